@@ -24,6 +24,8 @@ template <typename ElemType>
 void DoAdapt(const ConfigParameters& config);
 template <typename ElemType>
 void DoEdit(const ConfigParameters& config);
+template <typename ElemType>
+void DoBenchmarkAggregation(const ConfigParameters& config);
 
 // evaluation (EvalActions.cpp)
 template <typename ElemType>
@@ -32,16 +34,26 @@ template <typename ElemType>
 void DoCrossValidate(const ConfigParameters& config);
 template <typename ElemType>
 void DoWriteOutput(const ConfigParameters& config);
+template <typename ElemType>
+void DoBeamSearch(const ConfigParameters& config);
 
 // misc (OtherActions.cp)
 template <typename ElemType>
 void DoCreateLabelMap(const ConfigParameters& config);
 template <typename ElemType>
+void DoConvertCorpus(const ConfigParameters& config);
+template <typename ElemType>
+void DoPackImages(const ConfigParameters& config);
+template <typename ElemType>
+void DoCompressFeatures(const ConfigParameters& config);
+template <typename ElemType>
 void DoParameterSVD(const ConfigParameters& config);
 template <typename ElemType>
 void DoWriteWordAndClassInfo(const ConfigParameters& config);
 template <typename ElemType>
 void DoTopologyPlot(const ConfigParameters& config);
+template <typename ElemType>
+void DoPlanMemory(const ConfigParameters& config);
 
 // special purpose (EsotericActions.cp)
 template <typename ElemType>
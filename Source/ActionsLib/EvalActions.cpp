@@ -17,6 +17,7 @@
 #include "Config.h"
 #include "SimpleEvaluator.h"
 #include "SimpleOutputWriter.h"
+#include "BeamSearchDecoder.h"
 #include "BestGpu.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
@@ -29,6 +30,9 @@
 #include <queue>
 #include <set>
 #include <memory>
+#include <fstream>
+#include <sstream>
+#include <iterator>
 
 #ifndef let
 #define let const auto
@@ -228,7 +232,9 @@ void DoWriteOutput(const ConfigParameters& config)
 
     auto net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelPath);
 
-    SimpleOutputWriter<ElemType> writer(net, 1);
+    // formatting and writing the output overlaps with the evaluation of the next minibatch, unless asyncWrite=false
+    const bool asyncWrite = config(L"asyncWrite", "true");
+    SimpleOutputWriter<ElemType> writer(net, 1, asyncWrite);
 
     if (config.Exists("writer"))
     {
@@ -240,10 +246,86 @@ void DoWriteOutput(const ConfigParameters& config)
     else if (config.Exists("outputPath"))
     {
         wstring outputPath = config(L"outputPath"); // crashes if no default given?
-        writer.WriteOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, epochSize);
+        wstring outputFormat = config(L"outputFormat", L"text"); // 'binary' writes the values as they are in memory (see SimpleOutputWriter)
+        if (outputFormat != L"text" && outputFormat != L"binary")
+            InvalidArgument("DoWriteOutput: outputFormat must be 'text' or 'binary'.");
+        writer.WriteOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, epochSize, outputFormat == L"binary");
     }
     // writer.WriteOutput(testDataReader, mbSize[0], testDataWriter, outputNodeNamesVector, epochSize);
 }
 
 template void DoWriteOutput<float>(const ConfigParameters& config);
 template void DoWriteOutput<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoBeamSearch() - implements CNTK "beamSearch" command
+// Each line of inputPath is the prefix of one sentence, as token indices (may be empty). Each line of outputPath is
+// one hypothesis: the sentence's line number, the log probability, and the tokens, best first within a sentence.
+// ===========================================================================
+
+template <typename ElemType>
+void DoBeamSearch(const ConfigParameters& config)
+{
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    wstring modelPath = config(L"modelPath");
+    wstring inputNodeName = config(L"inputNodeName");
+    wstring outputNodeName = config(L"outputNodeName");
+    size_t beamWidth = config(L"beamWidth", "5");
+    size_t maxLength = config(L"maxLength", "100");
+    size_t startSymbol = config(L"startSymbol");
+    size_t endSymbol = config(L"endSymbol");
+    size_t numSentencesPerBatch = config(L"numSentencesPerBatch", "64"); // (times beamWidth parallel sequences)
+    std::string inputPath = config(L"inputPath");
+    std::string outputPath = config(L"outputPath");
+    if (numSentencesPerBatch == 0)
+        InvalidArgument("DoBeamSearch: numSentencesPerBatch must be positive.");
+
+    auto net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelPath);
+    BeamSearchDecoder<ElemType> decoder(net, inputNodeName, outputNodeName, beamWidth, maxLength, startSymbol, endSymbol);
+
+    std::ifstream inputFile(inputPath);
+    if (!inputFile)
+        RuntimeError("DoBeamSearch: could not open %s for reading.", inputPath.c_str());
+    std::ofstream outputFile(outputPath);
+    if (!outputFile)
+        RuntimeError("DoBeamSearch: could not open %s for writing.", outputPath.c_str());
+
+    size_t numSentences = 0;
+    std::vector<std::vector<size_t>> prefixes;
+    std::string line;
+    for (;;)
+    {
+        const bool haveLine = (bool) std::getline(inputFile, line);
+        if (haveLine)
+        {
+            std::istringstream tokens(line);
+            prefixes.push_back(std::vector<size_t>(std::istream_iterator<size_t>(tokens), std::istream_iterator<size_t>()));
+            if (!tokens.eof())
+                InvalidArgument("DoBeamSearch: line %d of %s is not a list of token indices.", (int) (numSentences + prefixes.size()), inputPath.c_str());
+        }
+        if (prefixes.size() == numSentencesPerBatch || (!haveLine && !prefixes.empty()))
+        {
+            const auto nBest = decoder.Decode(prefixes);
+            for (size_t s = 0; s < nBest.size(); s++)
+            {
+                for (const auto& hypothesis : nBest[s])
+                {
+                    outputFile << (numSentences + s) << "\t" << hypothesis.score << "\t";
+                    for (size_t i = 0; i < hypothesis.tokens.size(); i++)
+                        outputFile << (i > 0 ? " " : "") << hypothesis.tokens[i];
+                    outputFile << "\n";
+                }
+            }
+            if (!outputFile)
+                RuntimeError("DoBeamSearch: error writing to %s.", outputPath.c_str());
+            numSentences += prefixes.size();
+            prefixes.clear();
+            fprintf(stderr, "DoBeamSearch: %d sentences decoded.\n", (int) numSentences);
+        }
+        if (!haveLine)
+            break;
+    }
+}
+
+template void DoBeamSearch<float>(const ConfigParameters& config);
+template void DoBeamSearch<double>(const ConfigParameters& config);
@@ -13,10 +13,16 @@
 #include "ComputationNetwork.h"
 #include "ComputationNode.h"
 #include "Config.h"
+#include "BestGpu.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
+#include "ChunkedBinaryCorpus.h"
+#include "PackedImageFile.h"
+#include "../Readers/HTKMLFReader/htkfeatio.h" // for compact feature archives
 
 #include <string>
+#include <fstream>
+#include <sstream>
 #include <chrono>
 #include <algorithm>
 #include <vector>
@@ -117,6 +123,329 @@ void DoCreateLabelMap(const ConfigParameters& config)
 template void DoCreateLabelMap<float>(const ConfigParameters& config);
 template void DoCreateLabelMap<double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoConvertCorpus() - implements CNTK "convertCorpus" command
+// Reads a corpus once with any reader and writes it as a chunked binary corpus
+// (ChunkedBinaryCorpus.h) for ChunkedBinaryReader, keeping sequence boundaries.
+//
+// convert=[
+//     action="convertCorpus"
+//     reader=[...]                # any reader, without randomization
+//     outputFile="corpus.cbc"
+//     streams="features:labels"   # default: the reader sections that have a 'dim'
+//     sparseStreams="labels"      # streams that the reader delivers as sparse matrices
+//     oneHotStreams="labels"      # streams with a single 1 per sample (e.g. words), stored as ids; sparse or dense in the reader
+//     chunkSizeInSamples=65536
+// ]
+// ===========================================================================
+
+template <typename ElemType>
+void DoConvertCorpus(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    std::wstring outputFile = config(L"outputFile");
+    size_t chunkSizeInSamples = config(L"chunkSizeInSamples", "65536");
+    size_t minibatchSize = config(L"minibatchSize", "1024");
+    int traceLevel = config(L"traceLevel", "0");
+
+    std::vector<std::wstring> streamNames;
+    if (config.Exists(L"streams"))
+    {
+        ConfigArray streams = config(L"streams");
+        for (int i = 0; i < streams.size(); ++i)
+            streamNames.push_back(streams[i]);
+    }
+    else
+    {
+        std::vector<std::wstring> labelNames;
+        GetFileConfigNames(readerConfig, streamNames, labelNames);
+        streamNames.insert(streamNames.end(), labelNames.begin(), labelNames.end());
+    }
+    if (streamNames.empty())
+        RuntimeError("ConvertCorpus: no streams found to convert");
+    ConfigArray sparseStreams = config(L"sparseStreams", "");
+    std::set<std::wstring> sparseNames;
+    for (int i = 0; i < sparseStreams.size(); ++i)
+        sparseNames.insert(sparseStreams[i]);
+    ConfigArray oneHotStreams = config(L"oneHotStreams", "");
+    std::set<std::wstring> oneHotNames;
+    for (int i = 0; i < oneHotStreams.size(); ++i)
+        oneHotNames.insert(oneHotStreams[i]);
+
+    // the reader's minibatch matrices, on the CPU
+    const size_t numStreams = streamNames.size();
+    std::vector<shared_ptr<Matrix<ElemType>>> streamMatrices;
+    std::map<std::wstring, Matrix<ElemType>*> matrices;
+    for (const auto& name : streamNames)
+    {
+        auto matrix = make_shared<Matrix<ElemType>>(CPUDEVICE);
+        if (sparseNames.find(name) != sparseNames.end())
+            matrix->SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, false);
+        streamMatrices.push_back(matrix);
+        matrices[name] = matrix.get();
+    }
+
+    DataReader<ElemType> dataReader(readerConfig);
+    dataReader.StartMinibatchLoop(minibatchSize, 0, requestDataSize);
+    MBLayoutPtr pMBLayout = make_shared<MBLayout>();
+    unique_ptr<ChunkedBinaryCorpusWriter> writer;
+    std::map<UniqueSequenceId, ChunkedBinarySequence> openSequences; // sequences that continue in the next minibatch
+    std::vector<std::vector<ElemType>> values(numStreams);
+    std::vector<std::vector<CPUSPARSE_INDEX_TYPE>> colStarts(numStreams), rowIndices(numStreams);
+    size_t numSamples = 0;
+    auto start = std::chrono::system_clock::now();
+    while (dataReader.GetMinibatch(matrices))
+    {
+        dataReader.CopyMBLayoutTo(pMBLayout);
+        if (!writer)
+        {
+            std::vector<ChunkedBinaryStream> streams;
+            for (size_t k = 0; k < numStreams; k++)
+            {
+                const bool isOneHot = oneHotNames.find(streamNames[k]) != oneHotNames.end();
+                streams.push_back(ChunkedBinaryStream{streamNames[k], isOneHot || streamMatrices[k]->GetMatrixType() == MatrixType::SPARSE, streamMatrices[k]->GetNumRows(), isOneHot});
+            }
+            writer.reset(new ChunkedBinaryCorpusWriter(outputFile, streams, chunkSizeInSamples));
+        }
+
+        for (size_t k = 0; k < numStreams; k++)
+        {
+            const auto& matrix = *streamMatrices[k];
+            if (matrix.GetNumCols() != pMBLayout->GetNumCols())
+                RuntimeError("ConvertCorpus: stream '%ls' has %d columns, but the minibatch layout has %d.", streamNames[k].c_str(), (int) matrix.GetNumCols(), (int) pMBLayout->GetNumCols());
+            if (matrix.GetMatrixType() == MatrixType::SPARSE)
+                matrix.GetSparseCSCData(colStarts[k], rowIndices[k], values[k]);
+            else
+            {
+                values[k].resize(matrix.GetNumElements());
+                matrix.CopySection(matrix.GetNumRows(), matrix.GetNumCols(), values[k].data(), matrix.GetNumRows());
+            }
+        }
+
+        // columns are ordered by time step, then parallel sequence
+        const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+        const size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+        for (const auto& seq : pMBLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            auto& sequence = openSequences[seq.seqId];
+            if (seq.tBegin >= 0 || sequence.values.empty()) // (a truncated sequence may have begun in an earlier minibatch)
+                sequence.Clear(numStreams);
+            const size_t tEnd = min(seq.tEnd, numTimeSteps);
+            for (size_t t = (size_t) max(seq.tBegin, (ptrdiff_t) 0); t < tEnd; t++)
+            {
+                const size_t j = t * numParallelSequences + seq.s;
+                for (size_t k = 0; k < numStreams; k++)
+                {
+                    const size_t dim = streamMatrices[k]->GetNumRows();
+                    if (oneHotNames.find(streamNames[k]) != oneHotNames.end())
+                    {
+                        // the position of the single 1
+                        size_t id = SIZE_MAX, nnz = 0;
+                        if (streamMatrices[k]->GetMatrixType() == MatrixType::SPARSE)
+                        {
+                            for (CPUSPARSE_INDEX_TYPE p = colStarts[k][j]; p < colStarts[k][j + 1]; p++, nnz++)
+                                if (values[k][p] == 1)
+                                    id = rowIndices[k][p];
+                        }
+                        else
+                        {
+                            for (size_t i = 0; i < dim; i++)
+                            {
+                                if (values[k][j * dim + i] != 0)
+                                    nnz++;
+                                if (values[k][j * dim + i] == 1)
+                                    id = i;
+                            }
+                        }
+                        if (nnz != 1 || id == SIZE_MAX)
+                            RuntimeError("ConvertCorpus: stream '%ls' is not one-hot (a sample has %d non-zero values).", streamNames[k].c_str(), (int) nnz);
+                        sequence.rowIndices[k].push_back((uint32_t) id);
+                    }
+                    else if (streamMatrices[k]->GetMatrixType() == MatrixType::SPARSE)
+                    {
+                        for (CPUSPARSE_INDEX_TYPE p = colStarts[k][j]; p < colStarts[k][j + 1]; p++)
+                        {
+                            sequence.rowIndices[k].push_back((uint32_t) rowIndices[k][p]);
+                            sequence.values[k].push_back((float) values[k][p]);
+                        }
+                        sequence.colStarts[k].push_back((uint32_t) sequence.values[k].size());
+                    }
+                    else
+                    {
+                        for (size_t i = 0; i < dim; i++)
+                            sequence.values[k].push_back((float) values[k][j * dim + i]);
+                    }
+                }
+                sequence.numSamples++;
+            }
+            if (seq.tEnd <= numTimeSteps)
+            {
+                numSamples += sequence.numSamples;
+                writer->AddSequence(sequence);
+                openSequences.erase(seq.seqId);
+            }
+        }
+        if (traceLevel > 1)
+            fprintf(stderr, "."); // progress meter
+    }
+    if (!writer)
+        RuntimeError("ConvertCorpus: the reader delivered no data");
+    // (sequences still open when the data ended are kept as they are)
+    for (const auto& sequence : openSequences)
+    {
+        numSamples += sequence.second.numSamples;
+        writer->AddSequence(sequence.second);
+    }
+    writer->Close();
+
+    auto elapsed = std::chrono::system_clock::now() - start;
+    fprintf(stderr, "ConvertCorpus: wrote %d samples in %d sequences to '%ls' in %.1f seconds.\n",
+            (int) numSamples, (int) writer->GetNumSequences(), outputFile.c_str(), (float) (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) / 1000);
+}
+
+template void DoConvertCorpus<float>(const ConfigParameters& config);
+template void DoConvertCorpus<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoPackImages() - implements CNTK "packImages" command
+// Copies the image files listed in an ImageReader map file into one packed
+// image file (PackedImageFile.h), which ImageReader reads with 'packedFile'.
+//
+// pack=[
+//     action="packImages"
+//     file="train_map.txt"        # lines of <image path> TAB <class id>
+//     outputFile="train.pim"
+//     chunkSizeInImages=1024
+// ]
+// ===========================================================================
+
+template <typename ElemType>
+void DoPackImages(const ConfigParameters& config)
+{
+    std::string mapPath = config(L"file");
+    std::wstring outputFile = config(L"outputFile");
+    size_t chunkSizeInImages = config(L"chunkSizeInImages", "1024");
+    int traceLevel = config(L"traceLevel", "0");
+
+    std::ifstream mapFile(mapPath);
+    if (!mapFile)
+        RuntimeError("PackImages: could not open %s for reading.", mapPath.c_str());
+
+    PackedImageWriter writer(outputFile, chunkSizeInImages);
+    std::vector<char> data;
+    size_t numBytes = 0;
+    auto start = std::chrono::system_clock::now();
+    std::string line;
+    for (size_t cline = 0; std::getline(mapFile, line); cline++)
+    {
+        std::stringstream ss{line};
+        std::string imgPath;
+        std::string clsId;
+        if (!std::getline(ss, imgPath, '\t') || !std::getline(ss, clsId, '\t'))
+            RuntimeError("PackImages: invalid map file format, must contain 2 tab-delimited columns: %s, line: %d.", mapPath.c_str(), (int) cline);
+
+        std::ifstream imgFile(imgPath, std::ios::binary | std::ios::ate);
+        if (!imgFile)
+            RuntimeError("PackImages: cannot read image file %s", imgPath.c_str());
+        data.resize((size_t) imgFile.tellg());
+        imgFile.seekg(0);
+        if (!imgFile.read(data.data(), data.size()))
+            RuntimeError("PackImages: cannot read image file %s", imgPath.c_str());
+
+        writer.AddImage(data, std::stoi(clsId));
+        numBytes += data.size();
+        if (traceLevel > 1 && writer.GetNumImages() % 10000 == 0)
+            fprintf(stderr, "."); // progress meter
+    }
+    writer.Close();
+
+    auto elapsed = std::chrono::system_clock::now() - start;
+    fprintf(stderr, "PackImages: wrote %d images (%.1f MB) to '%ls' in %.1f seconds.\n",
+            (int) writer.GetNumImages(), numBytes / 1e6, outputFile.c_str(), (float) (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) / 1000);
+}
+
+template void DoPackImages<float>(const ConfigParameters& config);
+template void DoPackImages<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoCompressFeatures() - implements CNTK "compressFeatures" command
+// Converts the HTK feature files and archives of an HTKMLFReader script file
+// into compact feature archives (see htkfeatio.h), which the reader reads like
+// the originals, and writes a script file that refers to them.
+//
+// compress=[
+//     action="compressFeatures"
+//     scpFile="train.scp"          # lines of <logical path>=<archive>[<first frame>,<last frame>], or of file paths
+//     outputScpFile="train.cfa.scp"
+//     encoding="int8"              # fp16 (2x smaller), int16 or int8 (4x smaller), linear per chunk and dimension
+//     chunkFrames=256              # frames that share the range of the linear encodings
+//     suffix=".cfa"                # appended to the path of each converted file
+// ]
+// ===========================================================================
+
+template <typename ElemType>
+void DoCompressFeatures(const ConfigParameters& config)
+{
+    std::wstring scpFile = config(L"scpFile");
+    std::wstring outputScpFile = config(L"outputScpFile");
+    std::string encodingName = config(L"encoding", "fp16");
+    size_t chunkFrames = config(L"chunkFrames", "256");
+    std::wstring suffix = config(L"suffix", L".cfa");
+
+    int encoding;
+    if (encodingName == "fp16")
+        encoding = msra::asr::htkfeatio::compactfp16;
+    else if (encodingName == "int16")
+        encoding = msra::asr::htkfeatio::compactint16;
+    else if (encodingName == "int8")
+        encoding = msra::asr::htkfeatio::compactint8;
+    else
+        InvalidArgument("CompressFeatures: encoding must be fp16, int16 or int8, not %s.", encodingName.c_str());
+    if (chunkFrames == 0)
+        InvalidArgument("CompressFeatures: chunkFrames must be at least 1.");
+
+    std::vector<std::wstring> lines;
+    File(scpFile, fileOptionsText | fileOptionsRead).GetLines(lines);
+
+    std::set<std::wstring> converted;
+    size_t numFrames = 0;
+    uint64_t numBytesIn = 0, numBytesOut = 0;
+    auto start = std::chrono::system_clock::now();
+    std::ofstream outputScp(msra::strfun::utf8(outputScpFile));
+    if (!outputScp)
+        RuntimeError("CompressFeatures: could not open %ls for writing.", outputScpFile.c_str());
+    for (const auto& line : lines)
+    {
+        if (line.empty())
+            continue;
+        const msra::asr::htkfeatreader::parsedpath path(line);
+        const std::wstring& archive = path.physicallocation();
+        const std::wstring outputArchive = archive + suffix;
+        if (converted.insert(archive).second)
+        {
+            numFrames += msra::asr::htkfeatcompactwriter::convert(archive, outputArchive, encoding, chunkFrames);
+            numBytesIn += filesize(archive.c_str());
+            numBytesOut += filesize(outputArchive.c_str());
+        }
+        // the logical path, which matches the labels, stays the same
+        const size_t equals = line.find(L'=');
+        if (equals == std::wstring::npos)
+            outputScp << msra::strfun::utf8(line + L"=" + outputArchive) << "\n";
+        else
+            outputScp << msra::strfun::utf8(line.substr(0, equals + 1) + outputArchive + line.substr(equals + 1 + archive.size())) << "\n";
+    }
+
+    auto elapsed = std::chrono::system_clock::now() - start;
+    fprintf(stderr, "CompressFeatures: converted %d files (%d frames, %.1f MB to %.1f MB) in %.1f seconds; script file written to '%ls'.\n",
+            (int) converted.size(), (int) numFrames, numBytesIn / 1e6, numBytesOut / 1e6,
+            (float) (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) / 1000, outputScpFile.c_str());
+}
+
+template void DoCompressFeatures<float>(const ConfigParameters& config);
+template void DoCompressFeatures<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoParameterSVD() - implements CNTK "SVD" command
 // ===========================================================================
@@ -137,21 +466,29 @@ template void DoCreateLabelMap<double>(const ConfigParameters& config);
 //                  3)  KeepRatio           -- how many percentage of energy we want to keep
 //                  4)  AlignedSize         -- the resultant number of signular values is aligned to e.g., 32 or 64
 //                  5)  ParameterName       -- name (regex) of the parameter node we want to perform a SVD decomposition
+//          optionally:
+//                  6)  MaxRank             -- upper limit of the number of kept signular values (0: none)
+//                  7)  RandomizedSVD       -- compute only the leading singular values, by a randomized range finder;
+//                                             KeepRatio is then a share of the squared Frobenius norm, not of the sum of singular values
+//                  8)  deviceId            -- where the randomized SVD runs (the model is loaded on the CPU regardless)
+//                  9)  Oversampling, PowerIterations -- accuracy of the randomized SVD
+//                 10)  numThreads          -- matrices factored concurrently on the CPU
 //
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 //  helper function for DoParameterSVD
 //////////////////////////////////////////////////////////////////////////
-bool ParseSVDConfigFile(wstring fn, map<wstring, float>& config)
+bool ParseSVDConfigFile(wstring fn, map<wstring, pair<float, size_t>>& config)
 {
     msra::files::textreader reader(fn);
     for (; reader;)
     {
         wstring line = reader.wgetline();
         vector<wstring> tokens = msra::strfun::split(line, L"\t ");
-        if (tokens.size() != 2)
+        if (tokens.size() != 2 && tokens.size() != 3)
             return false;
-        config[tokens[0]] = (float) msra::strfun::todouble(tokens[1]);
+        const size_t maxRank = tokens.size() == 3 ? (size_t) msra::strfun::toint(tokens[2]) : 0;
+        config[tokens[0]] = make_pair((float) msra::strfun::todouble(tokens[1]), maxRank);
     }
     return true;
 }
@@ -160,10 +497,11 @@ void SVDConfigFileUsage()
 {
     fprintf(stderr, "usage of SVDConfigFile\n");
     fprintf(stderr, "A SVDConfigFile is referred in main config by \"SVDConfig\"\n");
-    fprintf(stderr, "Each line in this file specifies a group of Learnable Parameter nodes using regex and the KeepRatio associated with that group\n");
+    fprintf(stderr, "Each line in this file specifies a group of Learnable Parameter nodes using regex and the KeepRatio associated with that group,\n");
+    fprintf(stderr, "optionally followed by the maximum number of singular values to keep\n");
     fprintf(stderr, "An example: \n");
     fprintf(stderr, "W0         1.0\n");
-    fprintf(stderr, "W[1-5]     0.4\n");
+    fprintf(stderr, "W[1-5]     0.4     256\n");
 }
 template <typename ElemType>
 void DoParameterSVD(const ConfigParameters& config)
@@ -171,14 +509,23 @@ void DoParameterSVD(const ConfigParameters& config)
     DEVICEID_TYPE deviceID = -1; // use CPU for SVD
     wstring modelPath = config(L"modelPath");
     wstring outputmodelPath = config(L"outputmodelPath");
-    map<wstring, float> svdconfig;
+    map<wstring, pair<float, size_t>> svdconfig;
 
     float keepratio = config(L"KeepRatio", "0.4");
-    size_t AlignedSize = config(L"AlignedSize", "8");
+    size_t maxRank = config(L"MaxRank", "0");
+    ComputationNetwork::SVDOptions options;
+    options.alignedSize = config(L"AlignedSize", "8");
+    options.randomized = config(L"RandomizedSVD", false);
+    options.deviceId = options.randomized ? DeviceFromConfig(config) : CPUDEVICE;
+    options.oversampling = config(L"Oversampling", "16");
+    options.powerIterations = config(L"PowerIterations", "2");
+    options.numThreads = config(L"numThreads", "1");
+    if (options.alignedSize == 0)
+        InvalidArgument("DoParameterSVD: AlignedSize must be positive.");
     wstring svdnodeRegex = config(L"NodeNameRegex", L"");
     if (!svdnodeRegex.empty())
     {
-        svdconfig[svdnodeRegex] = keepratio;
+        svdconfig[svdnodeRegex] = make_pair(keepratio, maxRank);
     }
     else
     {
@@ -200,7 +547,7 @@ void DoParameterSVD(const ConfigParameters& config)
     ComputationNetwork net(deviceID);
     net.Load<ElemType>(modelPath);
 
-    net.PerformSVDecomposition<ElemType>(svdconfig, AlignedSize);
+    net.PerformSVDecomposition<ElemType>(svdconfig, options);
     if (!outputmodelPath.empty())
         net.Save(outputmodelPath);
 }
@@ -239,6 +586,9 @@ struct compare_second
 ///    wrd2cls in dense matrix in[vocab_size X 1].it maps a word to its class id.
 ///    cls2idx in dense matrix in[nbr_cls X 1].it maps a class to its first word index.
 ///
+///    wordCounts (optional, outputWordCounts) has the count of each word, one per line in word index order; it is the
+///    wordCountsFile of HierarchicalSoftmax.
+///
 /// to be used for class-based entropy, the outputs have the following assumptions
 /// A1 : words are sorted so that words that are in the same class are together
 ///    i.e., wrds2cls[0] <= wrd2cls[1] <= ... <= wrd2cls[vocab_size - 1]
@@ -250,6 +600,7 @@ void DoWriteWordAndClassInfo(const ConfigParameters& config)
     string outputWord2Cls = config(L"outputWord2Cls");
     string outputVocabFile = config(L"outputVocabFile");
     string outputCls2Index = config(L"outputCls2Index");
+    string outputWordCounts = config(L"outputWordCounts", "");
     size_t vocabSize = config(L"vocabSize");
     int nbrCls = config(L"nbrClass", "0");
     int cutoff = config(L"cutoff", "1");
@@ -429,6 +780,16 @@ void DoWriteWordAndClassInfo(const ConfigParameters& config)
     }
 
     ofvocab.close();
+    if (!outputWordCounts.empty())
+    {
+        msra::files::make_intermediate_dirs(s2ws(outputWordCounts));
+        ofstream ofp(outputWordCounts.c_str());
+        if (!ofp)
+            RuntimeError("cannot write to %s", outputWordCounts.c_str());
+        for (size_t i = 0; i < m_index.size(); i++)
+            ofp << m_count[i] << endl;
+        ofp.close();
+    }
     if (nbrCls > 0)
     {
         // write the outputs
@@ -512,3 +873,50 @@ void DoTopologyPlot(const ConfigParameters& config)
 
 template void DoTopologyPlot<float>(const ConfigParameters& config);
 template void DoTopologyPlot<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoPlanMemory() - implements CNTK "planMemory" command
+// ===========================================================================
+
+// print the device memory a network will need for training with a given minibatch size, reading no data
+// The activations and node gradients are those of the memory-sharing plan (MatrixPool), which scales with the
+// minibatch size; parameters, their gradients and the optimizer state do not. cuDNN workspaces, reader buffers and
+// aggregation buffers are not planned; see the traceMemoryUsage option of SGD for what training actually uses.
+template <typename ElemType>
+void DoPlanMemory(const ConfigParameters& config)
+{
+    wstring modelPath = config(L"modelPath");
+    const size_t minibatchSize = config(L"minibatchSize", (size_t) 256); // in samples
+    const size_t numOptimizerStates = config(L"optimizerStatesPerParameter", (size_t) 1); // smoothed gradients per parameter: 1 for momentum SGD, 2 for Adam
+
+    ComputationNetwork net(-1);
+    net.Load<ElemType>(modelPath);
+    if (net.FinalCriterionNodes().empty())
+        InvalidArgument("planMemory: the model '%ls' has no training criterion.", modelPath.c_str());
+    ComputationNodeBasePtr criterionNode = net.FinalCriterionNodes()[0];
+
+    size_t parameterBytes = 0;
+    size_t gradientBytes = 0;
+    for (const auto& node : net.LearnableParameterNodes(criterionNode))
+    {
+        const size_t bytes = node->GetSampleLayout().GetNumElements() * sizeof(ElemType);
+        parameterBytes += bytes;
+        if (node->IsParameterUpdateRequired())
+            gradientBytes += bytes;
+    }
+
+    net.AllocateAllMatrices(net.EvaluationNodes(), net.OutputNodes(), criterionNode);
+    const size_t activationBytes = net.GetPlannedBytesPerSample() * minibatchSize;
+
+    const double MB = 1 << 20;
+    fprintf(stderr, "\nPlanned device memory for training with minibatches of %d samples:\n", (int) minibatchSize);
+    fprintf(stderr, "\t%-16s %10.1f MB\n", DeviceMemoryAccounting::TagName(MemoryTag::NodeValue), parameterBytes / MB);
+    fprintf(stderr, "\t%-16s %10.1f MB\n", DeviceMemoryAccounting::TagName(MemoryTag::NodeGradient), gradientBytes / MB);
+    fprintf(stderr, "\t%-16s %10.1f MB\n", DeviceMemoryAccounting::TagName(MemoryTag::MatrixPool), activationBytes / MB);
+    fprintf(stderr, "\t%-16s %10.1f MB\n", DeviceMemoryAccounting::TagName(MemoryTag::OptimizerState), numOptimizerStates * gradientBytes / MB);
+    fprintf(stderr, "\ttotal            %10.1f MB (without workspaces, reader and aggregation buffers)\n",
+            (parameterBytes + gradientBytes + activationBytes + numOptimizerStates * gradientBytes) / MB);
+}
+
+template void DoPlanMemory<float>(const ConfigParameters& config);
+template void DoPlanMemory<double>(const ConfigParameters& config);
@@ -19,6 +19,16 @@
 #include "SynchronousExecutionEngine.h"
 #include "ModelEditLanguage.h"
 #include "SGD.h"
+#include "ComputationNetworkBuilder.h"
+#include "SimpleDistGradAggregator.h"
+#include "HalfPrecisionGradAggregator.h"
+#ifdef QUANTIZED_GRADIENT_AGGREGATION
+#include "AllReduceDistGradAggregator.h"
+#endif
+#include "ModelDeltaExchange.h"
+#include "DistGradHeader.h"
+#include "MPIWrapper.h"
+#include "TimerUtility.h"
 #include "Config.h"
 #include "SimpleEvaluator.h"
 #include "SimpleOutputWriter.h"
@@ -35,6 +45,10 @@
 #include <queue>
 #include <set>
 #include <memory>
+#include <fstream>
+#include <iterator>
+#include <future>
+#include <type_traits>
 
 #ifndef let
 #define let const auto
@@ -93,17 +107,132 @@ shared_ptr<C> CreateObject(const ConfigParameters& config, const wchar_t* id)
     return make_shared<C>(readerConfig);                           // old CNTK config specifies a dictionary which then must be explicitly instantiated
 }
 
+// text that identifies the reader configuration, which keys SGD's precompute cache
+static wstring ReaderConfigKey(const ConfigParameters& config)
+{
+    return msra::strfun::utf16(config(L"reader"));
+}
+// BrainScript has already turned the reader record into an object, so there is no text to compare; the cache is then keyed by the network's nodes only
+static wstring ReaderConfigKey(const ScriptableObjects::IConfigRecord&)
+{
+    return wstring();
+}
+
+// text of a network-builder section, which keys the network cache; for NDL including the files it reads
+static wstring NetworkBuilderConfigKey(const ConfigParameters& config, const wchar_t* id)
+{
+    const ConfigParameters builderConfig(config(id));
+    wstring key = msra::strfun::utf16(config(id));
+    vector<string> paths;
+    if (builderConfig.Exists("networkDescription"))
+        paths.push_back(builderConfig("networkDescription"));
+    if (builderConfig.Exists("ndlMacros"))
+        for (const auto& path : msra::strfun::split(builderConfig("ndlMacros"), "+"))
+            paths.push_back(path);
+    for (const auto& path : paths)
+    {
+        ifstream file(path, ios::binary);
+        if (file)
+            key += L"|" + msra::strfun::utf16(path) + L"=" + msra::strfun::utf16(string(istreambuf_iterator<char>(file), istreambuf_iterator<char>()));
+    }
+    return key;
+}
+// BrainScript has already turned these sections into records, so there is no text to key with
+static wstring NetworkBuilderConfigKey(const ScriptableObjects::IConfigRecord&, const wchar_t*)
+{
+    return wstring();
+}
+
+// networkCacheDir -- networks built from a description are kept there as model files named by a hash of the description,
+// so that further runs with the same description load them instead of parsing the description and building the network.
+// Not for createNetwork, which is code that may compute anything. Returns an empty path if there is no caching.
+template <class ConfigRecordType, typename ElemType>
+static wstring NetworkCachePath(const ConfigRecordType& config)
+{
+    if (!config.Exists(L"networkCacheDir") || config.Exists(L"createNetwork"))
+        return wstring();
+    wstring key;
+    if (config.Exists(L"SimpleNetworkBuilder"))
+        key = L"SimpleNetworkBuilder=" + NetworkBuilderConfigKey(config, L"SimpleNetworkBuilder");
+    else if (config.Exists(L"NDLNetworkBuilder"))
+        key = L"NDLNetworkBuilder=" + NetworkBuilderConfigKey(config, L"NDLNetworkBuilder");
+    else if (config.Exists(L"BrainScriptNetworkBuilder") || config.Exists(L"ExperimentalNetworkBuilder"))
+    {
+        wstring sourceCode = config.Exists(L"BrainScriptNetworkBuilder") ? config(L"BrainScriptNetworkBuilder") : config(L"ExperimentalNetworkBuilder");
+        key = L"BrainScriptNetworkBuilder=" + sourceCode;
+    }
+    if (key.empty() || key.back() == L'=')
+        return wstring();
+    key += wstring(L"|precision=") + ElemTypeName<ElemType>();
+
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+    for (wchar_t c : key)
+    {
+        hash ^= (uint64_t) c;
+        hash *= 1099511628211ull;
+    }
+    wstring dir = config(L"networkCacheDir");
+    return dir + msra::strfun::wstrprintf(L"/%016llx.dnn", (unsigned long long) hash);
+}
+
 template <class ConfigRecordType, typename ElemType>
 void DoTrain(const ConfigRecordType& config)
 {
     bool makeMode = config(L"makeMode", true);
+
+    // the optimizer comes first, since it times the startup up to the first minibatch
+    shared_ptr<SGD<ElemType>> optimizer;
+    if (config.Exists(L"optimizer"))
+    {
+        optimizer = CreateObject<SGD<ElemType>>(config, L"optimizer");
+    }
+    else // legacy CNTK config syntax: needs a record called 'SGD'
+    {
+        const ConfigRecordType& configSGD(config(L"SGD"));
+        optimizer = make_shared<SGD<ElemType>>(configSGD);
+    }
+    optimizer->SetReaderConfigKey(ReaderConfigKey(config));
+
+    // parallelStartup: the readers are created (MLF parsing, archive TOCs, chunk indices) on another thread, while this one
+    // picks the device, creates its context, and creates the network or loads the checkpoint; only with the legacy config
+    // syntax, since BrainScript records are evaluated lazily, which is not thread-safe
+    bool parallelStartup = config(L"parallelStartup", false);
+    if (parallelStartup && !std::is_same<ConfigRecordType, ConfigParameters>::value)
+    {
+        fprintf(stderr, "WARNING: parallelStartup is ignored with BrainScript configurations.\n");
+        parallelStartup = false;
+    }
+    shared_ptr<DataReader<ElemType>> dataReader;
+    shared_ptr<DataReader<ElemType>> cvDataReader;
+    auto createReadersFn = [&config, &dataReader, &cvDataReader]()
+    {
+        dataReader = CreateObject<DataReader<ElemType>>(config, L"reader");
+        if (config.Exists(L"cvReader"))
+            cvDataReader = CreateObject<DataReader<ElemType>>(config, L"cvReader");
+    };
+    std::future<void> readersCreated;
+    if (parallelStartup)
+        readersCreated = std::async(std::launch::async, createReadersFn);
+
     DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    if (parallelStartup && deviceId >= 0)
+        Matrix<ElemType> deviceContext(1, 1, deviceId); // (the context is created with the first allocation)
 
     // determine the network-creation function
     // We have several ways to create that network.
     function<ComputationNetworkPtr(DEVICEID_TYPE)> createNetworkFn;
 
-    if (config.Exists(L"createNetwork"))
+    const wstring networkCachePath = NetworkCachePath<ConfigRecordType, ElemType>(config);
+    const bool haveCachedNetwork = !networkCachePath.empty() && fexists(networkCachePath);
+    if (haveCachedNetwork)
+    {
+        fprintf(stderr, "Using the network cached in %ls.\n", networkCachePath.c_str());
+        createNetworkFn = [networkCachePath](DEVICEID_TYPE deviceId)
+        {
+            return ComputationNetwork::CreateFromFile<ElemType>(deviceId, networkCachePath);
+        };
+    }
+    else if (config.Exists(L"createNetwork"))
     {
         createNetworkFn = GetCreateNetworkFn(config); // (we need a separate function needed due to template code)
     }
@@ -155,24 +284,39 @@ void DoTrain(const ConfigRecordType& config)
         RuntimeError("No network builder found in the config file. NDLNetworkBuilder or SimpleNetworkBuilde must be specified");
     }
 
-    auto dataReader = CreateObject<DataReader<ElemType>>(config, L"reader");
-
-    shared_ptr<DataReader<ElemType>> cvDataReader;
-    if (config.Exists(L"cvReader"))
-        cvDataReader = CreateObject<DataReader<ElemType>>(config, L"cvReader");
+    // written to a temporary file first, so that concurrent jobs never load a truncated network
+    if (!networkCachePath.empty() && !haveCachedNetwork)
+    {
+        auto buildNetworkFn = createNetworkFn;
+        createNetworkFn = [buildNetworkFn, networkCachePath](DEVICEID_TYPE deviceId)
+        {
+            auto net = buildNetworkFn(deviceId);
+            if ((g_mpi == nullptr) || g_mpi->IsMainNode())
+            {
+                const wstring tmpPath = networkCachePath + L"." + std::to_wstring(GetCurrentProcessId()) + L".tmp";
+                msra::files::make_intermediate_dirs(networkCachePath);
+                net->Save(tmpPath);
+                renameOrDie(tmpPath, networkCachePath);
+                fprintf(stderr, "Saved the network to the cache %ls.\n", networkCachePath.c_str());
+            }
+            return net;
+        };
+    }
 
-    shared_ptr<SGD<ElemType>> optimizer;
-    if (config.Exists(L"optimizer"))
+    if (parallelStartup)
     {
-        optimizer = CreateObject<SGD<ElemType>>(config, L"optimizer");
+        optimizer->TrainWithDeferredReaders(createNetworkFn, deviceId, [&readersCreated, &dataReader, &cvDataReader]()
+                                            {
+                                                readersCreated.get(); // (rethrows what the reader thread failed with)
+                                                return make_pair((IDataReader<ElemType>*) dataReader.get(), (IDataReader<ElemType>*) cvDataReader.get());
+                                            },
+                                            makeMode);
     }
-    else // legacy CNTK config syntax: needs a record called 'SGD'
+    else
     {
-        const ConfigRecordType& configSGD(config(L"SGD"));
-        optimizer = make_shared<SGD<ElemType>>(configSGD);
+        createReadersFn();
+        optimizer->Train(createNetworkFn, deviceId, dataReader.get(), cvDataReader.get(), makeMode);
     }
-
-    optimizer->Train(createNetworkFn, deviceId, dataReader.get(), cvDataReader.get(), makeMode);
 }
 
 namespace Microsoft { namespace MSR { namespace ScriptableObjects {
@@ -272,3 +416,218 @@ void DoEdit(const ConfigParameters& config)
 
 template void DoEdit<double>(const ConfigParameters& config);
 template void DoEdit<float>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoBenchmarkAggregation() - implements CNTK "benchmarkAggregation" command
+// ===========================================================================
+
+// per-step timing of one rank count of DoBenchmarkAggregation(), the slowest rank's
+struct AggregationBenchmarkResult
+{
+    size_t numRanks;
+    size_t minibatchSizePerRank;
+    double computeSeconds;
+    double communicationSeconds;
+    double stepSeconds;
+};
+
+// train a synthetic network over the first 'numRanks' MPI ranks with random data and measure forward/backward
+// prop plus update ('compute') and the gradient aggregation or model averaging of each step ('communication')
+template <typename ElemType>
+static AggregationBenchmarkResult BenchmarkAggregation(ComputationNetwork& net, const ComputationNodeBasePtr& criterionNode,
+                                                       const wstring& method, size_t numGradientBits, size_t modelDeltaBits,
+                                                       size_t numRanks, size_t minibatchSizePerRank, size_t numWarmupSteps, size_t numSteps)
+{
+    AggregationBenchmarkResult result = {numRanks, minibatchSizePerRank, 0, 0, 0};
+    g_mpi->RequestNodes("benchmarkAggregation", numRanks);
+    if (!g_mpi->IsIdle())
+    {
+        shared_ptr<IDistGradAggregator<ElemType>> aggregator;
+        shared_ptr<ModelDeltaExchange<ElemType>> modelDeltaExchange;
+        if (method == L"modelAveraging")
+            modelDeltaExchange = make_shared<ModelDeltaExchange<ElemType>>(g_mpi, modelDeltaBits, true /*zeroThresholdFor1Bit*/);
+        else if (method == L"fp16" || method == L"bf16")
+            aggregator = make_shared<HalfPrecisionGradAggregator<ElemType>>(g_mpi, method == L"bf16", false /*useAsyncAggregation*/, 0 /*syncStatsTrace*/);
+        else if (method == L"quantized")
+        {
+#ifdef QUANTIZED_GRADIENT_AGGREGATION
+            aggregator = make_shared<AllReduceDistGradAggregator<ElemType>>(g_mpi, (int) numGradientBits, true /*zeroThresholdFor1Bit*/, true /*useQuantizationForSelfStripe*/, false /*useAsyncAggregation*/, 0 /*traceLevel*/, 0 /*syncStatsTrace*/);
+#else
+            numGradientBits;
+            RuntimeError("benchmarkAggregation: quantized aggregation is unsupported in CNTK binaries built without quantized gradient aggregation support.");
+#endif
+        }
+        else if (method == L"simple")
+            aggregator = make_shared<SimpleDistGradAggregator<ElemType>>(g_mpi, false /*useAsyncAggregation*/, 0 /*syncStatsTrace*/);
+        else
+            InvalidArgument("benchmarkAggregation: unknown aggregation '%ls'; use simple, quantized, fp16, bf16 or modelAveraging.", method.c_str());
+
+        // random input and labels of the minibatch size of this rank count
+        net.GetMBLayoutPtr()->InitAsFrameMode(minibatchSizePerRank);
+        std::vector<ComputationNodeBasePtr> inputNodes(net.FeatureNodes().begin(), net.FeatureNodes().end());
+        inputNodes.insert(inputNodes.end(), net.LabelNodes().begin(), net.LabelNodes().end());
+        for (const auto& node : inputNodes)
+        {
+            Matrix<ElemType>& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+            value.Resize(node->GetSampleMatrixNumRows(), minibatchSizePerRank);
+            value.SetUniformRandomValue(0, 1, (unsigned long) g_mpi->CurrentNodeRank() + 1);
+        }
+        net.NotifyInputNodesFunctionValuesMBSizeModified();
+        net.StartEvaluateMinibatchLoop(criterionNode);
+
+        const auto& learnableNodes = net.LearnableParameterNodes(criterionNode);
+        std::vector<Matrix<ElemType>*> gradients;
+        DistGradHeader* header = DistGradHeader::Create(0);
+        Timer computeTimer, communicationTimer;
+        for (size_t step = 0; step < numWarmupSteps + numSteps; step++)
+        {
+            computeTimer.Restart();
+            ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+            net.ForwardProp(criterionNode);
+            net.Backprop(criterionNode);
+            gradients.clear();
+            for (const auto& node : learnableNodes)
+            {
+                auto parameter = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+                gradients.push_back(&parameter->Gradient());
+                if (modelDeltaExchange) // (the models have to move for the averaging to have something to exchange)
+                    Matrix<ElemType>::ScaleAndAdd((ElemType) -1e-4, parameter->Gradient(), parameter->Value());
+            }
+            gradients.back()->Get00Element(); // (waits for the GPU)
+            computeTimer.Stop();
+
+            communicationTimer.Restart();
+            if (modelDeltaExchange)
+            {
+                modelDeltaExchange->Start(learnableNodes, minibatchSizePerRank);
+                modelDeltaExchange->Finish();
+                dynamic_pointer_cast<ComputationNode<ElemType>>(learnableNodes.back())->Value().Get00Element();
+            }
+            else
+            {
+                header->numSamples = minibatchSizePerRank;
+                header->numSamplesWithLabel = minibatchSizePerRank;
+                header->criterion = 0;
+                aggregator->AggregateGradients(gradients, header, 0);
+                gradients.back()->Get00Element();
+            }
+            communicationTimer.Stop();
+
+            if (step >= numWarmupSteps)
+            {
+                result.computeSeconds += computeTimer.ElapsedSeconds() / numSteps;
+                result.communicationSeconds += communicationTimer.ElapsedSeconds() / numSteps;
+            }
+        }
+        DistGradHeader::Destroy(header);
+
+        // the slowest rank sets the pace
+        double seconds[3] = {result.computeSeconds, result.communicationSeconds, result.computeSeconds + result.communicationSeconds};
+        MPI_Allreduce(MPI_IN_PLACE, seconds, 3, MPI_DOUBLE, MPI_MAX, g_mpi->Communicator()) || MpiFail("benchmarkAggregation: MPI_Allreduce");
+        result.computeSeconds = seconds[0];
+        result.communicationSeconds = seconds[1];
+        result.stepSeconds = seconds[2];
+    }
+    g_mpi->RequestNodes("benchmarkAggregation");
+    return result;
+}
+
+// Measure the scaling of data-parallel training on this cluster without any data: a synthetic network of
+// Times/Sigmoid layers of the given sizes (a SquareError criterion on top) is trained on random minibatches over
+// the first 1, 2, 4, ... MPI ranks (or 'numRanks'), with the real aggregators and MPI collectives. For each rank
+// count the main node writes the per-step compute and communication time of the slowest rank, the achieved bus
+// bandwidth of the aggregation (the full-precision gradient bytes, counted as for a ring all-reduce), and the scaling
+// efficiency relative to the first rank count: weak scaling keeps the minibatch of each rank, strong scaling the
+// minibatch over all ranks. Needs parallelTrain=true.
+template <typename ElemType>
+void DoBenchmarkAggregation(const ConfigParameters& config)
+{
+    if (g_mpi == nullptr)
+        InvalidArgument("benchmarkAggregation: needs parallelTrain=true and an MPI launch.");
+
+    ConfigArray layerSizesConfig = config(L"layerSizes", "1024:4096:4096:4096:1024");
+    intargvector layerSizes = layerSizesConfig;
+    if (layerSizes.size() < 2)
+        InvalidArgument("benchmarkAggregation: layerSizes needs an input and an output dimension.");
+    const size_t minibatchSize = config(L"minibatchSize", (size_t) 256);
+    const wstring scaling = config(L"scaling", L"weak"); // weak: minibatchSize per rank; strong: minibatchSize over all ranks
+    if (scaling != L"weak" && scaling != L"strong")
+        InvalidArgument("benchmarkAggregation: scaling must be weak or strong.");
+    const wstring method = config(L"aggregation", L"simple");
+    const size_t numGradientBits = config(L"numGradientBits", (size_t) 1);
+    const size_t modelDeltaBits = config(L"modelDeltaBits", (size_t) (8 * sizeof(ElemType)));
+    const size_t numWarmupSteps = config(L"numWarmupSteps", (size_t) 5);
+    const size_t numSteps = config(L"numSteps", (size_t) 20);
+    if (numSteps == 0)
+        InvalidArgument("benchmarkAggregation: numSteps must be at least 1.");
+
+    std::vector<size_t> rankCounts;
+    if (config.Exists(L"numRanks"))
+    {
+        ConfigArray rankCountsConfig = config(L"numRanks");
+        intargvector counts = rankCountsConfig;
+        for (size_t i = 0; i < counts.size(); i++)
+        {
+            if (counts[i] < 1 || counts[i] > (int) g_mpi->NumNodesInUse())
+                InvalidArgument("benchmarkAggregation: numRanks must be between 1 and the number of MPI ranks (%d).", (int) g_mpi->NumNodesInUse());
+            rankCounts.push_back(counts[i]);
+        }
+    }
+    else
+    {
+        for (size_t n = 1; n < g_mpi->NumNodesInUse(); n *= 2)
+            rankCounts.push_back(n);
+        rankCounts.push_back(g_mpi->NumNodesInUse());
+    }
+
+    // the synthetic network
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    ComputationNetwork net(deviceId);
+    ComputationNetworkBuilder<ElemType> builder(net);
+    auto input = builder.CreateInputNode(L"features", layerSizes[0]);
+    net.FeatureNodes().push_back(input);
+    auto output = input;
+    size_t numParameterElements = 0;
+    for (size_t i = 1; i < layerSizes.size(); i++)
+    {
+        auto w = builder.CreateLearnableParameter(msra::strfun::wstrprintf(L"W%d", (int) i - 1), layerSizes[i], layerSizes[i - 1]);
+        net.InitLearnableParameters(w, true /*uniformInit*/, (unsigned long) i, (ElemType) 1);
+        auto b = builder.CreateLearnableParameter(msra::strfun::wstrprintf(L"B%d", (int) i - 1), layerSizes[i], 1);
+        output = builder.Plus(builder.Times(w, output), b);
+        if (i + 1 < layerSizes.size())
+            output = builder.Sigmoid(output);
+        numParameterElements += layerSizes[i] * (layerSizes[i - 1] + 1);
+    }
+    auto label = builder.CreateInputNode(L"labels", layerSizes.back());
+    net.LabelNodes().push_back(label);
+    ComputationNodeBasePtr criterionNode = builder.SquareError(label, output, L"criterion");
+    net.FinalCriterionNodes().push_back(criterionNode);
+    net.CompileNetwork();
+    net.AllocateAllMatrices({}, {}, criterionNode);
+
+    const double gradientBytes = (double) numParameterElements * sizeof(ElemType);
+    if (g_mpi->IsMainNode())
+        fprintf(stderr, "\nbenchmarkAggregation: %d parameters (%.1f MB of gradients), %ls aggregation, %ls scaling with minibatches of %d samples%s.\n",
+                (int) numParameterElements, gradientBytes / (1 << 20), method.c_str(), scaling.c_str(), (int) minibatchSize, scaling == L"weak" ? " per rank" : "");
+
+    std::vector<AggregationBenchmarkResult> results;
+    for (size_t numRanks : rankCounts)
+    {
+        const size_t minibatchSizePerRank = scaling == L"weak" ? minibatchSize : max(minibatchSize / numRanks, (size_t) 1);
+        results.push_back(BenchmarkAggregation<ElemType>(net, criterionNode, method, numGradientBits, modelDeltaBits, numRanks, minibatchSizePerRank, numWarmupSteps, numSteps));
+        const AggregationBenchmarkResult& r = results.back();
+        const AggregationBenchmarkResult& reference = results.front();
+        const double samplesPerSecond = r.numRanks * r.minibatchSizePerRank / r.stepSeconds;
+        const double referenceSamplesPerSecond = reference.numRanks * reference.minibatchSizePerRank / reference.stepSeconds;
+        const double efficiency = scaling == L"weak" ? (samplesPerSecond / r.numRanks) / (referenceSamplesPerSecond / reference.numRanks)
+                                                     : (reference.stepSeconds * reference.numRanks) / (r.stepSeconds * r.numRanks);
+        const double busBandwidth = (r.numRanks > 1 && r.communicationSeconds > 0) ? gradientBytes / r.communicationSeconds * 2 * (r.numRanks - 1) / r.numRanks : 0;
+        if (g_mpi->IsMainNode())
+            fprintf(stderr, "benchmarkAggregation: ranks = %d; minibatch = %d per rank; compute = %.3f ms; communication = %.3f ms; step = %.3f ms; SamplesPerSecond = %.1f; bus bandwidth = %.2f GB/s; scaling efficiency = %.1f%%\n",
+                    (int) r.numRanks, (int) r.minibatchSizePerRank, 1000 * r.computeSeconds, 1000 * r.communicationSeconds, 1000 * r.stepSeconds,
+                    samplesPerSecond, busBandwidth / 1e9, 100 * efficiency);
+    }
+}
+
+template void DoBenchmarkAggregation<float>(const ConfigParameters& config);
+template void DoBenchmarkAggregation<double>(const ConfigParameters& config);
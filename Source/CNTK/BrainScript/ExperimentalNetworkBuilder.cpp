@@ -49,6 +49,7 @@ wstring computationNodes = // TODO: use actual TypeName() here? would first need
     L"Shift(input, fromOffset, boundaryValue, boundaryMode=-1/*context*/, dim=-1, tag='') = new ComputationNode [ operation = 'Shift' ; inputs = (input : boundaryValue) /*plus the function args*/ ]\n"
     L"RowSlice(startIndex, numRows, input, needGradient = false, tag='') = new ComputationNode [ operation = 'RowSlice' ; inputs = input /*plus the function args*/ ]\n"
     L"RowRepeat(input, numRepeats, needGradient = false, tag='') = new ComputationNode [ operation = 'RowRepeat' ; inputs = input /*plus the function args*/ ]\n"
+    L"SpliceNeighbors(input, leftContext, rightContext, tag='') = new ComputationNode [ operation = 'SpliceNeighbors' ; inputs = input /*plus the function args*/ ]\n"
     L"RowStack(inputs, tag='') = new ComputationNode [ operation = 'RowStack' /*plus the function args*/ ]\n"
     L"Reshape(input, numRows, imageWidth = 0, imageHeight = 0, imageChannels = 0, tag='') = new ComputationNode [ operation = 'LegacyReshape' ; inputs = input /*plus the function args*/ ]\n"
     L"NewReshape(input, dims, beginDim=0, endDim=0, tag='') = new ComputationNode [ operation = 'Reshape' ; inputs = input ; shape = new TensorShape [ /*dims*/ ] /*plus the function args*/ ]\n"
@@ -59,6 +60,11 @@ wstring computationNodes = // TODO: use actual TypeName() here? would first need
     L"WeightedLogistic(label, probability, instanceWeight, tag='') = new ComputationNode [ operation = 'Logistic' ; inputs = (label : probability : instanceWeight) /*plus the function args*/ ]\n"
     L"ReconcileMBLayout(dataInput, layoutInput, tag='') = new ComputationNode [ operation = 'ReconcileMBLayout' ; inputs = (dataInput : layoutInput) /*plus the function args*/ ]\n"
     L"Convolution(weightNode, inputValueNode, kernelWidth, kernelHeight, outputChannels, horizontalSubsample, verticalSubsample, zeroPadding = false, maxTempMemSizeInSamples = 0, imageLayout='CHW', tag='') = new ComputationNode [ operation = 'Convolution' ; inputs = (weightNode : inputValueNode) /*plus the function args*/ ]\n"
+    L"TimeDelay(weightNode, inputValueNode, kernelWidth, dilation = 1, subsample = 1, tag='') = new ComputationNode [ operation = 'TimeDelay' ; inputs = (weightNode : inputValueNode) /*plus the function args*/ ]\n"
+    L"SampledSoftmax(labels, hidden, weights, bias, numSamples, samplingDistribution='logUniform', unigramFile='', tag='') = new ComputationNode [ operation = 'SampledSoftmax' ; inputs = (labels : hidden : weights : bias) /*plus the function args*/ ]\n"
+    L"HierarchicalSoftmax(labels, hidden, weights, wordCountsFile, tag='') = new ComputationNode [ operation = 'HierarchicalSoftmax' ; inputs = (labels : hidden : weights) /*plus the function args*/ ]\n"
+    L"TensorContraction(A, B, spec, tag='') = new ComputationNode [ operation = 'TensorContraction' ; inputs = (A : B) /*plus the function args*/ ]\n"
+    L"LatticeFreeMMI(labels, logLikelihoods, denominatorGraph, tag='') = new ComputationNode [ operation = 'LatticeFreeMMI' ; inputs = (labels : logLikelihoods) /*plus the function args*/ ]\n"
     L"MaxPooling(input, windowWidth, windowHeight, horizontalSubsample, verticalSubsample, imageLayout='CHW', tag='') = new ComputationNode [ operation = 'MaxPooling' ; inputs = input /*plus the function args*/ ]\n"
     L"AveragePooling(input, windowWidth, windowHeight, horizontalSubsample, verticalSubsample, imageLayout='CHW', tag='') = new ComputationNode [ operation = 'AveragePooling' ; inputs = input /*plus the function args*/ ]\n"
     // TODO: define DelayedValue, with negative delay for future; cannot do this yet, need to be able to say something like delay = -(^.delay)
@@ -72,9 +78,7 @@ wstring computationNodes = // TODO: use actual TypeName() here? would first need
 #define BinaryStandardNode(Op, a, b) L## #Op L"(" L## #a L", " L## #b L", tag='') = new ComputationNode [ operation = '" L## #Op L"' ; inputs = (" L## #a L" : " L## #b L") /*plus the function args*/ ]\n"
 #define TernaryStandardNode(Op, a, b, c) L## #Op L"(" L## #a L", " L## #b L", " L## #c L", tag='') = new ComputationNode [ operation = '" L## #Op L"' ; inputs = (" L## #a L" : " L## #b L" : " L## #c L") /*plus the function args*/ ]\n"
 #define QuaternaryStandardNode(Op, a, b, c, d) L## #Op L"(" L## #a L", " L## #b L", " L## #c L", " L## #d L", tag='') = new ComputationNode [ operation = '" L## #Op L"' ; inputs = (" L## #a L" : " L## #b L" : " L## #c L" : " L## #d L") /*plus the function args*/ ]\n"
-#ifdef COMING_SOON
     TernaryStandardNode(CRF, labelVectorSequence, positionDependenScoreVectorSequence, transitionScores) // TODO: better names
-#endif
     QuaternaryStandardNode(ClassBasedCrossEntropyWithSoftmax, labelClassDescriptorVectorSequence, mainInputInfo, mainWeight, classLogProbsBeforeSoftmax)
     // BUGBUG: the commented-out ones are not mentioned in the CNTK book, nor are their parameters documented in the source code
     BinaryStandardNode(ColumnElementTimes, aVectorSequence, anotherVectorSequence)
@@ -93,7 +97,7 @@ wstring computationNodes = // TODO: use actual TypeName() here? would first need
     QuaternaryStandardNode(GMMLogLikelihood, unnormalizedPriorVector, meansAsRows, logStdDevAsRows, dataVectorSequence)
     UnaryStandardNode(InvStdDev, dataVectorSequence)
     BinaryStandardNode(KhatriRaoProduct, leftMatrix, rightMatrix)
-    //BinaryStandardNode(LSTMNode)
+    QuaternaryStandardNode(LSTM, inputWeights, recurrentWeights, bias, input)
     UnaryStandardNode(Log, x)
     UnaryStandardNode(LogSoftmax, z)
     //BinaryStandardNode(LookupTableNode)
@@ -111,9 +115,7 @@ wstring computationNodes = // TODO: use actual TypeName() here? would first need
     UnaryStandardNode(RectifiedLinear, z)
     //BinaryStandardNode(RowElementTimesNode)
     BinaryStandardNode(Scale, scalarScalingFactor, matrix)
-#ifdef COMING_SOON
-    //BinaryStandardNode(SequenceDecoderNode)
-#endif
+    L"SequenceDecoder(labelVectorSequence, positionDependenScoreVectorSequence, transitionScores, tag='') = new ComputationNode [ operation = 'SequenceDecoderNode' ; inputs = (labelVectorSequence : positionDependenScoreVectorSequence : transitionScores) /*plus the function args*/ ]\n"
     UnaryStandardNode(Sigmoid, z)
     UnaryStandardNode(Softmax, z)
     UnaryStandardNode(Hardmax, z)
@@ -124,8 +126,6 @@ wstring computationNodes = // TODO: use actual TypeName() here? would first need
     UnaryStandardNode(Tanh, z)
     UnaryStandardNode(TimeReverse, vectorSequence)
     BinaryStandardNode(Times, leftMatrix, rightMatrix)
-#ifdef COMING_SOON
     UnaryStandardNode(Transpose, matrix)
-#endif
     BinaryStandardNode(TransposeTimes, leftMatrix, rightMatrix)
     ;
@@ -20,6 +20,7 @@
 #include "ModelEditLanguage.h"
 #include "CPUMatrix.h" // used for SetNumThreads()
 #include "CommonMatrix.h"
+#include "HugePageMemAllocator.h"
 #include "SGD.h"
 #include "MPIWrapper.h"
 #include "Config.h"
@@ -60,6 +61,15 @@ Microsoft::MSR::CNTK::MPIWrapper* g_mpi = nullptr;
 // node output value matrices. This will go away when the
 // sharing is ready to be enabled by default
 bool g_shareNodeValueMatrices = false;
+bool g_fuseElementWiseOps = false;
+bool g_fuseConvolutions = false;
+bool g_fusePoolingActivations = false;
+bool g_maxPoolingIndices = false;
+bool g_zeroCopyViews = false;
+bool g_wavefrontLoops = false;
+bool g_concurrentLoops = false;
+bool g_persistentRecurrence = false;
+size_t g_numComputeStreams = 1;
 
 using namespace std;
 using namespace Microsoft::MSR;
@@ -152,7 +162,7 @@ void DoCommands(const ConfigParameters& config)
     ConfigArray command = config(L"command", "train");
 
     int numCPUThreads = config(L"numCPUThreads", "0");
-    numCPUThreads = CPUMatrix<ElemType>::SetNumThreads(numCPUThreads);
+    numCPUThreads = CPUMatrix<ElemType>::SetNumThreads(numCPUThreads, config(L"pinCPUThreads", false));
 
     if (numCPUThreads > 0)
     {
@@ -237,6 +247,10 @@ void DoCommands(const ConfigParameters& config)
             {
                 DoWriteOutput<ElemType>(commandParams);
             }
+            else if (action[j] == "beamSearch")
+            {
+                DoBeamSearch<ElemType>(commandParams);
+            }
             else if (action[j] == "devtest")
             {
                 TestCn<ElemType>(config); // for "devtest" action pass the root config instead
@@ -253,6 +267,18 @@ void DoCommands(const ConfigParameters& config)
             {
                 DoCreateLabelMap<ElemType>(commandParams);
             }
+            else if (action[j] == "convertCorpus")
+            {
+                DoConvertCorpus<ElemType>(commandParams);
+            }
+            else if (action[j] == "packImages")
+            {
+                DoPackImages<ElemType>(commandParams);
+            }
+            else if (action[j] == "compressFeatures")
+            {
+                DoCompressFeatures<ElemType>(commandParams);
+            }
             else if (action[j] == "writeWordAndClass")
             {
                 DoWriteWordAndClassInfo<ElemType>(commandParams);
@@ -261,6 +287,14 @@ void DoCommands(const ConfigParameters& config)
             {
                 DoTopologyPlot<ElemType>(commandParams);
             }
+            else if (action[j] == "benchmarkAggregation")
+            {
+                DoBenchmarkAggregation<ElemType>(commandParams);
+            }
+            else if (action[j] == "planMemory")
+            {
+                DoPlanMemory<ElemType>(commandParams);
+            }
             else if (action[j] == "SVD")
             {
                 DoParameterSVD<ElemType>(commandParams);
@@ -357,6 +391,24 @@ static wstring PathToBSStringLiteral(const wstring& path) // quote a pathname fo
         return L'"' + path + L'"';
 }
 
+// hugePages=none|2MB|1GB: back CPU matrices and reader buffers of at least hugePageThresholdMB with huge pages
+template <class ConfigRecordType>
+static void ConfigureHugePages(const ConfigRecordType& config)
+{
+    wstring hugePages = config(L"hugePages", L"none");
+    size_t pageSize;
+    if (!_wcsicmp(hugePages.c_str(), L"none"))
+        pageSize = 0;
+    else if (!_wcsicmp(hugePages.c_str(), L"2MB"))
+        pageSize = HugePageMemAllocator::pageSize2MB;
+    else if (!_wcsicmp(hugePages.c_str(), L"1GB"))
+        pageSize = HugePageMemAllocator::pageSize1GB;
+    else
+        InvalidArgument("hugePages must be 'none', '2MB' or '1GB', not '%ls'.", hugePages.c_str());
+    size_t thresholdMB = config(L"hugePageThresholdMB", (size_t) 4);
+    HugePageMemAllocator::Configure(pageSize, thresholdMB << 20);
+}
+
 // TODO: decide where these should go. Also, do we need three variables?
 extern wstring standardFunctions;
 extern wstring commonMacros;
@@ -430,8 +482,20 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         g_mpi = new MPIWrapper();
 
     g_shareNodeValueMatrices = config(L"shareNodeValueMatrices", false);
+    g_fuseElementWiseOps = config(L"fuseElementWiseOps", false);
+    g_fuseConvolutions = config(L"fuseConvolutions", false);
+    g_fusePoolingActivations = config(L"fusePoolingActivations", false);
+    g_maxPoolingIndices = config(L"maxPoolingIndices", false);
+    g_zeroCopyViews = config(L"zeroCopyViews", false);
+    g_wavefrontLoops = config(L"wavefrontLoops", false);
+    g_concurrentLoops = config(L"concurrentLoops", false);
+    g_persistentRecurrence = config(L"persistentRecurrence", false);
+    g_numComputeStreams = config(L"numComputeStreams", (size_t) 1);
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    TracingGPUMemoryAllocator::SetCachingEnabled(config(L"cacheGPUMemoryAllocations", true));
+    GPUKernelTuning::SetEnabled(config(L"autotuneGPUKernels", false), config(L"traceGPUKernelTuning", 0));
+    ConfigureHugePages(config);
 
     // logging
     wstring logpath = config(L"stderr", L"");
@@ -453,7 +517,7 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
     // execute the actions
     // std::string type = config(L"precision", "float");
     int numCPUThreads = config(L"numCPUThreads", 0);
-    numCPUThreads = CPUMatrix<float /*any will do*/>::SetNumThreads(numCPUThreads);
+    numCPUThreads = CPUMatrix<float /*any will do*/>::SetNumThreads(numCPUThreads, config(L"pinCPUThreads", false));
     if (numCPUThreads > 0)
         fprintf(stderr, "Using %d CPU threads.\n", numCPUThreads);
 
@@ -519,8 +583,20 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[]) // called from wmain which is
     }
 
     g_shareNodeValueMatrices = config(L"shareNodeValueMatrices", false);
+    g_fuseElementWiseOps = config(L"fuseElementWiseOps", false);
+    g_fuseConvolutions = config(L"fuseConvolutions", false);
+    g_fusePoolingActivations = config(L"fusePoolingActivations", false);
+    g_maxPoolingIndices = config(L"maxPoolingIndices", false);
+    g_zeroCopyViews = config(L"zeroCopyViews", false);
+    g_wavefrontLoops = config(L"wavefrontLoops", false);
+    g_concurrentLoops = config(L"concurrentLoops", false);
+    g_persistentRecurrence = config(L"persistentRecurrence", false);
+    g_numComputeStreams = config(L"numComputeStreams", (size_t) 1);
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    TracingGPUMemoryAllocator::SetCachingEnabled(config(L"cacheGPUMemoryAllocations", true));
+    GPUKernelTuning::SetEnabled(config(L"autotuneGPUKernels", false), config(L"traceGPUKernelTuning", 0));
+    ConfigureHugePages(config);
 
     if (logpath != L"")
     {
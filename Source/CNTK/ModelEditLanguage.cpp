@@ -198,7 +198,7 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
 
         // validate the network before we save it out
         ProcessNDLScript(m_netNdlDefault, ndlPassAll, true);
-        cn->SaveEdited(fileName);
+        cn->SaveEdited(fileName, GetSaveFileOptions(modelFormat));
     }
     else if (EqualInsensitive(name, "SaveModel"))
     {
@@ -217,7 +217,7 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
 
         // validate and finish the second pass through NDL if any in-line NDL was defined
         ProcessNDLScript(netNdl, ndlPassAll, true);
-        netNdl->cn->SaveEdited(fileName);
+        netNdl->cn->SaveEdited(fileName, GetSaveFileOptions(modelFormat));
     }
     else if (EqualInsensitive(name, "SetDefaultModel"))
     {
@@ -635,6 +635,31 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
             netNdlFrom->cn->RenameNode(node, nodeName.second);
         }
     }
+    else if (EqualInsensitive(name, "OptimizeForInference"))
+    {
+        size_t numFixedParams = 1, numOptionalParams = 1;
+        if (params.size() > numFixedParams + numOptionalParams || params.size() < numFixedParams)
+            RuntimeError("Invalid number of parameters. Valid parameters: OptimizeForInference(modelName, [fuseAffine=true|false])");
+
+        std::string modelName = params[0];
+        bool fuseAffine = true;
+        if (params.size() > numFixedParams)
+        {
+            std::string propName, value;
+            if (OptionalParameter(params[numFixedParams], propName, value) && EqualInsensitive(propName, "fuseAffine"))
+                fuseAffine = ConfigValue(value);
+            else
+                RuntimeError("Invalid optional parameter %s, valid optional parameter is fuseAffine=true|false", params[numFixedParams].c_str());
+        }
+
+        NetNdl<ElemType>* netNdl = &m_mapNameToNetNdl[modelName];
+        if (netNdl->cn == NULL)
+            RuntimeError("OptimizeForInference can only be called after a network has been setup, no active model named %s.", modelName.c_str());
+
+        // validate and finish the second pass through NDL if any in-line NDL was defined
+        ProcessNDLScript(netNdl, ndlPassAll, true);
+        netNdl->cn->template OptimizeForInference<ElemType>(fuseAffine);
+    }
     else if (EqualInsensitive(name, "ReviseParameter"))
     {
         typedef LearnableParameter<ElemType> LearnableParameterNode;
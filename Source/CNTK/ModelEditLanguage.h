@@ -437,6 +437,18 @@ public:
 
         return includeData;
     }
+    static FileOptions GetSaveFileOptions(const wstring& modelFormat)
+    {
+        if (modelFormat == L"cntk_aligned")
+            return (FileOptions)(fileOptionsBinary | fileOptionsAlignedBlocks);
+        else if (modelFormat == L"cntk_fp16")
+            return (FileOptions)(fileOptionsBinary | fileOptionsCompactFP16);
+        else if (modelFormat == L"cntk_int8")
+            return (FileOptions)(fileOptionsBinary | fileOptionsCompactInt8);
+        else
+            return fileOptionsBinary;
+    }
+
     wstring GetOptionalModelFormat(const ConfigParamList& params, const size_t numFixedParams)
     {
         wstring modelFormat = L"cntk"; // default
@@ -456,9 +468,21 @@ public:
                     {
                         modelFormat = L"cntk_legacy_no_tensorlib";
                     }
+                    else if (EqualInsensitive(value, "cntk_aligned")) // parameters stored as aligned blocks, which evaluation can map in place
+                    {
+                        modelFormat = L"cntk_aligned";
+                    }
+                    else if (EqualInsensitive(value, "cntk_fp16")) // large parameters stored as FP16, for deployment
+                    {
+                        modelFormat = L"cntk_fp16";
+                    }
+                    else if (EqualInsensitive(value, "cntk_int8")) // large parameters quantized to 8 bits per column, for deployment
+                    {
+                        modelFormat = L"cntk_int8";
+                    }
                     else
                     {
-                        RuntimeError("Invalid optional parameter value %s, valid values are: format=(cntk)", value.c_str());
+                        RuntimeError("Invalid optional parameter value %s, valid values are: format=(cntk|cntk_aligned|cntk_fp16|cntk_int8)", value.c_str());
                     }
                 }
                 else
@@ -155,9 +155,7 @@ bool CheckFunction(std::string& p_nodeType, bool* allowUndeterminedVariable)
     bool ret = false;
     if (EqualInsensitive(nodeType, OperationNameOf(AveragePoolingNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(BatchNormalizationNode))) ret = true;
-#ifdef COMING_SOON
     else if (EqualInsensitive(nodeType, OperationNameOf(CRFNode), L"CRF")) ret = true;
-#endif
     else if (EqualInsensitive(nodeType, OperationNameOf(ClassBasedCrossEntropyWithSoftmaxNode), L"CBCEWithSM")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(ConvolutionNode), L"Convolve")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(CosDistanceNode), L"CosDist")) ret = true;
@@ -177,14 +175,17 @@ bool CheckFunction(std::string& p_nodeType, bool* allowUndeterminedVariable)
     else if (EqualInsensitive(nodeType, OperationNameOf(GMMLogLikelihoodNode), L"GMMLL")) ret = true;
 #endif
     else if (EqualInsensitive(nodeType, OperationNameOf(HardmaxNode))) ret = true;
+    else if (EqualInsensitive(nodeType, OperationNameOf(HierarchicalSoftmaxNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(InputValue), L"Input")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(InvStdDevNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(KhatriRaoProductNode), L"ColumnwiseCrossProduct")) ret = true;
+    else if (EqualInsensitive(nodeType, OperationNameOf(LatticeFreeMMINode), L"LFMMI")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(LearnableParameter), L"Parameter")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(LogNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(LogSoftmaxNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(LogisticNode), L"Logistic")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(LookupTableNode))) ret = true;
+    else if (EqualInsensitive(nodeType, OperationNameOf(LSTMNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(MatrixL1RegNode), L"L1Reg")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(MatrixL2RegNode), L"L2Reg")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(MaxPoolingNode))) ret = true;
@@ -198,11 +199,12 @@ bool CheckFunction(std::string& p_nodeType, bool* allowUndeterminedVariable)
     else if (EqualInsensitive(nodeType, OperationNameOf(RectifiedLinearNode), L"ReLU")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(ReshapeNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(RowRepeatNode))) ret = true;
+    else if (EqualInsensitive(nodeType, OperationNameOf(SpliceNeighborsNode))) ret = true;
+    else if (EqualInsensitive(nodeType, OperationNameOf(TimeDelayNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(RowSliceNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(RowStackNode))) ret = true;
-#ifdef COMING_SOON
-    else if (EqualInsensitive(nodeType, OperationNameOf(SequenceDecoderNode), L"SEWithSM")) ret = true;
-#endif
+    else if (EqualInsensitive(nodeType, OperationNameOf(SequenceDecoderNode), L"SequenceDecoder")) ret = true;
+    else if (EqualInsensitive(nodeType, OperationNameOf(SampledSoftmaxNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(SequenceWithSoftmaxNode), L"SEWithSM")) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(SigmoidNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(SoftmaxNode))) ret = true;
@@ -211,10 +213,9 @@ bool CheckFunction(std::string& p_nodeType, bool* allowUndeterminedVariable)
     else if (EqualInsensitive(nodeType, OperationNameOf(SumColumnElementsNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(SumElementsNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(TanhNode))) ret = true;
+    else if (EqualInsensitive(nodeType, OperationNameOf(TensorContractionNode))) ret = true;
     else if (EqualInsensitive(nodeType, OperationNameOf(TimesNode))) ret = true;
-#ifdef COMING_SOON
     else if (EqualInsensitive(nodeType, OperationNameOf(TransposeNode))) ret = true;
-#endif
     else if (EqualInsensitive(nodeType, OperationNameOf(TransposeTimesNode))) ret = true;
     else if (EqualInsensitive(nodeType, L"ColumnElementTimes")) ret = true;
     else if (EqualInsensitive(nodeType, L"Constant", L"Const")) ret = true;
@@ -53,11 +53,9 @@ ComputationNetworkPtr SimpleNetworkBuilder<ElemType>::BuildNetworkFromDescriptio
     case ConditionalLSTMNetworkKind:
         net = BuildConditionalLSTMNetworkFromDescription();
         break;
-#ifdef COMING_SOON
     case CRFLSTMNetworkKind:
         net = BuildCRFLSTMNetworkFromDescription();
         break;
-#endif
     default:
         LogicError("BuildNetworkFromDescription: invalid m_standardNetworkKind %d", (int) m_standardNetworkKind);
     }
@@ -949,8 +947,6 @@ shared_ptr<ComputationNode<ElemType>> /*ComputationNodePtr*/ SimpleNetworkBuilde
     return output;
 }
 
-#ifdef COMING_SOON
-
 template <class ElemType>
 ComputationNetworkPtr SimpleNetworkBuilder<ElemType>::BuildCRFLSTMNetworkFromDescription()
 {
@@ -1050,8 +1046,6 @@ ComputationNetworkPtr SimpleNetworkBuilder<ElemType>::BuildCRFLSTMNetworkFromDes
     return m_net;
 }
 
-#endif
-
 template <class ElemType>
 ComputationNetworkPtr SimpleNetworkBuilder<ElemType>::BuildClassLSTMNetworkFromDescription()
 {
@@ -1686,12 +1680,10 @@ shared_ptr<ComputationNode<ElemType>> SimpleNetworkBuilder<ElemType>::AddTrainAn
             tinput = builder.Times(matrix, input);
         output = builder.Logistic(label, tinput, (trainNodeName == L"") ? L"Logistic" : trainNodeName);
         break;
-#ifdef COMING_SOON
     case TrainingCriterion::CRF:
         assert(trans != nullptr);
         output = builder.CRF(label, input, trans, (trainNodeName == L"") ? L"CRF" : trainNodeName);
         break;
-#endif
     case TrainingCriterion::ClassCrossEntropyWithSoftmax:
         output = builder.ClassCrossEntropyWithSoftmax(label, input, matrix, clspostprob, (trainNodeName == L"") ? L"ClassCrossEntropyWithSoftmax" : trainNodeName);
         break;
@@ -1743,14 +1735,12 @@ shared_ptr<ComputationNode<ElemType>> SimpleNetworkBuilder<ElemType>::AddTrainAn
                 tinput = builder.Times(matrix, input);
             output = builder.ErrorPrediction(label, tinput, (evalNodeName == L"") ? L"EvalErrorPrediction" : evalNodeName);
             break;
-#ifdef COMING_SOON
         case EvalCriterion::CRF:
             assert(trans != nullptr);
             if (matrix != nullptr && tinput == input)
                 tinput = builder.Times(matrix, input);
             output = builder.CRF(label, tinput, trans, (evalNodeName == L"") ? L"EvalCRF" : evalNodeName);
             break;
-#endif
         default:
             LogicError("Unsupported training criterion.");
         }
@@ -250,9 +250,7 @@ protected:
     ComputationNetworkPtr BuildLogBilinearNetworkFromDescription();
     ComputationNetworkPtr BuildDNNLMNetworkFromDescription();
     ComputationNetworkPtr BuildLSTMNetworkFromDescription();
-#ifdef COMING_SOON
     ComputationNetworkPtr BuildCRFLSTMNetworkFromDescription();
-#endif
     ComputationNetworkPtr BuildClassLSTMNetworkFromDescription();
     ComputationNetworkPtr BuildConditionalLSTMNetworkFromDescription();
     ComputationNetworkPtr BuildNCELSTMNetworkFromDescription();
@@ -14,6 +14,7 @@
 #include "ConvolutionalNodes.h"
 #include "NonlinearityNodes.h"
 #include "ReshapingNodes.h"
+#include "SpecialPurposeNodes.h"
 #include "TensorShape.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -220,6 +221,24 @@ void SynchronousNodeEvaluator<ElemType>::Evaluate(NDLNode<ElemType>* node, const
             nodePtr->SetParameterUpdateRequired(needGradient);
         }
     }
+    else if (cnNodeType == OperationNameOf(SpliceNeighborsNode))
+    {
+        if (parameter.size() != 3)
+            RuntimeError("SpliceNeighbors should have three parameters. Usage: SpliceNeighbors(origNodeName, leftContext, rightContext).");
+
+        nodeParamCount = 1;
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            // evaluate only scalar parameters
+            vector<void*> params = EvaluateParameters(node, baseName, 0, parameter.size(), pass);
+            size_t leftContext = ((NDLNode<ElemType>*) params[1])->GetScalar();
+            size_t rightContext = ((NDLNode<ElemType>*) params[2])->GetScalar();
+
+            nodePtr = builder.SpliceNeighbors(NULL, leftContext, rightContext, name);
+        }
+    }
     else if (cnNodeType == OperationNameOf(DiagonalNode))
     {
         if (parameter.size() != 1)
@@ -326,6 +345,95 @@ void SynchronousNodeEvaluator<ElemType>::Evaluate(NDLNode<ElemType>* node, const
                                           horizontalSubsample, verticalSubsample, imageLayoutKind, zeroPadding, maxTempMemSizeInSamples, name);
         }
     }
+    else if (cnNodeType == OperationNameOf(TimeDelayNode))
+    {
+        if (parameter.size() != 3)
+            RuntimeError("%ls should have 3 fixed parameters [weightNodeName, inputValueNodeName, kernelWidth] and two optional parameters [dilation = [1|yourvalue], subsample = [1|yourvalue]].", cnNodeType.c_str());
+
+        // setup the parameter position of children so we can hook them up later
+        nodeParamCount = 2;
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            // evaluate only scalar parameters
+            vector<void*> params = EvaluateParameters(node, baseName, 2, parameter.size() - 2, pass);
+            size_t kernelWidth = ((NDLNode<ElemType>*) params[0])->GetScalar();
+
+            // optional
+            size_t dilation = node->GetOptionalParameter("dilation", "1");
+            size_t subsample = node->GetOptionalParameter("subsample", "1");
+
+            nodePtr = builder.TimeDelay(NULL, NULL, kernelWidth, dilation, subsample, name);
+        }
+    }
+    else if (cnNodeType == OperationNameOf(SampledSoftmaxNode))
+    {
+        if (parameter.size() != 5)
+            RuntimeError("%ls should have 5 fixed parameters [labels, hidden, weights, bias, numSamples] and two optional parameters [samplingDistribution = \"logUniform\"|\"unigram\", unigramFile = \"\"].", cnNodeType.c_str());
+
+        // setup the parameter position of children so we can hook them up later
+        nodeParamCount = 4;
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            // evaluate only scalar parameters
+            vector<void*> params = EvaluateParameters(node, baseName, 4, parameter.size() - 4, pass);
+            size_t numSamples = ((NDLNode<ElemType>*) params[0])->GetScalar();
+
+            // optional
+            wstring samplingDistribution = node->GetOptionalParameter("samplingDistribution", "logUniform");
+            wstring unigramFile = node->GetOptionalParameter("unigramFile", "");
+
+            nodePtr = builder.SampledSoftmax(NULL, NULL, NULL, NULL, numSamples, samplingDistribution, unigramFile, name);
+        }
+    }
+    else if (cnNodeType == OperationNameOf(HierarchicalSoftmaxNode))
+    {
+        if (parameter.size() != 3)
+            RuntimeError("%ls should have 3 fixed parameters [labels, hidden, weights] and the parameter [wordCountsFile = \"\"].", cnNodeType.c_str());
+
+        // setup the parameter position of children so we can hook them up later
+        nodeParamCount = 3;
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            wstring wordCountsFile = node->GetOptionalParameter("wordCountsFile", "");
+            nodePtr = builder.HierarchicalSoftmax(NULL, NULL, NULL, wordCountsFile, name);
+        }
+    }
+    else if (cnNodeType == OperationNameOf(TensorContractionNode))
+    {
+        if (parameter.size() != 2)
+            RuntimeError("%ls should have 2 fixed parameters [A, B] and the parameter [spec = \"ik,kj->ij\"|yourvalue].", cnNodeType.c_str());
+
+        // setup the parameter position of children so we can hook them up later
+        nodeParamCount = 2;
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            wstring spec = node->GetOptionalParameter("spec", "ik,kj->ij");
+            nodePtr = builder.TensorContraction(NULL, NULL, spec, name);
+        }
+    }
+    else if (cnNodeType == OperationNameOf(LatticeFreeMMINode))
+    {
+        if (parameter.size() != 2)
+            RuntimeError("%ls should have 2 fixed parameters [labels, logLikelihoods] and the parameter [denominatorGraph = \"den.fst.txt\"].", cnNodeType.c_str());
+
+        // setup the parameter position of children so we can hook them up later
+        nodeParamCount = 2;
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            wstring denominatorGraph = node->GetOptionalParameter("denominatorGraph", "");
+            nodePtr = builder.LatticeFreeMMI(NULL, NULL, denominatorGraph, name);
+        }
+    }
     else if (cnNodeType == OperationNameOf(MaxPoolingNode))
     {
         if (parameter.size() != 5)
@@ -45,8 +45,15 @@ int bestGPUDummy = 42; // put something into this CPP, as to avoid a linker warn
 #include <stdio.h>
 #include <string.h>
 #include <algorithm>
+#ifndef _WIN32
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
 
 #include <memory>
+#include <string>
+#include <map>
 #include "CrossProcessMutex.h"
 
 // ---------------------------------------------------------------------------
@@ -65,7 +72,8 @@ struct ProcessorData
     size_t cudaTotalMem;
     bool dbnFound;
     bool cnFound;
-    int deviceId; // the deviceId (cuda side) for this processor
+    int deviceId;            // the deviceId (cuda side) for this processor
+    nvmlDevice_t nvmlDevice; // NVML's handle of it; null if NVML is not available
 };
 
 enum BestGpuFlags
@@ -96,6 +104,7 @@ private:
     void GetCudaProperties();
     void GetNvmlData();
     void QueryNvmlData();
+    int TopologyDistance(int deviceA, int deviceB) const;
 
 public:
     BestGpu()
@@ -117,6 +126,9 @@ public:
     static const int AllDevices = -1;                                                         // can be used to specify all GPUs in GetDevices() call
     static const int RequeryDevices = -2;                                                     // Requery refreshing statistics and picking the same number as last query
     std::vector<int> GetDevices(int number = AllDevices, BestGpuFlags flags = bestGpuNormal); // get multiple devices
+    // bind the calling thread (and threads it creates later, such as the reader's) to the CPUs local to the device
+    void BindThreadToDeviceCpus(int deviceId) const;
+
 private:
     bool LockDevice(int deviceId, bool trial = true);
 };
@@ -148,6 +160,7 @@ static DEVICEID_TYPE SelectDevice(DEVICEID_TYPE deviceId, bool bLockGPU)
             deviceId = (DEVICEID_TYPE)
                            g_bestGpu->GetDevice(BestGpuFlags(bLockGPU ? (bestGpuAvoidSharing | bestGpuExclusiveLock) : bestGpuAvoidSharing));
             bestDeviceId = deviceId;
+            g_bestGpu->BindThreadToDeviceCpus(deviceId);
         }
         else // already chosen
             deviceId = bestDeviceId;
@@ -196,6 +209,95 @@ DEVICEID_TYPE DeviceFromConfig(const ConfigParameters& config)
         return SelectDevice((int) val, bLockGPU);
 }
 
+// ---------------------------------------------------------------------------
+// host-level placement registry
+//
+// Every process that selects GPUs through BestGpu records its choice in a file in the temp directory, under the
+// querying lock. Later selections on the same host thereby know how many processes use each GPU, and which of them
+// are ranks of their own job (identified through the launcher's environment), so that GPUs are spread over jobs while
+// the ranks of one job stay on nearby GPUs. Entries of processes that have exited are dropped.
+// ---------------------------------------------------------------------------
+
+struct GpuPlacement
+{
+    int deviceId;
+    int pid;
+    std::string jobKey;
+};
+
+static std::string PlacementFilePath()
+{
+    for (const char* var : {"TMPDIR", "TEMP", "TMP"})
+    {
+        const char* dir = getenv(var);
+        if (dir != nullptr && *dir != 0)
+            return std::string(dir) + "/cntk_gpu_placement.txt";
+    }
+    return "/tmp/cntk_gpu_placement.txt";
+}
+
+static bool IsProcessAlive(int pid)
+{
+#ifdef _WIN32
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD) pid);
+    if (process == NULL)
+        return false;
+    bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return alive;
+#else
+    return kill((pid_t) pid, 0) == 0 || errno == EPERM;
+#endif
+}
+
+// identifies the job this process belongs to; processes of other jobs get keys that match no one else's
+// Under MPI, ranks on one host are siblings (children of the launcher's daemon) if the job id is not in the environment.
+static std::string GetJobKey()
+{
+    for (const char* var : {"CNTK_JOB_ID", "OMPI_MCA_ess_base_jobid", "PMI_JOBID", "SLURM_JOB_ID", "PBS_JOBID", "LSB_JOBID"})
+    {
+        const char* id = getenv(var);
+        if (id != nullptr && *id != 0)
+            return std::string(var) + "=" + id;
+    }
+#ifndef _WIN32
+    if (getenv("OMPI_COMM_WORLD_SIZE") || getenv("PMI_SIZE") || getenv("MV2_COMM_WORLD_SIZE"))
+        return "ppid=" + std::to_string((int) getppid());
+#endif
+    return "pid=" + std::to_string((int) GetCurrentProcessId());
+}
+
+// the placements of the live processes other than this one
+static std::vector<GpuPlacement> ReadPlacements()
+{
+    std::vector<GpuPlacement> placements;
+    FILE* f = fopen(PlacementFilePath().c_str(), "r");
+    if (f == nullptr)
+        return placements; // (no one has registered yet)
+    int deviceId, pid;
+    char jobKey[1024];
+    while (fscanf(f, "%d %d %1023s", &deviceId, &pid, jobKey) == 3)
+    {
+        if (pid != (int) GetCurrentProcessId() && IsProcessAlive(pid))
+            placements.push_back(GpuPlacement{deviceId, pid, jobKey});
+    }
+    fclose(f);
+    return placements;
+}
+
+static void WritePlacements(const std::vector<GpuPlacement>& placements)
+{
+    FILE* f = fopen(PlacementFilePath().c_str(), "w");
+    if (f == nullptr) // (placement then only relies on the exclusive locks and usage statistics)
+    {
+        fprintf(stderr, "BestGpu: Cannot write the placement registry %s.\n", PlacementFilePath().c_str());
+        return;
+    }
+    for (const auto& placement : placements)
+        fprintf(f, "%d %d %s\n", placement.deviceId, placement.pid, placement.jobKey.c_str());
+    fclose(f);
+}
+
 // !!!!This is from helper_cuda.h which comes with CUDA samples!!!! Consider if it is beneficial to just include all helper_cuda.h
 // TODO: This is duplicated in GPUMatrix.cu
 // Beginning of GPU Architecture definitions
@@ -324,6 +426,48 @@ int BestGpu::GetDevice(BestGpuFlags bestFlags)
     return best[0];
 }
 
+// TopologyDistance - how far apart two GPUs are
+// returns: 0 for the same device, 1 for an NVLink connection or a board with two GPUs, then 2 (single PCIe switch)
+// up to 6 (different CPU sockets), following NVML's topology levels; 6 if unknown
+int BestGpu::TopologyDistance(int deviceA, int deviceB) const
+{
+    if (deviceA == deviceB)
+        return 0;
+    const int maxDistance = 6;
+    if (deviceA < 0 || deviceB < 0 || deviceA >= (int) m_procData.size() || deviceB >= (int) m_procData.size())
+        return maxDistance;
+    nvmlDevice_t a = m_procData[deviceA]->nvmlDevice;
+    nvmlDevice_t b = m_procData[deviceB]->nvmlDevice;
+    if (a == nullptr || b == nullptr)
+        return maxDistance;
+#ifdef NVML_NVLINK_MAX_LINKS
+    for (unsigned int link = 0; link < NVML_NVLINK_MAX_LINKS; link++)
+    {
+        nvmlEnableState_t isActive;
+        nvmlPciInfo_t remote;
+        if (nvmlDeviceGetNvLinkState(a, link, &isActive) == NVML_SUCCESS && isActive == NVML_FEATURE_ENABLED &&
+            nvmlDeviceGetNvLinkRemotePciInfo(a, link, &remote) == NVML_SUCCESS && (int) remote.bus == m_procData[deviceB]->deviceProp.pciBusID)
+            return 1;
+    }
+#endif
+#if NVML_API_VERSION >= 7
+    nvmlGpuTopologyLevel_t level;
+    if (nvmlDeviceGetTopologyCommonAncestor(a, b, &level) == NVML_SUCCESS)
+        return std::min(1 + (int) level / 10, maxDistance); // NVML_TOPOLOGY_INTERNAL = 0, SINGLE = 10, ..., SYSTEM = 50
+#endif
+    return maxDistance;
+}
+
+// BindThreadToDeviceCpus - restrict the calling thread to the CPUs that are local to the device
+// Threads created afterwards inherit this (on Linux; elsewhere NVML does not support it, and this does nothing).
+void BestGpu::BindThreadToDeviceCpus(int deviceId) const
+{
+    if (deviceId < 0 || deviceId >= (int) m_procData.size() || m_procData[deviceId]->nvmlDevice == nullptr)
+        return;
+    if (nvmlDeviceSetCpuAffinity(m_procData[deviceId]->nvmlDevice) == NVML_SUCCESS)
+        fprintf(stderr, "BestGpu: Bound the process's threads to the CPUs local to GPU %d.\n", deviceId);
+}
+
 // SetAllowedDevices - set the allowed devices array up
 // devices - vector of allowed devices
 void BestGpu::SetAllowedDevices(const std::vector<int>& devices)
@@ -414,6 +558,7 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
         speedW *= 2;
     }
 
+    std::map<int, double> scoreOf; // [deviceId] score of the allowed devices, before taking other processes into account
     for (ProcessorData* pd : m_procData)
     {
         double score = 0.0;
@@ -431,10 +576,44 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
             mem = pd->cudaFreeMem / (double) pd->cudaTotalMem;
         score += mem * freeMemW;
         score += ((pd->cnFound || pd->dbnFound) ? 0 : 1) * mlAppRunningW;
+        scoreOf[pd->deviceId] = score;
+    }
+
+    // this code allows only one process to run concurrently on a machine
+    CrossProcessMutex deviceAllocationLock("DBN.exe GPGPU querying lock");
+
+    if (!deviceAllocationLock.Acquire((bestFlags & bestGpuExclusiveLock) != 0)) // failure  --this should not really happen
+        RuntimeError("DeviceFromConfig: unexpected failure");
+
+    // take the other processes on this host into account: every process already on a GPU counts like a running ML app,
+    // and GPUs far from those of this job's other ranks are penalized, so that the ranks stay close
+    // The utilization statistics alone would let processes that start at the same time all pick the same GPU.
+    std::vector<GpuPlacement> placements = ReadPlacements();
+    const std::string jobKey = GetJobKey();
+    const double colocationW = 0.3;
+    for (auto& entry : scoreOf)
+    {
+        double peerDistance = 0;
+        size_t numPeers = 0;
+        for (const auto& placement : placements)
+        {
+            if (placement.deviceId == entry.first)
+                entry.second -= mlAppRunningW;
+            if (placement.jobKey == jobKey)
+            {
+                peerDistance += TopologyDistance(entry.first, placement.deviceId);
+                numPeers++;
+            }
+        }
+        if (numPeers > 0)
+            entry.second -= colocationW * peerDistance / (6.0 * numPeers);
+    }
+    for (const auto& entry : scoreOf)
+    {
         for (int i = 0; i < best.size(); i++)
         {
             // look for a better score
-            if (score > scores[i])
+            if (entry.second > scores[i])
             {
                 // make room for this score in the correct location (insertion sort)
                 for (int j = (int) best.size() - 1; j > i; --j)
@@ -442,8 +621,8 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
                     scores[j] = scores[j - 1];
                     best[j] = best[j - 1];
                 }
-                scores[i] = score;
-                best[i] = pd->deviceId;
+                scores[i] = entry.second;
+                best[i] = entry.first;
                 break;
             }
         }
@@ -459,12 +638,6 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
             break;
     }
 
-    // this code allows only one process to run concurrently on a machine
-    CrossProcessMutex deviceAllocationLock("DBN.exe GPGPU querying lock");
-
-    if (!deviceAllocationLock.Acquire((bestFlags & bestGpuExclusiveLock) != 0)) // failure  --this should not really happen
-        RuntimeError("DeviceFromConfig: unexpected failure");
-
     {
         // even if user do not want to lock the GPU, we still need to check whether a particular GPU is locked or not,
         // to respect other users' exclusive lock.
@@ -500,6 +673,14 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
         LockDevice(best[z], false);
     }
 
+    // register the choice for the processes that come after us
+    for (int deviceId : best)
+    {
+        if (deviceId >= 0)
+            placements.push_back(GpuPlacement{deviceId, (int) GetCurrentProcessId(), jobKey});
+    }
+    WritePlacements(placements);
+
     return best; // return the array of the best GPUs
 }
 
@@ -543,6 +724,7 @@ void BestGpu::QueryNvmlData()
 
         if (curPd == NULL)
             continue;
+        curPd->nvmlDevice = device;
 
         // Get the memory usage, will only work for TCC drivers
         result = nvmlDeviceGetMemoryInfo(device, &memory);
@@ -163,6 +163,16 @@ void DataReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t e
     }
 }
 
+// SkipMinibatches - continue the epoch after its first numMinibatches minibatches
+// Only with a single reader: with several, some might skip while the others cannot.
+template <class ElemType>
+bool DataReader<ElemType>::SkipMinibatches(size_t numMinibatches)
+{
+    if (m_ioNames.size() != 1)
+        return false;
+    return m_dataReaders[m_ioNames[0]]->SkipMinibatches(numMinibatches);
+}
+
 // GetMinibatch - Get the next minibatch (features and labels)
 // matrices - [in] a map with named matrix types (i.e. 'features', 'labels') mapped to the corresponding matrix,
 //             [out] each matrix resized if necessary containing data.
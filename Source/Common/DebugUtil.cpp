@@ -137,4 +137,56 @@ void DebugUtil::PrintCallStack()
     free(symbolList);
 #endif
 }
+
+size_t DebugUtil::CaptureCallStack(void** frames, size_t maxFrames, size_t skip)
+{
+    void* callStack[MAX_CALLERS];
+    const size_t wanted = std::min(maxFrames + skip + 1, (size_t) MAX_CALLERS);
+#ifdef _WIN32
+    const size_t numFrames = RtlCaptureStackBackTrace(0, (ULONG) wanted, callStack, NULL);
+#else
+    const size_t numFrames = backtrace(callStack, (int) wanted);
+#endif
+    size_t n = 0;
+    for (size_t i = skip + 1; i < numFrames && n < maxFrames; i++)
+        frames[n++] = callStack[i];
+    return n;
+}
+
+std::string DebugUtil::FunctionName(void* address)
+{
+#ifdef _WIN32
+    static const bool symbolsInitialized = SymInitialize(GetCurrentProcess(), NULL, TRUE) != FALSE;
+    if (symbolsInitialized)
+    {
+        char buffer[sizeof(SYMBOL_INFO) + 256];
+        SYMBOL_INFO* symbolInfo = (SYMBOL_INFO*) buffer;
+        memset(symbolInfo, 0, sizeof(SYMBOL_INFO));
+        symbolInfo->MaxNameLen = 255;
+        symbolInfo->SizeOfStruct = sizeof(SYMBOL_INFO);
+        if (SymFromAddr(GetCurrentProcess(), (DWORD64) address, 0, symbolInfo))
+            return symbolInfo->Name;
+    }
+#else
+    char** symbolList = backtrace_symbols(&address, 1);
+    if (symbolList)
+    {
+        // "module(mangled+offset) [address]"
+        std::string symbol = symbolList[0];
+        free(symbolList);
+        const size_t beginName = symbol.find('(');
+        const size_t endName = symbol.find_first_of("+)", beginName);
+        if (beginName != std::string::npos && endName != std::string::npos && endName > beginName + 1)
+        {
+            const std::string mangled = symbol.substr(beginName + 1, endName - beginName - 1);
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(mangled.c_str(), NULL, NULL, &status);
+            std::string name = status == 0 ? demangled : mangled;
+            free(demangled);
+            return name;
+        }
+    }
+#endif
+    return msra::strfun::strprintf("%p", address);
+}
 } } }
@@ -129,6 +129,55 @@ void Eval<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>& in
     m_eval->Evaluate(inputs, outputs);
 }
 
+// EvaluateBatched - thread-safe Evaluate() of one request; concurrent requests are evaluated together in one minibatch
+template <class ElemType>
+void Eval<ElemType>::EvaluateBatched(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+{
+    m_eval->EvaluateBatched(inputs, outputs);
+}
+
+// BindBuffer - bind a caller-owned buffer to an input or output node, for use by EvaluateBound()
+template <class ElemType>
+void Eval<ElemType>::BindBuffer(const std::wstring& nodeName, ElemType* buffer, size_t maxNumSamples)
+{
+    m_eval->BindBuffer(nodeName, buffer, maxNumSamples);
+}
+
+// EvaluateBound - evaluate numSamples samples from the bound input buffers into the bound output buffers
+template <class ElemType>
+void Eval<ElemType>::EvaluateBound(size_t numSamples)
+{
+    m_eval->EvaluateBound(numSamples);
+}
+
+// OpenStream - start a stream whose chunks are evaluated with carried-over recurrent state
+template <class ElemType>
+size_t Eval<ElemType>::OpenStream()
+{
+    return m_eval->OpenStream();
+}
+
+// EvaluateStream - evaluate the next chunk of a stream
+template <class ElemType>
+void Eval<ElemType>::EvaluateStream(size_t streamId, std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+{
+    m_eval->EvaluateStream(streamId, inputs, outputs);
+}
+
+// CloseStream - release the state of a stream
+template <class ElemType>
+void Eval<ElemType>::CloseStream(size_t streamId)
+{
+    m_eval->CloseStream(streamId);
+}
+
+// EvaluateHypotheses - evaluate sequences with shared prefixes, each distinct prefix once
+template <class ElemType>
+void Eval<ElemType>::EvaluateHypotheses(std::vector<std::map<std::wstring, std::vector<ElemType>*>>& inputs, std::vector<std::map<std::wstring, std::vector<ElemType>*>>& outputs)
+{
+    m_eval->EvaluateHypotheses(inputs, outputs);
+}
+
 // ResetState - Reset the cell state when we get the start of an utterance
 template <class ElemType>
 void Eval<ElemType>::ResetState()
@@ -17,9 +17,12 @@
 #ifdef _WIN32
 #define NOMINMAX
 #include "Windows.h"
+#include <io.h>
 #endif
 #ifdef __unix__
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -118,6 +121,79 @@ void File::Init(const wchar_t* filename, int fileOptions)
                     m_file = fopenOrDie(filename, options.c_str());
                     m_seekable = true;
                 });
+
+    if (reading && !writing && m_seekable && (fileOptions & fileOptionsMapped) && (fileOptions & fileOptionsBinary))
+        Map();
+    if (m_seekable && (fileOptions & fileOptionsBinary))
+        SetUpBinaryIO(reading && !writing);
+}
+
+// Binary files (models, reader caches) consist of many small fields around few large arrays. A large stdio buffer
+// turns the small fields into few system calls, while PutArray()/GetArray() move the arrays in large blocks anyway.
+// Files that are only read are also announced as read sequentially, so that the OS reads ahead in the background.
+void File::SetUpBinaryIO(bool reading)
+{
+    static const size_t bufferSize = 4 << 20;
+    m_buffer.reset(new char[bufferSize]);
+    if (setvbuf(m_file, m_buffer.get(), _IOFBF, bufferSize) != 0)
+        m_buffer.reset(); // (stays with the default buffer)
+#ifdef __unix__
+    if (reading)
+        posix_fadvise(fileno(m_file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+    reading;
+#endif
+}
+
+// map the whole file read-only (shared, so that all processes mapping the same file use one copy in the page cache)
+void File::Map()
+{
+    const size_t size = filesize(m_file);
+    if (size == 0)
+        return;
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingW((HANDLE) _get_osfhandle(_fileno(m_file)), nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+        RuntimeError("File: failed to map '%ls' (error %d)", m_filename.c_str(), (int) GetLastError());
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping); // (the view keeps the mapping alive)
+    if (view == nullptr)
+        RuntimeError("File: failed to map '%ls' (error %d)", m_filename.c_str(), (int) GetLastError());
+    m_mapping = std::shared_ptr<const char>((const char*) view, [](const char* p)
+                                            {
+                                                UnmapViewOfFile(p);
+                                            });
+#else
+    void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, fileno(m_file), 0);
+    if (view == MAP_FAILED)
+        RuntimeError("File: failed to map '%ls': %s", m_filename.c_str(), strerror(errno));
+    m_mapping = std::shared_ptr<const char>((const char*) view, [size](const char* p)
+                                            {
+                                                munmap((void*) p, size);
+                                            });
+#endif
+}
+
+void File::PutAlignedBlock(const void* data, size_t size)
+{
+    static const char zeros[alignedBlockAlignment] = {0};
+    const size_t padding = (alignedBlockAlignment - GetPosition() % alignedBlockAlignment) % alignedBlockAlignment;
+    fwriteOrDie(zeros, 1, padding, m_file);
+    fwriteOrDie(data, 1, size, m_file);
+}
+
+const void* File::GetAlignedBlock(size_t size, void* buffer)
+{
+    const uint64_t pos = GetPosition();
+    const uint64_t begin = pos + (alignedBlockAlignment - pos % alignedBlockAlignment) % alignedBlockAlignment;
+    if (m_mapping)
+    {
+        SetPosition(begin + size);
+        return m_mapping.get() + begin;
+    }
+    SetPosition(begin);
+    freadOrDie(buffer, 1, size, m_file);
+    return buffer;
 }
 
 // skip to given delimiter character
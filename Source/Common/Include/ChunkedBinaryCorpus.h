@@ -0,0 +1,355 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ChunkedBinaryCorpus.h -- a chunked, indexed binary container for the input data of any reader
+//
+#pragma once
+
+#include "Basics.h"
+#include "File.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// Chunked binary corpus -- one container for dense, sparse and sequence data
+//
+// A corpus holds a number of streams (e.g. features and labels), each dense or sparse with a fixed dimension, and a
+// list of sequences. A sequence has the same number of samples in every stream; frame-mode data are sequences of
+// length 1. Sequences are grouped into chunks of roughly chunkSizeInSamples samples, which are the unit of paging
+// and of randomization (like the chunks of utterancesourcemulti.h). Each chunk is one aligned block, so that a reader
+// can map the file and use the data in place, and the index at the end of the file tells where every chunk and every
+// stream within it starts, so that chunks can be visited in any order without parsing anything else.
+//
+// Within a chunk, the samples of a stream are stored back to back, as 32-bit values:
+//  - dense:   float values[numSamples * dim], one column per sample
+//  - sparse:  uint32 colStarts[numSamples + 1] (offsets into rowIndices/values of this chunk), uint32 rowIndices[nnz], float values[nnz]
+//  - one-hot: uint32 ids[numSamples], the row of the single 1 of each sample (e.g. word ids); a special case of sparse
+// -----------------------------------------------------------------------
+
+struct ChunkedBinaryStream
+{
+    std::wstring name;
+    bool isSparse;
+    size_t dim;
+    bool isOneHot; // (implies isSparse)
+};
+
+// one sequence to be written: for every stream its samples in the layout above, colStarts relative to the sequence
+struct ChunkedBinarySequence
+{
+    size_t numSamples;
+    std::vector<std::vector<float>> values;        // [stream] not for one-hot
+    std::vector<std::vector<uint32_t>> rowIndices; // [stream] sparse only; the ids for one-hot
+    std::vector<std::vector<uint32_t>> colStarts;  // [stream] sparse only; numSamples + 1 entries; not for one-hot
+
+    void Clear(size_t numStreams)
+    {
+        numSamples = 0;
+        values.assign(numStreams, std::vector<float>());
+        rowIndices.assign(numStreams, std::vector<uint32_t>());
+        colStarts.assign(numStreams, std::vector<uint32_t>(1, 0));
+    }
+};
+
+struct ChunkedBinaryChunk
+{
+    uint64_t offset;                     // of the chunk's block in the file
+    size_t firstSequence;                // index of its first sequence in the corpus
+    size_t numSequences;
+    size_t numSamples;
+    std::vector<uint64_t> streamOffsets; // [stream] start of the stream's data, relative to offset
+};
+
+static const int chunkedBinaryCorpusVersion = 1;
+
+// -----------------------------------------------------------------------
+// ChunkedBinaryCorpusWriter -- writes a corpus sequence by sequence
+// -----------------------------------------------------------------------
+
+class ChunkedBinaryCorpusWriter
+{
+public:
+    ChunkedBinaryCorpusWriter(const std::wstring& path, const std::vector<ChunkedBinaryStream>& streams, size_t chunkSizeInSamples)
+        : m_file(path, fileOptionsBinary | fileOptionsWrite), m_streams(streams), m_chunkSizeInSamples(chunkSizeInSamples), m_closed(false)
+    {
+        if (m_streams.empty() || m_chunkSizeInSamples == 0)
+            InvalidArgument("ChunkedBinaryCorpusWriter: need at least one stream and a non-zero chunk size.");
+        m_file.PutMarker(fileMarkerBeginSection, std::wstring(L"BCBC"));
+        m_file << (int) chunkedBinaryCorpusVersion;
+        m_indexOffsetPosition = m_file.GetPosition();
+        m_file << (uint64_t) 0; // index offset, known in Close()
+        m_file << (uint64_t) m_streams.size();
+        for (const auto& stream : m_streams)
+            m_file << stream.name << (int) (stream.isOneHot ? 2 : stream.isSparse ? 1 : 0) << (uint64_t) stream.dim;
+        m_chunk.Clear(m_streams.size());
+        m_chunkNumSequences = 0;
+    }
+
+    ~ChunkedBinaryCorpusWriter()
+    {
+        if (!m_closed)
+            fprintf(stderr, "ChunkedBinaryCorpusWriter: corpus was not closed and is incomplete.\n");
+    }
+
+    void AddSequence(const ChunkedBinarySequence& sequence)
+    {
+        if (sequence.numSamples == 0)
+            return;
+        for (size_t s = 0; s < m_streams.size(); s++)
+        {
+            const auto& stream = m_streams[s];
+            if (stream.isOneHot)
+            {
+                if (sequence.rowIndices[s].size() != sequence.numSamples)
+                    InvalidArgument("ChunkedBinaryCorpusWriter: one-hot stream '%ls' has %d ids for %d samples.", stream.name.c_str(), (int) sequence.rowIndices[s].size(), (int) sequence.numSamples);
+                m_chunk.rowIndices[s].insert(m_chunk.rowIndices[s].end(), sequence.rowIndices[s].begin(), sequence.rowIndices[s].end());
+                continue;
+            }
+            if (!stream.isSparse && sequence.values[s].size() != sequence.numSamples * stream.dim)
+                InvalidArgument("ChunkedBinaryCorpusWriter: dense stream '%ls' has %d values for %d samples of dimension %d.",
+                                stream.name.c_str(), (int) sequence.values[s].size(), (int) sequence.numSamples, (int) stream.dim);
+            if (stream.isSparse && (sequence.colStarts[s].size() != sequence.numSamples + 1 || sequence.colStarts[s].back() != sequence.values[s].size()))
+                InvalidArgument("ChunkedBinaryCorpusWriter: sparse stream '%ls' is inconsistent with %d samples.", stream.name.c_str(), (int) sequence.numSamples);
+
+            auto& values = m_chunk.values[s];
+            if (stream.isSparse)
+            {
+                auto& colStarts = m_chunk.colStarts[s];
+                const uint32_t base = colStarts.back();
+                for (size_t j = 1; j < sequence.colStarts[s].size(); j++)
+                    colStarts.push_back(base + sequence.colStarts[s][j]);
+                m_chunk.rowIndices[s].insert(m_chunk.rowIndices[s].end(), sequence.rowIndices[s].begin(), sequence.rowIndices[s].end());
+            }
+            values.insert(values.end(), sequence.values[s].begin(), sequence.values[s].end());
+        }
+        m_chunk.numSamples += sequence.numSamples;
+        m_chunkNumSequences++;
+        m_sequenceLengths.push_back((uint32_t) sequence.numSamples);
+        if (m_chunk.numSamples >= m_chunkSizeInSamples)
+            FlushChunk();
+    }
+
+    // write the last chunk and the index
+    void Close()
+    {
+        FlushChunk();
+        const uint64_t indexOffset = m_file.GetPosition();
+        m_file.PutMarker(fileMarkerBeginSection, std::wstring(L"BIndex"));
+        m_file << (uint64_t) m_chunks.size();
+        for (const auto& chunk : m_chunks)
+        {
+            m_file << chunk.offset << (uint64_t) chunk.numSequences << (uint64_t) chunk.numSamples;
+            for (auto streamOffset : chunk.streamOffsets)
+                m_file << streamOffset;
+        }
+        m_file << m_sequenceLengths;
+        m_file.PutMarker(fileMarkerEndSection, std::wstring(L"EIndex"));
+        m_file.PutMarker(fileMarkerEndSection, std::wstring(L"EBCBC"));
+        m_file.SetPosition(m_indexOffsetPosition);
+        m_file << indexOffset;
+        m_file.Flush();
+        m_closed = true;
+    }
+
+    size_t GetNumSequences() const
+    {
+        return m_sequenceLengths.size();
+    }
+
+private:
+    void FlushChunk()
+    {
+        if (m_chunk.numSamples == 0)
+            return;
+        ChunkedBinaryChunk chunk;
+        chunk.firstSequence = m_sequenceLengths.size() - m_chunkNumSequences;
+        chunk.numSequences = m_chunkNumSequences;
+        chunk.numSamples = m_chunk.numSamples;
+        m_block.clear();
+        for (size_t s = 0; s < m_streams.size(); s++)
+        {
+            chunk.streamOffsets.push_back(m_block.size());
+            if (m_streams[s].isOneHot)
+            {
+                Append(m_chunk.rowIndices[s]);
+                continue;
+            }
+            if (m_streams[s].isSparse)
+            {
+                Append(m_chunk.colStarts[s]);
+                Append(m_chunk.rowIndices[s]);
+            }
+            Append(m_chunk.values[s]);
+        }
+        // (PutAlignedBlock() pads to the alignment first)
+        const uint64_t pos = m_file.GetPosition();
+        chunk.offset = pos + (File::alignedBlockAlignment - pos % File::alignedBlockAlignment) % File::alignedBlockAlignment;
+        m_file.PutAlignedBlock(m_block.data(), m_block.size());
+        m_chunks.push_back(chunk);
+        m_chunk.Clear(m_streams.size());
+        m_chunkNumSequences = 0;
+    }
+
+    template <class T>
+    void Append(const std::vector<T>& v)
+    {
+        const char* p = (const char*) v.data();
+        m_block.insert(m_block.end(), p, p + v.size() * sizeof(T));
+    }
+
+    File m_file;
+    std::vector<ChunkedBinaryStream> m_streams;
+    size_t m_chunkSizeInSamples;
+    uint64_t m_indexOffsetPosition;
+    bool m_closed;
+
+    std::vector<ChunkedBinaryChunk> m_chunks;
+    std::vector<uint32_t> m_sequenceLengths; // [sequence] number of samples
+
+    ChunkedBinarySequence m_chunk; // the chunk being collected; colStarts relative to the chunk
+    size_t m_chunkNumSequences;
+    std::vector<char> m_block;
+};
+
+// -----------------------------------------------------------------------
+// ChunkedBinaryCorpus -- a corpus mapped for reading
+// Only the index is read when opening; chunk data are paged in by the OS when they are accessed.
+// -----------------------------------------------------------------------
+
+class ChunkedBinaryCorpus
+{
+public:
+    ChunkedBinaryCorpus(const std::wstring& path)
+        : m_path(path)
+    {
+        File file(path, fileOptionsBinary | fileOptionsRead | fileOptionsMapped);
+        m_mapping = file.GetMapping();
+        if (!m_mapping)
+            RuntimeError("ChunkedBinaryCorpus: '%ls' cannot be mapped.", path.c_str());
+        file.GetMarker(fileMarkerBeginSection, std::wstring(L"BCBC"));
+        int version;
+        file >> version;
+        if (version != chunkedBinaryCorpusVersion)
+            RuntimeError("ChunkedBinaryCorpus: '%ls' has unsupported version %d.", path.c_str(), version);
+        uint64_t indexOffset, numStreams;
+        file >> indexOffset >> numStreams;
+        if (indexOffset == 0)
+            RuntimeError("ChunkedBinaryCorpus: '%ls' is incomplete (the writer was not closed).", path.c_str());
+        m_streams.resize(numStreams);
+        for (auto& stream : m_streams)
+        {
+            int kind; // 0 = dense, 1 = sparse, 2 = one-hot
+            uint64_t dim;
+            file >> stream.name >> kind >> dim;
+            stream.isSparse = kind != 0;
+            stream.isOneHot = kind == 2;
+            stream.dim = dim;
+        }
+
+        file.SetPosition(indexOffset);
+        file.GetMarker(fileMarkerBeginSection, std::wstring(L"BIndex"));
+        uint64_t numChunks;
+        file >> numChunks;
+        m_chunks.resize(numChunks);
+        size_t firstSequence = 0;
+        m_numSamples = 0;
+        for (auto& chunk : m_chunks)
+        {
+            uint64_t numSequences, numSamples;
+            file >> chunk.offset >> numSequences >> numSamples;
+            chunk.streamOffsets.resize(numStreams);
+            for (auto& streamOffset : chunk.streamOffsets)
+                file >> streamOffset;
+            chunk.firstSequence = firstSequence;
+            chunk.numSequences = numSequences;
+            chunk.numSamples = numSamples;
+            firstSequence += chunk.numSequences;
+            m_numSamples += chunk.numSamples;
+        }
+        file >> m_sequenceLengths;
+        file.GetMarker(fileMarkerEndSection, std::wstring(L"EIndex"));
+        if (m_sequenceLengths.size() != firstSequence)
+            RuntimeError("ChunkedBinaryCorpus: '%ls' has an inconsistent index.", path.c_str());
+
+        // sample offset of every sequence within its chunk
+        m_sequenceStarts.resize(m_sequenceLengths.size());
+        for (const auto& chunk : m_chunks)
+        {
+            size_t start = 0;
+            for (size_t i = chunk.firstSequence; i < chunk.firstSequence + chunk.numSequences; i++)
+            {
+                m_sequenceStarts[i] = (uint32_t) start;
+                start += m_sequenceLengths[i];
+            }
+        }
+    }
+
+    const std::vector<ChunkedBinaryStream>& GetStreams() const
+    {
+        return m_streams;
+    }
+    const std::vector<ChunkedBinaryChunk>& GetChunks() const
+    {
+        return m_chunks;
+    }
+    size_t GetNumSequences() const
+    {
+        return m_sequenceLengths.size();
+    }
+    size_t GetSequenceLength(size_t sequence) const
+    {
+        return m_sequenceLengths[sequence];
+    }
+    // first sample of a sequence, relative to its chunk
+    size_t GetSequenceStart(size_t sequence) const
+    {
+        return m_sequenceStarts[sequence];
+    }
+    size_t GetNumSamples() const
+    {
+        return m_numSamples;
+    }
+
+    // stream data of a chunk, in place in the mapping
+    const float* DenseValues(size_t chunk, size_t stream) const
+    {
+        return (const float*) StreamData(chunk, stream);
+    }
+    const uint32_t* SparseColStarts(size_t chunk, size_t stream) const
+    {
+        return (const uint32_t*) StreamData(chunk, stream);
+    }
+    const uint32_t* SparseRowIndices(size_t chunk, size_t stream) const
+    {
+        return SparseColStarts(chunk, stream) + m_chunks[chunk].numSamples + 1;
+    }
+    const float* SparseValues(size_t chunk, size_t stream) const
+    {
+        const uint32_t* colStarts = SparseColStarts(chunk, stream);
+        return (const float*) (SparseRowIndices(chunk, stream) + colStarts[m_chunks[chunk].numSamples]);
+    }
+    const uint32_t* OneHotIds(size_t chunk, size_t stream) const
+    {
+        return (const uint32_t*) StreamData(chunk, stream);
+    }
+
+private:
+    const char* StreamData(size_t chunk, size_t stream) const
+    {
+        return m_mapping.get() + m_chunks[chunk].offset + m_chunks[chunk].streamOffsets[stream];
+    }
+
+    std::wstring m_path;
+    std::shared_ptr<const char> m_mapping;
+    std::vector<ChunkedBinaryStream> m_streams;
+    std::vector<ChunkedBinaryChunk> m_chunks;
+    std::vector<uint32_t> m_sequenceLengths; // [sequence]
+    std::vector<uint32_t> m_sequenceStarts;  // [sequence] within its chunk
+    size_t m_numSamples;
+};
+} } }
@@ -64,6 +64,26 @@ enum EndDataType
     endDataSentence, // end of sentence
 };
 
+// KeepSubsetOf() -- for readers that shard their sequences across the workers of StartDistributedMinibatchLoop()
+// Of a block of items numbered firstIndex, firstIndex + 1, ... in the order of the corpus, this keeps every
+// numSubsets-th one, starting with the item whose number modulo numSubsets is subsetNum, and returns how many it kept.
+// Since the numbering continues over blocks, all workers together see each item once, whatever the block sizes.
+template <class T>
+size_t KeepSubsetOf(std::vector<T>& items, size_t firstIndex, size_t subsetNum, size_t numSubsets)
+{
+    if (numSubsets > 1)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            if ((firstIndex + i) % numSubsets == subsetNum)
+                items[kept++] = std::move(items[i]);
+        }
+        items.erase(items.begin() + kept, items.end());
+    }
+    return items.size();
+}
+
 // Data Reader interface
 // implemented by DataReader and underlying classes
 template <class ElemType>
@@ -94,6 +114,13 @@ public:
         return StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
     }
 
+    // continue the epoch just started by StartMinibatchLoop() after its first 'numMinibatches' minibatches, without
+    // reading them (resuming from a mid-epoch checkpoint); false if the reader cannot, and the caller reads and drops them
+    virtual bool SkipMinibatches(size_t /*numMinibatches*/)
+    {
+        return false;
+    }
+
     virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices) = 0;
     virtual bool GetMinibatch4SE(std::vector<shared_ptr<const msra::dbn::latticepair>>& /*latticeinput*/, vector<size_t>& /*uids*/, vector<size_t>& /*boundaries*/, vector<size_t>& /*extrauttmap*/)
     {
@@ -262,6 +289,7 @@ public:
 
     virtual bool SupportsDistributedMBRead() const override;
     virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
+    virtual bool SkipMinibatches(size_t numMinibatches) override;
 
     // GetMinibatch - Get the next minibatch (features and labels)
     // matrices - [in] a map with named matrix types (i.e. 'features', 'labels') mapped to the corresponding matrix,
@@ -20,6 +20,7 @@
 #endif
 
 #include <iostream>
+#include <string>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -34,6 +35,12 @@ private:
 
 public:
     static void PrintCallStack();
+
+    // the return addresses of up to maxFrames callers, innermost first, after skipping the 'skip' innermost ones
+    // (besides this function itself); the number of frames stored
+    static size_t CaptureCallStack(void** frames, size_t maxFrames, size_t skip);
+    // the (demangled) name of the function that contains a code address, or the address if it is not known
+    static std::string FunctionName(void* address);
 };
 }}}
 
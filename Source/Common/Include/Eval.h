@@ -48,6 +48,13 @@ public:
     virtual void GetNodeDimensions(std::map<std::wstring, size_t>& dimensions, NodeGroup nodeGroup) = 0;
     virtual void StartEvaluateMinibatchLoop(const std::wstring& outputNodeName) = 0;
     virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs) = 0;
+    virtual void EvaluateBatched(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs) = 0;
+    virtual void BindBuffer(const std::wstring& nodeName, ElemType* buffer, size_t maxNumSamples) = 0;
+    virtual void EvaluateBound(size_t numSamples) = 0;
+    virtual size_t OpenStream() = 0;
+    virtual void EvaluateStream(size_t streamId, std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs) = 0;
+    virtual void CloseStream(size_t streamId) = 0;
+    virtual void EvaluateHypotheses(std::vector<std::map<std::wstring, std::vector<ElemType>*>>& inputs, std::vector<std::map<std::wstring, std::vector<ElemType>*>>& outputs) = 0;
     virtual void ResetState() = 0;
 };
 
@@ -80,6 +87,12 @@ public:
     // deviceId=auto ( can be [0,all,cpu,0:2:3,auto] define accellerators (GPUs) to use, or the CPU
     // modelPath=c:\models\model.dnn (model path, if not specified, must call LoadModel() method before Evaluate()
     // minibatchSize=1024 (minibatch size used during evaluation if < passed data size)
+// maxBatchLatencyMs=2 (EvaluateBatched(): how long a request waits for concurrent ones to share its minibatch)
+// maxBatchRequests=64 (EvaluateBatched(): maximum number of requests merged into one minibatch)
+// numCPUThreads=1 (CPU threads of this evaluator's computation, applied per call, for the calling thread only once cpuCores is given)
+// cpuCores= (bind them to these cores, e.g. 0:1:2:3, or 'auto' for cores held by no other evaluator of the process, preferably on one NUMA node; numaNode=n picks the node)
+// outputNodeNames= (LoadModel(): load only the nodes these outputs depend on, e.g. out1:out2, if the model file has a node index)
+// optimizeModel=false (fold constants, Dropout and normalization nodes into the parameters, and fuse affine layers, when loading the model)
     Eval(const std::string& config);
     virtual ~Eval();
 
@@ -100,6 +113,37 @@ public:
     // inputs - map from node name to input vector
     // outputs - map from node name to output vector, outputs vectors need to be preallocated by caller, sizing will happen during evaluation
     virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+
+    // EvaluateBatched - thread-safe Evaluate() of one request, i.e. one sequence of samples
+    // Calls from concurrent threads are merged into one minibatch of parallel sequences, waiting at most maxBatchLatencyMs for others to join.
+    // inputs, outputs - as for Evaluate()
+    virtual void EvaluateBatched(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+
+    // BindBuffer - bind a caller-owned buffer to an input or output node, for use by EvaluateBound()
+    // nodeName - name of an input node, or of a node to be evaluated
+    // buffer - column-major space for maxNumSamples samples of the node; on the model's device (device memory for a GPU model), and valid while bound; nullptr unbinds
+    virtual void BindBuffer(const std::wstring& nodeName, ElemType* buffer, size_t maxNumSamples);
+
+    // EvaluateBound - evaluate numSamples samples as one sequence, read in place from the bound input buffers, into the bound output buffers
+    virtual void EvaluateBound(size_t numSamples);
+
+    // OpenStream - start a stream, e.g. an utterance that arrives in chunks; returns its id
+    // A stream carries the state of the model's PastValue nodes from one chunk to the next.
+    virtual size_t OpenStream();
+
+    // EvaluateStream - thread-safe evaluation of the next chunk of a stream, continuing from where its previous chunk ended
+    // Chunks of different streams evaluated concurrently are batched like EvaluateBatched(). Chunks of one stream must be evaluated one after another.
+    // inputs, outputs - as for Evaluate()
+    virtual void EvaluateStream(size_t streamId, std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+
+    // CloseStream - release the state of a stream
+    virtual void CloseStream(size_t streamId);
+
+    // EvaluateHypotheses - evaluate sequences that share prefixes, e.g. the N-best hypotheses of an RNN LM rescoring, evaluating each distinct prefix once
+    // The outputs are those of evaluating each sequence on its own. The model must not have FutureValue nodes.
+    // inputs, outputs - [h] as for Evaluate(), for sequence h
+    virtual void EvaluateHypotheses(std::vector<std::map<std::wstring, std::vector<ElemType>*>>& inputs, std::vector<std::map<std::wstring, std::vector<ElemType>*>>& outputs);
+
     virtual void Init(const std::string& config);
     virtual void ResetState();
 };
@@ -19,6 +19,7 @@
 #include "fileutil.h" // for f{ge,pu}t{,Text}()
 #include <fstream>    // for LoadMatrixFromTextFile() --TODO: change to using this File class
 #include <sstream>
+#include <memory>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -36,6 +37,10 @@ enum FileOptions
     fileOptionsWrite = 16,                                                      // open in write mode
     fileOptionsSequential = 32,                                                 // optimize for sequential reads (allocates big buffer)
     fileOptionsReadWrite = fileOptionsRead | fileOptionsWrite,                  // read/write mode
+    fileOptionsAlignedBlocks = 64,                                              // (binary write) store matrix data as aligned blocks, which a reader can map in place
+    fileOptionsMapped = 128,                                                    // (binary read) also map the file read-only, so that aligned blocks are referenced in place instead of copied
+    fileOptionsCompactFP16 = 256,                                               // (binary write) store the elements of large dense matrices as FP16
+    fileOptionsCompactInt8 = 512,                                               // (binary write) store the elements of large dense matrices as 8 bits, quantized per column
 };
 
 // markers used for text files
@@ -100,7 +105,11 @@ private:
     bool m_pcloseNeeded; // was opened with popen(), use pclose() when destructing
     bool m_seekable;     // this stream is seekable
     int m_options;       // FileOptions ored togther
+    std::shared_ptr<const char> m_mapping; // read-only view of the whole file if opened with fileOptionsMapped
+    std::unique_ptr<char[]> m_buffer;      // stdio buffer of binary files, see Init()
     void Init(const wchar_t* filename, int fileOptions);
+    void Map();
+    void SetUpBinaryIO(bool reading);
 
 public:
     File(const std::wstring& filename, int fileOptions);
@@ -121,6 +130,36 @@ public:
 
     bool IsTextBased();
 
+    // aligned blocks of raw data, e.g. matrix elements; see fileOptionsAlignedBlocks
+    // Such a block is preceded by zero padding such that it starts at a multiple of alignedBlockAlignment in the file.
+    static const size_t alignedBlockAlignment = 64;
+    bool UsesAlignedBlocks() const
+    {
+        return (m_options & (fileOptionsAlignedBlocks | fileOptionsType)) == (fileOptionsAlignedBlocks | fileOptionsBinary);
+    }
+    void PutAlignedBlock(const void* data, size_t size);
+    // compact encoding of matrix elements, see fileOptionsCompactFP16/Int8; readers recognize it without the option
+    bool UsesCompactFP16() const
+    {
+        return (m_options & (fileOptionsCompactFP16 | fileOptionsType)) == (fileOptionsCompactFP16 | fileOptionsBinary);
+    }
+    bool UsesCompactInt8() const
+    {
+        return (m_options & (fileOptionsCompactInt8 | fileOptionsType)) == (fileOptionsCompactInt8 | fileOptionsBinary);
+    }
+    static const size_t compactMinElements = 1024; // smaller matrices (biases, scales) are stored in full
+    const std::wstring& GetName() const
+    {
+        return m_filename;
+    }
+    // returns a pointer to the block in the mapping if the file is mapped, else reads it into buffer and returns that
+    const void* GetAlignedBlock(size_t size, void* buffer);
+    // the mapping stays valid for as long as it is referenced (also after the File is closed), which users of blocks in it must ensure
+    const std::shared_ptr<const char>& GetMapping() const
+    {
+        return m_mapping;
+    }
+
     bool IsUnicodeBOM(bool skip = false);
     bool IsEOF();
     bool IsWhiteSpace(bool skip = false);
@@ -165,6 +204,31 @@ public:
     File& PutMarker(FileMarker marker, const std::string& section);
     File& PutMarker(FileMarker marker, const std::wstring& section);
 
+    // contiguous arrays of basic types, e.g. matrix elements; the same format as putting/getting them one by one,
+    // but binary files transfer them in one block
+    template <typename T>
+    void PutArray(const T* data, size_t count)
+    {
+        if (IsTextBased())
+        {
+            for (size_t i = 0; i < count; i++)
+                *this << data[i];
+        }
+        else if (count > 0)
+            fwriteOrDie(data, sizeof(T), count, m_file);
+    }
+    template <typename T>
+    void GetArray(T* data, size_t count)
+    {
+        if (IsTextBased())
+        {
+            for (size_t i = 0; i < count; i++)
+                *this >> data[i];
+        }
+        else if (count > 0)
+            freadOrDie(data, sizeof(T), count, m_file);
+    }
+
     // put operator for vectors of types
     template <typename T>
     File& operator<<(const std::vector<T>& val)
@@ -6,10 +6,15 @@
 // and the MPI dev package on Linux (sudo apt-get install libopenmpi-dev openmpi-bin openmpi-doc)
 #include "mpi.h"
 #pragma comment(lib, "msmpi.lib")
+#if defined(OPEN_MPI)
+#include "mpi-ext.h" // (defines MPIX_CUDA_AWARE_SUPPORT if Open MPI was built with CUDA support)
+#endif
 
 #include <string>
 #include <array>
 #include <vector>
+#include <algorithm>
+#include <stdexcept>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -21,6 +26,28 @@ struct MpiFail : public std::string
     }
 };
 
+// thrown instead of aborting when an MPI operation failed because a rank died, if MPIWrapper::EnableFaultTolerance() was called
+// The survivors call MPIWrapper::ShrinkAfterRankLoss() to continue among themselves.
+struct MpiRankLoss : public std::runtime_error
+{
+    MpiRankLoss(const std::string &what)
+        : std::runtime_error(what)
+    {
+    }
+};
+
+// (inline, so that it is one flag across translation units, unlike the static operator|| below)
+inline bool &MpiFaultToleranceEnabled()
+{
+    static bool enabled = false;
+    return enabled;
+}
+
+// whether MPI errors about failed processes can be recovered from (the ULFM extension, e.g. Open MPI 5 or MPICH 4)
+#ifdef MPIX_ERR_PROC_FAILED
+#define CNTK_MPI_ULFM
+#endif
+
 static int operator||(int rc, const MpiFail &what)
 {
     if (rc == MPI_SUCCESS)
@@ -31,6 +58,16 @@ static int operator||(int rc, const MpiFail &what)
     fprintf(stderr, "%s, MPI error %d\n", what.c_str(), rc);
     fflush(stderr);
 
+#ifdef CNTK_MPI_ULFM
+    if (MpiFaultToleranceEnabled())
+    {
+        int errorClass;
+        MPI_Error_class(rc, &errorClass);
+        if (errorClass == MPIX_ERR_PROC_FAILED || errorClass == MPIX_ERR_REVOKED)
+            throw MpiRankLoss(what);
+    }
+#endif
+
     // (special case: we use that code to indicate a missing msmpi.dll...)
     if (rc != MPI_ERR_INTERN)
     {
@@ -49,15 +86,48 @@ static int operator||(int rc, const MpiFail &what)
     RuntimeError("%s", what.c_str());
 }
 
+// how AllReduce() of raw buffers is carried out
+enum class AllReduceAlgorithm
+{
+    MPI,         // whatever MPI_Allreduce implements (often tree-based)
+    Ring,        // chunked ring: reduce-scatter then all-gather, each rank sends and receives 2 (p-1)/p of the data
+    Hierarchical // reduce within each machine, ring across machines (one rank per machine), broadcast within each machine
+};
+
+static AllReduceAlgorithm ParseAllReduceAlgorithm(const std::wstring& s)
+{
+    if (s == L"mpi")
+        return AllReduceAlgorithm::MPI;
+    else if (s == L"ring")
+        return AllReduceAlgorithm::Ring;
+    else if (s == L"hierarchical")
+        return AllReduceAlgorithm::Hierarchical;
+    InvalidArgument("ParseAllReduceAlgorithm: Invalid all-reduce algorithm '%ls'. Valid values are mpi, ring, and hierarchical.", s.c_str());
+}
+
 class MPIWrapper
 {
     int m_myRank;
     int m_numMPINodes;
     size_t m_numNodesInUse;
 
+    // all ranks: MPI_COMM_WORLD, or what is left of it after ShrinkAfterRankLoss()
+    MPI_Comm m_worldComm;
+
     // MPI communicator that reflects the current subset selection
     MPI_Comm m_currentComm;
 
+    AllReduceAlgorithm m_allReduceAlgorithm;
+    // for hierarchical all-reduce, created on first use: the ranks on this machine, and one rank per machine (MPI_COMM_NULL if we are not the first on our machine)
+    MPI_Comm m_machineComm;
+    MPI_Comm m_acrossMachinesComm;
+
+    // MPI can be passed GPU device pointers
+    bool m_isCudaAware;
+
+    // buffers smaller than this many elements per rank are not worth splitting into chunks
+    static const size_t s_minRingChunkElements = 4096;
+
     // MPI_Init() with delay-loading the msmpi.dll (possibly causing a failure if missing; we want to catch that)
     int MPI_Init_DL()
     {
@@ -100,7 +170,7 @@ class MPIWrapper
 
 public:
     MPIWrapper()
-        : m_currentComm(MPI_COMM_WORLD)
+        : m_worldComm(MPI_COMM_WORLD), m_currentComm(MPI_COMM_WORLD), m_allReduceAlgorithm(AllReduceAlgorithm::MPI), m_machineComm(MPI_COMM_NULL), m_acrossMachinesComm(MPI_COMM_NULL), m_isCudaAware(false)
     {
         static bool initialized = false;
         if (initialized)
@@ -129,6 +199,10 @@ public:
         // by default we use all of them
         RequestNodes("MPIWrapper");
 
+        m_isCudaAware = QueryCudaAwareness();
+        if (m_isCudaAware)
+            fprintf(stderr, "mpihelper: MPI is CUDA-aware\n");
+
         if (m_numMPINodes > 1)
             fprintf(stderr, "mpihelper: we are cog %d in a gearbox of %d\n", (int) m_myRank, (int) m_numMPINodes);
         else
@@ -179,31 +253,20 @@ public:
     {
         Ping("requestnodes (before change)");
 
-// undo current split
-#ifdef USE2NDCOMM
-        if (m_currentComm != MPI_COMM_WORLD /*no subset*/ && m_currentComm != MPI_COMM_NULL /*idle nodes*/)
-        {
-            fprintf(stderr, "requestnodes: MPI_Comm_free %x\n", (int) m_currentComm);
-            fflush(stderr);
+        // undo current split
+        if (m_currentComm != m_worldComm /*no subset*/ && m_currentComm != MPI_COMM_NULL /*idle nodes*/)
             MPI_Comm_free(&m_currentComm) || MpiFail("requestnodes: MPI_Comm_free"); // will leave MPI_COMM_NULL here
-        }
-#endif
-        // reset to MPI_COMM_WORLD
-        m_currentComm = MPI_COMM_WORLD;
-        // create a new split (unless all nodes were requested)
+        // reset to all ranks
+        m_currentComm = m_worldComm;
+        // create a new split (unless all nodes were requested); idle nodes get MPI_COMM_NULL
+        // All nodes must call this together, since MPI_Comm_split() is collective over all ranks.
         if (requestednodes < (size_t) m_numMPINodes)
         {
-#ifdef USE2NDCOMM
-            fprintf(stderr, "requestnodes: MPI_Comm_split %d\n", (node() < requestednodes) ? 1 : MPI_UNDEFINED);
-            fflush(stderr);
-            MPI_Comm_split(communicator(), (node() < requestednodes) ? 1 : MPI_UNDEFINED, 0, &m_currentComm) || MpiFail("requestnodes: MPI_Comm_split");
-            fprintf(stderr, "requestnodes: MPI_Comm_split -> %x\n", (int) m_currentComm);
-            fflush(stderr);
-#endif
+            MPI_Comm_split(m_worldComm, ((size_t) m_myRank < requestednodes) ? 1 : MPI_UNDEFINED, m_myRank, &m_currentComm) || MpiFail("requestnodes: MPI_Comm_split");
         }
         else
         {
-            // leave m_currentComm as MPI_COMM_WORLD
+            // leave m_currentComm as all ranks
             // and clip to #nodes
             requestednodes = m_numMPINodes;
         }
@@ -216,6 +279,65 @@ public:
         Ping("requestnodes (after change)");
     }
 
+    // -----------------------------------------------------------------------
+    // elastic operation: surviving the loss of ranks
+    // -----------------------------------------------------------------------
+
+    // make MPI report errors instead of aborting, and turn failures of processes into MpiRankLoss exceptions
+    // Other errors still abort as before.
+    void EnableFaultTolerance()
+    {
+#ifdef CNTK_MPI_ULFM
+        MPI_Comm_set_errhandler(m_worldComm, MPI_ERRORS_RETURN) || MpiFail("EnableFaultTolerance: MPI_Comm_set_errhandler");
+        if (m_currentComm != m_worldComm && m_currentComm != MPI_COMM_NULL)
+            MPI_Comm_set_errhandler(m_currentComm, MPI_ERRORS_RETURN) || MpiFail("EnableFaultTolerance: MPI_Comm_set_errhandler");
+        MpiFaultToleranceEnabled() = true;
+        fprintf(stderr, "mpihelper: fault tolerance enabled, training continues if ranks are lost\n");
+#else
+        RuntimeError("EnableFaultTolerance: This MPI library does not support recovering from failed processes (the ULFM extension, MPIX_Comm_shrink()).");
+#endif
+    }
+
+    // after an MpiRankLoss, to be called by every surviving rank: make sure all of them stop what they were
+    // doing, and continue with a communicator of the survivors. The ranks are renumbered, and all of them are in use.
+    // Returns the number of ranks lost.
+    size_t ShrinkAfterRankLoss()
+    {
+#ifdef CNTK_MPI_ULFM
+        // revoking makes the pending and future operations on the communicators fail on all ranks, also on those that
+        // have not noticed the loss themselves (revoking twice is harmless, so every survivor does it)
+        for (MPI_Comm comm : {m_currentComm, m_machineComm, m_acrossMachinesComm})
+        {
+            if (comm != m_worldComm && comm != MPI_COMM_NULL)
+                MPIX_Comm_revoke(comm);
+        }
+        MPIX_Comm_revoke(m_worldComm);
+
+        MPI_Comm survivors;
+        MPIX_Comm_shrink(m_worldComm, &survivors) || MpiFail("ShrinkAfterRankLoss: MPIX_Comm_shrink");
+        MPI_Comm_set_errhandler(survivors, MPI_ERRORS_RETURN) || MpiFail("ShrinkAfterRankLoss: MPI_Comm_set_errhandler");
+
+        // Note: We do not free the revoked communicators (including the machine-level ones of the hierarchical
+        // all-reduce). The failed ranks would make that collective call fail, and this happens rarely anyway.
+        const size_t numRanksBefore = m_numMPINodes;
+        m_worldComm = survivors;
+        m_currentComm = survivors;
+        m_machineComm = MPI_COMM_NULL;
+        m_acrossMachinesComm = MPI_COMM_NULL;
+        MPI_Comm_rank(m_worldComm, &m_myRank) || MpiFail("ShrinkAfterRankLoss: MPI_Comm_rank");
+        MPI_Comm_size(m_worldComm, &m_numMPINodes) || MpiFail("ShrinkAfterRankLoss: MPI_Comm_size");
+        m_numNodesInUse = m_numMPINodes;
+        s_myRank = m_myRank;
+
+        fprintf(stderr, "mpihelper: lost %d ranks; continuing as cog %d in a gearbox of %d\n",
+                (int) (numRanksBefore - m_numMPINodes), (int) m_myRank, (int) m_numMPINodes);
+        fflush(stderr);
+        return numRanksBefore - m_numMPINodes;
+#else
+        LogicError("ShrinkAfterRankLoss: called without fault tolerance.");
+#endif
+    }
+
     MPI_Comm Communicator() const
     {
         return m_currentComm;
@@ -286,15 +408,116 @@ public:
     }
 
     // for raw pointer
+    // Large buffers use the all-reduce algorithm selected with SetAllReduceAlgorithm().
     template <class ElemType>
     void AllReduce(ElemType *pData, size_t nData)
     {
         if ((NumNodesInUse() > 1 && (Communicator() != MPI_COMM_NULL)))
         {
-            MPI_Allreduce(MPI_IN_PLACE, pData, (int) nData, GetDataType(pData), MPI_SUM, Communicator()) || MpiFail("Allreduce: MPI_Allreduce");
+            if (m_allReduceAlgorithm == AllReduceAlgorithm::Ring && nData >= NumNodesInUse() * s_minRingChunkElements)
+                RingAllReduce(pData, nData, Communicator());
+            else if (m_allReduceAlgorithm == AllReduceAlgorithm::Hierarchical && UsingAllNodes() && nData >= s_minRingChunkElements)
+                HierarchicalAllReduce(pData, nData);
+            else
+                MPI_Allreduce(MPI_IN_PLACE, pData, (int) nData, GetDataType(pData), MPI_SUM, Communicator()) || MpiFail("Allreduce: MPI_Allreduce");
         }
     }
 
+    // whether MPI operations accept GPU device pointers, as detected at construction
+    bool IsCudaAware() const
+    {
+        return m_isCudaAware;
+    }
+
+    void SetAllReduceAlgorithm(AllReduceAlgorithm algorithm)
+    {
+        m_allReduceAlgorithm = algorithm;
+    }
+    AllReduceAlgorithm GetAllReduceAlgorithm() const
+    {
+        return m_allReduceAlgorithm;
+    }
+
+private:
+    // A build-time check is not sufficient, as the MPI library found at runtime may differ from the one we compiled against.
+    // MPIX_Query_cuda_support() exists in Open MPI 2.0 and later; MVAPICH2 and MS MPI offer no query, and we assume they are not CUDA-aware.
+    static bool QueryCudaAwareness()
+    {
+#if defined(MPIX_CUDA_AWARE_SUPPORT) && MPIX_CUDA_AWARE_SUPPORT
+        return MPIX_Query_cuda_support() != 0;
+#else
+        return false;
+#endif
+    }
+
+    // bandwidth-optimal ring all-reduce (sum) over the ranks of 'comm'
+    // The buffer is split into one chunk per rank. In p-1 reduce-scatter steps every rank passes a partial sum of one
+    // chunk to its right neighbor and adds the one it gets from its left neighbor, after which rank r holds the full sum
+    // of chunk (r+1) mod p. In p-1 all-gather steps the summed chunks are passed around the ring.
+    template <class ElemType>
+    static void RingAllReduce(ElemType *pData, size_t nData, MPI_Comm comm)
+    {
+        int rank, numRanks;
+        MPI_Comm_rank(comm, &rank) || MpiFail("RingAllReduce: MPI_Comm_rank");
+        MPI_Comm_size(comm, &numRanks) || MpiFail("RingAllReduce: MPI_Comm_size");
+        if (numRanks < 2)
+            return;
+        const size_t p = numRanks;
+        const int right = (rank + 1) % numRanks;
+        const int left = (rank + numRanks - 1) % numRanks;
+        auto chunkBegin = [&](size_t chunk)
+        {
+            return chunk * nData / p;
+        };
+        auto chunkSize = [&](size_t chunk)
+        {
+            return chunkBegin(chunk + 1) - chunkBegin(chunk);
+        };
+
+        std::vector<ElemType> received(chunkSize(p - 1) + 1);
+        for (size_t step = 0; step + 1 < p; step++)
+        {
+            const size_t sendChunk = (rank + p - step) % p;
+            const size_t recvChunk = (rank + p - step - 1) % p;
+            MPI_Sendrecv(pData + chunkBegin(sendChunk), (int) chunkSize(sendChunk), GetDataType(pData), right, 0,
+                         received.data(), (int) chunkSize(recvChunk), GetDataType(pData), left, 0, comm, MPI_STATUS_IGNORE) || MpiFail("RingAllReduce: MPI_Sendrecv");
+            ElemType *target = pData + chunkBegin(recvChunk);
+            for (size_t i = 0; i < chunkSize(recvChunk); i++)
+                target[i] += received[i];
+        }
+        for (size_t step = 0; step + 1 < p; step++)
+        {
+            const size_t sendChunk = (rank + 1 + p - step) % p;
+            const size_t recvChunk = (rank + p - step) % p;
+            MPI_Sendrecv(pData + chunkBegin(sendChunk), (int) chunkSize(sendChunk), GetDataType(pData), right, 1,
+                         pData + chunkBegin(recvChunk), (int) chunkSize(recvChunk), GetDataType(pData), left, 1, comm, MPI_STATUS_IGNORE) || MpiFail("RingAllReduce: MPI_Sendrecv");
+        }
+    }
+
+    // reduce to the first rank of each machine, ring all-reduce among those, then broadcast within each machine
+    // Ranks on one machine talk over shared memory (and whatever the MPI library uses for that, e.g. CUDA IPC), so only
+    // one rank per machine puts the data on the network.
+    template <class ElemType>
+    void HierarchicalAllReduce(ElemType *pData, size_t nData)
+    {
+        if (m_machineComm == MPI_COMM_NULL)
+        {
+            MPI_Comm_split_type(m_worldComm, MPI_COMM_TYPE_SHARED, m_myRank, MPI_INFO_NULL, &m_machineComm) || MpiFail("HierarchicalAllReduce: MPI_Comm_split_type");
+            int machineRank;
+            MPI_Comm_rank(m_machineComm, &machineRank) || MpiFail("HierarchicalAllReduce: MPI_Comm_rank");
+            MPI_Comm_split(m_worldComm, machineRank == 0 ? 0 : MPI_UNDEFINED, m_myRank, &m_acrossMachinesComm) || MpiFail("HierarchicalAllReduce: MPI_Comm_split");
+        }
+
+        int machineRank;
+        MPI_Comm_rank(m_machineComm, &machineRank) || MpiFail("HierarchicalAllReduce: MPI_Comm_rank");
+        MPI_Reduce(machineRank == 0 ? MPI_IN_PLACE : pData, pData, (int) nData, GetDataType(pData), MPI_SUM, 0, m_machineComm) || MpiFail("HierarchicalAllReduce: MPI_Reduce");
+        if (m_acrossMachinesComm != MPI_COMM_NULL)
+            RingAllReduce(pData, nData, m_acrossMachinesComm);
+        MPI_Bcast(pData, (int) nData, GetDataType(pData), 0, m_machineComm) || MpiFail("HierarchicalAllReduce: MPI_Bcast");
+    }
+
+public:
+
     template <class ElemType>
     void Bcast(ElemType *pData, size_t nData, size_t srcRank)
     {
@@ -307,7 +530,8 @@ public:
     // wait for all ranks to reach here
     void WaitAll()
     {
-        MPI_Barrier(m_currentComm) || MpiFail("waitall: MPI_Barrier");
+        if (m_currentComm != MPI_COMM_NULL)
+            MPI_Barrier(m_currentComm) || MpiFail("waitall: MPI_Barrier");
     }
 };
 }
@@ -0,0 +1,155 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// PackedImageFile.h -- a single container for the encoded images and labels of an ImageReader map file
+//
+#pragma once
+
+#include "Basics.h"
+#include "File.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// Packed image file -- the encoded image files (JPEG, PNG, ...) of a map file, concatenated, plus an index
+//
+// Opening one file instead of one per image avoids the per-file opens and metadata lookups that dominate reading
+// from a shared file system. The images are stored unchanged, each as an aligned block, so that a mapped file can be
+// decoded in place. Consecutive images are grouped into chunks of chunkSizeInImages, the unit of randomization:
+// a reader shuffles the chunks and then the images within a window of chunks, which keeps its reads mostly sequential.
+// The index at the end holds the offset, size and label of every image.
+// -----------------------------------------------------------------------
+
+static const int packedImageFileVersion = 1;
+
+// -----------------------------------------------------------------------
+// PackedImageWriter -- writes a packed image file image by image
+// -----------------------------------------------------------------------
+
+class PackedImageWriter
+{
+public:
+    PackedImageWriter(const std::wstring& path, size_t chunkSizeInImages)
+        : m_file(path, fileOptionsBinary | fileOptionsWrite), m_closed(false)
+    {
+        if (chunkSizeInImages == 0)
+            InvalidArgument("PackedImageWriter: the chunk size must not be 0.");
+        m_file.PutMarker(fileMarkerBeginSection, std::wstring(L"BPIM"));
+        m_file << (int) packedImageFileVersion;
+        m_indexOffsetPosition = m_file.GetPosition();
+        m_file << (uint64_t) 0; // index offset, known in Close()
+        m_file << (uint64_t) chunkSizeInImages;
+    }
+
+    ~PackedImageWriter()
+    {
+        if (!m_closed)
+            fprintf(stderr, "PackedImageWriter: file was not closed and is incomplete.\n");
+    }
+
+    // data - the encoded image file as it is
+    void AddImage(const std::vector<char>& data, int label)
+    {
+        // (PutAlignedBlock() pads to the alignment first)
+        const uint64_t pos = m_file.GetPosition();
+        m_offsets.push_back(pos + (File::alignedBlockAlignment - pos % File::alignedBlockAlignment) % File::alignedBlockAlignment);
+        m_sizes.push_back((uint32_t) data.size());
+        m_labels.push_back((int32_t) label);
+        m_file.PutAlignedBlock(data.data(), data.size());
+    }
+
+    void Close()
+    {
+        const uint64_t indexOffset = m_file.GetPosition();
+        m_file.PutMarker(fileMarkerBeginSection, std::wstring(L"BIndex"));
+        m_file << m_offsets << m_sizes << m_labels;
+        m_file.PutMarker(fileMarkerEndSection, std::wstring(L"EIndex"));
+        m_file.PutMarker(fileMarkerEndSection, std::wstring(L"EPIM"));
+        m_file.SetPosition(m_indexOffsetPosition);
+        m_file << indexOffset;
+        m_file.Flush();
+        m_closed = true;
+    }
+
+    size_t GetNumImages() const
+    {
+        return m_offsets.size();
+    }
+
+private:
+    File m_file;
+    uint64_t m_indexOffsetPosition;
+    bool m_closed;
+    std::vector<uint64_t> m_offsets; // [image] of its block in the file
+    std::vector<uint32_t> m_sizes;   // [image] in bytes
+    std::vector<int32_t> m_labels;   // [image] class id
+};
+
+// -----------------------------------------------------------------------
+// PackedImageFile -- a packed image file mapped for reading
+// Only the index is read when opening; image data are paged in by the OS when they are accessed.
+// -----------------------------------------------------------------------
+
+class PackedImageFile
+{
+public:
+    PackedImageFile(const std::wstring& path)
+    {
+        File file(path, fileOptionsBinary | fileOptionsRead | fileOptionsMapped);
+        m_mapping = file.GetMapping();
+        if (!m_mapping)
+            RuntimeError("PackedImageFile: '%ls' cannot be mapped.", path.c_str());
+        file.GetMarker(fileMarkerBeginSection, std::wstring(L"BPIM"));
+        int version;
+        file >> version;
+        if (version != packedImageFileVersion)
+            RuntimeError("PackedImageFile: '%ls' has unsupported version %d.", path.c_str(), version);
+        uint64_t indexOffset, chunkSizeInImages;
+        file >> indexOffset >> chunkSizeInImages;
+        if (indexOffset == 0)
+            RuntimeError("PackedImageFile: '%ls' is incomplete (the writer was not closed).", path.c_str());
+        m_chunkSizeInImages = chunkSizeInImages;
+
+        file.SetPosition(indexOffset);
+        file.GetMarker(fileMarkerBeginSection, std::wstring(L"BIndex"));
+        file >> m_offsets >> m_sizes >> m_labels;
+        file.GetMarker(fileMarkerEndSection, std::wstring(L"EIndex"));
+        if (m_sizes.size() != m_offsets.size() || m_labels.size() != m_offsets.size())
+            RuntimeError("PackedImageFile: '%ls' has an inconsistent index.", path.c_str());
+    }
+
+    size_t GetNumImages() const
+    {
+        return m_offsets.size();
+    }
+    size_t GetChunkSizeInImages() const
+    {
+        return m_chunkSizeInImages;
+    }
+    // the encoded image, in place in the mapping
+    const char* GetImageData(size_t image) const
+    {
+        return m_mapping.get() + m_offsets[image];
+    }
+    size_t GetImageSize(size_t image) const
+    {
+        return m_sizes[image];
+    }
+    int GetLabel(size_t image) const
+    {
+        return m_labels[image];
+    }
+
+private:
+    std::shared_ptr<const char> m_mapping;
+    size_t m_chunkSizeInImages;
+    std::vector<uint64_t> m_offsets;
+    std::vector<uint32_t> m_sizes;
+    std::vector<int32_t> m_labels;
+};
+} } }
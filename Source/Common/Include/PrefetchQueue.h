@@ -0,0 +1,260 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// PrefetchQueue.h -- producer/consumer prefetching of minibatch buffers for readers
+//
+#pragma once
+
+#include "Basics.h"
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <functional>
+#include <exception>
+#include <atomic>
+#include <vector>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// BlockingQueue -- thread-safe FIFO whose pop() waits for an element
+// -----------------------------------------------------------------------
+
+template <typename T>
+class BlockingQueue
+{
+private:
+    std::mutex d_mutex;
+    std::condition_variable d_condition;
+    std::deque<T> d_queue;
+
+public:
+    void push(T const& value)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->d_mutex);
+            d_queue.push_front(value);
+        }
+        this->d_condition.notify_one();
+    }
+    T pop()
+    {
+        std::unique_lock<std::mutex> lock(this->d_mutex);
+        this->d_condition.wait(lock, [=]
+                               {
+                                   return !this->d_queue.empty();
+                               });
+        T rc(std::move(this->d_queue.back()));
+        this->d_queue.pop_back();
+        return rc;
+    }
+    void clear()
+    {
+        std::unique_lock<std::mutex> lock(this->d_mutex);
+        d_queue.clear();
+    }
+};
+
+// -----------------------------------------------------------------------
+// SPSCRing -- bounded lock-free FIFO between one producing and one consuming thread
+//
+// TryPush() fails when the ring is full, TryPop() when it is empty; neither waits. Reset() must not run
+// concurrently with either. (A consumer may move between threads, if each hands over to the next one, e.g. with a
+// std::future.) The capacity is rounded up to a power of 2.
+// -----------------------------------------------------------------------
+
+template <typename T>
+class SPSCRing
+{
+public:
+    explicit SPSCRing(size_t capacity)
+        : m_head(0), m_tail(0)
+    {
+        Reset(capacity);
+    }
+
+    void Reset(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size *= 2;
+        m_slots.assign(size, T());
+        m_mask = size - 1;
+        m_head = 0;
+        m_tail = 0;
+    }
+
+    bool TryPush(const T& value)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == m_slots.size())
+            return false;
+        m_slots[tail & m_mask] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& value)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        value = std::move(m_slots[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> m_slots;
+    size_t m_mask;
+    std::atomic<size_t> m_head; // next to pop; written by the consumer
+    char m_padding[64];         // (keeps the two counters on different cache lines)
+    std::atomic<size_t> m_tail; // next to push; written by the producer
+};
+
+// -----------------------------------------------------------------------
+// BufferPrefetcher -- fills minibatch buffers on a thread of its own, ahead of the reader's GetMinibatch()
+//
+// A fixed set of buffers circulates between the thread, which fills free ones in order, and the consumer, which
+// takes them with Next() and hands them back with Release(). 'fill' returns false at the end of the data; Next()
+// then returns nullptr. What 'fill' throws is rethrown by Next(). Start() and the destructor stop a running thread.
+// -----------------------------------------------------------------------
+
+template <class Buffer>
+class BufferPrefetcher
+{
+public:
+    BufferPrefetcher()
+        : m_stop(false)
+    {
+    }
+
+    ~BufferPrefetcher()
+    {
+        Stop();
+    }
+
+    void Start(size_t numBuffers, std::function<bool(Buffer&)>&& fill)
+    {
+        Stop();
+        while (m_buffers.size() < numBuffers)
+            m_buffers.push_back(std::unique_ptr<Buffer>(new Buffer()));
+        for (const auto& buffer : m_buffers)
+            m_free.push(buffer.get());
+        m_error = nullptr;
+        m_stop = false;
+        m_thread = std::thread([this, fill]
+                               {
+                                   for (;;)
+                                   {
+                                       Buffer* buffer = m_free.pop();
+                                       if (m_stop || !buffer)
+                                           return;
+                                       bool filled;
+                                       try
+                                       {
+                                           filled = fill(*buffer);
+                                       }
+                                       catch (...)
+                                       {
+                                           m_error = std::current_exception();
+                                           filled = false;
+                                       }
+                                       if (!filled)
+                                       {
+                                           m_filled.push(nullptr); // (the end)
+                                           return;
+                                       }
+                                       m_filled.push(buffer);
+                                   }
+                               });
+        m_running = true;
+    }
+
+    // the next filled buffer, or nullptr at the end of the data
+    Buffer* Next()
+    {
+        if (!m_running)
+            return nullptr;
+        Buffer* buffer = m_filled.pop();
+        if (!buffer)
+        {
+            m_filled.push(nullptr); // (stays at the end)
+            if (m_error)
+                std::rethrow_exception(m_error);
+        }
+        return buffer;
+    }
+
+    void Release(Buffer* buffer)
+    {
+        m_free.push(buffer);
+    }
+
+    void Stop()
+    {
+        if (!m_running)
+            return;
+        m_stop = true;
+        m_free.push(nullptr); // (wakes up the thread if it waits for a free buffer)
+        m_thread.join();
+        m_running = false;
+        m_free.clear();
+        m_filled.clear();
+    }
+
+private:
+    std::vector<std::unique_ptr<Buffer>> m_buffers;
+    BlockingQueue<Buffer*> m_free;
+    BlockingQueue<Buffer*> m_filled;
+    std::thread m_thread;
+    bool m_running = false;
+    std::atomic<bool> m_stop;
+    std::exception_ptr m_error; // (written by the thread before it pushes the end)
+};
+
+// -----------------------------------------------------------------------
+// SparseCSCBuffer -- host arrays of one sparse CSC minibatch, as taken by Matrix::SetMatrixFromCSCFormat()
+//
+// The column of every value is kept as well, so that the minibatch can go to the matrix as triplets
+// (SetMatrixFromCOOFormat()), whose CSC structure a GPU matrix builds on the device from a single upload.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+struct SparseCSCBuffer
+{
+    std::vector<ElemType> values;
+    std::vector<int32_t> rowIndices;
+    std::vector<int32_t> colStarts;  // numCols + 1 entries once complete
+    std::vector<int32_t> colIndices; // [value] its column
+
+    void Clear()
+    {
+        values.clear();
+        rowIndices.clear();
+        colStarts.assign(1, 0);
+        colIndices.clear();
+    }
+    // one column of nnz values, followed by their nnz row indices, as stored in the binary formats
+    void AppendColumn(const void* data, int32_t nnz)
+    {
+        const ElemType* columnValues = static_cast<const ElemType*>(data);
+        const int32_t* columnRows = reinterpret_cast<const int32_t*>(columnValues + nnz);
+        values.insert(values.end(), columnValues, columnValues + nnz);
+        rowIndices.insert(rowIndices.end(), columnRows, columnRows + nnz);
+        colIndices.insert(colIndices.end(), nnz, (int32_t) NumCols());
+        colStarts.push_back((int32_t) values.size());
+    }
+    size_t NumCols() const
+    {
+        return colStarts.empty() ? 0 : colStarts.size() - 1;
+    }
+    size_t NumNonZeros() const
+    {
+        return values.size();
+    }
+};
+} } }
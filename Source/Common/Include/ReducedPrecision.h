@@ -0,0 +1,90 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ReducedPrecision.h -- 16-bit formats for exchanged and stored values: IEEE FP16 and bfloat16
+//
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// IEEE 754 binary16, rounding to nearest even; overflows become infinity
+static inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = (uint16_t) ((bits >> 16) & 0x8000);
+    const uint32_t absBits = bits & 0x7fffffff;
+    if (absBits >= 0x7f800000) // Inf or NaN
+        return sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 : 0);
+    if (absBits >= 0x477ff000) // rounds to beyond the largest half
+        return sign | 0x7c00;
+    if (absBits < 0x38800000) // a subnormal half, or 0
+    {
+        if (absBits < 0x33000000)
+            return sign;
+        const uint32_t mantissa = (absBits & 0x7fffff) | 0x800000;
+        const int shift = 126 - (int) (absBits >> 23);
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return sign | (uint16_t) half;
+    }
+    uint32_t half = ((absBits >> 13) - (112 << 10));
+    const uint32_t rest = absBits & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return sign | (uint16_t) half;
+}
+
+static inline float HalfToFloat(uint16_t half)
+{
+    const uint32_t sign = (uint32_t) (half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0x1f)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else if (exponent != 0)
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    else if (mantissa == 0)
+        bits = sign;
+    else // subnormal: normalize
+    {
+        exponent = 113;
+        while (!(mantissa & 0x400))
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// the upper half of a float, rounding to nearest even; the range is that of float
+static inline uint16_t FloatToBFloat16(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffff) > 0x7f800000) // NaN: keep it one
+        return (uint16_t) ((bits >> 16) | 0x40);
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return (uint16_t) (bits >> 16);
+}
+
+static inline float BFloat16ToFloat(uint16_t value)
+{
+    const uint32_t bits = (uint32_t) value << 16;
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+} } }
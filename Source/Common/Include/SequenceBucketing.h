@@ -0,0 +1,102 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// SequenceBucketing.h -- length bucketing of sequences for readers that pack parallel sequences into an MBLayout
+//
+#pragma once
+
+#include "Basics.h"
+#include "Sequences.h"
+#include <vector>
+#include <algorithm>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// BucketSequencesByLength() -- reorder sequences so that those packed into the same minibatch have similar lengths
+//
+// Parallel sequences of an MBLayout are padded with gaps to the longest of them, and every node computes on the
+// gaps. Within each window of windowSize sequences of [begin, end) (which the reader has randomized already),
+// this sorts the sequences by length, cuts the sorted window into groups of groupSize (the number of parallel
+// sequences), and shuffles the order of the groups, so that the minibatches still come in random order.
+// A reader that takes the next groupSize sequences for each minibatch then pads only within a group.
+// -----------------------------------------------------------------------
+
+template <class T, class LengthFn, class RandomEngine>
+void BucketSequencesByLength(std::vector<T>& sequences, size_t begin, size_t end, size_t windowSize, size_t groupSize,
+                             const LengthFn& lengthOf, RandomEngine& engine)
+{
+    if (groupSize <= 1 || windowSize == 0)
+        return;
+    std::vector<T> sorted;
+    std::vector<size_t> groupOrder;
+    for (size_t windowBegin = begin; windowBegin < end; windowBegin += windowSize)
+    {
+        const size_t windowEnd = std::min(windowBegin + windowSize, end);
+        sorted.assign(sequences.begin() + windowBegin, sequences.begin() + windowEnd);
+        std::stable_sort(sorted.begin(), sorted.end(), [&lengthOf](const T& a, const T& b)
+                         {
+                             return lengthOf(a) < lengthOf(b);
+                         });
+
+        const size_t numGroups = (sorted.size() + groupSize - 1) / groupSize;
+        groupOrder.resize(numGroups);
+        for (size_t g = 0; g < numGroups; g++)
+            groupOrder[g] = g;
+        for (size_t g = numGroups; g > 1; g--)
+            std::swap(groupOrder[g - 1], groupOrder[engine() % g]);
+
+        size_t pos = windowBegin;
+        for (size_t g : groupOrder)
+        {
+            const size_t groupBegin = g * groupSize;
+            const size_t groupEnd = std::min(groupBegin + groupSize, sorted.size());
+            for (size_t i = groupBegin; i < groupEnd; i++)
+                sequences[pos++] = sorted[i];
+        }
+    }
+}
+
+// -----------------------------------------------------------------------
+// GapFrameCounter -- accumulates the fraction of gap frames in the minibatches of a reader, for reporting
+// -----------------------------------------------------------------------
+
+class GapFrameCounter
+{
+public:
+    GapFrameCounter()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        m_numMinibatches = 0;
+        m_numFrames = 0;
+        m_numGapFrames = 0;
+    }
+
+    void Add(const MBLayout& layout)
+    {
+        m_numMinibatches++;
+        m_numFrames += layout.GetNumCols();
+        m_numGapFrames += layout.GetNumCols() - layout.GetActualNumSamples();
+    }
+
+    // prints and resets the statistics since the last report, if any
+    void Report(const char* readerName)
+    {
+        if (m_numFrames == 0)
+            return;
+        fprintf(stderr, "%s: %.1f%% of the minibatch columns were gaps (%d of %d in %d minibatches).\n",
+                readerName, 100.0 * m_numGapFrames / m_numFrames, (int) m_numGapFrames, (int) m_numFrames, (int) m_numMinibatches);
+        Reset();
+    }
+
+private:
+    size_t m_numMinibatches;
+    size_t m_numFrames;
+    size_t m_numGapFrames;
+};
+} } }
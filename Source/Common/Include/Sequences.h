@@ -397,7 +397,9 @@ private:
     // TODO: We actually just need a boolean matrix for this.
     // A value of 1 indicates that the column has valid content
     // and 0 indicates invalid (aka MinibatchPackingFlags::NoInput)
+    // Init() only empties it, so that its buffer (and that of the CPU-side copy it is formed in) is reused by the next minibatch.
     mutable Matrix<char> m_columnsValidityMask;
+    mutable std::vector<char> m_columnsValidityMaskBuffer;
 
     // A boolean flag indicating whether the MBLayout can be further modified
     // When it's value is false, no set operations are allowed on the MBLayout.
@@ -676,29 +678,25 @@ inline const Matrix<char> &MBLayout::GetColumnsValidityMask(DEVICEID_TYPE device
         assert(HasGaps()); // must only be called if there are gaps
         Lock();
 
-        // Determine indices of all invalid columns in the minibatch
-        // TODO: This can be done more efficiently by using m_sequences[].
+        // Determine indices of all invalid columns in the minibatch, from the gap sequences
         size_t nT = GetNumTimeSteps();
         size_t nS = GetNumParallelSequences();
 
-        std::vector<char> columnsValidityMask(nT * nS, 1); // form the mask in a CPU-side STL vector first
+        auto& columnsValidityMask = m_columnsValidityMaskBuffer; // form the mask in a CPU-side STL vector first
+        columnsValidityMask.assign(nT * nS, 1);
         size_t gapsFound = 0;
-        for (size_t t = 0; t < nT; t++)
+        for (const auto& seq : m_sequences)
         {
-            FrameRange fr(nullptr, t);
-            if (IsGap(fr))
-            {
-                for (size_t s = 0; s < nS; s++)
-                {
-                    if (IsGap(fr.Sequence(s)))
-                    {
-                        columnsValidityMask[(t * nS) + s] = 0;
-                        gapsFound++;
-                    }
-                }
-            }
+            if (seq.seqId != GAP_SEQUENCE_ID)
+                continue;
+            const size_t b = (size_t) max(seq.tBegin, (ptrdiff_t) 0);
+            const size_t e = min(seq.tEnd, nT);
+            for (size_t t = b; t < e; t++)
+                columnsValidityMask[(t * nS) + seq.s] = 0;
+            gapsFound += e - b;
         }
         assert(gapsFound == m_numGapFrames); // sanity check
+        UNUSED(gapsFound);
 
         if (deviceId != m_columnsValidityMask.GetDeviceId())
             m_columnsValidityMask = Matrix<char>(deviceId);
@@ -960,4 +958,30 @@ static inline void MaskMissingColumnsTo(Matrix<ElemType> &matrixToMask, const MB
 #endif
     }
 }
+
+// -----------------------------------------------------------------------
+// GetSequenceBoundsAsMatrix() -- the sequences of an MBLayout as a 3 x numSequences matrix of
+// (parallel sequence, first time step, end time step), clipped to the minibatch and without gaps.
+// This is the input of the Matrix functions that process all sequences of a minibatch in one call, e.g. Matrix::CRFForwardBackward().
+// 'buffer' is scratch memory owned by the caller.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+static inline void GetSequenceBoundsAsMatrix(const MBLayoutPtr &pMBLayout, Matrix<ElemType> &sequenceBounds, std::vector<ElemType> &buffer)
+{
+    const size_t T = pMBLayout->GetNumTimeSteps();
+    buffer.clear();
+    for (const auto &seq : pMBLayout->GetAllSequences())
+    {
+        if (seq.seqId == GAP_SEQUENCE_ID)
+            continue;
+        buffer.push_back((ElemType) seq.s);
+        buffer.push_back((ElemType) max(seq.tBegin, (ptrdiff_t) 0));
+        buffer.push_back((ElemType) min(seq.tEnd, T));
+    }
+    if (buffer.empty())
+        sequenceBounds.Resize(3, 0);
+    else
+        sequenceBounds.SetValue(3, buffer.size() / 3, sequenceBounds.GetDeviceId(), buffer.data(), matrixFlagNormal);
+}
 } } }
@@ -564,6 +564,21 @@ public:
         result.DropDimsInPlace(toDrop);
         return result;
     }
+    TensorShape& PermuteDimsInPlace(const SmallVector<size_t>& permutation) // new dimension [k] is old [permutation[k]], retaining strides (no copy)
+    {
+        // A permutation[k] beyond the rank inserts a singleton dimension there, e.g. to line up the axes of the
+        // operands of a contraction. Dimensions not referenced are dropped, which implies a slice to [0] for them.
+        SmallVector<size_t> dims(permutation.size());
+        SmallVector<ptrdiff_t> strides(permutation.size());
+        for (size_t k = 0; k < permutation.size(); k++)
+        {
+            dims[k] = permutation[k] < size() ? m_dims[permutation[k]] : 1;
+            strides[k] = permutation[k] < size() ? m_strides[permutation[k]] : 0;
+        }
+        m_dims = dims;
+        m_strides = strides;
+        return *this;
+    }
     TensorShape& SetBroadcastStrides() // set strides to 0 for broadcasting dimensions
     {
         for (size_t k = 0; k < size(); k++)
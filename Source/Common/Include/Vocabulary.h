@@ -0,0 +1,183 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Vocabulary.h -- word-to-ID maps of the text readers, as interned strings with hashed lookup
+//
+#pragma once
+
+#include "Basics.h"
+#include "File.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// Vocabulary -- a map from words to IDs
+//
+// The words are kept back to back in one buffer and looked up through an open-addressing hash table of entry
+// indices (linear probing, at most half full), so a lookup hashes the characters once and compares with one or a
+// few words of the buffer. Find() also takes a pointer and a length, so tokens need not be copied into strings.
+// Words are never removed; Set() on a word that is already there changes its ID. Word(i) and Id(i) enumerate the
+// entries in the order they were added. Write() and Read() keep a vocabulary in a binary file, so that a text
+// vocabulary need not be parsed again.
+// -----------------------------------------------------------------------
+
+template <class CharType, class IdType>
+class Vocabulary
+{
+public:
+    typedef std::basic_string<CharType> StringType;
+
+    Vocabulary()
+    {
+        clear();
+    }
+
+    size_t size() const { return m_ids.size(); }
+    bool empty() const { return m_ids.empty(); }
+
+    void clear()
+    {
+        m_chars.clear();
+        m_offsets.assign(1, 0);
+        m_ids.clear();
+        m_slots.assign(minSlots, emptySlot);
+    }
+
+    bool Find(const CharType* word, size_t length, IdType& id) const
+    {
+        const size_t entry = m_slots[FindSlot(word, length)];
+        if (entry == emptySlot)
+            return false;
+        id = m_ids[entry];
+        return true;
+    }
+    bool Find(const StringType& word, IdType& id) const
+    {
+        return Find(word.data(), word.size(), id);
+    }
+    bool Contains(const StringType& word) const
+    {
+        IdType id;
+        return Find(word, id);
+    }
+    // the ID of a word that must be there
+    IdType operator[](const StringType& word) const
+    {
+        IdType id;
+        if (!Find(word, id))
+            RuntimeError("Vocabulary: a word of %d characters is not in the vocabulary.", (int) word.size());
+        return id;
+    }
+
+    // add the word, or change its ID
+    void Set(const StringType& word, IdType id)
+    {
+        const size_t slot = FindSlot(word.data(), word.size());
+        if (m_slots[slot] != emptySlot)
+        {
+            m_ids[m_slots[slot]] = id;
+            return;
+        }
+        m_slots[slot] = m_ids.size();
+        m_chars.insert(m_chars.end(), word.begin(), word.end());
+        m_offsets.push_back(m_chars.size());
+        m_ids.push_back(id);
+        if (2 * m_ids.size() > m_slots.size())
+            Rehash(2 * m_slots.size());
+    }
+
+    // the word and ID of an entry, in the order of adding
+    StringType Word(size_t entry) const
+    {
+        return StringType(m_chars.data() + m_offsets[entry], m_offsets[entry + 1] - m_offsets[entry]);
+    }
+    IdType Id(size_t entry) const
+    {
+        return m_ids[entry];
+    }
+
+    void Write(File& fstream) const
+    {
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVocabulary");
+        fstream << (size_t) 1 /*version*/ << sizeof(CharType) << sizeof(IdType) << m_ids.size() << m_chars.size();
+        fstream.PutArray(m_chars.data(), m_chars.size());
+        fstream.PutArray(m_offsets.data(), m_offsets.size());
+        fstream.PutArray(m_ids.data(), m_ids.size());
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVocabulary");
+    }
+
+    void Read(File& fstream)
+    {
+        fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BVocabulary");
+        size_t version, charSize, idSize, numEntries, numChars;
+        fstream >> version >> charSize >> idSize >> numEntries >> numChars;
+        if (version != 1 || charSize != sizeof(CharType) || idSize != sizeof(IdType))
+            RuntimeError("Vocabulary: unsupported version %d, or words or IDs of a different type.", (int) version);
+        m_chars.resize(numChars);
+        m_offsets.resize(numEntries + 1);
+        m_ids.resize(numEntries);
+        fstream.GetArray(m_chars.data(), m_chars.size());
+        fstream.GetArray(m_offsets.data(), m_offsets.size());
+        fstream.GetArray(m_ids.data(), m_ids.size());
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EVocabulary");
+        if (m_offsets.front() != 0 || m_offsets.back() != numChars)
+            RuntimeError("Vocabulary: inconsistent word offsets.");
+        size_t numSlots = minSlots;
+        while (numSlots < 2 * numEntries)
+            numSlots *= 2;
+        Rehash(numSlots);
+    }
+
+private:
+    enum : size_t
+    {
+        emptySlot = SIZE_MAX,
+        minSlots = 16 // (a power of 2, as all table sizes)
+    };
+
+    static size_t Hash(const CharType* word, size_t length) // FNV-1a over the characters
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < length; i++)
+            hash = (hash ^ (uint64_t) word[i]) * 1099511628211ull;
+        return (size_t) (hash ^ (hash >> 32));
+    }
+
+    // the slot of the word, or the empty slot it would go into
+    size_t FindSlot(const CharType* word, size_t length) const
+    {
+        const size_t mask = m_slots.size() - 1;
+        for (size_t slot = Hash(word, length) & mask;; slot = (slot + 1) & mask)
+        {
+            const size_t entry = m_slots[slot];
+            if (entry == emptySlot)
+                return slot;
+            const size_t begin = m_offsets[entry];
+            if (m_offsets[entry + 1] - begin == length && std::equal(word, word + length, m_chars.begin() + begin))
+                return slot;
+        }
+    }
+
+    void Rehash(size_t numSlots)
+    {
+        m_slots.assign(numSlots, emptySlot);
+        const size_t mask = numSlots - 1;
+        for (size_t entry = 0; entry < m_ids.size(); entry++)
+        {
+            size_t slot = Hash(m_chars.data() + m_offsets[entry], m_offsets[entry + 1] - m_offsets[entry]) & mask;
+            while (m_slots[slot] != emptySlot)
+                slot = (slot + 1) & mask;
+            m_slots[slot] = entry;
+        }
+    }
+
+    std::vector<CharType> m_chars;   // the words, back to back
+    std::vector<size_t> m_offsets;   // [entry] start of its word in m_chars; [size()] the end
+    std::vector<IdType> m_ids;       // [entry]
+    std::vector<size_t> m_slots;     // hash table of entries
+};
+} } }
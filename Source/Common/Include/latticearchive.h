@@ -14,6 +14,7 @@
 #include <inttypes.h>
 
 #include "Basics.h"
+#include "File.h" // for mapped archives
 #include "latticestorage.h"
 #include "simple_checked_arrays.h"
 #include "fileutil.h"
@@ -938,6 +939,47 @@ public:
 #endif
     }
 
+    // V3 format for mapped archives (see archive::convertmapped()): the V1 arrays as they are in memory, which is also
+    // how they are uploaded to the GPU, each starting at a multiple of File::alignedBlockAlignment.
+    // Reading it is a copy (or, from a FILE, a read) per array, without decompression or unit mapping in most cases.
+    static const size_t mappedalignment = Microsoft::MSR::CNTK::File::alignedBlockAlignment;
+    static size_t alignmentpadding(uint64_t pos)
+    {
+        return (size_t) ((mappedalignment - pos % mappedalignment) % mappedalignment);
+    }
+    static void fwritepadding(FILE* f)
+    {
+        static const char zeros[mappedalignment] = {0};
+        const size_t padding = alignmentpadding(fgetpos(f));
+        if (padding > 0)
+            fwriteOrDie(zeros, 1, padding, f);
+    }
+
+    template <class VECTOR>
+    void fwritealignedvector(FILE* f, const char* tag, const VECTOR& v)
+    {
+        fwritetag(f, tag, v.size());
+        fwritepadding(f);
+        if (!v.empty())
+            fwriteOrDie(v, f);
+    }
+
+    // write in V3 format; 'f' must be positioned at an aligned offset
+    void fwritemapped(FILE* f)
+    {
+        if (alignmentpadding(fgetpos(f)) != 0)
+            LogicError("fwritemapped: lattice must start at an aligned file offset");
+        if (nodes.size() != info.numnodes || edges.size() != info.numedges)
+            LogicError("fwritemapped: lattice arrays are inconsistent with its header");
+        const size_t version = 3; // format version
+        fwritetag(f, "LAT ", version);
+        fwriteOrDie(&info, sizeof(info), 1, f);
+        fwritealignedvector(f, "NODE", nodes);
+        fwritealignedvector(f, "EDGE", edges);
+        fwritealignedvector(f, "ALIG", align);
+        fputTag(f, "END ");
+    }
+
     // empty constructor, e.g. for use in minibatch source
     lattice()
     {
@@ -958,6 +1000,90 @@ public:
         freadOrDie(v, sz, f);
     }
 
+    template <class VECTOR>
+    void freadalignedvector(FILE* f, const char* tag, VECTOR& v, size_t expectedsize = SIZE_MAX)
+    {
+        const size_t sz = freadtag(f, tag);
+        if (expectedsize != SIZE_MAX && sz != expectedsize)
+            RuntimeError("freadalignedvector: malformed file, number of vector elements differs from head, for tag %s", tag);
+        const uint64_t pos = fgetpos(f);
+        fsetpos(f, pos + alignmentpadding(pos));
+        freadOrDie(v, sz, f);
+    }
+
+    // check if 'idmap' maps every unit onto itself, in which case aligns need no update
+    // This is critical--we have a buggy lattice set that requires no mapping where mapping would fail.
+    template <class IDMAP>
+    static bool isidentitymapping(const IDMAP& idmap, size_t spunit)
+    {
+        foreach_index (k, idmap)
+        {
+            if (idmap[k] != (size_t) k
+#if 1
+                && (k != (int) idmap.size() - 1 || idmap[k] != spunit) // that HACK that we add one more /sp/ entry at the end...
+#endif
+                )
+                return false;
+        }
+        return true;
+    }
+
+    // the V3 reading from a mapping: tags are parsed in place, and every read is checked against the end of the mapping
+    static size_t getmappedtag(const char*& p, const char* end, const char* tag)
+    {
+        int n;
+        if ((size_t)(end - p) < 4 + sizeof(n) || memcmp(p, tag, 4) != 0)
+            RuntimeError("readmapped: malformed mapped archive, expected tag %s", tag);
+        memcpy(&n, p + 4, sizeof(n));
+        p += 4 + sizeof(n);
+        return (unsigned int) n;
+    }
+
+    template <class VECTOR>
+    static void getmappedvector(const char*& p, const char* end, const char* tag, VECTOR& v, size_t expectedsize = SIZE_MAX)
+    {
+        typedef typename VECTOR::value_type T;
+        const size_t sz = getmappedtag(p, end, tag);
+        if (expectedsize != SIZE_MAX && sz != expectedsize)
+            RuntimeError("readmapped: malformed mapped archive, number of vector elements differs from head, for tag %s", tag);
+        p += alignmentpadding((uintptr_t) p); // (mappings start at page boundaries, so addresses are aligned like file offsets)
+        if (p > end || (size_t)(end - p) / sizeof(T) < sz)
+            RuntimeError("readmapped: malformed mapped archive, vector for tag %s exceeds the end of the file", tag);
+        v.assign((const T*) p, (const T*) p + sz);
+        p += sz * sizeof(T);
+    }
+
+    // read a V3 lattice from a mapping; [p, end) is the part of the mapped archive from the start of the lattice
+    // Like fread(), this replaces the content of an existing object and is safe to be used in retry loops.
+    template <class IDMAP>
+    void readmapped(const char* p, const char* end, const IDMAP& idmap, size_t spunit)
+    {
+        if (getmappedtag(p, end, "LAT ") != 3)
+            RuntimeError("readmapped: unsupported lattice format version in mapped archive");
+        if ((size_t)(end - p) < sizeof(info))
+            RuntimeError("readmapped: malformed mapped archive, truncated lattice header");
+        memcpy(&info, p, sizeof(info));
+        p += sizeof(info);
+        getmappedvector(p, end, "NODE", nodes, info.numnodes);
+        if (nodes.empty() || nodes.back().t != info.numframes)
+            RuntimeError("readmapped: mismatch between info.numframes and last node's time");
+        getmappedvector(p, end, "EDGE", edges, info.numedges);
+        getmappedvector(p, end, "ALIG", align);
+        if ((size_t)(end - p) < 4 || memcmp(p, "END ", 4) != 0)
+            RuntimeError("readmapped: malformed mapped archive, expected tag END ");
+        mapunits(idmap, spunit);
+    }
+
+    // map align ids of a V1 or V3 lattice to user's symmap  --the lattice gets updated in place here
+    template <class IDMAP>
+    void mapunits(const IDMAP& idmap, size_t spunit)
+    {
+        if (isidentitymapping(idmap, spunit))
+            return;
+        foreach_index (k, align)
+            align[k].updateunit(idmap); // updates itself
+    }
+
     // read from a stream
     // This can be used on an existing structure and will replace its content. May be useful to avoid memory allocations (resize() will not shrink memory).
     // For efficiency, we will not check the inner consistency of the file here, but rather when we further process it.
@@ -965,6 +1091,7 @@ public:
     // If this fails, the lattice is in unusable state, but it is OK to call fread() again to regain a usable object. I.e. this is safe to be used in retry loops.
     // This will also map the aligninfo entries to the new symbol table, through idmap.
     // V1 lattices will be converted. 'spsenoneid' is used in that process.
+    // V3 lattices (mapped archives) are normally read through readmapped(); this reads them from a file that cannot be mapped.
     template <class IDMAP>
     void fread(FILE* f, const IDMAP& idmap, size_t spunit)
     {
@@ -999,20 +1126,7 @@ public:
                 RuntimeError("fread: out of bounds spunitid");
             }
 #endif
-            // This is critical--we have a buggy lattice set that requires no mapping where mapping would fail
-            bool needsmapping = false;
-            foreach_index (k, idmap)
-            {
-                if (idmap[k] != (size_t) k
-#if 1
-                    && (k != (int) idmap.size() - 1 || idmap[k] != spunit) // that HACK that we add one more /sp/ entry at the end...
-#endif
-                    )
-                {
-                    needsmapping = true;
-                    break;
-                }
-            }
+            const bool needsmapping = !isidentitymapping(idmap, spunit);
             // map align ids to user's symmap  --the lattice gets updated in place here
             if (needsmapping)
             {
@@ -1060,6 +1174,17 @@ public:
             // reconstruct old lattice format from this   --TODO: remove once we change to new data representation
             rebuildedges(info.impliedspunitid != spunit /*to be able to read somewhat broken V2 lattice archives*/);
         }
+        else if (version == 3)
+        {
+            freadOrDie(&info, sizeof(info), 1, f);
+            freadalignedvector(f, "NODE", nodes, info.numnodes);
+            if (nodes.back().t != info.numframes)
+                RuntimeError("fread: mismatch between info.numframes and last node's time");
+            freadalignedvector(f, "EDGE", edges, info.numedges);
+            freadalignedvector(f, "ALIG", align);
+            fcheckTag(f, "END ");
+            mapunits(idmap, spunit);
+        }
         else
             RuntimeError("fread: unsupported lattice format version");
     }
@@ -1095,12 +1220,29 @@ public:
         void setdevice(size_t DeviceId);
         size_t getdevice();
         void release(bool cpumode);
-        void setloglls(const Microsoft::MSR::CNTK::Matrix<float>& loglls);
+        void setloglls(const Microsoft::MSR::CNTK::Matrix<float>& loglls); // (not copied; must outlive forwardbackward())
         void setloglls(const Microsoft::MSR::CNTK::Matrix<double>& loglls);
+        // have the next forwardbackward() write the gammas (or the sMBR error signal) straight into 'gammas' [senones x frames] on the GPU,
+        // instead of into a buffer of its own, which getgamma() would then copy; the host result matrix is not filled in that case
+        void setgammas(Microsoft::MSR::CNTK::Matrix<float>& gammas);
+        void setgammas(Microsoft::MSR::CNTK::Matrix<double>& gammas);
         void getgamma(Microsoft::MSR::CNTK::Matrix<float>& loglls);
         void getgamma(Microsoft::MSR::CNTK::Matrix<double>& loglls);
     };
 
+    // batched forward-backward for all lattices of a minibatch on the GPU (defined in parallelforwardbackward.cpp)
+    // logLLs, uids, and errorsignal hold the utterances of the lattices concatenated. Returns false if the lattices cannot be batched.
+    static bool parallelforwardbackwardbatch(parallelstate& parallelstate, const std::vector<const lattice*>& lattices,
+                                             const class msra::asr::simplesenonehmm& hset, const Microsoft::MSR::CNTK::Matrix<float>& logLLs,
+                                             const std::vector<size_t>& uids, const float lmf, const float wp, const float amf,
+                                             const float boostingfactor, const bool sMBRmode,
+                                             Microsoft::MSR::CNTK::Matrix<float>& errorsignal, std::vector<double>& results);
+    static bool parallelforwardbackwardbatch(parallelstate& parallelstate, const std::vector<const lattice*>& lattices,
+                                             const class msra::asr::simplesenonehmm& hset, const Microsoft::MSR::CNTK::Matrix<double>& logLLs,
+                                             const std::vector<size_t>& uids, const float lmf, const float wp, const float amf,
+                                             const float boostingfactor, const bool sMBRmode,
+                                             Microsoft::MSR::CNTK::Matrix<double>& errorsignal, std::vector<double>& results);
+
     // forward-backward function
     // Note: logLLs and posteriors may be the same matrix (aliased).
     double forwardbackward(parallelstate& parallelstate, const class msra::math::ssematrixbase& logLLs, const class msra::asr::simplesenonehmm& hmms,
@@ -1213,6 +1355,47 @@ class archive
 
     mutable size_t currentarchiveindex;               // which archive is open
     mutable auto_file_ptr f;                          // cached archive file handle of currentarchiveindex
+    // mapped archives (see convertmapped()) are mapped as a whole when first accessed, and lattices are copied out of the mapping
+    struct mappedarchive
+    {
+        std::shared_ptr<const char> mapping; // null if the archive is not a mapped archive (or cannot be mapped)
+        size_t size;
+        bool checked;
+        mappedarchive()
+            : size(0), checked(false)
+        {
+        }
+    };
+    mutable std::vector<mappedarchive> mappedarchives; // [archiveindex]
+    const mappedarchive& getmappedarchive(size_t archiveindex) const
+    {
+        mappedarchive& m = mappedarchives[archiveindex];
+        if (!m.checked)
+        {
+            {
+                auto_file_ptr probe;
+                probe = fopenOrDie(archivepaths[archiveindex], L"rbS");
+                char tag[4];
+                if (::fread(tag, 1, sizeof(tag), probe) != sizeof(tag) || memcmp(tag, "LMAP", sizeof(tag)) != 0)
+                {
+                    m.checked = true; // a regular archive, read with fread()
+                    return m;
+                }
+                int version;
+                if (::fread(&version, sizeof(version), 1, probe) != 1 || version != mappedarchiveversion)
+                    RuntimeError("getlattice: unsupported mapped archive version in '%S'", archivepaths[archiveindex].c_str());
+            }
+            using namespace Microsoft::MSR::CNTK;
+            File file(archivepaths[archiveindex], fileOptionsBinary | fileOptionsRead | fileOptionsMapped);
+            m.size = (size_t) file.Size();
+            m.mapping = file.GetMapping();
+            if (!m.mapping)
+                fprintf(stderr, "getlattice: mapped archive '%S' cannot be mapped, reading it with fread() instead\n", archivepaths[archiveindex].c_str());
+            m.checked = true;
+        }
+        return m;
+    }
+    static const int mappedarchiveversion = 1;
     std::unordered_map<std::wstring, latticeref> toc; // [key] -> (file, offset)  --table of content (.toc file)
 public:
     // construct = open the archive
@@ -1294,6 +1477,7 @@ public:
 
         // initialize symmaps  --alloc the array, but actually read the symmap on demand
         symmaps.resize(archivepaths.size());
+        mappedarchives.resize(archivepaths.size());
     }
 
     // check if a lattice for a given key is available  --do this during initial check ideally
@@ -1319,6 +1503,7 @@ public:
     // 'key' is supposed to be known to exist. Use haslattice() to ensure. This is because this function is called from a retry loop.
     // Lattices will have unit ids updated according to the modelsymmap.
     // V1 lattices will be converted. 'spsenoneid' is used in the conversion for optimizing storing 0-frame /sp/ aligns.
+    // Lattices of mapped archives are copied out of the mapping instead.
     void getlattice(const std::wstring& key, lattice& L,
                     size_t expectedframes = SIZE_MAX /*if unknown*/) const
     {
@@ -1336,18 +1521,28 @@ public:
         if (spunit2 != spunit)
             LogicError("getlattice: huh? same lookup of /sp/ gives different result?");
 #endif
+        const mappedarchive& mapped = getmappedarchive(archiveindex);
         // open archive file in case it is not the current one
-        if (archiveindex != currentarchiveindex)
+        if (!mapped.mapping && archiveindex != currentarchiveindex)
         {
             f = fopenOrDie(archivepaths[archiveindex], L"rbS"); // or throw (will close old 'f' iff succeeded)
             currentarchiveindex = archiveindex;
         }
         try // (for read operation)
         {
-            // seek to start
-            fsetpos(f, offset);
-            // get it
-            L.fread(f, idmap, spunit);
+            if (mapped.mapping)
+            {
+                if (offset >= mapped.size)
+                    RuntimeError("getlattice: TOC offset beyond the end of mapped archive '%S'", archivepaths[archiveindex].c_str());
+                L.readmapped(mapped.mapping.get() + offset, mapped.mapping.get() + mapped.size, idmap, spunit);
+            }
+            else
+            {
+                // seek to start
+                fsetpos(f, offset);
+                // get it
+                L.fread(f, idmap, spunit);
+            }
             L.setverbosity(verbosity);
 #ifdef HACK_IN_SILENCE // hack to simulate DEL in the lattice
             const size_t silunit = getid(modelsymmap, "sil");
@@ -1381,6 +1576,11 @@ public:
     //  - merge two lattices (for merging numer into denom lattices)
     static void convert(const std::wstring& intocpath, const std::wstring& intocpath2, const std::wstring& outpath,
                         const msra::asr::simplesenonehmm& hset);
+
+    // static method for converting an archive to a mapped archive (V3 lattices at aligned offsets, behind an "LMAP" header)
+    // The TOC and .symlist files are written as for convert(). getlattice() recognizes mapped archives by their header.
+    static void convertmapped(const std::wstring& intocpath, const std::wstring& outpath,
+                              const msra::asr::simplesenonehmm& hset);
 };
 };
 };
@@ -0,0 +1,149 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ssefloat8.h -- AVX2/FMA versions of the float4 inner loops of ssematrix, used if the CPU supports them
+//
+
+#pragma once
+
+#include <stddef.h>
+#ifdef _WIN32
+#include <intrin.h> // for __cpuid()
+#endif
+#include <immintrin.h>
+
+// The kernels get compiled for AVX2 and FMA regardless of the flags the rest of the code is built with, so that
+// binaries built for the baseline instruction set use them where possible. Visual C++ accepts the intrinsics
+// anywhere; gcc and clang need to be told per function.
+#ifdef _MSC_VER
+#define SSEFLOAT8_AVX2_TARGET
+#else
+#define SSEFLOAT8_AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+
+namespace msra { namespace math { namespace float8 {
+
+// ===========================================================================
+// The loops work on vectors of n floats, n a multiple of 4 (ssematrix pads its columns to that), with no alignment
+// requirement beyond that of float4. Each processes 8 floats per step, and the 4 left over with SSE. The dot
+// products accumulate in 8 lanes instead of 4, so their results may differ from the float4 loops in the last bits.
+// ===========================================================================
+
+// AVX2 and FMA, supported by the CPU and enabled by the OS; determined once
+static inline bool detectavx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0; // OS saves the YMM registers on context switches...
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6) // ...and has enabled them
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+inline bool available()
+{
+    static const bool hasavx2 = detectavx2();
+    return hasavx2;
+}
+
+SSEFLOAT8_AVX2_TARGET static inline float hsum(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+// a' * b
+SSEFLOAT8_AVX2_TARGET inline float dotprod(const float *a, const float *b, size_t n)
+{
+    __m256 acc = _mm256_setzero_ps();
+    size_t k = 0;
+    for (; k + 8 <= n; k += 8)
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + k), _mm256_loadu_ps(b + k), acc);
+    float tail = 0.0f;
+    if (k < n)
+        tail = _mm_cvtss_f32(_mm_dp_ps(_mm_load_ps(a + k), _mm_load_ps(b + k), 0xf1));
+    return hsum(acc) + tail;
+}
+
+// row' * cols4[k * cols4stride ...] for k = 0..3, into result[k]
+SSEFLOAT8_AVX2_TARGET inline void dotprod4(const float *row, const float *cols4, size_t cols4stride, size_t n, float result[4])
+{
+    const float *col0 = cols4;
+    const float *col1 = cols4 + cols4stride;
+    const float *col2 = cols4 + 2 * cols4stride;
+    const float *col3 = cols4 + 3 * cols4stride;
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    __m256 acc3 = _mm256_setzero_ps();
+    size_t k = 0;
+    for (; k + 8 <= n; k += 8)
+    {
+        const __m256 r = _mm256_loadu_ps(row + k);
+        acc0 = _mm256_fmadd_ps(r, _mm256_loadu_ps(col0 + k), acc0);
+        acc1 = _mm256_fmadd_ps(r, _mm256_loadu_ps(col1 + k), acc1);
+        acc2 = _mm256_fmadd_ps(r, _mm256_loadu_ps(col2 + k), acc2);
+        acc3 = _mm256_fmadd_ps(r, _mm256_loadu_ps(col3 + k), acc3);
+    }
+    float tail[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    if (k < n)
+    {
+        const __m128 r = _mm_load_ps(row + k);
+        tail[0] = _mm_cvtss_f32(_mm_dp_ps(r, _mm_load_ps(col0 + k), 0xf1));
+        tail[1] = _mm_cvtss_f32(_mm_dp_ps(r, _mm_load_ps(col1 + k), 0xf1));
+        tail[2] = _mm_cvtss_f32(_mm_dp_ps(r, _mm_load_ps(col2 + k), 0xf1));
+        tail[3] = _mm_cvtss_f32(_mm_dp_ps(r, _mm_load_ps(col3 + k), 0xf1));
+    }
+    result[0] = hsum(acc0) + tail[0];
+    result[1] = hsum(acc1) + tail[1];
+    result[2] = hsum(acc2) + tail[2];
+    result[3] = hsum(acc3) + tail[3];
+}
+
+// us = us * thisweight + other * weight; us is not read if thisweight is 0
+SSEFLOAT8_AVX2_TARGET inline void addweighted(float *us, float thisweight, const float *other, float weight, size_t n)
+{
+    const __m256 w = _mm256_set1_ps(weight);
+    const __m256 tw = _mm256_set1_ps(thisweight);
+    size_t k = 0;
+    if (thisweight == 0.0f)
+    {
+        for (; k + 8 <= n; k += 8)
+            _mm256_storeu_ps(us + k, _mm256_mul_ps(_mm256_loadu_ps(other + k), w));
+        if (k < n)
+            _mm_store_ps(us + k, _mm_mul_ps(_mm_load_ps(other + k), _mm256_castps256_ps128(w)));
+    }
+    else
+    {
+        for (; k + 8 <= n; k += 8)
+            _mm256_storeu_ps(us + k, _mm256_fmadd_ps(_mm256_loadu_ps(us + k), tw, _mm256_mul_ps(_mm256_loadu_ps(other + k), w)));
+        if (k < n)
+            _mm_store_ps(us + k, _mm_fmadd_ps(_mm_load_ps(us + k), _mm256_castps256_ps128(tw), _mm_mul_ps(_mm_load_ps(other + k), _mm256_castps256_ps128(w))));
+    }
+}
+
+// us = us * factor
+SSEFLOAT8_AVX2_TARGET inline void scale(float *us, float factor, size_t n)
+{
+    const __m256 f = _mm256_set1_ps(factor);
+    size_t k = 0;
+    for (; k + 8 <= n; k += 8)
+        _mm256_storeu_ps(us + k, _mm256_mul_ps(_mm256_loadu_ps(us + k), f));
+    if (k < n)
+        _mm_store_ps(us + k, _mm_mul_ps(_mm_load_ps(us + k), _mm256_castps256_ps128(f)));
+}
+} } }
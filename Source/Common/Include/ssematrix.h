@@ -13,6 +13,7 @@
 #include "Platform.h"
 #include "simple_checked_arrays.h" // ... for dotprod(); we can eliminate this I believe
 #include "ssefloat4.h"
+#include "ssefloat8.h"
 #include <stdexcept>
 #ifndef __unix__
 #include <ppl.h>
@@ -20,6 +21,7 @@
 #include "numahelpers.h"
 #endif
 #include "fileutil.h" // for saving and reading matrices
+#include "HugePageMemAllocator.h" // for large buffers
 #include <limits>     // for NaN
 #include <malloc.h>
 
@@ -387,17 +389,24 @@ public:
         assert((15 & reinterpret_cast<uintptr_t>(&b[0])) == 0); // enforce SSE alignment
 
         size_t nlong = (a.size() + 3) / 4; // number of SSE elements
-        const msra::math::float4 *pa = (const msra::math::float4 *) &a[0];
-        const msra::math::float4 *pb = (const msra::math::float4 *) &b[0];
+        float sum;
+        if (msra::math::float8::available())
+            sum = msra::math::float8::dotprod(&a[0], &b[0], 4 * nlong);
+        else
+        {
+            const msra::math::float4 *pa = (const msra::math::float4 *) &a[0];
+            const msra::math::float4 *pb = (const msra::math::float4 *) &b[0];
 
-        msra::math::float4 acc = pa[0] * pb[0];
-        for (size_t m = 1; m < nlong; m++)
-            acc += pa[m] * pb[m];
+            msra::math::float4 acc = pa[0] * pb[0];
+            for (size_t m = 1; m < nlong; m++)
+                acc += pa[m] * pb[m];
+            sum = acc.sum();
+        }
         // final sum
         if (addtoresult)
-            result = result * thisscale + weight * acc.sum();
+            result = result * thisscale + weight * sum;
         else
-            result = acc.sum();
+            result = sum;
     }
 
     // dot product of a matrix row with 4 columns at the same time
@@ -428,6 +437,15 @@ public:
         // perform multiple columns in parallel
         const size_t nlong = (row.size() + 3) / 4; // number of SSE elements
 
+        if (msra::math::float8::available())
+        {
+            float sums[4];
+            msra::math::float8::dotprod4(&row[0], &cols4[0], cols4stride, 4 * nlong, sums);
+            for (size_t k = 0; k < 4; k++)
+                usij[k * usijstride] = addtoresult ? usij[k * usijstride] * thisscale + weight * sums[k] : sums[k];
+            return;
+        }
+
         // row
         const msra::math::float4 *prow = (const msra::math::float4 *) &row[0];
 
@@ -788,6 +806,8 @@ public:
         assert(us4.size() == other4.size());
 
         // perform the operation on one long vector
+        if (msra::math::float8::available())
+            return msra::math::float8::addweighted((float *) us4.begin(), thisweight, (const float *) other4.begin(), weight, 4 * us4.size());
         msra::math::float4 weight4(weight);
         if (thisweight == 1.0f)
         {
@@ -878,6 +898,8 @@ public:
         array_ref<msra::math::float4> us4(us.operator array_ref<msra::math::float4>());
 
         // perform the operation on one long vector
+        if (msra::math::float8::available())
+            return msra::math::float8::scale((float *) us4.begin(), factor, 4 * us4.size());
         msra::math::float4 scale4(factor);
         foreach_index (i, us4)
         {
@@ -898,6 +920,8 @@ public:
         assert(us4.size() == other4.size());
 
         // perform the operation on one long vector
+        if (msra::math::float8::available() && thisscale != 0.0f) // (addweighted() would not read 'this')
+            return msra::math::float8::addweighted((float *) us4.begin(), thisscale, (const float *) other4.begin(), 1.0f, 4 * us4.size());
         msra::math::float4 thisscale4(thisscale);
         foreach_index (i, us4)
         {
@@ -1345,10 +1369,13 @@ class ssematrix : public ssematrixbase
     {
         BadExceptionError("allocation of SSE vector failed (%d bytes)", nbytes);
     }
+    // Large buffers (e.g. the frames of a paged-in chunk) come from huge pages if enabled; those are page-aligned.
 #ifdef _WIN32
     template <typename T>
     static T *new_sse(size_t nbytes)
     {
+        if (Microsoft::MSR::CNTK::HugePageMemAllocator::IsUsedFor(nbytes * sizeof(T)))
+            return (T *) Microsoft::MSR::CNTK::HugePageMemAllocator::Allocate(nbytes * sizeof(T));
         T *pv = (T *) _aligned_malloc(nbytes * sizeof(T), 16);
         if (pv)
             return pv;
@@ -1356,7 +1383,7 @@ class ssematrix : public ssematrixbase
     }
     static void delete_sse(void *p)
     {
-        if (p)
+        if (p && !Microsoft::MSR::CNTK::HugePageMemAllocator::Deallocate(p))
             _aligned_free(p);
     }
 #endif
@@ -1364,6 +1391,8 @@ class ssematrix : public ssematrixbase
     template <typename T>
     static T *new_sse(size_t nbytes)
     {
+        if (Microsoft::MSR::CNTK::HugePageMemAllocator::IsUsedFor(nbytes * sizeof(T)))
+            return (T *) Microsoft::MSR::CNTK::HugePageMemAllocator::Allocate(nbytes * sizeof(T));
         T *pv = (T *) _mm_malloc(nbytes * sizeof(T), 16);
         if (pv)
             return pv;
@@ -1371,7 +1400,7 @@ class ssematrix : public ssematrixbase
     }
     static void delete_sse(void *p)
     {
-        if (p)
+        if (p && !Microsoft::MSR::CNTK::HugePageMemAllocator::Deallocate(p))
             _mm_free(p);
     }
 #endif
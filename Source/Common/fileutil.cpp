@@ -1813,7 +1813,10 @@ void expand_wildcards(const wstring& path, vector<wstring>& paths)
 #else
     // On Linux we have just the function for the job: glob
     glob_t globResult;
-    if (glob(wtocharpath(path.c_str()).c_str(), GLOB_TILDE, NULL, &globResult) != 0)
+    const int rc = glob(wtocharpath(path.c_str()).c_str(), GLOB_TILDE, NULL, &globResult);
+    if (rc == GLOB_NOMATCH) // no matching file: empty, as on Windows
+        return;
+    if (rc != 0)
     {
         RuntimeError("error in expanding wild cards '%ls': %s", path.c_str(), strerror(errno));
     }
@@ -23,6 +23,8 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <thread>
+#include <atomic>
 
 using namespace std;
 
@@ -33,15 +35,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // -----------------------------------------------------------------------
 
 template <>
-vector<shared_ptr<Matrix<float>>>& MatrixPool::GetReleasedMatrices<float>()
+vector<MatrixPool::MemRequestInfo<float>>& MatrixPool::GetMemRequestInfos<float>()
 {
-    return m_releasedFloatMatrices;
+    return m_floatRequests;
 }
 
 template <>
-vector<shared_ptr<Matrix<double>>>& MatrixPool::GetReleasedMatrices<double>()
+vector<MatrixPool::MemRequestInfo<double>>& MatrixPool::GetMemRequestInfos<double>()
 {
-    return m_releasedDoubleMatrices;
+    return m_doubleRequests;
 }
 
 // -----------------------------------------------------------------------
@@ -54,6 +56,7 @@ void ComputationNetwork::ClearNetwork()
 {
     // release all references to nodes
     InvalidateCompiledNetwork();
+    m_validationRecords.clear();
 
     for (auto groupIter : GetAllNodeGroups())
         groupIter->clear();
@@ -98,8 +101,58 @@ void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFor
     }
 }
 
+template <class ElemType>
+void ComputationNetwork::SaveIncremental(const wstring& fileName, const wstring& baseFileName, const map<wstring, vector<ElemType>>& baseValues, const FileOptions fileFormat) const
+{
+    VerifyIsCompiled("SaveIncremental");
+    if ((g_mpi != nullptr) && !g_mpi->IsMainNode())
+        return;
+
+    // the parameters hold the differences while they are saved, and are then restored from 'backups' exactly
+    vector<wstring> deltaNodeNames;
+    vector<pair<Matrix<ElemType>*, vector<ElemType>>> backups;
+    vector<ElemType> delta;
+    auto restore = [&]()
+    {
+        for (auto& backup : backups)
+            backup.first->SetValue(backup.first->GetNumRows(), backup.first->GetNumCols(), backup.first->GetDeviceId(), backup.second.data());
+    };
+    try
+    {
+        for (const auto& nodeIter : m_nameToNodeMap)
+        {
+            auto node = dynamic_pointer_cast<LearnableParameter<ElemType>>(nodeIter.second);
+            auto baseIter = baseValues.find(nodeIter.first);
+            if (!node || baseIter == baseValues.end())
+                continue;
+            Matrix<ElemType>& value = node->Value();
+            if (value.GetMatrixType() != MatrixType::DENSE || value.GetNumElements() != baseIter->second.size()) // (changed shape: saved in full)
+                continue;
+            backups.emplace_back(&value, vector<ElemType>(value.GetNumElements()));
+            value.CopySection(value.GetNumRows(), value.GetNumCols(), backups.back().second.data(), value.GetNumRows());
+            delta = backups.back().second;
+            for (size_t k = 0; k < delta.size(); k++)
+                delta[k] -= baseIter->second[k];
+            value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), delta.data());
+            deltaNodeNames.push_back(nodeIter.first);
+        }
+        wstring tmpFileName = fileName + L".tmp";
+        SaveToFileImpl(tmpFileName, fileFormat, baseFileName, deltaNodeNames);
+        restore();
+        renameOrDie(tmpFileName, fileName);
+    }
+    catch (...)
+    {
+        restore();
+        throw;
+    }
+}
+
+// ends a binary model file that has a node index (see SaveToFileImpl())
+static const uint64_t nodeIndexMagic = 0x58444e4945444f4eull;
+
 // TODO: how does the file distinguish float vs double nodes?
-void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat) const
+void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat, const wstring& deltaBaseFileName, const vector<wstring>& deltaNodeNames) const
 {
     File fstream(fileName, fileFormat | FileOptions::fileOptionsWrite);
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCN");
@@ -109,15 +162,31 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
     fstream << (size_t) CURRENT_CNTK_MODEL_VERSION;
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
 
+    // incremental checkpoint (see SaveIncremental()): the model whose parameter values the listed nodes' values are relative to
+    // Older readers stop at this section (they expect the node count) rather than loading the differences as values.
+    if (!deltaNodeNames.empty())
+    {
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BDeltaBase");
+        fstream << deltaBaseFileName << deltaNodeNames.size();
+        for (const auto& nodeName : deltaNodeNames)
+            fstream << nodeName;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EDeltaBase");
+    }
+
     fstream << (size_t) m_nameToNodeMap.size();
 
     // put all node info first
+    const bool writeNodeIndex = (fileFormat & FileOptions::fileOptionsBinary) && fstream.CanSeek();
+    vector<uint64_t> nodeOffsets;
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BNodeList");
     for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
     {
         ComputationNodeBasePtr nodePtr = nodeIter->second;
+        if (writeNodeIndex)
+            nodeOffsets.push_back(fstream.GetPosition());
         nodePtr->Save(fstream);
     }
+    const uint64_t nodeListEnd = writeNodeIndex ? fstream.GetPosition() : 0;
 
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ENodeList");
 
@@ -185,14 +254,70 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
 
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECN");
 
+    // the node index, for Read() of only some of the nodes: where each node starts in the node list, and its inputs
+    // It follows the network, which older readers stop after; the last 16 bytes of the file locate it.
+    if (writeNodeIndex)
+    {
+        const uint64_t indexBegin = fstream.GetPosition();
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BNodeIndex");
+        fstream << (size_t) m_nameToNodeMap.size();
+        size_t i = 0;
+        for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++, i++)
+        {
+            ComputationNodeBasePtr nodePtr = nodeIter->second;
+            vector<wstring> inputNames;
+            for (size_t j = 0; j < nodePtr->GetNumInputs(); j++)
+                if (nodePtr->Input(j))
+                    inputNames.push_back(nodePtr->Input(j)->NodeName());
+            fstream << nodePtr->NodeName() << nodeOffsets[i] << inputNames.size();
+            for (const auto& inputName : inputNames)
+                fstream << inputName;
+        }
+        fstream << nodeListEnd;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ENodeIndex");
+        fstream << indexBegin << nodeIndexMagic;
+    }
+
     fstream.Flush();
 }
 
+// read the node index at the end of a binary model file; false if it has none
+// The file position is undefined afterwards.
+/*static*/ bool ComputationNetwork::ReadNodeIndex(File& fstream, vector<NodeIndexEntry>& index, uint64_t& nodeListEnd)
+{
+    if (!fstream.CanSeek() || fstream.IsTextBased())
+        return false;
+    const uint64_t fileSize = fstream.Size();
+    if (fileSize < 2 * sizeof(uint64_t))
+        return false;
+    uint64_t indexBegin, magic;
+    fstream.SetPosition(fileSize - 2 * sizeof(uint64_t));
+    fstream >> indexBegin >> magic;
+    if (magic != nodeIndexMagic || indexBegin >= fileSize)
+        return false;
+    fstream.SetPosition(indexBegin);
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BNodeIndex");
+    size_t numNodes;
+    fstream >> numNodes;
+    index.resize(numNodes);
+    for (auto& entry : index)
+    {
+        size_t numInputs;
+        fstream >> entry.nodeName >> entry.offset >> numInputs;
+        entry.inputs.resize(numInputs);
+        for (auto& inputName : entry.inputs)
+            fstream >> inputName;
+    }
+    fstream >> nodeListEnd;
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ENodeIndex");
+    return true;
+}
+
 // load the section of nodes that contain persistable parameters
 // This is used for reloading a model without recreating it, e.g. during training.
 // TODO: Why not just reload it? Because SGD::Train() holds pointers to the parameters directly? That should be fixed.
 template <class ElemType>
-void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
+void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create, const vector<uint64_t>& skipTo)
 {
     fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BCN");
 
@@ -204,13 +329,33 @@ void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
         fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EVersion");
     }
 
+    wstring deltaBaseFileName;
+    vector<wstring> deltaNodeNames;
+    if (fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BDeltaBase"))
+    {
+        size_t numDeltaNodes;
+        fstream >> deltaBaseFileName >> numDeltaNodes;
+        deltaNodeNames.resize(numDeltaNodes);
+        for (auto& nodeName : deltaNodeNames)
+            fstream >> nodeName;
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EDeltaBase");
+    }
+
     size_t numNodes;
     fstream >> numNodes;
 
     // get all node info first
     fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BNodeList");
+    if (!skipTo.empty() && skipTo.size() != numNodes)
+        LogicError("ReadPersistableParameters: The node index does not match the %d nodes of the model.", (int) numNodes);
     for (size_t i = 0; i < numNodes; i++)
     {
+        if (!skipTo.empty() && skipTo[i] != 0)
+        {
+            fstream.SetPosition(skipTo[i]);
+            continue;
+        }
+
         wstring opName, nodeName;
         fstream >> opName >> nodeName;
 
@@ -229,20 +374,120 @@ void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
     }
 
     fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ENodeList");
+
+    if (!deltaNodeNames.empty())
+        AddDeltaBase<ElemType>(fstream.GetName(), deltaBaseFileName, deltaNodeNames);
+}
+
+// complete the parameters loaded from an incremental checkpoint by adding those of its base model
+// The base is looked for where it was saved, else next to the checkpoint (e.g. when both were moved).
+template <class ElemType>
+void ComputationNetwork::AddDeltaBase(const wstring& fileName, const wstring& deltaBaseFileName, const vector<wstring>& deltaNodeNames)
+{
+    wstring basePath = deltaBaseFileName;
+    if (!fexists(basePath.c_str()))
+    {
+        const size_t dirEnd = fileName.find_last_of(L"/\\");
+        const size_t baseNameBegin = deltaBaseFileName.find_last_of(L"/\\");
+        basePath = (dirEnd == wstring::npos ? wstring() : fileName.substr(0, dirEnd + 1)) +
+                   (baseNameBegin == wstring::npos ? deltaBaseFileName : deltaBaseFileName.substr(baseNameBegin + 1));
+        if (!fexists(basePath.c_str()))
+            RuntimeError("Read: The base model %ls of the incremental checkpoint %ls does not exist.", deltaBaseFileName.c_str(), fileName.c_str());
+    }
+    ComputationNetwork base(CPUDEVICE);
+    base.Read<ElemType>(basePath);
+
+    vector<ElemType> values, baseValues;
+    for (const auto& nodeName : deltaNodeNames)
+    {
+        if (!NodeNameExists(nodeName)) // (not loaded, see Read())
+            continue;
+        auto node = dynamic_pointer_cast<LearnableParameter<ElemType>>(GetNodeFromName(nodeName));
+        auto baseNode = base.NodeNameExists(nodeName) ? dynamic_pointer_cast<LearnableParameter<ElemType>>(base.GetNodeFromName(nodeName)) : nullptr;
+        if (!node || !baseNode)
+            RuntimeError("Read: Parameter %ls of the incremental checkpoint %ls is not a parameter of its base model %ls.", nodeName.c_str(), fileName.c_str(), basePath.c_str());
+        Matrix<ElemType>& value = node->Value();
+        const Matrix<ElemType>& baseValue = baseNode->Value();
+        if (value.GetNumRows() != baseValue.GetNumRows() || value.GetNumCols() != baseValue.GetNumCols())
+            RuntimeError("Read: Parameter %ls of the incremental checkpoint %ls does not have the dimensions it has in its base model %ls.", nodeName.c_str(), fileName.c_str(), basePath.c_str());
+        values.resize(value.GetNumElements());
+        baseValues.resize(value.GetNumElements());
+        value.CopySection(value.GetNumRows(), value.GetNumCols(), values.data(), value.GetNumRows());
+        baseValue.CopySection(baseValue.GetNumRows(), baseValue.GetNumCols(), baseValues.data(), baseValue.GetNumRows());
+        for (size_t k = 0; k < values.size(); k++)
+            values[k] += baseValues[k];
+        value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), values.data());
+    }
 }
 
 // deserialize the model
 // This does not post-process the model (CompileNetwork()). Use Load() instead.
 template <class ElemType>
-void ComputationNetwork::Read(const wstring& fileName, const FileOptions fileFormat, const bool /*bAllowNoCriterionNode --unused*/, ComputationNetwork* anotherNetwork)
+void ComputationNetwork::Read(const wstring& fileName, const FileOptions fileFormat, const bool /*bAllowNoCriterionNode --unused*/, ComputationNetwork* anotherNetwork,
+                              const vector<wstring>& outputNodeNames)
 {
     ClearNetwork();
 
     File fstream(fileName, fileFormat | FileOptions::fileOptionsRead);
 
-    ReadPersistableParameters<ElemType>(fstream, true);
+    // with outputNodeNames, skip the nodes they do not depend on (those that are not in their inputs' closure)
+    vector<uint64_t> skipTo;
+    size_t numNodesInFile = 0;
+    if (!outputNodeNames.empty())
+    {
+        vector<NodeIndexEntry> index;
+        uint64_t nodeListEnd;
+        if (ReadNodeIndex(fstream, index, nodeListEnd))
+        {
+            map<wstring, size_t> indexOfName;
+            for (size_t i = 0; i < index.size(); i++)
+                indexOfName[index[i].nodeName] = i;
+            vector<bool> needed(index.size(), false);
+            vector<size_t> toVisit;
+            for (const auto& outputNodeName : outputNodeNames)
+            {
+                auto iter = indexOfName.find(outputNodeName);
+                if (iter == indexOfName.end())
+                    InvalidArgument("Read: Output node '%ls' is not in the model %ls.", outputNodeName.c_str(), fileName.c_str());
+                toVisit.push_back(iter->second);
+            }
+            while (!toVisit.empty())
+            {
+                const size_t i = toVisit.back();
+                toVisit.pop_back();
+                if (needed[i])
+                    continue;
+                needed[i] = true;
+                for (const auto& inputName : index[i].inputs)
+                {
+                    auto iter = indexOfName.find(inputName);
+                    if (iter != indexOfName.end()) // (else it is in anotherNetwork)
+                        toVisit.push_back(iter->second);
+                }
+            }
+            skipTo.assign(index.size(), 0);
+            for (size_t i = 0; i < index.size(); i++)
+                if (!needed[i])
+                    skipTo[i] = i + 1 < index.size() ? index[i + 1].offset : nodeListEnd;
+            numNodesInFile = index.size();
+        }
+        else
+            fprintf(stderr, "Read: %ls has no node index (it was saved by an older version); loading all nodes.\n", fileName.c_str());
+        fstream.SetPosition(0);
+    }
 
-    size_t numNodes = m_nameToNodeMap.size();
+    ReadPersistableParameters<ElemType>(fstream, true, skipTo);
+    m_modelFileMapping = fstream.GetMapping();
+    if (!skipTo.empty())
+        fprintf(stderr, "Read: Loaded the %d of the %d nodes of %ls that the requested outputs depend on.\n", (int) m_nameToNodeMap.size(), (int) numNodesInFile, fileName.c_str());
+
+    size_t numNodes = skipTo.empty() ? m_nameToNodeMap.size() : numNodesInFile;
+    // the root node lists only keep the nodes that were loaded
+    auto addIfLoaded = [&](std::vector<ComputationNodeBasePtr>& nodes, const wstring& nodeName)
+    {
+        if (skipTo.empty() || NodeNameExists(nodeName))
+            nodes.push_back(GetNodeFromName(nodeName));
+    };
 
     // get relationship
     fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BRelation");
@@ -251,7 +496,13 @@ void ComputationNetwork::Read(const wstring& fileName, const FileOptions fileFor
         wstring nodeName;
         size_t numChildren;
         fstream >> nodeName >> numChildren;
-        if (numChildren > 0)
+        if (!skipTo.empty() && !NodeNameExists(nodeName)) // (skipped)
+        {
+            wstring childName;
+            for (size_t j = 0; j < numChildren; j++)
+                fstream >> childName;
+        }
+        else if (numChildren > 0)
         {
             vector<wstring> childrenNames;
             childrenNames.resize(numChildren);
@@ -282,7 +533,7 @@ void ComputationNetwork::Read(const wstring& fileName, const FileOptions fileFor
             for (size_t i = 0; i < num; i++)
             {
                 fstream >> nodeName;
-                m_features.push_back(GetNodeFromName(nodeName));
+                addIfLoaded(m_features, nodeName);
             }
             fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EFeatureNodes");
         }
@@ -293,7 +544,7 @@ void ComputationNetwork::Read(const wstring& fileName, const FileOptions fileFor
             for (size_t i = 0; i < num; i++)
             {
                 fstream >> nodeName;
-                m_labels.push_back(GetNodeFromName(nodeName));
+                addIfLoaded(m_labels, nodeName);
             }
         }
         // BUGBUG: Should this be inside the block?
@@ -306,7 +557,7 @@ void ComputationNetwork::Read(const wstring& fileName, const FileOptions fileFor
             for (size_t i = 0; i < num; i++)
             {
                 fstream >> nodeName;
-                m_finalCriteria.push_back(GetNodeFromName(nodeName));
+                addIfLoaded(m_finalCriteria, nodeName);
             }
 
             if (!fstream.TryGetMarker(FileMarker::fileMarkerEndSection, L"ECriteriaNodes" /*legacy*/))
@@ -331,7 +582,7 @@ void ComputationNetwork::Read(const wstring& fileName, const FileOptions fileFor
             for (size_t i = 0; i < num; i++)
             {
                 fstream >> nodeName;
-                m_evalNodes.push_back(GetNodeFromName(nodeName));
+                addIfLoaded(m_evalNodes, nodeName);
             }
             fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EEvalNodes");
         }
@@ -342,7 +593,7 @@ void ComputationNetwork::Read(const wstring& fileName, const FileOptions fileFor
             for (size_t i = 0; i < num; i++)
             {
                 fstream >> nodeName;
-                m_outputNodes.push_back(GetNodeFromName(nodeName));
+                addIfLoaded(m_outputNodes, nodeName);
             }
             fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EOutputNodes");
         }
@@ -353,7 +604,7 @@ void ComputationNetwork::Read(const wstring& fileName, const FileOptions fileFor
             for (size_t i = 0; i < num; i++)
             {
                 fstream >> nodeName;
-                m_pairNodes.push_back(GetNodeFromName(nodeName));
+                addIfLoaded(m_pairNodes, nodeName);
             }
             fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EPairNodes");
         }
@@ -385,10 +636,11 @@ bool ComputationNetwork::IsTypicalCriterionNode(ComputationNodeBasePtr nodePtr)
         nodePtr->OperationName() == OperationNameOf(SequenceWithSoftmaxNode) ||
         nodePtr->OperationName() == OperationNameOf(CrossEntropyNode) ||
         nodePtr->OperationName() == OperationNameOf(ClassBasedCrossEntropyWithSoftmaxNode) ||
+        nodePtr->OperationName() == OperationNameOf(SampledSoftmaxNode) ||
+        nodePtr->OperationName() == OperationNameOf(HierarchicalSoftmaxNode) ||
+        nodePtr->OperationName() == OperationNameOf(LatticeFreeMMINode) ||
         nodePtr->OperationName() == OperationNameOf(ErrorPredictionNode) ||
-#ifdef COMING_SOON
         nodePtr->OperationName() == OperationNameOf(CRFNode) ||
-#endif
         nodePtr->OperationName() == OperationNameOf(DummyCriterionNode))
         return true;
 
@@ -532,6 +784,7 @@ void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
 {
     fprintf(stderr, "Set Max Temp Mem Size For Convolution Nodes to %lu samples.\n", maxTempMemSizeInSamples);
     list<ComputationNodeBasePtr> convolutionNodes = net->GetNodesWithType(OperationNameOf(ConvolutionNode), criterionNode);
+    convolutionNodes.splice(convolutionNodes.end(), net->GetNodesWithType(OperationNameOf(ConvolutionBiasActivationNode), criterionNode));
     if (convolutionNodes.size() == 0 && maxTempMemSizeInSamples != 0)
     {
         fprintf(stderr, "WARNING: there is no convolution node.\n");
@@ -540,10 +793,10 @@ void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
     {
         for (auto nodeIter = convolutionNodes.begin(); nodeIter != convolutionNodes.end(); nodeIter++)
         {
-            auto nodef = dynamic_pointer_cast<ConvolutionNode<float>>(*nodeIter);
+            auto nodef = dynamic_pointer_cast<ConvolutionNodeBase<float>>(*nodeIter);
             if (nodef)
                 nodef->SetmMaxTempMemSizeInSamples(maxTempMemSizeInSamples);
-            auto noded = dynamic_pointer_cast<ConvolutionNode<double>>(*nodeIter);
+            auto noded = dynamic_pointer_cast<ConvolutionNodeBase<double>>(*nodeIter);
             if (noded)
                 noded->SetmMaxTempMemSizeInSamples(maxTempMemSizeInSamples);
         }
@@ -870,20 +1123,35 @@ void ComputationNodeBase::EnumerateArcs(std::unordered_set<ComputationNodeBasePt
 //  A \approx B*C, where rank(B)=rank(C)=r < rank(A)
 // After SVD decomposition, the node A will become an intermediate node whose children are B,C ;
 // B and C are two learnable parameters
+// The kept rank r is the smallest that keeps the group's share of the energy, aligned, and at most the group's maximum
+// rank. The energy is the sum of the singular values with a full SVD. The randomized SVD only computes the leading
+// ones, so it keeps a share of the squared Frobenius norm (the sum of their squares) instead, and doubles the rank it
+// computes until that is reached.
+// The matrices are factored first, concurrently with options.numThreads on the CPU, then replaced in the network.
 // ========================================
 // BUGBUG: this only currently works for one ElemType, not both
 template <class ElemType>
-void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDConfig, size_t AlignedSize)
+void ComputationNetwork::PerformSVDecomposition(const map<wstring, pair<float, size_t>>& SVDConfig, const SVDOptions& options)
 {
-    vector<pair<vector<wstring>, float>> nodeGroups;
+    struct Factorization
+    {
+        wstring name;
+        shared_ptr<ComputationNode<ElemType>> node;
+        size_t group;
+        float keepRatio;
+        size_t maxRank;
+        shared_ptr<Matrix<ElemType>> U, VT; // [m x r] and [r x n], with the square roots of the singular values applied to both
+        size_t rank;
+        double seconds;
+    };
+    vector<Factorization> jobs;
+    vector<float> groupKeepRatios;
+    set<wstring> assigned; // a node is factored with the first group it is in
     wregex NameFilter;
 
     for (const auto& e : SVDConfig)
     {
         wstring regexStr = e.first;
-        float keepRatio = e.second;
-        vector<wstring> NamesInGroup;
-
         NameFilter.assign(regexStr);
 
         for (auto n = m_nameToNodeMap.begin(); n != m_nameToNodeMap.end(); n++)
@@ -898,52 +1166,54 @@ void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDCo
             if (!ptr)
                 continue;
 
-            Matrix<ElemType> W = ptr->Value();
+            Matrix<ElemType>& W = ptr->ValueAsMatrix();
+            // it is a vector, no need to do it
             if (W.GetNumCols() == 1 || W.GetNumRows() == 1)
                 continue;
 
             // still here ?
-            NamesInGroup.push_back(n->first);
+            if (!assigned.insert(n->first).second)
+                continue;
+            Factorization job;
+            job.name = n->first;
+            job.node = ptr;
+            job.group = groupKeepRatios.size();
+            job.keepRatio = e.second.first;
+            job.maxRank = e.second.second;
+            job.rank = 0;
+            job.seconds = 0;
+            jobs.push_back(job);
         }
-        nodeGroups.push_back(make_pair(NamesInGroup, keepRatio));
+        groupKeepRatios.push_back(e.second.first);
     }
 
-    size_t groupID = 0;
-    for (auto& group : nodeGroups)
+    // Step 1. do SVD decomposition
+    auto alignRank = [&](size_t r, size_t limit)
     {
-        float keepratio = group.second;
-        fprintf(stderr,
-                "--------------------------------------------------------------------------------------------\n");
-        fprintf(stderr,
-                "ParameterSVD: start to process group %d with KeepRatio=%.2f\n",
-                (int) groupID++, keepratio);
-        fprintf(stderr,
-                "--------------------------------------------------------------------------------------------\n");
-
-        for (const auto& name : group.first)
+        if (r % options.alignedSize != 0)
         {
-            if (m_nameToNodeMap.find(name) == m_nameToNodeMap.end())
-            {
-                // could be deleted in the previous groups
-                continue;
-            }
-
-            shared_ptr<ComputationNode<ElemType>> pNode = dynamic_pointer_cast<LearnableParameter<ElemType>>(m_nameToNodeMap[name]);
-
-            // Step 1. do SVD decomposition
-            Matrix<ElemType> A = pNode->ValueAsMatrix();
-
-            // it is a vector, no need to do it
-            if (A.GetNumCols() == 1 || A.GetNumRows() == 1)
-                continue;
-
-            size_t m = A.GetNumRows();
-            size_t n = A.GetNumCols();
-
-            Matrix<ElemType> S(-1), U(-1), VT(-1), W(-1);
-            chrono::time_point<chrono::system_clock> stTime = chrono::system_clock::now();
-            Matrix<ElemType>::SVD(A, S, U, VT, W);
-            chrono::time_point<chrono::system_clock> enTime = chrono::system_clock::now();
+            r -= r % options.alignedSize;
+            r = r + options.alignedSize > limit ? limit : r + options.alignedSize;
+        }
+        // r = (r + 7) & (~7); //  to keep the number of rows/cols of resultant matrix a multipier of 8
+        //  which can be helpful at runtime
+        return r;
+    };
+    auto factor = [&](size_t jobIndex)
+    {
+        Factorization& job = jobs[jobIndex];
+        const Matrix<ElemType>& value = job.node->ValueAsMatrix();
+        chrono::time_point<chrono::system_clock> stTime = chrono::system_clock::now();
+
+        const size_t m = value.GetNumRows();
+        const size_t n = value.GetNumCols();
+        const size_t limit = job.maxRank > 0 ? min(job.maxRank, min(m, n)) : min(m, n);
+        Matrix<ElemType> S(CPUDEVICE), U(CPUDEVICE), VT(CPUDEVICE);
+        size_t r = 0;
+        if (!options.randomized)
+        {
+            Matrix<ElemType> W(CPUDEVICE);
+            Matrix<ElemType>::SVD(value, S, U, VT, W);
 
             // A \in R^{mXn}
             // U \in R^{mXm}
@@ -954,10 +1224,9 @@ void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDCo
             ElemType totalenergy = 0.0f;
             for (size_t i = 0; i < S.GetNumRows(); i++)
                 totalenergy += S(i, 0);
-            ElemType keepenergy = totalenergy * keepratio;
+            ElemType keepenergy = totalenergy * job.keepRatio;
             ElemType runenergy = 0.0f;
 
-            size_t r = 0;
             for (size_t indx = 0; indx < S.GetNumRows(); indx++)
             {
                 runenergy += S(indx, 0);
@@ -967,41 +1236,114 @@ void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDCo
                     break;
                 }
             }
-
-            r = r > S.GetNumRows() ? S.GetNumRows() : r;
-
-            if (r % AlignedSize != 0)
+            r = r == 0 ? S.GetNumRows() : r; // (rounding kept the sum below the target)
+            r = min(alignRank(r, S.GetNumRows()), limit);
+        }
+        else
+        {
+            Matrix<ElemType> A(value.GetNumRows(), value.GetNumCols(), value.BufferPointer(), matrixFlagNormal, options.deviceId);
+            const double norm = (double) A.FrobeniusNorm();
+            const double totalenergy = norm * norm;
+            const double keepenergy = totalenergy * job.keepRatio;
+            for (size_t computed = min(limit, max(options.alignedSize, (size_t) 128));; computed = min(2 * computed, limit))
             {
-                r -= r % AlignedSize;
-                r = r + AlignedSize > S.GetNumRows() ? S.GetNumRows() : r + AlignedSize;
+                Matrix<ElemType>::RandomizedSVD(A, computed, options.oversampling, options.powerIterations, options.randomSeed + (unsigned long) jobIndex, S, U, VT);
+                double runenergy = 0;
+                r = 0;
+                for (size_t indx = 0; indx < S.GetNumRows() && r == 0; indx++)
+                {
+                    runenergy += (double) S(indx, 0) * S(indx, 0);
+                    if (runenergy > keepenergy)
+                        r = indx + 1;
+                }
+                if (r > 0 || computed == limit)
+                    break;
             }
-            // r = (r + 7) & (~7); //  to keep the number of rows/cols of resultant matrix a multipier of 8
-            //  which can be helpful at runtime
-
-            chrono::duration<double> elapsedtime = enTime - stTime;
-            fprintf(stderr,
-                    "Performing SVD for a %5d-by-%-5d matrix (node name: %-20ls) ---  computation time %5.2f secs ;  keep %4.1f%% energy ===> keep %5d svd values (reduce to %4.1f%% parameters) \n",
-                    (int) m, (int) n, name.c_str(), elapsedtime.count(),
-                    keepratio * 100, (int) r,
-                    ((m + n) * r + 0.0f) / m / n * 100);
-
-            // redU in R^ {mXr}
-            Matrix<ElemType> redU = U.ColumnSlice(0, r);
-            Matrix<ElemType> redVT(-1);
+            r = r == 0 ? S.GetNumRows() : r;
+            r = min(alignRank(r, S.GetNumRows()), limit);
+        }
+        chrono::time_point<chrono::system_clock> enTime = chrono::system_clock::now();
 
-            // redVT in R^{rXn}
-            redVT.Resize(r, n);
-            redVT.AssignRowSliceValuesOf(VT, 0, r);
+        // redU in R^ {mXr}, redVT in R^{rXn}
+        Matrix<ElemType> redU = U.ColumnSlice(0, r);
+        Matrix<ElemType> redVT(VT.GetDeviceId());
+        redVT.Resize(r, n);
+        redVT.AssignRowSliceValuesOf(VT, 0, r);
 
-            Matrix<ElemType> redS(r, (size_t) 1);
-            for (size_t i = 0; i < r; i++)
+        Matrix<ElemType> redS(r, (size_t) 1, CPUDEVICE);
+        for (size_t i = 0; i < r; i++)
+        {
+            ElemType sqrtsigma = (ElemType) sqrt((double) S(i, 0));
+            redS(i, 0) = sqrtsigma;
+        }
+        redS.TransferToDeviceIfNotThere(redU.GetDeviceId(), true);
+
+        redU.RowElementMultiplyWith(redS.Transpose());
+        redVT.ColumnElementMultiplyWith(redS);
+        redU.TransferToDeviceIfNotThere(m_deviceId, true);
+        redVT.TransferToDeviceIfNotThere(m_deviceId, true);
+
+        job.U = make_shared<Matrix<ElemType>>(move(redU));
+        job.VT = make_shared<Matrix<ElemType>>(move(redVT));
+        job.rank = r;
+        job.seconds = chrono::duration<double>(enTime - stTime).count();
+    };
+
+    // the GPU work of concurrent factorizations would share a stream, and Matrix is not thread-safe there
+    const size_t numThreads = options.randomized && options.deviceId != CPUDEVICE ? 1 : max(min(options.numThreads, jobs.size()), (size_t) 1);
+    if (numThreads == 1)
+    {
+        for (size_t i = 0; i < jobs.size(); i++)
+            factor(i);
+    }
+    else
+    {
+        atomic<size_t> nextJob(0);
+        vector<exception_ptr> errors(numThreads);
+        vector<thread> workers;
+        for (size_t t = 0; t < numThreads; t++)
+            workers.push_back(thread([&, t]()
             {
-                ElemType sqrtsigma = (ElemType) sqrt((double) S(i, 0));
-                redS(i, 0) = sqrtsigma;
-            }
+                try
+                {
+                    for (size_t i = nextJob++; i < jobs.size(); i = nextJob++)
+                        factor(i);
+                }
+                catch (...)
+                {
+                    errors[t] = current_exception();
+                }
+            }));
+        for (auto& worker : workers)
+            worker.join();
+        for (const auto& error : errors)
+            if (error)
+                rethrow_exception(error);
+    }
 
-            redU.RowElementMultiplyWith(redS.Transpose());
-            redVT.ColumnElementMultiplyWith(redS);
+    for (size_t groupID = 0; groupID < groupKeepRatios.size(); groupID++)
+    {
+        fprintf(stderr,
+                "--------------------------------------------------------------------------------------------\n");
+        fprintf(stderr,
+                "ParameterSVD: start to process group %d with KeepRatio=%.2f\n",
+                (int) groupID, groupKeepRatios[groupID]);
+        fprintf(stderr,
+                "--------------------------------------------------------------------------------------------\n");
+
+        for (const auto& job : jobs)
+        {
+            if (job.group != groupID)
+                continue;
+            const wstring& name = job.name;
+            const size_t m = job.U->GetNumRows();
+            const size_t n = job.VT->GetNumCols();
+            const size_t r = job.rank;
+            fprintf(stderr,
+                    "Performing %sSVD for a %5d-by-%-5d matrix (node name: %-20ls) ---  computation time %5.2f secs ;  keep %4.1f%% energy ===> keep %5d svd values (reduce to %4.1f%% parameters) \n",
+                    options.randomized ? "randomized " : "", (int) m, (int) n, name.c_str(), job.seconds,
+                    job.keepRatio * 100, (int) r,
+                    ((m + n) * r + 0.0f) / m / n * 100);
 
             // Step 2. create two new Parameter nodes and one Times node
             wstring leftChildName = name + L"-U";
@@ -1009,8 +1351,8 @@ void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDCo
             shared_ptr<ComputationNode<ElemType>> pLeft = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, leftChildName, m, r));
             shared_ptr<ComputationNode<ElemType>> pRight = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, rightChildName, r, n));
 
-            pLeft->ValueAsMatrix() = redU;
-            pRight->ValueAsMatrix() = redVT;
+            pLeft->ValueAsMatrix() = *job.U;
+            pRight->ValueAsMatrix() = *job.VT;
 
             shared_ptr<ComputationNode<ElemType>> pTimes = AddNodeToNetAndAttachInputs(New<TimesNode<ElemType>>(m_deviceId, name + L"-SVD"), pLeft, pRight);
 
@@ -1024,17 +1366,19 @@ void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDCo
 }
 
 template void ComputationNetwork::InitLearnableParameters<float>(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const float initValueScale, bool initOnCPUOnly);
-template void ComputationNetwork::Read<float>(const wstring& fileName, const FileOptions fileFormat, const bool bAllowNoCriterionNode, ComputationNetwork* anotherNetwork);
-template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create);
-template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template void ComputationNetwork::Read<float>(const wstring& fileName, const FileOptions fileFormat, const bool bAllowNoCriterionNode, ComputationNetwork* anotherNetwork, const vector<wstring>& outputNodeNames);
+template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create, const vector<uint64_t>& skipTo);
+template void ComputationNetwork::SaveIncremental<float>(const wstring& fileName, const wstring& baseFileName, const map<wstring, vector<float>>& baseValues, const FileOptions fileFormat) const;
+template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, pair<float, size_t>>& SVDConfig, const SVDOptions& options);
 template /*static*/ void ComputationNetwork::SetDropoutRate<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, unsigned long& dropOutSeed);
 template void ComputationNetwork::SetSeqParam<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
                                                      const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
 
 template void ComputationNetwork::InitLearnableParameters<double>(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const double initValueScale, bool initOnCPUOnly);
-template void ComputationNetwork::Read<double>(const wstring& fileName, const FileOptions fileFormat, const bool bAllowNoCriterionNode, ComputationNetwork* anotherNetwork);
-template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create);
-template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template void ComputationNetwork::Read<double>(const wstring& fileName, const FileOptions fileFormat, const bool bAllowNoCriterionNode, ComputationNetwork* anotherNetwork, const vector<wstring>& outputNodeNames);
+template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create, const vector<uint64_t>& skipTo);
+template void ComputationNetwork::SaveIncremental<double>(const wstring& fileName, const wstring& baseFileName, const map<wstring, vector<double>>& baseValues, const FileOptions fileFormat) const;
+template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, pair<float, size_t>>& SVDConfig, const SVDOptions& options);
 template /*static*/ void ComputationNetwork::SetDropoutRate<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, unsigned long& dropOutSeed);
 template void ComputationNetwork::SetSeqParam<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
                                                       const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
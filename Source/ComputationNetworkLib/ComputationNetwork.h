@@ -14,6 +14,7 @@
 #include "ScriptableObjects.h"
 
 #include <map>
+#include <set>
 #include <string>
 #include <stdexcept>
 #include <list>
@@ -26,9 +27,12 @@
 #include <regex>
 #include <chrono>
 #include <unordered_map>
+#include <functional>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class NodeProfiler;
+
 // ===========================================================================
 // ComputationNetwork -- computation graph and operations
 // ===========================================================================
@@ -45,6 +49,8 @@ public:
     ComputationNetwork()
         : m_randomSeedOffset(0),
           m_isCompiled(false),
+          m_recomputeSegmentLength(0),
+          m_offloadActivations(false),
           m_pMBLayout(make_shared<MBLayout>())
     {
     }
@@ -77,8 +83,9 @@ public:
     // (de-)serialization
     // -----------------------------------------------------------------------
 
+    // skipTo: empty, or [i] the position after the i-th node of the node list if it is to be skipped, 0 if it is to be loaded
     template <class ElemType>
-    void ReadPersistableParameters(File& fstream, bool create);
+    void ReadPersistableParameters(File& fstream, bool create, const std::vector<uint64_t>& skipTo = std::vector<uint64_t>());
     // reload node content only, e.g. used by SGD::Train() when going back to an older model that had better training objective
     template <class ElemType>
     void RereadPersistableParameters(const std::wstring& fileName)
@@ -88,14 +95,17 @@ public:
     }
     // design BUGBUG: binary files do not know whether they are float or double.
     // TODO: modify file format to know this; then eliminate the <ElemType> dependency (and in some future, allow nodes to be different)
+    // outputNodeNames: if not empty, only these nodes and the nodes they depend on are deserialized, if the file has a node index
     template <class ElemType>
     void Read(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary,
-              const bool bAllowNoCriterionNode = false, ComputationNetwork* anotherNetwork = nullptr);
+              const bool bAllowNoCriterionNode = false, ComputationNetwork* anotherNetwork = nullptr,
+              const std::vector<std::wstring>& outputNodeNames = std::vector<std::wstring>());
     template <class ElemType>
     void Load(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary,
-              const bool bAllowNoCriterionNode = false, ComputationNetwork* anotherNetwork = nullptr)
+              const bool bAllowNoCriterionNode = false, ComputationNetwork* anotherNetwork = nullptr,
+              const std::vector<std::wstring>& outputNodeNames = std::vector<std::wstring>())
     {
-        Read<ElemType>(fileName, fileFormat, bAllowNoCriterionNode, anotherNetwork);
+        Read<ElemType>(fileName, fileFormat, bAllowNoCriterionNode, anotherNetwork, outputNodeNames);
         // perform all further post-processing, caching, etc.
         CompileNetwork();
     }
@@ -104,19 +114,38 @@ public:
     template <class ElemType>
     static ComputationNetworkPtr CreateFromFile(DEVICEID_TYPE deviceId, const std::wstring& fileName,
                                                 const FileOptions fileFormat = FileOptions::fileOptionsBinary,
-                                                const bool bAllowNoCriterionNode = false, ComputationNetwork* anotherNetwork = nullptr)
+                                                const bool bAllowNoCriterionNode = false, ComputationNetwork* anotherNetwork = nullptr,
+                                                const std::vector<std::wstring>& outputNodeNames = std::vector<std::wstring>())
     {
         auto net = make_shared<ComputationNetwork>(deviceId);
-        net->Load<ElemType>(fileName, FileOptions::fileOptionsBinary, bAllowNoCriterionNode, anotherNetwork);
+        net->Load<ElemType>(fileName, fileFormat, bAllowNoCriterionNode, anotherNetwork, outputNodeNames);
         return net;
     }
 
     void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
     void SaveEdited(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary);
+    // incremental checkpoint: the learnable parameters in baseValues are saved as their differences to them
+    // baseValues[nodeName] are the values (column-major, on the host) that were saved in full to baseFileName, where
+    // Read() finds them to add back; the differences are small and suit a compact fileFormat.
+    template <class ElemType>
+    void SaveIncremental(const std::wstring& fileName, const std::wstring& baseFileName, const std::map<std::wstring, std::vector<ElemType>>& baseValues,
+                         const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
 
 private:
 
-    void SaveToFileImpl(const std::wstring& fileName, const FileOptions fileFormat) const;
+    void SaveToFileImpl(const std::wstring& fileName, const FileOptions fileFormat,
+                        const std::wstring& deltaBaseFileName = std::wstring(), const std::vector<std::wstring>& deltaNodeNames = std::vector<std::wstring>()) const;
+    template <class ElemType>
+    void AddDeltaBase(const std::wstring& fileName, const std::wstring& deltaBaseFileName, const std::vector<std::wstring>& deltaNodeNames);
+
+    // the node index that binary model files end with, for loading only some of the nodes
+    struct NodeIndexEntry
+    {
+        std::wstring nodeName;
+        uint64_t offset;                 // of the node in the node list
+        std::vector<std::wstring> inputs;
+    };
+    static bool ReadNodeIndex(File& fstream, std::vector<NodeIndexEntry>& index, uint64_t& nodeListEnd);
 
 public:
 
@@ -128,7 +157,25 @@ public:
     void ForwardProp(const ComputationNodeBasePtr rootNode);
 
     // main entry point for backprop
-    void Backprop(const ComputationNodeBasePtr rootNode);
+    // The root gradient is seeded with rootGradient; a value other than 1 implements loss scaling.
+    // With accumulateParameterGradients, the gradients of the learnable parameters are not reset but added to (gradient accumulation).
+    void Backprop(const ComputationNodeBasePtr rootNode, double rootGradient = 1.0, bool accumulateParameterGradients = false);
+
+    // called during Backprop() for every learnable parameter as soon as its gradient is final, e.g. to start exchanging it
+    void SetGradientFinalCallback(const std::function<void(const ComputationNodeBasePtr&)>& callback)
+    {
+        m_gradientFinalCallback = callback;
+    }
+
+    // if set, ForwardProp() and Backprop() report per-node times to the profiler (see NodeProfiler.h)
+    void SetNodeProfiler(const std::shared_ptr<NodeProfiler>& profiler)
+    {
+        m_nodeProfiler = profiler;
+    }
+    const std::shared_ptr<NodeProfiler>& GetNodeProfiler() const
+    {
+        return m_nodeProfiler;
+    }
 
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
@@ -171,6 +218,7 @@ public:
 private:
     void ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFinalValidationPass, size_t& todo);
     void ValidateSubNetwork(const ComputationNodeBasePtr& rootNode);
+    bool IsValidationCurrent(const ComputationNodeBasePtr& node) const;
     void MarkValueNonSharableNodes();
 
 private:
@@ -185,7 +233,20 @@ private:
 public:
     void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode);
 
+    // gradient checkpointing: keep only segment-boundary outputs alive after forward prop and recompute the
+    // others segment by segment during backprop (0 = keep all). Takes effect in the next AllocateAllMatrices().
+    void SetRecomputeSegmentLength(size_t segmentLength) { m_recomputeSegmentLength = segmentLength; }
+
+    // activation offload: copy outputs that are only read again in backprop to page-locked host memory during forward
+    // prop, let others use their device memory meanwhile, and copy them back ahead of their backprop. GPU only; not
+    // with recomputation or multiple compute streams. Takes effect in the next AllocateAllMatrices().
+    void SetOffloadActivations(bool offloadActivations) { m_offloadActivations = offloadActivations; }
+
+    // device memory that the last AllocateAllMatrices() planned per sample (minibatch column) on the network's device
+    size_t GetPlannedBytesPerSample() const { return m_matrixPool.GetPlannedBytesPerColumn(m_deviceId); }
+
 private:
+    void PlanInputViews(const std::vector<ComputationNodeBasePtr>& forwardPropRoots, bool performingBackPropagation);
     void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount);
     void AllocateGradientMatricesForInputs(ComputationNodeBasePtr parentNode);
 
@@ -341,6 +402,15 @@ public:
     void SetLearnableNodesBelowNeedGradient(const bool needGradient, const ComputationNodeBasePtr& rootNode = nullptr);
     void SetBatchNormlizationNodesBelowEvalMode(const bool evalMode, const ComputationNodeBasePtr& rootNode = nullptr);
 
+private:
+    std::vector<ComputationNodeBasePtr> GetConsumersOf(const ComputationNodeBasePtr& node) const;
+    bool IsInNodeGroup(const ComputationNodeBasePtr& node);
+    bool IsUsedOnlyBy(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& consumer);
+    void ReplaceAllUsesOfNode(const ComputationNodeBasePtr& oldNode, const ComputationNodeBasePtr& newNode);
+    void DeleteUnusedNodes(std::list<ComputationNodeBasePtr> candidates);
+    void ReplaceNodeInGraph(const ComputationNodeBasePtr& oldNode, const ComputationNodeBasePtr& newNode);
+public:
+
     // -----------------------------------------------------------------------
     // node access
     // -----------------------------------------------------------------------
@@ -556,8 +626,64 @@ public:
     // specialized operations
     // -----------------------------------------------------------------------
 
+    // how PerformSVDecomposition() factors the matrices
+    struct SVDOptions
+    {
+        size_t alignedSize;        // the kept rank is rounded up to a multiple of this
+        bool randomized;           // leading singular values only, by a randomized range finder (see Matrix::RandomizedSVD), instead of a full SVD
+        DEVICEID_TYPE deviceId;    // where the randomized factorization runs
+        size_t oversampling;       // extra dimensions of the random projection
+        size_t powerIterations;    // subspace iterations, for slowly decaying spectra
+        size_t numThreads;         // matrices factored concurrently; CPU only
+        unsigned long randomSeed;
+
+        SVDOptions()
+            : alignedSize(8), randomized(false), deviceId(CPUDEVICE), oversampling(16), powerIterations(2), numThreads(1), randomSeed(1)
+        {
+        }
+    };
+
+    // SVDConfig: node-name regex -> (keep ratio of the energy, maximum rank; 0 for none)
+    template <class ElemType>
+    void PerformSVDecomposition(const map<wstring, pair<float, size_t>>& SVDConfig, const SVDOptions& options);
+
+    // rewrite the network into an equivalent one that is cheaper to evaluate; the result can no longer be trained
+    template <class ElemType>
+    void OptimizeForInference(bool fuseAffine);
+
+private:
+    template <class ElemType>
+    size_t FoldConstantNodes();
+    size_t RemoveDropoutNodes();
+    template <class ElemType>
+    size_t FoldBatchNormalizationNodes();
+    template <class ElemType>
+    size_t FoldMeanVarNormalizationNodes();
     template <class ElemType>
-    void PerformSVDecomposition(const map<wstring, float>& SVDConfig, size_t AlignedSize);
+    size_t FuseAffineActivations();
+    // Times(Transpose(A), B) -> TransposeTimes(A, B); part of CompileNetwork()
+    size_t FuseTransposesIntoTimes();
+    template <class ElemType>
+    size_t FuseTransposesIntoTimes();
+    // RectifiedLinear(Plus(Convolution(W, x), b)) -> ConvolutionBiasActivation(W, x, b); part of CompileNetwork() if g_fuseConvolutions
+    size_t FuseConvolutionActivations(bool fusePooling);
+    template <class ElemType>
+    size_t FuseConvolutionActivations(bool fusePooling);
+public:
+
+    // model parallelism: move nodes to other devices and shard Times nodes, with transfers at the device boundaries; before AllocateAllMatrices()
+    template <class ElemType>
+    void PlaceNodesOnDevices(const vector<pair<wstring, DEVICEID_TYPE>>& placement, const vector<pair<wstring, vector<DEVICEID_TYPE>>>& shardedTimes);
+    // model parallelism: a placement for PlaceNodesOnDevices() that splits the network into consecutive stages of about equal cost
+    vector<pair<wstring, DEVICEID_TYPE>> PartitionIntoStages(const ComputationNodeBasePtr& rootNode, const vector<DEVICEID_TYPE>& stageDevices);
+
+private:
+    size_t RemoveDeviceTransfers();
+    template <class ElemType>
+    void ShardTimesNode(const ComputationNodeBasePtr& node, const vector<DEVICEID_TYPE>& devices);
+    template <class ElemType>
+    size_t InsertDeviceTransfers();
+public:
 
     // -----------------------------------------------------------------------
     // construction
@@ -852,6 +978,121 @@ protected:
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+        // gradient checkpointing: split m_nestedNodes into segments of 'segmentLength' and decide which node outputs
+        // are not stored but recomputed segment by segment during Backprop()
+        void PlanRecomputation(size_t segmentLength, const std::set<ComputationNodeBasePtr>& nodesToKeep);
+        int GetRecomputeSegment(const ComputationNodeBasePtr& node) const; // -1 if recomputation is off
+        bool IsRecomputed(const ComputationNodeBasePtr& node) const;
+
+        // activation offload: choose the outputs to copy to host memory between their last use in forward prop and
+        // their first use in backprop; 'neededDuringBackprop' as determined by AllocateAllMatrices()
+        void PlanOffload(DEVICEID_TYPE deviceId, const std::set<ComputationNodeBasePtr>& nodesToKeep,
+                         const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                         const std::unordered_map<ComputationNodeBasePtr, bool>& neededDuringBackprop);
+        // for AllocateAllMatrices() to mirror the offloads: [forward prop entry] -> nodes whose output is released before
+        // it runs (nullptr: at the end of forward prop), and [backprop entry] -> nodes whose output is requested again
+        // before it runs; entries are m_nestedNodes
+        void GetOffloadLifetimes(std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>>& releasedBefore,
+                                 std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>>& requestedBefore) const;
+        ~PARTraversalFlowControlNode();
+
+        // elementwise fusion: find runs of elementwise nodes in m_nestedNodes that ForwardProp() evaluates with a single kernel
+        void PlanElementWiseFusion();
+
+        // multi-stream execution: spread independent nodes over 'numStreams' GPU streams, with events where branches join
+        void PlanStreams(size_t numStreams, DEVICEID_TYPE deviceId);
+
+        // wavefront scheduling: run stacked recurrent loops diagonally in forward prop, loop k at time t together with
+        // loop k + 1 at time t - 1, on up to 'numStreams' GPU streams
+        void PlanWavefronts(size_t numStreams, DEVICEID_TYPE deviceId);
+
+        // concurrent loops: run independent recurrent loops (e.g. the two directions of a bidirectional layer) time step
+        // by time step side by side, in forward prop and backprop, on up to 'numStreams' GPU streams
+        void PlanConcurrentLoops(size_t numStreams, DEVICEID_TYPE deviceId);
+
+    private:
+        void RecomputeSegment(const FrameRange& fr, int segment, int lastIndex);
+
+        struct StreamSchedule
+        {
+            std::vector<size_t> streamOf;           // [i] stream that m_nestedNodes[i] runs on
+            std::vector<std::vector<int>> waitsFor; // [i] nodes on other streams that must be done before m_nestedNodes[i] runs
+            std::vector<bool> isWaitedFor;          // [i] a node on another stream waits for m_nestedNodes[i]
+        };
+        void EnterStream(const StreamSchedule& schedule, int i, size_t firstEvent);
+        void LeaveStream(const StreamSchedule& schedule, int i, size_t firstEvent);
+
+        struct FusedGroup
+        {
+            int begin, end;                             // [begin, end) range of m_nestedNodes
+            std::vector<ComputationNodeBasePtr> inputs; // inputs from outside the group, in register order
+            ElementWiseProgram program;                 // computes all members' values; output k is m_nestedNodes[begin + k]
+        };
+        template <class ElemType>
+        void ForwardPropFusedGroup(const FrameRange& fr, const FusedGroup& group);
+
+        struct Wavefront
+        {
+            int begin, end;           // [begin, end) range of m_nestedNodes: loops, the frame-wise nodes between them, and leaves
+            std::vector<int> stageOf; // [j - begin] the loop that m_nestedNodes[j] runs with: its own or, between loops, the next one; -1 for leaves
+            int numStages;            // number of loops
+            int steppingDirection;    // of all loops
+        };
+        void ForwardPropWavefront(const Wavefront& wavefront);
+
+        struct ConcurrentLoops
+        {
+            int begin, end;         // [begin, end) range of m_nestedNodes, from the first loop to the last
+            std::vector<int> loops; // positions of the loops in m_nestedNodes; the other entries of the range depend on none of them
+        };
+        void ForwardPropConcurrentLoops(const ConcurrentLoops& group);
+        void BackpropConcurrentLoops(const ConcurrentLoops& group);
+
+        struct Offload
+        {
+            int node;           // index into m_nestedNodes
+            int copyAfter;      // forward prop: copy out once m_nestedNodes[copyAfter], the last reader, is done...
+            int releaseBefore;  // ...and have it arrive before m_nestedNodes[releaseBefore] runs, which may reuse the memory; size() at the end
+            int prefetchBefore; // backprop: copy back before m_nestedNodes[prefetchBefore] runs...
+            int neededAt;       // ...and have it arrive before m_nestedNodes[neededAt], the first reader, runs
+            size_t rows, cols;  // of the output when it was copied out
+            void* hostBuffer;   // page-locked; grows as needed
+            size_t hostBytes;
+            enum class State { onDevice, copyingOut, onHost, copyingIn } state;
+        };
+        void OffloadBeforeForwardProp(int i);
+        void OffloadBeforeBackprop(int firstIndex);
+        template <class ElemType>
+        void CopyOut(Offload& offload, size_t event);
+        template <class ElemType>
+        void CopyIn(Offload& offload, size_t event);
+        void FreeOffloadBuffers();
+
+        size_t m_recomputeSegmentLength = 0;                        // 0 means store all outputs
+        std::vector<bool> m_isRecomputed;                           // [i] m_nestedNodes[i] is recomputed rather than stored
+        std::map<ComputationNodeBasePtr, int> m_recomputeSegmentOf; // [node] -> segment index, including nodes inside loops
+
+        std::vector<FusedGroup> m_fusedGroups;
+        std::vector<int> m_fusedGroupOf; // [i] index into m_fusedGroups of the group that starts at m_nestedNodes[i], else -1; empty if fusion is off
+
+        StreamSchedule m_forwardSchedule, m_backpropSchedule; // empty if multi-stream execution is off
+        DEVICEID_TYPE m_streamDeviceId = CPUDEVICE;
+
+        std::vector<Wavefront> m_wavefronts;
+        std::vector<int> m_wavefrontOf; // [i] index into m_wavefronts of the wavefront that starts at m_nestedNodes[i], else -1; empty if off
+        size_t m_wavefrontStreams = 1;
+
+        std::vector<ConcurrentLoops> m_concurrentLoops;
+        std::vector<int> m_concurrentLoopsOf; // [i] index into m_concurrentLoops of the group that m_nestedNodes[i] belongs to, else -1; empty if off
+        size_t m_concurrentLoopsStreams = 1;
+
+        std::vector<Offload> m_offloads; // empty if activation offload is off
+        DEVICEID_TYPE m_offloadDeviceId = CPUDEVICE;
+
+    public:
+        std::function<void(const ComputationNodeBasePtr&)> m_gradientFinalCallback; // set by ComputationNetwork::Backprop() for the duration of a call
+        NodeProfiler* m_nodeProfiler = nullptr;                                     // set by ComputationNetwork::ForwardProp() and Backprop() for the duration of a call
     };
 
 public:
@@ -870,6 +1111,8 @@ public:
 
 protected:
     DEVICEID_TYPE m_deviceId; // TODO: is this shared by all nodes?
+    std::function<void(const ComputationNodeBasePtr&)> m_gradientFinalCallback;
+    std::shared_ptr<NodeProfiler> m_nodeProfiler;
     unsigned long m_randomSeedOffset;
 
     // main node holder
@@ -893,6 +1136,9 @@ protected:
     // TODO: This will change once we allow for multiple inconsistent layouts.
     MBLayoutPtr m_pMBLayout; // note that this must be installed before doing anything that needs it (default leaves a nullptr)
 
+    // if read with fileOptionsMapped, the model file, which parameters of an aligned model reference in place
+    std::shared_ptr<const char> m_modelFileMapping;
+
 private:
     // -----------------------------------------------------------------------
     // the following members are all result of post-processing by CompileNetwork()
@@ -907,6 +1153,22 @@ private:
     // cache for evaluation ordering:
     bool m_isCompiled; // CompileNetwork has been called
 
+    size_t m_recomputeSegmentLength; // gradient checkpointing; see SetRecomputeSegmentLength()
+    bool m_offloadActivations;       // see SetOffloadActivations()
+
+    std::set<ComputationNodeBasePtr> m_nodesPlannedForInputViews; // zero-copy views are decided once per node, when it is first allocated
+
+    // what each node looked like when it was last validated, for incremental validation after model edits
+    // This survives InvalidateCompiledNetwork(); ValidateSubNetwork() only revalidates nodes that differ from it, and what depends on them.
+    struct ValidationRecord
+    {
+        std::vector<ComputationNodeBasePtr> inputs;
+        TensorShape sampleLayout;
+        MBLayoutPtr pMBLayout;
+        bool parameterUpdateRequired;
+    };
+    std::map<ComputationNodeBasePtr, ValidationRecord> m_validationRecords;
+
     // cached network iterations
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_evalOrders; // [out node] flat depth-first traversal starting from out node
     std::map<const ComputationNodeBasePtr, ComputationNodeBasePtr> m_nestedNetworks;        // [out node] network rewritten as recursive traveral, potentially optimized; execution plan
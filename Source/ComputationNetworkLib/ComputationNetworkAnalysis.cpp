@@ -149,9 +149,23 @@ void ComputationNetwork::FormRecurrentLoops(const ComputationNodeBasePtr& rootNo
     }
 
     // log the loops
+    // Loops are strongly connected components, so every node in a loop depends on the loop's own past output.
+    // Loop-invariant subgraphs, e.g. the input projections W * x(t) of an LSTM, are therefore never part of the loop:
+    // they are evaluated once over the whole minibatch in PAR mode before the loop runs, and the gradients into
+    // them are propagated once over all frames in SEQTraversalFlowControlNode::EndBackprop(). We log them as the loop's inputs.
     for (auto& iter : m_allSEQNodes)
     {
-        fprintf(stderr, "\nLoop[%d] --> %ls -> %d nodes\n", (int) iter->m_loopId, iter->NodeName().c_str(), (int) iter->m_nestedNodes.size());
+        set<ComputationNodeBasePtr> loopInputs;
+        for (const auto& node : iter->m_nestedNodes)
+            for (size_t i = 0; i < node->GetNumInputs(); i++)
+                if (!node->Input(i)->IsPartOfLoop() || node->Input(i)->m_loopId != iter->m_loopId)
+                    loopInputs.insert(node->Input(i));
+        size_t numHoisted = 0; // inputs that are computed per minibatch, as opposed to learnable parameters and constants
+        for (const auto& input : loopInputs)
+            if (input->HasMBLayout())
+                numHoisted++;
+        fprintf(stderr, "\nLoop[%d] --> %ls -> %d nodes, %d inputs (%d evaluated once per minibatch outside the loop)\n",
+                (int) iter->m_loopId, iter->NodeName().c_str(), (int) iter->m_nestedNodes.size(), (int) loopInputs.size(), (int) numHoisted);
         size_t n = 0;
         for (auto itr = iter->m_nestedNodes.begin(); itr != iter->m_nestedNodes.end(); itr++)
         {
@@ -8,11 +8,18 @@
 #include "Basics.h"
 #include "ComputationNode.h"
 #include "ComputationNetwork.h"
+#include "ConvolutionalNodes.h"
 #include "InputAndParamNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "NonlinearityNodes.h"
+#include "PreComputeNodes.h"
+#include "RecurrentNodes.h"
+#include "ReshapingNodes.h"
 #include "TrainingNodes.h"
 #include <string>
 #include <vector>
 #include <list>
+#include <set>
 
 using namespace std;
 
@@ -360,4 +367,708 @@ void ComputationNetwork::SetBatchNormlizationNodesBelowEvalMode(const bool evalM
         }
     }
 }
+
+// all nodes that have 'node' as an input
+std::vector<ComputationNodeBasePtr> ComputationNetwork::GetConsumersOf(const ComputationNodeBasePtr& node) const
+{
+    std::vector<ComputationNodeBasePtr> consumers;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        for (const auto& input : iter.second->GetInputs())
+        {
+            if (input == node)
+            {
+                consumers.push_back(iter.second);
+                break;
+            }
+        }
+    }
+    return consumers;
+}
+
+bool ComputationNetwork::IsInNodeGroup(const ComputationNodeBasePtr& node)
+{
+    for (auto groupIter : GetAllNodeGroups())
+        if (std::find(groupIter->begin(), groupIter->end(), node) != groupIter->end())
+            return true;
+    return false;
+}
+
+// true if changing 'node' affects nothing but 'consumer'
+bool ComputationNetwork::IsUsedOnlyBy(const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& consumer)
+{
+    const auto consumers = GetConsumersOf(node);
+    return consumers.size() == 1 && consumers[0] == consumer && !IsInNodeGroup(node);
+}
+
+// make every node (except newNode itself) and every node group that refers to oldNode refer to newNode instead
+void ComputationNetwork::ReplaceAllUsesOfNode(const ComputationNodeBasePtr& oldNode, const ComputationNodeBasePtr& newNode)
+{
+    InvalidateCompiledNetwork();
+
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const ComputationNodeBasePtr& node = iter.second;
+        if (node == newNode)
+            continue;
+        for (size_t i = 0; i < node->GetNumInputs(); i++)
+            if (node->GetInputs()[i] == oldNode)
+                node->SetInput(i, newNode);
+    }
+
+    for (auto groupIter : GetAllNodeGroups())
+    {
+        auto& group = *groupIter;
+        auto search = std::find(group.begin(), group.end(), oldNode);
+        if (search == group.end())
+            continue;
+        if (std::find(group.begin(), group.end(), newNode) != group.end())
+            group.erase(search);
+        else
+            *search = newNode;
+    }
+}
+
+// delete the candidates that are neither used nor in a node group, and then those of their inputs that became unused
+void ComputationNetwork::DeleteUnusedNodes(std::list<ComputationNodeBasePtr> candidates)
+{
+    while (!candidates.empty())
+    {
+        ComputationNodeBasePtr node = candidates.front();
+        candidates.pop_front();
+        if (!NodeNameExists(node->NodeName()) || GetNodeFromName(node->NodeName()) != node) // (already deleted)
+            continue;
+        if (IsInNodeGroup(node) || !GetConsumersOf(node).empty())
+            continue;
+        for (const auto& input : node->GetInputs())
+            if (input)
+                candidates.push_back(input);
+        DeleteNode(node->NodeName());
+    }
+}
+
+// let newNode take the place of oldNode, including its name; oldNode and what only it used are deleted
+void ComputationNetwork::ReplaceNodeInGraph(const ComputationNodeBasePtr& oldNode, const ComputationNodeBasePtr& newNode)
+{
+    const wstring name = oldNode->NodeName();
+    ReplaceAllUsesOfNode(oldNode, newNode);
+    DeleteUnusedNodes(std::list<ComputationNodeBasePtr>{oldNode});
+    RenameNode(newNode->NodeName(), name);
+}
+
+// -----------------------------------------------------------------------
+// inference optimization
+// OptimizeForInference() rewrites a trained network into an equivalent one that is cheaper to evaluate:
+//  - subgraphs that do not depend on the input data are computed once and replaced by parameters
+//  - Dropout nodes, the identity in inference, are removed
+//  - per-activation BatchNormalization after Times(W, x) [+ b] is folded into W and b
+//  - PerDimMeanVarNormalization in front of Times(W, .) is folded into W and a new bias
+//  - Times, Plus and a following Sigmoid, Tanh, or RectifiedLinear are fused into one AffineActivation node (if fuseAffine)
+// Names of nodes that remain visible (node groups, and the results of folded chains) are kept, so that readers and
+// EvalDll clients need no changes. Saving the result gives a leaner model for evaluation.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+static vector<ElemType> ValueToHost(const ComputationNodeBasePtr& node)
+{
+    const auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+    vector<ElemType> result(value.GetNumElements());
+    value.CopySection(value.GetNumRows(), value.GetNumCols(), result.data(), value.GetNumRows());
+    return result;
+}
+
+// replace the value of a node, keeping its dimensions
+template <class ElemType>
+static void SetValueFromHost(const ComputationNodeBasePtr& node, vector<ElemType>& values)
+{
+    auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+    // (into a new matrix, as the old one may reference a read-only mapped model file)
+    value = Matrix<ElemType>(value.GetNumRows(), value.GetNumCols(), values.data(), matrixFlagNormal, value.GetDeviceId());
+}
+
+// a leaf whose value does not depend on the input data: a parameter, or precomputed statistics
+template <class ElemType>
+static bool IsConstantLeaf(const ComputationNodeBasePtr& node)
+{
+    if (node->RequiresPreCompute())
+    {
+        auto preComputedNode = dynamic_pointer_cast<PreComputedNodeBase<ElemType>>(node);
+        return preComputedNode && preComputedNode->HasComputed();
+    }
+    return node->IsLeaf() && node->OperationName() == OperationNameOf(LearnableParameter);
+}
+
+template <class ElemType>
+void ComputationNetwork::OptimizeForInference(bool fuseAffine)
+{
+    // constant folding needs validated dimensions, and runs first so that the other steps see folded parameters
+    if (!IsCompiled())
+        CompileNetwork();
+    const size_t numNodesBefore = GetTotalNumberOfNodes();
+
+    const size_t numConstant = FoldConstantNodes<ElemType>();
+    const size_t numDropout = RemoveDropoutNodes();
+    const size_t numBatchNorm = FoldBatchNormalizationNodes<ElemType>();
+    const size_t numMeanVarNorm = FoldMeanVarNormalizationNodes<ElemType>();
+    const size_t numFused = fuseAffine ? FuseAffineActivations<ElemType>() : 0;
+
+    fprintf(stderr, "OptimizeForInference: folded %d constant subgraphs, removed %d Dropout nodes, folded %d BatchNormalization and %d PerDimMeanVarNormalization nodes, fused %d affine layers; %d nodes left of %d.\n",
+            (int) numConstant, (int) numDropout, (int) numBatchNorm, (int) numMeanVarNorm, (int) numFused, (int) GetTotalNumberOfNodes(), (int) numNodesBefore);
+
+    CompileNetwork();
+}
+
+// compute every node that depends only on constants, and replace those whose value is used by the rest of the network by a parameter
+template <class ElemType>
+size_t ComputationNetwork::FoldConstantNodes()
+{
+    set<ComputationNodeBasePtr> constants;
+    list<ComputationNodeBasePtr> constantComputations; // in evaluation order
+    for (const auto& node : ComputationNodeBase::EnumerateNodes(m_allRoots))
+    {
+        bool isConstant;
+        if (node->IsLeaf() || node->RequiresPreCompute())
+            isConstant = IsConstantLeaf<ElemType>(node);
+        else
+        {
+            // (random or stateful operations are excluded even if their inputs are constant)
+            const wstring& op = node->OperationName();
+            isConstant = !node->HasMBLayout() &&
+                         op != OperationNameOf(DropoutNode) && op != OperationNameOf(BatchNormalizationNode) &&
+                         op != OperationNameOf(PastValueNode) && op != OperationNameOf(FutureValueNode);
+            for (const auto& input : node->GetInputs())
+                if (constants.find(input) == constants.end())
+                    isConstant = false;
+            if (isConstant)
+                constantComputations.push_back(node);
+        }
+        if (isConstant)
+            constants.insert(node);
+    }
+
+    for (const auto& node : constantComputations)
+    {
+        node->MarkValueNonSharable(); // (gives it a value matrix of its own)
+        node->BeginForwardProp();
+        node->ForwardProp(FrameRange(node->GetMBLayout()));
+        node->EndForwardProp();
+    }
+
+    size_t numFolded = 0;
+    for (const auto& node : constantComputations)
+    {
+        if (!NodeNameExists(node->NodeName()) || GetNodeFromName(node->NodeName()) != node) // (deleted as input of a folded node)
+            continue;
+        const auto consumers = GetConsumersOf(node);
+        bool isFoldTarget = consumers.empty() || IsInNodeGroup(node);
+        for (const auto& consumer : consumers)
+            if (constants.find(consumer) == constants.end())
+                isFoldTarget = true;
+        if (!isFoldTarget)
+            continue;
+
+        auto parameter = New<LearnableParameter<ElemType>>(m_deviceId, node->NodeName() + L".folded", node->GetSampleLayout());
+        parameter->Value().SetValue(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value());
+        ComputationNodeBasePtr parameterNode = AddNodeToNet(parameter);
+        parameterNode->SetParameterUpdateRequired(false);
+        ReplaceNodeInGraph(node, parameterNode);
+        numFolded++;
+    }
+    return numFolded;
+}
+
+size_t ComputationNetwork::RemoveDropoutNodes()
+{
+    size_t numRemoved = 0;
+    for (const auto& node : GetNodesWithType(OperationNameOf(DropoutNode)))
+    {
+        if (IsInNodeGroup(node)) // (its name is visible)
+            continue;
+        ReplaceAllUsesOfNode(node, node->GetInputs()[0]);
+        DeleteUnusedNodes(list<ComputationNodeBasePtr>{node});
+        numRemoved++;
+    }
+    return numRemoved;
+}
+
+// BatchNormalization(Times(W, x) [+ b], scale, beta, mean, invStd) = W' x + b'
+// with k = scale .* invStd, W' = diag(k) W, and b' = k .* (b - mean) + beta
+// Only the per-activation form is folded: in the spatial form a channel's statistics have no row of W to go to.
+template <class ElemType>
+size_t ComputationNetwork::FoldBatchNormalizationNodes()
+{
+    size_t numFolded = 0;
+    for (const auto& node : GetNodesWithType(OperationNameOf(BatchNormalizationNode)))
+    {
+        auto batchNormNode = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(node);
+        if (!batchNormNode || batchNormNode->IsSpatial())
+            continue;
+
+        // match the chain; all of it must be used only here, as W and b are changed in place
+        ComputationNodeBasePtr plus;
+        ComputationNodeBasePtr times = node->GetInputs()[0];
+        if (times->OperationName() == OperationNameOf(PlusNode) && IsUsedOnlyBy(times, node))
+        {
+            plus = times;
+            times = plus->GetInputs()[0];
+        }
+        if (times->OperationName() != OperationNameOf(TimesNode) || !times->HasMBLayout() || !IsUsedOnlyBy(times, plus ? plus : node))
+            continue;
+        const ComputationNodeBasePtr weights = times->GetInputs()[0];
+        if (weights->OperationName() != OperationNameOf(LearnableParameter) || !IsUsedOnlyBy(weights, times))
+            continue;
+        const size_t rows = weights->GetAsMatrixNumRows(), cols = weights->GetAsMatrixNumCols();
+        const ComputationNodeBasePtr bias = plus ? plus->GetInputs()[1] : nullptr;
+        if (bias && (bias->OperationName() != OperationNameOf(LearnableParameter) || !IsUsedOnlyBy(bias, plus) || bias->GetAsMatrixNumRows() != rows || bias->GetAsMatrixNumCols() != 1))
+            continue;
+        bool isFoldable = true;
+        for (size_t i = 1; i < node->GetNumInputs(); i++)
+            if (!IsConstantLeaf<ElemType>(node->GetInputs()[i]) || node->GetInputs()[i]->GetAsMatrixNumRows() * node->GetInputs()[i]->GetAsMatrixNumCols() != rows)
+                isFoldable = false;
+        if (!isFoldable)
+            continue;
+
+        vector<ElemType> W = ValueToHost<ElemType>(weights);
+        const vector<ElemType> scale = ValueToHost<ElemType>(node->GetInputs()[1]);
+        const vector<ElemType> beta = ValueToHost<ElemType>(node->GetInputs()[2]);
+        const vector<ElemType> mean = ValueToHost<ElemType>(node->GetInputs()[3]);
+        const vector<ElemType> invStdDev = ValueToHost<ElemType>(node->GetInputs()[4]);
+        vector<ElemType> b = bias ? ValueToHost<ElemType>(bias) : vector<ElemType>(rows, 0);
+        if (W.size() != rows * cols)
+            continue;
+        for (size_t i = 0; i < rows; i++)
+        {
+            const ElemType k = scale[i] * invStdDev[i];
+            for (size_t j = 0; j < cols; j++)
+                W[i + j * rows] *= k;
+            b[i] = k * (b[i] - mean[i]) + beta[i];
+        }
+        SetValueFromHost(weights, W);
+
+        if (!plus)
+        {
+            ComputationNodeBasePtr newBias = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, node->NodeName() + L".bias", rows, 1));
+            newBias->SetParameterUpdateRequired(false);
+            SetValueFromHost(newBias, b);
+            plus = AddNodeToNetAndAttachInputs(New<PlusNode<ElemType>>(m_deviceId, node->NodeName() + L".plus"), times, newBias);
+        }
+        else
+            SetValueFromHost(bias, b);
+        ReplaceNodeInGraph(node, plus);
+        numFolded++;
+    }
+    return numFolded;
+}
+
+// Times(W, PerDimMeanVarNormalization(x, mean, invStd)) = W' x + b
+// with W' = W diag(invStd) and b = -W' mean
+template <class ElemType>
+size_t ComputationNetwork::FoldMeanVarNormalizationNodes()
+{
+    size_t numFolded = 0;
+    for (const auto& node : GetNodesWithType(OperationNameOf(PerDimMeanVarNormalizationNode)))
+    {
+        const auto consumers = GetConsumersOf(node);
+        if (consumers.size() != 1 || IsInNodeGroup(node))
+            continue;
+        const ComputationNodeBasePtr times = consumers[0];
+        if (times->OperationName() != OperationNameOf(TimesNode) || times->GetInputs()[1] != node || !node->HasMBLayout())
+            continue;
+        const ComputationNodeBasePtr weights = times->GetInputs()[0];
+        if (weights->OperationName() != OperationNameOf(LearnableParameter) || !IsUsedOnlyBy(weights, times))
+            continue;
+        const size_t rows = weights->GetAsMatrixNumRows(), cols = weights->GetAsMatrixNumCols();
+        const ComputationNodeBasePtr meanNode = node->GetInputs()[1];
+        const ComputationNodeBasePtr invStdDevNode = node->GetInputs()[2];
+        if (!IsConstantLeaf<ElemType>(meanNode) || !IsConstantLeaf<ElemType>(invStdDevNode))
+            continue;
+
+        vector<ElemType> W = ValueToHost<ElemType>(weights);
+        const vector<ElemType> mean = ValueToHost<ElemType>(meanNode);
+        const vector<ElemType> invStdDev = ValueToHost<ElemType>(invStdDevNode);
+        if (W.size() != rows * cols || mean.size() != cols || invStdDev.size() != cols)
+            continue;
+        vector<ElemType> b(rows, 0);
+        for (size_t j = 0; j < cols; j++)
+        {
+            for (size_t i = 0; i < rows; i++)
+            {
+                W[i + j * rows] *= invStdDev[j];
+                b[i] -= W[i + j * rows] * mean[j];
+            }
+        }
+        SetValueFromHost(weights, W);
+
+        ComputationNodeBasePtr newBias = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, times->NodeName() + L".bias", rows, 1));
+        newBias->SetParameterUpdateRequired(false);
+        SetValueFromHost(newBias, b);
+        auto newTimes = AddNodeToNetAndAttachInputs(New<TimesNode<ElemType>>(m_deviceId, times->NodeName() + L".unnormalized"), weights, node->GetInputs()[0]);
+        auto plus = AddNodeToNetAndAttachInputs(New<PlusNode<ElemType>>(m_deviceId, times->NodeName() + L".plus"), newTimes, newBias);
+        ReplaceNodeInGraph(times, plus);
+        numFolded++;
+    }
+    return numFolded;
+}
+
+// act(Plus(Times(W, x), b)) -> AffineActivation(W, x, b)
+template <class ElemType>
+size_t ComputationNetwork::FuseAffineActivations()
+{
+    size_t numFused = 0;
+    for (const auto& times : GetNodesWithType(OperationNameOf(TimesNode)))
+    {
+        if (!times->HasMBLayout() || IsInNodeGroup(times))
+            continue;
+        const auto consumers = GetConsumersOf(times);
+        if (consumers.size() != 1 || consumers[0]->OperationName() != OperationNameOf(PlusNode) || consumers[0]->GetInputs()[0] != times)
+            continue;
+        const ComputationNodeBasePtr plus = consumers[0];
+        const ComputationNodeBasePtr bias = plus->GetInputs()[1];
+        if (bias->HasMBLayout() || bias->GetAsMatrixNumRows() != times->GetSampleMatrixNumRows() || bias->GetAsMatrixNumCols() != 1)
+            continue;
+
+        ComputationNodeBasePtr last = plus;
+        wstring activation;
+        const auto plusConsumers = GetConsumersOf(plus);
+        if (plusConsumers.size() == 1 && !IsInNodeGroup(plus))
+        {
+            const wstring& op = plusConsumers[0]->OperationName();
+            if (op == OperationNameOf(SigmoidNode) || op == OperationNameOf(TanhNode) || op == OperationNameOf(RectifiedLinearNode))
+            {
+                last = plusConsumers[0];
+                activation = op;
+            }
+        }
+
+        auto fused = AddNodeToNetAndAttachInputs(New<AffineActivationNode<ElemType>>(m_deviceId, last->NodeName() + L".fused", activation), times->GetInputs()[0], times->GetInputs()[1], bias);
+        ReplaceNodeInGraph(last, fused);
+        numFused++;
+    }
+    return numFused;
+}
+
+template void ComputationNetwork::OptimizeForInference<float>(bool fuseAffine);
+template void ComputationNetwork::OptimizeForInference<double>(bool fuseAffine);
+
+// -----------------------------------------------------------------------
+// transpose fusion
+// Times(Transpose(A), B) becomes TransposeTimes(A, B), whose GEMM calls take A with the transpose flag. So the
+// transposed copy of A, its value and gradient buffers, and the transposing back of the gradient all go away.
+// A Transpose that also has other consumers is kept for them. This is done by CompileNetwork() on every network
+// and, unlike OptimizeForInference(), leaves it trainable.
+// -----------------------------------------------------------------------
+
+size_t ComputationNetwork::FuseTransposesIntoTimes()
+{
+    const auto transposes = GetNodesWithType(OperationNameOf(TransposeNode));
+    if (transposes.empty())
+        return 0;
+    if (dynamic_pointer_cast<ComputationNode<float>>(transposes.front()))
+        return FuseTransposesIntoTimes<float>();
+    else
+        return FuseTransposesIntoTimes<double>();
+}
+
+template <class ElemType>
+size_t ComputationNetwork::FuseTransposesIntoTimes()
+{
+    size_t numFused = 0;
+    for (const auto& times : GetNodesWithType(OperationNameOf(TimesNode)))
+    {
+        const ComputationNodeBasePtr transpose = times->GetInputs()[0];
+        if (transpose->OperationName() != OperationNameOf(TransposeNode))
+            continue;
+        auto fused = AddNodeToNetAndAttachInputs(New<TransposeTimesNode<ElemType>>(m_deviceId, times->NodeName() + L".fused"), transpose->GetInputs()[0], times->GetInputs()[1]);
+        ReplaceNodeInGraph(times, fused); // (deletes the Transpose if this was its only use)
+        numFused++;
+    }
+    if (numFused > 0)
+        fprintf(stderr, "FuseTransposesIntoTimes: %d Times nodes of a Transpose replaced by TransposeTimes.\n", (int) numFused);
+    return numFused;
+}
+
+// -----------------------------------------------------------------------
+// convolution fusion
+// RectifiedLinear(Plus(Convolution(W, x), b)) becomes ConvolutionBiasActivation(W, x, b), whose engine adds the
+// per-channel bias and applies the activation while it computes the convolution. So the Plus and the RectifiedLinear,
+// each with a value and a gradient of the size of the convolution's output, go away. Without a RectifiedLinear, the
+// bias alone is fused. With fusePooling, a MaxPooling of the result is moved in front of the activation, since
+// MaxPooling(RectifiedLinear(y)) = RectifiedLinear(MaxPooling(y)): the activation then works on the pooled output, and
+// the backprop of the convolution needs no masked copy of its gradient.
+// The nodes that go away must have no other consumers and not be in a node group. This is done by CompileNetwork()
+// if g_fuseConvolutions is set, and leaves the network trainable.
+// -----------------------------------------------------------------------
+
+size_t ComputationNetwork::FuseConvolutionActivations(bool fusePooling)
+{
+    const auto convolutions = GetNodesWithType(OperationNameOf(ConvolutionNode));
+    if (convolutions.empty())
+        return 0;
+    if (dynamic_pointer_cast<ComputationNode<float>>(convolutions.front()))
+        return FuseConvolutionActivations<float>(fusePooling);
+    else
+        return FuseConvolutionActivations<double>(fusePooling);
+}
+
+// a parameter with one value per output channel of the convolution, along the channel axis of its output
+// ([C' x 1] for HWC, [1 x 1 x C'] for CHW); checked on the declared dimensions, as this runs before validation
+template <class ElemType>
+static bool IsChannelBias(const ConvolutionNode<ElemType>& convolution, const ComputationNodeBasePtr& bias)
+{
+    if (bias->OperationName() != OperationNameOf(LearnableParameter))
+        return false;
+    const TensorShape& shape = bias->GetSampleLayout();
+    const size_t channelAxis = convolution.ImageLayout() == ImageLayoutKind::HWC ? 0 : 2;
+    return shape.GetNumElements() == convolution.OutputChannels() && shape.GetRank() > channelAxis && shape[channelAxis] == convolution.OutputChannels();
+}
+
+template <class ElemType>
+size_t ComputationNetwork::FuseConvolutionActivations(bool fusePooling)
+{
+    size_t numFused = 0, numPoolingsFused = 0;
+    for (const auto& node : GetNodesWithType(OperationNameOf(ConvolutionNode)))
+    {
+        const auto convolution = dynamic_pointer_cast<ConvolutionNode<ElemType>>(node);
+        if (IsInNodeGroup(node))
+            continue;
+        const auto consumers = GetConsumersOf(node);
+        if (consumers.size() != 1 || consumers[0]->OperationName() != OperationNameOf(PlusNode))
+            continue;
+        const ComputationNodeBasePtr plus = consumers[0];
+        const ComputationNodeBasePtr bias = plus->GetInputs()[plus->GetInputs()[0] == node ? 1 : 0];
+        if (bias == node || !IsChannelBias(*convolution, bias))
+            continue;
+
+        ComputationNodeBasePtr last = plus;
+        wstring activation;
+        const auto plusConsumers = GetConsumersOf(plus);
+        if (plusConsumers.size() == 1 && !IsInNodeGroup(plus) && plusConsumers[0]->OperationName() == OperationNameOf(RectifiedLinearNode))
+        {
+            last = plusConsumers[0];
+            activation = OperationNameOf(RectifiedLinearNode);
+        }
+
+        // RectifiedLinear(MaxPooling(y)) instead of MaxPooling(RectifiedLinear(y))
+        ComputationNodeBasePtr pooling;
+        if (fusePooling && !activation.empty() && !IsInNodeGroup(last))
+        {
+            const auto reluConsumers = GetConsumersOf(last);
+            if (reluConsumers.size() == 1 && reluConsumers[0]->OperationName() == OperationNameOf(MaxPoolingNode))
+            {
+                pooling = reluConsumers[0];
+                activation.clear();
+            }
+        }
+
+        auto fused = AddNodeToNetAndAttachInputs(New<ConvolutionBiasActivationNode<ElemType>>(m_deviceId, last->NodeName() + L".fused", *convolution, activation), node->GetInputs()[0], node->GetInputs()[1], bias);
+        ReplaceNodeInGraph(last, fused); // (deletes the Convolution and the Plus)
+        if (pooling)
+        {
+            const wstring name = pooling->NodeName();
+            auto relu = AddNodeToNetAndAttachInputs(New<RectifiedLinearNode<ElemType>>(m_deviceId, name + L".rectified"), pooling);
+            ReplaceAllUsesOfNode(pooling, relu); // (but the one by the new node itself)
+            RenameNode(pooling, name + L".unrectified");
+            RenameNode(relu, name);
+            numPoolingsFused++;
+        }
+        numFused++;
+    }
+    if (numFused > 0)
+        fprintf(stderr, "FuseConvolutionActivations: %d Convolution nodes fused with their bias and activation, %d of them with a MaxPooling.\n", (int) numFused, (int) numPoolingsFused);
+    return numFused;
+}
+
+// -----------------------------------------------------------------------
+// model-parallel placement
+// PlaceNodesOnDevices() spreads a network that is too large for one GPU over several:
+//  - 'placement' moves all nodes whose names match a pattern (with '*' wildcards) to a device; later patterns win
+//  - 'shardedTimes' splits the weight matrix of a Times(W, x) node by rows over several devices, each computing its
+//    part of the output; a RowStack on the node's own device puts them together again (a large output layer)
+//  - a DeviceTransfer node is put at every edge whose ends are on different devices
+// Inputs, criteria, and evaluation nodes stay on the network's device, as readers and SGD expect them there.
+// This must happen before the matrices get allocated. It can be repeated, e.g. for a model that was saved with
+// its DeviceTransfer nodes and shards (which is a valid single-device model).
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void ComputationNetwork::PlaceNodesOnDevices(const vector<pair<wstring, DEVICEID_TYPE>>& placement, const vector<pair<wstring, vector<DEVICEID_TYPE>>>& shardedTimes)
+{
+    if (!IsCompiled())
+        CompileNetwork();
+    const size_t numRemoved = RemoveDeviceTransfers();
+
+    for (const auto& shard : shardedTimes)
+        ShardTimesNode<ElemType>(GetNodeFromName(shard.first), shard.second);
+
+    for (const auto& place : placement)
+    {
+        const auto nodes = GetNodesFromName(place.first);
+        if (nodes.empty())
+            InvalidArgument("PlaceNodesOnDevices: No node matches '%ls'.", place.first.c_str());
+        for (const auto& node : nodes)
+        {
+            if (find(FeatureNodes().begin(), FeatureNodes().end(), node) != FeatureNodes().end() ||
+                find(LabelNodes().begin(), LabelNodes().end(), node) != LabelNodes().end())
+                InvalidArgument("PlaceNodesOnDevices: The input %ls cannot be moved off the network's device.", node->NodeName().c_str());
+            node->MoveToDevice(place.second);
+        }
+    }
+    for (const auto& group : {&FinalCriterionNodes(), &EvaluationNodes()})
+        for (const auto& node : *group)
+            if (node->GetDeviceId() != m_deviceId)
+                InvalidArgument("PlaceNodesOnDevices: The criterion or evaluation node %ls must stay on the network's device %d.", node->NodeName().c_str(), (int) m_deviceId);
+
+    const size_t numInserted = InsertDeviceTransfers<ElemType>();
+    fprintf(stderr, "PlaceNodesOnDevices: sharded %d Times nodes, %d cross-device edges (%d DeviceTransfer nodes replaced).\n",
+            (int) shardedTimes.size(), (int) numInserted, (int) numRemoved);
+
+    CompileNetwork();
+}
+
+// take out the DeviceTransfer nodes of an earlier placement
+size_t ComputationNetwork::RemoveDeviceTransfers()
+{
+    const auto transfers = GetNodesWithType(OperationNameOf(DeviceTransferNode));
+    for (const auto& node : transfers)
+    {
+        ReplaceAllUsesOfNode(node, node->GetInputs()[0]);
+        DeleteNode(node->NodeName());
+    }
+    return transfers.size();
+}
+
+// Times(W, x) -> RowStack(Times(W.shard0, x), Times(W.shard1, x), ...), with shard k on devices[k]
+// Only for a matrix W used by this node only, and a vector-valued result, so that stacking the rows is exact.
+// A node that is such a RowStack already (a saved sharded model) just gets its shards moved.
+template <class ElemType>
+void ComputationNetwork::ShardTimesNode(const ComputationNodeBasePtr& node, const vector<DEVICEID_TYPE>& devices)
+{
+    const wstring name = node->NodeName();
+    const size_t numShards = devices.size();
+    if (node->OperationName() == OperationNameOf(RowStackNode))
+    {
+        if (node->GetNumInputs() != numShards)
+            InvalidArgument("PlaceNodesOnDevices: %ls was sharded %d ways, not %d.", name.c_str(), (int) node->GetNumInputs(), (int) numShards);
+        for (size_t k = 0; k < numShards; k++)
+        {
+            const ComputationNodeBasePtr shard = node->GetInputs()[k];
+            if (shard->NodeName() != name + L".shard" + std::to_wstring(k) || shard->OperationName() != OperationNameOf(TimesNode))
+                InvalidArgument("PlaceNodesOnDevices: %ls is a RowStack, but not of the shards of a Times node.", name.c_str());
+            shard->MoveToDevice(devices[k]);
+            shard->GetInputs()[0]->MoveToDevice(devices[k]);
+        }
+        return;
+    }
+
+    if (node->OperationName() != OperationNameOf(TimesNode))
+        InvalidArgument("PlaceNodesOnDevices: %ls is a %ls node; only Times nodes can be sharded.", name.c_str(), node->OperationName().c_str());
+    const ComputationNodeBasePtr weights = node->GetInputs()[0];
+    const ComputationNodeBasePtr x = node->GetInputs()[1];
+    if (weights->OperationName() != OperationNameOf(LearnableParameter) || !IsUsedOnlyBy(weights, node) ||
+        weights->GetSampleLayout().GetRank() > 2 || node->GetSampleLayout().GetRank() != 1)
+        InvalidArgument("PlaceNodesOnDevices: %ls cannot be sharded; that needs a weight matrix used by it only, and a vector-valued result.", name.c_str());
+    const size_t rows = weights->GetAsMatrixNumRows(), cols = weights->GetAsMatrixNumCols();
+    if (numShards < 2 || rows < numShards)
+        InvalidArgument("PlaceNodesOnDevices: %ls has %d rows, which cannot be split %d ways.", name.c_str(), (int) rows, (int) numShards);
+
+    const vector<ElemType> W = ValueToHost<ElemType>(weights);
+    vector<ComputationNodeBasePtr> shards;
+    for (size_t k = 0; k < numShards; k++)
+    {
+        const size_t firstRow = rows * k / numShards, numRows = rows * (k + 1) / numShards - firstRow;
+        vector<ElemType> values(numRows * cols);
+        for (size_t j = 0; j < cols; j++)
+            for (size_t i = 0; i < numRows; i++)
+                values[i + j * numRows] = W[firstRow + i + j * rows];
+        ComputationNodeBasePtr shardWeights = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(devices[k], weights->NodeName() + L".shard" + std::to_wstring(k), numRows, cols));
+        shardWeights->SetParameterUpdateRequired(weights->IsParameterUpdateRequired());
+        SetValueFromHost(shardWeights, values);
+        shards.push_back(AddNodeToNetAndAttachInputs(New<TimesNode<ElemType>>(devices[k], name + L".shard" + std::to_wstring(k)), shardWeights, x));
+    }
+    auto stacked = AddNodeToNetAndAttachInputs(New<RowStackNode<ElemType>>(node->GetDeviceId(), name + L".stacked"), shards);
+    ReplaceNodeInGraph(node, stacked);
+}
+
+// route every input that lives on another device than its consumer through a DeviceTransfer node,
+// one per input and device, named after the input
+template <class ElemType>
+size_t ComputationNetwork::InsertDeviceTransfers()
+{
+    size_t numEdges = 0;
+    map<pair<ComputationNodeBasePtr, DEVICEID_TYPE>, ComputationNodeBasePtr> transfers;
+    list<ComputationNodeBasePtr> nodes;
+    for (const auto& iter : m_nameToNodeMap)
+        nodes.push_back(iter.second);
+    for (const auto& node : nodes)
+    {
+        for (size_t i = 0; i < node->GetNumInputs(); i++)
+        {
+            const ComputationNodeBasePtr input = node->GetInputs()[i];
+            if (!input || input->GetDeviceId() == node->GetDeviceId())
+                continue;
+            auto& transfer = transfers[make_pair(input, node->GetDeviceId())];
+            if (!transfer)
+                transfer = AddNodeToNetAndAttachInputs(New<DeviceTransferNode<ElemType>>(node->GetDeviceId(), input->NodeName() + L".onDevice" + std::to_wstring(node->GetDeviceId())), input);
+            node->SetInput(i, transfer);
+            numEdges++;
+        }
+    }
+    InvalidateCompiledNetwork();
+    return numEdges;
+}
+
+// model parallelism: split the eval order of 'rootNode' into contiguous stages of about equal forward cost, stage k
+// on stageDevices[k], as a placement for PlaceNodesOnDevices(). Parameters go with the stage of their first consumer.
+// Inputs, criteria, and evaluation nodes are not placed (they stay on the network's device, which should be the last stage's).
+vector<pair<wstring, DEVICEID_TYPE>> ComputationNetwork::PartitionIntoStages(const ComputationNodeBasePtr& rootNode, const vector<DEVICEID_TYPE>& stageDevices)
+{
+    if (stageDevices.empty())
+        InvalidArgument("PartitionIntoStages: No devices given.");
+    if (!IsCompiled())
+        CompileNetwork();
+    const auto& evalOrder = GetEvalOrder(rootNode);
+
+    double totalCost = 0;
+    for (const auto& node : evalOrder)
+        if (!node->IsLeaf())
+            totalCost += node->GetForwardFlopsEstimate();
+
+    const size_t numStages = stageDevices.size();
+    set<ComputationNodeBasePtr> unplaced(FinalCriterionNodes().begin(), FinalCriterionNodes().end());
+    unplaced.insert(EvaluationNodes().begin(), EvaluationNodes().end());
+    map<ComputationNodeBasePtr, size_t> stageOf;
+    vector<size_t> numNodesOfStage(numStages, 0);
+    double cost = 0;
+    for (const auto& node : evalOrder)
+    {
+        if (node->IsLeaf())
+            continue;
+        const double nodeCost = node->GetForwardFlopsEstimate();
+        // (a node goes to the stage that holds the middle of its cost)
+        const size_t stage = totalCost > 0 ? min(numStages - 1, (size_t) (numStages * (cost + nodeCost / 2) / totalCost)) : 0;
+        cost += nodeCost;
+        stageOf[node] = stage;
+        for (const auto& input : node->GetInputs())
+            if (input && input->IsLeaf() && stageOf.find(input) == stageOf.end())
+                stageOf[input] = stage;
+    }
+
+    vector<pair<wstring, DEVICEID_TYPE>> placement;
+    for (const auto& node : evalOrder)
+    {
+        auto iter = stageOf.find(node);
+        if (iter == stageOf.end() || unplaced.find(node) != unplaced.end() ||
+            find(FeatureNodes().begin(), FeatureNodes().end(), node) != FeatureNodes().end() ||
+            find(LabelNodes().begin(), LabelNodes().end(), node) != LabelNodes().end())
+            continue;
+        placement.push_back(make_pair(node->NodeName(), stageDevices[iter->second]));
+        numNodesOfStage[iter->second]++;
+    }
+    for (size_t k = 0; k < numStages; k++)
+        fprintf(stderr, "PartitionIntoStages: stage %d on device %d: %d nodes.\n", (int) k, (int) stageDevices[k], (int) numNodesOfStage[k]);
+    return placement;
+}
+
+template void ComputationNetwork::PlaceNodesOnDevices<float>(const vector<pair<wstring, DEVICEID_TYPE>>& placement, const vector<pair<wstring, vector<DEVICEID_TYPE>>>& shardedTimes);
+template void ComputationNetwork::PlaceNodesOnDevices<double>(const vector<pair<wstring, DEVICEID_TYPE>>& placement, const vector<pair<wstring, vector<DEVICEID_TYPE>>>& shardedTimes);
 } } }
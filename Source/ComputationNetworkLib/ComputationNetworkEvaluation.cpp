@@ -10,6 +10,10 @@
 #include "ComputationNetwork.h"
 #include "RecurrentNodes.h"
 #include "InputAndParamNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "ReshapingNodes.h"
+#include "NodeProfiler.h"
+#include "CUDAPageLockedMemAllocator.h"
 #include <string>
 #include <vector>
 #include <list>
@@ -39,14 +43,20 @@ void ComputationNetwork::ForwardProp(const ComputationNodeBasePtr rootNode)
 {
     VerifyIsCompiled("ForwardProp");
 
+    // (whatever the nodes allocate besides their values and gradients is a temporary of theirs)
+    ScopedMemoryTag memoryTag(MemoryTag::MatrixPool);
+
     // traverse all nodes in the pre-determined evaluation order
-    GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr));
+    auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    network->m_nodeProfiler = m_nodeProfiler.get();
+    network->ForwardProp(FrameRange(nullptr));
+    network->m_nodeProfiler = nullptr;
 }
 
 // set the gradient matrix of a node to an 1x1 matrix containing 1.0
 // Returns false if the node is not a ComputationNode<ElemType>.
 template <class ElemType>
-static bool SetGradientToScalarOne(ComputationNodeBasePtr nodep)
+static bool SetGradientToScalar(ComputationNodeBasePtr nodep, double value)
 {
     auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodep);
     bool hasMatchingType = (node != nullptr);
@@ -54,7 +64,7 @@ static bool SetGradientToScalarOne(ComputationNodeBasePtr nodep)
     {
         node->Value().VerifySize(1, 1);
         node->Gradient().Resize(1, 1);
-        node->Gradient().SetValue((ElemType) 1.0);
+        node->Gradient().SetValue((ElemType) value);
     }
     return hasMatchingType;
 }
@@ -64,17 +74,35 @@ static bool SetGradientToScalarOne(ComputationNodeBasePtr nodep)
 //  - ForwardProp() for eval nodes
 //  - ForwardProp() for the training criterion (which will reuse computation results from the previous step)
 //  - Backprop() for the training criterion
-void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // training criterion to compute the gradients for
+void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode, double rootGradient, bool accumulateParameterGradients) // training criterion to compute the gradients for
 {
+    ScopedMemoryTag memoryTag(MemoryTag::MatrixPool);
+
     // reset all gradients to zero (actually, internally, this is lazy, but we don't care here)
     ZeroGradients(rootNode);
 
-    // initialize root gradient with a scalar value of 1.0
-    if (!SetGradientToScalarOne<float>(rootNode) && !SetGradientToScalarOne<double>(rootNode))
+    // when accumulating, the parameter gradients keep what earlier Backprop() calls left in them
+    // (only valid after a first Backprop() without accumulation, which has sized and zeroed them)
+    if (accumulateParameterGradients)
+    {
+        for (auto& node : GetEvalOrder(rootNode))
+        {
+            if (node->IsParameterUpdateRequired())
+                node->KeepGradient();
+        }
+    }
+
+    // initialize root gradient with a scalar value of 1.0 (or the loss scale)
+    if (!SetGradientToScalar<float>(rootNode, rootGradient) && !SetGradientToScalar<double>(rootNode, rootGradient))
         LogicError("Backprop: Training criterion is neither ComputationNode<float> nor ComputationNode<double>.");
 
     // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    network->m_gradientFinalCallback = m_gradientFinalCallback;
+    network->m_nodeProfiler = m_nodeProfiler.get();
+    network->Backprop(FrameRange(nullptr), true, true);
+    network->m_gradientFinalCallback = nullptr;
+    network->m_nodeProfiler = nullptr;
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -127,36 +155,1070 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
-    for (auto& node : m_nestedNodes)
+    const bool useStreams = !m_forwardSchedule.streamOf.empty();
+    if (m_nodeProfiler)
+        m_nodeProfiler->BeginPass(false /*isBackprop*/);
+    for (int i = 0; i < (int) m_nestedNodes.size(); i++)
     {
+        auto& node = m_nestedNodes[i];
+        if (!m_offloads.empty())
+            OffloadBeforeForwardProp(i);
+
+        // concurrent loops: the group is evaluated as a whole at its first loop
+        if (!m_concurrentLoopsOf.empty() && m_concurrentLoopsOf[i] >= 0 && m_concurrentLoops[m_concurrentLoopsOf[i]].begin == i)
+        {
+            const auto& group = m_concurrentLoops[m_concurrentLoopsOf[i]];
+            MatrixTransferMonitor::Scope transferScope(node->NodeName(), "forward");
+            if (m_nodeProfiler)
+                m_nodeProfiler->BeginNode();
+            ForwardPropConcurrentLoops(group);
+            if (m_nodeProfiler)
+                m_nodeProfiler->EndNode(node, NodeProfiler::Phase::forward, 0, group.end - group.begin);
+            i = group.end - 1;
+            continue;
+        }
+
+        // wavefront: the loops and the nodes between them are evaluated as a whole at the first loop, on their own streams
+        if (!m_wavefrontOf.empty() && m_wavefrontOf[i] >= 0)
+        {
+            const auto& wavefront = m_wavefronts[m_wavefrontOf[i]];
+            bool isOutputOlderThanInputs = false;
+            for (int j = wavefront.begin; j < wavefront.end; j++)
+                isOutputOlderThanInputs |= wavefront.stageOf[j - wavefront.begin] >= 0 && m_nestedNodes[j]->IsOutputOlderThanInputs();
+            if (isOutputOlderThanInputs)
+            {
+                MatrixTransferMonitor::Scope transferScope(node->NodeName(), "forward");
+                if (m_nodeProfiler)
+                    m_nodeProfiler->BeginNode();
+                ForwardPropWavefront(wavefront);
+                if (m_nodeProfiler)
+                    m_nodeProfiler->EndNode(node, NodeProfiler::Phase::forward, 0, wavefront.end - wavefront.begin);
+            }
+            i = wavefront.end - 1;
+            continue;
+        }
+
+        if (useStreams)
+            EnterStream(m_forwardSchedule, i, 0);
+        const size_t stream = useStreams ? m_forwardSchedule.streamOf[i] : 0;
+
+        // elementwise fusion: a group is evaluated as a whole at its first member
+        if (!m_fusedGroupOf.empty() && m_fusedGroupOf[i] >= 0)
+        {
+            const auto& group = m_fusedGroups[m_fusedGroupOf[i]];
+            bool isOutputOlderThanInputs = false;
+            for (int j = group.begin; j < group.end; j++)
+                isOutputOlderThanInputs |= m_nestedNodes[j]->IsOutputOlderThanInputs();
+            if (isOutputOlderThanInputs)
+            {
+                MatrixTransferMonitor::Scope transferScope(node->NodeName(), "forward");
+                if (m_nodeProfiler)
+                    m_nodeProfiler->BeginNode();
+                if (dynamic_pointer_cast<ComputationNode<float>>(node))
+                    ForwardPropFusedGroup<float>(fr, group);
+                else
+                    ForwardPropFusedGroup<double>(fr, group);
+                if (m_nodeProfiler)
+                    m_nodeProfiler->EndNode(node, NodeProfiler::Phase::forward, stream, group.end - group.begin);
+            }
+            if (useStreams)
+                LeaveStream(m_forwardSchedule, i, 0);
+            i = group.end - 1;
+            continue;
+        }
+
         if (node->IsOutputOlderThanInputs())
         {
             auto recInfo = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node);
             if (recInfo)
                 assert(recInfo->m_sourceNode->GetMBLayout() == node->GetMBLayout());
 
+            MatrixTransferMonitor::Scope transferScope(node->NodeName(), "forward");
+            if (m_nodeProfiler)
+                m_nodeProfiler->BeginNode();
             node->BeginForwardProp();
             node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
             node->EndForwardProp();
+            if (m_nodeProfiler)
+                m_nodeProfiler->EndNode(node, NodeProfiler::Phase::forward, stream);
 
             node->BumpEvalTimeStamp();
         }
+        if (useStreams)
+            LeaveStream(m_forwardSchedule, i, 0);
     }
+    if (!m_offloads.empty())
+        OffloadBeforeForwardProp((int) m_nestedNodes.size());
+    if (useStreams)
+        ComputeStreams::Join(m_streamDeviceId);
+    if (m_nodeProfiler)
+        m_nodeProfiler->EndPass();
 }
 
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
+    // with recomputation, backprop is interleaved with forward prop of whole segments, which the schedule does not cover
+    const bool useStreams = !m_backpropSchedule.streamOf.empty() && m_isRecomputed.empty();
     // process nodes in pre-determined order
-    for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+    int currentSegment = -1;
+    if (m_nodeProfiler)
+        m_nodeProfiler->BeginPass(true /*isBackprop*/);
+    for (int i = (int) m_nestedNodes.size() - 1; i >= 0; i--) // iterate backwards over evaluation order
+    {
+        auto& node = m_nestedNodes[i];
+
+        // gradient checkpointing: entering a new segment from its end, so bring back the outputs that were not kept
+        if (!m_isRecomputed.empty() && (int) (i / m_recomputeSegmentLength) != currentSegment)
+        {
+            currentSegment = (int) (i / m_recomputeSegmentLength);
+            RecomputeSegment(fr, currentSegment, i);
+        }
+
+        // concurrent loops: the group is processed as a whole at its last loop (not with recomputation, which works by index)
+        const bool isConcurrentLoops = !m_concurrentLoopsOf.empty() && m_isRecomputed.empty() && m_concurrentLoopsOf[i] >= 0 && m_concurrentLoops[m_concurrentLoopsOf[i]].end == i + 1;
+        if (!m_offloads.empty())
+            OffloadBeforeBackprop(isConcurrentLoops ? m_concurrentLoops[m_concurrentLoopsOf[i]].begin : i);
+        if (isConcurrentLoops)
+        {
+            const auto& group = m_concurrentLoops[m_concurrentLoopsOf[i]];
+            MatrixTransferMonitor::Scope transferScope(node->NodeName(), "backprop");
+            if (m_nodeProfiler)
+                m_nodeProfiler->BeginNode();
+            BackpropConcurrentLoops(group);
+            if (m_nodeProfiler)
+                m_nodeProfiler->EndNode(node, NodeProfiler::Phase::backprop, 0, group.end - group.begin);
+            i = group.begin;
+            continue;
+        }
+
+        if (useStreams)
+            EnterStream(m_backpropSchedule, i, m_nestedNodes.size());
+        if (node->NeedGradient()) // (no learnable parameter below it, so none of its inputs takes a gradient either)
+        {
+            MatrixTransferMonitor::Scope transferScope(node->NodeName(), "backprop");
+            if (m_nodeProfiler)
+                m_nodeProfiler->BeginNode();
+            node->BeginBackprop();
+            node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+            node->EndBackprop();
+            if (m_nodeProfiler)
+                m_nodeProfiler->EndNode(node, NodeProfiler::Phase::backprop, useStreams ? m_backpropSchedule.streamOf[i] : 0);
+        }
+        if (useStreams)
+            LeaveStream(m_backpropSchedule, i, m_nestedNodes.size());
+
+        // all consumers of a parameter come after it in evaluation order, so they are done once we get here
+        if (m_gradientFinalCallback && node->IsLeaf() && node->IsParameterUpdateRequired() && node->NeedGradient())
+            m_gradientFinalCallback(node);
+    }
+    if (useStreams)
+        ComputeStreams::Join(m_streamDeviceId);
+    if (m_nodeProfiler)
+        m_nodeProfiler->EndPass();
+}
+
+// switch to the stream of m_nestedNodes[i] and wait for the nodes on other streams that it depends on
+// Events are numbered by node index, starting at 'firstEvent' (forward and backprop use separate ranges).
+void ComputationNetwork::PARTraversalFlowControlNode::EnterStream(const StreamSchedule& schedule, int i, size_t firstEvent)
+{
+    ComputeStreams::Select(m_streamDeviceId, schedule.streamOf[i]);
+    for (int j : schedule.waitsFor[i])
+        ComputeStreams::WaitEvent(m_streamDeviceId, firstEvent + j);
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::LeaveStream(const StreamSchedule& schedule, int i, size_t firstEvent)
+{
+    if (schedule.isWaitedFor[i])
+        ComputeStreams::RecordEvent(m_streamDeviceId, firstEvent + i);
+}
+
+// assign every node to a stream such that chains of dependent nodes stay on one stream and independent branches spread out
+// A node continues the stream of the first of its dependencies that is still the last node on its stream and has not
+// been continued by another node; otherwise it starts a new branch on the next stream in turn. It then waits for
+// its dependencies on other streams. Leaves (inputs and parameters) compute nothing and stay on the default stream.
+// In forward prop, a node depends on the nodes it reads. In backprop, processed in reverse order, a node depends on
+// the nodes that wrote its gradient (its consumers) and on those that write the same input gradients as it does.
+// Fused groups run as a whole at their first member. All streams are joined at the end of either pass.
+void ComputationNetwork::PARTraversalFlowControlNode::PlanStreams(size_t numStreams, DEVICEID_TYPE deviceId)
+{
+    m_streamDeviceId = deviceId;
+    const int numNodes = (int) m_nestedNodes.size();
+
+    // [i] -> index of the entry that executes m_nestedNodes[i]: itself, or the first member of its fused group
+    vector<int> unitOf(numNodes);
+    for (int i = 0; i < numNodes; i++)
+        unitOf[i] = i;
+    for (const auto& group : m_fusedGroups)
+        for (int j = group.begin; j < group.end; j++)
+            unitOf[j] = group.begin;
+
+    // [node] -> index into m_nestedNodes; nodes inside loops map to their loop
+    map<ComputationNodeBasePtr, int> positionOf;
+    vector<vector<ComputationNodeBasePtr>> membersOf(numNodes);
+    for (int i = 0; i < numNodes; i++)
+    {
+        auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[i]);
+        if (loop)
+            membersOf[i] = loop->m_nestedNodes;
+        else
+            membersOf[i].push_back(m_nestedNodes[i]);
+        for (const auto& member : membersOf[i])
+            positionOf[member] = i;
+    }
+
+    // inputs of each entry that are outside of it
+    vector<set<int>> inputsOf(numNodes);
+    for (int i = 0; i < numNodes; i++)
+    {
+        for (const auto& member : membersOf[i])
+        {
+            for (const auto& input : member->GetInputs())
+            {
+                auto iter = positionOf.find(input);
+                if (iter != positionOf.end() && iter->second != i)
+                    inputsOf[i].insert(iter->second);
+            }
+        }
+    }
+
+    auto isLeaf = [&](int i)
+    {
+        return membersOf[i].size() == 1 && membersOf[i].front()->IsLeaf();
+    };
+
+    // assign streams to units processed in the given order, given each unit's dependencies
+    auto schedule = [&](StreamSchedule& s, const vector<int>& order, const vector<vector<int>>& dependenciesOf)
+    {
+        s.streamOf.assign(numNodes, 0);
+        s.waitsFor.assign(numNodes, vector<int>());
+        s.isWaitedFor.assign(numNodes, false);
+        vector<int> lastOnStream(numStreams, -1);
+        vector<bool> isContinued(numNodes, false);
+        size_t nextStream = 0;
+        for (int u : order)
+        {
+            if (isLeaf(u))
+                continue;
+            int stream = -1;
+            for (int d : dependenciesOf[u])
+            {
+                if (lastOnStream[s.streamOf[d]] == d && !isContinued[d])
+                {
+                    stream = (int) s.streamOf[d];
+                    isContinued[d] = true;
+                    break;
+                }
+            }
+            if (stream < 0)
+            {
+                stream = (int) nextStream;
+                nextStream = (nextStream + 1) % numStreams;
+            }
+            s.streamOf[u] = stream;
+            lastOnStream[stream] = u;
+            for (int d : dependenciesOf[u])
+            {
+                if (s.streamOf[d] != s.streamOf[u])
+                {
+                    s.waitsFor[u].push_back(d);
+                    s.isWaitedFor[d] = true;
+                }
+            }
+        }
+    };
+
+    // forward prop: units in evaluation order, depending on the units they read (leaves need no waiting)
+    vector<int> forwardOrder;
+    vector<vector<int>> forwardDependencies(numNodes);
+    for (int i = 0; i < numNodes; i++)
+    {
+        if (unitOf[i] == i)
+            forwardOrder.push_back(i);
+        for (int d : inputsOf[i])
+        {
+            const int unit = unitOf[i], input = unitOf[d];
+            if (input != unit && !isLeaf(input) && find(forwardDependencies[unit].begin(), forwardDependencies[unit].end(), input) == forwardDependencies[unit].end())
+                forwardDependencies[unit].push_back(input);
+        }
+    }
+    for (auto& dependencies : forwardDependencies)
+        sort(dependencies.begin(), dependencies.end());
+    schedule(m_forwardSchedule, forwardOrder, forwardDependencies);
+    for (int i = 0; i < numNodes; i++) // (members of a fused group are not entered, but keep the table consistent)
+        m_forwardSchedule.streamOf[i] = m_forwardSchedule.streamOf[unitOf[i]];
+
+    // backprop: every entry, in reverse order, since fusion only applies to forward prop
+    // An entry's dependencies are its consumers and the earlier processed entries that share an input with it.
+    vector<int> backpropOrder;
+    vector<vector<int>> backpropDependencies(numNodes);
+    vector<vector<int>> consumersOf(numNodes);
+    for (int i = 0; i < numNodes; i++)
+        for (int d : inputsOf[i])
+            consumersOf[d].push_back(i);
+    for (int i = numNodes - 1; i >= 0; i--)
+    {
+        backpropOrder.push_back(i);
+        set<int> dependencies(consumersOf[i].begin(), consumersOf[i].end());
+        for (int input : inputsOf[i])
+            for (int coWriter : consumersOf[input])
+                if (coWriter > i)
+                    dependencies.insert(coWriter);
+        // most recently processed first, so that a chain continues its own stream
+        backpropDependencies[i].assign(dependencies.rbegin(), dependencies.rend());
+    }
+    schedule(m_backpropSchedule, backpropOrder, backpropDependencies);
+
+    size_t numForwardJoins = 0, numBackpropJoins = 0;
+    for (int i = 0; i < numNodes; i++)
+    {
+        numForwardJoins += m_forwardSchedule.waitsFor[i].size();
+        numBackpropJoins += m_backpropSchedule.waitsFor[i].size();
+    }
+    fprintf(stderr, "PlanStreams: %d nodes on %d streams; %d cross-stream dependencies in forward prop, %d in backprop.\n",
+            numNodes, (int) numStreams, (int) numForwardJoins, (int) numBackpropJoins);
+}
+
+// find runs of stacked recurrent loops that can be evaluated as a wavefront
+// A run consists of two or more loops with the same MBLayout and stepping direction. Between two loops there may be
+// leaves and frame-wise nodes with that MBLayout (elementwise ops, products, row slicing and stacking), which then run
+// frame by frame together with the next loop. A loop and the nodes before it form a stage. Since a stage only reads
+// earlier stages at the same time step, stage k can run time step t while stage k + 1 runs t - 1. Only forward prop
+// is changed; backprop runs the loops one after another as before, since it propagates out of a loop in PAR mode.
+void ComputationNetwork::PARTraversalFlowControlNode::PlanWavefronts(size_t numStreams, DEVICEID_TYPE deviceId)
+{
+    m_wavefronts.clear();
+    m_wavefrontOf.assign(m_nestedNodes.size(), -1);
+    m_wavefrontStreams = max(numStreams, (size_t) 1);
+    m_streamDeviceId = deviceId;
+
+    vector<bool> isFused(m_nestedNodes.size(), false); // (fused groups are evaluated as a whole, over all frames)
+    for (const auto& group : m_fusedGroups)
+        for (int j = group.begin; j < group.end; j++)
+            isFused[j] = true;
+    for (int j = 0; j < (int) m_concurrentLoopsOf.size(); j++) // (nor do concurrent loops take part)
+        if (m_concurrentLoopsOf[j] >= 0)
+            isFused[j] = true;
+    auto isFrameWise = [](const ComputationNodeBasePtr& node)
+    {
+        ElementWiseOperator op;
+        const wstring name = node->OperationName();
+        return node->GetElementWiseForwardOp(op) ||
+               name == OperationNameOf(TimesNode) || name == OperationNameOf(TransposeTimesNode) || name == OperationNameOf(DiagTimesNode) ||
+               name == OperationNameOf(PlusNode) || name == OperationNameOf(MinusNode) || name == OperationNameOf(ElementTimesNode) ||
+               name == OperationNameOf(RowSliceNode) || name == OperationNameOf(RowStackNode) || name == OperationNameOf(RowRepeatNode);
+    };
+
+    size_t numLoops = 0;
+    for (int i = 0; i < (int) m_nestedNodes.size(); i++)
+    {
+        auto first = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[i]);
+        if (!first || isFused[i])
+            continue;
+        Wavefront wavefront;
+        wavefront.begin = i;
+        wavefront.numStages = 1;
+        wavefront.steppingDirection = first->m_steppingDirection;
+        wavefront.stageOf.assign(1, 0);
+        int end = i + 1; // end of the last complete stage
+        for (int j = i + 1; j < (int) m_nestedNodes.size() && !isFused[j]; j++)
+        {
+            const auto& node = m_nestedNodes[j];
+            auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node);
+            if (loop)
+            {
+                if (loop->GetMBLayout() != first->GetMBLayout() || loop->m_steppingDirection != wavefront.steppingDirection)
+                    break;
+                wavefront.stageOf.push_back(wavefront.numStages++);
+                end = j + 1;
+            }
+            else if (node->IsLeaf())
+                wavefront.stageOf.push_back(-1);
+            else if (node->GetMBLayout() == first->GetMBLayout() && isFrameWise(node))
+                wavefront.stageOf.push_back(wavefront.numStages);
+            else
+                break;
+        }
+        if (wavefront.numStages < 2)
+            continue;
+        wavefront.end = end;
+        wavefront.stageOf.resize(end - i);
+        m_wavefrontOf[i] = (int) m_wavefronts.size();
+        numLoops += wavefront.numStages;
+        i = end - 1;
+        m_wavefronts.push_back(move(wavefront));
+    }
+    if (!m_wavefronts.empty())
+        fprintf(stderr, "PlanWavefronts: %d recurrent loops in %d wavefronts, on %d streams.\n", (int) numLoops, (int) m_wavefronts.size(), (int) m_wavefrontStreams);
+}
+
+// evaluate a wavefront: in step w, stage k runs time step w - k (in its stepping direction)
+// Stages are processed in descending order, so that with several streams, stage k can wait for the event that stage
+// k - 1 recorded after the same time step, in step w - 1, before stage k - 1 records it again.
+void ComputationNetwork::PARTraversalFlowControlNode::ForwardPropWavefront(const Wavefront& wavefront)
+{
+    const auto& pMBLayout = m_nestedNodes[wavefront.begin]->GetMBLayout();
+    const int numTimeSteps = (int) pMBLayout->GetNumTimeSteps();
+    const bool useStreams = m_wavefrontStreams > 1;
+    const size_t firstEvent = 2 * m_nestedNodes.size(); // (after those of the stream schedules)
+    if (useStreams)
+        ComputeStreams::Join(m_streamDeviceId); // (the inputs may come from any stream)
+
+    for (int j = wavefront.begin; j < wavefront.end; j++)
+    {
+        if (wavefront.stageOf[j - wavefront.begin] < 0 && m_nestedNodes[j]->IsOutputOlderThanInputs()) // a leaf: as in PAR mode
+        {
+            m_nestedNodes[j]->BeginForwardProp();
+            m_nestedNodes[j]->ForwardProp(FrameRange(m_nestedNodes[j]->GetMBLayout()));
+            m_nestedNodes[j]->EndForwardProp();
+            m_nestedNodes[j]->BumpEvalTimeStamp();
+        }
+        else if (wavefront.stageOf[j - wavefront.begin] >= 0)
+            m_nestedNodes[j]->BeginForwardProp();
+    }
+
+    for (int w = 0; w < numTimeSteps + wavefront.numStages - 1; w++)
     {
-        auto& node = *pnode;
+        for (int stage = min(w, wavefront.numStages - 1); stage >= 0 && w - stage < numTimeSteps; stage--)
+        {
+            const int t = w - stage;
+            const FrameRange fr(pMBLayout, wavefront.steppingDirection > 0 ? t : numTimeSteps - 1 - t);
+            if (useStreams)
+            {
+                ComputeStreams::Select(m_streamDeviceId, stage % m_wavefrontStreams);
+                if (stage > 0)
+                    ComputeStreams::WaitEvent(m_streamDeviceId, firstEvent + stage - 1);
+            }
+            for (int j = wavefront.begin; j < wavefront.end; j++)
+            {
+                if (wavefront.stageOf[j - wavefront.begin] != stage)
+                    continue;
+                auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[j]);
+                for (auto& node : loop ? loop->m_nestedNodes : vector<ComputationNodeBasePtr>(1, m_nestedNodes[j]))
+                {
+                    node->ForwardProp(fr);
+                    node->BumpEvalTimeStamp();
+                }
+            }
+            if (useStreams && stage < wavefront.numStages - 1)
+                ComputeStreams::RecordEvent(m_streamDeviceId, firstEvent + stage);
+        }
+    }
 
+    for (int j = wavefront.begin; j < wavefront.end; j++)
+        if (wavefront.stageOf[j - wavefront.begin] >= 0)
+            m_nestedNodes[j]->EndForwardProp();
+    if (useStreams)
+        ComputeStreams::Join(m_streamDeviceId);
+}
+
+// find groups of recurrent loops with the same MBLayout that do not depend on each other
+// A group starts at a loop and extends over the following entries as long as they do not read any of its loops; the
+// loops among them join the group, the other entries (e.g. the input projections of the next loop) are evaluated
+// before the loops in forward prop, and after them in backprop. The group ends at its last loop.
+void ComputationNetwork::PARTraversalFlowControlNode::PlanConcurrentLoops(size_t numStreams, DEVICEID_TYPE deviceId)
+{
+    m_concurrentLoops.clear();
+    m_concurrentLoopsOf.assign(m_nestedNodes.size(), -1);
+    m_concurrentLoopsStreams = max(numStreams, (size_t) 1);
+    m_streamDeviceId = deviceId;
+
+    vector<bool> isFused(m_nestedNodes.size(), false);
+    for (const auto& group : m_fusedGroups)
+        for (int j = group.begin; j < group.end; j++)
+            isFused[j] = true;
+
+    size_t numLoops = 0;
+    for (int i = 0; i < (int) m_nestedNodes.size(); i++)
+    {
+        auto first = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[i]);
+        if (!first || isFused[i])
+            continue;
+        ConcurrentLoops group;
+        group.begin = i;
+        group.loops.assign(1, i);
+        set<ComputationNodeBasePtr> loopMembers(first->m_nestedNodes.begin(), first->m_nestedNodes.end());
+        for (int j = i + 1; j < (int) m_nestedNodes.size() && !isFused[j]; j++)
+        {
+            auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[j]);
+            const vector<ComputationNodeBasePtr> members = loop ? loop->m_nestedNodes : vector<ComputationNodeBasePtr>(1, m_nestedNodes[j]);
+            bool readsLoop = false;
+            for (const auto& member : members)
+                for (const auto& input : member->GetInputs())
+                    readsLoop |= loopMembers.find(input) != loopMembers.end();
+            if (readsLoop || (loop && loop->GetMBLayout() != first->GetMBLayout()))
+                break;
+            if (loop)
+            {
+                group.loops.push_back(j);
+                loopMembers.insert(members.begin(), members.end());
+            }
+        }
+        if (group.loops.size() < 2)
+            continue;
+        group.end = group.loops.back() + 1;
+        for (int j = group.begin; j < group.end; j++)
+            m_concurrentLoopsOf[j] = (int) m_concurrentLoops.size();
+        numLoops += group.loops.size();
+        i = group.end - 1;
+        m_concurrentLoops.push_back(move(group));
+    }
+    if (!m_concurrentLoops.empty())
+        fprintf(stderr, "PlanConcurrentLoops: %d recurrent loops in %d concurrent groups, on %d streams.\n", (int) numLoops, (int) m_concurrentLoops.size(), (int) m_concurrentLoopsStreams);
+}
+
+// evaluate a group of concurrent loops: first the other entries of the range as in PAR mode, then the loops, one time
+// step of each in turn (each in its own stepping direction), loop k on stream k
+void ComputationNetwork::PARTraversalFlowControlNode::ForwardPropConcurrentLoops(const ConcurrentLoops& group)
+{
+    const bool useStreams = m_concurrentLoopsStreams > 1;
+    if (useStreams)
+        ComputeStreams::Join(m_streamDeviceId); // (the inputs may come from any stream)
+    vector<shared_ptr<SEQTraversalFlowControlNode>> loops;
+    for (int j = group.begin; j < group.end; j++)
+    {
+        auto& node = m_nestedNodes[j];
+        if (!node->IsOutputOlderThanInputs())
+            continue;
+        auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node);
+        if (loop)
+        {
+            loops.push_back(loop);
+            continue;
+        }
+        node->BeginForwardProp();
+        node->ForwardProp(FrameRange(node->GetMBLayout()));
+        node->EndForwardProp();
+        node->BumpEvalTimeStamp();
+    }
+
+    for (auto& loop : loops)
+        loop->BeginForwardProp();
+    const auto& pMBLayout = m_nestedNodes[group.begin]->GetMBLayout();
+    const size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+    for (size_t s = 0; s < numTimeSteps; s++)
+    {
+        for (size_t k = 0; k < loops.size(); k++)
+        {
+            if (useStreams)
+                ComputeStreams::Select(m_streamDeviceId, k % m_concurrentLoopsStreams);
+            const FrameRange fr(pMBLayout, loops[k]->m_steppingDirection > 0 ? s : numTimeSteps - 1 - s);
+            for (auto& node : loops[k]->m_nestedNodes)
+            {
+                node->ForwardProp(fr);
+                node->BumpEvalTimeStamp();
+            }
+        }
+    }
+    for (auto& loop : loops)
+    {
+        loop->EndForwardProp();
+        loop->BumpEvalTimeStamp();
+    }
+    if (useStreams)
+        ComputeStreams::Join(m_streamDeviceId);
+}
+
+// backprop through a group of concurrent loops: the loops time step by time step side by side, then, on the default
+// stream, each loop's propagation out of the loop (see SEQTraversalFlowControlNode::EndBackprop()) and the other
+// entries, in reverse order
+void ComputationNetwork::PARTraversalFlowControlNode::BackpropConcurrentLoops(const ConcurrentLoops& group)
+{
+    const bool useStreams = m_concurrentLoopsStreams > 1;
+    if (useStreams)
+        ComputeStreams::Join(m_streamDeviceId); // (the gradients may come from any stream)
+    vector<shared_ptr<SEQTraversalFlowControlNode>> loops;
+    for (auto iter = group.loops.rbegin(); iter != group.loops.rend(); iter++)
+        loops.push_back(dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[*iter]));
+
+    for (auto& loop : loops)
+        loop->BeginBackprop();
+    const auto& pMBLayout = m_nestedNodes[group.begin]->GetMBLayout();
+    const size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+    for (size_t s = 0; s < numTimeSteps; s++)
+    {
+        for (size_t k = 0; k < loops.size(); k++)
+        {
+            if (useStreams)
+                ComputeStreams::Select(m_streamDeviceId, k % m_concurrentLoopsStreams);
+            const FrameRange fr(pMBLayout, loops[k]->m_steppingDirection > 0 ? numTimeSteps - 1 - s : s);
+            for (auto nodeIter = loops[k]->m_nestedNodes.rbegin(); nodeIter != loops[k]->m_nestedNodes.rend(); ++nodeIter)
+                (*nodeIter)->Backprop(fr, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
+        }
+    }
+    if (useStreams)
+        ComputeStreams::Join(m_streamDeviceId); // (the loops may write the gradients of the same inputs, so this is serial)
+    for (auto& loop : loops)
+        loop->EndBackprop();
+
+    for (int j = group.end - 1; j >= group.begin; j--)
+    {
+        auto& node = m_nestedNodes[j];
+        if (dynamic_pointer_cast<SEQTraversalFlowControlNode>(node))
+            continue;
         node->BeginBackprop();
-        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+        node->Backprop(FrameRange(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
         node->EndBackprop();
+        if (m_gradientFinalCallback && node->IsLeaf() && node->IsParameterUpdateRequired() && node->NeedGradient())
+            m_gradientFinalCallback(node);
+    }
+}
+
+// re-run forward prop for the recomputed nodes of one segment, in evaluation order
+// Their inputs are either inside the segment (and recomputed before them) or stored outputs.
+void ComputationNetwork::PARTraversalFlowControlNode::RecomputeSegment(const FrameRange& fr, int segment, int lastIndex)
+{
+    for (int j = segment * (int) m_recomputeSegmentLength; j <= lastIndex; j++)
+    {
+        if (!m_isRecomputed[j])
+            continue;
+        auto& node = m_nestedNodes[j];
+        MatrixTransferMonitor::Scope transferScope(node->NodeName(), "recompute");
+        if (m_nodeProfiler)
+            m_nodeProfiler->BeginNode();
+        node->BeginForwardProp();
+        node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+        node->EndForwardProp();
+        if (m_nodeProfiler)
+            m_nodeProfiler->EndNode(node, NodeProfiler::Phase::recompute, 0);
+    }
+}
+
+// decide which outputs to recompute rather than keep alive through to backprop
+// A node is recomputed if it is a plain PAR node without side effects whose output nobody outside the network reads,
+// and if all of its consumers are in the same segment (otherwise its output is a segment boundary and must be kept).
+void ComputationNetwork::PARTraversalFlowControlNode::PlanRecomputation(size_t segmentLength, const std::set<ComputationNodeBasePtr>& nodesToKeep)
+{
+    m_recomputeSegmentLength = segmentLength;
+    m_isRecomputed.clear();
+    m_recomputeSegmentOf.clear();
+    if (segmentLength == 0)
+        return;
+
+    std::map<ComputationNodeBasePtr, int> positionOf; // [node] -> index into m_nestedNodes; the loop's index for nodes inside a loop
+    m_isRecomputed.assign(m_nestedNodes.size(), false);
+    for (int i = 0; i < (int) m_nestedNodes.size(); i++)
+    {
+        const auto& node = m_nestedNodes[i];
+        const int segment = i / (int) segmentLength;
+        auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node);
+        if (loop)
+        {
+            for (const auto& loopNode : loop->m_nestedNodes)
+            {
+                positionOf[loopNode] = i;
+                m_recomputeSegmentOf[loopNode] = segment;
+            }
+            continue; // loops are always kept
+        }
+        positionOf[node] = i;
+        m_recomputeSegmentOf[node] = segment;
+        m_isRecomputed[i] = !node->IsLeaf() && !node->RequiresPreCompute() && node->isValueSharable() && nodesToKeep.find(node) == nodesToKeep.end() &&
+                            node->OperationName() != L"Dropout" && node->OperationName() != L"BatchNormalization"; // these do not yield the same output twice
+    }
+
+    // outputs consumed in a later segment are segment boundaries; repeat until stable since that only ever removes nodes
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int i = 0; i < (int) m_nestedNodes.size(); i++)
+        {
+            if (!m_isRecomputed[i])
+                continue;
+            for (const auto& input : m_nestedNodes[i]->GetInputs())
+            {
+                auto position = positionOf.find(input);
+                if (position == positionOf.end()) // (not evaluated by this traversal, e.g. computed outside the criterion's order)
+                    continue;
+                const int j = position->second;
+                if (m_isRecomputed[j] && j / segmentLength != i / segmentLength)
+                {
+                    m_isRecomputed[j] = false;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    size_t numRecomputed = count(m_isRecomputed.begin(), m_isRecomputed.end(), true);
+    fprintf(stderr, "PlanRecomputation: %d of %d nodes will be recomputed during backprop in segments of %d.\n",
+            (int) numRecomputed, (int) m_nestedNodes.size(), (int) segmentLength);
+}
+
+// evaluate all members of a fused group with a single elementwise kernel
+// All member values are still stored, since backprop and other consumers need them; what is saved is the kernel launches
+// and re-reading the intermediate results.
+template <class ElemType>
+void ComputationNetwork::PARTraversalFlowControlNode::ForwardPropFusedGroup(const FrameRange& fr, const FusedGroup& group)
+{
+    vector<shared_ptr<ComputationNode<ElemType>>> members;
+    for (int j = group.begin; j < group.end; j++)
+        members.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(m_nestedNodes[j]));
+    vector<shared_ptr<ComputationNode<ElemType>>> inputs;
+    for (const auto& input : group.inputs)
+        inputs.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(input));
+
+    for (auto& node : members)
+        node->BeginForwardProp();
+
+    bool isDense = true;
+    for (const auto& node : members)
+        isDense &= node->Value().GetMatrixType() == DENSE;
+    for (const auto& input : inputs)
+        isDense &= input->Value().GetMatrixType() == DENSE;
+
+    if (isDense)
+    {
+        // all members and inputs share MBLayout and sample layout, as ensured by PlanElementWiseFusion()
+        const auto frLayout = fr.WithLayout(members.front()->GetMBLayout());
+        const size_t rank = members.front()->GetSampleLayout().GetRank();
+        vector<TensorView<ElemType>> inputValues, outputValues;
+        for (auto& input : inputs)
+            inputValues.push_back(input->ValueTensorFor(rank, frLayout));
+        for (auto& node : members)
+            outputValues.push_back(node->ValueTensorFor(rank, frLayout));
+        TensorView<ElemType>::DoElementWiseProgramOf(group.program, inputValues, outputValues);
+    }
+    else // (e.g. a sparse input) evaluate the members one by one
+    {
+        for (auto& node : members)
+            node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+    }
+
+    for (auto& node : members)
+    {
+        node->EndForwardProp();
+        node->BumpEvalTimeStamp();
+    }
+}
+
+// group contiguous runs of elementwise nodes (in evaluation order) into fused groups
+// A node can be fused if it declares its forward op through GetElementWiseForwardOp() and has the same MBLayout, sample
+// layout and element type as all of its inputs, i.e. no broadcasting is involved. Every member but the first must consume
+// the value of an earlier member. Groups are limited by the number of inputs and instructions an ElementWiseProgram holds.
+void ComputationNetwork::PARTraversalFlowControlNode::PlanElementWiseFusion()
+{
+    m_fusedGroups.clear();
+    m_fusedGroupOf.assign(m_nestedNodes.size(), -1);
+
+    auto isFusable = [](const ComputationNodeBasePtr& node, ElementWiseOperator& op)
+    {
+        if (dynamic_pointer_cast<FlowControlNode>(node) || !node->GetElementWiseForwardOp(op) || node->GetNumInputs() > 3)
+            return false;
+        const bool isFloat = dynamic_pointer_cast<ComputationNode<float>>(node) != nullptr;
+        for (const auto& input : node->GetInputs())
+        {
+            if (input->GetMBLayout() != node->GetMBLayout() || input->GetSampleLayout() != node->GetSampleLayout() ||
+                (dynamic_pointer_cast<ComputationNode<float>>(input) != nullptr) != isFloat)
+                return false;
+        }
+        return true;
+    };
+
+    size_t numFusedNodes = 0;
+    for (int i = 0; i < (int) m_nestedNodes.size();)
+    {
+        FusedGroup group;
+        group.begin = i;
+        vector<ElementWiseOperator> ops;
+        ElementWiseOperator op;
+        int j = i;
+        for (; j < (int) m_nestedNodes.size() && (int) ops.size() < ElementWiseProgram::maxInstructions; j++)
+        {
+            const auto& node = m_nestedNodes[j];
+            if (!isFusable(node, op))
+                break;
+            bool consumesMember = false;
+            vector<ComputationNodeBasePtr> newInputs;
+            for (const auto& input : node->GetInputs())
+            {
+                auto member = find(m_nestedNodes.begin() + group.begin, m_nestedNodes.begin() + j, input);
+                if (member != m_nestedNodes.begin() + j)
+                    consumesMember = true;
+                else if (find(group.inputs.begin(), group.inputs.end(), input) == group.inputs.end() &&
+                         find(newInputs.begin(), newInputs.end(), input) == newInputs.end())
+                    newInputs.push_back(input);
+            }
+            if ((j > i && !consumesMember) || group.inputs.size() + newInputs.size() > ElementWiseProgram::maxInputs)
+                break;
+            group.inputs.insert(group.inputs.end(), newInputs.begin(), newInputs.end());
+            ops.push_back(op);
+        }
+        group.end = j;
+        if (group.end - group.begin < 2) // nothing to gain
+        {
+            i = group.begin + 1;
+            continue;
+        }
+
+        // translate into register form: registers [0, numInputs) are the inputs, register numInputs + k is member k
+        auto& program = group.program;
+        program.numInputs = (int) group.inputs.size();
+        program.numInstructions = (int) ops.size();
+        program.numOutputs = (int) ops.size();
+        for (int k = 0; k < program.numInstructions; k++)
+        {
+            const auto& node = m_nestedNodes[group.begin + k];
+            auto& instruction = program.instructions[k];
+            instruction.op = ops[k];
+            instruction.output = k;
+            for (int a = 0; a < 3; a++)
+            {
+                instruction.args[a] = 0;
+                if (a >= (int) node->GetNumInputs())
+                    continue;
+                const auto& input = node->Input(a);
+                auto member = find(m_nestedNodes.begin() + group.begin, m_nestedNodes.begin() + group.begin + k, input);
+                if (member != m_nestedNodes.begin() + group.begin + k)
+                    instruction.args[a] = program.numInputs + (int) (member - (m_nestedNodes.begin() + group.begin));
+                else
+                    instruction.args[a] = (int) (find(group.inputs.begin(), group.inputs.end(), input) - group.inputs.begin());
+            }
+        }
+
+        m_fusedGroupOf[group.begin] = (int) m_fusedGroups.size();
+        numFusedNodes += ops.size();
+        i = group.end;
+        m_fusedGroups.push_back(move(group));
     }
+
+    fprintf(stderr, "PlanElementWiseFusion: %d of %d nodes fused into %d elementwise kernels.\n",
+            (int) numFusedNodes, (int) m_nestedNodes.size(), (int) m_fusedGroups.size());
+}
+
+int ComputationNetwork::PARTraversalFlowControlNode::GetRecomputeSegment(const ComputationNodeBasePtr& node) const
+{
+    auto iter = m_recomputeSegmentOf.find(node);
+    return iter != m_recomputeSegmentOf.end() ? iter->second : -1;
+}
+
+bool ComputationNetwork::PARTraversalFlowControlNode::IsRecomputed(const ComputationNodeBasePtr& node) const
+{
+    for (int i = 0; i < (int) m_isRecomputed.size(); i++)
+        if (m_nestedNodes[i] == node)
+            return m_isRecomputed[i];
+    return false;
 }
+// -----------------------------------------------------------------------
+// activation offload
+// An output that backprop reads again is held in device memory from its forward prop through to its backprop, idle
+// for most of that time. Offloaded outputs are copied to page-locked host memory after their last reader in forward
+// prop, on a transfer stream (see ComputeTransfers) while the next entries compute; their memory may be reused from
+// 'offloadLookahead' entries on. Backprop starts the copy back the same number of entries ahead of their first
+// reader. AllocateAllMatrices() plans the memory accordingly: the output is released at releaseBefore and
+// requested again at prefetchBefore. Entries are what ForwardProp() and Backprop() process as a whole, i.e. a fused
+// group, wavefront or group of concurrent loops counts as one, and the copies are placed at their boundaries.
+// -----------------------------------------------------------------------
+
+static const int offloadLookahead = 2; // entries that a copy overlaps with
+
+// choose the outputs to offload: plain top-level nodes that are not roots, whose readers are all in this network and
+// none of them a view of them, and whose device memory is free for long enough to be worth the copies
+void ComputationNetwork::PARTraversalFlowControlNode::PlanOffload(DEVICEID_TYPE deviceId, const std::set<ComputationNodeBasePtr>& nodesToKeep,
+                                                                  const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                                                  const std::unordered_map<ComputationNodeBasePtr, bool>& neededDuringBackprop)
+{
+    FreeOffloadBuffers();
+    m_offloads.clear();
+    m_offloadDeviceId = deviceId;
+    if (deviceId < 0)
+        return;
+
+    // [j] -> the last index of the forward prop and of the backprop entry that m_nestedNodes[j] is part of
+    const int numNodes = (int) m_nestedNodes.size();
+    std::vector<int> forwardLast(numNodes), backpropLast(numNodes);
+    for (int i = 0; i < numNodes;)
+    {
+        int end = i + 1;
+        if (!m_concurrentLoopsOf.empty() && m_concurrentLoopsOf[i] >= 0)
+            end = m_concurrentLoops[m_concurrentLoopsOf[i]].end;
+        else if (!m_wavefrontOf.empty() && m_wavefrontOf[i] >= 0)
+            end = m_wavefronts[m_wavefrontOf[i]].end;
+        else if (!m_fusedGroupOf.empty() && m_fusedGroupOf[i] >= 0)
+            end = m_fusedGroups[m_fusedGroupOf[i]].end;
+        for (int j = i; j < end; j++)
+            forwardLast[j] = end - 1;
+        i = end;
+    }
+    for (int j = 0; j < numNodes; j++)
+        backpropLast[j] = !m_concurrentLoopsOf.empty() && m_concurrentLoopsOf[j] >= 0 ? m_concurrentLoops[m_concurrentLoopsOf[j]].end - 1 : j;
+
+    std::map<ComputationNodeBasePtr, int> positionOf; // [node] -> index into m_nestedNodes; the loop's index for nodes inside a loop
+    for (int i = 0; i < numNodes; i++)
+    {
+        auto loop = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[i]);
+        if (loop)
+        {
+            for (const auto& loopNode : loop->m_nestedNodes)
+                positionOf[loopNode] = i;
+        }
+        else
+            positionOf[m_nestedNodes[i]] = i;
+    }
+
+    size_t numBytesPerSample = 0;
+    for (int i = 0; i < numNodes; i++)
+    {
+        const auto& node = m_nestedNodes[i];
+        auto needed = neededDuringBackprop.find(node);
+        auto parents = parentsMap.find(node);
+        if (dynamic_pointer_cast<SEQTraversalFlowControlNode>(node) || node->IsLeaf() || node->RequiresPreCompute() || !node->isValueSharable() ||
+            node->IsValueViewOfInput() || nodesToKeep.find(node) != nodesToKeep.end() ||
+            needed == neededDuringBackprop.end() || !needed->second || parents == parentsMap.end())
+            continue;
+
+        // backprop runs from the end, so the reader with the highest index is the first one there
+        int lastForwardUse = -1;
+        int firstBackpropUse = node->OutputUsedInComputingInputNodesGradients() ? i : -1;
+        bool isOffloadable = true;
+        for (const auto& parent : parents->second)
+        {
+            auto position = positionOf.find(parent);
+            if (position == positionOf.end() || (parent->IsValueViewOfInput() && parent->GetInputs()[0] == node))
+            {
+                isOffloadable = false;
+                break;
+            }
+            lastForwardUse = max(lastForwardUse, position->second);
+            for (size_t k = 0; k < parent->GetNumInputs(); k++)
+            {
+                if (parent->GetInputs()[k] == node && parent->InputUsedInComputingInputNodesGradients(k))
+                    firstBackpropUse = max(firstBackpropUse, position->second);
+            }
+        }
+        if (!isOffloadable || lastForwardUse < 0 || firstBackpropUse < 0)
+            continue;
+
+        Offload offload = {};
+        offload.node = i;
+        offload.copyAfter = forwardLast[lastForwardUse];
+        offload.releaseBefore = offload.copyAfter + 1;
+        for (int k = 0; k < offloadLookahead && offload.releaseBefore < numNodes; k++)
+            offload.releaseBefore = forwardLast[offload.releaseBefore] + 1;
+        offload.neededAt = firstBackpropUse;
+        offload.prefetchBefore = backpropLast[firstBackpropUse];
+        for (int k = 0; k < offloadLookahead && offload.prefetchBefore + 1 < numNodes; k++)
+            offload.prefetchBefore = backpropLast[offload.prefetchBefore + 1];
+        // the memory is free from releaseBefore to the end of forward prop, and from there back to prefetchBefore
+        if ((numNodes - offload.releaseBefore) + (numNodes - 1 - offload.prefetchBefore) < offloadLookahead)
+            continue;
+        offload.state = Offload::State::onDevice;
+        m_offloads.push_back(offload);
+        numBytesPerSample += node->GetSampleLayout().GetNumElements() * (dynamic_pointer_cast<ComputationNode<float>>(node) ? sizeof(float) : sizeof(double));
+    }
+    fprintf(stderr, "PlanOffload: %d of %d node outputs will be kept in host memory between forward prop and backprop, %.1f KB per sample.\n",
+            (int) m_offloads.size(), numNodes, numBytesPerSample / 1024.0);
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::GetOffloadLifetimes(std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>>& releasedBefore,
+                                                                          std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>>& requestedBefore) const
+{
+    for (const auto& offload : m_offloads)
+    {
+        const auto& node = m_nestedNodes[offload.node];
+        releasedBefore[offload.releaseBefore < (int) m_nestedNodes.size() ? m_nestedNodes[offload.releaseBefore] : nullptr].push_back(node);
+        requestedBefore[m_nestedNodes[offload.prefetchBefore]].push_back(node);
+    }
+}
+
+// called before the forward prop entry that starts at m_nestedNodes[i], and with i = size() at the end
+// Offload k uses transfer events 2k (out) and 2k + 1 (in).
+void ComputationNetwork::PARTraversalFlowControlNode::OffloadBeforeForwardProp(int i)
+{
+    for (size_t k = 0; k < m_offloads.size(); k++)
+    {
+        auto& offload = m_offloads[k];
+        if (i == 0 && offload.state != Offload::State::onDevice) // (forward prop without backprop, e.g. for cross validation, leaves it on the host)
+        {
+            if (offload.state != Offload::State::onHost)
+                ComputeTransfers::WaitForTransfer(m_offloadDeviceId, offload.state == Offload::State::copyingOut ? 2 * k : 2 * k + 1);
+            offload.state = Offload::State::onDevice;
+        }
+        if (offload.state == Offload::State::onDevice && offload.copyAfter < i)
+        {
+            if (dynamic_pointer_cast<ComputationNode<float>>(m_nestedNodes[offload.node]))
+                CopyOut<float>(offload, 2 * k);
+            else
+                CopyOut<double>(offload, 2 * k);
+            offload.state = Offload::State::copyingOut;
+        }
+        if (offload.state == Offload::State::copyingOut && offload.releaseBefore <= i)
+        {
+            ComputeTransfers::WaitForTransfer(m_offloadDeviceId, 2 * k);
+            offload.state = Offload::State::onHost;
+        }
+    }
+}
+
+// called before the backprop entry that ends with m_nestedNodes[firstIndex]
+void ComputationNetwork::PARTraversalFlowControlNode::OffloadBeforeBackprop(int firstIndex)
+{
+    for (size_t k = 0; k < m_offloads.size(); k++)
+    {
+        auto& offload = m_offloads[k];
+        if (offload.state == Offload::State::onHost && offload.prefetchBefore >= firstIndex)
+        {
+            if (dynamic_pointer_cast<ComputationNode<float>>(m_nestedNodes[offload.node]))
+                CopyIn<float>(offload, 2 * k + 1);
+            else
+                CopyIn<double>(offload, 2 * k + 1);
+            offload.state = Offload::State::copyingIn;
+        }
+        if (offload.state == Offload::State::copyingIn && offload.neededAt >= firstIndex)
+        {
+            ComputeTransfers::WaitForTransfer(m_offloadDeviceId, 2 * k + 1);
+            offload.state = Offload::State::onDevice;
+        }
+    }
+}
+
+template <class ElemType>
+void ComputationNetwork::PARTraversalFlowControlNode::CopyOut(Offload& offload, size_t event)
+{
+    auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(m_nestedNodes[offload.node]);
+    const Matrix<ElemType>& value = node->Value();
+    if (value.GetMatrixType() == SPARSE)
+        LogicError("PlanOffload: The output of %ls %ls operation is sparse and cannot be offloaded.", node->NodeName().c_str(), node->OperationName().c_str());
+    const size_t bytes = value.GetNumElements() * sizeof(ElemType);
+    if (bytes > offload.hostBytes)
+    {
+        if (offload.hostBuffer)
+            CUDAPageLockedMemAllocator::Free(offload.hostBuffer, m_offloadDeviceId);
+        offload.hostBuffer = CUDAPageLockedMemAllocator::Malloc(bytes, m_offloadDeviceId);
+        offload.hostBytes = bytes;
+    }
+    offload.rows = value.GetNumRows();
+    offload.cols = value.GetNumCols();
+    ComputeTransfers::CopyToHost(m_offloadDeviceId, offload.hostBuffer, value.BufferPointer(), bytes, event);
+}
+
+// (the memory may have been reused by a node of another shape meanwhile)
+template <class ElemType>
+void ComputationNetwork::PARTraversalFlowControlNode::CopyIn(Offload& offload, size_t event)
+{
+    auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(m_nestedNodes[offload.node]);
+    Matrix<ElemType>& value = node->Value();
+    value.Resize(offload.rows, offload.cols);
+    ComputeTransfers::CopyToDevice(m_offloadDeviceId, value.BufferPointer(), offload.hostBuffer, offload.rows * offload.cols * sizeof(ElemType), event);
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::FreeOffloadBuffers()
+{
+    for (auto& offload : m_offloads)
+    {
+        if (offload.hostBuffer)
+            CUDAPageLockedMemAllocator::Free(offload.hostBuffer, m_offloadDeviceId);
+        offload.hostBuffer = nullptr;
+        offload.hostBytes = 0;
+    }
+}
+
+ComputationNetwork::PARTraversalFlowControlNode::~PARTraversalFlowControlNode()
+{
+    FreeOffloadBuffers();
+}
+
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
 {
 }
@@ -394,6 +1456,11 @@ void ComputationNetwork::CompileNetwork()
 {
     fprintf(stderr, "\nPost-processing network...\n");
 
+    // STEP: Rewrite patterns that have a cheaper equivalent. This changes the set of nodes, so it comes first.
+    FuseTransposesIntoTimes();
+    if (g_fuseConvolutions)
+        FuseConvolutionActivations(g_fusePoolingActivations);
+
     // all steps below have to be repeated for all root nodes (=nodes without parents and PreComputeNodes)
     DetermineSetOfAllRoots();
 
@@ -429,11 +1496,61 @@ void ComputationNetwork::CompileNetwork()
         ValidateSubNetwork(node);
 
     // STEP: Optimize the network.
-    // :)
+    if (g_fuseElementWiseOps)
+    {
+        for (auto& node : m_allRoots)
+        {
+            auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(node));
+            if (network)
+                network->PlanElementWiseFusion();
+        }
+    }
+    // (streams belong to one device; a network placed over several GPUs runs on their default streams)
+    bool isOnOneDevice = true;
+    for (const auto& iter : m_nameToNodeMap)
+        if (iter.second->GetDeviceId() != m_deviceId)
+            isOnOneDevice = false;
+    if (g_numComputeStreams > 1 && m_deviceId >= 0 && isOnOneDevice)
+    {
+        for (auto& node : m_allRoots)
+        {
+            auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(node));
+            if (network)
+                network->PlanStreams(g_numComputeStreams, m_deviceId);
+        }
+    }
+    if (g_concurrentLoops)
+    {
+        for (auto& node : m_allRoots)
+        {
+            auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(node));
+            if (network)
+                network->PlanConcurrentLoops(m_deviceId >= 0 && isOnOneDevice ? g_numComputeStreams : 1, m_deviceId);
+        }
+    }
+    if (g_wavefrontLoops)
+    {
+        for (auto& node : m_allRoots)
+        {
+            auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(node));
+            if (network)
+                network->PlanWavefronts(m_deviceId >= 0 && isOnOneDevice ? g_numComputeStreams : 1, m_deviceId);
+        }
+    }
 
     // STEP: Some final details.
     ResetEvalTimeStamps(); // invalidate all m_value fields. Really belongs into StartEvaluateMinibatchLoop()
 
+    // forget validation records of deleted nodes
+    for (auto iter = m_validationRecords.begin(); iter != m_validationRecords.end();)
+    {
+        auto nodeIter = m_nameToNodeMap.find(iter->first->NodeName());
+        if (nodeIter == m_nameToNodeMap.end() || nodeIter->second != iter->first)
+            iter = m_validationRecords.erase(iter);
+        else
+            iter++;
+    }
+
     fprintf(stderr, "\nPost-processing network complete.\n");
     m_isCompiled = true;
 }
@@ -512,11 +1629,40 @@ void ComputationNetwork::ValidateSubNetwork(const ComputationNodeBasePtr& rootNo
     // Nodes validated on partial input (i.e. some children not yet validated) will be revisited.
     const auto& nodes = GetEvalOrder(rootNode);
 
+    // incremental validation: only nodes that changed since they were last validated (e.g. by a model edit), and all that
+    // depend on them, need to be validated again; the others keep their dimensions and m_needsGradient
+    // (iterated because of the back edges of recurrent loops)
+    set<ComputationNodeBasePtr> staleNodes;
+    for (bool grown = true; grown;)
+    {
+        grown = false;
+        for (auto& node : nodes)
+        {
+            if (staleNodes.find(node) != staleNodes.end())
+                continue;
+            bool isStale = !IsValidationCurrent(node);
+            for (auto& child : node->GetInputs())
+                isStale |= staleNodes.find(child) != staleNodes.end();
+            if (isStale)
+            {
+                staleNodes.insert(node);
+                grown = true;
+            }
+        }
+    }
+    list<ComputationNodeBasePtr> nodesToValidate;
     for (auto& node : nodes)
     {
-        node->m_visited = false;
-        node->m_needsGradient = node->IsParameterUpdateRequired(); // these get propagated upwards in the following
+        const bool isStale = staleNodes.find(node) != staleNodes.end();
+        node->m_visited = !isStale;
+        if (isStale)
+        {
+            node->m_needsGradient = node->IsParameterUpdateRequired(); // these get propagated upwards in the following
+            nodesToValidate.push_back(node);
+        }
     }
+    if (nodesToValidate.size() < nodes.size())
+        fprintf(stderr, "\nValidating for node %ls: %d of %d nodes unchanged since their last validation.\n", rootNode->NodeName().c_str(), (int) (nodes.size() - nodesToValidate.size()), (int) nodes.size());
 
     // loop and validate until we are done
     // steps:
@@ -525,17 +1671,22 @@ void ComputationNetwork::ValidateSubNetwork(const ComputationNodeBasePtr& rootNo
     //  - validate (final)              // final means consistency checks
     //    Fail if any change during this stage.
     size_t pass = 0;
-    size_t toValidate = nodes.size();
+    size_t toValidate = nodesToValidate.size();
     while (toValidate > 0)
     {
         pass++;
         fprintf(stderr, "\n\nValidating for node %ls. %d nodes to process in pass %d.\n", rootNode->NodeName().c_str(), (int) toValidate, (int) pass);
-        ValidateNodes(nodes, false /*isFinalValidationPass*/, toValidate);
+        ValidateNodes(nodesToValidate, false /*isFinalValidationPass*/, toValidate);
+    }
+    if (!nodesToValidate.empty())
+    {
+        fprintf(stderr, "\n\nValidating for node %ls, final verification.\n", rootNode->NodeName().c_str());
+        ValidateNodes(nodesToValidate, true /*isFinalValidationPass*/, toValidate);
+        if (toValidate != 0)
+            LogicError("ValidateSubNetwork: ValidateNodes(true) unexpectedly returned with work left to do.");
     }
-    fprintf(stderr, "\n\nValidating for node %ls, final verification.\n", rootNode->NodeName().c_str());
-    ValidateNodes(nodes, true /*isFinalValidationPass*/, toValidate);
-    if (toValidate != 0)
-        LogicError("ValidateSubNetwork: ValidateNodes(true) unexpectedly returned with work left to do.");
+    for (auto& node : nodesToValidate)
+        m_validationRecords[node] = ValidationRecord{node->GetInputs(), node->GetSampleLayout(), node->GetMBLayout(), node->IsParameterUpdateRequired()};
 
     // propagate some info to SEQTraversalFlowControlNode
     // TODO: In the future we should validate not on the flat list but the PARTraversalFlowControlNode structure. Then this will be unnecessary.
@@ -570,6 +1721,19 @@ void ComputationNetwork::ValidateSubNetwork(const ComputationNodeBasePtr& rootNo
     }
 }
 
+// has the node (its inputs, dimensions, layout, or whether it is learned) not changed since it was last validated?
+bool ComputationNetwork::IsValidationCurrent(const ComputationNodeBasePtr& node) const
+{
+    auto iter = m_validationRecords.find(node);
+    if (iter == m_validationRecords.end())
+        return false;
+    const ValidationRecord& record = iter->second;
+    return record.inputs == node->GetInputs() &&
+           record.sampleLayout == node->GetSampleLayout() &&
+           record.pMBLayout == node->GetMBLayout() &&
+           record.parameterUpdateRequired == node->IsParameterUpdateRequired();
+}
+
 // helper to discover dimension changes
 static pair<TensorShape, bool> GetDims(const ComputationNodeBasePtr& node)
 {
@@ -719,8 +1883,13 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
     if (trainRootNode != nullptr)
         forwardPropRoots.push_back(trainRootNode);
 
+    PlanInputViews(forwardPropRoots, performingBackPropagation);
+
     // For each node determine parents and whether the output of the
     // node is needed during back propagation
+    // The consumers of a zero-copy view count as consumers of the input it is a view of, too.
+    // Nodes that lead to no learnable parameter (NeedGradient() is false, e.g. a frozen encoder) do no backprop, so
+    // they keep no values for it; their outputs are released after forward prop as in evaluation.
     std::unordered_map<ComputationNodeBasePtr, bool> outputValueNeededDuringBackProp;
     std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>> parentsMap;
     for (auto& rootNode : forwardPropRoots)
@@ -730,24 +1899,39 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         {
             for (int i = 0; i < currentNode->GetNumInputs(); i++)
             {
-                ComputationNodeBasePtr pNode = currentNode->GetInputs()[i];
-                parentsMap[pNode].insert(currentNode);
-
-                if (performingBackPropagation)
+                for (ComputationNodeBasePtr pNode = currentNode->GetInputs()[i];; pNode = pNode->GetInputs()[0])
                 {
-                    if (outputValueNeededDuringBackProp.find(pNode) == outputValueNeededDuringBackProp.end())
-                        outputValueNeededDuringBackProp[pNode] = pNode->OutputUsedInComputingInputNodesGradients();
+                    parentsMap[pNode].insert(currentNode);
 
-                    outputValueNeededDuringBackProp[pNode] |= currentNode->InputUsedInComputingInputNodesGradients(i);
-                }
-                else
-                {
-                    outputValueNeededDuringBackProp[pNode] = false;
+                    if (performingBackPropagation)
+                    {
+                        if (outputValueNeededDuringBackProp.find(pNode) == outputValueNeededDuringBackProp.end())
+                            outputValueNeededDuringBackProp[pNode] = pNode->NeedGradient() && pNode->OutputUsedInComputingInputNodesGradients();
+
+                        outputValueNeededDuringBackProp[pNode] |= currentNode->NeedGradient() && currentNode->InputUsedInComputingInputNodesGradients(i);
+                    }
+                    else
+                    {
+                        outputValueNeededDuringBackProp[pNode] = false;
+                    }
+                    if (!pNode->IsValueViewOfInput())
+                        break;
                 }
             }
         }
     }
 
+    // A view that needs its own value for backprop (one computed in place) keeps the storage of the input it is a view of.
+    if (performingBackPropagation)
+    {
+        std::list<ComputationNodeBasePtr> nodesTopDown = ComputationNodeBase::EnumerateNodes(forwardPropRoots);
+        for (auto iter = nodesTopDown.rbegin(); iter != nodesTopDown.rend(); ++iter) // (views of views pass it all the way down)
+        {
+            if ((*iter)->IsValueViewOfInput() && outputValueNeededDuringBackProp[*iter])
+                outputValueNeededDuringBackProp[(*iter)->GetInputs()[0]] = true;
+        }
+    }
+
     std::unordered_map<ComputationNodeBasePtr, int> parentCount;
     for (auto& keyValue : parentsMap)
     {
@@ -768,10 +1952,43 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    // gradient checkpointing: outputs that will be recomputed in backprop are not kept alive after forward prop
+    shared_ptr<PARTraversalFlowControlNode> recomputePlan;
+    if (trainRootNode != nullptr)
+    {
+        recomputePlan = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(trainRootNode));
+        if (m_recomputeSegmentLength > 0 && !g_shareNodeValueMatrices)
+            fprintf(stderr, "AllocateAllMatrices: WARNING: Recomputation of node outputs requires shareNodeValueMatrices=true; ignored.\n");
+        set<ComputationNodeBasePtr> nodesToKeep(forwardPropRoots.begin(), forwardPropRoots.end());
+        recomputePlan->PlanRecomputation(g_shareNodeValueMatrices ? m_recomputeSegmentLength : 0, nodesToKeep);
+
+        // activation offload: outputs in host memory are released in forward prop and requested again in backprop
+        const bool offloadActivations = m_offloadActivations && g_shareNodeValueMatrices && m_deviceId >= 0 && m_recomputeSegmentLength == 0 && g_numComputeStreams <= 1;
+        if (m_offloadActivations && !offloadActivations)
+            fprintf(stderr, "AllocateAllMatrices: WARNING: Activation offload requires shareNodeValueMatrices=true and a GPU, and works with neither recomputation nor multiple compute streams; ignored.\n");
+        recomputePlan->PlanOffload(offloadActivations ? m_deviceId : CPUDEVICE, nodesToKeep, parentsMap, outputValueNeededDuringBackProp);
+    }
+    std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> offloadReleasedBefore, offloadRequestedBefore; // [entry of the PAR network] -> nodes
+    if (recomputePlan)
+        recomputePlan->GetOffloadLifetimes(offloadReleasedBefore, offloadRequestedBefore);
+    auto releaseOffloadedBefore = [&](const ComputationNodeBasePtr& entry)
+    {
+        auto iter = offloadReleasedBefore.find(entry);
+        if (iter == offloadReleasedBefore.end())
+            return;
+        for (auto& node : iter->second)
+            node->ReleaseMatricesAfterRecompute(m_matrixPool);
+        offloadReleasedBefore.erase(iter);
+    };
+
     set<ComputationNodeBasePtr> completedEvaluate;
     for (auto& nodeIter : compositeForwardPropEvalOrder)
     {
-        nodeIter->SetOutputNeededDuringBackprop(outputValueNeededDuringBackProp[nodeIter]);
+        if (!offloadReleasedBefore.empty())
+            releaseOffloadedBefore(nodeIter->IsPartOfLoop() ? FindInRecurrentLoops(m_allSEQNodes, nodeIter) : nodeIter);
+
+        bool isRecomputed = recomputePlan && recomputePlan->IsRecomputed(nodeIter);
+        nodeIter->SetOutputNeededDuringBackprop(outputValueNeededDuringBackProp[nodeIter] && !isRecomputed);
 
         if (nodeIter->IsPartOfLoop())
         {
@@ -797,6 +2014,12 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    releaseOffloadedBefore(nullptr);
+
+    // with concurrent streams, forward prop ends with all streams joined
+    m_matrixPool.SetShareAcrossBarriersOnly(g_numComputeStreams > 1);
+    m_matrixPool.Barrier();
+
     if (trainRootNode != nullptr)
     {
         std::list<ComputationNodeBasePtr>& backPropNodes = GetEvalOrder(trainRootNode);
@@ -804,12 +2027,55 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         // now, simulate the gradient computation order to determine how to allocate matrices
         set<ComputationNodeBasePtr> completedGradient;
 
+        size_t numComputeNodes = 0, numPrunedNodes = 0;
+        for (auto& node : backPropNodes)
+        {
+            if (!node->IsLeaf())
+            {
+                numComputeNodes++;
+                numPrunedNodes += node->NeedGradient() ? 0 : 1;
+            }
+        }
+        if (numPrunedNodes > 0)
+            fprintf(stderr, "AllocateAllMatrices: %d of %d nodes below %ls lead to no learnable parameter; they get no gradients and are skipped in backprop.\n",
+                    (int) numPrunedNodes, (int) numComputeNodes, trainRootNode->NodeName().c_str());
+
         // we need to call it here since we always compute gradients for children and root node is not children of other node
         trainRootNode->RequestMatricesBeforeBackprop(m_matrixPool);
 
+        int currentSegment = -1;
+        std::vector<ComputationNodeBasePtr> recomputedNodes; // outputs of current recompute segment, live until we leave it
         for (auto iter = backPropNodes.rbegin(); iter != backPropNodes.rend(); iter++) // for gradient computation, traverse in reverse order
         {
             auto n = *iter;
+            if (!offloadRequestedBefore.empty())
+            {
+                auto offloaded = offloadRequestedBefore.find(n->IsPartOfLoop() ? FindInRecurrentLoops(m_allSEQNodes, n) : n);
+                if (offloaded != offloadRequestedBefore.end())
+                {
+                    for (auto& node : offloaded->second)
+                        node->RequestMatricesBeforeRecompute(m_matrixPool);
+                    offloadRequestedBefore.erase(offloaded);
+                }
+            }
+            // gradient checkpointing: mirror PARTraversalFlowControlNode::Backprop(), which recomputes a segment when entering it
+            int segment = recomputePlan->GetRecomputeSegment(n);
+            if (segment != currentSegment)
+            {
+                for (auto& recomputedNode : recomputedNodes)
+                    recomputedNode->ReleaseMatricesAfterRecompute(m_matrixPool);
+                recomputedNodes.clear();
+                currentSegment = segment;
+                for (auto& segmentNode : backPropNodes)
+                {
+                    if (recomputePlan->GetRecomputeSegment(segmentNode) == currentSegment && recomputePlan->IsRecomputed(segmentNode))
+                    {
+                        segmentNode->RequestMatricesBeforeRecompute(m_matrixPool);
+                        recomputedNodes.push_back(segmentNode);
+                    }
+                }
+            }
+
             if (n->IsPartOfLoop())
             {
                 std::vector<ComputationNodeBasePtr> recurrentNodes;
@@ -833,14 +2099,101 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
                     n->ReleaseMatricesAfterBackprop(m_matrixPool);
             }
         }
+        for (auto& recomputedNode : recomputedNodes)
+            recomputedNode->ReleaseMatricesAfterRecompute(m_matrixPool);
+    }
+
+    // now that all lifetimes are known, assign the actual shared matrices
+    m_matrixPool.OptimizedMemoryAllocation();
+
+    // and let the views refer to them (in evaluation order, for views of views)
+    for (auto& node : compositeForwardPropEvalOrder)
+    {
+        if (node->IsValueViewOfInput())
+            node->AttachInputView();
+    }
+}
+
+// zero-copy views: decide which of the nodes that could be views of their input 0 (CanBeViewOfInput()) become ones
+// Not roots, whose values must outlive the network's use of the input, not in or next to loops, whose nodes are
+// allocated all at once, and not with recomputation, which drops and re-requests values per segment.
+// A view also has its input's gradient (CanShareGradientWithInput()) if it is the input's only consumer, since
+// then no other node accumulates into that gradient.
+// Elementwise nodes that can compute in place (CanComputeInPlace()) become views of their input 0, too, but only if
+// the input's value is no longer read once it is overwritten: the node is its only consumer in the whole network,
+// neither of the two needs that value for backprop, and it is neither a leaf, a precomputed value, nor a root. The
+// input may itself be computed in place, but not be a plain view, which might be of a parameter or read elsewhere.
+void ComputationNetwork::PlanInputViews(const std::vector<ComputationNodeBasePtr>& forwardPropRoots, bool performingBackPropagation)
+{
+    // (a later allocation for other roots leaves the matrices of nodes allocated before alone, hence also their views)
+    std::list<ComputationNodeBasePtr> nodes = ComputationNodeBase::EnumerateNodes(forwardPropRoots);
+    std::set<ComputationNodeBasePtr> newNodes;
+    for (auto& node : nodes)
+    {
+        if (m_nodesPlannedForInputViews.insert(node).second)
+            newNodes.insert(node);
+    }
+    if (!g_zeroCopyViews || (performingBackPropagation && m_recomputeSegmentLength > 0 && g_shareNodeValueMatrices))
+        return;
+
+    std::unordered_map<ComputationNodeBasePtr, size_t> numConsumers, numConsumersInNetwork;
+    for (auto& node : nodes)
+    {
+        for (const auto& input : node->GetInputs())
+            numConsumers[input]++;
+    }
+    for (const auto& iter : m_nameToNodeMap) // (in-place values must also be safe from later allocations for other roots)
+    {
+        for (const auto& input : iter.second->GetInputs())
+            numConsumersInNetwork[input]++;
+    }
+
+    const std::set<ComputationNodeBasePtr> roots(forwardPropRoots.begin(), forwardPropRoots.end());
+    std::set<ComputationNodeBasePtr> inPlaceNodes;
+    size_t numViews = 0, numGradientViews = 0;
+    for (auto& node : nodes) // (in evaluation order, so that the views among the inputs are known)
+    {
+        if (newNodes.find(node) == newNodes.end() || node->GetNumInputs() == 0 || roots.find(node) != roots.end())
+            continue;
+        const auto& input = node->GetInputs()[0];
+        if (node->IsPartOfLoop() || input->IsPartOfLoop() || node->GetDeviceId() != input->GetDeviceId())
+            continue;
+        if (!node->CanBeViewOfInput())
+        {
+            if (!node->CanComputeInPlace() || input->IsLeaf() || input->RequiresPreCompute() || !input->isValueSharable() ||
+                roots.find(input) != roots.end() || numConsumersInNetwork[input] != 1 ||
+                (input->IsValueViewOfInput() && inPlaceNodes.find(input) == inPlaceNodes.end()) ||
+                (performingBackPropagation && (input->OutputUsedInComputingInputNodesGradients() || node->InputUsedInComputingInputNodesGradients(0))))
+                continue;
+            inPlaceNodes.insert(node);
+        }
+        node->m_valueIsInputView = true;
+        node->m_gradientIsInputView = performingBackPropagation && node->NeedGradient() && input->NeedGradient() &&
+                                      numConsumers[input] == 1 && node->CanShareGradientWithInput();
+        numViews++;
+        if (node->m_gradientIsInputView)
+            numGradientViews++;
     }
+    if (numViews > 0)
+        fprintf(stderr, "PlanInputViews: %d nodes are zero-copy views of their inputs (%d computed in place), %d of them also of their gradients.\n",
+                (int) numViews, (int) inPlaceNodes.size(), (int) numGradientViews);
 }
 
+// (a node that reads through a view also reads the input the view is of)
 void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount)
 {
+    std::set<ComputationNodeBasePtr> inputs;
     for (int i = 0; i < n->GetNumInputs(); i++)
     {
-        ComputationNodeBasePtr pNode = n->GetInputs()[i];
+        for (ComputationNodeBasePtr pNode = n->GetInputs()[i];; pNode = pNode->GetInputs()[0])
+        {
+            inputs.insert(pNode);
+            if (!pNode->IsValueViewOfInput())
+                break;
+        }
+    }
+    for (const auto& pNode : inputs)
+    {
         parentCount[pNode]--;
         if (parentCount[pNode] == 0)
             pNode->ReleaseMatricesAfterForwardProp(m_matrixPool);
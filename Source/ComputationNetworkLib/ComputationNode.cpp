@@ -111,18 +111,24 @@ void ComputationNodeBase::ValidateUnaryReduce(bool isFinalValidationPass)
 // Currently only called by criterion nodes.
 // This function also infers child LearnableParameters. In case you wonder why this is needed for criterion nodes, there are edge cases, e.g. a
 // learnable parameter being regularized by a criterion node, where the learnable parameter is fed both into that criterion node and other places.
-void ComputationNodeBase::ValidateBinaryReduce(bool isFinalValidationPass)
+// 'allowIndexLabels': criteria over classes also take their labels as class indices, see HasIndexLabels()
+void ComputationNodeBase::ValidateBinaryReduce(bool isFinalValidationPass, bool allowIndexLabels)
 {
     ComputationNodeBase::Validate(isFinalValidationPass);
     m_pMBLayout = nullptr; // this node does not hold mini-batch data
     ValidateInferBinaryInputDims();
     if (isFinalValidationPass &&
-        !(Input(0)->GetSampleLayout().IsElementwiseCompatibleWith(Input(1)->GetSampleLayout()) && // TODO: Do we need broadcasting for these cases?
+        !((Input(0)->GetSampleLayout().IsElementwiseCompatibleWith(Input(1)->GetSampleLayout()) || (allowIndexLabels && HasIndexLabels())) && // TODO: Do we need broadcasting for these cases?
           (Input(0)->GetMBLayout() == Input(1)->GetMBLayout() || !Input(0)->HasMBLayout() || !Input(1)->HasMBLayout())))
         LogicError("The Matrix dimensions or MB layout in the %ls %ls operation do not match.", NodeName().c_str(), OperationName().c_str());
     SetDims(TensorShape(1), false);
 }
 
+bool ComputationNodeBase::HasIndexLabels() const
+{
+    return Input(0)->GetSampleLayout().GetNumElements() == 1 && Input(1)->GetSampleLayout().GetNumElements() > 1;
+}
+
 // helper function for validation
 // In complex cases of convolution, dimensions are quite difficult for a user to know/derive.
 // This is a feature that allows a node to help resizing its input node to the expected value
@@ -261,9 +267,9 @@ typedef Matrix<double> DoubleMatrix;
 atomic_ullong TimeStamp::s_timeStampCounter = ATOMIC_VAR_INIT(0);
 
 template <>
-std::map<size_t, std::map<size_t, FloatMatrix*>> ComputationNode<float>::s_constOnes{};
+std::map<DEVICEID_TYPE, std::map<size_t, std::map<size_t, FloatMatrix*>>> ComputationNode<float>::s_constOnes{};
 template <>
-std::map<size_t, std::map<size_t, DoubleMatrix*>> ComputationNode<double>::s_constOnes{};
+std::map<DEVICEID_TYPE, std::map<size_t, std::map<size_t, DoubleMatrix*>>> ComputationNode<double>::s_constOnes{};
 
 template class ComputationNode<float>;
 template class ComputationNode<double>;
@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <atomic>
+#include <mutex>
 
 #define DEFAULT_HIDDEN_ACTIVATION 0.1
 
@@ -33,6 +34,15 @@
 #define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_2
 
 extern bool g_shareNodeValueMatrices;
+extern bool g_fuseElementWiseOps;
+extern bool g_fuseConvolutions;
+extern bool g_fusePoolingActivations;
+extern bool g_maxPoolingIndices;
+extern bool g_zeroCopyViews;
+extern bool g_wavefrontLoops;
+extern bool g_concurrentLoops;
+extern bool g_persistentRecurrence;
+extern size_t g_numComputeStreams;
 
 #ifndef UNREFERENCED_PARAMETER
 #define UNREFERENCED_PARAMETER(P) (P)
@@ -100,6 +110,8 @@ struct /*interface*/ IComputationNode
     virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) = 0;
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) = 0; // request matrices that are needed for gradient computation
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) = 0;  // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
+    virtual void RequestMatricesBeforeRecompute(MatrixPool& matrixPool) = 0; // re-request the value matrix of a node whose output is recomputed during backprop
+    virtual void ReleaseMatricesAfterRecompute(MatrixPool& matrixPool) = 0;  // release it again once its recompute segment has been backpropagated
 
     // --- optional overrides that describe a feature or property of the node
 
@@ -142,7 +154,7 @@ struct ComputationNetworkOwnedNodeState
     friend class ComputationNetwork;
 
     ComputationNetworkOwnedNodeState()
-        : m_needsGradient(false), m_valueSharable(true)
+        : m_needsGradient(false), m_valueSharable(true), m_valueIsInputView(false), m_gradientIsInputView(false)
     {
         PurgeStateForFormingRecurrentLoops();
         m_isPartOfLoop = false;
@@ -161,6 +173,10 @@ struct ComputationNetworkOwnedNodeState
     virtual void MarkValueSharable() { m_valueSharable = true; }
     bool isValueSharable() const { return m_valueSharable; }
 
+    // zero-copy: the value (and maybe the gradient) of this node is the storage of its input 0 (see ComputationNetwork::PlanInputViews())
+    bool IsValueViewOfInput() const { return m_valueIsInputView; }
+    bool IsGradientViewOfInput() const { return m_gradientIsInputView; }
+
 protected:                // TODO: should be fully encapsulated here
 
     bool m_needsGradient; // true if this node or any children need a gradient to be computed (for own consumption or propagation to somewhere in the child tree)
@@ -168,6 +184,9 @@ protected:                // TODO: should be fully encapsulated here
     bool m_valueSharable; // a flag is needed for memory share.
                           // If it is false (e.g., learnableParameters/InputValue and those nodes are solely induced by learnableParameters),
                           // it will never be released to memory pool
+
+    bool m_valueIsInputView;    // the node requests no value matrix of its own
+    bool m_gradientIsInputView; // the node requests no gradient matrix of its own, and its input's gradient is its own
 private:
 
     bool m_isPartOfLoop; // true if this loop is part of a recurrent loop
@@ -367,7 +386,7 @@ public:
     //  - as a Matrix reference
     //     - actual object is a 2D tensor without MB Layout
     //     - ValueAsMatrix(), GradientAsMatrix() returns tensor as a 2D Matrix object
-    //     - nodes that do this are: TimesNode, DiagTimesNode, ConvolutionNode, NoiseContrastiveEstimationNode, ClassBasedCrossEntropyWithSoftmaxNode, TransposeNode, DiagonalNode
+    //     - nodes that do this are: TimesNode, ConvolutionNode, NoiseContrastiveEstimationNode, ClassBasedCrossEntropyWithSoftmaxNode, SampledSoftmaxNode, TransposeNode, DiagonalNode
     //
     // How values are stored:
     //
@@ -571,6 +590,9 @@ public:
 
     DEVICEID_TYPE GetDeviceId() const { return m_deviceId; }
 
+    // model parallelism: place the node on another device than the network's; must happen before AllocateAllMatrices()
+    virtual void MoveToDevice(DEVICEID_TYPE deviceId) { m_deviceId = deviceId; }
+
     // helper to access to element(0,0) without having to type-cast
     virtual double Get00Element() const = 0;
 
@@ -621,7 +643,9 @@ protected:
     void ValidateUnaryReduce(bool isFinalValidationPass);
     void ValidateInferBinaryInputDims();
     void ValidateBinaryZip(bool isFinalValidationPass, bool allowBroadcast);
-    void ValidateBinaryReduce(bool isFinalValidationPass);
+    void ValidateBinaryReduce(bool isFinalValidationPass, bool allowIndexLabels = false);
+    // the labels (input 0) are class indices [1 x T] into the rows of the prediction (input 1), rather than one vector per class
+    bool HasIndexLabels() const;
     void InferMBLayoutFromInputsForStandardCase();
     virtual void ValidateInferInputDimsFrom(const TensorShape&) = 0;    // (implemented by ComputationNode<ElemType>
 
@@ -684,6 +708,12 @@ public:
 
     virtual void ZeroGradientsOfInputs() = 0;
 
+    // the next backprop adds to the gradient as it is instead of zeroing it first (gradient accumulation)
+    void KeepGradient()
+    {
+        m_gradientInitialized = true;
+    }
+
     // -----------------------------------------------------------------------
     // memory sharing
     // -----------------------------------------------------------------------
@@ -698,6 +728,33 @@ public:
     // Base-class version makes conservative assumption that it is. Override if not.
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const { return true; }
 
+    // zero-copy views
+    // Nodes that only reinterpret their input 0 can return true here if, with the dimensions as validated, their value is a
+    // contiguous part of the input's value; and also from the second if their gradient can then be the input's as well.
+    // The network decides which nodes actually become views (PlanInputViews()); those find the value (and gradient)
+    // through AttachInputView() and skip the copy.
+    virtual bool CanBeViewOfInput() const { return false; }
+    virtual bool CanShareGradientWithInput() const { return false; }
+    virtual void AttachInputView() { }
+    // Elementwise nodes whose output has the dimensions and layout of input 0 can return true here if their ForwardProp()
+    // also works with the value being that of input 0, i.e. computed in place. They then become views the same way, but
+    // only where the planner finds that nothing else reads the input's value. With CanShareGradientWithInput(), their
+    // BackpropTo() must also work with their gradient being the input's.
+    virtual bool CanComputeInPlace() const { return false; }
+
+    // elementwise fusion
+    // Nodes whose ForwardProp() is exactly 'value = op(inputs...)' for a single ElementWiseOperator, without broadcasting,
+    // return the op here, so that chains of them can be evaluated by a single fused kernel (see PlanElementWiseFusion()).
+    virtual bool GetElementWiseForwardOp(ElementWiseOperator& /*op*/) const { return false; }
+
+    // profiling (see NodeProfiler)
+    // Estimated floating-point operations of a ForwardProp() over the whole minibatch. The default of one per output
+    // element fits elementwise nodes; nodes dominated by products override it. Backprop is estimated as twice this.
+    virtual double GetForwardFlopsEstimate() const { return (double) GetSampleMatrixNumRows() * GetSampleMatrixNumCols(); }
+    virtual size_t GetElementSize() const { return 0; }
+    virtual size_t GetValueAllocatedBytes() const { return 0; }    // 0 if not allocated (e.g. released to the matrix pool)
+    virtual size_t GetGradientAllocatedBytes() const { return 0; }
+
     void SetOutputNeededDuringBackprop(bool f) { m_outputNeededDuringBackprop = f; }
     bool IsOutputNeededDuringBackprop() const { return !g_shareNodeValueMatrices || m_outputNeededDuringBackprop; }
 
@@ -880,7 +937,7 @@ public:
     // public constructor
     // Note: use the New<> helper function that is declared next, which gives you the convenience of returning a shared_ptr
     ComputationNode(DEVICEID_TYPE deviceId, const wstring& name)
-        : ComputationNodeBase(deviceId, name)
+        : ComputationNodeBase(deviceId, name), m_overwriteInputGradient(false)
     {
     }
 
@@ -1094,6 +1151,11 @@ public:
     const Matrix<ElemType>& Gradient() const { return *m_gradient; }
     Matrix<ElemType>&       Gradient()       { return *m_gradient; }
 
+    // to let the gradient of a parameter be a view into a larger buffer (see FlatParameterBuffers)
+    // The matrix may be shared with other nodes through the matrix pool, so it must be replaced, not modified.
+    const shared_ptr<Matrix<ElemType>>& GradientPtr() const { return m_gradient; }
+    void SetGradientPtr(const shared_ptr<Matrix<ElemType>>& gradient) { m_gradient = gradient; }
+
 private:
 
     // map a tensor to a matrix
@@ -1169,6 +1231,10 @@ public:
     // TODO: Are all these meant to read out a scalar? Then rename and verify dimensions.
     virtual double Get00Element() const override final { return Value().Get00Element(); }
 
+    virtual size_t GetElementSize() const override final { return sizeof(ElemType); }
+    virtual size_t GetValueAllocatedBytes() const override final { return m_value ? m_value->GetAllocatedSize() * sizeof(ElemType) : 0; }
+    virtual size_t GetGradientAllocatedBytes() const override final { return m_gradient ? m_gradient->GetAllocatedSize() * sizeof(ElemType) : 0; }
+
     // -----------------------------------------------------------------------
     // dimensions and allocation
     // -----------------------------------------------------------------------
@@ -1217,6 +1283,7 @@ public:
     // update the actual matrix allocation for m_value based on the node dimension
     void UpdateFunctionValuesSize()
     {
+        ScopedMemoryTag memoryTag(MemoryTag::NodeValue);
         UpdateDataSize(Value());
     }
 
@@ -1232,6 +1299,10 @@ public:
     {
         Base::BeginForwardProp();
 
+        // a zero-copy view picks up its input's matrices, which the input may just have (re-)allocated
+        if (m_valueIsInputView)
+            AttachInputView();
+
         // update the actual m_value allocation
         if (!IsLeaf() && !RequiresPreCompute()) // TODO: guard this through overrides instead
             UpdateFunctionValuesSize();
@@ -1310,7 +1381,18 @@ public:
 #if DUMPOUTPUT
                 fprintf(stderr, "Backprop%d_%ls\n", i, NodeName().c_str());
 #endif
-                child->LazyZeroGradient(); // set gradient to 0 if this is the first time
+                if (m_gradientIsInputView && child->m_gradient == m_gradient)
+                    child->m_gradientInitialized = true; // (our gradient is the child's: it was initialized and accumulated already)
+                else if (!child->m_gradientInitialized && fr.IsAllFrames() && CanOverwriteInputGradient(i))
+                {
+                    // we are the first to write this gradient: BackpropTo() assigns it, so there is no need to zero it first
+                    ScopedMemoryTag memoryTag(MemoryTag::NodeGradient);
+                    child->UpdateDataSize(child->Gradient());
+                    child->m_gradientInitialized = true;
+                    m_overwriteInputGradient = true;
+                }
+                else
+                    child->LazyZeroGradient(); // set gradient to 0 if this is the first time
 
                 // If we propagate from a loop to a node that is outside the loop, we are not efficient.
                 // This case is handled by SEQTraversalFlowControlNode::Backprop().
@@ -1323,6 +1405,7 @@ public:
 
                 // fprintf(stderr, "BackpropTo %d %d %ls %ls\n", (int)fr.timeIdxInSeq, (int)i, NodeName().c_str(), OperationName().c_str());
                 BackpropTo(i, fr); // this computes partial wrt to the child and sums the gradient value in the child
+                m_overwriteInputGradient = false;
             }
 #ifdef DISPLAY_DEBUG
             else
@@ -1338,6 +1421,18 @@ public:
             Input(i)->m_gradientInitialized = false;
     }
 
+    // A node whose BackpropTo(inputIndex) writes all of the input's gradient for a whole-minibatch FrameRange can return true here,
+    // and then add into the input gradient with InputGradientBeta() as beta. If it is the first contribution to that gradient,
+    // Backprop() skips zeroing it, and beta is 0, so that the gradient is assigned instead of zeroed, read, and written again.
+    virtual bool CanOverwriteInputGradient(size_t /*inputIndex*/) const
+    {
+        return false;
+    }
+    ElemType InputGradientBeta() const
+    {
+        return m_overwriteInputGradient ? (ElemType) 0 : (ElemType) 1;
+    }
+
     // lazy resetting of gradient
     void LazyZeroGradient()
     {
@@ -1347,6 +1442,7 @@ public:
         if (m_gradientInitialized)
             return;
 
+        ScopedMemoryTag memoryTag(MemoryTag::NodeGradient);
         UpdateDataSize(Gradient());
         Gradient().SetValue(0);
 
@@ -1360,14 +1456,15 @@ public:
     // request matrices needed to do node function value evaluation
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
     {
-        RequestMatrixFromPool(m_value, matrixPool);
+        if (!m_valueIsInputView)
+            RequestMatrixFromPool(m_value, matrixPool);
     }
 
     // release temp matrices that are only used by forward computation
     // don't release matrices that need to be used in the gradient computation
     virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
     {
-        if (!IsOutputNeededDuringBackprop() && (m_value->GetMatrixType() != SPARSE) && isValueSharable())
+        if (!m_valueIsInputView && !IsOutputNeededDuringBackprop() && (m_value->GetMatrixType() != SPARSE) && isValueSharable())
             ReleaseMatrixToPool(m_value, matrixPool);
     }
 
@@ -1381,9 +1478,13 @@ public:
     }
 
     // request matrices that are needed for gradient computation
+    // (a gradient view's gradient is its input's, which therefore lives from here on)
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
     {
-        RequestMatrixFromPool(m_gradient, matrixPool);
+        if (m_gradientIsInputView)
+            Input(0)->RequestMatricesBeforeBackprop(matrixPool);
+        else
+            RequestMatrixFromPool(m_gradient, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -1391,21 +1492,53 @@ public:
     {
         if (!IsLeaf() && !RequiresPreCompute())
         {
-            if (m_gradient != nullptr && m_gradient->GetMatrixType() != SPARSE) // since we don't have a sparse pool yet
+            if (!m_gradientIsInputView && m_gradient != nullptr && m_gradient->GetMatrixType() != SPARSE) // since we don't have a sparse pool yet
                 ReleaseMatrixToPool(m_gradient, matrixPool);
 
             // Release the Value matrix only if the output value is needed during backprop
             // since in the case it isn't used, we release it during forward prop itself
-            if (IsOutputNeededDuringBackprop() && m_value->GetMatrixType() != SPARSE && isValueSharable())
+            if (!m_valueIsInputView && IsOutputNeededDuringBackprop() && m_value->GetMatrixType() != SPARSE && isValueSharable())
                 ReleaseMatrixToPool(m_value, matrixPool);
         }
     }
 
+    // zero-copy: by default, a view has the very matrices of its input; called after allocation and before each forward prop
+    virtual void AttachInputView() override
+    {
+        if (m_valueIsInputView)
+            m_value = Input(0)->m_value;
+        if (m_gradientIsInputView)
+            m_gradient = Input(0)->m_gradient;
+    }
+
+    // gradient checkpointing: the value of a recomputed node is dropped after forward prop (it is not
+    // IsOutputNeededDuringBackprop()) and becomes live again for the duration of its recompute segment
+    // (activation offload uses the same two for the time that an output is in host memory)
+    virtual void RequestMatricesBeforeRecompute(MatrixPool& matrixPool) override
+    {
+        matrixPool.Request<ElemType>(&m_value, m_deviceId, GetSampleMatrixNumRows());
+    }
+
+    virtual void ReleaseMatricesAfterRecompute(MatrixPool& matrixPool) override
+    {
+        ReleaseMatrixToPool(m_value, matrixPool);
+    }
+
     void CreateGradientMatrixIfNull()
     {
         CreateMatrixIfNull(m_gradient);
     }
 
+    // (matrices from the pool do not exist yet, those created earlier, like the values of parameters, are moved)
+    virtual void MoveToDevice(DEVICEID_TYPE deviceId) override
+    {
+        Base::MoveToDevice(deviceId);
+        if (m_value)
+            m_value->TransferToDeviceIfNotThere(deviceId, true);
+        if (m_gradient)
+            m_gradient->TransferToDeviceIfNotThere(deviceId, true);
+    }
+
     void MarkValueNonSharable() override
     {
         m_valueSharable = false;
@@ -1427,7 +1560,7 @@ protected:
     {
         if (matrixPtr == nullptr)
         {
-            matrixPtr = matrixPool.Request<ElemType>(m_deviceId);
+            matrixPool.Request<ElemType>(&matrixPtr, m_deviceId, GetSampleMatrixNumRows());
         }
     }
 
@@ -1520,24 +1653,22 @@ public:
         }
     }
 
-    // NOTE: we should reimplement this to be thread-safe and use a larger than requested initialized memory block
+    // NOTE: we should reimplement this to use a larger than requested initialized memory block
     // we can then just wrap that memory block in a matrix of the correct dimensions since it will be const no one can change it
     // should only need one memory block per device
-    // Thread-safety could be achieved by changing this to a shared_ptr.
+    // There is one matrix per device, and the lookup is locked, so that networks on several threads (e.g. the background
+    // cross-validation in SGD) can use this concurrently; once created, a matrix is never modified.
     // When using the TensorView interface, one could instead just use a 1x1 matrix with a view that broadcasts its columns (stride 0).
     static const Matrix<ElemType>& ConstOnes(const size_t rows, const size_t cols, const DEVICEID_TYPE deviceId)
     {
-        if (s_constOnes.find(rows) == s_constOnes.end() ||
-            s_constOnes[rows].find(cols) == s_constOnes[rows].end()) // not found
+        static std::mutex s_constOnesMutex;
+        std::lock_guard<std::mutex> lock(s_constOnesMutex);
+        auto& m = s_constOnes[deviceId][rows][cols];
+        if (!m) // not found
         {
-            Matrix<ElemType>* matrix = new Matrix<ElemType>(rows, cols, (DEVICEID_TYPE) deviceId);
-            matrix->SetValue(1);
-            s_constOnes[rows][cols] = matrix;
+            m = new Matrix<ElemType>(rows, cols, (DEVICEID_TYPE) deviceId);
+            m->SetValue(1);
         }
-
-        Matrix<ElemType>* m = s_constOnes[rows][cols];
-        m->TransferFromDeviceToDevice(m->GetDeviceId(), deviceId);
-
         return *m;
     }
 
@@ -1548,8 +1679,9 @@ public:
 protected:
 
     shared_ptr<Matrix<ElemType>> m_value, m_gradient;
+    bool m_overwriteInputGradient; // (during BackpropTo(): see CanOverwriteInputGradient())
 
-    static std::map<size_t, std::map<size_t, Matrix<ElemType>*>> s_constOnes;
+    static std::map<DEVICEID_TYPE, std::map<size_t, std::map<size_t, Matrix<ElemType>*>>> s_constOnes; // [deviceId][rows][cols]
 };
 
 // convenience wrapper for ComputationNode::New()
@@ -1638,6 +1770,23 @@ public:
     virtual bool RequiresPreCompute() const override { return false; } // return true if the node's value should be computed before the normal training. e.g., mean and invStd of input features.
     virtual void PrintSelfBeforeValidation() const override { }
     virtual void DumpNodeInfo(const bool /*printValues*/, File& fstream) const override { }
+    virtual void RequestMatricesBeforeRecompute(MatrixPool& matrixPool) override { }
+    virtual void ReleaseMatricesAfterRecompute(MatrixPool& matrixPool) override { }
+    // for profiling, a loop counts as all of its nodes
+    virtual double GetForwardFlopsEstimate() const override { return SumOverNestedNodes([](const ComputationNodeBasePtr& node) { return node->GetForwardFlopsEstimate(); }); }
+    virtual size_t GetElementSize() const override { return m_nestedNodes.empty() ? 0 : m_nestedNodes.front()->GetElementSize(); }
+    virtual size_t GetValueAllocatedBytes() const override { return (size_t) SumOverNestedNodes([](const ComputationNodeBasePtr& node) { return (double) node->GetValueAllocatedBytes(); }); }
+    virtual size_t GetGradientAllocatedBytes() const override { return (size_t) SumOverNestedNodes([](const ComputationNodeBasePtr& node) { return (double) node->GetGradientAllocatedBytes(); }); }
+
+private:
+    template <class F>
+    double SumOverNestedNodes(const F& f) const
+    {
+        double sum = 0;
+        for (const auto& node : m_nestedNodes)
+            sum += f(node);
+        return sum;
+    }
 
 protected: public:                                     // needed in ComputationNetwork::FindInRecurrentLoops(), which really should be part of SEQTraversalFlowControlNode
     std::vector<ComputationNodeBasePtr> m_nestedNodes; // nodes tucked away in this node, in evaluation order
@@ -1729,9 +1878,11 @@ protected:
     using Base::GradientAsMatrix;                                                                                                                        \
     using Base::GradientFor;                                                                                                                             \
     using Base::GradientTensorFor;                                                                                                                       \
+    using Base::HasIndexLabels;                                                                                                                          \
     using Base::HasMBLayout;                                                                                                                             \
     using Base::InferMBLayoutFromInputsForStandardCase;                                                                                                  \
     using Base::Input;                                                                                                                                   \
+    using Base::InputGradientBeta;                                                                                                                       \
     using Base::InputUsedInComputingInputNodesGradients;                                                                                                 \
     using Base::InvalidateMissingGradientColumns;                                                                                                        \
     using Base::InvalidateMissingValueColumns;                                                                                                           \
@@ -1775,6 +1926,7 @@ protected:
     using Base::ZeroGradientsOfInputs;                                                                                                                   \
     using Base::m_deviceId;                                                                                                                              \
     using Base::m_gradient;                                                                                                                              \
+    using Base::m_gradientIsInputView;                                                                                                                   \
     using Base::m_inputs;                                                                                                                                \
     using Base::m_nodeName;                                                                                                                              \
     using Base::m_pMBLayout;                                                                                                                             \
@@ -1782,6 +1934,7 @@ protected:
     using Base::m_sampleLayout;                                                                                                                          \
     using Base::m_value;                                                                                                                                 \
     using Base::m_valueSharable;                                                                                                                         \
+    using Base::m_valueIsInputView;                                                                                                                      \
     using Base::shared_from_this;                                                                                                                        \
     \
 public:                                                                                                                                                  \
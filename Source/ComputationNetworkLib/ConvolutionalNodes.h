@@ -26,7 +26,9 @@
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // -----------------------------------------------------------------------
+// ConvolutionNodeBase (convolutionWeights, inputFeature, ...)
 // ConvolutionNode (convolutionWeights, inputFeature)
+// ConvolutionBiasActivationNode (convolutionWeights, inputFeature, bias)
 // -----------------------------------------------------------------------
 
 // Convolutions (incl. pooling) support two different storage formats:
@@ -56,17 +58,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 //     - for hidden layer: dimension of activation vector for each pixel
 //  - C' = output channels = dimension of activation vector for each pixel (also called N by NVidia, inconsistently)
 template <class ElemType>
-class ConvolutionNode : public ComputationNode<ElemType>, public NumInputs<2>
+class ConvolutionNodeBase : public ComputationNode<ElemType>
 {
     typedef ComputationNode<ElemType> Base;
-    UsingComputationNodeMembersBoilerplate;
-    static const std::wstring TypeName()
-    {
-        return L"Convolution";
-    }
+    UsingComputationNodeMembers;
 
 public:
-    ConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name)
+    ConvolutionNodeBase(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
           m_kernelWidth(SIZE_MAX),
           m_kernelHeight(SIZE_MAX),
@@ -79,8 +77,8 @@ public:
     {
         SetDims(ImageDimensions::AsTensorShape(1, 1, 0, m_imageLayoutKind), 0);
     }
-    ConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name, const size_t kernelWidth, const size_t kernelHeight, const size_t outputChannels, const size_t horizontalSubsample, const size_t verticalSubsample, ImageLayoutKind imageLayoutKind,
-                    const bool zeroPadding = false, const size_t maxTempMemSizeInSamples = 0)
+    ConvolutionNodeBase(DEVICEID_TYPE deviceId, const wstring& name, const size_t kernelWidth, const size_t kernelHeight, const size_t outputChannels, const size_t horizontalSubsample, const size_t verticalSubsample, ImageLayoutKind imageLayoutKind,
+                        const bool zeroPadding = false, const size_t maxTempMemSizeInSamples = 0)
         : Base(deviceId, name),
           m_outputChannels(outputChannels),
           m_kernelWidth(kernelWidth),
@@ -94,13 +92,18 @@ public:
         SetDims(ImageDimensions::AsTensorShape(1, 1, m_outputChannels, m_imageLayoutKind), 0); // TODO: necessary?
         m_factory = ConvolutionEngineFactory<ElemType>::Create(deviceId, ConvolutionEngineFactory<ElemType>::EngineType::Auto, m_imageLayoutKind);
     }
-    ConvolutionNode(const ScriptableObjects::IConfigRecordPtr configp)
-        : ConvolutionNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"kernelWidth"), configp->Get(L"kernelHeight"), configp->Get(L"outputChannels"),
-                          configp->Get(L"horizontalSubsample"), configp->Get(L"verticalSubsample"), ImageLayoutKindFrom(configp->Get(L"imageLayout")),
-                          configp->Get(L"zeroPadding"), configp->Get(L"maxTempMemSizeInSamples"))
+    ConvolutionNodeBase(const ScriptableObjects::IConfigRecordPtr configp)
+        : ConvolutionNodeBase(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"kernelWidth"), configp->Get(L"kernelHeight"), configp->Get(L"outputChannels"),
+                              configp->Get(L"horizontalSubsample"), configp->Get(L"verticalSubsample"), ImageLayoutKindFrom(configp->Get(L"imageLayout")),
+                              configp->Get(L"zeroPadding"), configp->Get(L"maxTempMemSizeInSamples"))
+    {
+        // (the derived classes attach the inputs)
+    }
+    // with the geometry of another convolution
+    ConvolutionNodeBase(DEVICEID_TYPE deviceId, const wstring& name, const ConvolutionNodeBase<ElemType>& other)
+        : ConvolutionNodeBase(deviceId, name, other.m_kernelWidth, other.m_kernelHeight, other.m_outputChannels, other.m_horizontalSubsample, other.m_verticalSubsample, other.m_imageLayoutKind,
+                              other.m_zeroPadding, other.m_maxTempMemSizeInSamples)
     {
-        // weightNodeName, inputValueNodeName, kernelWidth, kernelHeight, outputChannels, horizontalSubsample, verticalSubsample, zeroPadding = false, maxTempMemSizeInSamples = 0
-        AttachInputs(configp, this->GetExpectedNumInputs());
     }
 
     void Save(File& fstream) const override
@@ -131,7 +134,7 @@ public:
         Base::CopyTo(nodeP, newName, flags);
         if (flags & CopyNodeFlags::copyNodeValue)
         {
-            auto node = dynamic_pointer_cast<ConvolutionNode<ElemType>>(nodeP);
+            auto node = dynamic_pointer_cast<ConvolutionNodeBase<ElemType>>(nodeP);
             node->m_kernelWidth = m_kernelWidth;
             node->m_kernelHeight = m_kernelHeight;
 
@@ -150,7 +153,12 @@ public:
 
     void BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
-        auto sliceOutputGrad = GradientFor(fr);
+        BackpropToWeightsOrFeature(inputIndex, fr, GradientFor(fr));
+    }
+
+    // the gradients of the weights (inputIndex 0) and of the input feature (1), from the gradient of the convolution
+    void BackpropToWeightsOrFeature(const size_t inputIndex, const FrameRange& fr, const Matrix<ElemType>& sliceOutputGrad)
+    {
         auto sliceInput1Value = Input(1)->ValueFor(fr);
 
         size_t batchSize = sliceInput1Value.GetNumCols();
@@ -177,6 +185,13 @@ public:
         return false;
     }
 
+    // one multiply-add per kernel weight and output pixel
+    virtual double GetForwardFlopsEstimate() const override
+    {
+        const size_t outputPixels = m_outputChannels > 0 ? GetSampleMatrixNumRows() / m_outputChannels : 0;
+        return 2.0 * Input(0)->GetSampleMatrixNumRows() * Input(0)->GetSampleMatrixNumCols() * outputPixels * GetSampleMatrixNumCols();
+    }
+
     void ForwardProp(const FrameRange& fr) override
     {
         const Matrix<ElemType>& input0 = Input(0)->ValueAsMatrix();
@@ -221,7 +236,7 @@ public:
         auto inDims = ImageDimensions(GetInputSampleLayout(1), m_imageLayoutKind);
 
         if (isFinalValidationPass && (inDims.m_width < m_kernelWidth || inDims.m_height < m_kernelHeight))
-            InvalidArgument("%ls %ls operation requires that input width be >= kernelWidth and input height >= kernelHeight.", NodeName().c_str(), OperationName().c_str());
+            InvalidArgument("%ls %ls operation requires that input width be >= kernelWidth and input height >= kernelHeight.", NodeName().c_str(), this->OperationName().c_str());
 
         // determine output tensor shape
         const int kernelWidthCenter = m_zeroPadding ? m_kernelWidth % 2 : m_kernelWidth;
@@ -291,6 +306,15 @@ public:
         m_maxTempMemSizeInSamples = maxTempMemSizeInSamples;
     }
 
+    size_t OutputChannels() const
+    {
+        return m_outputChannels;
+    }
+    ImageLayoutKind ImageLayout() const
+    {
+        return m_imageLayoutKind;
+    }
+
     // request matrices needed to do node function value evaluation
     void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
     {
@@ -305,7 +329,7 @@ public:
         ReleaseMatrixToPool(m_tempMatrix, matrixPool);
     }
 
-private:
+protected:
     size_t m_outputChannels;
     size_t m_kernelWidth, m_kernelHeight;
     size_t m_horizontalSubsample, m_verticalSubsample;
@@ -327,9 +351,198 @@ private:
     std::unique_ptr<ConvolutionTensor4D> m_biasT;
 };
 
+#define UsingConvolutionNodeBaseMembers     \
+    UsingComputationNodeMembersBoilerplate; \
+    \
+protected:                                  \
+    using Base::m_outputChannels;           \
+    using Base::m_imageLayoutKind;          \
+    using Base::m_convEng;                  \
+    using Base::m_inT;                      \
+    using Base::m_filterT;                  \
+    using Base::m_outT;                     \
+    using Base::m_convDesc;                 \
+    using Base::m_biasT;                    \
+    using Base::m_tempMatrix;               \
+    \
+public:
+
+template <class ElemType>
+class ConvolutionNode : public ConvolutionNodeBase<ElemType>, public NumInputs<2>
+{
+    typedef ConvolutionNodeBase<ElemType> Base;
+    UsingConvolutionNodeBaseMembers;
+    static const std::wstring TypeName()
+    {
+        return L"Convolution";
+    }
+
+public:
+    ConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+    ConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name, const size_t kernelWidth, const size_t kernelHeight, const size_t outputChannels, const size_t horizontalSubsample, const size_t verticalSubsample, ImageLayoutKind imageLayoutKind,
+                    const bool zeroPadding = false, const size_t maxTempMemSizeInSamples = 0)
+        : Base(deviceId, name, kernelWidth, kernelHeight, outputChannels, horizontalSubsample, verticalSubsample, imageLayoutKind, zeroPadding, maxTempMemSizeInSamples)
+    {
+    }
+    ConvolutionNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : Base(configp)
+    {
+        // weightNodeName, inputValueNodeName, kernelWidth, kernelHeight, outputChannels, horizontalSubsample, verticalSubsample, zeroPadding = false, maxTempMemSizeInSamples = 0
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+};
+
 template class ConvolutionNode<float>;
 template class ConvolutionNode<double>;
 
+// ConvolutionBiasActivationNode (convolutionWeights, inputFeature, bias) -- act(Convolution(W, x) + b)
+// Created by ComputationNetwork::FuseConvolutionActivations() from a Convolution, the Plus of a per-channel bias, and
+// an optional RectifiedLinear, so that the engine applies bias and activation to the output as it computes it (see
+// ConvolutionEngine::ForwardBiasActivation()) and the network stores one output instead of three.
+// The bias has one value per output channel, e.g. [C' x 1] for HWC and [1 x 1 x C'] for CHW.
+// m_activation is empty (none) or RectifiedLinear, whose gradient is taken from the output, as RectifiedLinearNode does.
+template <class ElemType>
+class ConvolutionBiasActivationNode : public ConvolutionNodeBase<ElemType>, public NumInputs<3>
+{
+    typedef ConvolutionNodeBase<ElemType> Base;
+    UsingConvolutionNodeBaseMembers;
+    static const std::wstring TypeName()
+    {
+        return L"ConvolutionBiasActivation";
+    }
+
+public:
+    ConvolutionBiasActivationNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+    ConvolutionBiasActivationNode(DEVICEID_TYPE deviceId, const wstring& name, const ConvolutionNodeBase<ElemType>& convolution, const wstring& activation)
+        : Base(deviceId, name, convolution), m_activation(activation)
+    {
+    }
+    ConvolutionBiasActivationNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : Base(configp)
+    {
+        wstring activation = configp->Get(L"activation");
+        m_activation = activation;
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_activation;
+    }
+
+    void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_activation;
+    }
+
+    void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<ConvolutionBiasActivationNode<ElemType>>(nodeP);
+            node->m_activation = m_activation;
+        }
+    }
+
+    void ForwardProp(const FrameRange& fr) override
+    {
+        const Matrix<ElemType>& input0 = Input(0)->ValueAsMatrix();
+        Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
+        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+
+        size_t batchSize = sliceInput1Value.GetNumCols();
+        m_inT->setN(batchSize);
+        m_outT->setN(batchSize);
+        assert(m_convEng != nullptr);
+        m_convEng->ForwardBiasActivation(*m_inT, sliceInput1Value, *m_filterT, input0, *m_convDesc, *m_biasT, Bias(), IsRectified(), *m_outT, sliceOutputValue, *m_tempMatrix);
+#if NANCHECK
+        sliceOutputValue.HasNan("ConvolutionBiasActivation");
+#endif
+    }
+
+    void BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        // the gradient of the convolution and of the bias, i.e. the gradient of the node masked where the activation is 0
+        // (into a matrix of its own, as the gradient of the node may be shared with a consumer that needs it as it is)
+        Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
+        const Matrix<ElemType>* convolutionGrad = &sliceOutputGrad;
+        if (IsRectified())
+        {
+            m_convolutionGradient->AssignLinearRectifierDerivativeOf(ValueFor(fr));
+            m_convolutionGradient->ElementMultiplyWith(sliceOutputGrad);
+            convolutionGrad = m_convolutionGradient.get();
+        }
+
+        if (inputIndex == 2) // derivative with respect to the bias
+        {
+            m_outT->setN(convolutionGrad->GetNumCols());
+            Matrix<ElemType> biasGrad = Input(2)->Gradient().Reshaped(m_outputChannels, 1);
+            m_convEng->BackwardBias(*m_outT, *convolutionGrad, *m_biasT, biasGrad);
+        }
+        else
+            Base::BackpropToWeightsOrFeature(inputIndex, fr, *convolutionGrad);
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return IsRectified();
+    }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override
+    {
+        return childIndex != 2;
+    }
+
+    void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        if (m_activation != L"" && m_activation != L"RectifiedLinear")
+            InvalidArgument("%ls %ls operation: unknown activation '%ls'.", NodeName().c_str(), OperationName().c_str(), m_activation.c_str());
+        if (isFinalValidationPass && (Input(2)->HasMBLayout() || Input(2)->GetSampleLayout().GetNumElements() != m_outputChannels))
+            InvalidArgument("%ls %ls operation requires the bias to have one value per output channel (%d) and to not be minibatch data.", NodeName().c_str(), OperationName().c_str(), (int) m_outputChannels);
+    }
+
+    void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        if (IsRectified())
+            RequestMatrixFromPool(m_convolutionGradient, matrixPool);
+    }
+
+    void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        if (IsRectified())
+            ReleaseMatrixToPool(m_convolutionGradient, matrixPool);
+    }
+
+private:
+    bool IsRectified() const
+    {
+        return m_activation == L"RectifiedLinear";
+    }
+
+    // the bias as the [C' x 1] column that the engines take, whatever its tensor shape
+    Matrix<ElemType> Bias()
+    {
+        return Input(2)->Value().Reshaped(m_outputChannels, 1);
+    }
+
+    wstring m_activation;
+    shared_ptr<Matrix<ElemType>> m_convolutionGradient;
+};
+
+template class ConvolutionBiasActivationNode<float>;
+template class ConvolutionBiasActivationNode<double>;
+
 // -----------------------------------------------------------------------
 // PoolingNodeBase (input)
 // -----------------------------------------------------------------------
@@ -510,7 +723,10 @@ protected:
     \
 protected:                                  \
     using Base::m_factory;                  \
+    using Base::m_poolEng;                  \
     using Base::m_poolDesc;                 \
+    using Base::m_inT;                      \
+    using Base::m_outT;                     \
     using Base::m_windowWidth;              \
     using Base::m_windowHeight;             \
     using Base::m_horizontalSubsample;      \
@@ -522,6 +738,11 @@ public:
 
 // -----------------------------------------------------------------------
 // MaxPoolingNode
+//
+// With maxPoolingIndices=true, and an engine that supports it, ForwardProp() saves for each output the position
+// of its maximum within the window in 1 or 2 bytes (see PoolingEngine::ForwardMaxWithIndices()). Backprop is then
+// a scatter of the gradient through these indices, and needs neither the input nor the output value, so that the
+// memory planner can release them early.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -548,12 +769,65 @@ public:
     {
     }
 
+    void ForwardProp(const FrameRange& fr) override
+    {
+        if (!UsesMaxIndices())
+            return Base::ForwardProp(fr);
+
+        Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
+        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+
+        size_t batchSize = sliceInput0Value.GetNumCols();
+        m_inT->setN(batchSize);
+        m_outT->setN(batchSize);
+        m_maxIndices.resize(Value().GetNumElements() * PoolingEngine<ElemType>::MaxIndexBytes(*m_poolDesc));
+        m_poolEng->ForwardMaxWithIndices(*m_inT, sliceInput0Value, *m_poolDesc, *m_outT, sliceOutputValue, MaxIndicesFor(fr));
+    }
+
+    void BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        if (!UsesMaxIndices())
+            return Base::BackpropTo(inputIndex, fr);
+
+        Matrix<ElemType> sliceInput0Grad = Input(0)->GradientFor(fr);
+        Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
+
+        size_t batchSize = sliceOutputGrad.GetNumCols();
+        m_inT->setN(batchSize);
+        m_outT->setN(batchSize);
+        m_poolEng->BackwardMaxFromIndices(*m_outT, sliceOutputGrad, *m_poolDesc, *m_inT, MaxIndicesFor(fr), sliceInput0Grad);
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return !UsesMaxIndices();
+    }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override
+    {
+        return !UsesMaxIndices();
+    }
+
     void Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
         if (isFinalValidationPass && m_poolDesc == nullptr)
             m_poolDesc = m_factory->CreatePoolDescriptor(PoolingDescriptor::PoolKind::Max, m_windowWidth, m_windowHeight, m_horizontalSubsample, m_verticalSubsample, 0, 0);
     }
+
+private:
+    bool UsesMaxIndices() const
+    {
+        return g_maxPoolingIndices && m_poolEng && m_poolEng->SupportsMaxIndices();
+    }
+
+    // the indices of the outputs in the columns of the frame range
+    unsigned char* MaxIndicesFor(const FrameRange& fr)
+    {
+        size_t offset = ColumnRangeWithMBLayoutFor(Value().GetNumCols(), fr, GetMBLayout()).first * Value().GetNumRows();
+        return m_maxIndices.data() + offset * PoolingEngine<ElemType>::MaxIndexBytes(*m_poolDesc);
+    }
+
+    std::vector<unsigned char> m_maxIndices; // [Value().GetNumElements() x MaxIndexBytes()] on the host
 };
 
 template class MaxPoolingNode<float>;
@@ -598,4 +872,385 @@ public:
 template class AveragePoolingNode<float>;
 template class AveragePoolingNode<double>;
 
+// -----------------------------------------------------------------------
+// TimeDelayNode (weights, input) -- dilated 1-D convolution over the time axis of the sequences (TDNN layer)
+//
+// Output frame t is sum_k W_k x(t + (k - (kernelWidth - 1) / 2) * dilation), where the weights W = [W_0 ... W_{K-1}]
+// are [outputDim x kernelWidth * inputDim], as for Times(W, SpliceNeighbors(x, ...)) with dilation 1. A tap beyond
+// the boundary of a sequence (or of the part of it in the minibatch) gets the first or last frame, as in SpliceNeighbors.
+// Nothing is unfolded: without subsampling, each tap is one product of W_k with the input columns shifted by its
+// offset, since frame t + d of a parallel sequence is d * numParallelSequences columns further; the few columns whose
+// tap crosses a sequence boundary are then corrected by products over just those columns. With subsample > 1, only
+// every subsample-th frame (in minibatch time) is computed, into a layout of its own with ceil(T / subsample) time
+// steps, and each tap gathers the input columns it needs. (Sequences that span minibatches keep their phase if the
+// minibatch length is a multiple of subsample.)
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class TimeDelayNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<2>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"TimeDelay";
+    }
+
+public:
+    TimeDelayNode(DEVICEID_TYPE deviceId, const wstring& name, size_t kernelWidth = 1, size_t dilation = 1, size_t subsample = 1)
+        : Base(deviceId, name),
+          m_kernelWidth(kernelWidth),
+          m_dilation(dilation),
+          m_subsample(subsample)
+    {
+    }
+    TimeDelayNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : TimeDelayNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"kernelWidth"), configp->Get(L"dilation"), configp->Get(L"subsample"))
+    {
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<TimeDelayNode<ElemType>>(nodeP);
+            node->m_kernelWidth = m_kernelWidth;
+            node->m_dilation = m_dilation;
+            node->m_subsample = m_subsample;
+        }
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_kernelWidth << m_dilation << m_subsample;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_kernelWidth >> m_dilation >> m_subsample;
+    }
+
+    virtual void PrintSelfBeforeValidation() const override
+    {
+        Base::PrintSelfBeforeValidation();
+        fprintf(stderr, ", kernelWidth=%lu, dilation=%lu, subsample=%lu", m_kernelWidth, m_dilation, m_subsample);
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        if (m_kernelWidth == 0 || m_dilation == 0 || m_subsample == 0)
+            InvalidArgument("%ls %ls operation: kernelWidth, dilation and subsample must be at least 1.", NodeName().c_str(), OperationName().c_str());
+        if (isFinalValidationPass && (Input(0)->HasMBLayout() || !Input(1)->HasMBLayout()))
+            InvalidArgument("%ls %ls operation requires weights without and minibatch data with a layout as its inputs.", NodeName().c_str(), OperationName().c_str());
+
+        // the output has a layout of its own when it has fewer frames
+        if (m_subsample > 1 && Input(1)->HasMBLayout())
+        {
+            if (!m_subsampledLayout)
+                m_subsampledLayout = make_shared<MBLayout>();
+            LinkToMBLayout(m_subsampledLayout);
+        }
+        else
+            InferMBLayoutFromInputsForStandardCase();
+
+        const size_t inputDim = Input(1)->GetSampleLayout().GetNumElements();
+        Input(0)->ValidateInferInputDimsFrom(TensorShape(Input(0)->GetAsMatrixNumRows(), m_kernelWidth * inputDim));
+        if (isFinalValidationPass && Input(0)->GetAsMatrixNumCols() != m_kernelWidth * inputDim)
+            InvalidArgument("%ls %ls operation: the weights must have kernelWidth * %d columns.", NodeName().c_str(), OperationName().c_str(), (int) inputDim);
+        SetDims(TensorShape(Input(0)->GetAsMatrixNumRows()), HasMBLayout());
+    }
+
+    virtual void /*ComputationNode::*/ BeginForwardProp() override
+    {
+        if (m_subsample > 1)
+            UpdateSubsampledLayout(); // (before the value gets its size from it)
+        Base::BeginForwardProp();
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        UpdateTapColumns();
+        Input(1)->MaskMissingValueColumnsToZero(FrameRange(Input(1)->GetMBLayout())); // (gaps are read by shifted taps)
+        const auto& input = Input(1)->ValueAsMatrix();
+        auto& output = ValueAsMatrix();
+        output.SetValue(0);
+        for (size_t k = 0; k < m_kernelWidth; k++)
+        {
+            const auto weights = Input(0)->ValueAsMatrix().ColumnSlice(k * input.GetNumRows(), input.GetNumRows());
+            if (m_subsample > 1)
+            {
+                EnsureBuffer(m_gathered)->AssignRowStackedColumnsOf(input, *m_taps[k].sources);
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, weights, false, *m_gathered, false, 1, output);
+                continue;
+            }
+            size_t outputBegin, numCols;
+            ptrdiff_t shift;
+            if (GetShiftedColumns(k, outputBegin, numCols, shift))
+            {
+                auto outputSlice = output.ColumnSlice(outputBegin, numCols);
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, weights, false, input.ColumnSlice(outputBegin + shift, numCols), false, 1, outputSlice);
+            }
+            // correct the columns where the tap crossed a sequence boundary: add the right input column, subtract the one used
+            for (int sign = 1; sign >= -1; sign -= 2)
+            {
+                const auto& correction = sign > 0 ? m_taps[k].boundaryAdd : m_taps[k].boundarySubtract;
+                if (correction.numCols == 0)
+                    continue;
+                EnsureBuffer(m_gathered)->AssignRowStackedColumnsOf(input, *correction.sources);
+                EnsureBuffer(m_product)->AssignProductOf(weights, false, *m_gathered, false);
+                if (sign < 0)
+                    *m_product *= -1;
+                output.AddFromRowStackedColumnsOf(*m_product, *correction.targets);
+            }
+        }
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override
+    {
+        MaskMissingGradientColumnsToZero(FrameRange(GetMBLayout()));
+        const auto& input = Input(1)->ValueAsMatrix();
+        const auto& outputGradient = GradientAsMatrix();
+        const size_t inputDim = input.GetNumRows();
+        for (size_t k = 0; k < m_kernelWidth; k++)
+        {
+            if (inputIndex == 0) // dW_k += dy x_k^T
+            {
+                auto weightsGradient = Input(0)->GradientAsMatrix().ColumnSlice(k * inputDim, inputDim);
+                if (m_subsample > 1)
+                {
+                    EnsureBuffer(m_gathered)->AssignRowStackedColumnsOf(input, *m_taps[k].sources);
+                    Matrix<ElemType>::MultiplyAndWeightedAdd(1, outputGradient, false, *m_gathered, true, 1, weightsGradient);
+                    continue;
+                }
+                size_t outputBegin, numCols;
+                ptrdiff_t shift;
+                if (GetShiftedColumns(k, outputBegin, numCols, shift))
+                    Matrix<ElemType>::MultiplyAndWeightedAdd(1, outputGradient.ColumnSlice(outputBegin, numCols), false, input.ColumnSlice(outputBegin + shift, numCols), true, 1, weightsGradient);
+                for (int sign = 1; sign >= -1; sign -= 2)
+                {
+                    const auto& correction = sign > 0 ? m_taps[k].boundaryAdd : m_taps[k].boundarySubtract;
+                    if (correction.numCols == 0)
+                        continue;
+                    EnsureBuffer(m_gathered)->AssignRowStackedColumnsOf(input, *correction.sources);
+                    EnsureBuffer(m_gatheredGradient)->AssignRowStackedColumnsOf(outputGradient, *correction.targets);
+                    Matrix<ElemType>::MultiplyAndWeightedAdd((ElemType) sign, *m_gatheredGradient, false, *m_gathered, true, 1, weightsGradient);
+                }
+            }
+            else // dx_k += W_k^T dy
+            {
+                const auto weights = Input(0)->ValueAsMatrix().ColumnSlice(k * inputDim, inputDim);
+                auto& inputGradient = Input(1)->GradientAsMatrix();
+                if (m_subsample > 1)
+                {
+                    EnsureBuffer(m_product)->AssignProductOf(weights, true, outputGradient, false);
+                    inputGradient.AddFromRowStackedColumnsOf(*m_product, *m_taps[k].sources);
+                    continue;
+                }
+                size_t outputBegin, numCols;
+                ptrdiff_t shift;
+                if (GetShiftedColumns(k, outputBegin, numCols, shift))
+                {
+                    auto inputGradientSlice = inputGradient.ColumnSlice(outputBegin + shift, numCols);
+                    Matrix<ElemType>::MultiplyAndWeightedAdd(1, weights, true, outputGradient.ColumnSlice(outputBegin, numCols), false, 1, inputGradientSlice);
+                }
+                for (int sign = 1; sign >= -1; sign -= 2)
+                {
+                    const auto& correction = sign > 0 ? m_taps[k].boundaryAdd : m_taps[k].boundarySubtract;
+                    if (correction.numCols == 0)
+                        continue;
+                    EnsureBuffer(m_gatheredGradient)->AssignRowStackedColumnsOf(outputGradient, *correction.targets);
+                    EnsureBuffer(m_product)->AssignProductOf(weights, true, *m_gatheredGradient, false);
+                    if (sign < 0)
+                        *m_product *= -1;
+                    inputGradient.AddFromRowStackedColumnsOf(*m_product, *correction.sources);
+                }
+            }
+        }
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return false;
+    }
+
+    // one multiply-add per weight element and output column
+    virtual double GetForwardFlopsEstimate() const override
+    {
+        return 2.0 * Input(0)->GetAsMatrixNumRows() * Input(0)->GetAsMatrixNumCols() * GetSampleMatrixNumCols();
+    }
+
+private:
+    // columns sources[i] of one matrix that belong to columns targets[i] of another (as [1 x numCols] index matrices)
+    struct ColumnMap
+    {
+        shared_ptr<Matrix<ElemType>> sources;
+        shared_ptr<Matrix<ElemType>> targets;
+        size_t numCols = 0;
+    };
+    struct Tap
+    {
+        ColumnMap boundaryAdd;      // output columns whose input column for the tap is not the shifted one...
+        ColumnMap boundarySubtract; // ...and the shifted one they got, where it exists
+        shared_ptr<Matrix<ElemType>> sources; // (subsampled) [1 x output columns] the input column of every output column
+    };
+
+    ptrdiff_t TapOffset(size_t k) const
+    {
+        return ((ptrdiff_t) k - (ptrdiff_t)(m_kernelWidth - 1) / 2) * (ptrdiff_t) m_dilation;
+    }
+
+    // the output columns that tap k multiplies with the input shifted by 'shift' columns
+    bool GetShiftedColumns(size_t k, size_t& outputBegin, size_t& numCols, ptrdiff_t& shift) const
+    {
+        const size_t n = GetMBLayout()->GetNumCols();
+        shift = TapOffset(k) * (ptrdiff_t) GetMBLayout()->GetNumParallelSequences();
+        if ((size_t)(shift < 0 ? -shift : shift) >= n)
+            return false;
+        outputBegin = shift < 0 ? (size_t) -shift : 0;
+        numCols = n - (size_t)(shift < 0 ? -shift : shift);
+        return true;
+    }
+
+    shared_ptr<Matrix<ElemType>>& EnsureBuffer(shared_ptr<Matrix<ElemType>>& buffer)
+    {
+        if (!buffer)
+            buffer = make_shared<Matrix<ElemType>>(m_deviceId);
+        return buffer;
+    }
+
+    void SetColumnMap(ColumnMap& map, const std::vector<ElemType>& sources, const std::vector<ElemType>& targets)
+    {
+        map.numCols = sources.size();
+        if (map.numCols == 0)
+            return;
+        EnsureBuffer(map.sources)->SetValue(1, map.numCols, m_deviceId, const_cast<ElemType*>(sources.data()), matrixFlagNormal);
+        EnsureBuffer(map.targets)->SetValue(1, map.numCols, m_deviceId, const_cast<ElemType*>(targets.data()), matrixFlagNormal);
+    }
+
+    // output frame t' is input frame t' * m_subsample; a sequence keeps the frames of it that are such
+    void UpdateSubsampledLayout()
+    {
+        const auto& inputLayout = Input(1)->GetMBLayout();
+        const size_t S = inputLayout->GetNumParallelSequences();
+        const size_t T = (inputLayout->GetNumTimeSteps() + m_subsample - 1) / m_subsample;
+        const ptrdiff_t sub = (ptrdiff_t) m_subsample;
+        m_pMBLayout->Init(S, T);
+        std::vector<bool> covered(S * T, false);
+        for (const auto& seq : inputLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            const ptrdiff_t tBegin = seq.tBegin >= 0 ? (seq.tBegin + sub - 1) / sub : -(-seq.tBegin / sub); // (rounded up)
+            const ptrdiff_t tEnd = ((ptrdiff_t) seq.tEnd + sub - 1) / sub;
+            if (tEnd <= tBegin || tBegin >= (ptrdiff_t) T) // (no frame of it is kept)
+                continue;
+            m_pMBLayout->AddSequence(seq.seqId, seq.s, tBegin, (size_t) tEnd);
+            for (ptrdiff_t t = max(tBegin, (ptrdiff_t) 0); t < min(tEnd, (ptrdiff_t) T); t++)
+                covered[t * S + seq.s] = true;
+        }
+        for (size_t s = 0; s < S; s++)
+        {
+            for (size_t t = 0; t < T;)
+            {
+                size_t tEnd = t;
+                while (tEnd < T && !covered[tEnd * S + s])
+                    tEnd++;
+                if (tEnd > t)
+                    m_pMBLayout->AddGap(s, t, tEnd);
+                t = max(tEnd, t + 1);
+            }
+        }
+    }
+
+    // determine the input columns of the taps from the input MBLayout
+    void UpdateTapColumns()
+    {
+        const auto& inputLayout = Input(1)->GetMBLayout();
+        const size_t S = inputLayout->GetNumParallelSequences();
+        const ptrdiff_t T = (ptrdiff_t) inputLayout->GetNumTimeSteps();
+        m_taps.resize(m_kernelWidth);
+
+        if (m_subsample > 1)
+        {
+            // every output column, gaps included, refers to the input column of its frame, or to the clamped neighbor of it
+            const size_t numOutputCols = GetMBLayout()->GetNumCols();
+            for (size_t k = 0; k < m_kernelWidth; k++)
+            {
+                m_sources.resize(numOutputCols);
+                for (size_t j = 0; j < numOutputCols; j++)
+                    m_sources[j] = (ElemType)((j / S) * m_subsample * S + j % S);
+                for (const auto& seq : inputLayout->GetAllSequences())
+                {
+                    if (seq.seqId == GAP_SEQUENCE_ID)
+                        continue;
+                    const ptrdiff_t tFirst = max(seq.tBegin, (ptrdiff_t) 0);
+                    const ptrdiff_t tLast = (ptrdiff_t) min(seq.tEnd, (size_t) T) - 1;
+                    const ptrdiff_t sub = (ptrdiff_t) m_subsample;
+                    for (ptrdiff_t t = ((tFirst + sub - 1) / sub) * sub; t <= tLast; t += sub)
+                    {
+                        const ptrdiff_t tSource = min(max(t + TapOffset(k), tFirst), tLast);
+                        m_sources[(t / sub) * S + seq.s] = (ElemType)(tSource * S + seq.s);
+                    }
+                }
+                EnsureBuffer(m_taps[k].sources)->SetValue(1, numOutputCols, m_deviceId, m_sources.data(), matrixFlagNormal);
+            }
+            return;
+        }
+
+        for (size_t k = 0; k < m_kernelWidth; k++)
+        {
+            const ptrdiff_t d = TapOffset(k);
+            m_sources.clear();
+            m_targets.clear();
+            m_sources2.clear();
+            m_targets2.clear();
+            if (d != 0)
+            {
+                for (const auto& seq : inputLayout->GetAllSequences())
+                {
+                    if (seq.seqId == GAP_SEQUENCE_ID)
+                        continue;
+                    const ptrdiff_t tFirst = max(seq.tBegin, (ptrdiff_t) 0);
+                    const ptrdiff_t tLast = (ptrdiff_t) min(seq.tEnd, (size_t) T) - 1;
+                    // the frames whose tap lies outside [tFirst, tLast]
+                    const ptrdiff_t tBegin = d > 0 ? max(tLast - d + 1, tFirst) : tFirst;
+                    const ptrdiff_t tEnd = d > 0 ? tLast + 1 : min(tFirst - d, tLast + 1);
+                    for (ptrdiff_t t = tBegin; t < tEnd; t++)
+                    {
+                        const ptrdiff_t target = t * S + seq.s;
+                        m_sources.push_back((ElemType)(min(max(t + d, tFirst), tLast) * S + seq.s));
+                        m_targets.push_back((ElemType) target);
+                        if (t + d >= 0 && t + d < T)
+                        {
+                            m_sources2.push_back((ElemType)((t + d) * S + seq.s));
+                            m_targets2.push_back((ElemType) target);
+                        }
+                    }
+                }
+            }
+            SetColumnMap(m_taps[k].boundaryAdd, m_sources, m_targets);
+            SetColumnMap(m_taps[k].boundarySubtract, m_sources2, m_targets2);
+        }
+    }
+
+    size_t m_kernelWidth;
+    size_t m_dilation;
+    size_t m_subsample;
+    MBLayoutPtr m_subsampledLayout; // (m_subsample > 1) the output's
+
+    std::vector<Tap> m_taps; // [k] the input columns of tap k, for this minibatch
+    std::vector<ElemType> m_sources, m_targets, m_sources2, m_targets2; // (CPU-side buffers for them)
+    shared_ptr<Matrix<ElemType>> m_gathered;         // input columns of a tap
+    shared_ptr<Matrix<ElemType>> m_gatheredGradient; // output gradient columns of a tap's boundary correction
+    shared_ptr<Matrix<ElemType>> m_product;
+};
+
+template class TimeDelayNode<float>;
+template class TimeDelayNode<double>;
+
 } } }
@@ -56,7 +56,13 @@ public:
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(Input(0)->GetMBLayout());
-        Input(0)->ValueFor(fr).VectorMax(*m_maxIndexes0, *m_maxValues, true);
+        // the label classes: given as indices, or taken from sparse or dense one-hot labels
+        if (Input(0)->Value().GetMatrixType() == SPARSE)
+            m_maxIndexes0->AssignOneHotIndicesOf(Input(0)->ValueFor(fr));
+        else if (HasIndexLabels())
+            m_maxIndexes0->SetValue(Input(0)->ValueFor(fr));
+        else
+            Input(0)->ValueFor(fr).VectorMax(*m_maxIndexes0, *m_maxValues, true);
         Input(1)->ValueFor(fr).VectorMax(*m_maxIndexes1, *m_maxValues, true, m_topK);
         MaskMissingColumnsToZero(*m_maxIndexes0, Input(0)->GetMBLayout(), fr);
         MaskMissingColumnsToZero(*m_maxIndexes1, Input(1)->GetMBLayout(), fr);
@@ -71,7 +77,7 @@ public:
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
-        ValidateBinaryReduce(isFinalValidationPass);
+        ValidateBinaryReduce(isFinalValidationPass, /*allowIndexLabels=*/true);
 
         m_topK = 1;
         // TODO: Make topK a constructor parameter
@@ -133,8 +139,6 @@ private:
 template class ErrorPredictionNode<float>;
 template class ErrorPredictionNode<double>;
 
-#ifdef COMING_SOON
-
 // -----------------------------------------------------------------------
 // SequenceDecoderNode (label, position_dependent_score, transition_score)
 // Decoder that matches CRF training.
@@ -143,6 +147,7 @@ template class ErrorPredictionNode<double>;
 //    in the R-CRF case, it is the RNN output score before softmax
 //  - transition score : score from the transition node,
 //    in the R-CRF case, it is the transition probability between labels
+// All parallel sequences of the minibatch are decoded in one call on the device of the inputs (see Matrix::ViterbiDecode()).
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -159,10 +164,8 @@ private:
     // TODO: member variables go to the end
     Matrix<ElemType> mAlpha;
     Matrix<ElemType> mBacktrace;
-
-    int mStartLab; // the starting output label
-    int mEndLab;   // the ending output label, if avaliable
-    ElemType m_default_activity;
+    Matrix<ElemType> mSequences; // (parallel sequence, first, end time step) of every sequence in the minibatch
+    std::vector<ElemType> mSequencesBuffer;
 
 public:
     DeclareConstructorFromConfigWithNumInputs(SequenceDecoderNode);
@@ -170,38 +173,10 @@ public:
         : Base(deviceId, name),
           mAlpha(deviceId),
           mBacktrace(deviceId),
-          mStartLab(-1),
-          mEndLab(-1)
+          mSequences(deviceId)
     {
     }
 
-    static void DecideStartEndingOutputLab(const Matrix<ElemType>& lbls, int& stt, int& stp)
-    {
-        if (stt != -1 && stp != -1)
-            return; // have computed before
-
-        int iNumPos = lbls.GetNumCols();
-
-        int firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        int lastLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, iNumPos - 1) != 0)
-            {
-                lastLbl = ik;
-                break;
-            }
-
-        stt = firstLbl;
-        stp = lastLbl;
-    };
-
     virtual void BackpropToNonLooping(size_t /*inputIndex*/) override // scaled by 2*number of elements in the Matrix<ElemType>
     {
         LogicError("SequenceDecoder is used for evaluation only.");
@@ -216,125 +191,35 @@ public:
         return false;
     }
 
-    // compute posterior probability of label y at position t
+    // best label path of every sequence, as one-hot columns
+    // We need to feed in pseudo label data, which tells the decoder what is the beginning
+    // and ending output symbol of a sequence. These symbols will constrain the search space.
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
-        DecideStartEndingOutputLab(Input(0)->Value(), mStartLab, mEndLab);
-        ForwardPropS(mAlpha, mBacktrace, Value(), Input(1)->Value(),
-                     Input(2)->Value(), mStartLab, mEndLab);
+        FrameRange fr(Input(0)->GetMBLayout());
+        GetSequenceBoundsAsMatrix(Input(0)->GetMBLayout(), mSequences, mSequencesBuffer);
+        Matrix<ElemType>::ViterbiDecode(Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), Input(2)->ValueAsMatrix(),
+                                        mAlpha, mBacktrace, Value(), mSequences, Input(0)->GetNumParallelSequences());
     }
 
-    // compute forward backward algorithm
-    void ForwardPropS(Matrix<ElemType>& alpha, Matrix<ElemType>& backtrace, Matrix<ElemType>& functionValues, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, const size_t stt, const size_t stp)
-    {
-        // to-do, each slice is for one sentence
-        // to-do, number of slices correspond to number of frames
-        // this implementation only supports one sentence per minibatch
-
-        // change to other values so can support multiple sentences in each minibatch
-        ForwardCompute(alpha, backtrace, pos_scores, pair_scores, stt);
-        BackwardCompute(functionValues, backtrace, stp);
-    };
-
-    // compute forward backward algorithm
-    static void ForwardCompute(Matrix<ElemType>& alpha,
-                               Matrix<ElemType>& backtrace,
-                               const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
-                               const size_t stt)
-    {
-        // to-do, shift more than 1 to support muliple sentences per minibatch
-        int iNumPos = pos_scores.GetNumCols();
-        int iNumLab = pos_scores.GetNumRows();
-        size_t iTmp = 0;
-
-        // need to have
-        alpha.Resize(iNumLab, iNumPos);
-        backtrace.Resize(iNumLab, iNumPos);
-
-        for (int t = 0; t < iNumPos; t++)
-        {
-            for (int k = 0; k < iNumLab; k++)
-            {
-                ElemType fTmp = (ElemType) LZERO;
-                if (t > 1)
-                {
-                    for (int j = 0; j < iNumLab; j++)
-                    {
-                        ElemType fAlpha = alpha(j, t - 1) + pair_scores(k, j);
-                        if (fAlpha > fTmp)
-                        {
-                            fTmp = fAlpha;
-                            iTmp = j;
-                        }
-                    }
-                    fTmp += pos_scores(k, t); // include position dependent score
-                }
-                else
-                {
-                    // with constrain that the first word is labeled as a given symbol
-                    iTmp = stt;
-                    fTmp = 0;
-                    if (t == 1)
-                    {
-                        fTmp = alpha(iTmp, t - 1);
-                        fTmp += pair_scores(k, iTmp);
-                        fTmp += pos_scores(k, t);
-                    }
-                    else
-                    {
-                        fTmp = (k == stt) ? pos_scores(k, t) : (ElemType) LZERO;
-                    }
-                }
-                alpha(k, t) = fTmp;
-                backtrace(k, t) = (ElemType) iTmp;
-            }
-        }
-    };
-
-    // compute backward algorithm
-    static void BackwardCompute(
-        Matrix<ElemType>& decodedpath,
-        const Matrix<ElemType>& backtrace, const size_t stp)
-    {
-        int iNumPos = backtrace.GetNumCols();
-        int iNumLab = backtrace.GetNumRows();
-
-        decodedpath.Resize(iNumLab, iNumPos);
-        decodedpath.SetValue(0);
-
-        size_t lastlbl = stp;
-        decodedpath(lastlbl, iNumPos - 1) = 1;
-
-        for (int t = iNumPos - 1; t > 0; t--)
-        {
-            lastlbl = (size_t) backtrace(lastlbl, t);
-            decodedpath(lastlbl, t - 1) = 1;
-        }
-    };
-
-    // need to feed in pseudo label data, which tells the decoder what is the beginning
-    // and ending output symbol. these symbols will constrain the search space
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
         InferMBLayoutFromInputsForStandardCase();
 
         if (isFinalValidationPass)
-            if (!(Input(1)->GetSampleMatrixNumRows() == Input(2)->GetSampleMatrixNumRows() && // position dependent and pair scores have same number of labels
+            if (!(Input(1)->GetSampleMatrixNumRows() == Input(2)->GetAsMatrixNumRows() && // position dependent and pair scores have same number of labels
                   Input(0)->GetSampleMatrixNumRows() == Input(1)->GetSampleMatrixNumRows() &&
-                  Input(0)->GetSampleMatrixNumCols() == Input(1)->GetSampleMatrixNumCols() && // position dependent and pair scores have the same observation numbers
-                  Input(2)->GetSampleMatrixNumCols() == Input(2)->GetSampleMatrixNumRows()))
+                  Input(0)->HasMBLayout() && Input(0)->GetMBLayout() == Input(1)->GetMBLayout() &&
+                  Input(2)->GetAsMatrixNumCols() == Input(2)->GetAsMatrixNumRows()))
             {
                 LogicError("The Matrix<ElemType>  dimension in the SequenceDecoderNode operation does not match.");
             }
-        // BUGBUG: No SetDims()?
-        m_sampleLayout = TensorShape();
+        SetDims(Input(1));
     }
 };
 
 template class SequenceDecoderNode<float>;
 template class SequenceDecoderNode<double>;
 
-#endif
-
 } } }
@@ -427,6 +427,10 @@ public:
             Matrix<ElemType> sliceInput1Value = Input(1)->MaskedValueFor(t);
             Matrix<ElemType> sliceOutputGrad = MaskedGradientFor(t);
 
+            // with sparse input, only the columns of words in the minibatch get a gradient (see AllocateGradientMatricesForInputs())
+            if (sliceInput1Value.GetMatrixType() == SPARSE && Input(0)->Gradient().GetMatrixType() == DENSE && sliceOutputGrad.GetMatrixType() == DENSE)
+                Input(0)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+
             BackpropToLeft(sliceInput1Value, Input(0)->GradientAsMatrix(), sliceOutputGrad);
         }
         else if (inputIndex == 1) // right derivative (input)
@@ -505,6 +509,19 @@ public:
         SetDims(TensorShape(Input(0)->GetAsMatrixNumRows() * wordsInEachSample), true);
     }
 
+    virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        // The embedding gradient is sparse (one block per word in the minibatch) if the input is, so it is not pooled.
+        // Gradient aggregation and the parameter update then only touch those columns.
+        if (Input(0)->NeedGradient() && Input(1)->Value().GetMatrixType() == SPARSE)
+        {
+            Input(0)->CreateGradientMatrixIfNull();
+            Input(0)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+        }
+
+        Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+
     bool UnitTest()
     {
         try
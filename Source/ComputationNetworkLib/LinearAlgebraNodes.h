@@ -9,6 +9,7 @@
 #include "ConvolutionalNodes.h"
 #include "Matrix.h"
 #include "TensorView.h"
+#include "Int8WeightMatrix.h"
 
 #include <unordered_set>
 #include <map>
@@ -46,6 +47,8 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (inputIndex == 0 && m_gradientIsInputView) // (our gradient is the input's already)
+            return;
         size_t rank = DetermineElementwiseTensorRank();
         auto gradient = GradientTensorFor(rank, fr);
         auto inputGradient = Input(inputIndex)->GradientTensorFor(rank, fr.AllowBroadcast());
@@ -54,7 +57,22 @@ public:
         if (Input(inputIndex)->ReducesInTimeWrt(shared_from_this()))
             MaskMissingGradientColumnsToZero(fr);
 
-        inputGradient.AddCopyOf(gradient);
+        inputGradient.DoCopyOf(InputGradientBeta(), gradient, 1);
+    }
+
+    virtual bool CanOverwriteInputGradient(size_t /*inputIndex*/) const override
+    {
+        return true;
+    }
+
+    // in place over the first summand if that is not broadcast; its gradient is then ours as it is
+    virtual bool CanComputeInPlace() const override
+    {
+        return Input(0)->GetSampleLayout() == GetSampleLayout() && Input(0)->GetMBLayout() == GetMBLayout();
+    }
+    virtual bool CanShareGradientWithInput() const override
+    {
+        return true;
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
@@ -66,6 +84,12 @@ public:
         auto input1 = Input(1)->ValueTensorFor(rank, fr.AllowBroadcast());
         result.AssignSumOf(input0, input1);
     }
+
+    virtual bool GetElementWiseForwardOp(ElementWiseOperator& op) const override
+    {
+        op = ElementWiseOperator::opSum;
+        return true;
+    }
 };
 
 template class PlusNode<float>;
@@ -94,6 +118,8 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (inputIndex == 0 && m_gradientIsInputView) // (our gradient is the input's already)
+            return;
         ElemType sign = inputIndex == 0 ? 1.0f : -1.0f;
         size_t rank = DetermineElementwiseTensorRank();
         auto gradient = GradientTensorFor(rank, fr);
@@ -103,7 +129,22 @@ public:
         if (Input(inputIndex)->ReducesInTimeWrt(shared_from_this()))
             MaskMissingGradientColumnsToZero(fr);
 
-        inputGradient.AddCopyOf(gradient, sign);
+        inputGradient.DoCopyOf(InputGradientBeta(), gradient, sign);
+    }
+
+    virtual bool CanOverwriteInputGradient(size_t /*inputIndex*/) const override
+    {
+        return true;
+    }
+
+    // in place over the minuend if that is not broadcast; its gradient is then ours as it is
+    virtual bool CanComputeInPlace() const override
+    {
+        return Input(0)->GetSampleLayout() == GetSampleLayout() && Input(0)->GetMBLayout() == GetMBLayout();
+    }
+    virtual bool CanShareGradientWithInput() const override
+    {
+        return true;
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
@@ -114,6 +155,12 @@ public:
         auto input1 = Input(1)->ValueTensorFor(rank, fr.AllowBroadcast());
         result.AssignDifferenceOf(input0, input1);
     }
+
+    virtual bool GetElementWiseForwardOp(ElementWiseOperator& op) const override
+    {
+        op = ElementWiseOperator::opDifference;
+        return true;
+    }
 };
 
 template class MinusNode<float>;
@@ -189,12 +236,73 @@ class TimesNodeBase : public ComputationNode<ElemType>, public NumInputs<2>
 
 public:
     TimesNodeBase(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name)
+        : Base(deviceId, name), m_calibratingQuantization(false), m_calibratedInputMaxAbs(0), m_compacted(false)
+    {
+    }
+
+    // inference only: from now on compute W * X with an INT8 copy of the weights W=Input(0), on the CPU
+    // Later changes to the weights are not seen. Returns false if not applicable (transposed, or not a dense CPU LearnableParameter).
+    bool QuantizeWeights()
+    {
+        const auto& weights = Input(0)->ValueAsMatrix();
+        if (m_transpose || Input(0)->OperationName() != L"LearnableParameter" || weights.GetMatrixType() != DENSE || weights.GetDeviceId() != CPUDEVICE || weights.IsEmpty())
+            return false;
+        m_quantizedWeights = make_shared<Int8WeightMatrix<ElemType>>(weights.BufferPointer(), weights.GetNumRows(), weights.GetNumCols());
+        return true;
+    }
+
+    // inference only: from now on compute W * X with a block-sparse row (BSR) copy of the weights W=Input(0), on the device of W,
+    // if at least minZeroBlockFraction of its blockDim x blockDim blocks are all zero, as in a block-pruned model. Later changes to the weights are not seen.
+    // Returns false if not applicable (transposed, not a dense LearnableParameter, or not sparse enough).
+    bool ConvertWeightsToBlockSparse(size_t blockDim, double minZeroBlockFraction)
+    {
+        const auto& weights = Input(0)->ValueAsMatrix();
+        if (m_transpose || Input(0)->OperationName() != L"LearnableParameter" || weights.GetMatrixType() != DENSE || weights.IsEmpty())
+            return false;
+        auto blockSparseWeights = make_shared<Matrix<ElemType>>(weights.GetNumRows(), weights.GetNumCols(), weights.GetDeviceId(), SPARSE, matrixFormatSparseBSR);
+        blockSparseWeights->SetBlockSparseRowValue(weights, blockDim);
+        const size_t numBlocks = ((weights.GetNumRows() + blockDim - 1) / blockDim) * ((weights.GetNumCols() + blockDim - 1) / blockDim);
+        const size_t numNonZeroBlocks = blockSparseWeights->NzCount() / (blockDim * blockDim);
+        if (numBlocks - numNonZeroBlocks < minZeroBlockFraction * numBlocks)
+            return false;
+        m_blockSparseWeights = blockSparseWeights;
+        return true;
+    }
+
+    // while on, products are computed in full precision and the range of the right operand is recorded; turning it off fixes the INT8 input range to it
+    void SetQuantizationCalibration(bool on)
     {
+        if (!on && m_calibratingQuantization && m_quantizedWeights)
+            m_quantizedWeights->SetInputMaxAbs(m_calibratedInputMaxAbs);
+        m_calibratingQuantization = on;
     }
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (m_compacted && fr.IsAllFrames() && Gradient().GetMatrixType() == DENSE)
+        {
+            // as in ForwardProp(), multiply only the columns that are not gaps
+            m_compactGradient->AssignRowStackedColumnsOf(GradientAsMatrix(), *m_compactColumns);
+            if (inputIndex == 0 && Input(0)->Gradient().GetMatrixType() == DENSE)
+            {
+                auto& input0Grad = Input(0)->GradientAsMatrix();
+                bool transpose = m_transpose; // (assigning to a non-const variable avoids a compiler warning C4127: conditional expression is constant)
+                if (!transpose)
+                    Matrix<ElemType>::MultiplyAndWeightedAdd(1, *m_compactGradient, false, *m_compactInput, true, InputGradientBeta(), input0Grad);
+                else
+                    Matrix<ElemType>::MultiplyAndWeightedAdd(1, *m_compactInput, false, *m_compactGradient, true, InputGradientBeta(), input0Grad);
+                return;
+            }
+            if (inputIndex == 1 && Input(1)->Gradient().GetMatrixType() == DENSE)
+            {
+                m_compactOutput->AssignProductOf(Input(0)->ValueAsMatrix(), !m_transpose, *m_compactGradient, false);
+                if (InputGradientBeta() == 0) // (the gaps are not written below)
+                    Input(1)->GradientAsMatrix().SetValue(0);
+                Input(1)->GradientAsMatrix().AddFromRowStackedColumnsOf(*m_compactOutput, *m_compactColumns);
+                return;
+            }
+        }
+
         if (inputIndex == 0) // left derivative
         {
             // this potentially computes inner products over time, so we use the Masked- variants
@@ -208,19 +316,25 @@ public:
 
             bool transpose = m_transpose; // (assigning to a non-const variable avoids a compiler warning C4127: conditional expression is constant)
             if (!transpose)
-                Matrix<ElemType>::MultiplyAndAdd(sliceOutputGrad, false, sliceInput1Value, true, input0Grad);
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, sliceOutputGrad, false, sliceInput1Value, true, InputGradientBeta(), input0Grad);
             else
-                Matrix<ElemType>::MultiplyAndAdd(sliceInput1Value, false, sliceOutputGrad, true, input0Grad);
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, sliceInput1Value, false, sliceOutputGrad, true, InputGradientBeta(), input0Grad);
         }
         else // right derivative
         {
             auto sliceInput1Grad = Input(1)->GradientFor(fr);
             auto sliceOutputGrad = GradientFor(fr);
 
-            Matrix<ElemType>::MultiplyAndAdd(Input(0)->ValueAsMatrix(), !m_transpose, sliceOutputGrad, false, sliceInput1Grad);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, Input(0)->ValueAsMatrix(), !m_transpose, sliceOutputGrad, false, InputGradientBeta(), sliceInput1Grad);
         }
     }
 
+    // (not into a sparse gradient, which the product with a sparse input1 makes of the weight gradient)
+    virtual bool CanOverwriteInputGradient(size_t inputIndex) const override
+    {
+        return Input(inputIndex)->Gradient().GetMatrixType() == DENSE && (inputIndex == 1 || Input(1)->Value().GetMatrixType() == DENSE);
+    }
+
     virtual bool OutputUsedInComputingInputNodesGradients() const override
     {
         // The TimesNode does not require its output value for computing
@@ -228,6 +342,12 @@ public:
         return false;
     }
 
+    // one multiply-add per weight element and output column
+    virtual double GetForwardFlopsEstimate() const override
+    {
+        return 2.0 * Input(0)->GetSampleMatrixNumRows() * Input(0)->GetSampleMatrixNumCols() * GetSampleMatrixNumCols();
+    }
+
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
         // right operand and output can have MB layout, while left operand cannot
@@ -236,6 +356,31 @@ public:
 #if DUMPOUTPUT
         Input(0)->ValueAsMatrix().Print("TimesNode - Input0");
 #endif
+        if (m_quantizedWeights && sliceInput1Value.GetMatrixType() == DENSE && sliceInput1Value.GetDeviceId() == CPUDEVICE &&
+            sliceInput1Value.GetNumRows() == m_quantizedWeights->GetNumCols() && sliceOutputValue.GetDeviceId() == CPUDEVICE)
+        {
+            if (!m_calibratingQuantization)
+            {
+                m_quantizedWeights->Multiply(sliceInput1Value.BufferPointer(), sliceInput1Value.GetNumCols(), sliceOutputValue.BufferPointer());
+                return;
+            }
+            m_calibratedInputMaxAbs = max(m_calibratedInputMaxAbs, sliceInput1Value.MatrixNormInf());
+        }
+        if (m_blockSparseWeights && sliceInput1Value.GetMatrixType() == DENSE && sliceOutputValue.GetMatrixType() == DENSE)
+        {
+            sliceOutputValue.AssignProductOf(*m_blockSparseWeights, false, sliceInput1Value, false);
+            return;
+        }
+        m_compacted = fr.IsAllFrames() && sliceInput1Value.GetMatrixType() == DENSE && sliceOutputValue.GetMatrixType() == DENSE && DetermineCompactColumns();
+        if (m_compacted)
+        {
+            // multiply only the columns that are not gaps, and leave the gaps 0
+            m_compactInput->AssignRowStackedColumnsOf(sliceInput1Value, *m_compactColumns);
+            m_compactOutput->AssignProductOf(Input(0)->ValueAsMatrix(), m_transpose, *m_compactInput, false);
+            sliceOutputValue.SetValue(0);
+            sliceOutputValue.AddFromRowStackedColumnsOf(*m_compactOutput, *m_compactColumns);
+            return;
+        }
         // BUGBUG: This uses correct Matrix dimensions when multiplying with a non-minibatch only by luck. To be fixed when we allow to apply TimesNode to a subset of tensor dimensions.
         sliceOutputValue.AssignProductOf(Input(0)->ValueAsMatrix(), m_transpose, sliceInput1Value, false);
 #if NANCHECK
@@ -300,6 +445,60 @@ public:
         // so that the default allocator will not allocate it again.
         Base::AllocateGradientMatricesForInputs(matrixPool);
     }
+
+private:
+    // Padded minibatches (parallel sequences of different lengths) can have many gap columns.
+    // If they are a sizable fraction, the products are computed on the valid columns only: these are gathered into
+    // a dense matrix, and the result is scattered back. Returns false if that is not worth it.
+    bool DetermineCompactColumns()
+    {
+        const double minGapFraction = 0.1; // gathering and scattering cost about as much as a product with a 10-row matrix
+        if (!HasMBLayout() || !m_pMBLayout->HasGaps())
+            return false;
+        const size_t numCols = m_pMBLayout->GetNumCols();
+        if (numCols - m_pMBLayout->GetActualNumSamples() < minGapFraction * numCols)
+            return false;
+
+        const size_t S = m_pMBLayout->GetNumParallelSequences();
+        const size_t T = m_pMBLayout->GetNumTimeSteps();
+        m_compactColumnsBuffer.clear();
+        for (const auto& seq : m_pMBLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            for (size_t t = (size_t) max(seq.tBegin, (ptrdiff_t) 0); t < min(seq.tEnd, T); t++)
+                m_compactColumnsBuffer.push_back((ElemType)(t * S + seq.s));
+        }
+        if (m_compactColumnsBuffer.empty())
+            return false;
+        std::sort(m_compactColumnsBuffer.begin(), m_compactColumnsBuffer.end());
+
+        if (!m_compactColumns)
+        {
+            m_compactColumns = make_shared<Matrix<ElemType>>(m_deviceId);
+            m_compactInput = make_shared<Matrix<ElemType>>(m_deviceId);
+            m_compactOutput = make_shared<Matrix<ElemType>>(m_deviceId);
+            m_compactGradient = make_shared<Matrix<ElemType>>(m_deviceId);
+        }
+        m_compactColumns->SetValue(1, m_compactColumnsBuffer.size(), m_deviceId, m_compactColumnsBuffer.data(), matrixFlagNormal);
+        return true;
+    }
+
+    // INT8 inference (not serialized)
+    shared_ptr<Int8WeightMatrix<ElemType>> m_quantizedWeights;
+    bool m_calibratingQuantization;
+    ElemType m_calibratedInputMaxAbs; // max |Input(1)| seen during calibration
+
+    // block-sparse inference (not serialized)
+    shared_ptr<Matrix<ElemType>> m_blockSparseWeights;
+
+    // gap compaction of the last ForwardProp()
+    bool m_compacted;
+    std::vector<ElemType> m_compactColumnsBuffer;  // [j] minibatch column of compact column j
+    shared_ptr<Matrix<ElemType>> m_compactColumns; // the same on the device
+    shared_ptr<Matrix<ElemType>> m_compactInput;   // the valid columns of Input(1), kept for the gradient of Input(0)
+    shared_ptr<Matrix<ElemType>> m_compactOutput;
+    shared_ptr<Matrix<ElemType>> m_compactGradient;
 };
 
 // -----------------------------------------------------------------------
@@ -354,6 +553,253 @@ public:
 template class TransposeTimesNode<float>;
 template class TransposeTimesNode<double>;
 
+// -----------------------------------------------------------------------
+// TensorContractionNode (A, B) -- general tensor product, einsum-style, e.g. spec = "ik,kj->ij" is Times(A, B)
+// The spec names the sample axes of A, B, and the result with one letter each (axis 0 first). Axes of both inputs
+// that the result does not have are summed over. The minibatch axes of an input with an MBLayout come on top of
+// those and go to the result: with a weight A, "ihk,hk->ih" applies a [I x H x K] weight to each head h of every
+// frame, and with two minibatch inputs, "kiq,kjq->ijq" gives per-frame products, such as attention scores, without
+// reshapes or transposes. The products run as (batched) GEMMs where the strides allow (see TensorView::DoContractionOf()).
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class TensorContractionNode : public ComputationNode<ElemType>, public NumInputs<2>
+{
+    typedef ComputationNode<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"TensorContraction";
+    }
+
+public:
+    TensorContractionNode(DEVICEID_TYPE deviceId, const wstring& name, const wstring& spec = L"")
+        : Base(deviceId, name), m_spec(spec)
+    {
+    }
+    TensorContractionNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : TensorContractionNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"spec"))
+    {
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<TensorContractionNode<ElemType>>(nodeP);
+            node->m_spec = m_spec;
+        }
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_spec;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_spec;
+    }
+
+    virtual void PrintSelfBeforeValidation() const override
+    {
+        Base::PrintSelfBeforeValidation();
+        fprintf(stderr, ", spec=%ls", m_spec.c_str());
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase();
+
+        // the labels of the sample axes, then those of the minibatch axes
+        const string spec = msra::strfun::utf8(m_spec);
+        const size_t comma = spec.find(',');
+        const size_t arrow = spec.find("->");
+        if (comma == string::npos || arrow == string::npos || comma > arrow)
+            InvalidArgument("%ls %ls operation: Invalid spec '%s', expected e.g. 'ik,kj->ij'.", NodeName().c_str(), OperationName().c_str(), spec.c_str());
+        for (char label : spec.substr(0, comma) + spec.substr(comma + 1, arrow - comma - 1) + spec.substr(arrow + 2))
+            if (!isalpha((unsigned char) label))
+                InvalidArgument("%ls %ls operation: The axes in '%s' must be labeled with letters.", NodeName().c_str(), OperationName().c_str(), spec.c_str());
+        m_labels[0] = spec.substr(0, comma);
+        m_labels[1] = spec.substr(comma + 1, arrow - comma - 1);
+        m_labels[2] = spec.substr(arrow + 2);
+        m_sampleRanks[0] = m_labels[0].size();
+        m_sampleRanks[1] = m_labels[1].size();
+        for (size_t i = 0; i < 2; i++)
+        {
+            if (Input(i)->GetSampleLayout().GetRank() > m_sampleRanks[i])
+                InvalidArgument("%ls %ls operation: Input %d [%s] has more axes than '%s' names for it.", NodeName().c_str(), OperationName().c_str(), (int) i, string(Input(i)->GetSampleLayout()).c_str(), spec.c_str());
+            if (Input(i)->HasMBLayout())
+                m_labels[i] += minibatchLabels;
+        }
+        m_sampleRanks[2] = m_labels[2].size();
+        if (HasMBLayout())
+            m_labels[2] += minibatchLabels;
+
+        SmallVector<size_t> dims;
+        for (size_t k = 0; k < m_sampleRanks[2]; k++)
+        {
+            const char label = m_labels[2][k];
+            const size_t i = m_labels[0].find(label) != string::npos ? 0 : 1;
+            if (m_labels[i].find(label) == string::npos)
+                InvalidArgument("%ls %ls operation: Output axis '%c' is not an axis of the inputs in '%s'.", NodeName().c_str(), OperationName().c_str(), label, spec.c_str());
+            dims.push_back(Input(i)->GetSampleLayout().GetDimPadded(m_labels[i].find(label)));
+        }
+        if (isFinalValidationPass)
+        {
+            for (char label : m_labels[0].substr(0, m_sampleRanks[0]))
+            {
+                const size_t k = m_labels[1].find(label);
+                if (k != string::npos && Input(1)->GetSampleLayout().GetDimPadded(k) != Input(0)->GetSampleLayout().GetDimPadded(m_labels[0].find(label)))
+                    InvalidArgument("%ls %ls operation: Axis '%c' of '%s' has different dimensions in %s and %s.", NodeName().c_str(), OperationName().c_str(),
+                                    label, spec.c_str(), string(Input(0)->GetSampleLayout()).c_str(), string(Input(1)->GetSampleLayout()).c_str());
+            }
+        }
+        SetDims(TensorShape(dims), HasMBLayout());
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        auto result = ValueTensorFor(m_sampleRanks[2], fr);
+        auto input0 = Input(0)->ValueTensorFor(m_sampleRanks[0], fr.AllowBroadcast());
+        auto input1 = Input(1)->ValueTensorFor(m_sampleRanks[1], fr.AllowBroadcast());
+        result.AssignContractionOf(input0, input1, m_labels[0] + "," + m_labels[1] + "->" + m_labels[2]);
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        // dA = dC B^T and dB = A^T dC, as contractions of the output gradient with the other input
+        const size_t otherIndex = 1 - inputIndex;
+        if (Input(inputIndex)->ReducesInTimeWrt(shared_from_this()))
+            MaskMissingGradientColumnsToZero(fr);
+        if (Input(inputIndex)->ReducesInTimeWrt(Input(otherIndex)))
+            Input(otherIndex)->MaskMissingValueColumnsToZero(fr);
+        auto gradient = GradientTensorFor(m_sampleRanks[2], fr);
+        auto inputGradient = Input(inputIndex)->GradientTensorFor(m_sampleRanks[inputIndex], fr.AllowBroadcast());
+        auto otherInputValue = Input(otherIndex)->ValueTensorFor(m_sampleRanks[otherIndex], fr.AllowBroadcast());
+        inputGradient.DoContractionOf(InputGradientBeta(), gradient, otherInputValue, 1, m_labels[2] + "," + m_labels[otherIndex] + "->" + m_labels[inputIndex]);
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return false;
+    }
+
+private:
+    static const char* const minibatchLabels;
+
+    wstring m_spec;
+    string m_labels[3];      // [operand] the axes of A, B, and the result, including the minibatch axes
+    size_t m_sampleRanks[3]; // [operand] the number of sample axes in the spec
+};
+
+template <class ElemType>
+const char* const TensorContractionNode<ElemType>::minibatchLabels = "01"; // (of the [parallel sequences x time steps] axes)
+
+template class TensorContractionNode<float>;
+template class TensorContractionNode<double>;
+
+// -----------------------------------------------------------------------
+// AffineActivationNode (W, x, b) -- act(W * x + b), for inference only
+// Created by ComputationNetwork::OptimizeForInference() from Times, Plus and an optional nonlinearity, so that the
+// bias and the nonlinearity are applied to the product in place instead of each in a pass over its own output.
+// m_activation is empty (none) or the operation name of the nonlinearity (Sigmoid, Tanh, RectifiedLinear).
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class AffineActivationNode : public ComputationNode<ElemType>, public NumInputs<3>
+{
+    typedef ComputationNode<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"AffineActivation";
+    }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(AffineActivationNode);
+    AffineActivationNode(DEVICEID_TYPE deviceId, const wstring& name, const wstring& activation = L"")
+        : Base(deviceId, name), m_activation(activation)
+    {
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_activation;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_activation;
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<AffineActivationNode<ElemType>>(nodeP);
+            node->m_activation = m_activation;
+        }
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t /*inputIndex*/, const FrameRange& /*fr*/) override
+    {
+        LogicError("%ls %ls operation is for inference only and cannot compute gradients.", NodeName().c_str(), OperationName().c_str());
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        auto sliceOutputValue = ValueFor(fr);
+        sliceOutputValue.AssignProductOf(Input(0)->ValueAsMatrix(), false, Input(1)->ValueFor(fr), false);
+        Matrix<ElemType>::ScaleAndAdd((ElemType) 1, Input(2)->ValueAsMatrix(), sliceOutputValue); // (adds the column vector to every column)
+        if (m_activation == L"Sigmoid")
+            sliceOutputValue.InplaceSigmoid();
+        else if (m_activation == L"Tanh")
+            sliceOutputValue.InplaceTanh();
+        else if (m_activation == L"RectifiedLinear")
+            sliceOutputValue.InplaceTruncateBottom(0);
+#if NANCHECK
+        sliceOutputValue.HasNan("AffineActivation");
+#endif
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        if (isFinalValidationPass && (Input(0)->HasMBLayout() || Input(2)->HasMBLayout()))
+            InvalidArgument("%ls AffineActivation operation requires the weights and the bias to not be minibatch data (must not have an MBLayout).", NodeName().c_str());
+        if (m_activation != L"" && m_activation != L"Sigmoid" && m_activation != L"Tanh" && m_activation != L"RectifiedLinear")
+            InvalidArgument("%ls AffineActivation operation: unknown activation '%ls'.", NodeName().c_str(), m_activation.c_str());
+        InferMBLayoutFromInputsForStandardCase();
+
+        const size_t rows0 = Input(0)->GetAsMatrixNumRows(), cols0 = Input(0)->GetAsMatrixNumCols();
+        SetDims(TensorShape(rows0), HasMBLayout());
+
+        if (isFinalValidationPass)
+        {
+            const size_t rows1 = Input(1)->HasMBLayout() ? Input(1)->GetSampleMatrixNumRows() : Input(1)->GetAsMatrixNumRows();
+            if (cols0 != rows1)
+                InvalidArgument("The inner matrix dimension in the %ls AffineActivation operation does not match (%d vs. %d).", NodeName().c_str(), (int) rows1, (int) cols0);
+            if (Input(2)->GetAsMatrixNumRows() != rows0 || Input(2)->GetAsMatrixNumCols() != 1)
+                InvalidArgument("The bias of the %ls AffineActivation operation must be a column vector of dimension %d.", NodeName().c_str(), (int) rows0);
+        }
+    }
+
+private:
+    wstring m_activation;
+};
+
+template class AffineActivationNode<float>;
+template class AffineActivationNode<double>;
+
 // -----------------------------------------------------------------------
 // ElementTimesNode (factor1, factor2)
 // This allows broadcasting, and can thus also scale with a row, a column, or a scalar.
@@ -389,7 +835,12 @@ public:
         if (Input(inputIndex)->ReducesInTimeWrt(Input(1 - inputIndex)))
             Input(1 - inputIndex)->MaskMissingValueColumnsToZero(fr);
 
-        inputGradient.AddElementwiseProductOf(gradient, otherInputValue);
+        inputGradient.DoElementwiseProductOf(InputGradientBeta(), gradient, otherInputValue, 1);
+    }
+
+    virtual bool CanOverwriteInputGradient(size_t /*inputIndex*/) const override
+    {
+        return true;
     }
 
     virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override
@@ -405,6 +856,12 @@ public:
         auto input1 = Input(1)->ValueTensorFor(rank, fr.AllowBroadcast());
         result.AssignElementwiseProductOf(input0, input1);
     }
+
+    virtual bool GetElementWiseForwardOp(ElementWiseOperator& op) const override
+    {
+        op = ElementWiseOperator::opElementwiseProduct;
+        return true;
+    }
 };
 
 template class ElementTimesNode<float>;
@@ -412,6 +869,8 @@ template class ElementTimesNode<double>;
 
 // -----------------------------------------------------------------------
 // DiagTimesNode (vector representing the diagonal of a square matrix, data)
+// This is a broadcasting ElementTimes with a column vector; the gradient of the diagonal is a reduction over the columns.
+// Both operate on the [rows x cols] matrix views, so that the data may have any sample layout, e.g. [W x H x C].
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -433,23 +892,39 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
-        if (inputIndex == 0) // left derivative
+        Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
+        auto gradient = TensorView<ElemType>(sliceOutputGrad, MatrixShape(sliceOutputGrad));
+
+        if (inputIndex == 0) // left derivative: reduce over the columns
         {
-            Matrix<ElemType> sliceOutputGrad = MaskedGradientFor(fr); // use Masked- version since this is reducing over frames
-            Matrix<ElemType> sliceInput1Value = Input(1)->MaskedValueFor(fr);
-            m_innerproduct->AssignInnerProductOf(sliceOutputGrad, sliceInput1Value, false);
-            Input(0)->GradientAsMatrix() += *m_innerproduct;
+            // the diagonal's gradient reduces over frames: mask the gaps
+            if (Input(0)->ReducesInTimeWrt(shared_from_this()))
+            {
+                MaskMissingGradientColumnsToZero(fr);
+                Input(1)->MaskMissingValueColumnsToZero(fr);
+            }
+
+            Matrix<ElemType>& diagonalGrad = Input(0)->GradientAsMatrix();
+            Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
+            auto inputGradient = TensorView<ElemType>(diagonalGrad, MatrixShape(diagonalGrad));
+            auto otherInputValue = TensorView<ElemType>(sliceInput1Value, MatrixShape(sliceInput1Value));
+            inputGradient.DoElementwiseProductOf(InputGradientBeta(), gradient, otherInputValue, 1);
         }
-        else // right derivative
+        else // right derivative: broadcast the diagonal over the columns
         {
-            Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
             Matrix<ElemType> sliceInput1Grad = Input(1)->GradientFor(fr);
-            m_rightGradient->SetValue(sliceOutputGrad);
-            m_rightGradient->ColumnElementMultiplyWith(Input(0)->ValueAsMatrix());
-            sliceInput1Grad += *m_rightGradient;
+            Matrix<ElemType>& diagonal = Input(0)->ValueAsMatrix();
+            auto inputGradient = TensorView<ElemType>(sliceInput1Grad, MatrixShape(sliceInput1Grad));
+            auto otherInputValue = TensorView<ElemType>(diagonal, MatrixShape(diagonal));
+            inputGradient.DoElementwiseProductOf(InputGradientBeta(), gradient, otherInputValue, 1);
         }
     }
 
+    virtual bool CanOverwriteInputGradient(size_t /*inputIndex*/) const override
+    {
+        return true;
+    }
+
     virtual bool OutputUsedInComputingInputNodesGradients() const override
     {
         // The DiagTimesNode does not require its output value for computing
@@ -459,11 +934,13 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
-        Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
-
-        sliceOutputValue.SetValue(sliceInput1Value);
-        sliceOutputValue.ColumnElementMultiplyWith(Input(0)->ValueAsMatrix());
+        Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
+        Matrix<ElemType>& diagonal = Input(0)->ValueAsMatrix();
+        auto result = TensorView<ElemType>(sliceOutputValue, MatrixShape(sliceOutputValue));
+        auto input0 = TensorView<ElemType>(diagonal, MatrixShape(diagonal)); // [rows0 x 1], broadcast over the columns
+        auto input1 = TensorView<ElemType>(sliceInput1Value, MatrixShape(sliceInput1Value));
+        result.AssignElementwiseProductOf(input0, input1);
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -503,35 +980,12 @@ public:
         SetDims(Input(1));
     }
 
-    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
-    {
-        Base::CopyTo(nodeP, newName, flags);
-        if (flags & CopyNodeFlags::copyNodeValue)
-        {
-            auto node = dynamic_pointer_cast<DiagTimesNode<ElemType>>(nodeP);
-            *node->m_innerproduct = *m_innerproduct;
-            *node->m_rightGradient = *m_rightGradient;
-        }
-    }
-    // request matrices that are needed for gradient computation
-    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
-    {
-        Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_innerproduct, matrixPool);
-        RequestMatrixFromPool(m_rightGradient, matrixPool);
-    }
-
-    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
-    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
+private:
+    // [rows x cols] view of a matrix, independent of the sample layout it holds
+    static TensorShape MatrixShape(const Matrix<ElemType>& m)
     {
-        Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_innerproduct, matrixPool);
-        ReleaseMatrixToPool(m_rightGradient, matrixPool);
+        return TensorShape(m.GetNumRows(), m.GetNumCols());
     }
-
-private:
-    shared_ptr<Matrix<ElemType>> m_innerproduct;
-    shared_ptr<Matrix<ElemType>> m_rightGradient;
 };
 
 template class DiagTimesNode<float>;
@@ -599,7 +1053,6 @@ template class SumElementsNode<double>;
 // SumColumnElementsNode (input)
 // sums up all elements in each column of the input, reducing each column to a scalar
 // TODO: This should be deprecated, in favor of a reduce node.
-// TODO: Implement this with the tensor library.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -621,10 +1074,10 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t /*inputIndex*/, const FrameRange& fr) override
     {
-        auto sliceInputGrad = Input(0)->GradientFor(fr);
-        auto sliceOutputGrad = GradientFor(fr);
-
-        sliceInputGrad += sliceOutputGrad; // here the assumption is that sliceOutputGrad is a row vector
+        size_t rank = DetermineElementwiseTensorRank();
+        auto gradient = GradientTensorFor(rank, fr);
+        auto inputGradient = Input(0)->GradientTensorFor(rank, fr);
+        inputGradient.AddCopyOf(gradient); // broadcasts each column's gradient over its elements
     }
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override
@@ -644,10 +1097,10 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
-        auto sliceInputValue = Input(0)->ValueFor(fr);
-        auto sliceOutputValue = ValueFor(fr); // row vector
-
-        Matrix<ElemType>::VectorSum(sliceInputValue, sliceOutputValue, true);
+        size_t rank = DetermineElementwiseTensorRank();
+        auto result = ValueTensorFor(rank, fr); // [1 x T]
+        auto input = Input(0)->ValueTensorFor(rank, fr);
+        result.AssignReductionOf(ElementWiseOperator::opSum, input); // reduces over all sample dimensions
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -662,10 +1115,9 @@ public:
 template class SumColumnElementsNode<float>;
 template class SumColumnElementsNode<double>;
 
-#ifdef COMING_SOON  // known bug in backprop; generalize to tensor
-
 // -----------------------------------------------------------------------
 // TransposeNode (input matrix)
+// Times(Transpose(A), B) gets compiled into TransposeTimes(A, B), see ComputationNetwork::FuseTransposesIntoTimes().
 // TODO: extend towards tensor transpose (swap 2 dimensions, incl. time)
 // -----------------------------------------------------------------------
 
@@ -695,13 +1147,10 @@ public:
         inputGradientValues.Print("child Gradient-in/out");
         inputFunctionValues.Print("child Function values");
 #endif
-        const Matrix<ElemType>& ones = ConstOnes(inputGradientValues.GetNumRows(), inputGradientValues.GetNumRows(), inputGradientValues.GetDeviceId());
-        // BUGBUG: This should be ^^ Identity(). This will be fixed once we switch to the more generic tensor Transpose operation, which can handle this easily.
-        Matrix<ElemType>::MultiplyAndAdd(ones, false, gradientValues, true, inputGradientValues);
+        Matrix<ElemType>::ScaleAndAdd(1, gradientValues.Transpose(), inputGradientValues); // inputGradient += gradient^T
 #if DUMPOUTPUT
         inputGradientValues.Print("child Gradient-out");
 #endif
-        InvalidArgument("TransposeNode::BackpropTo() has a known bug. it is not functional.");
     }
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override
@@ -752,8 +1201,6 @@ public:
 template class TransposeNode<float>;
 template class TransposeNode<double>;
 
-#endif
-
 // -----------------------------------------------------------------------
 // CosDistanceNode (left, right)
 // column-wise cos distance
@@ -981,6 +1428,9 @@ public:
     {
     }
 
+    // The scores of row m, m > 0, compare sample column j of input 0 with column (j + shift + m - 1) % n of input 1.
+    // Forward and backward each take one pass over all negNumber+1 rows: the inverse norms of the columns are computed once
+    // in ForwardProp() and kept for BackpropTo(), and the shifted columns are picked by index instead of being copied.
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
@@ -989,108 +1439,9 @@ public:
         Matrix<ElemType> sliceInputGrad = Input(inputIndex)->GradientFor(fr);
         Matrix<ElemType> sliceThisGrad = GradientFor(fr);
 
-        BackpropToS(inputIndex, *m_invNorm0, *m_invNorm1, sliceOutputValue, *m_temp, *m_rightTerm, *m_leftTerm, *m_invNormSquare, sliceInput0Value, sliceInput1Value, Input(2)->Value(), Input(3)->Value(), sliceInputGrad, sliceThisGrad);
-    }
-
-    // functionValues, invNorm0, invNorm1 - output from the EvaluateNode() method
-    // temp, rightTerm, leftTerm - temporary matrices
-    // in0, in1, in2, in3 - input functionValues from other nodes
-    // inputGradientValues(x) - gradients to update, where x matches inputIndex
-    /*TODO: merge with call site*/ void BackpropToS(const size_t inputIndex, const Matrix<ElemType>& invNorm0, const Matrix<ElemType>& invNorm1, const Matrix<ElemType>& functionValues,
-                                                    Matrix<ElemType>& temp, Matrix<ElemType>& rightTerm, Matrix<ElemType>& leftTerm, Matrix<ElemType>& invNormSquare, // the temporary variables
-                                                    const Matrix<ElemType>& in0, const Matrix<ElemType>& in1, const Matrix<ElemType>& in2, const Matrix<ElemType>& in3,
-                                                    Matrix<ElemType>& inputGradientValues, Matrix<ElemType>& thisGradientValues)
-    {
-        size_t shift = (size_t) in2.Get00Element();
-        size_t negNumber = (size_t) in3.Get00Element();
-        size_t numCols = in0.GetNumCols(); // used in computing right child's graident
-
-        if (inputIndex == 0) // left derivative
-        {
-            invNormSquare.AssignElementProductOf(invNorm0, invNorm0);
-
-            for (long m = 0; m < negNumber + 1; m++)
-            {
-                temp.GetARowByIndex(functionValues, m); // set this matrx to be the m-th row in functionValues
-                temp.ElementMultiplyWith(invNormSquare);
-
-                Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, rightTerm, 0, true);
-
-                if (m == 0)
-                {
-                    temp.AssignElementProductOf(invNorm0, invNorm1);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, leftTerm, 0, true);
-                }
-                else
-                {
-                    size_t currshift = m + shift - 1; // for current line, how much should we shift
-
-                    temp.AssignElementProductOfWithShift(invNorm0, invNorm1, currshift); // this is a row vector
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, leftTerm, currshift, true);
-                }
-
-                leftTerm = leftTerm - rightTerm;
-
-                temp.GetARowByIndex(thisGradientValues, m);
-
-                Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, 0, true);
-
-                inputGradientValues += rightTerm;
-            }
-        }
-        else // right part
-        {
-            invNormSquare.AssignElementProductOf(invNorm1, invNorm1); // this matrix should be save and unchanged. It should not be changed
-
-            for (long m = 0; m < negNumber + 1; m++)
-            {
-                temp.GetARowByIndex(functionValues, m); // set this matrx to be the m-th row in functionValues
-
-                if (m == 0) // this is the first line. computation should be symmetric
-                {
-                    // the following is for the right part
-                    temp.ElementMultiplyWith(invNormSquare);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, rightTerm, 0, true);
-
-                    // the following is for the left part
-                    temp.AssignElementProductOf(invNorm0, invNorm1);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, leftTerm, 0, true);
-
-                    leftTerm = leftTerm - rightTerm;
-
-                    temp.GetARowByIndex(thisGradientValues, m);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, 0, true);
-
-                    inputGradientValues += rightTerm;
-                }
-                else // this requires shift
-                {
-                    size_t currshift = (m + shift - 1) % numCols;
-                    size_t reverseshift = numCols - currshift;
-
-                    leftTerm.AssignElementProductOfWithShift(invNormSquare, temp, reverseshift); // use leftTerm as a temp variable here
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(leftTerm, in1, rightTerm, 0, true);
-
-                    temp.AssignElementProductOfWithShift(invNorm1, invNorm0, reverseshift);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, leftTerm, reverseshift, true);
-
-                    leftTerm = leftTerm - rightTerm;
-
-                    temp.GetARowByIndex(thisGradientValues, m);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, reverseshift, false);
-
-                    inputGradientValues += rightTerm;
-                }
-            }
-        }
+        size_t shift = (size_t) Input(2)->Get00Element();
+        size_t negNumber = (size_t) Input(3)->Get00Element();
+        Matrix<ElemType>::AddCosDistanceWithShiftNegGradient(sliceThisGrad, sliceOutputValue, sliceInput0Value, sliceInput1Value, *m_invNorm0, *m_invNorm1, shift, negNumber, inputIndex != 0 /*wrtB*/, sliceInputGrad);
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
@@ -1099,31 +1450,17 @@ public:
         Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
 
-        ForwardPropS(*m_invNorm0, *m_invNorm1, sliceOutputValue, sliceInput0Value, sliceInput1Value, Input(2)->Value(), Input(3)->Value(), *m_leftTerm, *m_rightTerm);
-    }
-
-    /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType>& invNorm0, Matrix<ElemType>& invNorm1, Matrix<ElemType>& functionValues, Matrix<ElemType>& in0, Matrix<ElemType>& in1, Matrix<ElemType>& in2, Matrix<ElemType>& in3, Matrix<ElemType>& leftTermTemp, Matrix<ElemType>& rightTermTemp)
-    {
-        invNorm0.AssignVectorNorm2Of(in0, true); // seems to modify input (in0)
-        invNorm0.AssignElementInverseOf(invNorm0);
-
-        invNorm1.AssignVectorNorm2Of(in1, true); // seems to modify the input (in1)
-        invNorm1.AssignElementInverseOf(invNorm1);
-
-        size_t shift = (size_t) in2.Get00Element();
-        size_t negNumber = (size_t) in3.Get00Element();
+        m_invNorm0->AssignVectorNorm2Of(sliceInput0Value, true);
+        m_invNorm0->AssignElementInverseOf(*m_invNorm0);
 
-        // mutiply invNorm0 and invNorm1 with shift and neg.
-        // The result is a matrix of (numberneg+1, invNorm0.Cols)
-        leftTermTemp.AssignElementProductOfWithShiftNeg(invNorm0, invNorm1, shift, negNumber);
+        m_invNorm1->AssignVectorNorm2Of(sliceInput1Value, true);
+        m_invNorm1->AssignElementInverseOf(*m_invNorm1);
 
-        // compute the right values
-        // Again, the ouput is a matrix of (negNumber+1, invNorm0.cols)
-        rightTermTemp.AssignInnerProductOfWithShiftNeg(in0, in1, true, shift, negNumber);
+        size_t shift = (size_t) Input(2)->Get00Element();
+        size_t negNumber = (size_t) Input(3)->Get00Element();
 
-        // compute the evaluation result matrix by multiply these two matrices, element by element
-        // we get a (negNumber+1, n) matrix
-        functionValues.AssignElementProductOf(leftTermTemp, rightTermTemp);
+        // a (negNumber+1, n) matrix
+        sliceOutputValue.AssignCosDistanceWithShiftNeg(sliceInput0Value, sliceInput1Value, *m_invNorm0, *m_invNorm1, shift, negNumber);
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -1154,10 +1491,6 @@ public:
             auto node = dynamic_pointer_cast<CosDistanceWithNegativeSamplesNode<ElemType>>(nodeP);
             *node->m_invNorm0 = *m_invNorm0;
             *node->m_invNorm1 = *m_invNorm1;
-            *node->m_invNormSquare = *m_invNormSquare;
-            *node->m_leftTerm = *m_leftTerm;
-            *node->m_rightTerm = *m_rightTerm;
-            *node->m_temp = *m_temp;
         }
     }
     // request matrices needed to do node function value evaluation
@@ -1166,16 +1499,6 @@ public:
         Base::RequestMatricesBeforeForwardProp(matrixPool);
         RequestMatrixFromPool(m_invNorm0, matrixPool);
         RequestMatrixFromPool(m_invNorm1, matrixPool);
-        RequestMatrixFromPool(m_leftTerm, matrixPool);
-        RequestMatrixFromPool(m_rightTerm, matrixPool);
-    }
-
-    // request matrices that are needed for gradient computation
-    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
-    {
-        Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_invNormSquare, matrixPool);
-        RequestMatrixFromPool(m_temp, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -1184,21 +1507,12 @@ public:
         Base::ReleaseMatricesAfterBackprop(matrixPool);
         ReleaseMatrixToPool(m_invNorm0, matrixPool);
         ReleaseMatrixToPool(m_invNorm1, matrixPool);
-        ReleaseMatrixToPool(m_leftTerm, matrixPool);
-        ReleaseMatrixToPool(m_rightTerm, matrixPool);
-        ReleaseMatrixToPool(m_invNormSquare, matrixPool);
-        ReleaseMatrixToPool(m_temp, matrixPool);
     }
 
 private:
     // invNorm nodes tranfer data between ForwardProp and BackpropTo
     shared_ptr<Matrix<ElemType>> m_invNorm0;
     shared_ptr<Matrix<ElemType>> m_invNorm1;
-    shared_ptr<Matrix<ElemType>> m_leftTerm;
-    shared_ptr<Matrix<ElemType>> m_rightTerm;
-    // the rest are temporaries, values don't need to be maintained
-    shared_ptr<Matrix<ElemType>> m_invNormSquare;
-    shared_ptr<Matrix<ElemType>> m_temp;
 };
 
 template class CosDistanceWithNegativeSamplesNode<float>;
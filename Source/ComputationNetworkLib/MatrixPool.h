@@ -8,7 +8,9 @@
 #include <string>
 #include <stdexcept>
 #include <vector>
+#include <map>
 #include <algorithm>
+#include <climits>
 #include <stdlib.h>
 
 #include "Basics.h"
@@ -17,52 +19,212 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// -----------------------------------------------------------------------
+// MatrixPool -- plans memory sharing of node value and gradient matrices.
+//
+// ComputationNetwork::AllocateAllMatrices() simulates forward and backward
+// evaluation order and calls Request() and Release() at the points where a
+// matrix becomes live or dead. The pool only records these as lifetime
+// intervals [requestStep, releaseStep] and hands out a placeholder.
+// OptimizedMemoryAllocation() then assigns every request to a shared buffer
+// such that no two overlapping lifetimes share one, picking the best-fitting
+// free buffer by size (in elements per column, as all pooled matrices scale
+// with the minibatch), and writes the shared matrices back into the nodes.
+// A matrix may be requested again after its release (e.g. a node value that
+// is recomputed during backprop); it then has several lifetime intervals,
+// all of which must be free in the buffer it is assigned to.
+// When nodes run concurrently on several streams, the simulated order is only
+// one of many possible ones. Then SetShareAcrossBarriersOnly() restricts
+// sharing to matrices separated by a Barrier(), i.e. a point where all
+// streams are joined (the end of forward and of backward propagation).
+// -----------------------------------------------------------------------
+
 class MatrixPool
 {
-    vector<shared_ptr<Matrix<float>>> m_releasedFloatMatrices;
-    vector<shared_ptr<Matrix<double>>> m_releasedDoubleMatrices;
+    template <class ElemType>
+    struct MemRequestInfo
+    {
+        shared_ptr<Matrix<ElemType>>* pMatrixPtr; // the node's member to write the shared matrix into
+        DEVICEID_TYPE deviceId;
+        size_t numRows; // size estimate, elements per column; 0 if not known
+        vector<pair<int, int>> lifetimes; // [requestStep, releaseStep]; releaseStep is INT_MAX while not released
+    };
+
+    static bool Overlaps(const vector<pair<int, int>>& a, const vector<pair<int, int>>& b)
+    {
+        for (const auto& x : a)
+            for (const auto& y : b)
+                if (x.first <= y.second && y.first <= x.second)
+                    return true;
+        return false;
+    }
+
+    vector<MemRequestInfo<float>> m_floatRequests;
+    vector<MemRequestInfo<double>> m_doubleRequests;
+    int m_stepCounter = 0;
+    bool m_shareAcrossBarriersOnly = false;
+    vector<int> m_barriers; // steps at which all streams are joined, ascending
+    map<DEVICEID_TYPE, size_t> m_plannedBytesPerColumn; // result of the last OptimizedMemoryAllocation()
 
     template <class ElemType>
-    vector<shared_ptr<Matrix<ElemType>>>& GetReleasedMatrices();
+    vector<MemRequestInfo<ElemType>>& GetMemRequestInfos();
 
 public:
+    // request a matrix for *pMatrixPtr; the actual (possibly shared) matrix is assigned in OptimizedMemoryAllocation()
+    // Requesting a matrix that was requested and released before opens another lifetime interval for it.
+    template <class ElemType>
+    void Request(shared_ptr<Matrix<ElemType>>* pMatrixPtr, DEVICEID_TYPE deviceId, size_t numRows)
+    {
+        vector<MemRequestInfo<ElemType>>& requests = GetMemRequestInfos<ElemType>();
+        for (auto& request : requests)
+        {
+            if (request.pMatrixPtr != pMatrixPtr)
+                continue;
+            if (request.lifetimes.back().second != INT_MAX) // (still live: nothing to do)
+                request.lifetimes.push_back(make_pair(m_stepCounter++, INT_MAX));
+            return;
+        }
+        // a placeholder, so that the simulation in AllocateAllMatrices() can inspect the matrix type; it holds no memory
+        *pMatrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+        requests.push_back(MemRequestInfo<ElemType>{pMatrixPtr, deviceId, numRows, vector<pair<int, int>>{make_pair(m_stepCounter++, INT_MAX)}});
+    }
+
     // release here means the matrix can be put back and shared by others
     template <class ElemType>
     void Release(shared_ptr<Matrix<ElemType>> freeMatrix)
     {
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
         if (freeMatrix == nullptr || freeMatrix->GetMatrixType() == SPARSE)
             RuntimeError("MatrixPool::Release: freeMatrix should not be null or sparse.");
-#ifdef _DEBUG
-        for (int i = 0; i < releasedMatrices.size(); i++)
+        vector<MemRequestInfo<ElemType>>& requests = GetMemRequestInfos<ElemType>();
+        for (auto iter = requests.rbegin(); iter != requests.rend(); iter++)
         {
-            if (releasedMatrices[i] == freeMatrix)
+            if (*iter->pMatrixPtr != freeMatrix)
+                continue;
+            if (iter->lifetimes.back().second != INT_MAX)
                 RuntimeError("MatrixPool::Release: freeMatrix is already in the released pool.");
+            iter->lifetimes.back().second = m_stepCounter++;
+            return;
         }
+        // not a pooled matrix (e.g. created by the node itself); nothing to share
+    }
 
-#endif
-        releasedMatrices.push_back(freeMatrix);
+    void SetShareAcrossBarriersOnly(bool enabled)
+    {
+        m_shareAcrossBarriersOnly = enabled;
+    }
+
+    // mark the current step as a point where all pending work has completed
+    void Barrier()
+    {
+        m_barriers.push_back(m_stepCounter++);
     }
 
+    // assign shared matrices to all requests recorded since the last call, and report planned vs. naive memory
+    void OptimizedMemoryAllocation()
+    {
+        m_plannedBytesPerColumn.clear();
+        OptimizedMemoryAllocation<float>();
+        OptimizedMemoryAllocation<double>();
+        m_stepCounter = 0;
+        m_barriers.clear();
+    }
+
+    // bytes the planned shared buffers on a device take per minibatch column, i.e. how device memory grows with the minibatch size
+    size_t GetPlannedBytesPerColumn(DEVICEID_TYPE deviceId) const
+    {
+        auto iter = m_plannedBytesPerColumn.find(deviceId);
+        return iter != m_plannedBytesPerColumn.end() ? iter->second : 0;
+    }
+
+private:
     template <class ElemType>
-    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId)
+    void OptimizedMemoryAllocation()
     {
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
-        shared_ptr<Matrix<ElemType>> matrixPtr;
-        if (releasedMatrices.empty())
+        vector<MemRequestInfo<ElemType>>& requests = GetMemRequestInfos<ElemType>();
+        if (requests.empty())
+            return;
+
+        // a released matrix stays busy until the next barrier
+        if (m_shareAcrossBarriersOnly)
         {
-            matrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+            for (auto& request : requests)
+            {
+                for (auto& lifetime : request.lifetimes)
+                {
+                    auto barrier = lower_bound(m_barriers.begin(), m_barriers.end(), lifetime.second);
+                    lifetime.second = barrier != m_barriers.end() ? *barrier : INT_MAX;
+                }
+            }
         }
-        else
+
+        // requests are recorded in step order, so they are already sorted by their first request step
+        map<DEVICEID_TYPE, vector<const MemRequestInfo<ElemType>*>> requestsPerDevice;
+        for (const auto& request : requests)
+            requestsPerDevice[request.deviceId].push_back(&request);
+
+        for (const auto& deviceRequests : requestsPerDevice)
         {
-            matrixPtr = releasedMatrices.back();
-            releasedMatrices.pop_back();
-        }
+            struct Buffer
+            {
+                shared_ptr<Matrix<ElemType>> matrix;
+                size_t numRows;
+                vector<pair<int, int>> busy; // lifetimes of all requests assigned to this buffer
+            };
+            vector<Buffer> buffers;
+            size_t naiveRows = 0;
+            for (const auto* request : deviceRequests.second)
+            {
+                naiveRows += request->numRows;
+                // best fit: the smallest free buffer that holds the request, else the largest free one (grown)
+                int best = -1;
+                for (int i = 0; i < (int) buffers.size(); i++)
+                {
+                    if (Overlaps(buffers[i].busy, request->lifetimes))
+                        continue;
+                    if (best < 0)
+                        best = i;
+                    else if (buffers[i].numRows >= request->numRows)
+                    {
+                        if (buffers[best].numRows < request->numRows || buffers[i].numRows < buffers[best].numRows)
+                            best = i;
+                    }
+                    else if (buffers[best].numRows < request->numRows && buffers[i].numRows > buffers[best].numRows)
+                        best = i;
+                }
+                if (best < 0)
+                {
+                    buffers.push_back(Buffer{make_shared<Matrix<ElemType>>(deviceRequests.first), 0, vector<pair<int, int>>()});
+                    best = (int) buffers.size() - 1;
+                }
+                auto& buffer = buffers[best];
+                buffer.numRows = max(buffer.numRows, request->numRows);
+                buffer.busy.insert(buffer.busy.end(), request->lifetimes.begin(), request->lifetimes.end());
+                *request->pMatrixPtr = buffer.matrix;
+            }
 
-        if (!matrixPtr) // this can't really happen
-            LogicError("MatrixPool::Request: failed to get a valid matrix.");
+            // the live-set size is the lower bound any plan can reach
+            size_t liveRows = 0;
+            for (const auto* request : deviceRequests.second)
+            {
+                for (const auto& lifetime : request->lifetimes)
+                {
+                    size_t rows = 0;
+                    for (const auto* other : deviceRequests.second)
+                        if (Overlaps(other->lifetimes, vector<pair<int, int>>{make_pair(lifetime.first, lifetime.first)}))
+                            rows += other->numRows;
+                    liveRows = max(liveRows, rows);
+                }
+            }
 
-        return matrixPtr;
+            size_t plannedRows = 0;
+            for (const auto& buffer : buffers)
+                plannedRows += buffer.numRows;
+            m_plannedBytesPerColumn[deviceRequests.first] += plannedRows * sizeof(ElemType);
+            fprintf(stderr, "MatrixPool: %d %s matrices on device %d share %d buffers; planned peak %d, naive %d, live-set lower bound %d elements per column.\n",
+                    (int) deviceRequests.second.size(), sizeof(ElemType) == sizeof(float) ? "float" : "double", (int) deviceRequests.first,
+                    (int) buffers.size(), (int) plannedRows, (int) naiveRows, (int) liveRows);
+        }
+        requests.clear();
     }
 };
 } } }
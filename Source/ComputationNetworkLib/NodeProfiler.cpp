@@ -0,0 +1,174 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "NodeProfiler.h"
+#include "fileutil.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// timing events: 0 marks the begin of the pass, 2k+1 and 2k+2 the begin and end of its k-th node
+static size_t BeginEvent(size_t k) { return 2 * k + 1; }
+static size_t EndEvent(size_t k)   { return 2 * k + 2; }
+
+NodeProfiler::NodeProfiler(DEVICEID_TYPE deviceId, const std::wstring& traceFile, size_t traceMinibatches)
+    : m_deviceId(deviceId), m_startTime(chrono::steady_clock::now()), m_isBackpropPass(false), m_passHostBegin(0),
+      m_traceFile(nullptr), m_traceMinibatches(traceMinibatches), m_traceHasEvents(false)
+{
+    if (!traceFile.empty() && traceMinibatches > 0)
+    {
+        m_traceFile = fopenOrDie(traceFile, L"w");
+        fprintf(m_traceFile, "{\"traceEvents\":[\n");
+        fprintf(stderr, "NodeProfiler: writing a trace of the first %d minibatches to %ls.\n", (int) traceMinibatches, traceFile.c_str());
+    }
+}
+
+NodeProfiler::~NodeProfiler()
+{
+    if (m_traceFile)
+    {
+        fprintf(m_traceFile, "\n]}\n");
+        fclose(m_traceFile);
+    }
+}
+
+double NodeProfiler::HostMilliseconds() const
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - m_startTime).count();
+}
+
+void NodeProfiler::BeginPass(bool isBackprop)
+{
+    m_isBackpropPass = isBackprop;
+    m_pending.clear();
+    ComputeTimingEvents::Record(m_deviceId, 0);
+    m_passHostBegin = HostMilliseconds();
+}
+
+void NodeProfiler::BeginNode()
+{
+    ComputeTimingEvents::Record(m_deviceId, BeginEvent(m_pending.size()));
+    m_pending.push_back(PendingNode{nullptr, Phase::forward, 0, 1, HostMilliseconds(), 0});
+}
+
+void NodeProfiler::EndNode(const ComputationNodeBasePtr& node, Phase phase, size_t stream, size_t numNodes)
+{
+    auto& pending = m_pending.back();
+    ComputeTimingEvents::Record(m_deviceId, EndEvent(m_pending.size() - 1));
+    pending.hostEnd = HostMilliseconds();
+    pending.node = node;
+    pending.phase = phase;
+    pending.stream = stream;
+    pending.numNodes = numNodes;
+}
+
+// number of elements a node reads and writes, counting the nodes of a loop individually
+static double NumElementsMoved(const ComputationNodeBasePtr& node)
+{
+    auto flowControlNode = dynamic_pointer_cast<FlowControlNode>(node);
+    if (flowControlNode)
+    {
+        double sum = 0;
+        for (const auto& nestedNode : flowControlNode->m_nestedNodes)
+            sum += NumElementsMoved(nestedNode);
+        return sum;
+    }
+    double sum = (double) node->GetSampleMatrixNumRows() * node->GetSampleMatrixNumCols();
+    for (const auto& input : node->GetInputs())
+        sum += (double) input->GetSampleMatrixNumRows() * input->GetSampleMatrixNumCols();
+    return sum;
+}
+
+// read back the times of the pass and add them to the statistics
+// On a GPU, this waits for the pass to complete.
+void NodeProfiler::EndPass()
+{
+    const bool isGPU = m_deviceId >= 0;
+    const bool trace = m_traceFile && m_traceMinibatches > 0;
+    for (size_t k = 0; k < m_pending.size(); k++)
+    {
+        const auto& pending = m_pending[k];
+        const auto& node = pending.node;
+        double beginMs, durationMs;
+        if (isGPU)
+        {
+            beginMs = m_passHostBegin + ComputeTimingEvents::ElapsedMilliseconds(m_deviceId, 0, BeginEvent(k));
+            durationMs = ComputeTimingEvents::ElapsedMilliseconds(m_deviceId, BeginEvent(k), EndEvent(k));
+        }
+        else
+        {
+            beginMs = pending.hostBegin;
+            durationMs = pending.hostEnd - pending.hostBegin;
+        }
+
+        wstring name = node->NodeName();
+        if (pending.numNodes > 1)
+            name += msra::strfun::wstrprintf(L" (+%d fused)", (int) pending.numNodes - 1);
+        auto& stats = m_statistics[name];
+        if (stats.operationName.empty())
+        {
+            stats.operationName = node->OperationName();
+            stats.numNodes = pending.numNodes;
+        }
+        // backprop computes about two products per forward one (w.r.t. each input), and moves about twice the data
+        const double work = pending.phase == Phase::backprop ? 2.0 : 1.0;
+        if (pending.phase == Phase::forward)
+        {
+            stats.numCalls++;
+            stats.forwardMs += durationMs;
+        }
+        else // (recomputation is part of the cost of backprop)
+            stats.backpropMs += durationMs;
+        stats.flops += work * node->GetForwardFlopsEstimate() * pending.numNodes;
+        stats.bytes += work * NumElementsMoved(node) * node->GetElementSize() * pending.numNodes;
+        stats.valueBytes = max(stats.valueBytes, node->GetValueAllocatedBytes());
+        stats.gradientBytes = max(stats.gradientBytes, node->GetGradientAllocatedBytes());
+
+        if (trace)
+        {
+            static const char* phaseNames[] = {"forward", "backprop", "recompute"};
+            fprintf(m_traceFile, "%s{\"name\":\"%ls\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.1f,\"dur\":%.1f,\"pid\":0,\"tid\":%d,\"args\":{\"op\":\"%ls\"}}",
+                    m_traceHasEvents ? ",\n" : "", name.c_str(), phaseNames[(int) pending.phase], 1000 * beginMs, 1000 * durationMs, (int) pending.stream, stats.operationName.c_str());
+            m_traceHasEvents = true;
+        }
+    }
+    m_pending.clear();
+    if (trace && m_isBackpropPass && --m_traceMinibatches == 0)
+        fflush(m_traceFile);
+}
+
+void NodeProfiler::PrintReport(const char* title)
+{
+    if (m_statistics.empty())
+        return;
+    vector<pair<wstring, NodeStatistics>> sorted(m_statistics.begin(), m_statistics.end());
+    sort(sorted.begin(), sorted.end(), [](const pair<wstring, NodeStatistics>& a, const pair<wstring, NodeStatistics>& b)
+         {
+             return a.second.forwardMs + a.second.backpropMs > b.second.forwardMs + b.second.backpropMs;
+         });
+    double totalMs = 0;
+    for (const auto& entry : sorted)
+        totalMs += entry.second.forwardMs + entry.second.backpropMs;
+
+    fprintf(stderr, "\nNode profile %s: %.1f ms in %d nodes\n", title, totalMs, (int) sorted.size());
+    fprintf(stderr, "%10s %10s %6s %8s %8s %8s %8s  %-24s %s\n", "fwd ms", "bwd ms", "%", "calls", "GFLOP/s", "GB/s", "MB", "operation", "node");
+    for (const auto& entry : sorted)
+    {
+        const auto& stats = entry.second;
+        const double ms = stats.forwardMs + stats.backpropMs;
+        const double seconds = ms > 0 ? ms / 1000 : 1;
+        fprintf(stderr, "%10.2f %10.2f %6.2f %8d %8.2f %8.2f %8.2f  %-24ls %ls\n",
+                stats.forwardMs, stats.backpropMs, totalMs > 0 ? 100 * ms / totalMs : 0, (int) stats.numCalls,
+                stats.flops / seconds * 1e-9, stats.bytes / seconds * 1e-9, (stats.valueBytes + stats.gradientBytes) / 1e6,
+                stats.operationName.c_str(), entry.first.c_str());
+    }
+    m_statistics.clear();
+}
+} } }
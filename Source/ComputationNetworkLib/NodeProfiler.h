@@ -0,0 +1,87 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// NodeProfiler.h -- per-node timing and memory statistics of forward prop and backprop
+//
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// NodeProfiler -- measures the time each node of a network spends in ForwardProp() and Backprop()
+//
+// PARTraversalFlowControlNode reports every node (or SEQ loop, or fused group) it executes between BeginNode() and
+// EndNode(). On a GPU, these record CUDA events on the node's stream, which are only read back at the end of
+// each pass, so that the measurement does not serialize the streams; on the CPU, the host clock is used.
+// Next to the time, the report shows an estimate of the flops and bytes moved (and the resulting rates),
+// and the memory allocated for each node's value and gradient.
+// Optionally, the first 'traceMinibatches' backprop passes are written as a Chrome trace (chrome://tracing),
+// with one row per stream.
+// -----------------------------------------------------------------------
+
+class NodeProfiler
+{
+public:
+    enum class Phase
+    {
+        forward,
+        backprop,
+        recompute // forward prop of a gradient-checkpointing segment during backprop
+    };
+
+    NodeProfiler(DEVICEID_TYPE deviceId, const std::wstring& traceFile, size_t traceMinibatches);
+    ~NodeProfiler();
+
+    // a pass is one call to PARTraversalFlowControlNode::ForwardProp() or Backprop()
+    void BeginPass(bool isBackprop);
+    void EndPass();
+
+    // 'numNodes' is the number of nodes executed as one unit (a fused group), for the report
+    void BeginNode();
+    void EndNode(const ComputationNodeBasePtr& node, Phase phase, size_t stream, size_t numNodes = 1);
+
+    // print the statistics accumulated since the last report, sorted by total time, and reset them
+    void PrintReport(const char* title);
+
+private:
+    double HostMilliseconds() const;
+
+    struct PendingNode
+    {
+        ComputationNodeBasePtr node;
+        Phase phase;
+        size_t stream;
+        size_t numNodes;
+        double hostBegin, hostEnd; // CPU only
+    };
+
+    struct NodeStatistics
+    {
+        std::wstring operationName;
+        size_t numNodes = 1;
+        size_t numCalls = 0;
+        double forwardMs = 0, backpropMs = 0;
+        double flops = 0, bytes = 0;
+        size_t valueBytes = 0, gradientBytes = 0;
+    };
+
+    DEVICEID_TYPE m_deviceId;
+    std::chrono::steady_clock::time_point m_startTime;
+    bool m_isBackpropPass;
+    double m_passHostBegin;
+    std::vector<PendingNode> m_pending;
+    std::map<std::wstring, NodeStatistics> m_statistics; // [node name]
+
+    FILE* m_traceFile;
+    size_t m_traceMinibatches; // backprop passes still to trace
+    bool m_traceHasEvents;
+};
+} } }
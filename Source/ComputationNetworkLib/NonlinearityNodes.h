@@ -60,7 +60,22 @@ public:
                               Input(0)->ValueTensorFor(rank, fr);
         // If gradient can be compute from output rather than input, then that's better for mem sharing (and faster in most cases).
         // Not possible for Cos().
-        sliceInputGrad.DoBinaryOpOf(1, sliceOutputGrad, sliceValue, 1, opBackward);
+        // (a gradient shared with the input is transformed in place)
+        sliceInputGrad.DoBinaryOpOf(m_gradientIsInputView ? 0 : InputGradientBeta(), sliceOutputGrad, sliceValue, 1, opBackward);
+    }
+
+    virtual bool CanOverwriteInputGradient(size_t /*inputIndex*/) const override
+    {
+        return true;
+    }
+
+    virtual bool CanComputeInPlace() const override
+    {
+        return true;
+    }
+    virtual bool CanShareGradientWithInput() const override
+    {
+        return true;
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -76,6 +91,12 @@ public:
     {
         return !gradientFromOutput;
     }
+
+    virtual bool GetElementWiseForwardOp(ElementWiseOperator& op) const override
+    {
+        op = opForward;
+        return true;
+    }
 };
 
 #define UnaryElementWiseWithOpCodeNodeBaseMembers UsingComputationNodeMembersBoilerplate;
@@ -13,6 +13,7 @@
 #include <string>
 #include <stdexcept>
 #include <list>
+#include <vector>
 #include <iostream>
 
 // this file will contain computation nodes that require several atomic computation.
@@ -120,6 +121,30 @@ public:
         SetDims(TensorShape(value.GetNumRows()), false);
     }
 
+    // restore a value that was precomputed for the same input before (SGD's precompute cache); keeps the sample layout
+    void RestoreComputedValue(const Matrix<ElemType>& value)
+    {
+        CreateMatrixIfNull(m_value);
+        m_value->SetValue(value);
+        m_hasComputed = true;
+    }
+
+    // distributed precomputation: every worker accumulates over its share of the data, then exports its statistics
+    // as a vector that merges with those of the other workers by elementwise summation (a single all-reduce),
+    // and imports the merged vector before MarkComputed(true)
+    virtual bool SupportsMergingStatistics() const
+    {
+        return false;
+    }
+    virtual void GetMergeableStatistics(std::vector<double>& /*stats*/) const
+    {
+        NOT_IMPLEMENTED;
+    }
+    virtual void SetMergedStatistics(const std::vector<double>& /*stats*/)
+    {
+        NOT_IMPLEMENTED;
+    }
+
 public:
     bool m_hasComputed;
 };
@@ -196,19 +221,46 @@ public:
         }
     }
 
+    virtual bool SupportsMergingStatistics() const override
+    {
+        return true;
+    }
+
 protected:
     size_t m_numSamples; // (SIZE_MAX while outside accumulation state)
     bool IsAccumulating() const
     {
         return m_numSamples != SIZE_MAX;
     }
+
+    // helpers for the mergeable statistics, which are kept in double precision
+    static std::vector<double> ToDoubles(const Matrix<ElemType>& m)
+    {
+        ElemType* values = m.CopyToArray();
+        std::vector<double> result(values, values + m.GetNumElements());
+        delete[] values;
+        return result;
+    }
+    static void AssignDoubles(Matrix<ElemType>& m, const std::vector<double>& values)
+    {
+        std::vector<ElemType> converted(values.begin(), values.end());
+        m.SetValue(converted.size(), 1, m.GetDeviceId(), converted.data());
+    }
+    void VerifyMergedStatisticsSize(const std::vector<double>& stats, size_t expectedSize) const
+    {
+        if (stats.size() != expectedSize)
+            LogicError("%ls %ls operation: Merged statistics have the wrong size.", NodeName().c_str(), OperationName().c_str());
+    }
 };
 
 #define UsingMeanInvStdDevNodeBaseNodeMembers \
     ComputationNodeBoilerplate;               \
     UsingPreComputedNodeMembers;              \
     using Base::m_numSamples;                 \
-    using Base::IsAccumulating
+    using Base::IsAccumulating;               \
+    using Base::ToDoubles;                    \
+    using Base::AssignDoubles;                \
+    using Base::VerifyMergedStatisticsSize
 
 // -----------------------------------------------------------------------
 // MeanNode (features)
@@ -277,6 +329,24 @@ public:
 
         m_numSamples += numNewSamples;
     }
+
+    // [count, count * mean]
+    virtual void GetMergeableStatistics(std::vector<double>& stats) const override
+    {
+        stats = ToDoubles(Value());
+        for (auto& v : stats)
+            v *= m_numSamples;
+        stats.insert(stats.begin(), (double) m_numSamples);
+    }
+    virtual void SetMergedStatistics(const std::vector<double>& stats) override
+    {
+        VerifyMergedStatisticsSize(stats, Value().GetNumElements() + 1);
+        m_numSamples = (size_t) stats[0];
+        std::vector<double> avg(stats.begin() + 1, stats.end());
+        for (auto& v : avg)
+            v = m_numSamples > 0 ? v / m_numSamples : 0;
+        AssignDoubles(Value(), avg);
+    }
 };
 
 template class MeanNode<float>;
@@ -390,6 +460,40 @@ public:
 #endif
     }
 
+    // [count, count * mean, count * (variance + mean^2)]
+    // This is the pairwise combination of Chan et al. written as sums, in double precision, so that
+    // workers merge in a single all-reduce.
+    virtual void GetMergeableStatistics(std::vector<double>& stats) const override
+    {
+        const auto mean = ToDoubles(m_mean);
+        const auto var = ToDoubles(m_var);
+        const size_t dim = mean.size();
+        stats.assign(1 + 2 * dim, 0);
+        stats[0] = (double) m_numSamples;
+        for (size_t i = 0; i < dim; i++)
+        {
+            stats[1 + i] = m_numSamples * mean[i];
+            stats[1 + dim + i] = m_numSamples * (var[i] + mean[i] * mean[i]);
+        }
+    }
+    virtual void SetMergedStatistics(const std::vector<double>& stats) override
+    {
+        const size_t dim = m_mean.GetNumElements();
+        VerifyMergedStatisticsSize(stats, 1 + 2 * dim);
+        m_numSamples = (size_t) stats[0];
+        std::vector<double> mean(dim, 0), var(dim, 0);
+        if (m_numSamples > 0)
+        {
+            for (size_t i = 0; i < dim; i++)
+            {
+                mean[i] = stats[1 + i] / m_numSamples;
+                var[i] = max(stats[1 + dim + i] / m_numSamples - mean[i] * mean[i], 0.0);
+            }
+        }
+        AssignDoubles(m_mean, mean);
+        AssignDoubles(m_var, var);
+    }
+
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
     {
         Base::CopyTo(nodeP, newName, flags);
@@ -112,13 +112,15 @@ private:
 protected:
     DelayedValueNodeBase(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
-          m_delayedValue(deviceId)
+          m_delayedValue(deviceId),
+          m_boundaryMask(deviceId)
     {
         Init(TensorShape(), (ElemType) DEFAULT_HIDDEN_ACTIVATION);
     }
     DelayedValueNodeBase(DEVICEID_TYPE deviceId, const wstring& name, ElemType initialActivationValue, const TensorShape& sampleLayout, size_t timeStep)
         : Base(deviceId, name),
-          m_delayedValue(deviceId)
+          m_delayedValue(deviceId),
+          m_boundaryMask(deviceId)
     {
         Init(sampleLayout, initialActivationValue);
         m_timeStep = (int) timeStep; // TODO: pass this to Init() instead as well
@@ -244,20 +246,45 @@ public:
         return false;
     }
 
+    virtual void BeginForwardProp() override // called before first iteration step of ForwardProp()
+    {
+        Base::BeginForwardProp();
+        UpdateBoundaryMask();
+    }
+
     virtual void EndForwardProp() override // called after last iteration step of ForwardProp()
     {
         // In truncated BPTT, we carry over left-to-right state across minibatches.
         // It is kept in m_delayedValue, m_delayedActivationMBLayout.
-        // This could be optimized as follows:
-        //  - only keep the required number of frames (m_timeStep)
-        //  - we don't need to keep anything in full-sequence mode
-        //  - we don't need to keep anything if all sequences are closed (sentence end)
-        //    This condition includes full-sequence mode.
-        // TODO: Can we optimize this and only copy if there is a sequence spanning across the end of the MB? And add a check to BeginForwardProp() to make sure we got one if there is a boundary at the start?
-        m_delayedValue = Input(0)->Value();
-        if (!m_delayedActivationMBLayout)
-            m_delayedActivationMBLayout = make_shared<MBLayout>();
-        m_delayedActivationMBLayout->CopyFrom(m_pMBLayout);
+        // Only the m_timeStep frames that the next minibatch can reach are kept, and nothing if no sequence crosses the
+        // minibatch boundary (which includes full-sequence mode). Their layout is kept for as long as its dimensions stay.
+        if (m_keepWholeInput)
+        {
+            m_delayedValue = Input(0)->Value();
+            if (!m_delayedActivationMBLayout)
+                m_delayedActivationMBLayout = make_shared<MBLayout>();
+            m_delayedActivationMBLayout->CopyFrom(m_pMBLayout);
+        }
+        else
+        {
+            const size_t S = GetNumParallelSequences();
+            const size_t T = GetNumTimeSteps();
+            const bool isCarried = direction < 0 ? m_pMBLayout->HasSequenceBeyondEnd() : m_pMBLayout->HasSequenceBeyondBegin();
+            const size_t numFrames = isCarried ? min((size_t) m_timeStep, T) : 0;
+            const size_t firstFrame = direction < 0 ? T - numFrames : 0;
+            if (numFrames > 0)
+                m_delayedValue.SetValue(Input(0)->Value().ColumnSlice(firstFrame * S, numFrames * S));
+            else
+                m_delayedValue.Resize(GetSampleMatrixNumRows(), 0);
+            if (!m_delayedActivationMBLayout)
+                m_delayedActivationMBLayout = make_shared<MBLayout>();
+            if (m_delayedActivationMBLayout->GetNumParallelSequences() != S || m_delayedActivationMBLayout->GetNumTimeSteps() != numFrames)
+            {
+                m_delayedActivationMBLayout->Init(S, numFrames); // (in place, which reuses its buffers)
+                for (size_t s = 0; s < S && numFrames > 0; s++)
+                    m_delayedActivationMBLayout->AddSequence(NEW_SEQUENCE_ID, s, 0, numFrames);
+            }
+        }
 
         Base::EndForwardProp();
     }
@@ -283,61 +310,42 @@ public:
         // we forward prop from the previous frame to this frame
         FrameRange frDelayed = fr.WithTimeOffset(direction * m_timeStep);
 
-        size_t T = GetNumTimeSteps();
-        size_t T_delayedActivation = m_delayedActivationMBLayout ? m_delayedActivationMBLayout->GetNumTimeSteps() : 0; // (note: should never happen in full-sequence mode)
+        int T = (int) GetNumTimeSteps();
+        int T_delayedActivation = m_delayedActivationMBLayout ? (int) m_delayedActivationMBLayout->GetNumTimeSteps() : 0; // (note: should never happen in full-sequence mode)
 
         // compute logical position of delayed value
         assert(m_timeStep > 0);
 
         size_t t = fr.t();
         int t_delayed = (int) (t + direction * m_timeStep); // this might end up outside the current window
+        const size_t S = GetNumParallelSequences();
+        const size_t firstSequence = fr.seqIndex == SIZE_MAX ? 0 : fr.seqIndex;
+        const size_t numSequences = fr.seqIndex == SIZE_MAX ? S : 1;
 
-        Matrix<ElemType> inp; // ((DEVICEID_TYPE)m_value.GetDeviceId());
+        Matrix<ElemType> out = ValueFor(fr);
 
-        // if any sequence at this time step has a boundary flag, then process one by one
-        // TODO: Would there be an efficiency gain from grouping consecutive sequences with identical flags?
-        // assert(m_pShiftedMBLayout->Is(t, SequenceStart_or_End) == m_pMBLayout->IsBeyondStartOrEnd(frDelayed));
-        if (m_pMBLayout->IsBeyondStartOrEnd(frDelayed))
+        // delay reaches into a previous minibatch that left nothing: every sequence must start over here (or be a gap)
+        if (t_delayed + T_delayedActivation < 0 || t_delayed - T >= T_delayedActivation)
         {
-            for (size_t id = 0; id < GetNumParallelSequences(); id++)
-            {
-                if (m_pMBLayout->IsGap(fr.Sequence(id))) // if output is in a gap then don't bother filling it
-                    continue;
-
-                Matrix<ElemType> out = ValueFor(fr.Sequence(id));
-
-                // assert(m_pShiftedMBLayout->Is(id, t, SequenceStart_or_End) == m_pMBLayout->IsBeyondStartOrEnd(frDelayed.Sequence(id)));
-                if (m_pMBLayout->IsBeyondStartOrEnd(frDelayed.Sequence(id)))
-                    out.SetValue(m_initialActivationValue); // crossed a boundary
-                else                                        // not a boundary: just copy the delayed value
-                {
-                    // inside the sequence: access delayed value
-                    if (t_delayed < 0)
-                        inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed + T_delayedActivation).Sequence(id), m_delayedActivationMBLayout); // delay reaches in previous minibatch
-                    else if (t_delayed >= T)
-                        inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed - T).Sequence(id), m_delayedActivationMBLayout); // delay reaches in previous minibatch
-                    else
-                        inp = Input(0)->ValueFor(frDelayed.Sequence(id));
-                    // inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, t_delayed).Sequence(id));
-
-                    out.SetValue(inp);
-                }
-            }
+            for (size_t id = firstSequence; id < firstSequence + numSequences; id++)
+                if (!m_pMBLayout->IsGap(fr.Sequence(id)) && !m_pMBLayout->IsBeyondStartOrEnd(frDelayed.Sequence(id)))
+                    LogicError("%ls %ls operation: A sequence continues from a previous minibatch that was not seen, or that left no state. Missing sequence-begin flag?", NodeName().c_str(), OperationName().c_str());
+            out.SetValue(m_initialActivationValue);
+            return;
         }
-        else // frame has no boundary flags: use ValueFor directly (still may have a gap here)
-        {
-            Matrix<ElemType> out = ValueFor(fr);
 
-            if (t_delayed < 0)
-                inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed + T_delayedActivation), m_delayedActivationMBLayout);
-            else if (t_delayed >= T)
-                inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed - T), m_delayedActivationMBLayout);
-            else
-                inp = Input(0)->ValueFor(frDelayed);
-            // inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, t_delayed));
+        // copy the whole frame, then reset the sequences that cross a boundary here in one go (gaps get filled too, which does not matter)
+        Matrix<ElemType> inp; // ((DEVICEID_TYPE)m_value.GetDeviceId());
+        if (t_delayed < 0)
+            inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed + T_delayedActivation), m_delayedActivationMBLayout).ColumnSlice(firstSequence, numSequences); // delay reaches in previous minibatch
+        else if (t_delayed >= T)
+            inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed - T), m_delayedActivationMBLayout).ColumnSlice(firstSequence, numSequences); // delay reaches in previous minibatch
+        else
+            inp = Input(0)->ValueFor(frDelayed);
+        out.SetValue(inp);
 
-            out.SetValue(inp);
-        }
+        if (t < m_hasBoundaryAt.size() && m_hasBoundaryAt[t])
+            out.MaskColumnsValue(m_boundaryMask.ColumnSlice(t * S + firstSequence, numSequences), m_initialActivationValue); // crossed a boundary
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -359,6 +367,7 @@ public:
             node->m_timeStep = m_timeStep;
             node->m_initialActivationValue = m_initialActivationValue;
             node->m_delayedValue = m_delayedValue;
+            node->m_keepWholeInput = m_keepWholeInput;
             if (m_delayedActivationMBLayout)
                 (node->m_delayedActivationMBLayout = make_shared<MBLayout>())->CopyFrom(m_delayedActivationMBLayout);
             else
@@ -369,8 +378,8 @@ public:
     virtual NodeStatePtr /*IStatefulNode::*/ ExportState() override
     {
         NodeStatePtr pExportedState;
-        size_t nT = m_pMBLayout->GetNumTimeSteps();
-        size_t nU = m_pMBLayout->GetNumParallelSequences();
+        size_t nT = m_delayedActivationMBLayout->GetNumTimeSteps(); // (the frames kept by EndForwardProp())
+        size_t nU = m_delayedActivationMBLayout->GetNumParallelSequences();
         int dir = direction;
         if (m_timeStep != 1)
         {
@@ -432,6 +441,7 @@ public:
         const Matrix<ElemType>& delayedActivation = pState->ExportCachedActivity();
         size_t nT = m_delayedActivationMBLayout->GetNumTimeSteps();
         size_t nU = m_delayedActivationMBLayout->GetNumParallelSequences();
+        m_delayedValue.Resize(GetSampleMatrixNumRows(), nT * nU); // (the frames the exporting node kept)
 
         int dir = direction;
         if (dir == -1) // looking backward
@@ -442,12 +452,70 @@ public:
             LogicError("Unrecognized direction in DelayedValueNodeBase");
     }
 
+    // streaming evaluation (EvalDll): carry state over between minibatches whose parallel sequences belong to different streams
+    // With SetKeepWholeInput(true), GetDelayedValue() after ForwardProp() is the input of the whole minibatch, else only the frames that
+    // EndForwardProp() keeps. SetDelayedValue() replaces it by just the frames the next minibatch reaches back to: the last m_timeStep
+    // frames of each of its numParallelSequences sequences, in minibatch column order.
+    int GetTimeStep() const
+    {
+        return m_timeStep;
+    }
+    void SetKeepWholeInput(bool keepWholeInput)
+    {
+        m_keepWholeInput = keepWholeInput;
+    }
+    const Matrix<ElemType>& GetDelayedValue() const
+    {
+        return m_delayedValue;
+    }
+    void SetDelayedValue(const Matrix<ElemType>& delayedValue, size_t numParallelSequences)
+    {
+        const size_t numTimeSteps = m_timeStep;
+        if (delayedValue.GetNumCols() != numTimeSteps * numParallelSequences)
+            LogicError("SetDelayedValue: %d columns given for %d frames of %d parallel sequences.", (int) delayedValue.GetNumCols(), (int) numTimeSteps, (int) numParallelSequences);
+        m_delayedValue.SetValue(delayedValue);
+        m_delayedActivationMBLayout = make_shared<MBLayout>();
+        m_delayedActivationMBLayout->Init(numParallelSequences, numTimeSteps);
+        for (size_t s = 0; s < numParallelSequences; s++)
+            m_delayedActivationMBLayout->AddSequence(NEW_SEQUENCE_ID, s, 0, numTimeSteps);
+    }
+
 protected:
     ElemType m_initialActivationValue;       // starting value for hidden activation vector at boundary
     Matrix<ElemType> m_delayedValue;         // saves the activation of the previous step that this node points to
     MBLayoutPtr m_delayedActivationMBLayout; // layout for m_delayedValue
     int m_timeStep;                          // delay in frames (typ. 1)
     function<void()> m_attachInputsFn;       // for late expansion of inputs (scripting)
+    bool m_keepWholeInput = false;           // keep all of the last input in m_delayedValue, not just the frames the next minibatch can reach
+
+private:
+    // determine for every column whether the delayed frame lies beyond the start or end of its sequence, i.e. the initial value is used
+    void UpdateBoundaryMask()
+    {
+        if (!m_pMBLayout)
+            return;
+        const size_t S = GetNumParallelSequences();
+        const size_t T = GetNumTimeSteps();
+        m_hasBoundaryAt.assign(T, false);
+        vector<char> mask;
+        for (size_t t = 0; t < T; t++)
+        {
+            FrameRange frDelayed = FrameRange(m_pMBLayout, t).WithTimeOffset(direction * m_timeStep);
+            if (!m_pMBLayout->IsBeyondStartOrEnd(frDelayed))
+                continue;
+            if (mask.empty())
+                mask.assign(S * T, 1);
+            m_hasBoundaryAt[t] = true;
+            for (size_t s = 0; s < S; s++)
+                if (m_pMBLayout->IsBeyondStartOrEnd(frDelayed.Sequence(s)))
+                    mask[t * S + s] = 0;
+        }
+        if (!mask.empty())
+            m_boundaryMask.SetValue(1, S * T, m_deviceId, mask.data()); // (one upload per minibatch)
+    }
+
+    Matrix<char> m_boundaryMask;  // [1 x S*T] 0 where the delayed frame is beyond the start or end of the sequence
+    vector<bool> m_hasBoundaryAt; // [t] true if any sequence crosses a boundary at time step t
 };
 
 #define UsingDelayedValueNodeMembers        \
@@ -530,6 +598,326 @@ public:
 template class FutureValueNode<float>;
 template class FutureValueNode<double>;
 
+// -----------------------------------------------------------------------
+// LSTMNode (inputWeights, recurrentWeights, bias, input) -- a complete LSTM layer
+//
+//   z_t = W x_t + R h_{t-1} + b, stacked as [input; forget; output; cell candidate] gate pre-activations
+//   c_t = sigmoid(z_f) .* c_{t-1} + sigmoid(z_i) .* tanh(z_g)
+//   h_t = sigmoid(z_o) .* tanh(c_t)
+//
+// Unlike an LSTM described in NDL through Times, PastValue and elementwise nodes, this node is not part of a
+// recurrent loop. It processes all time steps of the minibatch itself: the input projections W x_t are computed
+// for all time steps with a single GEMM, and each time step is one GEMM for R h_{t-1} plus one fused kernel for
+// all gate nonlinearities and the cell update. The gradient is computed by BPTT in the same manner.
+// With persistentRecurrence, layers with N <= 512 on a GPU instead run all time steps of the forward pass in one
+// persistent kernel that keeps R in shared memory (see Matrix::LSTMForwardSequence()).
+// W is [4N x I], R is [4N x N], b is [4N x 1], and the output h is [N x T].
+// Sequence starts reset h and c to 0. Sequences continuing from the previous minibatch (truncated BPTT)
+// continue from the state at its end, without propagating gradients into it.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class LSTMNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<4>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"LSTM";
+    }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(LSTMNode);
+    LSTMNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name),
+          m_carriedOutput(deviceId),
+          m_carriedCell(deviceId),
+          m_resetMask(deviceId)
+    {
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        const size_t S = GetNumParallelSequences();
+        const size_t T = GetNumTimeSteps();
+        UpdateResetMask();
+
+        // input projections and bias for all time steps in one go
+        m_gates->AssignProductOf(Input(0)->ValueAsMatrix(), false, Input(3)->Value(), false);
+        Matrix<ElemType>::ScaleAndAdd(1, Input(2)->ValueAsMatrix(), *m_gates);
+
+        const size_t N = GetSampleMatrixNumRows();
+        m_cell->Resize(N, S * T);
+        m_prevCell->Resize(N, S * T);
+        m_prevOutput->Resize(N, S * T);
+
+        // small layers go through all time steps in one persistent kernel if possible
+        bool isDone = false;
+        if (g_persistentRecurrence && T > 0)
+        {
+            SetPreviousState(0);
+            isDone = Matrix<ElemType>::LSTMForwardSequence(Input(1)->ValueAsMatrix(), *m_gates, m_resetMask, *m_prevOutput, *m_prevCell, *m_cell, Value(), S);
+        }
+
+        for (size_t t = 0; t < T && !isDone; t++)
+        {
+            SetPreviousState(t);
+            Matrix<ElemType> prevOutput = m_prevOutput->ColumnSlice(t * S, S);
+            Matrix<ElemType> prevCell = m_prevCell->ColumnSlice(t * S, S);
+            Matrix<ElemType> gates = m_gates->ColumnSlice(t * S, S);
+            if (t > 0 || m_continuesAtStart)
+                Matrix<ElemType>::MultiplyAndAdd(Input(1)->ValueAsMatrix(), false, prevOutput, false, gates);
+            Matrix<ElemType> cell = m_cell->ColumnSlice(t * S, S);
+            Matrix<ElemType> output = Value().ColumnSlice(t * S, S);
+            Matrix<ElemType>::LSTMForwardStep(gates, prevCell, cell, output);
+        }
+
+        // keep the final state for sequences that continue into the next minibatch
+        if (T > 0)
+        {
+            m_carriedOutput.SetValue(Value().ColumnSlice((T - 1) * S, S));
+            m_carriedCell.SetValue(m_cell->ColumnSlice((T - 1) * S, S));
+        }
+    }
+
+    virtual void /*IComputationNode::*/ BeginBackprop() override
+    {
+        Base::BeginBackprop();
+        m_gatesGradientValid = false;
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override
+    {
+        // the gate gradients over all time steps are shared by all inputs, so compute them once per backprop pass
+        if (!m_gatesGradientValid)
+        {
+            BackpropThroughTime();
+            m_gatesGradientValid = true;
+        }
+
+        if (inputIndex == 0) // input weights
+            Matrix<ElemType>::MultiplyAndAdd(*m_gatesGradient, false, Input(3)->MaskedValueFor(FrameRange(Input(3)->GetMBLayout())), true, Input(0)->GradientAsMatrix());
+        else if (inputIndex == 1) // recurrent weights
+            Matrix<ElemType>::MultiplyAndAdd(*m_gatesGradient, false, *m_prevOutput, true, Input(1)->GradientAsMatrix());
+        else if (inputIndex == 2) // bias
+        {
+            Matrix<ElemType>::VectorSum(*m_gatesGradient, *m_biasGradient, false);
+            Input(2)->GradientAsMatrix() += *m_biasGradient;
+        }
+        else // input
+            Matrix<ElemType>::MultiplyAndAdd(Input(0)->ValueAsMatrix(), true, *m_gatesGradient, false, Input(3)->Gradient());
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        // the previous outputs that the gradient needs are kept in m_prevOutput
+        return false;
+    }
+
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override
+    {
+        return childIndex != 2;
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase();
+
+        if (isFinalValidationPass && (Input(0)->HasMBLayout() || Input(1)->HasMBLayout() || Input(2)->HasMBLayout()))
+            InvalidArgument("%ls %ls operation requires the weights and bias to not be minibatch data (must not have an MBLayout).", NodeName().c_str(), OperationName().c_str());
+        if (isFinalValidationPass && !Input(3)->HasMBLayout())
+            InvalidArgument("%ls %ls operation requires the input to be minibatch data (must have an MBLayout).", NodeName().c_str(), OperationName().c_str());
+
+        // the cell dimension N is determined by the recurrent weights [4N x N], or else by the 4N rows of any parameter
+        size_t N = Input(1)->GetAsMatrixNumCols();
+        if (N == 0)
+            N = max(Input(0)->GetAsMatrixNumRows(), max(Input(1)->GetAsMatrixNumRows(), Input(2)->GetAsMatrixNumRows())) / 4;
+        const size_t inputDim = Input(3)->GetSampleMatrixNumRows();
+        Input(0)->ValidateInferInputDimsFrom(TensorShape(4 * N, inputDim));
+        Input(1)->ValidateInferInputDimsFrom(TensorShape(4 * N, N));
+        Input(2)->ValidateInferInputDimsFrom(TensorShape(4 * N, 1));
+
+        if (isFinalValidationPass)
+        {
+            if (N == 0 || Input(0)->GetAsMatrixNumRows() != 4 * N || Input(0)->GetAsMatrixNumCols() != inputDim)
+                InvalidArgument("%ls %ls operation: The input weights must be [%d x %d].", NodeName().c_str(), OperationName().c_str(), (int) (4 * N), (int) inputDim);
+            if (Input(1)->GetAsMatrixNumRows() != 4 * N || Input(1)->GetAsMatrixNumCols() != N)
+                InvalidArgument("%ls %ls operation: The recurrent weights must be [%d x %d].", NodeName().c_str(), OperationName().c_str(), (int) (4 * N), (int) N);
+            if (Input(2)->GetAsMatrixNumRows() != 4 * N || Input(2)->GetAsMatrixNumCols() != 1)
+                InvalidArgument("%ls %ls operation: The bias must be [%d x 1].", NodeName().c_str(), OperationName().c_str(), (int) (4 * N));
+        }
+
+        SetDims(TensorShape(N), true);
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<LSTMNode<ElemType>>(nodeP);
+            node->m_carriedOutput = m_carriedOutput;
+            node->m_carriedCell = m_carriedCell;
+        }
+    }
+
+    // request matrices needed to do node function value evaluation
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_gates, matrixPool);
+        RequestMatrixFromPool(m_cell, matrixPool);
+        RequestMatrixFromPool(m_prevCell, matrixPool);
+        RequestMatrixFromPool(m_prevOutput, matrixPool);
+    }
+
+    // request matrices that are needed for gradient computation
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_gatesGradient, matrixPool);
+        RequestMatrixFromPool(m_cellGradient, matrixPool);
+        RequestMatrixFromPool(m_stepGradient, matrixPool);
+        RequestMatrixFromPool(m_recurrentGradient, matrixPool);
+        RequestMatrixFromPool(m_biasGradient, matrixPool);
+    }
+
+    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_gates, matrixPool);
+        ReleaseMatrixToPool(m_cell, matrixPool);
+        ReleaseMatrixToPool(m_prevCell, matrixPool);
+        ReleaseMatrixToPool(m_prevOutput, matrixPool);
+        ReleaseMatrixToPool(m_gatesGradient, matrixPool);
+        ReleaseMatrixToPool(m_cellGradient, matrixPool);
+        ReleaseMatrixToPool(m_stepGradient, matrixPool);
+        ReleaseMatrixToPool(m_recurrentGradient, matrixPool);
+        ReleaseMatrixToPool(m_biasGradient, matrixPool);
+    }
+
+private:
+    // set the columns of time step t of m_prevOutput and m_prevCell
+    void SetPreviousState(size_t t)
+    {
+        const size_t N = GetSampleMatrixNumRows();
+        const size_t S = GetNumParallelSequences();
+        Matrix<ElemType> prevOutput = m_prevOutput->ColumnSlice(t * S, S);
+        Matrix<ElemType> prevCell = m_prevCell->ColumnSlice(t * S, S);
+        if (t > 0)
+        {
+            prevOutput.SetValue(Value().ColumnSlice((t - 1) * S, S));
+            prevCell.SetValue(m_cell->ColumnSlice((t - 1) * S, S));
+        }
+        else if (m_continuesAtStart)
+        {
+            if (m_carriedOutput.GetNumRows() != N || m_carriedOutput.GetNumCols() != S)
+                LogicError("%ls %ls operation: A sequence continues from a previous minibatch that was not seen. Missing sequence-begin flag?", NodeName().c_str(), OperationName().c_str());
+            prevOutput.SetValue(m_carriedOutput);
+            prevCell.SetValue(m_carriedCell);
+        }
+        else
+        {
+            prevOutput.SetValue(0);
+            prevCell.SetValue(0);
+        }
+        if (m_hasResetAt[t] && (t > 0 || m_continuesAtStart))
+        {
+            Matrix<char> mask = m_resetMask.ColumnSlice(t * S, S);
+            prevOutput.MaskColumnsValue(mask, 0);
+            prevCell.MaskColumnsValue(mask, 0);
+        }
+    }
+
+    // determine for every column whether its stream starts over there (sequence start or gap), i.e. does not see h_{t-1} and c_{t-1}
+    void UpdateResetMask()
+    {
+        const size_t S = GetNumParallelSequences();
+        const size_t T = GetNumTimeSteps();
+        vector<char> mask(S * T, 1);
+        m_hasResetAt.assign(T, false);
+        m_continuesAtStart = false;
+        for (size_t t = 0; t < T; t++)
+        {
+            FrameRange fr(m_pMBLayout, t);
+            FrameRange frPrev = fr.WithTimeOffset(-1);
+            bool hasReset = m_pMBLayout->IsGap(fr) || m_pMBLayout->IsBeyondStartOrEnd(frPrev);
+            for (size_t s = 0; s < S && hasReset; s++)
+            {
+                if (m_pMBLayout->IsGap(fr.Sequence(s)) || m_pMBLayout->IsBeyondStartOrEnd(frPrev.Sequence(s)))
+                {
+                    mask[t * S + s] = 0;
+                    m_hasResetAt[t] = true;
+                }
+            }
+            if (t == 0)
+                m_continuesAtStart = find(mask.begin(), mask.begin() + S, 1) != mask.begin() + S;
+        }
+        m_resetMask.SetValue(1, S * T, m_deviceId, mask.data());
+    }
+
+    // compute m_gatesGradient [4N x S*T] by iterating backwards over time
+    void BackpropThroughTime()
+    {
+        const size_t N = GetSampleMatrixNumRows();
+        const size_t S = GetNumParallelSequences();
+        const size_t T = GetNumTimeSteps();
+        MaskMissingGradientColumnsToZero(FrameRange(m_pMBLayout));
+
+        m_gatesGradient->Resize(4 * N, S * T);
+        m_cellGradient->Resize(N, S);
+        m_cellGradient->SetValue(0);
+        m_stepGradient->Resize(N, S);
+        for (size_t t = T; t-- > 0;)
+        {
+            m_stepGradient->SetValue(Gradient().ColumnSlice(t * S, S));
+            if (t + 1 < T)
+            {
+                // h_t and c_t feed into step t+1, except where a stream starts over there
+                m_recurrentGradient->AssignProductOf(Input(1)->ValueAsMatrix(), true, m_gatesGradient->ColumnSlice((t + 1) * S, S), false);
+                if (m_hasResetAt[t + 1])
+                {
+                    Matrix<char> mask = m_resetMask.ColumnSlice((t + 1) * S, S);
+                    m_recurrentGradient->MaskColumnsValue(mask, 0);
+                    m_cellGradient->MaskColumnsValue(mask, 0);
+                }
+                *m_stepGradient += *m_recurrentGradient;
+            }
+            Matrix<ElemType> gatesGradient = m_gatesGradient->ColumnSlice(t * S, S);
+            Matrix<ElemType>::LSTMBackwardStep(m_gates->ColumnSlice(t * S, S), m_prevCell->ColumnSlice(t * S, S), m_cell->ColumnSlice(t * S, S),
+                                               *m_stepGradient, *m_cellGradient, gatesGradient);
+        }
+        // gaps may hold garbage that must not leak into the weight gradients
+        MaskMissingColumnsTo(*m_gatesGradient, m_pMBLayout, FrameRange(m_pMBLayout), (ElemType) 0);
+    }
+
+    // values kept from ForwardProp for the gradient, all with S*T columns
+    shared_ptr<Matrix<ElemType>> m_gates;      // gate activations [4N x S*T]
+    shared_ptr<Matrix<ElemType>> m_cell;       // c_t
+    shared_ptr<Matrix<ElemType>> m_prevCell;   // c_{t-1} as seen by step t, i.e. 0 where a stream starts over
+    shared_ptr<Matrix<ElemType>> m_prevOutput; // h_{t-1} likewise
+    // the rest are temporaries, values don't need to be maintained
+    shared_ptr<Matrix<ElemType>> m_gatesGradient;
+    shared_ptr<Matrix<ElemType>> m_cellGradient;
+    shared_ptr<Matrix<ElemType>> m_stepGradient;
+    shared_ptr<Matrix<ElemType>> m_recurrentGradient;
+    shared_ptr<Matrix<ElemType>> m_biasGradient;
+    bool m_gatesGradientValid = false;
+
+    // final state [N x S], carried over to the next minibatch
+    Matrix<ElemType> m_carriedOutput;
+    Matrix<ElemType> m_carriedCell;
+
+    Matrix<char> m_resetMask;        // [1 x S*T] 0 where a stream starts over
+    vector<bool> m_hasResetAt;       // [t] true if any stream starts over at time step t
+    bool m_continuesAtStart = false; // true if any stream continues from the previous minibatch
+};
+
+template class LSTMNode<float>;
+template class LSTMNode<double>;
+
 #ifdef COMING_SOON
 
 // -----------------------------------------------------------------------
@@ -156,14 +156,17 @@ public:
         SetDims(sampleLayout, HasMBLayout());
     }
 
+    // (a zero-copy view has its input's value, and maybe its gradient, already)
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
-        ValueFor(fr).SetValue(Input(0)->ValueFor(fr));
+        if (!m_valueIsInputView)
+            ValueFor(fr).SetValue(Input(0)->ValueFor(fr));
     }
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
-        Input(inputIndex)->GradientFor(fr).SetValue(GradientFor(fr));
+        if (!m_gradientIsInputView)
+            Input(inputIndex)->GradientFor(fr).SetValue(GradientFor(fr));
     }
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override
@@ -175,6 +178,16 @@ public:
         return false;
     }
 
+    // the matrix is the input's: same elements in the same order, only the sample shape differs
+    virtual bool CanBeViewOfInput() const override
+    {
+        return true;
+    }
+    virtual bool CanShareGradientWithInput() const override
+    {
+        return true;
+    }
+
 private:
     TensorShape m_replacementSampleLayout; // user-specified dimensions to replace dimensions [beginDim, endDim]
     int m_beginDimParameter;               // 1-based index range as specified
@@ -254,6 +267,80 @@ public:
 template class ReconcileMBLayoutNode<float>;
 template class ReconcileMBLayoutNode<double>;
 
+// -----------------------------------------------------------------------
+// DeviceTransferNode (input) -- the input's value, on the device of this node
+// Inserted by ComputationNetwork::PlaceNodesOnDevices() (model parallelism) at every edge whose ends are on different
+// devices, so that no other node ever sees an input on a device other than its own. The value is copied over in
+// forward prop, and the gradient is copied back and added to the input's in backprop (peer-to-peer between GPUs).
+// In a network that is loaded onto a single device, this is an identity.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class DeviceTransferNode : public ComputationNode<ElemType>, public NumInputs<1>
+{
+    typedef ComputationNode<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"DeviceTransfer";
+    }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(DeviceTransferNode);
+    DeviceTransferNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        auto value = ValueFor(fr);
+        CopyToDevice(Input(0)->ValueFor(fr), value);
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t /*inputIndex*/, const FrameRange& fr) override
+    {
+        auto inputGradient = Input(0)->GradientFor(fr);
+        if (inputGradient.GetDeviceId() == m_deviceId)
+        {
+            inputGradient += GradientFor(fr);
+            return;
+        }
+        Matrix<ElemType> moved(m_deviceId);
+        moved.SetValue(GradientFor(fr));
+        moved.TransferToDeviceIfNotThere(inputGradient.GetDeviceId(), true);
+        inputGradient += moved;
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase();
+        SetDims(Input(0));
+    }
+
+private:
+    // Matrix::SetValue() would move the target to the source's device; this goes through a moved copy instead
+    static void CopyToDevice(const Matrix<ElemType>& from, Matrix<ElemType>& to)
+    {
+        if (from.GetDeviceId() == to.GetDeviceId())
+        {
+            to.SetValue(from);
+            return;
+        }
+        Matrix<ElemType> moved(from.GetDeviceId());
+        moved.SetValue(from);
+        moved.TransferToDeviceIfNotThere(to.GetDeviceId(), true);
+        to.SetValue(moved);
+    }
+};
+
+template class DeviceTransferNode<float>;
+template class DeviceTransferNode<double>;
+
 // -----------------------------------------------------------------------
 // RowSliceNode (input)
 // this node extracts part of the input by rows as the output
@@ -274,7 +361,8 @@ public:
     RowSliceNode(DEVICEID_TYPE deviceId, const wstring& name, size_t startIndex = 0, size_t numRows = 0)
         : Base(deviceId, name),
           m_startIndex(startIndex),
-          m_sliceHeight(numRows)
+          m_sliceHeight(numRows),
+          m_isViewAttached(false)
     {
     }
     RowSliceNode(const ScriptableObjects::IConfigRecordPtr configp)
@@ -326,7 +414,31 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
-        ValueFor(fr).AssignRowSliceValuesOf(Input(0)->ValueFor(fr), m_startIndex, m_sliceHeight);
+        if (!m_valueIsInputView || !m_isViewAttached)
+            ValueFor(fr).AssignRowSliceValuesOf(Input(0)->ValueFor(fr), m_startIndex, m_sliceHeight);
+    }
+
+    // zero-copy: the rows of a single column are contiguous, e.g. the gate biases sliced out of one stacked bias parameter
+    // The gradient is not shared, since the slice only covers part of the input's.
+    virtual bool CanBeViewOfInput() const override
+    {
+        return !Input(0)->HasMBLayout() && Input(0)->GetSampleMatrixNumCols() == 1;
+    }
+
+    // (right after allocation, the input may not have its value yet; until then, the node keeps a matrix of its own)
+    virtual void AttachInputView() override
+    {
+        const auto& input = Input(0)->Value();
+        m_isViewAttached = input.GetMatrixType() == DENSE && input.GetNumRows() == Input(0)->GetSampleMatrixNumRows() && input.GetNumCols() == 1;
+        if (m_isViewAttached)
+        {
+            Matrix<ElemType> inputRow = input.ColumnSlice(0, 1);
+            inputRow.Reshape(1, input.GetNumRows());
+            m_value = make_shared<Matrix<ElemType>>(inputRow.ColumnSlice(m_startIndex, m_sliceHeight));
+            m_value->Reshape(m_sliceHeight, 1);
+        }
+        else if (!m_value || !m_value->OwnBuffer())
+            m_value = make_shared<Matrix<ElemType>>(m_deviceId);
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -348,6 +460,7 @@ public:
 
 private:
     size_t m_startIndex, m_sliceHeight;
+    bool m_isViewAttached; // m_value is a view of the input's (see AttachInputView())
 };
 
 template class RowSliceNode<float>;
@@ -486,6 +599,8 @@ template class RowStackNode<double>;
 
 // -----------------------------------------------------------------------
 // RowRepeatNode (input) -- duplicate row(s) of a matrix multiple times
+// Each output column is viewed as [D x numRepeats] over the input column [D x 1], which is broadcast into it, so the
+// gradient is a reduction over the repeats.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -553,12 +668,25 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
-        ValueFor(fr).AssignRepeatOf(Input(0)->ValueFor(fr), m_numRepeat, 1);
+        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+        Matrix<ElemType> sliceInputValue = Input(0)->ValueFor(fr);
+        auto result = TensorView<ElemType>(sliceOutputValue, RepeatedShape(sliceInputValue, m_numRepeat));
+        auto input = TensorView<ElemType>(sliceInputValue, RepeatedShape(sliceInputValue, 1));
+        result.AssignCopyOf(input);
     }
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t /*inputIndex*/, const FrameRange& fr) override
     {
-        Input(0)->GradientFor(fr).AddToRowRepeatValuesOf(GradientFor(fr), m_numRepeat);
+        Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
+        Matrix<ElemType> sliceInputGrad = Input(0)->GradientFor(fr);
+        auto gradient = TensorView<ElemType>(sliceOutputGrad, RepeatedShape(sliceInputGrad, m_numRepeat));
+        auto inputGradient = TensorView<ElemType>(sliceInputGrad, RepeatedShape(sliceInputGrad, 1));
+        inputGradient.DoCopyOf(InputGradientBeta(), gradient, 1); // sums over the repeats
+    }
+
+    virtual bool CanOverwriteInputGradient(size_t /*inputIndex*/) const override
+    {
+        return true;
     }
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override
@@ -577,12 +705,164 @@ public:
     }
 
 private:
+    // [D x numRepeats x T] for an input slice of D rows and T columns
+    static TensorShape RepeatedShape(const Matrix<ElemType>& sliceInput, size_t numRepeats)
+    {
+        return TensorShape(sliceInput.GetNumRows(), numRepeats, sliceInput.GetNumCols());
+    }
+
     size_t m_numRepeat;
 };
 
 template class RowRepeatNode<float>;
 template class RowRepeatNode<double>;
 
+// -----------------------------------------------------------------------
+// SpliceNeighborsNode (input) -- stack each frame with its leftContext preceding and rightContext following frames
+//
+// This is the context-window expansion that the speech readers otherwise do on the CPU (contextWindow=11 etc.),
+// done on the device instead, so that only raw frames need to be read and transferred.
+// Frames beyond a sequence boundary are replaced by the first/last frame of the sequence, as in the readers.
+// Output column t is [x(t-leftContext); ...; x(t); ...; x(t+rightContext)].
+// The input must be in sequence (utterance) mode for the neighbors to be meaningful; in frame mode every frame
+// is its own sequence, and all blocks are copies of the frame itself.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class SpliceNeighborsNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<1>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"SpliceNeighbors";
+    }
+
+public:
+    SpliceNeighborsNode(DEVICEID_TYPE deviceId, const wstring& name, size_t leftContext = 0, size_t rightContext = 0)
+        : Base(deviceId, name),
+          m_leftContext(leftContext),
+          m_rightContext(rightContext)
+    {
+    }
+    SpliceNeighborsNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : SpliceNeighborsNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"leftContext"), configp->Get(L"rightContext"))
+    {
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<SpliceNeighborsNode<ElemType>>(nodeP);
+            node->m_leftContext = m_leftContext;
+            node->m_rightContext = m_rightContext;
+        }
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_leftContext << m_rightContext;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_leftContext >> m_rightContext;
+    }
+
+    virtual void PrintSelfBeforeValidation() const override
+    {
+        Base::PrintSelfBeforeValidation();
+        fprintf(stderr, ", leftContext=%lu, rightContext=%lu", m_leftContext, m_rightContext);
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase();
+
+        if (isFinalValidationPass && !HasMBLayout())
+            InvalidArgument("%ls %ls operation requires minibatch data (with a layout) as its input.", NodeName().c_str(), OperationName().c_str());
+
+        SetDims(TensorShape(Input(0)->GetSampleLayout().GetNumElements() * GetNumBlocks()), HasMBLayout());
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        UpdateSourceColumns();
+        ValueAsMatrix().AssignRowStackedColumnsOf(Input(0)->ValueAsMatrix(), *m_sourceColumns);
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t /*inputIndex*/) override
+    {
+        Input(0)->GradientAsMatrix().AddFromRowStackedColumnsOf(GradientAsMatrix(), *m_sourceColumns);
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return false;
+    }
+
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override
+    {
+        return false;
+    }
+
+private:
+    size_t GetNumBlocks() const
+    {
+        return m_leftContext + 1 + m_rightContext;
+    }
+
+    // determine the input column of every block of every output column, from the MBLayout
+    void UpdateSourceColumns()
+    {
+        const size_t S = GetMBLayout()->GetNumParallelSequences();
+        const size_t T = GetMBLayout()->GetNumTimeSteps();
+        const size_t K = GetNumBlocks();
+
+        // gaps and anything not covered by a sequence refer to themselves
+        m_sourceColumnsBuffer.resize(K * S * T);
+        for (size_t j = 0; j < S * T; j++)
+            for (size_t k = 0; k < K; k++)
+                m_sourceColumnsBuffer[j * K + k] = (ElemType) j;
+
+        for (const auto& seq : GetMBLayout()->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            // the part of the sequence within this minibatch
+            const ptrdiff_t tFirst = max(seq.tBegin, (ptrdiff_t) 0);
+            const ptrdiff_t tLast = (ptrdiff_t) min(seq.tEnd, T) - 1;
+            for (ptrdiff_t t = tFirst; t <= tLast; t++)
+            {
+                const size_t j = t * S + seq.s;
+                for (size_t k = 0; k < K; k++)
+                {
+                    const ptrdiff_t tSource = min(max(t - (ptrdiff_t) m_leftContext + (ptrdiff_t) k, tFirst), tLast);
+                    m_sourceColumnsBuffer[j * K + k] = (ElemType)(tSource * S + seq.s);
+                }
+            }
+        }
+
+        if (!m_sourceColumns)
+            m_sourceColumns = make_shared<Matrix<ElemType>>(m_deviceId);
+        m_sourceColumns->SetValue(K, S * T, m_deviceId, m_sourceColumnsBuffer.data(), matrixFlagNormal);
+    }
+
+    size_t m_leftContext;
+    size_t m_rightContext;
+    shared_ptr<Matrix<ElemType>> m_sourceColumns; // [k, j] input column of block k of output column j
+    std::vector<ElemType> m_sourceColumnsBuffer;  // CPU-side copy of m_sourceColumns
+};
+
+template class SpliceNeighborsNode<float>;
+template class SpliceNeighborsNode<double>;
+
 // -----------------------------------------------------------------------
 // DiagonalNode -- extract diagonal elements of a square matrix into a row vector
 // -----------------------------------------------------------------------
@@ -72,6 +72,11 @@ public:
         break;
         case 1:
         {
+            if (SharesParametersAcrossSamples())
+            {
+                BackpropToSharedMean(Input(1)->Gradient(), sliceGradientValue, Input(1)->Value(), Input(3)->ValueFor(fr), *m_stddev, slicePosterior, *m_temp, *m_componentTemp);
+                break;
+            }
             Matrix<ElemType> sliceNormedDeviationVectors = DataFor(*m_normedDeviationVectors, fr);
             if (colsPrior == 1)
                 BackpropToMean(Input(1)->Gradient(), sliceGradientValue, sliceNormedDeviationVectors, slicePosterior, *m_temp);
@@ -96,8 +101,13 @@ public:
         break;
         case 3:
         {
-            Matrix<ElemType> sliceNormedDeviationVectors = DataFor(*m_normedDeviationVectors, fr);
             Matrix<ElemType> sliceFeatureGradient = Input(3)->GradientFor(fr);
+            if (SharesParametersAcrossSamples())
+            {
+                BackpropToFeatureWithSharedParameters(sliceFeatureGradient, sliceGradientValue, Input(1)->Value(), Input(3)->ValueFor(fr), *m_stddev, slicePosterior, *m_temp, *m_componentTemp);
+                break;
+            }
+            Matrix<ElemType> sliceNormedDeviationVectors = DataFor(*m_normedDeviationVectors, fr);
             BackpropToFeature(sliceFeatureGradient, sliceGradientValue, sliceNormedDeviationVectors, slicePosterior, *m_temp);
         }
         break;
@@ -115,10 +125,17 @@ public:
 
     virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override
     {
-        // The GMMLogLikelihoodNode does not require any of it's input's values for computing
-        // the gradients of its input nodes
-        UNREFERENCED_PARAMETER(childIndex);
-        return false;
+        // With per-sample parameters, the GMMLogLikelihoodNode does not require any of it's input's values for computing
+        // the gradients of its input nodes. With shared ones, the means and features take the place of normedDeviationVectors.
+        return SharesParametersAcrossSamples() && (childIndex == 1 || childIndex == 3);
+    }
+
+    // whether unnormedPrior, means, and logStdDevs are single columns (e.g. model parameters) rather than computed per sample
+    // Then the squared distances of all samples to all means are computed with one GEMM, and the gradients w.r.t. means and
+    // features with one or two more, without materializing the (x-u_c)/(stddev^2) vectors of all components and samples.
+    bool SharesParametersAcrossSamples() const
+    {
+        return !Input(0)->HasMBLayout();
     }
 
     void BackpropToUnnormedPrior(Matrix<ElemType>& unnormedPriorGradientValues, const Matrix<ElemType>& gradientValues,
@@ -198,6 +215,53 @@ public:
             featureGradientValues.AddWithRowSliceValuesOf(temp, i * featureSize, featureSize);
     }
 
+    // means (featureDim * numComponent x 1) is viewed as the matrix U [featureDim x numComponent] of the means, the posteriors
+    // weighted by the gradient and divided by the variances are V [numComponent x numSamples]. The mean gradient is then
+    //   sum_t V(c,t) (x_t - u_c) = X V^T - U diag(V 1)
+    void BackpropToSharedMean(Matrix<ElemType>& meanGradientValues, const Matrix<ElemType>& gradientValues, const Matrix<ElemType>& mean, const Matrix<ElemType>& feature,
+                              const Matrix<ElemType>& stddev, const Matrix<ElemType>& posterior, Matrix<ElemType>& temp, Matrix<ElemType>& componentTemp)
+    {
+        size_t numComponent = posterior.GetNumRows();
+        size_t numSamples = posterior.GetNumCols();
+        size_t featureSize = feature.GetNumRows();
+
+        AssignWeightedPosterior(temp, gradientValues, stddev, posterior); // temp <-- V
+
+        Matrix<ElemType> meanGradients = meanGradientValues.Reshaped(featureSize, numComponent);
+        Matrix<ElemType>::MultiplyAndAdd(feature, false, temp, true, meanGradients); // += X V^T
+        Matrix<ElemType>::Multiply(ConstOnes(1, numSamples, temp.GetDeviceId()), false, temp, true, componentTemp); // V 1, as a row vector
+
+        temp.SetValue(mean.Reshaped(featureSize, numComponent));
+        temp.RowElementMultiplyWith(componentTemp);
+        meanGradients -= temp; // -= U diag(V 1)
+    }
+
+    // the feature gradient is sum_c V(c,t) (u_c - x_t) = U V - X diag(1^T V) (see BackpropToSharedMean())
+    void BackpropToFeatureWithSharedParameters(Matrix<ElemType>& featureGradientValues, const Matrix<ElemType>& gradientValues, const Matrix<ElemType>& mean, const Matrix<ElemType>& feature,
+                                               const Matrix<ElemType>& stddev, const Matrix<ElemType>& posterior, Matrix<ElemType>& temp, Matrix<ElemType>& componentTemp)
+    {
+        size_t numComponent = posterior.GetNumRows();
+        size_t featureSize = feature.GetNumRows();
+
+        AssignWeightedPosterior(temp, gradientValues, stddev, posterior); // temp <-- V
+
+        Matrix<ElemType>::MultiplyAndAdd(mean.Reshaped(featureSize, numComponent), false, temp, false, featureGradientValues); // += U V
+        Matrix<ElemType>::Multiply(ConstOnes(1, numComponent, temp.GetDeviceId()), false, temp, false, componentTemp);      // 1^T V
+
+        temp.SetValue(feature);
+        temp.RowElementMultiplyWith(componentTemp);
+        featureGradientValues -= temp; // -= X diag(1^T V)
+    }
+
+    // V <-- posterior .* gradient / stddev^2
+    static void AssignWeightedPosterior(Matrix<ElemType>& v, const Matrix<ElemType>& gradientValues, const Matrix<ElemType>& stddev, const Matrix<ElemType>& posterior)
+    {
+        v.SetValue(posterior);
+        v.RowElementMultiplyWith(gradientValues);
+        v.ColumnElementDivideBy(stddev); // divide twice
+        v.ColumnElementDivideBy(stddev);
+    }
+
     virtual void UpdateFunctionMBSize() override
     {
         Base::UpdateFunctionMBSize();
@@ -210,7 +274,8 @@ public:
         m_prior->Resize(numComponents, colsPrior);
         m_stddev->Resize(numComponents, colsPrior);
         m_normedDeviation->Resize(numComponents, numCols);
-        m_normedDeviationVectors->Resize(numComponents * featureSize, numCols);
+        if (!SharesParametersAcrossSamples()) // (not needed otherwise)
+            m_normedDeviationVectors->Resize(numComponents * featureSize, numCols);
         m_posterior->Resize(numComponents, numCols);
     }
 
@@ -224,11 +289,16 @@ public:
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
         Matrix<ElemType> sliceFeature = Input(3)->ValueFor(fr);
         Matrix<ElemType> sliceNormedDeviation = DataFor(*m_normedDeviation, fr);
-        Matrix<ElemType> sliceNormedDeviationVectors = DataFor(*m_normedDeviationVectors, fr);
         Matrix<ElemType> slicePosterior = DataFor(*m_posterior, fr);
 
-        if (colsPrior == 1)
+        if (SharesParametersAcrossSamples())
+        {
+            ForwardPropWithSharedParameters(sliceOutputValue, Input(0)->Value(), Input(1)->Value(), Input(2)->Value(), sliceFeature,
+                                            *m_prior, *m_stddev, sliceNormedDeviation, slicePosterior, *m_temp);
+        }
+        else if (colsPrior == 1)
         {
+            Matrix<ElemType> sliceNormedDeviationVectors = DataFor(*m_normedDeviationVectors, fr);
             ForwardPropS(sliceOutputValue, Input(0)->Value(), Input(1)->Value(), Input(2)->Value(), sliceFeature,
                          *m_prior, *m_stddev, sliceNormedDeviationVectors, sliceNormedDeviation, slicePosterior, *m_temp);
         }
@@ -240,6 +310,7 @@ public:
 
             Matrix<ElemType> slicePrior = DataFor(*m_prior, fr);
             Matrix<ElemType> sliceStddev = DataFor(*m_stddev, fr);
+            Matrix<ElemType> sliceNormedDeviationVectors = DataFor(*m_normedDeviationVectors, fr);
 
             ForwardPropS(sliceOutputValue, sliceUnnormedPrior, sliceMean, sliceLogstddev, sliceFeature,
                          slicePrior, sliceStddev, sliceNormedDeviationVectors, sliceNormedDeviation, slicePosterior, *m_temp);
@@ -324,6 +395,48 @@ public:
 #endif
     }
 
+    // same as ForwardPropS() for parameters shared by all samples, with ||x-u_c||^2 expanded into ||x||^2 - 2 u_c^T x + ||u_c||^2,
+    // so that the cross terms of all samples and components are one GEMM, and with a log-sum-exp over the components
+    // instead of summing up the exp'ed per-component likelihoods
+    void ForwardPropWithSharedParameters(Matrix<ElemType>& functionValues, const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& mean, const Matrix<ElemType>& logstddev,
+                                         const Matrix<ElemType>& feature, Matrix<ElemType>& prior, Matrix<ElemType>& stddev,
+                                         Matrix<ElemType>& normedDeviation, Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
+    {
+        size_t numComponent = unnormedPrior.GetNumRows();
+        size_t featureDim = feature.GetNumRows();
+        DEVICEID_TYPE deviceId = feature.GetDeviceId();
+        Matrix<ElemType> means = mean.Reshaped(featureDim, numComponent); // column c is u_c
+
+        stddev.AssignExpOf(logstddev);
+
+        // compute normedDeviation <-- ||x-u_c||^2/(stddev^2)
+        temp.AssignElementProductOf(means, means);
+        Matrix<ElemType>::Multiply(temp, true, ConstOnes(featureDim, 1, deviceId), false, prior); // ||u_c||^2 (prior is free until below)
+        Matrix<ElemType>::MultiplyAndWeightedAdd(-2, means, true, feature, false, 0, normedDeviation);
+        Matrix<ElemType>::ScaleAndAdd(1, prior, normedDeviation);
+        temp.AssignElementProductOf(feature, feature);
+        Matrix<ElemType>::Multiply(ConstOnes(1, featureDim, deviceId), false, temp, false, functionValues); // ||x||^2 (functionValues is free until below)
+        Matrix<ElemType>::MultiplyAndAdd(ConstOnes(numComponent, 1, deviceId), false, functionValues, false, normedDeviation);
+        normedDeviation.ColumnElementDivideBy(stddev); // divide twice
+        normedDeviation.ColumnElementDivideBy(stddev);
+
+        // compute per-component log likelihood + log prior <-- -||x-u_c||^2/(stddev^2)/2 - log(stddev^c) - c/2 log(2 pi) + log prior
+        prior.AssignLogSoftmaxOf(unnormedPrior, true); // log prior
+        temp.AssignProductOf(-(ElemType) numComponent, logstddev);
+        temp += prior;
+        temp += (ElemType)(-(numComponent / 2.0f) * log(TWO_PI));
+        posterior.AssignProductOf(-0.5f, normedDeviation);
+        Matrix<ElemType>::ScaleAndAdd(1, temp, posterior);
+
+        // compute posterior <-- per-comp likelihood / total likelihood, and the GMM log-likelihood, as log-sum-exp
+        temp.SetValue(posterior);
+        posterior.AssignLogSoftmaxOf(temp, true);
+        temp -= posterior;                              // each row is now the log of the total likelihood
+        functionValues.AssignRowSliceValuesOf(temp, 0, 1);
+        posterior.InplaceExp();
+        prior.InplaceExp();
+    }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -376,6 +489,13 @@ public:
         RequestMatrixFromPool(m_temp, matrixPool);
     }
 
+    // request matrices that are needed for gradient computation
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_componentTemp, matrixPool);
+    }
+
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
     {
@@ -386,6 +506,7 @@ public:
         ReleaseMatrixToPool(m_stddev, matrixPool);
         ReleaseMatrixToPool(m_posterior, matrixPool);
         ReleaseMatrixToPool(m_temp, matrixPool);
+        ReleaseMatrixToPool(m_componentTemp, matrixPool);
     }
 
 protected:
@@ -395,6 +516,7 @@ protected:
     shared_ptr<Matrix<ElemType>> m_stddev;
     shared_ptr<Matrix<ElemType>> m_posterior;
     shared_ptr<Matrix<ElemType>> m_temp;
+    shared_ptr<Matrix<ElemType>> m_componentTemp; // (a row vector; backprop with shared parameters only)
 };
 
 template class GMMLogLikelihoodNode<float>;
@@ -646,6 +768,252 @@ protected:
 template class SequenceWithSoftmaxNode<float>;
 template class SequenceWithSoftmaxNode<double>;
 
+// -----------------------------------------------------------------------
+// LatticeFreeMMINode (labels, logLikelihoods)
+// lattice-free MMI sequence training criterion: -sum over the sequences of (log numerator - log denominator), where
+//  - the numerator is the score of the label (senone) alignment, sum_t logLikelihoods(label_t, t)
+//  - the denominator is the total score of all paths through a denominator graph, an HMM over the pdfs (e.g. from a phone LM)
+// The graph is kept on the device, and all sequences of the minibatch go through one batched forward-backward
+// (Matrix::DenominatorForwardBackward()), so that no lattices are generated or read.
+// The gradient w.r.t. the log likelihoods is the denominator occupancy of each pdf minus the labels.
+//
+// The graph is read from denominatorGraph, an OpenFst text file as written by 'fstprint' (e.g. of a Kaldi chain den.fst):
+//     source destination ilabel olabel [cost]   an arc that emits pdf ilabel-1, with weight exp(-cost)
+//     state [cost]                               a final state
+// The start state is the source of the first arc; if there are no final states, all states are final.
+// The graph is saved with the model.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class LatticeFreeMMINode : public ComputationNodeNonLooping<ElemType>, public NumInputs<2>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"LatticeFreeMMI";
+    }
+
+public:
+    LatticeFreeMMINode(DEVICEID_TYPE deviceId, const wstring& name, const wstring& denominatorGraph = L"")
+        : Base(deviceId, name),
+          m_numPdfs(0),
+          m_graphArcs(deviceId),
+          m_graphStates(deviceId),
+          m_alpha(deviceId),
+          m_beta(deviceId),
+          m_posteriors(deviceId),
+          m_logDenominators(deviceId),
+          m_sequences(deviceId),
+          m_maskedLogLikelihoods(deviceId),
+          m_numerator(deviceId)
+    {
+        if (!denominatorGraph.empty())
+            ReadDenominatorGraph(denominatorGraph);
+    }
+    LatticeFreeMMINode(const ScriptableObjects::IConfigRecordPtr configp)
+        : LatticeFreeMMINode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"denominatorGraph"))
+    {
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<LatticeFreeMMINode<ElemType>>(nodeP);
+            node->m_arcs = m_arcs;
+            node->m_states = m_states;
+            node->m_numPdfs = m_numPdfs;
+        }
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_arcs << m_states << m_numPdfs;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_arcs >> m_states >> m_numPdfs;
+        m_graphArcs.Resize(4, 0); // upload again
+    }
+
+    virtual void PrintSelfBeforeValidation() const override
+    {
+        Base::PrintSelfBeforeValidation();
+        fprintf(stderr, ", denominator graph with %d states and %d arcs", (int) (m_states.size() / 4 - 1), (int) (m_arcs.size() / 8));
+    }
+
+    // -sum over sequences of (log numerator - log denominator)
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(Input(0)->GetMBLayout());
+        if (m_graphArcs.GetNumCols() * 4 != m_arcs.size() || m_graphArcs.GetDeviceId() != m_deviceId)
+            UploadDenominatorGraph();
+
+        GetSequenceBoundsAsMatrix(Input(0)->GetMBLayout(), m_sequences, m_sequencesBuffer);
+        Matrix<ElemType>::DenominatorForwardBackward(Input(1)->ValueFor(fr), m_graphArcs, m_graphStates, m_alpha, m_beta, m_posteriors, m_logDenominators,
+                                                     m_sequences, Input(0)->GetNumParallelSequences());
+
+        // the numerator is the score of the labels, without the gaps
+        m_maskedLogLikelihoods.SetValue(Input(1)->ValueFor(fr));
+        MaskMissingColumnsToZero(m_maskedLogLikelihoods, Input(0)->GetMBLayout(), fr);
+        m_numerator.AssignInnerProductOfMatrices(Input(0)->ValueFor(fr), m_maskedLogLikelihoods);
+
+        Value().AssignSumOfElements(m_logDenominators);
+        Value() -= m_numerator;
+#if NANCHECK
+        Value().HasNan("LatticeFreeMMI");
+#endif
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        FrameRange fr(Input(0)->GetMBLayout());
+        // inputIndex 0 should not get us here, it should be prevented by the needGradient flag of input[0]
+        if (inputIndex != 1)
+            InvalidArgument("%ls %ls operation only takes the gradient w.r.t. the log likelihoods.", NodeName().c_str(), OperationName().c_str());
+
+        auto gradient = Input(1)->GradientFor(fr);
+        Matrix<ElemType>::AddScaledDifference(Gradient(), m_posteriors, Input(0)->ValueFor(fr), gradient);
+        Input(1)->MaskMissingGradientColumnsToZero(fr);
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return false;
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+        if (isFinalValidationPass)
+        {
+            if (Input(0)->GetSampleMatrixNumRows() != Input(1)->GetSampleMatrixNumRows() || !Input(0)->HasMBLayout() || Input(0)->GetMBLayout() != Input(1)->GetMBLayout())
+                LogicError("%ls %ls operation requires labels and log likelihoods of the same dimension and layout.", NodeName().c_str(), OperationName().c_str());
+            if (m_arcs.empty())
+                InvalidArgument("%ls %ls operation requires a denominator graph (denominatorGraph).", NodeName().c_str(), OperationName().c_str());
+            if (m_numPdfs > Input(1)->GetSampleMatrixNumRows())
+                InvalidArgument("%ls %ls operation: the denominator graph has %d pdfs, but the log likelihoods have %d rows.",
+                                NodeName().c_str(), OperationName().c_str(), (int) m_numPdfs, (int) Input(1)->GetSampleMatrixNumRows());
+        }
+
+        SetDims(TensorShape(1), false);
+    }
+
+private:
+    void ReadDenominatorGraph(const wstring& path)
+    {
+        struct Arc
+        {
+            size_t src, dst, pdf;
+            float logWeight;
+        };
+        vector<Arc> arcs;
+        vector<pair<size_t, float>> finals;
+        size_t numStates = 0;
+
+        File file(path, fileOptionsRead | fileOptionsText);
+        vector<string> lines;
+        file.GetLines(lines);
+        for (const auto& line : lines)
+        {
+            auto fields = msra::strfun::split(line, " \t");
+            if (fields.empty())
+                continue;
+            if (fields.size() == 4 || fields.size() == 5)
+            {
+                const size_t ilabel = (size_t) atoi(fields[2].c_str());
+                if (ilabel == 0)
+                    RuntimeError("LatticeFreeMMI: denominator graph '%ls' has an epsilon arc, which is not supported.", path.c_str());
+                Arc arc = {(size_t) atoi(fields[0].c_str()), (size_t) atoi(fields[1].c_str()), ilabel - 1, fields.size() == 5 ? (float) -atof(fields[4].c_str()) : 0.0f};
+                arcs.push_back(arc);
+                numStates = max(numStates, max(arc.src, arc.dst) + 1);
+            }
+            else if (fields.size() <= 2)
+            {
+                finals.push_back(make_pair((size_t) atoi(fields[0].c_str()), fields.size() == 2 ? (float) -atof(fields[1].c_str()) : 0.0f));
+                numStates = max(numStates, finals.back().first + 1);
+            }
+            else
+                RuntimeError("LatticeFreeMMI: denominator graph '%ls' has an invalid line: %s", path.c_str(), line.c_str());
+        }
+        if (arcs.empty())
+            RuntimeError("LatticeFreeMMI: denominator graph '%ls' has no arcs.", path.c_str());
+
+        // states: (first in-arc, first out-arc, log initial weight, log final weight)
+        m_states.assign(4 * (numStates + 1), 0);
+        for (size_t k = 0; k <= numStates; k++)
+        {
+            m_states[4 * k + 2] = (float) LZERO;
+            m_states[4 * k + 3] = finals.empty() ? 0.0f : (float) LZERO;
+        }
+        m_states[4 * arcs[0].src + 2] = 0;
+        for (const auto& finalState : finals)
+            m_states[4 * finalState.first + 3] = finalState.second;
+
+        // arcs: (source, destination, pdf, log weight), sorted by destination and then by source
+        m_arcs.resize(8 * arcs.size());
+        m_numPdfs = 0;
+        for (int bySource = 0; bySource < 2; bySource++)
+        {
+            stable_sort(arcs.begin(), arcs.end(), [bySource](const Arc& a, const Arc& b)
+                        {
+                            return bySource ? a.src < b.src : a.dst < b.dst;
+                        });
+            float* out = m_arcs.data() + 4 * arcs.size() * bySource;
+            size_t a = 0;
+            for (size_t k = 0; k <= numStates; k++)
+            {
+                while (a < arcs.size() && (bySource ? arcs[a].src : arcs[a].dst) < k)
+                    a++;
+                m_states[4 * k + bySource] = (float) a;
+            }
+            for (size_t i = 0; i < arcs.size(); i++)
+            {
+                out[4 * i + 0] = (float) arcs[i].src;
+                out[4 * i + 1] = (float) arcs[i].dst;
+                out[4 * i + 2] = (float) arcs[i].pdf;
+                out[4 * i + 3] = arcs[i].logWeight;
+                m_numPdfs = max(m_numPdfs, arcs[i].pdf + 1);
+            }
+        }
+    }
+
+    void UploadDenominatorGraph()
+    {
+        vector<ElemType> arcs(m_arcs.begin(), m_arcs.end());
+        vector<ElemType> states(m_states.begin(), m_states.end());
+        m_graphArcs.SetValue(4, arcs.size() / 4, m_deviceId, arcs.data());
+        m_graphStates.SetValue(4, states.size() / 4, m_deviceId, states.data());
+    }
+
+    // the denominator graph, see Matrix::DenominatorForwardBackward()
+    vector<float> m_arcs;   // [4 x 2*numArcs] host copy, as saved with the model
+    vector<float> m_states; // [4 x (numStates + 1)]
+    size_t m_numPdfs;
+    Matrix<ElemType> m_graphArcs;
+    Matrix<ElemType> m_graphStates;
+
+    Matrix<ElemType> m_alpha;
+    Matrix<ElemType> m_beta;
+    Matrix<ElemType> m_posteriors;      // [numPdfs x T] denominator occupancies
+    Matrix<ElemType> m_logDenominators; // [0, j] log denominator of sequence j
+    Matrix<ElemType> m_sequences;       // (parallel sequence, first, end time step) of every sequence in the minibatch
+    std::vector<ElemType> m_sequencesBuffer;
+    Matrix<ElemType> m_maskedLogLikelihoods;
+    Matrix<ElemType> m_numerator;
+};
+
+template class LatticeFreeMMINode<float>;
+template class LatticeFreeMMINode<double>;
+
 
 // -----------------------------------------------------------------------
 /// DummyCriterionNode (objectives, derivatives, prediction)
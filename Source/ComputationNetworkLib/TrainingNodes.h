@@ -14,6 +14,8 @@
 #include <stdexcept>
 #include <list>
 #include <memory>
+#include <queue>
+#include <random>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -138,14 +140,14 @@ public:
         // left input is scalar
         if (inputIndex == 0) // left derivative
         {
-#if DUMPOUTPUT
-            *m_logSoftmaxOfRight.Print("CrossEntropyWithSoftmax Partial-logSoftmaxOfRight");
-            Gradient().Print("CrossEntropyWithSoftmax Partial-gradientValues");
-            Input(0)->GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Left-in");
-#endif
-
+            if (HasIndexLabels() || Input(0)->Value().GetMatrixType() == SPARSE)
+                InvalidArgument("%ls %ls operation: labels given as class indices or as a sparse matrix have no gradient.", NodeName().c_str(), OperationName().c_str());
+            // (the labels rarely need a gradient, so their log softmax is not kept but computed here)
+            Matrix<ElemType> logSoftmaxOfRight(Input(1)->Value().GetDeviceId());
+            logSoftmaxOfRight.AssignLogSoftmaxOf(Input(1)->ValueFor(fr), true);
+            MaskMissingColumnsToZero(logSoftmaxOfRight, Input(1)->GetMBLayout(), fr);
             auto gradient = Input(0)->GradientFor(fr);
-            Matrix<ElemType>::Multiply1x1AndWeightedAdd(-1.0f, Gradient() /*1x1*/, *m_logSoftmaxOfRight, 1.0f, gradient);
+            Matrix<ElemType>::Multiply1x1AndWeightedAdd(-1.0f, Gradient() /*1x1*/, logSoftmaxOfRight, 1.0f, gradient);
 #if DUMPOUTPUT
             Input(0)->GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Left-out");
 #endif
@@ -154,14 +156,17 @@ public:
         else if (inputIndex == 1) // right derivative
         {
 #if DUMPOUTPUT
-            *m_softmaxOfRight.Print("CrossEntropyWithSoftmax Partial-softmaxOfRight");
             Input(0)->ValueFor(fr).Print("CrossEntropyWithSoftmax Partial-inputFunctionValues");
             Gradient().Print("CrossEntropyWithSoftmax Partial-gradientValues");
             Input(1)->GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Right-in");
 #endif
 
+            // gradient += (softmax - labels) * outputGradient, with the softmax recomputed from the column statistics of forward prop
             auto gradient = Input(1)->GradientFor(fr);
-            Matrix<ElemType>::AddScaledDifference(Gradient(), *m_softmaxOfRight, Input(0)->ValueFor(fr), gradient);
+            if (Input(0)->Value().GetMatrixType() == SPARSE) // (converted to indices by forward prop)
+                Matrix<ElemType>::SoftmaxCrossEntropyBackprop(Gradient(), *m_labelIndices, Input(1)->ValueFor(fr), *m_columnStats, gradient);
+            else
+                Matrix<ElemType>::SoftmaxCrossEntropyBackprop(Gradient(), Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), *m_columnStats, gradient);
 #if DUMPOUTPUT
             Input(1)->GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Right");
 #endif
@@ -176,25 +181,27 @@ public:
         return false;
     }
 
-    virtual void UpdateFunctionMBSize() override
-    {
-        m_logSoftmaxOfRight->Resize(Input(1)->Value());
-        m_softmaxOfRight->Resize(*m_logSoftmaxOfRight);
-    }
-
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override // -sum(left_i * log(softmax_i(right)))
     {
         FrameRange fr(Input(0)->GetMBLayout());
-        // first compute the softmax (column-wise)
-        // Note that we need both log and non-log for gradient computation.
-        m_logSoftmaxOfRight->AssignLogSoftmaxOf(Input(1)->ValueFor(fr), true);
-        m_softmaxOfRight->SetValue(*m_logSoftmaxOfRight);
-        m_softmaxOfRight->InplaceExp();
-        // flatten all gaps to zero, such that gaps will contribute zero to the sum
-        MaskMissingColumnsToZero(*m_logSoftmaxOfRight, Input(1)->GetMBLayout(), fr);
+        // softmax (column-wise) and cross entropy in one pass, keeping only each column's max and log sum of exp for backprop
+        // Gaps have masked (zero) labels and thus contribute zero to the sum. Labels may also be class indices, whose gaps are
+        // masked to -1, or sparse one-hot columns, which are turned into indices (their gaps are empty columns); either way the
+        // target is gathered rather than multiplied with the prediction.
+        if (Input(0)->Value().GetMatrixType() == SPARSE)
+        {
+            m_labelIndices->AssignOneHotIndicesOf(Input(0)->ValueFor(fr));
+            Matrix<ElemType>::SoftmaxCrossEntropy(*m_labelIndices, Input(1)->ValueFor(fr), *m_columnStats);
+        }
+        else if (HasIndexLabels())
+        {
+            MaskMissingColumnsTo(Input(0)->Value(), Input(0)->GetMBLayout(), fr, (ElemType) -1);
+            Matrix<ElemType>::SoftmaxCrossEntropy(Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), *m_columnStats);
+        }
+        else
+            Matrix<ElemType>::SoftmaxCrossEntropy(Input(0)->MaskedValueFor(fr), Input(1)->ValueFor(fr), *m_columnStats);
         // reduce over all frames
-        Value().AssignInnerProductOfMatrices(Input(0)->MaskedValueFor(fr), *m_logSoftmaxOfRight);
-        Value() *= -1;
+        Value().AssignSumOfElements(m_columnStats->ColumnSlice(2, 1));
 #if NANCHECK
         Value().HasNan("CrossEntropyWithSoftmax");
 #endif
@@ -205,7 +212,7 @@ public:
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
-        ValidateBinaryReduce(isFinalValidationPass);
+        ValidateBinaryReduce(isFinalValidationPass, /*allowIndexLabels=*/true);
     }
 
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
@@ -214,8 +221,8 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CrossEntropyWithSoftmaxNode<ElemType>>(nodeP);
-            *node->m_logSoftmaxOfRight = *m_logSoftmaxOfRight;
-            *node->m_softmaxOfRight = *m_softmaxOfRight;
+            *node->m_columnStats = *m_columnStats;
+            *node->m_labelIndices = *m_labelIndices;
         }
     }
 
@@ -223,13 +230,23 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool);
-        RequestMatrixFromPool(m_softmaxOfRight, matrixPool);
+        RequestMatrixFromPool(m_columnStats, matrixPool);
+        RequestMatrixFromPool(m_labelIndices, matrixPool);
+    }
+
+    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_columnStats, matrixPool);
+        ReleaseMatrixToPool(m_labelIndices, matrixPool);
     }
 
 protected:
-    shared_ptr<Matrix<ElemType>> m_logSoftmaxOfRight;
-    shared_ptr<Matrix<ElemType>> m_softmaxOfRight;
+    // [T x 3]: max and log sum of exp of each column of the prediction, and its cross entropy (see Matrix::SoftmaxCrossEntropy())
+    shared_ptr<Matrix<ElemType>> m_columnStats;
+    // [1 x T]: the class indices of sparse labels
+    shared_ptr<Matrix<ElemType>> m_labelIndices;
 };
 
 template class CrossEntropyWithSoftmaxNode<float>;
@@ -695,6 +712,535 @@ private:
 template class NoiseContrastiveEstimationNode<float>;
 template class NoiseContrastiveEstimationNode<double>;
 
+// -----------------------------------------------------------------------
+// SampledSoftmaxNode (labels, hidden, weights, bias)
+// Cross entropy of a softmax over the label and numSamples words drawn from a proposal distribution,
+// for training output layers over large vocabularies without computing every word's score.
+//  - Input(0) [vocab_size x T] labels, one-hot (preferably sparse)
+//  - Input(1) [hdsize x T] hidden layer activation
+//  - Input(2) [hdsize x vocab_size] output embedding; word w scores weights(:,w)' * hidden + bias(w)
+//  - Input(3) [vocab_size x 1] bias
+// The samples are shared by all frames of the minibatch and drawn with replacement from
+//  - "logUniform": P(w) = log((w + 2) / (w + 1)) / log(vocab_size + 1), for word ids sorted by decreasing frequency, or
+//  - "unigram": the counts in unigramFile (one per line, in word-id order; counts below 1 are taken as 1).
+// All scores are corrected by the log of the expected number of times the word is drawn (Jean et al., 2015).
+// The embedding columns and biases of the labels and samples are gathered with a single sparse selection matrix,
+// whose transpose also scatters their gradients, so the embedding gradient only has those columns (matrixFormatSparseBlockCol).
+// The value estimates the training criterion only; the perplexity needs a full softmax over the same parameters.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class SampledSoftmaxNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<4>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"SampledSoftmax";
+    }
+
+public:
+    SampledSoftmaxNode(DEVICEID_TYPE deviceId, const wstring& name, size_t numSamples = 1, const wstring& samplingDistribution = L"logUniform", const wstring& unigramFile = L"")
+        : Base(deviceId, name),
+          m_numSamples(numSamples),
+          m_samplingDistribution(samplingDistribution),
+          m_logExpectedCounts(deviceId),
+          m_wordIds(deviceId),
+          m_labelIds(deviceId),
+          m_selection(0, 0, deviceId, SPARSE, matrixFormatSparseCSC),
+          m_selectedWeights(deviceId),
+          m_selectedBias(deviceId),
+          m_adjustedBias(deviceId),
+          m_labelLogits(deviceId),
+          m_sampleLogits(deviceId),
+          m_logSoftmax(deviceId),
+          m_gradLogits(deviceId),
+          m_gradLabelLogits(deviceId),
+          m_gradSampleLogits(deviceId),
+          m_gradSelected(deviceId),
+          m_temp(deviceId),
+          m_needRecomputeGradients(false)
+    {
+        m_randomSeed = (unsigned long) CreateUniqId();
+        if (m_samplingDistribution == L"unigram")
+            ReadUnigramCounts(unigramFile);
+        else if (m_samplingDistribution != L"logUniform")
+            InvalidArgument("SampledSoftmax: samplingDistribution must be 'logUniform' or 'unigram'.");
+    }
+    SampledSoftmaxNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : SampledSoftmaxNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"numSamples"), configp->Get(L"samplingDistribution"), configp->Get(L"unigramFile"))
+    {
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<SampledSoftmaxNode<ElemType>>(nodeP);
+            node->m_numSamples = m_numSamples;
+            node->m_samplingDistribution = m_samplingDistribution;
+            node->m_unigramProbs = m_unigramProbs;
+            node->m_randomSeed = m_randomSeed;
+        }
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_numSamples << m_samplingDistribution << m_unigramProbs;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_numSamples >> m_samplingDistribution >> m_unigramProbs;
+    }
+
+    virtual void PrintSelfBeforeValidation() const override
+    {
+        Base::PrintSelfBeforeValidation();
+        fprintf(stderr, ", numSamples=%lu, samplingDistribution=%ls", m_numSamples, m_samplingDistribution.c_str());
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        if (inputIndex == 0)
+            InvalidArgument("%ls %ls operation cannot compute the gradient with respect to the labels.", NodeName().c_str(), OperationName().c_str());
+
+        FrameRange fr(Input(0)->GetMBLayout());
+        const size_t numFrames = m_logSoftmax.GetNumCols();
+        if (m_needRecomputeGradients)
+        {
+            // gradient with respect to the scores: softmax minus the label (row 0), zero in gaps, times our gradient
+            m_gradLogits.AssignExpOf(m_logSoftmax);
+            m_temp.Resize(1, numFrames);
+            m_temp.SetValue(-1);
+            m_gradLogits.AddToRowSliceValuesOf(m_temp, 0, 1);
+            MaskMissingColumnsToZero(m_gradLogits, Input(0)->GetMBLayout(), fr);
+            Matrix<ElemType>::Multiply1x1AndWeightedAdd(+1.0f, Gradient() /*1x1*/, m_gradLogits, 0.0f, m_gradLogits);
+            m_gradLabelLogits.AssignRowSliceValuesOf(m_gradLogits, 0, 1);
+            m_gradSampleLogits.AssignRowSliceValuesOf(m_gradLogits, 1, m_numSamples);
+            m_needRecomputeGradients = false;
+        }
+
+        if (inputIndex == 1) // hidden: the selected embedding columns weighted by the gradients of their scores
+        {
+            auto hiddenGrad = Input(1)->GradientFor(fr);
+            m_temp.SetValue(m_selectedWeights.ColumnSlice(0, numFrames));
+            m_temp.RowElementMultiplyWith(m_gradLabelLogits);
+            hiddenGrad += m_temp;
+            Matrix<ElemType>::MultiplyAndAdd(m_selectedWeights.ColumnSlice(numFrames, m_numSamples), false, m_gradSampleLogits, false, hiddenGrad);
+        }
+        else if (inputIndex == 2) // embedding: gradients of the selected columns, scattered back by the selection matrix
+        {
+            auto hidden = Input(1)->ValueFor(fr);
+            m_gradSelected.Resize(hidden.GetNumRows(), numFrames + m_numSamples);
+            m_gradSelected.SetColumnSlice(hidden, 0, numFrames);
+            auto gradLabelColumns = m_gradSelected.ColumnSlice(0, numFrames);
+            gradLabelColumns.RowElementMultiplyWith(m_gradLabelLogits);
+            auto gradSampleColumns = m_gradSelected.ColumnSlice(numFrames, m_numSamples);
+            Matrix<ElemType>::Multiply(hidden, false, m_gradSampleLogits, true, gradSampleColumns);
+            Matrix<ElemType>::MultiplyAndAdd(m_gradSelected, false, m_selection, true, Input(2)->GradientAsMatrix());
+        }
+        else // bias: the same for the sums of the score gradients
+        {
+            m_gradSelected.Resize(1, numFrames + m_numSamples);
+            m_gradSelected.SetColumnSlice(m_gradLabelLogits, 0, numFrames);
+            Matrix<ElemType>::VectorSum(m_gradSampleLogits, m_temp, false);
+            m_gradSelected.SetColumnSlice(m_temp.Reshaped(1, m_numSamples), numFrames, m_numSamples);
+            auto biasGrad = Input(3)->GradientAsMatrix().Reshaped(1, Input(3)->GetAsMatrixNumRows());
+            Matrix<ElemType>::MultiplyAndAdd(m_gradSelected, false, m_selection, true, biasGrad);
+        }
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return false;
+    }
+
+    virtual void UpdateFunctionMBSize() override
+    {
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(Input(0)->GetMBLayout());
+        const size_t vocabSize = Input(0)->GetSampleMatrixNumRows();
+        if (m_logExpectedCounts.GetNumRows() != vocabSize)
+            InitProposalDistribution(vocabSize);
+
+        auto labels = Input(0)->ValueFor(fr);
+        auto hidden = Input(1)->ValueFor(fr);
+        const size_t numFrames = labels.GetNumCols();
+
+        // selection matrix: columns 0..numFrames-1 pick the labels (word 0 for gaps, which are masked below), the rest the samples
+        m_labelIds.AssignProductOf(m_wordIds, true, labels, false);
+        std::unique_ptr<ElemType[]> labelIds(m_labelIds.CopyToArray());
+        const size_t numSelected = numFrames + m_numSamples;
+        m_selectionColStarts.resize(numSelected + 1);
+        m_selectionRowIndices.resize(numSelected);
+        m_selectionValues.assign(numSelected, 1);
+        for (size_t t = 0; t < numFrames; t++)
+            m_selectionRowIndices[t] = (CPUSPARSE_INDEX_TYPE) min((size_t)(labelIds[t] + 0.5f), vocabSize - 1);
+        std::mt19937 engine(m_randomSeed);
+        m_randomSeed += 1073807359; // (as in DropoutNode)
+        for (size_t s = 0; s < m_numSamples; s++)
+            m_selectionRowIndices[numFrames + s] = (CPUSPARSE_INDEX_TYPE) DrawSample(engine, vocabSize);
+        for (size_t j = 0; j <= numSelected; j++)
+            m_selectionColStarts[j] = (CPUSPARSE_INDEX_TYPE) j;
+        m_selection.SetMatrixFromCSCFormat(m_selectionColStarts.data(), m_selectionRowIndices.data(), m_selectionValues.data(), numSelected, vocabSize, numSelected);
+
+        // gather the embedding columns and the corrected biases of the labels and samples
+        m_selectedWeights.AssignProductOf(Input(2)->ValueAsMatrix(), false, m_selection, false);
+        m_adjustedBias.AssignDifferenceOf(Input(3)->ValueAsMatrix(), m_logExpectedCounts);
+        m_selectedBias.AssignProductOf(m_adjustedBias, true, m_selection, false);
+
+        // scores of the label [1 x T] and of the samples [numSamples x T]
+        m_labelLogits.AssignInnerProductOf(m_selectedWeights.ColumnSlice(0, numFrames), hidden, true);
+        m_labelLogits += m_selectedBias.ColumnSlice(0, numFrames);
+        m_sampleLogits.AssignProductOf(m_selectedWeights.ColumnSlice(numFrames, m_numSamples), true, hidden, false);
+        Matrix<ElemType>::ScaleAndAdd(1, m_selectedBias.ColumnSlice(numFrames, m_numSamples).Reshaped(m_numSamples, 1), m_sampleLogits);
+
+        // -sum_t log softmax(label)
+        m_logSoftmax.Resize(1 + m_numSamples, numFrames);
+        m_logSoftmax.AssignToRowSliceValuesOf(m_labelLogits, 0, 1);
+        m_logSoftmax.AssignToRowSliceValuesOf(m_sampleLogits, 1, m_numSamples);
+        m_logSoftmax.InplaceLogSoftmax(true);
+        MaskMissingColumnsToZero(m_logSoftmax, Input(0)->GetMBLayout(), fr);
+        m_labelLogits.AssignRowSliceValuesOf(m_logSoftmax, 0, 1);
+        Value().AssignSumOfElements(m_labelLogits);
+        Value() *= -1;
+        m_needRecomputeGradients = true;
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+        if (isFinalValidationPass)
+        {
+            if (!Input(0)->HasMBLayout() || !Input(1)->HasMBLayout() || Input(2)->HasMBLayout() || Input(3)->HasMBLayout())
+                LogicError("%ls %ls operation requires inputs 0 and 1 to be a minibatch, and inputs 2 and 3 to be a matrix.", NodeName().c_str(), OperationName().c_str());
+            const size_t vocabSize = Input(0)->GetSampleMatrixNumRows();
+            if (Input(2)->GetAsMatrixNumRows() != Input(1)->GetSampleMatrixNumRows() || Input(2)->GetAsMatrixNumCols() != vocabSize)
+                LogicError("%ls %ls operation: the weights must be [%d x %d] for the hidden and label dimensions.", NodeName().c_str(), OperationName().c_str(), (int) Input(1)->GetSampleMatrixNumRows(), (int) vocabSize);
+            if (Input(3)->GetAsMatrixNumRows() != vocabSize || Input(3)->GetAsMatrixNumCols() != 1)
+                LogicError("%ls %ls operation: the bias must be a [%d x 1] column vector.", NodeName().c_str(), OperationName().c_str(), (int) vocabSize);
+            if (m_numSamples == 0)
+                InvalidArgument("%ls %ls operation: numSamples must not be 0.", NodeName().c_str(), OperationName().c_str());
+        }
+
+        SetDims(TensorShape(1), false);
+    }
+
+    virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        // only the embedding columns of labels and samples get a gradient, as for the embedding of a LookupTableNode with sparse input
+        if (Input(2)->NeedGradient())
+        {
+            Input(2)->CreateGradientMatrixIfNull();
+            Input(2)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+        }
+
+        Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+
+private:
+    void ReadUnigramCounts(const wstring& unigramFile)
+    {
+        if (unigramFile.empty())
+            InvalidArgument("SampledSoftmax: samplingDistribution 'unigram' requires a unigramFile.");
+        File file(unigramFile, fileOptionsRead | fileOptionsText);
+        vector<string> lines;
+        file.GetLines(lines);
+        m_unigramProbs.clear();
+        double sum = 0;
+        for (const auto& line : lines)
+        {
+            if (line.empty())
+                continue;
+            m_unigramProbs.push_back((float) max(atof(line.c_str()), 1.0));
+            sum += m_unigramProbs.back();
+        }
+        for (auto& p : m_unigramProbs)
+            p = (float) (p / sum);
+    }
+
+    void InitProposalDistribution(size_t vocabSize)
+    {
+        vector<ElemType> logExpectedCounts(vocabSize), wordIds(vocabSize);
+        if (m_samplingDistribution == L"unigram")
+        {
+            if (m_unigramProbs.size() != vocabSize)
+                InvalidArgument("%ls %ls operation: the unigram distribution has %d words, but the labels have %d.", NodeName().c_str(), OperationName().c_str(), (int) m_unigramProbs.size(), (int) vocabSize);
+            m_unigramSampler = std::discrete_distribution<size_t>(m_unigramProbs.begin(), m_unigramProbs.end());
+        }
+        const double logRange = log(vocabSize + 1.0);
+        for (size_t w = 0; w < vocabSize; w++)
+        {
+            const double p = m_samplingDistribution == L"unigram" ? m_unigramProbs[w] : log((w + 2.0) / (w + 1.0)) / logRange;
+            logExpectedCounts[w] = (ElemType) log(m_numSamples * p);
+            wordIds[w] = (ElemType) w;
+        }
+        m_logExpectedCounts.SetValue(vocabSize, 1, m_deviceId, logExpectedCounts.data());
+        m_wordIds.SetValue(vocabSize, 1, m_deviceId, wordIds.data());
+    }
+
+    size_t DrawSample(std::mt19937& engine, size_t vocabSize)
+    {
+        if (m_samplingDistribution == L"unigram")
+            return m_unigramSampler(engine);
+        // inverse of the log-uniform (Zipfian) cumulative distribution log(w + 1) / log(vocabSize + 1)
+        const double u = std::uniform_real_distribution<double>(0, 1)(engine);
+        return min((size_t) exp(u * log(vocabSize + 1.0)) - 1, vocabSize - 1);
+    }
+
+    size_t m_numSamples;
+    wstring m_samplingDistribution;
+    vector<float> m_unigramProbs; // [word] for "unigram"
+    std::discrete_distribution<size_t> m_unigramSampler;
+    unsigned long m_randomSeed;
+
+    Matrix<ElemType> m_logExpectedCounts; // [vocab_size x 1] log(numSamples * P(w))
+    Matrix<ElemType> m_wordIds;           // [vocab_size x 1] 0, 1, ..., for reading the label ids off the one-hot labels
+    Matrix<ElemType> m_labelIds;          // [1 x T]
+    Matrix<ElemType> m_selection;         // [vocab_size x (T + numSamples)] sparse, one non-zero per column
+    Matrix<ElemType> m_selectedWeights;   // [hdsize x (T + numSamples)]
+    Matrix<ElemType> m_selectedBias;      // [1 x (T + numSamples)]
+    Matrix<ElemType> m_adjustedBias;      // [vocab_size x 1] bias - log expected count
+    Matrix<ElemType> m_labelLogits;
+    Matrix<ElemType> m_sampleLogits;
+    Matrix<ElemType> m_logSoftmax; // [(1 + numSamples) x T] label in row 0
+    Matrix<ElemType> m_gradLogits;
+    Matrix<ElemType> m_gradLabelLogits;
+    Matrix<ElemType> m_gradSampleLogits;
+    Matrix<ElemType> m_gradSelected;
+    Matrix<ElemType> m_temp;
+    bool m_needRecomputeGradients;
+
+    // host copy of the selection matrix
+    vector<CPUSPARSE_INDEX_TYPE> m_selectionColStarts, m_selectionRowIndices;
+    vector<ElemType> m_selectionValues;
+};
+template class SampledSoftmaxNode<float>;
+template class SampledSoftmaxNode<double>;
+
+// -----------------------------------------------------------------------
+// HierarchicalSoftmaxNode (labels, hidden, weights)
+// Cross entropy of a softmax factored along a binary Huffman tree of the words, so that a frame costs O(log vocab_size):
+// P(w) is the product over the internal nodes n on the path from the root to w of sigmoid(+-weights(:,n)' * hidden).
+//  - Input(0) [vocab_size x T] labels, one-hot (preferably sparse), or [1 x T] word indices
+//  - Input(1) [hdsize x T] hidden layer activation
+//  - Input(2) [hdsize x (vocab_size - 1)] one column per internal node of the tree
+// The tree is built from the counts in wordCountsFile (one per line, in word-id order, as writeWordAndClass writes them to
+// outputWordCounts) and saved with the model. All frames are processed in one call to kernels
+// that gather the nodes on the paths of the labels (see Matrix::HierarchicalSoftmax()). Unlike sampling, the value is
+// the exact log likelihood, so its exp is the perplexity.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class HierarchicalSoftmaxNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<3>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"HierarchicalSoftmax";
+    }
+
+public:
+    HierarchicalSoftmaxNode(DEVICEID_TYPE deviceId, const wstring& name, const wstring& wordCountsFile = L"")
+        : Base(deviceId, name),
+          m_paths(deviceId),
+          m_labelIds(deviceId),
+          m_frameLosses(deviceId),
+          m_pathGradients(deviceId),
+          m_temp(deviceId)
+    {
+        if (!wordCountsFile.empty())
+        {
+            ReadWordCounts(wordCountsFile);
+            BuildTree();
+        }
+    }
+    HierarchicalSoftmaxNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : HierarchicalSoftmaxNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"wordCountsFile"))
+    {
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<HierarchicalSoftmaxNode<ElemType>>(nodeP);
+            node->m_wordCounts = m_wordCounts;
+            node->BuildTree();
+        }
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_wordCounts;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_wordCounts;
+        BuildTree();
+    }
+
+    virtual void PrintSelfBeforeValidation() const override
+    {
+        Base::PrintSelfBeforeValidation();
+        fprintf(stderr, ", vocabulary=%d, tree depth=%d", (int) m_wordCounts.size(), (int) (m_paths.GetNumRows() / 2));
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        if (inputIndex == 0)
+            InvalidArgument("%ls %ls operation cannot compute the gradient with respect to the labels.", NodeName().c_str(), OperationName().c_str());
+
+        FrameRange fr(Input(0)->GetMBLayout());
+        if (inputIndex == 1)
+        {
+            auto hiddenGrad = Input(1)->GradientFor(fr);
+            Matrix<ElemType>::HierarchicalSoftmaxBackpropHidden(Gradient(), m_labelIds, Input(2)->ValueAsMatrix(), m_paths, m_pathGradients, hiddenGrad);
+        }
+        else
+            Matrix<ElemType>::HierarchicalSoftmaxBackpropWeights(Gradient(), m_labelIds, Input(1)->ValueFor(fr), m_paths, m_pathGradients, Input(2)->GradientAsMatrix());
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return false;
+    }
+
+    virtual void UpdateFunctionMBSize() override
+    {
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(Input(0)->GetMBLayout());
+        // the word index of each frame, -1 in gaps
+        auto labels = Input(0)->ValueFor(fr);
+        if (labels.GetMatrixType() == SPARSE)
+            m_labelIds.AssignOneHotIndicesOf(labels);
+        else if (HasIndexLabels())
+            m_labelIds.SetValue(labels);
+        else
+            labels.VectorMax(m_labelIds, m_temp, true);
+        MaskMissingColumnsTo(m_labelIds, Input(0)->GetMBLayout(), fr, (ElemType) -1);
+
+        Matrix<ElemType>::HierarchicalSoftmax(m_labelIds, Input(1)->ValueFor(fr), Input(2)->ValueAsMatrix(), m_paths, m_frameLosses, m_pathGradients);
+        Value().AssignSumOfElements(m_frameLosses);
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+        if (isFinalValidationPass)
+        {
+            if (!Input(0)->HasMBLayout() || !Input(1)->HasMBLayout() || Input(2)->HasMBLayout())
+                LogicError("%ls %ls operation requires inputs 0 and 1 to be a minibatch, and input 2 to be a matrix.", NodeName().c_str(), OperationName().c_str());
+            const size_t vocabSize = m_wordCounts.size();
+            if (vocabSize < 2)
+                InvalidArgument("%ls %ls operation requires the counts of at least 2 words (wordCountsFile).", NodeName().c_str(), OperationName().c_str());
+            if (Input(0)->GetSampleMatrixNumRows() != vocabSize && !HasIndexLabels())
+                LogicError("%ls %ls operation: the labels have dimension %d, but there are counts of %d words.", NodeName().c_str(), OperationName().c_str(), (int) Input(0)->GetSampleMatrixNumRows(), (int) vocabSize);
+            if (Input(2)->GetAsMatrixNumRows() != Input(1)->GetSampleMatrixNumRows() || Input(2)->GetAsMatrixNumCols() != vocabSize - 1)
+                LogicError("%ls %ls operation: the weights must be [%d x %d], one column per internal node of the tree.", NodeName().c_str(), OperationName().c_str(), (int) Input(1)->GetSampleMatrixNumRows(), (int) vocabSize - 1);
+        }
+
+        SetDims(TensorShape(1), false);
+    }
+
+private:
+    void ReadWordCounts(const wstring& wordCountsFile)
+    {
+        File file(wordCountsFile, fileOptionsRead | fileOptionsText);
+        vector<string> lines;
+        file.GetLines(lines);
+        m_wordCounts.clear();
+        for (const auto& line : lines)
+        {
+            if (!line.empty())
+                m_wordCounts.push_back((float) max(atof(line.c_str()), 1.0));
+        }
+    }
+
+    // Huffman tree of the words: leaves 0..V-1, internal node V+k is weights column k (the root is the last); each word's
+    // path from the root goes into column w of m_paths as the weights columns and signs, +1 for the first child, -1 for the second
+    void BuildTree()
+    {
+        const size_t vocabSize = m_wordCounts.size();
+        if (vocabSize < 2)
+            return;
+        typedef std::pair<double, size_t> CountAndNode;
+        std::priority_queue<CountAndNode, vector<CountAndNode>, std::greater<CountAndNode>> queue;
+        for (size_t w = 0; w < vocabSize; w++)
+            queue.push(CountAndNode(m_wordCounts[w], w));
+        vector<size_t> parent(2 * vocabSize - 1);
+        vector<signed char> sign(2 * vocabSize - 1);
+        for (size_t node = vocabSize; node < 2 * vocabSize - 1; node++)
+        {
+            const CountAndNode first = queue.top();
+            queue.pop();
+            const CountAndNode second = queue.top();
+            queue.pop();
+            parent[first.second] = node;
+            sign[first.second] = +1;
+            parent[second.second] = node;
+            sign[second.second] = -1;
+            queue.push(CountAndNode(first.first + second.first, node));
+        }
+
+        const size_t root = 2 * vocabSize - 2;
+        size_t depth = 0;
+        vector<size_t> lengths(vocabSize);
+        for (size_t w = 0; w < vocabSize; w++)
+        {
+            for (size_t node = w; node != root; node = parent[node])
+                lengths[w]++;
+            depth = max(depth, lengths[w]);
+        }
+        vector<ElemType> paths(2 * depth * vocabSize, 0);
+        for (size_t w = 0; w < vocabSize; w++)
+        {
+            ElemType* column = &paths[2 * depth * w];
+            size_t d = lengths[w];
+            for (size_t node = w; node != root; node = parent[node])
+            {
+                d--;
+                column[d] = (ElemType) (parent[node] - vocabSize);
+                column[depth + d] = sign[node];
+            }
+            for (d = lengths[w]; d < depth; d++)
+                column[d] = -1;
+        }
+        m_paths.SetValue(2 * depth, vocabSize, m_deviceId, paths.data());
+    }
+
+    vector<float> m_wordCounts; // [word]
+
+    Matrix<ElemType> m_paths;         // [2 * depth x vocab_size] per word: the weights columns on its path, -1 past its end, and the signs of the branches
+    Matrix<ElemType> m_labelIds;      // [1 x T]
+    Matrix<ElemType> m_frameLosses;   // [1 x T]
+    Matrix<ElemType> m_pathGradients; // [depth x T] derivatives of the loss by the scores of the path nodes
+    Matrix<ElemType> m_temp;
+};
+template class HierarchicalSoftmaxNode<float>;
+template class HierarchicalSoftmaxNode<double>;
+
 // -----------------------------------------------------------------------
 // ClassBasedCrossEntropyWithSoftmaxNode (labeldata(.,t), inputdata(.,t), embeddingMatrix, clsProbBeforeSoftmaxData(.,t))
 //  - Input(0) [4 x T] label in dense matrix in
@@ -730,14 +1276,18 @@ public:
     ClassBasedCrossEntropyWithSoftmaxNode(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
           m_logSoftmax(deviceId),
-          m_softMax(deviceId),
+          m_targetLogProbs(deviceId),
           m_grdToSoftMaxInput(deviceId),
           m_clsLogSoftmax(deviceId),
-          m_clsSoftmax(deviceId)
+          m_clsSoftmax(deviceId),
+          m_frames(deviceId),
+          m_classes(deviceId),
+          m_classTargets(deviceId)
     {
     }
 
     // compute gradients to input observations, the weights to the observations, and the class log posterior probabilites
+    // All frames are processed at once by the batched class-conditional softmax of class Matrix.
     virtual void BackpropToNonLooping(size_t inputIndex) override
     {
         // this should never be called for input[0], which is controlled through the needGradient flag
@@ -746,53 +1296,21 @@ public:
 
         ComputeSoftMaxPartial();
 
-        Matrix<ElemType> grd_t;
-        Matrix<ElemType> grd_to_wgt_t;
-
-        const size_t nT = Input(LABELDATA)->GetNumTimeSteps();
-        const size_t nS = Input(LABELDATA)->GetNumParallelSequences();
-        size_t sz = 0; // iterate over the packed concatenated class-conditioned prob vectors
-        for (size_t s = 0; s < nS; s++)
-            for (size_t t = 0; t < nT; t++)
-            {
-                FrameRange fr = FrameRange(Input(LABELDATA)->GetMBLayout(), t).Sequence(s);
-
-                if (Input(LABELDATA)->GetMBLayout()->IsGap(fr)) // skip gaps
-                    continue;
-
-                Matrix<ElemType> lbl_t = Input(LABELDATA)->ValueFor(fr);
-                size_t c_t = (size_t) lbl_t(1, 0);
-                size_t lft_bnd = (size_t) lbl_t(2, 0); // index of first word belonging to current word token's class
-                size_t rgt_bnd = (size_t) lbl_t(3, 0); // and end of that range
-                size_t nbr_wrd = (rgt_bnd - lft_bnd);  // number of words in the class
-
-                // compute prb - 1 and prb
-                Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(lft_bnd, nbr_wrd);
-                Matrix<ElemType> obs = Input(INPUTDATA)->ValueFor(fr); // hidden activation vector for current word token
-                Matrix<ElemType> grd_to_soft_max_input = m_grdToSoftMaxInput.ColumnSlice(sz, nbr_wrd);
-                Matrix<ElemType> grd_to_cls_prob = DataWithMBLayoutFor(m_clsLogSoftmax, fr, Input(CLASSPROBINDATA)->GetMBLayout());
-
-                switch (inputIndex)
-                {
-                case 1:
-                    // gradient to input
-                    grd_t = Input(INPUTDATA)->GradientFor(fr);
-                    Matrix<ElemType>::MultiplyAndAdd(weightForClass, false, grd_to_soft_max_input, true, grd_t);
-                    break;
-                case 2:
-                    // gradient to input weight
-                    grd_to_wgt_t = Input(EMBEDDINGMATRIX)->GradientAsMatrix().ColumnSlice(lft_bnd, nbr_wrd);
-                    Matrix<ElemType>::MultiplyAndAdd(obs, false, grd_to_soft_max_input, false, grd_to_wgt_t);
-                    break;
-                case 3:
-                    grd_t = Input(CLASSPROBINDATA)->GradientFor(fr);
-                    grd_t.SetValue(DataWithMBLayoutFor(m_clsSoftmax, fr, Input(CLASSPROBINDATA)->GetMBLayout()));
-                    ComputeCEPartialToSoftmaxInputs(grd_t, Gradient(), c_t);
-                    break;
-                }
-
-                sz += nbr_wrd;
-            }
+        switch (inputIndex)
+        {
+        case 1:
+            // gradient to input
+            Matrix<ElemType>::AddClassConditionalHiddenGradient(Input(EMBEDDINGMATRIX)->ValueAsMatrix(), m_grdToSoftMaxInput, m_frames, Input(INPUTDATA)->Gradient());
+            break;
+        case 2:
+            // gradient to input weight
+            Matrix<ElemType>::AddClassConditionalWeightGradient(Input(INPUTDATA)->Value(), m_grdToSoftMaxInput, m_frames, m_classes, Input(EMBEDDINGMATRIX)->GradientAsMatrix());
+            break;
+        case 3:
+            // m_clsSoftmax holds softmax - one-hot class already
+            Matrix<ElemType>::Multiply1x1AndWeightedAdd(+1, Gradient(), m_clsSoftmax, 1, Input(CLASSPROBINDATA)->Gradient());
+            break;
+        }
     }
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override
@@ -801,48 +1319,91 @@ public:
     }
 
 private:
-    void ComputeCEPartialToSoftmaxInputs(Matrix<ElemType>& inputGradientValues, Matrix<ElemType>& gradientValues, size_t y_t)
-    {
-        Matrix<ElemType>::MinusOneAt(inputGradientValues, y_t);
-        Matrix<ElemType>::Scale(gradientValues, inputGradientValues);
-    }
-
     // gradient of cross entropy w.r.t. to input to softmax
     void ComputeSoftMaxPartial()
     {
         if (m_needRecomputeGradientToSoftmaxInput)
         {
-            m_grdToSoftMaxInput.Resize(1, m_totalNbrWords); // buffer that contains a concatenation of class-conditional values
-
-            const size_t nT = Input(LABELDATA)->GetNumTimeSteps();
-            const size_t nS = Input(LABELDATA)->GetNumParallelSequences();
-            size_t sz = 0; // iterate over the packed concatenated class-conditioned prob vectors
-            for (size_t s = 0; s < nS; s++)
-                for (size_t t = 0; t < nT; t++)
-                {
-                    FrameRange fr = FrameRange(Input(LABELDATA)->GetMBLayout(), t).Sequence(s);
-
-                    // if (Input(LABELDATA)->GetMBLayout()->IsGap(s, t))  // skip gaps
-                    if (Input(LABELDATA)->GetMBLayout()->IsGap(fr)) // skip gaps
-                        continue;
-
-                    Matrix<ElemType> lbl_t = Input(LABELDATA)->ValueFor(fr);
-                    size_t y_t = (size_t) lbl_t(0, 0);     // word index
-                    size_t lft_bnd = (size_t) lbl_t(2, 0); // index of first word belonging to current word token's class
-                    size_t rgt_bnd = (size_t) lbl_t(3, 0); // and end of that range
-                    size_t nbr_wrd = (rgt_bnd - lft_bnd);  // number of words in the class
-
-                    Matrix<ElemType> softMax = m_softMax.ColumnSlice(sz, nbr_wrd);
+            Matrix<ElemType>::ClassConditionalSoftmaxGradient(m_logSoftmax, Gradient(), m_frames, m_grdToSoftMaxInput);
+            m_needRecomputeGradientToSoftmaxInput = false;
+        }
+    }
 
-                    size_t idx_in_class = y_t - lft_bnd;
-                    ComputeCEPartialToSoftmaxInputs(softMax, Gradient(), idx_in_class);
+    // build the frame and class index of the minibatch from the labels (see Matrix::ClassConditionalLogSoftmax())
+    // The frames are sorted by class, so that the weight gradient of each class is one segmented reduction.
+    void BuildFrameIndex()
+    {
+        const auto& pMBLayout = Input(LABELDATA)->GetMBLayout();
+        const Matrix<ElemType>& labels = Input(LABELDATA)->Value();
+        const size_t nT = pMBLayout->GetNumTimeSteps();
+        const size_t nS = pMBLayout->GetNumParallelSequences();
 
-                    m_grdToSoftMaxInput.ColumnSlice(sz, nbr_wrd).SetValue(softMax);
+        struct Frame
+        {
+            size_t col, cls, lft, nbr, idx;
+        };
+        vector<Frame> frames;
+        for (size_t t = 0; t < nT; t++)
+            for (size_t s = 0; s < nS; s++)
+            {
+                if (pMBLayout->IsGap(FrameRange(pMBLayout, t).Sequence(s))) // skip gaps
+                    continue;
 
-                    sz += nbr_wrd;
-                }
+                const size_t col = t * nS + s;
+                size_t y_t = (size_t) labels(0, col);     // current word token index
+                size_t c_t = (size_t) labels(1, col);     // current word token's class index
+                size_t lft_bnd = (size_t) labels(2, col); // index of first word belonging to current word token's class
+                size_t rgt_bnd = (size_t) labels(3, col); // and end of that range
+                if (rgt_bnd <= lft_bnd)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): Encountered a class of size 0. This sample seems to lack an NoInput flag.");
+                if (y_t < lft_bnd || y_t >= rgt_bnd)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): Word index out of bounds of class-member index range (word not a class member).");
+                if (c_t >= m_nbrCls)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): Class index out of bounds of the class log posterior input.");
+                frames.push_back(Frame{col, c_t, lft_bnd, rgt_bnd - lft_bnd, y_t - lft_bnd});
+            }
+        stable_sort(frames.begin(), frames.end(), [](const Frame& a, const Frame& b)
+                    {
+                        return a.lft < b.lft;
+                    });
+
+        // 'sz' is the offset of a frame into the concatenated class-conditional vectors
+        m_framesBuffer.resize(5 * frames.size());
+        m_classesBuffer.clear();
+        m_classTargetsBuffer.resize(frames.size());
+        size_t sz = 0;
+        for (size_t j = 0; j < frames.size(); j++)
+        {
+            const Frame& frame = frames[j];
+            ElemType* f = &m_framesBuffer[5 * j];
+            f[0] = (ElemType) frame.col;
+            f[1] = (ElemType) sz;
+            f[2] = (ElemType) frame.lft;
+            f[3] = (ElemType) frame.nbr;
+            f[4] = (ElemType) frame.idx;
+            if (j == 0 || frame.lft != frames[j - 1].lft) // a new class begins: (first frame, end frame)
+            {
+                m_classesBuffer.push_back((ElemType) j);
+                m_classesBuffer.push_back((ElemType) j);
+            }
+            m_classesBuffer.back() = (ElemType)(j + 1);
+            m_classTargetsBuffer[j] = (ElemType)(frame.col * m_nbrCls + frame.cls); // element of the class posteriors
+            sz += frame.nbr;
+        }
+        m_totalNbrWords = sz; // total size of concatenated vector
+        m_numFrames = frames.size();
 
-            m_needRecomputeGradientToSoftmaxInput = false;
+        if (m_numFrames > 0)
+        {
+            m_frames.SetValue(5, m_numFrames, m_deviceId, m_framesBuffer.data());
+            m_classes.SetValue(2, m_classesBuffer.size() / 2, m_deviceId, m_classesBuffer.data());
+            m_classTargets.SetValue(1, m_numFrames, m_deviceId, m_classTargetsBuffer.data());
+        }
+        else
+        {
+            m_frames.Resize(5, 0);
+            m_classes.Resize(2, 0);
+            m_classTargets.Resize(1, 0);
         }
     }
 
@@ -856,102 +1417,44 @@ public:
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         if (Input(LABELDATA)->Value().GetDeviceId() != CPUDEVICE)
-            LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): The label matrix is not using CPU device. This will make computation slow, even though the label data is probably saved on GPU. Because of the external loop over time with explicit class id retrieved from the label matrix, the computation will be very slow if the label matrix is saved on GPU. However, this is only a constraint for label matrix and other matrices such as data are suggested to reside on GPU. ");
+            LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): The label matrix is not using CPU device. The class ranges of the minibatch are indexed from the label matrix on the host, so the label matrix must reside on the CPU. However, this is only a constraint for label matrix and other matrices such as data are suggested to reside on GPU. ");
         // TODO: Get the label matrix into location=Both state.
 
         auto& functionValues = Value();
-
-        const size_t hdSize = Input(INPUTDATA)->GetSampleMatrixNumRows(); // hdSize
         assert(m_nbrCls == Input(CLASSPROBINDATA)->GetSampleMatrixNumRows());
 
+        BuildFrameIndex();
+
         // compute the class posteriors
         m_clsLogSoftmax = Input(CLASSPROBINDATA)->Value();
         m_clsLogSoftmax.InplaceLogSoftmax(true);   // log
         m_clsSoftmax.AssignExpOf(m_clsLogSoftmax); // non-log
 
-        // create a large workspace to contain all class-conditioned probs concatenated
-        // 'sz' is the offset into that vector. We will iterate over these vectors at a few places. Always use this same boilerplate code.
-        // TODO: should we pull this iteration into an iterator, to reduce the code dup?
-        const size_t nT = Input(LABELDATA)->GetNumTimeSteps();
-        const size_t nS = Input(LABELDATA)->GetNumParallelSequences();
-        size_t sz = 0;
-        for (size_t s = 0; s < nS; s++)
-            for (size_t t = 0; t < nT; t++)
-            {
-                FrameRange fr = FrameRange(Input(LABELDATA)->GetMBLayout(), t).Sequence(s);
-                if (Input(LABELDATA)->GetMBLayout()->IsGap(fr)) // skip gaps
-                    continue;
-
-                const Matrix<ElemType>& lbl_t = Input(LABELDATA)->ValueFor(fr);
-                size_t lft_bnd = (size_t) lbl_t(2, 0);
-                size_t rgt_bnd = (size_t) lbl_t(3, 0);
-                size_t nbr_wrd = (rgt_bnd - lft_bnd); // number of words in the class
-                if (nbr_wrd == 0)
-                    LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): Encountered a class of size 0. This sample seems to lack an NoInput flag.");
-
-                sz += nbr_wrd;
-            }
-        m_totalNbrWords = sz; // total size of concatenated vector
+        // the class-conditional log softmax of all frames, concatenated, in one launch
+        Matrix<ElemType>::ClassConditionalLogSoftmax(Input(INPUTDATA)->Value(), Input(EMBEDDINGMATRIX)->ValueAsMatrix(), m_frames, m_totalNbrWords, m_logSoftmax, m_targetLogProbs);
 
-        // buffer to hold the concatenated class-conditioned prob vectors
-        m_softMax.Resize(1, sz);
-        m_logSoftmax.Resize(1, sz);
+        // add the class log posterior probabilities of the targets, gathered from the 1-row view of m_clsLogSoftmax
+        Matrix<ElemType> clsLogSoftmaxAsRow = m_clsLogSoftmax.ColumnSlice(0, m_clsLogSoftmax.GetNumCols());
+        clsLogSoftmaxAsRow.Reshape(1, m_clsLogSoftmax.GetNumElements());
+        Matrix<ElemType> targetClsLogProbs(m_deviceId);
+        targetClsLogProbs.AssignRowStackedColumnsOf(clsLogSoftmaxAsRow, m_classTargets);
+        m_targetLogProbs += targetClsLogProbs;
 
         // accumulate objective
-        functionValues.SetValue(0);
-        sz = 0; // iterate over the packed concatenated class-conditioned prob vectors
-        for (size_t s = 0; s < nS; s++)
-            for (size_t t = 0; t < nT; t++)
-            {
-                FrameRange fr = FrameRange(Input(LABELDATA)->GetMBLayout(), t).Sequence(s);
-                if (Input(LABELDATA)->GetMBLayout()->IsGap(fr)) // skip gaps
-                    continue;
-
-                const Matrix<ElemType>& lbl_t = Input(LABELDATA)->ValueFor(fr);
-                size_t y_t = (size_t) lbl_t(0, 0);     // current word token index
-                size_t c_t = (size_t) lbl_t(1, 0);     // current word token's class index
-                size_t lft_bnd = (size_t) lbl_t(2, 0); // index of first word belonging to current word token's class
-                size_t rgt_bnd = (size_t) lbl_t(3, 0); // and end of that range
-                size_t nbr_wrd = (rgt_bnd - lft_bnd);  // number of words in the class
-
-                // now get views of various arrays that correspond to the index range of words belonging to this class
-
-                // get hidden vectors for the words in this class
-                Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(lft_bnd, nbr_wrd); // [hdSize x nbr_wrd]
-
-                // buffer to hold the class-conditional distribution
-                Matrix<ElemType> softMax_t = m_softMax.ColumnSlice(sz, nbr_wrd); // TODO: declare these outside of the loop to avoid the malloc
-                Matrix<ElemType> logSoftMax_t = m_logSoftmax.ColumnSlice(sz, nbr_wrd);
-
-                Matrix<ElemType> obs = Input(INPUTDATA)->ValueFor(fr); // hidden activation vector for current word token
-
-                // multiply hidden activation with weight matrix (the slice of the weight matrix for the range of class members)
-                // TODO: can we use 'true' here instead? Above transposition hack won't work with row slices. 'obs' not used elsewhere
-                obs.Reshape(1, hdSize);                                                                                // transpose it (make it a column vector)
-                logSoftMax_t.AssignProductOf(obs /*(1 x hdSize)*/, false, weightForClass /*hdSize x nbr_wrd*/, false); // -> 1 x nbr_word
-
-                // log softmax(W x_t)
-                logSoftMax_t.InplaceLogSoftmax(false);
-
-                // and non-log version
-                softMax_t.SetValue(logSoftMax_t);
-                softMax_t.InplaceExp();
-                // we now have a column vector of class-conditional probabilities over the class members
-
-                // add  the word's class-conditional log posterior
-                if (y_t < lft_bnd || y_t >= rgt_bnd)
-                    LogicError("ClassBasedCrossEntropyWithSoftmax (ForwardPropNonLooping()): Word index out of bounds of class-member index range (word not a class member).");
-                size_t idx_in_class = y_t - lft_bnd;
-                Matrix<ElemType>::AddElementToElement(logSoftMax_t, 0, idx_in_class, functionValues, 0, 0); // (1x1)
-
-                // add the class log posterior probability
-                Matrix<ElemType>::AddElementToElement(m_clsLogSoftmax, c_t, t, functionValues, 0, 0); // (1x1)
-
-                sz += nbr_wrd;
-            }
-
+        functionValues.AssignSumOfElements(m_targetLogProbs);
         functionValues *= (-1);
 
+        // turn the class posteriors into the gradient of the objective w.r.t. the class log posterior input, up to the factor Gradient()
+        MaskMissingColumnsToZero(m_clsSoftmax, Input(CLASSPROBINDATA)->GetMBLayout(), FrameRange(Input(CLASSPROBINDATA)->GetMBLayout()));
+        if (m_numFrames > 0)
+        {
+            Matrix<ElemType> clsSoftmaxAsRow = m_clsSoftmax.ColumnSlice(0, m_clsSoftmax.GetNumCols());
+            clsSoftmaxAsRow.Reshape(1, m_clsSoftmax.GetNumElements());
+            Matrix<ElemType> minusOnes(1, m_numFrames, m_deviceId);
+            minusOnes.SetValue(-1);
+            clsSoftmaxAsRow.AddFromRowStackedColumnsOf(minusOnes, m_classTargets);
+        }
+
 #if NANCHECK
         functionValues.HasNan("ClassBasedCrossEntropyWithSoftmax");
 #endif
@@ -979,11 +1482,12 @@ public:
     }
 
 protected:
+    // concatenated class-conditional log softmax of all frames, and that of the target word (+ its class) per frame
     Matrix<ElemType> m_logSoftmax;
-    Matrix<ElemType> m_softMax;
+    Matrix<ElemType> m_targetLogProbs;
 
     Matrix<ElemType> m_clsLogSoftmax;
-    Matrix<ElemType> m_clsSoftmax;
+    Matrix<ElemType> m_clsSoftmax; // after ForwardProp: softmax - one-hot class, 0 in gaps
 
     // gradient of cross entropy with respect to the input of softmax
     // a 1 row by \sum_t m_nbrWordsInEachTime[t] vector
@@ -991,6 +1495,13 @@ protected:
     Matrix<ElemType> m_grdToSoftMaxInput;
     bool m_needRecomputeGradientToSoftmaxInput;
 
+    // frame and class index of the minibatch, see BuildFrameIndex()
+    Matrix<ElemType> m_frames;       // [5 x numFrames] (column, offset, first word, number of words, target word)
+    Matrix<ElemType> m_classes;      // [2 x numClasses] (first frame, end frame)
+    Matrix<ElemType> m_classTargets; // [1 x numFrames] element of the target class in the class posteriors
+    vector<ElemType> m_framesBuffer, m_classesBuffer, m_classTargetsBuffer;
+    size_t m_numFrames;
+
     size_t m_nbrCls;
     size_t m_totalNbrWords;
 };
@@ -998,8 +1509,6 @@ protected:
 template class ClassBasedCrossEntropyWithSoftmaxNode<float>;
 template class ClassBasedCrossEntropyWithSoftmaxNode<double>;
 
-#ifdef COMING_SOON
-
 // -----------------------------------------------------------------------
 // CRFNode (labels, position_dependent_scores, transition_scores)
 //  - labels: output label vector of [0:T-1]
@@ -1007,7 +1516,8 @@ template class ClassBasedCrossEntropyWithSoftmaxNode<double>;
 //    in the R-CRF case, it is the RNN output score before softmax
 //  - transition scores: square transition matrix,  --TODO: log?
 //    in the R-CRF case, it is the transition probability between labels
-// BUGBUG: This node cannot operate with truncated BPTT, but does not detect it. It also does not handle gaps or test boundary flags.
+// All parallel sequences of the minibatch are processed in one call on the device of the inputs (see Matrix::CRFForwardBackward()).
+// A sequence that is cut by the minibatch boundary (truncated BPTT) is treated as if it ended there.
 // -----------------------------------------------------------------------
 
 /**
@@ -1041,43 +1551,21 @@ public:
         : Base(deviceId, name),
           mAlpha(deviceId),
           mBeta(deviceId),
-          mPostProb(deviceId)
+          mPostProb(deviceId),
+          mSequences(deviceId),
+          mSequenceScores(deviceId)
     {
     }
 
-    // compute posterior probability of label y at position t
+    // compute posterior probability of label y at position t, and the negative log likelihood of the label sequences
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(Input(0)->GetMBLayout());
-        size_t nrow = Input(0)->Value().GetNumRows();
-        size_t ncol = Input(0)->Value().GetNumCols();
-
-        mAlpha.Resize(nrow, ncol);
-        mBeta.Resize(nrow, ncol);
-        mPostProb.Resize(nrow, ncol);
-
-        Value().SetValue(0.0);
-        Matrix<ElemType> funcVal = Value(); // TODO: This just creates a 1x1 matrix set to 0.
-
-        size_t nS = Input(0)->GetNumParallelSequences();
-        if (nS != 1)
-            LogicError("CRFNode: >1 parallel sequences are curently not implemented correctly.");
-        for (size_t i = 0; i < nS; i++) // process parallel sequences one by one  --BUGBUG: We should loop over individual sequences.
-        {
-            FrameRange sequenceRange = fr.Sequence(i); // FrameRange to select one sequence
-            // BUGBUG: This ^^ is neither supported nor correct, since this code does not handle gaps or start/end flags.
-            ForwardPropS(
-                DataWithMBLayoutFor(mPostProb, sequenceRange, Input(0)->GetMBLayout()),
-                DataWithMBLayoutFor(mAlpha, sequenceRange, Input(0)->GetMBLayout()),
-                DataWithMBLayoutFor(mBeta, sequenceRange, Input(0)->GetMBLayout()),
-                funcVal,
-                Input(0)->ValueFor(sequenceRange),
-                Input(1)->ValueFor(sequenceRange),
-                Input(2)->ValueAsMatrix(), mStartLbl,
-                mEndLbl);
-
-            Value() += funcVal; // aggregate over sequences
-        }
+        GetSequenceBoundsAsMatrix(Input(0)->GetMBLayout(), mSequences, mSequencesBuffer);
+        Matrix<ElemType>::CRFForwardBackward(Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), Input(2)->ValueAsMatrix(),
+                                             mAlpha, mBeta, mSequenceScores, mSequences, Input(0)->GetNumParallelSequences());
+        mPostProb.AssignExpOf(mBeta); // (beta is LZERO in gaps, so the posteriors are 0 there)
+        Value().AssignSumOfElements(mSequenceScores); // aggregate over sequences
     }
 
     virtual void BackpropToNonLooping(size_t inputIndex) override // scaled by 2*number of colmns (samples) in the Matrix<ElemType>
@@ -1091,25 +1579,14 @@ public:
         {
             auto gradient = Input(1)->GradientFor(fr);
             Matrix<ElemType>::AddScaledDifference(Gradient(), mPostProb, Input(0)->ValueFor(fr), gradient);
+            Input(1)->MaskMissingGradientColumnsToZero(fr);
         }
         else if (inputIndex == 2)
         {
             assert(Input(inputIndex)->GradientFor(fr).GetNumElements() > 0);
-            size_t nS = Input(0)->GetNumParallelSequences();
-            for (size_t i = 0; i < nS; i++) // process all sequences one by one
-            {
-                FrameRange sequenceRange = fr.Sequence(i); // FrameRange to select one sequence
-                auto& gradient = Input(2)->GradientAsMatrix();
-                TransGrdCompute(Input(0)->ValueFor(sequenceRange),
-                                DataWithMBLayoutFor(mAlpha, sequenceRange, Input(0)->GetMBLayout()),
-                                DataWithMBLayoutFor(mBeta, sequenceRange, Input(0)->GetMBLayout()),
-                                Input(2)->ValueAsMatrix(),
-                                gradient,
-                                mStartLbl, 1);
-            }
+            Matrix<ElemType>::CRFTransitionGradient(Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), Input(2)->ValueAsMatrix(),
+                                                    mAlpha, mBeta, Input(2)->GradientAsMatrix(), mSequences, Input(0)->GetNumParallelSequences());
         }
-        else
-            return;
     }
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override
@@ -1117,147 +1594,6 @@ public:
         return false;
     }
 
-    // compute forward backward algorithm
-    /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType> postprob, Matrix<ElemType> alpha, Matrix<ElemType> beta, Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, int& firstLbl, int& lastLbl, const int iStep = 1)
-    {
-        // to-do, each slice is for one sentence
-        // to-do, number of slices correspond to number of frames
-        // this implementation only supports one sentence per minibatch
-
-        int nObs = lbls.GetNumCols();
-
-        // change to other values so can support multiple sentences in each minibatch
-        assert(iStep == 1);
-        ForwardCompute(alpha, lbls, pos_scores, pair_scores);
-        BackwardCompute(alpha, beta, functionValues, lbls, pos_scores, pair_scores, iStep);
-        PostProbCompute(postprob, alpha, beta);
-
-        firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        lastLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, nObs - 1) != 0)
-            {
-                lastLbl = ik;
-                break;
-            }
-
-        functionValues.AssignInnerProductOfMatrices(lbls, pos_scores);
-
-        Matrix<ElemType> a = alpha.ColumnSlice(nObs - 1, 1);
-        ElemType fAlpha;
-        fAlpha = a.LogAddSumOfElements();
-
-        // transition score
-        ElemType tscore = 0;
-        for (int t = 0; t < nObs - 1; t++)
-        {
-            int i = -1;
-            for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-                if (lbls(ik, t) != 0)
-                {
-                    i = ik;
-                    break;
-                }
-            int j = -1;
-            for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-                if (lbls(ik, t + 1) != 0)
-                {
-                    j = ik;
-                    break;
-                }
-            tscore += pair_scores(j, i);
-        }
-        tscore += functionValues.Get00Element(); // correct path score
-        tscore -= fAlpha;                        // reduced by the scores from all paths
-        functionValues.SetValue(tscore);
-
-        functionValues *= (-1);
-    }
-
-    // compute forward backward algorithm
-    static void ForwardCompute(Matrix<ElemType>& alpha,
-                               const Matrix<ElemType>& lbls,
-                               const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores)
-    {
-        // to-do, shift more than 1 to support muliple sentences per minibatch
-        int iNumPos = lbls.GetNumCols();
-        int iNumLab = lbls.GetNumRows();
-
-        int firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        // need to have
-        alpha.Resize(iNumLab, iNumPos);
-
-        for (int t = 0; t < iNumPos; t++)
-        {
-            for (int k = 0; k < iNumLab; k++)
-            {
-                ElemType fTmp = (ElemType) LZERO;
-                for (int j = 0; j < iNumLab; j++)
-                {
-                    ElemType fAlpha = (j == firstLbl) ? (ElemType) 0.0 : (ElemType) LZERO;
-                    if (t > 0)
-                        fAlpha = alpha(j, t - 1);
-                    fTmp = alpha.LogAdd(fTmp, fAlpha + pair_scores(k, j));
-                }
-                fTmp += pos_scores(k, t); // include position dependent score
-                alpha(k, t) = fTmp;
-            }
-        }
-    }
-
-    // compute backward algorithm
-    static void BackwardCompute(const Matrix<ElemType>& alpha, Matrix<ElemType>& beta,
-                                Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls,
-                                const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, const int shift = 1)
-    {
-        assert(shift == 1);
-
-        alpha.RCRFBackwardCompute(alpha, beta, functionValues, lbls, pos_scores, pair_scores, shift);
-    }
-
-    static void TransGrdCompute(const Matrix<ElemType>& lbls,
-                                const Matrix<ElemType>& alpha,
-                                const Matrix<ElemType>& beta,
-                                const Matrix<ElemType>& pair_scores,
-                                Matrix<ElemType>& grd,
-                                const int startLbl,
-                                const int shift = 1)
-    {
-        assert(shift == 1);
-
-        alpha.RCRFTransGrdCompute(lbls,
-                                  alpha,
-                                  beta,
-                                  pair_scores,
-                                  grd,
-                                  startLbl, shift);
-    }
-
-    // compute forward backward algorithm
-    static void PostProbCompute(Matrix<ElemType>& postprob, const Matrix<ElemType>& alpha, const Matrix<ElemType>& beta)
-    {
-        int iNumPos = alpha.GetNumCols();
-        int iNumLab = alpha.GetNumRows();
-
-        postprob.Resize(iNumLab, iNumPos);
-        postprob.SetValue(beta);
-        postprob.InplaceExp();
-    }
-
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -1267,7 +1603,6 @@ public:
             if (!(Input(1)->GetSampleMatrixNumRows() == Input(2)->GetAsMatrixNumRows() && // position dependent and pair scores have same number of labels
                   Input(0)->GetSampleMatrixNumRows() == Input(1)->GetSampleMatrixNumRows() &&
                   Input(0)->HasMBLayout() && Input(0)->GetMBLayout() == Input(1)->GetMBLayout() &&
-                  // Input(0)->GetNumCols() == Input(1)->GetNumCols() && // position dependent and pair scores have the same observation numbers
                   Input(2)->GetAsMatrixNumCols() == Input(2)->GetAsMatrixNumRows()))
             {
                 LogicError("The Matrix dimension in the CRFNode operation does not match.");
@@ -1285,9 +1620,8 @@ public:
             node->mAlpha = mAlpha;
             node->mBeta = mBeta;
             node->mPostProb = mPostProb;
-
-            node->mStartLbl = mStartLbl;
-            node->mEndLbl = mEndLbl;
+            node->mSequences = mSequences;
+            node->mSequenceScores = mSequenceScores;
         }
     }
 
@@ -1295,11 +1629,13 @@ private:
     Matrix<ElemType> mAlpha; // TODO: m_Alpha etc.
     Matrix<ElemType> mBeta;
     Matrix<ElemType> mPostProb;
-    int mStartLbl;
-    int mEndLbl;
+    Matrix<ElemType> mSequences;      // (parallel sequence, first, end time step) of every sequence in the minibatch
+    Matrix<ElemType> mSequenceScores; // [0, j] -log P(labels of sequence j)
+    std::vector<ElemType> mSequencesBuffer;
 };
 
-#endif
+template class CRFNode<float>;
+template class CRFNode<double>;
 
 // -----------------------------------------------------------------------
 // LogisticNode (labels, prediction, weight)
@@ -1481,6 +1817,7 @@ public:
           m_dropoutRate(0)
     {
         m_randomSeed = (unsigned long) CreateUniqId();
+        m_maskSeed = m_randomSeed;
     }
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
@@ -1489,7 +1826,7 @@ public:
         Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
 
         if (m_dropoutRate > 0)
-            sliceInput0Grad.AddElementProductOf(sliceOutputGrad, DataFor(*m_maskOfDropout, fr));
+            sliceInput0Grad.AddDropoutOf(sliceOutputGrad, (ElemType) m_dropoutRate, m_maskSeed, MaskOffsetFor(fr)); // (same mask as in forward prop)
         else
             sliceInput0Grad += sliceOutputGrad;
     }
@@ -1509,12 +1846,13 @@ public:
         return false;
     }
 
-    virtual void UpdateFunctionMBSize() override
+    // the mask is not stored; it is a function of the seed and the element position, and computed where it is applied
+    // One seed serves the whole minibatch, so that the frames of a loop get different parts of the same mask.
+    virtual void /*IComputationNode::*/ BeginForwardProp() override
     {
-        Base::UpdateFunctionMBSize();
-        // resize temporaries to their proper size
-        if (m_dropoutRate > 0)
-            m_maskOfDropout->Resize(Input(0)->Value());
+        Base::BeginForwardProp();
+        m_maskSeed = m_randomSeed;
+        m_randomSeed += 1073807359; // 1073807359 is a very large prime number to avoid collision with other dropout nodes
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
@@ -1523,18 +1861,9 @@ public:
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
 
         if (m_dropoutRate > 0)
-        {
-            // determine drop-out mask for this minibatch
-            auto sliceMask = DataFor(*m_maskOfDropout, fr);
-            sliceMask.SetUniformRandomMask((ElemType) m_dropoutRate, (ElemType)(1.0 / (1.0 - m_dropoutRate)) /*pre-scaled*/, m_randomSeed);
-            m_randomSeed += 1073807359; // 1073807359 is a very large prime number to avoid collision with other dropout nodes
-            // apply dropout mask
-            sliceOutputValue.AssignElementProductOf(sliceMask, sliceInput0Value);
-        }
+            sliceOutputValue.AssignDropoutOf(sliceInput0Value, (ElemType) m_dropoutRate, m_maskSeed, MaskOffsetFor(fr)); // (mask is pre-scaled)
         else
-        {
             sliceOutputValue.SetValue(sliceInput0Value);
-        }
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -1553,6 +1882,7 @@ public:
     void SetRandomSeed(const unsigned long val)
     {
         m_randomSeed = (unsigned long) val;
+        m_maskSeed = m_randomSeed;
     }
 
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
@@ -1563,28 +1893,20 @@ public:
             auto node = dynamic_pointer_cast<DropoutNode<ElemType>>(nodeP);
             node->m_dropoutRate = m_dropoutRate;
             node->m_randomSeed = m_randomSeed;
-            node->m_maskOfDropout = m_maskOfDropout;
+            node->m_maskSeed = m_maskSeed;
         }
     }
-    // request matrices needed to do node function value evaluation
-    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
-    {
-        Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_maskOfDropout, matrixPool);
-    }
 
-    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
-    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
+private:
+    // position of the first element of the slice 'fr' within the minibatch
+    size_t MaskOffsetFor(const FrameRange& fr) const
     {
-        Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_maskOfDropout, matrixPool);
+        return ColumnRangeWithMBLayoutFor(Value().GetNumCols(), fr, GetMBLayout()).first * Value().GetNumRows();
     }
 
-private:
     double m_dropoutRate;
-    unsigned long m_randomSeed;
-
-    shared_ptr<Matrix<ElemType>> m_maskOfDropout;
+    unsigned long m_randomSeed; // seed of the next minibatch
+    unsigned long m_maskSeed;   // seed of the current minibatch's mask
 };
 
 template class DropoutNode<float>;
@@ -1842,6 +2164,11 @@ public:
         m_eval = bnEvalMode;
     }
 
+    bool IsSpatial() const
+    {
+        return m_spatial;
+    }
+
 private:
     struct VersionInfo
     {
@@ -9,8 +9,10 @@
 #define EVAL_EXPORTS // creating the exports here
 #include "Eval.h"
 #include "CNTKEval.h"
-#include "CPUMatrix.h" // for SetNumThreads()
+#include "CPUMatrix.h" // for SetNumThreads() and CPUThreadBudget
 #include "SimpleOutputWriter.h"
+#include "InputAndParamNodes.h"
+#include "SharedParameterRegistry.h"
 #ifdef LEAKDETECT
 #include <vld.h> // leak detection
 #endif
@@ -24,6 +26,15 @@ Microsoft::MSR::CNTK::MPIWrapper* g_mpi = nullptr;
 // node output value matrices. This will go away when the
 // sharing is ready to be enabled by default
 bool g_shareNodeValueMatrices = false;
+bool g_fuseElementWiseOps = false;
+bool g_fuseConvolutions = false;
+bool g_fusePoolingActivations = false;
+bool g_maxPoolingIndices = false;
+bool g_zeroCopyViews = false;
+bool g_wavefrontLoops = false;
+bool g_concurrentLoops = false;
+bool g_persistentRecurrence = false;
+size_t g_numComputeStreams = 1;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -52,10 +63,45 @@ void CNTKEval<ElemType>::Init(const std::string& config)
         std::wstring path = m_config("modelPath");
         LoadModel(path);
     }
-    size_t nThreads = m_config("numCPUThreads", "1");
-    CPUMatrix<ElemType>::SetNumThreads(nThreads);
+    // numCPUThreads is the budget of this evaluator, of the threads that call it; cpuCores binds them to a set of cores:
+    // a list (e.g. 0:1:2:3), or 'auto' for numCPUThreads cores that no other evaluator of this process holds, on one NUMA node if possible (or numaNode)
+    m_numCPUThreads = m_config("numCPUThreads", "1");
+    const std::string cpuCores = m_config("cpuCores", "");
+    if (cpuCores == "auto")
+    {
+        m_cpuCores = CPUThreadBudget::AllocateCores(m_numCPUThreads > 0 ? m_numCPUThreads : 1, m_config("numaNode", "-1"));
+        m_allocatedCores = true;
+    }
+    else if (!cpuCores.empty())
+    {
+        ConfigArray coresConfig = m_config("cpuCores");
+        intargvector cores = coresConfig;
+        m_cpuCores.assign(cores.begin(), cores.end());
+    }
+    if (m_cpuCores.empty()) // (without a core set the process-wide setting still applies, as before)
+        CPUMatrix<ElemType>::SetNumThreads(m_numCPUThreads, m_config(L"pinCPUThreads", false));
+    else
+        fprintf(stderr, "CNTKEval: %d CPU threads on cores %s\n", (int) m_numCPUThreads, ((std::string) m_config("cpuCores")).c_str());
 
     g_shareNodeValueMatrices = m_config(L"shareNodeValueMatrices", false);
+    g_fuseElementWiseOps = m_config(L"fuseElementWiseOps", false);
+    g_fuseConvolutions = m_config(L"fuseConvolutions", false);
+    g_fusePoolingActivations = m_config(L"fusePoolingActivations", false);
+    g_maxPoolingIndices = m_config(L"maxPoolingIndices", false);
+    g_zeroCopyViews = m_config(L"zeroCopyViews", false);
+    g_wavefrontLoops = m_config(L"wavefrontLoops", false);
+    g_concurrentLoops = m_config(L"concurrentLoops", false);
+    g_persistentRecurrence = m_config(L"persistentRecurrence", false);
+    g_numComputeStreams = m_config(L"numComputeStreams", (size_t) 1);
+
+    m_cacheUnchangedInputs = m_config(L"cacheUnchangedInputs", false);
+    if (m_cacheUnchangedInputs && g_shareNodeValueMatrices)
+        InvalidArgument("cacheUnchangedInputs cannot be used with shareNodeValueMatrices, which reuses the node values it keeps.");
+
+    m_maxBatchLatencyMs = m_config(L"maxBatchLatencyMs", (size_t) 2);
+    m_maxBatchRequests = m_config(L"maxBatchRequests", (size_t) 64);
+    if (m_maxBatchRequests == 0)
+        InvalidArgument("maxBatchRequests must be greater than 0.");
 }
 
 // Destroy - cleanup and remove this class
@@ -64,7 +110,10 @@ template <class ElemType>
 void CNTKEval<ElemType>::Destroy()
 {
     // cleanup everything
+    if (m_allocatedCores)
+        CPUThreadBudget::ReleaseCores(m_cpuCores);
     m_net.reset();
+    m_sharedParameters.clear();
     delete m_reader;
     delete m_writer;
     delete this;
@@ -77,7 +126,105 @@ void CNTKEval<ElemType>::LoadModel(const std::wstring& modelFileName)
 {
     DEVICEID_TYPE deviceId = DeviceFromConfig(m_config);
     fprintf(stderr, "DeviceID=%d\n", (int) deviceId);
-    m_net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
+    // with a model saved in the cntk_aligned format, CPU parameters then reference the mapped file, shared by all processes
+    const bool mapModelFile = m_config(L"mapModelFile", false);
+    // with outputNodeNames, only the nodes these outputs depend on are loaded, e.g. not the criteria or the other heads
+    vector<wstring> outputNodeNames;
+    if (m_config.Exists("outputNodeNames"))
+    {
+        ConfigArray outputNodeNamesConfig = m_config("outputNodeNames");
+        for (size_t i = 0; i < outputNodeNamesConfig.size(); i++)
+            outputNodeNames.push_back(outputNodeNamesConfig[i]);
+    }
+    m_net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName, mapModelFile ? (FileOptions)(fileOptionsBinary | fileOptionsMapped) : fileOptionsBinary,
+                                                         false /*bAllowNoCriterionNode*/, nullptr /*anotherNetwork*/, outputNodeNames);
+    m_allocatedOutputNames.clear();
+    m_inputVersions.clear();
+
+    // fold constants, Dropout and normalizations, and fuse affine layers; INT8 Times nodes are kept unfused
+    const bool quantizeWeights = m_config(L"quantizeWeights", false);
+    if (m_config(L"optimizeModel", false))
+        m_net->OptimizeForInference<ElemType>(/*fuseAffine=*/!quantizeWeights);
+
+    // parameters with the same values as one of another model of this process reference its values instead of their own copy
+    // (after the optimization, which changes them; the INT8 and block-sparse copies below are still per model)
+    m_sharedParameters.clear(); // (the previous network is gone)
+    if (m_config(L"shareParameters", false))
+    {
+        auto& registry = SharedParameterRegistry<ElemType>::Instance();
+        size_t numReused = 0;
+        for (const auto& node : m_net->GetNodesWithType(OperationNameOf(LearnableParameter)))
+        {
+            auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+            if (value.GetMatrixType() != DENSE || value.IsEmpty())
+                continue;
+            auto storage = registry.Intern(value);
+            if (storage.use_count() > 1)
+                numReused++;
+            value.SetValue(storage->GetNumRows(), storage->GetNumCols(), storage->GetDeviceId(), const_cast<ElemType*>(storage->BufferPointer()), matrixFlagDontOwnBuffer);
+            m_sharedParameters.push_back(storage);
+        }
+        fprintf(stderr, "Shared the values of %d parameters, %d of them with models loaded before.\n", (int) m_sharedParameters.size(), (int) numReused);
+    }
+
+    // INT8 weights for the products with parameters, on the CPU
+    // The input ranges are fixed from the first quantizationCalibrationSamples samples evaluated, which are computed in full precision;
+    // without calibration, every sample is quantized with its own range.
+    m_quantizedNodes.clear();
+    m_calibrationSamplesLeft = 0;
+    if (quantizeWeights)
+    {
+        const size_t calibrationSamples = m_config(L"quantizationCalibrationSamples", (size_t) 0);
+        for (const auto& node : m_net->GetNodesWithType(OperationNameOf(TimesNode)))
+        {
+            auto timesNode = dynamic_pointer_cast<TimesNode<ElemType>>(node);
+            if (!timesNode->QuantizeWeights())
+                continue;
+            timesNode->SetQuantizationCalibration(calibrationSamples > 0);
+            m_quantizedNodes.push_back(timesNode);
+        }
+        m_calibrationSamplesLeft = m_quantizedNodes.empty() ? 0 : calibrationSamples;
+        fprintf(stderr, "Quantized the weights of %d Times nodes to INT8, calibrating on %d samples.\n", (int) m_quantizedNodes.size(), (int) m_calibrationSamplesLeft);
+    }
+
+    // block-sparse (BSR) weights for the products with parameters that were pruned to blocks of blockSparseBlockSize,
+    // if at least the fraction blockSparsityThreshold of their blocks are zero
+    if (m_config(L"blockSparseWeights", false))
+    {
+        const size_t blockDim = m_config(L"blockSparseBlockSize", (size_t) 8);
+        const double threshold = m_config(L"blockSparsityThreshold", 0.5);
+        size_t numConverted = 0;
+        for (const auto& node : m_net->GetNodesWithType(OperationNameOf(TimesNode)))
+        {
+            if (dynamic_pointer_cast<TimesNode<ElemType>>(node)->ConvertWeightsToBlockSparse(blockDim, threshold))
+                numConverted++;
+        }
+        fprintf(stderr, "Converted the weights of %d Times nodes to block-sparse rows of %dx%d blocks.\n", (int) numConverted, (int) blockDim, (int) blockDim);
+    }
+
+    // the state that streams carry over
+    m_streams.clear();
+    m_pastValueNodes.clear();
+    m_maxTimeStep = 0;
+    for (const auto& node : m_net->GetNodesWithType(OperationNameOf(PastValueNode)))
+    {
+        auto pastValueNode = dynamic_pointer_cast<PastValueNode<ElemType>>(node);
+        pastValueNode->SetKeepWholeInput(true); // (SaveStreamStates() takes the last frames of every stream, wherever it ends)
+        m_pastValueNodes.push_back(pastValueNode);
+        m_maxTimeStep = max(m_maxTimeStep, (size_t) pastValueNode->GetTimeStep());
+    }
+}
+
+// EndOfMinibatchCalibration - count evaluated samples towards the INT8 calibration, and end it when enough were seen
+template <class ElemType>
+void CNTKEval<ElemType>::EndOfMinibatchCalibration(size_t numSamples)
+{
+    if (m_calibrationSamplesLeft == 0)
+        return;
+    m_calibrationSamplesLeft -= min(numSamples, m_calibrationSamplesLeft);
+    if (m_calibrationSamplesLeft == 0)
+        for (auto& node : m_quantizedNodes)
+            node->SetQuantizationCalibration(false);
 }
 
 // GetNodeDimensions - Get the node dimensions of the specified nodes
@@ -134,7 +281,9 @@ void CNTKEval<ElemType>::GetNodeDimensions(std::map<std::wstring, size_t>& dimen
 template <class ElemType>
 void CNTKEval<ElemType>::StartEvaluateMinibatchLoop(const std::wstring& outputNodeName)
 {
+    std::lock_guard<std::mutex> lock(m_evalMutex);
     m_net->StartEvaluateMinibatchLoop(m_net->GetNodeFromName(outputNodeName));
+    m_inputVersions.clear();
 }
 
 // Evaluate - Evalute using the model with the given inputs and outputs
@@ -143,6 +292,10 @@ void CNTKEval<ElemType>::StartEvaluateMinibatchLoop(const std::wstring& outputNo
 template <class ElemType>
 void CNTKEval<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
 {
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    CPUThreadBudget cpuThreads(m_numCPUThreads, m_cpuCores);
+    if (!m_boundInputs.empty())
+        LogicError("Evaluate: The input nodes reference bound buffers; use EvaluateBound().");
     size_t minibatchSize = m_config(L"minibatchSize", (size_t) 10240);
     // get the evaluation names from the output string
     vector<wstring> outNodeNames;
@@ -172,7 +325,605 @@ void CNTKEval<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>
 
     // call the evaluator
     SimpleOutputWriter<ElemType> eval(m_net);
+    if (m_cacheUnchangedInputs)
+        eval.SetUnchangedInputTest([this](const ComputationNodeBasePtr& node) { return IsInputUnchanged(node); });
+    else
+        m_inputVersions.clear();
     eval.WriteOutput(*m_reader, minibatchSize, *m_writer, outNodeNames);
+
+    if (!inputs.empty())
+        EndOfMinibatchCalibration(inputs.begin()->second->size() / max(m_dimensions[inputs.begin()->first], (size_t) 1));
+}
+
+// IsInputUnchanged - whether the reader gave an input node the same minibatch as before, for Evaluate() with cacheUnchangedInputs
+template <class ElemType>
+bool CNTKEval<ElemType>::IsInputUnchanged(const ComputationNodeBasePtr& node)
+{
+    const auto& pMBLayout = m_net->GetMBLayoutPtr();
+    bool hasHistory = false;
+    for (const auto& sequence : pMBLayout->GetAllSequences())
+        hasHistory |= sequence.tBegin < 0;
+
+    const Matrix<ElemType>& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+    m_inputBuffer.resize(value.GetNumElements());
+    if (value.GetDeviceId() == CPUDEVICE)
+        memcpy(m_inputBuffer.data(), value.BufferPointer(), m_inputBuffer.size() * sizeof(ElemType));
+    else if (!m_inputBuffer.empty())
+        value.CopySection(value.GetNumRows(), value.GetNumCols(), m_inputBuffer.data(), value.GetNumRows());
+
+    auto& input = m_inputVersions[node->NodeName()];
+    const bool unchanged = !hasHistory && input.layout && *input.layout == *pMBLayout && input.values.size() == m_inputBuffer.size() &&
+                           memcmp(input.values.data(), m_inputBuffer.data(), m_inputBuffer.size() * sizeof(ElemType)) == 0;
+    if (!unchanged)
+    {
+        input.values.swap(m_inputBuffer);
+        if (!input.layout)
+            input.layout = make_shared<MBLayout>();
+        input.layout->CopyFrom(pMBLayout);
+        input.version++;
+    }
+    return unchanged;
+}
+
+// EvaluateBatched - thread-safe Evaluate() of one request, i.e. one sequence of samples
+// Concurrent requests are evaluated together as parallel sequences of one minibatch; each request starts from a fresh state.
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateBatched(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+{
+    PendingRequest request = {&inputs, &outputs, nullptr, false, nullptr};
+    SubmitRequest(request);
+}
+
+// OpenStream - start a stream whose chunks are evaluated with carried-over PastValue state; returns its id
+template <class ElemType>
+size_t CNTKEval<ElemType>::OpenStream()
+{
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    if (m_net == nullptr)
+        LogicError("OpenStream: No model is loaded.");
+    if (!m_net->GetNodesWithType(OperationNameOf(FutureValueNode)).empty())
+        LogicError("OpenStream: Streaming evaluation requires a model without FutureValue nodes.");
+    const size_t streamId = m_nextStreamId++;
+    m_streams[streamId] = StreamState{std::vector<Matrix<ElemType>>(), 0};
+    return streamId;
+}
+
+// EvaluateStream - evaluate the next chunk of a stream, batched with concurrent chunks of other streams and EvaluateBatched() requests
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateStream(size_t streamId, std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+{
+    StreamState* stream;
+    {
+        std::lock_guard<std::mutex> lock(m_evalMutex);
+        auto iter = m_streams.find(streamId);
+        if (iter == m_streams.end())
+            InvalidArgument("EvaluateStream: Stream %d is not open.", (int) streamId);
+        stream = &iter->second;
+    }
+    PendingRequest request = {&inputs, &outputs, stream, false, nullptr};
+    SubmitRequest(request);
+}
+
+// CloseStream - release the state of a stream
+template <class ElemType>
+void CNTKEval<ElemType>::CloseStream(size_t streamId)
+{
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    if (m_streams.erase(streamId) == 0)
+        InvalidArgument("CloseStream: Stream %d is not open.", (int) streamId);
+}
+
+// EvaluateHypotheses - evaluate sequences with shared prefixes, each distinct prefix once
+// The sequences are arranged in a tree of segments: a segment holds the frames that all sequences through it have in
+// common after its parent segment. The tree is evaluated one level per minibatch (see EvaluateMerged()), where each
+// segment continues from a copy of the PastValue state its parent ended in, as the next chunk of a stream would.
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateHypotheses(std::vector<std::map<std::wstring, std::vector<ElemType>*>>& inputs, std::vector<std::map<std::wstring, std::vector<ElemType>*>>& outputs)
+{
+    if (inputs.size() != outputs.size())
+        InvalidArgument("EvaluateHypotheses: %d input maps for %d output maps.", (int) inputs.size(), (int) outputs.size());
+    if (inputs.empty())
+        return;
+    std::map<std::wstring, size_t> dimensions;
+    {
+        std::lock_guard<std::mutex> lock(m_evalMutex);
+        if (m_net == nullptr)
+            LogicError("EvaluateHypotheses: No model is loaded.");
+        if (!m_net->GetNodesWithType(OperationNameOf(FutureValueNode)).empty())
+            LogicError("EvaluateHypotheses: Prefix sharing requires a model without FutureValue nodes.");
+        GetNodeDimensions(dimensions, nodeInput);
+    }
+
+    // the length of each sequence
+    const size_t numHypotheses = inputs.size();
+    std::vector<size_t> lengths(numHypotheses, 0);
+    for (size_t h = 0; h < numHypotheses; h++)
+    {
+        if (inputs[h].size() != inputs[0].size() || outputs[h].size() != outputs[0].size())
+            InvalidArgument("EvaluateHypotheses: All sequences must use the same input and output nodes.");
+        for (const auto& input : inputs[h])
+        {
+            auto dim = dimensions.find(input.first);
+            if (dim == dimensions.end() || dim->second == 0 || inputs[0].find(input.first) == inputs[0].end())
+                InvalidArgument("EvaluateHypotheses: Input %ls not found in CNTK model, or not given for all sequences.", input.first.c_str());
+            const size_t length = input.second->size() / dim->second;
+            if (input.second->size() != length * dim->second || length == 0 || (lengths[h] != 0 && length != lengths[h]))
+                InvalidArgument("EvaluateHypotheses: Input %ls of sequence %d has %d values, which is not a consistent non-empty number of %d-dimensional samples.",
+                                input.first.c_str(), (int) h, (int) input.second->size(), (int) dim->second);
+            lengths[h] = length;
+        }
+        for (const auto& output : outputs[h])
+            if (outputs[0].find(output.first) == outputs[0].end())
+                InvalidArgument("EvaluateHypotheses: All sequences must use the same output nodes.");
+    }
+    auto sameFrame = [&](size_t h1, size_t t1, size_t h2, size_t t2)
+    {
+        for (const auto& input : inputs[h1])
+        {
+            const size_t rows = dimensions[input.first];
+            if (memcmp(input.second->data() + t1 * rows, inputs[h2][input.first]->data() + t2 * rows, rows * sizeof(ElemType)) != 0)
+                return false;
+        }
+        return true;
+    };
+
+    // build the tree
+    struct Segment
+    {
+        size_t parent;                // SIZE_MAX for the first segments of the sequences
+        size_t hypothesis;            // a sequence through this segment...
+        size_t begin, end;            // ...whose frames [begin, end) it holds
+        size_t depth;                 // number of ancestors
+        std::vector<size_t> children; // (their first frames differ)
+    };
+    std::vector<Segment> segments;
+    std::vector<size_t> roots;
+    auto findChild = [&](size_t parent, size_t h, size_t t)
+    {
+        const std::vector<size_t>& children = parent == SIZE_MAX ? roots : segments[parent].children;
+        for (size_t child : children)
+            if (sameFrame(segments[child].hypothesis, segments[child].begin, h, t))
+                return child;
+        return (size_t) SIZE_MAX;
+    };
+    for (size_t h = 0; h < numHypotheses; h++)
+    {
+        size_t parent = SIZE_MAX;
+        for (size_t t = 0; t < lengths[h];)
+        {
+            const size_t match = findChild(parent, h, t);
+            if (match == SIZE_MAX) // a new suffix
+            {
+                const size_t depth = parent == SIZE_MAX ? 0 : segments[parent].depth + 1;
+                segments.push_back(Segment{parent, h, t, lengths[h], depth, std::vector<size_t>()});
+                (parent == SIZE_MAX ? roots : segments[parent].children).push_back(segments.size() - 1);
+                break;
+            }
+            size_t common = 1;
+            while (segments[match].begin + common < segments[match].end && t + common < lengths[h] &&
+                   sameFrame(segments[match].hypothesis, segments[match].begin + common, h, t + common))
+                common++;
+            if (segments[match].begin + common < segments[match].end) // the sequence leaves the segment early: split it
+            {
+                Segment tail{match, segments[match].hypothesis, segments[match].begin + common, segments[match].end, segments[match].depth + 1, std::vector<size_t>()};
+                tail.children.swap(segments[match].children);
+                segments.push_back(tail);
+                const size_t tailIndex = segments.size() - 1;
+                for (size_t child : segments[tailIndex].children)
+                    segments[child].parent = tailIndex;
+                segments[match].end = segments[match].begin + common;
+                segments[match].children.assign(1, tailIndex);
+            }
+            parent = match;
+            t += common;
+        }
+    }
+    // (a split moves the segments below one level down)
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        segments[i].depth = 0;
+        for (size_t p = segments[i].parent; p != SIZE_MAX; p = segments[p].parent)
+            segments[i].depth++;
+    }
+
+    // evaluate it level by level
+    std::vector<StreamState> states(segments.size());
+    std::vector<std::map<std::wstring, std::vector<ElemType>>> segmentInputs(segments.size());
+    std::vector<std::map<std::wstring, std::vector<ElemType>>> segmentOutputs(segments.size());
+    std::vector<std::map<std::wstring, std::vector<ElemType>*>> segmentInputPointers(segments.size());
+    std::vector<std::map<std::wstring, std::vector<ElemType>*>> segmentOutputPointers(segments.size());
+    for (size_t level = 0;; level++)
+    {
+        std::vector<size_t> levelSegments;
+        for (size_t i = 0; i < segments.size(); i++)
+            if (segments[i].depth == level)
+                levelSegments.push_back(i);
+        if (levelSegments.empty())
+            break;
+        for (size_t b = 0; b < levelSegments.size(); b += m_maxBatchRequests)
+        {
+            std::vector<PendingRequest> requests;
+            for (size_t k = b; k < min(b + m_maxBatchRequests, levelSegments.size()); k++)
+            {
+                const size_t i = levelSegments[k];
+                const Segment& segment = segments[i];
+                if (segment.parent == SIZE_MAX)
+                    states[i] = StreamState{std::vector<Matrix<ElemType>>(), 0};
+                else
+                    states[i] = states[segment.parent]; // (a copy, on the device)
+                for (const auto& input : inputs[segment.hypothesis])
+                {
+                    const size_t rows = dimensions[input.first];
+                    auto& data = segmentInputs[i][input.first];
+                    data.assign(input.second->begin() + segment.begin * rows, input.second->begin() + segment.end * rows);
+                    segmentInputPointers[i][input.first] = &data;
+                }
+                for (const auto& output : outputs[0])
+                    segmentOutputPointers[i][output.first] = &segmentOutputs[i][output.first];
+                requests.push_back(PendingRequest{&segmentInputPointers[i], &segmentOutputPointers[i], &states[i], false, nullptr});
+            }
+            std::vector<PendingRequest*> requestPointers;
+            for (auto& request : requests)
+                requestPointers.push_back(&request);
+            EvaluateMerged(requestPointers);
+            for (const auto& request : requests)
+                if (request.error)
+                    std::rethrow_exception(request.error);
+        }
+        for (size_t i : levelSegments) // (the parents' states have been copied into their children)
+            if (segments[i].parent != SIZE_MAX)
+                states[segments[i].parent] = StreamState();
+    }
+
+    // concatenate the outputs along the path of each sequence
+    for (size_t h = 0; h < numHypotheses; h++)
+    {
+        std::vector<size_t> path;
+        for (size_t t = 0, parent = SIZE_MAX; t < lengths[h]; t += segments[parent].end - segments[parent].begin)
+        {
+            parent = findChild(parent, h, t);
+            path.push_back(parent);
+        }
+        for (auto& output : outputs[h])
+        {
+            output.second->clear();
+            for (size_t i : path)
+                output.second->insert(output.second->end(), segmentOutputs[i][output.first].begin(), segmentOutputs[i][output.first].end());
+        }
+    }
+}
+
+// SubmitRequest - wait until the request has been evaluated as part of a batch, possibly leading that batch
+template <class ElemType>
+void CNTKEval<ElemType>::SubmitRequest(PendingRequest& request)
+{
+    std::unique_lock<std::mutex> lock(m_batchMutex);
+    m_pendingRequests.push_back(&request);
+    m_batchCondition.notify_all(); // (a leader may be waiting for a full batch)
+    while (!request.done)
+    {
+        if (m_batchLeaderActive)
+        {
+            m_batchCondition.wait(lock);
+            continue;
+        }
+
+        // lead the next batch: give concurrent requests the latency budget to join
+        m_batchLeaderActive = true;
+        m_batchCondition.wait_for(lock, std::chrono::milliseconds(m_maxBatchLatencyMs), [this]
+                                  {
+                                      return m_pendingRequests.size() >= m_maxBatchRequests;
+                                  });
+        std::vector<PendingRequest*> batch;
+        for (auto iter = m_pendingRequests.begin(); iter != m_pendingRequests.end() && batch.size() < m_maxBatchRequests;)
+        {
+            // a stream's next chunk waits for the batch after the one that evaluates its previous chunk
+            PendingRequest* pending = *iter;
+            if (pending->stream && any_of(batch.begin(), batch.end(), [pending](const PendingRequest* other)
+                                          {
+                                              return other->stream == pending->stream;
+                                          }))
+            {
+                ++iter;
+                continue;
+            }
+            batch.push_back(pending);
+            iter = m_pendingRequests.erase(iter);
+        }
+        lock.unlock();
+
+        try
+        {
+            EvaluateMerged(batch);
+        }
+        catch (...)
+        {
+            for (auto* batchRequest : batch)
+                if (!batchRequest->error)
+                    batchRequest->error = std::current_exception();
+        }
+
+        lock.lock();
+        for (auto* batchRequest : batch)
+            batchRequest->done = true;
+        m_batchLeaderActive = false;
+        m_batchCondition.notify_all();
+    }
+    lock.unlock();
+
+    if (request.error)
+        std::rethrow_exception(request.error);
+}
+
+// EvaluateMerged - evaluate several requests as the parallel sequences of one minibatch
+// Frame t of request s goes into column t * requests.size() + s; the shorter requests are padded with gaps.
+// The sequence of a stream's chunk begins in its earlier chunks, whose last frames are restored into the PastValue nodes.
+// A request that does not fit (inconsistent record counts, or inputs/outputs different from the first request's) fails alone.
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateMerged(const std::vector<PendingRequest*>& allRequests)
+{
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    CPUThreadBudget cpuThreads(m_numCPUThreads, m_cpuCores);
+    if (!m_boundInputs.empty())
+        LogicError("EvaluateBatched: The input nodes reference bound buffers; use EvaluateBound().");
+    m_inputVersions.clear();
+    GetNodeDimensions(m_dimensions, nodeInput);
+    GetNodeDimensions(m_dimensions, nodeOutput);
+
+    auto sameKeys = [](const std::map<std::wstring, std::vector<ElemType>*>& a, const std::map<std::wstring, std::vector<ElemType>*>& b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (auto ia = a.begin(), ib = b.begin(); ia != a.end(); ++ia, ++ib)
+            if (ia->first != ib->first)
+                return false;
+        return true;
+    };
+
+    // determine each request's length
+    std::vector<PendingRequest*> requests;
+    std::vector<size_t> lengths;
+    for (auto* request : allRequests)
+    {
+        try
+        {
+            if (!requests.empty() && (!sameKeys(*request->inputs, *requests[0]->inputs) || !sameKeys(*request->outputs, *requests[0]->outputs)))
+                InvalidArgument("EvaluateBatched: all requests must use the same input and output nodes.");
+            size_t length = 0;
+            for (const auto& input : *request->inputs)
+            {
+                auto dim = m_dimensions.find(input.first);
+                if (dim == m_dimensions.end() || dim->second == 0)
+                    InvalidArgument("EvaluateBatched: input %ls not found in CNTK model.", input.first.c_str());
+                const size_t inputLength = input.second->size() / dim->second;
+                if (input.second->size() != inputLength * dim->second || inputLength == 0 || (length != 0 && inputLength != length))
+                    InvalidArgument("EvaluateBatched: input %ls has %d values, which is not a consistent non-empty number of %d-dimensional samples.",
+                                    input.first.c_str(), (int) input.second->size(), (int) dim->second);
+                length = inputLength;
+            }
+            for (const auto& output : *request->outputs)
+                if (m_dimensions.find(output.first) == m_dimensions.end())
+                    InvalidArgument("EvaluateBatched: output %ls not found in CNTK model.", output.first.c_str());
+            if (length == 0)
+                InvalidArgument("EvaluateBatched: request has no inputs.");
+            requests.push_back(request);
+            lengths.push_back(length);
+        }
+        catch (...)
+        {
+            request->error = std::current_exception();
+        }
+    }
+    if (requests.empty())
+        return;
+    const size_t numParallelSequences = requests.size();
+    const size_t numTimeSteps = *max_element(lengths.begin(), lengths.end());
+
+    // interleave the inputs
+    std::map<std::wstring, std::vector<ElemType>*> inputs;
+    for (const auto& input : *requests[0]->inputs)
+    {
+        const size_t rows = m_dimensions[input.first];
+        auto& merged = m_batchInputs[input.first];
+        merged.assign(rows * numParallelSequences * numTimeSteps, 0);
+        for (size_t s = 0; s < numParallelSequences; s++)
+        {
+            const ElemType* data = (*requests[s]->inputs)[input.first]->data();
+            for (size_t t = 0; t < lengths[s]; t++)
+                memcpy(merged.data() + (t * numParallelSequences + s) * rows, data + t * rows, rows * sizeof(ElemType));
+        }
+        inputs[input.first] = &merged;
+    }
+    std::map<std::wstring, std::vector<ElemType>*> outputs;
+    for (const auto& output : *requests[0]->outputs)
+    {
+        m_batchOutputs[output.first].clear();
+        outputs[output.first] = &m_batchOutputs[output.first];
+    }
+
+    // (no PastValue node reaches back further than m_maxTimeStep frames)
+    std::vector<size_t> historyLengths;
+    for (const auto* request : requests)
+        historyLengths.push_back(request->stream ? min(request->stream->numFrames, m_maxTimeStep) : 0);
+    RestoreStreamStates(requests);
+
+    ConfigParameters config;
+    if (m_reader == nullptr)
+        m_reader = new EvalReader<ElemType>(config);
+    m_reader->SetData(&inputs, &m_dimensions);
+    m_reader->SetSequenceLengths(lengths, historyLengths);
+    if (m_writer == nullptr)
+        m_writer = new EvalWriter<ElemType>(config);
+    m_writer->SetData(&outputs, &m_dimensions);
+
+    SimpleOutputWriter<ElemType> eval(m_net, 0);
+    eval.WriteOutput(*m_reader, numParallelSequences * numTimeSteps, *m_writer, vector<wstring>());
+    EndOfMinibatchCalibration(numParallelSequences * numTimeSteps);
+    SaveStreamStates(requests, lengths);
+
+    // and split the outputs back
+    for (const auto& output : outputs)
+    {
+        const size_t rows = m_dimensions[output.first];
+        const auto& merged = *output.second;
+        if (merged.size() != rows * numParallelSequences * numTimeSteps)
+            RuntimeError("EvaluateBatched: output %ls does not have one sample per input sample.", output.first.c_str());
+        for (size_t s = 0; s < numParallelSequences; s++)
+        {
+            std::vector<ElemType>& data = *(*requests[s]->outputs)[output.first];
+            data.resize(rows * lengths[s]);
+            for (size_t t = 0; t < lengths[s]; t++)
+                memcpy(data.data() + t * rows, merged.data() + (t * numParallelSequences + s) * rows, rows * sizeof(ElemType));
+        }
+    }
+}
+
+// RestoreStreamStates - let the PastValue nodes of the next minibatch, whose parallel sequence s is requests[s], see the last frames of each stream
+template <class ElemType>
+void CNTKEval<ElemType>::RestoreStreamStates(const std::vector<PendingRequest*>& requests)
+{
+    if (none_of(requests.begin(), requests.end(), [](const PendingRequest* request)
+                {
+                    return request->stream && !request->stream->delayedValues.empty();
+                }))
+        return; // (all sequences start here)
+
+    const size_t numParallelSequences = requests.size();
+    for (size_t i = 0; i < m_pastValueNodes.size(); i++)
+    {
+        const auto& node = m_pastValueNodes[i];
+        const size_t timeStep = node->GetTimeStep();
+        Matrix<ElemType> delayedValue(node->Value().GetNumRows(), timeStep * numParallelSequences, m_net->GetDeviceId());
+        delayedValue.SetValue(0); // (not seen by sequences that start here)
+        for (size_t s = 0; s < numParallelSequences; s++)
+        {
+            const StreamState* stream = requests[s]->stream;
+            if (!stream || stream->delayedValues.empty())
+                continue;
+            for (size_t k = 0; k < timeStep; k++)
+                delayedValue.SetColumnSlice(stream->delayedValues[i].ColumnSlice(k, 1), k * numParallelSequences + s, 1);
+        }
+        node->SetDelayedValue(delayedValue, numParallelSequences);
+    }
+}
+
+// SaveStreamStates - after a minibatch, keep the last frames of each PastValue node's input for every stream in it, in place
+template <class ElemType>
+void CNTKEval<ElemType>::SaveStreamStates(const std::vector<PendingRequest*>& requests, const std::vector<size_t>& lengths)
+{
+    const size_t numParallelSequences = requests.size();
+    const size_t numTimeSteps = *max_element(lengths.begin(), lengths.end());
+    for (size_t s = 0; s < numParallelSequences; s++)
+    {
+        StreamState* stream = requests[s]->stream;
+        if (!stream)
+            continue;
+        if (stream->delayedValues.empty())
+        {
+            for (const auto& node : m_pastValueNodes)
+            {
+                stream->delayedValues.push_back(Matrix<ElemType>(node->Value().GetNumRows(), node->GetTimeStep(), m_net->GetDeviceId()));
+                stream->delayedValues.back().SetValue(0);
+            }
+        }
+        for (size_t i = 0; i < m_pastValueNodes.size(); i++)
+        {
+            const auto& node = m_pastValueNodes[i];
+            const Matrix<ElemType>& input = node->GetDelayedValue(); // the node's input in this minibatch
+            if (input.GetNumCols() != numTimeSteps * numParallelSequences)
+                continue; // (not computed for these outputs)
+            // slot k holds frame (length - timeStep + k) of this chunk; a chunk shorter than timeStep shifts the older slots forward
+            Matrix<ElemType>& delayedValue = stream->delayedValues[i];
+            const ptrdiff_t timeStep = node->GetTimeStep();
+            for (ptrdiff_t k = 0; k < timeStep; k++)
+            {
+                const ptrdiff_t t = (ptrdiff_t) lengths[s] - timeStep + k;
+                if (t >= 0)
+                    delayedValue.SetColumnSlice(input.ColumnSlice(t * numParallelSequences + s, 1), k, 1);
+                else
+                    delayedValue.SetColumnSlice(delayedValue.ColumnSlice(k + lengths[s], 1), k, 1);
+            }
+        }
+        stream->numFrames += lengths[s];
+    }
+}
+
+// BindBuffer - bind a caller-owned buffer to an input or output node, for use by EvaluateBound()
+// nodeName - name of an input node, or of a node to be evaluated
+// buffer - column-major space for maxNumSamples samples of the node, on the model's device; nullptr unbinds
+template <class ElemType>
+void CNTKEval<ElemType>::BindBuffer(const std::wstring& nodeName, ElemType* buffer, size_t maxNumSamples)
+{
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    auto node = m_net->GetNodeFromName(nodeName);
+    const bool isInput = node->OperationName() == OperationNameOf(InputValue);
+    auto& bindings = isInput ? m_boundInputs : m_boundOutputs;
+    if (buffer == nullptr)
+    {
+        if (isInput && bindings.find(nodeName) != bindings.end())
+            dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value() = Matrix<ElemType>(m_net->GetDeviceId()); // drop the reference; the node owns its buffer again
+        bindings.erase(nodeName);
+    }
+    else if (maxNumSamples == 0)
+        InvalidArgument("BindBuffer: maxNumSamples must be greater than 0.");
+    else
+        bindings[nodeName] = BoundBuffer{buffer, maxNumSamples};
+}
+
+// EvaluateBound - evaluate numSamples samples as one sequence, read in place from the bound input buffers, into the bound output buffers
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateBound(size_t numSamples)
+{
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    CPUThreadBudget cpuThreads(m_numCPUThreads, m_cpuCores);
+    if (m_boundOutputs.empty())
+        LogicError("EvaluateBound: No output buffers are bound.");
+    if (numSamples == 0)
+        return;
+    m_inputVersions.clear();
+
+    std::vector<ComputationNodeBasePtr> outputNodes;
+    std::vector<std::wstring> outputNames;
+    for (const auto& binding : m_boundOutputs)
+    {
+        outputNodes.push_back(m_net->GetNodeFromName(binding.first));
+        outputNames.push_back(binding.first);
+    }
+    if (outputNames != m_allocatedOutputNames)
+    {
+        m_net->AllocateAllMatrices({}, outputNodes, nullptr);
+        m_allocatedOutputNames = outputNames;
+    }
+    m_net->StartEvaluateMinibatchLoop(outputNodes);
+
+    // let the input values reference the caller's buffers
+    std::vector<ComputationNodeBasePtr> inputNodes;
+    for (const auto& binding : m_boundInputs)
+    {
+        if (numSamples > binding.second.maxNumSamples)
+            InvalidArgument("EvaluateBound: %d samples exceed the %d bound for input %ls.", (int) numSamples, (int) binding.second.maxNumSamples, binding.first.c_str());
+        auto node = m_net->GetNodeFromName(binding.first);
+        dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().SetValue(node->GetSampleMatrixNumRows(), numSamples, m_net->GetDeviceId(), binding.second.buffer, matrixFlagDontOwnBuffer);
+        node->NotifyFunctionValuesMBSizeModified();
+        inputNodes.push_back(node);
+    }
+    auto pMBLayout = m_net->GetMBLayoutPtr();
+    pMBLayout->Init(1, numSamples);
+    pMBLayout->AddSequence(NEW_SEQUENCE_ID, 0, 0, numSamples);
+    m_net->DetermineActualMBSizeFromFeatures();
+    ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+
+    for (const auto& node : outputNodes)
+    {
+        m_net->ForwardProp(node);
+        const BoundBuffer& binding = m_boundOutputs[node->NodeName()];
+        const Matrix<ElemType>& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        if (value.GetNumCols() > binding.maxNumSamples)
+            InvalidArgument("EvaluateBound: Output %ls has %d samples, more than the %d bound.", node->NodeName().c_str(), (int) value.GetNumCols(), (int) binding.maxNumSamples);
+        Matrix<ElemType> output(value.GetNumRows(), value.GetNumCols(), binding.buffer, matrixFlagDontOwnBuffer, value.GetDeviceId());
+        output.SetValue(value);
+    }
+    EndOfMinibatchCalibration(numSamples);
 }
 
 // ResetState - Reset the cell state when we get start of an utterance
@@ -9,12 +9,19 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
 
 #include "Eval.h"
 #include "EvalReader.h"
 #include "EvalWriter.h"
 
 #include "ComputationNetwork.h"
+#include "LinearAlgebraNodes.h"
+#include "RecurrentNodes.h"
+#include "SharedParameterRegistry.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -29,10 +36,97 @@ class CNTKEval : public IEvaluateModel<ElemType>
     std::map<std::wstring, size_t> m_dimensions;
     size_t m_start;
 
+    // serializes all use of the network, reader and writer
+    std::mutex m_evalMutex;
+
+    // streams for EvaluateStream()
+    // Between chunks, a stream keeps what the next chunk's PastValue nodes reach back to, on the model's device.
+    struct StreamState
+    {
+        std::vector<Matrix<ElemType>> delayedValues; // [i] the last GetTimeStep() input frames of m_pastValueNodes[i]; empty before the first chunk
+        size_t numFrames;                            // evaluated so far
+    };
+    std::map<size_t, StreamState> m_streams;
+    size_t m_nextStreamId;
+    std::vector<shared_ptr<PastValueNode<ElemType>>> m_pastValueNodes;
+    size_t m_maxTimeStep; // of m_pastValueNodes
+
+    // dynamic batching for EvaluateBatched() and EvaluateStream()
+    // The first waiting caller leads: it collects requests for up to m_maxBatchLatencyMs, evaluates them as one minibatch, and wakes the others.
+    // All requests run on the one network, so the weights are held once; each request only brings its own input and output vectors.
+    struct PendingRequest
+    {
+        std::map<std::wstring, std::vector<ElemType>*>* inputs;
+        std::map<std::wstring, std::vector<ElemType>*>* outputs;
+        StreamState* stream; // continued by this request; nullptr if it starts from a fresh state
+        bool done;
+        std::exception_ptr error;
+    };
+    std::mutex m_batchMutex;
+    std::condition_variable m_batchCondition;
+    std::vector<PendingRequest*> m_pendingRequests; // waiting to be evaluated, in arrival order
+    bool m_batchLeaderActive;
+    size_t m_maxBatchLatencyMs;
+    size_t m_maxBatchRequests;
+
+    // merged minibatch buffers, reused across batches
+    std::map<std::wstring, std::vector<ElemType>> m_batchInputs;
+    std::map<std::wstring, std::vector<ElemType>> m_batchOutputs;
+
+    void SubmitRequest(PendingRequest& request);
+    void EvaluateMerged(const std::vector<PendingRequest*>& requests);
+    void RestoreStreamStates(const std::vector<PendingRequest*>& requests);
+    void SaveStreamStates(const std::vector<PendingRequest*>& requests, const std::vector<size_t>& lengths);
+
+    // caller-owned buffers for EvaluateBound()
+    // Input node values reference their buffer directly; output values are copied into theirs on the device, without any allocation.
+    struct BoundBuffer
+    {
+        ElemType* buffer;
+        size_t maxNumSamples;
+    };
+    std::map<std::wstring, BoundBuffer> m_boundInputs;
+    std::map<std::wstring, BoundBuffer> m_boundOutputs;
+    std::vector<std::wstring> m_allocatedOutputNames; // the bound outputs AllocateAllMatrices() was last done for (rebinding the same ones to new buffers keeps it)
+
+    // INT8 inference of TimesNodes (quantizeWeights=true)
+    std::vector<shared_ptr<TimesNode<ElemType>>> m_quantizedNodes;
+    size_t m_calibrationSamplesLeft; // the first samples evaluated determine the fixed input ranges; 0 = per-sample ranges
+
+    void EndOfMinibatchCalibration(size_t numSamples);
+
+    // reuse of node values across Evaluate() calls (cacheUnchangedInputs=true)
+    // An input is unchanged if its values and the minibatch layout are those of the previous minibatch, and no sequence
+    // reaches back before the minibatch (PastValue state); the nodes that only depend on unchanged inputs and parameters
+    // then keep their values. The other ways of evaluating change the node values, so they forget the versions.
+    struct InputVersion
+    {
+        std::vector<ElemType> values; // of the previous minibatch
+        MBLayoutPtr layout;           // of the previous minibatch
+        size_t version;               // number of changes seen
+        InputVersion()
+            : version(0)
+        {
+        }
+    };
+    bool m_cacheUnchangedInputs;
+    std::map<std::wstring, InputVersion> m_inputVersions;
+    std::vector<ElemType> m_inputBuffer;
+
+    bool IsInputUnchanged(const ComputationNodeBasePtr& node);
+
+    // CPU threads of this evaluator (numCPUThreads, cpuCores), applied during each evaluation with a CPUThreadBudget
+    int m_numCPUThreads;
+    std::vector<int> m_cpuCores; // empty: not bound
+    bool m_allocatedCores;       // m_cpuCores came from CPUThreadBudget::AllocateCores() (cpuCores=auto)
+
+    // the values the parameters of m_net reference (shareParameters=true); released after the network
+    std::vector<typename SharedParameterRegistry<ElemType>::StoragePtr> m_sharedParameters;
+
 public:
     // constructor
     CNTKEval()
-        : m_reader(nullptr), m_net(nullptr)
+        : m_reader(nullptr), m_writer(nullptr), m_net(nullptr), m_nextStreamId(0), m_maxTimeStep(0), m_batchLeaderActive(false), m_maxBatchLatencyMs(2), m_maxBatchRequests(64), m_calibrationSamplesLeft(0), m_cacheUnchangedInputs(false), m_numCPUThreads(1), m_allocatedCores(false)
     {
     }
 
@@ -54,6 +148,30 @@ public:
     // outputs - map from node name to output vector, outputs vectors need to be preallocated by caller, sizing will happen during evaluation
     virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
 
+    // EvaluateBatched - thread-safe Evaluate() of one request, i.e. one sequence of samples
+    // Concurrent requests are evaluated together as parallel sequences of one minibatch; each request starts from a fresh state.
+    virtual void EvaluateBatched(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+
+    // BindBuffer - bind a caller-owned buffer to an input or output node, for use by EvaluateBound()
+    // buffer - column-major space for maxNumSamples samples of the node, on the model's device; nullptr unbinds
+    virtual void BindBuffer(const std::wstring& nodeName, ElemType* buffer, size_t maxNumSamples);
+
+    // EvaluateBound - evaluate numSamples samples as one sequence, read in place from the bound input buffers, into the bound output buffers
+    virtual void EvaluateBound(size_t numSamples);
+
+    // OpenStream - start a stream, e.g. an utterance that arrives in chunks; returns its id
+    virtual size_t OpenStream();
+
+    // EvaluateStream - thread-safe evaluation of the next chunk of a stream, continuing the PastValue state where its previous chunk ended
+    // Concurrent chunks of different streams are evaluated together as parallel sequences of one minibatch, as in EvaluateBatched().
+    virtual void EvaluateStream(size_t streamId, std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+
+    // CloseStream - release the state of a stream; not while a chunk of it is being evaluated
+    virtual void CloseStream(size_t streamId);
+
+    // EvaluateHypotheses - evaluate sequences that share prefixes, evaluating each distinct prefix once; thread-safe
+    virtual void EvaluateHypotheses(std::vector<std::map<std::wstring, std::vector<ElemType>*>>& inputs, std::vector<std::map<std::wstring, std::vector<ElemType>*>>& outputs);
+
     virtual void Init(const std::string& config);
     virtual void Destroy();
     virtual void ResetState();
@@ -6,6 +6,7 @@
 
 #define DATAREADER_LOCAL
 #include "DataReader.h"
+#include <algorithm>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -25,6 +26,8 @@ private:
     size_t m_mbSize;
     vector<size_t> m_switchFrame;
     size_t m_oldSig;
+    vector<size_t> m_sequenceLengths; // if not empty: the data holds this many parallel sequences of these lengths, interleaved and padded to the longest
+    vector<size_t> m_historyLengths;  // if not empty: [s] frames of sequence s before this minibatch
 
 public:
     // Method to setup the data for the reader
@@ -34,6 +37,8 @@ public:
         m_dimensions = dimensions;
         m_currentRecord = 0;
         m_recordCount = 0;
+        m_sequenceLengths.clear();
+        m_historyLengths.clear();
         for (auto iter = inputs->begin(); iter != inputs->end(); ++iter)
         {
             // figure out the dimension of the data
@@ -55,6 +60,20 @@ public:
         }
     }
 
+    // declare the data set by SetData() as parallel sequences: column t * lengths.size() + s holds frame t of sequence s
+    // All of it is returned as a single minibatch, with the padding beyond each sequence's end marked as gaps.
+    // historyLengths, if given, are the numbers of frames of each sequence in earlier minibatches (streaming); else all sequences start here.
+    void SetSequenceLengths(const vector<size_t>& lengths, const vector<size_t>& historyLengths = vector<size_t>())
+    {
+        const size_t numTimeSteps = lengths.empty() ? 0 : *max_element(lengths.begin(), lengths.end());
+        if (m_recordCount != lengths.size() * numTimeSteps)
+            RuntimeError("EvalReader: %d parallel sequences of up to %d frames do not match the record count (%d).", (int) lengths.size(), (int) numTimeSteps, (int) m_recordCount);
+        if (!historyLengths.empty() && historyLengths.size() != lengths.size())
+            LogicError("EvalReader: %d history lengths given for %d parallel sequences.", (int) historyLengths.size(), (int) lengths.size());
+        m_sequenceLengths = lengths;
+        m_historyLengths = historyLengths;
+    }
+
     void SetBoundary(size_t newSig)
     {
         if (m_switchFrame.size() == 0)
@@ -110,7 +129,7 @@ public:
     // requestedEpochSamples - [in] number of samples to randomize, defaults to requestDataSize which uses the number of samples there are in the dataset
     virtual void StartMinibatchLoop(size_t mbSize, size_t /*epoch*/, size_t /*requestedEpochSamples=requestDataSize*/)
     {
-        m_mbSize = min(mbSize, m_recordCount);
+        m_mbSize = m_sequenceLengths.empty() ? min(mbSize, m_recordCount) : m_recordCount;
     }
 
     // GetMinibatch - Get the next minibatch (features and labels)
@@ -167,7 +186,7 @@ public:
 
     size_t GetNumParallelSequences()
     {
-        return 1;
+        return m_sequenceLengths.empty() ? 1 : m_sequenceLengths.size();
     }
 
     void SetNumParallelSequences(const size_t)
@@ -183,6 +202,21 @@ public:
     }
     void CopyMBLayoutTo(MBLayoutPtr pMBLayout)
     {
+        if (!m_sequenceLengths.empty())
+        {
+            // each parallel sequence ends in this minibatch, and starts in it unless it has a history
+            const size_t numParallelSequences = m_sequenceLengths.size();
+            const size_t numTimeSteps = m_mbSize / numParallelSequences;
+            pMBLayout->Init(numParallelSequences, numTimeSteps);
+            for (size_t s = 0; s < numParallelSequences; s++)
+            {
+                const ptrdiff_t beginTime = m_historyLengths.empty() ? 0 : -(ptrdiff_t) m_historyLengths[s];
+                pMBLayout->AddSequence(NEW_SEQUENCE_ID, s, beginTime, m_sequenceLengths[s]);
+                pMBLayout->AddGap(s, m_sequenceLengths[s], numTimeSteps);
+            }
+            return;
+        }
+
         assert(m_switchFrame.size() == 1);
         pMBLayout->Init(1, m_mbSize);
 
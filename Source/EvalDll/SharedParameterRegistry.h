@@ -0,0 +1,108 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// SharedParameterRegistry.h -- one copy of the parameter values that several models loaded into the same process share
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "Matrix.h"
+#include <memory>
+#include <mutex>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// SharedParameterRegistry -- deduplicates parameter tensors across the models of a process by their content
+//
+// Intern() gives the storage for a dense parameter matrix: one already registered with the same dimensions, device
+// and values (compared in full on a match of the content hash), or a new copy of it. Models reference that storage
+// with matrixFlagDontOwnBuffer views and keep the returned pointers for as long as they do; the registry only holds
+// weak references, so that storage no model uses any more is released. The shared values are read-only: a model
+// must not change them, which is why this is only for inference.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class SharedParameterRegistry
+{
+public:
+    typedef std::shared_ptr<const Matrix<ElemType>> StoragePtr;
+
+    static SharedParameterRegistry& Instance()
+    {
+        static SharedParameterRegistry registry;
+        return registry;
+    }
+
+    StoragePtr Intern(const Matrix<ElemType>& value)
+    {
+        if (value.GetMatrixType() != DENSE)
+            InvalidArgument("SharedParameterRegistry: only dense parameters can be shared.");
+        std::vector<ElemType> host;
+        CopyToHost(value, host);
+        const uint64_t key = Hash(value, host);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto range = m_entries.equal_range(key);
+        std::vector<ElemType> other;
+        for (auto iter = range.first; iter != range.second;)
+        {
+            StoragePtr storage = iter->second.lock();
+            if (!storage) // (no model uses it any more)
+            {
+                iter = m_entries.erase(iter);
+                continue;
+            }
+            if (storage->GetDeviceId() == value.GetDeviceId() && storage->GetNumRows() == value.GetNumRows() && storage->GetNumCols() == value.GetNumCols())
+            {
+                CopyToHost(*storage, other);
+                if (memcmp(other.data(), host.data(), host.size() * sizeof(ElemType)) == 0)
+                    return storage;
+            }
+            ++iter;
+        }
+        auto storage = std::make_shared<Matrix<ElemType>>(value.GetNumRows(), value.GetNumCols(), host.data(), matrixFlagNormal, value.GetDeviceId());
+        m_entries.insert(std::make_pair(key, std::weak_ptr<const Matrix<ElemType>>(storage)));
+        return storage;
+    }
+
+private:
+    SharedParameterRegistry()
+    {
+    }
+
+    static void CopyToHost(const Matrix<ElemType>& m, std::vector<ElemType>& buffer)
+    {
+        buffer.resize(m.GetNumElements());
+        if (buffer.empty())
+            return;
+        if (m.GetDeviceId() == CPUDEVICE)
+            memcpy(buffer.data(), m.BufferPointer(), buffer.size() * sizeof(ElemType));
+        else
+            m.CopySection(m.GetNumRows(), m.GetNumCols(), buffer.data(), m.GetNumRows());
+    }
+
+    // FNV-1a over the dimensions, the device and the bytes of the values
+    static uint64_t Hash(const Matrix<ElemType>& m, const std::vector<ElemType>& values)
+    {
+        const size_t header[3] = {m.GetNumRows(), m.GetNumCols(), (size_t) (m.GetDeviceId() + 1)};
+        uint64_t hash = 14695981039346656037ull;
+        const auto add = [&hash](const unsigned char* bytes, size_t numBytes)
+        {
+            for (size_t i = 0; i < numBytes; i++)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+        };
+        add((const unsigned char*) header, sizeof(header));
+        add((const unsigned char*) values.data(), values.size() * sizeof(ElemType));
+        return hash;
+    }
+
+    std::mutex m_mutex;
+    std::unordered_multimap<uint64_t, std::weak_ptr<const Matrix<ElemType>>> m_entries; // content hash -> storage
+};
+} } }
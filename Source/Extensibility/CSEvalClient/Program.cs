@@ -24,6 +24,8 @@ namespace Microsoft.MSR.CNTK.Extensibility.Managed.CSEvalClient
     /// This client shows two methods for obtaining the output results from the evaluation, the first as
     /// return values from the Evaluate method call (which only returns a single layer output), and the second
     /// by passing the allocated output layers to the evaluate method.
+    /// Finally, it evaluates a batch of samples with a pool of evaluators that several threads can share, passing
+    /// arrays that are read and written in place instead of being copied.
     /// </description>
     class Program
     {
@@ -40,15 +42,15 @@ namespace Microsoft.MSR.CNTK.Extensibility.Managed.CSEvalClient
                 Environment.CurrentDirectory = Path.Combine(Environment.CurrentDirectory, @"..\..\Examples\Image\MNIST\Data\");
                 
                 Dictionary<string, List<float>> outputs;
+                string config = GetConfig();
+                string modelFilePath = Path.Combine(Environment.CurrentDirectory, @"..\Output\Models\01_OneHidden");
 
                 using (var model = new IEvaluateModelManagedF())
                 {
                     // Initialize model evaluator
-                    string config = GetConfig();
                     model.Init(config);
 
                     // Load model
-                    string modelFilePath = Path.Combine(Environment.CurrentDirectory, @"..\Output\Models\01_OneHidden");
                     model.LoadModel(modelFilePath);
 
                     // Generate random input values in the appropriate structure and size
@@ -61,6 +63,17 @@ namespace Microsoft.MSR.CNTK.Extensibility.Managed.CSEvalClient
                     outputs = GetDictionary("ol.z", 10, 1);
                     model.Evaluate(inputs, outputs);                    
                 }
+
+                // A pool of evaluators can be shared by the threads of a service; each call waits for an idle one
+                // (evaluating arrays in place needs the model on the CPU)
+                using (var pool = new EvaluateModelPoolManagedF(config + "\ndeviceId=-1", modelFilePath, Environment.ProcessorCount))
+                {
+                    // a batch of 4 samples, one after the other
+                    const int batchSize = 4;
+                    var batchInputs = new Dictionary<string, float[]> { { "features", GetFloatArray(28*28*batchSize, 255).ToArray() } };
+                    var batchOutputs = new Dictionary<string, float[]> { { "ol.z", new float[10*batchSize] } };
+                    pool.Evaluate(batchInputs, batchOutputs);
+                }
                 
                 Console.WriteLine("--- Output results ---");
                 foreach (var item in outputs)
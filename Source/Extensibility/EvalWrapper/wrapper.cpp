@@ -10,6 +10,7 @@
 #include <string>
 #include <utility>
 #include <msclr\marshal_cppstd.h>
+#include <msclr\lock.h>
 
 #include "Eval.h"
 
@@ -19,6 +20,8 @@
 using namespace System;
 using namespace System::Collections::Generic;
 using namespace System::Collections;
+using namespace System::Collections::Concurrent;
+using namespace System::Runtime::InteropServices;
 using namespace Microsoft::MSR::CNTK;
 
 namespace Microsoft {
@@ -140,6 +143,82 @@ public:
         }
     }
 
+    /// <summary>Evaluates the model on a batch of samples, read in place from the input arrays and written in place into the output arrays</summary>
+    /// <param name="inputs">Map from input node name to its samples, one after the other (the number of samples times the node dimension)</param>
+    /// <param name="outputs">Map from output node name to the space for its samples (at least the number of samples times the node dimension)</param>
+    /// <returns>The number of samples evaluated</returns>
+    /// <remarks>The arrays are pinned for the call instead of being copied, so the model must be on the CPU (deviceId=-1).
+    /// All inputs must hold the same number of samples; a recurrent model sees them as one sequence.
+    /// Calls on one instance are serialized; use <see cref="EvaluateModelPoolManaged"> to evaluate from several threads.</remarks>
+    int Evaluate(Dictionary<String^, array<ElemType>^>^ inputs, Dictionary<String^, array<ElemType>^>^ outputs)
+    {
+        if (m_eval == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+
+        msclr::lock lock(this);
+
+        std::map<std::wstring, size_t> dimensions;
+        for each (auto item in inputs)
+        {
+            dimensions[msclr::interop::marshal_as<std::wstring>(item.Key)] = 0;
+        }
+        for each (auto item in outputs)
+        {
+            dimensions[msclr::interop::marshal_as<std::wstring>(item.Key)] = 0;
+        }
+        m_eval->GetNodeDimensions(dimensions, nodeSpecified);
+
+        int numSamples = -1;
+        for each (auto item in inputs)
+        {
+            size_t dim = dimensions[msclr::interop::marshal_as<std::wstring>(item.Key)];
+            if (dim == 0 || item.Value->Length % dim != 0 || (numSamples >= 0 && item.Value->Length / dim != numSamples))
+            {
+                throw gcnew ArgumentException(String::Format("Input {0} does not hold a whole number of samples, or not the same number as the other inputs.", item.Key));
+            }
+            numSamples = (int) (item.Value->Length / dim);
+        }
+        if (numSamples <= 0)
+        {
+            return 0;
+        }
+
+        List<GCHandle>^ pinned = gcnew List<GCHandle>();
+        std::vector<std::wstring> bound;
+        try
+        {
+            for each (auto item in inputs)
+            {
+                Bind(item.Key, item.Value, numSamples, pinned, bound);
+            }
+            for each (auto item in outputs)
+            {
+                size_t dim = dimensions[msclr::interop::marshal_as<std::wstring>(item.Key)];
+                if (dim == 0 || item.Value->Length < dim * numSamples)
+                {
+                    throw gcnew ArgumentException(String::Format("Output {0} has no space for {1} samples.", item.Key, numSamples));
+                }
+                Bind(item.Key, item.Value, item.Value->Length / dim, pinned, bound);
+            }
+
+            m_eval->EvaluateBound(numSamples);
+        }
+        finally
+        {
+            for (const auto& name : bound)
+            {
+                m_eval->BindBuffer(name, nullptr, 0);
+            }
+            for each (GCHandle handle in pinned)
+            {
+                handle.Free();
+            }
+        }
+        return numSamples;
+    }
+
     /// <summary>Evaluates the model against input data and retrieves the output layer data</summary>
     /// <param name="inputs"></param>
     /// <param name="outputKey"></param>
@@ -191,15 +270,25 @@ private:
     shared_ptr<std::vector<ElemType>> CopyList(List<ElemType>^ list)
     {
         shared_ptr<std::vector<ElemType>> lower(new std::vector<ElemType>());
-        if (list != nullptr)
+        if (list != nullptr && list->Count > 0)
         {
-            for each (ElemType item in list)
-            {
-                lower->push_back(item);
-            }
+            // one block copy out of the list's array instead of enumerating it
+            array<ElemType>^ items = list->ToArray();
+            pin_ptr<ElemType> first = &items[0];
+            lower->assign((ElemType*) first, (ElemType*) first + items->Length);
         }
         return lower;
     }
+
+    /// <summary>Pins an array and binds it to a node of the native model, for EvaluateBound()</summary>
+    void Bind(String^ nodeName, array<ElemType>^ values, size_t maxNumSamples, List<GCHandle>^ pinned, std::vector<std::wstring>& bound)
+    {
+        GCHandle handle = GCHandle::Alloc(values, GCHandleType::Pinned);
+        pinned->Add(handle);
+        const std::wstring name = msclr::interop::marshal_as<std::wstring>(nodeName);
+        m_eval->BindBuffer(name, (ElemType*) handle.AddrOfPinnedObject().ToPointer(), maxNumSamples);
+        bound.push_back(name);
+    }
 };
 
 /// <summary>Managed float-specific model evaluation class</summary>
@@ -224,6 +313,116 @@ public:
     }
 };
 
+/// <summary>Pool of native evaluators of one model, to be shared by managed threads</summary>
+/// <remarks>Each call takes an idle evaluator, waiting for one while all are busy, so that up to numEvaluators calls run at once.</remarks>
+template<typename ElemType, typename Evaluator>
+public ref class EvaluateModelPoolManaged : IDisposable
+{
+public:
+    /// <summary>Initializes a new instance of the <see cref="EvaluateModelPoolManaged"> class.</summary>
+    /// <param name="config">Model configuration entries, passed to the Init() of every evaluator</param>
+    /// <param name="modelFileName">The model file to load into every evaluator, or null if the configuration names it (modelPath)</param>
+    /// <param name="numEvaluators">The number of evaluators, i.e. of calls that can run at the same time</param>
+    EvaluateModelPoolManaged(String^ config, String^ modelFileName, int numEvaluators)
+    {
+        if (numEvaluators <= 0)
+        {
+            throw gcnew ArgumentOutOfRangeException("numEvaluators");
+        }
+
+        m_evaluators = gcnew List<Evaluator^>();
+        m_idle = gcnew BlockingCollection<Evaluator^>();
+        for (int i = 0; i < numEvaluators; i++)
+        {
+            Evaluator^ evaluator = gcnew Evaluator();
+            m_evaluators->Add(evaluator);
+            evaluator->Init(config);
+            if (modelFileName != nullptr)
+            {
+                evaluator->LoadModel(modelFileName);
+            }
+            m_idle->Add(evaluator);
+        }
+    }
+
+    /// <summary>Evaluates a batch of samples in place, as IEvaluateModelManaged.Evaluate() with arrays does, on an idle evaluator</summary>
+    int Evaluate(Dictionary<String^, array<ElemType>^>^ inputs, Dictionary<String^, array<ElemType>^>^ outputs)
+    {
+        Evaluator^ evaluator = Take();
+        try
+        {
+            return evaluator->Evaluate(inputs, outputs);
+        }
+        finally
+        {
+            m_idle->Add(evaluator);
+        }
+    }
+
+    /// <summary>Evaluates the model against input data and retrieves the output layer data, on an idle evaluator</summary>
+    void Evaluate(Dictionary<String^, List<ElemType>^>^ inputs, Dictionary<String^, List<ElemType>^>^ outputs)
+    {
+        Evaluator^ evaluator = Take();
+        try
+        {
+            evaluator->Evaluate(inputs, outputs);
+        }
+        finally
+        {
+            m_idle->Add(evaluator);
+        }
+    }
+
+    ~EvaluateModelPoolManaged()
+    {
+        if (m_evaluators == nullptr)
+        {
+            return;
+        }
+
+        // (disposing while calls are running is the caller's error, as for a single evaluator)
+        for each (Evaluator^ evaluator in m_evaluators)
+        {
+            delete evaluator;
+        }
+        m_evaluators = nullptr;
+        delete m_idle;
+    }
+
+private:
+    List<Evaluator^>^ m_evaluators;
+    BlockingCollection<Evaluator^>^ m_idle;
+
+    Evaluator^ Take()
+    {
+        if (m_evaluators == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+        return m_idle->Take();
+    }
+};
+
+/// <summary>Managed float-specific evaluator pool</summary>
+public ref class EvaluateModelPoolManagedF : EvaluateModelPoolManaged<float, IEvaluateModelManagedF>
+{
+public:
+    EvaluateModelPoolManagedF::EvaluateModelPoolManagedF(String^ config, String^ modelFileName, int numEvaluators)
+        : EvaluateModelPoolManaged(config, modelFileName, numEvaluators)
+    {
+    }
+};
+
+/// <summary>Managed double-specific evaluator pool</summary>
+public ref class EvaluateModelPoolManagedD : EvaluateModelPoolManaged<double, IEvaluateModelManagedD>
+{
+public:
+    EvaluateModelPoolManagedD::EvaluateModelPoolManagedD(String^ config, String^ modelFileName, int numEvaluators)
+        : EvaluateModelPoolManaged(config, modelFileName, numEvaluators)
+    {
+    }
+};
+
 // This method tricks the compiler into emitting the methods of the classes
 // Refer to https://msdn.microsoft.com/en-us/library/ms177213.aspx for an
 // explanation to this behavior
@@ -231,15 +430,25 @@ void emit()
 {
     IEvaluateModelManagedF f;
     f.Init("");
-    f.Evaluate(nullptr, nullptr);
+    f.Evaluate((Dictionary<String^, List<float>^>^) nullptr, (Dictionary<String^, List<float>^>^) nullptr);
     f.Evaluate(nullptr, "", 0);
+    f.Evaluate((Dictionary<String^, array<float>^>^) nullptr, (Dictionary<String^, array<float>^>^) nullptr);
     f.LoadModel("");
 
+    EvaluateModelPoolManagedF^ fp = gcnew EvaluateModelPoolManagedF("", nullptr, 1);
+    fp->Evaluate((Dictionary<String^, array<float>^>^) nullptr, (Dictionary<String^, array<float>^>^) nullptr);
+    fp->Evaluate((Dictionary<String^, List<float>^>^) nullptr, (Dictionary<String^, List<float>^>^) nullptr);
+
     IEvaluateModelManagedD d;
     d.Init("");
-    d.Evaluate(nullptr, nullptr);
+    d.Evaluate((Dictionary<String^, List<double>^>^) nullptr, (Dictionary<String^, List<double>^>^) nullptr);
     d.Evaluate(nullptr, "", 0);
+    d.Evaluate((Dictionary<String^, array<double>^>^) nullptr, (Dictionary<String^, array<double>^>^) nullptr);
     d.LoadModel("");
+
+    EvaluateModelPoolManagedD^ dp = gcnew EvaluateModelPoolManagedD("", nullptr, 1);
+    dp->Evaluate((Dictionary<String^, array<double>^>^) nullptr, (Dictionary<String^, array<double>^>^) nullptr);
+    dp->Evaluate((Dictionary<String^, List<double>^>^) nullptr, (Dictionary<String^, List<double>^>^) nullptr);
 }
 }
 }
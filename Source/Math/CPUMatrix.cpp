@@ -11,6 +11,8 @@
 
 #include "CPUMatrix.h"
 #include "TensorOps.h"
+#include "CPUVectorKernels.h"
+#include "HugePageMemAllocator.h"
 #include <assert.h>
 #include <stdexcept>
 #include <omp.h>
@@ -19,6 +21,7 @@
 #include <chrono>
 #include <exception>
 #include <thread>
+#include <mutex>
 #include <iostream>
 #include <algorithm>
 #ifdef _WIN32
@@ -29,6 +32,8 @@
 #define max(a, b) (((a) > (b)) ? (a) : (b))
 #endif
 #include <cfloat>
+#include <pthread.h>
+#include <sched.h>
 #endif
 
 #ifdef LEAKDETECT
@@ -78,6 +83,37 @@ bool TracingGPUMemoryAllocator::IsTraceEnabled()
     return (m_traceLevel > 0);
 }
 
+bool MATH_API TracingGPUMemoryAllocator::m_cachingEnabled = true;
+
+void TracingGPUMemoryAllocator::SetCachingEnabled(bool enabled)
+{
+    m_cachingEnabled = enabled;
+}
+
+bool TracingGPUMemoryAllocator::IsCachingEnabled()
+{
+    return m_cachingEnabled;
+}
+
+bool MATH_API GPUKernelTuning::m_enabled = false;
+int MATH_API GPUKernelTuning::m_traceLevel = 0;
+
+void GPUKernelTuning::SetEnabled(bool enabled, int traceLevel)
+{
+    m_enabled = enabled;
+    m_traceLevel = traceLevel;
+}
+
+bool GPUKernelTuning::IsEnabled()
+{
+    return m_enabled;
+}
+
+int GPUKernelTuning::GetTraceLevel()
+{
+    return m_traceLevel;
+}
+
 #pragma region Helpful Enum Definitions
 enum class MatrixOrder
 {
@@ -139,18 +175,49 @@ CPUMatrix<ElemType>::CPUMatrix(FILE* f, const char* matrixName)
 
 // helper to allocate an array of ElemType
 // Use this instead of new[] to get NaN initialization for debugging.
+// Large arrays are zeroed by the OpenMP threads with the same static partitioning the kernels use, so that on NUMA
+// machines the pages are first touched, and thus placed, on the node of the thread that later works on them.
 template <class ElemType>
-static ElemType* NewArray(size_t n)
+static void FirstTouchZero(ElemType* p, size_t n)
 {
-    ElemType* p = new ElemType[n]();
+    const long numElements = (long) n;
+#pragma omp parallel for schedule(static) if (numElements >= 65536)
+    for (long i = 0; i < numElements; i++)
+        p[i] = 0;
 #if 0 // _DEBUG
         ElemType nan = Matrix<ElemType>::MakeNan(__LINE__);
         for (size_t i = 0; i < n; i++)
             p[i] = nan;
 #endif
+}
+
+template <class ElemType>
+static ElemType* NewArray(size_t n)
+{
+    ElemType* p = new ElemType[n];
+    FirstTouchZero(p, n);
     return p;
 }
 
+// helpers for the element storage of a matrix (m_pArray): large ones on huge pages if enabled (see HugePageMemAllocator)
+// Arrays handed to callers (CopyToArray()) still come from NewArray(), since they are released with delete[].
+template <class ElemType>
+static ElemType* NewStorageArray(size_t n)
+{
+    if (!HugePageMemAllocator::IsUsedFor(n * sizeof(ElemType)))
+        return NewArray<ElemType>(n);
+    ElemType* p = (ElemType*) HugePageMemAllocator::Allocate(n * sizeof(ElemType));
+    FirstTouchZero(p, n);
+    return p;
+}
+
+template <class ElemType>
+static void DeleteStorageArray(ElemType* p)
+{
+    if (!HugePageMemAllocator::Deallocate(p))
+        delete[] p;
+}
+
 template <class ElemType>
 CPUMatrix<ElemType>::CPUMatrix(const size_t numRows, const size_t numCols)
 {
@@ -161,7 +228,7 @@ CPUMatrix<ElemType>::CPUMatrix(const size_t numRows, const size_t numCols)
     m_elemSizeAllocated = GetNumElements();
 
     if (m_elemSizeAllocated != 0)
-        m_pArray = NewArray<ElemType>(m_elemSizeAllocated);
+        m_pArray = NewStorageArray<ElemType>(m_elemSizeAllocated);
 }
 
 template <class ElemType>
@@ -215,7 +282,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::operator=(CPUMatrix<ElemType>&& moveFr
     if (this != &moveFrom)
     {
         if (OwnBuffer() && m_pArray != nullptr)
-            delete[] m_pArray; // always delete the data pointer since we will use the pointer from moveFrom
+            DeleteStorageArray(m_pArray); // always delete the data pointer since we will use the pointer from moveFrom
 
         m_computeDevice = moveFrom.m_computeDevice;
         m_numRows = moveFrom.m_numRows;
@@ -242,7 +309,7 @@ void CPUMatrix<ElemType>::Clear()
 {
     if (m_pArray != nullptr && OwnBuffer())
     {
-        delete[] m_pArray;
+        DeleteStorageArray(m_pArray);
         m_pArray = nullptr;
         m_elemSizeAllocated = 0;
     }
@@ -619,6 +686,67 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddToRowRepeatValuesOf(const CPUMatrix
     return *this;
 }
 
+// this(k * a.GetNumRows() + i, j) = a(i, sourceColumns(k, j))
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignRowStackedColumnsOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& sourceColumns)
+{
+    if (this == &a)
+        LogicError("AssignRowStackedColumnsOf: a is the same as [this]. Does not support inplace operation.");
+
+    if (a.IsEmpty())
+        LogicError("AssignRowStackedColumnsOf: Matrix a is empty.");
+
+    const long m = (long) a.GetNumRows(), K = (long) sourceColumns.GetNumRows(), n = (long) sourceColumns.GetNumCols();
+    for (size_t idx = 0; idx < sourceColumns.GetNumElements(); idx++)
+        if ((size_t) sourceColumns.m_pArray[idx] >= a.GetNumCols())
+            LogicError("AssignRowStackedColumnsOf: source column index out of range.");
+
+    Resize(m * K, n);
+    auto& us = *this;
+
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        for (long k = 0; k < K; k++)
+        {
+            const size_t col = (size_t) sourceColumns(k, j);
+            memcpy(&us(k * m, j), &a(0, col), sizeof(ElemType) * m);
+        }
+    }
+
+    return *this;
+}
+
+// this(i, sourceColumns(k, j)) += a(k * GetNumRows() + i, j)
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddFromRowStackedColumnsOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& sourceColumns)
+{
+    if (a.IsEmpty())
+        LogicError("AddFromRowStackedColumnsOf: input matrix a is empty.");
+
+    const long m = (long) GetNumRows(), K = (long) sourceColumns.GetNumRows(), n = (long) sourceColumns.GetNumCols();
+    if (a.GetNumRows() != m * K || a.GetNumCols() != n)
+        LogicError("AddFromRowStackedColumnsOf: a must have GetNumRows() * sourceColumns.GetNumRows() rows and sourceColumns.GetNumCols() columns.");
+
+    auto& us = *this;
+
+    // several (k, j) may map to the same target column, so parallelize over rows instead
+#pragma omp parallel for
+    for (long i = 0; i < m; i++)
+    {
+        for (long j = 0; j < n; j++)
+        {
+            for (long k = 0; k < K; k++)
+            {
+                const size_t col = (size_t) sourceColumns(k, j);
+                us(i, col) += a(k * m + i, j);
+            }
+        }
+    }
+
+    return *this;
+}
+
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignPositiveAndShiftedNegSample(const CPUMatrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber)
 {
@@ -847,8 +975,8 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
     if (matrixFlags & matrixFlagDontOwnBuffer)
     {
         // free previous array allocation if any before overwriting
-        if (m_pArray != nullptr)
-            delete[] m_pArray;
+        if (m_pArray != nullptr && OwnBuffer())
+            DeleteStorageArray(m_pArray);
 
         m_pArray = pArray;
         m_numRows = numRows;
@@ -905,6 +1033,33 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
     }
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::SetValueFromCompact(const size_t numRows, const size_t numCols, const void* pArray, CompactElementType type, ElemType scale, const ElemType* rowShift)
+{
+    m_format = matrixFormatDense;
+    m_computeDevice = CPUDEVICE;
+    Resize(numRows, numCols);
+
+    const long n = (long) numCols;
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        ElemType* dst = m_pArray + j * numRows;
+        if (type == compactElementUInt8)
+        {
+            const unsigned char* src = (const unsigned char*) pArray + j * numRows;
+            for (size_t i = 0; i < numRows; i++)
+                dst[i] = scale * (ElemType) src[i] + (rowShift ? rowShift[i] : 0);
+        }
+        else
+        {
+            const unsigned short* src = (const unsigned short*) pArray + j * numRows;
+            for (size_t i = 0; i < numRows; i++)
+                dst[i] = scale * (ElemType) Float16ToFloat(src[i]) + (rowShift ? rowShift[i] : 0);
+        }
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::SetDiagonalValue(const ElemType v)
 {
@@ -990,34 +1145,18 @@ void CPUMatrix<ElemType>::SetDiagonalValue(const CPUMatrix<ElemType>& vector)
     }
 }
 
+// The random fills compute each element on its own (see ResolveRandomSeed() in CommonMatrix.h), hence in parallel.
 template <class ElemType>
 void CPUMatrix<ElemType>::SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed)
 {
     if (IsEmpty())
         LogicError("SetUniformRandomValue: Matrix is empty.");
 
-#ifdef _MSC_VER // TODO: check if available under GCC/Linux
-    std::ranlux64_base_01 generator;
-    generator.seed(seed == USE_TIME_BASED_SEED ? (unsigned long) time(NULL) : seed);
-#else
-    std::default_random_engine generator(seed);
-#endif
-    std::uniform_real_distribution<ElemType> r(low, high);
-
-    long m = (long) GetNumElements();
-    // four-way unrolling
-    for (long i = 0; i < (m & ~3); i += 4)
-    {
-        m_pArray[i] = r(generator);
-        m_pArray[i + 1] = r(generator);
-        m_pArray[i + 2] = r(generator);
-        m_pArray[i + 3] = r(generator);
-    }
-    // handle remaining stuffs
-    for (long i = m & ~3; i < m; i++)
-    {
-        m_pArray[i] = r(generator);
-    }
+    const unsigned long long streamSeed = ResolveRandomSeed(seed);
+    ElemType* us = m_pArray;
+#pragma omp parallel for
+    for (long i = 0; i < (long) GetNumElements(); i++)
+        us[i] = low + (high - low) * UniformRandomAt<ElemType>(streamSeed, i);
 }
 
 template <class ElemType>
@@ -1029,19 +1168,11 @@ void CPUMatrix<ElemType>::SetGaussianRandomValue(const ElemType mean, const Elem
     if (IsEmpty())
         LogicError("SetUniformRandomValue: Matrix is empty.");
 
-    auto& us = *this;
-#ifdef _MSC_VER // TODO: check if available under GCC/Linux
-    std::ranlux64_base_01 generator;
-    generator.seed(seed == USE_TIME_BASED_SEED ? (unsigned long) time(NULL) : seed);
-#else
-    std::default_random_engine generator(seed);
-#endif
-    std::normal_distribution<ElemType> r(mean, sigma);
-    // #pragma omp parallel for   // is it thread safe?
-    foreach_coord (i, j, us)
-    {
-        us(i, j) = r(generator);
-    }
+    const unsigned long long streamSeed = ResolveRandomSeed(seed);
+    ElemType* us = m_pArray;
+#pragma omp parallel for
+    for (long i = 0; i < (long) GetNumElements(); i++)
+        us[i] = mean + sigma * GaussianRandomAt<ElemType>(streamSeed, i);
 }
 
 template <class ElemType>
@@ -1053,74 +1184,27 @@ void CPUMatrix<ElemType>::AddGaussianRandomValue(const ElemType mean, const Elem
     if (IsEmpty())
         LogicError("SetUniformRandomValue: Matrix is empty.");
 
-    auto& us = *this;
-#ifdef _MSC_VER // TODO: check if available under GCC/Linux
-    std::ranlux64_base_01 generator;
-    generator.seed(seed == USE_TIME_BASED_SEED ? (unsigned long) time(NULL) : seed);
-#else
-    std::default_random_engine generator(seed);
-#endif
-    std::normal_distribution<ElemType> r(mean, sigma);
-
-    long m = (long) GetNumRows(), n = (long) GetNumCols();
-    for (long j = 0; j < n; j++)
-    {
-        // four-way unrolling
-        for (long i = 0; i < (m & ~3); i += 4)
-        {
-            us(i, j) = r(generator);
-            us(i + 1, j) = r(generator);
-            us(i + 2, j) = r(generator);
-            us(i + 3, j) = r(generator);
-        }
-        // handle remaining stuffs
-        for (long i = m & ~3; i < m; i++)
-        {
-            us(i, j) = r(generator);
-        }
-    }
+    const unsigned long long streamSeed = ResolveRandomSeed(seed);
+    ElemType* us = m_pArray;
+#pragma omp parallel for
+    for (long i = 0; i < (long) GetNumElements(); i++)
+        us[i] += mean + sigma * GaussianRandomAt<ElemType>(streamSeed, i);
 }
 
 //maskRate: percentage of values masked out (similar to dropout rate)
 //scaleValue: which scale value to set to the left ones (unmasked items).
+// This is the same mask as AddDropoutOf() applies for the same seed.
 template <class ElemType>
 void CPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, unsigned long seed)
 {
     if (IsEmpty())
         LogicError("SetUniformRandomValue: Matrix is empty.");
 
-    auto& us = *this;
-#ifdef _MSC_VER // TODO: check if available under GCC/Linux
-    std::ranlux64_base_01 generator;
-    generator.seed(seed == USE_TIME_BASED_SEED ? (unsigned long) time(NULL) : seed);
-#else
-    std::default_random_engine generator(seed == USE_TIME_BASED_SEED ? (unsigned long) time(NULL) : seed);
-#endif
-    std::uniform_real_distribution<ElemType> r(0, 1);
-
-    long m = (long) GetNumRows(), n = (long) GetNumCols();
-    ElemType v;
-    for (long j = 0; j < n; j++)
-    {
-        // four-way unrolling
-        for (long i = 0; i < (m & ~3); i += 4)
-        {
-            v = r(generator);
-            us(i, j) = v <= maskRate ? 0 : scaleValue;
-            v = r(generator);
-            us(i + 1, j) = v <= maskRate ? 0 : scaleValue;
-            v = r(generator);
-            us(i + 2, j) = v <= maskRate ? 0 : scaleValue;
-            v = r(generator);
-            us(i + 3, j) = v <= maskRate ? 0 : scaleValue;
-        }
-        // handle remaining stuffs
-        for (long i = m & ~3; i < m; i++)
-        {
-            v = r(generator);
-            us(i, j) = v <= maskRate ? 0 : scaleValue;
-        }
-    }
+    const unsigned long long streamSeed = ResolveRandomSeed(seed);
+    ElemType* us = m_pArray;
+#pragma omp parallel for
+    for (long i = 0; i < (long) GetNumElements(); i++)
+        us[i] = DropoutMaskAt<ElemType>(streamSeed, i, maskRate, scaleValue);
 }
 
 template <class ElemType>
@@ -1238,6 +1322,122 @@ void CPUMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& gradients,
     }
 }
 
+// state of LarsUpdate() and LambUpdate(): 'numStates' matrices like the gradient, followed by columns for a few scalars
+// (squared norms, step count), which start out as 0
+static size_t NumColsForUpdateState(size_t numRows, size_t numCols, size_t numStates)
+{
+    const size_t numScalars = 4;
+    return numStates * numCols + (numScalars + numRows - 1) / numRows;
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::LarsUpdate(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRate, ElemType momentum, ElemType trustCoefficient)
+{
+    const size_t numColsNeeded = NumColsForUpdateState(gradients.GetNumRows(), gradients.GetNumCols(), 1);
+    if (IsEmpty() || GetNumCols() < numColsNeeded)
+    {
+        Resize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    const long n = (long) gradients.GetNumElements();
+    const ElemType* grad = gradients.m_pArray;
+    ElemType* velocity = m_pArray;
+    ElemType* val = functionValues.m_pArray;
+    double sumSqrW = 0, sumSqrG = 0;
+#pragma omp parallel for reduction(+ : sumSqrW, sumSqrG)
+    for (long i = 0; i < n; i++)
+    {
+        sumSqrW += (double) val[i] * val[i];
+        sumSqrG += (double) grad[i] * grad[i];
+    }
+    const ElemType trust = sumSqrW > 0 && sumSqrG > 0 ? (ElemType)(trustCoefficient * sqrt(sumSqrW / sumSqrG)) : 1;
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+    {
+        velocity[i] = momentum * velocity[i] + learnRate * trust * grad[i];
+        val[i] -= velocity[i];
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::LambUpdate(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRate, ElemType beta1, ElemType beta2, ElemType epsilon, ElemType weightDecay)
+{
+    const size_t numColsNeeded = NumColsForUpdateState(gradients.GetNumRows(), gradients.GetNumCols(), 2);
+    if (IsEmpty() || GetNumCols() < numColsNeeded)
+    {
+        Resize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    const long n = (long) gradients.GetNumElements();
+    const ElemType* grad = gradients.m_pArray;
+    ElemType* smoothMom = m_pArray;
+    ElemType* smoothSqr = m_pArray + n;
+    ElemType* scalars = m_pArray + 2 * n; // [0..1] (GPU only), [2] step
+    ElemType* val = functionValues.m_pArray;
+    scalars[2] += 1;
+    const ElemType momCorrection = (ElemType)(1 - pow(beta1, scalars[2]));
+    const ElemType sqrCorrection = (ElemType)(1 - pow(beta2, scalars[2]));
+
+    // pass 1: moments, and the norms of W and of the update direction r (which is recomputed in pass 2 rather than stored)
+    double sumSqrW = 0, sumSqrR = 0;
+#pragma omp parallel for reduction(+ : sumSqrW, sumSqrR)
+    for (long i = 0; i < n; i++)
+    {
+        const ElemType g = grad[i];
+        smoothMom[i] = beta1 * smoothMom[i] + (1 - beta1) * g;
+        smoothSqr[i] = beta2 * smoothSqr[i] + (1 - beta2) * g * g;
+        const ElemType r = (smoothMom[i] / momCorrection) / (sqrt(smoothSqr[i] / sqrCorrection) + epsilon) + weightDecay * val[i];
+        sumSqrW += (double) val[i] * val[i];
+        sumSqrR += (double) r * r;
+    }
+    const ElemType trust = sumSqrW > 0 && sumSqrR > 0 ? (ElemType) sqrt(sumSqrW / sumSqrR) : 1;
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+    {
+        const ElemType r = (smoothMom[i] / momCorrection) / (sqrt(smoothSqr[i] / sqrCorrection) + epsilon) + weightDecay * val[i];
+        val[i] -= learnRate * trust * r;
+    }
+}
+
+// per parameter: clip g, g += l2Weight W, v = momentum v + (1 - momentum) learnRatePerSample g, W -= v (or its Nesterov form), soft-threshold W
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::MultiTensorNormalGrad(const std::vector<CPUMatrix<ElemType>*>& functionValues, const std::vector<CPUMatrix<ElemType>*>& gradients, const std::vector<CPUMatrix<ElemType>*>& smoothedGradients,
+                                                         ElemType learnRatePerSample, ElemType momentum, bool useNesterovMomentum,
+                                                         ElemType clippingThreshold, bool clipByTruncation, ElemType l2Weight, ElemType l1Threshold)
+{
+    const bool isClipped = clippingThreshold != std::numeric_limits<ElemType>::infinity();
+    for (size_t k = 0; k < functionValues.size(); k++)
+    {
+        const long n = (long) gradients[k]->GetNumElements();
+        const ElemType* grad = gradients[k]->m_pArray;
+        ElemType* smooth = smoothedGradients[k]->m_pArray;
+        ElemType* val = functionValues[k]->m_pArray;
+        ElemType scale = 1;
+        if (isClipped && !clipByTruncation)
+        {
+            const double norm = gradients[k]->FrobeniusNorm();
+            if (norm > clippingThreshold)
+                scale = (ElemType)(clippingThreshold / norm);
+        }
+#pragma omp parallel for
+        for (long i = 0; i < n; i++)
+        {
+            ElemType g = grad[i] * scale;
+            if (isClipped && clipByTruncation)
+                g = max(min(g, clippingThreshold), -clippingThreshold);
+            g += l2Weight * val[i];
+            const ElemType step = (1 - momentum) * learnRatePerSample * g;
+            smooth[i] = momentum * smooth[i] + step;
+            ElemType w = val[i] - (useNesterovMomentum ? momentum * smooth[i] + step : smooth[i]);
+            if (l1Threshold > 0)
+                w = w > l1Threshold ? w - l1Threshold : w < -l1Threshold ? w + l1Threshold : 0;
+            val[i] = w;
+        }
+    }
+}
+
 template <class ElemType>
 ElemType CPUMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& gradients,
                                       ElemType RMS_GAMMA,
@@ -1367,11 +1567,11 @@ void CPUMatrix<ElemType>::Resize(const size_t numRows, const size_t numCols, boo
         {
             if (!OwnBuffer())
                 LogicError("Resize: Resizing an matrix you don't own is not supported.");
-            pArray = NewArray<ElemType>(numElements);
+            pArray = NewStorageArray<ElemType>(numElements);
         }
         // success: update the object
         if (OwnBuffer())
-            delete[] m_pArray;
+            DeleteStorageArray(m_pArray);
         else
             assert(pArray == nullptr); // (if !OwnBuffer we can still resize to 0)
         m_pArray = pArray;
@@ -1790,6 +1990,8 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignElementProductOf(const CPUMatrix
     auto& us = *this;
     if (this != &a)
         Resize(a.GetNumRows(), a.GetNumCols());
+    if (VectorizedBinaryOp(ElementWiseOperator::opElementwiseProduct, 0, a.m_pArray, b.m_pArray, m_pArray, 1, GetNumElements()))
+        return *this;
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
 #pragma omp parallel for
@@ -1812,6 +2014,30 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignElementProductOf(const CPUMatrix
     return *this;
 }
 
+//[this] = beta * [this] + a .* mask, with the dropout mask computed on the fly
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddDropoutOf(const CPUMatrix<ElemType>& a, const ElemType beta, const ElemType dropoutRate, unsigned long seed, size_t offset)
+{
+    if (a.IsEmpty())
+        LogicError("AddDropoutOf: Matrix is empty.");
+
+    if (beta == 0 && this != &a)
+        Resize(a.GetNumRows(), a.GetNumCols());
+    else if (!(a.GetNumRows() == GetNumRows() && a.GetNumCols() == GetNumCols()))
+        InvalidArgument("AddDropoutOf : The input matrix dimensions do not match [this].");
+
+    const ElemType scale = 1 / (1 - dropoutRate);
+    ElemType* us = BufferPointer();
+    const ElemType* pa = a.BufferPointer();
+#pragma omp parallel for
+    for (long i = 0; i < (long) GetNumElements(); i++)
+    {
+        const ElemType value = pa[i] * DropoutMaskAt<ElemType>(seed, offset + i, dropoutRate, scale);
+        us[i] = beta == 0 ? value : beta * us[i] + value;
+    }
+    return *this;
+}
+
 //[this] +=a .* b
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddElementProductOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b)
@@ -1826,6 +2052,9 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddElementProductOf(const CPUMatrix<El
     if (!(a.GetNumRows() == GetNumRows() && a.GetNumCols() == GetNumCols()))
         InvalidArgument("AddElementProductOf : The input matrix dimensions do not match [this].");
 
+    if (VectorizedBinaryOp(ElementWiseOperator::opElementwiseProduct, 1, a.m_pArray, b.m_pArray, m_pArray, 1, GetNumElements()))
+        return *this;
+
     auto& us = *this;
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
@@ -2073,6 +2302,8 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSigmoidOf(const CPUMatrix<ElemTy
     auto& us = *this;
     if (this != &a)
         Resize(a.GetNumRows(), a.GetNumCols());
+    if (VectorizedUnaryOp(ElementWiseOperator::opSigmoid, 0, a.m_pArray, m_pArray, 1, GetNumElements()))
+        return *this;
 
 #pragma omp parallel for
     foreach_coord (i, j, us)
@@ -2189,6 +2420,8 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignTanhOf(const CPUMatrix<ElemType>
     auto& us = *this;
     if (this != &a)
         Resize(a.GetNumRows(), a.GetNumCols());
+    if (VectorizedUnaryOp(ElementWiseOperator::opTanh, 0, a.m_pArray, m_pArray, 1, GetNumElements()))
+        return *this;
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
 #pragma omp parallel for
@@ -2390,6 +2623,8 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignExpOf(const CPUMatrix<ElemType>&
     auto& us = *this;
     if (this != &a)
         Resize(a.GetNumRows(), a.GetNumCols());
+    if (VectorizedUnaryOp(ElementWiseOperator::opExp, 0, a.m_pArray, m_pArray, 1, GetNumElements()))
+        return *this;
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
 #pragma omp parallel for
@@ -2475,6 +2710,8 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLogOf(const CPUMatrix<ElemType>&
     auto& us = *this;
     if (this != &a)
         Resize(a.GetNumRows(), a.GetNumCols());
+    if (VectorizedUnaryOp(ElementWiseOperator::opLog, 0, a.m_pArray, m_pArray, 1, GetNumElements()))
+        return *this;
 
 #pragma omp parallel for
     foreach_coord (i, j, a)
@@ -3268,6 +3505,17 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignFrobeniusNormOf(const CPUMatrix<
     return us;
 }
 
+// see Matrix::ClipFrobeniusNorm()
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::ClipFrobeniusNorm(ElemType maxNorm, CPUMatrix<ElemType>& norm)
+{
+    norm.AssignFrobeniusNormOf(*this);
+    const ElemType n = norm(0, 0);
+    if (n > maxNorm)
+        *this *= maxNorm / n;
+    return *this;
+}
+
 template <class ElemType>
 ElemType CPUMatrix<ElemType>::MatrixNormInf() const
 {
@@ -3419,30 +3667,30 @@ void CPUMatrix<ElemType>::VectorMax(CPUMatrix<ElemType>& maxIndexes, CPUMatrix<E
         }
         else
         {
-            std::vector<int> indices(m);
-            int i = 0;
-            std::generate(indices.begin(), indices.end(), [&i]
-                          {
-                              return i++;
-                          });
-
-            const ElemType* curVal = m_pArray;
-            ElemType* curIdx = maxIndexes.m_pArray;
-            ElemType* curMax = maxValues.m_pArray;
-            for (int icol = 0; icol < n; icol++, curVal += m, curIdx += topK, curMax += topK)
+            // in descending order, ties going to the lower row index (as on the GPU)
+#pragma omp parallel
             {
-                // Partial sort, descending order.
-                std::nth_element(indices.begin(), indices.begin() + topK, indices.end(),
-                                 [curVal](const int& a, const int& b)
-                                 {
-                                     return curVal[a] > curVal[b];
-                                 });
-                // REVIEW alexeyk: the following produces warning (see SCL_SECURE_NO_WARNINGS) so use loop instead.
-                // std::transform(indices.begin(), indices.begin() + topK, curIdx, [](const int& a) { return static_cast<ElemType>(a); });
-                for (int i = 0; i < topK; i++)
+                std::vector<int> indices(m);
+#pragma omp for
+                for (int icol = 0; icol < n; icol++)
                 {
-                    curIdx[i] = static_cast<ElemType>(indices[i]);
-                    curMax[i] = curVal[indices[i]];
+                    const ElemType* curVal = m_pArray + (size_t) icol * m;
+                    ElemType* curIdx = maxIndexes.m_pArray + (size_t) icol * topK;
+                    ElemType* curMax = maxValues.m_pArray + (size_t) icol * topK;
+                    for (int i = 0; i < m; i++)
+                        indices[i] = i;
+                    std::partial_sort(indices.begin(), indices.begin() + topK, indices.end(),
+                                      [curVal](const int& a, const int& b)
+                                      {
+                                          return curVal[a] > curVal[b] || (curVal[a] == curVal[b] && a < b);
+                                      });
+                    // REVIEW alexeyk: the following produces warning (see SCL_SECURE_NO_WARNINGS) so use loop instead.
+                    // std::transform(indices.begin(), indices.begin() + topK, curIdx, [](const int& a) { return static_cast<ElemType>(a); });
+                    for (int i = 0; i < topK; i++)
+                    {
+                        curIdx[i] = static_cast<ElemType>(indices[i]);
+                        curMax[i] = curVal[indices[i]];
+                    }
                 }
             }
         }
@@ -4066,6 +4314,59 @@ void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix
     }
 }
 
+// c_i = alpha * op(a_i) * op(b_i) + beta * c_i for the batchSize column blocks of a, b and c (see BatchedGemmShape)
+// Products small enough to stay in the L2 cache are computed by a plain loop, in parallel over the batch,
+// as a BLAS call per product would cost more than the product itself; larger ones are one BLAS call each.
+template <class ElemType>
+void CPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB,
+                                                      ElemType beta, CPUMatrix<ElemType>& c, size_t batchSize)
+{
+    const BatchedGemmShape s = GetBatchedGemmShape(a.GetNumRows(), a.GetNumCols(), transposeA, b.GetNumRows(), b.GetNumCols(), transposeB, c.GetNumRows(), c.GetNumCols(), batchSize);
+    const size_t blockColsA = transposeA ? s.m : s.k;
+    const size_t blockColsB = transposeB ? s.k : s.n;
+
+    if ((s.m * s.k + s.k * s.n + s.m * s.n) * sizeof(ElemType) > 256 * 1024)
+    {
+        for (size_t i = 0; i < batchSize; i++)
+        {
+            CPUMatrix<ElemType> ci = c.ColumnSlice(i * s.n, s.n);
+            MultiplyAndWeightedAdd(alpha, a.ColumnSlice(s.strideA ? i * blockColsA : 0, blockColsA), transposeA,
+                                   b.ColumnSlice(s.strideB ? i * blockColsB : 0, blockColsB), transposeB, beta, ci);
+        }
+        return;
+    }
+
+#pragma omp parallel for
+    for (long i = 0; i < (long) batchSize; i++)
+    {
+        const ElemType* ai = a.m_pArray + i * s.strideA;
+        const ElemType* bi = b.m_pArray + i * s.strideB;
+        ElemType* ci = c.m_pArray + i * s.strideC;
+        for (size_t col = 0; col < s.n; col++)
+        {
+            ElemType* cCol = ci + col * s.m;
+            if (beta == 0) // (c may be uninitialized)
+                memset(cCol, 0, s.m * sizeof(ElemType));
+            else if (beta != 1)
+                for (size_t row = 0; row < s.m; row++)
+                    cCol[row] *= beta;
+            for (size_t p = 0; p < s.k; p++)
+            {
+                const ElemType bpj = alpha * (transposeB ? bi[col + p * s.n] : bi[p + col * s.k]);
+                if (transposeA) // op(a_i)(row, p) = a_i(p, row)
+                    for (size_t row = 0; row < s.m; row++)
+                        cCol[row] += ai[p + row * s.k] * bpj;
+                else
+                {
+                    const ElemType* aCol = ai + p * s.m;
+                    for (size_t row = 0; row < s.m; row++)
+                        cCol[row] += aCol[row] * bpj;
+                }
+            }
+        }
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b,
                                                     ElemType beta, CPUMatrix<ElemType>& c)
@@ -4508,25 +4809,177 @@ void CPUMatrix<ElemType>::AssignScaledDifference(const ElemType alpha, const CPU
     }
 }
 
-//c[ci,cj] += a[ai,aj]
+// for each column: max of the prediction, log sum of exp(prediction - max), and the cross entropy -sum(labels .* logSoftmax)
+// Labels of 0 do not contribute, so that gap columns (labels masked to zero) yield 0 whatever their prediction holds.
+// With class indices as labels, the cross entropy is the log softmax at the index, and 0 for an index outside the rows.
 template <class ElemType>
-void CPUMatrix<ElemType>::AddElementToElement(const CPUMatrix<ElemType>& a, const size_t ai, const size_t aj, CPUMatrix<ElemType>& c, const size_t ci, const size_t cj)
+/*static*/ void CPUMatrix<ElemType>::SoftmaxCrossEntropy(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& prediction, CPUMatrix<ElemType>& columnStats)
 {
-    if (ai >= a.GetNumRows() || aj >= a.GetNumCols() ||
-        ci >= c.GetNumRows() || cj >= c.GetNumCols())
-        InvalidArgument("AddElementToElement:  index out of range.");
+    const long n = (long) prediction.GetNumCols();
+    const bool isIndices = labels.GetNumRows() == 1 && prediction.GetNumRows() > 1;
+    columnStats.Resize(n, 3);
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        ElemType maxV = prediction(0, j);
+        foreach_row (i, prediction)
+            maxV = max(maxV, prediction(i, j));
 
-    c(ci, cj) += a(ai, aj);
+        ElemType sum = 0, labelSum = 0, crossEntropy = 0;
+        foreach_row (i, prediction)
+        {
+            const ElemType shifted = prediction(i, j) - maxV;
+            sum += exp(shifted);
+            if (isIndices)
+                continue;
+            if (labels(i, j) != 0)
+            {
+                labelSum += labels(i, j);
+                crossEntropy -= labels(i, j) * shifted;
+            }
+        }
+        const ElemType logSum = log(sum);
+        if (isIndices)
+        {
+            const ElemType index = labels(0, j);
+            if (index >= 0 && index < prediction.GetNumRows())
+            {
+                labelSum = 1;
+                crossEntropy = -(prediction((size_t) index, j) - maxV);
+            }
+        }
+        columnStats(j, 0) = maxV;
+        columnStats(j, 1) = logSum;
+        columnStats(j, 2) = labelSum == 0 ? 0 : crossEntropy + labelSum * logSum;
+    }
 }
 
-////c[ci,cj] += a[ai,aj]
-//template<class ElemType>
-//void CPUMatrix<ElemType>::AddLogElementToElement(const CPUMatrix<ElemType>& a, const size_t ai, const size_t aj, CPUMatrix<ElemType>& c, const size_t ci, const size_t cj)
-//{
-//    if (ai >= a.GetNumRows() || aj >=a.GetNumCols() ||
-//        ci >= c.GetNumRows() || cj >=c.GetNumCols())
-//        InvalidArgument("AddElementToElement:  index out of range.");
-//
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::SoftmaxCrossEntropyBackprop(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& prediction,
+                                                                const CPUMatrix<ElemType>& columnStats, CPUMatrix<ElemType>& predictionGradient)
+{
+    if (alpha.GetNumElements() != 1)
+        InvalidArgument("SoftmaxCrossEntropyBackprop: alpha must be a 1X1 matrix.");
+
+    const ElemType a = alpha(0, 0);
+    const long n = (long) prediction.GetNumCols();
+    const bool isIndices = labels.GetNumRows() == 1 && prediction.GetNumRows() > 1;
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        const ElemType logNorm = columnStats(j, 0) + columnStats(j, 1);
+        foreach_row (i, prediction)
+        {
+            const ElemType target = isIndices ? (labels(0, j) == (ElemType) i ? 1 : 0) : labels(i, j);
+            predictionGradient(i, j) += a * (exp(prediction(i, j) - logNorm) - target);
+        }
+    }
+}
+
+// per frame: the scores of the nodes on the path of its label, log(1 + exp(-sign * score)) summed over them, and the derivatives
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::HierarchicalSoftmax(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& hidden, const CPUMatrix<ElemType>& weights, const CPUMatrix<ElemType>& paths,
+                                                        CPUMatrix<ElemType>& frameLosses, CPUMatrix<ElemType>& pathGradients)
+{
+    const long n = (long) hidden.GetNumCols();
+    const size_t dim = hidden.GetNumRows(), depth = paths.GetNumRows() / 2, numClasses = paths.GetNumCols();
+    frameLosses.Resize(1, n);
+    pathGradients.Resize(depth, n);
+#pragma omp parallel for
+    for (long t = 0; t < n; t++)
+    {
+        const ElemType label = labels(0, t);
+        const bool hasLabel = label >= 0 && label < numClasses;
+        ElemType loss = 0;
+        for (size_t d = 0; d < depth; d++)
+        {
+            const ElemType node = hasLabel ? paths(d, (size_t) label) : -1;
+            if (node < 0)
+            {
+                pathGradients(d, t) = 0;
+                continue;
+            }
+            ElemType score = 0;
+            for (size_t i = 0; i < dim; i++)
+                score += weights(i, (size_t) node) * hidden(i, t);
+            const ElemType z = paths(depth + d, (size_t) label) * score;
+            loss += max(-z, (ElemType) 0) + log(1 + exp(-fabs(z)));                     // log(1 + exp(-z))
+            pathGradients(d, t) = -paths(depth + d, (size_t) label) * (1 / (1 + exp(z))); // -sign * sigmoid(-z)
+        }
+        frameLosses(0, t) = loss;
+    }
+}
+
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::HierarchicalSoftmaxBackpropHidden(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& weights, const CPUMatrix<ElemType>& paths,
+                                                                      const CPUMatrix<ElemType>& pathGradients, CPUMatrix<ElemType>& hiddenGradient)
+{
+    if (alpha.GetNumElements() != 1)
+        InvalidArgument("HierarchicalSoftmaxBackpropHidden: alpha must be a 1X1 matrix.");
+
+    const ElemType a = alpha(0, 0);
+    const long n = (long) hiddenGradient.GetNumCols();
+    const size_t dim = hiddenGradient.GetNumRows(), depth = paths.GetNumRows() / 2, numClasses = paths.GetNumCols();
+#pragma omp parallel for
+    for (long t = 0; t < n; t++)
+    {
+        const ElemType label = labels(0, t);
+        if (!(label >= 0 && label < numClasses))
+            continue;
+        for (size_t d = 0; d < depth && paths(d, (size_t) label) >= 0; d++)
+        {
+            const size_t node = (size_t) paths(d, (size_t) label);
+            const ElemType g = a * pathGradients(d, t);
+            for (size_t i = 0; i < dim; i++)
+                hiddenGradient(i, t) += g * weights(i, node);
+        }
+    }
+}
+
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::HierarchicalSoftmaxBackpropWeights(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& hidden, const CPUMatrix<ElemType>& paths,
+                                                                       const CPUMatrix<ElemType>& pathGradients, CPUMatrix<ElemType>& weightsGradient)
+{
+    if (alpha.GetNumElements() != 1)
+        InvalidArgument("HierarchicalSoftmaxBackpropWeights: alpha must be a 1X1 matrix.");
+
+    // (frames share nodes, so this goes over them in sequence)
+    const ElemType a = alpha(0, 0);
+    const size_t n = hidden.GetNumCols(), dim = hidden.GetNumRows(), depth = paths.GetNumRows() / 2, numClasses = paths.GetNumCols();
+    for (size_t t = 0; t < n; t++)
+    {
+        const ElemType label = labels(0, t);
+        if (!(label >= 0 && label < numClasses))
+            continue;
+        for (size_t d = 0; d < depth && paths(d, (size_t) label) >= 0; d++)
+        {
+            const size_t node = (size_t) paths(d, (size_t) label);
+            const ElemType g = a * pathGradients(d, t);
+            for (size_t i = 0; i < dim; i++)
+                weightsGradient(i, node) += g * hidden(i, t);
+        }
+    }
+}
+
+//c[ci,cj] += a[ai,aj]
+template <class ElemType>
+void CPUMatrix<ElemType>::AddElementToElement(const CPUMatrix<ElemType>& a, const size_t ai, const size_t aj, CPUMatrix<ElemType>& c, const size_t ci, const size_t cj)
+{
+    if (ai >= a.GetNumRows() || aj >= a.GetNumCols() ||
+        ci >= c.GetNumRows() || cj >= c.GetNumCols())
+        InvalidArgument("AddElementToElement:  index out of range.");
+
+    c(ci, cj) += a(ai, aj);
+}
+
+////c[ci,cj] += a[ai,aj]
+//template<class ElemType>
+//void CPUMatrix<ElemType>::AddLogElementToElement(const CPUMatrix<ElemType>& a, const size_t ai, const size_t aj, CPUMatrix<ElemType>& c, const size_t ci, const size_t cj)
+//{
+//    if (ai >= a.GetNumRows() || aj >=a.GetNumCols() ||
+//        ci >= c.GetNumRows() || cj >=c.GetNumCols())
+//        InvalidArgument("AddElementToElement:  index out of range.");
+//
 //    ElemType v = a(ai,aj);
 //    c(ci, cj) += ((v < EPS_IN_LOG) ? LOG_OF_EPS_IN_LOG : log(v));
 //}
@@ -5201,6 +5654,73 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignElementProductOfWithShift(const
     return *this;
 }
 
+// see Matrix::AssignCosDistanceWithShiftNeg()
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignCosDistanceWithShiftNeg(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB, size_t shift, size_t negnumber)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AssignCosDistanceWithShiftNeg: Matrix is empty.");
+
+    const long dim = (long) a.GetNumRows();
+    const long n = (long) a.GetNumCols();
+    if (b.GetNumRows() != dim || b.GetNumCols() != n)
+        InvalidArgument("AssignCosDistanceWithShiftNeg: The input matrix dimensions do not match.");
+
+    Resize(negnumber + 1, n);
+    auto& us = *this;
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        const ElemType* aCol = a.m_pArray + a.LocateColumn(j);
+        for (long i = 0; i <= (long) negnumber; i++)
+        {
+            const long k = i == 0 ? j : (long) ((j + shift + i - 1) % n); // the column of b
+            const ElemType* bCol = b.m_pArray + b.LocateColumn(k);
+            ElemType sum = 0;
+            for (long r = 0; r < dim; r++)
+                sum += aCol[r] * bCol[r];
+            us(i, j) = sum * invNormA(0, j) * invNormB(0, k);
+        }
+    }
+    return *this;
+}
+
+// see Matrix::AddCosDistanceWithShiftNegGradient()
+template <class ElemType>
+void CPUMatrix<ElemType>::AddCosDistanceWithShiftNegGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& cosDistance, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB,
+                                                             size_t shift, size_t negnumber, bool wrtB, CPUMatrix<ElemType>& inputGradient)
+{
+    const long dim = (long) a.GetNumRows();
+    const long n = (long) a.GetNumCols();
+    const CPUMatrix<ElemType>& self = wrtB ? b : a;  // the input that gets the gradient
+    const CPUMatrix<ElemType>& other = wrtB ? a : b; // the one it is compared to
+    const CPUMatrix<ElemType>& selfInvNorm = wrtB ? invNormB : invNormA;
+#pragma omp parallel for
+    for (long j = 0; j < n; j++) // column of the input gradient
+    {
+        ElemType* gradCol = inputGradient.m_pArray + inputGradient.LocateColumn(j);
+        const ElemType* selfCol = self.m_pArray + self.LocateColumn(j);
+        ElemType selfWeight = 0;
+        for (long i = 0; i <= (long) negnumber; i++)
+        {
+            // the sample column of a (jA) and the column of b (jB) that are compared in row i, with j being one of them
+            const long s = i == 0 ? 0 : (long) ((shift + i - 1) % n);
+            const long jA = wrtB ? (j + n - s) % n : j;
+            const long jB = wrtB ? j : (j + s) % n;
+            const long k = wrtB ? jA : jB; // the column of 'other'
+            const ElemType g = gradient(i, jA);
+            const ElemType otherWeight = g * invNormA(0, jA) * invNormB(0, jB);
+            selfWeight += g * cosDistance(i, jA);
+            const ElemType* otherCol = other.m_pArray + other.LocateColumn(k);
+            for (long r = 0; r < dim; r++)
+                gradCol[r] += otherWeight * otherCol[r];
+        }
+        selfWeight *= selfInvNorm(0, j) * selfInvNorm(0, j);
+        for (long r = 0; r < dim; r++)
+            gradCol[r] -= selfWeight * selfCol[r];
+    }
+}
+
 #pragma endregion Static BLAS Functions
 
 // 'double' version of LogAdd
@@ -5418,6 +5938,585 @@ void CPUMatrix<ElemType>::_rcrfTransGrdCompute(size_t i,
         }
     }
 };
+
+// -----------------------------------------------------------------------
+// batched CRF and Viterbi over all sequences of a minibatch
+// Sequences are processed in parallel. Within a sequence, the loops over labels run innermost over contiguous
+// memory without calls to LogAdd(), so that the compiler can vectorize them.
+// -----------------------------------------------------------------------
+
+// row of the one-hot label of a column, or -1 if the column has no label
+template <class ElemType>
+static int LabelOfColumn(const ElemType* labels, size_t numLabels)
+{
+    for (size_t k = 0; k < numLabels; k++)
+        if (labels[k] != 0)
+            return (int) k;
+    return -1;
+}
+
+// log sum_i exp(x[i] + y[i])
+template <class ElemType>
+static ElemType LogSumExpOfSum(const ElemType* x, const ElemType* y, size_t n)
+{
+    ElemType maxVal = x[0] + y[0];
+    for (size_t i = 1; i < n; i++)
+        maxVal = max(maxVal, x[i] + y[i]);
+    ElemType sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += exp(x[i] + y[i] - maxVal);
+    return maxVal + log(sum);
+}
+
+// out[k] = log sum_i exp(prev[i] + scores(k, i)) for the column-major n x n matrix scores
+// (the columns of scores are visited in order, so that the loops over k are contiguous)
+template <class ElemType>
+static void LogSumOverPredecessors(const ElemType* prev, const ElemType* scores, size_t n, ElemType* maxVals, ElemType* out)
+{
+    for (size_t k = 0; k < n; k++)
+        maxVals[k] = prev[0] + scores[k];
+    for (size_t i = 1; i < n; i++)
+        for (size_t k = 0; k < n; k++)
+            maxVals[k] = max(maxVals[k], prev[i] + scores[i * n + k]);
+    for (size_t k = 0; k < n; k++)
+        out[k] = 0;
+    for (size_t i = 0; i < n; i++)
+        for (size_t k = 0; k < n; k++)
+            out[k] += exp(prev[i] + scores[i * n + k] - maxVals[k]);
+    for (size_t k = 0; k < n; k++)
+        out[k] = maxVals[k] + log(out[k]);
+}
+
+template <class ElemType>
+static void GetSequenceOfBatch(const CPUMatrix<ElemType>& sequences, size_t j, size_t& s, size_t& tBegin, size_t& tEnd)
+{
+    s = (size_t) sequences(0, j);
+    tBegin = (size_t) sequences(1, j);
+    tEnd = (size_t) sequences(2, j);
+}
+
+template <class ElemType>
+static void CheckBatchedCRFArguments(const char* function, const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& posScores, const CPUMatrix<ElemType>& pairScores,
+                                     const CPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    const size_t numLabels = posScores.GetNumRows();
+    if (numLabels == 0 || pairScores.GetNumRows() != numLabels || pairScores.GetNumCols() != numLabels)
+        InvalidArgument("%s: pair scores must be a square matrix with one row per label.", function);
+    if (labels.GetNumRows() != numLabels || labels.GetNumCols() != posScores.GetNumCols())
+        InvalidArgument("%s: labels and position scores must have the same dimensions.", function);
+    if (sequences.GetNumRows() != 3 || numParallelSequences == 0)
+        InvalidArgument("%s: sequences must have 3 rows (parallel sequence, first time step, end time step).", function);
+    for (size_t j = 0; j < sequences.GetNumCols(); j++)
+    {
+        size_t s, tBegin, tEnd;
+        GetSequenceOfBatch(sequences, j, s, tBegin, tEnd);
+        if (s >= numParallelSequences || tBegin > tEnd || tEnd * numParallelSequences > posScores.GetNumCols())
+            InvalidArgument("%s: sequence %d is outside the minibatch.", function, (int) j);
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::CRFForwardBackward(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& posScores, const CPUMatrix<ElemType>& pairScores,
+                                             CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta, CPUMatrix<ElemType>& sequenceScores,
+                                             const CPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    CheckBatchedCRFArguments("CRFForwardBackward", labels, posScores, pairScores, sequences, numParallelSequences);
+    const size_t L = posScores.GetNumRows();
+    const size_t S = numParallelSequences;
+    const long numSequences = (long) sequences.GetNumCols();
+
+    alpha.Resize(L, posScores.GetNumCols());
+    beta.Resize(L, posScores.GetNumCols());
+    alpha.SetValue((ElemType) LZERO);
+    beta.SetValue((ElemType) LZERO);
+    sequenceScores.Resize(1, numSequences);
+
+    const ElemType* lbl = labels.m_pArray;
+    const ElemType* pos = posScores.m_pArray;
+    const ElemType* pair = pairScores.m_pArray;
+#pragma omp parallel for
+    for (long j = 0; j < numSequences; j++)
+    {
+        size_t s, tBegin, tEnd;
+        GetSequenceOfBatch(sequences, j, s, tBegin, tEnd);
+        if (tBegin == tEnd)
+        {
+            sequenceScores(0, j) = 0;
+            continue;
+        }
+        std::vector<ElemType> buffer(L), zero(L, 0); // (a sequence costs O(L^2 T), so the allocations do not matter)
+
+        // forward: alpha(k, t) = log sum_i exp(alpha(i, t-1) + pair(k, i)) + pos(k, t); the first label is the start symbol
+        const int startLabel = LabelOfColumn(lbl + (tBegin * S + s) * L, L);
+        for (size_t t = tBegin; t < tEnd; t++)
+        {
+            const size_t col = t * S + s;
+            ElemType* a = alpha.m_pArray + col * L;
+            if (t > tBegin)
+                LogSumOverPredecessors(a - S * L, pair, L, buffer.data(), a);
+            else
+                for (size_t k = 0; k < L; k++)
+                    a[k] = startLabel >= 0 ? pair[startLabel * L + k] : 0;
+            for (size_t k = 0; k < L; k++)
+                a[k] += pos[col * L + k];
+        }
+
+        // backward: beta(k, t) = log P(label k at t) = alpha(k, t) + log sum_i exp(beta(i, t+1) + pair(i, k) - zeta(i, t+1)),
+        // where zeta(i, t+1) = alpha(i, t+1) - pos(i, t+1) normalizes over the predecessors of i
+        const size_t lastCol = (tEnd - 1) * S + s;
+        const ElemType logZ = LogSumExpOfSum(alpha.m_pArray + lastCol * L, zero.data(), L);
+        for (size_t k = 0; k < L; k++)
+            beta.m_pArray[lastCol * L + k] = alpha.m_pArray[lastCol * L + k] - logZ;
+        for (size_t t = tEnd - 1; t-- > tBegin;)
+        {
+            const size_t col = t * S + s;
+            const size_t next = col + S;
+            for (size_t i = 0; i < L; i++)
+                buffer[i] = beta.m_pArray[next * L + i] - alpha.m_pArray[next * L + i] + pos[next * L + i];
+            for (size_t k = 0; k < L; k++)
+                beta.m_pArray[col * L + k] = alpha.m_pArray[col * L + k] + LogSumExpOfSum(buffer.data(), pair + k * L, L);
+        }
+
+        // -log P(labels) = log Z - score of the label path (including the transition from the start symbol)
+        ElemType pathScore = 0;
+        int prevLabel = startLabel;
+        for (size_t t = tBegin; t < tEnd; t++)
+        {
+            const size_t col = t * S + s;
+            const int label = LabelOfColumn(lbl + col * L, L);
+            if (label >= 0)
+            {
+                pathScore += pos[col * L + label];
+                if (prevLabel >= 0)
+                    pathScore += pair[prevLabel * L + label];
+            }
+            prevLabel = label;
+        }
+        sequenceScores(0, j) = logZ - pathScore;
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::CRFTransitionGradient(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& posScores, const CPUMatrix<ElemType>& pairScores,
+                                                const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& beta, CPUMatrix<ElemType>& grd,
+                                                const CPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    CheckBatchedCRFArguments("CRFTransitionGradient", labels, posScores, pairScores, sequences, numParallelSequences);
+    const size_t L = posScores.GetNumRows();
+    const size_t S = numParallelSequences;
+    if (grd.GetNumRows() != L || grd.GetNumCols() != L)
+        InvalidArgument("CRFTransitionGradient: the gradient must have the dimensions of the pair scores.");
+    if (alpha.GetNumRows() != L || alpha.GetNumCols() != posScores.GetNumCols() || beta.GetNumRows() != L || beta.GetNumCols() != posScores.GetNumCols())
+        InvalidArgument("CRFTransitionGradient: alpha and beta must come from CRFForwardBackward() on the same minibatch.");
+
+    const ElemType* lbl = labels.m_pArray;
+    const ElemType* pos = posScores.m_pArray;
+    const ElemType* pair = pairScores.m_pArray;
+    const ElemType* a = alpha.m_pArray;
+    const ElemType* b = beta.m_pArray;
+
+    // expected transition counts: grd(k, i) += sum_t P(i at t-1, k at t) = sum_t exp(alpha(i, t-1) + pair(k, i) - zeta(k, t) + beta(k, t)).
+    // Every thread owns one column i of grd, i.e. the transitions from label i.
+#pragma omp parallel for
+    for (long i = 0; i < (long) L; i++)
+    {
+        ElemType* g = grd.m_pArray + i * L;
+        const ElemType* p = pair + i * L;
+        for (size_t j = 0; j < sequences.GetNumCols(); j++)
+        {
+            size_t s, tBegin, tEnd;
+            GetSequenceOfBatch(sequences, j, s, tBegin, tEnd);
+            for (size_t t = tBegin; t < tEnd; t++)
+            {
+                const size_t col = t * S + s;
+                ElemType prev;
+                if (t > tBegin)
+                    prev = a[(col - S) * L + i];
+                else if (LabelOfColumn(lbl + col * L, L) == (int) i) // from the start symbol
+                    prev = 0;
+                else
+                    continue;
+                for (size_t k = 0; k < L; k++)
+                    g[k] += exp(prev + p[k] - a[col * L + k] + pos[col * L + k] + b[col * L + k]);
+            }
+        }
+    }
+
+    // minus the transition counts of the label paths
+    for (size_t j = 0; j < sequences.GetNumCols(); j++)
+    {
+        size_t s, tBegin, tEnd;
+        GetSequenceOfBatch(sequences, j, s, tBegin, tEnd);
+        int prevLabel = tBegin < tEnd ? LabelOfColumn(lbl + (tBegin * S + s) * L, L) : -1;
+        for (size_t t = tBegin; t < tEnd; t++)
+        {
+            const int label = LabelOfColumn(lbl + (t * S + s) * L, L);
+            if (label >= 0 && prevLabel >= 0)
+                grd(label, prevLabel) -= 1;
+            prevLabel = label;
+        }
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::ViterbiDecode(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& posScores, const CPUMatrix<ElemType>& pairScores,
+                                        CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& backtrace, CPUMatrix<ElemType>& decodedPath,
+                                        const CPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    CheckBatchedCRFArguments("ViterbiDecode", labels, posScores, pairScores, sequences, numParallelSequences);
+    const size_t L = posScores.GetNumRows();
+    const size_t S = numParallelSequences;
+    const long numSequences = (long) sequences.GetNumCols();
+
+    alpha.Resize(L, posScores.GetNumCols());
+    backtrace.Resize(L, posScores.GetNumCols());
+    decodedPath.Resize(L, posScores.GetNumCols());
+    alpha.SetValue((ElemType) LZERO);
+    backtrace.SetValue(0);
+    decodedPath.SetValue(0);
+
+    const ElemType* lbl = labels.m_pArray;
+    const ElemType* pos = posScores.m_pArray;
+    const ElemType* pair = pairScores.m_pArray;
+#pragma omp parallel for
+    for (long j = 0; j < numSequences; j++)
+    {
+        size_t s, tBegin, tEnd;
+        GetSequenceOfBatch(sequences, j, s, tBegin, tEnd);
+        if (tBegin == tEnd)
+            continue;
+
+        // best path scores: alpha(k, t) = max_i (alpha(i, t-1) + pair(k, i)) + pos(k, t), starting in the first label if there is one
+        const int startLabel = LabelOfColumn(lbl + (tBegin * S + s) * L, L);
+        for (size_t t = tBegin; t < tEnd; t++)
+        {
+            const size_t col = t * S + s;
+            ElemType* a = alpha.m_pArray + col * L;
+            ElemType* bt = backtrace.m_pArray + col * L;
+            if (t > tBegin)
+            {
+                const ElemType* prev = a - S * L;
+                for (size_t k = 0; k < L; k++)
+                {
+                    a[k] = prev[0] + pair[k];
+                    bt[k] = 0;
+                }
+                for (size_t i = 1; i < L; i++)
+                {
+                    for (size_t k = 0; k < L; k++)
+                    {
+                        const ElemType score = prev[i] + pair[i * L + k];
+                        if (score > a[k])
+                        {
+                            a[k] = score;
+                            bt[k] = (ElemType) i;
+                        }
+                    }
+                }
+                for (size_t k = 0; k < L; k++)
+                    a[k] += pos[col * L + k];
+            }
+            else
+            {
+                for (size_t k = 0; k < L; k++)
+                    a[k] = (startLabel < 0 || (int) k == startLabel) ? pos[col * L + k] : (ElemType) LZERO;
+            }
+        }
+
+        // trace back from the last label, or from the best end if the last frame has none
+        const size_t lastCol = (tEnd - 1) * S + s;
+        int label = LabelOfColumn(lbl + lastCol * L, L);
+        if (label < 0)
+            label = (int) (std::max_element(alpha.m_pArray + lastCol * L, alpha.m_pArray + (lastCol + 1) * L) - (alpha.m_pArray + lastCol * L));
+        for (size_t t = tEnd; t-- > tBegin;)
+        {
+            const size_t col = t * S + s;
+            decodedPath(label, col) = 1;
+            label = (int) backtrace(label, col);
+        }
+    }
+}
+
+template <class ElemType>
+static void CheckDenominatorGraph(const CPUMatrix<ElemType>& logLikelihoods, const CPUMatrix<ElemType>& arcs, const CPUMatrix<ElemType>& states,
+                                  const CPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    if (arcs.GetNumRows() != 4 || arcs.GetNumCols() % 2 != 0 || states.GetNumRows() != 4 || states.GetNumCols() < 2)
+        InvalidArgument("DenominatorForwardBackward: arcs must have 4 rows and twice the number of arcs as columns, states 4 rows and one column more than there are states.");
+    const size_t numArcs = arcs.GetNumCols() / 2;
+    const size_t numStates = states.GetNumCols() - 1;
+    if ((size_t) states(0, numStates) != numArcs || (size_t) states(1, numStates) != numArcs)
+        InvalidArgument("DenominatorForwardBackward: the arc ranges of the states do not cover the arcs.");
+    for (size_t a = 0; a < 2 * numArcs; a++)
+        if ((size_t) arcs(0, a) >= numStates || (size_t) arcs(1, a) >= numStates || (size_t) arcs(2, a) >= logLikelihoods.GetNumRows())
+            InvalidArgument("DenominatorForwardBackward: arc %d refers to a state or pdf that does not exist.", (int) (a % numArcs));
+    if (sequences.GetNumRows() != 3 || numParallelSequences == 0)
+        InvalidArgument("DenominatorForwardBackward: sequences must have 3 rows (parallel sequence, first time step, end time step).");
+    for (size_t j = 0; j < sequences.GetNumCols(); j++)
+    {
+        size_t s, tBegin, tEnd;
+        GetSequenceOfBatch(sequences, j, s, tBegin, tEnd);
+        if (s >= numParallelSequences || tBegin > tEnd || tEnd * numParallelSequences > logLikelihoods.GetNumCols())
+            InvalidArgument("DenominatorForwardBackward: sequence %d is outside the minibatch.", (int) j);
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::DenominatorForwardBackward(const CPUMatrix<ElemType>& logLikelihoods, const CPUMatrix<ElemType>& arcs, const CPUMatrix<ElemType>& states,
+                                                     CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta, CPUMatrix<ElemType>& posteriors, CPUMatrix<ElemType>& logDenominators,
+                                                     const CPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    CheckDenominatorGraph(logLikelihoods, arcs, states, sequences, numParallelSequences);
+    const size_t L = logLikelihoods.GetNumRows();
+    const size_t N = states.GetNumCols() - 1;
+    const size_t A = arcs.GetNumCols() / 2;
+    const size_t S = numParallelSequences;
+    const long numSequences = (long) sequences.GetNumCols();
+
+    alpha.Resize(N, logLikelihoods.GetNumCols());
+    beta.Resize(N, 2 * numSequences);
+    posteriors.Resize(L, logLikelihoods.GetNumCols());
+    alpha.SetValue((ElemType) LZERO);
+    posteriors.SetValue(0);
+    logDenominators.Resize(1, numSequences);
+
+    const ElemType* z = logLikelihoods.m_pArray;
+    const ElemType* inArcs = arcs.m_pArray;
+    const ElemType* outArcs = arcs.m_pArray + 4 * A;
+    const ElemType* st = states.m_pArray;
+#pragma omp parallel for
+    for (long j = 0; j < numSequences; j++)
+    {
+        size_t s, tBegin, tEnd;
+        GetSequenceOfBatch(sequences, j, s, tBegin, tEnd);
+        logDenominators(0, j) = 0;
+        if (tBegin == tEnd)
+            continue;
+
+        // forward: alpha(k, t) = log sum over the arcs i -> k of alpha(i, t-1) + arc weight + log likelihood of the arc's pdf at t
+        for (size_t t = tBegin; t < tEnd; t++)
+        {
+            const size_t col = t * S + s;
+            ElemType* a = alpha.m_pArray + col * N;
+            for (size_t k = 0; k < N; k++)
+            {
+                ElemType v = (ElemType) LZERO;
+                for (size_t i = (size_t) st[4 * k]; i < (size_t) st[4 * (k + 1)]; i++)
+                {
+                    const ElemType* arc = inArcs + 4 * i;
+                    const size_t src = (size_t) arc[0];
+                    const ElemType prev = t > tBegin ? (a - S * N)[src] : st[4 * src + 2];
+                    v = LogAdd(v, prev + arc[3] + z[col * L + (size_t) arc[2]]);
+                }
+                a[k] = v;
+            }
+        }
+        const size_t lastCol = (tEnd - 1) * S + s;
+        ElemType logZ = (ElemType) LZERO;
+        for (size_t k = 0; k < N; k++)
+            logZ = LogAdd(logZ, alpha.m_pArray[lastCol * N + k] + st[4 * k + 3]);
+        if (logZ <= (ElemType) LZERO / 2) // no path through the graph
+            continue;
+        logDenominators(0, j) = logZ;
+
+        // backward, with the two latest frames in columns 2j and 2j+1 of beta, and the arc posteriors added to their pdfs
+        for (size_t t = tEnd; t-- > tBegin;)
+        {
+            const size_t col = t * S + s;
+            ElemType* cur = beta.m_pArray + (2 * j + t % 2) * N;
+            const ElemType* next = beta.m_pArray + (2 * j + (t + 1) % 2) * N;
+            for (size_t k = 0; k < N; k++)
+            {
+                if (t + 1 < tEnd)
+                {
+                    ElemType v = (ElemType) LZERO;
+                    for (size_t i = (size_t) st[4 * k + 1]; i < (size_t) st[4 * (k + 1) + 1]; i++)
+                    {
+                        const ElemType* arc = outArcs + 4 * i;
+                        v = LogAdd(v, arc[3] + z[(col + S) * L + (size_t) arc[2]] + next[(size_t) arc[1]]);
+                    }
+                    cur[k] = v;
+                }
+                else
+                    cur[k] = st[4 * k + 3];
+            }
+            for (size_t k = 0; k < N; k++)
+            {
+                const ElemType prev = t > tBegin ? alpha.m_pArray[(col - S) * N + k] : st[4 * k + 2];
+                for (size_t i = (size_t) st[4 * k + 1]; i < (size_t) st[4 * (k + 1) + 1]; i++)
+                {
+                    const ElemType* arc = outArcs + 4 * i;
+                    const size_t pdf = (size_t) arc[2];
+                    const ElemType logPost = prev + arc[3] + z[col * L + pdf] + cur[(size_t) arc[1]] - logZ;
+                    if (logPost > (ElemType) LZERO / 2)
+                        posteriors.m_pArray[col * L + pdf] += exp(logPost);
+                }
+            }
+        }
+    }
+}
+
+template <class ElemType>
+static void GetClassConditionalFrame(const CPUMatrix<ElemType>& frames, size_t j, size_t& col, size_t& offset, size_t& first, size_t& n, size_t& target)
+{
+    col = (size_t) frames(0, j);
+    offset = (size_t) frames(1, j);
+    first = (size_t) frames(2, j);
+    n = (size_t) frames(3, j);
+    target = (size_t) frames(4, j);
+}
+
+// returns the length of the concatenated class-conditional vectors
+template <class ElemType>
+static size_t CheckClassConditionalFrames(const char* function, const CPUMatrix<ElemType>& frames, const size_t numHiddenCols, const size_t numWords)
+{
+    if (frames.GetNumRows() != 5)
+        InvalidArgument("%s: frames must have 5 rows (column, offset, first word, number of words, target word).", function);
+    size_t totalNumWords = 0;
+    for (size_t j = 0; j < frames.GetNumCols(); j++)
+    {
+        size_t col, offset, first, n, target;
+        GetClassConditionalFrame(frames, j, col, offset, first, n, target);
+        if (col >= numHiddenCols || first + n > numWords || target >= n)
+            InvalidArgument("%s: frame %d is outside the minibatch or the vocabulary.", function, (int) j);
+        totalNumWords = max(totalNumWords, offset + n);
+    }
+    return totalNumWords;
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::ClassConditionalLogSoftmax(const CPUMatrix<ElemType>& hidden, const CPUMatrix<ElemType>& weights, const CPUMatrix<ElemType>& frames, const size_t totalNumWords,
+                                                     CPUMatrix<ElemType>& logSoftmax, CPUMatrix<ElemType>& targetLogProbs)
+{
+    if (hidden.GetNumRows() != weights.GetNumRows())
+        InvalidArgument("ClassConditionalLogSoftmax: hidden and weights must have the same number of rows.");
+    if (CheckClassConditionalFrames("ClassConditionalLogSoftmax", frames, hidden.GetNumCols(), weights.GetNumCols()) > totalNumWords)
+        InvalidArgument("ClassConditionalLogSoftmax: the frames do not fit into totalNumWords.");
+    const size_t hd = hidden.GetNumRows();
+    const long numFrames = (long) frames.GetNumCols();
+
+    logSoftmax.Resize(1, totalNumWords);
+    targetLogProbs.Resize(1, numFrames);
+
+#pragma omp parallel for
+    for (long j = 0; j < numFrames; j++)
+    {
+        size_t col, offset, first, n, target;
+        GetClassConditionalFrame(frames, j, col, offset, first, n, target);
+        const ElemType* h = hidden.m_pArray + col * hd;
+        ElemType* out = logSoftmax.m_pArray + offset;
+
+        ElemType maxVal = (ElemType) LZERO;
+        for (size_t k = 0; k < n; k++)
+        {
+            const ElemType* w = weights.m_pArray + (first + k) * hd;
+            ElemType v = 0;
+            for (size_t i = 0; i < hd; i++)
+                v += h[i] * w[i];
+            out[k] = v;
+            maxVal = max(maxVal, v);
+        }
+        ElemType sum = 0;
+        for (size_t k = 0; k < n; k++)
+            sum += exp(out[k] - maxVal);
+        const ElemType logSum = maxVal + log(sum);
+        for (size_t k = 0; k < n; k++)
+            out[k] -= logSum;
+        targetLogProbs(0, j) = out[target];
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::ClassConditionalSoftmaxGradient(const CPUMatrix<ElemType>& logSoftmax, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& frames,
+                                                          CPUMatrix<ElemType>& grd)
+{
+    if (gradient.GetNumElements() != 1)
+        InvalidArgument("ClassConditionalSoftmaxGradient: gradient must be a 1x1 matrix.");
+    const size_t totalNumWords = CheckClassConditionalFrames("ClassConditionalSoftmaxGradient", frames, SIZE_MAX, SIZE_MAX);
+    if (logSoftmax.GetNumRows() != 1 || logSoftmax.GetNumCols() < totalNumWords)
+        InvalidArgument("ClassConditionalSoftmaxGradient: logSoftmax must come from ClassConditionalLogSoftmax() on the same frames.");
+    const long numFrames = (long) frames.GetNumCols();
+
+    grd.Resize(1, logSoftmax.GetNumCols());
+    const ElemType g = gradient(0, 0);
+#pragma omp parallel for
+    for (long j = 0; j < numFrames; j++)
+    {
+        size_t col, offset, first, n, target;
+        GetClassConditionalFrame(frames, j, col, offset, first, n, target);
+        for (size_t k = 0; k < n; k++)
+            grd.m_pArray[offset + k] = (exp(logSoftmax.m_pArray[offset + k]) - (k == target ? 1 : 0)) * g;
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::AddClassConditionalHiddenGradient(const CPUMatrix<ElemType>& weights, const CPUMatrix<ElemType>& grd, const CPUMatrix<ElemType>& frames,
+                                                            CPUMatrix<ElemType>& hiddenGradient)
+{
+    if (hiddenGradient.GetNumRows() != weights.GetNumRows())
+        InvalidArgument("AddClassConditionalHiddenGradient: hiddenGradient and weights must have the same number of rows.");
+    const size_t totalNumWords = CheckClassConditionalFrames("AddClassConditionalHiddenGradient", frames, hiddenGradient.GetNumCols(), weights.GetNumCols());
+    if (grd.GetNumElements() < totalNumWords)
+        InvalidArgument("AddClassConditionalHiddenGradient: grd must come from ClassConditionalSoftmaxGradient() on the same frames.");
+    const size_t hd = weights.GetNumRows();
+    const long numFrames = (long) frames.GetNumCols();
+
+    // (each frame has its own column, so the frames can run in parallel)
+#pragma omp parallel for
+    for (long j = 0; j < numFrames; j++)
+    {
+        size_t col, offset, first, n, target;
+        GetClassConditionalFrame(frames, j, col, offset, first, n, target);
+        ElemType* hg = hiddenGradient.m_pArray + col * hd;
+        for (size_t k = 0; k < n; k++)
+        {
+            const ElemType* w = weights.m_pArray + (first + k) * hd;
+            const ElemType gk = grd.m_pArray[offset + k];
+            for (size_t i = 0; i < hd; i++)
+                hg[i] += w[i] * gk;
+        }
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::AddClassConditionalWeightGradient(const CPUMatrix<ElemType>& hidden, const CPUMatrix<ElemType>& grd, const CPUMatrix<ElemType>& frames,
+                                                            const CPUMatrix<ElemType>& classes, CPUMatrix<ElemType>& weightGradient)
+{
+    if (hidden.GetNumRows() != weightGradient.GetNumRows())
+        InvalidArgument("AddClassConditionalWeightGradient: hidden and weightGradient must have the same number of rows.");
+    const size_t totalNumWords = CheckClassConditionalFrames("AddClassConditionalWeightGradient", frames, hidden.GetNumCols(), weightGradient.GetNumCols());
+    if (grd.GetNumElements() < totalNumWords)
+        InvalidArgument("AddClassConditionalWeightGradient: grd must come from ClassConditionalSoftmaxGradient() on the same frames.");
+    if (classes.GetNumRows() != 2)
+        InvalidArgument("AddClassConditionalWeightGradient: classes must have 2 rows (first frame, end frame).");
+    for (size_t c = 0; c < classes.GetNumCols(); c++)
+        if ((size_t) classes(0, c) > (size_t) classes(1, c) || (size_t) classes(1, c) > frames.GetNumCols())
+            InvalidArgument("AddClassConditionalWeightGradient: class %d is outside the frames.", (int) c);
+    const size_t hd = hidden.GetNumRows();
+    const long numClasses = (long) classes.GetNumCols();
+
+    // the classes have disjoint word ranges, so they can run in parallel
+#pragma omp parallel for
+    for (long c = 0; c < numClasses; c++)
+    {
+        const size_t frameBegin = (size_t) classes(0, c);
+        const size_t frameEnd = (size_t) classes(1, c);
+        for (size_t f = frameBegin; f < frameEnd; f++)
+        {
+            size_t col, offset, first, n, target;
+            GetClassConditionalFrame(frames, f, col, offset, first, n, target);
+            const ElemType* h = hidden.m_pArray + col * hd;
+            for (size_t k = 0; k < n; k++)
+            {
+                ElemType* wg = weightGradient.m_pArray + (first + k) * hd;
+                const ElemType gk = grd.m_pArray[offset + k];
+                for (size_t i = 0; i < hd; i++)
+                    wg[i] += h[i] * gk;
+            }
+        }
+    }
+}
+
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::DropFrame(const CPUMatrix<ElemType>& label, const CPUMatrix<ElemType>& gamma, const ElemType& threshhold)
 {
@@ -5459,33 +6558,300 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSequenceError(const ElemType hsm
     return *this;
 }
 
+// the logical CPUs the process may run on (e.g. as restricted by taskset, numactl, or a container), in ascending order
+static std::vector<int> ProcessAllowedCPUs()
+{
+    std::vector<int> cpus;
+#ifdef _WIN32
+    DWORD_PTR processMask = 0, systemMask = 0;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+    {
+        for (int cpu = 0; cpu < 8 * sizeof(DWORD_PTR); cpu++)
+            if (processMask & ((DWORD_PTR) 1 << cpu))
+                cpus.push_back(cpu);
+    }
+#else
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    if (sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &cpuSet))
+                cpus.push_back(cpu);
+    }
+#endif
+    return cpus;
+}
+
 // note: this function does not depend on the <ElemType> parameter
+// With pinThreads, OpenMP thread k is bound to the k-th logical CPU the process may run on. OpenMP keeps its threads alive
+// across parallel regions, so each thread then stays on one core, next to the memory it first touched (see NewArray()).
 template <class ElemType>
-int CPUMatrix<ElemType>::SetNumThreads(int numThreads)
+int CPUMatrix<ElemType>::SetNumThreads(int numThreads, bool pinThreads)
 {
-    if (numThreads == 0) // use default
-        return numThreads;
-
     int mthreads = (int) std::thread::hardware_concurrency();
 
-    if (numThreads <= 0)
-        numThreads = max(1, mthreads + numThreads);
-    if (numThreads > mthreads)
-        numThreads = mthreads;
+    if (numThreads != 0) // 0 means use default
+    {
+        if (numThreads < 0)
+            numThreads = max(1, mthreads + numThreads);
+        if (numThreads > mthreads)
+            numThreads = mthreads;
 
 #ifdef _OPENMP
-    omp_set_num_threads(numThreads);
-    numThreads = omp_get_max_threads();
+        omp_set_num_threads(numThreads);
+        numThreads = omp_get_max_threads();
 
 #ifndef USE_MKL
-    acmlsetnumthreads(numThreads);
+        acmlsetnumthreads(numThreads);
 #else
-    mkl_set_num_threads(numThreads);
+        mkl_set_num_threads(numThreads);
 #endif
+#endif
+    }
+
+#ifdef _OPENMP
+    const std::vector<int> allowedCPUs = pinThreads ? ProcessAllowedCPUs() : std::vector<int>();
+    if (!allowedCPUs.empty())
+    {
+#pragma omp parallel
+        {
+            const int cpu = allowedCPUs[omp_get_thread_num() % allowedCPUs.size()];
+#ifdef _WIN32
+            SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << cpu);
+#else
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            CPU_SET(cpu, &cpuSet);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#endif
+        }
+    }
+#else
+    pinThreads;
 #endif
     return numThreads;
 }
 
+// -----------------------------------------------------------------------
+// CPUThreadBudget
+// -----------------------------------------------------------------------
+
+// bind the calling thread to a set of logical CPUs
+static void BindThreadToCores(const std::vector<int>& cores)
+{
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for (int cpu : cores)
+    {
+        if (cpu < 8 * sizeof(DWORD_PTR))
+            mask |= (DWORD_PTR) 1 << cpu;
+    }
+    if (mask != 0)
+        SetThreadAffinityMask(GetCurrentThread(), mask);
+#else
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpu : cores)
+        CPU_SET(cpu, &cpuSet);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#endif
+}
+
+// the cores each thread was last bound to by a budget, and the number of OpenMP threads bound with it
+static thread_local std::vector<int>* t_boundCores = nullptr;
+static thread_local int t_boundNumThreads = 0;
+
+CPUThreadBudget::CPUThreadBudget(int numThreads, const std::vector<int>& cores)
+    : m_previousNumThreads(0), m_previousMKLThreads(0)
+{
+    if (numThreads <= 0)
+        numThreads = (int) cores.size();
+#ifdef _OPENMP
+    if (numThreads > 0)
+    {
+        m_previousNumThreads = omp_get_max_threads();
+        omp_set_num_threads(numThreads); // (the setting of this thread only)
+#ifdef USE_MKL
+        m_previousMKLThreads = mkl_set_num_threads_local(numThreads);
+#endif
+    }
+    if (!cores.empty() && (t_boundCores == nullptr || *t_boundCores != cores || t_boundNumThreads < numThreads))
+    {
+        BindThreadToCores(cores);
+#pragma omp parallel num_threads(numThreads)
+        BindThreadToCores(cores);
+        if (t_boundCores == nullptr)
+            t_boundCores = new std::vector<int>();
+        *t_boundCores = cores;
+        t_boundNumThreads = numThreads;
+    }
+#else
+    if (!cores.empty())
+        BindThreadToCores(cores);
+#endif
+}
+
+CPUThreadBudget::~CPUThreadBudget()
+{
+#ifdef _OPENMP
+    if (m_previousNumThreads > 0)
+    {
+        omp_set_num_threads(m_previousNumThreads);
+#ifdef USE_MKL
+        mkl_set_num_threads_local(m_previousMKLThreads);
+#endif
+    }
+#endif
+}
+
+// parse a Linux CPU list, e.g. "0-7,16-23"
+static std::vector<int> ParseCPUList(const std::string& list)
+{
+    std::vector<int> cpus;
+    for (size_t pos = 0; pos < list.size();)
+    {
+        char* end;
+        long first = strtol(list.c_str() + pos, &end, 10);
+        if (end == list.c_str() + pos)
+            break;
+        long last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        for (long cpu = first; cpu <= last; cpu++)
+            cpus.push_back((int) cpu);
+        pos = end - list.c_str();
+        if (pos < list.size() && list[pos] == ',')
+            pos++;
+        else
+            break;
+    }
+    return cpus;
+}
+
+std::vector<std::vector<int>> CPUThreadBudget::NumaNodeCores()
+{
+    std::vector<std::vector<int>> nodes;
+#ifdef _WIN32
+    ULONG highestNode = 0;
+    if (GetNumaHighestNodeNumber(&highestNode))
+    {
+        for (ULONG node = 0; node <= highestNode; node++)
+        {
+            ULONGLONG mask = 0;
+            if (!GetNumaNodeProcessorMask((UCHAR) node, &mask) || mask == 0)
+                continue;
+            std::vector<int> cores;
+            for (int cpu = 0; cpu < 64; cpu++)
+            {
+                if (mask & (1ULL << cpu))
+                    cores.push_back(cpu);
+            }
+            nodes.push_back(cores);
+        }
+    }
+#else
+    for (int node = 0;; node++)
+    {
+        char path[100];
+        sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+        FILE* f = fopen(path, "r");
+        if (f == nullptr)
+            break;
+        char list[4096] = "";
+        if (fgets(list, sizeof(list), f) == nullptr)
+            list[0] = 0;
+        fclose(f);
+        std::vector<int> cores = ParseCPUList(list);
+        if (!cores.empty())
+            nodes.push_back(cores);
+    }
+#endif
+    if (nodes.empty()) // no NUMA information: one node
+    {
+        nodes.push_back(std::vector<int>());
+        for (int cpu = 0; cpu < (int) std::thread::hardware_concurrency(); cpu++)
+            nodes.back().push_back(cpu);
+    }
+    return nodes;
+}
+
+static std::mutex s_coreAllocationMutex;
+static std::vector<bool> s_allocatedCores; // [cpu] held by an AllocateCores() of this process
+
+std::vector<int> CPUThreadBudget::AllocateCores(size_t numCores, int numaNode)
+{
+    const auto nodes = NumaNodeCores();
+    if (numaNode >= (int) nodes.size())
+        InvalidArgument("AllocateCores: there is no NUMA node %d (%d nodes).", numaNode, (int) nodes.size());
+    std::lock_guard<std::mutex> lock(s_coreAllocationMutex);
+    auto isFree = [](int cpu) { return cpu >= (int) s_allocatedCores.size() || !s_allocatedCores[cpu]; };
+    // [node] its free cores
+    std::vector<std::vector<int>> freeCores(nodes.size());
+    size_t totalFree = 0;
+    for (size_t node = 0; node < nodes.size(); node++)
+    {
+        for (int cpu : nodes[node])
+        {
+            if (isFree(cpu))
+                freeCores[node].push_back(cpu);
+        }
+        totalFree += freeCores[node].size();
+    }
+
+    std::vector<int> cores;
+    if (numaNode >= 0)
+    {
+        if (freeCores[numaNode].size() < numCores)
+            RuntimeError("AllocateCores: only %d of the %d cores of NUMA node %d are free; %d requested.", (int) freeCores[numaNode].size(), (int) nodes[numaNode].size(), numaNode, (int) numCores);
+        cores.assign(freeCores[numaNode].begin(), freeCores[numaNode].begin() + numCores);
+    }
+    else
+    {
+        if (totalFree < numCores)
+            RuntimeError("AllocateCores: only %d cores are free; %d requested.", (int) totalFree, (int) numCores);
+        // the node with the fewest free cores that has enough, so that large requests find room later; else spill over the fullest first
+        int best = -1;
+        for (size_t node = 0; node < freeCores.size(); node++)
+        {
+            if (freeCores[node].size() >= numCores && (best < 0 || freeCores[node].size() < freeCores[best].size()))
+                best = (int) node;
+        }
+        if (best >= 0)
+            cores.assign(freeCores[best].begin(), freeCores[best].begin() + numCores);
+        else
+        {
+            fprintf(stderr, "AllocateCores: no NUMA node has %d free cores; the allocation spans nodes.\n", (int) numCores);
+            std::vector<size_t> order(freeCores.size());
+            for (size_t node = 0; node < order.size(); node++)
+                order[node] = node;
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return freeCores[a].size() > freeCores[b].size(); });
+            for (size_t node : order)
+            {
+                for (size_t k = 0; k < freeCores[node].size() && cores.size() < numCores; k++)
+                    cores.push_back(freeCores[node][k]);
+            }
+        }
+    }
+    for (int cpu : cores)
+    {
+        if (cpu >= (int) s_allocatedCores.size())
+            s_allocatedCores.resize(cpu + 1, false);
+        s_allocatedCores[cpu] = true;
+    }
+    return cores;
+}
+
+void CPUThreadBudget::ReleaseCores(const std::vector<int>& cores)
+{
+    std::lock_guard<std::mutex> lock(s_coreAllocationMutex);
+    for (int cpu : cores)
+    {
+        if (cpu < (int) s_allocatedCores.size())
+            s_allocatedCores[cpu] = false;
+    }
+}
+
 // =======================================================================
 // TensorView support
 // =======================================================================
@@ -5502,17 +6868,17 @@ template <class ElemType, typename OPFN, size_t N, int m>
 struct TensorOpReduction
 {
     // reduction case (non-reduction case is specialized)
-    static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn,
+    static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn, ElementWiseOperator reductionOp,
                                 const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
     {
         array<ptrdiff_t, N - 1> strides;   // N-1 because last one is the result pointer, which is unused in reduction
         for (size_t i = 0; i < N - 1; i++) // N = a small constant, this will be unrolled
             strides[i] = reducingStrides[i][(size_t) m];
-        double /*ElemType*/ aggregate = 0;
+        double /*ElemType*/ aggregate = NeutralValue<double>(reductionOp);
         for (size_t dim = reducingOpDims[(size_t) m]; dim-- > 0;)
         {
             // need to descend into one loop deeper
-            aggregate += TensorOpReduction<ElemType, OPFN, N, m - 1>::Loop(pointers, opfn, reducingOpDims, reducingStrides);
+            aggregate = Aggregate<double>(aggregate, TensorOpReduction<ElemType, OPFN, N, m - 1>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides), reductionOp);
             // advance the pointers
             for (size_t i = 0; i < N - 1; i++)
                 pointers[i] += strides[i]; // note: last pointer (result) is unused and untouched here
@@ -5526,7 +6892,7 @@ struct TensorOpReduction
 template <class ElemType, typename OPFN, size_t N>
 struct TensorOpReduction<ElemType, OPFN, N, -1>
 {
-    static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn,
+    static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn, ElementWiseOperator /*reductionOp*/,
                                 const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&)
     {
         return opfn(pointers); // finally we are doing some work!!!
@@ -5541,7 +6907,7 @@ struct TensorOpReduction<ElemType, OPFN, N, -1>
 template <class ElemType, typename OPFN, size_t N, bool vectorizable, int m, int k>
 struct TensorOpIteration
 {
-    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn,
+    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
                             const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
                             const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
     {
@@ -5552,7 +6918,7 @@ struct TensorOpIteration
         for (size_t dim = regularOpDims[(size_t) k]; dim-- > 0;)
         {
             // need to descend into one loop deeper
-            TensorOpIteration<ElemType, OPFN, N, vectorizable, m, k - 1>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            TensorOpIteration<ElemType, OPFN, N, vectorizable, m, k - 1>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
             // advance the pointers
             for (size_t i = 0; i < N; i++)
                 pointers[i] += strides[i];
@@ -5565,7 +6931,7 @@ struct TensorOpIteration
 template <class ElemType, typename OPFN>
 struct TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, 0 /*innermost loop*/>
 {
-    static inline void Loop(ElemType beta, array<ElemType*, 3> pointers, ElemType alpha, const OPFN& opfn,
+    static inline void Loop(ElemType beta, array<ElemType*, 3> pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
                             const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
                             const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
     {
@@ -5577,15 +6943,15 @@ struct TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduc
         if (beta != 0)
 #pragma omp parallel for
             for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else if (alpha != 1)
 #pragma omp parallel for
             for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else
 #pragma omp parallel for
             for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, 1, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+                TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         // TODO: According to Amit, the VS compiler is not able to vectorize into lambdas. Solution: change the lambda to take an N, or to implement the loop inside (with 1 element by default).
         // TODO: The signedness of k (required for omp) causes an extra sign-extend.
         // TODO: OMP adds LOTS of overhead. Do we need a guard, a min size when to use it?
@@ -5595,7 +6961,7 @@ struct TensorOpIteration<ElemType, OPFN, 3, true /*vectorizable*/, -1 /*no reduc
 template <class ElemType, typename OPFN>
 struct TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, 0 /*innermost loop*/>
 {
-    static inline void Loop(ElemType beta, array<ElemType*, 2> pointers, ElemType alpha, const OPFN& opfn,
+    static inline void Loop(ElemType beta, array<ElemType*, 2> pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
                             const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                             const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
     {
@@ -5606,27 +6972,27 @@ struct TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduc
         if (beta != 0)
 #pragma omp parallel for
             for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else if (alpha != 1)
 #pragma omp parallel for
             for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else
 #pragma omp parallel for
             for (int k = 0; k < (int) K; k++)
-                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, 1, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+                TensorOpIteration<ElemType, OPFN, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     }
 };
 
 template <class ElemType, typename OPFN, size_t N, bool vectorizable, int m>
 struct TensorOpIteration<ElemType, OPFN, N, vectorizable, m, -1>
 {
-    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn,
+    static inline void Loop(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
                             const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&,
                             const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
     {
         // we are at element level for the result: perform the op (there may still be reduction)
-        ElemType val = TensorOpReduction<ElemType, OPFN, N, m>::Loop(pointers, opfn, reducingOpDims, reducingStrides);
+        ElemType val = TensorOpReduction<ElemType, OPFN, N, m>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides);
         // scale
         val *= alpha;
         // combine with previous value in target matrix, then write it out
@@ -5639,23 +7005,105 @@ struct TensorOpIteration<ElemType, OPFN, N, vectorizable, m, -1>
     }
 };
 
+// -----------------------------------------------------------------------
+// multi-threaded reductions
+// The element-wise loops above only parallelize the innermost loop of non-reducing ops. A reducing op instead gets
+// its outermost regular loop split over threads; one that reduces to a single value gets its outermost reducing
+// loop split into a fixed number of chunks, whose partial aggregates are combined in order, so that the result does
+// not depend on the number of threads.
+// -----------------------------------------------------------------------
+
+static const size_t minParallelReductionElements = 32768; // below this, threading costs more than it saves
+static const size_t numParallelReductionChunks = 64;
+
+template <class ElemType, typename OPFN, size_t N, int m, int k>
+struct TensorOpParallelReduction
+{
+    static void Loop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
+                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                     const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+    {
+        const size_t K = regularOpDims[(size_t) k];
+#pragma omp parallel for
+        for (long index = 0; index < (long) K; index++)
+        {
+            array<ElemType*, N> indexedPointers = pointers;
+            for (size_t i = 0; i < N; i++)
+                indexedPointers[i] += index * regularStrides[i][(size_t) k];
+            TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, m, k - 1>::Loop(beta, indexedPointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        }
+    }
+};
+
+// reduction to a single value (k = -1)
+template <class ElemType, typename OPFN, size_t N, int m>
+struct TensorOpParallelReduction<ElemType, OPFN, N, m, -1>
+{
+    static void Loop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
+                     const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&,
+                     const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+    {
+        const size_t dim = reducingOpDims[(size_t) m];
+        const size_t numChunks = min(dim, numParallelReductionChunks);
+        double partials[numParallelReductionChunks];
+#pragma omp parallel for
+        for (long chunk = 0; chunk < (long) numChunks; chunk++)
+        {
+            double partial = NeutralValue<double>(reductionOp);
+            for (size_t index = chunk * dim / numChunks; index < (chunk + 1) * dim / numChunks; index++)
+            {
+                array<ElemType*, N> indexedPointers = pointers;
+                for (size_t i = 0; i < N - 1; i++) // (the result pointer is not reduced over)
+                    indexedPointers[i] += index * reducingStrides[i][(size_t) m];
+                partial = Aggregate<double>(partial, TensorOpReduction<ElemType, OPFN, N, m - 1>::Loop(indexedPointers, opfn, reductionOp, reducingOpDims, reducingStrides), reductionOp);
+            }
+            partials[chunk] = partial;
+        }
+        double aggregate = NeutralValue<double>(reductionOp);
+        for (size_t chunk = 0; chunk < numChunks; chunk++)
+            aggregate = Aggregate<double>(aggregate, partials[chunk], reductionOp);
+
+        ElemType val = alpha * (ElemType) aggregate;
+        auto* pout = pointers.back();
+        if (beta != 0)
+            val += beta * *pout;
+        *pout = val;
+    }
+};
+
 // -----------------------------------------------------------------------
 // map runtime parameters N to template parameters
 // -----------------------------------------------------------------------
 
 // tensor operation with k+1 dimensions (-1 means scalar)
 template <class ElemType, typename OPFN, size_t N, int k>
-static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn,
+static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
                                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
                                     const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
 {
     size_t dims = reducingOpDims.size();
+    if (dims > 0 && omp_get_max_threads() > 1)
+    {
+        size_t numElements = 1;
+        for (size_t i = 0; i < regularOpDims.size(); i++)
+            numElements *= regularOpDims[i];
+        for (size_t i = 0; i < dims; i++)
+            numElements *= reducingOpDims[i];
+        const size_t numLoops = k >= 0 ? regularOpDims[(size_t) max(k, 0)] : reducingOpDims.back();
+        if (numElements >= minParallelReductionElements && numLoops > 1)
+        {
+            if (dims == 2)
+                return TensorOpParallelReduction<ElemType, OPFN, N, 1, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            else if (dims == 1)
+                return TensorOpParallelReduction<ElemType, OPFN, N, 0, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        }
+    }
     switch (dims)
     {
     case 2:
-        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 1, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 1, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 1:
-        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 0, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, 0, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 0:
     {
         // if all leading dimensions are 1, we can let the compiler do some unrolling
@@ -5663,9 +7111,9 @@ static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& po
         for (size_t i = 0; i < N; i++)
             leadingAllOne &= k >= 0 && regularStrides[i][0] == 1;
         if (leadingAllOne) // special version that uses a hard-coded increment of 1 for all leading dimensions
-            return TensorOpIteration<ElemType, OPFN, N, true /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            return TensorOpIteration<ElemType, OPFN, N, true /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else
-            return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+            return TensorOpIteration<ElemType, OPFN, N, false /*vectorizable*/, -1, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     }
     default:
         LogicError("TensorOp: %d non-flattened reduction dimensions are not supported.", (int) dims);
@@ -5675,7 +7123,7 @@ static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& po
 // tensor operation, generalized in number of arguments, operation already provided as a lambda
 // This function now expands into different k.
 template <class ElemType, typename OPFN, size_t N>
-static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn,
+static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, const OPFN& opfn, ElementWiseOperator reductionOp,
                            const array<size_t, N>& offsets,
                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
@@ -5686,15 +7134,15 @@ static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType
     switch (dims)
     {
     case 4:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, 3>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, 3>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 3:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, 2>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, 2>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 2:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, 1>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, 1>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 1:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, 0>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, 0>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 0:
-        return TensorOpWithRegularLoop<ElemType, OPFN, N, -1>(beta, pointers, alpha, opfn, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, OPFN, N, -1>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     default:
         LogicError("TensorOp: %d non-flattened input dimensions are not supported.", (int) dims);
     }
@@ -5707,7 +7155,7 @@ static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType
 // perform unary operation 'op' on a giving 'this', reinterpreting the matrices as tensors as specified by the dims and strides
 // This maps 'op' to a lambda.
 template <class ElemType>
-void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, ElemType alpha, ElementWiseOperator op,
+void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 2>& offsets,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
@@ -5719,7 +7167,12 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               {                                                        \
                                   return Op##oper((*(pp[0])));                         \
                               },                                                       \
-                              offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+                              reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+
+    // contiguous elementwise ops without reduction have vectorized kernels (for floats, if the CPU has AVX2)
+    if (regularOpDims.size() == 1 && regularStrides[0][0] == 1 && regularStrides[1][0] == 1 && reducingOpDims.empty() &&
+        VectorizedUnaryOp(op, beta, a.m_pArray + offsets[0], m_pArray + offsets[1], alpha, regularOpDims[0]))
+        return;
 
     array<ElemType*, 2> pointers = {a.m_pArray, m_pArray};
     switch (op)
@@ -5733,7 +7186,7 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
 // perform binary operation 'op' on a and b giving 'this', reinterpreting the matrices as tensors as specified by the dims and strides
 // This maps 'op' to a lambda.
 template <class ElemType>
-void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, ElemType alpha, ElementWiseOperator op,
+void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 3>& offsets,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
@@ -5744,7 +7197,11 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               {                                                        \
                                   return Op##oper((*(pp[0])), (*(pp[1])));             \
                               },                                                       \
-                              offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+                              reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+
+    if (regularOpDims.size() == 1 && regularStrides[0][0] == 1 && regularStrides[1][0] == 1 && regularStrides[2][0] == 1 && reducingOpDims.empty() &&
+        VectorizedBinaryOp(op, beta, a.m_pArray + offsets[0], b.m_pArray + offsets[1], m_pArray + offsets[2], alpha, regularOpDims[0]))
+        return;
 
     array<ElemType*, 3> pointers = {a.m_pArray, b.m_pArray, m_pArray};
     switch (op)
@@ -5758,7 +7215,7 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
 // perform ternary operation 'op' on a, and c giving 'this', reinterpreting the matrices as tensors as specified by the dims and strides
 // This maps 'op' to a lambda.
 template <class ElemType>
-void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& c, ElemType alpha, ElementWiseOperator op,
+void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& c, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 4>& offsets,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides)
@@ -5769,7 +7226,7 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               {                                                        \
                                   return Op##oper((*(pp[0])), (*(pp[1])), (*(pp[2]))); \
                               },                                                       \
-                              offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
+                              reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 4> pointers = {a.m_pArray, b.m_pArray, c.m_pArray, m_pArray};
     switch (op)
@@ -5780,6 +7237,44 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
     }
 }
 
+// execute a fused ElementWiseProgram, one element per loop iteration
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::ElementWiseProgramOp(const ElementWiseProgram& program, const ElemType* const* inputs, ElemType* const* outputs, size_t numElements)
+{
+#pragma omp parallel for
+    for (long i = 0; i < (long) numElements; i++)
+        ExecuteElementWiseProgram(program, inputs, outputs, (size_t) i);
+}
+
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::LSTMForwardStep(CPUMatrix<ElemType>& gates, const CPUMatrix<ElemType>& prevCell, CPUMatrix<ElemType>& cell, CPUMatrix<ElemType>& output)
+{
+    const size_t N = cell.GetNumRows();
+    ElemType* pGates = gates.BufferPointer();
+    const ElemType* pPrevCell = prevCell.BufferPointer();
+    ElemType* pCell = cell.BufferPointer();
+    ElemType* pOutput = output.BufferPointer();
+#pragma omp parallel for
+    for (long i = 0; i < (long) cell.GetNumElements(); i++)
+        LSTMForwardStepAt((size_t) i, N, pGates, pPrevCell, pCell, pOutput);
+}
+
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::LSTMBackwardStep(const CPUMatrix<ElemType>& gates, const CPUMatrix<ElemType>& prevCell, const CPUMatrix<ElemType>& cell,
+                                                     const CPUMatrix<ElemType>& outputGradient, CPUMatrix<ElemType>& cellGradient, CPUMatrix<ElemType>& gatesGradient)
+{
+    const size_t N = cell.GetNumRows();
+    const ElemType* pGates = gates.BufferPointer();
+    const ElemType* pPrevCell = prevCell.BufferPointer();
+    const ElemType* pCell = cell.BufferPointer();
+    const ElemType* pOutputGradient = outputGradient.BufferPointer();
+    ElemType* pCellGradient = cellGradient.BufferPointer();
+    ElemType* pGatesGradient = gatesGradient.BufferPointer();
+#pragma omp parallel for
+    for (long i = 0; i < (long) cell.GetNumElements(); i++)
+        LSTMBackwardStepAt((size_t) i, N, pGates, pPrevCell, pCell, pOutputGradient, pCellGradient, pGatesGradient);
+}
+
 // =======================================================================
 // explicit instantiations
 // =======================================================================
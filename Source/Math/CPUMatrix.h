@@ -83,6 +83,11 @@ public:
                      ElemType RMS_WGT_DEC,
                      ElemType RMS_WGT_MIN,
                      const bool needAveMultiplier);
+    void LarsUpdate(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRate, ElemType momentum, ElemType trustCoefficient);
+    void LambUpdate(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRate, ElemType beta1, ElemType beta2, ElemType epsilon, ElemType weightDecay);
+    static void MultiTensorNormalGrad(const std::vector<CPUMatrix<ElemType>*>& functionValues, const std::vector<CPUMatrix<ElemType>*>& gradients, const std::vector<CPUMatrix<ElemType>*>& smoothedGradients,
+                                      ElemType learnRatePerSample, ElemType momentum, bool useNesterovMomentum,
+                                      ElemType clippingThreshold, bool clipByTruncation, ElemType l2Weight, ElemType l1Threshold);
 
     void Reshape(const size_t numRows, const size_t numCols);
     void Resize(const size_t numRows, const size_t numCols, bool growOnly = true); // by default we only reallocate if need to grow
@@ -106,6 +111,7 @@ public:
     void SetValue(const ElemType v);
     void SetValue(const CPUMatrix<ElemType>& deepCopyFrom);
     void SetValue(const size_t numRows, const size_t numCols, ElemType* pArray, size_t matrixFlags = matrixFlagNormal);
+    void SetValueFromCompact(const size_t numRows, const size_t numCols, const void* pArray, CompactElementType type, ElemType scale, const ElemType* rowShift);
 
     void MaskColumnsValue(const CPUMatrix<char>& columnsMask, ElemType val);
 
@@ -157,6 +163,8 @@ public:
     CPUMatrix<ElemType>& ElementMultiplyWith(const CPUMatrix<ElemType>& a);
     CPUMatrix<ElemType>& AssignElementProductOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b);
     CPUMatrix<ElemType>& AddElementProductOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b);
+    // [this] = beta * [this] + a .* dropout mask (see DropoutMaskAt() in TensorOps.h)
+    CPUMatrix<ElemType>& AddDropoutOf(const CPUMatrix<ElemType>& a, const ElemType beta, const ElemType dropoutRate, unsigned long seed, size_t offset);
 
     CPUMatrix<ElemType>& AssignElementDivisionOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b);
     CPUMatrix<ElemType>& ElementDivideBy(const CPUMatrix<ElemType>& a);
@@ -256,6 +264,7 @@ public:
 
     ElemType FrobeniusNorm() const;
     CPUMatrix<ElemType>& AssignFrobeniusNormOf(const CPUMatrix<ElemType>& a);
+    CPUMatrix<ElemType>& ClipFrobeniusNorm(ElemType maxNorm, CPUMatrix<ElemType>& norm);
 
     ElemType MatrixNormInf() const;
     ElemType MatrixNorm1() const;
@@ -272,6 +281,8 @@ public:
 
     CPUMatrix<ElemType>& AssignRepeatOf(const CPUMatrix<ElemType>& a, const size_t numRowRepeats, const size_t numColRepeats);
     CPUMatrix<ElemType>& AddToRowRepeatValuesOf(const CPUMatrix<ElemType>& a, const size_t numRowRepeats);
+    CPUMatrix<ElemType>& AssignRowStackedColumnsOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& sourceColumns);
+    CPUMatrix<ElemType>& AddFromRowStackedColumnsOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& sourceColumns);
 
     CPUMatrix<ElemType>& AssignPositiveAndShiftedNegSample(const CPUMatrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber);
     CPUMatrix<ElemType>& AddFoldedPositiveAndShiftedNegSample(const CPUMatrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber);
@@ -317,12 +328,13 @@ public:
                                                    const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample);
 
 public:
-    static int SetNumThreads(int numThreads); // note: this does not depend on <ElemType>, i.e. you can call it on any <ElemType>
+    static int SetNumThreads(int numThreads, bool pinThreads = false); // note: this does not depend on <ElemType>, i.e. you can call it on any <ElemType>
 
     // static BLAS functions
     static void SVD(const CPUMatrix<ElemType>& A, CPUMatrix<ElemType>& SIGMA, CPUMatrix<ElemType>& U, CPUMatrix<ElemType>& VT, CPUMatrix<ElemType>& W);
 
     static void MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c);
+    static void BatchMultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c, size_t batchSize);
     static void MultiplyAndAdd(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, CPUMatrix<ElemType>& c);
     static void Multiply(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, CPUMatrix<ElemType>& c);
     static void Multiply(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
@@ -334,6 +346,19 @@ public:
     static void AddScaledDifference(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);    // alpha must be 1X1
     static void AssignScaledDifference(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c); // alpha must be 1X1
 
+    // see Matrix::SoftmaxCrossEntropy(); alpha must be 1X1
+    static void SoftmaxCrossEntropy(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& prediction, CPUMatrix<ElemType>& columnStats);
+    static void SoftmaxCrossEntropyBackprop(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& prediction,
+                                            const CPUMatrix<ElemType>& columnStats, CPUMatrix<ElemType>& predictionGradient);
+
+    // see Matrix::HierarchicalSoftmax(); alpha must be 1X1
+    static void HierarchicalSoftmax(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& hidden, const CPUMatrix<ElemType>& weights, const CPUMatrix<ElemType>& paths,
+                                    CPUMatrix<ElemType>& frameLosses, CPUMatrix<ElemType>& pathGradients);
+    static void HierarchicalSoftmaxBackpropHidden(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& weights, const CPUMatrix<ElemType>& paths,
+                                                  const CPUMatrix<ElemType>& pathGradients, CPUMatrix<ElemType>& hiddenGradient);
+    static void HierarchicalSoftmaxBackpropWeights(const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& hidden, const CPUMatrix<ElemType>& paths,
+                                                   const CPUMatrix<ElemType>& pathGradients, CPUMatrix<ElemType>& weightsGradient);
+
     static void AddElementToElement(const CPUMatrix<ElemType>& a, const size_t ai, const size_t aj, CPUMatrix<ElemType>& c, const size_t ci, const size_t cj);
     // static void AddLogElementToElement(const CPUMatrix<ElemType>& a, const size_t ai, const size_t aj, CPUMatrix<ElemType>& c, const size_t ci, const size_t cj);
     static void AssignElementToElement(const CPUMatrix<ElemType>& a, const size_t ai, const size_t aj, CPUMatrix<ElemType>& c, const size_t ci, const size_t cj);
@@ -351,18 +376,25 @@ public:
 
     static void TensorShuffleScaleAndAdd(ElemType keepWeight, const CPUMatrix<ElemType>& a, size_t D, size_t S, size_t M, size_t K, size_t T, ElemType scaleFactor, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
 
-    void TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, ElemType alpha, ElementWiseOperator op,
+    void TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                   const std::array<size_t, 2>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& reducingStrides);
-    void TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, ElemType alpha, ElementWiseOperator op,
+    void TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                   const std::array<size_t, 3>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 3>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 3>& reducingStrides);
-    void TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& c, ElemType alpha, ElementWiseOperator op,
+    void TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& c, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                   const std::array<size_t, 4>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
+    // fused elementwise ops over 'numElements' consecutive elements of each input and output
+    static void ElementWiseProgramOp(const ElementWiseProgram& program, const ElemType* const* inputs, ElemType* const* outputs, size_t numElements);
+
+    // one time step of an LSTM over all parallel sequences (see LSTMForwardStepAt() in TensorOps.h)
+    static void LSTMForwardStep(CPUMatrix<ElemType>& gates, const CPUMatrix<ElemType>& prevCell, CPUMatrix<ElemType>& cell, CPUMatrix<ElemType>& output);
+    static void LSTMBackwardStep(const CPUMatrix<ElemType>& gates, const CPUMatrix<ElemType>& prevCell, const CPUMatrix<ElemType>& cell,
+                                 const CPUMatrix<ElemType>& outputGradient, CPUMatrix<ElemType>& cellGradient, CPUMatrix<ElemType>& gatesGradient);
 
     static CPUMatrix<ElemType> Ones(const size_t rows, const size_t cols);
     static CPUMatrix<ElemType> Zeros(const size_t rows, const size_t cols);
@@ -380,11 +412,17 @@ public:
     CPUMatrix<ElemType>& GetARowByIndex(const CPUMatrix<ElemType>& a, const size_t index);
     static void ConductRowElementMultiplyWithShift(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c, const size_t shift, bool bFirstmatrixfixed);
     CPUMatrix<ElemType>& AssignElementProductOfWithShift(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const size_t shift);
+    CPUMatrix<ElemType>& AssignCosDistanceWithShiftNeg(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB, size_t shift, size_t negnumber);
+    static void AddCosDistanceWithShiftNegGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& cosDistance, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB, size_t shift, size_t negnumber, bool wrtB, CPUMatrix<ElemType>& inputGradient);
 
 public:
+    // A matrix written with fileOptionsAlignedBlocks is marked BMATA and stores its elements as one aligned block. When read
+    // from a mapped file, the matrix then references the mapping in place (read-only); the caller must keep the mapping alive.
     friend File& operator>>(File& stream, CPUMatrix<ElemType>& us)
     {
-        stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+        const bool isAligned = stream.CanSeek() && stream.TryGetMarker(fileMarkerBeginSection, std::wstring(L"BMATA"));
+        if (!isAligned)
+            stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
         size_t elsize;
         stream >> elsize;
         if (sizeof(ElemType) != elsize)
@@ -393,22 +431,33 @@ public:
         size_t numRows, numCols;
         int format;
         stream >> matrixName >> format >> numRows >> numCols;
-        ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        if (isAligned && stream.GetMapping() && numRows * numCols > 0)
+        {
+            const void* data = stream.GetAlignedBlock(numRows * numCols * sizeof(ElemType), nullptr);
+            us.SetValue(numRows, numCols, const_cast<ElemType*>(static_cast<const ElemType*>(data)), matrixFlagDontOwnBuffer);
+        }
+        else
+        {
+            ElemType* d_array = new ElemType[numRows * numCols];
+            if (isAligned)
+                stream.GetAlignedBlock(numRows * numCols * sizeof(ElemType), d_array);
+            else
+                stream.GetArray(d_array, numRows * numCols);
+            us.SetValue(numRows, numCols, d_array, matrixFlagNormal);
+            delete[] d_array;
+        }
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
-        us.SetValue(numRows, numCols, d_array, matrixFlagNormal);
         if (us.m_matrixName)
             delete[] us.m_matrixName;
         us.m_matrixName = new wchar_t[matrixName.length() + 1];
         wmemcpy(us.m_matrixName, matrixName.c_str(), matrixName.length() + 1);
 
-        delete[] d_array;
         return stream;
     }
     friend File& operator<<(File& stream, const CPUMatrix<ElemType>& us)
     {
-        stream.PutMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+        const bool isAligned = stream.UsesAlignedBlocks();
+        stream.PutMarker(fileMarkerBeginSection, std::wstring(isAligned ? L"BMATA" : L"BMAT"));
         stream << sizeof(ElemType);
 
         std::wstring s = (us.m_matrixName == NULL) ? std::wstring(L"unnamed") : std::wstring(us.m_matrixName);
@@ -416,8 +465,10 @@ public:
         stream << s << format;
 
         stream << us.m_numRows << us.m_numCols;
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << us.m_pArray[i];
+        if (isAligned)
+            stream.PutAlignedBlock(us.m_pArray, us.GetNumElements() * sizeof(ElemType));
+        else
+            stream.PutArray(us.m_pArray, us.GetNumElements());
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         return stream;
     }
@@ -449,6 +500,32 @@ public:
                                      const size_t tPos // position
                                      );
 
+    // batched CRF and Viterbi over all sequences of a minibatch (see Matrix.h)
+    static void CRFForwardBackward(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& posScores, const CPUMatrix<ElemType>& pairScores,
+                                   CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta, CPUMatrix<ElemType>& sequenceScores,
+                                   const CPUMatrix<ElemType>& sequences, const size_t numParallelSequences);
+    static void CRFTransitionGradient(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& posScores, const CPUMatrix<ElemType>& pairScores,
+                                      const CPUMatrix<ElemType>& alpha, const CPUMatrix<ElemType>& beta, CPUMatrix<ElemType>& grd,
+                                      const CPUMatrix<ElemType>& sequences, const size_t numParallelSequences);
+    static void ViterbiDecode(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& posScores, const CPUMatrix<ElemType>& pairScores,
+                              CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& backtrace, CPUMatrix<ElemType>& decodedPath,
+                              const CPUMatrix<ElemType>& sequences, const size_t numParallelSequences);
+
+    // batched denominator-graph forward-backward over all sequences of a minibatch (see Matrix.h)
+    static void DenominatorForwardBackward(const CPUMatrix<ElemType>& logLikelihoods, const CPUMatrix<ElemType>& arcs, const CPUMatrix<ElemType>& states,
+                                           CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta, CPUMatrix<ElemType>& posteriors, CPUMatrix<ElemType>& logDenominators,
+                                           const CPUMatrix<ElemType>& sequences, const size_t numParallelSequences);
+
+    // batched class-based softmax over all frames of a minibatch (see Matrix.h)
+    static void ClassConditionalLogSoftmax(const CPUMatrix<ElemType>& hidden, const CPUMatrix<ElemType>& weights, const CPUMatrix<ElemType>& frames, const size_t totalNumWords,
+                                           CPUMatrix<ElemType>& logSoftmax, CPUMatrix<ElemType>& targetLogProbs);
+    static void ClassConditionalSoftmaxGradient(const CPUMatrix<ElemType>& logSoftmax, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& frames,
+                                                CPUMatrix<ElemType>& grd);
+    static void AddClassConditionalHiddenGradient(const CPUMatrix<ElemType>& weights, const CPUMatrix<ElemType>& grd, const CPUMatrix<ElemType>& frames,
+                                                  CPUMatrix<ElemType>& hiddenGradient);
+    static void AddClassConditionalWeightGradient(const CPUMatrix<ElemType>& hidden, const CPUMatrix<ElemType>& grd, const CPUMatrix<ElemType>& frames,
+                                                  const CPUMatrix<ElemType>& classes, CPUMatrix<ElemType>& weightGradient);
+
 protected:
     size_t LocateElement(const size_t i, const size_t j) const;
     size_t LocateColumn(const size_t j) const;
@@ -458,6 +535,37 @@ private:
     void Clear();
 };
 
+// -----------------------------------------------------------------------
+// CPUThreadBudget -- the cores and the number of threads of the CPU math of the calling thread, for a scope
+//
+// SetNumThreads() is process-wide: several evaluators in one process each take all cores for their OpenMP regions
+// and BLAS calls. A budget instead applies to the calling thread only: OpenMP keeps the number of threads per
+// thread, and MKL has a thread-local setting (ACML runs on the OpenMP threads of the caller). With cores, the
+// calling thread and the OpenMP threads of its parallel regions are bound to them (they stay bound afterwards; the
+// binding is redone only when a thread gets other cores). AllocateCores() hands out disjoint sets of cores of one
+// NUMA node where possible, for instances that should not share cores.
+// -----------------------------------------------------------------------
+
+class MATH_API CPUThreadBudget
+{
+public:
+    // numThreads = 0: as many as cores, or leave the number unchanged without cores
+    CPUThreadBudget(int numThreads, const std::vector<int>& cores);
+    ~CPUThreadBudget();
+
+    // 'numCores' logical CPUs that no other allocation holds, on the given NUMA node or (numaNode < 0) on the one with the most free
+    static std::vector<int> AllocateCores(size_t numCores, int numaNode = -1);
+    static void ReleaseCores(const std::vector<int>& cores);
+    // [node] logical CPUs of each NUMA node
+    static std::vector<std::vector<int>> NumaNodeCores();
+
+private:
+    CPUThreadBudget(const CPUThreadBudget&) = delete;
+    CPUThreadBudget& operator=(const CPUThreadBudget&) = delete;
+    int m_previousNumThreads; // of OpenMP; 0 if unchanged
+    int m_previousMKLThreads;
+};
+
 typedef CPUMatrix<float> CPUSingleMatrix;
 typedef CPUMatrix<double> CPUDoubleMatrix;
 } } }
@@ -118,6 +118,7 @@ void CPUSparseMatrix<ElemType>::ZeroInit()
         m_pArray = NULL;
         m_blockIds = NULL;
     }
+    m_bsrBlockDim = 0;
     m_nzValues = NULL;
 }
 
@@ -125,7 +126,8 @@ void CPUSparseMatrix<ElemType>::ZeroInit()
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::CheckInit(const MatrixFormat format)
 {
-    if (format != MatrixFormat::matrixFormatSparseCSC && format != MatrixFormat::matrixFormatSparseCSR && format != MatrixFormat::matrixFormatSparseBlockCol && format != MatrixFormat::matrixFormatSparseBlockRow)
+    if (format != MatrixFormat::matrixFormatSparseCSC && format != MatrixFormat::matrixFormatSparseCSR && format != MatrixFormat::matrixFormatSparseBlockCol && format != MatrixFormat::matrixFormatSparseBlockRow &&
+        format != MatrixFormat::matrixFormatSparseBSR)
     {
         LogicError("CPUSparseMatrix:  unsupported sparse matrix format");
     }
@@ -192,6 +194,7 @@ CPUSparseMatrix<ElemType>::CPUSparseMatrix(CPUSparseMatrix<ElemType>&& moveFrom)
     m_blockSize = moveFrom.m_blockSize;
     m_blockIdShift = moveFrom.m_blockIdShift;
     m_blockIds = moveFrom.m_blockIds;
+    m_bsrBlockDim = moveFrom.m_bsrBlockDim;
 
     // release the pointer from the source object so that the destructor won't release it twice
     moveFrom.ZeroInit();
@@ -225,6 +228,7 @@ CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::operator=(CPUSparseMatrix<
         m_blockSize = moveFrom.m_blockSize;
         m_blockIdShift = moveFrom.m_blockIdShift;
         m_blockIds = moveFrom.m_blockIds;
+        m_bsrBlockDim = moveFrom.m_bsrBlockDim;
 
         // release the pointer from the source object so that the destructor won't release it twice
         moveFrom.ZeroInit();
@@ -248,7 +252,7 @@ void CPUSparseMatrix<ElemType>::ReleaseMemory()
     {
         delete[] m_matrixName;
 
-        if (m_format == MatrixFormat::matrixFormatSparseCSC || m_format == MatrixFormat::matrixFormatSparseCSR)
+        if (m_format == MatrixFormat::matrixFormatSparseCSC || m_format == MatrixFormat::matrixFormatSparseCSR || m_format == MatrixFormat::matrixFormatSparseBSR)
         {
             delete[] m_pArray;
             m_pArray = nullptr;
@@ -336,6 +340,7 @@ void CPUSparseMatrix<ElemType>::SetValue(const CPUSparseMatrix<ElemType>& v)
 
     this->Reset();
     m_format = v.GetFormat();
+    m_bsrBlockDim = v.m_bsrBlockDim;
 
     this->Resize(v.GetNumRows(), v.GetNumCols(), v.NzSize());
     m_nz = v.NzCount();
@@ -460,6 +465,9 @@ CPUMatrix<ElemType> CPUSparseMatrix<ElemType>::CopyColumnSliceToDense(size_t sta
     if (startColumn + numCols > m_numCols)
         InvalidArgument("The slice (%d+%d) is out of range of the source matrix (%d).", (int) startColumn, (int) numCols, (int) m_numCols);
 
+    if (m_format == MatrixFormat::matrixFormatSparseBSR)
+        return CopyBSRColumnSliceToDense(startColumn, numCols);
+
     if (m_format != MatrixFormat::matrixFormatSparseCSC)
         NOT_IMPLEMENTED;
 
@@ -482,6 +490,46 @@ CPUMatrix<ElemType> CPUSparseMatrix<ElemType>::CopyColumnSliceToDense(size_t sta
     return slice;
 }
 
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::CopyOneHotIndicesTo(CPUMatrix<ElemType>& indices) const
+{
+    if (m_format != MatrixFormat::matrixFormatSparseCSC)
+        NOT_IMPLEMENTED;
+
+    indices.Resize(1, m_numCols);
+    for (size_t j = 0; j < m_numCols; j++)
+        indices(0, j) = m_compIndex[j + 1] > m_compIndex[j] ? (ElemType) m_unCompIndex[m_compIndex[j]] : (ElemType) -1;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType> CPUSparseMatrix<ElemType>::CopyBSRColumnSliceToDense(size_t startColumn, size_t numCols) const
+{
+    CPUMatrix<ElemType> slice(m_numRows, numCols);
+
+    const size_t dim = m_bsrBlockDim;
+    const long numBlockRows = (long) ((m_numRows + dim - 1) / dim);
+#pragma omp parallel for
+    for (long bi = 0; bi < numBlockRows; bi++)
+    {
+        const size_t rowBegin = bi * dim;
+        const size_t rows = min(dim, m_numRows - rowBegin);
+        for (size_t p = m_compIndex[bi]; p < m_compIndex[bi + 1]; p++)
+        {
+            const ElemType* block = m_pArray + p * dim * dim;
+            for (size_t q = 0; q < dim; q++)
+            {
+                const size_t col = m_unCompIndex[p] * dim + q;
+                if (col < startColumn || col >= startColumn + numCols)
+                    continue;
+                for (size_t r = 0; r < rows; r++)
+                    slice(rowBegin + r, col - startColumn) = block[q * dim + r];
+            }
+        }
+    }
+
+    return slice;
+}
+
 template <class ElemType>
 CPUMatrix<ElemType> CPUSparseMatrix<ElemType>::DiagonalToDense() const
 {
@@ -529,6 +577,145 @@ void CPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
     memcpy(NzValues(), h_Val, NzSize());
 }
 
+// triplets ordered by column (checked here, unlike on the GPU)
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::SetMatrixFromCOOFormat(const CPUSPARSE_INDEX_TYPE* h_Col, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                                       const size_t nz, const size_t numRows, const size_t numCols)
+{
+    std::vector<CPUSPARSE_INDEX_TYPE> colStarts(numCols + 1, 0);
+    for (size_t k = 0; k < nz; k++)
+    {
+        if (h_Col[k] < 0 || (size_t) h_Col[k] >= numCols || (k > 0 && h_Col[k] < h_Col[k - 1]))
+            InvalidArgument("SetMatrixFromCOOFormat: The triplets must be ordered by column, with columns below %d.", (int) numCols);
+        colStarts[h_Col[k] + 1]++;
+    }
+    for (size_t j = 0; j < numCols; j++)
+        colStarts[j + 1] += colStarts[j];
+    SetMatrixFromCSCFormat(colStarts.data(), h_Row, h_Val, nz, numRows, numCols);
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::GetSparseBlockColData(std::vector<size_t>& columnIds, std::vector<ElemType>& values) const
+{
+    if (m_format != matrixFormatSparseBlockCol)
+        LogicError("GetSparseBlockColData: The matrix is not in SparseBlockCol format.");
+
+    columnIds.resize(m_blockSize);
+    for (size_t j = 0; j < m_blockSize; j++)
+        columnIds[j] = m_blockIds[j] - m_blockIdShift;
+    values.assign(m_nzValues, m_nzValues + m_blockSize * m_numRows);
+}
+
+// colStarts (GetNumCols() + 1 entries) start at 0
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::GetSparseCSCData(std::vector<CPUSPARSE_INDEX_TYPE>& colStarts, std::vector<CPUSPARSE_INDEX_TYPE>& rowIndices, std::vector<ElemType>& values) const
+{
+    if (m_format != matrixFormatSparseCSC)
+        LogicError("GetSparseCSCData: The matrix is not in CSC format.");
+
+    colStarts.assign(m_numCols + 1, 0);
+    if (m_numCols == 0)
+    {
+        rowIndices.clear();
+        values.clear();
+        return;
+    }
+    const CPUSPARSE_INDEX_TYPE base = m_compIndex[0];
+    for (size_t j = 0; j <= m_numCols; j++)
+        colStarts[j] = m_compIndex[j] - base;
+    rowIndices.assign(m_unCompIndex + base, m_unCompIndex + m_compIndex[m_numCols]);
+    values.assign(m_nzValues + base, m_nzValues + m_compIndex[m_numCols]);
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::SetSparseBlockColData(const size_t numRows, const size_t numCols, const std::vector<size_t>& columnIds, const std::vector<ElemType>& values)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+    if (values.size() != numRows * columnIds.size())
+        InvalidArgument("SetSparseBlockColData: Expected %d values for %d columns.", (int) (numRows * columnIds.size()), (int) columnIds.size());
+
+    m_format = matrixFormatSparseBlockCol;
+    Resize(numRows, numCols, values.size(), true, false);
+    m_blockSize = columnIds.size();
+    m_blockIdShift = 0;
+    std::copy(columnIds.begin(), columnIds.end(), m_blockIds);
+    std::copy(values.begin(), values.end(), m_nzValues);
+    this->SetNzCount(values.size());
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::SetMatrixFromBSRFormat(const CPUSPARSE_INDEX_TYPE* h_blockRowStarts, const CPUSPARSE_INDEX_TYPE* h_blockCols, const ElemType* h_blockValues,
+                                                       const size_t numBlocks, const size_t blockDim, const size_t numRows, const size_t numCols)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+    if (blockDim == 0 || blockDim > maxBSRBlockDim)
+        InvalidArgument("SetMatrixFromBSRFormat: The block dimension must be between 1 and %d.", (int) maxBSRBlockDim);
+
+    m_format = matrixFormatSparseBSR;
+    m_bsrBlockDim = blockDim;
+    Resize(numRows, numCols, numBlocks * blockDim * blockDim, true, false);
+    this->SetNzCount(numBlocks * blockDim * blockDim);
+
+    memcpy(SecondaryIndexLocation(), h_blockRowStarts, SecondaryIndexSize());
+    memcpy(MajorIndexLocation(), h_blockCols, MajorIndexSize());
+    memcpy(NzValues(), h_blockValues, NzSize());
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::SetBSRFromDense(const ElemType* dense, const size_t numRows, const size_t numCols, const size_t blockDim)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+    if (blockDim == 0 || blockDim > maxBSRBlockDim)
+        InvalidArgument("SetBSRFromDense: The block dimension must be between 1 and %d.", (int) maxBSRBlockDim);
+
+    // find the non-zero blocks
+    const size_t numBlockRows = (numRows + blockDim - 1) / blockDim;
+    const size_t numBlockCols = (numCols + blockDim - 1) / blockDim;
+    std::vector<CPUSPARSE_INDEX_TYPE> blockRowStarts(numBlockRows + 1, 0);
+    std::vector<CPUSPARSE_INDEX_TYPE> blockCols;
+    for (size_t bi = 0; bi < numBlockRows; bi++)
+    {
+        const size_t rowEnd = min((bi + 1) * blockDim, numRows);
+        for (size_t bj = 0; bj < numBlockCols; bj++)
+        {
+            const size_t colEnd = min((bj + 1) * blockDim, numCols);
+            bool nonZero = false;
+            for (size_t col = bj * blockDim; col < colEnd && !nonZero; col++)
+                for (size_t row = bi * blockDim; row < rowEnd && !nonZero; row++)
+                    nonZero = dense[col * numRows + row] != 0;
+            if (nonZero)
+                blockCols.push_back((CPUSPARSE_INDEX_TYPE) bj);
+        }
+        blockRowStarts[bi + 1] = (CPUSPARSE_INDEX_TYPE) blockCols.size();
+    }
+
+    m_format = matrixFormatSparseBSR;
+    m_bsrBlockDim = blockDim;
+    Resize(numRows, numCols, blockCols.size() * blockDim * blockDim, true, false);
+    this->SetNzCount(blockCols.size() * blockDim * blockDim);
+    std::copy(blockRowStarts.begin(), blockRowStarts.end(), m_compIndex);
+    std::copy(blockCols.begin(), blockCols.end(), m_unCompIndex);
+
+#pragma omp parallel for
+    for (long bi = 0; bi < (long) numBlockRows; bi++)
+    {
+        const size_t rowBegin = bi * blockDim;
+        const size_t rows = min(blockDim, numRows - rowBegin);
+        for (size_t p = blockRowStarts[bi]; p < blockRowStarts[bi + 1]; p++)
+        {
+            ElemType* block = m_pArray + p * blockDim * blockDim;
+            memset(block, 0, sizeof(ElemType) * blockDim * blockDim);
+            const size_t colBegin = blockCols[p] * blockDim;
+            const size_t cols = min(blockDim, numCols - colBegin);
+            for (size_t q = 0; q < cols; q++)
+                memcpy(block + q * blockDim, dense + (colBegin + q) * numRows + rowBegin, sizeof(ElemType) * rows);
+        }
+    }
+}
+
 template <class ElemType>
 ElemType* CPUSparseMatrix<ElemType>::BufferPointer() const
 {
@@ -553,7 +740,7 @@ void CPUSparseMatrix<ElemType>::Resize(const size_t numRows, const size_t numCol
 
     if (reallocate)
     {
-        if (m_format == MatrixFormat::matrixFormatSparseCSC || m_format == MatrixFormat::matrixFormatSparseCSR)
+        if (m_format == MatrixFormat::matrixFormatSparseCSC || m_format == MatrixFormat::matrixFormatSparseCSR || m_format == MatrixFormat::matrixFormatSparseBSR)
         {
             ElemType* pArray = NULL;
             pArray = new ElemType[numNZElemToReserve];
@@ -663,52 +850,280 @@ void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPU
     if (rhs.GetFormat() != matrixFormatSparseCSC)
         NOT_IMPLEMENTED;
 
+    // All products are partitioned by output column, so that threads never write to the same column of c,
+    // and the inner loops run over contiguous dense columns.
+    const size_t lhsRows = lhs.GetNumRows();
+    const ElemType* lhsData = lhs.BufferPointer();
+    ElemType* cData = c.GetArray();
     if (!transposeA && !transposeB)
     {
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
+#ifdef USE_MKL
+        // c^T = rhs^T * lhs^T, where the CSC arrays of rhs are the CSR arrays of rhs^T, and the column-major
+        // lhs and c are row-major lhs^T and c^T, which is what zero-based csrmm expects;
+        // csrmm indexes val and indx relative to pntrb[0], which is not 0 for a column slice
+        const size_t firstNz = rhs.m_compIndex[0];
+        const char transa = 'N';
+        const MKL_INT mklM = (MKL_INT) rhs.GetNumCols(), mklN = (MKL_INT) m, mklK = (MKL_INT) k;
+        const char matdescra[6] = {'G', 'L', 'N', 'C', 0, 0};
+        const ElemType one = 1;
+        if (sizeof(ElemType) == sizeof(double))
+            mkl_dcsrmm(&transa, &mklM, &mklN, &mklK, reinterpret_cast<double*>(&alpha), matdescra, reinterpret_cast<double*>(rhs.m_pArray + firstNz),
+                       rhs.m_unCompIndex + firstNz, rhs.m_compIndex, rhs.m_compIndex + 1, reinterpret_cast<const double*>(lhsData), &mklN,
+                       reinterpret_cast<const double*>(&one), reinterpret_cast<double*>(cData), &mklN);
+        else
+            mkl_scsrmm(&transa, &mklM, &mklN, &mklK, reinterpret_cast<float*>(&alpha), matdescra, reinterpret_cast<float*>(rhs.m_pArray + firstNz),
+                       rhs.m_unCompIndex + firstNz, rhs.m_compIndex, rhs.m_compIndex + 1, reinterpret_cast<const float*>(lhsData), &mklN,
+                       reinterpret_cast<const float*>(&one), reinterpret_cast<float*>(cData), &mklN);
+#else
+        // c(:, j) += alpha * sum_p lhs(:, i_p) * val_p over the nonzeros (i_p, j) of column j of rhs
+#pragma omp parallel for
+        for (long j = 0; j < (long) rhs.GetNumCols(); j++)
         {
-            size_t start = rhs.m_compIndex[j]; // ColLocation
-            size_t end = rhs.m_compIndex[j + 1];
-            for (size_t p = start; p < end; p++)
+            ElemType* cj = cData + j * lhsRows;
+            for (size_t p = rhs.m_compIndex[j]; p < rhs.m_compIndex[j + 1]; p++)
             {
-                size_t i = rhs.m_unCompIndex[p]; // RowLocation
-                ElemType val = rhs.m_pArray[p];
-
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                {
-                    c(h, j) += alpha * lhs(h, i) * val;
-                }
+                const ElemType* li = lhsData + rhs.m_unCompIndex[p] * lhsRows;
+                const ElemType val = alpha * rhs.m_pArray[p];
+                for (size_t h = 0; h < lhsRows; h++)
+                    cj[h] += li[h] * val;
             }
         }
+#endif
     }
     else if (!transposeA && transposeB)
     {
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
+        // c(:, i) += alpha * sum_p lhs(:, j_p) * val_p over the nonzeros (i, j_p) of row i of rhs
+        std::vector<size_t> rowStarts, nzOfRows, colOfNz;
+        rhs.GetNonZerosByRow(rowStarts, nzOfRows, colOfNz);
+#pragma omp parallel for
+        for (long i = 0; i < (long) rhs.GetNumRows(); i++)
+        {
+            ElemType* ci = cData + i * lhsRows;
+            for (size_t q = rowStarts[i]; q < rowStarts[i + 1]; q++)
+            {
+                const size_t p = nzOfRows[q];
+                const ElemType* lj = lhsData + colOfNz[p - rhs.m_compIndex[0]] * lhsRows;
+                const ElemType val = alpha * rhs.m_pArray[p];
+                for (size_t h = 0; h < lhsRows; h++)
+                    ci[h] += lj[h] * val;
+            }
+        }
+    }
+    else if (transposeA && !transposeB)
+    {
+        // c(h, j) += alpha * sum_p lhs(i_p, h) * val_p, a sparse dot product with column h of lhs
+        const size_t cRows = lhs.GetNumCols();
+#pragma omp parallel for
+        for (long j = 0; j < (long) rhs.GetNumCols(); j++)
         {
-            size_t start = rhs.m_compIndex[j];
-            size_t end = rhs.m_compIndex[j + 1];
+            ElemType* cj = cData + j * cRows;
+            const size_t start = rhs.m_compIndex[j];
+            const size_t end = rhs.m_compIndex[j + 1];
+            for (size_t h = 0; h < cRows; h++)
+            {
+                const ElemType* lh = lhsData + h * lhsRows;
+                ElemType sum = 0;
+                for (size_t p = start; p < end; p++)
+                    sum += lh[rhs.m_unCompIndex[p]] * rhs.m_pArray[p];
+                cj[h] += alpha * sum;
+            }
+        }
+    }
+    else
+    {
+        NOT_IMPLEMENTED;
+    }
+}
 
-            for (size_t p = start; p < end; p++)
+// c(:, j) += alpha * lhs * op(rhs)(:, j) for a BSR lhs [m x k], where op(rhs)(q, j) is at rhs[q * rhsStride + j * rhsColStride]
+// Each thread computes whole block rows, accumulating the rows of one block row for one column at a time.
+// BlockDim is the block dimension, or 0 for a block dimension known only at runtime; with a fixed one the
+// loop over the rows of a block column has a constant trip count and is unrolled and vectorized.
+template <class ElemType, size_t BlockDim>
+static void BSRTimesDenseAndAdd(ElemType alpha, const ElemType* values, const CPUSPARSE_INDEX_TYPE* blockRowStarts, const CPUSPARSE_INDEX_TYPE* blockCols,
+                                size_t runtimeBlockDim, size_t m, size_t k, const ElemType* rhs, size_t rhsStride, size_t rhsColStride, size_t n, ElemType* c)
+{
+    const size_t dim = BlockDim > 0 ? BlockDim : runtimeBlockDim;
+    const long numBlockRows = (long) ((m + dim - 1) / dim);
+#pragma omp parallel for
+    for (long bi = 0; bi < numBlockRows; bi++)
+    {
+        ElemType acc[CPUSparseMatrix<ElemType>::maxBSRBlockDim];
+        const size_t rowBegin = bi * dim;
+        const size_t rows = min(dim, m - rowBegin);
+        for (size_t j = 0; j < n; j++)
+        {
+            for (size_t r = 0; r < dim; r++)
+                acc[r] = 0;
+            for (size_t p = blockRowStarts[bi]; p < blockRowStarts[bi + 1]; p++)
             {
-                size_t i = rhs.m_unCompIndex[p];
-                ElemType val = rhs.m_pArray[p];
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
+                const ElemType* block = values + p * dim * dim;
+                const size_t colBegin = blockCols[p] * dim;
+                const size_t cols = min(dim, k - colBegin);
+                for (size_t q = 0; q < cols; q++)
                 {
-                    c(h, i) += alpha * lhs(h, j) * val;
+                    const ElemType x = rhs[(colBegin + q) * rhsStride + j * rhsColStride];
+                    const ElemType* blockCol = block + q * dim;
+                    for (size_t r = 0; r < dim; r++)
+                        acc[r] += blockCol[r] * x;
                 }
             }
+            ElemType* cj = c + j * m + rowBegin;
+            for (size_t r = 0; r < rows; r++)
+                cj[r] += alpha * acc[r];
         }
     }
-    else if (transposeA && !transposeB)
+}
+
+// c(:, j) += alpha * lhs^T * op(rhs)(:, j) for a BSR lhs [k x m], partitioned by the columns of c
+template <class ElemType>
+static void BSRTransposeTimesDenseAndAdd(ElemType alpha, const ElemType* values, const CPUSPARSE_INDEX_TYPE* blockRowStarts, const CPUSPARSE_INDEX_TYPE* blockCols,
+                                         size_t dim, size_t m, size_t k, const ElemType* rhs, size_t rhsStride, size_t rhsColStride, size_t n, ElemType* c)
+{
+    const size_t numBlockRows = (k + dim - 1) / dim;
+#pragma omp parallel for
+    for (long j = 0; j < (long) n; j++)
     {
+        ElemType* cj = c + j * m;
+        for (size_t bi = 0; bi < numBlockRows; bi++)
+        {
+            const size_t rowBegin = bi * dim;
+            const size_t rows = min(dim, k - rowBegin);
+            for (size_t p = blockRowStarts[bi]; p < blockRowStarts[bi + 1]; p++)
+            {
+                const ElemType* block = values + p * dim * dim;
+                const size_t colBegin = blockCols[p] * dim;
+                const size_t cols = min(dim, m - colBegin);
+                for (size_t q = 0; q < cols; q++)
+                {
+                    ElemType sum = 0;
+                    for (size_t r = 0; r < rows; r++)
+                        sum += block[q * dim + r] * rhs[(rowBegin + r) * rhsStride + j * rhsColStride];
+                    cj[colBegin + q] += alpha * sum;
+                }
+            }
+        }
+    }
+}
+
+// c = alpha * op(lhs) * op(rhs) + beta * c, with a CSC or BSR matrix lhs
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUSparseMatrix<ElemType>& lhs, const bool transposeA,
+                                                       const CPUMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c)
+{
+    if (lhs.IsEmpty() || rhs.IsEmpty())
+        LogicError("MultiplyAndWeightedAdd:  one of the input matrix is empty.");
+
+    if (lhs.GetFormat() != matrixFormatSparseCSC && lhs.GetFormat() != matrixFormatSparseBSR)
         NOT_IMPLEMENTED;
+
+    const size_t m = transposeA ? lhs.GetNumCols() : lhs.GetNumRows();
+    const size_t k = transposeA ? lhs.GetNumRows() : lhs.GetNumCols();
+    const size_t l = transposeB ? rhs.GetNumCols() : rhs.GetNumRows();
+    const size_t n = transposeB ? rhs.GetNumRows() : rhs.GetNumCols();
+    if (k != l)
+        InvalidArgument("CPUSparseMatrix::MultiplyAndWeightedAdd: The inner dimensions of a and b must match.");
+
+    if (beta == 0)
+    {
+        c.Resize(m, n);
+        memset(c.GetArray(), 0, sizeof(ElemType) * c.GetNumElements());
     }
     else
     {
-        NOT_IMPLEMENTED;
+        c.VerifySize(m, n); // Can't resize if beta != 0
+        if (beta != 1)
+            c *= beta;
+    }
+
+    // partitioned by output column; rhs(q, j) is at rhsData[q * rhsStride + j * rhsColStride]
+    const ElemType* rhsData = rhs.BufferPointer();
+    const size_t rhsStride = transposeB ? rhs.GetNumRows() : 1;
+    const size_t rhsColStride = transposeB ? 1 : rhs.GetNumRows();
+    ElemType* cData = c.GetArray();
+    if (lhs.GetFormat() == matrixFormatSparseBSR)
+    {
+        const size_t dim = lhs.m_bsrBlockDim;
+        const ElemType* values = lhs.m_pArray;
+        if (transposeA)
+            BSRTransposeTimesDenseAndAdd(alpha, values, lhs.m_compIndex, lhs.m_unCompIndex, dim, m, k, rhsData, rhsStride, rhsColStride, n, cData);
+        else if (dim == 4)
+            BSRTimesDenseAndAdd<ElemType, 4>(alpha, values, lhs.m_compIndex, lhs.m_unCompIndex, dim, m, k, rhsData, rhsStride, rhsColStride, n, cData);
+        else if (dim == 8)
+            BSRTimesDenseAndAdd<ElemType, 8>(alpha, values, lhs.m_compIndex, lhs.m_unCompIndex, dim, m, k, rhsData, rhsStride, rhsColStride, n, cData);
+        else if (dim == 16)
+            BSRTimesDenseAndAdd<ElemType, 16>(alpha, values, lhs.m_compIndex, lhs.m_unCompIndex, dim, m, k, rhsData, rhsStride, rhsColStride, n, cData);
+        else if (dim == 32)
+            BSRTimesDenseAndAdd<ElemType, 32>(alpha, values, lhs.m_compIndex, lhs.m_unCompIndex, dim, m, k, rhsData, rhsStride, rhsColStride, n, cData);
+        else
+            BSRTimesDenseAndAdd<ElemType, 0>(alpha, values, lhs.m_compIndex, lhs.m_unCompIndex, dim, m, k, rhsData, rhsStride, rhsColStride, n, cData);
+    }
+    else if (!transposeA)
+    {
+        // c(:, j) += alpha * sum_q lhs(:, q) * rhs(q, j): scatter the sparse columns of lhs into column j
+#pragma omp parallel for
+        for (long j = 0; j < (long) n; j++)
+        {
+            ElemType* cj = cData + j * m;
+            for (size_t q = 0; q < k; q++)
+            {
+                const ElemType v = alpha * rhsData[q * rhsStride + j * rhsColStride];
+                if (v == 0)
+                    continue;
+                for (size_t p = lhs.m_compIndex[q]; p < lhs.m_compIndex[q + 1]; p++)
+                    cj[lhs.m_unCompIndex[p]] += lhs.m_pArray[p] * v;
+            }
+        }
+    }
+    else
+    {
+        // c(q, j) += alpha * sum_p val_p * rhs(i_p, j), a sparse dot product of column q of lhs with column j of op(rhs)
+#pragma omp parallel for
+        for (long j = 0; j < (long) n; j++)
+        {
+            ElemType* cj = cData + j * m;
+            const ElemType* rj = rhsData + j * rhsColStride;
+            for (size_t q = 0; q < m; q++)
+            {
+                ElemType sum = 0;
+                for (size_t p = lhs.m_compIndex[q]; p < lhs.m_compIndex[q + 1]; p++)
+                    sum += lhs.m_pArray[p] * rj[lhs.m_unCompIndex[p] * rhsStride];
+                cj[q] += alpha * sum;
+            }
+        }
     }
 }
 
+// the nonzeros of a CSC matrix grouped by row: the positions in m_pArray of the nonzeros of row i are
+// nzOfRows[rowStarts[i]..rowStarts[i+1]), in column order; colOfNz[p - m_compIndex[0]] is the column of the nonzero at position p
+// (m_compIndex[0] is not 0 for a column slice)
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::GetNonZerosByRow(std::vector<size_t>& rowStarts, std::vector<size_t>& nzOfRows, std::vector<size_t>& colOfNz) const
+{
+    if (this->GetFormat() != matrixFormatSparseCSC)
+        NOT_IMPLEMENTED;
+
+    const size_t numRows = GetNumRows();
+    const size_t firstNz = m_compIndex[0];
+    const size_t endNz = m_compIndex[GetNumCols()];
+    rowStarts.assign(numRows + 1, 0);
+    colOfNz.resize(endNz - firstNz);
+    for (size_t j = 0; j < GetNumCols(); j++)
+        for (size_t p = m_compIndex[j]; p < m_compIndex[j + 1]; p++)
+        {
+            colOfNz[p - firstNz] = j;
+            rowStarts[m_unCompIndex[p] + 1]++;
+        }
+    for (size_t i = 0; i < numRows; i++)
+        rowStarts[i + 1] += rowStarts[i];
+
+    // counting sort; visiting the nonzeros in column order keeps them in column order within a row
+    nzOfRows.resize(endNz - firstNz);
+    std::vector<size_t> next(rowStarts.begin(), rowStarts.end() - 1);
+    for (size_t p = firstNz; p < endNz; p++)
+        nzOfRows[next[m_unCompIndex[p]]++] = p;
+}
+
 //c = alpha * op(lhs) * op(rhs)
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
@@ -749,42 +1164,36 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
         c.SetFormat(matrixFormatSparseBlockCol);
         c.Resize(m, n, m * min(n, rhs.m_nz), true, false);
 
-        map<size_t, size_t> w2Id;
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
-        { // j ranges over batches
-            size_t start = rhs.m_compIndex[j];
-            size_t end = rhs.m_compIndex[j + 1];
-
-            for (size_t p = start; p < end; p++)
+        // one block per nonzero row i of rhs (i ranges over words), in the order of their first occurrence;
+        // the ids are assigned serially, then the blocks are computed in parallel
+        std::vector<size_t> rowStarts, nzOfRows, colOfNz;
+        rhs.GetNonZerosByRow(rowStarts, nzOfRows, colOfNz);
+        std::vector<bool> seen(rhs.GetNumRows(), false);
+        for (size_t p = rhs.m_compIndex[0]; p < rhs.m_compIndex[rhs.GetNumCols()]; p++)
+        {
+            const size_t i = rhs.m_unCompIndex[p];
+            if (!seen[i])
             {
-                size_t i = rhs.m_unCompIndex[p]; // i ranges over words
-                ElemType val = rhs.m_pArray[p];  // 1 for(i, j)
+                seen[i] = true;
+                c.m_blockIds[c.m_blockSize++] = i;
+            }
+        }
 
-                bool first = true;
-                if (w2Id.find(i) == w2Id.end())
-                {
-                    size_t id = w2Id.size();
-                    w2Id[i] = id;
-                    c.m_blockIds[c.m_blockSize] = i;
-                    c.m_blockSize++;
-                }
-                else
-                {
-                    first = false;
-                }
-                size_t pos = w2Id[i] * lhs.GetNumRows();
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                { // h range over hidden layer
-                    if (first == true)
-                    {
-                        c.m_pArray[pos] = alpha * lhs(h, j) * val;
-                    }
-                    else
-                    {
-                        c.m_pArray[pos] += alpha * lhs(h, j) * val;
-                    }
-                    pos++;
-                }
+        const size_t lhsRows = lhs.GetNumRows();
+        const ElemType* lhsData = lhs.BufferPointer();
+#pragma omp parallel for
+        for (long id = 0; id < (long) c.m_blockSize; id++)
+        {
+            const size_t i = c.m_blockIds[id];
+            ElemType* block = c.m_pArray + id * lhsRows;
+            memset(block, 0, sizeof(ElemType) * lhsRows);
+            for (size_t q = rowStarts[i]; q < rowStarts[i + 1]; q++) // j ranges over batches
+            {
+                const size_t p = nzOfRows[q];
+                const ElemType* lj = lhsData + colOfNz[p - rhs.m_compIndex[0]] * lhsRows;
+                const ElemType val = alpha * rhs.m_pArray[p]; // 1 for(i, j)
+                for (size_t h = 0; h < lhsRows; h++)          // h range over hidden layer
+                    block[h] += lj[h] * val;
             }
         }
         c.m_nz = c.m_blockSize * m;
@@ -983,6 +1392,158 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
         return 1;
 }
 
+// The row-sparse (lazy) updates below only touch the columns present in a block-column gradient (e.g. the words of an embedding
+// seen in the minibatch). The smoothed state of the other columns is brought up to date when they are next touched, as if they
+// had received zero gradients in between (with the current hyper-parameters). For that, the smoothed-gradient matrix c has,
+// after the per-element state, one entry per column with the step it was last updated at, followed by the current step.
+// (Steps are stored as ElemType, so for float they are exact for 2^24 minibatches.)
+static size_t NumColsForStepCounters(size_t numRows, size_t numCols)
+{
+    return (numCols + 1 + numRows - 1) / numRows;
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues,
+                                          ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul)
+{
+    if (m_format != MatrixFormat::matrixFormatSparseBlockCol)
+        RuntimeError("CPUSparseMatrix::FSAdagrad() only supports SparseBlockCol format.");
+
+    const size_t numRows = GetNumRows();
+    const size_t n = this->GetNumElements();
+    size_t numColsNeeded = 2 * GetNumCols() + NumColsForStepCounters(numRows, GetNumCols());
+    if (c.IsEmpty() || c.GetNumCols() != numColsNeeded)
+    {
+        c.Resize(numRows, numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    ElemType* smoothAda = c.BufferPointer();
+    ElemType* smoothMom = smoothAda + n;
+    ElemType* lastSteps = smoothAda + 2 * n;
+    ElemType& step = lastSteps[GetNumCols()];
+    ElemType* val = functionValues.BufferPointer();
+    step++;
+
+    for (long j = 0; j < m_blockSize; j++)
+    {
+        size_t col = m_blockIds[j] - m_blockIdShift;
+
+        // catch up on the steps without gradient: the squares decay, and the momentum keeps moving the parameters
+        double numSkipped = lastSteps[col] > 0 ? step - lastSteps[col] - 1 : 0;
+        ElemType adaDecay = (ElemType) pow((double) adaWeight, numSkipped);
+        ElemType momDecay = (ElemType) pow((double) momentum, numSkipped);
+        ElemType momSum = momentum > 0 ? (momentum < 1 ? momentum * (1 - momDecay) / (1 - momentum) : (ElemType) numSkipped) : 0;
+        lastSteps[col] = step;
+
+        for (size_t i = 0; i < numRows; i++)
+        {
+            size_t index = col * numRows + i;
+            if (numSkipped > 0)
+            {
+                val[index] -= learnRatePerSample * momSum * smoothMom[index];
+                smoothMom[index] *= momDecay;
+                smoothAda[index] *= adaDecay;
+            }
+
+            ElemType g = m_pArray[j * numRows + i];
+            ElemType adaSqr = adaWeight * smoothAda[index] + (1.0f - adaWeight) * g * g;
+            smoothAda[index] = adaSqr;
+            if (adaSqr != 0.0f)
+            {
+                ElemType w = adaMul * ((ElemType) 1.0 / sqrt(adaSqr));
+                if (w > 10.0f)
+                    w = 10.0f;
+                g *= w;
+            }
+
+            if (momentum > 0.0f)
+            {
+                g = momentum * smoothMom[index] + (1.0f - momentum) * g;
+                smoothMom[index] = g;
+            }
+
+            val[index] -= learnRatePerSample * g;
+        }
+    }
+}
+
+template <class ElemType>
+ElemType CPUSparseMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX,
+                                            ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier)
+{
+    if (m_format != MatrixFormat::matrixFormatSparseBlockCol)
+        RuntimeError("CPUSparseMatrix::RmsProp() only supports SparseBlockCol format.");
+
+    const ElemType floor = 1e-6f;
+    const size_t numRows = GetNumRows();
+    const size_t n = this->GetNumElements();
+    size_t numColsNeeded = 3 * GetNumCols() + NumColsForStepCounters(numRows, GetNumCols());
+    if (c.IsEmpty() || c.GetNumCols() != numColsNeeded)
+    {
+        c.Resize(numRows, numColsNeeded);
+        c.SetValue(0.0);
+        ElemType* steps = c.BufferPointer() + 2 * n;
+        for (size_t i = 0; i < n; i++)
+            steps[i] = ElemType(0.02);
+    }
+
+    ElemType* avars = c.BufferPointer(); // accumulated variances for RMS scaling
+    ElemType* signs = avars + n;         // sign of previous gradient
+    ElemType* steps = avars + 2 * n;     // current step size
+    ElemType* lastSteps = avars + 3 * n;
+    ElemType& step = lastSteps[GetNumCols()];
+    step++;
+
+    ElemType ONE_MINUS_GAMMA = ElemType(1.0) - RMS_GAMMA;
+    ElemType aveMultiplier = 0;
+    for (long j = 0; j < m_blockSize; j++)
+    {
+        size_t col = m_blockIds[j] - m_blockIdShift;
+
+        // catch up on the steps without gradient: the variances decay, and a zero gradient decreases the step size
+        const bool isFirst = lastSteps[col] == 0;
+        double numSkipped = isFirst ? 0 : step - lastSteps[col] - 1;
+        ElemType varDecay = (ElemType) pow((double) RMS_GAMMA, numSkipped);
+        ElemType stepDecay = (ElemType) pow((double) RMS_WGT_DEC, numSkipped);
+        lastSteps[col] = step;
+
+        for (size_t i = 0; i < numRows; i++)
+        {
+            size_t index = col * numRows + i;
+            ElemType& g = m_pArray[j * numRows + i];
+            if (isFirst) // (as in the dense version, the variance starts at the first gradient)
+                avars[index] = g * g;
+            else if (numSkipped > 0)
+            {
+                avars[index] *= varDecay;
+                steps[index] = max(steps[index] * stepDecay, RMS_WGT_MIN);
+                signs[index] = 0;
+            }
+
+            avars[index] = RMS_GAMMA * avars[index] + ONE_MINUS_GAMMA * (g * g);
+            const int grad_sign = (ElemType(0) < g) - (g < ElemType(0));
+
+            if (signs[index] * grad_sign > 0)
+                steps[index] = min(steps[index] * RMS_WGT_INC, RMS_WGT_MAX);
+            else
+                steps[index] = max(steps[index] * RMS_WGT_DEC, RMS_WGT_MIN);
+
+            ElemType a = steps[index] / sqrt(avars[index] + floor);
+            g *= a;
+            signs[index] = (ElemType) grad_sign;
+
+            if (needAveMultiplier)
+                aveMultiplier += a;
+        }
+    }
+
+    if (needAveMultiplier && m_nz > 0)
+        return aveMultiplier / m_nz;
+    else
+        return 1;
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateTop(const ElemType threshold)
 {
@@ -76,6 +76,8 @@ public:
 
     CPUSparseMatrix<ElemType> ColumnSlice(size_t startColumn, size_t numCols) const;
     CPUMatrix<ElemType> CopyColumnSliceToDense(size_t startColumn, size_t numCols) const;
+    // see Matrix::AssignOneHotIndicesOf()
+    void CopyOneHotIndicesTo(CPUMatrix<ElemType>& indices) const;
 
     CPUMatrix<ElemType> DiagonalToDense() const;
 
@@ -86,9 +88,34 @@ public:
 
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
                                 const size_t nz, const size_t numRows, const size_t numCols);
+    void SetMatrixFromCOOFormat(const CPUSPARSE_INDEX_TYPE* h_Col, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                const size_t nz, const size_t numRows, const size_t numCols);
+
+    void GetSparseBlockColData(std::vector<size_t>& columnIds, std::vector<ElemType>& values) const;
+    void GetSparseCSCData(std::vector<CPUSPARSE_INDEX_TYPE>& colStarts, std::vector<CPUSPARSE_INDEX_TYPE>& rowIndices, std::vector<ElemType>& values) const;
+    void SetSparseBlockColData(const size_t numRows, const size_t numCols, const std::vector<size_t>& columnIds, const std::vector<ElemType>& values);
+
+    // block-sparse row format (matrixFormatSparseBSR): square blocks of GetBSRBlockDim() (at most maxBSRBlockDim), each stored
+    // column-major, one after the other. The compressed index holds the first block of each block row (ceil(rows / blockDim) + 1 entries),
+    // the uncompressed index the block column of each block. Blocks at the bottom and right edges are padded with zeros.
+    void SetMatrixFromBSRFormat(const CPUSPARSE_INDEX_TYPE* h_blockRowStarts, const CPUSPARSE_INDEX_TYPE* h_blockCols, const ElemType* h_blockValues,
+                                const size_t numBlocks, const size_t blockDim, const size_t numRows, const size_t numCols);
+    // from a column-major dense matrix, keeping the blocks that have a non-zero element
+    void SetBSRFromDense(const ElemType* dense, const size_t numRows, const size_t numCols, const size_t blockDim);
+    size_t GetBSRBlockDim() const
+    {
+        return m_bsrBlockDim;
+    }
+    size_t GetNumBSRBlocks() const
+    {
+        return m_bsrBlockDim > 0 ? m_nz / (m_bsrBlockDim * m_bsrBlockDim) : 0;
+    }
+    static const size_t maxBSRBlockDim = 32;
 
     static void MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                        const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c);
+    static void MultiplyAndWeightedAdd(ElemType alpha, const CPUSparseMatrix<ElemType>& lhs, const bool transposeA,
+                                       const CPUMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c); // lhs CSC or BSR
 
     static void MultiplyAndAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, CPUSparseMatrix<ElemType>& c);
@@ -153,6 +180,8 @@ public:
 public:
     void NormalGrad(CPUMatrix<ElemType>& c, const ElemType momentum);
     ElemType Adagrad(CPUMatrix<ElemType>& c, const bool needAveMultiplier);
+    void FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
+    ElemType RmsProp(CPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
 
 public:
     CPUSparseMatrix<ElemType>& InplaceTruncateTop(const ElemType threshold);
@@ -190,7 +219,7 @@ public:
     } // this is the major index, row/col ids in CSC/CSR format
     size_t MajorIndexCount() const
     {
-        return m_nz;
+        return m_format == matrixFormatSparseBSR ? GetNumBSRBlocks() : m_nz;
     }
     size_t MajorIndexSize() const
     {
@@ -203,7 +232,9 @@ public:
     } // this is the compressed index, col/row in CSC/CSR format
     size_t SecondaryIndexCount() const
     {
-        if (m_format & matrixFormatCompressed)
+        if (m_format == matrixFormatSparseBSR)
+            return m_numRows > 0 && m_bsrBlockDim > 0 ? (m_numRows + m_bsrBlockDim - 1) / m_bsrBlockDim + 1 : 0;
+        else if (m_format & matrixFormatCompressed)
         {
             size_t cnt = (m_format & matrixFormatRowMajor) ? m_numRows : m_numCols;
             if (cnt > 0)
@@ -237,6 +268,10 @@ public:
         return (m_format & matrixFormatRowMajor) ? MajorIndexSize() : SecondaryIndexSize();
     } // actual number of bytes in use
 
+private:
+    CPUMatrix<ElemType> CopyBSRColumnSliceToDense(size_t startColumn, size_t numCols) const;
+    void GetNonZerosByRow(std::vector<size_t>& rowStarts, std::vector<size_t>& nzOfRows, std::vector<size_t>& colOfNz) const;
+
 private:
     int m_colIdx; // used to SetValue()
     size_t m_compIndexSize;
@@ -249,6 +284,8 @@ private:
     size_t m_blockSize;    // block size
     size_t* m_blockIds;    // block ids
     size_t m_blockIdShift; // used to get efficient slice, actual col = blockIds[j] - m_blockIdShift
+
+    size_t m_bsrBlockDim; // block dimension in BSR format
 };
 
 typedef CPUSparseMatrix<float> CPUSingleSparseMatrix;
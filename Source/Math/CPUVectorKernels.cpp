@@ -0,0 +1,294 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernels.cpp -- AVX2 kernels for elementwise ops, used if the host supports them (see CPUVectorKernels.h)
+//
+
+#include "stdafx.h"
+#include "CPUVectorKernels.h"
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HAS_AVX2_KERNELS
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h> // for __cpuid()
+#endif
+#endif
+
+// The kernels get compiled for AVX2 and FMA regardless of the flags the rest of the code is built with. Visual C++
+// accepts the intrinsics anywhere; gcc and clang need to be told per function.
+#ifdef _MSC_VER
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef HAS_AVX2_KERNELS
+
+static bool DetectAVX2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0; // OS saves the YMM registers on context switches...
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6) // ...and has enabled them
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+bool CPUHasAVX2()
+{
+    static const bool hasAVX2 = DetectAVX2();
+    return hasAVX2;
+}
+
+// -----------------------------------------------------------------------
+// functions on 8 floats
+// -----------------------------------------------------------------------
+
+// exp(x) as 2^n * exp(r) with r = x - n * log(2) in [-log(2)/2, log(2)/2]
+AVX2_TARGET static inline __m256 Exp8(__m256 x)
+{
+    const __m256 isNaN = _mm256_cmp_ps(x, x, _CMP_UNORD_Q);
+    const __m256 overflows = _mm256_cmp_ps(x, _mm256_set1_ps(88.7228391f), _CMP_GT_OQ);
+    __m256 r = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-104.0f)), _mm256_set1_ps(88.7228391f)); // (below -104, exp(x) is 0 in float)
+    const __m256 n = _mm256_round_ps(_mm256_mul_ps(r, _mm256_set1_ps(1.44269504088896341f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), r); // log(2) in two parts, for precision
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+    __m256 y = _mm256_set1_ps(1.9875691500e-4f);
+    y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(1.3981999507e-3f));
+    y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(8.3334519073e-3f));
+    y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(4.1665795894e-2f));
+    y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(1.6666665459e-1f));
+    y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(5.0000001201e-1f));
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+    // 2^n as 2^n1 * 2^n2 by constructing the exponent bits, since n itself may be out of range (-150..128)
+    const __m256i n1 = _mm256_srai_epi32(_mm256_cvtps_epi32(n), 1);
+    const __m256i n2 = _mm256_sub_epi32(_mm256_cvtps_epi32(n), n1);
+    y = _mm256_mul_ps(y, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n1, _mm256_set1_epi32(127)), 23)));
+    y = _mm256_mul_ps(y, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n2, _mm256_set1_epi32(127)), 23)));
+    y = _mm256_blendv_ps(y, _mm256_set1_ps(INFINITY), overflows);
+    return _mm256_blendv_ps(y, x, isNaN);
+}
+
+// log(x) for positive normalized x, as log(m) + e * log(2) with m in [sqrt(1/2), sqrt(2))
+AVX2_TARGET static inline __m256 LogOfNormalized8(__m256 x)
+{
+    const __m256i bits = _mm256_castps_si256(x);
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f000000))); // in [0.5, 1)
+    const __m256 isSmall = _mm256_cmp_ps(m, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OQ);
+    e = _mm256_sub_ps(e, _mm256_and_ps(_mm256_set1_ps(1.0f), isSmall));
+    m = _mm256_add_ps(_mm256_sub_ps(m, _mm256_set1_ps(1.0f)), _mm256_and_ps(m, isSmall)); // m - 1, or 2m - 1
+    const __m256 z = _mm256_mul_ps(m, m);
+    __m256 y = _mm256_set1_ps(7.0376836292e-2f);
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.1514610310e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(1.1676998740e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.2420140846e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(1.4249322787e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.6668057665e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(2.0000714765e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-2.4999993993e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(3.3333331174e-1f));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+    y = _mm256_fmadd_ps(e, _mm256_set1_ps(-2.12194440e-4f), y);
+    y = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), y);
+    return _mm256_fmadd_ps(e, _mm256_set1_ps(0.693359375f), _mm256_add_ps(m, y));
+}
+
+// same as ClippedLog() in TensorOps.h
+AVX2_TARGET static inline __m256 ClippedLog8(__m256 x)
+{
+    const __m256 isClipped = _mm256_cmp_ps(x, _mm256_set1_ps(EPS_IN_LOG), _CMP_LT_OQ);
+    const __m256 isSpecial = _mm256_cmp_ps(x, _mm256_set1_ps(FLT_MAX), _CMP_NLE_UQ); // +INF or NaN: log(x) = x
+    __m256 y = LogOfNormalized8(_mm256_max_ps(x, _mm256_set1_ps(EPS_IN_LOG)));
+    y = _mm256_blendv_ps(y, _mm256_set1_ps(LOG_OF_EPS_IN_LOG), isClipped);
+    return _mm256_blendv_ps(y, x, isSpecial);
+}
+
+// same formula as Sigmoid() in TensorOps.h
+AVX2_TARGET static inline __m256 Sigmoid8(__m256 x)
+{
+    const __m256 e = Exp8(_mm256_sub_ps(_mm256_setzero_ps(), x));
+    return _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_add_ps(e, _mm256_set1_ps(1.0f)));
+}
+
+// tanh(x) as a polynomial for |x| < 0.625, and as 1 - 2 / (exp(2|x|) + 1) with the sign of x beyond
+AVX2_TARGET static inline __m256 Tanh8(__m256 x)
+{
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    const __m256 absX = _mm256_andnot_ps(signBit, x);
+    const __m256 e = Exp8(_mm256_add_ps(absX, absX));
+    __m256 large = _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_div_ps(_mm256_set1_ps(2.0f), _mm256_add_ps(e, _mm256_set1_ps(1.0f))));
+    large = _mm256_or_ps(large, _mm256_and_ps(signBit, x));
+    const __m256 z = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps(-5.70498872745e-3f);
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(2.06390887954e-2f));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(-5.37397155531e-2f));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(1.33314422036e-1f));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(-3.33332819422e-1f));
+    const __m256 small = _mm256_fmadd_ps(_mm256_mul_ps(x, z), p, x);
+    return _mm256_blendv_ps(large, small, _mm256_cmp_ps(absX, _mm256_set1_ps(0.625f), _CMP_LT_OQ));
+}
+
+#define DefUnaryVectorFunctor(op, expr)                      \
+    struct Vector##op                                        \
+    {                                                        \
+        AVX2_TARGET static inline __m256 Compute(__m256 a)   \
+        {                                                    \
+            return expr;                                     \
+        }                                                    \
+    };
+#define DefBinaryVectorFunctor(op, expr)                             \
+    struct Vector##op                                                \
+    {                                                                \
+        AVX2_TARGET static inline __m256 Compute(__m256 a, __m256 b) \
+        {                                                            \
+            return expr;                                             \
+        }                                                            \
+    };
+
+DefUnaryVectorFunctor(Copy, a);
+DefUnaryVectorFunctor(Exp, Exp8(a));
+DefUnaryVectorFunctor(Log, ClippedLog8(a));
+DefUnaryVectorFunctor(Sigmoid, Sigmoid8(a));
+DefUnaryVectorFunctor(Tanh, Tanh8(a));
+DefUnaryVectorFunctor(LinearRectifier, _mm256_and_ps(a, _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ)));
+DefBinaryVectorFunctor(Sum, _mm256_add_ps(a, b));
+DefBinaryVectorFunctor(Difference, _mm256_sub_ps(a, b));
+DefBinaryVectorFunctor(ElementwiseProduct, _mm256_mul_ps(a, b));
+
+// -----------------------------------------------------------------------
+// loops
+// The last n % 8 elements go through a padded copy, so that they get the same results as the others.
+// -----------------------------------------------------------------------
+
+static const size_t minParallelElements = 16384; // below this, threading costs more than it saves
+
+AVX2_TARGET static inline void Store8(float* pc, __m256 val, float beta, __m256 vAlpha, __m256 vBeta)
+{
+    val = _mm256_mul_ps(val, vAlpha);
+    if (beta != 0)
+        val = _mm256_fmadd_ps(vBeta, _mm256_loadu_ps(pc), val);
+    _mm256_storeu_ps(pc, val);
+}
+
+template <class FN>
+AVX2_TARGET static void UnaryLoop(float beta, const float* pa, float* pc, float alpha, size_t n)
+{
+    const __m256 vAlpha = _mm256_set1_ps(alpha), vBeta = _mm256_set1_ps(beta);
+    const long numBlocks = (long) (n / 8);
+#pragma omp parallel for if (n >= minParallelElements)
+    for (long k = 0; k < numBlocks; k++)
+        Store8(pc + 8 * k, FN::Compute(_mm256_loadu_ps(pa + 8 * k)), beta, vAlpha, vBeta);
+    const size_t rest = n % 8;
+    if (rest > 0)
+    {
+        float a[8] = {0}, c[8] = {0};
+        memcpy(a, pa + n - rest, rest * sizeof(float));
+        memcpy(c, pc + n - rest, rest * sizeof(float));
+        Store8(c, FN::Compute(_mm256_loadu_ps(a)), beta, vAlpha, vBeta);
+        memcpy(pc + n - rest, c, rest * sizeof(float));
+    }
+}
+
+template <class FN>
+AVX2_TARGET static void BinaryLoop(float beta, const float* pa, const float* pb, float* pc, float alpha, size_t n)
+{
+    const __m256 vAlpha = _mm256_set1_ps(alpha), vBeta = _mm256_set1_ps(beta);
+    const long numBlocks = (long) (n / 8);
+#pragma omp parallel for if (n >= minParallelElements)
+    for (long k = 0; k < numBlocks; k++)
+        Store8(pc + 8 * k, FN::Compute(_mm256_loadu_ps(pa + 8 * k), _mm256_loadu_ps(pb + 8 * k)), beta, vAlpha, vBeta);
+    const size_t rest = n % 8;
+    if (rest > 0)
+    {
+        float a[8] = {0}, b[8] = {0}, c[8] = {0};
+        memcpy(a, pa + n - rest, rest * sizeof(float));
+        memcpy(b, pb + n - rest, rest * sizeof(float));
+        memcpy(c, pc + n - rest, rest * sizeof(float));
+        Store8(c, FN::Compute(_mm256_loadu_ps(a), _mm256_loadu_ps(b)), beta, vAlpha, vBeta);
+        memcpy(pc + n - rest, c, rest * sizeof(float));
+    }
+}
+
+// -----------------------------------------------------------------------
+// entry points: map op to a functor
+// -----------------------------------------------------------------------
+
+#define CaseUnaryVectorOp(oper)                                    \
+    case ElementWiseOperator::op##oper:                            \
+        UnaryLoop<Vector##oper>(beta, a, c, alpha, n);             \
+        return true
+
+#define CaseBinaryVectorOp(oper)                                   \
+    case ElementWiseOperator::op##oper:                            \
+        BinaryLoop<Vector##oper>(beta, a, b, c, alpha, n);         \
+        return true
+
+bool VectorizedUnaryOp(ElementWiseOperator op, float beta, const float* a, float* c, float alpha, size_t n)
+{
+    if (!CPUHasAVX2())
+        return false;
+    switch (op)
+    {
+        CaseUnaryVectorOp(Copy);
+        CaseUnaryVectorOp(Exp);
+        CaseUnaryVectorOp(Log);
+        CaseUnaryVectorOp(Sigmoid);
+        CaseUnaryVectorOp(Tanh);
+        CaseUnaryVectorOp(LinearRectifier);
+    default:
+        return false;
+    }
+}
+
+bool VectorizedBinaryOp(ElementWiseOperator op, float beta, const float* a, const float* b, float* c, float alpha, size_t n)
+{
+    if (!CPUHasAVX2())
+        return false;
+    switch (op)
+    {
+        CaseBinaryVectorOp(Sum);
+        CaseBinaryVectorOp(Difference);
+        CaseBinaryVectorOp(ElementwiseProduct);
+    default:
+        return false;
+    }
+}
+
+#else // no x86: no kernels
+
+bool CPUHasAVX2()
+{
+    return false;
+}
+
+bool VectorizedUnaryOp(ElementWiseOperator, float, const float*, float*, float, size_t)
+{
+    return false;
+}
+
+bool VectorizedBinaryOp(ElementWiseOperator, float, const float*, const float*, float*, float, size_t)
+{
+    return false;
+}
+
+#endif
+} } }
@@ -0,0 +1,38 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernels.h -- vectorized elementwise kernels for CPUMatrix, with the instruction set picked at runtime
+//
+#pragma once
+
+#include "CommonMatrix.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// Elementwise float ops over n consecutive elements: c = beta * c + alpha * op(a [, b]) (if beta == 0, c is not read)
+//
+// The kernels use AVX2 and FMA if the host has them, which is determined once at runtime, so that binaries built
+// for the baseline instruction set (-msse3) still use them. Exp, log, tanh, and the sigmoid are polynomial
+// approximations accurate to a few ulp (the Cephes single-precision ones), with the same treatment of
+// overflow, NaN, and of the clipping in ClippedLog() as the scalar ops in TensorOps.h.
+// They return false if there is no vectorized kernel for 'op' or for this host; the caller then uses its
+// scalar loop. c may be the same as a or b, but must not overlap them otherwise.
+// -----------------------------------------------------------------------
+
+bool CPUHasAVX2(); // AVX2 and FMA, supported by CPU and OS
+
+bool VectorizedUnaryOp(ElementWiseOperator op, float beta, const float* a, float* c, float alpha, size_t n);
+bool VectorizedBinaryOp(ElementWiseOperator op, float beta, const float* a, const float* b, float* c, float alpha, size_t n);
+
+// (no double kernels; double stays with the scalar loops)
+inline bool VectorizedUnaryOp(ElementWiseOperator, double, const double*, double*, double, size_t)
+{
+    return false;
+}
+inline bool VectorizedBinaryOp(ElementWiseOperator, double, const double*, const double*, double*, double, size_t)
+{
+    return false;
+}
+} } }
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "CUDAPageLockedMemAllocator.h"
+#include "HugePageMemAllocator.h"
 #include "BestGpu.h" // for CPUONLY
 #ifndef CPUONLY
 #include <cuda_runtime_api.h>
@@ -13,11 +14,21 @@ CUDAPageLockedMemAllocator::CUDAPageLockedMemAllocator(int deviceID)
 {
 }
 
+// Large buffers are taken from HugePageMemAllocator if it is enabled, and page-locked by registering them with CUDA.
 void* CUDAPageLockedMemAllocator::Malloc(size_t size, int deviceId)
 {
     void* p;
     cudaSetDevice(deviceId);
 
+    if (HugePageMemAllocator::IsUsedFor(size))
+    {
+        p = HugePageMemAllocator::Allocate(size);
+        if (cudaHostRegister(p, size, cudaHostRegisterDefault) == cudaSuccess)
+            return p;
+        cudaGetLastError(); // (clear it; fall back to cudaHostAlloc())
+        HugePageMemAllocator::Deallocate(p);
+    }
+
     // Note: I ask for cudaHostAllocDefault but cudaHostGetFlags() shows that it is allocated as 'cudaHostAllocMapped'
     cudaHostAlloc(&p, size, cudaHostAllocDefault) || "Malloc in CUDAPageLockedMemAllocator failed";
 
@@ -27,6 +38,12 @@ void* CUDAPageLockedMemAllocator::Malloc(size_t size, int deviceId)
 void CUDAPageLockedMemAllocator::Free(void* p, int deviceId)
 {
     cudaSetDevice(deviceId);
+    if (HugePageMemAllocator::Owns(p))
+    {
+        cudaHostUnregister(p) || "Free in CUDAPageLockedMemAllocator failed";
+        HugePageMemAllocator::Deallocate(p);
+        return;
+    }
     cudaFreeHost(p) || "Free in CUDAPageLockedMemAllocator failed";
 }
 
@@ -16,7 +16,9 @@
 
 #include "Basics.h"
 #include <string>
+#include <string.h>
 #include <stdint.h>
+#include <algorithm>
 
 #define DEVICEID_TYPE int
 // and the following magic values
@@ -40,6 +42,12 @@ MATH_API DEVICEID_TYPE EnforceOneGPUOnly(DEVICEID_TYPE requestedDeviceId);
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Random fills (SetUniformRandomValue() etc.) compute each element from its index and the seed with the counter-based
+// generator in TensorOps.h, so that the values do not depend on the number of threads, and on the device only up to
+// floating-point rounding (masks are identical). Each seed is a stream of its own (nodes pass their own seeds).
+// This maps USE_TIME_BASED_SEED to a new stream at every call.
+MATH_API unsigned long long ResolveRandomSeed(unsigned long seed);
+
 class MATH_API TracingGPUMemoryAllocator
 {
 private:
@@ -58,13 +66,170 @@ public:
     template <typename AllocatedElemType>
     static void Free(int deviceId, AllocatedElemType* bufferPtr, bool ignoreCUDARetCode = false);
 
+    // caching: freed device buffers are kept in per-device size buckets and handed back to later
+    // requests of the same bucket without a cudaMalloc/cudaFree (which synchronize the device)
+    static void SetCachingEnabled(bool enabled);
+    static bool IsCachingEnabled();
+    static void ReleaseCachedMemory(int deviceId);   // return all cached buffers of a device to the driver
+    static void PrintMemoryStatistics(int deviceId); // peak, in-use, cached and fragmented bytes
+    static void GetMemoryStatistics(int deviceId, size_t& inUseBytes, size_t& cachedBytes); // of the cache; 0 if it is off
+
 private:
+    static bool m_cachingEnabled;
+
     template <typename AllocatedElemType>
     static AllocatedElemType* AllocateNoTrace(int deviceId, size_t numElements);
 
     static std::pair<size_t, size_t> GetFreeAndTotalMemoryInMBs(int deviceId);
 };
 
+// -----------------------------------------------------------------------
+// GPUKernelTuning -- switch for the tuner of GPU kernel launch configurations
+// When enabled, kernels that offer several launch configurations (thread-block size, block- vs. warp-per-column
+// variant) time them on their first launch per device architecture and shape class and keep the fastest; see
+// KernelLaunchTuner in GPUMatrix.cu. Off, they use their default configuration. Tracing prints each choice.
+// -----------------------------------------------------------------------
+
+class MATH_API GPUKernelTuning
+{
+public:
+    static void SetEnabled(bool enabled, int traceLevel = 0);
+    static bool IsEnabled();
+    static int GetTraceLevel();
+
+private:
+    static bool m_enabled;
+    static int m_traceLevel;
+};
+
+// -----------------------------------------------------------------------
+// DeviceMemoryAccounting -- device memory in use and its peak, per subsystem that asked for it.
+// Every buffer TracingGPUMemoryAllocator hands out is counted under the MemoryTag that is current for the
+// allocating thread when it is allocated (see ScopedMemoryTag), and uncounted when it is freed. Sizes are those
+// requested, not of the cache buckets. PrintReport() prints current and peak bytes per tag; it is also printed
+// when a device allocation fails. All functions do nothing for CPU devices and in CPU-only builds.
+// -----------------------------------------------------------------------
+
+enum class MemoryTag
+{
+    Other,
+    NodeValue,
+    NodeGradient,
+    MatrixPool,     // temporaries of the nodes, and buffers shared through the matrix pool
+    OptimizerState, // smoothed gradients and other per-parameter state of the learner
+    Aggregator,     // buffers of the distributed gradient aggregation and model averaging
+    Reader,         // minibatch staging
+    Workspace,      // cuDNN workspace
+    Lattice,        // sequence training lattices
+    Count
+};
+
+class MATH_API DeviceMemoryAccounting
+{
+public:
+    static MemoryTag CurrentTag();
+    static void SetCurrentTag(MemoryTag tag);
+    static void OnAllocate(int deviceId, const void* bufferPtr, size_t bytes);
+    static void OnFree(int deviceId, const void* bufferPtr);
+    static void GetUsage(int deviceId, MemoryTag tag, size_t& currentBytes, size_t& peakBytes);
+    static void GetTotalUsage(int deviceId, size_t& currentBytes, size_t& peakBytes); // of all tags together
+    static void PrintReport(int deviceId);
+    static const char* TagName(MemoryTag tag);
+};
+
+// sets the tag of the calling thread's allocations for its lifetime
+class ScopedMemoryTag
+{
+public:
+    ScopedMemoryTag(MemoryTag tag)
+        : m_previousTag(DeviceMemoryAccounting::CurrentTag())
+    {
+        DeviceMemoryAccounting::SetCurrentTag(tag);
+    }
+    ~ScopedMemoryTag()
+    {
+        DeviceMemoryAccounting::SetCurrentTag(m_previousTag);
+    }
+
+private:
+    ScopedMemoryTag(const ScopedMemoryTag&) = delete;
+    void operator=(const ScopedMemoryTag&) = delete;
+    MemoryTag m_previousTag;
+};
+
+// -----------------------------------------------------------------------
+// ComputeStreams -- a small per-device pool of CUDA streams to overlap independent work.
+// Stream 0 is the default stream, which all GPU work goes to unless Select() picks another one
+// for the calling thread; kernels, cuBLAS and cuDNN calls then go to that stream. Events are
+// numbered by the caller: RecordEvent() marks the current point of the selected stream, and
+// WaitEvent() makes the selected stream wait for it. Join() makes all streams of the device wait
+// for each other, selects stream 0 again, and lets the allocator cache reuse buffers freed on
+// other streams (until then they are held back, since work on another stream may still use them).
+// All functions do nothing for CPU devices and in CPU-only builds.
+// -----------------------------------------------------------------------
+
+class MATH_API ComputeStreams
+{
+public:
+    static void Select(int deviceId, size_t stream);
+    static void RecordEvent(int deviceId, size_t event);
+    static void WaitEvent(int deviceId, size_t event);
+    static void Join(int deviceId);
+};
+
+// -----------------------------------------------------------------------
+// ComputeTimingEvents -- timing of GPU work with CUDA events, without synchronizing at every measurement.
+// Record() marks the current point of the selected stream (see ComputeStreams) under a caller-given index.
+// ElapsedMilliseconds() waits until 'toEvent' has completed and returns the GPU time from 'fromEvent' to it;
+// the events may have been recorded on different streams of the device. It returns -1 for CPU devices and in
+// CPU-only builds, where callers time on the host instead.
+// -----------------------------------------------------------------------
+
+class MATH_API ComputeTimingEvents
+{
+public:
+    static void Record(int deviceId, size_t event);
+    static float ElapsedMilliseconds(int deviceId, size_t fromEvent, size_t toEvent);
+};
+
+// -----------------------------------------------------------------------
+// ComputeGraphs -- capture of the GPU work of a sequence of calls into a CUDA graph, to replay it with one launch.
+// BeginCapture() makes the calling thread's GPU work go into a capture instead of running. EndCapture() selects the
+// default stream again and returns the executable graph, or nullptr if the capture failed, e.g. because something
+// synchronized with the host or used the default stream meanwhile; nothing of it has run then. Launch() runs a graph
+// on the default stream, in order with the work around it. A graph keeps the buffer addresses of its capture, so
+// it is only valid while GetAllocationCount() (device allocations and frees so far) is what it was at the capture.
+// CUDA graphs need CUDA 10; IsSupported() is false with older versions, for CPU devices and in CPU-only builds.
+// -----------------------------------------------------------------------
+
+class MATH_API ComputeGraphs
+{
+public:
+    static bool IsSupported(int deviceId);
+    static void BeginCapture(int deviceId);
+    static void* EndCapture(int deviceId);
+    static void Launch(int deviceId, void* graph);
+    static void Destroy(void* graph);
+    static size_t GetAllocationCount();
+};
+
+// -----------------------------------------------------------------------
+// ComputeTransfers -- copies between device memory and page-locked host memory that overlap with computation.
+// CopyToHost() and CopyToDevice() start a copy on a transfer stream of the device once the work issued so far on
+// the selected stream (see ComputeStreams) is done; later work on the selected stream does not wait for it.
+// WaitForTransfer() makes the selected stream wait until the copy started under the caller-given event index is
+// complete. The host memory must stay allocated, and neither side be reused, until then. All functions do nothing
+// for CPU devices and in CPU-only builds.
+// -----------------------------------------------------------------------
+
+class MATH_API ComputeTransfers
+{
+public:
+    static void CopyToHost(int deviceId, void* host, const void* device, size_t bytes, size_t event);
+    static void CopyToDevice(int deviceId, void* device, const void* host, size_t bytes, size_t event);
+    static void WaitForTransfer(int deviceId, size_t event);
+};
+
 // -----------------------------------------------------------------------
 // ElementWiseOperator -- This enum represents which function to apply.
 // This is shared between all matrix types and tensors.
@@ -167,6 +332,82 @@ enum ElementWiseOperator
     Macro(Cond);                \
     Macro(Clip);
 
+// -----------------------------------------------------------------------
+// ElementWiseProgram -- a short sequence of ElementWiseOperators that is
+// evaluated in a single pass over memory, i.e. a fused kernel for a chain
+// of elementwise operations on tensors of identical shape.
+// Registers [0, numInputs) hold the input values at the current element.
+// Instruction k computes register numInputs + k from up to 3 registers and
+// optionally stores it into output tensor 'output'. Unused args must be 0.
+// -----------------------------------------------------------------------
+
+struct ElementWiseInstruction
+{
+    ElementWiseOperator op;
+    int args[3]; // register indices
+    int output;  // output tensor to store the result into, or -1 if it is only used by later instructions
+};
+
+struct ElementWiseProgram
+{
+    enum
+    {
+        maxInputs = 8,
+        maxInstructions = 16,
+        maxOutputs = 16
+    };
+    int numInputs;
+    int numOutputs;
+    int numInstructions;
+    ElementWiseInstruction instructions[maxInstructions];
+};
+
+// -----------------------------------------------------------------------
+// BatchedGemmShape -- the shape of a batch of equally shaped products
+// c_i = alpha * op(a_i) * op(b_i) + beta * c_i, i < batchSize (BatchMultiplyAndWeightedAdd()).
+// Each operand consists of batchSize equally wide column blocks side by side,
+// x_i being the i-th block of x. An operand that is only one block wide
+// (e.g. a weight matrix) is shared by all products. c must have its final size.
+// -----------------------------------------------------------------------
+
+struct BatchedGemmShape
+{
+    size_t m, n, k;                   // op(a_i) is [m x k], op(b_i) is [k x n]
+    size_t strideA, strideB, strideC; // elements between the starts of consecutive blocks; 0 for a shared operand
+};
+
+static inline size_t BatchedGemmStride(size_t rows, size_t cols, size_t blockRows, size_t blockCols, size_t batchSize, const char* name)
+{
+    if (rows != blockRows || (cols != blockCols * batchSize && cols != blockCols))
+        InvalidArgument("BatchMultiplyAndWeightedAdd: %s must consist of %d blocks of [%d x %d], or be a single one, but is [%d x %d].",
+                        name, (int) batchSize, (int) blockRows, (int) blockCols, (int) rows, (int) cols);
+    return cols == blockCols * batchSize ? rows * blockCols : 0;
+}
+
+static inline BatchedGemmShape GetBatchedGemmShape(size_t aRows, size_t aCols, bool transposeA, size_t bRows, size_t bCols, bool transposeB,
+                                                   size_t cRows, size_t cCols, size_t batchSize)
+{
+    if (batchSize == 0 || cCols % batchSize != 0)
+        InvalidArgument("BatchMultiplyAndWeightedAdd: The number of columns of c (%d) must be a multiple of the batch size (%d).", (int) cCols, (int) batchSize);
+    BatchedGemmShape s;
+    s.m = cRows;
+    s.n = cCols / batchSize;
+    // the inner dimension is the row dimension of a transposed a or a non-transposed b;
+    // otherwise a and b are both k or batchSize * k wide, and the narrower one is shared
+    if (transposeA)
+        s.k = aRows;
+    else if (!transposeB)
+        s.k = bRows;
+    else
+        s.k = aCols == bCols ? aCols / batchSize : std::min(aCols, bCols);
+    s.strideA = transposeA ? BatchedGemmStride(aRows, aCols, s.k, s.m, batchSize, "a") : BatchedGemmStride(aRows, aCols, s.m, s.k, batchSize, "a");
+    s.strideB = transposeB ? BatchedGemmStride(bRows, bCols, s.n, s.k, batchSize, "b") : BatchedGemmStride(bRows, bCols, s.k, s.n, batchSize, "b");
+    s.strideC = s.m * s.n;
+    if (s.m == 0 || s.n == 0 || s.k == 0)
+        InvalidArgument("BatchMultiplyAndWeightedAdd: Empty operands.");
+    return s;
+}
+
 // -----------------------------------------------------------------------
 // various enums to describe
 // -----------------------------------------------------------------------
@@ -195,6 +436,7 @@ enum MatrixFormat
     matrixFormatMask = matrixFormatRowMajor + matrixFormatSparse + matrixFormatCompressed, // mask that covers all the
     matrixFormatSparseBlockCol,                                                            // col block based sparse matrix
     matrixFormatSparseBlockRow,                                                            // row block based sparse matrix
+    matrixFormatSparseBSR,                                                                 // block-sparse row: square blocks of a fixed dimension, e.g. for pruned weights
 };
 
 // common matrix flags for use on all matrices
@@ -206,6 +448,64 @@ enum MatrixFlags
     matrixFlagSetValueOnDevice = 1 << bitPosSetValueOnDevice, // SetValue() call has a buffer that is already on the device
 };
 
+// element types of the compact host buffers of SetValueFromCompact(), which are converted where the matrix lives
+enum CompactElementType
+{
+    compactElementUInt8 = 0,   // unsigned char, e.g. image pixels
+    compactElementFloat16 = 1, // IEEE half precision, kept as unsigned short
+};
+
+inline size_t CompactElementSize(CompactElementType type)
+{
+    return type == compactElementUInt8 ? sizeof(unsigned char) : sizeof(unsigned short);
+}
+
+// float -> half precision, rounding to nearest even; out-of-range values become infinity
+inline unsigned short FloatToFloat16(float f)
+{
+    unsigned int x;
+    memcpy(&x, &f, sizeof(x));
+    const unsigned int sign = (x >> 16) & 0x8000;
+    const unsigned int absx = x & 0x7fffffff;
+    if (absx >= 0x7f800000) // Inf, NaN
+        return (unsigned short) (sign | 0x7c00 | (absx > 0x7f800000 ? 0x200 : 0));
+    if (absx >= 0x477ff000) // rounds to 65536 or more
+        return (unsigned short) (sign | 0x7c00);
+    unsigned int h, rem, halfway;
+    if (absx < 0x38800000) // below 2^-14: a denormal half, or 0
+    {
+        if (absx < 0x33000000) // below 2^-25
+            return (unsigned short) sign;
+        const unsigned int mantissa = (absx & 0x007fffff) | 0x00800000;
+        const unsigned int shift = 126 - (absx >> 23);
+        h = mantissa >> shift;
+        rem = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    }
+    else
+    {
+        h = (absx - 0x38000000) >> 13; // (rebias the exponent from 127 to 15)
+        rem = absx & 0x1fff;
+        halfway = 0x1000;
+    }
+    if (rem > halfway || (rem == halfway && (h & 1)))
+        h++; // (a carry into the exponent is correct)
+    return (unsigned short) (sign | h);
+}
+
+inline float Float16ToFloat(unsigned short h)
+{
+    const unsigned int sign = (unsigned int) (h & 0x8000) << 16;
+    const unsigned int exponent = (h >> 10) & 0x1f;
+    const unsigned int mantissa = h & 0x3ff;
+    if (exponent == 0) // denormal, 0
+        return (sign ? -1.0f : 1.0f) * (float) mantissa * 5.9604644775390625e-8f /*2^-24*/;
+    const unsigned int x = sign | (exponent == 0x1f ? 0x7f800000 : (exponent + 112) << 23) | (mantissa << 13);
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
 // -----------------------------------------------------------------------
 // BaseMatrix -- base class for all matrix types (CPU, GPU) x (dense, sparse)
 // -----------------------------------------------------------------------
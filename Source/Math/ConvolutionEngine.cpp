@@ -9,6 +9,38 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Offset of element (row, col, channel) within a sample of a [w x h x c] image.
+// HWC (legacy) stores the channel fastest, then the row (extent h), then the column;
+// CHW (cuDNN) stores the column (extent w) fastest, then the row, then the channel.
+static inline size_t ImageOffset(ImageLayoutKind layout, size_t w, size_t h, size_t c, size_t row, size_t col, size_t channel)
+{
+    return layout == ImageLayoutKind::HWC ? channel + c * (row + h * col) : col + w * (row + h * channel);
+}
+
+// Offset of element (row, col, channel) within a row of the [k x kw * kh * c] filter matrix.
+// HWC filters store the channel slowest, then the column, then the row (fastest); CHW filters are CHW images.
+static inline size_t FilterOffset(ImageLayoutKind layout, size_t kw, size_t kh, size_t row, size_t col, size_t channel)
+{
+    return layout == ImageLayoutKind::HWC ? channel * kw * kh + row + col * kh : col + kw * (row + kh * channel);
+}
+
+// Channel of element i of a sample, for per-channel parameters (bias, spatial batch normalization).
+static inline size_t ImageChannel(ImageLayoutKind layout, size_t w, size_t h, size_t c, size_t i)
+{
+    return layout == ImageLayoutKind::HWC ? i % c : i / (w * h);
+}
+
+// added to the variance in batch normalization, as CUDNN_BN_MIN_EPSILON in the cuDNN engine
+static const double BatchNormEpsilon = 1e-5;
+
+// The legacy CPU/GPU kernels handle HWC only; the CHW paths work on host memory.
+template <class ElemType>
+static void VerifyCHWOnCPU(const Matrix<ElemType>& m)
+{
+    if (m.GetCurrentMatrixLocation() != CurrentDataLocation::CPU || m.GetMatrixType() != MatrixType::DENSE)
+        RuntimeError("The CHW image layout is supported on the GPU and for sparse input only by the cuDNN engine.");
+}
+
 template <class ElemType>
 class DefaultConvolutionEngine : public ConvolutionEngine<ElemType>
 {
@@ -20,8 +52,8 @@ public:
     using typename Base::ConvDesc;
 
 public:
-    DefaultConvolutionEngine(DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples)
-        : m_ones(deviceId), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples)
+    DefaultConvolutionEngine(DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples, ImageLayoutKind imageLayoutKind)
+        : m_ones(deviceId), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_imageLayoutKind(imageLayoutKind), m_gpuSparseOpt(false), m_gpuSparse1D(false)
     {
     }
 
@@ -29,6 +61,27 @@ public:
     void Forward(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
                  const Tensor4D& outT, Mat& out, Mat& workspace) override
     {
+        ForwardWithEpilogue(inT, in, filterT, filter, convDesc, nullptr, false, outT, out, workspace);
+    }
+
+    void ForwardBiasActivation(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                               const Tensor4D& biasT, const Mat& bias, bool relu, const Tensor4D& outT, Mat& out, Mat& workspace) override
+    {
+        assert(biasT.c() == outT.c());
+        assert(bias.GetNumElements() == biasT.c());
+        UNUSED(biasT);
+        ForwardWithEpilogue(inT, in, filterT, filter, convDesc, &bias, relu, outT, out, workspace);
+    }
+
+protected:
+    // Forward(); with a bias, each sub-batch gets the bias and the activation right after its product, while it is
+    // still in the cache, instead of in passes over the whole output
+    void ForwardWithEpilogue(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                             const Mat* bias, bool relu, const Tensor4D& outT, Mat& out, Mat& workspace)
+    {
+        if (m_imageLayoutKind == ImageLayoutKind::CHW)
+            return ForwardCHW(inT, in, filterT, filter, convDesc, bias, relu, outT, out, workspace);
+
         assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
         assert(inT.n() == in.GetNumCols());
         assert(filterT.k() == filter.GetNumRows());
@@ -107,15 +160,33 @@ public:
                 // workspace.Resize(packedInputRows, packedInputColsPerSample * smallBatchSize);
                 // BUGBUG: This ^^ destroys the content of the matrix. Also it seems not to change the size. Does it? Should this be a Reshape()?
                 Mat::Multiply(filter, false, workspace, false, outputSubBatch);
+                if (bias)
+                    AddBiasActivationHWC(*bias, relu, outputSubBatch);
             }
         }
 
+        // (the sparse 1-D path computes into a [c * w x h * n] output, which has no column per pixel until now)
+        if (bias && m_gpuSparseOpt)
+        {
+            Mat outputAsPixels = out.Reshaped(outT.c(), outputSizePerChannel * batchSize);
+            AddBiasActivationHWC(*bias, relu, outputAsPixels);
+        }
+
         out.Reshape(outT.c() * outputSizePerChannel, batchSize); // each sample becomes a column
 
         assert(outT.w() * outT.h() * outT.c() == out.GetNumRows());
         assert(outT.n() == out.GetNumCols());
     }
 
+    // out [c x pixels] += bias [c], then max(out, 0) if relu
+    static void AddBiasActivationHWC(const Mat& bias, bool relu, Mat& out)
+    {
+        Mat::ScaleAndAdd((ElemType) 1, bias.Reshaped(bias.GetNumElements(), 1), out); // (adds the column vector to every column)
+        if (relu)
+            out.InplaceTruncateBottom(0);
+    }
+
+public:
     void BackwardData(const Tensor4D& srcGradT, const Mat& srcGrad, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
                       const Tensor4D& gradT, Mat& grad, Mat& workspace) override
     {
@@ -128,6 +199,9 @@ public:
         assert(gradT.w() * gradT.h() * gradT.c() == grad.GetNumRows());
         assert(gradT.n() == grad.GetNumCols());
 
+        if (m_imageLayoutKind == ImageLayoutKind::CHW)
+            return BackwardDataCHW(srcGradT, srcGrad, filterT, filter, convDesc, gradT, grad, workspace);
+
         size_t packedInputRows = filterT.w() * filterT.h() * filterT.c();
         size_t packedInputColsPerSample = srcGradT.w() * srcGradT.h();
         size_t outputSizePerChannel = packedInputColsPerSample;
@@ -179,6 +253,9 @@ public:
         assert(filterT.k() == filter.GetNumRows());
         assert(filterT.w() * filterT.h() * filterT.c() == filter.GetNumCols());
 
+        if (m_imageLayoutKind == ImageLayoutKind::CHW)
+            return BackwardFilterCHW(srcGradT, srcGrad, inT, in, convDesc, filterT, filter, allowReuse, workspace);
+
         size_t packedInputRows = filterT.w() * filterT.h() * filterT.c();
         size_t packedInputColsPerSample = srcGradT.w() * srcGradT.h();
         size_t outputSizePerChannel = packedInputColsPerSample;
@@ -261,6 +338,20 @@ public:
         assert(outT.w() * outT.h() * outT.c() == out.GetNumRows());
         assert(outT.n() == out.GetNumCols());
 
+        if (m_imageLayoutKind == ImageLayoutKind::CHW)
+        {
+            VerifyCHWOnCPU(out);
+            dst.Resize(out.GetNumRows(), out.GetNumCols());
+            const ElemType* o = out.BufferPointer();
+            const ElemType* b = bias.BufferPointer();
+            ElemType* d = dst.BufferPointer();
+            const long numElements = (long) out.GetNumElements();
+#pragma omp parallel for
+            for (long i = 0; i < numElements; i++)
+                d[i] = o[i] + b[ImageChannel(m_imageLayoutKind, outT.w(), outT.h(), outT.c(), i % out.GetNumRows())];
+            return;
+        }
+
         Mat o = out.ColumnSlice(0, out.GetNumCols()); // same as .AsReference()
         Mat d = dst.Reshaped(biasT.c(), outT.w() * outT.h() * outT.n());
         d.AssignSumOf(o.Reshaped(biasT.c(), outT.w() * outT.h() * outT.n()), bias);
@@ -275,6 +366,25 @@ public:
         assert(biasGrad.GetNumRows() == biasT.c());
         assert(biasGrad.GetNumCols() == 1);
 
+        if (m_imageLayoutKind == ImageLayoutKind::CHW)
+        {
+            // each channel is a contiguous block of w * h values in every sample
+            VerifyCHWOnCPU(srcGrad);
+            const size_t pixels = srcGradT.w() * srcGradT.h();
+            const ElemType* sg = srcGrad.BufferPointer();
+            ElemType* bg = biasGrad.BufferPointer();
+#pragma omp parallel for
+            for (long c = 0; c < (long) biasT.c(); c++)
+            {
+                ElemType sum = 0;
+                for (size_t s = 0; s < srcGradT.n(); s++)
+                    for (size_t p = 0; p < pixels; p++)
+                        sum += sg[s * srcGrad.GetNumRows() + c * pixels + p];
+                bg[c] += sum;
+            }
+            return;
+        }
+
         Mat sg = srcGrad.ColumnSlice(0, srcGrad.GetNumCols());
         size_t ccol = srcGradT.w() * srcGradT.h() * srcGradT.n();
         // REVIEW alexeyk: should be replaced by ConstOnes eventually.
@@ -283,64 +393,562 @@ public:
         Mat::MultiplyAndAdd(sg.Reshaped(biasT.c(), ccol), false, m_ones, false, biasGrad);
     }
 
+    // As cudnnBatchNormalizationForwardTraining(): normalizes with the minibatch statistics, saves them for the backward pass,
+    // and folds them into the running statistics, runX = (1 - expAvgFactor) * runX + expAvgFactor * x, all in one pass per feature.
     void NormalizeBatch(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
                         bool spatial, double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out, Mat& saveMean, Mat& saveInvStdDev) override
     {
-        UNUSED(inT);
-        UNUSED(in);
+        assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
+        assert(scaleBiasT.c() * scaleBiasT.w() * scaleBiasT.h() == scale.GetNumRows());
         UNUSED(scaleBiasT);
-        UNUSED(scale);
-        UNUSED(bias);
-        UNUSED(out);
-        UNUSED(spatial);
-        UNUSED(expAvgFactor);
-        UNUSED(runMean);
-        UNUSED(runInvStdDev);
-        UNUSED(saveMean);
-        UNUSED(saveInvStdDev);
-        RuntimeError("Not yet implemented.");
+        if (in.GetCurrentMatrixLocation() != CurrentDataLocation::CPU || in.GetMatrixType() != MatrixType::DENSE)
+            RuntimeError("Batch normalization on the GPU requires the cuDNN engine.");
+
+        out.Resize(in.GetNumRows(), in.GetNumCols());
+        saveMean.Resize(runMean.GetNumRows(), runMean.GetNumCols());
+        saveInvStdDev.Resize(runMean.GetNumRows(), runMean.GetNumCols());
+        const ElemType* x = in.BufferPointer();
+        const ElemType* s = scale.BufferPointer();
+        const ElemType* b = bias.BufferPointer();
+        ElemType* y = out.BufferPointer();
+        ElemType* rm = runMean.BufferPointer();
+        ElemType* risd = runInvStdDev.BufferPointer();
+        ElemType* sm = saveMean.BufferPointer();
+        ElemType* sisd = saveInvStdDev.BufferPointer();
+        const ElemType factor = (ElemType) expAvgFactor;
+#pragma omp parallel for
+        for (long f = 0; f < (long) scale.GetNumRows(); f++)
+        {
+            double sum = 0;
+            double sumSq = 0;
+            size_t count = 0;
+            ForEachElementOfFeature(inT, in, spatial, f, [&](size_t i)
+                                    {
+                                        sum += x[i];
+                                        sumSq += (double) x[i] * x[i];
+                                        count++;
+                                    });
+            const double mean = sum / count;
+            const ElemType invStdDev = (ElemType) (1 / sqrt(max(sumSq / count - mean * mean, 0.0) + BatchNormEpsilon));
+            ForEachElementOfFeature(inT, in, spatial, f, [&](size_t i)
+                                    {
+                                        y[i] = s[f] * (x[i] - (ElemType) mean) * invStdDev + b[f];
+                                    });
+            sm[f] = (ElemType) mean;
+            sisd[f] = invStdDev;
+            rm[f] = (1 - factor) * rm[f] + factor * (ElemType) mean;
+            risd[f] = (1 - factor) * risd[f] + factor * invStdDev;
+        }
     }
 
+    // out = scale * (in - runMean) * runInvStdDev + bias, with one parameter per channel if spatial, else per element
     void NormalizeBatchInference(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
                                  bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out) override
     {
-        UNUSED(inT);
-        UNUSED(in);
+        assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
+        assert(scaleBiasT.c() * scaleBiasT.w() * scaleBiasT.h() == scale.GetNumRows());
         UNUSED(scaleBiasT);
-        UNUSED(scale);
-        UNUSED(bias);
-        UNUSED(out);
-        UNUSED(spatial);
-        UNUSED(runMean);
-        UNUSED(runInvStdDev);
-        RuntimeError("Not yet implemented.");
+        if (in.GetCurrentMatrixLocation() != CurrentDataLocation::CPU || in.GetMatrixType() != MatrixType::DENSE)
+            RuntimeError("Batch normalization on the GPU requires the cuDNN engine.");
+
+        out.Resize(in.GetNumRows(), in.GetNumCols());
+        const size_t rows = in.GetNumRows();
+        const ElemType* x = in.BufferPointer();
+        const ElemType* s = scale.BufferPointer();
+        const ElemType* b = bias.BufferPointer();
+        const ElemType* m = runMean.BufferPointer();
+        const ElemType* isd = runInvStdDev.BufferPointer();
+        ElemType* y = out.BufferPointer();
+        const long numElements = (long) in.GetNumElements();
+#pragma omp parallel for
+        for (long i = 0; i < numElements; i++)
+        {
+            const size_t f = spatial ? ImageChannel(m_imageLayoutKind, inT.w(), inT.h(), inT.c(), i % rows) : i % rows;
+            y[i] = s[f] * (x[i] - m[f]) * isd[f] + b[f];
+        }
     }
 
+    // As cudnnBatchNormalizationBackward(), from the statistics saved by NormalizeBatch(): adds to grad, and assigns scaleGrad and biasGrad.
+    // With xHat = (x - mean) * invStdDev: biasGrad = sum(dy), scaleGrad = sum(dy * xHat),
+    // dx = scale * invStdDev * (dy - (biasGrad + xHat * scaleGrad) / m) for m elements per feature.
     void BackwardNormalizeBatch(const Tensor4D& inT, const Mat& in, const Mat& srcGrad, Mat& grad,
                                 const Tensor4D& scaleBiasT, const Mat& scale, bool spatial, const Mat& saveMean, const Mat& saveInvStdDev,
                                 Mat& scaleGrad, Mat& biasGrad) override
     {
-        UNUSED(inT);
-        UNUSED(in);
-        UNUSED(srcGrad);
-        UNUSED(grad);
+        assert(scaleBiasT.c() * scaleBiasT.w() * scaleBiasT.h() == scale.GetNumRows());
         UNUSED(scaleBiasT);
-        UNUSED(scale);
-        UNUSED(scaleGrad);
-        UNUSED(biasGrad);
-        UNUSED(spatial);
-        UNUSED(saveMean);
-        UNUSED(saveInvStdDev);
-        RuntimeError("Not yet implemented.");
+        if (in.GetCurrentMatrixLocation() != CurrentDataLocation::CPU || in.GetMatrixType() != MatrixType::DENSE)
+            RuntimeError("Batch normalization on the GPU requires the cuDNN engine.");
+
+        scaleGrad.Resize(scale.GetNumRows(), scale.GetNumCols());
+        biasGrad.Resize(scale.GetNumRows(), scale.GetNumCols());
+        const ElemType* x = in.BufferPointer();
+        const ElemType* dy = srcGrad.BufferPointer();
+        ElemType* dx = grad.BufferPointer();
+        const ElemType* s = scale.BufferPointer();
+        const ElemType* sm = saveMean.BufferPointer();
+        const ElemType* sisd = saveInvStdDev.BufferPointer();
+        ElemType* ds = scaleGrad.BufferPointer();
+        ElemType* db = biasGrad.BufferPointer();
+#pragma omp parallel for
+        for (long f = 0; f < (long) scale.GetNumRows(); f++)
+        {
+            double sumDy = 0;
+            double sumDyXHat = 0;
+            size_t count = 0;
+            ForEachElementOfFeature(inT, in, spatial, f, [&](size_t i)
+                                    {
+                                        sumDy += dy[i];
+                                        sumDyXHat += (double) dy[i] * (x[i] - sm[f]) * sisd[f];
+                                        count++;
+                                    });
+            const ElemType meanDy = (ElemType) (sumDy / count);
+            const ElemType meanDyXHat = (ElemType) (sumDyXHat / count);
+            const ElemType k = s[f] * sisd[f];
+            ForEachElementOfFeature(inT, in, spatial, f, [&](size_t i)
+                                    {
+                                        dx[i] += k * (dy[i] - meanDy - (x[i] - sm[f]) * sisd[f] * meanDyXHat);
+                                    });
+            ds[f] = (ElemType) sumDyXHat;
+            db[f] = (ElemType) sumDy;
+        }
+    }
+
+private:
+    // calls f(i) for the elements i of 'in' that share the batch normalization parameters of feature f:
+    // a channel if spatial, else an element of the sample
+    template <class F>
+    void ForEachElementOfFeature(const Tensor4D& inT, const Mat& in, bool spatial, size_t feature, F f) const
+    {
+        const size_t rows = in.GetNumRows();
+        const size_t pixels = inT.w() * inT.h();
+        for (size_t s = 0; s < in.GetNumCols(); s++)
+        {
+            if (!spatial)
+                f(s * rows + feature);
+            else if (m_imageLayoutKind == ImageLayoutKind::HWC)
+                for (size_t p = 0; p < pixels; p++)
+                    f(s * rows + feature + inT.c() * p);
+            else
+                for (size_t p = 0; p < pixels; p++)
+                    f(s * rows + feature * pixels + p);
+        }
+    }
+
+    // CHW: im2col per sample, with the packed rows in filter order and the packed columns in output pixel order,
+    // so that packed' * filter' is the CHW output of the sample.
+
+    // packed [kw * kh * c x (outW * outH) * n]
+    static void PackCHW(const Mat& in, const Tensor4D& inT, const Filter& filterT, const ConvDesc& convDesc, const Tensor4D& outT, Mat& packed)
+    {
+        const size_t numSamples = in.GetNumCols();
+        const size_t packedRows = filterT.w() * filterT.h() * filterT.c();
+        const size_t outPixels = outT.w() * outT.h();
+        packed.Resize(packedRows, outPixels * numSamples);
+        const long padW = convDesc.padding() ? (long) filterT.w() / 2 : 0;
+        const long padH = convDesc.padding() ? (long) filterT.h() / 2 : 0;
+        const ElemType* x = in.BufferPointer();
+        ElemType* p = packed.BufferPointer();
+#pragma omp parallel for
+        for (long sc = 0; sc < (long) (numSamples * inT.c()); sc++)
+        {
+            const size_t sample = sc / inT.c();
+            const size_t c = sc % inT.c();
+            const ElemType* sampleIn = x + sample * in.GetNumRows();
+            ElemType* samplePacked = p + sample * outPixels * packedRows;
+            for (size_t kr = 0; kr < filterT.h(); kr++)
+            {
+                for (size_t kc = 0; kc < filterT.w(); kc++)
+                {
+                    const size_t packedRow = FilterOffset(ImageLayoutKind::CHW, filterT.w(), filterT.h(), kr, kc, c);
+                    for (size_t orow = 0; orow < outT.h(); orow++)
+                    {
+                        const long row = (long) (orow * convDesc.hStride() + kr) - padH;
+                        for (size_t ocol = 0; ocol < outT.w(); ocol++)
+                        {
+                            const long col = (long) (ocol * convDesc.wStride() + kc) - padW;
+                            const bool inside = row >= 0 && row < (long) inT.h() && col >= 0 && col < (long) inT.w();
+                            samplePacked[packedRow + packedRows * (ocol + outT.w() * orow)] =
+                                inside ? sampleIn[ImageOffset(ImageLayoutKind::CHW, inT.w(), inT.h(), inT.c(), row, col, c)] : 0;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // the inverse of PackCHW(): adds each packed value to the input element it was taken from
+    static void UnpackAddCHW(const Mat& packed, const Tensor4D& inT, const Filter& filterT, const ConvDesc& convDesc, const Tensor4D& outT, Mat& in)
+    {
+        const size_t numSamples = in.GetNumCols();
+        const size_t packedRows = filterT.w() * filterT.h() * filterT.c();
+        const size_t outPixels = outT.w() * outT.h();
+        const long padW = convDesc.padding() ? (long) filterT.w() / 2 : 0;
+        const long padH = convDesc.padding() ? (long) filterT.h() / 2 : 0;
+        const ElemType* p = packed.BufferPointer();
+        ElemType* x = in.BufferPointer();
+        // (a channel of a sample is only written by its own iteration)
+#pragma omp parallel for
+        for (long sc = 0; sc < (long) (numSamples * inT.c()); sc++)
+        {
+            const size_t sample = sc / inT.c();
+            const size_t c = sc % inT.c();
+            ElemType* sampleIn = x + sample * in.GetNumRows();
+            const ElemType* samplePacked = p + sample * outPixels * packedRows;
+            for (size_t kr = 0; kr < filterT.h(); kr++)
+            {
+                for (size_t kc = 0; kc < filterT.w(); kc++)
+                {
+                    const size_t packedRow = FilterOffset(ImageLayoutKind::CHW, filterT.w(), filterT.h(), kr, kc, c);
+                    for (size_t orow = 0; orow < outT.h(); orow++)
+                    {
+                        const long row = (long) (orow * convDesc.hStride() + kr) - padH;
+                        if (row < 0 || row >= (long) inT.h())
+                            continue;
+                        for (size_t ocol = 0; ocol < outT.w(); ocol++)
+                        {
+                            const long col = (long) (ocol * convDesc.wStride() + kc) - padW;
+                            if (col >= 0 && col < (long) inT.w())
+                                sampleIn[ImageOffset(ImageLayoutKind::CHW, inT.w(), inT.h(), inT.c(), row, col, c)] += samplePacked[packedRow + packedRows * (ocol + outT.w() * orow)];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    size_t SubBatchSize(size_t batchSize) const
+    {
+        return min(batchSize, m_maxTempMemSizeInSamples == 0 ? batchSize : m_maxTempMemSizeInSamples);
+    }
+
+    void ForwardCHW(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                    const Mat* bias, bool relu, const Tensor4D& outT, Mat& out, Mat& workspace)
+    {
+        VerifyCHWOnCPU(in);
+        const size_t batchSize = inT.n();
+        const size_t outPixels = outT.w() * outT.h();
+        const size_t subBatchSize = SubBatchSize(batchSize);
+        out.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+        out.Resize(outPixels * outT.c(), batchSize);
+        for (size_t startSampleId = 0; startSampleId < batchSize; startSampleId += subBatchSize)
+        {
+            const size_t smallBatchSize = min(batchSize - startSampleId, subBatchSize);
+            PackCHW(in.ColumnSlice(startSampleId, smallBatchSize), inT, filterT, convDesc, outT, workspace);
+            // per sample: out_s [outPixels x K] = packed_s^T * filter^T
+            Mat outSubBatch = out.ColumnSlice(startSampleId, smallBatchSize).Reshaped(outPixels, outT.c() * smallBatchSize);
+            Mat::BatchMultiplyAndWeightedAdd(1, workspace, true, filter, true, 0, outSubBatch, smallBatchSize);
+            if (bias)
+                AddBiasActivationCHW(*bias, relu, outSubBatch);
+        }
+    }
+
+    // out [pixels x c * n] += bias [c] (column j is channel j % c), then max(out, 0) if relu; in one pass on the host
+    static void AddBiasActivationCHW(const Mat& bias, bool relu, Mat& out)
+    {
+        const size_t pixels = out.GetNumRows();
+        const size_t numChannels = bias.GetNumElements();
+        const ElemType* b = bias.BufferPointer();
+        ElemType* o = out.BufferPointer();
+#pragma omp parallel for
+        for (long j = 0; j < (long) out.GetNumCols(); j++)
+        {
+            const ElemType channelBias = b[j % numChannels];
+            ElemType* col = o + j * pixels;
+            for (size_t p = 0; p < pixels; p++)
+            {
+                const ElemType v = col[p] + channelBias;
+                col[p] = relu && v < 0 ? 0 : v;
+            }
+        }
+    }
+
+    void BackwardDataCHW(const Tensor4D& srcGradT, const Mat& srcGrad, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                         const Tensor4D& gradT, Mat& grad, Mat& workspace)
+    {
+        VerifyCHWOnCPU(srcGrad);
+        const size_t batchSize = srcGradT.n();
+        const size_t outPixels = srcGradT.w() * srcGradT.h();
+        const size_t subBatchSize = SubBatchSize(batchSize);
+        for (size_t startSampleId = 0; startSampleId < batchSize; startSampleId += subBatchSize)
+        {
+            const size_t smallBatchSize = min(batchSize - startSampleId, subBatchSize);
+            workspace.Resize(filterT.w() * filterT.h() * filterT.c(), outPixels * smallBatchSize);
+            // per sample: packed_s = filter^T * srcGrad_s^T
+            Mat::BatchMultiplyAndWeightedAdd(1, filter, true, srcGrad.ColumnSlice(startSampleId, smallBatchSize).Reshaped(outPixels, srcGradT.c() * smallBatchSize), true, 0, workspace, smallBatchSize);
+            Mat gradSubBatch = grad.ColumnSlice(startSampleId, smallBatchSize);
+            UnpackAddCHW(workspace, gradT, filterT, convDesc, srcGradT, gradSubBatch);
+        }
+    }
+
+    void BackwardFilterCHW(const Tensor4D& srcGradT, const Mat& srcGrad, const Tensor4D& inT, const Mat& in, const ConvDesc& convDesc,
+                           const Filter& filterT, Mat& filter, bool allowReuse, Mat& workspace)
+    {
+        VerifyCHWOnCPU(in);
+        const size_t batchSize = inT.n();
+        const size_t outPixels = srcGradT.w() * srcGradT.h();
+        const size_t subBatchSize = SubBatchSize(batchSize);
+        for (size_t startSampleId = 0; startSampleId < batchSize; startSampleId += subBatchSize)
+        {
+            const size_t smallBatchSize = min(batchSize - startSampleId, subBatchSize);
+            // as in the HWC path, the packed input of the forward pass is reused if there was a single sub-batch
+            if (!(allowReuse && subBatchSize == batchSize))
+                PackCHW(in.ColumnSlice(startSampleId, smallBatchSize), inT, filterT, convDesc, srcGradT, workspace);
+            for (size_t s = 0; s < smallBatchSize; s++)
+                Mat::MultiplyAndAdd(srcGrad.ColumnSlice(startSampleId + s, 1).Reshaped(outPixels, srcGradT.c()), true, workspace.ColumnSlice(s * outPixels, outPixels), true, filter);
+        }
     }
 
 private:
     size_t m_maxTempMemSizeInSamples;
+    ImageLayoutKind m_imageLayoutKind;
     Mat m_ones;
     bool m_gpuSparseOpt;
     bool m_gpuSparse1D;
 };
 
+// -----------------------------------------------------------------------
+// WinogradConvolutionEngine -- CPU engine that computes dense 3x3 stride-1 convolutions with Winograd's minimal
+// filtering algorithm F(2x2, 3x3), and everything else (other filters and strides, sparse input, backprop) with im2col.
+//
+// Each 4x4 input tile d and 3x3 filter g are transformed into V = B' d B and U = G g G', multiplied elementwise,
+// summed over the input channels and transformed back into a 2x2 output tile Y = A' M A. For each of the 16 tile
+// positions the sum over channels is one [k x c] * [c x tiles] product, so that the bulk of the work is still done
+// by the BLAS, with 2.25x fewer multiplications than im2col and 4 instead of 9 transformed input values per output pixel.
+// Both image layouts are supported, see ImageOffset() and FilterOffset().
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class WinogradConvolutionEngine : public DefaultConvolutionEngine<ElemType>
+{
+public:
+    using Base = DefaultConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+    using typename Base::Tensor4D;
+    using typename Base::Filter;
+    using typename Base::ConvDesc;
+
+public:
+    WinogradConvolutionEngine(DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples, ImageLayoutKind imageLayoutKind)
+        : Base(deviceId, maxTempMemSizeInSamples, imageLayoutKind), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_imageLayoutKind(imageLayoutKind),
+          m_transformedFilter(CPUDEVICE), m_transformedOutput(CPUDEVICE), m_lastForwardUsedWinograd(false)
+    {
+    }
+
+public:
+    void Forward(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                 const Tensor4D& outT, Mat& out, Mat& workspace) override
+    {
+        ForwardWinograd(inT, in, filterT, filter, convDesc, nullptr, false, outT, out, workspace);
+    }
+
+    void ForwardBiasActivation(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                               const Tensor4D& biasT, const Mat& bias, bool relu, const Tensor4D& outT, Mat& out, Mat& workspace) override
+    {
+        assert(biasT.c() == outT.c());
+        assert(bias.GetNumElements() == biasT.c());
+        UNUSED(biasT);
+        ForwardWinograd(inT, in, filterT, filter, convDesc, &bias, relu, outT, out, workspace);
+    }
+
+    void BackwardFilter(const Tensor4D& srcGradT, const Mat& srcGrad, const Tensor4D& inT, const Mat& in, const ConvDesc& convDesc,
+                        const Filter& filterT, Mat& filter, bool allowReuse, Mat& workspace) override
+    {
+        // the workspace holds the packed input of the forward pass only if that was done with im2col
+        Base::BackwardFilter(srcGradT, srcGrad, inT, in, convDesc, filterT, filter, allowReuse && !m_lastForwardUsedWinograd, workspace);
+    }
+
+private:
+    // with a bias, TransformOutput() adds it and applies the activation as it writes the output tiles
+    void ForwardWinograd(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                         const Mat* bias, bool relu, const Tensor4D& outT, Mat& out, Mat& workspace)
+    {
+        m_lastForwardUsedWinograd = in.GetMatrixType() == MatrixType::DENSE && in.GetCurrentMatrixLocation() == CurrentDataLocation::CPU &&
+                                    filterT.w() == 3 && filterT.h() == 3 && convDesc.wStride() == 1 && convDesc.hStride() == 1;
+        if (!m_lastForwardUsedWinograd)
+            return Base::ForwardWithEpilogue(inT, in, filterT, filter, convDesc, bias, relu, outT, out, workspace);
+
+        assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
+        assert(inT.n() == in.GetNumCols());
+        assert(filterT.k() == filter.GetNumRows());
+        assert(filterT.w() * filterT.h() * filterT.c() == filter.GetNumCols());
+        assert(inT.c() == filterT.c());
+        assert(outT.c() == filterT.k());
+
+        const size_t batchSize = inT.n();
+        const size_t tilesPerSample = ((outT.h() + 1) / 2) * ((outT.w() + 1) / 2);
+        const size_t maxTempMemSizeInSamples = (m_maxTempMemSizeInSamples == 0 ? batchSize : m_maxTempMemSizeInSamples);
+        const size_t subBatchSize = min(batchSize, maxTempMemSizeInSamples);
+
+        TransformFilter(filter, filterT);
+        out.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+        for (size_t startSampleId = 0; startSampleId < batchSize; startSampleId += subBatchSize)
+        {
+            const size_t smallBatchSize = min(batchSize - startSampleId, subBatchSize);
+            const size_t numTiles = tilesPerSample * smallBatchSize;
+            workspace.Resize(inT.c(), 16 * numTiles);
+            m_transformedOutput.Resize(outT.c(), 16 * numTiles);
+
+            TransformInput(in.ColumnSlice(startSampleId, smallBatchSize), inT, outT, convDesc.padding(), workspace);
+            // one product per element of the 4x4 tile
+            Mat::BatchMultiplyAndWeightedAdd(1, m_transformedFilter, false, workspace, false, 0, m_transformedOutput, 16);
+            Mat outputSubBatch = out.ColumnSlice(startSampleId, smallBatchSize);
+            TransformOutput(outT, bias ? bias->BufferPointer() : nullptr, relu, outputSubBatch);
+        }
+    }
+
+    // U = G g G' for all (k, c), into m_transformedFilter [k x 16 * c] where column xi * c + c' holds tile position xi of channel c'
+    void TransformFilter(const Mat& filter, const Filter& filterT)
+    {
+        const size_t C = filterT.c();
+        const size_t K = filterT.k();
+        m_transformedFilter.Resize(K, 16 * C);
+        const ElemType* g = filter.BufferPointer();
+        ElemType* u = m_transformedFilter.BufferPointer();
+#pragma omp parallel for
+        for (long c = 0; c < (long) C; c++)
+        {
+            for (size_t k = 0; k < K; k++)
+            {
+                ElemType tile[3][3];
+                for (size_t i = 0; i < 3; i++) // (kh)
+                    for (size_t j = 0; j < 3; j++) // (kw)
+                        tile[i][j] = g[k + K * FilterOffset(m_imageLayoutKind, 3, 3, i, j, c)];
+                ElemType tmp[4][3];
+                for (size_t j = 0; j < 3; j++)
+                {
+                    tmp[0][j] = tile[0][j];
+                    tmp[1][j] = (tile[0][j] + tile[1][j] + tile[2][j]) / 2;
+                    tmp[2][j] = (tile[0][j] - tile[1][j] + tile[2][j]) / 2;
+                    tmp[3][j] = tile[2][j];
+                }
+                for (size_t i = 0; i < 4; i++)
+                {
+                    const ElemType v[4] = {tmp[i][0], (tmp[i][0] + tmp[i][1] + tmp[i][2]) / 2, (tmp[i][0] - tmp[i][1] + tmp[i][2]) / 2, tmp[i][2]};
+                    for (size_t j = 0; j < 4; j++)
+                        u[k + K * ((i * 4 + j) * C + c)] = v[j];
+                }
+            }
+        }
+    }
+
+    // V = B' d B for all (tile, c), into transformedInput [c x 16 * tiles] where column xi * tiles + t holds tile position xi of tile t
+    void TransformInput(const Mat& in, const Tensor4D& inT, const Tensor4D& outT, bool padding, Mat& transformedInput) const
+    {
+        const long C = (long) inT.c();
+        const long H = (long) inT.h();
+        const long W = (long) inT.w();
+        const long tilesH = (long) (outT.h() + 1) / 2;
+        const long tilesW = (long) (outT.w() + 1) / 2;
+        const long numSamples = (long) in.GetNumCols();
+        const long numTiles = tilesH * tilesW * numSamples;
+        const long pad = padding ? 1 : 0;
+        const ElemType* d = in.BufferPointer();
+        ElemType* v = transformedInput.BufferPointer();
+#pragma omp parallel for
+        for (long t = 0; t < numTiles; t++)
+        {
+            const long sample = t / (tilesH * tilesW);
+            const long tileRow = t % tilesH;
+            const long tileCol = (t / tilesH) % tilesW;
+            const ElemType* sampleIn = d + sample * H * W * C;
+            for (long c = 0; c < C; c++)
+            {
+                ElemType tile[4][4];
+                for (long i = 0; i < 4; i++)
+                {
+                    const long row = 2 * tileRow - pad + i;
+                    for (long j = 0; j < 4; j++)
+                    {
+                        const long col = 2 * tileCol - pad + j;
+                        tile[i][j] = row >= 0 && row < H && col >= 0 && col < W ? sampleIn[ImageOffset(m_imageLayoutKind, W, H, C, row, col, c)] : 0;
+                    }
+                }
+                ElemType tmp[4][4];
+                for (long j = 0; j < 4; j++)
+                {
+                    tmp[0][j] = tile[0][j] - tile[2][j];
+                    tmp[1][j] = tile[1][j] + tile[2][j];
+                    tmp[2][j] = tile[2][j] - tile[1][j];
+                    tmp[3][j] = tile[1][j] - tile[3][j];
+                }
+                for (long i = 0; i < 4; i++)
+                {
+                    const ElemType r[4] = {tmp[i][0] - tmp[i][2], tmp[i][1] + tmp[i][2], tmp[i][2] - tmp[i][1], tmp[i][1] - tmp[i][3]};
+                    for (long j = 0; j < 4; j++)
+                        v[c + C * ((i * 4 + j) * numTiles + t)] = r[j];
+                }
+            }
+        }
+    }
+
+    // Y = A' M A for all (tile, k), from m_transformedOutput into out, dropping the rows/columns of tiles beyond the output;
+    // plus bias[k] and max(y, 0) if relu, if a bias is given
+    void TransformOutput(const Tensor4D& outT, const ElemType* bias, bool relu, Mat& out) const
+    {
+        const long K = (long) outT.c();
+        const long H = (long) outT.h();
+        const long W = (long) outT.w();
+        const long tilesH = (H + 1) / 2;
+        const long tilesW = (W + 1) / 2;
+        const long numTiles = tilesH * tilesW * (long) out.GetNumCols();
+        const ElemType* m = m_transformedOutput.BufferPointer();
+        ElemType* y = out.BufferPointer();
+#pragma omp parallel for
+        for (long t = 0; t < numTiles; t++)
+        {
+            const long sample = t / (tilesH * tilesW);
+            const long tileRow = t % tilesH;
+            const long tileCol = (t / tilesH) % tilesW;
+            ElemType* sampleOut = y + sample * H * W * K;
+            for (long k = 0; k < K; k++)
+            {
+                const ElemType b = bias ? bias[k] : 0;
+                const ElemType lower = relu ? 0 : -std::numeric_limits<ElemType>::infinity();
+                ElemType tile[4][4];
+                for (long xi = 0; xi < 16; xi++)
+                    tile[xi / 4][xi % 4] = m[k + K * (xi * numTiles + t)];
+                ElemType tmp[2][4];
+                for (long j = 0; j < 4; j++)
+                {
+                    tmp[0][j] = tile[0][j] + tile[1][j] + tile[2][j];
+                    tmp[1][j] = tile[1][j] - tile[2][j] - tile[3][j];
+                }
+                for (long i = 0; i < 2; i++)
+                {
+                    const long row = 2 * tileRow + i;
+                    if (row >= H)
+                        continue;
+                    const ElemType r[2] = {tmp[i][0] + tmp[i][1] + tmp[i][2] + b, tmp[i][1] - tmp[i][2] - tmp[i][3] + b};
+                    for (long j = 0; j < 2; j++)
+                    {
+                        const long col = 2 * tileCol + j;
+                        if (col < W)
+                            sampleOut[ImageOffset(m_imageLayoutKind, W, H, K, row, col, k)] = max(r[j], lower);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    size_t m_maxTempMemSizeInSamples;
+    ImageLayoutKind m_imageLayoutKind;
+    Mat m_transformedFilter; // [k x 16 * c]
+    Mat m_transformedOutput; // [k x 16 * tiles]
+    bool m_lastForwardUsedWinograd;
+};
+
+template <class ElemType>
+void ConvolutionEngine<ElemType>::ForwardBiasActivation(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                                                        const Tensor4D& biasT, const Mat& bias, bool relu, const Tensor4D& outT, Mat& out, Mat& workspace)
+{
+    Forward(inT, in, filterT, filter, convDesc, outT, out, workspace);
+    AddBias(outT, out, biasT, bias, out);
+    if (relu)
+        out.InplaceTruncateBottom(0);
+}
+
 template class ConvolutionEngine<float>;
 template class ConvolutionEngine<double>;
 
@@ -353,6 +961,12 @@ public:
     using typename Base::PoolDesc;
     using typename Base::Mat;
 
+public:
+    DefaultPoolingEngine(DEVICEID_TYPE deviceId, ImageLayoutKind imageLayoutKind)
+        : m_deviceId(deviceId), m_imageLayoutKind(imageLayoutKind)
+    {
+    }
+
 public:
     void Forward(const Tensor4D& inT, const Mat& in, const PoolDesc& poolDesc, const Tensor4D& outT, Mat& out) override
     {
@@ -361,6 +975,9 @@ public:
         assert(outT.w() * outT.h() * outT.c() == out.GetNumRows());
         assert(outT.n() == out.GetNumCols());
 
+        if (m_imageLayoutKind == ImageLayoutKind::CHW)
+            return ForwardCHW(inT, in, poolDesc, outT, out);
+
         if (poolDesc.kind() == PoolDesc::PoolKind::Max)
         {
             out.AssignMaxPoolingResult(in, inT.c(), inT.w(), inT.h(), inT.w() * inT.h() * inT.c(),
@@ -388,6 +1005,9 @@ public:
         assert(in.GetNumRows() == grad.GetNumRows());
         assert(in.GetNumCols() == grad.GetNumCols());
 
+        if (m_imageLayoutKind == ImageLayoutKind::CHW)
+            return BackwardCHW(outT, out, srcGrad, poolDesc, inT, in, grad);
+
         if (poolDesc.kind() == PoolDesc::PoolKind::Max)
         {
             grad.AddMaxPoolingGradient(srcGrad, in, out,
@@ -404,6 +1024,196 @@ public:
         else
             assert(false);
     }
+
+    // both image layouts, on the host
+    bool SupportsMaxIndices() const override
+    {
+        return m_deviceId < 0;
+    }
+
+    void ForwardMaxWithIndices(const Tensor4D& inT, const Mat& in, const PoolDesc& poolDesc, const Tensor4D& outT, Mat& out, unsigned char* indices) override
+    {
+        assert(poolDesc.kind() == PoolDesc::PoolKind::Max);
+        assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
+        assert(outT.w() * outT.h() * outT.c() == out.GetNumRows());
+        assert(in.GetNumCols() == out.GetNumCols());
+        VerifyCHWOnCPU(in);
+        VerifyCHWOnCPU(out);
+        if (Base::MaxIndexBytes(poolDesc) == 1)
+            ForwardMaxWithIndices(inT, in, poolDesc, outT, out, indices);
+        else
+            ForwardMaxWithIndices(inT, in, poolDesc, outT, out, (uint16_t*) indices);
+    }
+
+    void BackwardMaxFromIndices(const Tensor4D& outT, const Mat& srcGrad, const PoolDesc& poolDesc, const Tensor4D& inT, const unsigned char* indices, Mat& grad) override
+    {
+        assert(poolDesc.kind() == PoolDesc::PoolKind::Max);
+        assert(outT.w() * outT.h() * outT.c() == srcGrad.GetNumRows());
+        assert(inT.w() * inT.h() * inT.c() == grad.GetNumRows());
+        VerifyCHWOnCPU(grad);
+        if (Base::MaxIndexBytes(poolDesc) == 1)
+            BackwardMaxFromIndices(outT, srcGrad, poolDesc, inT, indices, grad);
+        else
+            BackwardMaxFromIndices(outT, srcGrad, poolDesc, inT, (const uint16_t*) indices, grad);
+    }
+
+private:
+    // The index of input (row, col) in the window of output (orow, ocol) is (row - row0) * w + (col - col0), where
+    // (row0, col0) is the window's top left corner, which may lie in the padding. Each (sample, channel) plane is
+    // processed on its own, as the windows within a plane may overlap.
+    template <class IndexType>
+    void ForwardMaxWithIndices(const Tensor4D& inT, const Mat& in, const PoolDesc& poolDesc, const Tensor4D& outT, Mat& out, IndexType* indices) const
+    {
+        const size_t C = inT.c();
+        const size_t inSize = inT.w() * inT.h() * C;
+        const size_t outSize = outT.w() * outT.h() * C;
+        const ElemType* x = in.BufferPointer();
+        ElemType* y = out.BufferPointer();
+#pragma omp parallel for
+        for (long plane = 0; plane < (long) (in.GetNumCols() * C); plane++)
+        {
+            const size_t sample = plane / C;
+            const size_t channel = plane % C;
+            for (size_t orow = 0; orow < outT.h(); orow++)
+            {
+                for (size_t ocol = 0; ocol < outT.w(); ocol++)
+                {
+                    const long row0 = (long) (orow * poolDesc.hStride()) - (long) poolDesc.hPad();
+                    const long col0 = (long) (ocol * poolDesc.wStride()) - (long) poolDesc.wPad();
+                    ElemType result = -std::numeric_limits<ElemType>::max();
+                    size_t best = 0;
+                    for (long row = max(row0, 0L); row < min(row0 + (long) poolDesc.h(), (long) inT.h()); row++)
+                    {
+                        for (long col = max(col0, 0L); col < min(col0 + (long) poolDesc.w(), (long) inT.w()); col++)
+                        {
+                            const ElemType v = x[sample * inSize + ImageOffset(m_imageLayoutKind, inT.w(), inT.h(), C, row, col, channel)];
+                            if (v > result || (row == max(row0, 0L) && col == max(col0, 0L)))
+                            {
+                                result = v;
+                                best = (row - row0) * poolDesc.w() + (col - col0);
+                            }
+                        }
+                    }
+                    const size_t o = sample * outSize + ImageOffset(m_imageLayoutKind, outT.w(), outT.h(), C, orow, ocol, channel);
+                    y[o] = result;
+                    indices[o] = (IndexType) best;
+                }
+            }
+        }
+    }
+
+    template <class IndexType>
+    void BackwardMaxFromIndices(const Tensor4D& outT, const Mat& srcGrad, const PoolDesc& poolDesc, const Tensor4D& inT, const IndexType* indices, Mat& grad) const
+    {
+        const size_t C = inT.c();
+        const size_t inSize = inT.w() * inT.h() * C;
+        const size_t outSize = outT.w() * outT.h() * C;
+        const ElemType* dy = srcGrad.BufferPointer();
+        ElemType* dx = grad.BufferPointer();
+#pragma omp parallel for
+        for (long plane = 0; plane < (long) (srcGrad.GetNumCols() * C); plane++)
+        {
+            const size_t sample = plane / C;
+            const size_t channel = plane % C;
+            for (size_t orow = 0; orow < outT.h(); orow++)
+            {
+                for (size_t ocol = 0; ocol < outT.w(); ocol++)
+                {
+                    const size_t o = sample * outSize + ImageOffset(m_imageLayoutKind, outT.w(), outT.h(), C, orow, ocol, channel);
+                    const size_t row = orow * poolDesc.hStride() - poolDesc.hPad() + indices[o] / poolDesc.w();
+                    const size_t col = ocol * poolDesc.wStride() - poolDesc.wPad() + indices[o] % poolDesc.w();
+                    dx[sample * inSize + ImageOffset(m_imageLayoutKind, inT.w(), inT.h(), C, row, col, channel)] += dy[o];
+                }
+            }
+        }
+    }
+
+    // CHW: every channel of every sample is a contiguous [w x h] plane. Padding is taken into account like in cuDNN:
+    // padded positions never win a max, and averages are over the positions inside the image.
+
+    // calls f(outIndex, inIndex) for each input position of output position (orow, ocol) of a plane
+    template <class F>
+    static void ForEachInWindow(const Tensor4D& inT, const PoolDesc& poolDesc, size_t orow, size_t ocol, F f)
+    {
+        const long row0 = (long) (orow * poolDesc.hStride()) - (long) poolDesc.hPad();
+        const long col0 = (long) (ocol * poolDesc.wStride()) - (long) poolDesc.wPad();
+        for (long row = max(row0, 0L); row < min(row0 + (long) poolDesc.h(), (long) inT.h()); row++)
+            for (long col = max(col0, 0L); col < min(col0 + (long) poolDesc.w(), (long) inT.w()); col++)
+                f(col + inT.w() * row);
+    }
+
+    void ForwardCHW(const Tensor4D& inT, const Mat& in, const PoolDesc& poolDesc, const Tensor4D& outT, Mat& out)
+    {
+        VerifyCHWOnCPU(in);
+        out.Resize(outT.w() * outT.h() * outT.c(), in.GetNumCols());
+        const size_t inPlane = inT.w() * inT.h();
+        const size_t outPlane = outT.w() * outT.h();
+        const bool isMax = poolDesc.kind() == PoolDesc::PoolKind::Max;
+        const ElemType* x = in.BufferPointer();
+        ElemType* y = out.BufferPointer();
+#pragma omp parallel for
+        for (long plane = 0; plane < (long) (in.GetNumCols() * inT.c()); plane++)
+        {
+            const ElemType* planeIn = x + plane * inPlane;
+            ElemType* planeOut = y + plane * outPlane;
+            for (size_t orow = 0; orow < outT.h(); orow++)
+            {
+                for (size_t ocol = 0; ocol < outT.w(); ocol++)
+                {
+                    ElemType result = isMax ? -std::numeric_limits<ElemType>::max() : 0;
+                    size_t count = 0;
+                    ForEachInWindow(inT, poolDesc, orow, ocol, [&](size_t i)
+                                    {
+                                        result = isMax ? max(result, planeIn[i]) : result + planeIn[i];
+                                        count++;
+                                    });
+                    planeOut[ocol + outT.w() * orow] = isMax || count == 0 ? result : result / count;
+                }
+            }
+        }
+    }
+
+    void BackwardCHW(const Tensor4D& outT, const Mat& out, const Mat& srcGrad, const PoolDesc& poolDesc, const Tensor4D& inT, const Mat& in, Mat& grad)
+    {
+        VerifyCHWOnCPU(in);
+        const size_t inPlane = inT.w() * inT.h();
+        const size_t outPlane = outT.w() * outT.h();
+        const bool isMax = poolDesc.kind() == PoolDesc::PoolKind::Max;
+        const ElemType* x = in.BufferPointer();
+        const ElemType* y = out.BufferPointer();
+        const ElemType* dy = srcGrad.BufferPointer();
+        ElemType* dx = grad.BufferPointer();
+#pragma omp parallel for
+        for (long plane = 0; plane < (long) (in.GetNumCols() * inT.c()); plane++)
+        {
+            const ElemType* planeIn = x + plane * inPlane;
+            ElemType* planeGrad = dx + plane * inPlane;
+            for (size_t orow = 0; orow < outT.h(); orow++)
+            {
+                for (size_t ocol = 0; ocol < outT.w(); ocol++)
+                {
+                    const size_t o = plane * outPlane + ocol + outT.w() * orow;
+                    size_t count = 0;
+                    ForEachInWindow(inT, poolDesc, orow, ocol, [&](size_t)
+                                    {
+                                        count++;
+                                    });
+                    // as in the HWC path, every input that equals the max gets the gradient
+                    ForEachInWindow(inT, poolDesc, orow, ocol, [&](size_t i)
+                                    {
+                                        if (!isMax)
+                                            planeGrad[i] += dy[o] / count;
+                                        else if (planeIn[i] == y[o])
+                                            planeGrad[i] += dy[o];
+                                    });
+                }
+            }
+        }
+    }
+
+private:
+    DEVICEID_TYPE m_deviceId;
+    ImageLayoutKind m_imageLayoutKind;
 };
 
 template class PoolingEngine<float>;
@@ -427,6 +1237,11 @@ public:
     using typename Base::PoolEnginePtr;
 
 public:
+    DefaultConvolutionEngineFactory(ImageLayoutKind imageLayoutKind, bool useWinograd)
+        : m_imageLayoutKind(imageLayoutKind), m_useWinograd(useWinograd)
+    {
+    }
+
     Tensor4DPtr CreateTensor(size_t w, size_t h, size_t c, size_t n) override
     {
         return std::make_unique<ConvolutionTensor4D>(w, h, c, n);
@@ -450,13 +1265,19 @@ public:
 
     ConvEnginePtr CreateConvEngine(DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples) override
     {
-        return std::make_unique<DefaultConvolutionEngine<ElemType>>(deviceId, maxTempMemSizeInSamples);
+        if (m_useWinograd)
+            return std::make_unique<WinogradConvolutionEngine<ElemType>>(deviceId, maxTempMemSizeInSamples, m_imageLayoutKind);
+        return std::make_unique<DefaultConvolutionEngine<ElemType>>(deviceId, maxTempMemSizeInSamples, m_imageLayoutKind);
     }
 
-    PoolEnginePtr CreatePoolEngine(DEVICEID_TYPE /*deviceId*/) override
+    PoolEnginePtr CreatePoolEngine(DEVICEID_TYPE deviceId) override
     {
-        return std::make_unique<DefaultPoolingEngine<ElemType>>();
+        return std::make_unique<DefaultPoolingEngine<ElemType>>(deviceId, m_imageLayoutKind);
     }
+
+private:
+    ImageLayoutKind m_imageLayoutKind;
+    bool m_useWinograd;
 };
 
 template <class ElemType>
@@ -467,6 +1288,8 @@ std::unique_ptr<ConvolutionEngineFactory<ElemType>> ConvolutionEngineFactory<Ele
         // REVIEW alexeyk: make cuDNN default when running on GPU and compiled with cuDNN, add config parameter to enable runtime switch between implementations.
         if (deviceId >= 0 && CuDnnConvolutionEngineFactory<ElemType>::IsSupported(deviceId) && imageLayoutKind == ImageLayoutKind::CHW)
             return Create(deviceId, EngineType::CuDnn, imageLayoutKind);
+        else if (deviceId < 0)
+            return Create(deviceId, EngineType::Winograd, imageLayoutKind);
         else
             return Create(deviceId, EngineType::Legacy, imageLayoutKind);
     }
@@ -481,11 +1304,14 @@ std::unique_ptr<ConvolutionEngineFactory<ElemType>> ConvolutionEngineFactory<Ele
     else if (engType == EngineType::Legacy)
     {
         // REVIEW alexeyk: temp hack to allow this to work in MEL scenarios. InvalidArgument should be used instead.
-        if (imageLayoutKind != ImageLayoutKind::HWC)
+        // The legacy engine handles CHW on the CPU only.
+        if (imageLayoutKind != ImageLayoutKind::HWC && deviceId >= 0)
             fprintf(stderr, "WARNING: trying to use cuDNN on unsupported platform. It is safe to ignore the warning if it's produced during model editing command.\n");
         // InvalidArgument("ConvolutionEngineFactory: ImageLayout '%s' is not compatible with the legacy convolution engine.", ToString(imageLayoutKind).c_str());
-        return std::make_unique<DefaultConvolutionEngineFactory<ElemType>>();
+        return std::make_unique<DefaultConvolutionEngineFactory<ElemType>>(imageLayoutKind, false);
     }
+    else if (engType == EngineType::Winograd)
+        return std::make_unique<DefaultConvolutionEngineFactory<ElemType>>(imageLayoutKind, true);
 
     RuntimeError("Not supported convolution engine type: %d.", engType);
 }
@@ -250,6 +250,11 @@ public:
     virtual void AddBias(const Tensor4D& outT, const Mat& out, const Tensor4D& biasT, const Mat& bias, Mat& dst) = 0;
     virtual void BackwardBias(const Tensor4D& srcGradT, const Mat& srcGrad, const Tensor4D& biasT, Mat& biasGrad) = 0;
 
+    // Forward(), then the per-channel bias and, if relu, max(x, 0), as AddBias() and a RectifiedLinear would do.
+    // Engines override this to apply bias and activation to the output while they compute it, instead of in passes of their own.
+    virtual void ForwardBiasActivation(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                                       const Tensor4D& biasT, const Mat& bias, bool relu, const Tensor4D& outT, Mat& out, Mat& workspace);
+
     virtual void NormalizeBatch(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
                                 bool spatial, double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out, Mat& saveMean, Mat& saveInvStdDev) = 0;
 
@@ -282,6 +287,28 @@ public:
     virtual void Forward(const Tensor4D& inT, const Mat& in, const PoolDesc& poolDesc, const Tensor4D& outT, Mat& out) = 0;
     virtual void Backward(const Tensor4D& outT, const Mat& out, const Mat& srcGrad, const PoolDesc& poolDesc, const Tensor4D& inT, const Mat& in, Mat& grad) = 0;
 
+    // Max pooling that also saves, for each output, the position of its maximum within the pooling window, as an index
+    // of MaxIndexBytes() bytes in host memory, so that the backward pass is a scatter that needs neither the input nor
+    // the output. Unlike Backward(), only the first of several equal maxima gets the gradient (as in cuDNN).
+    // Only engines for which SupportsMaxIndices() is true implement this.
+    virtual bool SupportsMaxIndices() const
+    {
+        return false;
+    }
+    virtual void ForwardMaxWithIndices(const Tensor4D& inT, const Mat& in, const PoolDesc& poolDesc, const Tensor4D& outT, Mat& out, unsigned char* indices)
+    {
+        NOT_IMPLEMENTED;
+    }
+    virtual void BackwardMaxFromIndices(const Tensor4D& outT, const Mat& srcGrad, const PoolDesc& poolDesc, const Tensor4D& inT, const unsigned char* indices, Mat& grad)
+    {
+        NOT_IMPLEMENTED;
+    }
+    // 1 byte for windows of up to 256 positions, else 2
+    static size_t MaxIndexBytes(const PoolDesc& poolDesc)
+    {
+        return poolDesc.w() * poolDesc.h() <= 256 ? 1 : 2;
+    }
+
 public:
     PoolingEngine(const PoolingEngine&) = delete;
     PoolingEngine& operator=(const PoolingEngine&) = delete;
@@ -323,7 +350,8 @@ public:
     {
         Auto,
         CuDnn,
-        Legacy
+        Legacy,
+        Winograd // Legacy, with dense 3x3 stride-1 forward convolution on the CPU done by Winograd F(2x2, 3x3)
     };
     static std::unique_ptr<ConvolutionEngineFactory<ElemType>> Create(DEVICEID_TYPE deviceId, EngineType engType, ImageLayoutKind imageLayoutKind);
 
@@ -8,6 +8,7 @@
 #include "GPUMatrix.h"
 #ifdef USE_CUDNN
 #include <cudnn.h>
+#include <mutex>
 
 template <>
 const char* CudaErrString<cudnnStatus_t>(cudnnStatus_t x)
@@ -174,6 +175,106 @@ private:
     cudnnPoolingDescriptor_t m_pool;
 };
 
+// -----------------------------------------------------------------------
+// CuDnnAlgoCache -- autotuning results, shared by all convolution engines of the process
+//
+// cudnnFind*() benchmarks all algorithms, which takes long enough that it is done only once per
+// configuration (operation, tensor/filter/convolution shapes, data type, GPU model, cuDNN version and
+// workspace limit), no matter how many engines use it. If the environment variable CNTK_CUDNN_ALGO_CACHE
+// names a file, the results are loaded from it at first use and written back whenever one is added,
+// so that later runs on the same GPU model skip the benchmarks altogether.
+// -----------------------------------------------------------------------
+
+class CuDnnAlgoCache
+{
+public:
+    struct Entry
+    {
+        int algo;
+        size_t memory; // workspace in bytes
+    };
+
+    static CuDnnAlgoCache& Instance()
+    {
+        static CuDnnAlgoCache cache;
+        return cache;
+    }
+
+    bool TryGet(const std::string& key, Entry& entry)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto iter = m_entries.find(key);
+        if (iter == m_entries.end())
+            return false;
+        entry = iter->second;
+        return true;
+    }
+
+    void Add(const std::string& key, const Entry& entry)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries[key] = entry;
+        if (!m_path.empty())
+            Save();
+    }
+
+private:
+    CuDnnAlgoCache()
+    {
+        const char* path = getenv("CNTK_CUDNN_ALGO_CACHE");
+        if (path != nullptr && *path != 0)
+        {
+            m_path = path;
+            Load();
+        }
+    }
+
+    // one line per entry: key algo memory; keys contain no white space
+    void Load()
+    {
+        FILE* f = fopen(m_path.c_str(), "r");
+        if (f == nullptr)
+            return;
+        char key[1024];
+        int algo;
+        unsigned long long memory;
+        while (fscanf(f, "%1023s %d %llu", key, &algo, &memory) == 3)
+            m_entries[key] = Entry{algo, (size_t) memory};
+        fclose(f);
+        fprintf(stderr, "CuDnnAlgoCache: loaded %d autotuning results from '%s'.\n", (int) m_entries.size(), m_path.c_str());
+    }
+
+    // (a failure only costs the benchmarks of the next run, so it is not fatal)
+    void Save() const
+    {
+        FILE* f = fopen(m_path.c_str(), "w");
+        if (f == nullptr)
+        {
+            fprintf(stderr, "CuDnnAlgoCache: cannot write '%s'.\n", m_path.c_str());
+            return;
+        }
+        for (const auto& entry : m_entries)
+            fprintf(f, "%s %d %llu\n", entry.first.c_str(), entry.second.algo, (unsigned long long) entry.second.memory);
+        fclose(f);
+    }
+
+    std::mutex m_mutex;
+    std::string m_path;
+    std::map<std::string, Entry> m_entries;
+};
+
+// name of the current GPU without white space, for the cache keys
+static std::string CurrentGpuName()
+{
+    int deviceId = 0;
+    cudaDeviceProp props = {0};
+    if (cudaGetDevice(&deviceId) != cudaSuccess || cudaGetDeviceProperties(&props, deviceId) != cudaSuccess)
+        return "unknown";
+    std::string name = props.name;
+    std::replace_if(name.begin(), name.end(), [](char c) { return isspace((unsigned char) c) != 0; }, '_');
+    return name;
+}
+
 template <typename CuDnnT, typename In>
 static CuDnnT& As(In& src)
 {
@@ -233,11 +334,13 @@ public:
     using typename Base::Filter;
     using typename Base::ConvDesc;
 
-    CuDnnConvolutionEngine(size_t maxTempMemSizeInSamples)
-        : m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_cudnn(nullptr), m_curMBSize(0)
+    CuDnnConvolutionEngine(DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples)
+        : m_deviceId(deviceId), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_cudnn(nullptr), m_relu(nullptr), m_gpuName(CurrentGpuName())
     {
         CUDNN_CALL(cudnnCreate(&m_cudnn));
         CUDNN_CALL(cudnnSetStream(m_cudnn, GetStream()));
+        CUDNN_CALL(cudnnCreateActivationDescriptor(&m_relu));
+        CUDNN_CALL(cudnnSetActivationDescriptor(m_relu, CUDNN_ACTIVATION_RELU, CUDNN_NOT_PROPAGATE_NAN, 0));
         m_fwdAlgo.status = CUDNN_STATUS_NOT_INITIALIZED;
         m_backDataAlgo.status = CUDNN_STATUS_NOT_INITIALIZED;
         m_backFiltAlgo.status = CUDNN_STATUS_NOT_INITIALIZED;
@@ -245,6 +348,11 @@ public:
 
     ~CuDnnConvolutionEngine()
     {
+        if (m_relu != nullptr)
+        {
+            cudnnDestroyActivationDescriptor(m_relu);
+            m_relu = nullptr;
+        }
         if (m_cudnn != nullptr)
         {
             cudnnDestroy(m_cudnn);
@@ -254,7 +362,7 @@ public:
 
 public:
     void Forward(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
-                 const Tensor4D& outT, Mat& out, Mat& workspace) override
+                 const Tensor4D& outT, Mat& out, Mat& /*workspace: SharedWorkspace() is used instead*/) override
     {
         assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
         assert(inT.n() == in.GetNumCols());
@@ -265,15 +373,27 @@ public:
 
         // Find best algo and allocate temp buffer, if needed.
         FindBestForwardAlgo(t(inT), f(filterT), cd(convDesc), t(outT));
-        if (m_fwdAlgo.memory > 0)
-            workspace.Resize((m_fwdAlgo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
         // Perform forward convolution operation.
         CUDNN_CALL(cudnnConvolutionForward(m_cudnn, &C::One, t(inT), ptr(in), f(filterT), ptr(filter), cd(convDesc), m_fwdAlgo.algo,
-                                           ptr(workspace), m_fwdAlgo.memory, &C::Zero, t(outT), ptr(out)));
+                                           SharedWorkspace(m_fwdAlgo.memory), m_fwdAlgo.memory, &C::Zero, t(outT), ptr(out)));
+    }
+
+    // The bias and the activation are applied in place to the output of the convolution, so that no other buffer of its
+    // size is needed. (cudnnConvolutionBiasActivationForward(), which does all in one kernel, needs cuDNN 6.)
+    void ForwardBiasActivation(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
+                               const Tensor4D& biasT, const Mat& bias, bool relu, const Tensor4D& outT, Mat& out, Mat& workspace) override
+    {
+        assert(biasT.c() == outT.c());
+        assert(bias.GetNumElements() == biasT.c());
+
+        Forward(inT, in, filterT, filter, convDesc, outT, out, workspace);
+        CUDNN_CALL(cudnnAddTensor(m_cudnn, &C::One, t(biasT), ptr(bias), &C::One, t(outT), ptr(out)));
+        if (relu)
+            CUDNN_CALL(cudnnActivationForward(m_cudnn, m_relu, &C::One, t(outT), ptr(out), &C::Zero, t(outT), ptr(out)));
     }
 
     void BackwardData(const Tensor4D& srcGradT, const Mat& srcGrad, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
-                      const Tensor4D& gradT, Mat& grad, Mat& workspace) override
+                      const Tensor4D& gradT, Mat& grad, Mat& /*workspace: SharedWorkspace() is used instead*/) override
     {
         assert(srcGradT.w() * srcGradT.h() * srcGradT.c() == srcGrad.GetNumRows());
         assert(srcGradT.n() == srcGrad.GetNumCols());
@@ -286,15 +406,13 @@ public:
 
         // Find best algo and allocate temp buffer, if needed.
         FindBestBackwardDataAlgo(f(filterT), t(srcGradT), cd(convDesc), t(gradT));
-        if (m_backDataAlgo.memory > 0)
-            workspace.Resize((m_backDataAlgo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
         // Compute gradients with respect to the output tensor (data).
         CUDNN_CALL(cudnnConvolutionBackwardData(m_cudnn, &C::One, f(filterT), ptr(filter), t(srcGradT), ptr(srcGrad), cd(convDesc), m_backDataAlgo.algo,
-                                                ptr(workspace), m_backDataAlgo.memory, &C::One, t(gradT), ptr(grad)));
+                                                SharedWorkspace(m_backDataAlgo.memory), m_backDataAlgo.memory, &C::One, t(gradT), ptr(grad)));
     }
 
     void BackwardFilter(const Tensor4D& srcGradT, const Mat& srcGrad, const Tensor4D& inT, const Mat& in, const ConvDesc& convDesc,
-                        const Filter& filterT, Mat& filter, bool /*allowReuse*/, Mat& workspace) override
+                        const Filter& filterT, Mat& filter, bool /*allowReuse*/, Mat& /*workspace: SharedWorkspace() is used instead*/) override
     {
         assert(srcGradT.w() * srcGradT.h() * srcGradT.c() == srcGrad.GetNumRows());
         assert(srcGradT.n() == srcGrad.GetNumCols());
@@ -307,11 +425,9 @@ public:
 
         // Find best algo and allocate temp buffer, if needed.
         FindBestBackwardFilterAlgo(t(inT), t(srcGradT), cd(convDesc), f(filterT));
-        if (m_backFiltAlgo.memory > 0)
-            workspace.Resize((m_backFiltAlgo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
         // Compute gradients with respect to the output tensor (data).
         CUDNN_CALL(cudnnConvolutionBackwardFilter(m_cudnn, &C::One, t(inT), ptr(in), t(srcGradT), ptr(srcGrad), cd(convDesc), m_backFiltAlgo.algo,
-                                                  ptr(workspace), m_backFiltAlgo.memory, &C::One, f(filterT), ptr(filter)));
+                                                  SharedWorkspace(m_backFiltAlgo.memory), m_backFiltAlgo.memory, &C::One, f(filterT), ptr(filter)));
     }
 
     void AddBias(const Tensor4D& outT, const Mat& out, const Tensor4D& biasT, const Mat& bias, Mat& dst) override
@@ -440,83 +556,155 @@ public:
     }
 
 private:
+    // The cache key of a convolution configuration. Padding is implied by the filter size (see CreateConvDescriptor()).
+    std::string AlgoKey(const char* operation, const CuDnnTensor4D& inT, const CuDnnFilter& filtT, const CuDnnConvolutionDescriptor& convDesc,
+                        const CuDnnTensor4D& outT, size_t maxMem) const
+    {
+        char key[512];
+        sprintf(key, "%s:%s:cudnn%d:%s:in%dx%dx%dx%d:filter%dx%dx%dx%d:stride%dx%d%s:out%dx%dx%dx%d:mem%llu",
+                operation, m_gpuName.c_str(), (int) CUDNN_VERSION, sizeof(ElemType) == sizeof(float) ? "float" : "double",
+                (int) inT.w(), (int) inT.h(), (int) inT.c(), (int) inT.n(),
+                (int) filtT.w(), (int) filtT.h(), (int) filtT.c(), (int) filtT.k(),
+                (int) convDesc.wStride(), (int) convDesc.hStride(), convDesc.padding() ? "pad" : "",
+                (int) outT.w(), (int) outT.h(), (int) outT.c(), (int) outT.n(), (unsigned long long) maxMem);
+        return key;
+    }
+
+    size_t MaxWorkspaceSize(const CuDnnTensor4D& inT) const
+    {
+        return m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : inT.w() * inT.h() * inT.c() * m_maxTempMemSizeInSamples * sizeof(ElemType);
+    }
+
+    // Algorithms are re-selected whenever the configuration changes (e.g. the minibatch size),
+    // but benchmarked only the first time a configuration is seen in this process (or in the cache file).
     void FindBestForwardAlgo(const CuDnnTensor4D& inT, const CuDnnFilter& filtT, const CuDnnConvolutionDescriptor& convDesc, const CuDnnTensor4D& outT)
     {
-        // Need to re-run auto-tuner in case batch size has been changed.
-        // We assume no other dimensions of tensors can change so we don't check it.
-        // REVIEW alexeyk: is this a safe assumption? Can convolution configuration change in runtime?
-        if (m_fwdAlgo.status == CUDNN_STATUS_SUCCESS && inT.n() == m_curMBSize && outT.n() == m_curMBSize)
+        size_t maxMem = MaxWorkspaceSize(inT);
+        std::string key = AlgoKey("fwd", inT, filtT, convDesc, outT, maxMem);
+        if (key == m_fwdKey)
             return;
-        const int MaxAlgoCount = 10;
-        int calgo = 0;
-        cudnnConvolutionFwdAlgoPerf_t algoPerf[MaxAlgoCount];
-        CUDNN_CALL(cudnnFindConvolutionForwardAlgorithm(m_cudnn, inT, filtT, convDesc, outT, MaxAlgoCount, &calgo, algoPerf));
-        assert(calgo > 0);
-        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : inT.w() * inT.h() * inT.c() * m_maxTempMemSizeInSamples * sizeof(ElemType);
-        auto res = std::find_if(algoPerf, algoPerf + calgo,
-                                [=](const cudnnConvolutionFwdAlgoPerf_t& cur)
-                                {
-                                    return cur.status == CUDNN_STATUS_SUCCESS && cur.memory <= maxMem;
-                                });
-        if (res == algoPerf + calgo)
-            RuntimeError("cuDNN could not find suitable algorithm for cudnnConvolutionForward.");
-        m_curMBSize = inT.n();
-        m_fwdAlgo = *res;
+        CuDnnAlgoCache::Entry entry;
+        if (!CuDnnAlgoCache::Instance().TryGet(key, entry))
+        {
+            const int MaxAlgoCount = 10;
+            int calgo = 0;
+            cudnnConvolutionFwdAlgoPerf_t algoPerf[MaxAlgoCount];
+            CUDNN_CALL(cudnnFindConvolutionForwardAlgorithm(m_cudnn, inT, filtT, convDesc, outT, MaxAlgoCount, &calgo, algoPerf));
+            assert(calgo > 0);
+            auto res = std::find_if(algoPerf, algoPerf + calgo,
+                                    [=](const cudnnConvolutionFwdAlgoPerf_t& cur)
+                                    {
+                                        return cur.status == CUDNN_STATUS_SUCCESS && cur.memory <= maxMem;
+                                    });
+            if (res == algoPerf + calgo)
+                RuntimeError("cuDNN could not find suitable algorithm for cudnnConvolutionForward.");
+            entry = CuDnnAlgoCache::Entry{(int) res->algo, res->memory};
+            CuDnnAlgoCache::Instance().Add(key, entry);
+        }
+        m_fwdAlgo.algo = (cudnnConvolutionFwdAlgo_t) entry.algo;
+        m_fwdAlgo.memory = entry.memory;
+        m_fwdAlgo.status = CUDNN_STATUS_SUCCESS;
+        m_fwdKey = key;
     }
 
     void FindBestBackwardDataAlgo(const CuDnnFilter& filtT, const CuDnnTensor4D& srcGradT, const CuDnnConvolutionDescriptor& convDesc, const CuDnnTensor4D& gradT)
     {
-        if (m_backDataAlgo.status == CUDNN_STATUS_SUCCESS && srcGradT.n() == m_curMBSize && gradT.n() == m_curMBSize)
+        size_t maxMem = MaxWorkspaceSize(gradT);
+        std::string key = AlgoKey("bwdData", gradT, filtT, convDesc, srcGradT, maxMem);
+        if (key == m_backDataKey)
             return;
-        const int MaxAlgoCount = 10;
-        int calgo = 0;
-        cudnnConvolutionBwdDataAlgoPerf_t algoPerf[MaxAlgoCount];
-        CUDNN_CALL(cudnnFindConvolutionBackwardDataAlgorithm(m_cudnn, filtT, srcGradT, convDesc, gradT, MaxAlgoCount, &calgo, algoPerf));
-        assert(calgo > 0);
-        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : gradT.w() * gradT.h() * gradT.c() * m_maxTempMemSizeInSamples * sizeof(ElemType);
-        auto res = std::find_if(algoPerf, algoPerf + calgo,
-                                [=](const cudnnConvolutionBwdDataAlgoPerf_t& cur)
-                                {
-                                    return cur.status == CUDNN_STATUS_SUCCESS && cur.memory <= maxMem;
-                                });
-        if (res == algoPerf + calgo)
-            RuntimeError("cuDNN could not find suitable algorithm for cudnnConvolutionBackwardData.");
-        m_curMBSize = srcGradT.n();
-        m_backDataAlgo = *res;
+        CuDnnAlgoCache::Entry entry;
+        if (!CuDnnAlgoCache::Instance().TryGet(key, entry))
+        {
+            const int MaxAlgoCount = 10;
+            int calgo = 0;
+            cudnnConvolutionBwdDataAlgoPerf_t algoPerf[MaxAlgoCount];
+            CUDNN_CALL(cudnnFindConvolutionBackwardDataAlgorithm(m_cudnn, filtT, srcGradT, convDesc, gradT, MaxAlgoCount, &calgo, algoPerf));
+            assert(calgo > 0);
+            auto res = std::find_if(algoPerf, algoPerf + calgo,
+                                    [=](const cudnnConvolutionBwdDataAlgoPerf_t& cur)
+                                    {
+                                        return cur.status == CUDNN_STATUS_SUCCESS && cur.memory <= maxMem;
+                                    });
+            if (res == algoPerf + calgo)
+                RuntimeError("cuDNN could not find suitable algorithm for cudnnConvolutionBackwardData.");
+            entry = CuDnnAlgoCache::Entry{(int) res->algo, res->memory};
+            CuDnnAlgoCache::Instance().Add(key, entry);
+        }
+        m_backDataAlgo.algo = (cudnnConvolutionBwdDataAlgo_t) entry.algo;
+        m_backDataAlgo.memory = entry.memory;
+        m_backDataAlgo.status = CUDNN_STATUS_SUCCESS;
+        m_backDataKey = key;
     }
 
     void FindBestBackwardFilterAlgo(const CuDnnTensor4D& inT, const CuDnnTensor4D& srcGradT, const CuDnnConvolutionDescriptor& convDesc, const CuDnnFilter& filtT)
     {
-        if (m_backFiltAlgo.status == CUDNN_STATUS_SUCCESS && inT.n() == m_curMBSize && srcGradT.n() == m_curMBSize)
+        size_t maxMem = MaxWorkspaceSize(inT);
+        std::string key = AlgoKey("bwdFilter", inT, filtT, convDesc, srcGradT, maxMem);
+        if (key == m_backFiltKey)
             return;
-        const int MaxAlgoCount = 10;
-        int calgo = 0;
-        cudnnConvolutionBwdFilterAlgoPerf_t algoPerf[MaxAlgoCount];
-        CUDNN_CALL(cudnnFindConvolutionBackwardFilterAlgorithm(m_cudnn, inT, srcGradT, convDesc, filtT, MaxAlgoCount, &calgo, algoPerf));
-        assert(calgo > 0);
-        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : inT.w() * inT.h() * inT.c() * m_maxTempMemSizeInSamples * sizeof(ElemType);
-        auto res = std::find_if(algoPerf, algoPerf + calgo,
-                                [=](const cudnnConvolutionBwdFilterAlgoPerf_t& cur)
-                                {
-                                    return cur.status == CUDNN_STATUS_SUCCESS && cur.memory <= maxMem;
-                                });
-        if (res == algoPerf + calgo)
-            RuntimeError("cuDNN could not find suitable algorithm for cudnnConvolutionBackwardFilter.");
-        m_curMBSize = inT.n();
-        m_backFiltAlgo = *res;
+        CuDnnAlgoCache::Entry entry;
+        if (!CuDnnAlgoCache::Instance().TryGet(key, entry))
+        {
+            const int MaxAlgoCount = 10;
+            int calgo = 0;
+            cudnnConvolutionBwdFilterAlgoPerf_t algoPerf[MaxAlgoCount];
+            CUDNN_CALL(cudnnFindConvolutionBackwardFilterAlgorithm(m_cudnn, inT, srcGradT, convDesc, filtT, MaxAlgoCount, &calgo, algoPerf));
+            assert(calgo > 0);
+            auto res = std::find_if(algoPerf, algoPerf + calgo,
+                                    [=](const cudnnConvolutionBwdFilterAlgoPerf_t& cur)
+                                    {
+                                        return cur.status == CUDNN_STATUS_SUCCESS && cur.memory <= maxMem;
+                                    });
+            if (res == algoPerf + calgo)
+                RuntimeError("cuDNN could not find suitable algorithm for cudnnConvolutionBackwardFilter.");
+            entry = CuDnnAlgoCache::Entry{(int) res->algo, res->memory};
+            CuDnnAlgoCache::Instance().Add(key, entry);
+        }
+        m_backFiltAlgo.algo = (cudnnConvolutionBwdFilterAlgo_t) entry.algo;
+        m_backFiltAlgo.memory = entry.memory;
+        m_backFiltAlgo.status = CUDNN_STATUS_SUCCESS;
+        m_backFiltKey = key;
+    }
+
+    // One workspace per device, grown to the largest request, instead of one per convolution node.
+    // All engines of a device issue their work on the same stream, so they use it in turn.
+    ElemType* SharedWorkspace(size_t bytes)
+    {
+        if (bytes == 0)
+            return nullptr;
+        static std::mutex workspaceMutex;
+        // (never destroyed: freeing device memory after the CUDA runtime has shut down at exit would fail)
+        static auto* workspaces = new std::map<DEVICEID_TYPE, std::unique_ptr<Mat>>();
+        std::lock_guard<std::mutex> lock(workspaceMutex);
+        auto& workspace = (*workspaces)[m_deviceId];
+        if (!workspace)
+            workspace = std::make_unique<Mat>(m_deviceId);
+        size_t numElements = (bytes + sizeof(ElemType) - 1) / sizeof(ElemType);
+        if (workspace->GetNumElements() < numElements)
+        {
+            ScopedMemoryTag memoryTag(MemoryTag::Workspace);
+            workspace->Resize(numElements, 1);
+        }
+        return ptr(*workspace);
     }
 
 private:
     using C = Consts<ElemType>;
 
     // REVIEW alexeyk: currently limit is set once in ctor though in CNTK it can be, theoretically, changed in runtime.
+    DEVICEID_TYPE m_deviceId;
     size_t m_maxTempMemSizeInSamples;
     cudnnHandle_t m_cudnn;
-    // Current mini-batch size, needed for re-computing statistics in auto-tuner.
-    size_t m_curMBSize;
+    cudnnActivationDescriptor_t m_relu;
+    std::string m_gpuName;
+    // Selected algorithms and the keys of the configurations they were selected for.
     cudnnConvolutionFwdAlgoPerf_t m_fwdAlgo;
     cudnnConvolutionBwdDataAlgoPerf_t m_backDataAlgo;
     cudnnConvolutionBwdFilterAlgoPerf_t m_backFiltAlgo;
+    std::string m_fwdKey;
+    std::string m_backDataKey;
+    std::string m_backFiltKey;
 };
 
 template <class ElemType>
@@ -629,9 +817,9 @@ typename CuDnnConvolutionEngineFactory<ElemType>::PoolDescPtr CuDnnConvolutionEn
 
 template <class ElemType>
 typename CuDnnConvolutionEngineFactory<ElemType>::ConvEnginePtr CuDnnConvolutionEngineFactory<ElemType>::CreateConvEngine(
-    DEVICEID_TYPE /*deviceId*/, size_t maxTempMemSizeInSamples)
+    DEVICEID_TYPE deviceId, size_t maxTempMemSizeInSamples)
 {
-    return std::make_unique<CuDnnConvolutionEngine<ElemType>>(maxTempMemSizeInSamples);
+    return std::make_unique<CuDnnConvolutionEngine<ElemType>>(deviceId, maxTempMemSizeInSamples);
 }
 
 template <class ElemType>
@@ -76,8 +76,14 @@ cudaStream_t GPUDataTransferer<ElemType>::GetFetchStream()
 }
 
 template <class ElemType>
-GPUDataTransferer<ElemType>::GPUDataTransferer(int deviceId, bool useConcurrentStreams)
-    : m_deviceId(deviceId)
+cudaStream_t GPUDataTransferer<ElemType>::GetAssignStream()
+{
+    return m_assignStream;
+}
+
+template <class ElemType>
+GPUDataTransferer<ElemType>::GPUDataTransferer(int deviceId, bool useConcurrentStreams, bool usePrivateStreams)
+    : m_privateFetchStream(NULL), m_privateAssignStream(NULL), m_deviceId(deviceId)
 {
     PrepareDevice(m_deviceId);
 
@@ -85,6 +91,16 @@ GPUDataTransferer<ElemType>::GPUDataTransferer(int deviceId, bool useConcurrentS
     // Note: Do NOT use cudaEventBlockingSync (which supposedly yields the process)--it will totally break cudaEventSynchronize(), causing it to take 50 or 100 ms randomly.
     cudaEventCreateWithFlags(&m_fetchCompleteEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
     cudaEventCreateWithFlags(&m_assignCompleteEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
+    cudaEventCreateWithFlags(&m_computeStreamEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
+
+    if (usePrivateStreams)
+    {
+        // Not the static pair: once that is created non-blocking, the legacy default stream no longer orders the
+        // copies of every other transferer in the process against computation.
+        cudaStreamCreateWithFlags(&m_privateFetchStream, cudaStreamNonBlocking) || "cudaStreamCreateWithFlags failed";
+        cudaStreamCreateWithFlags(&m_privateAssignStream, cudaStreamNonBlocking) || "cudaStreamCreateWithFlags failed";
+        return;
+    }
 
 #pragma warning(disable : 4127)
     if (useConcurrentStreams && (m_fetchStream == NULL))
@@ -98,6 +114,12 @@ template <class ElemType>
 GPUDataTransferer<ElemType>::~GPUDataTransferer()
 {
     // BUGBUG: we don't destroy our streams (they are static variables); we need a static destructor, I am too lazy now
+    if (m_privateFetchStream)
+    {
+        cudaStreamDestroy(m_privateFetchStream);
+        cudaStreamDestroy(m_privateAssignStream);
+    }
+    cudaEventDestroy(m_computeStreamEvent);
     cudaEventDestroy(m_assignCompleteEvent);
     cudaEventDestroy(m_fetchCompleteEvent);
 }
@@ -107,8 +129,8 @@ void GPUDataTransferer<ElemType>::CopyGPUToCPUAsync(ElemType* gpuBuffer, size_t
 {
     PrepareDevice(m_deviceId);
 
-    cudaMemcpyAsync(cpuBuffer, gpuBuffer, numElements * sizeof(ElemType), cudaMemcpyDeviceToHost, m_fetchStream) || "cudaMemcpyAsync failed";
-    cudaEventRecord(m_fetchCompleteEvent, m_fetchStream) || "cudaEventRecord failed";
+    cudaMemcpyAsync(cpuBuffer, gpuBuffer, numElements * sizeof(ElemType), cudaMemcpyDeviceToHost, FetchStream()) || "cudaMemcpyAsync failed";
+    cudaEventRecord(m_fetchCompleteEvent, FetchStream()) || "cudaEventRecord failed";
 }
 
 template <class ElemType>
@@ -124,8 +146,8 @@ void GPUDataTransferer<ElemType>::CopyCPUToGPUAsync(ElemType* cpuBuffer, size_t
 {
     PrepareDevice(m_deviceId);
 
-    cudaMemcpyAsync(gpuBuffer, cpuBuffer, numElements * sizeof(ElemType), cudaMemcpyHostToDevice, m_assignStream) || "cudaMemcpyAsync failed";
-    cudaEventRecord(m_assignCompleteEvent, m_assignStream) || "cudaEventRecord failed";
+    cudaMemcpyAsync(gpuBuffer, cpuBuffer, numElements * sizeof(ElemType), cudaMemcpyHostToDevice, AssignStream()) || "cudaMemcpyAsync failed";
+    cudaEventRecord(m_assignCompleteEvent, AssignStream()) || "cudaEventRecord failed";
 }
 
 template <class ElemType>
@@ -136,6 +158,15 @@ void GPUDataTransferer<ElemType>::WaitForCopyCPUToGPUAsync()
     SyncEvent(m_assignCompleteEvent);
 }
 
+template <class ElemType>
+void GPUDataTransferer<ElemType>::SynchronizeAssignStreamWithComputeStream()
+{
+    PrepareDevice(m_deviceId);
+
+    cudaEventRecord(m_computeStreamEvent, GetStream()) || "cudaEventRecord failed";
+    cudaStreamWaitEvent(AssignStream(), m_computeStreamEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+}
+
 //explicit
 template class GPUDataTransferer<float>;
 template class GPUDataTransferer<double>;
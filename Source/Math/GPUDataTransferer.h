@@ -13,7 +13,9 @@ template <class ElemType>
 class GPUDataTransferer
 {
 public:
-    GPUDataTransferer(int deviceId, bool useConcurrentStreams);
+    // useConcurrentStreams: copy on the process-wide non-blocking fetch and assign streams (shared with MatrixQuantizerGPU)
+    // usePrivateStreams: copy on a non-blocking stream pair owned by this transferer, which no other transferer sees
+    GPUDataTransferer(int deviceId, bool useConcurrentStreams, bool usePrivateStreams = false);
     ~GPUDataTransferer();
 
     // Disallow copy and move construction and assignment
@@ -25,13 +27,20 @@ public:
     void CopyCPUToGPUAsync(ElemType* cpuBuffer, size_t numElements, ElemType* gpuBuffer);
     void WaitForCopyCPUToGPUAsync();
 
+    // make the copies queued from now on by CopyCPUToGPUAsync() wait for the work queued so far on the main compute stream
+    void SynchronizeAssignStreamWithComputeStream();
+
 #ifndef CPUONLY
     static cudaStream_t GetFetchStream();
+    static cudaStream_t GetAssignStream();
 #endif // !CPUONLY
 
 private:
 #ifndef CPUONLY
     static void SyncEvent(cudaEvent_t ev);
+
+    cudaStream_t FetchStream() const { return m_privateFetchStream ? m_privateFetchStream : m_fetchStream; }
+    cudaStream_t AssignStream() const { return m_privateAssignStream ? m_privateAssignStream : m_assignStream; }
 #endif // !CPUONLY
 
 private:
@@ -39,8 +48,12 @@ private:
     static cudaStream_t m_fetchStream;
     static cudaStream_t m_assignStream;
 
+    cudaStream_t m_privateFetchStream; // NULL unless usePrivateStreams
+    cudaStream_t m_privateAssignStream;
+
     mutable cudaEvent_t m_fetchCompleteEvent;
     mutable cudaEvent_t m_assignCompleteEvent;
+    cudaEvent_t m_computeStreamEvent;
 #endif // !CPUONLY
 
     int m_deviceId;
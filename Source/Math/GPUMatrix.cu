@@ -24,7 +24,12 @@
 #include <curand_kernel.h>
 #include "cublas_v2.h"
 #include <assert.h>
+#include <float.h>
 #include <memory>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 
 #pragma comment(lib, "cudart.lib") // instruct linker to reference these libs
 #pragma comment(lib, "cublas.lib")
@@ -48,6 +53,8 @@ bool do_sync = true;
 #ifdef _WIN32
 // thread local storage to access the current stream, initalize to default stream
 __declspec(thread)
+#else
+__thread
 #endif
     cudaStream_t t_stream = cudaStreamDefault;
 
@@ -108,6 +115,296 @@ const char* CudaErrString<curandStatus>(curandStatus)
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// -----------------------------------------------------------------------
+// DeviceBufferCache -- size-bucketed caching allocator for device memory.
+// Each device has free lists keyed by bucket size. A freed buffer is put on
+// its bucket's list and handed to the next request of the same bucket, so
+// that steady-state training with changing minibatch shapes does not call
+// cudaMalloc/cudaFree (which implicitly synchronize the device) at all.
+// GPU work is issued on the current stream (t_stream), so a block freed by
+// one kernel sequence can be reused by the next without events. Blocks freed
+// while ComputeStreams has selected another stream are held back until Join().
+// If the driver runs out of memory, the device's cache is released and the
+// allocation retried once.
+// -----------------------------------------------------------------------
+
+static void ReportFailedAllocation(int deviceId, size_t bytes, cudaError_t result);
+
+class DeviceBufferCache
+{
+    struct DeviceState
+    {
+        std::map<size_t, std::vector<void*>> freeBlocks;              // [bucket bytes] -> cached blocks
+        std::vector<std::pair<size_t, void*>> deferredBlocks;         // (bucket bytes, block) freed on a non-default stream, reusable after Join()
+        std::unordered_map<void*, std::pair<size_t, size_t>> inUse;   // [block] -> (bucket bytes, requested bytes)
+        size_t inUseBytes = 0;     // bucketed bytes handed out
+        size_t requestedBytes = 0; // bytes actually asked for; inUseBytes - requestedBytes is internal fragmentation
+        size_t cachedBytes = 0;    // bytes sitting on the free lists
+        size_t peakBytes = 0;      // max of inUseBytes + cachedBytes, i.e. the most we held from the driver
+        size_t numDriverAllocs = 0;
+        size_t numCacheHits = 0;
+    };
+
+    std::mutex m_mutex;
+    std::map<int, DeviceState> m_devices;
+
+    static const size_t minBucketBytes = 512;
+    static const size_t largeBucketBytes = 1 << 20;
+
+public:
+    // never destroyed: GPUMatrix objects with static lifetime may still free their buffers during process exit
+    static DeviceBufferCache& Instance()
+    {
+        static DeviceBufferCache* instance = new DeviceBufferCache();
+        return *instance;
+    }
+
+    // round a request up to its bucket: powers of two below 1 MB, multiples of 1 MB above
+    static size_t BucketSize(size_t bytes)
+    {
+        if (bytes >= largeBucketBytes)
+            return (bytes + largeBucketBytes - 1) / largeBucketBytes * largeBucketBytes;
+        size_t bucket = minBucketBytes;
+        while (bucket < bytes)
+            bucket <<= 1;
+        return bucket;
+    }
+
+    void* Allocate(int deviceId, size_t bytes)
+    {
+        const size_t bucket = BucketSize(bytes);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& dev = m_devices[deviceId];
+        void* ptr = nullptr;
+        auto iter = dev.freeBlocks.find(bucket);
+        if (iter != dev.freeBlocks.end() && !iter->second.empty())
+        {
+            ptr = iter->second.back();
+            iter->second.pop_back();
+            dev.cachedBytes -= bucket;
+            dev.numCacheHits++;
+        }
+        else
+        {
+            PrepareDevice(deviceId);
+            if (cudaMalloc(&ptr, bucket) != cudaSuccess)
+            {
+                cudaGetLastError(); // clear the error state and retry after handing the cache back to the driver
+                ReleaseCachedNoLock(deviceId, dev);
+                cudaError_t result = cudaMalloc(&ptr, bucket);
+                ReportFailedAllocation(deviceId, bucket, result);
+                CUDA_CALL(result);
+            }
+            dev.numDriverAllocs++;
+        }
+        dev.inUse[ptr] = make_pair(bucket, bytes);
+        dev.inUseBytes += bucket;
+        dev.requestedBytes += bytes;
+        dev.peakBytes = max(dev.peakBytes, dev.inUseBytes + dev.cachedBytes);
+        return ptr;
+    }
+
+    // returns false if the block did not come from the cache (e.g. caching was off when it was allocated)
+    bool Release(int deviceId, void* ptr)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto devIter = m_devices.find(deviceId);
+        if (devIter == m_devices.end())
+            return false;
+        auto& dev = devIter->second;
+        auto iter = dev.inUse.find(ptr);
+        if (iter == dev.inUse.end())
+            return false;
+        const size_t bucket = iter->second.first;
+        dev.inUseBytes -= bucket;
+        dev.requestedBytes -= iter->second.second;
+        dev.inUse.erase(iter);
+        if (t_stream != cudaStreamDefault)
+            dev.deferredBlocks.push_back(make_pair(bucket, ptr));
+        else
+            dev.freeBlocks[bucket].push_back(ptr);
+        dev.cachedBytes += bucket;
+        return true;
+    }
+
+    // called once all streams are joined: blocks freed on other streams are safe to reuse now
+    void ReleaseDeferred(int deviceId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto devIter = m_devices.find(deviceId);
+        if (devIter == m_devices.end())
+            return;
+        auto& dev = devIter->second;
+        for (const auto& block : dev.deferredBlocks)
+            dev.freeBlocks[block.first].push_back(block.second);
+        dev.deferredBlocks.clear();
+    }
+
+    void ReleaseCached(int deviceId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto devIter = m_devices.find(deviceId);
+        if (devIter != m_devices.end())
+            ReleaseCachedNoLock(deviceId, devIter->second);
+    }
+
+    void PrintStatistics(int deviceId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto devIter = m_devices.find(deviceId);
+        if (devIter == m_devices.end())
+            return;
+        const auto& dev = devIter->second;
+        const double MB = 1 << 20;
+        fprintf(stderr, "GPU memory cache on DeviceId = %d: peak = %.1f MB, in use = %.1f MB, cached = %.1f MB, fragmented = %.1f MB; %d driver allocations, %d cache hits\n",
+                deviceId, dev.peakBytes / MB, dev.inUseBytes / MB, dev.cachedBytes / MB, (dev.inUseBytes - dev.requestedBytes) / MB,
+                (int) dev.numDriverAllocs, (int) dev.numCacheHits);
+    }
+
+    void GetStatistics(int deviceId, size_t& inUseBytes, size_t& cachedBytes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto devIter = m_devices.find(deviceId);
+        inUseBytes = devIter != m_devices.end() ? devIter->second.inUseBytes : 0;
+        cachedBytes = devIter != m_devices.end() ? devIter->second.cachedBytes : 0;
+    }
+
+private:
+    void ReleaseCachedNoLock(int deviceId, DeviceState& dev)
+    {
+        PrepareDevice(deviceId);
+        for (auto& bucket : dev.freeBlocks)
+            for (void* ptr : bucket.second)
+                CUDA_CALL(cudaFree(ptr));
+        dev.freeBlocks.clear();
+        dev.cachedBytes = 0;
+        for (const auto& block : dev.deferredBlocks) // (still pending on another stream: keep them)
+            dev.cachedBytes += block.first;
+    }
+};
+
+// -----------------------------------------------------------------------
+// DeviceMemoryAccounting -- the tag and size of every live device buffer, with per-tag totals
+// -----------------------------------------------------------------------
+
+#ifdef _WIN32
+static __declspec(thread)
+#else
+static __thread
+#endif
+    MemoryTag t_memoryTag = MemoryTag::Other;
+
+struct DeviceMemoryUsage
+{
+    size_t currentBytes[(size_t) MemoryTag::Count] = {};
+    size_t peakBytes[(size_t) MemoryTag::Count] = {};
+    size_t totalBytes = 0;
+    size_t peakTotalBytes = 0;
+    std::unordered_map<const void*, std::pair<MemoryTag, size_t>> buffers;
+};
+
+static std::mutex s_memoryUsageMutex;
+static std::map<int, DeviceMemoryUsage>* s_memoryUsage = new std::map<int, DeviceMemoryUsage>(); // (never destroyed, like the DeviceBufferCache)
+
+MemoryTag DeviceMemoryAccounting::CurrentTag()
+{
+    return t_memoryTag;
+}
+
+void DeviceMemoryAccounting::SetCurrentTag(MemoryTag tag)
+{
+    t_memoryTag = tag;
+}
+
+void DeviceMemoryAccounting::OnAllocate(int deviceId, const void* bufferPtr, size_t bytes)
+{
+    if (deviceId < 0 || bufferPtr == nullptr)
+        return;
+    const MemoryTag tag = t_memoryTag;
+    std::lock_guard<std::mutex> lock(s_memoryUsageMutex);
+    auto& usage = (*s_memoryUsage)[deviceId];
+    usage.buffers[bufferPtr] = make_pair(tag, bytes);
+    size_t& current = usage.currentBytes[(size_t) tag];
+    current += bytes;
+    usage.peakBytes[(size_t) tag] = max(usage.peakBytes[(size_t) tag], current);
+    usage.totalBytes += bytes;
+    usage.peakTotalBytes = max(usage.peakTotalBytes, usage.totalBytes);
+}
+
+void DeviceMemoryAccounting::OnFree(int deviceId, const void* bufferPtr)
+{
+    if (deviceId < 0 || bufferPtr == nullptr)
+        return;
+    std::lock_guard<std::mutex> lock(s_memoryUsageMutex);
+    auto devIter = s_memoryUsage->find(deviceId);
+    if (devIter == s_memoryUsage->end())
+        return;
+    auto& usage = devIter->second;
+    auto iter = usage.buffers.find(bufferPtr);
+    if (iter == usage.buffers.end())
+        return;
+    usage.currentBytes[(size_t) iter->second.first] -= iter->second.second;
+    usage.totalBytes -= iter->second.second;
+    usage.buffers.erase(iter);
+}
+
+void DeviceMemoryAccounting::GetUsage(int deviceId, MemoryTag tag, size_t& currentBytes, size_t& peakBytes)
+{
+    std::lock_guard<std::mutex> lock(s_memoryUsageMutex);
+    auto devIter = s_memoryUsage->find(deviceId);
+    currentBytes = devIter != s_memoryUsage->end() ? devIter->second.currentBytes[(size_t) tag] : 0;
+    peakBytes = devIter != s_memoryUsage->end() ? devIter->second.peakBytes[(size_t) tag] : 0;
+}
+
+void DeviceMemoryAccounting::GetTotalUsage(int deviceId, size_t& currentBytes, size_t& peakBytes)
+{
+    std::lock_guard<std::mutex> lock(s_memoryUsageMutex);
+    auto devIter = s_memoryUsage->find(deviceId);
+    currentBytes = devIter != s_memoryUsage->end() ? devIter->second.totalBytes : 0;
+    peakBytes = devIter != s_memoryUsage->end() ? devIter->second.peakTotalBytes : 0;
+}
+
+void DeviceMemoryAccounting::PrintReport(int deviceId)
+{
+    std::lock_guard<std::mutex> lock(s_memoryUsageMutex);
+    auto devIter = s_memoryUsage->find(deviceId);
+    if (devIter == s_memoryUsage->end())
+        return;
+    const auto& usage = devIter->second;
+    const double MB = 1 << 20;
+    fprintf(stderr, "GPU memory on DeviceId = %d: in use = %.1f MB, peak = %.1f MB\n", deviceId, usage.totalBytes / MB, usage.peakTotalBytes / MB);
+    for (size_t tag = 0; tag < (size_t) MemoryTag::Count; tag++)
+    {
+        if (usage.peakBytes[tag] != 0)
+            fprintf(stderr, "\t%-16s in use = %10.1f MB, peak = %10.1f MB\n", TagName((MemoryTag) tag), usage.currentBytes[tag] / MB, usage.peakBytes[tag] / MB);
+    }
+}
+
+const char* DeviceMemoryAccounting::TagName(MemoryTag tag)
+{
+    switch (tag)
+    {
+    case MemoryTag::NodeValue:      return "NodeValue";
+    case MemoryTag::NodeGradient:   return "NodeGradient";
+    case MemoryTag::MatrixPool:     return "MatrixPool";
+    case MemoryTag::OptimizerState: return "OptimizerState";
+    case MemoryTag::Aggregator:     return "Aggregator";
+    case MemoryTag::Reader:         return "Reader";
+    case MemoryTag::Workspace:      return "Workspace";
+    case MemoryTag::Lattice:        return "Lattice";
+    default:                        return "Other";
+    }
+}
+
+// an allocation failed: say who has the memory before CUDA_CALL() throws
+static void ReportFailedAllocation(int deviceId, size_t bytes, cudaError_t result)
+{
+    if (result != cudaErrorMemoryAllocation)
+        return;
+    fprintf(stderr, "Failed to allocate %.1f MB on DeviceId = %d for %s.\n", bytes / (double) (1 << 20), deviceId, DeviceMemoryAccounting::TagName(t_memoryTag));
+    DeviceMemoryAccounting::PrintReport(deviceId);
+}
+
 template <typename AllocatedElemType>
 AllocatedElemType* TracingGPUMemoryAllocator::Allocate(int deviceId, size_t numRows, size_t numCols)
 {
@@ -117,6 +414,7 @@ AllocatedElemType* TracingGPUMemoryAllocator::Allocate(int deviceId, size_t numR
     {
         auto freeAndTotalMemory = GetFreeAndTotalMemoryInMBs(deviceId);
         fprintf(stderr, "Allocated Matrix<%s> (Rows = %d, Cols = %d) buffer on DeviceId = %d, DeviceBufferPointer = %p; GPU Memory Free = %d MB of %d MB\n", typeid(AllocatedElemType).name(), (int) numRows, (int) numCols, (int) deviceId, (void*) deviceBufferPtr, (int) freeAndTotalMemory.first, (int) freeAndTotalMemory.second);
+        PrintMemoryStatistics(deviceId);
         Microsoft::MSR::CNTK::DebugUtil::PrintCallStack();
     }
 
@@ -132,25 +430,35 @@ AllocatedElemType* TracingGPUMemoryAllocator::Allocate(int deviceId, size_t numE
     {
         auto freeAndTotalMemory = GetFreeAndTotalMemoryInMBs(deviceId);
         fprintf(stderr, "Allocated array<%s> (NumElements = %d) on DeviceId = %d, DeviceBufferPointer = %p; GPU Memory Free = %d MB of %d MB\n", typeid(AllocatedElemType).name(), (int) numElements, (int) deviceId, (void*) deviceBufferPtr, (int) freeAndTotalMemory.first, (int) freeAndTotalMemory.second);
+        PrintMemoryStatistics(deviceId);
         Microsoft::MSR::CNTK::DebugUtil::PrintCallStack();
     }
 
     return deviceBufferPtr;
 }
 
+static std::atomic<size_t> s_numAllocations(0); // device allocations and frees so far, see ComputeGraphs::GetAllocationCount()
+
 template <typename AllocatedElemType>
 void TracingGPUMemoryAllocator::Free(int deviceId, AllocatedElemType* bufferPtr, bool ignoreCUDARetCode /*= false*/)
 {
-    PrepareDevice(deviceId);
-    if (ignoreCUDARetCode)
-        cudaFree((void*) bufferPtr);
-    else
-        CUDA_CALL(cudaFree((void*) bufferPtr));
+    s_numAllocations++;
+    DeviceMemoryAccounting::OnFree(deviceId, bufferPtr);
+    // buffers that came out of the cache go back into it; no driver call, no device sync
+    if (!DeviceBufferCache::Instance().Release(deviceId, (void*) bufferPtr))
+    {
+        PrepareDevice(deviceId);
+        if (ignoreCUDARetCode)
+            cudaFree((void*) bufferPtr);
+        else
+            CUDA_CALL(cudaFree((void*) bufferPtr));
+    }
 
     if (IsTraceEnabled())
     {
         auto freeAndTotalMemory = GetFreeAndTotalMemoryInMBs(deviceId);
         fprintf(stderr, "Freed buffer<%s> DeviceBufferPointer = %p on DeviceId = %d; GPU Memory Free = %d MB of %d MB\n", typeid(AllocatedElemType).name(), (void*) bufferPtr, (int) deviceId, (int) freeAndTotalMemory.first, (int) freeAndTotalMemory.second);
+        PrintMemoryStatistics(deviceId);
         Microsoft::MSR::CNTK::DebugUtil::PrintCallStack();
     }
 }
@@ -160,12 +468,273 @@ AllocatedElemType* TracingGPUMemoryAllocator::AllocateNoTrace(int deviceId, size
 {
     AllocatedElemType* deviceBufferPtr;
 
-    PrepareDevice(deviceId);
-    CUDA_CALL(cudaMalloc((void**) &deviceBufferPtr, sizeof(AllocatedElemType) * numElements));
+    s_numAllocations++;
+    const size_t bytes = sizeof(AllocatedElemType) * numElements;
+    if (IsCachingEnabled())
+        deviceBufferPtr = (AllocatedElemType*) DeviceBufferCache::Instance().Allocate(deviceId, bytes);
+    else
+    {
+        PrepareDevice(deviceId);
+        cudaError_t result = cudaMalloc((void**) &deviceBufferPtr, bytes);
+        ReportFailedAllocation(deviceId, bytes, result);
+        CUDA_CALL(result);
+    }
 
+    DeviceMemoryAccounting::OnAllocate(deviceId, deviceBufferPtr, bytes);
     return deviceBufferPtr;
 }
 
+void TracingGPUMemoryAllocator::ReleaseCachedMemory(int deviceId)
+{
+    DeviceBufferCache::Instance().ReleaseCached(deviceId);
+}
+
+// -----------------------------------------------------------------------
+// ComputeStreams -- streams and events are created lazily per device, on first use of their index.
+// The streams are created blocking, i.e. they are ordered with respect to all work on the legacy default
+// stream (e.g. synchronous cudaMemcpy), which keeps host transfers correct without extra events.
+// -----------------------------------------------------------------------
+
+static std::map<int, std::vector<cudaStream_t>> s_computeStreams; // [deviceId] -> streams 1..n (index 0 is the default stream)
+static std::map<int, std::vector<cudaEvent_t>> s_computeEvents;   // [deviceId] -> events numbered by the caller
+static std::map<int, std::vector<cudaEvent_t>> s_joinEvents;      // [deviceId] -> one event per stream, for Join()
+
+static cudaStream_t GetComputeStream(int deviceId, size_t stream)
+{
+    if (stream == 0)
+        return cudaStreamDefault;
+    auto& streams = s_computeStreams[deviceId];
+    while (streams.size() < stream)
+    {
+        PrepareDevice(deviceId);
+        cudaStream_t newStream;
+        CUDA_CALL(cudaStreamCreate(&newStream));
+        streams.push_back(newStream);
+    }
+    return streams[stream - 1];
+}
+
+static cudaEvent_t GetEvent(std::vector<cudaEvent_t>& events, int deviceId, size_t event)
+{
+    while (events.size() <= event)
+    {
+        PrepareDevice(deviceId);
+        cudaEvent_t newEvent;
+        CUDA_CALL(cudaEventCreateWithFlags(&newEvent, cudaEventDisableTiming));
+        events.push_back(newEvent);
+    }
+    return events[event];
+}
+
+void ComputeStreams::Select(int deviceId, size_t stream)
+{
+    if (deviceId < 0)
+        return;
+    SetStream(GetComputeStream(deviceId, stream));
+}
+
+void ComputeStreams::RecordEvent(int deviceId, size_t event)
+{
+    if (deviceId < 0)
+        return;
+    CUDA_CALL(cudaEventRecord(GetEvent(s_computeEvents[deviceId], deviceId, event), t_stream));
+}
+
+void ComputeStreams::WaitEvent(int deviceId, size_t event)
+{
+    if (deviceId < 0)
+        return;
+    CUDA_CALL(cudaStreamWaitEvent(t_stream, GetEvent(s_computeEvents[deviceId], deviceId, event), 0));
+}
+
+void ComputeStreams::Join(int deviceId)
+{
+    if (deviceId < 0)
+        return;
+    // every stream records its end, then every stream waits for all others
+    const size_t numStreams = s_computeStreams[deviceId].size() + 1;
+    auto& joinEvents = s_joinEvents[deviceId];
+    for (size_t s = 0; s < numStreams; s++)
+        CUDA_CALL(cudaEventRecord(GetEvent(joinEvents, deviceId, s), GetComputeStream(deviceId, s)));
+    for (size_t s = 0; s < numStreams; s++)
+        for (size_t other = 0; other < numStreams; other++)
+            if (other != s)
+                CUDA_CALL(cudaStreamWaitEvent(GetComputeStream(deviceId, s), joinEvents[other], 0));
+    SetStream(cudaStreamDefault);
+    DeviceBufferCache::Instance().ReleaseDeferred(deviceId);
+}
+
+// timing events, unlike the events above, are created with timing enabled
+static std::map<int, std::vector<cudaEvent_t>> s_timingEvents; // [deviceId] -> events numbered by the caller
+
+static cudaEvent_t GetTimingEvent(int deviceId, size_t event)
+{
+    auto& events = s_timingEvents[deviceId];
+    while (events.size() <= event)
+    {
+        PrepareDevice(deviceId);
+        cudaEvent_t newEvent;
+        CUDA_CALL(cudaEventCreate(&newEvent));
+        events.push_back(newEvent);
+    }
+    return events[event];
+}
+
+void ComputeTimingEvents::Record(int deviceId, size_t event)
+{
+    if (deviceId < 0)
+        return;
+    CUDA_CALL(cudaEventRecord(GetTimingEvent(deviceId, event), t_stream));
+}
+
+float ComputeTimingEvents::ElapsedMilliseconds(int deviceId, size_t fromEvent, size_t toEvent)
+{
+    if (deviceId < 0)
+        return -1;
+    const cudaEvent_t to = GetTimingEvent(deviceId, toEvent);
+    CUDA_CALL(cudaEventSynchronize(to));
+    float ms;
+    CUDA_CALL(cudaEventElapsedTime(&ms, GetTimingEvent(deviceId, fromEvent), to));
+    return ms;
+}
+
+// -----------------------------------------------------------------------
+// ComputeGraphs -- the capture goes to a stream of its own per device, which does not wait for the default stream:
+// nothing runs in it, and the graph is launched on the default stream.
+// -----------------------------------------------------------------------
+
+static std::map<int, cudaStream_t> s_captureStreams; // [deviceId]
+
+bool ComputeGraphs::IsSupported(int deviceId)
+{
+#if CUDART_VERSION >= 10000
+    return deviceId >= 0;
+#else
+    return false;
+#endif
+}
+
+void ComputeGraphs::BeginCapture(int deviceId)
+{
+#if CUDART_VERSION >= 10000
+    auto& stream = s_captureStreams[deviceId];
+    if (!stream)
+    {
+        PrepareDevice(deviceId);
+        CUDA_CALL(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking));
+    }
+    // (in global mode, calls that are unsafe during a capture, such as cudaMalloc() or a synchronous cudaMemcpy(), fail it)
+    CUDA_CALL(cudaStreamBeginCapture(stream, cudaStreamCaptureModeGlobal));
+    SetStream(stream);
+#else
+    RuntimeError("ComputeGraphs: CUDA graphs need CUDA 10 or later.");
+#endif
+}
+
+void* ComputeGraphs::EndCapture(int deviceId)
+{
+#if CUDART_VERSION >= 10000
+    SetStream(cudaStreamDefault);
+    cudaGraph_t graph = nullptr;
+    cudaGraphExec_t graphExec = nullptr;
+    cudaError_t err = cudaStreamEndCapture(s_captureStreams[deviceId], &graph);
+    if (err == cudaSuccess)
+        err = cudaGraphInstantiate(&graphExec, graph, nullptr, nullptr, 0);
+    if (graph)
+        cudaGraphDestroy(graph);
+    if (err != cudaSuccess)
+    {
+        cudaGetLastError(); // (the failed capture leaves no error behind)
+        return nullptr;
+    }
+    return graphExec;
+#else
+    return nullptr;
+#endif
+}
+
+void ComputeGraphs::Launch(int deviceId, void* graph)
+{
+#if CUDART_VERSION >= 10000
+    PrepareDevice(deviceId);
+    CUDA_CALL(cudaGraphLaunch((cudaGraphExec_t) graph, cudaStreamDefault));
+#else
+    RuntimeError("ComputeGraphs: CUDA graphs need CUDA 10 or later.");
+#endif
+}
+
+void ComputeGraphs::Destroy(void* graph)
+{
+#if CUDART_VERSION >= 10000
+    if (graph)
+        cudaGraphExecDestroy((cudaGraphExec_t) graph);
+#endif
+}
+
+size_t ComputeGraphs::GetAllocationCount()
+{
+    return s_numAllocations;
+}
+
+// -----------------------------------------------------------------------
+// ComputeTransfers -- one transfer stream per device, created non-blocking so that the copies do not wait for the
+// default stream (the compute streams are blocking, and would). Each copy waits for a start event recorded on the
+// selected stream, and records its own event when done, under the same index.
+// -----------------------------------------------------------------------
+
+static std::map<int, cudaStream_t> s_transferStreams;                // [deviceId]
+static std::map<int, std::vector<cudaEvent_t>> s_transferStartEvents; // [deviceId] -> events numbered by the caller
+static std::map<int, std::vector<cudaEvent_t>> s_transferDoneEvents;  // [deviceId] -> same numbering
+static std::mutex s_transferMutex;                                    // (the networks of data-parallel replicas run on threads of their own)
+
+static void StartTransfer(int deviceId, void* dst, const void* src, size_t bytes, cudaMemcpyKind kind, size_t event)
+{
+    std::lock_guard<std::mutex> lock(s_transferMutex);
+    auto& stream = s_transferStreams[deviceId];
+    if (!stream)
+    {
+        PrepareDevice(deviceId);
+        CUDA_CALL(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking));
+    }
+    const cudaEvent_t start = GetEvent(s_transferStartEvents[deviceId], deviceId, event);
+    CUDA_CALL(cudaEventRecord(start, t_stream));
+    CUDA_CALL(cudaStreamWaitEvent(stream, start, 0));
+    CUDA_CALL(cudaMemcpyAsync(dst, src, bytes, kind, stream));
+    CUDA_CALL(cudaEventRecord(GetEvent(s_transferDoneEvents[deviceId], deviceId, event), stream));
+}
+
+void ComputeTransfers::CopyToHost(int deviceId, void* host, const void* device, size_t bytes, size_t event)
+{
+    if (deviceId < 0)
+        return;
+    StartTransfer(deviceId, host, device, bytes, cudaMemcpyDeviceToHost, event);
+}
+
+void ComputeTransfers::CopyToDevice(int deviceId, void* device, const void* host, size_t bytes, size_t event)
+{
+    if (deviceId < 0)
+        return;
+    StartTransfer(deviceId, device, host, bytes, cudaMemcpyHostToDevice, event);
+}
+
+void ComputeTransfers::WaitForTransfer(int deviceId, size_t event)
+{
+    if (deviceId < 0)
+        return;
+    std::lock_guard<std::mutex> lock(s_transferMutex);
+    CUDA_CALL(cudaStreamWaitEvent(t_stream, GetEvent(s_transferDoneEvents[deviceId], deviceId, event), 0));
+}
+
+void TracingGPUMemoryAllocator::PrintMemoryStatistics(int deviceId)
+{
+    DeviceBufferCache::Instance().PrintStatistics(deviceId);
+}
+
+void TracingGPUMemoryAllocator::GetMemoryStatistics(int deviceId, size_t& inUseBytes, size_t& cachedBytes)
+{
+    DeviceBufferCache::Instance().GetStatistics(deviceId, inUseBytes, cachedBytes);
+}
+
 std::pair<size_t, size_t> TracingGPUMemoryAllocator::GetFreeAndTotalMemoryInMBs(int deviceId)
 {
     PrepareDevice(deviceId);
@@ -185,7 +754,12 @@ std::pair<size_t, size_t> TracingGPUMemoryAllocator::GetFreeAndTotalMemoryInMBs(
 // deviceId - the device on which the operation will take place
 void PrepareDevice(DEVICEID_TYPE deviceId)
 {
-    static DEVICEID_TYPE currentDevice = AUTOPLACEMATRIX; // set to anything valid
+    // per thread, like CUDA's current device (threads may work on different GPUs, see DataParallelReplicas)
+#ifdef _WIN32
+    static __declspec(thread) DEVICEID_TYPE currentDevice = AUTOPLACEMATRIX; // set to anything valid
+#else
+    static __thread DEVICEID_TYPE currentDevice = AUTOPLACEMATRIX;
+#endif
     // and if we last set the device to be this device we are good
     if (deviceId == currentDevice)
         return;
@@ -967,6 +1541,64 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddToRowRepeatValuesOf(const GPUMatrix
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignRowStackedColumnsOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& sourceColumns)
+{
+    if (this == &a)
+        LogicError("AssignRowStackedColumnsOf: a is the same as [this]. Does not support inplace operation.");
+
+    if (a.IsEmpty())
+        LogicError("AssignRowStackedColumnsOf: Matrix a is empty.");
+
+    const size_t K = sourceColumns.GetNumRows();
+    Resize(a.GetNumRows() * K, sourceColumns.GetNumCols());
+
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    if (N == 0)
+        return *this;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _assignRowStackedColumnsOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, a.m_pArray, sourceColumns.m_pArray, N, (CUDA_LONG) a.GetNumRows(), (CUDA_LONG) K);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddFromRowStackedColumnsOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& sourceColumns)
+{
+    if (a.IsEmpty())
+        LogicError("AddFromRowStackedColumnsOf: input matrix a is empty.");
+
+    const size_t K = sourceColumns.GetNumRows();
+    if (a.GetNumRows() != GetNumRows() * K || a.GetNumCols() != sourceColumns.GetNumCols())
+        LogicError("AddFromRowStackedColumnsOf: a must have GetNumRows() * sourceColumns.GetNumRows() rows and sourceColumns.GetNumCols() columns.");
+
+    CUDA_LONG N = (CUDA_LONG) a.GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _addFromRowStackedColumnsOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, a.m_pArray, sourceColumns.m_pArray, N, (CUDA_LONG) GetNumRows(), (CUDA_LONG) K);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignPositiveAndShiftedNegSample(const GPUMatrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber)
 {
@@ -1281,10 +1913,69 @@ void GPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, i
     m_format = matrixFormatDense;
 }
 
-template <class ElemType>
-void GPUMatrix<ElemType>::SetDiagonalValue(const ElemType v)
+// the compact elements of SetValueFromCompact() go into a device buffer that is kept per device and only grows
+// (an upload is ordered on t_stream after the kernels that read the previous one)
+static void* UploadCompactElements(DEVICEID_TYPE deviceId, const void* pArray, size_t numBytes)
 {
-    CUDA_LONG N = (CUDA_LONG) GetNumRows();
+    struct Staging
+    {
+        char* buffer = nullptr;
+        size_t size = 0;
+    };
+    static std::mutex mutex;
+    static std::map<DEVICEID_TYPE, Staging> stagings;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& staging = stagings[deviceId];
+    if (staging.size < numBytes)
+    {
+        if (staging.buffer)
+            TracingGPUMemoryAllocator::Free<char>(deviceId, staging.buffer);
+        staging.size = max(numBytes, 2 * staging.size);
+        staging.buffer = TracingGPUMemoryAllocator::Allocate<char>(deviceId, staging.size);
+    }
+    CUDA_CALL(cudaMemcpyAsync(staging.buffer, pArray, numBytes, cudaMemcpyHostToDevice, t_stream));
+    return staging.buffer;
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::SetValueFromCompact(const size_t numRows, const size_t numCols, int deviceId, const void* pArray, CompactElementType type, ElemType scale, const ElemType* d_rowShift)
+{
+    // as SetValue(): wipe a foreign buffer, move to the requested device
+    if (!OwnBuffer())
+        ZeroInit(deviceId);
+    if (m_computeDevice != deviceId && deviceId >= 0)
+    {
+        Clear();
+        ZeroInit(deviceId);
+    }
+    Resize(numRows, numCols);
+    m_externalBuffer = false;
+    if (IsEmpty())
+        return;
+
+    PrepareDevice();
+    const void* d_compact = UploadCompactElements(m_computeDevice, pArray, GetNumElements() * CompactElementSize(type));
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    if (type == compactElementUInt8)
+        _setValueFromCompact<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, (const unsigned char*) d_compact, scale, d_rowShift, (CUDA_LONG) numRows, N);
+    else
+        _setValueFromCompact<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, (const unsigned short*) d_compact, scale, d_rowShift, (CUDA_LONG) numRows, N);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::SetDiagonalValue(const ElemType v)
+{
+    CUDA_LONG N = (CUDA_LONG) GetNumRows();
     int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
     PrepareDevice();
     cudaEvent_t done = nullptr;
@@ -1334,33 +2025,20 @@ void GPUMatrix<ElemType>::SetDiagonalValue(const GPUMatrix<ElemType>& vector)
     }
 }
 
+// The random fills compute each element on its own (see ResolveRandomSeed() in CommonMatrix.h), giving the same values as CPUMatrix.
 template <class ElemType>
 void GPUMatrix<ElemType>::SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed)
 {
-    PrepareDevice();
-    CreateCurandObject(seed, __FUNCTION__); // TODO call ResetCurandObject() instead?
+    if (IsEmpty())
+        LogicError("SetUniformRandomValue: Matrix is empty.");
 
+    PrepareDevice();
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
     cudaEvent_t done = nullptr;
-    CUDA_CALL(cudaEventCreate(&done));
-    if (sizeof(ElemType) == sizeof(float))
-    {
-        CURAND_CALL(curandGenerateUniform(((curandGenerator_t*) s_curandGenerator)[0], reinterpret_cast<float*>(m_pArray), GetNumElements()));
-    }
-    else
-    {
-        CURAND_CALL(curandGenerateUniformDouble(((curandGenerator_t*) s_curandGenerator)[0], reinterpret_cast<double*>(m_pArray), GetNumElements()));
-    }
-    CUDA_CALL(cudaEventRecord(done));
-    CUDA_CALL(cudaEventSynchronize(done));
-    // CURAND_CALL(curandDestroyGenerator(gen));
-    CUDA_CALL(cudaEventDestroy(done));
-
-    size_t N = GetNumElements();
-    size_t blocksPerGrid = (size_t) ceil(N / (double) GridDim::maxThreadsPerBlock);
-
     if (do_sync)
         CUDA_CALL(cudaEventCreate(&done));
-    _rescaleToRange<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, N, low, high);
+    _setUniformRandomValue<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, N, low, high, ResolveRandomSeed(seed));
     if (do_sync)
         CUDA_CALL(cudaEventRecord(done));
     if (do_sync)
@@ -1372,48 +2050,61 @@ void GPUMatrix<ElemType>::SetUniformRandomValue(const ElemType low, const ElemTy
 template <class ElemType>
 void GPUMatrix<ElemType>::SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed)
 {
+    if (IsEmpty())
+        LogicError("SetGaussianRandomValue: Matrix is empty.");
+
     PrepareDevice();
-    CreateCurandObject(seed, __FUNCTION__); // TODO call ResetCurandObject() instead?
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _addGaussianRandomValue<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, N, 0, mean, sigma, ResolveRandomSeed(seed));
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
 
-    if (sizeof(ElemType) == sizeof(float))
-    {
-        CURAND_CALL(curandGenerateNormal(((curandGenerator_t*) s_curandGenerator)[0], reinterpret_cast<float*>(m_pArray), GetNumElements(), (float) mean, (float) sigma));
-    }
-    else
-    {
-        CURAND_CALL(curandGenerateNormalDouble(((curandGenerator_t*) s_curandGenerator)[0], reinterpret_cast<double*>(m_pArray), GetNumElements(), (double) mean, (double) sigma));
-    }
-    // CURAND_CALL(curandDestroyGenerator(gen));
+template <class ElemType>
+void GPUMatrix<ElemType>::AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed)
+{
+    if (IsEmpty())
+        LogicError("AddGaussianRandomValue: Matrix is empty.");
+
+    PrepareDevice();
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _addGaussianRandomValue<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, N, 1, mean, sigma, ResolveRandomSeed(seed));
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
 }
 
 //maskRate: percentage of values masked out (similar to dropout rate)
 //scaleValue: which scale value to set to the left ones (unmasked items).
+// This is the same mask as AddDropoutOf() applies for the same seed.
 template <class ElemType>
 void GPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, unsigned long seed)
 {
-    PrepareDevice();
-    CreateCurandObject(seed, __FUNCTION__); // TODO call ResetCurandObject() instead?
+    if (IsEmpty())
+        LogicError("SetUniformRandomMask: Matrix is empty.");
 
+    PrepareDevice();
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
     cudaEvent_t done = nullptr;
-    CUDA_CALL(cudaEventCreate(&done));
-    if (sizeof(ElemType) == sizeof(float))
-    {
-        CURAND_CALL(curandGenerateUniform((((curandGenerator_t*) s_curandGenerator)[0]), reinterpret_cast<float*>(m_pArray), GetNumElements()));
-    }
-    else
-    {
-        CURAND_CALL(curandGenerateUniformDouble((((curandGenerator_t*) s_curandGenerator)[0]), reinterpret_cast<double*>(m_pArray), GetNumElements()));
-    }
-    CUDA_CALL(cudaEventRecord(done));
-    CUDA_CALL(cudaEventSynchronize(done));
-    CUDA_CALL(cudaEventDestroy(done));
-    // CURAND_CALL(curandDestroyGenerator(gen));
-
-    size_t N = GetNumElements();
-    size_t blocksPerGrid = (size_t) ceil(N / (double) GridDim::maxThreadsPerBlock);
     if (do_sync)
         CUDA_CALL(cudaEventCreate(&done));
-    _setMaskAndScale<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, N, maskRate, scaleValue);
+    _setUniformRandomMask<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, N, maskRate, scaleValue, ResolveRandomSeed(seed));
     if (do_sync)
         CUDA_CALL(cudaEventRecord(done));
     if (do_sync)
@@ -1488,6 +2179,149 @@ void GPUMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& gradients,
                                                                          learnRatePerSample, momentum, adaWeight, adaMul);
 }
 
+// state layout of LarsUpdate() and LambUpdate(), as in CPUMatrix.cpp
+static size_t NumColsForUpdateState(size_t numRows, size_t numCols, size_t numStates)
+{
+    const size_t numScalars = 4;
+    return numStates * numCols + (numScalars + numRows - 1) / numRows;
+}
+
+// (enough blocks to fill the GPU, but few partial sums to add up atomically)
+static int NumBlocksForNorms(size_t n)
+{
+    return (int) min((n + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock, (size_t) 1024);
+}
+
+// the tables of MultiTensorNormalGrad() go into a device buffer that is kept per device and only grows
+// They are only uploaded when they change, which, as parameters stay where they are, is about once.
+// (the previous call's kernels may still read it; an upload is ordered after them on t_stream)
+static void* UploadMultiTensorTables(DEVICEID_TYPE deviceId, const std::vector<char>& tables, size_t bytesNeeded)
+{
+    struct Scratch
+    {
+        char* buffer = nullptr;
+        size_t size = 0;
+        std::vector<char> uploaded;
+    };
+    static std::mutex mutex;
+    static std::map<DEVICEID_TYPE, Scratch> scratches;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& scratch = scratches[deviceId];
+    if (scratch.size < bytesNeeded)
+    {
+        if (scratch.buffer)
+            TracingGPUMemoryAllocator::Free<char>(deviceId, scratch.buffer);
+        scratch.size = max(bytesNeeded, 2 * scratch.size);
+        scratch.buffer = TracingGPUMemoryAllocator::Allocate<char>(deviceId, scratch.size);
+        scratch.uploaded.clear();
+    }
+    if (scratch.uploaded != tables)
+    {
+        CUDA_CALL(cudaMemcpyAsync(scratch.buffer, tables.data(), tables.size(), cudaMemcpyHostToDevice, t_stream));
+        CUDA_CALL(cudaStreamSynchronize(t_stream)); // (from a temporary host buffer; this happens about once, so waiting is fine)
+        scratch.uploaded = tables;
+    }
+    return scratch.buffer;
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::MultiTensorNormalGrad(const std::vector<GPUMatrix<ElemType>*>& functionValues, const std::vector<GPUMatrix<ElemType>*>& gradients, const std::vector<GPUMatrix<ElemType>*>& smoothedGradients,
+                                                         ElemType learnRatePerSample, ElemType momentum, bool useNesterovMomentum,
+                                                         ElemType clippingThreshold, bool clipByTruncation, ElemType l2Weight, ElemType l1Threshold)
+{
+    const CUDA_LONG chunkSize = 64 * GridDim::maxThreadsPerBlock;
+    const DEVICEID_TYPE deviceId = functionValues[0]->GetComputeDeviceId();
+    size_t numChunks = 0;
+    for (const auto& gradient : gradients)
+        numChunks += (gradient->GetNumElements() + chunkSize - 1) / chunkSize;
+    if (numChunks == 0)
+        return;
+
+    // (written field by field into zeroed memory, so that the padding compares equal, too)
+    const int clipMode = clippingThreshold == std::numeric_limits<ElemType>::infinity() ? 0 : clipByTruncation ? 1 : 2;
+    const size_t tensorBytes = functionValues.size() * sizeof(MultiTensorEntry<ElemType>);
+    const size_t chunkBytes = numChunks * sizeof(MultiTensorChunk);
+    const size_t chunkOffset = (tensorBytes + 15) / 16 * 16, sumsOffset = (chunkOffset + chunkBytes + 15) / 16 * 16;
+    const size_t sumsBytes = clipMode == 2 ? 2 * functionValues.size() * sizeof(ElemType) : 0;
+    std::vector<char> tables(chunkOffset + chunkBytes, 0);
+    auto* tensors = (MultiTensorEntry<ElemType>*) tables.data();
+    auto* chunks = (MultiTensorChunk*) (tables.data() + chunkOffset);
+    size_t chunk = 0;
+    for (size_t k = 0; k < functionValues.size(); k++)
+    {
+        const CUDA_LONG n = (CUDA_LONG) gradients[k]->GetNumElements();
+        tensors[k].val = functionValues[k]->m_pArray;
+        tensors[k].grad = gradients[k]->m_pArray;
+        tensors[k].smooth = smoothedGradients[k]->m_pArray;
+        tensors[k].size = n;
+        for (CUDA_LONG begin = 0; begin < n; begin += chunkSize, chunk++)
+        {
+            chunks[chunk].tensor = (int) k;
+            chunks[chunk].begin = begin;
+        }
+    }
+
+    functionValues[0]->PrepareDevice();
+    char* scratch = (char*) UploadMultiTensorTables(deviceId, tables, sumsOffset + sumsBytes);
+    auto* d_tensors = (const MultiTensorEntry<ElemType>*) scratch;
+    auto* d_chunks = (const MultiTensorChunk*) (scratch + chunkOffset);
+    auto* d_sums = clipMode == 2 ? (ElemType*) (scratch + sumsOffset) : nullptr;
+    if (clipMode == 2)
+    {
+        CUDA_CALL(cudaMemsetAsync(d_sums, 0, sumsBytes, t_stream));
+        _multiTensorSumOfSquares<ElemType><<<(int) numChunks, GridDim::maxThreadsPerBlock, 0, t_stream>>>(d_tensors, d_chunks, chunkSize, d_sums);
+    }
+    _multiTensorNormalGrad<ElemType><<<(int) numChunks, GridDim::maxThreadsPerBlock, 0, t_stream>>>(d_tensors, d_chunks, chunkSize, d_sums,
+                                                                                                     learnRatePerSample, momentum, useNesterovMomentum,
+                                                                                                     clipMode, clippingThreshold, l2Weight, l1Threshold);
+}
+
+// see CPUMatrix::LarsUpdate(); two passes over W and g: the norms, and the update
+template <class ElemType>
+void GPUMatrix<ElemType>::LarsUpdate(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRate, ElemType momentum, ElemType trustCoefficient)
+{
+    const size_t numColsNeeded = NumColsForUpdateState(gradients.GetNumRows(), gradients.GetNumCols(), 1);
+    if (IsEmpty() || GetNumCols() < numColsNeeded)
+    {
+        Resize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    PrepareDevice();
+    const size_t n = gradients.GetNumElements();
+    ElemType* sums = m_pArray + n;
+    CUDA_CALL(cudaMemsetAsync(sums, 0, 2 * sizeof(ElemType), t_stream));
+    const int blocksPerGrid = NumBlocksForNorms(n);
+    _larsNorms<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>((CUDA_LONG) n, functionValues.m_pArray, gradients.m_pArray, sums);
+    _larsUpdate<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>((CUDA_LONG) n, gradients.m_pArray, m_pArray, functionValues.m_pArray, sums,
+                                                                                    learnRate, momentum, trustCoefficient);
+}
+
+// see CPUMatrix::LambUpdate(); two passes: the moments together with the norms, and the update
+template <class ElemType>
+void GPUMatrix<ElemType>::LambUpdate(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRate, ElemType beta1, ElemType beta2, ElemType epsilon, ElemType weightDecay)
+{
+    const size_t numColsNeeded = NumColsForUpdateState(gradients.GetNumRows(), gradients.GetNumCols(), 2);
+    if (IsEmpty() || GetNumCols() < numColsNeeded)
+    {
+        Resize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    PrepareDevice();
+    const size_t n = gradients.GetNumElements();
+    ElemType* smoothMom = m_pArray;
+    ElemType* smoothSqr = m_pArray + n;
+    ElemType* scalars = m_pArray + 2 * n;
+    CUDA_CALL(cudaMemsetAsync(scalars, 0, 2 * sizeof(ElemType), t_stream));
+    const int blocksPerGrid = NumBlocksForNorms(n);
+    _lambMoments<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>((CUDA_LONG) n, gradients.m_pArray, smoothMom, smoothSqr, functionValues.m_pArray, scalars,
+                                                                                     beta1, beta2, epsilon, weightDecay);
+    _lambUpdate<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>((CUDA_LONG) n, smoothMom, smoothSqr, functionValues.m_pArray, scalars,
+                                                                                    learnRate, beta1, beta2, epsilon, weightDecay);
+    _lambFinishStep<ElemType><<<1, 1, 0, t_stream>>>(scalars);
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& gradients,
                                       ElemType RMS_GAMMA,
@@ -1959,6 +2793,33 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddElementProductOf(const GPUMatrix<El
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddDropoutOf(const GPUMatrix<ElemType>& a, const ElemType beta, const ElemType dropoutRate, unsigned long seed, size_t offset)
+{
+    if (a.IsEmpty())
+        LogicError("AddDropoutOf: Matrix is empty.");
+
+    if (beta == 0 && this != &a)
+        Resize(a.GetNumRows(), a.GetNumCols());
+    else if (!(a.GetNumRows() == GetNumRows() && a.GetNumCols() == GetNumCols()))
+        InvalidArgument("AddDropoutOf: The input matrix dimensions do not match [this].");
+
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    a.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _addDropoutOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, a.m_pArray, N, beta, dropoutRate, 1 / (1 - dropoutRate), (unsigned long long) seed, (unsigned long long) offset);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::ColumnElementMultiplyWith(const GPUMatrix<ElemType>& a)
 {
@@ -2316,6 +3177,129 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::InplaceLogSoftmax(const bool isColWise
     return *this;
 }
 
+// -----------------------------------------------------------------------
+// KernelLaunchTuner -- launch configuration of a kernel, picked by timing the candidates on first use
+// A kernel that takes part passes a fixed list of candidates (kernel variant and threads per block), the first of
+// which is the default, and a function that launches it with a given one. With GPUKernelTuning enabled, the first
+// launch per (device, kernel, shape class) times all candidates on the current stream and caches the fastest.
+// The shape class is the pair of power-of-two buckets of the two sizes that decide the occupancy, e.g. column
+// height and number of columns. Timing runs the kernel several times, so callers whose output aliases an input pass
+// mayRerun=false; those launches use the cached choice if there is one, and the default otherwise.
+// -----------------------------------------------------------------------
+
+enum ColumnwiseKernelVariant
+{
+    columnwiseBlockPerColumn = 0, // one thread block per column
+    columnwiseWarpPerColumn = 1   // one warp per column, threadsPerBlock / 32 columns per block
+};
+
+struct KernelLaunchConfig
+{
+    int variant;
+    int threadsPerBlock;
+};
+
+class KernelLaunchTuner
+{
+public:
+    template <class LaunchFunction>
+    static void Launch(const char* kernel, CUDA_LONG size1, CUDA_LONG size2, const std::vector<KernelLaunchConfig>& candidates, bool mayRerun, const LaunchFunction& launch)
+    {
+        if (!GPUKernelTuning::IsEnabled() || candidates.size() == 1)
+            return launch(candidates[0]);
+
+        const cudaDeviceProp& props = GridDim::GetDeviceProps();
+        const std::string key = msra::strfun::strprintf("%s/%d.%d/%d/%s/%d/%d", props.name, props.major, props.minor, props.multiProcessorCount, kernel, SizeClass(size1), SizeClass(size2));
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            auto found = s_choices.find(key);
+            if (found != s_choices.end())
+                return launch(found->second);
+        }
+        if (!mayRerun)
+            return launch(candidates[0]);
+
+        // time the candidates; launch errors (e.g. too many threads for this device) just disqualify one
+        const int repeats = 3;
+        cudaEvent_t start, stop;
+        CUDA_CALL(cudaEventCreate(&start));
+        CUDA_CALL(cudaEventCreate(&stop));
+        KernelLaunchConfig best = candidates[0];
+        float bestTime = FLT_MAX;
+        for (const auto& candidate : candidates)
+        {
+            launch(candidate); // (warm-up)
+            CUDA_CALL(cudaEventRecord(start, t_stream));
+            for (int k = 0; k < repeats; k++)
+                launch(candidate);
+            CUDA_CALL(cudaEventRecord(stop, t_stream));
+            CUDA_CALL(cudaEventSynchronize(stop));
+            if (cudaGetLastError() != cudaSuccess)
+                continue;
+            float ms;
+            CUDA_CALL(cudaEventElapsedTime(&ms, start, stop));
+            if (GPUKernelTuning::GetTraceLevel() > 1)
+                fprintf(stderr, "KernelLaunchTuner: %s variant %d with %d threads per block: %.4f ms\n", key.c_str(), candidate.variant, candidate.threadsPerBlock, ms / repeats);
+            if (ms < bestTime)
+            {
+                bestTime = ms;
+                best = candidate;
+            }
+        }
+        CUDA_CALL(cudaEventDestroy(start));
+        CUDA_CALL(cudaEventDestroy(stop));
+        if (GPUKernelTuning::GetTraceLevel() > 0)
+            fprintf(stderr, "KernelLaunchTuner: %s uses variant %d with %d threads per block\n", key.c_str(), best.variant, best.threadsPerBlock);
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_choices[key] = best;
+        }
+        launch(best); // (the output is that of the last candidate timed, which need not be the best)
+    }
+
+private:
+    static int SizeClass(CUDA_LONG size) // ceil(log2(size))
+    {
+        int sizeClass = 0;
+        while (sizeClass < 31 && ((CUDA_LONG) 1 << sizeClass) < size)
+            sizeClass++;
+        return sizeClass;
+    }
+
+    static std::mutex s_mutex;
+    static std::unordered_map<std::string, KernelLaunchConfig> s_choices; // [key] fastest candidate
+};
+
+std::mutex KernelLaunchTuner::s_mutex;
+std::unordered_map<std::string, KernelLaunchConfig> KernelLaunchTuner::s_choices;
+
+template <class ElemType>
+static void LaunchColumnwiseLogSoftmax(const KernelLaunchConfig& config, const ElemType* a, ElemType* us, CUDA_LONG N, CUDA_LONG M)
+{
+    if (config.variant == columnwiseWarpPerColumn)
+    {
+        _assignColumnwiseLogSoftmaxOfWarp<ElemType><<<CeilDiv(N, config.threadsPerBlock / 32), config.threadsPerBlock, 0, t_stream>>>(a, us, N, M);
+        return;
+    }
+    switch (config.threadsPerBlock)
+    {
+    case 512:
+        _assignColumnwiseLogSoftmaxOf<ElemType, 512><<<N, 512, 0, t_stream>>>(a, us, N, M);
+        break;
+    case 256:
+        _assignColumnwiseLogSoftmaxOf<ElemType, 256><<<N, 256, 0, t_stream>>>(a, us, N, M);
+        break;
+    case 128:
+        _assignColumnwiseLogSoftmaxOf<ElemType, 128><<<N, 128, 0, t_stream>>>(a, us, N, M);
+        break;
+    case 64:
+        _assignColumnwiseLogSoftmaxOf<ElemType, 64><<<N, 64, 0, t_stream>>>(a, us, N, M);
+        break;
+    default:
+        LogicError("LaunchColumnwiseLogSoftmax: unsupported block size %d", config.threadsPerBlock);
+    }
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignLogSoftmaxOf(const GPUMatrix<ElemType>& a, const bool isColWise)
 {
@@ -2328,7 +3312,15 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignLogSoftmaxOf(const GPUMatrix<Ele
         cudaEvent_t done = nullptr;
         if (do_sync)
             CUDA_CALL(cudaEventCreate(&done));
-        _assignColumnwiseLogSoftmaxOf<<<N, 512, 0, t_stream>>>(a.m_pArray, m_pArray, N, M);
+        // (timing reruns the kernel, which is not possible in place)
+        static const std::vector<KernelLaunchConfig> candidates = {{columnwiseBlockPerColumn, 512}, {columnwiseBlockPerColumn, 256}, {columnwiseBlockPerColumn, 128},
+                                                                   {columnwiseBlockPerColumn, 64}, {columnwiseWarpPerColumn, 128}, {columnwiseWarpPerColumn, 256}};
+        const ElemType* in = a.m_pArray;
+        ElemType* out = m_pArray;
+        KernelLaunchTuner::Launch("AssignColumnwiseLogSoftmaxOf", M, N, candidates, in != out, [in, out, N, M](const KernelLaunchConfig& config)
+                                  {
+                                      LaunchColumnwiseLogSoftmax(config, in, out, N, M);
+                                  });
         if (do_sync)
             CUDA_CALL(cudaEventRecord(done));
         if (do_sync)
@@ -2990,6 +3982,29 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignFrobeniusNormOf(const GPUMatrix<
     return *this;
 }
 
+// the norm stays on the device, and so does the decision whether to scale; nothing here waits for the GPU
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::ClipFrobeniusNorm(ElemType maxNorm, GPUMatrix<ElemType>& norm)
+{
+    norm.AssignFrobeniusNormOf(*this);
+
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _scaleToMaxNorm<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, N, norm.m_pArray, maxNorm);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+
+    return *this;
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::MatrixNormInf() const
 {
@@ -3156,6 +4171,22 @@ void GPUMatrix<ElemType>::VectorMax(GPUMatrix<ElemType>& maxIndexes, GPUMatrix<E
     maxValues.Resize(topK, n);
     maxIndexes.Resize(topK, n);
 
+    // small k (e.g. top-5 error, beam search): a selection within a block per column, without sorting the matrix
+    if (topK <= 32)
+    {
+        if (topK <= 8)
+            _vectorMaxTopK<256, 8, ElemType><<<n, 256, 0, t_stream>>>(us.m_pArray, maxIndexes.m_pArray, maxValues.m_pArray, m, topK);
+        else
+            _vectorMaxTopK<128, 32, ElemType><<<n, 128, 0, t_stream>>>(us.m_pArray, maxIndexes.m_pArray, maxValues.m_pArray, m, topK);
+        if (do_sync)
+            CUDA_CALL(cudaEventRecord(done));
+        if (do_sync)
+            CUDA_CALL(cudaEventSynchronize(done));
+        if (do_sync)
+            CUDA_CALL(cudaEventDestroy(done));
+        return;
+    }
+
     // To sort matrix columns we use 2-pass _stable_ sort algorithm:
     // 1. Sort by values (descending) with corresponding row/col indexes.
     // 2. Sort by col indices (ascending) with corresponding values/row indices.
@@ -3547,6 +4578,14 @@ static cublasStatus_t cublas_gemm(cublasHandle_t handle, cublasOperation_t trans
 {
     return cublasDgemm(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
 }
+static cublasStatus_t cublas_gemmBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const float* alpha, const float** A, int lda, const float** B, int ldb, const float* beta, float** C, int ldc, int batchCount)
+{
+    return cublasSgemmBatched(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, batchCount);
+}
+static cublasStatus_t cublas_gemmBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const double* alpha, const double** A, int lda, const double** B, int ldb, const double* beta, double** C, int ldc, int batchCount)
+{
+    return cublasDgemmBatched(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, batchCount);
+}
 static cublasStatus_t cublas_axpy(cublasHandle_t handle, int n, const float* alpha, const float* x, int incx, float* y, int incy)
 {
     return cublasSaxpy(handle, n, alpha, x, incx, y, incy);
@@ -3586,6 +4625,29 @@ void GPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix
     c.m_numCols = n;
 }
 
+// c_i = alpha * op(a_i) * op(b_i) + beta * c_i for the batchSize column blocks of a, b and c (see BatchedGemmShape), as one cublas<t>gemmBatched() call
+// The pointer arrays are set up by a kernel on the current stream, so no host-to-device copy or synchronization is needed.
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB,
+                                                      ElemType beta, GPUMatrix<ElemType>& c, size_t batchSize)
+{
+    a.PrepareDevice();
+    if ((a.GetComputeDeviceId() != b.GetComputeDeviceId()) || (b.GetComputeDeviceId() != c.GetComputeDeviceId())) // different GPUs
+        InvalidArgument("All matrices must be on the same GPU");
+    const BatchedGemmShape s = GetBatchedGemmShape(a.m_numRows, a.m_numCols, transposeA, b.m_numRows, b.m_numCols, transposeB, c.m_numRows, c.m_numCols, batchSize);
+
+    // (the scratch matrix goes back to the device buffer cache after the call, in stream order)
+    GPUMatrix<ElemType> pointerArrays(c.GetComputeDeviceId());
+    pointerArrays.Resize((3 * batchSize * sizeof(ElemType*) + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
+    const ElemType** pointers = reinterpret_cast<const ElemType**>(pointerArrays.m_pArray);
+    int blocksPerGrid = (int) ceil(1.0 * batchSize / GridDim::maxThreadsPerBlock);
+    _setBatchedGemmPointers<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(pointers, a.m_pArray, s.strideA, b.m_pArray, s.strideB, c.m_pArray, s.strideC, (CUDA_LONG) batchSize);
+
+    cublasHandle_t cuHandle = GetCublasHandle(b.GetComputeDeviceId());
+    CUBLAS_CALL(cublas_gemmBatched(cuHandle, transposeA ? CUBLAS_OP_T : CUBLAS_OP_N, transposeB ? CUBLAS_OP_T : CUBLAS_OP_N, (int) s.m, (int) s.n, (int) s.k,
+                                   &alpha, pointers, (int) a.m_numRows, pointers + batchSize, (int) b.m_numRows, &beta, const_cast<ElemType**>(pointers + 2 * batchSize), (int) c.m_numRows, (int) batchSize));
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c)
 {
@@ -4040,15 +5102,143 @@ void GPUMatrix<ElemType>::AssignScaledDifference(const GPUMatrix<ElemType>& alph
     }
 }
 
-//c[ci,cj] += a[ai,aj]
 template <class ElemType>
-void GPUMatrix<ElemType>::AddElementToElement(const GPUMatrix<ElemType>& a, const size_t ai, const size_t aj, GPUMatrix<ElemType>& c, const size_t ci, const size_t cj)
+/*static*/ void GPUMatrix<ElemType>::SoftmaxCrossEntropy(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& prediction, GPUMatrix<ElemType>& columnStats)
 {
-    if (ai >= a.GetNumRows() || aj >= a.GetNumCols() ||
-        ci >= c.GetNumRows() || cj >= c.GetNumCols())
-        InvalidArgument("AddElementToElement:  index out of range.");
+    if (labels.GetComputeDeviceId() != prediction.GetComputeDeviceId() || columnStats.GetComputeDeviceId() != prediction.GetComputeDeviceId())
+        InvalidArgument("All matrices must be on the same GPU");
 
-    a.PrepareDevice();
+    CUDA_LONG numCols = (CUDA_LONG) prediction.GetNumCols();
+    columnStats.Resize(numCols, 3);
+    prediction.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    const bool isIndices = labels.GetNumRows() == 1 && prediction.GetNumRows() > 1;
+    _softmaxCrossEntropy<ElemType><<<numCols, 512, 0, t_stream>>>(labels.m_pArray, prediction.m_pArray, columnStats.m_pArray, (CUDA_LONG) prediction.GetNumRows(), numCols, isIndices);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::SoftmaxCrossEntropyBackprop(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& prediction,
+                                                                const GPUMatrix<ElemType>& columnStats, GPUMatrix<ElemType>& predictionGradient)
+{
+    if (alpha.GetNumElements() != 1)
+        InvalidArgument("SoftmaxCrossEntropyBackprop: alpha must be a 1X1 matrix.");
+    if (labels.GetComputeDeviceId() != prediction.GetComputeDeviceId() || predictionGradient.GetComputeDeviceId() != prediction.GetComputeDeviceId())
+        InvalidArgument("All matrices must be on the same GPU");
+
+    CUDA_LONG N = (CUDA_LONG) prediction.GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    const bool isIndices = labels.GetNumRows() == 1 && prediction.GetNumRows() > 1;
+    prediction.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _softmaxCrossEntropyBackprop<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(alpha.m_pArray, labels.m_pArray, prediction.m_pArray, columnStats.m_pArray,
+                                                                                                         predictionGradient.m_pArray, (CUDA_LONG) prediction.GetNumRows(), (CUDA_LONG) prediction.GetNumCols(), N,
+                                                                                                         isIndices);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::HierarchicalSoftmax(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& hidden, const GPUMatrix<ElemType>& weights, const GPUMatrix<ElemType>& paths,
+                                                        GPUMatrix<ElemType>& frameLosses, GPUMatrix<ElemType>& pathGradients)
+{
+    if (labels.GetComputeDeviceId() != hidden.GetComputeDeviceId() || weights.GetComputeDeviceId() != hidden.GetComputeDeviceId() || paths.GetComputeDeviceId() != hidden.GetComputeDeviceId())
+        InvalidArgument("All matrices must be on the same GPU");
+
+    const CUDA_LONG numCols = (CUDA_LONG) hidden.GetNumCols(), depth = (CUDA_LONG) paths.GetNumRows() / 2;
+    frameLosses.Resize(1, numCols);
+    pathGradients.Resize(depth, numCols);
+    if (numCols == 0)
+        return;
+    hidden.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _hierarchicalSoftmax<ElemType><<<numCols, 256, 0, t_stream>>>(labels.m_pArray, hidden.m_pArray, weights.m_pArray, paths.m_pArray, frameLosses.m_pArray, pathGradients.m_pArray,
+                                                                  (CUDA_LONG) hidden.GetNumRows(), depth, (CUDA_LONG) paths.GetNumCols());
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::HierarchicalSoftmaxBackpropHidden(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& weights, const GPUMatrix<ElemType>& paths,
+                                                                      const GPUMatrix<ElemType>& pathGradients, GPUMatrix<ElemType>& hiddenGradient)
+{
+    if (alpha.GetNumElements() != 1)
+        InvalidArgument("HierarchicalSoftmaxBackpropHidden: alpha must be a 1X1 matrix.");
+
+    CUDA_LONG N = (CUDA_LONG) hiddenGradient.GetNumElements();
+    if (N == 0)
+        return;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    hiddenGradient.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _hierarchicalSoftmaxBackpropHidden<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(alpha.m_pArray, labels.m_pArray, weights.m_pArray, paths.m_pArray, pathGradients.m_pArray,
+                                                                                                               hiddenGradient.m_pArray, (CUDA_LONG) hiddenGradient.GetNumRows(),
+                                                                                                               (CUDA_LONG) paths.GetNumRows() / 2, (CUDA_LONG) paths.GetNumCols(), N);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::HierarchicalSoftmaxBackpropWeights(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& hidden, const GPUMatrix<ElemType>& paths,
+                                                                       const GPUMatrix<ElemType>& pathGradients, GPUMatrix<ElemType>& weightsGradient)
+{
+    if (alpha.GetNumElements() != 1)
+        InvalidArgument("HierarchicalSoftmaxBackpropWeights: alpha must be a 1X1 matrix.");
+
+    const CUDA_LONG depth = (CUDA_LONG) paths.GetNumRows() / 2;
+    CUDA_LONG N = (CUDA_LONG) (hidden.GetNumElements() * depth);
+    if (N == 0)
+        return;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    weightsGradient.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _hierarchicalSoftmaxBackpropWeights<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(alpha.m_pArray, labels.m_pArray, hidden.m_pArray, paths.m_pArray, pathGradients.m_pArray,
+                                                                                                                weightsGradient.m_pArray, (CUDA_LONG) hidden.GetNumRows(), depth,
+                                                                                                                (CUDA_LONG) paths.GetNumCols(), N);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+//c[ci,cj] += a[ai,aj]
+template <class ElemType>
+void GPUMatrix<ElemType>::AddElementToElement(const GPUMatrix<ElemType>& a, const size_t ai, const size_t aj, GPUMatrix<ElemType>& c, const size_t ci, const size_t cj)
+{
+    if (ai >= a.GetNumRows() || aj >= a.GetNumCols() ||
+        ci >= c.GetNumRows() || cj >= c.GetNumCols())
+        InvalidArgument("AddElementToElement:  index out of range.");
+
+    a.PrepareDevice();
     cudaEvent_t done = nullptr;
     int blocksPerGrid = 1; // only one element   --BUGBUG: then why not launch only 1 thread per block?
     if (do_sync)
@@ -4342,41 +5532,6 @@ bool GPUMatrix<ElemType>::HasElement(const GPUMatrix<ElemType>& a, const ElemTyp
     return bResult;
 }
 
-template <class ElemType>
-void GPUMatrix<ElemType>::CreateCurandObject(unsigned long seed, const char* caller)
-{
-    assert(caller != nullptr);
-
-    if (s_curandGenerator == NULL)
-    {
-        unsigned long long cudaSeed = (seed == USE_TIME_BASED_SEED) ? time(NULL) : seed;
-        fprintf(stderr, "%s (GPU): creating curand object with seed %llu, sizeof(ElemType)==%u\n",
-                caller, cudaSeed, sizeof(ElemType));
-        s_curandGenerator = new curandGenerator_t;
-        // Create pseudo-random number generator
-        CURAND_CALL(curandCreateGenerator(&(((curandGenerator_t*) s_curandGenerator)[0]), CURAND_RNG_PSEUDO_XORWOW));
-        CURAND_CALL(curandSetPseudoRandomGeneratorSeed(((curandGenerator_t*) s_curandGenerator)[0], cudaSeed));
-        CURAND_CALL(curandSetGeneratorOrdering(((curandGenerator_t*) s_curandGenerator)[0], CURAND_ORDERING_PSEUDO_SEEDED));
-    }
-}
-
-template <class ElemType>
-void GPUMatrix<ElemType>::ResetCurandObject(unsigned long seed, const char* caller)
-{
-    assert(caller != nullptr);
-
-    if (s_curandGenerator && (seed != USE_TIME_BASED_SEED))
-    {
-        // Note: this might be slow.
-        CURAND_CALL(curandSetPseudoRandomGeneratorSeed(((curandGenerator_t*) s_curandGenerator)[0], seed));
-        CURAND_CALL(curandSetGeneratorOffset(((curandGenerator_t*) s_curandGenerator)[0], 0));
-    }
-    else
-    {
-        CreateCurandObject(seed, caller);
-    }
-}
-
 template <class ElemType>
 GPUMatrix<ElemType> GPUMatrix<ElemType>::Ones(const size_t rows, const size_t cols, int deviceId)
 {
@@ -4537,6 +5692,65 @@ void GPUMatrix<ElemType>::InnerProductWithShiftNeg(const GPUMatrix<ElemType>& a,
     }
 }
 
+// see Matrix::AssignCosDistanceWithShiftNeg()
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCosDistanceWithShiftNeg(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB, const size_t shift, const size_t nt)
+{
+    if (a.GetComputeDeviceId() != b.GetComputeDeviceId() || a.GetComputeDeviceId() != invNormA.GetComputeDeviceId() || a.GetComputeDeviceId() != invNormB.GetComputeDeviceId())
+        InvalidArgument("All matrices must be on the same GPU");
+
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AssignCosDistanceWithShiftNeg: Matrix is empty.");
+
+    const int m = (int) a.GetNumRows();
+    const int n = (int) a.GetNumCols();
+    if (b.GetNumRows() != m || b.GetNumCols() != n)
+        InvalidArgument("Matrices a and b should have same dimension.");
+
+    Resize(nt + 1, n);
+
+    PrepareDevice();
+    dim3 thread_tail(DEFAULT_THREAD_PER_DIM, DEFAULT_THREAD_PER_DIM);
+    dim3 block_tail((nt + 1 + DEFAULT_THREAD_PER_DIM - 1) / DEFAULT_THREAD_PER_DIM, (n + DEFAULT_THREAD_PER_DIM - 1) / DEFAULT_THREAD_PER_DIM);
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _assignCosDistanceWithShiftNeg<ElemType><<<block_tail, thread_tail, 0, t_stream>>>(m_pArray, a.m_pArray, b.m_pArray, invNormA.m_pArray, invNormB.m_pArray, m, n, (CUDA_LONG)(shift % n), nt + 1);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+    return *this;
+}
+
+// see Matrix::AddCosDistanceWithShiftNegGradient()
+template <class ElemType>
+void GPUMatrix<ElemType>::AddCosDistanceWithShiftNegGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& cosDistance, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB,
+                                                             const size_t shift, const size_t nt, const bool wrtB, GPUMatrix<ElemType>& inputGradient)
+{
+    if (a.GetComputeDeviceId() != b.GetComputeDeviceId() || a.GetComputeDeviceId() != inputGradient.GetComputeDeviceId() || a.GetComputeDeviceId() != gradient.GetComputeDeviceId())
+        InvalidArgument("All matrices must be on the same GPU");
+
+    const CUDA_LONG m = (CUDA_LONG) a.GetNumRows();
+    const CUDA_LONG n = (CUDA_LONG) a.GetNumCols();
+    CUDA_LONG N = m * n;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    inputGradient.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _addCosDistanceWithShiftNegGradient<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(inputGradient.m_pArray, gradient.m_pArray, cosDistance.m_pArray, a.m_pArray, b.m_pArray,
+                                                                                                              invNormA.m_pArray, invNormB.m_pArray, m, n, (CUDA_LONG)(shift % n), nt + 1, wrtB);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::GetARowByIndex(const GPUMatrix<ElemType>& a, const size_t m)
 {
@@ -4793,6 +6007,271 @@ void GPUMatrix<ElemType>::RCRFTransGrdCompute(const GPUMatrix<ElemType>& lbls,
     TracingGPUMemoryAllocator::Free<ElemType>(alpha.GetComputeDeviceId(), d_zeta);
 };
 
+template <class ElemType>
+static void CheckBatchedCRFArguments(const char* function, const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& posScores, const GPUMatrix<ElemType>& pairScores,
+                                     const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    const size_t numLabels = posScores.GetNumRows();
+    if (numLabels == 0 || pairScores.GetNumRows() != numLabels || pairScores.GetNumCols() != numLabels)
+        InvalidArgument("%s: pair scores must be a square matrix with one row per label.", function);
+    if (labels.GetNumRows() != numLabels || labels.GetNumCols() != posScores.GetNumCols())
+        InvalidArgument("%s: labels and position scores must have the same dimensions.", function);
+    if (sequences.GetNumRows() != 3 || numParallelSequences == 0)
+        InvalidArgument("%s: sequences must have 3 rows (parallel sequence, first time step, end time step).", function);
+}
+
+// threads per block for the kernels that walk the time steps of one sequence per block
+static int ThreadsPerSequenceBlock(size_t numLabels)
+{
+    const size_t warps = (numLabels + 31) / 32;
+    return (int) (warps * 32 < (size_t) GridDim::maxThreadsPerBlock ? warps * 32 : (size_t) GridDim::maxThreadsPerBlock);
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::CRFForwardBackward(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& posScores, const GPUMatrix<ElemType>& pairScores,
+                                             GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& sequenceScores,
+                                             const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    CheckBatchedCRFArguments("CRFForwardBackward", labels, posScores, pairScores, sequences, numParallelSequences);
+    const size_t L = posScores.GetNumRows();
+    const size_t numSequences = sequences.GetNumCols();
+
+    alpha.Resize(L, posScores.GetNumCols());
+    beta.Resize(L, posScores.GetNumCols());
+    alpha.SetValue((ElemType) LZERO);
+    beta.SetValue((ElemType) LZERO);
+    sequenceScores.Resize(1, numSequences);
+    if (numSequences == 0)
+        return;
+
+    posScores.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _crfForwardBackward<ElemType><<<(int) numSequences, ThreadsPerSequenceBlock(L), 0, t_stream>>>(labels.m_pArray, posScores.m_pArray, pairScores.m_pArray, alpha.m_pArray, beta.m_pArray,
+                                                                                                   sequenceScores.m_pArray, sequences.m_pArray, (CUDA_LONG) numParallelSequences, (CUDA_LONG) L);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::CRFTransitionGradient(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& posScores, const GPUMatrix<ElemType>& pairScores,
+                                                const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& grd,
+                                                const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    CheckBatchedCRFArguments("CRFTransitionGradient", labels, posScores, pairScores, sequences, numParallelSequences);
+    const size_t L = posScores.GetNumRows();
+    if (grd.GetNumRows() != L || grd.GetNumCols() != L)
+        InvalidArgument("CRFTransitionGradient: the gradient must have the dimensions of the pair scores.");
+    if (alpha.GetNumRows() != L || alpha.GetNumCols() != posScores.GetNumCols() || beta.GetNumRows() != L || beta.GetNumCols() != posScores.GetNumCols())
+        InvalidArgument("CRFTransitionGradient: alpha and beta must come from CRFForwardBackward() on the same minibatch.");
+
+    CUDA_LONG N = (CUDA_LONG) (L * L);
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    grd.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _crfTransitionGradient<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(labels.m_pArray, posScores.m_pArray, pairScores.m_pArray, alpha.m_pArray, beta.m_pArray,
+                                                                                                  grd.m_pArray, sequences.m_pArray, (CUDA_LONG) sequences.GetNumCols(), (CUDA_LONG) numParallelSequences, (CUDA_LONG) L);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::ViterbiDecode(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& posScores, const GPUMatrix<ElemType>& pairScores,
+                                        GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& backtrace, GPUMatrix<ElemType>& decodedPath,
+                                        const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    CheckBatchedCRFArguments("ViterbiDecode", labels, posScores, pairScores, sequences, numParallelSequences);
+    const size_t L = posScores.GetNumRows();
+    const size_t numSequences = sequences.GetNumCols();
+
+    alpha.Resize(L, posScores.GetNumCols());
+    backtrace.Resize(L, posScores.GetNumCols());
+    decodedPath.Resize(L, posScores.GetNumCols());
+    alpha.SetValue((ElemType) LZERO);
+    backtrace.SetValue(0);
+    decodedPath.SetValue(0);
+    if (numSequences == 0)
+        return;
+
+    posScores.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _viterbiDecode<ElemType><<<(int) numSequences, ThreadsPerSequenceBlock(L), 0, t_stream>>>(labels.m_pArray, posScores.m_pArray, pairScores.m_pArray, alpha.m_pArray, backtrace.m_pArray,
+                                                                                              decodedPath.m_pArray, sequences.m_pArray, (CUDA_LONG) numParallelSequences, (CUDA_LONG) L);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::DenominatorForwardBackward(const GPUMatrix<ElemType>& logLikelihoods, const GPUMatrix<ElemType>& arcs, const GPUMatrix<ElemType>& states,
+                                                     GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& posteriors, GPUMatrix<ElemType>& logDenominators,
+                                                     const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    if (arcs.GetNumRows() != 4 || arcs.GetNumCols() % 2 != 0 || states.GetNumRows() != 4 || states.GetNumCols() < 2)
+        InvalidArgument("DenominatorForwardBackward: arcs must have 4 rows and twice the number of arcs as columns, states 4 rows and one column more than there are states.");
+    if (sequences.GetNumRows() != 3 || numParallelSequences == 0)
+        InvalidArgument("DenominatorForwardBackward: sequences must have 3 rows (parallel sequence, first time step, end time step).");
+    const size_t L = logLikelihoods.GetNumRows();
+    const size_t N = states.GetNumCols() - 1;
+    const size_t numSequences = sequences.GetNumCols();
+
+    alpha.Resize(N, logLikelihoods.GetNumCols());
+    beta.Resize(N, 2 * numSequences);
+    posteriors.Resize(L, logLikelihoods.GetNumCols());
+    alpha.SetValue((ElemType) LZERO);
+    posteriors.SetValue(0);
+    logDenominators.Resize(1, numSequences);
+    if (numSequences == 0)
+        return;
+
+    logLikelihoods.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _denominatorForwardBackward<ElemType><<<(int) numSequences, ThreadsPerSequenceBlock(N), 0, t_stream>>>(logLikelihoods.m_pArray, arcs.m_pArray, states.m_pArray, alpha.m_pArray, beta.m_pArray,
+                                                                                                        posteriors.m_pArray, logDenominators.m_pArray, sequences.m_pArray,
+                                                                                                        (CUDA_LONG) numParallelSequences, (CUDA_LONG) L, (CUDA_LONG) N, (CUDA_LONG) (arcs.GetNumCols() / 2));
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+// the frames are not validated here, since that would need them on the host; see CheckClassConditionalFrames() in CPUMatrix.cpp
+template <class ElemType>
+static void CheckClassConditionalFrames(const char* function, const GPUMatrix<ElemType>& frames)
+{
+    if (frames.GetNumRows() != 5)
+        InvalidArgument("%s: frames must have 5 rows (column, offset, first word, number of words, target word).", function);
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::ClassConditionalLogSoftmax(const GPUMatrix<ElemType>& hidden, const GPUMatrix<ElemType>& weights, const GPUMatrix<ElemType>& frames, const size_t totalNumWords,
+                                                     GPUMatrix<ElemType>& logSoftmax, GPUMatrix<ElemType>& targetLogProbs)
+{
+    if (hidden.GetNumRows() != weights.GetNumRows())
+        InvalidArgument("ClassConditionalLogSoftmax: hidden and weights must have the same number of rows.");
+    CheckClassConditionalFrames("ClassConditionalLogSoftmax", frames);
+    const size_t numFrames = frames.GetNumCols();
+
+    logSoftmax.Resize(1, totalNumWords);
+    targetLogProbs.Resize(1, numFrames);
+    if (numFrames == 0)
+        return;
+
+    hidden.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _classConditionalLogSoftmax<ElemType><<<(int) numFrames, GridDim::maxThreadsPerBlock, 0, t_stream>>>(hidden.m_pArray, weights.m_pArray, frames.m_pArray, logSoftmax.m_pArray,
+                                                                                                        targetLogProbs.m_pArray, (CUDA_LONG) hidden.GetNumRows());
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::ClassConditionalSoftmaxGradient(const GPUMatrix<ElemType>& logSoftmax, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& frames,
+                                                          GPUMatrix<ElemType>& grd)
+{
+    if (gradient.GetNumElements() != 1)
+        InvalidArgument("ClassConditionalSoftmaxGradient: gradient must be a 1x1 matrix.");
+    CheckClassConditionalFrames("ClassConditionalSoftmaxGradient", frames);
+    const size_t numFrames = frames.GetNumCols();
+
+    grd.Resize(1, logSoftmax.GetNumCols());
+    if (numFrames == 0)
+        return;
+
+    logSoftmax.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _classConditionalSoftmaxGradient<ElemType><<<(int) numFrames, GridDim::maxThreadsPerBlock, 0, t_stream>>>(logSoftmax.m_pArray, gradient.m_pArray, frames.m_pArray, grd.m_pArray);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddClassConditionalHiddenGradient(const GPUMatrix<ElemType>& weights, const GPUMatrix<ElemType>& grd, const GPUMatrix<ElemType>& frames,
+                                                            GPUMatrix<ElemType>& hiddenGradient)
+{
+    if (hiddenGradient.GetNumRows() != weights.GetNumRows())
+        InvalidArgument("AddClassConditionalHiddenGradient: hiddenGradient and weights must have the same number of rows.");
+    CheckClassConditionalFrames("AddClassConditionalHiddenGradient", frames);
+    const size_t numFrames = frames.GetNumCols();
+    if (numFrames == 0)
+        return;
+
+    const size_t hd = weights.GetNumRows();
+    const int threadsPerBlock = (int) min((size_t) GridDim::maxThreadsPerBlock, (hd + 31) / 32 * 32);
+    hiddenGradient.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _addClassConditionalHiddenGradient<ElemType><<<(int) numFrames, threadsPerBlock, 0, t_stream>>>(weights.m_pArray, grd.m_pArray, frames.m_pArray, hiddenGradient.m_pArray, (CUDA_LONG) hd);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddClassConditionalWeightGradient(const GPUMatrix<ElemType>& hidden, const GPUMatrix<ElemType>& grd, const GPUMatrix<ElemType>& frames,
+                                                            const GPUMatrix<ElemType>& classes, GPUMatrix<ElemType>& weightGradient)
+{
+    if (hidden.GetNumRows() != weightGradient.GetNumRows())
+        InvalidArgument("AddClassConditionalWeightGradient: hidden and weightGradient must have the same number of rows.");
+    CheckClassConditionalFrames("AddClassConditionalWeightGradient", frames);
+    if (classes.GetNumRows() != 2)
+        InvalidArgument("AddClassConditionalWeightGradient: classes must have 2 rows (first frame, end frame).");
+    const size_t numClasses = classes.GetNumCols();
+    if (numClasses == 0)
+        return;
+
+    // each class is split over a few blocks, since a minibatch may touch only a few classes
+    const dim3 grid((unsigned int) numClasses, 16);
+    weightGradient.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _addClassConditionalWeightGradient<ElemType><<<grid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(hidden.m_pArray, grd.m_pArray, frames.m_pArray, classes.m_pArray,
+                                                                                                   weightGradient.m_pArray, (CUDA_LONG) hidden.GetNumRows());
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
 // -----------------------------------------------------------------------
 // TensorView entry points from Matrix.cpp
 // -----------------------------------------------------------------------
@@ -4819,7 +6298,7 @@ static shared_ptr<GPUMatrix<ElemType>> GetOnesVector(size_t N, DEVICEID_TYPE dev
 // perform unary operation 'op' on a giving 'this', reinterpreting the matrices as tensors as specified by the dims and strides
 // This binds the N-ariness to a template parameter N, and gets the data pointers out from the matrix objects.
 template <class ElemType>
-void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, ElemType alpha, ElementWiseOperator op,
+void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 2>& offsets,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
@@ -4847,6 +6326,7 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
     // Note: A minor risk is that with this, our own reduction function will rarely be used.
     // That function was tested to give the same results with 'double', and nearly the same with 'float' (different summation order matters).
     else if (op == ElementWiseOperator::opCopy && // we are just adding to target without any further operation
+             reductionOp == ElementWiseOperator::opSum &&
 #ifdef _DEBUG
              sizeof(ElemType) == sizeof(float) && // in debug don't shortcut 'double' so we have some test of our own codepath
 #endif
@@ -4869,12 +6349,12 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
 
     // regular case
     else
-        return TensorOpN<ElemType, 2>(beta, array<ElemType*, 2>{a.m_pArray, m_pArray}, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpN<ElemType, 2>(beta, array<ElemType*, 2>{a.m_pArray, m_pArray}, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
 // perform binary operation 'op' on a and b giving 'this', reinterpreting the matrices as tensors as specified by the dims and strides
 template <class ElemType>
-void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType alpha, ElementWiseOperator op,
+void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 3>& offsets,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
@@ -4883,12 +6363,12 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
     if (a.GetComputeDeviceId() != GetComputeDeviceId() || b.GetComputeDeviceId() != GetComputeDeviceId())
         InvalidArgument("All matrices must be on the same GPU");
 
-    return TensorOpN<ElemType, 3>(beta, array<ElemType*, 3>{a.m_pArray, b.m_pArray, m_pArray}, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    return TensorOpN<ElemType, 3>(beta, array<ElemType*, 3>{a.m_pArray, b.m_pArray, m_pArray}, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
 // perform ternary operation 'op' on a, and c giving 'this', reinterpreting the matrices as tensors as specified by the dims and strides
 template <class ElemType>
-void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& c, ElemType alpha, ElementWiseOperator op,
+void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& c, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 4>& offsets,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides)
@@ -4896,7 +6376,107 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
     a.PrepareDevice();
     if (a.GetComputeDeviceId() != GetComputeDeviceId() || b.GetComputeDeviceId() != GetComputeDeviceId() || c.GetComputeDeviceId() != GetComputeDeviceId())
         InvalidArgument("All matrices must be on the same GPU");
-    return TensorOpN<ElemType, 4>(beta, array<ElemType*, 4>{a.m_pArray, b.m_pArray, c.m_pArray, m_pArray}, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    return TensorOpN<ElemType, 4>(beta, array<ElemType*, 4>{a.m_pArray, b.m_pArray, c.m_pArray, m_pArray}, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+}
+
+// execute a fused ElementWiseProgram in a single kernel launch
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::ElementWiseProgramOp(const ElementWiseProgram& program, const ElemType* const* inputs, ElemType* const* outputs, size_t numElements, DEVICEID_TYPE deviceId)
+{
+    PrepareDevice(deviceId);
+    LaunchElementWiseProgram<ElemType>(program, inputs, outputs, numElements);
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::LSTMForwardStep(GPUMatrix<ElemType>& gates, const GPUMatrix<ElemType>& prevCell, GPUMatrix<ElemType>& cell, GPUMatrix<ElemType>& output)
+{
+    CUDA_LONG N = (CUDA_LONG) cell.GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    cell.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _lstmForwardStep<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(N, (CUDA_LONG) cell.GetNumRows(), gates.m_pArray, prevCell.m_pArray, cell.m_pArray, output.m_pArray);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::LSTMBackwardStep(const GPUMatrix<ElemType>& gates, const GPUMatrix<ElemType>& prevCell, const GPUMatrix<ElemType>& cell,
+                                                     const GPUMatrix<ElemType>& outputGradient, GPUMatrix<ElemType>& cellGradient, GPUMatrix<ElemType>& gatesGradient)
+{
+    CUDA_LONG N = (CUDA_LONG) cell.GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    cell.PrepareDevice();
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _lstmBackwardStep<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(N, (CUDA_LONG) cell.GetNumRows(), gates.m_pArray, prevCell.m_pArray, cell.m_pArray,
+                                                                                              outputGradient.m_pArray, cellGradient.m_pArray, gatesGradient.m_pArray);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+// the step counter of _lstmForwardSequence(), kept per device
+static unsigned int* GetLSTMBarrier(DEVICEID_TYPE deviceId)
+{
+    static std::mutex mutex;
+    static std::map<DEVICEID_TYPE, unsigned int*> barriers;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& barrier = barriers[deviceId];
+    if (!barrier)
+        barrier = (unsigned int*) TracingGPUMemoryAllocator::Allocate<char>(deviceId, sizeof(unsigned int));
+    return barrier;
+}
+
+template <class ElemType>
+/*static*/ bool GPUMatrix<ElemType>::LSTMForwardSequence(const GPUMatrix<ElemType>& R, GPUMatrix<ElemType>& gates, const GPUMatrix<char>& resetMask,
+                                                        GPUMatrix<ElemType>& prevOutput, GPUMatrix<ElemType>& prevCell, GPUMatrix<ElemType>& cell, GPUMatrix<ElemType>& output, size_t S)
+{
+    const size_t N = cell.GetNumRows();
+    const size_t T = cell.GetNumCols() / S;
+    // The blocks of the kernel wait for each other. On the default stream, no other such kernel can hold on to
+    // multiprocessors that its blocks are waiting for, while the kernels of other streams do finish.
+    if (N > maxPersistentLSTMCells || N == 0 || T == 0 || t_stream != cudaStreamDefault)
+        return false;
+    cell.PrepareDevice();
+    const cudaDeviceProp& props = GridDim::GetDeviceProps();
+    // at most one block per multiprocessor, each with the rows of R of as few cells as possible
+    const size_t unitsPerBlock = (N + props.multiProcessorCount - 1) / props.multiProcessorCount;
+    const int blocksPerGrid = (int) ((N + unitsPerBlock - 1) / unitsPerBlock);
+    const size_t sharedBytes = 4 * unitsPerBlock * N * sizeof(ElemType);
+#if CUDART_VERSION >= 9000
+    if (sharedBytes > props.sharedMemPerBlockOptin)
+        return false;
+    if (sharedBytes > props.sharedMemPerBlock)
+        CUDA_CALL(cudaFuncSetAttribute(_lstmForwardSequence<ElemType>, cudaFuncAttributeMaxDynamicSharedMemorySize, (int) sharedBytes));
+#else
+    if (sharedBytes > props.sharedMemPerBlock)
+        return false;
+#endif
+
+    unsigned int* barrier = GetLSTMBarrier(cell.GetComputeDeviceId());
+    CUDA_CALL(cudaMemsetAsync(barrier, 0, sizeof(unsigned int), t_stream));
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _lstmForwardSequence<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, sharedBytes, t_stream>>>((CUDA_LONG) N, (CUDA_LONG) S, (CUDA_LONG) T, (CUDA_LONG) unitsPerBlock, R.m_pArray, gates.m_pArray,
+                                                                                                          resetMask.m_pArray, prevOutput.m_pArray, prevCell.m_pArray, cell.m_pArray, output.m_pArray, barrier);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+    return true;
 }
 
 // =======================================================================
@@ -4911,9 +6491,6 @@ template class DeviceBoundNumber<double>;
 template <class ElemType>
 cublasHandle_t GPUMatrix<ElemType>::s_cuHandle[GPUMatrix<ElemType>::MaxGpus] = {0};
 
-template <class ElemType>
-void* GPUMatrix<ElemType>::s_curandGenerator = NULL;
-
 // We use Matrix<char> as the backing store for QuantizedMatrix
 // Let's explicitly instantiate the methods we need for that purpose
 template GPUMatrix<char>::GPUMatrix(const size_t numRows, const size_t numCols, int deviceId);
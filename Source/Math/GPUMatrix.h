@@ -114,7 +114,6 @@ public:
 
 private:
     static cublasHandle_t s_cuHandle[MaxGpus];
-    static void* s_curandGenerator;
 
 // Have to use disable the warning to avoid issues with __declspec(dllexport) on Windows (C4251).
 // Also, NVCC FE corresponding warning has to be disabled, see MathCUDA.vcxproj.
@@ -178,6 +177,11 @@ public:
     ElemType Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier);
     void FSAdagrad(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
     ElemType RmsProp(GPUMatrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
+    void LarsUpdate(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRate, ElemType momentum, ElemType trustCoefficient);
+    void LambUpdate(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRate, ElemType beta1, ElemType beta2, ElemType epsilon, ElemType weightDecay);
+    static void MultiTensorNormalGrad(const std::vector<GPUMatrix<ElemType>*>& functionValues, const std::vector<GPUMatrix<ElemType>*>& gradients, const std::vector<GPUMatrix<ElemType>*>& smoothedGradients,
+                                      ElemType learnRatePerSample, ElemType momentum, bool useNesterovMomentum,
+                                      ElemType clippingThreshold, bool clipByTruncation, ElemType l2Weight, ElemType l1Threshold);
 
     void Reshape(const size_t numRows, const size_t numCols);
     void Resize(const size_t numRows, const size_t numCols, bool growOnly = true); // by default we only reallocate if need to grow
@@ -201,12 +205,14 @@ public:
 
     void SetValue(const GPUMatrix<ElemType>& deepCopyFrom);
     void SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, size_t matrixFlags = matrixFlagNormal);
+    void SetValueFromCompact(const size_t numRows, const size_t numCols, int deviceId, const void* pArray, CompactElementType type, ElemType scale, const ElemType* d_rowShift);
 
     void SetDiagonalValue(const ElemType v);
     void SetDiagonalValue(const GPUMatrix<ElemType>& vector);
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, unsigned long seed = USE_TIME_BASED_SEED);
+    void AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
 
     GPUMatrix<ElemType> Transpose() const;
     GPUMatrix<ElemType>& AssignTransposeOf(const GPUMatrix<ElemType>& a);
@@ -245,6 +251,8 @@ public:
     GPUMatrix<ElemType>& ElementMultiplyWith(const GPUMatrix<ElemType>& a);
     GPUMatrix<ElemType>& AssignElementProductOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b);
     GPUMatrix<ElemType>& AddElementProductOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b);
+    // [this] = beta * [this] + a .* dropout mask (see DropoutMaskAt() in TensorOps.h)
+    GPUMatrix<ElemType>& AddDropoutOf(const GPUMatrix<ElemType>& a, const ElemType beta, const ElemType dropoutRate, unsigned long seed, size_t offset);
 
     GPUMatrix<ElemType>& AssignElementDivisionOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b);
     GPUMatrix<ElemType>& ElementDivideBy(const GPUMatrix<ElemType>& a);
@@ -334,6 +342,7 @@ public:
 
     ElemType FrobeniusNorm() const;
     GPUMatrix<ElemType>& AssignFrobeniusNormOf(const GPUMatrix<ElemType>& a);
+    GPUMatrix<ElemType>& ClipFrobeniusNorm(ElemType maxNorm, GPUMatrix<ElemType>& norm);
 
     ElemType MatrixNormInf() const;
     ElemType MatrixNorm1() const;
@@ -349,6 +358,8 @@ public:
 
     GPUMatrix<ElemType>& AssignRepeatOf(const GPUMatrix<ElemType>& a, const size_t numRowRepeats, const size_t numColRepeats);
     GPUMatrix<ElemType>& AddToRowRepeatValuesOf(const GPUMatrix<ElemType>& a, const size_t numRowRepeats);
+    GPUMatrix<ElemType>& AssignRowStackedColumnsOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& sourceColumns);
+    GPUMatrix<ElemType>& AddFromRowStackedColumnsOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& sourceColumns);
 
     GPUMatrix<ElemType>& AssignPositiveAndShiftedNegSample(const GPUMatrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber);
     GPUMatrix<ElemType>& AddFoldedPositiveAndShiftedNegSample(const GPUMatrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber);
@@ -405,6 +416,7 @@ public:
 public:
     // static BLAS functions
     static void MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c);
+    static void BatchMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c, size_t batchSize);
     static void MultiplyAndAdd(const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, GPUMatrix<ElemType>& c);
     static void Multiply(const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, GPUMatrix<ElemType>& c);
     static void Multiply(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
@@ -417,6 +429,19 @@ public:
     static void AddScaledDifference(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
     static void AssignScaledDifference(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
 
+    // see Matrix::SoftmaxCrossEntropy(); alpha must be 1X1
+    static void SoftmaxCrossEntropy(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& prediction, GPUMatrix<ElemType>& columnStats);
+    static void SoftmaxCrossEntropyBackprop(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& prediction,
+                                            const GPUMatrix<ElemType>& columnStats, GPUMatrix<ElemType>& predictionGradient);
+
+    // see Matrix::HierarchicalSoftmax(); alpha must be 1X1
+    static void HierarchicalSoftmax(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& hidden, const GPUMatrix<ElemType>& weights, const GPUMatrix<ElemType>& paths,
+                                    GPUMatrix<ElemType>& frameLosses, GPUMatrix<ElemType>& pathGradients);
+    static void HierarchicalSoftmaxBackpropHidden(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& weights, const GPUMatrix<ElemType>& paths,
+                                                  const GPUMatrix<ElemType>& pathGradients, GPUMatrix<ElemType>& hiddenGradient);
+    static void HierarchicalSoftmaxBackpropWeights(const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& hidden, const GPUMatrix<ElemType>& paths,
+                                                   const GPUMatrix<ElemType>& pathGradients, GPUMatrix<ElemType>& weightsGradient);
+
     static void AddElementToElement(const GPUMatrix<ElemType>& a, const size_t ai, const size_t aj, GPUMatrix<ElemType>& c, const size_t ci, const size_t cj);
 
     // minus one at a specific position
@@ -433,21 +458,30 @@ public:
 
     static void TensorShuffleScaleAndAdd(ElemType keepWeight, const GPUMatrix<ElemType>& a, size_t D, size_t S, size_t M, size_t K, size_t T, ElemType scaleFactor, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
 
-    void TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, ElemType alpha, ElementWiseOperator op,
+    void TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                   const std::array<size_t, 2>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& reducingStrides);
-    void TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType alpha, ElementWiseOperator op,
+    void TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                   const std::array<size_t, 3>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 3>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 3>& reducingStrides);
-    void TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& c, ElemType alpha, ElementWiseOperator op,
+    void TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& c, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                   const std::array<size_t, 4>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
+    // fused elementwise ops over 'numElements' consecutive elements of each input and output (device pointers)
+    static void ElementWiseProgramOp(const ElementWiseProgram& program, const ElemType* const* inputs, ElemType* const* outputs, size_t numElements, DEVICEID_TYPE deviceId);
+
+    // one time step of an LSTM over all parallel sequences (see LSTMForwardStepAt() in TensorOps.h)
+    static void LSTMForwardStep(GPUMatrix<ElemType>& gates, const GPUMatrix<ElemType>& prevCell, GPUMatrix<ElemType>& cell, GPUMatrix<ElemType>& output);
+    static void LSTMBackwardStep(const GPUMatrix<ElemType>& gates, const GPUMatrix<ElemType>& prevCell, const GPUMatrix<ElemType>& cell,
+                                 const GPUMatrix<ElemType>& outputGradient, GPUMatrix<ElemType>& cellGradient, GPUMatrix<ElemType>& gatesGradient);
+    // all time steps of an LSTM in one persistent kernel that keeps R in shared memory (see Matrix::LSTMForwardSequence()); false if it does not apply
+    static const size_t maxPersistentLSTMCells = 512;
+    static bool LSTMForwardSequence(const GPUMatrix<ElemType>& R, GPUMatrix<ElemType>& gates, const GPUMatrix<char>& resetMask,
+                                    GPUMatrix<ElemType>& prevOutput, GPUMatrix<ElemType>& prevCell, GPUMatrix<ElemType>& cell, GPUMatrix<ElemType>& output, size_t S);
 
-    static void CreateCurandObject(unsigned long seed, const char* caller);
-    static void ResetCurandObject(unsigned long seed, const char* caller);
     static GPUMatrix<ElemType> Ones(const size_t rows, const size_t cols, int deviceId);
     static GPUMatrix<ElemType> Zeros(const size_t rows, const size_t cols, int deviceId);
     static GPUMatrix<ElemType> Eye(const size_t rows, int deviceId);
@@ -467,6 +501,8 @@ public:
     static void ConductRowElementMultiplyWithShift(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c, const size_t shift, const bool isafixed);
 
     GPUMatrix<ElemType>& AssignElementProductOfWithShift(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const size_t shift);
+    GPUMatrix<ElemType>& AssignCosDistanceWithShiftNeg(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB, const size_t shift, const size_t nt);
+    static void AddCosDistanceWithShiftNegGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& cosDistance, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB, const size_t shift, const size_t nt, const bool wrtB, GPUMatrix<ElemType>& inputGradient);
 
 public:
     static void RCRFBackwardCompute(
@@ -481,10 +517,39 @@ public:
                                     const int startLbl, // the time 0 start symbol in the output layer
                                     const int shift);
 
+    // batched CRF and Viterbi over all sequences of a minibatch (see Matrix.h)
+    static void CRFForwardBackward(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& posScores, const GPUMatrix<ElemType>& pairScores,
+                                   GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& sequenceScores,
+                                   const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences);
+    static void CRFTransitionGradient(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& posScores, const GPUMatrix<ElemType>& pairScores,
+                                      const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& grd,
+                                      const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences);
+    static void ViterbiDecode(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& posScores, const GPUMatrix<ElemType>& pairScores,
+                              GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& backtrace, GPUMatrix<ElemType>& decodedPath,
+                              const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences);
+
+    // batched denominator-graph forward-backward over all sequences of a minibatch (see Matrix.h)
+    static void DenominatorForwardBackward(const GPUMatrix<ElemType>& logLikelihoods, const GPUMatrix<ElemType>& arcs, const GPUMatrix<ElemType>& states,
+                                           GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& posteriors, GPUMatrix<ElemType>& logDenominators,
+                                           const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences);
+
+    // batched class-based softmax over all frames of a minibatch (see Matrix.h)
+    static void ClassConditionalLogSoftmax(const GPUMatrix<ElemType>& hidden, const GPUMatrix<ElemType>& weights, const GPUMatrix<ElemType>& frames, const size_t totalNumWords,
+                                           GPUMatrix<ElemType>& logSoftmax, GPUMatrix<ElemType>& targetLogProbs);
+    static void ClassConditionalSoftmaxGradient(const GPUMatrix<ElemType>& logSoftmax, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& frames,
+                                                GPUMatrix<ElemType>& grd);
+    static void AddClassConditionalHiddenGradient(const GPUMatrix<ElemType>& weights, const GPUMatrix<ElemType>& grd, const GPUMatrix<ElemType>& frames,
+                                                  GPUMatrix<ElemType>& hiddenGradient);
+    static void AddClassConditionalWeightGradient(const GPUMatrix<ElemType>& hidden, const GPUMatrix<ElemType>& grd, const GPUMatrix<ElemType>& frames,
+                                                  const GPUMatrix<ElemType>& classes, GPUMatrix<ElemType>& weightGradient);
+
 public:
+    // see CPUMatrix for the aligned format; a mapped block is uploaded from the mapping directly
     friend File& operator>>(File& stream, GPUMatrix<ElemType>& us)
     {
-        stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+        const bool isAligned = stream.CanSeek() && stream.TryGetMarker(fileMarkerBeginSection, std::wstring(L"BMATA"));
+        if (!isAligned)
+            stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
         size_t elsize;
         stream >> elsize;
         if (sizeof(ElemType) != elsize)
@@ -493,11 +558,14 @@ public:
         size_t numRows, numCols;
         int format;
         stream >> matrixName >> format >> numRows >> numCols;
-        ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        ElemType* d_array = isAligned && stream.GetMapping() ? nullptr : new ElemType[numRows * numCols];
+        const ElemType* data = d_array;
+        if (isAligned)
+            data = static_cast<const ElemType*>(stream.GetAlignedBlock(numRows * numCols * sizeof(ElemType), d_array));
+        else
+            stream.GetArray(d_array, numRows * numCols);
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
-        us.SetValue(numRows, numCols, us.GetComputeDeviceId(), d_array, matrixFlagNormal | format);
+        us.SetValue(numRows, numCols, us.GetComputeDeviceId(), const_cast<ElemType*>(data), matrixFlagNormal | format);
         delete[] d_array;
         us.m_matrixName = new wchar_t[matrixName.length() + 1];
         wmemcpy(us.m_matrixName, matrixName.c_str(), matrixName.length() + 1);
@@ -506,7 +574,7 @@ public:
     }
     friend File& operator<<(File& stream, const GPUMatrix<ElemType>& us)
     {
-        stream.PutMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+        stream.PutMarker(fileMarkerBeginSection, std::wstring(stream.UsesAlignedBlocks() ? L"BMATA" : L"BMAT"));
         stream << sizeof(ElemType);
 
         std::wstring s = (us.m_matrixName == NULL) ? std::wstring(L"unnamed") : std::wstring(us.m_matrixName);
@@ -515,8 +583,10 @@ public:
 
         stream << us.m_numRows << us.m_numCols;
         ElemType* pArray = us.CopyToArray();
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << pArray[i];
+        if (stream.UsesAlignedBlocks())
+            stream.PutAlignedBlock(pArray, us.GetNumElements() * sizeof(ElemType));
+        else
+            stream.PutArray(pArray, us.GetNumElements());
         delete[] pArray;
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         return stream;
@@ -384,6 +384,37 @@ __global__ void _setValue(
     a[id] = d_v[0];
 };
 
+// a[i] = scale * x[i] + rowShift[i % numRows], x being uint8 or fp16 (as unsigned short)
+__device__ __forceinline__ float _compactToFloat(unsigned char x)
+{
+    return (float) x;
+}
+
+__device__ __forceinline__ float _compactToFloat(unsigned short x)
+{
+    const unsigned int sign = (unsigned int) (x & 0x8000) << 16;
+    const unsigned int exponent = (x >> 10) & 0x1f;
+    const unsigned int mantissa = x & 0x3ff;
+    if (exponent == 0) // denormal, 0
+        return (sign ? -1.0f : 1.0f) * (float) mantissa * 5.9604644775390625e-8f;
+    return __int_as_float(sign | (exponent == 0x1f ? 0x7f800000 : (exponent + 112) << 23) | (mantissa << 13));
+}
+
+template <class ElemType, class CompactType>
+__global__ void _setValueFromCompact(
+    ElemType* a,
+    const CompactType* x,
+    const ElemType scale,
+    const ElemType* rowShift,
+    const CUDA_LONG numRows,
+    const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    a[id] = scale * (ElemType) _compactToFloat(x[id]) + (rowShift ? rowShift[id % numRows] : 0);
+};
+
 template <class ElemType>
 __global__ void _copyColumnsStrided(ElemType* dest, ElemType* src, CUDA_LONG N, CUDA_LONG numRows, CUDA_LONG destNumColsStride, CUDA_LONG srcNumColsStride)
 {
@@ -516,6 +547,43 @@ __global__ void _addToRowRepeatValuesOf(ElemType* dest, ElemType* src, const CUD
     dest[IDX2C(row, col, destRows)] += src[id];
 }
 
+// dest(k * srcRows + i, j) = src(i, sourceColumns(k, j)); N = number of elements of dest, K = rows of sourceColumns
+template <class ElemType>
+__global__ void _assignRowStackedColumnsOf(ElemType* dest, const ElemType* src, const ElemType* sourceColumns, const CUDA_LONG N, const CUDA_LONG srcRows, const CUDA_LONG K)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    const CUDA_LONG destRows = srcRows * K;
+    const CUDA_LONG col = id / destRows;
+    const CUDA_LONG row = id - col * destRows;
+    const CUDA_LONG k = row / srcRows;
+    const CUDA_LONG i = row - k * srcRows;
+
+    const size_t srcCol = (size_t) sourceColumns[IDX2C(k, col, K)]; // (src may have more than 2^31 elements, e.g. an embedding table)
+    dest[id] = src[IDX2C(i, srcCol, srcRows)];
+}
+
+// dest(i, sourceColumns(k, j)) += src(k * destRows + i, j); N = number of elements of src
+// Several source elements may go to the same target, hence atomicAdd().
+template <class ElemType>
+__global__ void _addFromRowStackedColumnsOf(ElemType* dest, const ElemType* src, const ElemType* sourceColumns, const CUDA_LONG N, const CUDA_LONG destRows, const CUDA_LONG K)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    const CUDA_LONG srcRows = destRows * K;
+    const CUDA_LONG col = id / srcRows;
+    const CUDA_LONG row = id - col * srcRows;
+    const CUDA_LONG k = row / destRows;
+    const CUDA_LONG i = row - k * destRows;
+
+    const size_t destCol = (size_t) sourceColumns[IDX2C(k, col, K)];
+    atomicAdd(&dest[IDX2C(i, destCol, destRows)], src[id]);
+}
+
 template <class ElemType>
 __global__ void _assignPositiveAndShiftedNegSample(ElemType* dest, const ElemType* src, const CUDA_LONG N, const CUDA_LONG srcRows, const CUDA_LONG srcCols, const CUDA_LONG destRows, const CUDA_LONG posNumber, const CUDA_LONG shiftNumber)
 {
@@ -605,6 +673,19 @@ __global__ void _multiply1x1AndWeightedAdd(
         c[id] = b[id] * f + c[id] * beta;
 }
 
+// pointer arrays for cublas<t>gemmBatched(): pointers[0..2][i] = a, b, c + i * stride
+template <class ElemType>
+__global__ void _setBatchedGemmPointers(
+    const ElemType** pointers, const ElemType* a, size_t strideA, const ElemType* b, size_t strideB, ElemType* c, size_t strideC, CUDA_LONG batchSize)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= batchSize)
+        return;
+    pointers[id] = a + id * strideA;
+    pointers[batchSize + id] = b + id * strideB;
+    pointers[2 * batchSize + id] = c + id * strideC;
+}
+
 template <class ElemType>
 __global__ void _addValue(
     ElemType* a,
@@ -838,139 +919,333 @@ __global__ void _logSoftMaxColWise(
 //    }
 //}
 
-// each block processes one column. There must be 512 threads in a block
+// one block of 512 threads per column: max, log sum of exp(prediction - max), and cross entropy (see CPUMatrix::SoftmaxCrossEntropy())
+// With 'isIndices', 'labels' are [1 x numCols] class indices, and the target is gathered from the prediction.
 template <class ElemType>
-__global__ void _assignColumnwiseLogSoftmaxOf(
-    const ElemType* a,
-    ElemType* us,
-    const CUDA_LONG m_numCols,
-    const CUDA_LONG m_numRows)
+__global__ void _softmaxCrossEntropy(
+    const ElemType* labels,
+    const ElemType* prediction,
+    ElemType* columnStats, // [numCols x 3]
+    const CUDA_LONG numRows,
+    const CUDA_LONG numCols,
+    const bool isIndices)
 {
-    // We first find max per column
-    __shared__ ElemType colMax[1];
-    __shared__ ElemType partials[512];
-    colMax[0] = -10000000;
-    partials[threadIdx.x] = -10000000;
+    __shared__ ElemType partials[3][512];
+    const ElemType* z = prediction + IDX2C(0, blockIdx.x, numRows);
+    const ElemType* y = labels + (isIndices ? blockIdx.x : IDX2C(0, blockIdx.x, numRows));
 
-    for (int i = threadIdx.x; i < m_numRows; i += 512)
-    {
-        partials[threadIdx.x] = max(partials[threadIdx.x], a[IDX2C(i, blockIdx.x, m_numRows)]);
-    }
+    ElemType maxV = z[0];
+    for (CUDA_LONG i = threadIdx.x; i < numRows; i += 512)
+        maxV = max(maxV, z[i]);
+    partials[0][threadIdx.x] = maxV;
     __syncthreads();
-
-    if (threadIdx.x < 256)
+    for (int s = 256; s > 0; s >>= 1)
     {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 256], partials[threadIdx.x]);
+        if (threadIdx.x < s)
+            partials[0][threadIdx.x] = max(partials[0][threadIdx.x], partials[0][threadIdx.x + s]);
+        __syncthreads();
     }
+    maxV = partials[0][0];
     __syncthreads();
 
-    if (threadIdx.x < 128)
+    ElemType sum = 0, labelSum = 0, crossEntropy = 0;
+    for (CUDA_LONG i = threadIdx.x; i < numRows; i += 512)
     {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 128], partials[threadIdx.x]);
+        const ElemType shifted = z[i] - maxV;
+        sum += exp_(shifted);
+        if (!isIndices && y[i] != 0)
+        {
+            labelSum += y[i];
+            crossEntropy -= y[i] * shifted;
+        }
     }
+    partials[0][threadIdx.x] = sum;
+    partials[1][threadIdx.x] = labelSum;
+    partials[2][threadIdx.x] = crossEntropy;
     __syncthreads();
-
-    if (threadIdx.x < 64)
+    for (int s = 256; s > 0; s >>= 1)
     {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 64], partials[threadIdx.x]);
+        if (threadIdx.x < s)
+        {
+            partials[0][threadIdx.x] += partials[0][threadIdx.x + s];
+            partials[1][threadIdx.x] += partials[1][threadIdx.x + s];
+            partials[2][threadIdx.x] += partials[2][threadIdx.x + s];
+        }
+        __syncthreads();
     }
-    __syncthreads();
-
-    if (threadIdx.x < 32)
+    if (threadIdx.x == 0)
     {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 32], partials[threadIdx.x]);
+        const ElemType logSum = log_(partials[0][0]);
+        if (isIndices)
+        {
+            const bool hasLabel = y[0] >= 0 && y[0] < numRows;
+            partials[1][0] = hasLabel ? 1 : 0;
+            partials[2][0] = hasLabel ? -(z[(CUDA_LONG) y[0]] - maxV) : 0;
+        }
+        columnStats[blockIdx.x] = maxV;
+        columnStats[numCols + blockIdx.x] = logSum;
+        columnStats[2 * numCols + blockIdx.x] = partials[1][0] == 0 ? 0 : partials[2][0] + partials[1][0] * logSum;
     }
-    __syncthreads();
+}
 
-    if (threadIdx.x < 16)
-    {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 16], partials[threadIdx.x]);
+// gradient += alpha * (softmax - labels), one thread per element, with the softmax recomputed from the column statistics
+// (with 'isIndices', the label of an element is 1 if its row is the class index of its column)
+template <class ElemType>
+__global__ void _softmaxCrossEntropyBackprop(
+    const ElemType* alpha,
+    const ElemType* labels,
+    const ElemType* prediction,
+    const ElemType* columnStats,
+    ElemType* gradient,
+    const CUDA_LONG numRows,
+    const CUDA_LONG numCols,
+    const CUDA_LONG N,
+    const bool isIndices)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const CUDA_LONG col = id / numRows;
+    const ElemType softmax = exp_(prediction[id] - columnStats[col] - columnStats[numCols + col]);
+    const ElemType target = isIndices ? (labels[col] == (ElemType)(id - col * numRows) ? 1 : 0) : labels[id];
+    gradient[id] += alpha[0] * (softmax - target);
+}
+
+// one block of 256 threads per frame: the scores of the nodes on the path of its label, and the loss and derivatives (see CPUMatrix::HierarchicalSoftmax())
+template <class ElemType>
+__global__ void _hierarchicalSoftmax(
+    const ElemType* labels,
+    const ElemType* hidden,
+    const ElemType* weights,
+    const ElemType* paths, // [2 * depth x numClasses]
+    ElemType* frameLosses,
+    ElemType* pathGradients, // [depth x numCols]
+    const CUDA_LONG dim,
+    const CUDA_LONG depth,
+    const CUDA_LONG numClasses)
+{
+    __shared__ ElemType partials[256];
+    const CUDA_LONG t = blockIdx.x;
+    const ElemType label = labels[t];
+    const bool hasLabel = label >= 0 && label < numClasses;
+    const ElemType* path = paths + (hasLabel ? IDX2C(0, (CUDA_LONG) label, 2 * depth) : 0);
+    const ElemType* h = hidden + IDX2C(0, t, dim);
+    ElemType loss = 0;
+    for (CUDA_LONG d = 0; d < depth; d++)
+    {
+        const ElemType node = hasLabel ? path[d] : -1;
+        if (node < 0) // (the same for all threads of the block)
+        {
+            if (threadIdx.x == 0)
+                pathGradients[IDX2C(d, t, depth)] = 0;
+            continue;
+        }
+        const ElemType* w = weights + IDX2C(0, (CUDA_LONG) node, dim);
+        ElemType sum = 0;
+        for (CUDA_LONG i = threadIdx.x; i < dim; i += 256)
+            sum += w[i] * h[i];
+        partials[threadIdx.x] = sum;
+        __syncthreads();
+        for (int s = 128; s > 0; s >>= 1)
+        {
+            if (threadIdx.x < s)
+                partials[threadIdx.x] += partials[threadIdx.x + s];
+            __syncthreads();
+        }
+        if (threadIdx.x == 0)
+        {
+            const ElemType sign = path[depth + d];
+            const ElemType z = sign * partials[0];
+            loss += max(-z, (ElemType) 0) + log_(1 + exp_(-fabs_(z)));
+            pathGradients[IDX2C(d, t, depth)] = -sign / (1 + exp_(z));
+        }
+        __syncthreads();
     }
-    __syncthreads();
+    if (threadIdx.x == 0)
+        frameLosses[t] = loss;
+}
 
-    if (threadIdx.x < 8)
-    {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 8], partials[threadIdx.x]);
-    }
-    __syncthreads();
+// hiddenGradient += alpha * the path nodes' weights, weighted by the derivatives of their scores; one thread per element
+template <class ElemType>
+__global__ void _hierarchicalSoftmaxBackpropHidden(
+    const ElemType* alpha,
+    const ElemType* labels,
+    const ElemType* weights,
+    const ElemType* paths,
+    const ElemType* pathGradients,
+    ElemType* hiddenGradient,
+    const CUDA_LONG dim,
+    const CUDA_LONG depth,
+    const CUDA_LONG numClasses,
+    const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const CUDA_LONG t = id / dim;
+    const CUDA_LONG i = id - t * dim;
+    const ElemType label = labels[t];
+    if (!(label >= 0 && label < numClasses))
+        return;
+    const ElemType* path = paths + IDX2C(0, (CUDA_LONG) label, 2 * depth);
+    ElemType sum = 0;
+    for (CUDA_LONG d = 0; d < depth && path[d] >= 0; d++)
+        sum += pathGradients[IDX2C(d, t, depth)] * weights[IDX2C(i, (CUDA_LONG) path[d], dim)];
+    hiddenGradient[id] += alpha[0] * sum;
+}
+
+// weightsGradient(:,node) += alpha * derivative * hidden(:,t); one thread per element, path position and frame
+// Frames share the nodes near the root, hence atomicAdd().
+template <class ElemType>
+__global__ void _hierarchicalSoftmaxBackpropWeights(
+    const ElemType* alpha,
+    const ElemType* labels,
+    const ElemType* hidden,
+    const ElemType* paths,
+    const ElemType* pathGradients,
+    ElemType* weightsGradient,
+    const CUDA_LONG dim,
+    const CUDA_LONG depth,
+    const CUDA_LONG numClasses,
+    const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const CUDA_LONG i = id % dim;
+    const CUDA_LONG d = (id / dim) % depth;
+    const CUDA_LONG t = id / (dim * depth);
+    const ElemType label = labels[t];
+    if (!(label >= 0 && label < numClasses))
+        return;
+    const ElemType node = paths[IDX2C(d, (CUDA_LONG) label, 2 * depth)];
+    if (node < 0)
+        return;
+    atomicAdd(&weightsGradient[IDX2C(i, (CUDA_LONG) node, dim)], alpha[0] * pathGradients[IDX2C(d, t, depth)] * hidden[IDX2C(i, t, dim)]);
+}
 
-    if (threadIdx.x < 4)
-    {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 4], partials[threadIdx.x]);
-    }
-    __syncthreads();
+// indices[j] = row of the first non-zero of CSC column j, or -1 (see Matrix::AssignOneHotIndicesOf())
+template <class ElemType>
+__global__ void _cscOneHotIndices(
+    const CUDA_LONG numCols,
+    const GPUSPARSE_INDEX_TYPE* colStart,
+    const GPUSPARSE_INDEX_TYPE* rowIndex,
+    ElemType* indices)
+{
+    CUDA_LONG j = blockDim.x * blockIdx.x + threadIdx.x;
+    if (j >= numCols)
+        return;
+    indices[j] = colStart[j + 1] > colStart[j] ? (ElemType) rowIndex[colStart[j]] : (ElemType) -1;
+}
 
-    if (threadIdx.x == 0)
-    {
-        colMax[0] = max(max(partials[0], partials[1]), max(partials[2], partials[3]));
-    }
-    partials[threadIdx.x] = 0.0f;
+// sum or max of a value over the BlockSize threads of a block; the result is returned to all threads
+// 'partials' is BlockSize elements of shared memory, which may be reused after the call.
+template <class ElemType, int BlockSize, bool IsMax>
+static __device__ ElemType _columnBlockReduce(ElemType* partials, ElemType val)
+{
+    partials[threadIdx.x] = val;
     __syncthreads();
-
-    // Now start finding sums
-    __shared__ ElemType colSum[1];
-    colSum[0] = 0.0f;
-    for (int i = threadIdx.x; i < m_numRows; i += 512)
+    for (int s = BlockSize / 2; s > 0; s /= 2)
     {
-        ElemType tmp = a[IDX2C(i, blockIdx.x, m_numRows)] - colMax[0];
-        us[IDX2C(i, blockIdx.x, m_numRows)] = tmp;
-        partials[threadIdx.x] += (sizeof(ElemType) == sizeof(float)) ? expf(tmp) : exp(tmp);
+        if (threadIdx.x < s)
+            partials[threadIdx.x] = IsMax ? max(partials[threadIdx.x], partials[threadIdx.x + s]) : partials[threadIdx.x] + partials[threadIdx.x + s];
+        __syncthreads();
     }
+    ElemType result = partials[0];
     __syncthreads();
+    return result;
+}
 
-    if (threadIdx.x < 256)
-    {
-        partials[threadIdx.x] += partials[threadIdx.x + 256];
-    }
-    __syncthreads();
+// exchange a value with thread (lane ^ mask) of the warp; a 'double' gets moved in two halves
+static __device__ float _warpShuffleXor(float val, int mask)
+{
+#if __CUDACC_VER_MAJOR__ >= 9
+    return __shfl_xor_sync(0xffffffff, val, mask);
+#else
+    return __shfl_xor(val, mask);
+#endif
+}
+static __device__ double _warpShuffleXor(double val, int mask)
+{
+    int lo = __double2loint(val);
+    int hi = __double2hiint(val);
+#if __CUDACC_VER_MAJOR__ >= 9
+    lo = __shfl_xor_sync(0xffffffff, lo, mask);
+    hi = __shfl_xor_sync(0xffffffff, hi, mask);
+#else
+    lo = __shfl_xor(lo, mask);
+    hi = __shfl_xor(hi, mask);
+#endif
+    return __hiloint2double(hi, lo);
+}
 
-    if (threadIdx.x < 128)
-    {
-        partials[threadIdx.x] += partials[threadIdx.x + 128];
-    }
-    __syncthreads();
+// each block processes one column with BlockSize threads (a power of 2, at least 32)
+// The launch tuner in GPUMatrix.cu picks BlockSize, or _assignColumnwiseLogSoftmaxOfWarp for short columns.
+template <class ElemType, int BlockSize>
+__global__ void _assignColumnwiseLogSoftmaxOf(
+    const ElemType* a,
+    ElemType* us,
+    const CUDA_LONG m_numCols,
+    const CUDA_LONG m_numRows)
+{
+    __shared__ ElemType partials[BlockSize];
 
-    if (threadIdx.x < 64)
-    {
-        partials[threadIdx.x] += partials[threadIdx.x + 64];
-    }
-    __syncthreads();
+    // We first find max per column
+    ElemType colMax = -10000000;
+    for (CUDA_LONG i = threadIdx.x; i < m_numRows; i += BlockSize)
+        colMax = max(colMax, a[IDX2C(i, blockIdx.x, m_numRows)]);
+    colMax = _columnBlockReduce<ElemType, BlockSize, true>(partials, colMax);
 
-    if (threadIdx.x < 32)
+    // Now start finding sums
+    ElemType colSum = 0;
+    for (CUDA_LONG i = threadIdx.x; i < m_numRows; i += BlockSize)
     {
-        partials[threadIdx.x] += partials[threadIdx.x + 32];
+        ElemType tmp = a[IDX2C(i, blockIdx.x, m_numRows)] - colMax;
+        us[IDX2C(i, blockIdx.x, m_numRows)] = tmp;
+        colSum += (sizeof(ElemType) == sizeof(float)) ? expf(tmp) : exp(tmp);
     }
-    __syncthreads();
+    colSum = _columnBlockReduce<ElemType, BlockSize, false>(partials, colSum);
+    colSum = (sizeof(ElemType) == sizeof(float)) ? logf(colSum) : log(colSum);
 
-    if (threadIdx.x < 16)
+    for (CUDA_LONG i = threadIdx.x; i < m_numRows; i += BlockSize)
     {
-        partials[threadIdx.x] += partials[threadIdx.x + 16];
+        us[IDX2C(i, blockIdx.x, m_numRows)] -= colSum;
     }
-    __syncthreads();
+}
 
-    if (threadIdx.x < 8)
-    {
-        partials[threadIdx.x] += partials[threadIdx.x + 8];
-    }
-    __syncthreads();
+// each warp processes one column, blockDim.x / 32 columns per block
+// Used for short columns, which leave most threads of a block-per-column launch idle.
+template <class ElemType>
+__global__ void _assignColumnwiseLogSoftmaxOfWarp(
+    const ElemType* a,
+    ElemType* us,
+    const CUDA_LONG m_numCols,
+    const CUDA_LONG m_numRows)
+{
+    const CUDA_LONG col = blockIdx.x * (blockDim.x / 32) + threadIdx.x / 32;
+    const int lane = threadIdx.x % 32;
+    if (col >= m_numCols) // (the whole warp leaves)
+        return;
 
-    if (threadIdx.x < 4)
-    {
-        partials[threadIdx.x] += partials[threadIdx.x + 4];
-    }
-    __syncthreads();
+    ElemType colMax = -10000000;
+    for (CUDA_LONG i = lane; i < m_numRows; i += 32)
+        colMax = max(colMax, a[IDX2C(i, col, m_numRows)]);
+    for (int mask = 16; mask > 0; mask /= 2)
+        colMax = max(colMax, _warpShuffleXor(colMax, mask));
 
-    if (threadIdx.x == 0)
+    ElemType colSum = 0;
+    for (CUDA_LONG i = lane; i < m_numRows; i += 32)
     {
-        colSum[0] = partials[0] + partials[1] + partials[2] + partials[3];
-        colSum[0] = (sizeof(ElemType) == sizeof(float)) ? logf(colSum[0]) : log(colSum[0]);
+        ElemType tmp = a[IDX2C(i, col, m_numRows)] - colMax;
+        us[IDX2C(i, col, m_numRows)] = tmp;
+        colSum += (sizeof(ElemType) == sizeof(float)) ? expf(tmp) : exp(tmp);
     }
-    __syncthreads();
+    for (int mask = 16; mask > 0; mask /= 2)
+        colSum += _warpShuffleXor(colSum, mask);
+    colSum = (sizeof(ElemType) == sizeof(float)) ? logf(colSum) : log(colSum);
 
-    for (int i = threadIdx.x; i < m_numRows; i += 512)
-    {
-        us[IDX2C(i, blockIdx.x, m_numRows)] -= colSum[0];
-    }
+    for (CUDA_LONG i = lane; i < m_numRows; i += 32)
+        us[IDX2C(i, col, m_numRows)] -= colSum;
 }
 
 template <class ElemType>
@@ -1442,59 +1717,318 @@ __global__ void _fsadagrad(CUDA_LONG size, ElemType* grad, ElemType* smoothAda,
     }
 }
 
+// layer-wise adaptive rates (LARS, LAMB), see CPUMatrix::LarsUpdate() and LambUpdate()
+// The norms are reduced on the device into a few scalars that the update kernels read, so the host never waits.
+// Each block adds its partial sums of squares into sums[0] and sums[1] (blockDim.x must be a power of 2).
 template <class ElemType>
-__global__ void _rmsprop_init(
-    ElemType* avars, ElemType* signs, ElemType* steps,
-    ElemType* curr_grad,
-    const CUDA_LONG N)
+__device__ void _addSumsOfSquaresOfBlock(ElemType a, ElemType b, ElemType* sums)
 {
-    CUDA_LONG i = blockDim.x * blockIdx.x + threadIdx.x;
-    if (i >= N)
-        return;
-
-    ElemType tmp = curr_grad[i];
-    avars[i] = tmp * tmp;
-    signs[i] = ElemType(0.0);
-    steps[i] = ElemType(0.02);
+    __shared__ ElemType partialA[GridDim::maxThreadsPerBlock];
+    __shared__ ElemType partialB[GridDim::maxThreadsPerBlock];
+    partialA[threadIdx.x] = a;
+    partialB[threadIdx.x] = b;
+    __syncthreads();
+    for (CUDA_LONG s = blockDim.x / 2; s > 0; s >>= 1)
+    {
+        if (threadIdx.x < s)
+        {
+            partialA[threadIdx.x] += partialA[threadIdx.x + s];
+            partialB[threadIdx.x] += partialB[threadIdx.x + s];
+        }
+        __syncthreads();
+    }
+    if (threadIdx.x == 0)
+    {
+        atomicAdd(&sums[0], partialA[0]);
+        atomicAdd(&sums[1], partialB[0]);
+    }
 }
 
+// multi-tensor NormalGrad(), see CPUMatrix::MultiTensorNormalGrad()
+// Each block works on one chunk of one tensor, so that a single launch covers all parameters, however small.
 template <class ElemType>
-__global__ void _rmsprop(
-    ElemType* avars, ElemType* signs, ElemType* steps,
-    ElemType* curr_grad,
-    const CUDA_LONG N,
-    ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
-    ElemType floor,
-    ElemType* upd_gpu,
-    ElemType* multipliers)
+struct MultiTensorEntry
 {
-    CUDA_LONG i = blockDim.x * blockIdx.x + threadIdx.x;
-    if (i >= N)
-        return;
-
-    avars[i] = RMS_GAMMA * avars[i] + (ElemType(1.0) - RMS_GAMMA) * (curr_grad[i] * curr_grad[i]);
+    ElemType* val;
+    const ElemType* grad;
+    ElemType* smooth;
+    CUDA_LONG size;
+};
 
-    // // grad sign base 3: 0->neg, 1->zero, 2->pos
-    // const int grad_sign = 1 + (ElemType(0) < curr_grad[i]) - (curr_grad[i] < ElemType(0));
+struct MultiTensorChunk
+{
+    int tensor;
+    CUDA_LONG begin;
+};
 
-    // // signs[i] contains three consecutive grad_sign
-    // signs[i]  = 3*(int(signs[i]) % 9) + grad_sign;
+template <class ElemType>
+__global__ void _multiTensorSumOfSquares(const MultiTensorEntry<ElemType>* tensors, const MultiTensorChunk* chunks, CUDA_LONG chunkSize, ElemType* sumsOfSquares)
+{
+    const MultiTensorChunk chunk = chunks[blockIdx.x];
+    const MultiTensorEntry<ElemType> t = tensors[chunk.tensor];
+    const CUDA_LONG end = min(chunk.begin + chunkSize, t.size);
+    ElemType sum = 0;
+    for (CUDA_LONG idx = chunk.begin + threadIdx.x; idx < end; idx += blockDim.x)
+        sum += t.grad[idx] * t.grad[idx];
+    _addSumsOfSquaresOfBlock(sum, (ElemType) 0, sumsOfSquares + 2 * chunk.tensor);
+}
 
-    // // update according to the following table:
-    // // (!pos,!pos,!pos) or (!neg,!neg,!neg): RMS_WGT_INC
-    // // (!neg,!neg,neg) or (!pos,!pos,pos): RMS_WGT_DEC
-    // // otherwise: no action
+// clipMode: 0 = none, 1 = truncation, 2 = by the norm in sumsOfSquares[2 * tensor]
+template <class ElemType>
+__global__ void _multiTensorNormalGrad(const MultiTensorEntry<ElemType>* tensors, const MultiTensorChunk* chunks, CUDA_LONG chunkSize, const ElemType* sumsOfSquares,
+                                       ElemType lr, ElemType mom, bool useNesterovMomentum, int clipMode, ElemType clippingThreshold, ElemType l2Weight, ElemType l1Threshold)
+{
+    const MultiTensorChunk chunk = chunks[blockIdx.x];
+    const MultiTensorEntry<ElemType> t = tensors[chunk.tensor];
+    const CUDA_LONG end = min(chunk.begin + chunkSize, t.size);
+    ElemType scale = 1;
+    if (clipMode == 2)
+    {
+        const ElemType norm = sqrt(sumsOfSquares[2 * chunk.tensor]);
+        if (norm > clippingThreshold)
+            scale = clippingThreshold / norm;
+    }
+    for (CUDA_LONG idx = chunk.begin + threadIdx.x; idx < end; idx += blockDim.x)
+    {
+        ElemType g = t.grad[idx] * scale;
+        if (clipMode == 1)
+            g = max(min(g, clippingThreshold), -clippingThreshold);
+        g += l2Weight * t.val[idx];
+        const ElemType step = (1 - mom) * lr * g;
+        const ElemType v = mom * t.smooth[idx] + step;
+        t.smooth[idx] = v;
+        ElemType w = t.val[idx] - (useNesterovMomentum ? mom * v + step : v);
+        if (l1Threshold > 0)
+            w = w > l1Threshold ? w - l1Threshold : w < -l1Threshold ? w + l1Threshold : 0;
+        t.val[idx] = w;
+    }
+}
 
-    // switch(int(upd_gpu[int(signs[i])]))
-    // {
-    // case 0:
-    //    steps[i] = max(steps[i] * RMS_WGT_DEC, RMS_WGT_MIN);
-    //    break;
-    // case 2:
-    //    steps[i] = min(steps[i] * RMS_WGT_INC, RMS_WGT_MAX);
-    //    break;
-    // }
-    // curr_grad[i] *= steps[i] / sqrt(avars[i] + floor);
+template <class ElemType>
+__global__ void _larsNorms(CUDA_LONG size, const ElemType* val, const ElemType* grad, ElemType* sums)
+{
+    ElemType sumSqrW = 0, sumSqrG = 0;
+    for (CUDA_LONG idx = blockIdx.x * blockDim.x + threadIdx.x; idx < size; idx += blockDim.x * gridDim.x)
+    {
+        sumSqrW += val[idx] * val[idx];
+        sumSqrG += grad[idx] * grad[idx];
+    }
+    _addSumsOfSquaresOfBlock(sumSqrW, sumSqrG, sums);
+}
+
+template <class ElemType>
+__global__ void _larsUpdate(CUDA_LONG size, const ElemType* grad, ElemType* velocity, ElemType* val, const ElemType* sums,
+                            ElemType lr, ElemType mom, ElemType trustCoefficient)
+{
+    const ElemType trust = sums[0] > 0 && sums[1] > 0 ? trustCoefficient * sqrt(sums[0] / sums[1]) : 1;
+    for (CUDA_LONG idx = blockIdx.x * blockDim.x + threadIdx.x; idx < size; idx += blockDim.x * gridDim.x)
+    {
+        const ElemType v = mom * velocity[idx] + lr * trust * grad[idx];
+        velocity[idx] = v;
+        val[idx] -= v;
+    }
+}
+
+// scalars: [0] and [1] squared norms of W and r, [2] step count (incremented by _lambFinishStep())
+template <class ElemType>
+__device__ ElemType _lambDirection(CUDA_LONG idx, const ElemType* smoothMom, const ElemType* smoothSqr, const ElemType* val, ElemType step,
+                                   ElemType beta1, ElemType beta2, ElemType epsilon, ElemType weightDecay)
+{
+    const ElemType momCorrection = 1 - pow(beta1, step);
+    const ElemType sqrCorrection = 1 - pow(beta2, step);
+    return (smoothMom[idx] / momCorrection) / (sqrt(smoothSqr[idx] / sqrCorrection) + epsilon) + weightDecay * val[idx];
+}
+
+template <class ElemType>
+__global__ void _lambMoments(CUDA_LONG size, const ElemType* grad, ElemType* smoothMom, ElemType* smoothSqr, const ElemType* val, ElemType* scalars,
+                             ElemType beta1, ElemType beta2, ElemType epsilon, ElemType weightDecay)
+{
+    const ElemType step = scalars[2] + 1;
+    ElemType sumSqrW = 0, sumSqrR = 0;
+    for (CUDA_LONG idx = blockIdx.x * blockDim.x + threadIdx.x; idx < size; idx += blockDim.x * gridDim.x)
+    {
+        const ElemType g = grad[idx];
+        smoothMom[idx] = beta1 * smoothMom[idx] + (1 - beta1) * g;
+        smoothSqr[idx] = beta2 * smoothSqr[idx] + (1 - beta2) * g * g;
+        const ElemType r = _lambDirection(idx, smoothMom, smoothSqr, val, step, beta1, beta2, epsilon, weightDecay);
+        sumSqrW += val[idx] * val[idx];
+        sumSqrR += r * r;
+    }
+    _addSumsOfSquaresOfBlock(sumSqrW, sumSqrR, scalars);
+}
+
+template <class ElemType>
+__global__ void _lambUpdate(CUDA_LONG size, const ElemType* smoothMom, const ElemType* smoothSqr, ElemType* val, const ElemType* scalars,
+                            ElemType lr, ElemType beta1, ElemType beta2, ElemType epsilon, ElemType weightDecay)
+{
+    const ElemType step = scalars[2] + 1;
+    const ElemType trust = scalars[0] > 0 && scalars[1] > 0 ? sqrt(scalars[0] / scalars[1]) : 1;
+    for (CUDA_LONG idx = blockIdx.x * blockDim.x + threadIdx.x; idx < size; idx += blockDim.x * gridDim.x)
+        val[idx] -= lr * trust * _lambDirection(idx, smoothMom, smoothSqr, val, step, beta1, beta2, epsilon, weightDecay);
+}
+
+template <class ElemType>
+__global__ void _lambFinishStep(ElemType* scalars)
+{
+    scalars[2] += 1;
+}
+
+// row-sparse (lazy) FSAdagrad and RmsProp for block-column gradients, see CPUSparseMatrix::FSAdagrad()
+// lastSteps[col] is the step column col was last updated at, lastSteps[numCols] the step before the current one.
+// One thread per non-zero value; _updateLastSteps4BlockSparse() then records the current step.
+template <class ElemType>
+__global__ void _fsadagrad4BlockSparse(CUDA_LONG N, const size_t numRows, const ElemType* grad, const GPUSPARSE_INDEX_TYPE* blockId2Col,
+                                       ElemType* smoothAda, ElemType* smoothMom, const ElemType* lastSteps, const size_t numCols, ElemType* val,
+                                       ElemType lr, ElemType mom, ElemType adaWeight, ElemType adaMul)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    CUDA_LONG blockid = id / numRows;
+    CUDA_LONG col = blockId2Col[blockid];
+    size_t index = (id - blockid * numRows) + col * numRows;
+
+    ElemType numSkipped = lastSteps[col] > 0 ? lastSteps[numCols] - lastSteps[col] : 0;
+    if (numSkipped > 0)
+    {
+        ElemType momDecay = pow(mom, numSkipped);
+        ElemType momSum = mom > 0 ? (mom < 1 ? mom * (1 - momDecay) / (1 - mom) : numSkipped) : 0;
+        val[index] -= lr * momSum * smoothMom[index];
+        smoothMom[index] *= momDecay;
+        smoothAda[index] *= pow(adaWeight, numSkipped);
+    }
+
+    ElemType g = grad[id];
+    ElemType adaSqr = adaWeight * smoothAda[index] + (1.0f - adaWeight) * g * g;
+    smoothAda[index] = adaSqr;
+    if (adaSqr != 0.0f)
+    {
+        ElemType w = adaMul * (sizeof(ElemType) == sizeof(double) ? rsqrt(adaSqr) : rsqrtf(adaSqr));
+        if (w > 10.0f)
+            w = 10.0f;
+        g *= w;
+    }
+
+    if (mom > 0.0f)
+    {
+        g = mom * smoothMom[index] + (1.0f - mom) * g;
+        smoothMom[index] = g;
+    }
+
+    val[index] -= lr * g;
+}
+
+template <class ElemType>
+__global__ void _rmsprop4BlockSparse(CUDA_LONG N, const size_t numRows, ElemType* curr_grad, const GPUSPARSE_INDEX_TYPE* blockId2Col,
+                                     ElemType* avars, ElemType* signs, ElemType* steps, const ElemType* lastSteps, const size_t numCols,
+                                     ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+                                     ElemType floor, ElemType* multipliers)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+
+    CUDA_LONG blockid = id / numRows;
+    CUDA_LONG col = blockId2Col[blockid];
+    size_t index = (id - blockid * numRows) + col * numRows;
+
+    ElemType g = curr_grad[id];
+    if (lastSteps[col] == 0)
+        avars[index] = g * g;
+    else if (lastSteps[numCols] > lastSteps[col])
+    {
+        ElemType numSkipped = lastSteps[numCols] - lastSteps[col];
+        avars[index] *= pow(RMS_GAMMA, numSkipped);
+        steps[index] = max(steps[index] * pow(RMS_WGT_DEC, numSkipped), RMS_WGT_MIN);
+        signs[index] = 0;
+    }
+
+    avars[index] = RMS_GAMMA * avars[index] + (ElemType(1.0) - RMS_GAMMA) * (g * g);
+    const int grad_sign = (ElemType(0) < g) - (g < ElemType(0));
+
+    if (signs[index] * grad_sign > 0)
+        steps[index] = min(steps[index] * RMS_WGT_INC, RMS_WGT_MAX);
+    else
+        steps[index] = max(steps[index] * RMS_WGT_DEC, RMS_WGT_MIN);
+
+    ElemType temp = steps[index] / sqrt(avars[index] + floor);
+    curr_grad[id] = g * temp;
+    signs[index] = grad_sign;
+
+    if (multipliers != nullptr)
+        multipliers[id] = temp;
+}
+
+// records the current step for the columns of a block-column gradient; then advances the step (see above)
+template <class ElemType>
+__global__ void _updateLastSteps4BlockSparse(CUDA_LONG numBlocks, const GPUSPARSE_INDEX_TYPE* blockId2Col, ElemType* lastSteps, const size_t numCols)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= numBlocks)
+        return;
+    lastSteps[blockId2Col[id]] = lastSteps[numCols] + 1;
+}
+
+template <class ElemType>
+__global__ void _advanceStep4BlockSparse(ElemType* lastSteps, const size_t numCols)
+{
+    lastSteps[numCols]++;
+}
+
+template <class ElemType>
+__global__ void _rmsprop_init(
+    ElemType* avars, ElemType* signs, ElemType* steps,
+    ElemType* curr_grad,
+    const CUDA_LONG N)
+{
+    CUDA_LONG i = blockDim.x * blockIdx.x + threadIdx.x;
+    if (i >= N)
+        return;
+
+    ElemType tmp = curr_grad[i];
+    avars[i] = tmp * tmp;
+    signs[i] = ElemType(0.0);
+    steps[i] = ElemType(0.02);
+}
+
+template <class ElemType>
+__global__ void _rmsprop(
+    ElemType* avars, ElemType* signs, ElemType* steps,
+    ElemType* curr_grad,
+    const CUDA_LONG N,
+    ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN,
+    ElemType floor,
+    ElemType* upd_gpu,
+    ElemType* multipliers)
+{
+    CUDA_LONG i = blockDim.x * blockIdx.x + threadIdx.x;
+    if (i >= N)
+        return;
+
+    avars[i] = RMS_GAMMA * avars[i] + (ElemType(1.0) - RMS_GAMMA) * (curr_grad[i] * curr_grad[i]);
+
+    // // grad sign base 3: 0->neg, 1->zero, 2->pos
+    // const int grad_sign = 1 + (ElemType(0) < curr_grad[i]) - (curr_grad[i] < ElemType(0));
+
+    // // signs[i] contains three consecutive grad_sign
+    // signs[i]  = 3*(int(signs[i]) % 9) + grad_sign;
+
+    // // update according to the following table:
+    // // (!pos,!pos,!pos) or (!neg,!neg,!neg): RMS_WGT_INC
+    // // (!neg,!neg,neg) or (!pos,!pos,pos): RMS_WGT_DEC
+    // // otherwise: no action
+
+    // switch(int(upd_gpu[int(signs[i])]))
+    // {
+    // case 0:
+    //    steps[i] = max(steps[i] * RMS_WGT_DEC, RMS_WGT_MIN);
+    //    break;
+    // case 2:
+    //    steps[i] = min(steps[i] * RMS_WGT_INC, RMS_WGT_MAX);
+    //    break;
+    // }
+    // curr_grad[i] *= steps[i] / sqrt(avars[i] + floor);
 
     const int grad_sign = (ElemType(0) < curr_grad[i]) - (curr_grad[i] < ElemType(0));
 
@@ -1511,30 +2045,50 @@ __global__ void _rmsprop(
         multipliers[i] = temp;
 }
 
+// random fills, one Philox evaluation per element, with the same values as the CPU (see UniformRandomAt() etc. in TensorOps.h)
 template <class ElemType>
-__global__ void _rescaleToRange(
+__global__ void _setUniformRandomValue(
     ElemType* a,
     const CUDA_LONG N,
     const ElemType low,
-    const ElemType high)
+    const ElemType high,
+    const unsigned long long seed)
 {
     CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
     if (id >= N)
         return;
-    a[id] = a[id] * (high - low) + low;
+    a[id] = low + (high - low) * UniformRandomAt<ElemType>(seed, id);
 }
 
+// a = beta * a + mean + sigma * normal
 template <class ElemType>
-__global__ void _setMaskAndScale(
+__global__ void _addGaussianRandomValue(
+    ElemType* a,
+    const CUDA_LONG N,
+    const ElemType beta,
+    const ElemType mean,
+    const ElemType sigma,
+    const unsigned long long seed)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const ElemType value = mean + sigma * GaussianRandomAt<ElemType>(seed, id);
+    a[id] = beta == 0 ? value : beta * a[id] + value;
+}
+
+template <class ElemType>
+__global__ void _setUniformRandomMask(
     ElemType* a,
     const CUDA_LONG N,
     const ElemType maskRate,
-    const ElemType scaleValue)
+    const ElemType scaleValue,
+    const unsigned long long seed)
 {
     CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
     if (id >= N)
         return;
-    a[id] = a[id] <= maskRate ? 0 : scaleValue;
+    a[id] = DropoutMaskAt<ElemType>(seed, id, maskRate, scaleValue);
 }
 
 template <class ElemType>
@@ -2038,6 +2592,25 @@ __global__ void _addElementProductOf(
     us[id] += (a[id] * b[id]);
 }
 
+// us = beta * us + a .* mask, one Philox evaluation per element (see DropoutMaskAt() in TensorOps.h)
+template <class ElemType>
+__global__ void _addDropoutOf(
+    ElemType* us,
+    const ElemType* a,
+    const CUDA_LONG N,
+    const ElemType beta,
+    const ElemType dropoutRate,
+    const ElemType scale,
+    const unsigned long long seed,
+    const unsigned long long offset)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const ElemType value = a[id] * DropoutMaskAt<ElemType>(seed, offset + id, dropoutRate, scale);
+    us[id] = beta == 0 ? value : beta * us[id] + value;
+}
+
 template <class ElemType>
 __global__ void _columnElementMultiplyWith(
     ElemType* us,
@@ -2799,6 +3372,40 @@ __global__ void _isValid(
     }
 }
 
+// CSC from triplets ordered by column: each triplet is copied in place, and each column start is found by binary search
+template <class ElemType>
+__global__ void _assembleCSCFromCOO(
+    const ElemType* cooValues,
+    const GPUSPARSE_INDEX_TYPE* cooRows,
+    const GPUSPARSE_INDEX_TYPE* cooCols,
+    const CUDA_LONG nz,
+    const CUDA_LONG numCols,
+    ElemType* values,
+    GPUSPARSE_INDEX_TYPE* rows,
+    GPUSPARSE_INDEX_TYPE* colStarts)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id < nz)
+    {
+        values[id] = cooValues[id];
+        rows[id] = cooRows[id];
+    }
+    if (id <= numCols)
+    {
+        CUDA_LONG lo = 0;
+        CUDA_LONG hi = nz;
+        while (lo < hi)
+        {
+            const CUDA_LONG mid = (lo + hi) / 2;
+            if (cooCols[mid] < id)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        colStarts[id] = (GPUSPARSE_INDEX_TYPE) lo;
+    }
+}
+
 template <class ElemType>
 __global__ void _shiftColCSCIndexFromSliceViewToAbsolute(
     GPUSPARSE_INDEX_TYPE* colCSCIndex,
@@ -2936,6 +3543,67 @@ __global__ void _dense1DConvMultSparseCSCTransposeAndAddToDense(
     }
 }
 
+// c = alpha * a * b + beta * c for a sparse b (CSC) with few non-zeros per column, e.g. one-hot word ids:
+// each column of c gathers the columns of a that the non-zeros of the corresponding column of b select.
+// grid: (ceil(m / blockDim.x), up to n); a thread computes one row of c for the columns blockIdx.y, blockIdx.y + gridDim.y, ...
+template <class ElemType>
+__global__ void _denseMultSparseCSCGatherAndWeightedAddToDense(
+    const int m, // rowDense (= rows of c)
+    const int n, // colSparse (= cols of c)
+    const ElemType alpha,
+    const ElemType* a,         // dense
+    const ElemType* bnzValues, // sparse nz values
+    const GPUSPARSE_INDEX_TYPE* rowIndex,
+    const GPUSPARSE_INDEX_TYPE* colCSCIndex,
+    const ElemType beta,
+    ElemType* c // dense target
+    )
+{
+    const int rowInC = blockDim.x * blockIdx.x + threadIdx.x;
+    if (rowInC >= m)
+        return;
+
+    for (int colInC = blockIdx.y; colInC < n; colInC += gridDim.y)
+    {
+        ElemType s = 0;
+        const int end = colCSCIndex[colInC + 1];
+        for (int j = colCSCIndex[colInC]; j < end; j++)
+            s += a[IDX2C(rowInC, rowIndex[j], m)] * bnzValues[j];
+
+        ElemType& cij = c[IDX2C(rowInC, colInC, m)];
+        cij = (beta == 0 ? 0 : beta * cij) + alpha * s; // beta == 0 must not read c, which may not be initialized
+    }
+}
+
+// c += alpha * a * b^T for a sparse b (CSC) with few non-zeros per column, e.g. the weight gradient of one-hot inputs:
+// each column of a is scattered into the columns of c that the non-zeros of the same column of b select.
+// Several columns of b may select the same column of c, hence atomicAdd().
+// grid: (ceil(m / blockDim.x), up to n), as for _denseMultSparseCSCGatherAndWeightedAddToDense()
+template <class ElemType>
+__global__ void _denseMultSparseCSCTransposeScatterAndAddToDense(
+    const int m, // rowDense (= rows of c)
+    const int n, // colDense (= cols of b)
+    const ElemType alpha,
+    const ElemType* a,         // dense
+    const ElemType* bnzValues, // sparse nz values
+    const GPUSPARSE_INDEX_TYPE* rowIndex,
+    const GPUSPARSE_INDEX_TYPE* colCSCIndex,
+    ElemType* c // dense target
+    )
+{
+    const int rowInA = blockDim.x * blockIdx.x + threadIdx.x;
+    if (rowInA >= m)
+        return;
+
+    for (int colInA = blockIdx.y; colInA < n; colInA += gridDim.y)
+    {
+        const ElemType aij = alpha * a[IDX2C(rowInA, colInA, m)];
+        const int end = colCSCIndex[colInA + 1];
+        for (int j = colCSCIndex[colInA]; j < end; j++)
+            atomicAdd(&c[IDX2C(rowInA, rowIndex[j], m)], aij * bnzValues[j]);
+    }
+}
+
 template <class ElemType>
 __global__ void _reshape(
     const int oldNumRows,                       // old row count
@@ -4102,6 +4770,22 @@ __global__ void _reductionSum2(
     }
 }
 
+// a *= maxNorm / norm if norm > maxNorm, where norm is on the device (see GPUMatrix::ClipFrobeniusNorm())
+template <class ElemType>
+__global__ void _scaleToMaxNorm(
+    ElemType* a,
+    const CUDA_LONG N,
+    const ElemType* norm,
+    const ElemType maxNorm)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const ElemType n = *norm;
+    if (n > maxNorm)
+        a[id] *= maxNorm / n;
+}
+
 //This function should be called with 1024 threads per block and 1 block
 //THIS IS NOT THE MOST EFFICIENT IMPLEMENTATION!!!
 template <class ElemType>
@@ -4484,6 +5168,75 @@ __global__ void _innerProductWithShiftNeg(
     c[IDX2C(idx, idy, NTPlusOne)] = sum;
 }
 
+// c(idx, idy) = cos(a(:, idy), b(:, idy + shift(idx))), with the inverse norms of the columns given (see Matrix::AssignCosDistanceWithShiftNeg())
+template <class ElemType>
+__global__ void _assignCosDistanceWithShiftNeg(
+    ElemType* c,
+    const ElemType* a,
+    const ElemType* b,
+    const ElemType* invNormA,
+    const ElemType* invNormB,
+    const CUDA_LONG N, // a.GetNumRows();
+    const CUDA_LONG M, // a.GetNumCols();
+    const CUDA_LONG shift,
+    const CUDA_LONG NTPlusOne)
+{
+    CUDA_LONG idx = blockDim.x * blockIdx.x + threadIdx.x;
+    CUDA_LONG idy = blockDim.y * blockIdx.y + threadIdx.y;
+
+    if (idx >= NTPlusOne || idy >= M)
+        return;
+
+    const CUDA_LONG col_b = idx == 0 ? idy : (idy + shift + idx - 1) % M;
+    const ElemType* pa = a + IDX2C(0, idy, N);
+    const ElemType* pb = b + IDX2C(0, col_b, N);
+    ElemType sum = 0;
+    for (CUDA_LONG i = 0; i < N; ++i)
+        sum += pa[i] * pb[i];
+    c[IDX2C(idx, idy, NTPlusOne)] = sum * invNormA[idy] * invNormB[col_b];
+}
+
+// inputGradient(id) += the gradient of _assignCosDistanceWithShiftNeg() w.r.t. a, or b if wrtB (see Matrix::AddCosDistanceWithShiftNegGradient())
+// One thread per element; it gathers the NTPlusOne terms of its column.
+template <class ElemType>
+__global__ void _addCosDistanceWithShiftNegGradient(
+    ElemType* inputGradient,
+    const ElemType* gradient,
+    const ElemType* cosDistance,
+    const ElemType* a,
+    const ElemType* b,
+    const ElemType* invNormA,
+    const ElemType* invNormB,
+    const CUDA_LONG N, // a.GetNumRows();
+    const CUDA_LONG M, // a.GetNumCols();
+    const CUDA_LONG shift,
+    const CUDA_LONG NTPlusOne,
+    const bool wrtB)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N * M)
+        return;
+
+    const CUDA_LONG row = id % N;
+    const CUDA_LONG col = id / N;
+    const ElemType* self = wrtB ? b : a;
+    const ElemType* other = wrtB ? a : b;
+    const ElemType* selfInvNorm = wrtB ? invNormB : invNormA;
+    ElemType sum = 0;
+    ElemType selfWeight = 0;
+    for (CUDA_LONG i = 0; i < NTPlusOne; i++)
+    {
+        const CUDA_LONG s = i == 0 ? 0 : (shift + i - 1) % M;
+        const CUDA_LONG colA = wrtB ? (col + M - s) % M : col;
+        const CUDA_LONG colB = wrtB ? col : (col + s) % M;
+        const ElemType g = gradient[IDX2C(i, colA, NTPlusOne)];
+        sum += g * invNormA[colA] * invNormB[colB] * other[IDX2C(row, wrtB ? colA : colB, N)];
+        selfWeight += g * cosDistance[IDX2C(i, colA, NTPlusOne)];
+    }
+    sum -= selfWeight * selfInvNorm[col] * selfInvNorm[col] * self[id];
+    inputGradient[id] += sum;
+}
+
 template <class ElemType>
 __global__ void _getARowByIndex(
     ElemType* us,
@@ -4847,6 +5600,432 @@ __global__ void _rcrfTransGrdCompute(
     }
 };
 
+// -----------------------------------------------------------------------
+// batched CRF and Viterbi over all sequences of a minibatch (see Matrix::CRFForwardBackward())
+// One block per sequence walks the time steps, its threads stride over the labels.
+// sequences is 3 x numSequences: (parallel sequence, first time step, end time step).
+// -----------------------------------------------------------------------
+
+// row of the one-hot label of a column, or -1
+template <class ElemType>
+static __device__ int _labelOfColumn(const ElemType* labels, const CUDA_LONG numLabels)
+{
+    for (CUDA_LONG k = 0; k < numLabels; k++)
+        if (labels[k] != 0)
+            return (int) k;
+    return -1;
+}
+
+template <class ElemType>
+__global__ void _crfForwardBackward(const ElemType* labels, const ElemType* pos, const ElemType* pair, ElemType* alpha, ElemType* beta,
+                                    ElemType* sequenceScores, const ElemType* sequences, const CUDA_LONG S, const CUDA_LONG L)
+{
+    __shared__ int startLabel;
+    __shared__ double logZ;
+
+    const CUDA_LONG j = blockIdx.x;
+    const CUDA_LONG s = (CUDA_LONG) sequences[IDX2C(0, j, 3)];
+    const CUDA_LONG tBegin = (CUDA_LONG) sequences[IDX2C(1, j, 3)];
+    const CUDA_LONG tEnd = (CUDA_LONG) sequences[IDX2C(2, j, 3)];
+    if (tBegin == tEnd)
+    {
+        if (threadIdx.x == 0)
+            sequenceScores[j] = 0;
+        return;
+    }
+    if (threadIdx.x == 0)
+        startLabel = _labelOfColumn(labels + (tBegin * S + s) * L, L);
+    __syncthreads();
+
+    // forward
+    for (CUDA_LONG t = tBegin; t < tEnd; t++)
+    {
+        const CUDA_LONG col = t * S + s;
+        for (CUDA_LONG k = threadIdx.x; k < L; k += blockDim.x)
+        {
+            ElemType v;
+            if (t > tBegin)
+            {
+                v = LZERO;
+                for (CUDA_LONG i = 0; i < L; i++)
+                    v = logaddk(v, alpha[IDX2C(i, col - S, L)] + pair[IDX2C(k, i, L)]);
+            }
+            else
+                v = startLabel >= 0 ? pair[IDX2C(k, startLabel, L)] : 0;
+            alpha[IDX2C(k, col, L)] = v + pos[IDX2C(k, col, L)];
+        }
+        __syncthreads();
+    }
+
+    // backward, beta = log posteriors
+    const CUDA_LONG lastCol = (tEnd - 1) * S + s;
+    if (threadIdx.x == 0)
+    {
+        ElemType v = LZERO;
+        for (CUDA_LONG k = 0; k < L; k++)
+            v = logaddk(v, alpha[IDX2C(k, lastCol, L)]);
+        logZ = v;
+    }
+    __syncthreads();
+    for (CUDA_LONG k = threadIdx.x; k < L; k += blockDim.x)
+        beta[IDX2C(k, lastCol, L)] = alpha[IDX2C(k, lastCol, L)] - (ElemType) logZ;
+    __syncthreads();
+    for (CUDA_LONG t = tEnd - 2; t >= tBegin; t--)
+    {
+        const CUDA_LONG col = t * S + s;
+        const CUDA_LONG next = col + S;
+        for (CUDA_LONG k = threadIdx.x; k < L; k += blockDim.x)
+        {
+            ElemType v = LZERO;
+            for (CUDA_LONG i = 0; i < L; i++)
+                v = logaddk(v, beta[IDX2C(i, next, L)] - alpha[IDX2C(i, next, L)] + pos[IDX2C(i, next, L)] + pair[IDX2C(i, k, L)]);
+            beta[IDX2C(k, col, L)] = alpha[IDX2C(k, col, L)] + v;
+        }
+        __syncthreads();
+    }
+
+    // -log P(labels)
+    if (threadIdx.x == 0)
+    {
+        ElemType pathScore = 0;
+        int prevLabel = startLabel;
+        for (CUDA_LONG t = tBegin; t < tEnd; t++)
+        {
+            const CUDA_LONG col = t * S + s;
+            const int label = _labelOfColumn(labels + col * L, L);
+            if (label >= 0)
+            {
+                pathScore += pos[IDX2C(label, col, L)];
+                if (prevLabel >= 0)
+                    pathScore += pair[IDX2C(label, prevLabel, L)];
+            }
+            prevLabel = label;
+        }
+        sequenceScores[j] = (ElemType) logZ - pathScore;
+    }
+}
+
+// grd(k, i) += expected minus actual number of transitions from label i to k, summed over all sequences;
+// one thread per element of grd, so no atomics are needed
+template <class ElemType>
+__global__ void _crfTransitionGradient(const ElemType* labels, const ElemType* pos, const ElemType* pair, const ElemType* alpha, const ElemType* beta,
+                                       ElemType* grd, const ElemType* sequences, const CUDA_LONG numSequences, const CUDA_LONG S, const CUDA_LONG L)
+{
+    const CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= L * L)
+        return;
+    const CUDA_LONG k = id % L;
+    const CUDA_LONG i = id / L;
+
+    ElemType sum = 0;
+    for (CUDA_LONG j = 0; j < numSequences; j++)
+    {
+        const CUDA_LONG s = (CUDA_LONG) sequences[IDX2C(0, j, 3)];
+        const CUDA_LONG tBegin = (CUDA_LONG) sequences[IDX2C(1, j, 3)];
+        const CUDA_LONG tEnd = (CUDA_LONG) sequences[IDX2C(2, j, 3)];
+        for (CUDA_LONG t = tBegin; t < tEnd; t++)
+        {
+            const CUDA_LONG col = t * S + s;
+            ElemType prev;
+            bool isLabelTransition;
+            if (t > tBegin)
+            {
+                prev = alpha[IDX2C(i, col - S, L)];
+                isLabelTransition = labels[IDX2C(i, col - S, L)] != 0 && labels[IDX2C(k, col, L)] != 0;
+            }
+            else if (labels[IDX2C(i, col, L)] != 0) // from the start symbol
+            {
+                prev = 0;
+                isLabelTransition = i == k;
+            }
+            else
+                continue;
+            sum += exp(prev + pair[id] - alpha[IDX2C(k, col, L)] + pos[IDX2C(k, col, L)] + beta[IDX2C(k, col, L)]);
+            if (isLabelTransition)
+                sum -= 1;
+        }
+    }
+    grd[id] += sum;
+}
+
+template <class ElemType>
+__global__ void _viterbiDecode(const ElemType* labels, const ElemType* pos, const ElemType* pair, ElemType* alpha, ElemType* backtrace,
+                               ElemType* decodedPath, const ElemType* sequences, const CUDA_LONG S, const CUDA_LONG L)
+{
+    __shared__ int startLabel;
+
+    const CUDA_LONG j = blockIdx.x;
+    const CUDA_LONG s = (CUDA_LONG) sequences[IDX2C(0, j, 3)];
+    const CUDA_LONG tBegin = (CUDA_LONG) sequences[IDX2C(1, j, 3)];
+    const CUDA_LONG tEnd = (CUDA_LONG) sequences[IDX2C(2, j, 3)];
+    if (tBegin == tEnd)
+        return;
+    if (threadIdx.x == 0)
+        startLabel = _labelOfColumn(labels + (tBegin * S + s) * L, L);
+    __syncthreads();
+
+    for (CUDA_LONG t = tBegin; t < tEnd; t++)
+    {
+        const CUDA_LONG col = t * S + s;
+        for (CUDA_LONG k = threadIdx.x; k < L; k += blockDim.x)
+        {
+            if (t > tBegin)
+            {
+                ElemType best = alpha[IDX2C(0, col - S, L)] + pair[IDX2C(k, 0, L)];
+                CUDA_LONG bestPrev = 0;
+                for (CUDA_LONG i = 1; i < L; i++)
+                {
+                    const ElemType score = alpha[IDX2C(i, col - S, L)] + pair[IDX2C(k, i, L)];
+                    if (score > best)
+                    {
+                        best = score;
+                        bestPrev = i;
+                    }
+                }
+                alpha[IDX2C(k, col, L)] = best + pos[IDX2C(k, col, L)];
+                backtrace[IDX2C(k, col, L)] = (ElemType) bestPrev;
+            }
+            else
+                alpha[IDX2C(k, col, L)] = (startLabel < 0 || k == startLabel) ? pos[IDX2C(k, col, L)] : (ElemType) LZERO;
+        }
+        __syncthreads();
+    }
+
+    if (threadIdx.x == 0)
+    {
+        const CUDA_LONG lastCol = (tEnd - 1) * S + s;
+        int label = _labelOfColumn(labels + lastCol * L, L);
+        if (label < 0)
+        {
+            label = 0;
+            for (CUDA_LONG k = 1; k < L; k++)
+                if (alpha[IDX2C(k, lastCol, L)] > alpha[IDX2C(label, lastCol, L)])
+                    label = (int) k;
+        }
+        for (CUDA_LONG t = tEnd - 1; t >= tBegin; t--)
+        {
+            const CUDA_LONG col = t * S + s;
+            decodedPath[IDX2C(label, col, L)] = 1;
+            label = (int) backtrace[IDX2C(label, col, L)];
+        }
+    }
+}
+
+// -----------------------------------------------------------------------
+// denominator-graph forward-backward over all sequences of a minibatch (see Matrix::DenominatorForwardBackward())
+// One block per sequence walks the time steps, its threads stride over the graph states.
+// arcs is 4 x 2*numArcs: (source, destination, pdf, log weight), first sorted by destination, then by source;
+// states is 4 x (numStates + 1): (first in-arc, first out-arc, log initial weight, log final weight).
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+__global__ void _denominatorForwardBackward(const ElemType* logLikelihoods, const ElemType* arcs, const ElemType* states, ElemType* alpha, ElemType* beta,
+                                            ElemType* posteriors, ElemType* logDenominators, const ElemType* sequences,
+                                            const CUDA_LONG S, const CUDA_LONG L, const CUDA_LONG N, const CUDA_LONG A)
+{
+    __shared__ double logZ;
+
+    const CUDA_LONG j = blockIdx.x;
+    const CUDA_LONG s = (CUDA_LONG) sequences[IDX2C(0, j, 3)];
+    const CUDA_LONG tBegin = (CUDA_LONG) sequences[IDX2C(1, j, 3)];
+    const CUDA_LONG tEnd = (CUDA_LONG) sequences[IDX2C(2, j, 3)];
+    if (tBegin == tEnd)
+    {
+        if (threadIdx.x == 0)
+            logDenominators[j] = 0;
+        return;
+    }
+    const ElemType* inArcs = arcs;
+    const ElemType* outArcs = arcs + 4 * A;
+
+    // forward: alpha(k, t) = log sum over the arcs i -> k of alpha(i, t-1) + arc weight + log likelihood of the arc's pdf at t
+    for (CUDA_LONG t = tBegin; t < tEnd; t++)
+    {
+        const CUDA_LONG col = t * S + s;
+        for (CUDA_LONG k = threadIdx.x; k < N; k += blockDim.x)
+        {
+            ElemType v = LZERO;
+            for (CUDA_LONG a = (CUDA_LONG) states[IDX2C(0, k, 4)]; a < (CUDA_LONG) states[IDX2C(0, k + 1, 4)]; a++)
+            {
+                const CUDA_LONG src = (CUDA_LONG) inArcs[IDX2C(0, a, 4)];
+                const ElemType prev = t > tBegin ? alpha[IDX2C(src, col - S, N)] : states[IDX2C(2, src, 4)];
+                v = logaddk(v, prev + inArcs[IDX2C(3, a, 4)] + logLikelihoods[IDX2C((CUDA_LONG) inArcs[IDX2C(2, a, 4)], col, L)]);
+            }
+            alpha[IDX2C(k, col, N)] = v;
+        }
+        __syncthreads();
+    }
+
+    const CUDA_LONG lastCol = (tEnd - 1) * S + s;
+    if (threadIdx.x == 0)
+    {
+        ElemType v = LZERO;
+        for (CUDA_LONG k = 0; k < N; k++)
+            v = logaddk(v, alpha[IDX2C(k, lastCol, N)] + states[IDX2C(3, k, 4)]);
+        logZ = v;
+        logDenominators[j] = v > LZERO / 2 ? v : 0;
+    }
+    __syncthreads();
+    if (logZ <= LZERO / 2) // no path through the graph
+        return;
+
+    // backward, with the two latest frames in columns 2j and 2j+1 of beta, and the arc posteriors added to their pdfs
+    for (CUDA_LONG t = tEnd - 1; t >= tBegin; t--)
+    {
+        const CUDA_LONG col = t * S + s;
+        ElemType* cur = beta + (2 * j + t % 2) * N;
+        const ElemType* next = beta + (2 * j + (t + 1) % 2) * N;
+        for (CUDA_LONG k = threadIdx.x; k < N; k += blockDim.x)
+        {
+            ElemType v;
+            if (t < tEnd - 1)
+            {
+                v = LZERO;
+                for (CUDA_LONG a = (CUDA_LONG) states[IDX2C(1, k, 4)]; a < (CUDA_LONG) states[IDX2C(1, k + 1, 4)]; a++)
+                    v = logaddk(v, outArcs[IDX2C(3, a, 4)] + logLikelihoods[IDX2C((CUDA_LONG) outArcs[IDX2C(2, a, 4)], col + S, L)] + next[(CUDA_LONG) outArcs[IDX2C(1, a, 4)]]);
+            }
+            else
+                v = states[IDX2C(3, k, 4)];
+            cur[k] = v;
+        }
+        __syncthreads();
+        for (CUDA_LONG k = threadIdx.x; k < N; k += blockDim.x)
+        {
+            const ElemType prev = t > tBegin ? alpha[IDX2C(k, col - S, N)] : states[IDX2C(2, k, 4)];
+            for (CUDA_LONG a = (CUDA_LONG) states[IDX2C(1, k, 4)]; a < (CUDA_LONG) states[IDX2C(1, k + 1, 4)]; a++)
+            {
+                const CUDA_LONG pdf = (CUDA_LONG) outArcs[IDX2C(2, a, 4)];
+                const ElemType logPost = prev + outArcs[IDX2C(3, a, 4)] + logLikelihoods[IDX2C(pdf, col, L)] + cur[(CUDA_LONG) outArcs[IDX2C(1, a, 4)]] - (ElemType) logZ;
+                if (logPost > LZERO / 2)
+                    atomicAdd(&posteriors[IDX2C(pdf, col, L)], exp_(logPost));
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------
+// class-based softmax over all frames of a minibatch (see Matrix::ClassConditionalLogSoftmax())
+// frames is 5 x numFrames: (column of hidden, offset into the concatenated class-conditional vectors,
+// first word of the class, number of words in the class, target word within the class).
+// The per-frame kernels run one block of 512 threads per frame.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+__device__ void _getClassConditionalFrame(const ElemType* frames, const CUDA_LONG j, CUDA_LONG& col, CUDA_LONG& offset, CUDA_LONG& first, CUDA_LONG& n, CUDA_LONG& target)
+{
+    col = (CUDA_LONG) frames[IDX2C(0, j, 5)];
+    offset = (CUDA_LONG) frames[IDX2C(1, j, 5)];
+    first = (CUDA_LONG) frames[IDX2C(2, j, 5)];
+    n = (CUDA_LONG) frames[IDX2C(3, j, 5)];
+    target = (CUDA_LONG) frames[IDX2C(4, j, 5)];
+}
+
+// logSoftmax[offset + k] = log softmax over k of hidden(:, col)^T * weights(:, first + k)
+template <class ElemType>
+__global__ void _classConditionalLogSoftmax(const ElemType* hidden, const ElemType* weights, const ElemType* frames, ElemType* logSoftmax, ElemType* targetLogProbs, const CUDA_LONG hd)
+{
+    __shared__ ElemType partials[512];
+
+    const CUDA_LONG j = blockIdx.x;
+    CUDA_LONG col, offset, first, n, target;
+    _getClassConditionalFrame(frames, j, col, offset, first, n, target);
+    const ElemType* h = hidden + (size_t) col * hd;
+    ElemType* out = logSoftmax + offset;
+
+    ElemType localMax = (ElemType) LZERO;
+    for (CUDA_LONG k = threadIdx.x; k < n; k += blockDim.x)
+    {
+        const ElemType* w = weights + (size_t)(first + k) * hd;
+        ElemType v = 0;
+        for (CUDA_LONG i = 0; i < hd; i++)
+            v += h[i] * w[i];
+        out[k] = v;
+        localMax = max(localMax, v);
+    }
+    partials[threadIdx.x] = localMax;
+    __syncthreads();
+    for (CUDA_LONG stride = blockDim.x / 2; stride > 0; stride /= 2)
+    {
+        if (threadIdx.x < stride)
+            partials[threadIdx.x] = max(partials[threadIdx.x], partials[threadIdx.x + stride]);
+        __syncthreads();
+    }
+    const ElemType maxVal = partials[0];
+    __syncthreads();
+
+    ElemType localSum = 0;
+    for (CUDA_LONG k = threadIdx.x; k < n; k += blockDim.x)
+        localSum += exp_(out[k] - maxVal);
+    partials[threadIdx.x] = localSum;
+    __syncthreads();
+    for (CUDA_LONG stride = blockDim.x / 2; stride > 0; stride /= 2)
+    {
+        if (threadIdx.x < stride)
+            partials[threadIdx.x] += partials[threadIdx.x + stride];
+        __syncthreads();
+    }
+    const ElemType logSum = maxVal + log_(partials[0]);
+
+    for (CUDA_LONG k = threadIdx.x; k < n; k += blockDim.x)
+    {
+        out[k] -= logSum;
+        if (k == target)
+            targetLogProbs[j] = out[k];
+    }
+}
+
+// grd[offset + k] = (softmax[offset + k] - (k == target)) * gradient[0]
+template <class ElemType>
+__global__ void _classConditionalSoftmaxGradient(const ElemType* logSoftmax, const ElemType* gradient, const ElemType* frames, ElemType* grd)
+{
+    CUDA_LONG col, offset, first, n, target;
+    _getClassConditionalFrame(frames, (CUDA_LONG) blockIdx.x, col, offset, first, n, target);
+    const ElemType g = gradient[0];
+    for (CUDA_LONG k = threadIdx.x; k < n; k += blockDim.x)
+        grd[offset + k] = (exp_(logSoftmax[offset + k]) - (k == target ? 1 : 0)) * g;
+}
+
+// hiddenGradient(:, col) += weights(:, first : first + n) * grd[offset : offset + n]; the threads stride over the rows
+template <class ElemType>
+__global__ void _addClassConditionalHiddenGradient(const ElemType* weights, const ElemType* grd, const ElemType* frames, ElemType* hiddenGradient, const CUDA_LONG hd)
+{
+    CUDA_LONG col, offset, first, n, target;
+    _getClassConditionalFrame(frames, (CUDA_LONG) blockIdx.x, col, offset, first, n, target);
+    for (CUDA_LONG i = threadIdx.x; i < hd; i += blockDim.x)
+    {
+        ElemType sum = 0;
+        for (CUDA_LONG k = 0; k < n; k++)
+            sum += weights[IDX2C(i, first + k, hd)] * grd[offset + k];
+        hiddenGradient[IDX2C(i, col, hd)] += sum;
+    }
+}
+
+// weightGradient(:, first + k) += sum over the frames of a class of hidden(:, col) * grd[offset + k]
+// classes is 2 x numClasses: (first frame, end frame) of each class, whose frames are consecutive in frames.
+// Block (c, y) reduces the elements y, y + gridDim.y, ... (in 512-element steps) of the [hd x n] weight slice of class c;
+// the word ranges of the classes are disjoint, so no atomics are needed.
+template <class ElemType>
+__global__ void _addClassConditionalWeightGradient(const ElemType* hidden, const ElemType* grd, const ElemType* frames, const ElemType* classes, ElemType* weightGradient, const CUDA_LONG hd)
+{
+    const CUDA_LONG frameBegin = (CUDA_LONG) classes[IDX2C(0, blockIdx.x, 2)];
+    const CUDA_LONG frameEnd = (CUDA_LONG) classes[IDX2C(1, blockIdx.x, 2)];
+    if (frameBegin >= frameEnd)
+        return;
+    CUDA_LONG col, offset, first, n, target;
+    _getClassConditionalFrame(frames, frameBegin, col, offset, first, n, target);
+
+    const CUDA_LONG N = hd * n;
+    for (CUDA_LONG e = blockIdx.y * blockDim.x + threadIdx.x; e < N; e += gridDim.y * blockDim.x)
+    {
+        const CUDA_LONG i = e % hd;
+        const CUDA_LONG k = e / hd;
+        ElemType sum = 0;
+        for (CUDA_LONG f = frameBegin; f < frameEnd; f++)
+            sum += hidden[IDX2C(i, (CUDA_LONG) frames[IDX2C(0, f, 5)], hd)] * grd[(CUDA_LONG) frames[IDX2C(1, f, 5)] + k];
+        weightGradient[IDX2C(i, first + k, hd)] += sum;
+    }
+}
+
 template <class ElemType>
 __global__ void _reductionLogAddSum(
     const ElemType* data,
@@ -4950,6 +6129,74 @@ __global__ void _copyTopKResults(const uint64_t* indexes, const ElemType* values
     maxValues[id] = values[icol * crow + irow];
 }
 
+// column-wise top k of a [m x n] matrix for k <= MaxK, one block of BlockSize threads per column
+// Every thread keeps the k largest values of the rows it reads (threadIdx.x, threadIdx.x + BlockSize, ...) in descending
+// order. Then k rounds of a block-wide argmax over the best remaining candidate of each thread pick the results, in
+// descending order. Ties go to the lower row index, as with a stable descending sort of the column.
+template <class ElemType>
+__device__ bool _isBetterTopKCandidate(ElemType val, CUDA_LONG row, ElemType otherVal, CUDA_LONG otherRow)
+{
+    return row >= 0 && (otherRow < 0 || val > otherVal || (val == otherVal && row < otherRow));
+}
+
+template <int BlockSize, int MaxK, class ElemType>
+__global__ void _vectorMaxTopK(const ElemType* us, ElemType* maxIndexes, ElemType* maxValues, const CUDA_LONG m, const int topK)
+{
+    assert(topK <= MaxK && blockDim.x == BlockSize);
+    const CUDA_LONG col = blockIdx.x;
+    const int tid = threadIdx.x;
+
+    // this thread's top k
+    ElemType vals[MaxK];
+    CUDA_LONG rows[MaxK];
+    int count = 0;
+    for (CUDA_LONG i = tid; i < m; i += BlockSize)
+    {
+        const ElemType val = us[IDX2C(i, col, m)];
+        if (count == topK && !(val > vals[topK - 1])) // (a later row loses a tie)
+            continue;
+        int pos = count < topK ? count++ : topK - 1;
+        for (; pos > 0 && val > vals[pos - 1]; pos--)
+        {
+            vals[pos] = vals[pos - 1];
+            rows[pos] = rows[pos - 1];
+        }
+        vals[pos] = val;
+        rows[pos] = i;
+    }
+
+    // merge
+    __shared__ ElemType candidateVals[BlockSize];
+    __shared__ CUDA_LONG candidateRows[BlockSize];
+    __shared__ int candidateThreads[BlockSize];
+    int head = 0;
+    for (int r = 0; r < topK; r++)
+    {
+        candidateVals[tid] = head < count ? vals[head] : 0;
+        candidateRows[tid] = head < count ? rows[head] : -1;
+        candidateThreads[tid] = tid;
+        __syncthreads();
+        for (int s = BlockSize / 2; s > 0; s /= 2)
+        {
+            if (tid < s && _isBetterTopKCandidate(candidateVals[tid + s], candidateRows[tid + s], candidateVals[tid], candidateRows[tid]))
+            {
+                candidateVals[tid] = candidateVals[tid + s];
+                candidateRows[tid] = candidateRows[tid + s];
+                candidateThreads[tid] = candidateThreads[tid + s];
+            }
+            __syncthreads();
+        }
+        if (tid == 0)
+        {
+            maxIndexes[IDX2C(r, col, topK)] = (ElemType) candidateRows[0];
+            maxValues[IDX2C(r, col, topK)] = candidateVals[0];
+        }
+        if (candidateThreads[0] == tid)
+            head++;
+        __syncthreads();
+    }
+}
+
 template <int BlockSize, class ElemType>
 __global__ void _assignNumOfDiffCol(const ElemType* a, const ElemType* b, ElemType* c, CUDA_LONG crowB, CUDA_LONG ccol)
 {
@@ -4995,6 +6242,187 @@ __global__ void _maskColumnsValue(ElemType* a, const char* columnsMask, CUDA_LON
         a[IDX2C(rowIdx, colIdx, numRows)] = val;
     }
 }
+
+// one LSTM time step, one thread per element of the [numRows x S] cell
+template <class ElemType>
+__global__ void _lstmForwardStep(CUDA_LONG N, CUDA_LONG numRows, ElemType* gates, const ElemType* prevCell, ElemType* cell, ElemType* output)
+{
+    CALCULATE_ELEMENTWISE_INDEX_OR_EXIT(id, N);
+    LSTMForwardStepAt<ElemType>(id, numRows, gates, prevCell, cell, output);
+}
+
+template <class ElemType>
+__global__ void _lstmBackwardStep(CUDA_LONG N, CUDA_LONG numRows, const ElemType* gates, const ElemType* prevCell, const ElemType* cell,
+                                  const ElemType* outputGradient, ElemType* cellGradient, ElemType* gatesGradient)
+{
+    CALCULATE_ELEMENTWISE_INDEX_OR_EXIT(id, N);
+    LSTMBackwardStepAt<ElemType>(id, numRows, gates, prevCell, cell, outputGradient, cellGradient, gatesGradient);
+}
+
+// sum over the 32 threads of a warp; the result is valid in its first thread
+static __device__ float _lstmWarpSum(float val)
+{
+    for (int delta = 16; delta > 0; delta /= 2)
+#if __CUDACC_VER_MAJOR__ >= 9
+        val += __shfl_down_sync(0xffffffff, val, delta);
+#else
+        val += __shfl_down(val, delta);
+#endif
+    return val;
+}
+static __device__ double _lstmWarpSum(double val)
+{
+    for (int delta = 16; delta > 0; delta /= 2)
+    {
+        int lo = __double2loint(val);
+        int hi = __double2hiint(val);
+#if __CUDACC_VER_MAJOR__ >= 9
+        lo = __shfl_down_sync(0xffffffff, lo, delta);
+        hi = __shfl_down_sync(0xffffffff, hi, delta);
+#else
+        lo = __shfl_down(lo, delta);
+        hi = __shfl_down(hi, delta);
+#endif
+        val += __hiloint2double(hi, lo);
+    }
+    return val;
+}
+
+// all blocks of the grid wait here until the counter has reached 'target' arrivals
+static __device__ void _lstmGridBarrier(unsigned int* counter, unsigned int target)
+{
+    __syncthreads();
+    if (threadIdx.x == 0)
+    {
+        __threadfence(); // (the block's writes are visible to the others before its arrival is)
+        atomicAdd(counter, 1);
+        while (*(volatile unsigned int*) counter < target)
+            ;
+        __threadfence();
+    }
+    __syncthreads();
+}
+
+// all time steps of an LSTM layer in a single launch (a persistent kernel), for small cell dimensions
+// Block b owns the cells [j0, j0 + unitsPerBlock) and keeps their four rows of R [4N x N] in shared memory for the whole
+// sequence. A warp computes the recurrent part of the four gates of one cell of one stream and then the cell update.
+// The blocks go through time in lockstep, meeting at a barrier after each step, which requires all of them to be
+// resident at once, i.e. no more blocks than the GPU can run side by side. h_{t-1} has been written by the other
+// blocks in the previous step, hence it is read through volatile loads that do not hit stale L1 lines.
+// 'gates' come in holding W x_t + b; the columns of step 0 of 'prevOutput' and 'prevCell' are given, those of later steps
+// are filled in from the previous step, 0 where 'resetMask' is 0.
+template <class ElemType>
+__global__ void _lstmForwardSequence(CUDA_LONG N, CUDA_LONG S, CUDA_LONG T, CUDA_LONG unitsPerBlock, const ElemType* R, ElemType* gates, const char* resetMask,
+                                     ElemType* prevOutput, ElemType* prevCell, ElemType* cell, ElemType* output, unsigned int* barrier)
+{
+    extern __shared__ double _lstmSharedRows[]; // (double for the alignment)
+    ElemType* r = (ElemType*) _lstmSharedRows;  // [(gate * units + u) * N + k] = R[gate * N + j0 + u, k]
+    const CUDA_LONG j0 = blockIdx.x * unitsPerBlock;
+    const CUDA_LONG units = min(unitsPerBlock, N - j0);
+    for (CUDA_LONG k = threadIdx.x; k < 4 * units * N; k += blockDim.x)
+    {
+        const CUDA_LONG row = k % (4 * units), col = k / (4 * units);
+        const CUDA_LONG gate = row / units, u = row % units;
+        r[(gate * units + u) * N + col] = R[(size_t) col * 4 * N + gate * N + j0 + u];
+    }
+    __syncthreads();
+
+    const CUDA_LONG lane = threadIdx.x % warpSize;
+    const CUDA_LONG numWarps = blockDim.x / warpSize;
+    for (CUDA_LONG t = 0; t < T; t++)
+    {
+        for (CUDA_LONG item = threadIdx.x / warpSize; item < units * S; item += numWarps)
+        {
+            const CUDA_LONG u = item % units, s = item / units;
+            const CUDA_LONG j = j0 + u, col = t * S + s;
+            const bool continues = t == 0 || resetMask[col] != 0;
+            const volatile ElemType* h = t == 0 ? prevOutput + (size_t) col * N : output + (size_t) (col - S) * N;
+            ElemType z[4] = {0, 0, 0, 0};
+            if (continues)
+            {
+                for (CUDA_LONG k = lane; k < N; k += warpSize)
+                {
+                    const ElemType hk = h[k];
+                    for (int gate = 0; gate < 4; gate++)
+                        z[gate] += r[(gate * units + u) * N + k] * hk;
+                }
+            }
+            for (int gate = 0; gate < 4; gate++)
+                z[gate] = _lstmWarpSum(z[gate]);
+            if (lane == 0)
+            {
+                if (t > 0) // (the previous values of the block's own cells, written by this block)
+                {
+                    prevOutput[(size_t) col * N + j] = continues ? output[(size_t) (col - S) * N + j] : 0;
+                    prevCell[(size_t) col * N + j] = continues ? cell[(size_t) (col - S) * N + j] : 0;
+                }
+                ElemType* zj = gates + (size_t) col * 4 * N + j;
+                for (int gate = 0; gate < 4; gate++)
+                    zj[gate * N] += z[gate];
+                LSTMForwardStepAt<ElemType>((size_t) col * N + j, N, gates, prevCell, cell, output);
+            }
+        }
+        if (t + 1 < T)
+            _lstmGridBarrier(barrier, gridDim.x * (t + 1));
+    }
+}
+
+// c = alpha * a * b + beta * c for a block-sparse row matrix a [m x k] (see CPUSparseMatrix) and a dense b [k x n]
+// Thread block (blockIdx.x, blockIdx.y) computes block row blockIdx.x of c for blockDim.y columns; threadIdx.x is the row within the block,
+// so that a warp reads the block columns contiguously and every element of b it needs is a broadcast.
+// BlockDim is the block dimension, or 0 for one known only at runtime (runtimeBlockDim); a fixed one lets the compiler unroll the loop over a block.
+template <class ElemType, int BlockDim>
+__global__ void _bsrTimesDense(const CUDA_LONG m, const CUDA_LONG k, const CUDA_LONG n, const int runtimeBlockDim, const ElemType alpha, const ElemType* values,
+                               const GPUSPARSE_INDEX_TYPE* blockRowStarts, const GPUSPARSE_INDEX_TYPE* blockCols, const ElemType* b, const ElemType beta, ElemType* c)
+{
+    const int dim = BlockDim > 0 ? BlockDim : runtimeBlockDim;
+    const CUDA_LONG blockRow = blockIdx.x;
+    const CUDA_LONG row = blockRow * dim + threadIdx.x;
+    const CUDA_LONG col = blockIdx.y * blockDim.y + threadIdx.y;
+    if (col >= n)
+        return;
+
+    const ElemType* bCol = b + IDX2C(0, col, k);
+    ElemType sum = 0;
+    for (GPUSPARSE_INDEX_TYPE p = blockRowStarts[blockRow]; p < blockRowStarts[blockRow + 1]; p++)
+    {
+        const ElemType* blockRowValues = values + (size_t) p * dim * dim + threadIdx.x;
+        const CUDA_LONG colBegin = (CUDA_LONG) blockCols[p] * dim;
+        if (colBegin + dim <= k)
+        {
+#pragma unroll
+            for (int q = 0; q < dim; q++)
+                sum += blockRowValues[q * dim] * bCol[colBegin + q];
+        }
+        else // block at the right edge: its padding columns have no rows in b
+        {
+            for (CUDA_LONG q = 0; colBegin + q < k; q++)
+                sum += blockRowValues[q * dim] * bCol[colBegin + q];
+        }
+    }
+    if (row < m)
+        c[IDX2C(row, col, m)] = alpha * sum + (beta == 0 ? 0 : beta * c[IDX2C(row, col, m)]);
+}
+
+// scatter the blocks of a block-sparse row matrix into a zeroed dense matrix [m x k], one thread block per block row
+template <class ElemType>
+__global__ void _bsrToDense(const CUDA_LONG m, const CUDA_LONG k, const int dim, const ElemType* values, const GPUSPARSE_INDEX_TYPE* blockRowStarts,
+                            const GPUSPARSE_INDEX_TYPE* blockCols, ElemType* dense)
+{
+    const CUDA_LONG blockRow = blockIdx.x;
+    const CUDA_LONG blockSize = dim * dim;
+    const GPUSPARSE_INDEX_TYPE begin = blockRowStarts[blockRow];
+    const CUDA_LONG numValues = (blockRowStarts[blockRow + 1] - begin) * blockSize;
+    for (CUDA_LONG id = threadIdx.x; id < numValues; id += blockDim.x)
+    {
+        const CUDA_LONG p = begin + id / blockSize;
+        const CUDA_LONG withinBlock = id % blockSize;
+        const CUDA_LONG row = blockRow * dim + withinBlock % dim;
+        const CUDA_LONG col = (CUDA_LONG) blockCols[p] * dim + withinBlock / dim;
+        if (row < m && col < k)
+            dense[IDX2C(row, col, m)] = values[(size_t) p * blockSize + withinBlock];
+    }
+}
 }
 }
 }
@@ -19,6 +19,8 @@
 #include "CommonMatrix.h"
 #include <iostream> // for cout/cerr
 #include <assert.h>
+#include <map>
+#include <mutex>
 
 typedef unsigned char byte;
 
@@ -65,7 +67,8 @@ template <class ElemType>
 void GPUSparseMatrix<ElemType>::ZeroInit(const MatrixFormat matrixFormat, const DEVICEID_TYPE computeDevice)
 {
     if (matrixFormat != MatrixFormat::matrixFormatSparseCSC && matrixFormat != MatrixFormat::matrixFormatSparseCSR &&
-        matrixFormat != MatrixFormat::matrixFormatSparseBlockCol && matrixFormat != MatrixFormat::matrixFormatSparseBlockRow)
+        matrixFormat != MatrixFormat::matrixFormatSparseBlockCol && matrixFormat != MatrixFormat::matrixFormatSparseBlockRow &&
+        matrixFormat != MatrixFormat::matrixFormatSparseBSR)
     {
         LogicError("GPUSparseMatrix:  unsupported sparse matrix format");
     }
@@ -83,8 +86,10 @@ void GPUSparseMatrix<ElemType>::ZeroInit(const MatrixFormat matrixFormat, const
     m_matrixName = nullptr;
 
     m_blockSize = 0;
+    m_bsrBlockDim = 0;
 
     m_rowToId = nullptr;
+    m_derivedCache.reset();
 
     m_tempHostBuffer = nullptr;
     m_tempHostBufferSize = 0;
@@ -141,6 +146,7 @@ void GPUSparseMatrix<ElemType>::DeepCopy(const GPUSparseMatrix<ElemType>& deepCo
 
     Resize(deepCopy.m_numRows, deepCopy.m_numCols, deepCopy.GetNumNZElements(), deepCopy.m_format, true, false);
     m_nz = deepCopy.m_nz;
+    m_bsrBlockDim = deepCopy.m_bsrBlockDim;
     m_sliceViewOffset = 0; // reset to zero as we only start copying the indices starting from the offset in the source matrix
 
     CUDA_CALL(cudaMemcpy(BufferPointer(), deepCopy.NzValues(), NzSize(), cudaMemcpyDeviceToDevice));
@@ -203,6 +209,10 @@ void GPUSparseMatrix<ElemType>::SetValue(const CPUSparseMatrix<ElemType>& deepCo
     {
         SetMatrixFromCSCFormat(deepCopy.ColLocation(), deepCopy.RowLocation(), deepCopy.BufferPointer(), deepCopy.GetNumElemAllocated(), deepCopy.GetNumRows(), deepCopy.GetNumCols());
     }
+    else if (deepCopy.GetFormat() == matrixFormatSparseBSR)
+    {
+        SetMatrixFromBSRFormat(deepCopy.SecondaryIndexLocation(), deepCopy.MajorIndexLocation(), deepCopy.NzValues(), deepCopy.GetNumBSRBlocks(), deepCopy.GetBSRBlockDim(), deepCopy.GetNumRows(), deepCopy.GetNumCols());
+    }
     else
         NOT_IMPLEMENTED;
 }
@@ -268,10 +278,50 @@ void GPUSparseMatrix<ElemType>::CopyToCPUSparseMatrix(CPUSparseMatrix<ElemType>&
 
         CUDA_CALL(cudaMemcpy(cpuSparseMatrix.BufferPointer(), BufferPointer(), GetSizeElemAllocated(), cudaMemcpyDeviceToHost));
     }
+    else if (this->GetFormat() == matrixFormatSparseBSR)
+    {
+        const size_t numBlocks = m_nz / (m_bsrBlockDim * m_bsrBlockDim);
+        const size_t numBlockRows = (m_numRows + m_bsrBlockDim - 1) / m_bsrBlockDim;
+        std::vector<GPUSPARSE_INDEX_TYPE> blockRowStarts(numBlockRows + 1), blockCols(numBlocks);
+        std::vector<ElemType> values(m_nz);
+
+        PrepareDevice();
+        CUDA_CALL(cudaMemcpy(blockRowStarts.data(), SecondaryIndexLocation(), sizeof(GPUSPARSE_INDEX_TYPE) * blockRowStarts.size(), cudaMemcpyDeviceToHost));
+        if (numBlocks > 0)
+        {
+            CUDA_CALL(cudaMemcpy(blockCols.data(), MajorIndexLocation(), sizeof(GPUSPARSE_INDEX_TYPE) * numBlocks, cudaMemcpyDeviceToHost));
+            CUDA_CALL(cudaMemcpy(values.data(), NzValues(), NzSize(), cudaMemcpyDeviceToHost));
+        }
+        std::vector<CPUSPARSE_INDEX_TYPE> cpuBlockRowStarts(blockRowStarts.begin(), blockRowStarts.end()), cpuBlockCols(blockCols.begin(), blockCols.end());
+        cpuSparseMatrix.SetMatrixFromBSRFormat(cpuBlockRowStarts.data(), cpuBlockCols.data(), values.data(), numBlocks, m_bsrBlockDim, m_numRows, m_numCols);
+    }
     else
         NOT_IMPLEMENTED;
 }
 
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::CopyOneHotIndicesTo(GPUMatrix<ElemType>& indices) const
+{
+    if (m_format != matrixFormatSparseCSC)
+        NOT_IMPLEMENTED;
+
+    indices.Resize(1, m_numCols);
+    if (m_numCols == 0)
+        return;
+    PrepareDevice();
+    int blocksPerGrid = (int) ceil(1.0 * m_numCols / GridDim::maxThreadsPerBlock);
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _cscOneHotIndices<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>((CUDA_LONG) m_numCols, ColLocation(), RowLocation(), indices.BufferPointer());
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::CopyToDenseMatrix(GPUMatrix<ElemType>& denseMatrix) const
 {
@@ -282,6 +332,27 @@ void GPUSparseMatrix<ElemType>::CopyToDenseMatrix(GPUMatrix<ElemType>& denseMatr
     }
 
     PrepareDevice();
+    if (m_format == MatrixFormat::matrixFormatSparseBSR)
+    {
+        denseMatrix.Resize(m_numRows, m_numCols);
+        denseMatrix.SetValue(0);
+        const size_t numBlockRows = (m_numRows + m_bsrBlockDim - 1) / m_bsrBlockDim;
+        if (m_nz == 0)
+            return;
+        cudaEvent_t done = nullptr;
+        if (do_sync)
+            CUDA_CALL(cudaEventCreate(&done));
+        _bsrToDense<ElemType><<<(int) numBlockRows, GridDim::maxThreadsPerBlock, 0, t_stream>>>((CUDA_LONG) m_numRows, (CUDA_LONG) m_numCols, (int) m_bsrBlockDim,
+                                                                                              NzValues(), SecondaryIndexLocation(), MajorIndexLocation(), denseMatrix.BufferPointer());
+        if (do_sync)
+            CUDA_CALL(cudaEventRecord(done));
+        if (do_sync)
+            CUDA_CALL(cudaEventSynchronize(done));
+        if (do_sync)
+            CUDA_CALL(cudaEventDestroy(done));
+        return;
+    }
+
     cusparseHandle_t cusparseHandle = 0;
     CUSPARSE_CALL(cusparseCreate(&cusparseHandle));
     cusparseMatDescr_t descr = 0;
@@ -428,6 +499,7 @@ void GPUSparseMatrix<ElemType>::ChangeDeviceTo(DEVICEID_TYPE to_id)
         LogicError("to_id must be valid GPU");
     if (m_computeDevice == to_id)
         return;
+    InvalidateDerivedCache();
 
     if (m_totalBufferSizeAllocated == 0) // nothing to move
     {
@@ -592,8 +664,10 @@ GPUSparseMatrix<ElemType>::GPUSparseMatrix(GPUSparseMatrix<ElemType>&& moveFrom)
     m_matrixName = moveFrom.m_matrixName;
 
     m_blockSize = moveFrom.m_blockSize;
+    m_bsrBlockDim = moveFrom.m_bsrBlockDim;
 
     m_rowToId = moveFrom.m_rowToId;
+    m_derivedCache = std::move(moveFrom.m_derivedCache);
 
     m_tempHostBuffer = moveFrom.m_tempHostBuffer;
     m_tempHostBufferSize = moveFrom.m_tempHostBufferSize;
@@ -622,8 +696,10 @@ GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::operator=(GPUSparseMatrix<
         m_matrixName = moveFrom.m_matrixName;
 
         m_blockSize = moveFrom.m_blockSize;
+        m_bsrBlockDim = moveFrom.m_bsrBlockDim;
 
         m_rowToId = moveFrom.m_rowToId;
+        m_derivedCache = std::move(moveFrom.m_derivedCache);
 
         m_tempHostBuffer = moveFrom.m_tempHostBuffer;
         m_tempHostBufferSize = moveFrom.m_tempHostBufferSize;
@@ -648,6 +724,8 @@ void GPUSparseMatrix<ElemType>::ReleaseMemory()
     // case we shouldn't free anything.
     if (OwnBuffer())
     {
+        InvalidateDerivedCache(); // (for the views; of a view, the matrix keeps it)
+
         delete[] m_matrixName;
         m_matrixName = nullptr;
 
@@ -685,6 +763,7 @@ void GPUSparseMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCo
 {
     if (!OwnBuffer())
         LogicError("GPUSparseMatrix::Reshape: Cannot Reshape since the buffer is managed externally.");
+    InvalidateDerivedCache();
 
     if (m_numRows == numRows && m_numCols == numCols)
         return;
@@ -756,6 +835,7 @@ void GPUSparseMatrix<ElemType>::Resize(const size_t numRows, const size_t numCol
 {
     if (!OwnBuffer())
         LogicError("Cannot Resize since the buffer is managed externally.");
+    InvalidateDerivedCache();
 
     if (matrixFormat != m_format || m_numRows != numRows || m_numCols != numCols)
         keepExistingValues = false;
@@ -814,6 +894,7 @@ void GPUSparseMatrix<ElemType>::Resize(const size_t numRows, const size_t numCol
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::Reset()
 {
+    InvalidateDerivedCache();
     m_nz = 0;
     m_blockSize = 0;
 }
@@ -853,6 +934,7 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSRFormat(const GPUSPARSE_INDEX_TYP
         CUDA_CALL(cudaMemcpy(RowLocation(), pRow, RowSize(), kind));
         CUDA_CALL(cudaMemcpy(ColLocation(), pCol, ColSize(), kind));
     }
+    ArmDerivedCache();
 }
 
 // this function will allocate memory while the caller needs to release it
@@ -934,6 +1016,79 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
         CUDA_CALL(cudaMemcpy(RowLocation(), pRow, RowSize(), kind));
         CUDA_CALL(cudaMemcpy(ColLocation(), pCol, ColSize(), kind));
     }
+    ArmDerivedCache();
+}
+
+// The triplets of SetMatrixFromCOOFormat() are packed into a page-locked host buffer and uploaded with one copy into a
+// device buffer; both are kept per device and only grow. The host buffer is refilled once its last upload is done; the
+// device buffer is only used on t_stream, after the kernels that read it before.
+struct COOStaging
+{
+    char* host = nullptr;
+    char* device = nullptr;
+    size_t size = 0;
+    cudaEvent_t uploaded = nullptr;
+};
+static std::mutex s_cooStagingMutex;
+static std::map<DEVICEID_TYPE, COOStaging> s_cooStagings;
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromCOOFormat(const CPUSPARSE_INDEX_TYPE* h_Col, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                                       const size_t nz, const size_t numRows, const size_t numCols)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot Set since the buffer is managed externally.");
+    if (nz > 0 && (h_Col == nullptr || h_Row == nullptr || h_Val == nullptr))
+        LogicError("SetMatrixFromCOOFormat: nullptr passed in.");
+
+    SetComputeDeviceId(PrepareDevice());
+    m_format = matrixFormatSparseCSC;
+    Resize(numRows, numCols, nz, true, false);
+    SetNzCount(nz);
+
+    const size_t valueBytes = nz * sizeof(ElemType);
+    const size_t indexBytes = nz * sizeof(GPUSPARSE_INDEX_TYPE);
+    const size_t numBytes = max(valueBytes + 2 * indexBytes, (size_t) 1);
+    std::lock_guard<std::mutex> lock(s_cooStagingMutex);
+    auto& staging = s_cooStagings[m_computeDevice];
+    if (staging.size < numBytes)
+    {
+        if (staging.host)
+        {
+            CUDA_CALL(cudaStreamSynchronize(t_stream)); // (the kernels may still read the device buffer)
+            CUDA_CALL(cudaFreeHost(staging.host));
+            TracingGPUMemoryAllocator::Free<char>(m_computeDevice, staging.device);
+        }
+        else
+            CUDA_CALL(cudaEventCreateWithFlags(&staging.uploaded, cudaEventDisableTiming));
+        staging.size = max(numBytes, 2 * staging.size);
+        CUDA_CALL(cudaHostAlloc((void**) &staging.host, staging.size, cudaHostAllocDefault));
+        staging.device = TracingGPUMemoryAllocator::Allocate<char>(m_computeDevice, staging.size);
+    }
+    else
+        CUDA_CALL(cudaEventSynchronize(staging.uploaded));
+
+    memcpy(staging.host, h_Val, valueBytes);
+    CopyBuffer((GPUSPARSE_INDEX_TYPE*) (staging.host + valueBytes), h_Row, nz);
+    CopyBuffer((GPUSPARSE_INDEX_TYPE*) (staging.host + valueBytes + indexBytes), h_Col, nz);
+    CUDA_CALL(cudaMemcpyAsync(staging.device, staging.host, valueBytes + 2 * indexBytes, cudaMemcpyHostToDevice, t_stream));
+    CUDA_CALL(cudaEventRecord(staging.uploaded, t_stream));
+
+    CUDA_LONG N = (CUDA_LONG) max(nz, numCols + 1);
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    _assembleCSCFromCOO<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+        (const ElemType*) staging.device, (const GPUSPARSE_INDEX_TYPE*) (staging.device + valueBytes), (const GPUSPARSE_INDEX_TYPE*) (staging.device + valueBytes + indexBytes),
+        (CUDA_LONG) nz, (CUDA_LONG) numCols, BufferPointer(), RowLocation(), ColLocation());
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+    ArmDerivedCache();
 }
 
 // this function will allocate memory while the caller needs to release it
@@ -978,6 +1133,74 @@ void GPUSparseMatrix<ElemType>::GetMatrixFromCSCFormat(GPUSPARSE_INDEX_TYPE*& h_
     }
 }
 
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromBSRFormat(const CPUSPARSE_INDEX_TYPE* h_blockRowStarts, const CPUSPARSE_INDEX_TYPE* h_blockCols, const ElemType* h_blockValues,
+                                                       const size_t numBlocks, const size_t blockDim, const size_t numRows, const size_t numCols)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot Set since the buffer is managed externally.");
+    if (blockDim == 0 || blockDim > CPUSparseMatrix<ElemType>::maxBSRBlockDim)
+        InvalidArgument("SetMatrixFromBSRFormat: The block dimension must be between 1 and %d.", (int) CPUSparseMatrix<ElemType>::maxBSRBlockDim);
+
+    PrepareDevice();
+    Resize(numRows, numCols, numBlocks * blockDim * blockDim, matrixFormatSparseBSR, true, false);
+    SetNzCount(numBlocks * blockDim * blockDim);
+    m_bsrBlockDim = blockDim;
+
+    const size_t numBlockRows = (numRows + blockDim - 1) / blockDim;
+    std::vector<GPUSPARSE_INDEX_TYPE> blockRowStarts(h_blockRowStarts, h_blockRowStarts + numBlockRows + 1), blockCols(h_blockCols, h_blockCols + numBlocks);
+    CUDA_CALL(cudaMemcpy(SecondaryIndexLocation(), blockRowStarts.data(), sizeof(GPUSPARSE_INDEX_TYPE) * blockRowStarts.size(), cudaMemcpyHostToDevice));
+    if (numBlocks > 0)
+    {
+        CUDA_CALL(cudaMemcpy(MajorIndexLocation(), blockCols.data(), sizeof(GPUSPARSE_INDEX_TYPE) * numBlocks, cudaMemcpyHostToDevice));
+        CUDA_CALL(cudaMemcpy(NzValues(), h_blockValues, NzSize(), cudaMemcpyHostToDevice));
+    }
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::GetSparseBlockColData(std::vector<size_t>& columnIds, std::vector<ElemType>& values) const
+{
+    if (m_format != matrixFormatSparseBlockCol)
+        LogicError("GetSparseBlockColData: The matrix is not in SparseBlockCol format.");
+
+    std::vector<GPUSPARSE_INDEX_TYPE> blockId2Col(m_blockSize);
+    values.resize(m_blockSize * m_numRows);
+    if (m_blockSize > 0)
+    {
+        PrepareDevice();
+        CUDA_CALL(cudaMemcpy(blockId2Col.data(), BlockId2ColOrRow(), sizeof(GPUSPARSE_INDEX_TYPE) * m_blockSize, cudaMemcpyDeviceToHost));
+        CUDA_CALL(cudaMemcpy(values.data(), NzValues(), sizeof(ElemType) * values.size(), cudaMemcpyDeviceToHost));
+    }
+    columnIds.assign(blockId2Col.begin(), blockId2Col.end());
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetSparseBlockColData(const size_t numRows, const size_t numCols, const std::vector<size_t>& columnIds, const std::vector<ElemType>& values)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+    if (values.size() != numRows * columnIds.size())
+        InvalidArgument("SetSparseBlockColData: Expected %d values for %d columns.", (int) (numRows * columnIds.size()), (int) columnIds.size());
+
+    Resize(numRows, numCols, values.size(), matrixFormatSparseBlockCol, true, false);
+    m_nz = values.size();
+    m_blockSize = columnIds.size();
+
+    // columns without values map to block id numCols, as in _determineBlockIds()
+    std::vector<GPUSPARSE_INDEX_TYPE> blockId2Col(numCols, 0);
+    std::vector<GPUSPARSE_INDEX_TYPE> col2BlockId(numCols, (GPUSPARSE_INDEX_TYPE) numCols);
+    for (size_t j = 0; j < columnIds.size(); j++)
+    {
+        blockId2Col[j] = (GPUSPARSE_INDEX_TYPE) columnIds[j];
+        col2BlockId[columnIds[j]] = (GPUSPARSE_INDEX_TYPE) j;
+    }
+    PrepareDevice();
+    CUDA_CALL(cudaMemcpy(BlockId2ColOrRow(), blockId2Col.data(), sizeof(GPUSPARSE_INDEX_TYPE) * numCols, cudaMemcpyHostToDevice));
+    CUDA_CALL(cudaMemcpy(ColOrRow2BlockId(), col2BlockId.data(), sizeof(GPUSPARSE_INDEX_TYPE) * numCols, cudaMemcpyHostToDevice));
+    if (m_nz > 0)
+        CUDA_CALL(cudaMemcpy(NzValues(), values.data(), sizeof(ElemType) * m_nz, cudaMemcpyHostToDevice));
+}
+
 #pragma endregion Constructors and Destructor
 
 #pragma region Static BLAS Functions
@@ -1011,15 +1234,25 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
         c.VerifySize(m, n); // Can't resize if beta != 0
 
     c.PrepareDevice();
-    if (rhs.m_format == MatrixFormat::matrixFormatSparseCSC)
+    if (rhs.m_format == MatrixFormat::matrixFormatSparseCSC && !transposeA && rhs.HasFewNonZerosPerColumn())
+    {
+        GatherMultiplyAndWeightedAdd(alpha, lhs, rhs, transposeB, beta, c);
+    }
+    else if (rhs.m_format == MatrixFormat::matrixFormatSparseCSC)
     {
         ConvolveAndWeightedAdd(alpha, lhs, transposeA, rhs, transposeB, beta, c, 1, 1, false, false);
     }
     else if (rhs.m_format == matrixFormatSparseCSR)
     {
-        GPUSparseMatrix<ElemType> tempMatrix(matrixFormatSparseCSC, rhs.GetComputeDeviceId());
-        rhs.ConvertToSparseFormat(matrixFormatSparseCSC, tempMatrix);
-        MultiplyAndWeightedAdd(alpha, lhs, transposeA, tempMatrix, transposeB, beta, c);
+        DerivedCache& cache = rhs.GetDerivedCache(); // (the CSC copy of a reader input is made once per minibatch)
+        if (!cache.csc)
+            cache.csc.reset(new GPUSparseMatrix<ElemType>(matrixFormatSparseCSC, rhs.GetComputeDeviceId()));
+        if (!cache.valid || !cache.hasCSC)
+        {
+            rhs.ConvertToSparseFormat(matrixFormatSparseCSC, *cache.csc);
+            cache.hasCSC = cache.valid;
+        }
+        MultiplyAndWeightedAdd(alpha, lhs, transposeA, *cache.csc, transposeB, beta, c);
     }
     else
     {
@@ -1027,6 +1260,64 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
     }
 }
 
+// dense X sparse = dense for a CSC rhs with few non-zeros per column (see HasFewNonZerosPerColumn()), e.g. one-hot inputs:
+// c = alpha * lhs * rhs + beta * c gathers columns of lhs, and the gradient c = alpha * lhs * rhs^T + beta * c scatter-adds them,
+// each with a single kernel launch (ConvolveAndWeightedAdd() launches one per column of rhs for the gradient)
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::GatherMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const GPUSparseMatrix<ElemType>& rhs,
+                                                             const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c)
+{
+    // the caller has verified the dimensions and sized c
+    const int m = (int) lhs.GetNumRows();
+    const int n = (int) rhs.GetNumCols(); // columns of c, or of lhs if transposeB
+    assert(c.GetNumRows() == m);
+
+    if (transposeB) // scatter-add into c, hence apply beta first
+    {
+        if (beta == 0)
+            c.SetValue(0);
+        else if (beta != 1)
+            c *= beta;
+    }
+
+    if (n == 0 || (transposeB && rhs.m_nz == 0))
+        return;
+
+    // a block of threads covers consecutive rows of a column, so that the columns of lhs are read and c is written coalesced
+    const int threadsPerBlock = min(m, (int) GridDim::maxThreadsPerBlock);
+    const dim3 blocksPerGrid((m + threadsPerBlock - 1) / threadsPerBlock, min(n, 65535));
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    if (!transposeB)
+    {
+        _denseMultSparseCSCGatherAndWeightedAddToDense<ElemType><<<blocksPerGrid, threadsPerBlock, 0, t_stream>>>(
+            m, n, alpha,
+            reinterpret_cast<const ElemType*>(lhs.BufferPointer()), // dense
+            reinterpret_cast<const ElemType*>(rhs.BufferPointer()), // sparse nz values
+            rhs.RowLocation(),
+            rhs.ColLocation(),
+            beta,
+            reinterpret_cast<ElemType*>(c.BufferPointer())); // dense target
+    }
+    else
+    {
+        _denseMultSparseCSCTransposeScatterAndAddToDense<ElemType><<<blocksPerGrid, threadsPerBlock, 0, t_stream>>>(
+            m, n, alpha,
+            reinterpret_cast<const ElemType*>(lhs.BufferPointer()), // dense
+            reinterpret_cast<const ElemType*>(rhs.BufferPointer()), // sparse nz values
+            rhs.RowLocation(),
+            rhs.ColLocation(),
+            reinterpret_cast<ElemType*>(c.BufferPointer())); // dense target
+    }
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::ConvolveAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const bool transposeA,
                                                        const GPUSparseMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c, size_t numChannels, size_t horizontalSubsample, bool padding, bool channelwise)
@@ -1332,6 +1623,10 @@ size_t GPUSparseMatrix<ElemType>::IdentifyRowsWithValues() const
     if (GetFormat() != matrixFormatSparseCSC)
         NOT_IMPLEMENTED;
 
+    DerivedCache& cache = GetDerivedCache(); // (m_rowToId still holds the numbering if this slice made it last)
+    if (cache.valid && cache.numRowsWithValues != SIZE_MAX && cache.rowsFirstColumn == m_sliceViewOffset && cache.rowsNumColumns == m_numCols)
+        return cache.numRowsWithValues;
+
     map<size_t, GPUSPARSE_INDEX_TYPE> indexer;
     GPUSPARSE_INDEX_TYPE* rowToId = (GPUSPARSE_INDEX_TYPE*) ReserveTempHostBuffer(sizeof(GPUSPARSE_INDEX_TYPE) * m_nz * 2);
     GPUSPARSE_INDEX_TYPE* h_Row = rowToId + m_nz;
@@ -1348,6 +1643,9 @@ size_t GPUSparseMatrix<ElemType>::IdentifyRowsWithValues() const
         rowToId[i] = indexer[row];
     }
     CUDA_CALL(cudaMemcpy(m_rowToId, rowToId, sizeof(GPUSPARSE_INDEX_TYPE) * m_nz, cudaMemcpyHostToDevice));
+    cache.rowsFirstColumn = m_sliceViewOffset;
+    cache.rowsNumColumns = m_numCols;
+    cache.numRowsWithValues = indexer.size();
     return indexer.size();
 }
 
@@ -1398,6 +1696,7 @@ GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::InplaceTruncate(const Elem
 {
     if (!OwnBuffer())
         LogicError("Cannot modify since the buffer is managed externally.");
+    InvalidateDerivedCache();
 
     CUDA_LONG N = (CUDA_LONG) GetNumNZElements();
 
@@ -1422,6 +1721,7 @@ GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::InplaceSoftThreshold(const
 {
     if (!OwnBuffer())
         LogicError("Cannot modify since the buffer is managed externally.");
+    InvalidateDerivedCache();
 
     CUDA_LONG N = (CUDA_LONG) GetNumNZElements();
 
@@ -1542,6 +1842,99 @@ ElemType GPUSparseMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& c, const bool n
     }
 }
 
+// row-sparse (lazy) versions, see CPUSparseMatrix::FSAdagrad() for the layout of c
+static size_t NumColsForStepCounters(size_t numRows, size_t numCols)
+{
+    return (numCols + 1 + numRows - 1) / numRows;
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues,
+                                          ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul)
+{
+    if (m_format != matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+
+    size_t n = GetNumElements();
+    size_t numColsNeeded = 2 * GetNumCols() + NumColsForStepCounters(GetNumRows(), GetNumCols());
+    if (c.IsEmpty() || c.GetNumCols() != numColsNeeded)
+    {
+        c.Resize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    ElemType* lastSteps = c.BufferPointer() + 2 * n;
+    int blocksPerGrid = (m_nz + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+    if (m_nz > 0)
+    {
+        _fsadagrad4BlockSparse<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(m_nz, GetNumRows(), BufferPointer(), BlockId2ColOrRow(),
+                                                                                         c.BufferPointer(), c.BufferPointer() + n, lastSteps, GetNumCols(), functionValues.BufferPointer(),
+                                                                                         learnRatePerSample, momentum, adaWeight, adaMul);
+        blocksPerGrid = (int) ((m_blockSize + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock);
+        _updateLastSteps4BlockSparse<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(m_blockSize, BlockId2ColOrRow(), lastSteps, GetNumCols());
+    }
+    _advanceStep4BlockSparse<ElemType><<<1, 1>>>(lastSteps, GetNumCols());
+}
+
+template <class ElemType>
+ElemType GPUSparseMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX,
+                                            ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+    if (m_format != matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+
+    const ElemType floor = 1e-6f;
+    size_t n = GetNumElements();
+    size_t numStepCols = NumColsForStepCounters(GetNumRows(), GetNumCols());
+    size_t numColsNeeded = 3 * GetNumCols() + numStepCols;
+    if (needAveMultiplier)
+        numColsNeeded += GetNumCols();
+    if (c.IsEmpty() || c.GetNumCols() != numColsNeeded)
+    {
+        c.Resize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+        GPUMatrix<ElemType> steps = c.ColumnSlice(2 * GetNumCols(), GetNumCols());
+        steps.SetValue(ElemType(0.02));
+    }
+
+    ElemType* avars = c.BufferPointer(); // accumulated variances for RMS scaling
+    ElemType* signs = avars + n;         // sign of previous gradient
+    ElemType* steps = avars + 2 * n;     // current step size
+    ElemType* lastSteps = avars + 3 * n;
+    ElemType* multipliers = needAveMultiplier ? lastSteps + numStepCols * GetNumRows() : nullptr; // temp memory used to store multipliers
+
+    if (m_nz > 0)
+    {
+        int blocksPerGrid = (m_nz + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+        _rmsprop4BlockSparse<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(m_nz, GetNumRows(), BufferPointer(), BlockId2ColOrRow(),
+                                                                                       avars, signs, steps, lastSteps, GetNumCols(),
+                                                                                       RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN,
+                                                                                       floor, multipliers);
+        blocksPerGrid = (int) ((m_blockSize + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock);
+        _updateLastSteps4BlockSparse<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(m_blockSize, BlockId2ColOrRow(), lastSteps, GetNumCols());
+    }
+    _advanceStep4BlockSparse<ElemType><<<1, 1>>>(lastSteps, GetNumCols());
+
+    if (!needAveMultiplier || m_nz == 0)
+        return 1;
+
+    cublasHandle_t cuHandle = GPUMatrix<ElemType>::GetCublasHandle(GetComputeDeviceId());
+    if (sizeof(ElemType) == sizeof(float))
+    {
+        float aveMultiplier = 0;
+        CUBLAS_CALL(cublasSasum(cuHandle, (LONG64) m_nz, reinterpret_cast<float*>(multipliers), 1, &aveMultiplier));
+        return (ElemType) aveMultiplier / m_nz;
+    }
+    else
+    {
+        double aveMultiplier = 0;
+        CUBLAS_CALL(cublasDasum(cuHandle, (LONG64) m_nz, reinterpret_cast<double*>(multipliers), 1, &aveMultiplier));
+        return (ElemType) aveMultiplier / m_nz;
+    }
+}
+
 //-------------------------------------------------------------------------
 // End of new GPU Sparse Matrix code
 //-------------------------------------------------------------------------
@@ -1551,6 +1944,12 @@ template <class ElemType>
 void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& a, const bool transposeA,
                                                        const GPUMatrix<ElemType>& b, const bool transposeD, ElemType beta, GPUMatrix<ElemType>& c)
 {
+    if (a.m_format == matrixFormatSparseBSR && !transposeA && !transposeD)
+    {
+        BSRMultiplyAndWeightedAdd(alpha, a, b, beta, c);
+        return;
+    }
+
     if (a.m_format != matrixFormatSparseCSR)
         NOT_IMPLEMENTED;
 
@@ -1598,6 +1997,55 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
     CUSPARSE_CALL(cusparseDestroy(cusparseHandle));
 }
 
+// c = alpha * a * b + beta * c for a BSR matrix a
+// One thread block per block row and tile of columns of b; see _bsrTimesDense().
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::BSRMultiplyAndWeightedAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c)
+{
+    if (a.GetComputeDeviceId() != b.GetComputeDeviceId())
+        RuntimeError("MultiplyAndWeightedAdd: All matrices must be on the same GPU");
+    if (a.GetNumCols() != b.GetNumRows())
+        InvalidArgument("MultiplyAndWeightedAdd: The inner dimensions of a and b must match.");
+
+    const size_t m = a.GetNumRows();
+    const size_t n = b.GetNumCols();
+    if (beta == 0)
+        c.Resize(m, n);
+    else if (c.GetNumRows() != m || c.GetNumCols() != n)
+        InvalidArgument("MultiplyAndWeightedAdd: c has the wrong dimensions.");
+    if (m == 0 || n == 0)
+        return;
+
+    a.PrepareDevice();
+    const int dim = (int) a.m_bsrBlockDim;
+    const size_t numBlockRows = (m + dim - 1) / dim;
+    const dim3 threads(dim, GridDim::maxThreadsPerBlock / 2 / dim); // (row within the block, column)
+    const dim3 blocks((unsigned int) numBlockRows, (unsigned int) ((n + threads.y - 1) / threads.y));
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+#define LAUNCH_BSR_TIMES_DENSE(BlockDim) \
+    _bsrTimesDense<ElemType, BlockDim><<<blocks, threads, 0, t_stream>>>((CUDA_LONG) m, (CUDA_LONG) a.GetNumCols(), (CUDA_LONG) n, dim, alpha, a.NzValues(), \
+                                                                        a.SecondaryIndexLocation(), a.MajorIndexLocation(), b.BufferPointer(), beta, c.BufferPointer())
+    if (dim == 4)
+        LAUNCH_BSR_TIMES_DENSE(4);
+    else if (dim == 8)
+        LAUNCH_BSR_TIMES_DENSE(8);
+    else if (dim == 16)
+        LAUNCH_BSR_TIMES_DENSE(16);
+    else if (dim == 32)
+        LAUNCH_BSR_TIMES_DENSE(32);
+    else
+        LAUNCH_BSR_TIMES_DENSE(0);
+#undef LAUNCH_BSR_TIMES_DENSE
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::Multiply(const GPUSparseMatrix<ElemType>& S, const GPUMatrix<ElemType>& D, GPUMatrix<ElemType>& C)
 {
@@ -1625,7 +2073,7 @@ size_t GPUSparseMatrix<ElemType>::ElemCountFromBufferSize(const size_t numRows,
     {
         elemSizeAllocated = (totalBufferSize - sizeof(GPUSPARSE_INDEX_TYPE) * (numCols + 1)) / (sizeof(GPUSPARSE_INDEX_TYPE) + sizeof(ElemType));
     }
-    else if (format == matrixFormatSparseCSR)
+    else if (format == matrixFormatSparseCSR || format == matrixFormatSparseBSR)
     {
         elemSizeAllocated = (totalBufferSize - sizeof(GPUSPARSE_INDEX_TYPE) * (numRows + 1)) / (sizeof(GPUSPARSE_INDEX_TYPE) + sizeof(ElemType));
     }
@@ -1893,6 +2341,7 @@ void GPUSparseMatrix<ElemType>::Scale(ElemType alpha, GPUSparseMatrix<ElemType>&
 {
     if (!a.OwnBuffer())
         LogicError("Cannot modify since the buffer is managed externally.");
+    a.InvalidateDerivedCache();
 
     if (a.IsEmpty())
         return;
@@ -1916,6 +2365,7 @@ void GPUSparseMatrix<ElemType>::ElementWisePower(ElemType alpha, const GPUSparse
 {
     if (!c.OwnBuffer())
         LogicError("Cannot modify since the buffer is managed externally.");
+    c.InvalidateDerivedCache();
 
     if (a.GetComputeDeviceId() != c.GetComputeDeviceId())
     {
@@ -2382,6 +2832,8 @@ GPUSparseMatrix<ElemType> GPUSparseMatrix<ElemType>::ColumnSlice(size_t startCol
     slice.m_matrixName = m_matrixName;
     slice.m_blockSize = m_blockSize;
     slice.m_rowToId = m_rowToId;
+    GetDerivedCache();
+    slice.m_derivedCache = m_derivedCache;
     slice.m_tempHostBuffer = m_tempHostBuffer;
     slice.m_tempHostBufferSize = m_tempHostBufferSize;
     slice.m_sliceViewOffset = startColumn; // Just shift the compressed index location to the new startColumn - that's it!
@@ -2552,6 +3004,7 @@ GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::ElementInverse()
 {
     if (!OwnBuffer())
         LogicError("Cannot modify since the buffer is managed externally.");
+    InvalidateDerivedCache();
 
     if (IsEmpty())
         LogicError("ElementInverse: Matrix is empty.");
@@ -2695,6 +3148,7 @@ GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::InplaceTruncateBottom(cons
 {
     if (!OwnBuffer())
         LogicError("Cannot modify since the buffer is managed externally.");
+    InvalidateDerivedCache();
 
     if (IsEmpty())
         LogicError("InplaceTruncateBottom: Matrix is empty.");
@@ -2747,6 +3201,7 @@ GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::InplaceTruncateTop(const E
 {
     if (!OwnBuffer())
         LogicError("Cannot modify since the buffer is managed externally.");
+    InvalidateDerivedCache();
 
     if (IsEmpty())
         LogicError("InplaceTruncateTop: Matrix is empty.");
@@ -2799,6 +3254,7 @@ GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::SetToZeroIfAbsLessThan(con
 {
     if (!OwnBuffer())
         LogicError("Cannot modify since the buffer is managed externally.");
+    InvalidateDerivedCache();
 
     if (IsEmpty())
         LogicError("SetToZeroIfAbsLessThan: Matrix is empty.");
@@ -2858,6 +3314,7 @@ void GPUSparseMatrix<ElemType>::performElementWiseFunction(ElementWiseOperator k
 {
     if (!OwnBuffer())
         LogicError("Cannot modify since the buffer is managed externally.");
+    InvalidateDerivedCache();
 
     CUDA_LONG N = (CUDA_LONG) GetNumNZElements();
     int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
@@ -2953,23 +3410,15 @@ MATH_API File& operator>>(File& stream, GPUSparseMatrix<ElemType>& us)
         CPUSPARSE_INDEX_TYPE* unCompressedIndex = new CPUSPARSE_INDEX_TYPE[nz];
         CPUSPARSE_INDEX_TYPE* compressedIndex = new CPUSPARSE_INDEX_TYPE[compressedSize];
 
-        // read in the sparse matrix info
-        for (size_t i = 0; i < nz; ++i)
-        {
-            stream >> dataBuffer[i];
-        }
+        // read in the sparse matrix info (the indices are stored as size_t)
+        stream.GetArray(dataBuffer, nz);
+        std::vector<size_t> indices(std::max(nz, compressedSize));
+        stream.GetArray(indices.data(), nz);
         for (size_t i = 0; i < nz; ++i)
-        {
-            size_t val;
-            stream >> val;
-            unCompressedIndex[i] = val;
-        }
+            unCompressedIndex[i] = (CPUSPARSE_INDEX_TYPE) indices[i];
+        stream.GetArray(indices.data(), compressedSize);
         for (size_t i = 0; i < compressedSize; ++i)
-        {
-            size_t val;
-            stream >> val;
-            compressedIndex[i] = val;
-        }
+            compressedIndex[i] = (CPUSPARSE_INDEX_TYPE) indices[i];
 
         if (us.m_format == matrixFormatSparseCSC)
             us.SetMatrixFromCSCFormat(compressedIndex, unCompressedIndex, dataBuffer, nz, rownum, colnum);
@@ -3027,20 +3476,11 @@ MATH_API File& operator<<(File& stream, const GPUSparseMatrix<ElemType>& us)
         else
             NOT_IMPLEMENTED;
 
-        for (size_t i = 0; i < nz; ++i)
-        {
-            stream << dataBuffer[i];
-        }
-        for (size_t i = 0; i < nz; ++i)
-        {
-            size_t val = unCompressedIndex[i];
-            stream << val;
-        }
-        for (size_t i = 0; i < compressedSize; ++i)
-        {
-            size_t val = compressedIndex[i];
-            stream << val;
-        }
+        stream.PutArray(dataBuffer, nz);
+        std::vector<size_t> indices(unCompressedIndex, unCompressedIndex + nz); // (stored as size_t)
+        stream.PutArray(indices.data(), nz);
+        indices.assign(compressedIndex, compressedIndex + compressedSize);
+        stream.PutArray(indices.data(), compressedSize);
 
         delete[] dataBuffer;
         delete[] unCompressedIndex;
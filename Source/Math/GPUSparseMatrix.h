@@ -8,6 +8,7 @@
 #include "GPUMatrix.h"
 #include "CPUSparseMatrix.h"
 #include <functional>
+#include <memory>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -89,6 +90,14 @@ public:
         return m_nz;
     }
 
+    // dense x CSC products gather (or, transposed, scatter-add) whole columns of the dense matrix if the CSC matrix
+    // has at most this many non-zeros per column on average, e.g. one-hot word ids or letter-n-gram inputs
+    static const size_t maxAvgNzPerColumnForGather = 32;
+    bool HasFewNonZerosPerColumn() const
+    {
+        return m_format == matrixFormatSparseCSC && m_nz <= maxAvgNzPerColumnForGather * m_numCols;
+    }
+
     GPUSPARSE_INDEX_TYPE* MajorIndexLocation() const // row/col ids in CSC/CSR format, blockId2col/blockId2row in BlockCol/BlockRow format
     {
         return (GPUSPARSE_INDEX_TYPE*) (m_pArray + m_elemSizeAllocated);
@@ -136,8 +145,8 @@ public:
             return numRows;
         else if (format == matrixFormatSparseCSC)
             return numCols + 1;
-        else if (format == matrixFormatSparseCSR)
-            return numRows + 1;
+        else if (format == matrixFormatSparseCSR || format == matrixFormatSparseBSR)
+            return numRows + 1; // for BSR, enough for the first blocks of the block rows for any block dimension
         else
             return numNZReserved; // COO format
     }
@@ -238,6 +247,8 @@ public:
 
     GPUMatrix<ElemType> CopyToDenseMatrix() const;
     void CopyToDenseMatrix(GPUMatrix<ElemType>& denseMatrix) const;
+    // see Matrix::AssignOneHotIndicesOf()
+    void CopyOneHotIndicesTo(GPUMatrix<ElemType>& indices) const;
     void CopyToCPUSparseMatrix(CPUSparseMatrix<ElemType>& cpuSparseMatrix) const;
     void ChangeDeviceTo(DEVICEID_TYPE toId);
 
@@ -264,12 +275,27 @@ public:
                                 const size_t nz, const size_t numRows, const size_t numCols, const bool IsOnDevice = false, const DEVICEID_TYPE devId = -1);
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
                                 const size_t nz, const size_t numRows, const size_t numCols, const bool IsOnDevice = false, const DEVICEID_TYPE devId = -1);
+    // CSC from host triplets ordered by column, uploaded in one copy; the column starts are computed on the device
+    void SetMatrixFromCOOFormat(const CPUSPARSE_INDEX_TYPE* h_Col, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                const size_t nz, const size_t numRows, const size_t numCols);
 
     // Gets sparse matrix in CSR format. this acts as deep copy. All passed pointers must be NULL. the function will allocate memory itself.
     void GetMatrixFromCSRFormat(CPUSPARSE_INDEX_TYPE*& h_CSRRow, CPUSPARSE_INDEX_TYPE*& h_Col, ElemType*& h_Val, size_t& numElemAllocated, size_t& nz, size_t& numRows, size_t& numCols) const;
 
     void GetMatrixFromCSCFormat(CPUSPARSE_INDEX_TYPE*& h_CSCCol, CPUSPARSE_INDEX_TYPE*& h_Row, ElemType*& h_Val, size_t& numElemAllocated, size_t& nz, size_t& numRows, size_t& numCols) const;
 
+    // host copies of a matrixFormatSparseBlockCol matrix: the ids of its non-zero columns, and their values
+    void GetSparseBlockColData(std::vector<size_t>& columnIds, std::vector<ElemType>& values) const;
+    void SetSparseBlockColData(const size_t numRows, const size_t numCols, const std::vector<size_t>& columnIds, const std::vector<ElemType>& values);
+
+    // block-sparse row format, laid out as in CPUSparseMatrix; the major index holds the block columns, the secondary index the first block of each block row
+    void SetMatrixFromBSRFormat(const CPUSPARSE_INDEX_TYPE* h_blockRowStarts, const CPUSPARSE_INDEX_TYPE* h_blockCols, const ElemType* h_blockValues,
+                                const size_t numBlocks, const size_t blockDim, const size_t numRows, const size_t numCols);
+    size_t GetBSRBlockDim() const
+    {
+        return m_bsrBlockDim;
+    }
+
     void ConvertToSparseFormat(MatrixFormat newFormat);
     void ConvertToSparseFormat(MatrixFormat newFormat, GPUSparseMatrix<ElemType>& outMatrix) const;
 
@@ -335,6 +361,8 @@ public:
 
     void NormalGrad(GPUMatrix<ElemType>& c, const ElemType momentum);
     ElemType Adagrad(GPUMatrix<ElemType>& c, const bool needAveMultiplier);
+    void FSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
+    ElemType RmsProp(GPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
 
     static void Multiply(const GPUSparseMatrix<ElemType>& S, const GPUMatrix<ElemType>& D, GPUMatrix<ElemType>& C);
     static void Multiply(const GPUMatrix<ElemType>& D, const GPUSparseMatrix<ElemType>& S, GPUMatrix<ElemType>& C);
@@ -376,18 +404,55 @@ private:
     void DeepCopy(const GPUSparseMatrix<ElemType>& deepCopyFrom);
     void ReleaseMemory();
     void PrepareBuffer(const size_t numRows, const size_t numCols, const bool canReuseBuffer, std::function<size_t(GPUSPARSE_INDEX_TYPE* csrRowPtrC)> func);
+    static void BSRMultiplyAndWeightedAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c);
+    static void GatherMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const GPUSparseMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c);
 
     size_t ElemCountFromBufferSize(const size_t numRows, const size_t numCols, const MatrixFormat format, const size_t totalBufferSize) const;
     size_t ElemCountFromBufferSize() const;
     DEVICEID_TYPE PrepareDevice(const DEVICEID_TYPE deviceId = -1) const;
     size_t IdentifyRowsWithValues() const;
 
+    // What the gradient products derive from a sparse input, kept while its values are those set by the reader, so
+    // that the consumers of an input share the work: the row numbering of IdentifyRowsWithValues() (in m_rowToId) for
+    // the column slice it was made for, and the CSC copy of a CSR input. The setters SetMatrixFrom*Format() arm it;
+    // any other change of the structure or the values disarms it. Column-slice views share it with their matrix.
+    struct DerivedCache
+    {
+        bool valid = false;
+        size_t rowsFirstColumn = 0;
+        size_t rowsNumColumns = 0;
+        size_t numRowsWithValues = SIZE_MAX; // SIZE_MAX: not computed
+        bool hasCSC = false;
+        std::unique_ptr<GPUSparseMatrix<ElemType>> csc; // (kept when disarmed, to reuse its buffer)
+    };
+    DerivedCache& GetDerivedCache() const
+    {
+        if (!m_derivedCache)
+            m_derivedCache = std::make_shared<DerivedCache>();
+        return *m_derivedCache;
+    }
+    void ArmDerivedCache()
+    {
+        DerivedCache& cache = GetDerivedCache();
+        cache.numRowsWithValues = SIZE_MAX;
+        cache.hasCSC = false;
+        cache.valid = true;
+    }
+    void InvalidateDerivedCache()
+    {
+        if (m_derivedCache)
+            m_derivedCache->valid = false;
+    }
+
 private:
     size_t m_totalBufferSizeAllocated;
 
     // used by the blockCol and blockRow format
     size_t m_blockSize;                      // block size
     mutable GPUSPARSE_INDEX_TYPE* m_rowToId; // the id showing the order row number is observed in the nnz values.
+    mutable std::shared_ptr<DerivedCache> m_derivedCache;
+
+    size_t m_bsrBlockDim; // block dimension in BSR format
 
     mutable void* m_tempHostBuffer; // used to copy values.
     mutable size_t m_tempHostBufferSize;
@@ -35,9 +35,10 @@ extern bool do_sync;
 
 #ifdef _WIN32
 // thread local storage to access the current stream, initalize to default stream
-__declspec(thread)
+__declspec(thread) extern cudaStream_t t_stream;
+#else
+extern __thread cudaStream_t t_stream;
 #endif
-    extern cudaStream_t t_stream;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -233,12 +234,12 @@ template <class ElemType, C_size_t N, C_int M, C_int m>
 struct TensorOpReduce
 {
     // this version for m >= 0
-    static __device__ ElemType Compute(FixedArray<ElemType*, N> pointers, ElementWiseOperator op,
+    static __device__ ElemType Compute(FixedArray<ElemType*, N> pointers, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                        const FixedArray<C_unsigned_int, M>& reducingOpDims, const FixedMatrix<C_int, N, M>& reducingStrides)
     {
         // start with index 0
         // We may use 'double' since we are memory-bound anyway.
-        ReduceElemType aggregate = TensorOpReduce<ElemType, N, M, m - 1>::Compute(pointers, op, reducingOpDims, reducingStrides);
+        ReduceElemType aggregate = TensorOpReduce<ElemType, N, M, m - 1>::Compute(pointers, op, reductionOp, reducingOpDims, reducingStrides);
         // apply this index to the pointers
         C_size_t dim = reducingOpDims[m];
         for (C_size_t k = 1 /*done with k=0 already*/; k < dim; k++)
@@ -246,8 +247,8 @@ struct TensorOpReduce
             // bump the pointers
             for (C_size_t i = 0; i < N - 1; i++) // N-1 because output is not used here
                 pointers[i] += reducingStrides(i, (C_size_t) m);
-            ElemType val = TensorOpReduce<ElemType, N, M, m - 1>::Compute(pointers, op, reducingOpDims, reducingStrides);
-            aggregate += val;
+            ElemType val = TensorOpReduce<ElemType, N, M, m - 1>::Compute(pointers, op, reductionOp, reducingOpDims, reducingStrides);
+            aggregate = Aggregate(aggregate, (ReduceElemType) val, reductionOp);
         }
         return (ElemType) aggregate;
     }
@@ -260,7 +261,7 @@ struct TensorOpReduce<ElemType, N, M, /*m=*/-1>
 {
     // this version for m = -1
     // the pointers are pointing to the right location(s) to take the operation over
-    static __device__ ElemType Compute(FixedArray<ElemType*, N> pointers, ElementWiseOperator op,
+    static __device__ ElemType Compute(FixedArray<ElemType*, N> pointers, ElementWiseOperator op, ElementWiseOperator /*reductionOp*/,
                                        const FixedArray<C_unsigned_int, M>& /*reducingOpDims*/, const FixedMatrix<C_int, N, M>& /*reducingStrides*/)
     {
         return TensorOps<ElemType>::Compute(pointers, op); // finally computing something!
@@ -320,7 +321,7 @@ template <class ElemType, C_size_t N, C_int M, C_int K, bool parallelReduce, C_i
 struct TensorOpElement
 {
     // template-recursive version loops over indices
-    static __device__ void Compute(CUDA_LONG id, ElemType beta, FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op,
+    static __device__ void Compute(CUDA_LONG id, ElemType beta, FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const FixedArray<C_unsigned_int, K>& regularOpStrides, const FixedMatrix<C_int, N, K>& regularStrides,
                                    const FixedArray<C_unsigned_int, M>& reducingOpDims, const FixedMatrix<C_int, N, M>& reducingStrides,
                                    CUDA_LONG reductionBegin, CUDA_LONG reductionChunkSize)
@@ -333,7 +334,7 @@ struct TensorOpElement
         for (C_size_t i = 0; i < N; i++)
             pointers[i] += index * regularStrides(i, (C_size_t) k); // now this dimension is taken care of
         // process the previous index
-        TensorOpElement<ElemType, N, M, K, parallelReduce, k - 1>::Compute(id, beta, pointers, alpha, op, regularOpStrides, regularStrides, reducingOpDims, reducingStrides, reductionBegin, reductionChunkSize);
+        TensorOpElement<ElemType, N, M, K, parallelReduce, k - 1>::Compute(id, beta, pointers, alpha, op, reductionOp, regularOpStrides, regularStrides, reducingOpDims, reducingStrides, reductionBegin, reductionChunkSize);
     }
 };
 
@@ -342,7 +343,7 @@ template <class ElemType, C_size_t N, C_int M, C_int K, bool parallelReduce>
 struct TensorOpElement<ElemType, N, M, K, parallelReduce, /*k=*/0>
 {
     // template-recursive version loops over indices
-    static __device__ void Compute(CUDA_LONG id, ElemType beta, FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op,
+    static __device__ void Compute(CUDA_LONG id, ElemType beta, FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const FixedArray<C_unsigned_int, K>& regularOpStrides, const FixedMatrix<C_int, N, K>& regularStrides,
                                    const FixedArray<C_unsigned_int, M>& reducingOpDims, const FixedMatrix<C_int, N, M>& reducingStrides,
                                    CUDA_LONG reductionBegin, CUDA_LONG reductionChunkSize)
@@ -353,7 +354,7 @@ struct TensorOpElement<ElemType, N, M, K, parallelReduce, /*k=*/0>
         for (C_size_t i = 0; i < N; i++)
             pointers[i] += index * regularStrides(i, 0); // now this dimension is taken care of
         // process the previous index
-        TensorOpElement<ElemType, N, M, K, parallelReduce, -1>::Compute(/*id*/ 0, beta, pointers, alpha, op, regularOpStrides, regularStrides, reducingOpDims, reducingStrides, reductionBegin, reductionChunkSize);
+        TensorOpElement<ElemType, N, M, K, parallelReduce, -1>::Compute(/*id*/ 0, beta, pointers, alpha, op, reductionOp, regularOpStrides, regularStrides, reducingOpDims, reducingStrides, reductionBegin, reductionChunkSize);
     }
 };
 
@@ -377,13 +378,13 @@ struct TensorOpElement<ElemType, N, M, K, /*parallelReduce=*/false, /*k=*/-1>
 {
     // template-recursion-teminating version computes the actual value for this output location
     // now the output pointers point to the right element (input pointers may still iterate for reduction)
-    static __device__ void Compute(CUDA_LONG /*id*/, ElemType beta, FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op,
+    static __device__ void Compute(CUDA_LONG /*id*/, ElemType beta, FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const FixedArray<C_unsigned_int, K>& /*regularOpStrides*/, const FixedMatrix<C_int, N, K>& /*regularStrides*/,
                                    const FixedArray<C_unsigned_int, M>& reducingOpDims, const FixedMatrix<C_int, N, M>& reducingStrides, CUDA_LONG /*reductionBegin*/, CUDA_LONG /*reductionChunkSize*/)
     {
         // compute the operation for this output coordinate
         // This may still involve a reduction over inverse-broadcasting dimensions.
-        ElemType val = TensorOpReduce<ElemType, N, M, M - 1>::Compute(pointers, op, reducingOpDims, reducingStrides);
+        ElemType val = TensorOpReduce<ElemType, N, M, M - 1>::Compute(pointers, op, reductionOp, reducingOpDims, reducingStrides);
         // scale
         val *= alpha;
         // combine with previous value in target matrix, then write it out
@@ -395,13 +396,45 @@ struct TensorOpElement<ElemType, N, M, K, /*parallelReduce=*/false, /*k=*/-1>
     }
 };
 
+// reduce the values of the 32 threads of a warp; the result is valid in its first thread
+// Shuffles move 32 bits, so a 'double' gets moved in two halves.
+static __device__ float ShuffleDown(float val, int delta)
+{
+#if __CUDACC_VER_MAJOR__ >= 9
+    return __shfl_down_sync(0xffffffff, val, delta);
+#else
+    return __shfl_down(val, delta);
+#endif
+}
+static __device__ double ShuffleDown(double val, int delta)
+{
+    int lo = __double2loint(val);
+    int hi = __double2hiint(val);
+#if __CUDACC_VER_MAJOR__ >= 9
+    lo = __shfl_down_sync(0xffffffff, lo, delta);
+    hi = __shfl_down_sync(0xffffffff, hi, delta);
+#else
+    lo = __shfl_down(lo, delta);
+    hi = __shfl_down(hi, delta);
+#endif
+    return __hiloint2double(hi, lo);
+}
+
+template <class ElemType>
+static __device__ ElemType WarpReduce(ElemType aggregate, ElementWiseOperator reductionOp)
+{
+    for (int delta = 16; delta > 0; delta >>= 1)
+        aggregate = Aggregate(aggregate, ShuffleDown(aggregate, delta), reductionOp);
+    return aggregate;
+}
+
 // specialization for k = -1 terminates the template recursion, and computes reductions in parallel
 template <class ElemType, C_size_t N, C_int M, C_int K>
 struct TensorOpElement<ElemType, N, M, K, /*parallelReduce=*/true, /*k=*/-1>
 {
     // template-recursion-teminating version computes the actual value for this output location
     // now the output pointers point to the right element (input pointers may still iterate for reduction)
-    static __device__ void Compute(CUDA_LONG /*id*/, ElemType beta, FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op,
+    static __device__ void Compute(CUDA_LONG /*id*/, ElemType beta, FixedArray<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const FixedArray<C_unsigned_int, K>& /*regularOpStrides*/, const FixedMatrix<C_int, N, K>& /*regularStrides*/,
                                    const FixedArray<C_unsigned_int, M>& reducingOpDims, const FixedMatrix<C_int, N, M>& reducingStrides, CUDA_LONG reductionBegin, CUDA_LONG reductionChunkSize)
     {
@@ -421,38 +454,39 @@ struct TensorOpElement<ElemType, N, M, K, /*parallelReduce=*/true, /*k=*/-1>
         CUDA_LONG reductionEnd = min(reductionBegin + reductionChunkSize, reductionDim);
 
         // compute the operation for this input coordinate
-        ReduceElemType sum = 0;
+        // Threads beyond the end contribute the neutral value, so that all warps are complete (tids is a multiple of 32).
+        ReduceElemType aggregate = NeutralValue<ReduceElemType>(reductionOp);
         for (CUDA_LONG redId = reductionBegin + tid; redId < reductionEnd; redId += tids)
         {
             auto val = TensorOpParallelReduce<ElemType, N, M, M - 1>::Compute(redId, pointers, op, reducingOpDims, reducingStrides);
-            sum += val;
+            aggregate = Aggregate(aggregate, (ReduceElemType) val, reductionOp);
         }
 
-        // reduce    --cf https://docs.nvidia.com/cuda/samples/6_Advanced/reduction/doc/reduction.pdf
-        __shared__ ReduceElemType accumulators[GridDim::maxThreadsPerBlock /*tids*/];
-        accumulators[tid] = sum;
+        // reduce    --cf https://devblogs.nvidia.com/parallelforall/faster-parallel-reductions-kepler/
+        // First within each warp through register shuffles, then the warps' results through shared memory.
+        static_assert(GridDim::maxThreadsPerBlock <= 32 * 32, "GridDim::maxThreadsPerBlock too large for a two-level warp reduction");
+        __shared__ ReduceElemType warpAggregates[GridDim::maxThreadsPerBlock / 32];
+        aggregate = WarpReduce(aggregate, reductionOp);
+        if (tid % 32 == 0)
+            warpAggregates[tid / 32] = aggregate;
         __syncthreads();
-        static_assert(GridDim::maxThreadsPerBlock <= 512, "GridDim::maxThreadsPerBlock too large, need to add manually unrolled steps");
-        for (CUDA_LONG i = 256; i; i >>= 1)
+        if (tid < 32)
         {
-            if (tid < i && tid + i < tids)
-                accumulators[tid] += accumulators[tid + i];
-            if (0 + i < tids)
-                __syncthreads(); // sync if condition true for at least one thread
-            // TODO: use volatile* and then we can skip the __syncthreads() for the last 32 values. See Amit's allreduce() function implementation in MatrixQuantizer_kernel.cu.
+            aggregate = tid < tids / 32 ? warpAggregates[tid] : NeutralValue<ReduceElemType>(reductionOp);
+            aggregate = WarpReduce(aggregate, reductionOp);
         }
 
         // now set final value to output coordinate
         if (tid == 0)
         {
-            ElemType val = (ElemType) accumulators[0];
+            ElemType val = (ElemType) aggregate;
             // scale
             val *= alpha;
             // combine with previous value in target matrix, then write it out
             auto* pout = pointers[pointers.size() - 1];
             if (reductionBlocks > 1) // multiple blocks: need to use atomicAdd()
             {
-                // in this case, outer calling code must pass beta = 1
+                // in this case, outer calling code must pass beta = 1, and reductionOp must be opSum
                 val = atomicAdd(pout, val);
             }
             else
@@ -472,17 +506,17 @@ struct TensorOpElement<ElemType, N, M, K, /*parallelReduce=*/true, /*k=*/-1>
 
 // launch tensor op with CUDA
 template <class ElemType, C_size_t N, C_int M, C_int K>
-__global__ void _launchTensorOp(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op,
+__global__ void _launchTensorOp(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                 FixedArray<C_unsigned_int, K> regularOpStrides, FixedMatrix<C_int, N, K> regularStrides, CUDA_LONG numElements,
                                 FixedArray<C_unsigned_int, M> reducingOpDims, FixedMatrix<C_int, N, M> reducingStrides)
 {
     CUDA_LONG id = GridDim::GetLinearThreadId();
     if (id < numElements) // note: there are no __syncthread() calls inside
-        TensorOpElement<ElemType, N, M, K, false, K - 1>::Compute(id, beta, pointers, alpha, op, regularOpStrides, regularStrides, reducingOpDims, reducingStrides, 0, 0);
+        TensorOpElement<ElemType, N, M, K, false, K - 1>::Compute(id, beta, pointers, alpha, op, reductionOp, regularOpStrides, regularStrides, reducingOpDims, reducingStrides, 0, 0);
 }
 
 template <class ElemType, C_size_t N, C_int K>
-static void LaunchTensorOp(ElemType beta, array<ElemType*, N> pointerVector, ElemType alpha, ElementWiseOperator op,
+static void LaunchTensorOp(ElemType beta, array<ElemType*, N> pointerVector, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrideVectors)
 {
     // copy all parameters to CUDA-compatible data structures
@@ -505,7 +539,104 @@ static void LaunchTensorOp(ElemType beta, array<ElemType*, N> pointerVector, Ele
     if (do_sync)
         CUDA_CALL(cudaEventCreate(&done));
     GridDim grid(NN);
-    _launchTensorOp<ElemType, N, /*M=*/0, K><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointers, alpha, op, regularOpStrides, regularStrides, grid.m_N, reducingOpDims, reducingStrides);
+    _launchTensorOp<ElemType, N, /*M=*/0, K><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointers, alpha, op, reductionOp, regularOpStrides, regularStrides, grid.m_N, reducingOpDims, reducingStrides);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
+// -----------------------------------------------------------------------
+// kernel and launch  --dense
+// -----------------------------------------------------------------------
+
+// Operands that are contiguous and of the same shape (after TensorView has merged the dimensions, a single regular
+// dimension with stride 1 for all of them) need no index arithmetic. Their elements are processed in a grid-stride
+// loop, 16 bytes per operand and load at a time if all pointers are aligned for that.
+
+// a 16-byte vector of ElemType
+template <class ElemType>
+struct TensorOpVector;
+template <>
+struct TensorOpVector<float>
+{
+    typedef float4 type;
+};
+template <>
+struct TensorOpVector<double>
+{
+    typedef double2 type;
+};
+
+// VectorType is TensorOpVector<ElemType>::type, or ElemType itself for operands that are not aligned for it
+template <class ElemType, class VectorType, C_size_t N>
+__global__ void _launchDenseTensorOp(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op, CUDA_LONG numElements)
+{
+    const CUDA_LONG vectorSize = sizeof(VectorType) / sizeof(ElemType);
+    const CUDA_LONG numVectors = numElements / vectorSize;
+    const CUDA_LONG gridStride = blockDim.x * gridDim.x;
+    const CUDA_LONG firstId = GridDim::GetLinearThreadId();
+    for (CUDA_LONG v = firstId; v < numVectors; v += gridStride)
+    {
+        ElemType values[N][vectorSize]; // [operand][element]
+#pragma unroll
+        for (C_size_t i = 0; i < N - 1; i++)
+            *(VectorType*) values[i] = ((const VectorType*) pointers[i])[v];
+        if (beta != 0)
+            *(VectorType*) values[N - 1] = ((const VectorType*) pointers[N - 1])[v];
+        FixedArray<ElemType*, N> elementPointers = pointers;
+#pragma unroll
+        for (CUDA_LONG e = 0; e < vectorSize; e++)
+        {
+#pragma unroll
+            for (C_size_t i = 0; i < N - 1; i++)
+                elementPointers[i] = &values[i][e];
+            ElemType val = TensorOps<ElemType>::Compute(elementPointers, op) * alpha;
+            if (beta != 0)
+                val += beta * values[N - 1][e];
+            values[N - 1][e] = val;
+        }
+        ((VectorType*) pointers[N - 1])[v] = *(const VectorType*) values[N - 1];
+    }
+    // the elements after the last full vector
+    for (CUDA_LONG id = numVectors * vectorSize + firstId; id < numElements; id += gridStride)
+    {
+        FixedArray<ElemType*, N> elementPointers = pointers;
+        for (C_size_t i = 0; i < N; i++)
+            elementPointers[i] += id;
+        ElemType val = TensorOps<ElemType>::Compute(elementPointers, op) * alpha;
+        auto* pout = elementPointers[N - 1];
+        if (beta != 0)
+            val += beta * *pout;
+        *pout = val;
+    }
+}
+
+template <class ElemType, C_size_t N>
+static void LaunchDenseTensorOp(ElemType beta, const array<ElemType*, N>& pointerVector, ElemType alpha, ElementWiseOperator op, size_t numElements)
+{
+    typedef typename TensorOpVector<ElemType>::type VectorType;
+    bool aligned = true;
+    for (C_size_t i = 0; i < N; i++)
+        aligned &= ((size_t) pointerVector[i] % sizeof(VectorType)) == 0;
+    FixedArray<ElemType*, N> pointers(pointerVector);
+
+    CUDA_LONG NN = (CUDA_LONG) numElements;
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    if (aligned)
+    {
+        GridDim grid(CeilDiv(NN, (CUDA_LONG)(sizeof(VectorType) / sizeof(ElemType)))); // (one thread per vector)
+        _launchDenseTensorOp<ElemType, VectorType, N><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointers, alpha, op, NN);
+    }
+    else
+    {
+        GridDim grid(NN);
+        _launchDenseTensorOp<ElemType, ElemType, N><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointers, alpha, op, NN);
+    }
     if (do_sync)
         CUDA_CALL(cudaEventRecord(done));
     if (do_sync)
@@ -519,18 +650,18 @@ static void LaunchTensorOp(ElemType beta, array<ElemType*, N> pointerVector, Ele
 // -----------------------------------------------------------------------
 
 template <class ElemType, C_size_t N, C_int M, C_int K>
-__global__ void _launchTensorOpWithReduction(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op,
+__global__ void _launchTensorOpWithReduction(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                              FixedArray<C_unsigned_int, K> regularOpStrides, FixedMatrix<C_int, N, K> regularStrides, CUDA_LONG numElements,
                                              FixedArray<C_unsigned_int, M> reducingOpDims, FixedMatrix<C_int, N, M> reducingStrides, CUDA_LONG reductionBegin, CUDA_LONG reductionChunkSize)
 {
     CUDA_LONG id = gridDim.x * blockIdx.y + blockIdx.x; // input dimensions are Y dimension of blocks in this case, so we can use thread dim for shared-memory/parallelization
     if (id < numElements)                               // note: we have __syncthread() calls but only entire blocks in sync, so this is OK
-        TensorOpElement<ElemType, N, M, K, true, K - 1>::Compute(id, beta, pointers, alpha, op, regularOpStrides, regularStrides, reducingOpDims, reducingStrides, reductionBegin, reductionChunkSize);
+        TensorOpElement<ElemType, N, M, K, true, K - 1>::Compute(id, beta, pointers, alpha, op, reductionOp, regularOpStrides, regularStrides, reducingOpDims, reducingStrides, reductionBegin, reductionChunkSize);
 }
 
 // All dimensions (N-ariness, number of input dimensions K and number of reduction dimensions M) are bound to template parameters now.
 template <class ElemType, C_size_t N, C_int M, C_int K>
-static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> pointerVector, ElemType alpha, ElementWiseOperator op,
+static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> pointerVector, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                         const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrideVectors,
                                         const SmallVector<size_t>& reducingOpDimVector, const array<SmallVector<ptrdiff_t>, N>& reducingStrideVectors)
 {
@@ -581,7 +712,8 @@ static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> point
 
         // By how much do we underutilize?
         // We increase #blocks by that factor by breaking reduction into that many chunks.
-        let numReductionChunks = CeilDiv(props.multiProcessorCount, NN);
+        // Only sums can be split into chunks, since those get combined with atomicAdd().
+        let numReductionChunks = reductionOp == ElementWiseOperator::opSum ? CeilDiv(props.multiProcessorCount, NN) : 1;
 
         // NN may be too large for a single dimension
         let blockXOverBy = CeilDiv(NN, props.maxGridSize[0]);
@@ -594,24 +726,25 @@ static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> point
 
         // reduction goes into thread dim X
         let reductionChunkSize = CeilDiv(reductionDim, numReductionChunks);
-        let numThreadsX = min(reductionChunkSize, GridDim::maxThreadsPerBlock); // any that's over will be done by looping inside the kernel
+        // The warp reduction needs complete warps; any that's over will be done by looping inside the kernel.
+        let numThreadsX = min(CeilDiv(reductionChunkSize, 32) * 32, GridDim::maxThreadsPerBlock);
 
         if (beta == 1 || numBlocksZ == 1)
         {
-            _launchTensorOpWithReduction<ElemType, N, M, K><<<dim3(numBlocksX, numBlocksY, numBlocksZ), numThreadsX, numThreadsX * sizeof(ReduceElemType), t_stream>>>(/*beta=*/1, pointers, alpha, op, regularOpStrides, regularStrides, NN, reducingOpDims, reducingStrides, 0, reductionChunkSize);
+            _launchTensorOpWithReduction<ElemType, N, M, K><<<dim3(numBlocksX, numBlocksY, numBlocksZ), numThreadsX, 0, t_stream>>>(beta, pointers, alpha, op, reductionOp, regularOpStrides, regularStrides, NN, reducingOpDims, reducingStrides, 0, reductionChunkSize);
         }
         else
         {
             // We need more than one chunk, we will use atomicAdd().
             // First reset/pre-multiply input; then do the remaining chunks using atomicAdd().
-            _launchTensorOpWithReduction<ElemType, N, M, K><<<dim3(numBlocksX, numBlocksY, 1), numThreadsX, numThreadsX * sizeof(ReduceElemType), t_stream>>>(beta, pointers, alpha, op, regularOpStrides, regularStrides, NN, reducingOpDims, reducingStrides, 0, reductionChunkSize);
-            _launchTensorOpWithReduction<ElemType, N, M, K><<<dim3(numBlocksX, numBlocksY, numBlocksZ - 1), numThreadsX, numThreadsX * sizeof(ReduceElemType), t_stream>>>(/*beta=*/1, pointers, alpha, op, regularOpStrides, regularStrides, NN, reducingOpDims, reducingStrides, reductionChunkSize, reductionChunkSize);
+            _launchTensorOpWithReduction<ElemType, N, M, K><<<dim3(numBlocksX, numBlocksY, 1), numThreadsX, 0, t_stream>>>(beta, pointers, alpha, op, reductionOp, regularOpStrides, regularStrides, NN, reducingOpDims, reducingStrides, 0, reductionChunkSize);
+            _launchTensorOpWithReduction<ElemType, N, M, K><<<dim3(numBlocksX, numBlocksY, numBlocksZ - 1), numThreadsX, 0, t_stream>>>(/*beta=*/1, pointers, alpha, op, reductionOp, regularOpStrides, regularStrides, NN, reducingOpDims, reducingStrides, reductionChunkSize, reductionChunkSize);
         }
     }
     else
     {
         // we got enough elements to generate: do one element per thread, and reduction inside
-        _launchTensorOp<ElemType, N, M, K><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointers, alpha, op, regularOpStrides, regularStrides, grid.m_N, reducingOpDims, reducingStrides);
+        _launchTensorOp<ElemType, N, M, K><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointers, alpha, op, reductionOp, regularOpStrides, regularStrides, grid.m_N, reducingOpDims, reducingStrides);
     }
     if (do_sync)
         CUDA_CALL(cudaEventRecord(done));
@@ -695,13 +828,59 @@ void LaunchUnaryTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemTy
         CUDA_CALL(cudaEventDestroy(done));
 }
 
+// -----------------------------------------------------------------------
+// fused elementwise programs (ElementWiseProgram, see CommonMatrix.h)
+// -----------------------------------------------------------------------
+
+// the operand pointers, passed by value like FixedArray
+template <class ElemType>
+struct ElementWiseProgramPointers
+{
+    const ElemType* inputs[ElementWiseProgram::maxInputs];
+    ElemType* outputs[ElementWiseProgram::maxOutputs];
+};
+
+template <class ElemType>
+__global__ void _launchElementWiseProgram(const ElementWiseProgram program, const ElementWiseProgramPointers<ElemType> pointers, CUDA_LONG numElements)
+{
+    CUDA_LONG id = GridDim::GetLinearThreadId();
+    if (id >= numElements)
+        return;
+    ExecuteElementWiseProgram(program, pointers.inputs, pointers.outputs, (size_t) id);
+}
+
+template <class ElemType>
+void LaunchElementWiseProgram(const ElementWiseProgram& program, const ElemType* const* inputs, ElemType* const* outputs, size_t numElements)
+{
+    if (program.numInputs > ElementWiseProgram::maxInputs || program.numOutputs > ElementWiseProgram::maxOutputs)
+        LogicError("LaunchElementWiseProgram: Too many operands.");
+    ElementWiseProgramPointers<ElemType> pointers;
+    for (int k = 0; k < program.numInputs; k++)
+        pointers.inputs[k] = inputs[k];
+    for (int k = 0; k < program.numOutputs; k++)
+        pointers.outputs[k] = outputs[k];
+
+    CUDA_LONG NN = (CUDA_LONG) numElements;
+    cudaEvent_t done = nullptr;
+    if (do_sync)
+        CUDA_CALL(cudaEventCreate(&done));
+    GridDim grid(NN);
+    _launchElementWiseProgram<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(program, pointers, NN);
+    if (do_sync)
+        CUDA_CALL(cudaEventRecord(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventSynchronize(done));
+    if (do_sync)
+        CUDA_CALL(cudaEventDestroy(done));
+}
+
 // -----------------------------------------------------------------------
 // map runtime parameters N to template parameters
 // -----------------------------------------------------------------------
 
 // tensor operation with k+1 dimensions (-1 means scalar)
 template <class ElemType, C_size_t N, C_int K>
-static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op,
+static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
                                     const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
 {
@@ -709,11 +888,11 @@ static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& po
     switch (dims)
     {
     case 2:
-        return LaunchTensorOpWithReduction<ElemType, N, 2, K>(beta, pointers, alpha, op, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return LaunchTensorOpWithReduction<ElemType, N, 2, K>(beta, pointers, alpha, op, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 1:
-        return LaunchTensorOpWithReduction<ElemType, N, 1, K>(beta, pointers, alpha, op, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return LaunchTensorOpWithReduction<ElemType, N, 1, K>(beta, pointers, alpha, op, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 0:
-        return LaunchTensorOp<ElemType, N, K>(beta, pointers, alpha, op, regularOpDims, regularStrides);
+        return LaunchTensorOp<ElemType, N, K>(beta, pointers, alpha, op, reductionOp, regularOpDims, regularStrides);
     default:
         LogicError("TensorOp: %d non-flattened reduction dimensions are not supported.", (C_int) dims);
     }
@@ -722,26 +901,34 @@ static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& po
 // tensor operation, generalized in number of arguments
 // This function now expands into different k. It also eliminates the offsets by adding them to the pointers.
 template <class ElemType, C_size_t N>
-void TensorOpN(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op,
+void TensorOpN(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                const array<size_t, N>& offsets,
                const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
                const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
 {
     for (C_size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
         pointers[i] += offsets[i];
+
+    // special case: all operands dense and of the same shape
+    bool isDense = regularOpDims.size() == 1 && reducingOpDims.empty();
+    for (C_size_t i = 0; i < N && isDense; i++)
+        isDense = regularStrides[i][0] == 1;
+    if (isDense)
+        return LaunchDenseTensorOp<ElemType, N>(beta, pointers, alpha, op, regularOpDims[0]);
+
     size_t dims = regularOpDims.size();
     switch (dims)
     {
     case 4:
-        return TensorOpWithRegularLoop<ElemType, N, 4>(beta, pointers, alpha, op, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, N, 4>(beta, pointers, alpha, op, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 3:
-        return TensorOpWithRegularLoop<ElemType, N, 3>(beta, pointers, alpha, op, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, N, 3>(beta, pointers, alpha, op, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 2:
-        return TensorOpWithRegularLoop<ElemType, N, 2>(beta, pointers, alpha, op, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, N, 2>(beta, pointers, alpha, op, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 1:
-        return TensorOpWithRegularLoop<ElemType, N, 1>(beta, pointers, alpha, op, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, N, 1>(beta, pointers, alpha, op, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 0:
-        return TensorOpWithRegularLoop<ElemType, N, 0>(beta, pointers, alpha, op, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithRegularLoop<ElemType, N, 0>(beta, pointers, alpha, op, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     default:
         LogicError("TensorOp: %d non-flattened input dimensions are not supported.", (C_int) dims);
     }
@@ -751,33 +938,36 @@ void TensorOpN(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, Elem
 // explicit instantiations--these are being called from GPUMatrix.cu
 //------------------------------------------------------------------------
 
-template void TensorOpN<float, 2>(float beta, array<float*, 2> pointers, float alpha, ElementWiseOperator op,
+template void TensorOpN<float, 2>(float beta, array<float*, 2> pointers, float alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                   const array<size_t, 2>& offsets,
                                   const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                                   const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides);
-template void TensorOpN<float, 3>(float beta, array<float*, 3> pointers, float alpha, ElementWiseOperator op,
+template void TensorOpN<float, 3>(float beta, array<float*, 3> pointers, float alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                   const array<size_t, 3>& offsets,
                                   const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
                                   const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides);
-template void TensorOpN<float, 4>(float beta, array<float*, 4> pointers, float alpha, ElementWiseOperator op,
+template void TensorOpN<float, 4>(float beta, array<float*, 4> pointers, float alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                   const array<size_t, 4>& offsets,
                                   const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                                   const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
-template void TensorOpN<double, 2>(double beta, array<double*, 2> pointers, double alpha, ElementWiseOperator op,
+template void TensorOpN<double, 2>(double beta, array<double*, 2> pointers, double alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 2>& offsets,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides);
-template void TensorOpN<double, 3>(double beta, array<double*, 3> pointers, double alpha, ElementWiseOperator op,
+template void TensorOpN<double, 3>(double beta, array<double*, 3> pointers, double alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 3>& offsets,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides);
-template void TensorOpN<double, 4>(double beta, array<double*, 4> pointers, double alpha, ElementWiseOperator op,
+template void TensorOpN<double, 4>(double beta, array<double*, 4> pointers, double alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 4>& offsets,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
 
 template void LaunchUnaryTensorOp(float beta, const float* pa, float* pb, float alpha, ElementWiseOperator op, size_t regularOpDim);
 template void LaunchUnaryTensorOp(double beta, const double* pa, double* pb, double alpha, ElementWiseOperator op, size_t regularOpDim);
+
+template void LaunchElementWiseProgram(const ElementWiseProgram& program, const float* const* inputs, float* const* outputs, size_t numElements);
+template void LaunchElementWiseProgram(const ElementWiseProgram& program, const double* const* inputs, double* const* outputs, size_t numElements);
 }
 }
 }
@@ -11,6 +11,10 @@
 #include "GPUWatcher.h"
 #include <cuda.h>
 #include <cuda_runtime.h>
+#include <nvml.h>
+#pragma comment(lib, "nvml.lib")
+#include <map>
+#include <mutex>
 
 int GPUWatcher::GetGPUIdWithTheMostFreeMemory()
 {
@@ -53,6 +57,59 @@ size_t GPUWatcher::GetFreeMemoryOnCUDADevice(int devId)
         return free;
 }
 
+// NVML's handle of a CUDA device (they number devices differently, the PCI bus id is common); null without NVML
+static nvmlDevice_t GetNvmlDevice(int devId)
+{
+    static std::mutex mutex;
+    static bool nvmlInitialized = false, nvmlAvailable = false;
+    static std::map<int, nvmlDevice_t> devices;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!nvmlInitialized)
+    {
+        nvmlAvailable = nvmlInit() == NVML_SUCCESS;
+        nvmlInitialized = true;
+    }
+    if (!nvmlAvailable)
+        return nullptr;
+    auto iter = devices.find(devId);
+    if (iter != devices.end())
+        return iter->second;
+    nvmlDevice_t device = nullptr;
+    char pciBusId[32];
+    if (cudaDeviceGetPCIBusId(pciBusId, sizeof(pciBusId), devId) != cudaSuccess || nvmlDeviceGetHandleByPciBusId(pciBusId, &device) != NVML_SUCCESS)
+        device = nullptr;
+    devices[devId] = device;
+    return device;
+}
+
+GPUTelemetrySample GPUWatcher::GetTelemetryOfCUDADevice(int devId)
+{
+    const double MB = 1 << 20;
+    GPUTelemetrySample sample;
+    size_t inUseBytes, cachedBytes;
+    Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::GetMemoryStatistics(devId, inUseBytes, cachedBytes);
+    sample.memoryCachedMB = cachedBytes / MB;
+
+    nvmlDevice_t device = GetNvmlDevice(devId);
+    if (!device)
+        return sample;
+    nvmlUtilization_t utilization;
+    if (nvmlDeviceGetUtilizationRates(device, &utilization) == NVML_SUCCESS)
+        sample.smUtilization = (int) utilization.gpu;
+    nvmlMemory_t memory;
+    if (nvmlDeviceGetMemoryInfo(device, &memory) == NVML_SUCCESS)
+    {
+        sample.memoryUsedMB = memory.used / MB;
+        sample.memoryTotalMB = memory.total / MB;
+    }
+    unsigned int kbPerSec;
+    if (nvmlDeviceGetPcieThroughput(device, NVML_PCIE_UTIL_TX_BYTES, &kbPerSec) == NVML_SUCCESS)
+        sample.pcieTxMBPerSec = kbPerSec / 1024.0;
+    if (nvmlDeviceGetPcieThroughput(device, NVML_PCIE_UTIL_RX_BYTES, &kbPerSec) == NVML_SUCCESS)
+        sample.pcieRxMBPerSec = kbPerSec / 1024.0;
+    return sample;
+}
+
 GPUWatcher::GPUWatcher(void)
 {
 }
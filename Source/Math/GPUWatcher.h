@@ -7,11 +7,29 @@
 
 #include "GPUMatrix.h"
 
+// one sample of the activity of a device, for training telemetry; what cannot be queried is -1
+struct GPUTelemetrySample
+{
+    int smUtilization;     // percent of the last sample period (about 1/6 to 1 s) in which a kernel ran (NVML)
+    double memoryUsedMB;   // on the device, by all processes
+    double memoryTotalMB;
+    double memoryCachedMB; // of memoryUsedMB, free buffers that our allocator cache holds on to
+    double pcieTxMBPerSec; // PCIe throughput over the last 20 ms (NVML)
+    double pcieRxMBPerSec;
+
+    GPUTelemetrySample()
+        : smUtilization(-1), memoryUsedMB(-1), memoryTotalMB(-1), memoryCachedMB(-1), pcieTxMBPerSec(-1), pcieRxMBPerSec(-1)
+    {
+    }
+};
+
 class MATH_API GPUWatcher
 {
 public:
     static size_t GetFreeMemoryOnCUDADevice(int devId);
     static int GetGPUIdWithTheMostFreeMemory();
+    // does not change the current device of the calling thread; PCIe sampling blocks for 20 ms
+    static GPUTelemetrySample GetTelemetryOfCUDADevice(int devId);
     GPUWatcher(void);
     ~GPUWatcher(void);
 };
@@ -0,0 +1,151 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// HugePageMemAllocator.cpp -- huge-page backed host allocations (see HugePageMemAllocator.h)
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "HugePageMemAllocator.h"
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static size_t s_hugePageSize = 0; // 0: off
+static size_t s_hugePageMinBytes = 0;
+static std::mutex s_hugePageMutex;
+static std::unordered_map<const void*, size_t> s_hugePageRegions; // [start] mapped bytes
+static std::atomic<size_t> s_numHugePageRegions(0);            // (lets Owns() skip the lock when there are none)
+static bool s_warnedFallback = false;
+
+void HugePageMemAllocator::Configure(size_t pageSize, size_t minBytes)
+{
+    if (pageSize != 0 && pageSize != pageSize2MB && pageSize != pageSize1GB)
+        InvalidArgument("HugePageMemAllocator: page size must be 2MB or 1GB.");
+    s_hugePageSize = pageSize;
+    s_hugePageMinBytes = max(minBytes, pageSize);
+}
+
+bool HugePageMemAllocator::IsUsedFor(size_t bytes)
+{
+    return s_hugePageSize != 0 && bytes >= s_hugePageMinBytes;
+}
+
+static void WarnFallback(const char* reason)
+{
+    std::lock_guard<std::mutex> lock(s_hugePageMutex);
+    if (!s_warnedFallback)
+        fprintf(stderr, "HugePageMemAllocator: %s\n", reason);
+    s_warnedFallback = true;
+}
+
+void* HugePageMemAllocator::Allocate(size_t bytes)
+{
+    const size_t pageSize = s_hugePageSize ? s_hugePageSize : pageSize2MB;
+    size_t mappedBytes = (max(bytes, (size_t) 1) + pageSize - 1) / pageSize * pageSize;
+    void* p = nullptr;
+#ifdef _WIN32
+    // large pages are the processor's large-page size (2MB on x64) and need SeLockMemoryPrivilege
+    const size_t largePage = GetLargePageMinimum();
+    if (largePage != 0)
+    {
+        const size_t largeBytes = (mappedBytes + largePage - 1) / largePage * largePage;
+        p = VirtualAlloc(nullptr, largeBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (p)
+            mappedBytes = largeBytes;
+    }
+    if (!p)
+    {
+        WarnFallback("large pages not available (the 'Lock pages in memory' privilege is required), using regular pages");
+        p = VirtualAlloc(nullptr, mappedBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+    if (!p)
+        RuntimeError("HugePageMemAllocator: failed to allocate %llu bytes.", (unsigned long long) bytes);
+#else
+    p = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (pageSize == pageSize1GB ? MAP_HUGE_1GB : MAP_HUGE_2MB), -1, 0);
+    if (p == MAP_FAILED)
+    {
+        // no reserved huge pages: align the region to 2MB and let the kernel back it with transparent huge pages
+        WarnFallback("no reserved huge pages (see /proc/sys/vm/nr_hugepages), using transparent huge pages");
+        mappedBytes = (max(bytes, (size_t) 1) + pageSize2MB - 1) / pageSize2MB * pageSize2MB;
+        char* region = (char*) mmap(nullptr, mappedBytes + pageSize2MB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED)
+            RuntimeError("HugePageMemAllocator: failed to allocate %llu bytes.", (unsigned long long) bytes);
+        char* aligned = (char*) (((uintptr_t) region + pageSize2MB - 1) / pageSize2MB * pageSize2MB);
+        if (aligned > region)
+            munmap(region, aligned - region);
+        if (aligned + mappedBytes < region + mappedBytes + pageSize2MB)
+            munmap(aligned + mappedBytes, region + mappedBytes + pageSize2MB - (aligned + mappedBytes));
+        madvise(aligned, mappedBytes, MADV_HUGEPAGE);
+        p = aligned;
+    }
+#endif
+    std::lock_guard<std::mutex> lock(s_hugePageMutex);
+    s_hugePageRegions[p] = mappedBytes;
+    s_numHugePageRegions++;
+    return p;
+}
+
+bool HugePageMemAllocator::Owns(const void* p)
+{
+    if (p == nullptr || s_numHugePageRegions == 0)
+        return false;
+    std::lock_guard<std::mutex> lock(s_hugePageMutex);
+    return s_hugePageRegions.find(p) != s_hugePageRegions.end();
+}
+
+bool HugePageMemAllocator::Deallocate(void* p)
+{
+    if (p == nullptr || s_numHugePageRegions == 0)
+        return false;
+    size_t mappedBytes;
+    {
+        std::lock_guard<std::mutex> lock(s_hugePageMutex);
+        auto found = s_hugePageRegions.find(p);
+        if (found == s_hugePageRegions.end())
+            return false;
+        mappedBytes = found->second;
+        s_hugePageRegions.erase(found);
+        s_numHugePageRegions--;
+    }
+#ifdef _WIN32
+    mappedBytes;
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munmap(p, mappedBytes);
+#endif
+    return true;
+}
+
+void* HugePageMemAllocator::Malloc(size_t size)
+{
+    if (IsUsedFor(size))
+        return Allocate(size);
+    void* p = malloc(size);
+    if (!p)
+        RuntimeError("HugePageMemAllocator: failed to allocate %llu bytes.", (unsigned long long) size);
+    return p;
+}
+
+void HugePageMemAllocator::Free(void* p)
+{
+    if (!Deallocate(p))
+        free(p);
+}
+} } }
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "MemAllocator.h"
+#include <stddef.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+// -----------------------------------------------------------------------
+// HugePageMemAllocator -- host memory for large buffers, backed by 2MB or 1GB pages
+// This cuts the TLB misses of GEMMs and frame gathers on big CPU matrices and reader buffers. It is off by
+// default; Configure() turns it on process-wide for allocations of at least 'minBytes'. CPUMatrix storage, the
+// speech readers' ssematrix buffers and CUDAPageLockedMemAllocator (which then registers the pages with CUDA)
+// go through it.
+// On Linux, explicit huge pages (MAP_HUGETLB) are used if the kernel has some reserved, otherwise the region is
+// huge-page aligned and marked for transparent huge pages. On Windows, large pages need the 'Lock pages in memory'
+// privilege; without it, regular pages are used. Pages are placed on the NUMA node that first touches them, so
+// callers that zero large buffers do so from the threads that will work on them (see NewArray() in CPUMatrix.cpp).
+// -----------------------------------------------------------------------
+
+class MATH_API HugePageMemAllocator : public MemAllocator
+{
+public:
+    static const size_t pageSize2MB = (size_t) 2 << 20;
+    static const size_t pageSize1GB = (size_t) 1 << 30;
+
+    // pageSize is pageSize2MB, pageSize1GB, or 0 to turn huge pages off
+    static void Configure(size_t pageSize, size_t minBytes);
+    static bool IsUsedFor(size_t bytes);
+
+    // Allocate() always returns huge-page sized (and aligned) memory, falling back to regular pages if there are none
+    static void* Allocate(size_t bytes);
+    static bool Owns(const void* p);
+    static bool Deallocate(void* p); // false (and nothing done) if 'p' is not from Allocate()
+
+    // MemAllocator: huge pages if IsUsedFor(size), otherwise malloc()
+    void* Malloc(size_t size) override;
+    void Free(void* p) override;
+};
+} } }
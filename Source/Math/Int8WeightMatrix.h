@@ -0,0 +1,130 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "Basics.h"
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// Int8WeightMatrix -- a weight matrix quantized to INT8, for inference-only products W * X on the CPU
+//
+// As in ValueQuantizer.h, each vector is mapped symmetrically onto a fixed integer range with its own scale:
+// every row of W (one output dimension) with max|w| / 127, and every column of X (one sample) with max|x| / 127,
+// computed on the fly unless a fixed input range was calibrated. Products are accumulated in int32 and
+// rescaled by rowScale * columnScale.
+// Rows are stored contiguously and padded to a multiple of 32, so that the inner loop is a plain int8 dot product.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class Int8WeightMatrix
+{
+public:
+    // W - [rows x cols], column-major in CPU memory
+    Int8WeightMatrix(const ElemType* W, size_t rows, size_t cols)
+        : m_rows(rows), m_cols(cols), m_paddedCols((cols + 31) / 32 * 32), m_weights(rows * m_paddedCols, 0), m_rowScales(rows), m_inputMaxAbs(0)
+    {
+        for (size_t i = 0; i < rows; i++)
+        {
+            ElemType maxAbs = 0;
+            for (size_t j = 0; j < cols; j++)
+                maxAbs = std::max(maxAbs, (ElemType) std::fabs(W[i + j * rows]));
+            const ElemType scale = maxAbs > 0 ? maxAbs / 127 : 1;
+            m_rowScales[i] = scale;
+            for (size_t j = 0; j < cols; j++)
+                m_weights[i * m_paddedCols + j] = Quantize(W[i + j * rows], 1 / scale);
+        }
+    }
+
+    size_t GetNumRows() const { return m_rows; }
+    size_t GetNumCols() const { return m_cols; }
+
+    // fix the range of the input values, e.g. from calibration; values beyond are clipped. 0 means a range per input column.
+    void SetInputMaxAbs(ElemType maxAbs)
+    {
+        m_inputMaxAbs = maxAbs;
+    }
+
+    // Y = W * X
+    // X - [cols x numSamples], Y - [rows x numSamples], both column-major and contiguous in CPU memory
+    void Multiply(const ElemType* X, size_t numSamples, ElemType* Y) const
+    {
+        // quantize the inputs
+        m_inputs.assign(numSamples * m_paddedCols, 0);
+        m_columnScales.resize(numSamples);
+#pragma omp parallel for
+        for (long j = 0; j < (long) numSamples; j++)
+        {
+            const ElemType* x = X + j * m_cols;
+            ElemType maxAbs = m_inputMaxAbs;
+            if (maxAbs == 0)
+                for (size_t k = 0; k < m_cols; k++)
+                    maxAbs = std::max(maxAbs, (ElemType) std::fabs(x[k]));
+            const ElemType scale = maxAbs > 0 ? maxAbs / 127 : 1;
+            m_columnScales[j] = scale;
+            for (size_t k = 0; k < m_cols; k++)
+                m_inputs[j * m_paddedCols + k] = Quantize(x[k], 1 / scale);
+        }
+
+        // each weight row stays in cache while it meets all samples
+#pragma omp parallel for
+        for (long i = 0; i < (long) m_rows; i++)
+        {
+            const int8_t* w = m_weights.data() + i * m_paddedCols;
+            for (size_t j = 0; j < numSamples; j++)
+                Y[i + j * m_rows] = (ElemType) Dot(w, m_inputs.data() + j * m_paddedCols, m_paddedCols) * m_rowScales[i] * m_columnScales[j];
+        }
+    }
+
+private:
+    static int8_t Quantize(ElemType value, ElemType invScale)
+    {
+        const ElemType q = std::round(value * invScale);
+        return (int8_t) std::max((ElemType) -127, std::min((ElemType) 127, q));
+    }
+
+    // n must be a multiple of 16
+    static int32_t Dot(const int8_t* a, const int8_t* b, size_t n)
+    {
+#ifdef __AVX2__
+        // sign-extend to int16 and multiply-add pairs into int32; |a * b| <= 127 * 127, so pairs cannot overflow
+        __m256i sum = _mm256_setzero_si256();
+        for (size_t k = 0; k < n; k += 16)
+        {
+            const __m256i a16 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (a + k)));
+            const __m256i b16 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (b + k)));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a16, b16));
+        }
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        s = _mm_hadd_epi32(s, s);
+        s = _mm_hadd_epi32(s, s);
+        return _mm_cvtsi128_si32(s);
+#else
+        int32_t sum = 0;
+        for (size_t k = 0; k < n; k++)
+            sum += (int32_t) a[k] * (int32_t) b[k];
+        return sum;
+#endif
+    }
+
+    size_t m_rows;
+    size_t m_cols;
+    size_t m_paddedCols;
+    std::vector<int8_t> m_weights;     // [i * m_paddedCols + j] quantized W(i,j)
+    std::vector<ElemType> m_rowScales; // [i] dequantization scale of row i
+    ElemType m_inputMaxAbs;            // fixed input range, or 0
+
+    // scratch for Multiply()
+    mutable std::vector<int8_t> m_inputs;
+    mutable std::vector<ElemType> m_columnScales;
+};
+} } }
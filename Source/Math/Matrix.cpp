@@ -12,8 +12,16 @@
 #include "GPUMatrix.h"
 #include "GPUSparseMatrix.h"
 #include "File.h"
+#include "ReducedPrecision.h"
+#include "DebugUtil.h"
 #include <assert.h>
 #include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <time.h>
 #include "GPUWatcher.h" // bring in this class as well so that it gets exported from this DLL
 #ifndef CPUONLY
 #pragma comment(lib, "MathCUDA.lib") // built by CNTKMathCUDA project
@@ -192,6 +200,15 @@ DEVICEID_TYPE EnforceOneGPUOnly(DEVICEID_TYPE requestedDeviceId)
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+unsigned long long ResolveRandomSeed(unsigned long seed)
+{
+    if (seed != USE_TIME_BASED_SEED)
+        return seed;
+    // above the explicit seeds (for 32-bit unsigned long), and one apart per call
+    static std::atomic<unsigned long long> nextSeed(((unsigned long long) time(NULL) << 32) | 0x80000000ull);
+    return nextSeed++;
+}
+
 #pragma region Constructors, destructors and other static matrix builders
 
 //This function will only initialize default bland matrix. The actual matrices need to allocated
@@ -613,15 +630,93 @@ void Matrix<ElemType>::Read(File& stream)
             M.SetDataLocation(GPU, SPARSE);
         }
     }
+    else if (type == 'h' || type == 'q') // compact encodings, see Write()
+    {
+        stream.GetMarker(fileMarkerBeginSection, std::wstring(type == 'h' ? L"BMATH" : L"BMATQ"));
+        std::wstring name;
+        size_t numRows, numCols;
+        stream >> name >> numRows >> numCols;
+        std::vector<ElemType> values(numRows * numCols);
+        if (type == 'h')
+        {
+            std::vector<uint16_t> halves(values.size());
+            stream.GetArray(halves.data(), halves.size());
+            for (size_t k = 0; k < values.size(); k++)
+                values[k] = (ElemType) HalfToFloat(halves[k]);
+        }
+        else
+        {
+            std::vector<float> offsets(numCols), scales(numCols);
+            stream.GetArray(offsets.data(), numCols);
+            stream.GetArray(scales.data(), numCols);
+            std::vector<uint8_t> codes(values.size());
+            stream.GetArray(codes.data(), codes.size());
+            for (size_t j = 0; j < numCols; j++)
+                for (size_t i = 0; i < numRows; i++)
+                    values[j * numRows + i] = (ElemType) (offsets[j] + scales[j] * codes[j * numRows + i]);
+        }
+        stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+        M.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+        M.SetValue(numRows, numCols, M.GetDeviceId(), values.data(), matrixFlagNormal);
+        if (name != L"unnamed")
+            M.SetMatrixName(name.c_str());
+    }
     else
         LogicError("Read: Input file corrupt (invalid matrix type field 0x%02d, should be 'f' or 'd').", type);
 }
 
+// compact encodings of the elements of a dense matrix, for models that are deployed rather than trained further:
+//  - 'h': FP16, half the size of float with a relative error of at most 2^-11
+//  - 'q': 8 bits per element with an offset (the minimum) and a scale per column, a quarter of the size of float
+// The shape and name are stored as for 'd'; the values are decoded to ElemType by Read().
+template <class ElemType>
+static void WriteCompact(File& stream, const Matrix<ElemType>& M, bool quantize)
+{
+    const size_t numRows = M.GetNumRows(), numCols = M.GetNumCols();
+    std::vector<ElemType> values(M.GetNumElements());
+    M.CopySection(numRows, numCols, values.data(), numRows);
+    stream << (quantize ? 'q' : 'h');
+    stream.PutMarker(fileMarkerBeginSection, std::wstring(quantize ? L"BMATQ" : L"BMATH"));
+    stream << std::wstring(M.GetMatrixName() ? M.GetMatrixName() : L"unnamed") << numRows << numCols;
+    if (!quantize)
+    {
+        std::vector<uint16_t> halves(values.size());
+        for (size_t k = 0; k < values.size(); k++)
+            halves[k] = FloatToHalf((float) values[k]);
+        stream.PutArray(halves.data(), halves.size());
+    }
+    else
+    {
+        std::vector<float> offsets(numCols), scales(numCols);
+        std::vector<uint8_t> codes(values.size());
+        for (size_t j = 0; j < numCols; j++)
+        {
+            const ElemType* column = values.data() + j * numRows;
+            float lo = (float) column[0], hi = lo;
+            for (size_t i = 1; i < numRows; i++)
+            {
+                lo = (float) column[i] < lo ? (float) column[i] : lo;
+                hi = (float) column[i] > hi ? (float) column[i] : hi;
+            }
+            offsets[j] = lo;
+            scales[j] = (hi - lo) / 255;
+            for (size_t i = 0; i < numRows; i++)
+                codes[j * numRows + i] = scales[j] > 0 ? (uint8_t) (((float) column[i] - lo) / scales[j] + 0.5f) : 0;
+        }
+        stream.PutArray(offsets.data(), numCols);
+        stream.PutArray(scales.data(), numCols);
+        stream.PutArray(codes.data(), codes.size());
+    }
+    stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+}
+
 template <class ElemType>
 void Matrix<ElemType>::Write(File& stream) const
 {
     const Matrix<ElemType>& M = *this;
-    if (M.GetMatrixType() == MatrixType::DENSE)
+    if (M.GetMatrixType() == MatrixType::DENSE && (stream.UsesCompactFP16() || stream.UsesCompactInt8()) && M.GetNumElements() >= File::compactMinElements)
+        WriteCompact(stream, M, stream.UsesCompactInt8());
+    else if (M.GetMatrixType() == MatrixType::DENSE)
     {
         stream << 'd';
         if (M.GetDeviceId() < 0)
@@ -1227,6 +1322,25 @@ void Matrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, int
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::SetValueFromCompact(const size_t numRows, const size_t numCols, int deviceId, const void* pArray, CompactElementType type,
+                                           ElemType scale, const Matrix<ElemType>* rowShift)
+{
+    if (((numRows * numCols) > 0) && (pArray == nullptr))
+        InvalidArgument("Invalid pArray.");
+    if (rowShift && (rowShift->GetNumRows() != numRows || rowShift->GetNumCols() != 1 || rowShift->GetMatrixType() != DENSE))
+        InvalidArgument("SetValueFromCompact: rowShift must be a dense column of %d rows.", (int) numRows);
+    if (rowShift && rowShift->GetDeviceId() != GetDeviceId())
+        InvalidArgument("SetValueFromCompact: rowShift must be on the device of the matrix.");
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->SetValueFromCompact(numRows, numCols, pArray, type, scale, rowShift ? rowShift->m_CPUMatrix->BufferPointer() : nullptr),
+                            m_GPUMatrix->SetValueFromCompact(numRows, numCols, deviceId, pArray, type, scale, rowShift ? rowShift->m_GPUMatrix->BufferPointer() : nullptr),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::SetValue(const size_t rIdx, const size_t cIdx, ElemType val)
 {
@@ -1251,6 +1365,70 @@ void Matrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCC
                             m_GPUSparseMatrix->SetMatrixFromCSCFormat(h_CSCCol, h_Row, h_Val, nz, numRows, numCols));
 }
 
+template <class ElemType>
+void Matrix<ElemType>::SetMatrixFromCOOFormat(const CPUSPARSE_INDEX_TYPE* h_Col, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                              const size_t nz, const size_t numRows, const size_t numCols)
+{
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            m_CPUSparseMatrix->SetMatrixFromCOOFormat(h_Col, h_Row, h_Val, nz, numRows, numCols),
+                            m_GPUSparseMatrix->SetMatrixFromCOOFormat(h_Col, h_Row, h_Val, nz, numRows, numCols));
+}
+
+template <class ElemType>
+void Matrix<ElemType>::GetSparseBlockColData(std::vector<size_t>& columnIds, std::vector<ElemType>& values) const
+{
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            nullptr,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            m_CPUSparseMatrix->GetSparseBlockColData(columnIds, values),
+                            m_GPUSparseMatrix->GetSparseBlockColData(columnIds, values));
+}
+
+template <class ElemType>
+void Matrix<ElemType>::GetSparseCSCData(std::vector<CPUSPARSE_INDEX_TYPE>& colStarts, std::vector<CPUSPARSE_INDEX_TYPE>& rowIndices, std::vector<ElemType>& values) const
+{
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            nullptr,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            m_CPUSparseMatrix->GetSparseCSCData(colStarts, rowIndices, values),
+                            NOT_IMPLEMENTED);
+}
+
+// the blocks are found on the CPU; this is meant for converting weights once, e.g. when loading a model
+template <class ElemType>
+void Matrix<ElemType>::SetBlockSparseRowValue(const Matrix<ElemType>& a, const size_t blockDim)
+{
+    if (a.GetMatrixType() != MatrixType::DENSE)
+        LogicError("SetBlockSparseRowValue: The source matrix must be dense.");
+
+    std::unique_ptr<ElemType[]> dense(a.CopyToArray());
+    CPUSparseMatrix<ElemType> bsr(matrixFormatSparseBSR);
+    bsr.SetBSRFromDense(dense.get(), a.GetNumRows(), a.GetNumCols(), blockDim);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            m_CPUSparseMatrix->SetValue(bsr),
+                            m_GPUSparseMatrix->SetValue(bsr));
+}
+
+template <class ElemType>
+void Matrix<ElemType>::SetSparseBlockColData(const size_t numRows, const size_t numCols, const std::vector<size_t>& columnIds, const std::vector<ElemType>& values)
+{
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            m_CPUSparseMatrix->SetSparseBlockColData(numRows, numCols, columnIds, values),
+                            m_GPUSparseMatrix->SetSparseBlockColData(numRows, numCols, columnIds, values));
+}
+
 template <class ElemType>
 void Matrix<ElemType>::SetDiagonalValue(const ElemType v)
 {
@@ -1351,7 +1529,7 @@ void Matrix<ElemType>::AddGaussianRandomValue(const ElemType mean, const ElemTyp
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
                             m_CPUMatrix->AddGaussianRandomValue(mean, sigma, seed),
-                            NOT_IMPLEMENTED,
+                            m_GPUMatrix->AddGaussianRandomValue(mean, sigma, seed),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
 }
@@ -1469,8 +1647,10 @@ void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Mat
                             SetDataLocation(CPU),
                             m_GPUMatrix->FSAdagrad(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes);
                             SetDataLocation(GPU),
-                            NOT_IMPLEMENTED,
-                            NOT_IMPLEMENTED);
+                            gradients.m_CPUSparseMatrix->FSAdagrad(*m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes);
+                            SetDataLocation(CPU),
+                            gradients.m_GPUSparseMatrix->FSAdagrad(*m_GPUMatrix, *functionValues.m_GPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes);
+                            SetDataLocation(GPU));
 }
 
 template <class ElemType>
@@ -1484,14 +1664,98 @@ ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
 {
     DecideAndMoveToRightDevice(*this, gradients);
 
-    DISPATCH_MATRIX_ON_FLAG(this,
+    DISPATCH_MATRIX_ON_FLAG(&gradients,
                             &gradients,
                             return m_CPUMatrix->RmsProp(*gradients.m_CPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier);
                             SetDataLocation(CPU),
                             return m_GPUMatrix->RmsProp(*gradients.m_GPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier);
                             SetDataLocation(GPU),
-                            NOT_IMPLEMENTED,
-                            NOT_IMPLEMENTED);
+                            return gradients.m_CPUSparseMatrix->RmsProp(*m_CPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier);
+                            SetDataLocation(CPU),
+                            return gradients.m_GPUSparseMatrix->RmsProp(*m_GPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier);
+                            SetDataLocation(GPU));
+}
+
+// LARS: v = momentum v + learnRate trust g; W -= v, with trust = trustCoefficient ||W|| / ||g||
+// 'this' keeps v, followed by the norms; they are computed on the device, and the update reads them there.
+template <class ElemType>
+void Matrix<ElemType>::LarsUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRate, const ElemType momentum, const ElemType trustCoefficient)
+{
+    DecideAndMoveToRightDevice(*this, gradients);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients,
+                            &gradients,
+                            m_CPUMatrix->LarsUpdate(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, learnRate, momentum, trustCoefficient);
+                            SetDataLocation(CPU),
+                            m_GPUMatrix->LarsUpdate(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, learnRate, momentum, trustCoefficient);
+                            SetDataLocation(GPU),
+                            RuntimeError("LarsUpdate: Sparse gradients are not supported."),
+                            RuntimeError("LarsUpdate: Sparse gradients are not supported."));
+}
+
+// LAMB: Adam moments m and v of g, r = m^ / (sqrt(v^) + epsilon) + weightDecay W (bias-corrected moments); W -= learnRate trust r, with trust = ||W|| / ||r||
+// 'this' keeps m and v, followed by the norms and the step count (which thus is saved with the checkpoint).
+template <class ElemType>
+void Matrix<ElemType>::LambUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRate, const ElemType beta1, const ElemType beta2, const ElemType epsilon, const ElemType weightDecay)
+{
+    DecideAndMoveToRightDevice(*this, gradients);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients,
+                            &gradients,
+                            m_CPUMatrix->LambUpdate(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, learnRate, beta1, beta2, epsilon, weightDecay);
+                            SetDataLocation(CPU),
+                            m_GPUMatrix->LambUpdate(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, learnRate, beta1, beta2, epsilon, weightDecay);
+                            SetDataLocation(GPU),
+                            RuntimeError("LambUpdate: Sparse gradients are not supported."),
+                            RuntimeError("LambUpdate: Sparse gradients are not supported."));
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::MultiTensorNormalGrad(const std::vector<Matrix<ElemType>*>& functionValues, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& smoothedGradients,
+                                                      const ElemType learnRatePerSample, const ElemType momentum, const bool useNesterovMomentum,
+                                                      const ElemType clippingThreshold, const bool clipByTruncation, const ElemType l2Weight, const ElemType l1Threshold)
+{
+    if (functionValues.empty())
+        return;
+    if (gradients.size() != functionValues.size() || smoothedGradients.size() != functionValues.size())
+        LogicError("MultiTensorNormalGrad: The numbers of values, gradients, and smoothed gradients differ.");
+    const DEVICEID_TYPE deviceId = functionValues[0]->GetDeviceId();
+    for (size_t i = 0; i < functionValues.size(); i++)
+    {
+        DecideAndMoveToRightDevice(*functionValues[i], *gradients[i], *smoothedGradients[i]);
+        if (functionValues[i]->GetDeviceId() != deviceId || gradients[i]->GetMatrixType() != DENSE || functionValues[i]->GetMatrixType() != DENSE || smoothedGradients[i]->GetMatrixType() != DENSE)
+            LogicError("MultiTensorNormalGrad: All matrices must be dense and on the same device.");
+        if (gradients[i]->GetNumElements() != functionValues[i]->GetNumElements() || smoothedGradients[i]->GetNumElements() != functionValues[i]->GetNumElements())
+            LogicError("MultiTensorNormalGrad: Dimensions of value, gradient, and smoothed gradient differ.");
+    }
+
+    if (deviceId == CPUDEVICE)
+    {
+        std::vector<CPUMatrix<ElemType>*> values, grads, smoothed;
+        for (size_t i = 0; i < functionValues.size(); i++)
+        {
+            values.push_back(functionValues[i]->m_CPUMatrix);
+            grads.push_back(gradients[i]->m_CPUMatrix);
+            smoothed.push_back(smoothedGradients[i]->m_CPUMatrix);
+        }
+        CPUMatrix<ElemType>::MultiTensorNormalGrad(values, grads, smoothed, learnRatePerSample, momentum, useNesterovMomentum, clippingThreshold, clipByTruncation, l2Weight, l1Threshold);
+    }
+    else
+    {
+        std::vector<GPUMatrix<ElemType>*> values, grads, smoothed;
+        for (size_t i = 0; i < functionValues.size(); i++)
+        {
+            values.push_back(functionValues[i]->m_GPUMatrix);
+            grads.push_back(gradients[i]->m_GPUMatrix);
+            smoothed.push_back(smoothedGradients[i]->m_GPUMatrix);
+        }
+        GPUMatrix<ElemType>::MultiTensorNormalGrad(values, grads, smoothed, learnRatePerSample, momentum, useNesterovMomentum, clippingThreshold, clipByTruncation, l2Weight, l1Threshold);
+    }
+    for (size_t i = 0; i < functionValues.size(); i++)
+    {
+        functionValues[i]->SetDataLocation(deviceId == CPUDEVICE ? CPU : GPU, DENSE);
+        smoothedGradients[i]->SetDataLocation(deviceId == CPUDEVICE ? CPU : GPU, DENSE);
+    }
 }
 
 template <class ElemType>
@@ -1827,6 +2091,44 @@ Matrix<ElemType>& Matrix<ElemType>::AddToRowRepeatValuesOf(const Matrix<ElemType
     return *this;
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignRowStackedColumnsOf(const Matrix<ElemType>& a, const Matrix<ElemType>& sourceColumns)
+{
+    DecideAndMoveToRightDevice(a, sourceColumns, *this);
+
+    if (a.GetMatrixType() != DENSE || sourceColumns.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(a.GetMatrixType(), a.GetFormat(), false);
+
+    DISPATCH_MATRIX_ON_FLAG(&a,
+                            this,
+                            m_CPUMatrix->AssignRowStackedColumnsOf(*a.m_CPUMatrix, *sourceColumns.m_CPUMatrix),
+                            m_GPUMatrix->AssignRowStackedColumnsOf(*a.m_GPUMatrix, *sourceColumns.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddFromRowStackedColumnsOf(const Matrix<ElemType>& a, const Matrix<ElemType>& sourceColumns)
+{
+    DecideAndMoveToRightDevice(*this, a, sourceColumns);
+
+    if (GetMatrixType() != DENSE || a.GetMatrixType() != DENSE || sourceColumns.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AddFromRowStackedColumnsOf(*a.m_CPUMatrix, *sourceColumns.m_CPUMatrix),
+                            m_GPUMatrix->AddFromRowStackedColumnsOf(*a.m_GPUMatrix, *sourceColumns.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 //used in the DSSM model. The resulted *this is a [a.GetRows()*(negNumber+1), a.GetCols()] matrix
 //each column contains posNumber of  positive samples (original) and negNumber negative samples generated by copying
 //sample shifted by shiftNumber columns
@@ -2169,6 +2471,52 @@ Matrix<ElemType>& Matrix<ElemType>::AddElementProductOf(const Matrix<ElemType>&
     return *this;
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignDropoutOf(const Matrix<ElemType>& a, const ElemType dropoutRate, unsigned long seed, size_t offset)
+{
+    if (a.IsEmpty())
+        LogicError("AssignDropoutOf: Matrix is empty.");
+
+    DecideAndMoveToRightDevice(a, *this);
+    if (a.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(a.GetMatrixType(), a.GetFormat(), false);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AddDropoutOf(*a.m_CPUMatrix, 0, dropoutRate, seed, offset),
+                            m_GPUMatrix->AddDropoutOf(*a.m_GPUMatrix, 0, dropoutRate, seed, offset),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddDropoutOf(const Matrix<ElemType>& a, const ElemType dropoutRate, unsigned long seed, size_t offset)
+{
+    if (a.IsEmpty())
+        LogicError("AddDropoutOf: Matrix is empty.");
+
+    if (!(a.GetNumRows() == GetNumRows() && a.GetNumCols() == GetNumCols()))
+        InvalidArgument("AddDropoutOf: The input matrix dimensions do not match [this].");
+
+    DecideAndMoveToRightDevice(*this, a);
+
+    if (a.GetMatrixType() != DENSE || GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            nullptr,
+                            m_CPUMatrix->AddDropoutOf(*a.m_CPUMatrix, 1, dropoutRate, seed, offset),
+                            m_GPUMatrix->AddDropoutOf(*a.m_GPUMatrix, 1, dropoutRate, seed, offset),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 //[this]=a ./ b
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::AssignElementDivisionOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b)
@@ -3271,6 +3619,47 @@ Matrix<ElemType>& Matrix<ElemType>::AssignFrobeniusNormOf(const Matrix<ElemType>
     return *this;
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::ClipFrobeniusNorm(ElemType maxNorm, Matrix<ElemType>& norm)
+{
+    if (IsEmpty())
+        LogicError("ClipFrobeniusNorm: Matrix is empty.");
+    if (GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    norm.SwitchToMatrixType(DENSE, matrixFormatDense, false);
+    norm.TransferToDeviceIfNotThere(GetDeviceId(), true, true);
+    norm.Resize(1, 1);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->ClipFrobeniusNorm(maxNorm, *norm.m_CPUMatrix),
+                            m_GPUMatrix->ClipFrobeniusNorm(maxNorm, *norm.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignOneHotIndicesOf(const Matrix<ElemType>& oneHot)
+{
+    if (oneHot.GetMatrixType() != SPARSE || oneHot.GetFormat() != matrixFormatSparseCSC)
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(DENSE, matrixFormatDense, false);
+    TransferToDeviceIfNotThere(oneHot.GetDeviceId(), true, true);
+
+    DISPATCH_MATRIX_ON_FLAG(&oneHot,
+                            this,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            oneHot.m_CPUSparseMatrix->CopyOneHotIndicesTo(*m_CPUMatrix),
+                            oneHot.m_GPUSparseMatrix->CopyOneHotIndicesTo(*m_GPUMatrix));
+
+    return *this;
+}
+
 template <class ElemType>
 ElemType Matrix<ElemType>::MatrixNormInf() const
 {
@@ -3544,6 +3933,155 @@ void Matrix<ElemType>::DecideAndMoveToRightDevice(const Matrix<ElemType>& a, con
     d._transferToDevice(a.GetDeviceId()); // BUGBUG: Is this correct in case a,b,c share the same preferredDevice?
 }
 
+// -----------------------------------------------------------------------
+// MatrixTransferMonitor
+// -----------------------------------------------------------------------
+
+namespace
+{
+const size_t transferCallSiteDepth = 4; // callers recorded per transfer
+
+struct TransferKey
+{
+    std::wstring owner; // node, or empty outside of nodes
+    const char* phase;
+    bool isImplicit;
+    int fromId, toId;
+    std::array<void*, transferCallSiteDepth> callSite;
+    bool operator<(const TransferKey& other) const
+    {
+        return std::tie(owner, phase, isImplicit, fromId, toId, callSite) < std::tie(other.owner, other.phase, other.isImplicit, other.fromId, other.toId, other.callSite);
+    }
+};
+
+struct TransferStats
+{
+    size_t count = 0;
+    size_t bytes = 0;
+};
+
+std::atomic<int> s_transferMonitorMode(0); // (a MatrixTransferMonitor::Mode)
+std::mutex s_transferStatsMutex;
+std::map<TransferKey, TransferStats> s_transferStats;
+thread_local const std::wstring* t_transferOwner = nullptr;
+thread_local const char* t_transferPhase = "";
+
+std::string DeviceName(int deviceId)
+{
+    return deviceId < 0 ? std::string("CPU") : msra::strfun::strprintf("GPU%d", deviceId);
+}
+}
+
+/*static*/ MatrixTransferMonitor::Mode MatrixTransferMonitor::ParseMode(const std::wstring& s)
+{
+    if (s == L"off" || s.empty())
+        return Mode::off;
+    else if (s == L"count")
+        return Mode::count;
+    else if (s == L"strict")
+        return Mode::strict;
+    InvalidArgument("MatrixTransferMonitor: Invalid mode '%ls'. Valid values are off, count, and strict.", s.c_str());
+}
+
+/*static*/ void MatrixTransferMonitor::SetMode(Mode mode)
+{
+    s_transferMonitorMode = (int) mode;
+}
+
+/*static*/ MatrixTransferMonitor::Mode MatrixTransferMonitor::GetMode()
+{
+    return (Mode) s_transferMonitorMode.load(std::memory_order_relaxed);
+}
+
+MatrixTransferMonitor::Scope::Scope(const std::wstring& owner, const char* phase)
+    : m_prevOwner(t_transferOwner), m_prevPhase(t_transferPhase)
+{
+    t_transferOwner = &owner;
+    t_transferPhase = phase;
+}
+
+MatrixTransferMonitor::Scope::~Scope()
+{
+    t_transferOwner = m_prevOwner;
+    t_transferPhase = m_prevPhase;
+}
+
+/*static*/ void MatrixTransferMonitor::Record(bool isImplicit, int fromId, int toId, size_t bytes, size_t rows, size_t cols)
+{
+    TransferKey key;
+    key.owner = t_transferOwner ? *t_transferOwner : std::wstring();
+    key.phase = t_transferPhase;
+    key.isImplicit = isImplicit;
+    key.fromId = fromId;
+    key.toId = toId;
+    key.callSite.fill(nullptr);
+    DebugUtil::CaptureCallStack(key.callSite.data(), transferCallSiteDepth, 3 /*Record(), RecordTransfer(), and the Matrix function that transfers*/);
+    {
+        std::lock_guard<std::mutex> lock(s_transferStatsMutex);
+        auto& stats = s_transferStats[key];
+        stats.count++;
+        stats.bytes += bytes;
+    }
+    if (isImplicit && t_transferOwner && GetMode() == Mode::strict)
+        RuntimeError("MatrixTransferMonitor: implicit transfer of a %d x %d matrix from %s to %s in %ls (%s).",
+                     (int) rows, (int) cols, DeviceName(fromId).c_str(), DeviceName(toId).c_str(), t_transferOwner->c_str(), t_transferPhase);
+}
+
+/*static*/ void MatrixTransferMonitor::Report(const char* what, size_t maxEntries)
+{
+    std::vector<std::pair<TransferKey, TransferStats>> entries;
+    {
+        std::lock_guard<std::mutex> lock(s_transferStatsMutex);
+        entries.assign(s_transferStats.begin(), s_transferStats.end());
+        s_transferStats.clear();
+    }
+    size_t total[2][2] = {{0, 0}, {0, 0}}; // [isImplicit][count, bytes]
+    for (const auto& entry : entries)
+    {
+        total[entry.first.isImplicit][0] += entry.second.count;
+        total[entry.first.isImplicit][1] += entry.second.bytes;
+    }
+    fprintf(stderr, "MatrixTransferMonitor %s: %d implicit transfers (%.1f MB), %d explicit transfers (%.1f MB)\n", what,
+            (int) total[1][0], total[1][1] / 1e6, (int) total[0][0], total[0][1] / 1e6);
+    std::sort(entries.begin(), entries.end(), [](const std::pair<TransferKey, TransferStats>& a, const std::pair<TransferKey, TransferStats>& b)
+    {
+        return a.first.isImplicit != b.first.isImplicit ? a.first.isImplicit : a.second.bytes > b.second.bytes;
+    });
+    for (size_t i = 0; i < entries.size() && i < maxEntries; i++)
+    {
+        const auto& key = entries[i].first;
+        const auto& stats = entries[i].second;
+        fprintf(stderr, "    %s %s->%s: %d times, %.3f MB, in %ls%s%s%s, at",
+                key.isImplicit ? "implicit" : "explicit", DeviceName(key.fromId).c_str(), DeviceName(key.toId).c_str(), (int) stats.count, stats.bytes / 1e6,
+                key.owner.empty() ? L"(no node)" : key.owner.c_str(), *key.phase ? " (" : "", key.phase, *key.phase ? ")" : "");
+        for (size_t k = 0; k < transferCallSiteDepth && key.callSite[k]; k++)
+            fprintf(stderr, "%s %s", k > 0 ? " <-" : "", DebugUtil::FunctionName(key.callSite[k]).c_str());
+        fprintf(stderr, "\n");
+    }
+    if (entries.size() > maxEntries)
+        fprintf(stderr, "    ... and %d more\n", (int) (entries.size() - maxEntries));
+}
+
+template <class ElemType>
+void Matrix<ElemType>::RecordTransfer(int from_id, int to_id, bool emptyTransfer, bool isImplicit) const
+{
+    if (from_id < 0)
+        from_id = CPUDEVICE;
+    if (to_id < 0)
+        to_id = CPUDEVICE;
+    if (from_id == to_id)
+        return;
+    size_t bytes = 0;
+    if (!emptyTransfer)
+    {
+        if (m_matrixType == MatrixType::SPARSE)
+            bytes = from_id == CPUDEVICE ? (m_CPUSparseMatrix ? m_CPUSparseMatrix->BufferSize() : 0) : (m_GPUSparseMatrix ? m_GPUSparseMatrix->BufferSizeAllocated() : 0);
+        else
+            bytes = GetNumElements() * sizeof(ElemType);
+    }
+    MatrixTransferMonitor::Record(isImplicit, from_id, to_id, bytes, GetNumRows(), GetNumCols());
+}
+
 template <class ElemType>
 void Matrix<ElemType>::_transferToDevice(int to_id, bool ismoved, bool emptyTransfer) const
 {
@@ -3551,6 +4089,8 @@ void Matrix<ElemType>::_transferToDevice(int to_id, bool ismoved, bool emptyTran
     if (to_id == from_id) // nothing to do
         return;
 
+    if (MatrixTransferMonitor::IsEnabled())
+        RecordTransfer(from_id, to_id, emptyTransfer, true /*isImplicit*/);
     if (OwnBuffer())
         _transferFromDeviceToDevice(from_id, to_id, ismoved, emptyTransfer);
     else
@@ -3723,6 +4263,8 @@ void Matrix<ElemType>::_transferFromDeviceToDevice(int from_id, int to_id, bool
 template <class ElemType>
 void Matrix<ElemType>::TransferFromDeviceToDevice(int from_id, int to_id, bool ismoved, bool emptyTransfer, bool updatePreferredDevice) const
 {
+    if (MatrixTransferMonitor::IsEnabled())
+        RecordTransfer(from_id, to_id, emptyTransfer, false /*isImplicit*/);
     _transferFromDeviceToDevice(from_id, to_id, ismoved, emptyTransfer);
     if (updatePreferredDevice)
         m_preferredDeviceId = GetDeviceId();
@@ -4034,6 +4576,104 @@ void Matrix<ElemType>::SVD(const Matrix<ElemType>& A, Matrix<ElemType>& SIGMA, M
                             NOT_IMPLEMENTED);
 }
 
+// eigendecomposition of the symmetric positive semidefinite [l x l] matrix G = V*diag(lambda)*V' (as its SVD), on the CPU,
+// with V returned on G's device
+template <class ElemType>
+static void SymmetricEigen(const Matrix<ElemType>& G, Matrix<ElemType>& lambda, Matrix<ElemType>& V)
+{
+    const DEVICEID_TYPE deviceId = G.GetDeviceId();
+    Matrix<ElemType> hostG(G.GetNumRows(), G.GetNumCols(), CPUDEVICE);
+    if (deviceId >= 0)
+        G.CopySection(G.GetNumRows(), G.GetNumCols(), hostG.BufferPointer(), G.GetNumRows());
+    else
+        hostG.SetValue(G);
+    Matrix<ElemType> VT(CPUDEVICE), W(CPUDEVICE);
+    lambda.TransferToDeviceIfNotThere(CPUDEVICE, true);
+    V.TransferToDeviceIfNotThere(CPUDEVICE, true);
+    Matrix<ElemType>::SVD(hostG, lambda, V, VT, W);
+    V.TransferToDeviceIfNotThere(deviceId, true);
+}
+
+// orthonormalize the columns of Y with the eigendecomposition of Y'Y (Cholesky-QR, with the decomposition of the small Gram
+// matrix in place of the Cholesky factorization, which copes with rank deficiency); twice, since one pass leaves an error
+// that grows with the square of the condition number
+template <class ElemType>
+static void OrthonormalizeColumns(Matrix<ElemType>& Y)
+{
+    const DEVICEID_TYPE deviceId = Y.GetDeviceId();
+    for (int pass = 0; pass < 2; pass++)
+    {
+        Matrix<ElemType> gram(deviceId), lambda(CPUDEVICE), V(deviceId), Q(deviceId);
+        Matrix<ElemType>::Multiply(Y, true, Y, false, gram);
+        SymmetricEigen(gram, lambda, V);
+        // scale the eigenvectors by 1/sqrt(lambda); directions Y does not span are dropped
+        const double threshold = max((double) lambda(0, 0), 0.0) * std::numeric_limits<ElemType>::epsilon() * Y.GetNumCols();
+        Matrix<ElemType> scale(lambda.GetNumRows(), 1, CPUDEVICE);
+        for (size_t j = 0; j < lambda.GetNumRows(); j++)
+            scale(j, 0) = lambda(j, 0) > threshold ? (ElemType)(1 / sqrt((double) lambda(j, 0))) : 0;
+        scale.TransferToDeviceIfNotThere(deviceId, true);
+        V.RowElementMultiplyWith(scale.Transpose());
+        Matrix<ElemType>::Multiply(Y, false, V, false, Q);
+        Y = std::move(Q);
+    }
+}
+
+// Halko, Martinsson, Tropp: an orthonormal basis Y of the range of A*Omega, Omega Gaussian [n x l], refined by power iterations
+// for spectra that decay slowly; then the SVD of the small Y'*A, through the eigendecomposition of its Gram matrix. Since that
+// squares the condition number, singular values far below the first (about sqrt(epsilon) of it) are inaccurate, which does not
+// matter for the leading ones this is for.
+template <class ElemType>
+void Matrix<ElemType>::RandomizedSVD(const Matrix<ElemType>& A, const size_t rank, const size_t oversampling, const size_t powerIterations, unsigned long seed,
+                                     Matrix<ElemType>& SIGMA, Matrix<ElemType>& U, Matrix<ElemType>& VT)
+{
+    if (A.IsEmpty())
+        LogicError("RandomizedSVD: the input matrix is empty.");
+    if (A.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    const DEVICEID_TYPE deviceId = A.GetDeviceId();
+    const size_t m = A.GetNumRows();
+    const size_t n = A.GetNumCols();
+    const size_t l = min(rank + oversampling, min(m, n));
+    const size_t k = min(rank, l);
+
+    Matrix<ElemType> Y(deviceId), Z(deviceId);
+    Matrix<ElemType>::Multiply(A, false, Matrix<ElemType>::RandomGaussian(n, l, 0, 1, seed, deviceId), false, Y);
+    OrthonormalizeColumns(Y);
+    for (size_t q = 0; q < powerIterations; q++)
+    {
+        Matrix<ElemType>::Multiply(A, true, Y, false, Z);
+        OrthonormalizeColumns(Z);
+        Matrix<ElemType>::Multiply(A, false, Z, false, Y);
+        OrthonormalizeColumns(Y);
+    }
+
+    // B = Y'A = Ub*diag(sigma)*Vb', with B*B' = Ub*diag(sigma^2)*Ub'
+    Matrix<ElemType> B(deviceId), gram(deviceId), lambda(CPUDEVICE), Ub(deviceId);
+    Matrix<ElemType>::Multiply(Y, true, A, false, B);
+    Matrix<ElemType>::Multiply(B, false, B, true, gram);
+    SymmetricEigen(gram, lambda, Ub);
+    Matrix<ElemType> leadingUb = Ub.ColumnSlice(0, k);
+
+    SIGMA.TransferToDeviceIfNotThere(CPUDEVICE, true);
+    SIGMA.SwitchToMatrixType(DENSE, matrixFormatDense, false);
+    SIGMA.Resize(k, 1);
+    Matrix<ElemType> inverseSigma(k, 1, CPUDEVICE);
+    for (size_t j = 0; j < k; j++)
+    {
+        SIGMA(j, 0) = (ElemType) sqrt(max((double) lambda(j, 0), 0.0));
+        inverseSigma(j, 0) = SIGMA(j, 0) > 0 ? 1 / SIGMA(j, 0) : 0;
+    }
+    inverseSigma.TransferToDeviceIfNotThere(deviceId, true);
+
+    // U = Y*Ub, VT = diag(1/sigma)*Ub'*B
+    U.TransferToDeviceIfNotThere(deviceId, true);
+    VT.TransferToDeviceIfNotThere(deviceId, true);
+    Matrix<ElemType>::Multiply(Y, false, leadingUb, false, U);
+    Matrix<ElemType>::Multiply(leadingUb, true, B, false, VT);
+    VT.ColumnElementMultiplyWith(inverseSigma);
+}
+
 /// <summary>Matrix-matrix multiply with col-major matrices (a and b may be transposed): c = alpha * op(a) * op(b) + beta*c</summary>
 /// <param name="alpha">Scalar</param>
 /// <param name="a">Input matrix</param>
@@ -4051,8 +4691,14 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
     if (c.GetDeviceId() < 0) // CPU
     {
         if (a.GetMatrixType() == MatrixType::SPARSE)
-            NOT_IMPLEMENTED;
-        if (b.GetMatrixType() == MatrixType::SPARSE)
+        {
+            if (b.GetMatrixType() == MatrixType::SPARSE)
+                NOT_IMPLEMENTED;
+            c.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+            CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_CPUSparseMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix);
+            c.SetDataLocation(CPU, DENSE);
+        }
+        else if (b.GetMatrixType() == MatrixType::SPARSE)
         {
             if (c.GetMatrixType() == MatrixType::DENSE)
             {
@@ -4165,6 +4811,30 @@ template <class ElemType>
                             NOT_IMPLEMENTED);
 }
 
+/// <summary>Batch of equally shaped matrix-matrix multiplies: c_i = alpha * op(a_i) * op(b_i) + beta * c_i, i < batchSize</summary>
+/// <param name="a">Input matrix: batchSize column blocks a_i side by side, or a single block shared by all products</param>
+/// <param name="transposeA">Whether the blocks of a are transposed</param>
+/// <param name="b">Input matrix: batchSize column blocks b_i side by side, or a single block shared by all products</param>
+/// <param name="transposeB">Whether the blocks of b are transposed</param>
+/// <param name="beta">Weight of the original c</param>
+/// <param name="c">batchSize column blocks c_i side by side; must have its final size, also if beta is 0</param>
+/// <param name="batchSize">Number of products</param>
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::BatchMultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB,
+                                                              ElemType beta, Matrix<ElemType>& c, size_t batchSize)
+{
+    DecideAndMoveToRightDevice(a, b, c);
+    if (a.GetMatrixType() != MatrixType::DENSE || b.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&c,
+                            &c,
+                            CPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(alpha, *a.m_CPUMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix, batchSize),
+                            GPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(alpha, *a.m_GPUMatrix, transposeA, *b.m_GPUMatrix, transposeB, beta, *c.m_GPUMatrix, batchSize),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 /// <summary>Matrix-matrix multiply with col-major matrices (a and b may be transposed): c =  op(a) * op(b) + c</summary>
 /// <param name="a">Input matrix</param>
 /// <param name="transposeA">Whether matrix a is transposed</param>
@@ -4429,6 +5099,122 @@ void Matrix<ElemType>::AssignScaledDifference(const Matrix<ElemType>& alpha, con
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::SoftmaxCrossEntropy(const Matrix<ElemType>& labels, const Matrix<ElemType>& prediction, Matrix<ElemType>& columnStats)
+{
+    if (prediction.IsEmpty())
+        LogicError("SoftmaxCrossEntropy: Matrix is empty.");
+    if ((labels.GetNumRows() != prediction.GetNumRows() && labels.GetNumRows() != 1) || labels.GetNumCols() != prediction.GetNumCols())
+        InvalidArgument("SoftmaxCrossEntropy: The input matrix dimensions do not match.");
+
+    DecideAndMoveToRightDevice(labels, prediction, columnStats);
+    if (labels.GetMatrixType() != DENSE || prediction.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+    columnStats.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&columnStats,
+                            &columnStats,
+                            CPUMatrix<ElemType>::SoftmaxCrossEntropy(*labels.m_CPUMatrix, *prediction.m_CPUMatrix, *columnStats.m_CPUMatrix),
+                            GPUMatrix<ElemType>::SoftmaxCrossEntropy(*labels.m_GPUMatrix, *prediction.m_GPUMatrix, *columnStats.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::SoftmaxCrossEntropyBackprop(const Matrix<ElemType>& alpha, const Matrix<ElemType>& labels, const Matrix<ElemType>& prediction,
+                                                             const Matrix<ElemType>& columnStats, Matrix<ElemType>& predictionGradient)
+{
+    if ((labels.GetNumRows() != prediction.GetNumRows() && labels.GetNumRows() != 1) || labels.GetNumCols() != prediction.GetNumCols() ||
+        predictionGradient.GetNumRows() != prediction.GetNumRows() || predictionGradient.GetNumCols() != prediction.GetNumCols() ||
+        columnStats.GetNumRows() != prediction.GetNumCols() || columnStats.GetNumCols() != 3)
+        InvalidArgument("SoftmaxCrossEntropyBackprop: The input matrix dimensions do not match.");
+
+    DecideAndMoveToRightDevice(predictionGradient, labels, prediction, columnStats);
+    alpha._transferToDevice(predictionGradient.GetDeviceId());
+    if (labels.GetMatrixType() != DENSE || prediction.GetMatrixType() != DENSE || predictionGradient.GetMatrixType() != DENSE || alpha.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&predictionGradient,
+                            &predictionGradient,
+                            CPUMatrix<ElemType>::SoftmaxCrossEntropyBackprop(*alpha.m_CPUMatrix, *labels.m_CPUMatrix, *prediction.m_CPUMatrix, *columnStats.m_CPUMatrix, *predictionGradient.m_CPUMatrix),
+                            GPUMatrix<ElemType>::SoftmaxCrossEntropyBackprop(*alpha.m_GPUMatrix, *labels.m_GPUMatrix, *prediction.m_GPUMatrix, *columnStats.m_GPUMatrix, *predictionGradient.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::HierarchicalSoftmax(const Matrix<ElemType>& labels, const Matrix<ElemType>& hidden, const Matrix<ElemType>& weights, const Matrix<ElemType>& paths,
+                                                     Matrix<ElemType>& frameLosses, Matrix<ElemType>& pathGradients)
+{
+    if (labels.GetNumRows() != 1 || labels.GetNumCols() != hidden.GetNumCols() || weights.GetNumRows() != hidden.GetNumRows() ||
+        paths.GetNumRows() % 2 != 0 || paths.GetNumCols() != weights.GetNumCols() + 1)
+        InvalidArgument("HierarchicalSoftmax: The input matrix dimensions do not match.");
+
+    DecideAndMoveToRightDevice(hidden, weights, frameLosses);
+    labels._transferToDevice(hidden.GetDeviceId());
+    paths._transferToDevice(hidden.GetDeviceId());
+    pathGradients._transferToDevice(hidden.GetDeviceId(), true, true);
+    if (labels.GetMatrixType() != DENSE || hidden.GetMatrixType() != DENSE || weights.GetMatrixType() != DENSE || paths.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+    frameLosses.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    pathGradients.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&hidden,
+                            &frameLosses,
+                            CPUMatrix<ElemType>::HierarchicalSoftmax(*labels.m_CPUMatrix, *hidden.m_CPUMatrix, *weights.m_CPUMatrix, *paths.m_CPUMatrix, *frameLosses.m_CPUMatrix, *pathGradients.m_CPUMatrix);
+                            pathGradients.SetDataLocation(CPU, DENSE),
+                            GPUMatrix<ElemType>::HierarchicalSoftmax(*labels.m_GPUMatrix, *hidden.m_GPUMatrix, *weights.m_GPUMatrix, *paths.m_GPUMatrix, *frameLosses.m_GPUMatrix, *pathGradients.m_GPUMatrix);
+                            pathGradients.SetDataLocation(GPU, DENSE),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::HierarchicalSoftmaxBackpropHidden(const Matrix<ElemType>& alpha, const Matrix<ElemType>& labels, const Matrix<ElemType>& weights, const Matrix<ElemType>& paths,
+                                                                   const Matrix<ElemType>& pathGradients, Matrix<ElemType>& hiddenGradient)
+{
+    if (labels.GetNumCols() != hiddenGradient.GetNumCols() || weights.GetNumRows() != hiddenGradient.GetNumRows() ||
+        pathGradients.GetNumRows() * 2 != paths.GetNumRows() || pathGradients.GetNumCols() != hiddenGradient.GetNumCols())
+        InvalidArgument("HierarchicalSoftmaxBackpropHidden: The input matrix dimensions do not match.");
+
+    DecideAndMoveToRightDevice(hiddenGradient, weights, pathGradients);
+    alpha._transferToDevice(hiddenGradient.GetDeviceId());
+    labels._transferToDevice(hiddenGradient.GetDeviceId());
+    paths._transferToDevice(hiddenGradient.GetDeviceId());
+    if (hiddenGradient.GetMatrixType() != DENSE || weights.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&hiddenGradient,
+                            &hiddenGradient,
+                            CPUMatrix<ElemType>::HierarchicalSoftmaxBackpropHidden(*alpha.m_CPUMatrix, *labels.m_CPUMatrix, *weights.m_CPUMatrix, *paths.m_CPUMatrix, *pathGradients.m_CPUMatrix, *hiddenGradient.m_CPUMatrix),
+                            GPUMatrix<ElemType>::HierarchicalSoftmaxBackpropHidden(*alpha.m_GPUMatrix, *labels.m_GPUMatrix, *weights.m_GPUMatrix, *paths.m_GPUMatrix, *pathGradients.m_GPUMatrix, *hiddenGradient.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::HierarchicalSoftmaxBackpropWeights(const Matrix<ElemType>& alpha, const Matrix<ElemType>& labels, const Matrix<ElemType>& hidden, const Matrix<ElemType>& paths,
+                                                                    const Matrix<ElemType>& pathGradients, Matrix<ElemType>& weightsGradient)
+{
+    if (labels.GetNumCols() != hidden.GetNumCols() || weightsGradient.GetNumRows() != hidden.GetNumRows() || paths.GetNumCols() != weightsGradient.GetNumCols() + 1 ||
+        pathGradients.GetNumRows() * 2 != paths.GetNumRows() || pathGradients.GetNumCols() != hidden.GetNumCols())
+        InvalidArgument("HierarchicalSoftmaxBackpropWeights: The input matrix dimensions do not match.");
+
+    DecideAndMoveToRightDevice(weightsGradient, hidden, pathGradients);
+    alpha._transferToDevice(weightsGradient.GetDeviceId());
+    labels._transferToDevice(weightsGradient.GetDeviceId());
+    paths._transferToDevice(weightsGradient.GetDeviceId());
+    if (weightsGradient.GetMatrixType() != DENSE || hidden.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&weightsGradient,
+                            &weightsGradient,
+                            CPUMatrix<ElemType>::HierarchicalSoftmaxBackpropWeights(*alpha.m_CPUMatrix, *labels.m_CPUMatrix, *hidden.m_CPUMatrix, *paths.m_CPUMatrix, *pathGradients.m_CPUMatrix, *weightsGradient.m_CPUMatrix),
+                            GPUMatrix<ElemType>::HierarchicalSoftmaxBackpropWeights(*alpha.m_GPUMatrix, *labels.m_GPUMatrix, *hidden.m_GPUMatrix, *paths.m_GPUMatrix, *pathGradients.m_GPUMatrix, *weightsGradient.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 //c[ci,cj] += a[ai,aj]
 template <class ElemType>
 void Matrix<ElemType>::AddElementToElement(const Matrix<ElemType>& a, const size_t ai, const size_t aj, Matrix<ElemType>& c, const size_t ci, const size_t cj)
@@ -4929,6 +5715,73 @@ Matrix<ElemType>& Matrix<ElemType>::AssignElementProductOfWithShift(const Matrix
     return *this;
 }
 
+// [this](0, j) = cos(a(:, j), b(:, j)) and [this](i, j) = cos(a(:, j), b(:, (j + shift + i - 1) % n)) for i in [1, negnumber],
+// i.e. AssignElementProductOfWithShiftNeg(invNormA, invNormB) .* AssignInnerProductOfWithShiftNeg(a, b) in one pass,
+// where the shifted columns of b are picked by index instead of being copied
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignCosDistanceWithShiftNeg(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB, size_t shift, size_t negnumber)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AssignCosDistanceWithShiftNeg: Matrix is empty.");
+
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols())
+        InvalidArgument("AssignCosDistanceWithShiftNeg: The input matrix dimensions do not match.");
+
+    if (invNormA.GetNumRows() != 1 || invNormA.GetNumCols() != a.GetNumCols() || invNormB.GetNumRows() != 1 || invNormB.GetNumCols() != b.GetNumCols())
+        InvalidArgument("AssignCosDistanceWithShiftNeg: The inverse norms must be row vectors with one element per column.");
+
+    DecideAndMoveToRightDevice(a, b, *this);
+    invNormA._transferToDevice(a.GetDeviceId());
+    invNormB._transferToDevice(a.GetDeviceId());
+    if (!(a.GetMatrixType() == b.GetMatrixType()))
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(a.GetMatrixType(), a.GetFormat(), false);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AssignCosDistanceWithShiftNeg(*a.m_CPUMatrix, *b.m_CPUMatrix, *invNormA.m_CPUMatrix, *invNormB.m_CPUMatrix, shift, negnumber),
+                            m_GPUMatrix->AssignCosDistanceWithShiftNeg(*a.m_GPUMatrix, *b.m_GPUMatrix, *invNormA.m_GPUMatrix, *invNormB.m_GPUMatrix, shift, negnumber),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+// the backprop of AssignCosDistanceWithShiftNeg() into a or b, for all negnumber+1 rows of the gradient at once
+// With s = the shift of row i and c = cosDistance(i, j), column j of a gets
+//   gradient(i, j) * (invNormA(j) * invNormB(j + s) * b(:, j + s) - c * invNormA(j)^2 * a(:, j))
+// and column j + s of b gets
+//   gradient(i, j) * (invNormA(j) * invNormB(j + s) * a(:, j) - c * invNormB(j + s)^2 * b(:, j + s)).
+// Every column of the result gathers its negnumber+1 terms, so there is nothing to shift back and no temporaries.
+template <class ElemType>
+void Matrix<ElemType>::AddCosDistanceWithShiftNegGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& cosDistance, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB, size_t shift, size_t negnumber, bool wrtB, Matrix<ElemType>& inputGradient)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AddCosDistanceWithShiftNegGradient: Matrix is empty.");
+
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols() ||
+        inputGradient.GetNumRows() != a.GetNumRows() || inputGradient.GetNumCols() != a.GetNumCols())
+        InvalidArgument("AddCosDistanceWithShiftNegGradient: The input matrix dimensions do not match.");
+
+    if (gradient.GetNumRows() != negnumber + 1 || gradient.GetNumCols() != a.GetNumCols() ||
+        cosDistance.GetNumRows() != negnumber + 1 || cosDistance.GetNumCols() != a.GetNumCols())
+        InvalidArgument("AddCosDistanceWithShiftNegGradient: The gradient and the cosine distances must have negnumber+1 rows and one column per sample.");
+
+    DecideAndMoveToRightDevice(gradient, a, b, inputGradient);
+    cosDistance._transferToDevice(a.GetDeviceId());
+    invNormA._transferToDevice(a.GetDeviceId());
+    invNormB._transferToDevice(a.GetDeviceId());
+    if (a.GetMatrixType() != b.GetMatrixType() || a.GetMatrixType() != inputGradient.GetMatrixType())
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&inputGradient,
+                            nullptr,
+                            CPUMatrix<ElemType>::AddCosDistanceWithShiftNegGradient(*gradient.m_CPUMatrix, *cosDistance.m_CPUMatrix, *a.m_CPUMatrix, *b.m_CPUMatrix, *invNormA.m_CPUMatrix, *invNormB.m_CPUMatrix, shift, negnumber, wrtB, *inputGradient.m_CPUMatrix),
+                            GPUMatrix<ElemType>::AddCosDistanceWithShiftNegGradient(*gradient.m_GPUMatrix, *cosDistance.m_GPUMatrix, *a.m_GPUMatrix, *b.m_GPUMatrix, *invNormA.m_GPUMatrix, *invNormB.m_GPUMatrix, shift, negnumber, wrtB, *inputGradient.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::RCRFBackwardCompute(const Matrix<ElemType>& alpha, Matrix<ElemType>& beta,
                                            Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls,
@@ -4987,6 +5840,183 @@ void Matrix<ElemType>::RCRFTransGrdCompute(const Matrix<ElemType>& lbls,
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::CRFForwardBackward(const Matrix<ElemType>& labels, const Matrix<ElemType>& posScores, const Matrix<ElemType>& pairScores,
+                                          Matrix<ElemType>& alpha, Matrix<ElemType>& beta, Matrix<ElemType>& sequenceScores,
+                                          const Matrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    DecideAndMoveToRightDevice(posScores, pairScores, labels, sequences);
+    alpha._transferToDevice(posScores.GetDeviceId());
+    beta._transferToDevice(posScores.GetDeviceId());
+    sequenceScores._transferToDevice(posScores.GetDeviceId());
+
+    if (labels.GetMatrixType() != DENSE || pairScores.GetMatrixType() != DENSE || sequences.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&posScores,
+                            &alpha,
+                            CPUMatrix<ElemType>::CRFForwardBackward(*labels.m_CPUMatrix, *posScores.m_CPUMatrix, *pairScores.m_CPUMatrix,
+                                                                    *alpha.m_CPUMatrix, *beta.m_CPUMatrix, *sequenceScores.m_CPUMatrix,
+                                                                    *sequences.m_CPUMatrix, numParallelSequences),
+                            GPUMatrix<ElemType>::CRFForwardBackward(*labels.m_GPUMatrix, *posScores.m_GPUMatrix, *pairScores.m_GPUMatrix,
+                                                                    *alpha.m_GPUMatrix, *beta.m_GPUMatrix, *sequenceScores.m_GPUMatrix,
+                                                                    *sequences.m_GPUMatrix, numParallelSequences),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::CRFTransitionGradient(const Matrix<ElemType>& labels, const Matrix<ElemType>& posScores, const Matrix<ElemType>& pairScores,
+                                             const Matrix<ElemType>& alpha, const Matrix<ElemType>& beta, Matrix<ElemType>& grd,
+                                             const Matrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    DecideAndMoveToRightDevice(posScores, pairScores, labels, sequences);
+    alpha._transferToDevice(posScores.GetDeviceId());
+    beta._transferToDevice(posScores.GetDeviceId());
+    grd._transferToDevice(posScores.GetDeviceId());
+
+    if (labels.GetMatrixType() != DENSE || pairScores.GetMatrixType() != DENSE || sequences.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&posScores,
+                            &grd,
+                            CPUMatrix<ElemType>::CRFTransitionGradient(*labels.m_CPUMatrix, *posScores.m_CPUMatrix, *pairScores.m_CPUMatrix,
+                                                                       *alpha.m_CPUMatrix, *beta.m_CPUMatrix, *grd.m_CPUMatrix,
+                                                                       *sequences.m_CPUMatrix, numParallelSequences),
+                            GPUMatrix<ElemType>::CRFTransitionGradient(*labels.m_GPUMatrix, *posScores.m_GPUMatrix, *pairScores.m_GPUMatrix,
+                                                                       *alpha.m_GPUMatrix, *beta.m_GPUMatrix, *grd.m_GPUMatrix,
+                                                                       *sequences.m_GPUMatrix, numParallelSequences),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::ViterbiDecode(const Matrix<ElemType>& labels, const Matrix<ElemType>& posScores, const Matrix<ElemType>& pairScores,
+                                     Matrix<ElemType>& alpha, Matrix<ElemType>& backtrace, Matrix<ElemType>& decodedPath,
+                                     const Matrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    DecideAndMoveToRightDevice(posScores, pairScores, labels, sequences);
+    alpha._transferToDevice(posScores.GetDeviceId());
+    backtrace._transferToDevice(posScores.GetDeviceId());
+    decodedPath._transferToDevice(posScores.GetDeviceId());
+
+    if (labels.GetMatrixType() != DENSE || pairScores.GetMatrixType() != DENSE || sequences.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&posScores,
+                            &decodedPath,
+                            CPUMatrix<ElemType>::ViterbiDecode(*labels.m_CPUMatrix, *posScores.m_CPUMatrix, *pairScores.m_CPUMatrix,
+                                                               *alpha.m_CPUMatrix, *backtrace.m_CPUMatrix, *decodedPath.m_CPUMatrix,
+                                                               *sequences.m_CPUMatrix, numParallelSequences),
+                            GPUMatrix<ElemType>::ViterbiDecode(*labels.m_GPUMatrix, *posScores.m_GPUMatrix, *pairScores.m_GPUMatrix,
+                                                               *alpha.m_GPUMatrix, *backtrace.m_GPUMatrix, *decodedPath.m_GPUMatrix,
+                                                               *sequences.m_GPUMatrix, numParallelSequences),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::DenominatorForwardBackward(const Matrix<ElemType>& logLikelihoods, const Matrix<ElemType>& arcs, const Matrix<ElemType>& states,
+                                                  Matrix<ElemType>& alpha, Matrix<ElemType>& beta, Matrix<ElemType>& posteriors, Matrix<ElemType>& logDenominators,
+                                                  const Matrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+    DecideAndMoveToRightDevice(logLikelihoods, arcs, states, sequences);
+    alpha._transferToDevice(logLikelihoods.GetDeviceId());
+    beta._transferToDevice(logLikelihoods.GetDeviceId());
+    posteriors._transferToDevice(logLikelihoods.GetDeviceId());
+    logDenominators._transferToDevice(logLikelihoods.GetDeviceId());
+
+    if (logLikelihoods.GetMatrixType() != DENSE || arcs.GetMatrixType() != DENSE || states.GetMatrixType() != DENSE || sequences.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&logLikelihoods,
+                            &posteriors,
+                            CPUMatrix<ElemType>::DenominatorForwardBackward(*logLikelihoods.m_CPUMatrix, *arcs.m_CPUMatrix, *states.m_CPUMatrix,
+                                                                            *alpha.m_CPUMatrix, *beta.m_CPUMatrix, *posteriors.m_CPUMatrix, *logDenominators.m_CPUMatrix,
+                                                                            *sequences.m_CPUMatrix, numParallelSequences),
+                            GPUMatrix<ElemType>::DenominatorForwardBackward(*logLikelihoods.m_GPUMatrix, *arcs.m_GPUMatrix, *states.m_GPUMatrix,
+                                                                            *alpha.m_GPUMatrix, *beta.m_GPUMatrix, *posteriors.m_GPUMatrix, *logDenominators.m_GPUMatrix,
+                                                                            *sequences.m_GPUMatrix, numParallelSequences),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::ClassConditionalLogSoftmax(const Matrix<ElemType>& hidden, const Matrix<ElemType>& weights, const Matrix<ElemType>& frames, const size_t totalNumWords,
+                                                  Matrix<ElemType>& logSoftmax, Matrix<ElemType>& targetLogProbs)
+{
+    DecideAndMoveToRightDevice(hidden, weights, frames);
+    logSoftmax._transferToDevice(hidden.GetDeviceId());
+    targetLogProbs._transferToDevice(hidden.GetDeviceId());
+
+    if (hidden.GetMatrixType() != DENSE || weights.GetMatrixType() != DENSE || frames.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&hidden,
+                            &logSoftmax,
+                            CPUMatrix<ElemType>::ClassConditionalLogSoftmax(*hidden.m_CPUMatrix, *weights.m_CPUMatrix, *frames.m_CPUMatrix, totalNumWords,
+                                                                            *logSoftmax.m_CPUMatrix, *targetLogProbs.m_CPUMatrix),
+                            GPUMatrix<ElemType>::ClassConditionalLogSoftmax(*hidden.m_GPUMatrix, *weights.m_GPUMatrix, *frames.m_GPUMatrix, totalNumWords,
+                                                                            *logSoftmax.m_GPUMatrix, *targetLogProbs.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::ClassConditionalSoftmaxGradient(const Matrix<ElemType>& logSoftmax, const Matrix<ElemType>& gradient, const Matrix<ElemType>& frames,
+                                                       Matrix<ElemType>& grd)
+{
+    DecideAndMoveToRightDevice(logSoftmax, gradient, frames);
+    grd._transferToDevice(logSoftmax.GetDeviceId());
+
+    if (logSoftmax.GetMatrixType() != DENSE || gradient.GetMatrixType() != DENSE || frames.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&logSoftmax,
+                            &grd,
+                            CPUMatrix<ElemType>::ClassConditionalSoftmaxGradient(*logSoftmax.m_CPUMatrix, *gradient.m_CPUMatrix, *frames.m_CPUMatrix, *grd.m_CPUMatrix),
+                            GPUMatrix<ElemType>::ClassConditionalSoftmaxGradient(*logSoftmax.m_GPUMatrix, *gradient.m_GPUMatrix, *frames.m_GPUMatrix, *grd.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::AddClassConditionalHiddenGradient(const Matrix<ElemType>& weights, const Matrix<ElemType>& grd, const Matrix<ElemType>& frames,
+                                                         Matrix<ElemType>& hiddenGradient)
+{
+    DecideAndMoveToRightDevice(hiddenGradient, weights, grd, frames);
+
+    if (hiddenGradient.GetMatrixType() != DENSE || weights.GetMatrixType() != DENSE || frames.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&hiddenGradient,
+                            &hiddenGradient,
+                            CPUMatrix<ElemType>::AddClassConditionalHiddenGradient(*weights.m_CPUMatrix, *grd.m_CPUMatrix, *frames.m_CPUMatrix, *hiddenGradient.m_CPUMatrix),
+                            GPUMatrix<ElemType>::AddClassConditionalHiddenGradient(*weights.m_GPUMatrix, *grd.m_GPUMatrix, *frames.m_GPUMatrix, *hiddenGradient.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::AddClassConditionalWeightGradient(const Matrix<ElemType>& hidden, const Matrix<ElemType>& grd, const Matrix<ElemType>& frames,
+                                                         const Matrix<ElemType>& classes, Matrix<ElemType>& weightGradient)
+{
+    DecideAndMoveToRightDevice(weightGradient, hidden, grd, frames);
+    classes._transferToDevice(weightGradient.GetDeviceId());
+
+    if (weightGradient.GetMatrixType() != DENSE || hidden.GetMatrixType() != DENSE || frames.GetMatrixType() != DENSE || classes.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&weightGradient,
+                            &weightGradient,
+                            CPUMatrix<ElemType>::AddClassConditionalWeightGradient(*hidden.m_CPUMatrix, *grd.m_CPUMatrix, *frames.m_CPUMatrix,
+                                                                                   *classes.m_CPUMatrix, *weightGradient.m_CPUMatrix),
+                            GPUMatrix<ElemType>::AddClassConditionalWeightGradient(*hidden.m_GPUMatrix, *grd.m_GPUMatrix, *frames.m_GPUMatrix,
+                                                                                   *classes.m_GPUMatrix, *weightGradient.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::DropFrame(const Matrix<ElemType>& label, const Matrix<ElemType>& gamma, const ElemType& threshhold)
 {
@@ -5034,7 +6064,7 @@ Matrix<ElemType>& Matrix<ElemType>::AssignSequenceError(const ElemType hsmoothin
 #pragma endregion Static BLAS Functions
 
 template <class ElemType>
-void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, ElemType alpha, ElementWiseOperator op,
+void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                 const array<size_t, 2>& offsets,
                                 const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                                 const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
@@ -5043,14 +6073,14 @@ void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, ElemTy
 
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            m_CPUMatrix->TensorOp(beta, *a.m_CPUMatrix, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
-                            m_GPUMatrix->TensorOp(beta, *a.m_GPUMatrix, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
+                            m_CPUMatrix->TensorOp(beta, *a.m_CPUMatrix, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
+                            m_GPUMatrix->TensorOp(beta, *a.m_GPUMatrix, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
 }
 
 template <class ElemType>
-void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, const Matrix<ElemType>& b, ElemType alpha, ElementWiseOperator op,
+void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, const Matrix<ElemType>& b, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                 const array<size_t, 3>& offsets,
                                 const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
                                 const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
@@ -5059,14 +6089,14 @@ void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, const
 
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            m_CPUMatrix->TensorOp(beta, *a.m_CPUMatrix, *b.m_CPUMatrix, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
-                            m_GPUMatrix->TensorOp(beta, *a.m_GPUMatrix, *b.m_GPUMatrix, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
+                            m_CPUMatrix->TensorOp(beta, *a.m_CPUMatrix, *b.m_CPUMatrix, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
+                            m_GPUMatrix->TensorOp(beta, *a.m_GPUMatrix, *b.m_GPUMatrix, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
 }
 
 template <class ElemType>
-void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, ElemType alpha, ElementWiseOperator op,
+void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                 const array<size_t, 4>& offsets,
                                 const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                                 const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides)
@@ -5075,12 +6105,115 @@ void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, const
 
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            m_CPUMatrix->TensorOp(beta, *a.m_CPUMatrix, *b.m_CPUMatrix, *c.m_CPUMatrix, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
-                            m_GPUMatrix->TensorOp(beta, *a.m_GPUMatrix, *b.m_GPUMatrix, *c.m_GPUMatrix, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
+                            m_CPUMatrix->TensorOp(beta, *a.m_CPUMatrix, *b.m_CPUMatrix, *c.m_CPUMatrix, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
+                            m_GPUMatrix->TensorOp(beta, *a.m_GPUMatrix, *b.m_GPUMatrix, *c.m_GPUMatrix, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::ElementWiseProgramOp(const ElementWiseProgram& program,
+                                                      const vector<const Matrix<ElemType>*>& inputs, const vector<size_t>& inputOffsets,
+                                                      const vector<Matrix<ElemType>*>& outputs, const vector<size_t>& outputOffsets, size_t numElements)
+{
+    if ((int) inputs.size() != program.numInputs || inputOffsets.size() != inputs.size() || (int) outputs.size() != program.numOutputs || outputOffsets.size() != outputs.size() || outputs.empty())
+        InvalidArgument("ElementWiseProgramOp: Number of operands does not match the program.");
+
+    // all operands go to the device of the first output
+    DEVICEID_TYPE deviceId = outputs[0]->GetDeviceId();
+    vector<const ElemType*> inputPointers;
+    vector<ElemType*> outputPointers;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        if (inputs[i]->GetMatrixType() != MatrixType::DENSE)
+            InvalidArgument("ElementWiseProgramOp: Only dense matrices are supported.");
+        inputs[i]->TransferToDeviceIfNotThere(deviceId, true);
+        if (inputOffsets[i] + numElements > inputs[i]->GetNumElements())
+            InvalidArgument("ElementWiseProgramOp: Input %d is too small.", (int) i);
+        inputPointers.push_back(inputs[i]->BufferPointer() + inputOffsets[i]);
+    }
+    for (size_t k = 0; k < outputs.size(); k++)
+    {
+        if (outputs[k]->GetMatrixType() != MatrixType::DENSE)
+            InvalidArgument("ElementWiseProgramOp: Only dense matrices are supported.");
+        outputs[k]->TransferToDeviceIfNotThere(deviceId, true);
+        if (outputOffsets[k] + numElements > outputs[k]->GetNumElements())
+            InvalidArgument("ElementWiseProgramOp: Output %d is too small.", (int) k);
+        outputPointers.push_back(outputs[k]->BufferPointer() + outputOffsets[k]);
+        // the outputs are written on the target device only, so any other copy becomes stale
+        outputs[k]->SetDataLocation(deviceId < 0 ? CurrentDataLocation::CPU : CurrentDataLocation::GPU, MatrixType::DENSE);
+    }
+
+    if (deviceId < 0)
+        CPUMatrix<ElemType>::ElementWiseProgramOp(program, inputPointers.data(), outputPointers.data(), numElements);
+    else
+        GPUMatrix<ElemType>::ElementWiseProgramOp(program, inputPointers.data(), outputPointers.data(), numElements, deviceId);
+}
+
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::LSTMForwardStep(Matrix<ElemType>& gates, const Matrix<ElemType>& prevCell, Matrix<ElemType>& cell, Matrix<ElemType>& output)
+{
+    const size_t N = cell.GetNumRows(), S = cell.GetNumCols();
+    if (gates.GetNumRows() != 4 * N || gates.GetNumCols() != S || prevCell.GetNumRows() != N || prevCell.GetNumCols() != S || output.GetNumRows() != N || output.GetNumCols() != S)
+        InvalidArgument("LSTMForwardStep: The input matrix dimensions do not match.");
+
+    DecideAndMoveToRightDevice(gates, prevCell, cell, output);
+    gates.SetDataLocation(output.GetDeviceId() < 0 ? CurrentDataLocation::CPU : CurrentDataLocation::GPU, MatrixType::DENSE);
+    cell.SetDataLocation(output.GetDeviceId() < 0 ? CurrentDataLocation::CPU : CurrentDataLocation::GPU, MatrixType::DENSE);
+
+    DISPATCH_MATRIX_ON_FLAG(&output,
+                            &output,
+                            CPUMatrix<ElemType>::LSTMForwardStep(*gates.m_CPUMatrix, *prevCell.m_CPUMatrix, *cell.m_CPUMatrix, *output.m_CPUMatrix),
+                            GPUMatrix<ElemType>::LSTMForwardStep(*gates.m_GPUMatrix, *prevCell.m_GPUMatrix, *cell.m_GPUMatrix, *output.m_GPUMatrix),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::LSTMBackwardStep(const Matrix<ElemType>& gates, const Matrix<ElemType>& prevCell, const Matrix<ElemType>& cell,
+                                                  const Matrix<ElemType>& outputGradient, Matrix<ElemType>& cellGradient, Matrix<ElemType>& gatesGradient)
+{
+    const size_t N = cell.GetNumRows(), S = cell.GetNumCols();
+    if (gates.GetNumRows() != 4 * N || gates.GetNumCols() != S || prevCell.GetNumRows() != N || prevCell.GetNumCols() != S ||
+        outputGradient.GetNumRows() != N || outputGradient.GetNumCols() != S || cellGradient.GetNumRows() != N || cellGradient.GetNumCols() != S ||
+        gatesGradient.GetNumRows() != 4 * N || gatesGradient.GetNumCols() != S)
+        InvalidArgument("LSTMBackwardStep: The input matrix dimensions do not match.");
+
+    DecideAndMoveToRightDevice(gates, prevCell, cell, outputGradient);
+    cellGradient.TransferToDeviceIfNotThere(gates.GetDeviceId(), true);
+    gatesGradient.TransferToDeviceIfNotThere(gates.GetDeviceId(), true);
+    gatesGradient.SetDataLocation(gates.GetDeviceId() < 0 ? CurrentDataLocation::CPU : CurrentDataLocation::GPU, MatrixType::DENSE);
+
+    DISPATCH_MATRIX_ON_FLAG(&cellGradient,
+                            &cellGradient,
+                            CPUMatrix<ElemType>::LSTMBackwardStep(*gates.m_CPUMatrix, *prevCell.m_CPUMatrix, *cell.m_CPUMatrix, *outputGradient.m_CPUMatrix, *cellGradient.m_CPUMatrix, *gatesGradient.m_CPUMatrix),
+                            GPUMatrix<ElemType>::LSTMBackwardStep(*gates.m_GPUMatrix, *prevCell.m_GPUMatrix, *cell.m_GPUMatrix, *outputGradient.m_GPUMatrix, *cellGradient.m_GPUMatrix, *gatesGradient.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+/*static*/ bool Matrix<ElemType>::LSTMForwardSequence(const Matrix<ElemType>& R, Matrix<ElemType>& gates, const Matrix<char>& resetMask,
+                                                     Matrix<ElemType>& prevOutput, Matrix<ElemType>& prevCell, Matrix<ElemType>& cell, Matrix<ElemType>& output, size_t S)
+{
+    const size_t N = cell.GetNumRows(), numCols = cell.GetNumCols();
+    if (S == 0 || numCols % S != 0 || R.GetNumRows() != 4 * N || R.GetNumCols() != N || gates.GetNumRows() != 4 * N || gates.GetNumCols() != numCols ||
+        prevOutput.GetNumRows() != N || prevOutput.GetNumCols() != numCols || prevCell.GetNumRows() != N || prevCell.GetNumCols() != numCols ||
+        output.GetNumRows() != N || output.GetNumCols() != numCols || resetMask.GetNumCols() != numCols)
+        InvalidArgument("LSTMForwardSequence: The input matrix dimensions do not match.");
+
+    const DEVICEID_TYPE deviceId = output.GetDeviceId();
+    if (deviceId < 0 || R.GetDeviceId() != deviceId || gates.GetDeviceId() != deviceId || resetMask.GetDeviceId() != deviceId ||
+        prevOutput.GetDeviceId() != deviceId || prevCell.GetDeviceId() != deviceId || cell.GetDeviceId() != deviceId ||
+        R.GetMatrixType() != MatrixType::DENSE || output.GetMatrixType() != MatrixType::DENSE)
+        return false;
+    for (auto* m : {&gates, &prevOutput, &prevCell, &cell, &output})
+        m->SetDataLocation(CurrentDataLocation::GPU, MatrixType::DENSE);
+
+    return GPUMatrix<ElemType>::LSTMForwardSequence(*R.m_GPUMatrix, *gates.m_GPUMatrix, *resetMask.m_GPUMatrix,
+                                                    *prevOutput.m_GPUMatrix, *prevCell.m_GPUMatrix, *cell.m_GPUMatrix, *output.m_GPUMatrix, S);
+}
+
 template class Matrix<float>;
 template class Matrix<double>;
 
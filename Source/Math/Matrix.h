@@ -56,6 +56,49 @@ class CPUSparseMatrix;
 template <class ElemType>
 class DeviceBoundNumber;
 
+// -----------------------------------------------------------------------
+// MatrixTransferMonitor -- counts the moves of Matrix data between devices, to find the ones nobody asked for
+//
+// A transfer is implicit if Matrix makes it on its own because the operands of an operation live on different devices
+// (DecideAndMoveToRightDevice() and the like), explicit if it comes from TransferFromDeviceToDevice() and friends.
+// While enabled, each transfer is attributed to the node the current thread is in (see Scope, set by the network's
+// forward and backward passes) and to its call site (the first few callers), with its count and bytes. Report()
+// prints those, sorted by bytes, and resets them. In strict mode, an implicit transfer inside a node is an error.
+// -----------------------------------------------------------------------
+
+class MATH_API MatrixTransferMonitor
+{
+public:
+    enum class Mode
+    {
+        off,
+        count,
+        strict
+    };
+    static Mode ParseMode(const std::wstring& s); // "off", "count", or "strict"
+    static void SetMode(Mode mode);
+    static Mode GetMode();
+    static bool IsEnabled()
+    {
+        return GetMode() != Mode::off;
+    }
+
+    // attributes the transfers of the current thread to 'owner' (e.g. a node name, which must outlive the scope) in a phase (e.g. "forward")
+    class MATH_API Scope
+    {
+    public:
+        Scope(const std::wstring& owner, const char* phase);
+        ~Scope();
+
+    private:
+        const std::wstring* m_prevOwner;
+        const char* m_prevPhase;
+    };
+
+    static void Record(bool isImplicit, int fromId, int toId, size_t bytes, size_t rows, size_t cols);
+    static void Report(const char* what, size_t maxEntries = 20);
+};
+
 //To compy with BLAS libraries matrices are stored in ColMajor. However, by default C/C++/C# use RowMajor
 //convertion is need when passing data between Matrix and C++ matrices
 //For the best performance compile CNTKMath project with NO_SYNC preprocessor directive
@@ -79,6 +122,7 @@ private:
 
     // Moves matrix from device id_from to device with id_to. This method doesn't change preferred device Id
     void _transferFromDeviceToDevice(int id_from, int id_to, bool ismoved = true, bool emptyTransfer = false) const;
+    void RecordTransfer(int id_from, int id_to, bool emptyTransfer, bool isImplicit) const; // (for MatrixTransferMonitor)
     // Moves matrix from current device to device with id_to. This method doesn't change preferred device Id
     void _transferToDevice(int id_to, bool ismoved = true, bool emptyTransfer = false) const;
     static void DecideAndMoveToRightDevice(const Matrix<ElemType>& a, const Matrix<ElemType>& b);
@@ -198,6 +242,14 @@ public:
     ElemType Adagrad(Matrix<ElemType>& gradients, const bool needAveMultiplier);
     void FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum);
     ElemType RmsProp(Matrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
+    // layer-wise adaptive rates for large minibatches; the learning rate is per minibatch, and is scaled by ||W|| / ||update|| of this parameter
+    void LarsUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRate, const ElemType momentum, const ElemType trustCoefficient);
+    void LambUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRate, const ElemType beta1, const ElemType beta2, const ElemType epsilon, const ElemType weightDecay);
+    // NormalGrad() of a whole set of dense parameters of one device at once, including clipping (per parameter; not clipped if the threshold is infinite),
+    // L2 (added to the gradient) and L1 (soft threshold of the result); on the GPU in one or two kernel launches for all of them
+    static void MultiTensorNormalGrad(const std::vector<Matrix<ElemType>*>& functionValues, const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& smoothedGradients,
+                                      const ElemType learnRatePerSample, const ElemType momentum, const bool useNesterovMomentum,
+                                      const ElemType clippingThreshold, const bool clipByTruncation, const ElemType l2Weight, const ElemType l1Threshold);
 
     void Resize(const size_t numRows, const size_t numCols, const size_t numNZElemToReserve = 10000, bool growOnly = true); // by default we only reallocate if need to grow
     void Resize(const Matrix<ElemType>& other)
@@ -242,6 +294,10 @@ public:
     void SetValue(const Matrix<ElemType>& deepCopyFrom, const MatrixFormat format = matrixFormatSparseCSR);
     void SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, const size_t matrixFlags = matrixFlagNormal);
     void SetValue(const size_t rIdx, const size_t cIdx, ElemType val); // set matrix sparsely
+    // from a host buffer of uint8 or fp16 elements, converted on the matrix's device: scale * x + rowShift[row]
+    // This lets readers ship inputs at their natural size, e.g. pixels as bytes. rowShift (a column, may be null) must live where this matrix does.
+    void SetValueFromCompact(const size_t numRows, const size_t numCols, int deviceId, const void* pArray, CompactElementType type,
+                             ElemType scale = 1, const Matrix<ElemType>* rowShift = nullptr);
     void SetValue(const size_t numRows, const size_t numCols, std::initializer_list<ElemType> l)
     {
         std::vector<ElemType> vals(l);
@@ -255,6 +311,17 @@ public:
     }
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
                                 const size_t nz, const size_t numRows, const size_t numCols);
+    // the same from (column, row, value) triplets ordered by column; on the GPU, the CSC structure is built by the device
+    void SetMatrixFromCOOFormat(const CPUSPARSE_INDEX_TYPE* h_Col, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                const size_t nz, const size_t numRows, const size_t numCols);
+
+    // host copies of a matrixFormatSparseBlockCol matrix: the ids of its non-zero columns, and their values (GetNumRows() per column)
+    void GetSparseBlockColData(std::vector<size_t>& columnIds, std::vector<ElemType>& values) const;
+    void SetSparseBlockColData(const size_t numRows, const size_t numCols, const std::vector<size_t>& columnIds, const std::vector<ElemType>& values);
+    // host copy of a CSC matrix on the CPU, the counterpart of SetMatrixFromCSCFormat()
+    void GetSparseCSCData(std::vector<CPUSPARSE_INDEX_TYPE>& colStarts, std::vector<CPUSPARSE_INDEX_TYPE>& rowIndices, std::vector<ElemType>& values) const;
+    // this (sparse) = the blockDim x blockDim blocks of the dense matrix a that have a non-zero element, in matrixFormatSparseBSR
+    void SetBlockSparseRowValue(const Matrix<ElemType>& a, const size_t blockDim);
 
     void MaskColumnsValue(const Matrix<char>& columnsMask, ElemType val);
 
@@ -312,6 +379,10 @@ public:
     Matrix<ElemType>& ElementMultiplyWith(const Matrix<ElemType>& a);
     Matrix<ElemType>& AssignElementProductOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b);
     Matrix<ElemType>& AddElementProductOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b);
+    // [this] = resp. += a .* mask, where the dropout mask is that of elements offset, offset+1, ... of the sequence that 'seed' determines
+    // (see DropoutMaskAt() in TensorOps.h); it is computed on the fly, so backprop can regenerate it rather than keep it
+    Matrix<ElemType>& AssignDropoutOf(const Matrix<ElemType>& a, const ElemType dropoutRate, unsigned long seed, size_t offset);
+    Matrix<ElemType>& AddDropoutOf(const Matrix<ElemType>& a, const ElemType dropoutRate, unsigned long seed, size_t offset);
 
     Matrix<ElemType>& AssignElementDivisionOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b);
     Matrix<ElemType>& ElementDivideBy(const Matrix<ElemType>& a);
@@ -392,6 +463,10 @@ public:
 
     Matrix<ElemType>& AssignRepeatOf(const Matrix<ElemType>& a, const size_t numRowRepeats, const size_t numColRepeats);
     Matrix<ElemType>& AddToRowRepeatValuesOf(const Matrix<ElemType>& a, const size_t numRepeats);
+    // this(k-th block of a.GetNumRows() rows, j) = a(:, sourceColumns(k, j)), e.g. to splice neighbor frames into one column
+    Matrix<ElemType>& AssignRowStackedColumnsOf(const Matrix<ElemType>& a, const Matrix<ElemType>& sourceColumns);
+    // the transpose of the above: this(:, sourceColumns(k, j)) += a(k-th block of GetNumRows() rows, j)
+    Matrix<ElemType>& AddFromRowStackedColumnsOf(const Matrix<ElemType>& a, const Matrix<ElemType>& sourceColumns);
 
     Matrix<ElemType>& AssignPositiveAndShiftedNegSample(const Matrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber);
     Matrix<ElemType>& AddFoldedPositiveAndShiftedNegSample(const Matrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber);
@@ -418,6 +493,10 @@ public:
 
     ElemType FrobeniusNorm() const;
     Matrix<ElemType>& AssignFrobeniusNormOf(const Matrix<ElemType>& a);
+    // scale down to a Frobenius norm of at most maxNorm; the norm goes into 'norm' [1 x 1], and the GPU decides without reading it back
+    Matrix<ElemType>& ClipFrobeniusNorm(ElemType maxNorm, Matrix<ElemType>& norm);
+    // [1 x T] row index of the non-zero of each column of a sparse CSC one-hot matrix, or -1 for an empty column
+    Matrix<ElemType>& AssignOneHotIndicesOf(const Matrix<ElemType>& oneHot);
 
     ElemType MatrixNormInf() const;
     ElemType MatrixNorm1() const;
@@ -480,8 +559,14 @@ public:
 
     // singular value decomposition of A as A = U*SIGMA*VT
     static void SVD(const Matrix<ElemType>& A, Matrix<ElemType>& SIGMA, Matrix<ElemType>& U, Matrix<ElemType>& VT, Matrix<ElemType>& W);
+    // the leading 'rank' singular values and vectors of A by a randomized range finder: A ~= U*diag(SIGMA)*VT, with U and VT on
+    // A's device and SIGMA [rank x 1] on the CPU, in descending order; everything but decompositions of [l x l] matrices,
+    // l = rank + oversampling, runs as GEMMs where A is
+    static void RandomizedSVD(const Matrix<ElemType>& A, const size_t rank, const size_t oversampling, const size_t powerIterations, unsigned long seed,
+                              Matrix<ElemType>& SIGMA, Matrix<ElemType>& U, Matrix<ElemType>& VT);
 
     static void MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c); // SGEMM
+    static void BatchMultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c, size_t batchSize); // batch of equally shaped SGEMMs, see BatchedGemmShape
     static void MultiplyAndAdd(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, Matrix<ElemType>& c);
     static void Multiply(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, Matrix<ElemType>& c);
     static void Multiply(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
@@ -495,6 +580,27 @@ public:
     static void AddScaledDifference(const Matrix<ElemType>& alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c); // c += alpha * (a - b)
     static void AssignScaledDifference(const Matrix<ElemType>& alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
 
+    // column-wise softmax followed by cross entropy with 'labels', without a matrix for the softmax
+    // 'columnStats' [T x 3] receives for each column the max of 'prediction', the log of the sum of exp(prediction - max), and the cross entropy.
+    // 'labels' [1 x T] of a prediction with more rows are class indices (the target is gathered, not multiplied); indices outside the rows mean no label.
+    static void SoftmaxCrossEntropy(const Matrix<ElemType>& labels, const Matrix<ElemType>& prediction, Matrix<ElemType>& columnStats);
+    // predictionGradient += alpha * (softmax(prediction) - labels), with the softmax recomputed from the 'columnStats' of SoftmaxCrossEntropy()
+    static void SoftmaxCrossEntropyBackprop(const Matrix<ElemType>& alpha, const Matrix<ElemType>& labels, const Matrix<ElemType>& prediction,
+                                            const Matrix<ElemType>& columnStats, Matrix<ElemType>& predictionGradient);
+
+    // hierarchical softmax over a binary tree of the classes: column w of 'paths' [2D x V] holds the internal nodes from the root to class w
+    // (rows 0..D-1, -1 past the end of the path) and the branch signs +1 or -1 (rows D..2D-1); node n scores weights(:,n)' * hidden.
+    // For the class indices 'labels' [1 x T] (outside [0, V) for none), 'frameLosses' [1 x T] receives -log P(label) = sum_d log(1 + exp(-sign_d * score_d)),
+    // and 'pathGradients' [D x T] its derivatives by the scores along the path.
+    static void HierarchicalSoftmax(const Matrix<ElemType>& labels, const Matrix<ElemType>& hidden, const Matrix<ElemType>& weights, const Matrix<ElemType>& paths,
+                                    Matrix<ElemType>& frameLosses, Matrix<ElemType>& pathGradients);
+    // hiddenGradient(:,t) += alpha * sum_d pathGradients(d,t) * weights(:,node_d)
+    static void HierarchicalSoftmaxBackpropHidden(const Matrix<ElemType>& alpha, const Matrix<ElemType>& labels, const Matrix<ElemType>& weights, const Matrix<ElemType>& paths,
+                                                  const Matrix<ElemType>& pathGradients, Matrix<ElemType>& hiddenGradient);
+    // weightsGradient(:,node_d) += alpha * pathGradients(d,t) * hidden(:,t), over all frames t
+    static void HierarchicalSoftmaxBackpropWeights(const Matrix<ElemType>& alpha, const Matrix<ElemType>& labels, const Matrix<ElemType>& hidden, const Matrix<ElemType>& paths,
+                                                   const Matrix<ElemType>& pathGradients, Matrix<ElemType>& weightsGradient);
+
     static void AddElementToElement(const Matrix<ElemType>& a, const size_t ai, const size_t aj, Matrix<ElemType>& c, const size_t ci, const size_t cj);
     // static void AddLogElementToElement(const Matrix<ElemType>& a, const size_t ai, const size_t aj, Matrix<ElemType>& c, const size_t ci, const size_t cj);
     static void AssignElementToElement(const Matrix<ElemType>& a, const size_t ai, const size_t aj, Matrix<ElemType>& c, const size_t ci, const size_t cj);
@@ -512,18 +618,35 @@ public:
 
     static void TensorShuffleScaleAndAdd(ElemType keepWeight, const Matrix<ElemType>& a, size_t D, size_t S, size_t M, size_t K, size_t T, ElemType scaleFactor, const Matrix<ElemType>& b, Matrix<ElemType>& c);
 
-    void TensorOp(ElemType beta, const Matrix<ElemType>& a, ElemType alpha, ElementWiseOperator op,
+    void TensorOp(ElemType beta, const Matrix<ElemType>& a, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                   const std::array<size_t, 2>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& reducingStrides);
-    void TensorOp(ElemType beta, const Matrix<ElemType>& a, const Matrix<ElemType>& b, ElemType alpha, ElementWiseOperator op,
+    void TensorOp(ElemType beta, const Matrix<ElemType>& a, const Matrix<ElemType>& b, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                   const std::array<size_t, 3>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 3>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 3>& reducingStrides);
-    void TensorOp(ElemType beta, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, ElemType alpha, ElementWiseOperator op,
+    void TensorOp(ElemType beta, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                   const std::array<size_t, 4>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
+    // evaluate a fused chain of elementwise ops over 'numElements' consecutive elements of each operand, starting at the given element offsets
+    static void ElementWiseProgramOp(const ElementWiseProgram& program,
+                                     const std::vector<const Matrix<ElemType>*>& inputs, const std::vector<size_t>& inputOffsets,
+                                     const std::vector<Matrix<ElemType>*>& outputs, const std::vector<size_t>& outputOffsets, size_t numElements);
+
+    // one fused LSTM time step over all parallel sequences
+    // 'gates' [4N x S] holds the gate pre-activations [input; forget; output; cell candidate] and is overwritten with their activations.
+    static void LSTMForwardStep(Matrix<ElemType>& gates, const Matrix<ElemType>& prevCell, Matrix<ElemType>& cell, Matrix<ElemType>& output);
+    // 'cellGradient' comes in as the gradient from the next step and is replaced by the gradient for the previous step
+    static void LSTMBackwardStep(const Matrix<ElemType>& gates, const Matrix<ElemType>& prevCell, const Matrix<ElemType>& cell,
+                                 const Matrix<ElemType>& outputGradient, Matrix<ElemType>& cellGradient, Matrix<ElemType>& gatesGradient);
+    // all T time steps of an LSTM over S parallel sequences at once, in a persistent GPU kernel that keeps the recurrent weights R [4N x N] on chip
+    // 'gates' [4N x S*T] come in holding W x_t + b. The columns of step 0 of 'prevOutput' and 'prevCell' [N x S*T] are given; those of the later
+    // steps are set to the output and cell of the step before, or to 0 where 'resetMask' [1 x S*T] is 0.
+    // Returns false without doing anything where this does not apply (on the CPU, or for N > 512 or an R that does not fit into shared memory).
+    static bool LSTMForwardSequence(const Matrix<ElemType>& R, Matrix<ElemType>& gates, const Matrix<char>& resetMask,
+                                    Matrix<ElemType>& prevOutput, Matrix<ElemType>& prevCell, Matrix<ElemType>& cell, Matrix<ElemType>& output, size_t S);
 
 public:
     void Read(File& stream);
@@ -537,6 +660,10 @@ public:
     Matrix<ElemType>& GetARowByIndex(const Matrix<ElemType>& a, size_t index);
     static void ConductRowElementMultiplyWithShift(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c, size_t shift, bool bFirstmatrixfixed);
     Matrix<ElemType>& AssignElementProductOfWithShift(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift);
+    // [this] = the cosine distances of the columns of a and the negnumber+1 shifted columns of b, with their inverse norms given as row vectors
+    Matrix<ElemType>& AssignCosDistanceWithShiftNeg(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB, size_t shift, size_t negnumber);
+    // inputGradient += the gradient of AssignCosDistanceWithShiftNeg() with respect to a, or to b if wrtB
+    static void AddCosDistanceWithShiftNegGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& cosDistance, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB, size_t shift, size_t negnumber, bool wrtB, Matrix<ElemType>& inputGradient);
 
 public:
     static void RCRFBackwardCompute(const Matrix<ElemType>& alpha, Matrix<ElemType>& beta,
@@ -551,6 +678,57 @@ public:
                                     const int startLbl, // the time 0 start symbol in the output layer
                                     const int shift);
 
+    // Batched linear-chain CRF over all sequences of a minibatch, in one pass instead of one call per sequence.
+    // sequences is a 3 x numSequences matrix of (parallel sequence s, first time step, end time step); time step t
+    // of a sequence is column t * numParallelSequences + s, as in an MBLayout. labels are one-hot; the label of the
+    // first frame of a sequence is also its start symbol (as in RCRFTransGrdCompute()). Columns not covered by
+    // a sequence (gaps) get LZERO in alpha and beta, and 0 in decodedPath.
+    //  - CRFForwardBackward: alpha = forward scores, beta = log posteriors of the labels,
+    //    sequenceScores(0, j) = -log P(labels of sequence j)
+    //  - CRFTransitionGradient: grd += gradient of the sum of sequenceScores w.r.t. pairScores
+    //  - ViterbiDecode: decodedPath = one-hot best label paths; a sequence ends in the label of its last frame if it has one
+    static void CRFForwardBackward(const Matrix<ElemType>& labels, const Matrix<ElemType>& posScores, const Matrix<ElemType>& pairScores,
+                                   Matrix<ElemType>& alpha, Matrix<ElemType>& beta, Matrix<ElemType>& sequenceScores,
+                                   const Matrix<ElemType>& sequences, const size_t numParallelSequences);
+    static void CRFTransitionGradient(const Matrix<ElemType>& labels, const Matrix<ElemType>& posScores, const Matrix<ElemType>& pairScores,
+                                      const Matrix<ElemType>& alpha, const Matrix<ElemType>& beta, Matrix<ElemType>& grd,
+                                      const Matrix<ElemType>& sequences, const size_t numParallelSequences);
+    static void ViterbiDecode(const Matrix<ElemType>& labels, const Matrix<ElemType>& posScores, const Matrix<ElemType>& pairScores,
+                              Matrix<ElemType>& alpha, Matrix<ElemType>& backtrace, Matrix<ElemType>& decodedPath,
+                              const Matrix<ElemType>& sequences, const size_t numParallelSequences);
+
+    // Forward-backward of a denominator graph (lattice-free MMI) over all sequences of a minibatch, in one pass.
+    // The graph is an HMM whose arcs emit pdfs (rows of logLikelihoods):
+    //  - arcs: 4 x 2*numArcs of (source state, destination state, pdf, log weight), first sorted by destination, then the same arcs sorted by source
+    //  - states: 4 x (numStates + 1) of (first in-arc, first out-arc in the second half of arcs, log initial weight, log final weight);
+    //    the last column holds the ends of the arc ranges
+    // sequences and numParallelSequences are as for CRFForwardBackward(). Outputs:
+    //  - alpha: numStates x numCols forward scores; beta: numStates x 2*numSequences workspace
+    //  - posteriors: numPdfs x numCols occupancies of the pdfs, 0 in gaps
+    //  - logDenominators(0, j) = log of the total score of all paths of sequence j (0 if the graph has none of its length)
+    static void DenominatorForwardBackward(const Matrix<ElemType>& logLikelihoods, const Matrix<ElemType>& arcs, const Matrix<ElemType>& states,
+                                           Matrix<ElemType>& alpha, Matrix<ElemType>& beta, Matrix<ElemType>& posteriors, Matrix<ElemType>& logDenominators,
+                                           const Matrix<ElemType>& sequences, const size_t numParallelSequences);
+
+    // Class-based softmax over all frames of a minibatch, in one pass instead of a few small products per frame.
+    // frames is a 5 x numFrames matrix of (column of hidden, offset into the concatenated class-conditional vectors,
+    // first word of the class, number of words in the class, target word within the class); the class-conditional
+    // vectors of the frames are concatenated into one 1 x totalNumWords row vector (totalNumWords = the sum of the class sizes).
+    //  - ClassConditionalLogSoftmax: logSoftmax = log softmax of hidden(:, col)^T * weights(:, first : first + n) per frame,
+    //    targetLogProbs(0, j) = the log probability of the target word of frame j
+    //  - ClassConditionalSoftmaxGradient: grd = (softmax - one-hot target) * gradient(0, 0)
+    //  - AddClassConditionalHiddenGradient: hiddenGradient(:, col) += weights(:, first : first + n) * grd of the frame
+    //  - AddClassConditionalWeightGradient: weightGradient(:, first : first + n) += hidden(:, col) * grd^T, summed over the frames;
+    //    classes is a 2 x numClasses matrix of (first frame, end frame), i.e. the frames must be sorted by class
+    static void ClassConditionalLogSoftmax(const Matrix<ElemType>& hidden, const Matrix<ElemType>& weights, const Matrix<ElemType>& frames, const size_t totalNumWords,
+                                           Matrix<ElemType>& logSoftmax, Matrix<ElemType>& targetLogProbs);
+    static void ClassConditionalSoftmaxGradient(const Matrix<ElemType>& logSoftmax, const Matrix<ElemType>& gradient, const Matrix<ElemType>& frames,
+                                                Matrix<ElemType>& grd);
+    static void AddClassConditionalHiddenGradient(const Matrix<ElemType>& weights, const Matrix<ElemType>& grd, const Matrix<ElemType>& frames,
+                                                  Matrix<ElemType>& hiddenGradient);
+    static void AddClassConditionalWeightGradient(const Matrix<ElemType>& hidden, const Matrix<ElemType>& grd, const Matrix<ElemType>& frames,
+                                                  const Matrix<ElemType>& classes, Matrix<ElemType>& weightGradient);
+
     template <typename T>
     friend class MatrixQuantizer;
 
@@ -3,6 +3,182 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// ---------------------------------------------------------------------------
+// CPU column kernels
+//
+// The layout of a quantized column is the one of ColumnQuantizer, which interleaves the rows for collated access on
+// CUDA: QWord w holds rows w, w + numQWords, w + 2 * numQWords, ... Here the column is walked in order instead, in
+// blocks of numQWords consecutive rows, where block k goes into the bits [k * nBits, (k + 1) * nBits) of all QWords.
+// So all loops run over contiguous memory, without branches, and get vectorized by the compiler. The sums of the
+// range statistics are accumulated in row order, as ColumnQuantizer does, so the results are the same.
+// The first pass stores the sum of value and residual into the output residual, the last pass replaces it by the
+// new residual, so that the column is read from the matrix and the residual only once.
+// Columns are processed in parallel.
+// ---------------------------------------------------------------------------
+
+template <class ElemType, bool ZeroThresholdFor1Bit>
+static void QuantizeColumn(const ElemType* in, const ElemType* inResidual, ElemType* outResidual, size_t M, size_t nBits, size_t ldNbits, QuantizedColumn<ElemType>& qcol)
+{
+    typedef typename ValueQuantizer<ElemType>::QWord QWord;
+    typedef typename ValueQuantizer<ElemType>::QWordVal QWordVal;
+
+    // pass 1: val = in + residual, and the sums that need no mean
+    ElemType* val = outResidual;
+    ElemType sum = 0;
+    ElemType sum0 = 0, sum1 = 0;
+    unsigned int num0 = 0, num1 = 0;
+    const bool needMean = !ZeroThresholdFor1Bit || (nBits != 1);
+    if (needMean)
+    {
+        for (size_t i = 0; i < M; i++)
+        {
+            val[i] = in[i] + inResidual[i];
+            sum += val[i];
+        }
+    }
+    else // (1 bit with threshold 0: the level sums right away)
+    {
+        for (size_t i = 0; i < M; i++)
+        {
+            val[i] = in[i] + inResidual[i];
+            if (val[i] < 0)
+            {
+                sum0 += val[i];
+                num0++;
+            }
+            else
+            {
+                sum1 += val[i];
+                num1++;
+            }
+        }
+    }
+    const ElemType mean = needMean ? sum / M : 0;
+
+    // pass 2: the range (same as ColumnQuantizer::ComputeRangeStatColjSubset())
+    if (nBits == 1)
+    {
+        if (needMean)
+        {
+            for (size_t i = 0; i < M; i++)
+            {
+                if (val[i] < mean)
+                {
+                    sum0 += val[i];
+                    num0++;
+                }
+                else
+                {
+                    sum1 += val[i];
+                    num1++;
+                }
+            }
+        }
+        ElemType radius, newmean;
+        if (!ZeroThresholdFor1Bit)
+        {
+            const ElemType dev = (((num0 * mean) - sum0) + (sum1 - (num1 * mean))) / M;
+            radius = 2.0f * dev;
+            newmean = mean;
+        }
+        else
+        {
+            const ElemType mean0 = sum0 / (num0 == 0 ? 1 : num0);
+            const ElemType mean1 = sum1 / (num1 == 0 ? 1 : num1);
+            newmean = 0.5f * (mean0 + mean1);
+            radius = 2.0f * (mean1 - newmean);
+        }
+        qcol.lower = newmean - radius;
+        qcol.upper = newmean + radius;
+    }
+    else
+    {
+        ElemType varacc = 0;
+        for (size_t i = 0; i < M; i++)
+            varacc += (val[i] - mean) * (val[i] - mean);
+        const ElemType stddevs = 5.0f;
+        const ElemType stddev = sqrt(varacc / M);
+        qcol.lower = mean - (stddevs * stddev);
+        qcol.upper = mean + (stddevs * stddev);
+    }
+
+    // pass 3: quantize, update the residual, and pack, one block of numQWords rows per bit position
+    const ValueQuantizer<ElemType> valQ(ldNbits, qcol.lower, qcol.upper);
+    const size_t numQWords = ColumnQuantizer<ElemType>::QWordsPerCol(M, nBits);
+    QWord* bits = qcol.bits;
+    memset(bits, 0, numQWords * sizeof(QWord));
+    if (nBits == 1)
+    {
+        const ElemType val0 = valQ.Unquantize(0);
+        const ElemType val1 = valQ.Unquantize(1);
+        for (size_t rowBegin = 0, k = 0; rowBegin < M; rowBegin += numQWords, k++)
+        {
+            const size_t n = min(numQWords, M - rowBegin);
+            ElemType* v = val + rowBegin;
+            for (size_t w = 0; w < n; w++)
+            {
+                const bool q = valQ.template Quantize1<ZeroThresholdFor1Bit>(v[w]);
+                v[w] -= q ? val1 : val0;
+                bits[w] |= (QWord) q << k;
+            }
+        }
+    }
+    else
+    {
+        for (size_t rowBegin = 0, k = 0; rowBegin < M; rowBegin += numQWords, k += nBits)
+        {
+            const size_t n = min(numQWords, M - rowBegin);
+            ElemType* v = val + rowBegin;
+            for (size_t w = 0; w < n; w++)
+            {
+                const QWordVal q = valQ.template Quantize<ZeroThresholdFor1Bit>(v[w]);
+                v[w] -= valQ.Unquantize(q);
+                bits[w] |= q << k;
+            }
+        }
+    }
+}
+
+template <class ElemType>
+static void UnquantizeColumn(const QuantizedColumn<ElemType>& qcol, ElemType* out, size_t M, size_t nBits, size_t ldNbits, bool add)
+{
+    typedef typename ValueQuantizer<ElemType>::QWord QWord;
+    typedef typename ValueQuantizer<ElemType>::QWordVal QWordVal;
+
+    const ValueQuantizer<ElemType> valQ(ldNbits, qcol.lower, qcol.upper);
+    const size_t numQWords = ColumnQuantizer<ElemType>::QWordsPerCol(M, nBits);
+    const QWord* bits = qcol.bits;
+    if (nBits == 1)
+    {
+        const ElemType val0 = valQ.Unquantize(0);
+        const ElemType val1 = valQ.Unquantize(1);
+        for (size_t rowBegin = 0, k = 0; rowBegin < M; rowBegin += numQWords, k++)
+        {
+            const size_t n = min(numQWords, M - rowBegin);
+            ElemType* o = out + rowBegin;
+            for (size_t w = 0; w < n; w++)
+            {
+                const ElemType val = ((bits[w] >> k) & 1) ? val1 : val0;
+                o[w] = add ? o[w] + val : val;
+            }
+        }
+    }
+    else
+    {
+        const QWordVal bitmask = valQ.QuanRangeEnd() - 1;
+        for (size_t rowBegin = 0, k = 0; rowBegin < M; rowBegin += numQWords, k += nBits)
+        {
+            const size_t n = min(numQWords, M - rowBegin);
+            ElemType* o = out + rowBegin;
+            for (size_t w = 0; w < n; w++)
+            {
+                const ElemType val = valQ.Unquantize((bits[w] >> k) & bitmask);
+                o[w] = add ? o[w] + val : val;
+            }
+        }
+    }
+}
+
 template <class ElemType>
 MatrixQuantizerCPU<ElemType>::MatrixQuantizerCPU()
     : MatrixQuantizerImpl<ElemType>(CPUDEVICE)
@@ -27,39 +203,19 @@ void MatrixQuantizerCPU<ElemType>::QuantizeAsync(const Matrix<ElemType>& inMatri
     assert((outResidual.GetNumRows() == nRow) && (outResidual.GetNumCols() == nCol));
 
     const size_t ldNbits = ValueQuantizer<ElemType>::ld(nBits);
-#ifdef QUANTUSEPPL
-    Concurrency::parallel_for((size_t) 0, us.cols(), [&](size_t j)
-#else
-    for (size_t j = 0; j < nCol; j++)
-#endif
-                              {
-                                  auto& qcol = *(outQMatrix.GetQuantizedColumn(j));
-                                  if (zeroThresholdFor1Bit)
-                                  {
-                                      // Explicit use of 'template' keyword is needed to compile with GCC
-                                      ColumnQuantizer<ElemType>::template ComputeRangeStatColj<true>(inMatrix.BufferPointer(), inResidual.BufferPointer(), (long) nRow, j, nBits, qcol.lower, qcol.upper);
-                                  }
-                                  else
-                                  {
-                                      // Explicit use of 'template' keyword is needed to compile with GCC
-                                      ColumnQuantizer<ElemType>::template ComputeRangeStatColj<false>(inMatrix.BufferPointer(), inResidual.BufferPointer(), (long) nRow, j, nBits, qcol.lower, qcol.upper);
-                                  }
-
-                                  ColumnQuantizer<ElemType> q(ldNbits, qcol.lower, qcol.upper);
-                                  if (zeroThresholdFor1Bit)
-                                  {
-                                      // Explicit use of 'template' keyword is needed to compile with GCC
-                                      q.template Quantize<true>(inMatrix.BufferPointer(), inResidual.BufferPointer(), (long) nRow, j, qcol.bits, outResidual.BufferPointer());
-                                  }
-                                  else
-                                  {
-                                      // Explicit use of 'template' keyword is needed to compile with GCC
-                                      q.template Quantize<false>(inMatrix.BufferPointer(), inResidual.BufferPointer(), (long) nRow, j, qcol.bits, outResidual.BufferPointer());
-                                  }
-                              }
-#ifdef QUANTUSEPPL
-                              );
-#endif
+    const ElemType* in = inMatrix.BufferPointer();
+    const ElemType* inRes = inResidual.BufferPointer();
+    ElemType* outRes = outResidual.BufferPointer();
+#pragma omp parallel for schedule(static) if (nRow * nCol >= 65536)
+    for (long j = 0; j < (long) nCol; j++)
+    {
+        auto& qcol = *(outQMatrix.GetQuantizedColumn(j));
+        const size_t offset = j * nRow;
+        if (zeroThresholdFor1Bit)
+            QuantizeColumn<ElemType, true>(in + offset, inRes + offset, outRes + offset, nRow, nBits, ldNbits, qcol);
+        else
+            QuantizeColumn<ElemType, false>(in + offset, inRes + offset, outRes + offset, nRow, nBits, ldNbits, qcol);
+    }
 }
 
 template <class ElemType>
@@ -68,7 +224,7 @@ void MatrixQuantizerCPU<ElemType>::WaitQuantizeAsyncDone()
     // TODO: Currently this is a no-op since the actual quantization is synchronous
 }
 
-// unquantize an entire matrix, calling unquantize() for each column
+// unquantize an entire matrix, calling UnquantizeColumn() for each column
 template <class ElemType>
 void MatrixQuantizerCPU<ElemType>::UnquantizeAsync(QuantizedMatrix<ElemType>& inQMatrix, Matrix<ElemType>& outMatrix, bool add /*= false*/)
 {
@@ -84,19 +240,13 @@ void MatrixQuantizerCPU<ElemType>::UnquantizeAsync(QuantizedMatrix<ElemType>& in
     assert((outMatrix.GetNumRows() == nRow) && (outMatrix.GetNumCols() == nCol));
 
     const size_t ldNbits = ValueQuantizer<ElemType>::ld(nBits);
-#ifdef QUANTUSEPPL
-    Concurrency::parallel_for((size_t) 0, us.cols(), [&](size_t j)
-#else
-    for (size_t j = 0; j < nCol; j++)
-#endif
-                              {
-                                  const auto& qcol = *(inQMatrix.GetQuantizedColumn(j));
-                                  ColumnQuantizer<ElemType> q(ldNbits, qcol.lower, qcol.upper);
-                                  q.Unquantize(outMatrix.BufferPointer(), (long) nRow, j, qcol.bits, add);
-                              }
-#ifdef QUANTUSEPPL
-                              );
-#endif
+    ElemType* out = outMatrix.BufferPointer();
+#pragma omp parallel for schedule(static) if (nRow * nCol >= 65536)
+    for (long j = 0; j < (long) nCol; j++)
+    {
+        const auto& qcol = *(inQMatrix.GetQuantizedColumn(j));
+        UnquantizeColumn(qcol, out + j * nRow, nRow, nBits, ldNbits, add);
+    }
 }
 
 template <class ElemType>
@@ -376,9 +376,17 @@ void GPUMatrixComputeStreamEvent::SynchronizeDataTransferFetchStreamWithEvent()
     cudaStreamWaitEvent(GPUDataTransferer<ElemType>::GetFetchStream(), m_mainGPUComputeStreamCUDAEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
 }
 
+template <typename ElemType>
+void GPUMatrixComputeStreamEvent::SynchronizeDataTransferAssignStreamWithEvent()
+{
+    cudaStreamWaitEvent(GPUDataTransferer<ElemType>::GetAssignStream(), m_mainGPUComputeStreamCUDAEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+}
+
 // Explicit template instantiations
 template void GPUMatrixComputeStreamEvent::SynchronizeQuantizationComputeStreamWithEvent<float>();
 template void GPUMatrixComputeStreamEvent::SynchronizeQuantizationComputeStreamWithEvent<double>();
 template void GPUMatrixComputeStreamEvent::SynchronizeDataTransferFetchStreamWithEvent<float>();
 template void GPUMatrixComputeStreamEvent::SynchronizeDataTransferFetchStreamWithEvent<double>();
+template void GPUMatrixComputeStreamEvent::SynchronizeDataTransferAssignStreamWithEvent<float>();
+template void GPUMatrixComputeStreamEvent::SynchronizeDataTransferAssignStreamWithEvent<double>();
 } } }
@@ -97,6 +97,9 @@ public:
     template <typename ElemType>
     void SynchronizeDataTransferFetchStreamWithEvent();
 
+    template <typename ElemType>
+    void SynchronizeDataTransferAssignStreamWithEvent();
+
 private:
 #ifndef CPUONLY
     cudaEvent_t m_mainGPUComputeStreamCUDAEvent;
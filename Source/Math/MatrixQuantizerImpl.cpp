@@ -64,6 +64,16 @@ void MatrixComputeStreamEvent::SynchronizeDataTransferFetchStreamWithEvent()
     }
 }
 
+template <typename ElemType>
+void MatrixComputeStreamEvent::SynchronizeDataTransferAssignStreamWithEvent()
+{
+    if (m_deviceId >= 0)
+    {
+        GPUMatrixComputeStreamEvent* GPUEvent = dynamic_cast<GPUMatrixComputeStreamEvent*>(this);
+        GPUEvent->SynchronizeDataTransferAssignStreamWithEvent<ElemType>();
+    }
+}
+
 MatrixComputeStreamEvent::MatrixComputeStreamEvent(int deviceId)
     : m_deviceId(deviceId)
 {
@@ -74,4 +84,6 @@ template MATH_API void MatrixComputeStreamEvent::SynchronizeQuantizationComputeS
 template MATH_API void MatrixComputeStreamEvent::SynchronizeQuantizationComputeStreamWithEvent<double>();
 template MATH_API void MatrixComputeStreamEvent::SynchronizeDataTransferFetchStreamWithEvent<float>();
 template MATH_API void MatrixComputeStreamEvent::SynchronizeDataTransferFetchStreamWithEvent<double>();
+template MATH_API void MatrixComputeStreamEvent::SynchronizeDataTransferAssignStreamWithEvent<float>();
+template MATH_API void MatrixComputeStreamEvent::SynchronizeDataTransferAssignStreamWithEvent<double>();
 } } }
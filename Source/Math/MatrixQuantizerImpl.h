@@ -64,6 +64,9 @@ public:
     template <typename ElemType>
     void SynchronizeDataTransferFetchStreamWithEvent();
 
+    template <typename ElemType>
+    void SynchronizeDataTransferAssignStreamWithEvent();
+
 protected:
     MatrixComputeStreamEvent(int deviceId);
 
@@ -25,6 +25,122 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 void PrepareDevice(DEVICEID_TYPE deviceId);
 
+void TracingGPUMemoryAllocator::ReleaseCachedMemory(int deviceId)
+{
+}
+
+void TracingGPUMemoryAllocator::PrintMemoryStatistics(int deviceId)
+{
+}
+
+void TracingGPUMemoryAllocator::GetMemoryStatistics(int deviceId, size_t& inUseBytes, size_t& cachedBytes)
+{
+    inUseBytes = 0;
+    cachedBytes = 0;
+}
+
+MemoryTag DeviceMemoryAccounting::CurrentTag()
+{
+    return MemoryTag::Other;
+}
+
+void DeviceMemoryAccounting::SetCurrentTag(MemoryTag tag)
+{
+}
+
+void DeviceMemoryAccounting::OnAllocate(int deviceId, const void* bufferPtr, size_t bytes)
+{
+}
+
+void DeviceMemoryAccounting::OnFree(int deviceId, const void* bufferPtr)
+{
+}
+
+void DeviceMemoryAccounting::GetUsage(int deviceId, MemoryTag tag, size_t& currentBytes, size_t& peakBytes)
+{
+    currentBytes = 0;
+    peakBytes = 0;
+}
+
+void DeviceMemoryAccounting::GetTotalUsage(int deviceId, size_t& currentBytes, size_t& peakBytes)
+{
+    currentBytes = 0;
+    peakBytes = 0;
+}
+
+void DeviceMemoryAccounting::PrintReport(int deviceId)
+{
+}
+
+const char* DeviceMemoryAccounting::TagName(MemoryTag tag)
+{
+    return "Other";
+}
+
+void ComputeStreams::Select(int deviceId, size_t stream)
+{
+}
+
+void ComputeStreams::RecordEvent(int deviceId, size_t event)
+{
+}
+
+void ComputeStreams::WaitEvent(int deviceId, size_t event)
+{
+}
+
+void ComputeStreams::Join(int deviceId)
+{
+}
+
+void ComputeTimingEvents::Record(int deviceId, size_t event)
+{
+}
+
+float ComputeTimingEvents::ElapsedMilliseconds(int deviceId, size_t fromEvent, size_t toEvent)
+{
+    return -1;
+}
+
+bool ComputeGraphs::IsSupported(int deviceId)
+{
+    return false;
+}
+
+void ComputeGraphs::BeginCapture(int deviceId)
+{
+}
+
+void* ComputeGraphs::EndCapture(int deviceId)
+{
+    return nullptr;
+}
+
+void ComputeGraphs::Launch(int deviceId, void* graph)
+{
+}
+
+void ComputeGraphs::Destroy(void* graph)
+{
+}
+
+size_t ComputeGraphs::GetAllocationCount()
+{
+    return 0;
+}
+
+void ComputeTransfers::CopyToHost(int deviceId, void* host, const void* device, size_t bytes, size_t event)
+{
+}
+
+void ComputeTransfers::CopyToDevice(int deviceId, void* device, const void* host, size_t bytes, size_t event)
+{
+}
+
+void ComputeTransfers::WaitForTransfer(int deviceId, size_t event)
+{
+}
+
 template <class ElemType>
 GPUSPARSE_INDEX_TYPE GPUSparseMatrix<ElemType>::SecondaryIndexValueAt(size_t idx) const
 {
@@ -146,6 +262,11 @@ GPUMatrix<ElemType> GPUSparseMatrix<ElemType>::CopyToDenseMatrix() const
     GPUMatrix<ElemType> res(0);
     return res;
 }
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::CopyOneHotIndicesTo(GPUMatrix<ElemType>& /*indices*/) const
+{
+}
+
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::CopyToDenseMatrix(GPUMatrix<ElemType>& denseMatrix) const
 {
@@ -176,6 +297,12 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
 {
 }
 
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromCOOFormat(const CPUSPARSE_INDEX_TYPE* h_Col, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                                       const size_t nz, const size_t numRows, const size_t numCols)
+{
+}
+
 // forward pass from feature to hidden layer
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const bool transposeA,
@@ -212,8 +339,15 @@ ElemType GPUSparseMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& c, const bool n
 {
     return 1;
 }
-//template<class ElemType>
-//void GPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>&, ElemType, ElemType, ElemType, ElemType) { }
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul)
+{
+}
+template <class ElemType>
+ElemType GPUSparseMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier)
+{
+    return 1;
+}
 
 #ifdef NO_SYNC
 template <class ElemType>
@@ -648,6 +782,22 @@ void GPUSparseMatrix<ElemType>::GetMatrixFromCSCFormat(CPUSPARSE_INDEX_TYPE*& h_
 {
 }
 
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::GetSparseBlockColData(std::vector<size_t>& columnIds, std::vector<ElemType>& values) const
+{
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetSparseBlockColData(const size_t numRows, const size_t numCols, const std::vector<size_t>& columnIds, const std::vector<ElemType>& values)
+{
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromBSRFormat(const CPUSPARSE_INDEX_TYPE* h_blockRowStarts, const CPUSPARSE_INDEX_TYPE* h_blockCols, const ElemType* h_blockValues,
+                                                       const size_t numBlocks, const size_t blockDim, const size_t numRows, const size_t numCols)
+{
+}
+
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::ConvertToSparseFormat(MatrixFormat newFormat)
 {
@@ -909,6 +1059,16 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddToRowRepeatValuesOf(const GPUMatrix
 {
     return *this;
 }
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignRowStackedColumnsOf(const GPUMatrix<ElemType>& /*a*/, const GPUMatrix<ElemType>& /*sourceColumns*/)
+{
+    return *this;
+}
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddFromRowStackedColumnsOf(const GPUMatrix<ElemType>& /*a*/, const GPUMatrix<ElemType>& /*sourceColumns*/)
+{
+    return *this;
+}
 
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignPositiveAndShiftedNegSample(const GPUMatrix<ElemType>& a, const size_t posNumber, const size_t negNumber, const size_t shiftNumber)
@@ -982,6 +1142,11 @@ void GPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, i
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::SetValueFromCompact(const size_t numRows, const size_t numCols, int deviceId, const void* pArray, CompactElementType type, ElemType scale, const ElemType* d_rowShift)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::SetDiagonalValue(const ElemType v)
 {
@@ -1009,6 +1174,11 @@ void GPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed)
+{
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
@@ -1025,6 +1195,23 @@ ElemType GPUMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& gradients, ElemType R
     return 0;
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::LarsUpdate(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRate, ElemType momentum, ElemType trustCoefficient)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::LambUpdate(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRate, ElemType beta1, ElemType beta2, ElemType epsilon, ElemType weightDecay)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::MultiTensorNormalGrad(const std::vector<GPUMatrix<ElemType>*>& functionValues, const std::vector<GPUMatrix<ElemType>*>& gradients, const std::vector<GPUMatrix<ElemType>*>& smoothedGradients,
+                                                ElemType learnRatePerSample, ElemType momentum, bool useNesterovMomentum,
+                                                ElemType clippingThreshold, bool clipByTruncation, ElemType l2Weight, ElemType l1Threshold)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Reshape(const size_t numRows, const size_t numCols)
 {
@@ -1212,6 +1399,12 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddElementProductOf(const GPUMatrix<El
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddDropoutOf(const GPUMatrix<ElemType>& /*a*/, const ElemType /*beta*/, const ElemType /*dropoutRate*/, unsigned long /*seed*/, size_t /*offset*/)
+{
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::ColumnElementMultiplyWith(const GPUMatrix<ElemType>& /*a*/)
 {
@@ -1497,6 +1690,18 @@ void GPUMatrix<ElemType>::ConductRowElementMultiplyWithShift(const GPUMatrix<Ele
 {
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCosDistanceWithShiftNeg(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB, const size_t shift, const size_t nt)
+{
+    return (*this);
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddCosDistanceWithShiftNegGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& cosDistance, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB,
+                                                             const size_t shift, const size_t nt, const bool wrtB, GPUMatrix<ElemType>& inputGradient)
+{
+}
+
 template <class ElemType>
 DeviceBoundNumber<ElemType> GPUMatrix<ElemType>::Sum_AsDeviceBoundNum() const
 {
@@ -1614,6 +1819,12 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignFrobeniusNormOf(const GPUMatrix<
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::ClipFrobeniusNorm(ElemType /*maxNorm*/, GPUMatrix<ElemType>& /*norm*/)
+{
+    return *this;
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::MatrixNormInf() const
 {
@@ -1761,6 +1972,11 @@ void GPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix
 {
 }
 template <class ElemType>
+void GPUMatrix<ElemType>::BatchMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& /*a*/, const bool transposeA, const GPUMatrix<ElemType>& /*b*/, const bool transposeB,
+                                                      ElemType beta, GPUMatrix<ElemType>& c, size_t batchSize)
+{
+}
+template <class ElemType>
 void GPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const GPUMatrix<ElemType>& rhs, ElemType beta, GPUMatrix<ElemType>& c)
 {
 }
@@ -1849,6 +2065,35 @@ void GPUMatrix<ElemType>::AssignScaledDifference(const GPUMatrix<ElemType>& /*al
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::SoftmaxCrossEntropy(const GPUMatrix<ElemType>& /*labels*/, const GPUMatrix<ElemType>& /*prediction*/, GPUMatrix<ElemType>& /*columnStats*/)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::SoftmaxCrossEntropyBackprop(const GPUMatrix<ElemType>& /*alpha*/, const GPUMatrix<ElemType>& /*labels*/, const GPUMatrix<ElemType>& /*prediction*/,
+                                                      const GPUMatrix<ElemType>& /*columnStats*/, GPUMatrix<ElemType>& /*predictionGradient*/)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::HierarchicalSoftmax(const GPUMatrix<ElemType>& /*labels*/, const GPUMatrix<ElemType>& /*hidden*/, const GPUMatrix<ElemType>& /*weights*/, const GPUMatrix<ElemType>& /*paths*/,
+                                              GPUMatrix<ElemType>& /*frameLosses*/, GPUMatrix<ElemType>& /*pathGradients*/)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::HierarchicalSoftmaxBackpropHidden(const GPUMatrix<ElemType>& /*alpha*/, const GPUMatrix<ElemType>& /*labels*/, const GPUMatrix<ElemType>& /*weights*/, const GPUMatrix<ElemType>& /*paths*/,
+                                                            const GPUMatrix<ElemType>& /*pathGradients*/, GPUMatrix<ElemType>& /*hiddenGradient*/)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::HierarchicalSoftmaxBackpropWeights(const GPUMatrix<ElemType>& /*alpha*/, const GPUMatrix<ElemType>& /*labels*/, const GPUMatrix<ElemType>& /*hidden*/, const GPUMatrix<ElemType>& /*paths*/,
+                                                             const GPUMatrix<ElemType>& /*pathGradients*/, GPUMatrix<ElemType>& /*weightsGradient*/)
+{
+}
+
 //c[ci,cj] += a[ai,aj]
 template <class ElemType>
 void GPUMatrix<ElemType>::AddElementToElement(const GPUMatrix<ElemType>& /*a*/, const size_t ai, const size_t aj, GPUMatrix<ElemType>& c, const size_t ci, const size_t cj)
@@ -1910,21 +2155,21 @@ void GPUMatrix<ElemType>::TensorShuffleScaleAndAdd(ElemType keepWeight, const GP
 }
 
 template <class ElemType>
-void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, ElemType alpha, ElementWiseOperator op,
+void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 2>& offsets,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 2>& reducingStrides)
 {
 }
 template <class ElemType>
-void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType alpha, ElementWiseOperator op,
+void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 3>& offsets,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 3>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 3>& reducingStrides)
 {
 }
 template <class ElemType>
-void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& c, ElemType alpha, ElementWiseOperator op,
+void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& c, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                    const array<size_t, 4>& offsets,
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides)
@@ -1932,15 +2177,28 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
 }
 
 template <class ElemType>
-void GPUMatrix<ElemType>::CreateCurandObject(unsigned long seed, const char* caller)
+void GPUMatrix<ElemType>::ElementWiseProgramOp(const ElementWiseProgram& program, const ElemType* const* inputs, ElemType* const* outputs, size_t numElements, DEVICEID_TYPE deviceId)
 {
 }
 
 template <class ElemType>
-void GPUMatrix<ElemType>::ResetCurandObject(unsigned long seed, const char* caller)
+void GPUMatrix<ElemType>::LSTMForwardStep(GPUMatrix<ElemType>& gates, const GPUMatrix<ElemType>& prevCell, GPUMatrix<ElemType>& cell, GPUMatrix<ElemType>& output)
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::LSTMBackwardStep(const GPUMatrix<ElemType>& gates, const GPUMatrix<ElemType>& prevCell, const GPUMatrix<ElemType>& cell,
+                                           const GPUMatrix<ElemType>& outputGradient, GPUMatrix<ElemType>& cellGradient, GPUMatrix<ElemType>& gatesGradient)
+{
+}
+
+template <class ElemType>
+bool GPUMatrix<ElemType>::LSTMForwardSequence(const GPUMatrix<ElemType>& R, GPUMatrix<ElemType>& gates, const GPUMatrix<char>& resetMask,
+                                              GPUMatrix<ElemType>& prevOutput, GPUMatrix<ElemType>& prevCell, GPUMatrix<ElemType>& cell, GPUMatrix<ElemType>& output, size_t S)
+{
+    return false;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType> GPUMatrix<ElemType>::Ones(const size_t rows, const size_t cols, int deviceId)
 {
@@ -2007,6 +2265,58 @@ void GPUMatrix<ElemType>::RCRFTransGrdCompute(const GPUMatrix<ElemType>& lbls,
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::CRFForwardBackward(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& posScores, const GPUMatrix<ElemType>& pairScores,
+                                             GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& sequenceScores,
+                                             const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::CRFTransitionGradient(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& posScores, const GPUMatrix<ElemType>& pairScores,
+                                                const GPUMatrix<ElemType>& alpha, const GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& grd,
+                                                const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::ViterbiDecode(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& posScores, const GPUMatrix<ElemType>& pairScores,
+                                        GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& backtrace, GPUMatrix<ElemType>& decodedPath,
+                                        const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::DenominatorForwardBackward(const GPUMatrix<ElemType>& logLikelihoods, const GPUMatrix<ElemType>& arcs, const GPUMatrix<ElemType>& states,
+                                                     GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& posteriors, GPUMatrix<ElemType>& logDenominators,
+                                                     const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::ClassConditionalLogSoftmax(const GPUMatrix<ElemType>& hidden, const GPUMatrix<ElemType>& weights, const GPUMatrix<ElemType>& frames, const size_t totalNumWords,
+                                                     GPUMatrix<ElemType>& logSoftmax, GPUMatrix<ElemType>& targetLogProbs)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::ClassConditionalSoftmaxGradient(const GPUMatrix<ElemType>& logSoftmax, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& frames,
+                                                          GPUMatrix<ElemType>& grd)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddClassConditionalHiddenGradient(const GPUMatrix<ElemType>& weights, const GPUMatrix<ElemType>& grd, const GPUMatrix<ElemType>& frames,
+                                                            GPUMatrix<ElemType>& hiddenGradient)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddClassConditionalWeightGradient(const GPUMatrix<ElemType>& hidden, const GPUMatrix<ElemType>& grd, const GPUMatrix<ElemType>& frames,
+                                                            const GPUMatrix<ElemType>& classes, GPUMatrix<ElemType>& weightGradient)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::AssignNoiseContrastiveEstimation(const GPUMatrix<ElemType>& a,
                                                            const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& bias, size_t sampleCount, GPUMatrix<ElemType>& tmp, GPUMatrix<ElemType>& c)
@@ -2080,13 +2390,17 @@ template <>
 void GPUMatrixComputeStreamEvent::SynchronizeDataTransferFetchStreamWithEvent<float>(){};
 template <>
 void GPUMatrixComputeStreamEvent::SynchronizeDataTransferFetchStreamWithEvent<double>(){};
+template <>
+void GPUMatrixComputeStreamEvent::SynchronizeDataTransferAssignStreamWithEvent<float>(){};
+template <>
+void GPUMatrixComputeStreamEvent::SynchronizeDataTransferAssignStreamWithEvent<double>(){};
 
 #pragma endregion GPUMatrixComputeStreamEvent functions
 
 #pragma region GPUDataTransferer functions
 
 template <class ElemType>
-GPUDataTransferer<ElemType>::GPUDataTransferer(int, bool)
+GPUDataTransferer<ElemType>::GPUDataTransferer(int, bool, bool)
 {
 }
 
@@ -2115,6 +2429,11 @@ void GPUDataTransferer<ElemType>::WaitForCopyCPUToGPUAsync()
 {
 }
 
+template <class ElemType>
+void GPUDataTransferer<ElemType>::SynchronizeAssignStreamWithComputeStream()
+{
+}
+
 #pragma endregion GPUDataTransferer functions
 
 template class GPUMatrix<char>;
@@ -2133,9 +2452,6 @@ template class GPUDataTransferer<double>;
 template <class ElemType>
 cublasHandle_t GPUMatrix<ElemType>::s_cuHandle[GPUMatrix<ElemType>::MaxGpus] = {0};
 
-template <class ElemType>
-void* GPUMatrix<ElemType>::s_curandGenerator = NULL;
-
 template <class ElemType>
 typename CuDnnConvolutionEngineFactory<ElemType>::Tensor4DPtr CuDnnConvolutionEngineFactory<ElemType>::CreateTensor(size_t, size_t, size_t, size_t)
 {
@@ -2199,6 +2515,11 @@ size_t GPUWatcher::GetFreeMemoryOnCUDADevice(int /*devId*/)
     return 0;
 }
 
+GPUTelemetrySample GPUWatcher::GetTelemetryOfCUDADevice(int /*devId*/)
+{
+    return GPUTelemetrySample();
+}
+
 GPUWatcher::GPUWatcher(void)
 {
 }
@@ -179,6 +179,18 @@ void QuantizedMatrix<ElemType>::Print(const char* matrixName, size_t rowStart, s
     }
 }
 
+template <class ElemType>
+/*static*/ size_t QuantizedMatrix<ElemType>::SelectNumBits(size_t numRows, size_t numCols, size_t nbits, size_t minElementsToQuantize)
+{
+    if ((nbits == 0) || (((QWordNumBits / nbits) * nbits) != QWordNumBits))
+        InvalidArgument("Quantization: 'nbits' must be a divisor of %d", (int) QWordNumBits);
+
+    if (numRows * numCols < minElementsToQuantize)
+        return QWordNumBits;
+
+    return nbits;
+}
+
 // Explicit instantiation
 template class QuantizedMatrix<float>;
 template class QuantizedMatrix<double>;
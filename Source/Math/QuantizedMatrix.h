@@ -95,6 +95,16 @@ public:
 
     QuantizedMatrix<ElemType> ColumnSlice(size_t startColumn, size_t numCols) const;
 
+    // bytes taken by a quantized matrix, so that matrices of different bit widths can be packed into one exchange buffer
+    static size_t QuantizedSize(size_t numRows, size_t numCols, size_t nbits)
+    {
+        return QuantizedColumn<ElemType>::QuantizedColumnSize(nbits, numRows) * numCols;
+    }
+
+    // per-matrix bit width for a quantized exchange, given the configured 'nbits': matrices with fewer than
+    // 'minElementsToQuantize' elements are not worth quantizing; they get the full QWordNumBits, i.e. are sent as they are
+    static size_t SelectNumBits(size_t numRows, size_t numCols, size_t nbits, size_t minElementsToQuantize);
+
     void Print(const char* matrixName, size_t rowStart, size_t rowEnd, size_t colStart, size_t colEnd);
 
 private:
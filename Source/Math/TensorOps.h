@@ -230,6 +230,36 @@ DefBinaryOp(ElementwiseProductWithCosDerivative, a * -sin_(b)); // note: b = inp
 
 #pragma pop_macro("DefBinaryOp")
 
+// -----------------------------------------------------------------------
+// reduction ops: how the values along reduced (inverse-broadcasting) dimensions get aggregated
+// TensorOp() supports opSum, opLogSum, opMax, and opMin; a mean is a sum with alpha = 1/(number of values).
+// -----------------------------------------------------------------------
+
+// the value to start a reduction with
+template <class ElemType>
+DECL ElemType NeutralValue(ElementWiseOperator reductionOp)
+{
+    switch (reductionOp)
+    {
+    case ElementWiseOperator::opLogSum: return (ElemType) LZERO;
+    case ElementWiseOperator::opMax:    return (ElemType) -INFINITY;
+    case ElementWiseOperator::opMin:    return (ElemType) INFINITY;
+    default:                            return 0; // opSum
+    }
+}
+
+template <class ElemType>
+DECL ElemType Aggregate(ElemType aggregate, ElemType val, ElementWiseOperator reductionOp)
+{
+    switch (reductionOp)
+    {
+    case ElementWiseOperator::opLogSum: return OpLogSum(aggregate, val);
+    case ElementWiseOperator::opMax:    return OpMax(aggregate, val);
+    case ElementWiseOperator::opMin:    return OpMin(aggregate, val);
+    default:                            return aggregate + val; // opSum
+    }
+}
+
 #pragma push_macro("DefTernaryOp")
 #define DefTernaryOp(op, expr)                               \
     template <class ElemType>                                \
@@ -241,6 +271,197 @@ DefBinaryOp(ElementwiseProductWithCosDerivative, a * -sin_(b)); // note: b = inp
 DefTernaryOp(Cond, a ? b : c);
 DefTernaryOp(Clip, a < b ? b : (a > c ? c : a));
 #pragma pop_macro("DefTernaryOp")
+
+// -----------------------------------------------------------------------
+// ElementWiseProgram (CommonMatrix.h) interpreter
+//
+// Executes all instructions of a fused program for one element index.
+// Used by both the CPU loop and the CUDA kernel.
+// -----------------------------------------------------------------------
+
+// apply any ElementWiseOperator to argument values; arguments beyond the op's arity are ignored
+template <class ElemType>
+DECL ElemType ComputeElementWiseOp(ElementWiseOperator op, ElemType a, ElemType b, ElemType c)
+{
+#pragma push_macro("CaseNullaryOp")
+#pragma push_macro("CaseUnaryOp")
+#pragma push_macro("CaseBinaryOp")
+#pragma push_macro("CaseTernaryOp")
+#define CaseNullaryOp(oper)             \
+    case ElementWiseOperator::op##oper: \
+        return Op##oper<ElemType>()
+#define CaseUnaryOp(oper)               \
+    case ElementWiseOperator::op##oper: \
+        return Op##oper(a)
+#define CaseBinaryOp(oper)              \
+    case ElementWiseOperator::op##oper: \
+        return Op##oper(a, b)
+#define CaseTernaryOp(oper)             \
+    case ElementWiseOperator::op##oper: \
+        return Op##oper(a, b, c)
+    switch (op)
+    {
+        ForAllNullaryOps(CaseNullaryOp);
+        ForAllUnaryOps(CaseUnaryOp);
+        ForAllBinaryOps(CaseBinaryOp);
+        ForAllTernaryOps(CaseTernaryOp);
+    default:
+        return 0; // (failure; the program was validated when it was built)
+    }
+#pragma pop_macro("CaseTernaryOp")
+#pragma pop_macro("CaseBinaryOp")
+#pragma pop_macro("CaseUnaryOp")
+#pragma pop_macro("CaseNullaryOp")
+}
+
+template <class ElemType>
+DECL void ExecuteElementWiseProgram(const ElementWiseProgram& program, const ElemType* const* inputs, ElemType* const* outputs, size_t index)
+{
+    ElemType registers[ElementWiseProgram::maxInputs + ElementWiseProgram::maxInstructions];
+    for (int k = 0; k < program.numInputs; k++)
+        registers[k] = inputs[k][index];
+    // Outputs are stored in instruction order, so if outputs alias, the last one wins.
+    // Inputs are all read before anything is stored, so an output may alias an input.
+    for (int k = 0; k < program.numInstructions; k++)
+    {
+        const ElementWiseInstruction& instruction = program.instructions[k];
+        ElemType value = ComputeElementWiseOp(instruction.op, registers[instruction.args[0]], registers[instruction.args[1]], registers[instruction.args[2]]);
+        registers[program.numInputs + k] = value;
+        if (instruction.output >= 0)
+            outputs[instruction.output][index] = value;
+    }
+}
+
+// -----------------------------------------------------------------------
+// LSTM cell step, for element 'index' of an [N x S] cell/output column slice
+// Each column of 'gates' stacks the pre-activations of the four gates as row blocks [input; forget; output; cell candidate].
+// Forward replaces them in place by their activations, which is what the backward step needs.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+DECL void LSTMForwardStepAt(size_t index, size_t N, ElemType* gates, const ElemType* prevCell, ElemType* cell, ElemType* output)
+{
+    ElemType* z = gates + (index / N) * 4 * N + index % N;
+    const ElemType i = Sigmoid(z[0]);
+    const ElemType f = Sigmoid(z[N]);
+    const ElemType o = Sigmoid(z[2 * N]);
+    const ElemType g = tanh_(z[3 * N]);
+    z[0] = i;
+    z[N] = f;
+    z[2 * N] = o;
+    z[3 * N] = g;
+    const ElemType c = f * prevCell[index] + i * g;
+    cell[index] = c;
+    output[index] = o * tanh_(c);
+}
+
+// 'cellGradient' comes in as the gradient from the next time step and goes out as the gradient for the previous one
+template <class ElemType>
+DECL void LSTMBackwardStepAt(size_t index, size_t N, const ElemType* gates, const ElemType* prevCell, const ElemType* cell, const ElemType* outputGradient, ElemType* cellGradient, ElemType* gatesGradient)
+{
+    const size_t offset = (index / N) * 4 * N + index % N;
+    const ElemType* a = gates + offset;
+    ElemType* dz = gatesGradient + offset;
+    const ElemType i = a[0], f = a[N], o = a[2 * N], g = a[3 * N];
+    const ElemType tc = tanh_(cell[index]);
+    const ElemType dh = outputGradient[index];
+    const ElemType dc = cellGradient[index] + dh * o * (1 - tc * tc);
+    dz[0] = dc * g * i * (1 - i);
+    dz[N] = dc * prevCell[index] * f * (1 - f);
+    dz[2 * N] = dh * tc * o * (1 - o);
+    dz[3 * N] = dc * i * (1 - g * g);
+    cellGradient[index] = dc * f;
+}
+
+// -----------------------------------------------------------------------
+// counter-based random numbers: Philox4x32-10 [Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC 2011]
+// Each counter value yields four 32-bit random numbers that only depend on it and on the key, so that any element of
+// a random sequence can be computed independently of all others, on the CPU and on the GPU alike.
+// -----------------------------------------------------------------------
+
+DECL void Philox4x32(unsigned int counter[4], unsigned int key0, unsigned int key1)
+{
+    for (int round = 0; round < 10; round++)
+    {
+        const unsigned long long p0 = 0xD2511F53ull * counter[0];
+        const unsigned long long p1 = 0xCD9E8D57ull * counter[2];
+        const unsigned int c1 = counter[1], c3 = counter[3];
+        counter[0] = (unsigned int) (p1 >> 32) ^ c1 ^ key0;
+        counter[1] = (unsigned int) p1;
+        counter[2] = (unsigned int) (p0 >> 32) ^ c3 ^ key1;
+        counter[3] = (unsigned int) p0;
+        key0 += 0x9E3779B9;
+        key1 += 0xBB67AE85;
+    }
+}
+
+// the four random words of block 'block' of the sequence that 'seed' determines
+DECL void PhiloxBlock(unsigned long long seed, unsigned long long block, unsigned int words[4])
+{
+    words[0] = (unsigned int) block;
+    words[1] = (unsigned int) (block >> 32);
+    words[2] = 0;
+    words[3] = 0;
+    Philox4x32(words, (unsigned int) seed, (unsigned int) (seed >> 32));
+}
+
+// dropout mask of element 'index' of the sequence that 'seed' determines: 0 with probability 'dropoutRate', 'scale' otherwise
+// Forward prop and backprop compute it alike, so it need not be stored.
+template <class ElemType>
+DECL ElemType DropoutMaskAt(unsigned long long seed, unsigned long long index, ElemType dropoutRate, ElemType scale)
+{
+    unsigned int words[4];
+    PhiloxBlock(seed, index / 4, words);
+    const float u = words[index % 4] * 2.3283064e-10f; // in [0,1]
+    return u <= (float) dropoutRate ? 0 : scale;
+}
+
+// uniform random numbers in (0,1) from 23 resp. 52 random bits; the conversion is exact, so all devices get the same values
+DECL float UniformFromWords(unsigned int w)
+{
+    return ((w >> 9) + 0.5f) * 1.1920929e-7f; // 2^-23
+}
+DECL double UniformFromWords(unsigned int w0, unsigned int w1)
+{
+    return ((((unsigned long long) w0 << 20) | (w1 >> 12)) + 0.5) * 2.220446049250313e-16; // 2^-52
+}
+
+// element 'index' of the uniform sequence that 'seed' determines, in (0,1)
+// Floats take one word each (four elements per block), doubles two.
+template <class ElemType>
+DECL ElemType UniformRandomAt(unsigned long long seed, unsigned long long index)
+{
+    unsigned int words[4];
+    if (sizeof(ElemType) == sizeof(float))
+    {
+        PhiloxBlock(seed, index / 4, words);
+        return (ElemType) UniformFromWords(words[index % 4]);
+    }
+    PhiloxBlock(seed, index / 2, words);
+    return (ElemType) UniformFromWords(words[2 * (index % 2)], words[2 * (index % 2) + 1]);
+}
+
+// element 'index' of the standard normal sequence that 'seed' determines, by Box-Muller from two uniforms
+// Unlike the uniforms, these go through log() and cos(), and thus agree across devices only up to their rounding.
+template <class ElemType>
+DECL ElemType GaussianRandomAt(unsigned long long seed, unsigned long long index)
+{
+    unsigned int words[4];
+    ElemType u1, u2;
+    if (sizeof(ElemType) == sizeof(float))
+    {
+        PhiloxBlock(seed, index / 2, words);
+        u1 = (ElemType) UniformFromWords(words[2 * (index % 2)]);
+        u2 = (ElemType) UniformFromWords(words[2 * (index % 2) + 1]);
+    }
+    else
+    {
+        PhiloxBlock(seed, index, words);
+        u1 = (ElemType) UniformFromWords(words[0], words[1]);
+        u2 = (ElemType) UniformFromWords(words[2], words[3]);
+    }
+    return sqrt_(-2 * log_(u1)) * cos_((ElemType) 6.283185307179586 * u2);
+}
 }
 }
 }
@@ -23,6 +23,7 @@
 #include "Basics.h"
 #include "TensorView.h"
 #include <array>
+#include <mutex>
 
 #ifndef let
 #define let const auto
@@ -216,6 +217,96 @@ static void PrepareTensorOperands(array<TensorShape, N> shapes, array<size_t, N>
         offsets[i] = shapes[i].GetOffset();
 }
 
+// -------------------------------------------------------------------
+// plan cache for PrepareTensorOperands()
+// Nodes issue the same tensor operations on the same shapes for every minibatch (and time step) of an unchanged layout,
+// so the flattened dims and strides are kept per combination of operand dims and strides, in a small direct-mapped
+// table per arity. Offsets (e.g. of time steps) take no part: they pass through PrepareTensorOperands() unchanged.
+// Failing operand checks throw before anything is stored.
+// -------------------------------------------------------------------
+
+template <size_t N>
+struct TensorOperandsPlan
+{
+    bool valid;
+    array<SmallVector<size_t>, N> dims; // (key)
+    array<SmallVector<ptrdiff_t>, N> strides;
+    SmallVector<size_t> regularOpDims, reducingOpDims;
+    array<SmallVector<ptrdiff_t>, N> regularStrides, reducingStrides;
+
+    TensorOperandsPlan()
+        : valid(false)
+    {
+    }
+    bool Matches(const array<TensorShape, N>& shapes) const
+    {
+        if (!valid)
+            return false;
+        for (size_t i = 0; i < N; i++)
+            if (dims[i] != shapes[i].GetDims() || strides[i] != shapes[i].GetStrides())
+                return false;
+        return true;
+    }
+};
+
+template <size_t N>
+static size_t HashTensorOperands(const array<TensorShape, N>& shapes)
+{
+    size_t hash = N;
+    for (size_t i = 0; i < N; i++)
+    {
+        const auto& dims = shapes[i].GetDims();
+        const auto& strides = shapes[i].GetStrides();
+        for (size_t k = 0; k < dims.size(); k++)
+            hash = (hash * 31 + dims[k]) * 31 + (size_t) strides[k];
+        hash = hash * 31 + dims.size();
+    }
+    return hash ^ (hash >> 17);
+}
+
+template <class ElemType, size_t N>
+static void PrepareTensorOperandsCached(const array<TensorShape, N>& shapes, array<size_t, N>& offsets,
+                                        SmallVector<size_t>& regularOpDims,
+                                        array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                        SmallVector<size_t>& reducingOpDims,
+                                        array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    static const size_t tableSize = 128;
+    static TensorOperandsPlan<N> table[tableSize];
+    static mutex tableMutex;
+
+    for (size_t i = 0; i < N; i++)
+        offsets[i] = shapes[i].GetOffset();
+
+    auto& plan = table[HashTensorOperands(shapes) % tableSize];
+    {
+        lock_guard<mutex> lock(tableMutex);
+        if (plan.Matches(shapes))
+        {
+            regularOpDims = plan.regularOpDims;
+            reducingOpDims = plan.reducingOpDims;
+            regularStrides = plan.regularStrides;
+            reducingStrides = plan.reducingStrides;
+            return;
+        }
+    }
+
+    array<size_t, N> planOffsets;
+    PrepareTensorOperands<ElemType, N>(shapes, planOffsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+
+    lock_guard<mutex> lock(tableMutex);
+    for (size_t i = 0; i < N; i++)
+    {
+        plan.dims[i] = shapes[i].GetDims();
+        plan.strides[i] = shapes[i].GetStrides();
+    }
+    plan.regularOpDims = regularOpDims;
+    plan.reducingOpDims = reducingOpDims;
+    plan.regularStrides = regularStrides;
+    plan.reducingStrides = reducingStrides;
+    plan.valid = true;
+}
+
 // enforce that in case of broadcasting, the output must not be an input
 template <class ElemType>
 static bool CheckDifferentObject(const TensorView<ElemType>& a, const TensorView<ElemType>& b)
@@ -225,8 +316,17 @@ static bool CheckDifferentObject(const TensorView<ElemType>& a, const TensorView
     return true;
 }
 
+// enforce that the reduction op is one that TensorOp() knows to aggregate with (see Aggregate() in TensorOps.h)
+static bool CheckReductionOp(ElementWiseOperator reductionOp)
+{
+    if (reductionOp != ElementWiseOperator::opSum && reductionOp != ElementWiseOperator::opLogSum &&
+        reductionOp != ElementWiseOperator::opMax && reductionOp != ElementWiseOperator::opMin)
+        InvalidArgument("Do{U,Bi,Ter}naryOpOf: Op code %d cannot be used for reduction.", (int) reductionOp);
+    return true;
+}
+
 template <class ElemType>
-void TensorView<ElemType>::DoUnaryOpOf(ElemType beta, const TensorView& a, ElemType alpha, ElementWiseOperator op)
+void TensorView<ElemType>::DoUnaryOpOf(ElemType beta, const TensorView& a, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp)
 {
     // static int cc = 0; if (cc++ == 0)
     //    fprintf(stderr, "Tensor Op: Op %d: %s -> %s\n", (int)op, string(a.GetShape()).c_str(), string(GetShape()).c_str());
@@ -235,18 +335,18 @@ void TensorView<ElemType>::DoUnaryOpOf(ElemType beta, const TensorView& a, ElemT
     array<size_t, 2> offsets;
     array<SmallVector<ptrdiff_t>, 2> regularStrides, reducingStrides;
     SmallVector<size_t> regularOpDims, reducingOpDims;
-    PrepareTensorOperands<ElemType, 2>(array<TensorShape, 2>{a.GetShape(), GetShape()}, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    PrepareTensorOperandsCached<ElemType, 2>(array<TensorShape, 2>{a.GetShape(), GetShape()}, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 
-    // output cannot be input when reducing
+    // output cannot be input when reducing, and only some ops can reduce
     if (reducingOpDims.size() > 0)
-        CheckDifferentObject(a, *this);
+        CheckReductionOp(reductionOp) && CheckDifferentObject(a, *this);
 
     // now perform the operation
-    GetSOB().TensorOp(beta, a.GetSOB(), alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    GetSOB().TensorOp(beta, a.GetSOB(), alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
 template <class ElemType>
-void TensorView<ElemType>::DoBinaryOpOf(ElemType beta, const TensorView& a, const TensorView& b, ElemType alpha, ElementWiseOperator op)
+void TensorView<ElemType>::DoBinaryOpOf(ElemType beta, const TensorView& a, const TensorView& b, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp)
 {
     // static int cc = 0; if (cc++ == 0)
     //    fprintf(stderr, "Tensor Op: Op %d: %s op %s -> %s\n", (int)op, string(a.GetShape()).c_str(), string(b.GetShape()).c_str(), string(GetShape()).c_str());
@@ -254,17 +354,17 @@ void TensorView<ElemType>::DoBinaryOpOf(ElemType beta, const TensorView& a, cons
     array<size_t, 3> offsets;
     array<SmallVector<ptrdiff_t>, 3> regularStrides, reducingStrides;
     SmallVector<size_t> regularOpDims, reducingOpDims;
-    PrepareTensorOperands<ElemType, 3>(array<TensorShape, 3>{a.GetShape(), b.GetShape(), GetShape()}, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    PrepareTensorOperandsCached<ElemType, 3>(array<TensorShape, 3>{a.GetShape(), b.GetShape(), GetShape()}, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 
-    // output cannot be input when reducing
+    // output cannot be input when reducing, and only some ops can reduce
     if (reducingOpDims.size() > 0)
-        CheckDifferentObject(a, *this) && CheckDifferentObject(b, *this);
+        CheckReductionOp(reductionOp) && CheckDifferentObject(a, *this) && CheckDifferentObject(b, *this);
 
-    GetSOB().TensorOp(beta, a.GetSOB(), b.GetSOB(), alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    GetSOB().TensorOp(beta, a.GetSOB(), b.GetSOB(), alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
 template <class ElemType>
-void TensorView<ElemType>::DoTernaryOpOf(ElemType beta, const TensorView& a, const TensorView& b, const TensorView& c, ElemType alpha, ElementWiseOperator op)
+void TensorView<ElemType>::DoTernaryOpOf(ElemType beta, const TensorView& a, const TensorView& b, const TensorView& c, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp)
 {
     // static int cc = 0; if (cc++ == 0)
     //    fprintf(stderr, "Tensor Op: Op %d: %s, %s, %s -> %s\n", (int)op, string(a.GetShape()).c_str(), string(b.GetShape()).c_str(), string(c.GetShape()).c_str(), string(GetShape()).c_str());
@@ -272,13 +372,203 @@ void TensorView<ElemType>::DoTernaryOpOf(ElemType beta, const TensorView& a, con
     array<size_t, 4> offsets;
     array<SmallVector<ptrdiff_t>, 4> regularStrides, reducingStrides;
     SmallVector<size_t> regularOpDims, reducingOpDims;
-    PrepareTensorOperands<ElemType, 4>(array<TensorShape, 4>{a.GetShape(), b.GetShape(), c.GetShape(), GetShape()}, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    PrepareTensorOperandsCached<ElemType, 4>(array<TensorShape, 4>{a.GetShape(), b.GetShape(), c.GetShape(), GetShape()}, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 
-    // output cannot be input when reducing
+    // output cannot be input when reducing, and only some ops can reduce
     if (reducingOpDims.size() > 0)
-        CheckDifferentObject(a, *this) && CheckDifferentObject(b, *this) && CheckDifferentObject(c, *this);
+        CheckReductionOp(reductionOp) && CheckDifferentObject(a, *this) && CheckDifferentObject(b, *this) && CheckDifferentObject(c, *this);
+
+    GetSOB().TensorOp(beta, a.GetSOB(), b.GetSOB(), c.GetSOB(), alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+}
+
+// -------------------------------------------------------------------
+// tensor contraction
+// -------------------------------------------------------------------
+
+// the axis labels of the operands of a contraction, from an einsum-style spec such as "ik,kj->ij"
+struct ContractionLabels
+{
+    string a, b, c;
+};
+
+static bool Has(const string& labels, char label)
+{
+    return labels.find(label) != string::npos;
+}
+
+static ContractionLabels ParseContractionSpec(const string& spec)
+{
+    let comma = spec.find(',');
+    let arrow = spec.find("->");
+    if (comma == string::npos || arrow == string::npos || comma > arrow)
+        InvalidArgument("DoContractionOf: Invalid spec '%s', expected e.g. 'ik,kj->ij'.", spec.c_str());
+    ContractionLabels labels{spec.substr(0, comma), spec.substr(comma + 1, arrow - comma - 1), spec.substr(arrow + 2)};
+    for (let* operand : {&labels.a, &labels.b, &labels.c})
+    {
+        for (size_t k = 0; k < operand->size(); k++)
+        {
+            let label = (*operand)[k];
+            if (operand->find(label) != k)
+                InvalidArgument("DoContractionOf: '%c' labels two axes of one operand in '%s' (diagonals are not supported).", label, spec.c_str());
+        }
+    }
+    for (let label : labels.a + labels.b)
+        if (!Has(labels.b, label) && !Has(labels.c, label))
+            InvalidArgument("DoContractionOf: Axis '%c' of only one input in '%s' (sum over it first).", label, spec.c_str());
+    for (let label : labels.c)
+        if (!Has(labels.a, label) && !Has(labels.b, label))
+            InvalidArgument("DoContractionOf: Output axis '%c' is not an axis of the inputs in '%s'.", label, spec.c_str());
+    return labels;
+}
+
+// dimension of the axis with the label; axes beyond the rank are 1
+static size_t DimOf(const TensorShape& shape, const string& labels, char label)
+{
+    return shape.GetDimPadded(labels.find(label));
+}
+
+// test whether the axes of a tensor, in the given order, form a dense block
+static bool IsDenseInOrder(const TensorShape& shape, const string& labels, const string& order)
+{
+    ptrdiff_t stride = 1;
+    for (let label : order)
+    {
+        let k = labels.find(label);
+        let dim = shape.GetDimPadded(k);
+        if (dim == 1) // (any stride)
+            continue;
+        if (shape.GetStrides()[k] != stride)
+            return false;
+        stride *= (ptrdiff_t) dim;
+    }
+    return true;
+}
+
+static size_t ProductOfDims(const TensorShape& shape, const string& labels, const string& order)
+{
+    size_t product = 1;
+    for (let label : order)
+        product *= DimOf(shape, labels, label);
+    return product;
+}
+
+// reference to the dense block that a tensor occupies, as a [rows x cols] matrix
+template <class ElemType>
+static Matrix<ElemType> MatrixOfBlock(const Matrix<ElemType>& sob, const TensorShape& shape, size_t rows, size_t cols)
+{
+    return sob.Reshaped(1, sob.GetNumElements()).ColumnSlice(shape.GetOffset(), rows * cols).Reshaped(rows, cols);
+}
+
+template <class ElemType>
+void TensorView<ElemType>::DoContractionOf(ElemType beta, const TensorView& a, const TensorView& b, ElemType alpha, const string& spec)
+{
+    let labels = ParseContractionSpec(spec);
+    let& shapeA = a.GetShape();
+    let& shapeB = b.GetShape();
+    let& shapeC = GetShape();
+    for (let* operand : {&shapeA, &shapeB, &shapeC})
+    {
+        let& operandLabels = operand == &shapeA ? labels.a : operand == &shapeB ? labels.b : labels.c;
+        for (size_t k = operandLabels.size(); k < operand->GetRank(); k++)
+            if (operand->GetDim(k) != 1)
+                InvalidArgument("DoContractionOf: Tensor %s has more axes than '%s' names.", string(*operand).c_str(), spec.c_str());
+    }
+    for (let label : labels.a + labels.b + labels.c)
+    {
+        let dim = Has(labels.a, label) ? DimOf(shapeA, labels.a, label) : DimOf(shapeB, labels.b, label);
+        if ((Has(labels.b, label) && DimOf(shapeB, labels.b, label) != dim) || (Has(labels.c, label) && DimOf(shapeC, labels.c, label) != dim))
+            InvalidArgument("DoContractionOf: Axis '%c' of '%s' has different dimensions in %s, %s -> %s.", label, spec.c_str(), string(shapeA).c_str(), string(shapeB).c_str(), string(shapeC).c_str());
+    }
+
+    // group the axes as for a batch of GEMMs c[m,n,batch] = a[m,k,batch] * b[k,n,batch]
+    string m, n, k, batch;
+    for (let label : labels.a)
+        (Has(labels.b, label) ? (Has(labels.c, label) ? batch : k) : m).push_back(label);
+    for (let label : labels.b)
+        if (!Has(labels.a, label))
+            n.push_back(label);
+    let M = ProductOfDims(shapeA, labels.a, m);
+    let N = ProductOfDims(shapeB, labels.b, n);
+    let K = ProductOfDims(shapeA, labels.a, k);
+    let batchSize = ProductOfDims(shapeA, labels.a, batch);
+    if (M * N * batchSize == 0)
+        return;
+
+    let isDense = GetSOB().GetMatrixType() == DENSE && a.GetSOB().GetMatrixType() == DENSE && b.GetSOB().GetMatrixType() == DENSE;
+    let transposeA = !IsDenseInOrder(shapeA, labels.a, m + k + batch);
+    let transposeB = !IsDenseInOrder(shapeB, labels.b, k + n + batch);
+    let transposeC = !IsDenseInOrder(shapeC, labels.c, m + n + batch);
+    if (isDense &&
+        (!transposeA || IsDenseInOrder(shapeA, labels.a, k + m + batch)) &&
+        (!transposeB || IsDenseInOrder(shapeB, labels.b, n + k + batch)) &&
+        (!transposeC || IsDenseInOrder(shapeC, labels.c, n + m + batch)))
+    {
+        let matrixA = MatrixOfBlock(a.GetSOB(), shapeA, transposeA ? K : M, (transposeA ? M : K) * batchSize);
+        let matrixB = MatrixOfBlock(b.GetSOB(), shapeB, transposeB ? N : K, (transposeB ? K : N) * batchSize);
+        auto matrixC = MatrixOfBlock(GetSOB(), shapeC, transposeC ? N : M, (transposeC ? M : N) * batchSize);
+        if (!transposeC)
+            Matrix<ElemType>::BatchMultiplyAndWeightedAdd(alpha, matrixA, transposeA, matrixB, transposeB, beta, matrixC, batchSize);
+        else // c^T = b^T a^T
+            Matrix<ElemType>::BatchMultiplyAndWeightedAdd(alpha, matrixB, !transposeB, matrixA, !transposeA, beta, matrixC, batchSize);
+        return;
+    }
+
+    // otherwise line up all axes--those of c, then the summed ones--for c = sum over the singleton axes of c of a .* b
+    string axes = labels.c + k;
+    SmallVector<size_t> permutationA(axes.size()), permutationB(axes.size()), permutationC(axes.size());
+    for (size_t i = 0; i < axes.size(); i++)
+    {
+        permutationA[i] = labels.a.find(axes[i]); // (npos: a new singleton axis)
+        permutationB[i] = labels.b.find(axes[i]);
+        permutationC[i] = labels.c.find(axes[i]);
+    }
+    TensorView<ElemType> linedUpC(*this, TensorShape(shapeC).PermuteDimsInPlace(permutationC));
+    linedUpC.DoBinaryOpOf(beta, TensorView<ElemType>(a, TensorShape(shapeA).PermuteDimsInPlace(permutationA)), TensorView<ElemType>(b, TensorShape(shapeB).PermuteDimsInPlace(permutationB)),
+                          alpha, ElementWiseOperator::opElementwiseProduct, ElementWiseOperator::opSum);
+}
+
+// test whether a tensor is a dense, contiguous block without broadcasting, and has the same dimensions as 'ref'
+static bool IsDenseWithDims(const TensorShape& shape, const TensorShape& ref)
+{
+    size_t rank = max(shape.GetRank(), ref.GetRank());
+    for (size_t k = 0; k < rank; k++)
+        if (shape.GetDimPadded(k) != ref.GetDimPadded(k))
+            return false;
+    if (shape.GetRank() > 0 && shape.GetDim(0) != 1 && shape.GetStrides()[0] != 1)
+        return false;
+    for (size_t k = 1; k < shape.GetRank(); k++)
+        if (!shape.CanFlatten(k))
+            return false;
+    return true;
+}
+
+template <class ElemType>
+/*static*/ void TensorView<ElemType>::DoElementWiseProgramOf(const ElementWiseProgram& program, const vector<TensorView>& inputs, vector<TensorView>& outputs)
+{
+    if (outputs.empty())
+        InvalidArgument("DoElementWiseProgramOf: At least one output is required.");
+    const TensorShape& ref = outputs[0].GetShape();
+
+    vector<const Matrix<ElemType>*> inputSOBs;
+    vector<size_t> inputOffsets;
+    for (const auto& input : inputs)
+    {
+        if (!IsDenseWithDims(input.GetShape(), ref))
+            InvalidArgument("DoElementWiseProgramOf: Input %s does not match output %s or is not dense.", string(input.GetShape()).c_str(), string(ref).c_str());
+        inputSOBs.push_back(&input.GetSOB());
+        inputOffsets.push_back(input.GetShape().GetOffset());
+    }
+    vector<Matrix<ElemType>*> outputSOBs;
+    vector<size_t> outputOffsets;
+    for (auto& output : outputs)
+    {
+        if (!IsDenseWithDims(output.GetShape(), ref))
+            InvalidArgument("DoElementWiseProgramOf: Output %s does not match output %s or is not dense.", string(output.GetShape()).c_str(), string(ref).c_str());
+        outputSOBs.push_back(&output.GetSOB());
+        outputOffsets.push_back(output.GetShape().GetOffset());
+    }
 
-    GetSOB().TensorOp(beta, a.GetSOB(), b.GetSOB(), c.GetSOB(), alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    Matrix<ElemType>::ElementWiseProgramOp(program, inputSOBs, inputOffsets, outputSOBs, outputOffsets, ref.GetNumElements());
 }
 
 // simple test function for testing stuff
@@ -116,9 +116,55 @@ public:
 
     static void Test();
 
-    void DoUnaryOpOf(ElemType beta, const TensorView& a, ElemType alpha, ElementWiseOperator op);
-    void DoBinaryOpOf(ElemType beta, const TensorView& a, const TensorView& b, ElemType alpha, ElementWiseOperator op);
-    void DoTernaryOpOf(ElemType beta, const TensorView& a, const TensorView& b, const TensorView& c, ElemType alpha, ElementWiseOperator op);
+    // 'reductionOp' aggregates the values along the inverse-broadcasting dimensions: opSum, opLogSum, opMax, or opMin
+    void DoUnaryOpOf(ElemType beta, const TensorView& a, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp = ElementWiseOperator::opSum);
+    void DoBinaryOpOf(ElemType beta, const TensorView& a, const TensorView& b, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp = ElementWiseOperator::opSum);
+    void DoTernaryOpOf(ElemType beta, const TensorView& a, const TensorView& b, const TensorView& c, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp = ElementWiseOperator::opSum);
+
+    // -------------------------------------------------------------------
+    // reductions
+    // 'this' has dimensions of 1 where 'a' has larger ones, and those get reduced over, along any axes.
+    // E.g. with c=[1 x 20] and a=[10 x 20], c.AssignReductionOf(opMax, a) gives the maximum of each column,
+    // and c.AssignMeanOf(a) their means. To fuse an elementwise op with the reduction, use DoUnaryOpOf() etc.
+    // with a reductionOp, e.g. c.DoBinaryOpOf(0, a, b, 1, opElementwiseProduct, opSum) for column-wise dot products.
+    // -------------------------------------------------------------------
+
+    void DoReductionOf(ElemType beta, const TensorView& a, ElemType alpha, ElementWiseOperator reductionOp)
+    {
+        DoUnaryOpOf(beta, a, alpha, ElementWiseOperator::opCopy, reductionOp);
+    }
+    void AssignReductionOf(ElementWiseOperator reductionOp, const TensorView& a, ElemType alpha = 1.0f)
+    {
+        DoUnaryOpOf(0, a, alpha, ElementWiseOperator::opCopy, reductionOp);
+    }
+    void AssignMeanOf(const TensorView& a)
+    {
+        DoUnaryOpOf(0, a, (ElemType) GetShape().GetNumElements() / a.GetShape().GetNumElements(), ElementWiseOperator::opCopy, ElementWiseOperator::opSum);
+    }
+
+    // -------------------------------------------------------------------
+    // tensor contraction
+    // 'spec' names the axes of a, b, and 'this' with one letter each, einsum-style, in TensorShape order (axis 0 first),
+    // e.g. "ik,kj->ij" for a matrix product or "kib,kjb->ijb" for a batch of products with a transposed a.
+    // Axes of both a and b that 'this' does not have are summed over; each axis of 'this' must be one of a or b.
+    // E.g. c.DoContractionOf(beta, a, b, alpha, "ikb,kjb->ijb") means c[:,:,t] := beta * c[:,:,t] + alpha * a[:,:,t] * b[:,:,t].
+    // Nothing is copied: if the axes of each operand, with their strides, are a dense [rows x cols x batch] block,
+    // this is one (batched) GEMM; otherwise it is an elementwise product with a sum reduction over the summed axes.
+    // -------------------------------------------------------------------
+
+    void DoContractionOf(ElemType beta, const TensorView& a, const TensorView& b, ElemType alpha, const std::string& spec);
+    void AssignContractionOf(const TensorView& a, const TensorView& b, const std::string& spec, ElemType alpha = 1.0f)
+    {
+        DoContractionOf(0, a, b, alpha, spec);
+    }
+    void AddContractionOf(const TensorView& a, const TensorView& b, const std::string& spec, ElemType alpha = 1.0f)
+    {
+        DoContractionOf(1, a, b, alpha, spec);
+    }
+
+    // run a fused chain of elementwise ops (see ElementWiseProgram) in a single pass
+    // All operands must have the same dimensions and be stored densely; there is no broadcasting or reduction.
+    static void DoElementWiseProgramOf(const ElementWiseProgram& program, const std::vector<TensorView>& inputs, std::vector<TensorView>& outputs);
 
 private:
     // -------------------------------------------------------------------
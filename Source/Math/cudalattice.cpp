@@ -16,6 +16,7 @@
 #include <memory> // for auto_ptr
 #include <assert.h>
 #include <float.h>
+#include <algorithm>
 
 namespace msra { namespace cuda {
 
@@ -45,15 +46,18 @@ public:
     {
         release();
     }
+    // The vectors of a parallelstate are kept from lattice to lattice, so this only reallocates when a lattice is larger
+    // than all before; it then grows by half at least, so that the high-water mark is reached in few steps.
     void allocate(size_t sz)
     {
         if (sz > capacity) // need to grow
         {
-            ondevice no(deviceid);                          // switch to desired CUDA card
-            cuda_ptr<elemtype> pnew = malloc<elemtype>(sz); // allocate memory inside CUDA device (or throw)
-            capacity = sz;                                  // if succeeded then: remember
-            cuda_ptr<elemtype> p = this->reset(pnew, sz);   //  and swap the pointers and update n
-            free(p);                                        //  then release the old one
+            ondevice no(deviceid);                                   // switch to desired CUDA card
+            const size_t newcapacity = std::max(sz, capacity + capacity / 2);
+            cuda_ptr<elemtype> pnew = malloc<elemtype>(newcapacity); // allocate memory inside CUDA device (or throw)
+            capacity = newcapacity;                                  // if succeeded then: remember
+            cuda_ptr<elemtype> p = this->reset(pnew, sz);            //  and swap the pointers and update n
+            free(p);                                                 //  then release the old one
         }
         else // not growing: keep same allocation
             this->reset(this->get(), sz);
@@ -212,6 +216,66 @@ private:
                                              dynamic_cast<const vectorbaseimpl<doublevector, vectorref<double>> &>(logqs),
                                              logaccMatrixRef);
     }
+
+    void forwardbackwardlatticebatch(const size_t *batchsizeforward, const size_t *batchsizebackward,
+                                     const size_t numlaunchforward, const size_t numlaunchbackward,
+                                     const uintvector &edgeorder, const uintvector &edgelattices, const uintvector &latticenodes,
+                                     const size_t spalignunitid, const size_t silalignunitid,
+                                     const floatvector &edgeacscores, const edgeinfowithscoresvector &edges,
+                                     const nodeinfovector &nodes, const aligninfovector &aligns,
+                                     const ushortvector &alignments, const uintvector &alignoffsets,
+                                     doublevector &logpps, doublevector &logalphas, doublevector &logbetas,
+                                     const float lmf, const float wp, const float amf, const float boostingfactor, const bool returnEframescorrect,
+                                     const ushortvector &uids, const ushortvector &senone2classmap, doublevector &logaccalphas,
+                                     doublevector &logaccbetas, doublevector &logframescorrectedge,
+                                     doublevector &logEframescorrect, doublevector &latticetotals)
+    {
+        ondevice no(deviceid);
+        latticefunctionsops::forwardbackwardlatticebatch(batchsizeforward, batchsizebackward, numlaunchforward, numlaunchbackward,
+                                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(edgeorder),
+                                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(edgelattices),
+                                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(latticenodes),
+                                                         spalignunitid, silalignunitid,
+                                                         dynamic_cast<const vectorbaseimpl<floatvector, vectorref<float>> &>(edgeacscores),
+                                                         dynamic_cast<const vectorbaseimpl<edgeinfowithscoresvector, vectorref<msra::lattices::edgeinfowithscores>> &>(edges),
+                                                         dynamic_cast<const vectorbaseimpl<nodeinfovector, vectorref<msra::lattices::nodeinfo>> &>(nodes),
+                                                         dynamic_cast<const vectorbaseimpl<aligninfovector, vectorref<msra::lattices::aligninfo>> &>(aligns),
+                                                         dynamic_cast<const vectorbaseimpl<ushortvector, vectorref<unsigned short>> &>(alignments),
+                                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(alignoffsets),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logpps),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logalphas),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logbetas),
+                                                         lmf, wp, amf, boostingfactor, returnEframescorrect,
+                                                         dynamic_cast<const vectorbaseimpl<ushortvector, vectorref<unsigned short>> &>(uids),
+                                                         dynamic_cast<const vectorbaseimpl<ushortvector, vectorref<unsigned short>> &>(senone2classmap),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logaccalphas),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logaccbetas),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logframescorrectedge),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logEframescorrect),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(latticetotals));
+    }
+
+    void sMBRerrorsignalbatch(const ushortvector &alignstateids, const uintvector &alignoffsets,
+                              const edgeinfowithscoresvector &edges, const nodeinfovector &nodes,
+                              const doublevector &logpps, const float amf, const doublevector &logEframescorrect,
+                              const uintvector &edgelattices, const doublevector &latticetotals,
+                              Microsoft::MSR::CNTK::Matrix<float> &dengammas, Microsoft::MSR::CNTK::Matrix<float> &dengammasbuf)
+    {
+        ondevice no(deviceid);
+
+        matrixref<float> dengammasMatrixRef = tomatrixref(dengammas);
+        matrixref<float> dengammasbufMatrixRef = tomatrixref(dengammasbuf);
+        latticefunctionsops::sMBRerrorsignalbatch(dynamic_cast<const vectorbaseimpl<ushortvector, vectorref<unsigned short>> &>(alignstateids),
+                                                  dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(alignoffsets),
+                                                  dynamic_cast<const vectorbaseimpl<edgeinfowithscoresvector, vectorref<msra::lattices::edgeinfowithscores>> &>(edges),
+                                                  dynamic_cast<const vectorbaseimpl<nodeinfovector, vectorref<msra::lattices::nodeinfo>> &>(nodes),
+                                                  dynamic_cast<const vectorbaseimpl<doublevector, vectorref<double>> &>(logpps),
+                                                  amf,
+                                                  dynamic_cast<const vectorbaseimpl<doublevector, vectorref<double>> &>(logEframescorrect),
+                                                  dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(edgelattices),
+                                                  dynamic_cast<const vectorbaseimpl<doublevector, vectorref<double>> &>(latticetotals),
+                                                  dengammasMatrixRef, dengammasbufMatrixRef);
+    }
 };
 
 latticefunctions *newlatticefunctions(size_t deviceid)
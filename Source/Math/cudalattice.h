@@ -109,6 +109,26 @@ struct latticefunctions : public vectorbase<msra::lattices::empty>
     virtual void stateposteriors(const ushortvector& alignstateids, const uintvector& alignoffsets,
                                  const edgeinfowithscoresvector& edges, const nodeinfovector& nodes,
                                  const doublevector& logqs, Microsoft::MSR::CNTK::Matrix<float>& logacc) = 0;
+    // batched versions for the lattices of a minibatch packed into one arena (see parallelforwardbackwardbatch())
+    // latticetotals receives [total forward scores, total backward scores, logEframescorrecttotals], one entry per lattice each
+    virtual void forwardbackwardlatticebatch(const size_t* batchsizeforward, const size_t* batchsizebackward,
+                                             const size_t numlaunchforward, const size_t numlaunchbackward,
+                                             const uintvector& edgeorder, const uintvector& edgelattices, const uintvector& latticenodes,
+                                             const size_t spalignunitid, const size_t silalignunitid,
+                                             const floatvector& edgeacscores, const edgeinfowithscoresvector& edges,
+                                             const nodeinfovector& nodes, const aligninfovector& aligns,
+                                             const ushortvector& alignoutput, const uintvector& alignoffsets,
+                                             doublevector& logpps, doublevector& logalphas, doublevector& logbetas,
+                                             const float lmf, const float wp, const float amf, const float boostingfactor, const bool returnEframescorrect,
+                                             const ushortvector& uids, const ushortvector& senone2classmap,
+                                             doublevector& logaccalphas, doublevector& logaccbetas,
+                                             doublevector& logframescorrectedge, doublevector& logEframescorrect,
+                                             doublevector& latticetotals) = 0;
+    virtual void sMBRerrorsignalbatch(const ushortvector& alignstateids, const uintvector& alignoffsets,
+                                      const edgeinfowithscoresvector& edges, const nodeinfovector& nodes,
+                                      const doublevector& logpps, const float amf, const doublevector& logEframescorrect,
+                                      const uintvector& edgelattices, const doublevector& latticetotals,
+                                      Microsoft::MSR::CNTK::Matrix<float>& dengammas, Microsoft::MSR::CNTK::Matrix<float>& dengammasbuf) = 0;
 };
 
 // ---------------------------------------------------------------------------
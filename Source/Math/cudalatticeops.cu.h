@@ -201,7 +201,8 @@ __global__ void forwardlatticej(const size_t batchsize, const size_t startindex,
     if (j < batchsize) // note: will cause issues if we ever use __synctreads()
     {
         msra::lattices::latticefunctionskernels::forwardlatticej(j + startindex, edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns, alignments, alignmentoffsets,
-                                                                 logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas);
+                                                                 logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas,
+                                                                 0, nodes.size() - 1);
     }
 }
 
@@ -223,7 +224,7 @@ __global__ void backwardlatticej(const size_t batchsize, const size_t startindex
                                                                   edges, nodes, aligns, totalfwscore, logpps, logalphas, logbetas,
                                                                   lmf, wp, amf, boostingfactor, returnEframescorrect,
                                                                   logframescorrectedge, logaccalphas,
-                                                                  logEframescorrect, logaccbetas);
+                                                                  logEframescorrect, logaccbetas, 0, nodes.size() - 1);
     }
 }
 
@@ -451,5 +452,202 @@ void latticefunctionsops::mmierrorsignal(const vectorref<unsigned short> &aligns
     expfi<<<dim3((((unsigned int) errorsignal.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignal);
     checklaunch("expfi");
 }
+
+// -----------------------------------------------------------------------
+// batched lattice forward-backward --all lattices of a minibatch packed into one arena of edges and nodes
+// Node indices and times of the packed edges are relative to the arena; latticenodes[l] is the first node of lattice l
+// (one more entry for the end), and edgelattices[j] the lattice of edge j. edgeorder holds the edge indices in the order
+// of the launches: first the forward launches, then the backward ones. A launch takes the i-th independent batch of
+// edges of every lattice, so the number of launches is that of the longest lattice rather than the sum over the lattices.
+// latticetotals has 3 entries per lattice: total forward score, total backward score, and logEframescorrecttotal.
+// -----------------------------------------------------------------------
+
+__global__ void setlatticetokensj(vectorref<double> logalphas, vectorref<double> logbetas, const vectorref<unsigned int> latticenodes)
+{
+    const size_t l = threadIdx.x + (blockIdx.x * blockDim.x);
+    if (l + 1 < latticenodes.size())
+    {
+        logalphas[latticenodes[l]] = 0.0;
+        logbetas[latticenodes[l + 1] - 1] = 0.0;
+    }
+}
+
+// backward = false: gather the total forward scores; true: total backward scores and expected frames correct
+__global__ void latticetotalsj(const vectorref<double> logalphas, const vectorref<double> logbetas, const vectorref<double> logaccbetas,
+                               const vectorref<unsigned int> latticenodes, const bool backward, const bool returnEframescorrect, vectorref<double> latticetotals)
+{
+    const size_t numlattices = latticenodes.size() - 1;
+    const size_t l = threadIdx.x + (blockIdx.x * blockDim.x);
+    if (l < numlattices)
+    {
+        if (!backward)
+            latticetotals[l] = logalphas[latticenodes[l + 1] - 1];
+        else
+        {
+            const size_t startnode = latticenodes[l];
+            latticetotals[numlattices + l] = logbetas[startnode];
+            latticetotals[2 * numlattices + l] = returnEframescorrect ? logaccbetas[startnode] - logbetas[startnode] : LOGZERO;
+        }
+    }
+}
+
+__global__ void forwardlatticebatchj(const size_t batchsize, const size_t startindex, const vectorref<unsigned int> edgeorder,
+                                     const vectorref<unsigned int> edgelattices, const vectorref<unsigned int> latticenodes,
+                                     const vectorref<float> edgeacscores, const size_t spalignunitid, const size_t silalignunitid,
+                                     vectorref<msra::lattices::edgeinfowithscores> edges, vectorref<msra::lattices::nodeinfo> nodes,
+                                     const vectorref<msra::lattices::aligninfo> aligns, vectorref<unsigned short> alignments,
+                                     vectorref<unsigned int> alignmentoffsets, vectorref<double> logalphas, float lmf, float wp, float amf,
+                                     const float boostingfactor, const vectorref<unsigned short> uids, const vectorref<unsigned short> senone2classmap,
+                                     const bool returnEframescorrect, vectorref<double> logframescorrectedge, vectorref<double> logaccalphas)
+{
+    const size_t shufflemode = 1;
+    const size_t k = msra::lattices::latticefunctionskernels::shuffle(threadIdx.x, blockDim.x, threadIdx.y, blockDim.y, blockIdx.x, gridDim.x, shufflemode);
+    if (k < batchsize)
+    {
+        const size_t j = edgeorder[k + startindex];
+        const size_t l = edgelattices[j];
+        msra::lattices::latticefunctionskernels::forwardlatticej(j, edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns, alignments, alignmentoffsets,
+                                                                 logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas,
+                                                                 latticenodes[l], latticenodes[l + 1] - 1);
+    }
+}
+
+__global__ void backwardlatticebatchj(const size_t batchsize, const size_t startindex, const vectorref<unsigned int> edgeorder,
+                                      const vectorref<unsigned int> edgelattices, const vectorref<unsigned int> latticenodes,
+                                      const vectorref<double> latticetotals, const vectorref<float> edgeacscores,
+                                      const size_t spalignunitid, const size_t silalignunitid,
+                                      vectorref<msra::lattices::edgeinfowithscores> edges, vectorref<msra::lattices::nodeinfo> nodes,
+                                      vectorref<msra::lattices::aligninfo> aligns, vectorref<double> logpps, vectorref<double> logalphas, vectorref<double> logbetas,
+                                      float lmf, float wp, float amf, const float boostingfactor, const bool returnEframescorrect,
+                                      vectorref<double> logframescorrectedge, vectorref<double> logaccalphas,
+                                      vectorref<double> logEframescorrect, vectorref<double> logaccbetas)
+{
+    const size_t tpb = blockDim.x * blockDim.y; // total #threads in a block
+    const size_t jinblock = threadIdx.x + threadIdx.y * blockDim.x;
+    const size_t k = jinblock + blockIdx.x * tpb;
+    if (k < batchsize)
+    {
+        const size_t j = edgeorder[k + startindex];
+        const size_t l = edgelattices[j];
+        msra::lattices::latticefunctionskernels::backwardlatticej(j, edgeacscores, spalignunitid, silalignunitid,
+                                                                  edges, nodes, aligns, latticetotals[l], logpps, logalphas, logbetas,
+                                                                  lmf, wp, amf, boostingfactor, returnEframescorrect,
+                                                                  logframescorrectedge, logaccalphas,
+                                                                  logEframescorrect, logaccbetas, latticenodes[l], latticenodes[l + 1] - 1);
+    }
+}
+
+void latticefunctionsops::forwardbackwardlatticebatch(const size_t *batchsizeforward, const size_t *batchsizebackward,
+                                                      const size_t numlaunchforward, const size_t numlaunchbackward,
+                                                      const vectorref<unsigned int> &edgeorder, const vectorref<unsigned int> &edgelattices,
+                                                      const vectorref<unsigned int> &latticenodes,
+                                                      const size_t spalignunitid, const size_t silalignunitid,
+                                                      const vectorref<float> &edgeacscores,
+                                                      const vectorref<msra::lattices::edgeinfowithscores> &edges,
+                                                      const vectorref<msra::lattices::nodeinfo> &nodes,
+                                                      const vectorref<msra::lattices::aligninfo> &aligns,
+                                                      const vectorref<unsigned short> &alignments,
+                                                      const vectorref<unsigned int> &aligmentoffsets,
+                                                      vectorref<double> &logpps, vectorref<double> &logalphas, vectorref<double> &logbetas,
+                                                      const float lmf, const float wp, const float amf, const float boostingfactor,
+                                                      const bool returnEframescorrect, const vectorref<unsigned short> &uids,
+                                                      const vectorref<unsigned short> &senone2classmap, vectorref<double> &logaccalphas,
+                                                      vectorref<double> &logaccbetas, vectorref<double> &logframescorrectedge,
+                                                      vectorref<double> &logEframescorrect, vectorref<double> &latticetotals) const
+{
+    dim3 t(32, 8);
+    const size_t tpb = t.x * t.y;
+    dim3 b((unsigned int) ((logalphas.size() + tpb - 1) / tpb));
+    const size_t numlattices = latticenodes.size() - 1;
+    dim3 bl((unsigned int) ((numlattices + 31) / 32));
+
+    setvaluej<<<b, t, 0, GetCurrentStream()>>>(logalphas, LOGZERO, logalphas.size());
+    checklaunch("setvaluej");
+    setvaluej<<<b, t, 0, GetCurrentStream()>>>(logbetas, LOGZERO, logalphas.size());
+    checklaunch("setvaluej");
+    if (returnEframescorrect)
+    {
+        setvaluej<<<b, t, 0, GetCurrentStream()>>>(logaccalphas, LOGZERO, logalphas.size());
+        checklaunch("setvaluej");
+        setvaluej<<<b, t, 0, GetCurrentStream()>>>(logaccbetas, LOGZERO, logalphas.size());
+        checklaunch("setvaluej");
+    }
+    // initial tokens of all lattices, on the device
+    setlatticetokensj<<<bl, 32, 0, GetCurrentStream()>>>(logalphas, logbetas, latticenodes);
+    checklaunch("setlatticetokensj");
+
+    // forward pass
+    size_t startindex = 0;
+    for (size_t i = 0; i < numlaunchforward; i++)
+    {
+        dim3 b((unsigned int) ((batchsizeforward[i] + tpb - 1) / tpb));
+        forwardlatticebatchj<<<b, t, 0, GetCurrentStream()>>>(batchsizeforward[i], startindex, edgeorder, edgelattices, latticenodes, edgeacscores,
+                                                              spalignunitid, silalignunitid, edges, nodes, aligns,
+                                                              alignments, aligmentoffsets, logalphas, lmf, wp, amf,
+                                                              boostingfactor, uids, senone2classmap, returnEframescorrect,
+                                                              logframescorrectedge, logaccalphas);
+        checklaunch("forwardlatticebatchj");
+        startindex += batchsizeforward[i];
+    }
+    // the backward pass needs the total forward score of each lattice; these stay on the device
+    latticetotalsj<<<bl, 32, 0, GetCurrentStream()>>>(logalphas, logbetas, logaccbetas, latticenodes, false, returnEframescorrect, latticetotals);
+    checklaunch("latticetotalsj");
+
+    // backward pass
+    for (size_t i = 0; i < numlaunchbackward; i++)
+    {
+        dim3 b((unsigned int) ((batchsizebackward[i] + tpb - 1) / tpb));
+        backwardlatticebatchj<<<b, t, 0, GetCurrentStream()>>>(batchsizebackward[i], startindex, edgeorder, edgelattices, latticenodes, latticetotals,
+                                                               edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns,
+                                                               logpps, logalphas, logbetas,
+                                                               lmf, wp, amf, boostingfactor, returnEframescorrect, logframescorrectedge,
+                                                               logaccalphas, logEframescorrect, logaccbetas);
+        checklaunch("backwardlatticebatchj");
+        startindex += batchsizebackward[i];
+    }
+    latticetotalsj<<<bl, 32, 0, GetCurrentStream()>>>(logalphas, logbetas, logaccbetas, latticenodes, true, returnEframescorrect, latticetotals);
+    checklaunch("latticetotalsj");
+}
+
+__global__ void sMBRerrorsignalbatchj(const vectorref<unsigned short> alignstateids, const vectorref<unsigned int> alignoffsets,
+                                      const vectorref<msra::lattices::edgeinfowithscores> edges, const vectorref<msra::lattices::nodeinfo> nodes,
+                                      vectorref<double> logpps, const float amf, const vectorref<double> logEframescorrect,
+                                      const vectorref<unsigned int> edgelattices, const vectorref<double> latticetotals, const size_t numlattices,
+                                      matrixref<float> errorsignal, matrixref<float> errorsignalneg)
+{
+    const size_t shufflemode = 1;
+    const size_t j = msra::lattices::latticefunctionskernels::shuffle(threadIdx.x, blockDim.x, threadIdx.y, blockDim.y, blockIdx.x, gridDim.x, shufflemode);
+    if (j < edges.size())
+    {
+        const double logEframescorrecttotal = latticetotals[2 * numlattices + edgelattices[j]];
+        msra::lattices::latticefunctionskernels::sMBRerrorsignalj(j, alignstateids, alignoffsets, edges, nodes, logpps, amf, logEframescorrect, logEframescorrecttotal, errorsignal, errorsignalneg);
+    }
+}
+
+void latticefunctionsops::sMBRerrorsignalbatch(const vectorref<unsigned short> &alignstateids, const vectorref<unsigned int> &alignoffsets,
+                                               const vectorref<msra::lattices::edgeinfowithscores> &edges, const vectorref<msra::lattices::nodeinfo> &nodes,
+                                               const vectorref<double> &logpps, const float amf, const vectorref<double> &logEframescorrect,
+                                               const vectorref<unsigned int> &edgelattices, const vectorref<double> &latticetotals,
+                                               matrixref<float> &errorsignal, matrixref<float> &errorsignalauxbuf) const
+{
+    const size_t numedges = edges.size();
+    dim3 t(32, 8);
+    const size_t tpb = t.x * t.y;
+    dim3 b((unsigned int) ((numedges + tpb - 1) / tpb));
+
+    setvaluei<<<dim3((((unsigned int) errorsignal.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignal, LOGZERO);
+    checklaunch("setvaluei");
+    setvaluei<<<dim3((((unsigned int) errorsignalauxbuf.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignalauxbuf, LOGZERO);
+    checklaunch("setvaluei");
+    sMBRerrorsignalbatchj<<<b, t, 0, GetCurrentStream()>>>(alignstateids, alignoffsets, edges, nodes, logpps, amf, logEframescorrect,
+                                                           edgelattices, latticetotals, latticetotals.size() / 3, errorsignal, errorsignalauxbuf);
+    checklaunch("sMBRerrorsignalbatchj");
+
+    setunseeni<<<dim3((((unsigned int) errorsignal.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignal, errorsignalauxbuf);
+    checklaunch("setunseenj");
+
+    errorcomputationi<<<dim3((((unsigned int) errorsignal.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignal, errorsignalauxbuf, amf);
+    checklaunch("errorcomputationj");
+}
 };
 };
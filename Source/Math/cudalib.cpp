@@ -10,6 +10,7 @@
 #include <cuda.h>             // for device API
 #include "cudalib.h"
 #include "cudadevice.h"
+#include "CommonMatrix.h" // for TracingGPUMemoryAllocator
 #include <string>
 #include <assert.h>
 #include <cublas_v2.h>
@@ -49,17 +50,25 @@ const int stackSize = 20;
 static int curStack = 0;
 static size_t deviceStack[stackSize] = {0};
 
-// memory allocation
+// memory allocation, on the current device
+// This goes through the allocator of the GPU matrices, so that the lattice buffers are taken from and returned to its
+// cache of device buffers (if enabled) instead of the driver.
+static int currentdevice()
+{
+    int deviceid;
+    cudaGetDevice(&deviceid) || "cudaGetDevice failed";
+    return deviceid;
+}
+
 void *mallocbytes(size_t nelem, size_t sz)
 {
     for (size_t retry = 0;; retry++)
     {
         try
         {
+            Microsoft::MSR::CNTK::ScopedMemoryTag memoryTag(Microsoft::MSR::CNTK::MemoryTag::Lattice);
             // fprintf (stderr, "mallocbytes: allocating %d elements of size %d, %d bytes\n", (int) nelem, (int) sz, (int) (nelem * sz));        // comment out by [v-hansu] to get rid out annoying output
-            void *p;
-            cudaMalloc(&p, nelem * sz) || "cudaMalloc failed";
-            return p;
+            return Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::Allocate<char>(currentdevice(), nelem * sz);
         }
         catch (const std::exception &e)
         {
@@ -72,7 +81,7 @@ void *mallocbytes(size_t nelem, size_t sz)
 
 void freebytes(void *p)
 {
-    cudaFree(p) || "cudaFree failed";
+    Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::Free<char>(currentdevice(), (char *) p);
 }
 
 void memcpyh2d(void *dst, size_t byteoffset, const void *src, size_t nbytes)
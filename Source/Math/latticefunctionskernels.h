@@ -654,6 +654,7 @@ struct latticefunctionskernels
 
     // Phase 1 of forwardbackward algorithm
     // returnEframescorrect means sMBR mode
+    // startnode and endnode are the first and last node of the lattice of edge j (0 and nodes.size()-1 unless lattices are packed into one arena)
     template <typename edgeinforvector, typename nodeinfovector, typename aligninfovector, typename ushortvector, typename uintvector, typename floatvector, typename doublevector>
     static inline __device__ void forwardlatticej(const size_t j, const floatvector &edgeacscores,
                                                   const size_t /*spalignunitid --unused*/, const size_t silalignunitid,
@@ -661,7 +662,8 @@ struct latticefunctionskernels
                                                   const ushortvector &alignments, const uintvector &alignmentoffsets,
                                                   doublevector &logalphas, float lmf, float wp, float amf, const float boostingfactor,
                                                   const ushortvector &uids, const ushortvector senone2classmap, const bool returnEframescorrect,
-                                                  doublevector &logframescorrectedge, doublevector &logaccalphas)
+                                                  doublevector &logframescorrectedge, doublevector &logaccalphas,
+                                                  const size_t startnode, const size_t endnode)
     {
         // edge info
         const edgeinfowithscores &e = edges[j];
@@ -732,7 +734,7 @@ struct latticefunctionskernels
 
 #ifdef FORBID_INVALID_SIL_PATHS
         // silence edge or second speech edge
-        if ((isaddedsil && e.E != nodes.size() - 1) || (forbidinvalidsilpath && e.S != 0))
+        if ((isaddedsil && e.E != endnode) || (forbidinvalidsilpath && e.S != startnode))
         {
             const size_t S = (size_t)(!isaddedsil ? e.S + nodes.size() : e.S); // second speech edge comes from special 'silence state' node
             const size_t E = (size_t)(isaddedsil ? e.E + nodes.size() : e.E);  // silence edge goes into special 'silence state' node
@@ -760,7 +762,8 @@ struct latticefunctionskernels
                                                    doublevector &logalphas, doublevector &logbetas, float lmf, float wp,
                                                    float amf, const float boostingfactor, const bool returnEframescorrect,
                                                    doublevector &logframescorrectedge, doublevector &logaccalphas,
-                                                   doublevector &logEframescorrect, doublevector &logaccbetas)
+                                                   doublevector &logEframescorrect, doublevector &logaccbetas,
+                                                   const size_t startnode, const size_t endnode)
     {
         // output values
         double logpp = LOGZERO;
@@ -837,7 +840,7 @@ struct latticefunctionskernels
         double logEframescorrectj2 = LOGZERO;
 
         // silence edge or second speech edge
-        if ((isaddedsil && e.E != nodes.size() - 1) || (forbidinvalidsilpath && e.S != 0))
+        if ((isaddedsil && e.E != endnode) || (forbidinvalidsilpath && e.S != startnode))
         {
             const size_t S = (size_t)(!isaddedsil ? e.S + nodes.size() : e.S); // second speech edge comes from special 'silence state' node
             const size_t E = (size_t)(isaddedsil ? e.E + nodes.size() : e.E);  // silence edge goes into special 'silence state' node
@@ -882,6 +885,8 @@ struct latticefunctionskernels
         }
 #else
         nodes;
+        startnode;
+        endnode;
 #endif
 
         // write back return values
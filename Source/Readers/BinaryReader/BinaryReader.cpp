@@ -52,6 +52,8 @@ void BinaryReader<ElemType>::LoadSections(Section* sectionRoot, MappingType mapp
 //  # reader to use
 //  readerType=BinaryReader
 //  miniBatchMode=Partial
+//  # read the next minibatch on a background thread while the current one is used
+//  prefetch=true
 //  file={,
 //    c:\speech\mnist\mnist_features.bin
 //      c:\speech\mnist\mnist_labels.bin
@@ -127,6 +129,7 @@ void BinaryReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfig
     // determine if partial minibatches are desired
     std::string minibatchMode(readerConfig(L"minibatchMode", "Partial"));
     m_partialMinibatch = !_stricmp(minibatchMode.c_str(), "Partial");
+    m_prefetchEnabled = readerConfig(L"prefetch", false) && !mOneLinePerFile;
 
     // Initial load is complete
     DisplayProperties();
@@ -170,6 +173,8 @@ void BinaryReader<ElemType>::DisplayProperties()
 template <class ElemType>
 BinaryReader<ElemType>::~BinaryReader()
 {
+    WaitForPrefetch(); // (its result or error is dropped)
+
     // clear the section references, they will be deleted by the sectionFile destructors
     m_sections.clear();
 
@@ -204,6 +209,10 @@ void BinaryReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, siz
     m_epochSize = requestedEpochSamples;
     m_epoch = epoch;
 
+    // drop a minibatch prefetched for the previous loop
+    if (m_pendingAsyncGetMinibatch.valid())
+        m_pendingAsyncGetMinibatch.get();
+
     SetupEpoch();
 }
 
@@ -245,6 +254,65 @@ bool BinaryReader<ElemType>::CheckEndDataset(size_t actualmbsize)
 // returns - true if there are more minibatches, false if no more minibatchs remain
 template <class ElemType>
 bool BinaryReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices)
+{
+    bool minibatchesRemaining = true;
+    if (m_pendingAsyncGetMinibatch.valid())
+    {
+        // An async GetMinibatch is in flight. Wait for it to finish and swap
+        // the contents of the m_prefetchMatrices and parameter matrices
+        minibatchesRemaining = m_pendingAsyncGetMinibatch.get();
+        for (auto iter = matrices.begin(); iter != matrices.end(); ++iter)
+        {
+            auto found = m_prefetchMatrices.find(iter->first);
+            if (found == m_prefetchMatrices.end())
+                LogicError("No matching prefetch matrix found for matrix named %ls!", iter->first.c_str());
+            std::swap(*(iter->second), *found->second);
+        }
+    }
+    else
+    {
+        minibatchesRemaining = GetMinibatchImpl(matrices);
+
+        // Allocate prefetch matrices if we would be firing an async minibatch prefetch
+        if (minibatchesRemaining && m_prefetchEnabled)
+        {
+            m_prefetchMatrices.clear();
+            for (auto iter = matrices.begin(); iter != matrices.end(); ++iter)
+                m_prefetchMatrices[iter->first].reset(new Matrix<ElemType>(iter->second->GetDeviceId()));
+        }
+    }
+
+    // Fire a new prefetch if there are any minibatches remaining
+    if (minibatchesRemaining && m_prefetchEnabled && !matrices.empty())
+    {
+        int deviceId = matrices.begin()->second->GetDeviceId();
+        m_pendingAsyncGetMinibatch = std::async(std::launch::async, [this, deviceId]()
+                                                {
+                                                    // Set the device since this will execute on a new thread
+                                                    Matrix<ElemType>::SetDevice(deviceId);
+
+                                                    std::map<std::wstring, Matrix<ElemType>*> prefetchMatrices;
+                                                    for (auto iter = m_prefetchMatrices.begin(); iter != m_prefetchMatrices.end(); ++iter)
+                                                        prefetchMatrices[iter->first] = iter->second.get();
+                                                    return GetMinibatchImpl(prefetchMatrices);
+                                                });
+    }
+
+    return minibatchesRemaining;
+}
+
+// WaitForPrefetch - block until a pending prefetch has touched the sections for the last time
+// The result stays in m_pendingAsyncGetMinibatch for the next GetMinibatch().
+template <class ElemType>
+void BinaryReader<ElemType>::WaitForPrefetch()
+{
+    if (m_pendingAsyncGetMinibatch.valid())
+        m_pendingAsyncGetMinibatch.wait();
+}
+
+// GetMinibatchImpl - The actual implementation of getting the next minibatch, copying the records out of the mapped sections
+template <class ElemType>
+bool BinaryReader<ElemType>::GetMinibatchImpl(std::map<std::wstring, Matrix<ElemType>*>& matrices)
 {
     // get out if they didn't call StartMinibatchLoop() first
     if (m_mbSize == 0)
@@ -392,6 +460,7 @@ void BinaryReader<ElemType>::SetLabelMapping(const std::wstring& /*sectionName*/
 template <class ElemType>
 bool BinaryReader<ElemType>::GetData(const std::wstring& sectionName, size_t numRecords, void* data, size_t& dataBufferSize, size_t recordStart)
 {
+    WaitForPrefetch(); // (sections may be remapped by the prefetch)
     auto iter = m_sections.find(sectionName);
     if (iter == m_sections.end())
     {
@@ -419,6 +488,8 @@ template <class ElemType>
 bool BinaryReader<ElemType>::DataEnd(EndDataType endDataType)
 {
     bool ret = false;
+    if (m_pendingAsyncGetMinibatch.valid() && endDataType != endDataSentence)
+        return false; // a prefetched minibatch has not been handed out yet
     switch (endDataType)
     {
     case endDataNull:
@@ -11,6 +11,8 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <future>
+#include <memory>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -567,10 +569,19 @@ private:
     size_t m_dim;
     vector<FILE*> m_fStream;
 
+    // Prefetching related fields
+    // The next minibatch is read from the mapped sections on its own thread, so page faults on cold sections
+    // and the copy into (device) matrices overlap with the consumer. Sections are only touched by one thread at a time.
+    bool m_prefetchEnabled;
+    std::future<bool> m_pendingAsyncGetMinibatch;
+    std::map<std::wstring, std::unique_ptr<Matrix<ElemType>>> m_prefetchMatrices;
+
     void SetupEpoch();
     void LoadSections(Section* parentSection, MappingType mapping, size_t windowSize);
     void DisplayProperties();
     bool CheckEndDataset(size_t actualmbsize);
+    bool GetMinibatchImpl(std::map<std::wstring, Matrix<ElemType>*>& matrices);
+    void WaitForPrefetch();
 
 public:
     template <class ConfigRecordType>
@@ -585,7 +596,7 @@ public:
     }
     virtual void Destroy();
     BinaryReader()
-        : m_pMBLayout(make_shared<MBLayout>())
+        : m_pMBLayout(make_shared<MBLayout>()), m_prefetchEnabled(false)
     {
     }
     virtual ~BinaryReader();
@@ -634,6 +645,15 @@ private:
     // create the section map for the API
     std::map<std::wstring, SectionType, nocase_compare> m_sectionInfo;
 
+    // asynchronous output: SaveData() copies the records and writes them into the sections on another thread
+    // Only one write is in flight, so they are applied in order; the last records of a pass are written synchronously.
+    bool m_asyncWrite;
+    std::future<void> m_pendingAsyncSaveData;
+    std::map<std::wstring, std::vector<char>, nocase_compare> m_asyncBuffers; // [section name] copy of the records being written
+
+    bool SaveDataImpl(size_t recordStart, const std::map<std::wstring, void*, nocase_compare>& matrices, size_t numRecords, size_t datasetSize, size_t byteVariableSized);
+    void WaitForPendingSave();
+
     // create a section from config parameters
     Section* CreateSection(const ConfigParameters& config, Section* parentSection, size_t p_records, size_t p_windowSize = 0);
     Section* CreateSection(const ScriptableObjects::IConfigRecord& config, Section* parentSection, size_t p_records, size_t p_windowSize = 0);
@@ -652,10 +672,12 @@ public:
     // DataWriter Constructor
     // config - [in] configuration parameters for the datareader
     BinaryWriter(const ConfigParameters& config)
+        : m_asyncWrite(false)
     {
         Init(config);
     }
     BinaryWriter()
+        : m_asyncWrite(false)
     {
     }
     // Destroy - cleanup and remove this class
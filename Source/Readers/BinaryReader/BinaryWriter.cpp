@@ -25,6 +25,15 @@ void BinaryWriter<ElemType>::Destroy()
 template <class ElemType>
 BinaryWriter<ElemType>::~BinaryWriter()
 {
+    try
+    {
+        WaitForPendingSave();
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "~BinaryWriter: error in pending asynchronous write: %s\n", e.what());
+    }
+
     // clear the section references, they will be delted by the sectionFile destructors
     m_sections.clear();
 
@@ -48,6 +57,8 @@ BinaryWriter<ElemType>::~BinaryWriter()
 //  #wsize - inital size of the file in MB default to 256
 //  # has to be large enough for your dataset. the file will shrink to the actual size when closed.
 //  #wsize=256
+//  #asyncWrite - copy the records passed to SaveData() and write them into the file on a background thread
+//  #asyncWrite=true
 //  #wrecords - number of records we should allocate space for in the file
 //  # files cannot be expanded, so this should be large enough. If known modify this element in config before creating file
 //  wrecords=50000
@@ -372,6 +383,7 @@ void BinaryWriter<ElemType>::InitFromConfig(const ConfigRecordType& config)
     m_recordCurrent = 0;
     m_recordMax = config(L"wrecords", (size_t) 0);
     m_traceLevel = config(L"traceLevel", 0);
+    m_asyncWrite = config(L"asyncWrite", false);
     m_uniqueID = (WORD) GetTickCount();
 
     // get the configuration, this will recursively go down and create all subfiles/sections as well
@@ -398,6 +410,52 @@ void BinaryWriter<ElemType>::GetSections(std::map<std::wstring, SectionType, noc
 // returns: true if more data is desired, false if no more data is required (signal that file may be closed)
 template <class ElemType>
 bool BinaryWriter<ElemType>::SaveData(size_t recordStart, const std::map<std::wstring, void*, nocase_compare>& matrices, size_t numRecords, size_t datasetSize, size_t byteVariableSized)
+{
+    // the previous asynchronous write must be applied (and its errors reported) first
+    WaitForPendingSave();
+    if (!m_asyncWrite || byteVariableSized > 0)
+        return SaveDataImpl(recordStart, matrices, numRecords, datasetSize, byteVariableSized);
+
+    // Writing in the background is only possible if the return value is known beforehand, i.e. some
+    // fixed-size section still expects records after these (the last records of a pass are written synchronously).
+    // The caller reuses its buffers, so the records are copied.
+    bool moreToWrite = false;
+    std::map<std::wstring, void*, nocase_compare> copies;
+    for (auto pair : m_sections)
+    {
+        Section* section = pair.second;
+        auto found = matrices.find(section->GetName());
+        if (found == matrices.end()) // (e.g. stats sections, which read their parent's records)
+            continue;
+        size_t size = section->GetElementSize() * section->GetElementsPerRecord() * numRecords;
+        if (size == 0)
+            return SaveDataImpl(recordStart, matrices, numRecords, datasetSize, byteVariableSized);
+        moreToWrite |= recordStart + numRecords < min(datasetSize, section->GetRecordCount());
+        std::vector<char>& buffer = m_asyncBuffers[found->first];
+        buffer.assign((const char*) found->second, (const char*) found->second + size);
+        copies[found->first] = buffer.data();
+    }
+    if (!moreToWrite)
+        return SaveDataImpl(recordStart, matrices, numRecords, datasetSize, byteVariableSized);
+
+    m_pendingAsyncSaveData = std::async(std::launch::async, [this, recordStart, copies, numRecords, datasetSize]()
+                                        {
+                                            SaveDataImpl(recordStart, copies, numRecords, datasetSize, 0);
+                                        });
+    return true;
+}
+
+// WaitForPendingSave - wait for an asynchronous SaveData() and rethrow its error, if any
+template <class ElemType>
+void BinaryWriter<ElemType>::WaitForPendingSave()
+{
+    if (m_pendingAsyncSaveData.valid())
+        m_pendingAsyncSaveData.get();
+}
+
+// SaveDataImpl - write the records into all sections that take them
+template <class ElemType>
+bool BinaryWriter<ElemType>::SaveDataImpl(size_t recordStart, const std::map<std::wstring, void*, nocase_compare>& matrices, size_t numRecords, size_t datasetSize, size_t byteVariableSized)
 {
     // allow restarting a writing session. This is used primarily for writing entire sections at once
     if (recordStart == 0)
@@ -428,6 +486,7 @@ bool BinaryWriter<ElemType>::SaveData(size_t recordStart, const std::map<std::ws
 template <class ElemType>
 void BinaryWriter<ElemType>::SaveMapping(std::wstring saveId, const std::map<typename BinaryWriter<ElemType>::LabelIdType, typename BinaryWriter<ElemType>::LabelType>& labelMapping)
 {
+    WaitForPendingSave();
     Section* section = m_sections[saveId];
     if (section->GetSectionType() == sectionTypeLabelMapping)
     {
@@ -0,0 +1,558 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ChunkedBinaryReader.cpp : reader for the chunked binary corpus format
+//
+
+#include "stdafx.h"
+#define DATAREADER_EXPORTS // creating the exports here
+#include "DataReader.h"
+#include "ChunkedBinaryReader.h"
+#include "ScriptableObjects.h"
+#include <random>
+#include <numeric>
+#include <thread>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static const size_t autoRandomizationWindowInChunks = 32;
+
+template <class ElemType>
+template <class ConfigRecordType>
+void ChunkedBinaryReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfig)
+{
+    std::wstring file;
+    m_streaming = readerConfig.Exists(L"streamFiles");
+    if (m_streaming)
+    {
+        std::wstring pattern = readerConfig(L"streamFiles");
+        m_streamPattern = pattern;
+        file = pattern;
+        m_pollSeconds = readerConfig(L"pollSeconds", (size_t) 10);
+        m_waitForData = readerConfig(L"waitForData", true);
+        while (!TakeNewFiles()) // (the layout of the stream is that of its first file)
+        {
+            if (!WaitForData())
+                RuntimeError("ChunkedBinaryReader: No file matches '%ls'.", pattern.c_str());
+        }
+    }
+    else
+    {
+        std::wstring path = readerConfig(L"file");
+        file = path;
+        m_corpus.reset(new ChunkedBinaryCorpus(file));
+        m_streams = m_corpus->GetStreams();
+    }
+    const ChunkedBinaryCorpus& corpus = m_streaming ? *m_streamFiles.front().corpus : *m_corpus;
+    const auto& streams = m_streams;
+    const auto& chunks = corpus.GetChunks();
+    if (chunks.empty())
+        RuntimeError("ChunkedBinaryReader: '%ls' contains no data.", file.c_str());
+
+    // network inputs: the sections of the reader config, or all streams under their own names
+    for (const auto& id : readerConfig.GetMemberIds())
+    {
+        if (!readerConfig.CanBeConfigRecord(id))
+            continue;
+        const ConfigRecordType& section = readerConfig(id);
+        std::wstring streamName = id;
+        if (section.ExistsCurrent(L"stream"))
+        {
+            std::wstring name = section(L"stream");
+            streamName = name;
+        }
+        auto iter = std::find_if(streams.begin(), streams.end(), [&streamName](const ChunkedBinaryStream& stream)
+                                 {
+                                     return stream.name == streamName;
+                                 });
+        if (iter != streams.end())
+            m_streamOfInput[id] = iter - streams.begin();
+        else if (section.ExistsCurrent(L"stream"))
+            InvalidArgument("ChunkedBinaryReader: '%ls' has no stream '%ls'.", file.c_str(), streamName.c_str());
+    }
+    if (m_streamOfInput.empty())
+    {
+        for (size_t k = 0; k < streams.size(); k++)
+            m_streamOfInput[streams[k].name] = k;
+    }
+
+    // randomization window, in chunks
+    m_randomizationWindow = autoRandomizationWindowInChunks;
+    if (readerConfig.Exists(L"randomize"))
+    {
+        wstring randomizeString = readerConfig.CanBeString(L"randomize") ? readerConfig(L"randomize") : wstring();
+        if (!_wcsicmp(randomizeString.c_str(), L"none"))
+            m_randomizationWindow = 0;
+        else if (_wcsicmp(randomizeString.c_str(), L"auto"))
+        {
+            const size_t randomizeInSamples = readerConfig(L"randomize");
+            m_randomizationWindow = max((size_t) 1, randomizeInSamples * chunks.size() / max(corpus.GetNumSamples(), (size_t) 1));
+        }
+    }
+    // (streaming: the same number of chunks, of the size of those of the first file)
+    m_streamWindow = m_randomizationWindow * corpus.GetNumSamples() / chunks.size();
+
+    bool allFrames = true;
+    for (size_t i = 0; i < corpus.GetNumSequences() && allFrames; i++)
+        allFrames = corpus.GetSequenceLength(i) == 1;
+    m_frameMode = readerConfig(L"frameMode", allFrames);
+    m_numParallelSequences = m_frameMode ? 1 : (size_t) readerConfig(L"nbruttsineachrecurrentiter", (size_t) 1);
+    if (m_numParallelSequences == 0)
+        InvalidArgument("ChunkedBinaryReader: nbruttsineachrecurrentiter must be greater than 0.");
+    m_bucketByLength = !m_frameMode && (bool) readerConfig(L"bucketByLength", false);
+    if (m_streaming && m_bucketByLength)
+        InvalidArgument("ChunkedBinaryReader: bucketByLength is not supported when reading a stream.");
+
+    if (m_streaming)
+        fprintf(stderr, "ChunkedBinaryReader: streaming '%ls' with %d streams, randomization window of %d samples.\n",
+                file.c_str(), (int) streams.size(), (int) m_streamWindow);
+    else
+        fprintf(stderr, "ChunkedBinaryReader: '%ls' has %d samples in %d sequences and %d chunks, %d streams.\n",
+                file.c_str(), (int) corpus.GetNumSamples(), (int) corpus.GetNumSequences(), (int) chunks.size(), (int) streams.size());
+}
+
+// streaming: take the files matching the pattern that have not been taken yet, in name order; false if there are none
+template <class ElemType>
+bool ChunkedBinaryReader<ElemType>::TakeNewFiles()
+{
+    std::vector<std::wstring> paths;
+    expand_wildcards(m_streamPattern, paths);
+    std::sort(paths.begin(), paths.end());
+    bool taken = false;
+    for (const auto& path : paths)
+    {
+        if (!m_takenFiles.insert(path).second)
+            continue;
+        auto corpus = std::make_shared<ChunkedBinaryCorpus>(path);
+        const auto& streams = corpus->GetStreams();
+        if (m_streams.empty())
+            m_streams = streams;
+        bool sameStreams = streams.size() == m_streams.size();
+        for (size_t k = 0; k < streams.size() && sameStreams; k++)
+            sameStreams = streams[k].name == m_streams[k].name && streams[k].isSparse == m_streams[k].isSparse &&
+                          streams[k].isOneHot == m_streams[k].isOneHot && streams[k].dim == m_streams[k].dim;
+        if (!sameStreams)
+            RuntimeError("ChunkedBinaryReader: '%ls' has other streams than the first file of the stream.", path.c_str());
+        fprintf(stderr, "ChunkedBinaryReader: taking '%ls' with %d samples in %d chunks.\n", path.c_str(), (int) corpus->GetNumSamples(), (int) corpus->GetChunks().size());
+        m_streamFiles.push_back(StreamFile{corpus, 0, 0});
+        taken = true;
+    }
+    if (taken)
+        m_waiting = false;
+    return taken;
+}
+
+// streaming: wait for new files; false if not configured to
+template <class ElemType>
+bool ChunkedBinaryReader<ElemType>::WaitForData()
+{
+    if (!m_waitForData)
+        return false;
+    if (!m_waiting)
+        fprintf(stderr, "ChunkedBinaryReader: all data of '%ls' have been read; waiting for new files.\n", m_streamPattern.c_str());
+    m_waiting = true;
+    std::this_thread::sleep_for(std::chrono::seconds(m_pollSeconds));
+    return true;
+}
+
+// streaming: advance the stream by a chunk, which goes into the window if 'keep' and it belongs to this subset;
+// false if the stream has no more data for now
+template <class ElemType>
+bool ChunkedBinaryReader<ElemType>::PullChunk(bool keep)
+{
+    auto file = std::find_if(m_streamFiles.begin(), m_streamFiles.end(), [](const StreamFile& f)
+                             {
+                                 return f.nextChunk < f.corpus->GetChunks().size();
+                             });
+    if (file == m_streamFiles.end())
+        return TakeNewFiles() && PullChunk(keep);
+
+    const uint32_t fileNumber = (uint32_t) (m_streamFileBase + (file - m_streamFiles.begin()));
+    const uint32_t c = (uint32_t) file->nextChunk++;
+    const auto& chunk = file->corpus->GetChunks()[c];
+    const bool mine = m_streamChunksPulled++ % m_numSubsets == m_subsetNum;
+    m_streamSamplesPulled += chunk.numSamples;
+    if (keep && mine)
+    {
+        if (m_frameMode)
+        {
+            for (size_t t = 0; t < chunk.numSamples; t++)
+                m_window.push_back(ReadUnit{c, (uint32_t) t, fileNumber});
+            file->numUnitsInWindow += chunk.numSamples;
+        }
+        else
+        {
+            for (size_t i = chunk.firstSequence; i < chunk.firstSequence + chunk.numSequences; i++)
+                m_window.push_back(ReadUnit{c, (uint32_t) i, fileNumber});
+            file->numUnitsInWindow += chunk.numSequences;
+        }
+        m_windowSamples += chunk.numSamples;
+    }
+    ReleaseStreamFiles();
+    return true;
+}
+
+// streaming: unmap the files at the front of the stream that have been used up
+template <class ElemType>
+void ChunkedBinaryReader<ElemType>::ReleaseStreamFiles()
+{
+    while (!m_streamFiles.empty() && m_streamFiles.front().numUnitsInWindow == 0 &&
+           m_streamFiles.front().nextChunk == m_streamFiles.front().corpus->GetChunks().size())
+    {
+        m_streamFiles.pop_front();
+        m_streamFileBase++;
+    }
+}
+
+// determine the reading order of a sweep for a subset
+template <class ElemType>
+void ChunkedBinaryReader<ElemType>::StartSweep(size_t sweep, size_t subsetNum, size_t numSubsets)
+{
+    if (sweep == m_sweep && subsetNum == m_subsetNum && numSubsets == m_numSubsets)
+        return;
+    m_sweep = sweep;
+    m_subsetNum = subsetNum;
+    m_numSubsets = numSubsets;
+
+    const auto& chunks = m_corpus->GetChunks();
+    std::mt19937_64 engine(sweep);
+    std::vector<uint32_t> chunkOrder(chunks.size());
+    std::iota(chunkOrder.begin(), chunkOrder.end(), 0);
+    if (m_randomizationWindow > 0)
+    {
+        for (size_t i = chunkOrder.size() - 1; i > 0; i--)
+            std::swap(chunkOrder[i], chunkOrder[engine() % (i + 1)]);
+    }
+
+    const size_t windowSize = max(m_randomizationWindow, (size_t) 1);
+    m_units.clear();
+    m_windowStarts.assign(1, 0);
+    m_windowSampleEnds.clear();
+    size_t numSamples = 0;
+    for (size_t begin = 0; begin < chunkOrder.size(); begin += windowSize)
+    {
+        const size_t end = min(begin + windowSize, chunkOrder.size());
+        for (size_t p = begin; p < end; p++)
+        {
+            const auto& chunk = chunks[chunkOrder[p]];
+            numSamples += chunk.numSamples;
+            if (p % numSubsets != subsetNum)
+                continue;
+            if (m_frameMode)
+            {
+                for (size_t t = 0; t < chunk.numSamples; t++)
+                    m_units.push_back(ReadUnit{chunkOrder[p], (uint32_t) t});
+            }
+            else
+            {
+                for (size_t i = chunk.firstSequence; i < chunk.firstSequence + chunk.numSequences; i++)
+                    m_units.push_back(ReadUnit{chunkOrder[p], (uint32_t) i});
+            }
+        }
+        if (m_randomizationWindow > 0)
+        {
+            const size_t start = m_windowStarts.back();
+            for (size_t i = m_units.size(); i > start + 1; i--)
+                std::swap(m_units[i - 1], m_units[start + engine() % (i - start)]);
+        }
+        if (m_bucketByLength)
+        {
+            const size_t start = m_windowStarts.back();
+            BucketSequencesByLength(m_units, start, m_units.size(), m_units.size() - start, m_numParallelSequences, [this](const ReadUnit& unit)
+                                    {
+                                        return m_corpus->GetSequenceLength(unit.index);
+                                    },
+                                    engine);
+        }
+        m_windowStarts.push_back(m_units.size());
+        m_windowSampleEnds.push_back(numSamples);
+    }
+}
+
+// An epoch of requestedEpochSamples starts at the randomization window that contains its first sample,
+// so consecutive epochs neither overlap nor skip data; an epoch does not extend into the next sweep.
+template <class ElemType>
+void ChunkedBinaryReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
+{
+    if (numSubsets == 0 || subsetNum >= numSubsets)
+        InvalidArgument("ChunkedBinaryReader: invalid subset %d of %d.", (int) subsetNum, (int) numSubsets);
+    m_mbSize = mbSize;
+    if (m_streaming)
+    {
+        // The stream cannot go back: an epoch that is run again (e.g. by a learning-rate search) continues where it is.
+        if (requestedEpochSamples == requestDataSize)
+            InvalidArgument("ChunkedBinaryReader: Reading a stream needs an epoch size (epochSize).");
+        m_subsetNum = subsetNum;
+        m_numSubsets = numSubsets;
+        if (m_streamChunksPulled == 0)
+            m_streamEngine.seed(subsetNum);
+        m_streamEpochStart = epoch * requestedEpochSamples;
+        m_streamEpochEnd = m_streamSamplesPulled < m_streamEpochStart + requestedEpochSamples ? m_streamEpochStart + requestedEpochSamples
+                                                                                                 : m_streamSamplesPulled + requestedEpochSamples;
+        m_streamEpochDone = false;
+        return;
+    }
+    const size_t totalSamples = m_corpus->GetNumSamples();
+    if (requestedEpochSamples == requestDataSize || requestedEpochSamples >= totalSamples)
+    {
+        StartSweep(epoch, subsetNum, numSubsets);
+        m_pos = 0;
+        m_endPos = m_units.size();
+        return;
+    }
+
+    const size_t epochStart = epoch * requestedEpochSamples;
+    StartSweep(epochStart / totalSamples, subsetNum, numSubsets);
+    auto windowStartOf = [this](size_t sample)
+    {
+        const size_t w = std::upper_bound(m_windowSampleEnds.begin(), m_windowSampleEnds.end(), sample) - m_windowSampleEnds.begin();
+        return m_windowStarts[w];
+    };
+    m_pos = windowStartOf(epochStart % totalSamples);
+    m_endPos = windowStartOf(epochStart % totalSamples + requestedEpochSamples);
+}
+
+template <class ElemType>
+bool ChunkedBinaryReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices)
+{
+    if (m_streaming)
+    {
+        if (!GetStreamedMinibatch())
+            return false;
+    }
+    else if (m_pos >= m_endPos)
+    {
+        if (m_bucketByLength)
+            m_gapFrames.Report("ChunkedBinaryReader");
+        return false;
+    }
+    else if (m_frameMode)
+    {
+        const size_t numSamples = min(m_mbSize, m_endPos - m_pos);
+        m_columns.assign(m_units.begin() + m_pos, m_units.begin() + m_pos + numSamples);
+        m_pos += numSamples;
+        m_pMBLayout->InitAsFrameMode(numSamples);
+    }
+    else
+    {
+        // as many whole sequences as fit into the parallel sequences and the minibatch size (at least one)
+        size_t numSequences = 1;
+        size_t numTimeSteps = m_corpus->GetSequenceLength(m_units[m_pos].index);
+        while (numSequences < m_numParallelSequences && m_pos + numSequences < m_endPos)
+        {
+            const size_t length = max(numTimeSteps, m_corpus->GetSequenceLength(m_units[m_pos + numSequences].index));
+            if (length * (numSequences + 1) > m_mbSize)
+                break;
+            numTimeSteps = length;
+            numSequences++;
+        }
+        SetSequenceColumns(m_units.data() + m_pos, numSequences, numTimeSteps);
+        m_pos += numSequences;
+        m_gapFrames.Add(*m_pMBLayout);
+    }
+
+    for (auto& iter : matrices)
+    {
+        auto stream = m_streamOfInput.find(iter.first);
+        if (stream != m_streamOfInput.end())
+            FillMatrix(*iter.second, stream->second, m_columns);
+    }
+    if (m_streaming)
+        ReleaseStreamFiles();
+    return true;
+}
+
+// the columns and the MBLayout of a minibatch of parallel sequences
+template <class ElemType>
+void ChunkedBinaryReader<ElemType>::SetSequenceColumns(const ReadUnit* units, size_t numSequences, size_t numTimeSteps)
+{
+    m_pMBLayout->Init(numSequences, numTimeSteps);
+    m_columns.assign(numSequences * numTimeSteps, ReadUnit{gapChunk, 0, 0});
+    for (size_t s = 0; s < numSequences; s++)
+    {
+        const ReadUnit& unit = units[s];
+        const ChunkedBinaryCorpus& corpus = CorpusOf(unit);
+        const size_t length = corpus.GetSequenceLength(unit.index);
+        const size_t start = corpus.GetSequenceStart(unit.index);
+        for (size_t t = 0; t < length; t++)
+            m_columns[t * numSequences + s] = ReadUnit{unit.chunk, (uint32_t) (start + t), unit.file};
+        m_pMBLayout->AddSequence(NEW_SEQUENCE_ID, s, 0, length);
+        if (length < numTimeSteps)
+            m_pMBLayout->AddGap(s, length, numTimeSteps);
+    }
+}
+
+// streaming: fill the window and draw the next minibatch's units from it into m_columns
+// Chunks are pulled into the window until it holds 'randomize' samples beyond the minibatch, up to the end of the
+// epoch; the epoch ends when no more than the window is left, which carries over into the next epoch.
+template <class ElemType>
+bool ChunkedBinaryReader<ElemType>::GetStreamedMinibatch()
+{
+    if (m_streamEpochDone)
+        return false;
+    while (m_streamSamplesPulled < m_streamEpochStart) // (restarted: skip what has been trained on)
+    {
+        if (!PullChunk(false) && !WaitForData())
+            break;
+    }
+    bool exhausted = false;
+    while (m_streamSamplesPulled < m_streamEpochEnd && m_windowSamples < m_streamWindow + m_mbSize)
+    {
+        if (!PullChunk(true) && !WaitForData())
+        {
+            exhausted = true;
+            break;
+        }
+    }
+    const bool filled = m_streamSamplesPulled >= m_streamEpochEnd;
+    const size_t budget = filled && !exhausted ? (m_windowSamples > m_streamWindow ? min(m_mbSize, m_windowSamples - m_streamWindow) : 0) : m_mbSize;
+    if (m_window.empty() || budget == 0)
+    {
+        m_streamEpochDone = true;
+        return false;
+    }
+
+    // the next unit: a random one of the window, or the oldest without randomization
+    auto draw = [this]() -> const ReadUnit&
+    {
+        if (m_streamWindow > 0)
+            std::swap(m_window.front(), m_window[m_streamEngine() % m_window.size()]);
+        return m_window.front();
+    };
+    auto take = [this]()
+    {
+        const ReadUnit unit = m_window.front();
+        m_window.pop_front();
+        m_streamFiles[unit.file - m_streamFileBase].numUnitsInWindow--;
+        m_windowSamples -= m_frameMode ? 1 : CorpusOf(unit).GetSequenceLength(unit.index);
+        return unit;
+    };
+    m_columns.clear();
+    if (m_frameMode)
+    {
+        const size_t numSamples = min(budget, m_window.size());
+        for (size_t j = 0; j < numSamples; j++)
+        {
+            draw();
+            m_columns.push_back(take());
+        }
+        m_pMBLayout->InitAsFrameMode(numSamples);
+    }
+    else
+    {
+        // as for the corpus, as many whole sequences as fit (at least one); the one that does not fit is drawn first next time
+        std::vector<ReadUnit> units(1, (draw(), take()));
+        size_t numTimeSteps = CorpusOf(units[0]).GetSequenceLength(units[0].index);
+        while (units.size() < m_numParallelSequences && !m_window.empty())
+        {
+            const ReadUnit& unit = draw();
+            const size_t length = max(numTimeSteps, CorpusOf(unit).GetSequenceLength(unit.index));
+            if (length * (units.size() + 1) > budget)
+                break;
+            numTimeSteps = length;
+            units.push_back(take());
+        }
+        SetSequenceColumns(units.data(), units.size(), numTimeSteps);
+    }
+    return true;
+}
+
+// gather the columns from the mapped chunks into a host buffer, and from there into the matrix
+template <class ElemType>
+void ChunkedBinaryReader<ElemType>::FillMatrix(Matrix<ElemType>& matrix, size_t stream, const std::vector<ReadUnit>& columns)
+{
+    const auto& streamDesc = m_streams[stream];
+    const size_t dim = streamDesc.dim;
+    if (matrix.GetMatrixType() == MatrixType::SPARSE)
+    {
+        m_colStarts.assign(1, 0);
+        m_rowIndices.clear();
+        m_values.clear();
+        for (const auto& column : columns)
+        {
+            if (column.chunk == gapChunk)
+                ;
+            else if (streamDesc.isOneHot)
+            {
+                m_rowIndices.push_back((CPUSPARSE_INDEX_TYPE) CorpusOf(column).OneHotIds(column.chunk, stream)[column.index]);
+                m_values.push_back(1);
+            }
+            else if (streamDesc.isSparse)
+            {
+                const ChunkedBinaryCorpus& corpus = CorpusOf(column);
+                const uint32_t* colStarts = corpus.SparseColStarts(column.chunk, stream);
+                const uint32_t* rowIndices = corpus.SparseRowIndices(column.chunk, stream);
+                const float* values = corpus.SparseValues(column.chunk, stream);
+                for (uint32_t p = colStarts[column.index]; p < colStarts[column.index + 1]; p++)
+                {
+                    m_rowIndices.push_back((CPUSPARSE_INDEX_TYPE) rowIndices[p]);
+                    m_values.push_back((ElemType) values[p]);
+                }
+            }
+            else
+            {
+                const float* values = CorpusOf(column).DenseValues(column.chunk, stream) + column.index * dim;
+                for (size_t i = 0; i < dim; i++)
+                {
+                    if (values[i] != 0)
+                    {
+                        m_rowIndices.push_back((CPUSPARSE_INDEX_TYPE) i);
+                        m_values.push_back((ElemType) values[i]);
+                    }
+                }
+            }
+            m_colStarts.push_back((CPUSPARSE_INDEX_TYPE) m_values.size());
+        }
+        matrix.SetMatrixFromCSCFormat(m_colStarts.data(), m_rowIndices.data(), m_values.data(), m_values.size(), dim, columns.size());
+    }
+    else
+    {
+        m_values.assign(dim * columns.size(), 0);
+        for (size_t j = 0; j < columns.size(); j++)
+        {
+            const auto& column = columns[j];
+            ElemType* dst = m_values.data() + j * dim;
+            if (column.chunk == gapChunk)
+                ;
+            else if (streamDesc.isOneHot)
+                dst[CorpusOf(column).OneHotIds(column.chunk, stream)[column.index]] = 1;
+            else if (streamDesc.isSparse)
+            {
+                const ChunkedBinaryCorpus& corpus = CorpusOf(column);
+                const uint32_t* colStarts = corpus.SparseColStarts(column.chunk, stream);
+                const uint32_t* rowIndices = corpus.SparseRowIndices(column.chunk, stream);
+                const float* values = corpus.SparseValues(column.chunk, stream);
+                for (uint32_t p = colStarts[column.index]; p < colStarts[column.index + 1]; p++)
+                    dst[rowIndices[p]] = (ElemType) values[p];
+            }
+            else
+            {
+                const float* values = CorpusOf(column).DenseValues(column.chunk, stream) + column.index * dim;
+                for (size_t i = 0; i < dim; i++)
+                    dst[i] = (ElemType) values[i];
+            }
+        }
+        matrix.SetValue(dim, columns.size(), matrix.GetDeviceId(), m_values.data(), matrixFlagNormal);
+    }
+}
+
+template <class ElemType>
+bool ChunkedBinaryReader<ElemType>::DataEnd(EndDataType endDataType)
+{
+    switch (endDataType)
+    {
+    case endDataEpoch:
+    case endDataSet:
+        return m_streaming ? m_streamEpochDone : m_pos >= m_endPos;
+    case endDataSentence: // the end of a minibatch is always the end of its sequences
+        return true;
+    default:
+        LogicError("ChunkedBinaryReader: invalid EndDataType.");
+    }
+}
+
+// instantiate all the combinations we expect to be used
+template class ChunkedBinaryReader<double>;
+template class ChunkedBinaryReader<float>;
+} } }
@@ -0,0 +1,186 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ChunkedBinaryReader.h - reader for the chunked binary corpus format (ChunkedBinaryCorpus.h)
+//
+#pragma once
+#include "stdafx.h"
+#include "DataReader.h"
+#include "ChunkedBinaryCorpus.h"
+#include "SequenceBucketing.h"
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <deque>
+#include <set>
+#include <random>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// ChunkedBinaryReader -- reads a corpus written by the "convertCorpus" action
+//
+// The corpus is memory-mapped; a minibatch is gathered directly from the mapped chunks.
+// Randomization is two-level, as in the HTK reader: the chunk order is shuffled once per sweep,
+// and samples (frame mode) or sequences are shuffled within each window of randomizationWindow chunks.
+// For distributed reading, every subset reads every numSubsets-th chunk of the shuffled order.
+// One-hot streams (word ids, see convertCorpus' oneHotStreams) go directly into the CSC arrays of a sparse input,
+// so that text corpora need neither tokenizing nor one-hot expansion when training.
+//
+// With streamFiles instead of file, the reader trains on a stream of corpora that keeps growing, e.g. of freshly
+// logged data: it takes the files matching the pattern in name order as they appear (they must be complete when they
+// do, i.e. be written elsewhere and renamed into place), and never reaches the end of the data. There is no sweep to
+// shuffle; instead, each minibatch draws its samples or sequences at random from a sliding window of the last
+// 'randomize' samples read. Epochs are then sample counts (SGD's epochSize is required): epoch e reads the chunks from
+// sample e * epochSize of the stream on, so a restarted job skips what it has trained on. For distributed reading,
+// every subset takes every numSubsets-th chunk of the stream. A file is unmapped once all its samples have been used.
+//
+// reader=[
+//     readerType="ChunkedBinaryReader"
+//     file="corpus.cbc"
+//     #streamFiles="incoming/*.cbc"  # instead of file: read a growing stream of corpora
+//     #pollSeconds=10                # streaming: how often to look for new files when all data have been read
+//     #waitForData=true              # streaming: wait for new files; if false, an epoch ends early when the data run out
+//     randomize="Auto"             # None, Auto, or a randomization window in samples
+//     frameMode=true               # default: true if all sequences have length 1
+//     nbruttsineachrecurrentiter=1 # parallel sequences if not frame mode
+//     bucketByLength=false         # group sequences of similar length within each randomization window
+//     features=[ stream="features" ] # one section per network input; 'stream' defaults to the section name
+// ]
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class ChunkedBinaryReader : public IDataReader<ElemType>
+{
+public:
+    virtual void Init(const ConfigParameters& config) override
+    {
+        InitFromConfig(config);
+    }
+    virtual void Init(const ScriptableObjects::IConfigRecord& config) override
+    {
+        InitFromConfig(config);
+    }
+
+    template <class ConfigRecordType>
+    void InitFromConfig(const ConfigRecordType&);
+
+    ChunkedBinaryReader()
+        : m_randomizationWindow(0), m_frameMode(true), m_numParallelSequences(1), m_bucketByLength(false), m_mbSize(0), m_sweep(SIZE_MAX), m_subsetNum(0), m_numSubsets(1), m_pos(0), m_endPos(0),
+          m_streaming(false), m_pollSeconds(10), m_waitForData(true), m_windowSamples(0), m_streamWindow(0), m_streamFileBase(0), m_streamChunksPulled(0), m_streamSamplesPulled(0),
+          m_streamEpochStart(0), m_streamEpochEnd(0), m_streamEpochDone(false), m_waiting(false)
+    {
+        m_pMBLayout = make_shared<MBLayout>();
+    }
+
+    virtual ~ChunkedBinaryReader()
+    {
+    }
+
+    // Destroy - cleanup and remove this class
+    // NOTE: this destroys the object, and it can't be used past this point
+    virtual void Destroy() override
+    {
+        delete this;
+    }
+
+    virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize) override
+    {
+        StartDistributedMinibatchLoop(mbSize, epoch, 0, 1, requestedEpochSamples);
+    }
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples) override;
+    virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices) override;
+
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return true;
+    }
+
+    virtual bool DataEnd(EndDataType endDataType) override;
+
+    virtual size_t GetNumParallelSequences() override
+    {
+        return m_pMBLayout->GetNumParallelSequences();
+    }
+    virtual void CopyMBLayoutTo(MBLayoutPtr pMBLayout) override
+    {
+        pMBLayout->CopyFrom(m_pMBLayout);
+    }
+
+private:
+    // a sample (frame mode) or a sequence of a chunk, the unit of randomization; also used for the minibatch columns
+    struct ReadUnit
+    {
+        uint32_t chunk; // gapChunk for a gap column
+        uint32_t index; // sample within the chunk (frame mode and columns), or sequence number
+        uint32_t file;  // streaming: number of the file in the stream; else 0
+    };
+    static const uint32_t gapChunk = UINT32_MAX;
+
+    void StartSweep(size_t sweep, size_t subsetNum, size_t numSubsets);
+    void SetSequenceColumns(const ReadUnit* units, size_t numSequences, size_t numTimeSteps);
+    void FillMatrix(Matrix<ElemType>& matrix, size_t stream, const std::vector<ReadUnit>& columns);
+    const ChunkedBinaryCorpus& CorpusOf(const ReadUnit& unit) const
+    {
+        return m_streaming ? *m_streamFiles[unit.file - m_streamFileBase].corpus : *m_corpus;
+    }
+
+    // streaming
+    bool TakeNewFiles();
+    bool PullChunk(bool keep);
+    bool WaitForData();
+    void ReleaseStreamFiles();
+    bool GetStreamedMinibatch();
+
+    std::unique_ptr<ChunkedBinaryCorpus> m_corpus; // (not streaming)
+    std::vector<ChunkedBinaryStream> m_streams;     // of the corpus, or of every file of the stream
+    std::map<std::wstring, size_t> m_streamOfInput; // [network input] corpus stream
+    size_t m_randomizationWindow;                   // in chunks; 0 means no randomization
+    bool m_frameMode;
+    size_t m_numParallelSequences;
+    bool m_bucketByLength;
+    MBLayoutPtr m_pMBLayout;
+    GapFrameCounter m_gapFrames;
+
+    // current sweep, as read by this subset
+    size_t m_mbSize;
+    size_t m_sweep;
+    size_t m_subsetNum, m_numSubsets;
+    std::vector<ReadUnit> m_units;          // in reading order
+    std::vector<ReadUnit> m_columns;        // of the current minibatch
+    std::vector<size_t> m_windowStarts;     // [w] first unit of window w in m_units; one more entry for the end
+    std::vector<size_t> m_windowSampleEnds; // [w] number of samples of all subsets up to the end of window w
+    size_t m_pos;                           // next unit to read
+    size_t m_endPos;                        // end of the epoch in m_units
+
+    // scratch for FillMatrix()
+    std::vector<ElemType> m_values;
+    std::vector<CPUSPARSE_INDEX_TYPE> m_colStarts, m_rowIndices;
+
+    // streaming
+    struct StreamFile
+    {
+        std::shared_ptr<ChunkedBinaryCorpus> corpus;
+        size_t nextChunk;       // to be pulled
+        size_t numUnitsInWindow;
+    };
+    bool m_streaming;
+    std::wstring m_streamPattern;
+    size_t m_pollSeconds;
+    bool m_waitForData;
+    std::set<std::wstring> m_takenFiles;
+    std::deque<StreamFile> m_streamFiles; // the files not yet released, in stream order
+    std::deque<ReadUnit> m_window;        // this subset's units pulled but not yet used
+    size_t m_windowSamples;               // in m_window
+    size_t m_streamWindow;                // randomization window in samples; 0 means no randomization
+    std::mt19937_64 m_streamEngine;
+    size_t m_streamFileBase;              // number of m_streamFiles.front()
+    size_t m_streamChunksPulled;          // of all subsets
+    size_t m_streamSamplesPulled;         // of all subsets
+    size_t m_streamEpochStart, m_streamEpochEnd;
+    bool m_streamEpochDone;
+    bool m_waiting;                       // (reported once per wait)
+};
+} } }
@@ -234,6 +234,7 @@ void DSSMReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfig)
 template <class ElemType>
 DSSMReader<ElemType>::~DSSMReader()
 {
+    m_prefetcher.Stop(); // (before the inputs go away)
     ReleaseMemory();
 }
 
@@ -276,8 +277,9 @@ size_t RoundUp(size_t value, size_t size)
 // epoch - [in] epoch number for this loop, if > 0 the requestedEpochSamples must be specified (unless epoch zero was completed this run)
 // requestedEpochSamples - [in] number of samples to randomize, defaults to requestDataSize which uses the number of samples there are in the dataset
 //   this value must be a multiple of mbSize, if it is not, it will be rounded up to one.
+// subsetNum, numSubsets - [in] distributed reading: this worker reads minibatches subsetNum, subsetNum + numSubsets, ... of the file
 template <class ElemType>
-void DSSMReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples)
+void DSSMReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
 {
     size_t mbStartSample = m_epoch * m_epochSize;
     if (m_totalSamples == 0)
@@ -305,6 +307,22 @@ void DSSMReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_
     }
     m_epoch = epoch;
     m_mbStartSample = epoch * m_epochSize;
+
+    // two minibatches in flight: one being gathered while the other one is copied into the matrices
+    // The records are found through the offset tables, so the minibatches of the other workers are not touched at all.
+    size_t nextSample = subsetNum * m_mbSize;
+    const size_t stride = numSubsets * m_mbSize;
+    m_prefetcher.Start(2, [this, nextSample, stride](PrefetchedMinibatch& minibatch) mutable
+                       {
+                           if (nextSample >= m_totalSamples)
+                               return false;
+                           const size_t numToRead = min(m_mbSize, m_totalSamples - nextSample);
+                           dssm_queryInput.Read_Batch(minibatch.query, nextSample, numToRead);
+                           dssm_docInput.Read_Batch(minibatch.doc, nextSample, numToRead);
+                           nextSample += stride;
+                           minibatch.nextSample = nextSample;
+                           return true;
+                       });
 }
 
 // function to store the LabelType in an ElemType
@@ -333,22 +351,20 @@ bool DSSMReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType>*
     Matrix<ElemType>& featuresD = *matrices[m_featuresNameDoc];
     Matrix<ElemType>& labels = *matrices[m_labelsName]; // will change this part later.
 
-    size_t actualMBSize = (m_readNextSample + m_mbSize > m_totalSamples) ? m_totalSamples - m_readNextSample : m_mbSize;
+    PrefetchedMinibatch* minibatch = m_prefetcher.Next();
+    if (!minibatch)
+        return false;
+    const size_t actualMBSize = minibatch->query.NumCols();
 
     featuresQ.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
     featuresD.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
 
-    /*
-    featuresQ.Resize(dssm_queryInput.numRows, actualMBSize);
-    featuresD.Resize(dssm_docInput.numRows, actualMBSize);
-    */
-
-    // fprintf(stderr, "featuresQ\n");
-    dssm_queryInput.Next_Batch(featuresQ, m_readNextSample, actualMBSize, read_order);
-    // fprintf(stderr, "\n\n\nfeaturesD\n");
-    dssm_docInput.Next_Batch(featuresD, m_readNextSample, actualMBSize, read_order);
-    // fprintf(stderr, "\n\n\n\n\n");
-    m_readNextSample += actualMBSize;
+    featuresQ.SetMatrixFromCOOFormat(minibatch->query.colIndices.data(), minibatch->query.rowIndices.data(), minibatch->query.values.data(),
+                                     minibatch->query.NumNonZeros(), dssm_queryInput.Dim(), actualMBSize);
+    featuresD.SetMatrixFromCOOFormat(minibatch->doc.colIndices.data(), minibatch->doc.rowIndices.data(), minibatch->doc.values.data(),
+                                     minibatch->doc.NumNonZeros(), dssm_docInput.Dim(), actualMBSize);
+    m_readNextSample = minibatch->nextSample;
+    m_prefetcher.Release(minibatch);
     /*
                 featuresQ.Print("featuresQ");
                 fprintf(stderr, "\n");
@@ -552,22 +568,6 @@ void DSSM_BinaryInput<ElemType>::Init(wstring fileName, size_t dim)
 template <class ElemType>
 bool DSSM_BinaryInput<ElemType>::SetupEpoch(size_t minibatchSize)
 {
-    if (values == NULL || mbSize < minibatchSize)
-    {
-        if (values != NULL)
-        {
-            free(values);
-            free(colIndices);
-            free(rowIndices);
-        }
-
-        values = (ElemType*) malloc(sizeof(ElemType) * MAX_BUFFER * minibatchSize);
-        colIndices = (int32_t*) malloc(sizeof(int32_t) * (minibatchSize + 1));
-        rowIndices = (int32_t*) malloc(sizeof(int32_t) * MAX_BUFFER * minibatchSize);
-        // fprintf(stderr, "values  size: %d",sizeof(ElemType)*MAX_BUFFER*minibatchSize);
-        // fprintf(stderr, "colindi size: %d",sizeof(int32_t)*MAX_BUFFER*(1+minibatchSize));
-        // fprintf(stderr, "rowindi size: %d",sizeof(int32_t)*MAX_BUFFER*minibatchSize);
-    }
     if (minibatchSize > mbSize)
     {
         mbSize = minibatchSize;
@@ -575,74 +575,18 @@ bool DSSM_BinaryInput<ElemType>::SetupEpoch(size_t minibatchSize)
 
     return true;
 }
+// Read_Batch - gather the samples [cur, cur + numToRead) into CSC arrays
+// Each sample is stored at its offset as nnz, followed by nnz values and nnz row indices.
 template <class ElemType>
-bool DSSM_BinaryInput<ElemType>::Next_Batch(Matrix<ElemType>& matrices, size_t cur, size_t numToRead, int* /*ordering*/)
+void DSSM_BinaryInput<ElemType>::Read_Batch(SparseCSCBuffer<ElemType>& batch, size_t cur, size_t numToRead) const
 {
-    /*
-    int devId = matrices.GetDeviceId();
-    matrices.TransferFromDeviceToDevice(devId, -1);
-    */
-
-    int32_t cur_index = 0;
-
-    for (int c = 0; c < numToRead; c++, cur++)
-    {
-        // int64_t cur_offset = offsets[ordering[cur]];
-        int64_t cur_offset = offsets[cur];
-        // int64_t cur_offset = offsets[ordering[c]];
-        // int32_t nnz;
-        colIndices[c] = cur_index;
-        int32_t nnz = *(int32_t*) ((char*) data_buffer + cur_offset);
-        // memcpy(&nnz, (char*)data_buffer + cur_offset, sizeof(int32_t));
-        memcpy(values + cur_index, (char*) data_buffer + cur_offset + sizeof(int32_t), sizeof(ElemType) * nnz);
-        memcpy(rowIndices + cur_index, (char*) data_buffer + cur_offset + sizeof(int32_t) + sizeof(ElemType) * nnz, sizeof(int32_t) * nnz);
-        /**
-        fprintf(stderr, "%4d (%3d, %6d): ", c, nnz, cur_index + nnz);
-        for (int i = 0; i < nnz; i++)
-        {
-            fprintf(stderr, "%d:%.f ", rowIndices[cur_index+i], values[cur_index+i]);
-            // matrices.SetValue(rowIndices[cur_index + i], c, values[cur_index + i]);
-        }
-        fprintf(stderr, "\n");
-        **/
-
-        cur_index += nnz;
-    }
-    colIndices[numToRead] = cur_index;
-    /*
-    int col = 0;
-    for (int c = 0; c < cur_index; c++)
+    batch.Clear();
+    for (size_t c = 0; c < numToRead; c++, cur++)
     {
-        if (colIndices[col] == c)
-        {
-            fprintf(stderr, "\n%4d: ", col);
-            col++;
-        }
-        fprintf(stderr, "%d:%.f ", rowIndices[c], values[c]);
+        const char* sample = (const char*) data_buffer + offsets[cur];
+        const int32_t nnz = *(const int32_t*) sample;
+        batch.AppendColumn(sample + sizeof(int32_t), nnz);
     }
-    */
-    /*
-    fprintf(stderr, "\nXXXX nnz: %d\n", cur_index);
-    fprintf(stderr, "XXXX max values read: %d vs %d\n", sizeof(ElemType)*cur_index, sizeof(ElemType)*MAX_BUFFER*numToRead);
-    fprintf(stderr, "XXXX max indices read: %d vs %d\n", sizeof(int32_t)*cur_index, sizeof(int32_t)*MAX_BUFFER*numToRead);
-    fprintf(stderr, "XXXX sizeof(int32_t) = %d, sizeof(int) = %d\n", sizeof(int32_t), sizeof(int));
-    */
-    /*
-        values = (ElemType*)malloc(sizeof(ElemType)*MAX_BUFFER*minibatchSize);
-        colIndices = (int32_t*)malloc(sizeof(int32_t)*MAX_BUFFER*(minibatchSize+1));
-        rowIndices = (int32_t*)malloc(sizeof(int32_t)*MAX_BUFFER*minibatchSize);
-        */
-
-    matrices.SetMatrixFromCSCFormat(colIndices, rowIndices, values, cur_index, m_dim, numToRead);
-    // matrices.Print("actual values");
-    // exit(1);
-    /*
-    matrices.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense);
-    matrices.Print("featuresQ");
-    exit(1);
-    matrices.TransferFromDeviceToDevice(-1,devId);
-    */
-    return true;
 }
 
 template <class ElemType>
@@ -661,18 +605,6 @@ void DSSM_BinaryInput<ElemType>::Dispose()
     {
         free(offsets); // = (ElemType*)malloc(sizeof(float)* 230 * 1024);
     }
-    if (values != NULL)
-    {
-        free(values); // = (ElemType*)malloc(sizeof(float)* 230 * 1024);
-    }
-    if (rowIndices != NULL)
-    {
-        free(rowIndices); // = (int*)malloc(sizeof(float)* 230 * 1024);
-    }
-    if (colIndices != NULL)
-    {
-        free(colIndices); // = (int*)malloc(sizeof(float)* 230 * 1024);
-    }
 }
 
 template <class ElemType>
@@ -9,6 +9,7 @@
 #include "DataWriter.h"
 #include "Config.h"
 #include "RandomOrdering.h"
+#include "PrefetchQueue.h"
 #include <string>
 #include <map>
 #include <vector>
@@ -43,12 +44,8 @@ private:
 
     size_t m_dim;
     size_t mbSize;
-    size_t MAX_BUFFER = 300;
 
-    ElemType* values;    // = (ElemType*)malloc(sizeof(float)* 230 * 1024);
-    int64_t* offsets;    // = (int*)malloc(sizeof(int)* 230 * 1024);
-    int32_t* colIndices; // = (int*)malloc(sizeof(int)* (batchsize + 1));
-    int32_t* rowIndices; // = (int*)malloc(sizeof(int)* MAX_BUFFER * batchsize);
+    int64_t* offsets; // = (int*)malloc(sizeof(int)* 230 * 1024);
 
 public:
     int64_t numRows;
@@ -59,7 +56,11 @@ public:
     ~DSSM_BinaryInput();
     void Init(std::wstring fileName, size_t dim);
     bool SetupEpoch(size_t minibatchSize);
-    bool Next_Batch(Matrix<ElemType>& matrices, size_t cur, size_t numToRead, int* ordering);
+    void Read_Batch(SparseCSCBuffer<ElemType>& batch, size_t cur, size_t numToRead) const; // (only reads the mapping, so may run on the prefetch thread)
+    size_t Dim() const
+    {
+        return m_dim;
+    }
     void Dispose();
 };
 
@@ -78,6 +79,15 @@ private:
     DSSM_BinaryInput<ElemType> dssm_queryInput;
     DSSM_BinaryInput<ElemType> dssm_docInput;
 
+    // the query and doc features of the coming minibatches are gathered from the mappings on a thread of their own
+    struct PrefetchedMinibatch
+    {
+        SparseCSCBuffer<ElemType> query;
+        SparseCSCBuffer<ElemType> doc;
+        size_t nextSample; // where the next minibatch of this worker starts in the file
+    };
+    BufferPrefetcher<PrefetchedMinibatch> m_prefetcher;
+
     size_t m_mbSize;                 // size of minibatch requested
     LabelIdType m_labelIdMax;        // maximum label ID we have encountered so far
     LabelIdType m_labelDim;          // maximum label ID we will ever see (used for array dimensions)
@@ -157,7 +167,15 @@ public:
         m_labelsBuffer = NULL;
     }
     virtual ~DSSMReader();
-    virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize);
+    virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize)
+    {
+        return StartDistributedMinibatchLoop(mbSize, epoch, 0, 1, requestedEpochSamples);
+    }
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return true;
+    }
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
     virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
 
     size_t GetNumParallelSequences()
@@ -300,6 +300,12 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
     m_frameMode = readerConfig(L"frameMode", true);
     m_verbosity = readerConfig(L"verbosity", 2);
 
+    wstring transferFormat(readerConfig(L"transferFormat", L"float"));
+    if (!_wcsicmp(transferFormat.c_str(), L"float16"))
+        m_halfPrecisionTransfer = true;
+    else if (_wcsicmp(transferFormat.c_str(), L"float"))
+        InvalidArgument("HTKMLFReader: transferFormat must be float or float16, not '%ls'.", transferFormat.c_str());
+
     // determine if we partial minibatches are desired
     wstring minibatchMode(readerConfig(L"minibatchMode", L"partial"));
     m_partialMinibatch = !_wcsicmp(minibatchMode.c_str(), L"partial");
@@ -430,6 +436,8 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
     //    statelistpath = readerConfig(L"statelist");
 
     double htktimetoframe = 100000.0; // default is 10ms
+    // parsed MLFs are cached there, for later runs (see htkmlfreader::labelcachefile())
+    const wstring labelCacheDir(readerConfig(L"labelCacheDir", L""));
     // std::vector<msra::asr::htkmlfreader<msra::asr::htkmlfentry,msra::lattices::lattice::htkmlfwordsequence>> labelsmulti;
     std::vector<std::map<std::wstring, std::vector<msra::asr::htkmlfentry>>> labelsmulti;
     // std::vector<std::wstring> pagepath;
@@ -437,7 +445,7 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
     {
         const msra::lm::CSymbolSet* wordmap = unigram ? &unigramsymbols : NULL;
         msra::asr::htkmlfreader<msra::asr::htkmlfentry, msra::lattices::lattice::htkmlfwordsequence>
-        labels(mlfpathsmulti[i], restrictmlftokeys, statelistpaths[i], wordmap, (map<string, size_t>*) NULL, htktimetoframe); // label MLF
+        labels(mlfpathsmulti[i], restrictmlftokeys, statelistpaths[i], wordmap, (map<string, size_t>*) NULL, htktimetoframe, labelCacheDir); // label MLF
         // get the temp file name for the page file
 
         // Make sure 'msra::asr::htkmlfreader' type has a move constructor
@@ -455,8 +463,38 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
         m_lattices->setverbosity(m_verbosity);
 
         // now get the frame source. This has better randomization and doesn't create temp files
-        m_frameSource.reset(new msra::dbn::minibatchutterancesourcemulti(infilesmulti, labelsmulti, m_featDims, m_labelDims, numContextLeft, numContextRight, randomize, *m_lattices, m_latticeMap, m_frameMode));
+        auto utteranceSource = new msra::dbn::minibatchutterancesourcemulti(infilesmulti, labelsmulti, m_featDims, m_labelDims, numContextLeft, numContextRight, randomize, *m_lattices, m_latticeMap, m_frameMode);
+        m_frameSource.reset(utteranceSource);
         m_frameSource->setverbosity(m_verbosity);
+        m_utteranceSource = utteranceSource;
+
+        // read chunks ahead in the background, e.g. from network storage
+        size_t prefetchChunks = readerConfig(L"prefetchChunks", (size_t) 0);
+        size_t prefetchThreads = readerConfig(L"prefetchThreads", (size_t) 2);
+        size_t prefetchMemoryBudgetMB = readerConfig(L"prefetchMemoryBudgetMB", (size_t) 0);
+        utteranceSource->setprefetch(prefetchChunks, prefetchThreads, prefetchMemoryBudgetMB * 1024 * 1024);
+
+        // with several workers, keep each one's chunks after the first sweep in RAM and on local storage, instead of reading them again
+        size_t shardedCacheMemoryMB = readerConfig(L"shardedCacheMemoryMB", (size_t) 0);
+        const wstring shardedCacheDir(readerConfig(L"shardedCacheDir", L""));
+        utteranceSource->setshardedcache(shardedCacheMemoryMB * 1024 * 1024, shardedCacheDir);
+
+        // page chunks into memory-mapped files shared by the workers of a host (e.g. under /dev/shm), which then read each chunk once
+        const wstring sharedChunkStore(readerConfig(L"sharedChunkStore", L""));
+        size_t workersPerHost = readerConfig(L"workersPerHost", (size_t) 1);
+        utteranceSource->setsharedchunkstore(sharedChunkStore, workersPerHost);
+
+        // keep the chunk window in device memory and gather the randomized frames there (frame mode only)
+        m_deviceFrameRandomization = readerConfig(L"deviceFrameRandomization", false);
+        if (m_deviceFrameRandomization)
+        {
+            if (!m_frameMode || m_truncated)
+                InvalidArgument("deviceFrameRandomization requires frameMode=true and truncated=false.");
+            utteranceSource->setdeferframegather(true);
+            m_frameRings.resize(m_featDims.size());
+            m_frameRingColumns.resize(m_featDims.size());
+            m_frameRingColumnIndices.resize(m_featDims.size());
+        }
     }
     else if (!_wcsicmp(readMethod.c_str(), L"rollingWindow"))
     {
@@ -735,6 +773,9 @@ void HTKMLFReader<ElemType>::StartMinibatchLoopToTrainOrTest(size_t mbSize, size
         requestedEpochSamples = totalFrames;
     }
 
+    m_frameRingSweep = SIZE_MAX; // (the new epoch may not continue where the last one left off)
+    if (m_utteranceSource)
+        m_utteranceSource->setshardedcachesubset(subsetNum, numSubsets);
     m_mbiter.reset(new msra::dbn::minibatchiterator(*m_frameSource, epoch, requestedEpochSamples, mbSize, subsetNum, numSubsets, datapasses));
     // Advance the MB iterator until we find some data or reach the end of epoch
     while ((m_mbiter->currentmbframes() == 0) && *m_mbiter)
@@ -1049,11 +1090,11 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                     // dereference matrix that corresponds to key (input/output name) and
                     // populate based on whether its a feature or a label
                     Matrix<ElemType>& data = *matrices[iter->first]; // can be features or labels
-                    if (m_nameToTypeMap[iter->first] == InputOutputTypes::real)
+                    if (m_nameToTypeMap[iter->first] == InputOutputTypes::real && !m_deviceFrameRandomization) // (else already gathered into 'data')
                     {
                         id = m_featureNameToIdMap[iter->first];
                         dim = m_featureNameToDimMap[iter->first];
-                        data.SetValue(dim, m_mbNumTimeSteps * m_numSeqsPerMB, data.GetDeviceId(), m_featuresBufferMultiIO[id].get(), matrixFlagNormal);
+                        SetFeatureValue(data, dim, m_mbNumTimeSteps * m_numSeqsPerMB, m_featuresBufferMultiIO[id].get());
                     }
                     else if (m_nameToTypeMap[iter->first] == InputOutputTypes::category)
                     {
@@ -1328,7 +1369,7 @@ bool HTKMLFReader<ElemType>::GetMinibatchToTrainOrTest(std::map<std::wstring, Ma
                 {
                     id = m_featureNameToIdMap[iter->first];
                     dim = m_featureNameToDimMap[iter->first];
-                    data.SetValue(dim, m_mbNumTimeSteps * m_numSeqsPerMB, data.GetDeviceId(), m_featuresBufferMultiIO[id].get(), matrixFlagNormal);
+                    SetFeatureValue(data, dim, m_mbNumTimeSteps * m_numSeqsPerMB, m_featuresBufferMultiIO[id].get());
                 }
                 else if (m_nameToTypeMap[iter->first] == InputOutputTypes::category)
                 {
@@ -1369,7 +1410,24 @@ void HTKMLFReader<ElemType>::fillOneUttDataforParallelmode(std::map<std::wstring
         // populate based on whether its a feature or a label
         Matrix<ElemType>& data = *matrices[iter->first]; // can be features or labels
 
-        if (m_nameToTypeMap[iter->first] == InputOutputTypes::real)
+        if (m_nameToTypeMap[iter->first] == InputOutputTypes::real && m_deviceFrameRandomization)
+        {
+            // gather the frames and their neighbors from the ring straight into the minibatch (frame mode: this is all of it)
+            id = m_featureNameToIdMap[iter->first];
+            assert(startFr == 0 && channelIndex == 0 && sourceChannelIndex == 0 && m_numSeqsPerMB == 1);
+            Matrix<ElemType>& ring = *m_frameRings[id];
+            if (ring.GetDeviceId() != data.GetDeviceId()) // (first minibatch: now we know the device)
+            {
+                ring.TransferToDeviceIfNotThere(data.GetDeviceId(), true);
+                m_frameRingDeviceId = data.GetDeviceId();
+            }
+            const size_t numNeighbors = m_frameRingColumns[id].size() / framenum;
+            if (!m_frameRingColumnIndices[id])
+                m_frameRingColumnIndices[id] = make_shared<Matrix<ElemType>>(data.GetDeviceId());
+            m_frameRingColumnIndices[id]->SetValue(numNeighbors, framenum, data.GetDeviceId(), m_frameRingColumns[id].data(), matrixFlagNormal);
+            data.AssignRowStackedColumnsOf(ring, *m_frameRingColumnIndices[id]);
+        }
+        else if (m_nameToTypeMap[iter->first] == InputOutputTypes::real)
         {
             id = m_featureNameToIdMap[iter->first];
             dim = m_featureNameToDimMap[iter->first];
@@ -1527,7 +1585,7 @@ bool HTKMLFReader<ElemType>::GetMinibatchToWrite(std::map<std::wstring, Matrix<E
                         }
                     }
                 }
-                data.SetValue(feat.rows(), feat.cols(), data.GetDeviceId(), m_featuresBufferMultiIO[id].get(), matrixFlagNormal);
+                SetFeatureValue(data, feat.rows(), feat.cols(), m_featuresBufferMultiIO[id].get());
             }
         }
         return true;
@@ -1538,6 +1596,21 @@ bool HTKMLFReader<ElemType>::GetMinibatchToWrite(std::map<std::wstring, Matrix<E
     }
 }
 
+// copy a minibatch of features from the host buffer into the input matrix, as half precision if so configured
+template <class ElemType>
+void HTKMLFReader<ElemType>::SetFeatureValue(Matrix<ElemType>& data, size_t dim, size_t numCols, const ElemType* buffer)
+{
+    if (!m_halfPrecisionTransfer || data.GetDeviceId() == CPUDEVICE) // (nothing to gain on the CPU)
+    {
+        data.SetValue(dim, numCols, data.GetDeviceId(), const_cast<ElemType*>(buffer), matrixFlagNormal);
+        return;
+    }
+    m_halfPrecisionBuffer.resize(dim * numCols);
+    for (size_t i = 0; i < m_halfPrecisionBuffer.size(); i++)
+        m_halfPrecisionBuffer[i] = FloatToFloat16((float) buffer[i]);
+    data.SetValueFromCompact(dim, numCols, data.GetDeviceId(), m_halfPrecisionBuffer.data(), compactElementFloat16);
+}
+
 template <class ElemType>
 bool HTKMLFReader<ElemType>::ReNewBufferForMultiIO(size_t i)
 {
@@ -1606,7 +1679,9 @@ bool HTKMLFReader<ElemType>::ReNewBufferForMultiIO(size_t i)
         }
         assert(actualmbsizeOri == m_mbiter->currentmbframes());
 
-        if (sizeof(ElemType) == sizeof(float))
+        if (m_deviceFrameRandomization) // (the frames were not gathered by the source; see UpdateDeviceFrameRing())
+            continue;
+        else if (sizeof(ElemType) == sizeof(float))
         {
             for (int k = 0; k < actualmbsizeOri; k++) // column major, so iterate columns
             {
@@ -1676,6 +1751,10 @@ bool HTKMLFReader<ElemType>::ReNewBufferForMultiIO(size_t i)
 
     m_processedFrame[i] = 0;
 
+    // the source pages out the chunks before the next chunk window when advancing, so upload the current window here
+    if (m_deviceFrameRandomization && m_numFramesToProcess[i] > 0)
+        UpdateDeviceFrameRing();
+
     Timer mbIterAdvancementTimer;
     if (m_verbosity > 2)
         mbIterAdvancementTimer.Start();
@@ -1699,6 +1778,97 @@ bool HTKMLFReader<ElemType>::ReNewBufferForMultiIO(size_t i)
     return true;
 }
 
+// bring the device frame rings up to the chunk window of the minibatch just read, and compute where its frames and their neighbors are
+// The ring is a FIFO of chunks: as the window moves forward, the chunks before it are dropped and the new ones appended, each uploaded once.
+// A new sweep (which randomizes the chunks anew) or a window that does not fit starts over with an empty ring.
+template <class ElemType>
+void HTKMLFReader<ElemType>::UpdateDeviceFrameRing()
+{
+    size_t sweep, windowBegin, windowEnd, subsetNum, numSubsets;
+    m_utteranceSource->getlastchunkwindow(sweep, windowBegin, windowEnd, subsetNum, numSubsets);
+    size_t windowFrames = 0;
+    for (size_t k = windowBegin; k < windowEnd; k++)
+        if (m_utteranceSource->ischunkofsubset(k, subsetNum, numSubsets))
+            windowFrames += m_utteranceSource->getchunknumframes(k);
+
+    if (sweep != m_frameRingSweep || windowFrames > m_frameRingCapacity || windowBegin < m_frameRingWindowBegin || windowEnd < m_frameRingWindowEnd)
+    {
+        if (windowFrames > m_frameRingCapacity)
+        {
+            m_frameRingCapacity = windowFrames + windowFrames / 8; // (some room for the window to grow)
+            if ((size_t)(ElemType)(m_frameRingCapacity - 1) != m_frameRingCapacity - 1)
+                RuntimeError("deviceFrameRandomization: a chunk window of %d frames is too large for column indices of this precision; reduce randomize.", (int) windowFrames);
+            foreach_index (id, m_frameRings)
+            {
+                size_t leftExtent, rightExtent;
+                m_utteranceSource->getcontextextent(id, leftExtent, rightExtent);
+                const size_t featDim = m_featDims[id] / (leftExtent + 1 + rightExtent);
+                m_frameRings[id] = make_shared<Matrix<ElemType>>(featDim, m_frameRingCapacity, m_frameRingDeviceId);
+            }
+            if (m_verbosity > 0)
+                fprintf(stderr, "UpdateDeviceFrameRing: frame rings of %d frames\n", (int) m_frameRingCapacity);
+        }
+        m_frameRingChunkStarts.clear();
+        m_frameRingEnd = 0;
+        m_frameRingSweep = sweep;
+    }
+    m_frameRingWindowBegin = windowBegin;
+    m_frameRingWindowEnd = windowEnd;
+
+    // drop the chunks before the window, and append the new ones
+    while (!m_frameRingChunkStarts.empty() && m_frameRingChunkStarts.begin()->first < windowBegin)
+        m_frameRingChunkStarts.erase(m_frameRingChunkStarts.begin());
+    const size_t firstNewChunk = m_frameRingChunkStarts.empty() ? windowBegin : m_frameRingChunkStarts.rbegin()->first + 1;
+    for (size_t k = firstNewChunk; k < windowEnd; k++)
+    {
+        if (!m_utteranceSource->ischunkofsubset(k, subsetNum, numSubsets))
+            continue;
+        const size_t numFrames = m_utteranceSource->getchunknumframes(k);
+        foreach_index (id, m_frameRings)
+        {
+            const msra::dbn::matrixbase& frames = m_utteranceSource->getchunkframes(id, k);
+            const size_t featDim = frames.rows();
+            m_frameRingUploadBuffer.resize(featDim * numFrames);
+            for (size_t t = 0; t < numFrames; t++) // (the columns of 'frames' are padded)
+                for (size_t d = 0; d < featDim; d++)
+                    m_frameRingUploadBuffer[t * featDim + d] = frames(d, t);
+            // the chunk may wrap around the end of the ring
+            for (size_t t = 0; t < numFrames;)
+            {
+                const size_t ringColumn = (m_frameRingEnd + t) % m_frameRingCapacity;
+                const size_t n = min(numFrames - t, m_frameRingCapacity - ringColumn);
+                Matrix<ElemType> chunkColumns(featDim, n, m_frameRingUploadBuffer.data() + t * featDim, matrixFlagNormal, m_frameRingDeviceId);
+                m_frameRings[id]->SetColumnSlice(chunkColumns, ringColumn, n);
+                t += n;
+            }
+        }
+        m_frameRingChunkStarts[k] = m_frameRingEnd;
+        m_frameRingEnd = (m_frameRingEnd + numFrames) % m_frameRingCapacity;
+    }
+
+    // ring columns of the frames, with the neighbors clamped at the utterance boundaries like augmentneighbors() does
+    const auto& frameRefs = m_utteranceSource->getlastframerefs();
+    foreach_index (id, m_frameRingColumns)
+    {
+        size_t leftExtent, rightExtent;
+        m_utteranceSource->getcontextextent(id, leftExtent, rightExtent);
+        const size_t numNeighbors = leftExtent + 1 + rightExtent;
+        auto& columns = m_frameRingColumns[id];
+        columns.resize(numNeighbors * frameRefs.size());
+        foreach_index (j, frameRefs)
+        {
+            const auto& frameRef = frameRefs[j];
+            const size_t uttBegin = m_frameRingChunkStarts.at(frameRef.chunkindex) + frameRef.utteranceframepos;
+            for (size_t c = 0; c < numNeighbors; c++)
+            {
+                const ptrdiff_t t = (ptrdiff_t) frameRef.frameindex - (ptrdiff_t) leftExtent + (ptrdiff_t) c;
+                const size_t clampedT = (size_t) max((ptrdiff_t) 0, min(t, (ptrdiff_t) frameRef.utterancenumframes - 1));
+                columns[j * numNeighbors + c] = (ElemType)((uttBegin + clampedT) % m_frameRingCapacity);
+            }
+        }
+    }
+}
+
 // GetLabelMapping - Gets the label mapping from integer to type in file
 // mappingTable - a map from numeric datatype to native label type stored as a string
 template <class ElemType>
@@ -9,6 +9,10 @@
 #include "Config.h" // for intargvector
 #include "CUDAPageLockedMemAllocator.h"
 
+namespace msra { namespace dbn {
+class minibatchutterancesourcemulti;
+} }
+
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 template <class ElemType>
@@ -92,6 +96,29 @@ private:
 
     int m_verbosity;
 
+    // device frame randomization (frame mode): the chunks of the randomization window are kept in a ring buffer of columns per feature stream
+    // on the device, uploaded once per chunk, and each minibatch is gathered from there with a single kernel (see UpdateDeviceFrameRing())
+    bool m_deviceFrameRandomization;
+    msra::dbn::minibatchutterancesourcemulti* m_utteranceSource;        // (m_frameSource if it is one, else nullptr)
+    std::vector<shared_ptr<Matrix<ElemType>>> m_frameRings;             // [feature id] [featdim x m_frameRingCapacity]
+    size_t m_frameRingCapacity;                                         // columns of each ring
+    size_t m_frameRingEnd;                                              // the next chunk goes here
+    size_t m_frameRingSweep;                                            // the chunks in the ring are of this sweep; SIZE_MAX when empty
+    size_t m_frameRingWindowBegin, m_frameRingWindowEnd;                // chunk window of the last update
+    std::map<size_t, size_t> m_frameRingChunkStarts;                    // [randomized chunk index] -> first column in the rings
+    DEVICEID_TYPE m_frameRingDeviceId;                                  // where the rings are; CPU until the first minibatch tells
+    std::vector<std::vector<ElemType>> m_frameRingColumns;              // [feature id] ring column of every neighbor of every frame of the buffered minibatch
+    std::vector<shared_ptr<Matrix<ElemType>>> m_frameRingColumnIndices; // [feature id] the same on the device
+    std::vector<ElemType> m_frameRingUploadBuffer;
+
+    void UpdateDeviceFrameRing();
+
+    // transferFormat=float16: features go to the device as half precision (half the bytes of float), and are converted there
+    bool m_halfPrecisionTransfer;
+    std::vector<unsigned short> m_halfPrecisionBuffer;
+
+    void SetFeatureValue(Matrix<ElemType>& data, size_t dim, size_t numCols, const ElemType* buffer);
+
     template <class ConfigRecordType>
     void PrepareForTrainingOrTesting(const ConfigRecordType& config);
     template <class ConfigRecordType>
@@ -140,7 +167,7 @@ public:
     // TODO: this ^^ does not seem to belong here.
 
     HTKMLFReader()
-        : m_pMBLayout(make_shared<MBLayout>())
+        : m_pMBLayout(make_shared<MBLayout>()), m_deviceFrameRandomization(false), m_halfPrecisionTransfer(false), m_utteranceSource(nullptr), m_frameRingCapacity(0), m_frameRingEnd(0), m_frameRingSweep(SIZE_MAX), m_frameRingWindowBegin(0), m_frameRingWindowEnd(0), m_frameRingDeviceId(CPUDEVICE)
     {
     }
     template <class ConfigRecordType>
@@ -21,7 +21,10 @@
 #include <wchar.h>
 #include "simplesenonehmm.h"
 #include <array>
+#include <chrono>
+#include <exception>
 #include "minibatchsourcehelpers.h"
+#include "ReducedPrecision.h"
 
 namespace msra { namespace asr {
 
@@ -137,6 +140,30 @@ protected:
     static const int HASZEROC = 020000;  // _0 0'th Cepstra included
     static const int HASVQ = 040000;     // _V has VQ index attached
     static const int HASTHIRD = 0100000; // _T has Delta-Delta-Delta index attached
+
+public:
+    // compact feature archive -- the frames of an HTK feature file in 16 or 8 bits per value
+    // The file starts with compactmagic and a header that replaces the HTK header (native byte order):
+    //   int version, encoding, nsamples, sampperiod; short sampkind (HTK, without _C); int dim, chunkframes
+    // The frames follow in chunks of chunkframes (the last one may be shorter). With linear encodings, a chunk
+    // starts with float offset[dim] and scale[dim], its range per dimension, and a value is offset + scale * code.
+    // Frames are of fixed size within a chunk, so any range of frames (e.g. an utterance) can be read directly.
+    static const char* compactmagic() // (8 bytes)
+    {
+        return "CNTKCFA\x1a";
+    }
+    static const int compactversion = 1;
+    enum compactencoding
+    {
+        compactnone = 0,
+        compactfp16 = 1,  // IEEE half precision, no chunk parameters
+        compactint16 = 2, // linear, 16 bits per value
+        compactint8 = 3   // linear, 8 bits per value
+    };
+    static size_t compactbytespervalue(int encoding)
+    {
+        return encoding == compactint8 ? 1 : 2;
+    }
 };
 
 // ===========================================================================
@@ -150,7 +177,7 @@ class htkfeatwriter : protected htkfeatio
     vector<float> tmp;
 
 public:
-    short parsekind(const string& str)
+    static short parsekind(const string& str)
     {
         vector<string> params = msra::strfun::split(str, ";");
         if (params.empty())
@@ -337,6 +364,15 @@ class htkfeatreader : protected htkfeatio
     size_t numframes;                    // number of samples for current logical file
     size_t energyElements;               // how many energy elements to add if addEnergy is true
 
+    // compact feature archive (see htkfeatio::compactmagic())
+    int encoding;                 // compactencoding; compactnone for HTK files
+    size_t chunkframes;           // frames per chunk
+    size_t chunkparambytes;       // size of a chunk's offsets and scales
+    size_t curchunk;              // chunk whose offsets and scales are loaded, SIZE_MAX if none
+    size_t firstframe;            // physical frame that the logical frame 0 is
+    vector<float> chunkoffset, chunkscale;
+    vector<unsigned short> tmpShortVector; // for decompression of compact archives
+
 public:
     // parser for complex a=b[s,e] syntax
     struct parsedpath
@@ -441,18 +477,49 @@ private:
         // auto_file_ptr f = fopenOrDie (physpath, L"rbS");
         auto_file_ptr f(fopenOrDie(physpath, L"rb")); // removed 'S' for now, as we mostly run local anyway, and this will speed up debugging
 
+        // a compact feature archive has its own header
+        int encoding = compactnone;
+        size_t chunkframes = 0;
+        char magic[8] = {0};
+        isidxformat = ppath.isidxformat;
+        if (!isidxformat && fread(magic, 1, sizeof(magic), f) == sizeof(magic) && memcmp(magic, compactmagic(), sizeof(magic)) == 0)
+        {
+            int version = fgetint(f);
+            if (version != compactversion)
+                RuntimeError("htkfeatreader: unsupported version %d of the compact feature archive '%ls'", version, physpath.c_str());
+            encoding = fgetint(f);
+            if (encoding != compactfp16 && encoding != compactint16 && encoding != compactint8)
+                RuntimeError("htkfeatreader: invalid encoding %d of the compact feature archive '%ls'", encoding, physpath.c_str());
+        }
+        else
+            fsetpos(f, (uint64_t) 0);
+
         // read the header (12 bytes for htk feature files)
         fileheader H;
-        isidxformat = ppath.isidxformat;
-        if (!isidxformat)
-            H.read(f);
-        else // read header of idxfile
-            H.idxRead(f);
+        bool needbyteswapping = false;
+        if (encoding != compactnone)
+        {
+            H.nsamples = fgetint(f);
+            H.sampperiod = fgetint(f);
+            H.sampkind = fgetshort(f);
+            const int dim = fgetint(f);
+            chunkframes = (size_t) fgetint(f);
+            if (dim <= 0 || chunkframes == 0)
+                RuntimeError("htkfeatreader: invalid header of the compact feature archive '%ls'", physpath.c_str());
+            H.sampsize = (short) (dim * compactbytespervalue(encoding));
+        }
+        else
+        {
+            if (!isidxformat)
+                H.read(f);
+            else // read header of idxfile
+                H.idxRead(f);
 
-        // take a guess as to whether we need byte swapping or not
-        bool needbyteswapping = ((unsigned int) swapint(H.sampperiod) < (unsigned int) H.sampperiod);
-        if (needbyteswapping)
-            H.byteswap();
+            // take a guess as to whether we need byte swapping or not
+            needbyteswapping = ((unsigned int) swapint(H.sampperiod) < (unsigned int) H.sampperiod);
+            if (needbyteswapping)
+                H.byteswap();
+        }
 
         // interpret sampkind
         int basekind = H.sampkind & BASEMASK;
@@ -507,7 +574,9 @@ private:
         }
 
         // other checks
-        size_t bytesPerValue = isidxformat ? 1 : (compressed ? sizeof(short) : sizeof(float));
+        size_t bytesPerValue = isidxformat ? 1 : encoding != compactnone ? compactbytespervalue(encoding) : (compressed ? sizeof(short) : sizeof(float));
+        if (compressed && encoding != compactnone)
+            RuntimeError("htkfeatreader: invalid feature kind of the compact feature archive '%ls'", physpath.c_str());
 
         if (H.sampsize % bytesPerValue != 0)
             RuntimeError("htkfeatreader:sample size not multiple of dimension");
@@ -540,6 +609,20 @@ private:
         this->b.swap(b);
         this->vecbytesize = H.sampsize;
         this->hascrcc = hascrcc;
+        this->encoding = encoding;
+        this->chunkframes = chunkframes;
+        this->chunkparambytes = encoding == compactint16 || encoding == compactint8 ? 2 * dim * sizeof(float) : 0;
+        this->curchunk = SIZE_MAX;
+        this->firstframe = 0;
+    }
+
+    // byte offset of a physical frame
+    uint64_t frameoffset(size_t t) const
+    {
+        if (encoding == compactnone)
+            return physicaldatastart + t * vecbytesize;
+        const uint64_t chunkbytes = chunkparambytes + chunkframes * vecbytesize;
+        return physicaldatastart + (t / chunkframes) * chunkbytes + chunkparambytes + (t % chunkframes) * vecbytesize;
     }
     void close() // force close the open file --use this in case of read failure
     {
@@ -552,6 +635,9 @@ public:
     {
         addEnergy = false;
         energyElements = 0;
+        encoding = compactnone;
+        curchunk = SIZE_MAX;
+        firstframe = 0;
     }
 
     // helper to create a parsed-path object
@@ -577,14 +663,16 @@ public:
             if (ppath.e >= physicalframes)
                 RuntimeError("open: end frame exceeds archive's total number of frames %d in '%ls'", (int) physicalframes, ppath.logicalpath.c_str());
 
-            int64_t dataoffset = physicaldatastart + ppath.s * vecbytesize;
+            int64_t dataoffset = frameoffset(ppath.s);
             fsetpos(f, dataoffset); // we assume fsetpos(), which is our own, is smart to not flush the read buffer
             curframe = 0;
+            firstframe = ppath.s;
             numframes = ppath.e + 1 - ppath.s;
         }
         else // reading a full file
         {
             curframe = 0;
+            firstframe = 0;
             numframes = physicalframes;
             assert(fgetpos(f) == physicaldatastart);
         }
@@ -619,7 +707,9 @@ public:
     {
         if (curframe >= numframes)
             RuntimeError("htkfeatreader:attempted to read beyond end");
-        if (!compressed && !isidxformat) // not compressed--the easy one
+        if (encoding != compactnone)
+            readcompact(v);
+        else if (!compressed && !isidxformat) // not compressed--the easy one
         {
             freadOrDie(v, featdim, f);
             if (needbyteswapping)
@@ -646,6 +736,43 @@ public:
         }
         curframe++;
     }
+
+private:
+    void readcompact(std::vector<float>& v)
+    {
+        const size_t t = firstframe + curframe;
+        if (chunkparambytes > 0 && t / chunkframes != curchunk) // entering a chunk: get its offsets and scales
+        {
+            curchunk = t / chunkframes;
+            fsetpos(f, frameoffset(curchunk * chunkframes) - chunkparambytes);
+            freadOrDie(chunkoffset, featdim, f);
+            freadOrDie(chunkscale, featdim, f);
+            fsetpos(f, frameoffset(t));
+        }
+        v.resize(featdim);
+        if (encoding == compactint8)
+        {
+            freadOrDie(tmpByteVector, featdim, f);
+            for (size_t k = 0; k < featdim; k++)
+                v[k] = chunkoffset[k] + chunkscale[k] * tmpByteVector[k];
+        }
+        else
+        {
+            freadOrDie(tmpShortVector, featdim, f);
+            if (encoding == compactint16)
+            {
+                for (size_t k = 0; k < featdim; k++)
+                    v[k] = chunkoffset[k] + chunkscale[k] * tmpShortVector[k];
+            }
+            else
+            {
+                for (size_t k = 0; k < featdim; k++)
+                    v[k] = Microsoft::MSR::CNTK::HalfToFloat(tmpShortVector[k]);
+            }
+        }
+    }
+
+public:
     // read a sequence of vectors from the open file into a range of frames [ts,te)
     template <class MATRIX>
     void read(MATRIX& feat, size_t ts, size_t te)
@@ -720,6 +847,139 @@ public:
     }
 };
 
+// ===========================================================================
+// htkfeatcompactwriter -- write a compact feature archive (see htkfeatio::compactmagic())
+// Like htkfeatwriter, this writes a single file. convert() turns an HTK feature file or archive into one with the
+// same frames, so that the frame ranges of a script file remain valid for it.
+// ===========================================================================
+
+class htkfeatcompactwriter : protected htkfeatio
+{
+    int encoding;
+    size_t chunkframes;
+    size_t curframe;
+    vector<float> chunk;                 // frames of the current chunk, [t * featdim + k]
+    vector<float> offset, scale;         // per dimension, of the current chunk
+    vector<unsigned short> shortcodes;   // encoded chunk
+    vector<unsigned char> bytecodes;
+
+    static const long nsamplesposition = 16; // (after magic, version and encoding)
+
+public:
+    htkfeatcompactwriter(const wstring& path, const string& kind, size_t dim, unsigned int period, int encoding, size_t chunkframes)
+        : encoding(encoding), chunkframes(chunkframes), curframe(0)
+    {
+        if (encoding != compactfp16 && encoding != compactint16 && encoding != compactint8)
+            LogicError("htkfeatcompactwriter: invalid encoding %d", encoding);
+        if (chunkframes == 0)
+            LogicError("htkfeatcompactwriter: chunks must have at least one frame");
+        setkind(kind, dim, period, path);
+        f = fopenOrDie(path, L"wbS");
+        fwriteOrDie(compactmagic(), 1, 8, f);
+        fputint(f, compactversion);
+        fputint(f, encoding);
+        fputint(f, 0); // nsamples, updated in close()
+        fputint(f, (int) period);
+        fputshort(f, htkfeatwriter::parsekind(kind));
+        fputint(f, (int) dim);
+        fputint(f, (int) chunkframes);
+    }
+
+    // write a frame
+    void write(const vector<float>& v)
+    {
+        if (v.size() != featdim)
+            LogicError("htkfeatcompactwriter: inconsistent feature dimension");
+        chunk.insert(chunk.end(), v.begin(), v.end());
+        if (chunk.size() == chunkframes * featdim)
+            writechunk();
+        curframe++;
+    }
+
+    // finish; this updates the header
+    void close()
+    {
+        if (!chunk.empty())
+            writechunk();
+        fflushOrDie(f);
+        fseekOrDie(f, nsamplesposition);
+        fputint(f, (int) curframe);
+        fflushOrDie(f);
+        f = NULL; // this triggers an fclose() on auto_file_ptr
+    }
+
+    // convert an HTK feature file (a whole archive) into a compact feature archive
+    static size_t convert(const wstring& inpath, const wstring& outpath, int encoding, size_t chunkframes)
+    {
+        htkfeatreader reader;
+        string kind;
+        size_t dim;
+        unsigned int period;
+        reader.getinfo(reader.parse(inpath), kind, dim, period); // (opens the file)
+        wstring tmppath = outpath + L"$$"; // tmp path for make-mode compliant
+        size_t numframes = 0;
+        {
+            htkfeatcompactwriter W(tmppath, kind, dim, period, encoding, chunkframes);
+            vector<float> v;
+            for (; reader; numframes++)
+            {
+                reader.read(v);
+                W.write(v);
+            }
+            W.close();
+        }
+        renameOrDie(tmppath, outpath);
+        return numframes;
+    }
+
+private:
+    void writechunk()
+    {
+        const size_t n = chunk.size() / featdim;
+        if (encoding == compactfp16)
+        {
+            shortcodes.resize(chunk.size());
+            foreach_index (i, chunk)
+                shortcodes[i] = Microsoft::MSR::CNTK::FloatToHalf(chunk[i]);
+            fwriteOrDie(shortcodes, f);
+            chunk.clear();
+            return;
+        }
+
+        // the range of each dimension in this chunk, mapped linearly to the codes
+        const float maxcode = encoding == compactint8 ? 255.0f : 65535.0f;
+        offset.assign(chunk.begin(), chunk.begin() + featdim);
+        vector<float> hi(offset);
+        for (size_t t = 1; t < n; t++)
+        {
+            for (size_t k = 0; k < featdim; k++)
+            {
+                const float x = chunk[t * featdim + k];
+                offset[k] = x < offset[k] ? x : offset[k];
+                hi[k] = x > hi[k] ? x : hi[k];
+            }
+        }
+        scale.resize(featdim);
+        for (size_t k = 0; k < featdim; k++)
+            scale[k] = (hi[k] - offset[k]) / maxcode;
+        fwriteOrDie(offset, f);
+        fwriteOrDie(scale, f);
+
+        shortcodes.resize(chunk.size());
+        for (size_t t = 0; t < n; t++)
+            for (size_t k = 0; k < featdim; k++)
+                shortcodes[t * featdim + k] = scale[k] > 0 ? (unsigned short) ((chunk[t * featdim + k] - offset[k]) / scale[k] + 0.5f) : 0;
+        if (encoding == compactint8)
+        {
+            bytecodes.assign(shortcodes.begin(), shortcodes.end());
+            fwriteOrDie(bytecodes, f);
+        }
+        else
+            fwriteOrDie(shortcodes, f);
+        chunk.clear();
+    }
+};
+
 struct htkmlfentry
 {
     unsigned int firstframe; // range [firstframe,firstframe+numframes)
@@ -844,22 +1104,32 @@ class htkmlfreader : public map<wstring, vector<ENTRY>> // [key][i] the data
         return lines;
     }
 
+    // one MLF entry, parsed independently of all others (so that entries can be parsed in parallel)
+    struct parsedentry
+    {
+        wstring key; // empty if the entry is skipped
+        bool malformedfilename;
+        vector<ENTRY> entries;
+        vector<typename WORDSEQUENCE::word> words;
+        vector<typename WORDSEQUENCE::aligninfo> align;
+    };
+
+    // parse the entry of lines [0, numlines), which start at line 'line' of the file; the last one is the "." line
     template <typename WORDSYMBOLTABLE, typename UNITSYMBOLTABLE>
-    void parseentry(const vector<std::string>& lines, size_t line, const set<wstring>& restricttokeys,
-                    const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap,
-                    vector<typename WORDSEQUENCE::word>& wordseqbuffer, vector<typename WORDSEQUENCE::aligninfo>& alignseqbuffer,
-                    const double htkTimeToFrame)
+    void parseentry(char* const* lines, size_t numlines, const set<wstring>& restricttokeys,
+                    const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap, const double htkTimeToFrame, parsedentry& result)
     {
+        result.key.clear();
+        result.malformedfilename = false;
         size_t idx = 0;
+        while (strcmp(lines[idx], "#!MLF!#") == 0) // skip embedded duplicate MLF headers (so user can 'cat' MLFs)
+            idx++;
         string filename = lines[idx++];
-        while (filename == "#!MLF!#") // skip embedded duplicate MLF headers (so user can 'cat' MLFs)
-            filename = lines[idx++];
 
         // some mlf file have write errors, so skip malformed entry
         if (filename.length() < 3 || filename[0] != '"' || filename[filename.length() - 1] != '"')
         {
-            fprintf(stderr, "warning: filename entry (%s)\n", filename.c_str());
-            fprintf(stderr, "skip current mlf entry from line (%lu) until line (%lu).\n", line + idx, line + lines.size());
+            result.malformedfilename = true;
             return;
         }
 
@@ -874,24 +1144,24 @@ class htkmlfreader : public map<wstring, vector<ENTRY>> // [key][i] the data
 
         // determine lines range
         size_t s = idx;
-        size_t e = lines.size() - 1;
+        size_t e = numlines - 1;
         // lines range: [s,e)
 
         // don't parse unused entries (this is supposed to be used for very small debugging setups with huge MLFs)
         if (!restricttokeys.empty() && restricttokeys.find(key) == restricttokeys.end())
             return;
 
-        vector<ENTRY>& entries = (*this)[key]; // this creates a new entry
-        if (!entries.empty())
-            malformed(msra::strfun::strprintf("duplicate entry '%ls'", key.c_str()));
+        vector<ENTRY>& entries = result.entries;
         entries.resize(e - s);
+        auto& wordseqbuffer = result.words;
+        auto& alignseqbuffer = result.align;
         wordseqbuffer.resize(0);
         alignseqbuffer.resize(0);
         vector<char*> toks;
         for (size_t i = s; i < e; i++)
         {
             // We can mutate the original string as it is no longer needed after tokenization
-            strtok(const_cast<char*>(lines[i].c_str()), " \t", toks);
+            strtok(lines[i], " \t", toks);
             if (statelistmap.size() == 0)
                 entries[i - s].parse(toks, htkTimeToFrame);
             else
@@ -943,11 +1213,202 @@ class htkmlfreader : public map<wstring, vector<ENTRY>> // [key][i] the data
             }
             // if (sentstart < 0 || sentend < 0 || silence < 0)
             //    LogicError("parseentry: word map must contain !silence, !sent_start, and !sent_end");
-            // implant
-            auto& wordsequence = wordsequences[key]; // this creates the map entry
-            wordsequence.words = wordseqbuffer;      // makes a copy
-            wordsequence.align = alignseqbuffer;
         }
+        result.key = move(key);
+    }
+
+    // -----------------------------------------------------------------------
+    // batch parsing
+    // The lines of the file are copied into one arena, in batches of whole entries, so that no line needs an allocation
+    // of its own. The entries of a batch are then parsed in parallel, and merged into the map in file order.
+    // -----------------------------------------------------------------------
+
+    struct linebatch
+    {
+        vector<char> arena;          // the lines, 0-terminated
+        vector<size_t> linestarts;   // [j] offset of line j in arena
+        vector<size_t> entryends;    // [k] one past the last line of entry k
+        vector<size_t> entryfileline; // [k] line number of the first line of entry k in the file
+
+        void clear()
+        {
+            arena.clear();
+            linestarts.clear();
+            entryends.clear();
+            entryfileline.clear();
+        }
+        void addline(const char* line)
+        {
+            linestarts.push_back(arena.size());
+            arena.insert(arena.end(), line, line + strlen(line) + 1);
+        }
+        void endentry(size_t fileline)
+        {
+            entryfileline.push_back(fileline - (linestarts.size() - (entryends.empty() ? 0 : entryends.back())));
+            entryends.push_back(linestarts.size());
+        }
+        size_t numopenlines() const
+        {
+            return linestarts.size() - (entryends.empty() ? 0 : entryends.back());
+        }
+    };
+
+    template <typename WORDSYMBOLTABLE, typename UNITSYMBOLTABLE>
+    void parsebatch(linebatch& batch, const set<wstring>& restricttokeys, const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap,
+                    const double htkTimeToFrame, vector<const wstring*>& newkeys)
+    {
+        const size_t numentries = batch.entryends.size();
+        if (numentries == 0)
+            return;
+        vector<char*> lines(batch.entryends.back());
+        for (size_t j = 0; j < lines.size(); j++)
+            lines[j] = batch.arena.data() + batch.linestarts[j];
+        vector<parsedentry> results(numentries);
+        std::exception_ptr error; // (an exception must not leave the parallel region)
+#pragma omp parallel for schedule(dynamic, 256)
+        for (long k = 0; k < (long) numentries; k++)
+        {
+            const size_t begin = k == 0 ? 0 : batch.entryends[k - 1];
+            try
+            {
+                parseentry(lines.data() + begin, batch.entryends[k] - begin, restricttokeys, wordmap, unitmap, htkTimeToFrame, results[k]);
+            }
+            catch (...)
+            {
+#pragma omp critical
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+        if (error)
+            std::rethrow_exception(error);
+
+        for (size_t k = 0; k < numentries; k++)
+        {
+            auto& result = results[k];
+            if (result.malformedfilename)
+            {
+                const size_t begin = k == 0 ? 0 : batch.entryends[k - 1];
+                fprintf(stderr, "warning: filename entry (%s)\n", lines[begin]);
+                fprintf(stderr, "skip current mlf entry from line (%lu) until line (%lu).\n", batch.entryfileline[k], batch.entryfileline[k] + batch.entryends[k] - begin);
+                continue;
+            }
+            if (result.key.empty() || (!restricttokeys.empty() && this->size() >= restricttokeys.size()))
+                continue;
+            auto ins = this->insert(make_pair(move(result.key), move(result.entries)));
+            if (!ins.second)
+                malformed(msra::strfun::strprintf("duplicate entry '%ls'", ins.first->first.c_str()));
+            newkeys.push_back(&ins.first->first);
+            if (wordmap)
+            {
+                auto& wordsequence = wordsequences[ins.first->first]; // this creates the map entry
+                wordsequence.words = move(result.words);
+                wordsequence.align = move(result.align);
+            }
+        }
+        batch.clear();
+    }
+
+    // -----------------------------------------------------------------------
+    // label cache
+    // With a cache directory, the labels of each MLF are saved in a binary file there after parsing, which later
+    // runs load instead of parsing the MLF again. A cache file is used only if it is newer than the MLF and the
+    // state list, and was made of the same paths, MLF size, and time unit. Only plain state alignments are cached
+    // (no word sequences, phone boundaries, or restriction to a subset of the utterances).
+    // The file is written aside and renamed, so that the workers of a job that all write it do not see a partial one.
+    // -----------------------------------------------------------------------
+
+    wstring labelcachedir;
+    wstring statelistpath;
+
+    wstring labelcachefile(const wstring& path) const
+    {
+        return labelcachedir + L"/" + msra::strfun::wstrprintf(L"%016llx.mlfcache", (unsigned long long) std::hash<wstring>()(path));
+    }
+
+    static size_t labelcacheversion() { return 1; }
+
+    void putcacheheader(FILE* f, const wstring& path, const double htkTimeToFrame) const
+    {
+        fput(f, labelcacheversion());
+        fput(f, sizeof(ENTRY));
+        fputstring(f, path);
+        fput(f, (uint64_t) filesize(path.c_str()));
+        fputstring(f, statelistpath);
+        fput(f, statelistmap.size());
+        fput(f, htkTimeToFrame);
+    }
+
+    bool checkcacheheader(FILE* f, const wstring& path, const double htkTimeToFrame) const
+    {
+        size_t version, entrysize, numstates;
+        uint64_t mlfsize;
+        double timetoframe;
+        fget(f, version);
+        if (version != labelcacheversion())
+            return false;
+        fget(f, entrysize);
+        const wstring cachedpath = fgetwstring(f);
+        fget(f, mlfsize);
+        const wstring cachedstatelistpath = fgetwstring(f);
+        fget(f, numstates);
+        fget(f, timetoframe);
+        return entrysize == sizeof(ENTRY) && cachedpath == path && mlfsize == (uint64_t) filesize(path.c_str()) &&
+               cachedstatelistpath == statelistpath && numstates == statelistmap.size() && timetoframe == htkTimeToFrame;
+    }
+
+    bool readlabelcache(const wstring& path, const double htkTimeToFrame)
+    {
+        const wstring cachefile = labelcachefile(path);
+        if (!msra::files::fuptodate(cachefile, path, false) || (!statelistpath.empty() && !msra::files::fuptodate(cachefile, statelistpath, false)))
+            return false;
+        try
+        {
+            auto_file_ptr f(fopenOrDie(cachefile, L"rb"));
+            if (!checkcacheheader(f, path, htkTimeToFrame))
+                return false;
+            size_t numkeys;
+            fget(f, numkeys);
+            for (size_t k = 0; k < numkeys; k++)
+            {
+                wstring key = fgetwstring(f);
+                size_t numentries;
+                fget(f, numentries);
+                vector<ENTRY> entries(numentries);
+                if (numentries > 0)
+                    freadOrDie(entries.data(), sizeof(ENTRY), numentries, f);
+                if (!this->insert(make_pair(move(key), move(entries))).second)
+                    malformed("duplicate entry in label cache");
+            }
+        }
+        catch (const exception& e)
+        {
+            // (entries read so far stay, and parsing the MLF finds them duplicate; so this must not happen halfway)
+            RuntimeError("htkmlfreader: Label cache %ls for %ls cannot be read (%s). Delete it to parse the MLF again.", cachefile.c_str(), path.c_str(), e.what());
+        }
+        return true;
+    }
+
+    void writelabelcache(const wstring& path, const vector<const wstring*>& keys, const double htkTimeToFrame) const
+    {
+        const wstring cachefile = labelcachefile(path);
+        const wstring tmpfile = cachefile + msra::strfun::wstrprintf(L".%llx.tmp", (unsigned long long) chrono::high_resolution_clock::now().time_since_epoch().count());
+        msra::files::make_intermediate_dirs(cachefile);
+        {
+            auto_file_ptr f(fopenOrDie(tmpfile, L"wb"));
+            putcacheheader(f, path, htkTimeToFrame);
+            fput(f, keys.size());
+            for (const wstring* key : keys)
+            {
+                const vector<ENTRY>& entries = this->find(*key)->second;
+                fputstring(f, *key);
+                fput(f, entries.size());
+                if (!entries.empty())
+                    fwriteOrDie(entries.data(), sizeof(ENTRY), entries.size(), f);
+            }
+            fflushOrDie(f);
+        }
+        renameOrDie(tmpfile, cachefile);
     }
 
 public:
@@ -988,8 +1449,11 @@ public:
 
     // alternate constructor that optionally also reads word alignments (for MMI training); triggered by providing a 'wordmap'
     // (We cannot use an optional arg in the constructor aboe because it interferes with teh template resolution.)
+    // With a labelCacheDir, parsed MLFs are cached there in binary form (see labelcachefile()).
     template <typename WORDSYMBOLTABLE, typename UNITSYMBOLTABLE>
-    htkmlfreader(const vector<wstring>& paths, const set<wstring>& restricttokeys, const wstring& stateListPath, const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap, const double htkTimeToFrame)
+    htkmlfreader(const vector<wstring>& paths, const set<wstring>& restricttokeys, const wstring& stateListPath, const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap, const double htkTimeToFrame,
+                 const wstring& labelCacheDir = L"")
+        : labelcachedir(labelCacheDir)
     {
         // read state list
         if (stateListPath != L"")
@@ -1019,6 +1483,13 @@ public:
         if (!restricttokeys.empty() && this->size() >= restricttokeys.size()) // no need to even read the file if we are there (we support multiple files)
             return;
 
+        const bool usecache = !labelcachedir.empty() && restricttokeys.empty() && !wordmap && symmap.empty();
+        if (usecache && readlabelcache(path, htkTimeToFrame))
+        {
+            fprintf(stderr, "htkmlfreader: read labels of MLF file %ls from cache %ls, total %lu entries\n", path.c_str(), labelcachefile(path).c_str(), this->size());
+            return;
+        }
+
         fprintf(stderr, "htkmlfreader: reading MLF file %ls ...", path.c_str());
         curpath = path; // for error messages only
 
@@ -1027,13 +1498,13 @@ public:
         if (headerLine != "#!MLF!#")
             malformed("header missing");
 
-        // Read the file in blocks and parse MLF entries
-        std::vector<typename WORDSEQUENCE::word> wordsequencebuffer;
-        std::vector<typename WORDSEQUENCE::aligninfo> alignsequencebuffer;
+        // Read the file in blocks, collect its lines into batches of whole entries, and parse these
+        const size_t maxBatchLines = 4000000;
+        linebatch batch;
+        vector<const wstring*> newkeys; // what this MLF adds, for the cache
         size_t readBlockSize = 1000000;
         std::vector<char> currBlockBuf(readBlockSize + 1);
         size_t currLineNum = 1;
-        std::vector<string> currMLFLines;
         bool reachedEOF = (feof(f) != 0);
         char* nextReadPtr = currBlockBuf.data();
         size_t nextReadSize = readBlockSize;
@@ -1054,15 +1525,12 @@ public:
             auto consumeMLFLine = [&](const char* mlfLine)
             {
                 currLineNum++;
-                currMLFLines.push_back(mlfLine);
+                batch.addline(mlfLine);
                 if ((mlfLine[0] == '.') && (mlfLine[1] == 0)) // utterance end delimiter: a single dot on a line
                 {
-                    if (restricttokeys.empty() || (this->size() < restricttokeys.size()))
-                    {
-                        parseentry(currMLFLines, currLineNum - currMLFLines.size(), restricttokeys, wordmap, unitmap, wordsequencebuffer, alignsequencebuffer, htkTimeToFrame);
-                    }
-
-                    currMLFLines.clear();
+                    batch.endentry(currLineNum);
+                    if (batch.linestarts.size() >= maxBatchLines)
+                        parsebatch(batch, restricttokeys, wordmap, unitmap, htkTimeToFrame, newkeys);
                 }
             };
 
@@ -1093,13 +1561,21 @@ public:
                 nextReadPtr = currBlockBuf.data();
                 nextReadSize = readBlockSize;
             }
+
+            // the rest needs no parsing once we have all restricted keys
+            if (!restricttokeys.empty() && this->size() >= restricttokeys.size())
+                break;
         }
 
-        if (!currMLFLines.empty())
+        if (batch.numopenlines() > 0 && (restricttokeys.empty() || this->size() < restricttokeys.size()))
             malformed("unexpected end in mid-utterance");
+        parsebatch(batch, restricttokeys, wordmap, unitmap, htkTimeToFrame, newkeys);
 
         curpath.clear();
         fprintf(stderr, " total %lu entries\n", this->size());
+
+        if (usecache)
+            writelabelcache(path, newkeys, htkTimeToFrame);
     }
 
     // read state list, index is from 0
@@ -1107,6 +1583,7 @@ public:
     {
         if (stateListPath != L"")
         {
+            statelistpath = stateListPath;
             vector<char> buffer; // buffer owns the characters--don't release until done
             vector<char*> lines = readlines(stateListPath, buffer);
             size_t index;
@@ -524,6 +524,60 @@ void lattice::dedup()
     fprintf(stderr, "converted %d lattices\n", toclines.size());
 }
 
+// convert an archive to a mapped archive
+// The lattices are written in V3 format (lattice::fwritemapped()), each at an aligned offset, behind the "LMAP" header
+// by which getlattice() recognizes a mapped archive. Their units are mapped to 'hset' already, and the .symlist is written
+// for that mapping, so that readers with the same model need no mapping at all.
+/*static*/ void archive::convertmapped(const std::wstring &intocpath, const std::wstring &outpath,
+                                       const msra::asr::simplesenonehmm &hset)
+{
+    const auto &modelsymmap = hset.getsymmap();
+
+    const std::wstring tocpath = outpath + L".toc";
+    const std::wstring symlistpath = outpath + L".symlist";
+
+    std::vector<std::wstring> intocpaths(1, intocpath);
+    msra::lattices::archive archive(intocpaths, modelsymmap);
+
+    // read the intocpath file once again to get the keys in original order
+    std::vector<char> textbuffer;
+    auto toclines = msra::files::fgetfilelines(intocpath, textbuffer);
+
+    msra::files::make_intermediate_dirs(outpath);
+    auto_file_ptr f = fopenOrDie(outpath, L"wb");
+    auto_file_ptr ftoc = fopenOrDie(tocpath, L"wb");
+    fputTag(f, "LMAP");
+    fputint(f, mappedarchiveversion);
+
+    foreach_index (i, toclines)
+    {
+        const char *line = toclines[i];
+        const char *p = strchr(line, '=');
+        if (p == NULL)
+            RuntimeError("open: invalid TOC line (no = sign): %s", line);
+        const std::wstring key = msra::strfun::utf16(std::string(line, p - line));
+
+        // fetch lattice  --this expands V2 lattices into the edges/align arrays that V3 stores
+        lattice L;
+        archive.getlattice(key, L);
+
+        // write to archive
+        lattice::fwritepadding(f);
+        uint64_t offset = fgetpos(f);
+        L.fwritemapped(f);
+
+        // write reference to TOC file   --note: TOC file is a headerless UTF8 file; so don't use fprintf %ls format (default code page)
+        fprintfOrDie(ftoc, "%s=%s[%llu]\n", msra::strfun::utf8(key).c_str(), (i == 0) ? msra::strfun::utf8(outpath).c_str() : "", offset);
+    }
+    fflushOrDie(f);
+    fflushOrDie(ftoc);
+
+    // write out the unit map that the lattices were mapped to
+    writeunitmap(symlistpath, modelsymmap);
+
+    fprintf(stderr, "convertmapped: converted %d lattices into a mapped archive of %llu bytes\n", (int) toclines.size(), (unsigned long long) fgetpos(f));
+}
+
 // ---------------------------------------------------------------------------
 // reading lattices from external formats (HTK lat, MLF)
 // ---------------------------------------------------------------------------
@@ -360,6 +360,26 @@ class mgram_map
     std::vector<int24_vector> ids;            // [M+1][i] ([0] = not used)
     bool level1nonsparse;                     // true: level[1] can be directly looked up
     std::vector<index_t> level1lookup;        // id->index for unigram level
+
+    // hash tables for find_child() in the levels above the unigram level (built by created())
+    // A lookup costs one multiplication and typically a single cache line, instead of a binary search over the
+    // children of a history. Open addressing with linear probing, at most 2/3 full. Entries are 16 bytes, so that
+    // 4 of them share a cache line.
+    struct childentry
+    {
+        unsigned long long key; // history index and child id, see childkey()
+        index_t i;              // index of the child in level m+1; nindex marks an empty slot
+        index_t unused;
+    };
+    std::vector<std::vector<childentry>> childhashes; // [m] children of level m in level m+1 ([0] not used)
+    static unsigned long long childkey(index_t i, int id)
+    {
+        return ((unsigned long long) i << 32) | (unsigned int) id;
+    }
+    static size_t childslot(unsigned long long key, size_t mask)
+    {
+        return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    }
     static void fail(const char *msg)
     {
         RuntimeError("mgram_map::%s", msg);
@@ -399,6 +419,19 @@ class mgram_map
             assert(i == nindex || ids[1][i] == id);
             return i;
         }
+        if (m < (int) childhashes.size() && !childhashes[m].empty())
+        {
+            const std::vector<childentry> &hash = childhashes[m];
+            const size_t mask = hash.size() - 1;
+            const unsigned long long k = childkey(i, id);
+            for (size_t s = childslot(k, mask);; s = (s + 1) & mask)
+            {
+                if (hash[s].i == nindex)
+                    return nindex; // not found
+                if (hash[s].key == k)
+                    return hash[s].i;
+            }
+        }
         index_t beg = firsts[m][i];
         index_t end = firsts[m][i + 1];
         const int24_vector &ids_m1 = ids[m + 1];
@@ -416,6 +449,38 @@ class mgram_map
         return nindex; // not found
     }
 
+    // build the hash tables of find_child() for the levels above the unigram level
+    void createhashes()
+    {
+        childhashes.assign(M, std::vector<childentry>());
+        for (int m = 1; m < M; m++)
+        {
+            const int24_vector &ids_m1 = ids[m + 1];
+            const size_t n = ids_m1.size();
+            if (n == 0)
+                continue;
+            size_t size = 1;
+            while (size < n + n / 2 + 1)
+                size *= 2;
+            const childentry empty = {0, nindex, 0};
+            std::vector<childentry> &hash = childhashes[m];
+            hash.assign(size, empty);
+            const size_t mask = size - 1;
+            for (index_t i = 0; i + 1 < (index_t) firsts[m].size(); i++)
+            {
+                for (index_t j = firsts[m][i]; j < firsts[m][i + 1]; j++)
+                {
+                    const unsigned long long k = childkey(i, ids_m1[j]);
+                    size_t s = childslot(k, mask);
+                    while (hash[s].i != nindex)
+                        s = (s + 1) & mask;
+                    hash[s].key = k;
+                    hash[s].i = j;
+                }
+            }
+        }
+    }
+
 public:
     // --- allocation
 
@@ -456,6 +521,8 @@ public:
         M = newM;
         firsts.resize(M);
         ids.resize(M + 1);
+        if (childhashes.size() > (size_t) M)
+            childhashes.resize(M);
     }
     // destruct
     void clear()
@@ -463,6 +530,7 @@ public:
         M = 0;
         firsts.clear();
         ids.clear();
+        childhashes.clear();
         w2id.clear();
         id2w.clear();
         idmax = -1;
@@ -480,6 +548,7 @@ public:
         ids.swap(other.ids);
         ::swap(level1nonsparse, other.level1nonsparse);
         level1lookup.swap(other.level1lookup);
+        childhashes.swap(other.childhashes);
         w2id.swap(other.w2id);
         id2w.swap(other.id2w);
         ::swap(idmax, other.idmax);
@@ -938,6 +1007,7 @@ public:
     {
         if (k.m < 1)
             return coord(); // (root need not be created)
+        childhashes.clear(); // (find_child() searches while the map grows; created() builds them again)
         // locate history (must exist), also updates cache[]
         bool prevValid = true;
         index_t i = 0; // index of history in level k.m-1
@@ -1004,6 +1074,7 @@ public:
     // call this at the end
     //  - establish the w->id mapping that is used in operator[]
     //  - finalize the firsts arrays
+    //  - build the hash tables for the lookup
     // This function swaps the user-provided map and our current one.
     // We use swapping to avoid the memory allocation (noone else outside should
     // have to keep the map).
@@ -1020,6 +1091,7 @@ public:
                 assert(firsts[m][i] <= firsts[m][i + 1]);
             assert((size_t) firsts[m].back() == ids[m + 1].size());
         }
+        createhashes();
         // id mapping
         // user-provided w->id map
         ::swap(w2id, userToLMSymMap);
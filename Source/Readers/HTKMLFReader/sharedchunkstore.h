@@ -0,0 +1,157 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// sharedchunkstore.h -- frames of paged-in chunks in memory-mapped files, shared by the processes on a host
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "fileutil.h"
+#include "ssematrix.h"
+#include "CrossProcessMutex.h"
+#include <functional>
+#include <memory>
+#include <string>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace msra { namespace dbn {
+
+// ---------------------------------------------------------------------------
+// sharedchunkframes -- the read-only frames [featdim x numframes] of a chunk in a memory-mapped file
+// The file holds the columns with the SSE column stride of ssematrix, so that the mapping can be viewed as a matrix.
+// ---------------------------------------------------------------------------
+
+class sharedchunkframes
+{
+    sharedchunkframes(const sharedchunkframes &);
+    void operator=(const sharedchunkframes &);
+
+    void *base; // mapped view
+    size_t bytes;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+    std::unique_ptr<msra::math::ssematrixfrombuffer> view; // (over 'base')
+
+public:
+    static size_t filebytes(size_t rows, size_t cols)
+    {
+        return msra::math::ssematrixfrombuffer::elementsneeded(rows, cols) * sizeof(float);
+    }
+
+    sharedchunkframes(const std::wstring &path, size_t rows, size_t cols)
+        : base(nullptr), bytes(filebytes(rows, cols))
+    {
+        const size_t size = filesize(path.c_str());
+        if (size != bytes)
+            RuntimeError("sharedchunkframes: file %ls has %d bytes, expected %d", path.c_str(), (int) size, (int) bytes);
+#ifdef _WIN32
+        file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            RuntimeError("sharedchunkframes: cannot open %ls", path.c_str());
+        mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL)
+            base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!base)
+        {
+            if (mapping != NULL)
+                CloseHandle(mapping);
+            CloseHandle(file);
+            RuntimeError("sharedchunkframes: cannot map %ls", path.c_str());
+        }
+#else
+        const int fd = open(msra::strfun::utf8(path).c_str(), O_RDONLY);
+        if (fd < 0)
+            RuntimeError("sharedchunkframes: cannot open %ls", path.c_str());
+        base = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd); // (the mapping keeps the file)
+        if (base == MAP_FAILED)
+        {
+            base = nullptr;
+            RuntimeError("sharedchunkframes: cannot map %ls", path.c_str());
+        }
+#endif
+        array_ref<float> buffer((float *) base, bytes / sizeof(float));
+        view.reset(new msra::math::ssematrixfrombuffer(buffer, rows, cols));
+    }
+
+    ~sharedchunkframes()
+    {
+        view.reset();
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle(mapping);
+        CloseHandle(file);
+#else
+        munmap(base, bytes);
+#endif
+    }
+
+    // the frames; they must not be written to
+    msra::dbn::matrixbase &frames() const
+    {
+        return *view;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// sharedchunkstore -- chunk frames in a host-local directory, read from the archives once per host
+//
+// The first process that asks for a chunk reads its frames, writes them to a file of the store, and renames it into
+// place; the others wait for it (a CrossProcessMutex per chunk) and map the file, so the chunk is in RAM once per
+// host however many processes have it paged in. On Linux, a directory under /dev/shm keeps the files in memory.
+// The store keeps what its processes have read; the directory should be specific to the corpus and the job, and be
+// removed after it.
+// ---------------------------------------------------------------------------
+
+class sharedchunkstore
+{
+    std::wstring dir;
+    std::string lockprefix; // (CrossProcessMutex names are system-wide)
+
+public:
+    sharedchunkstore(const std::wstring &dir)
+        : dir(dir)
+    {
+        lockprefix = msra::strfun::strprintf("CNTK.sharedchunkstore.%016llx.", (unsigned long long) std::hash<std::wstring>()(dir));
+    }
+
+    // the frames of the chunk 'name'; 'read' fills a matrix with them if no process on this host has done so yet
+    std::shared_ptr<sharedchunkframes> get(const std::string &name, size_t rows, size_t cols, const std::function<void(msra::dbn::matrix &)> &read)
+    {
+        const std::wstring path = dir + L"/" + msra::strfun::utf16(name) + L".frames";
+        if (!fexists(path))
+        {
+            CrossProcessMutex lock(lockprefix + name);
+            if (!lock.Acquire(true /*wait*/))
+                RuntimeError("sharedchunkstore: cannot acquire the lock of chunk %s", name.c_str());
+            if (!fexists(path)) // (else another process has written it while we waited)
+            {
+                msra::dbn::matrix frames;
+                read(frames);
+                if (frames.rows() != rows || frames.cols() != cols)
+                    LogicError("sharedchunkstore: chunk %s read as %d x %d, expected %d x %d", name.c_str(), (int) frames.rows(), (int) frames.cols(), (int) rows, (int) cols);
+                const std::wstring tmppath = path + L".tmp";
+                msra::files::make_intermediate_dirs(tmppath);
+                FILE *f = fopenOrDie(tmppath, L"wb");
+                const size_t colstride = sharedchunkframes::filebytes(rows, 1) / sizeof(float);
+                std::vector<float> column(colstride, 0.0f); // (with the padding)
+                for (size_t j = 0; j < cols; j++)
+                {
+                    memcpy(column.data(), &frames(0, j), rows * sizeof(float));
+                    fwriteOrDie(column.data(), sizeof(float), colstride, f);
+                }
+                fcloseOrDie(f);
+                renameOrDie(tmppath, path);
+            }
+            lock.Release();
+        }
+        return std::make_shared<sharedchunkframes>(path, rows, cols);
+    }
+};
+} }
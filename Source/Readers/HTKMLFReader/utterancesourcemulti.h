@@ -12,7 +12,11 @@
 #include "latticearchive.h" // for reading HTK phoneme lattices (MMI training)
 #include "minibatchsourcehelpers.h"
 #include "minibatchiterator.h"
+#include "sharedchunkstore.h"
 #include "unordered_set"
+#include <future>
+#include <map>
+#include <chrono>
 
 namespace msra { namespace dbn {
 
@@ -85,6 +89,7 @@ class minibatchutterancesourcemulti : public minibatchsource
 
         std::vector<size_t> firstframes;                                            // [utteranceindex] first frame for given utterance
         mutable msra::dbn::matrix frames;                                           // stores all frames consecutively (mutable since this is a cache)
+        mutable std::shared_ptr<sharedchunkframes> sharedframes;                    // or they are in a sharedchunkstore (then 'frames' is empty)
         size_t totalframes;                                                         // total #frames for all utterances in this chunk
         mutable std::vector<shared_ptr<const latticesource::latticepair>> lattices; // (may be empty if none)
 
@@ -117,7 +122,13 @@ class minibatchutterancesourcemulti : public minibatchsource
                 LogicError("getutteranceframes: called when data have not been paged in");
             const size_t ts = firstframes[i];
             const size_t n = numframes(i);
-            return msra::dbn::matrixstripe(frames, ts, n);
+            return msra::dbn::matrixstripe(chunkframes(), ts, n);
+        }
+        msra::dbn::matrixbase &chunkframes() const // all frames, wherever they are
+        {
+            if (sharedframes)
+                return sharedframes->frames();
+            return frames;
         }
         shared_ptr<const latticesource::latticepair> getutterancelattice(size_t i) const // return the frame set for a given utterance
         {
@@ -130,7 +141,7 @@ class minibatchutterancesourcemulti : public minibatchsource
         // test if data is in memory at the moment
         bool isinram() const
         {
-            return !frames.empty();
+            return !frames.empty() || sharedframes;
         }
         // page in data for this chunk
         // We pass in the feature info variables by ref which will be filled lazily upon first read
@@ -173,6 +184,68 @@ class minibatchutterancesourcemulti : public minibatchsource
                 throw;
             }
         }
+        // read the frames of this chunk into 'chunkframes' without touching the chunk, e.g. on a prefetch thread
+        // The feature kind info must have been determined by a requiredata() call before.
+        void readframes(const string &featkind, size_t featdim, unsigned int sampperiod, msra::dbn::matrix &chunkframes) const
+        {
+            msra::asr::htkfeatreader reader; // (each call has its own reader, so concurrent calls are independent)
+            chunkframes.resize(featdim, totalframes);
+            foreach_index (i, utteranceset)
+            {
+                msra::dbn::matrixstripe uttframes(chunkframes, firstframes[i], numframes(i));
+                reader.read(utteranceset[i].parsedpath, featkind, sampperiod, uttframes);
+            }
+        }
+        // page in data for this chunk from frames read by readframes(); lattices are read here
+        void installdata(msra::dbn::matrix &&chunkframes, const latticesource &latticesource, int verbosity = 0) const
+        {
+            if (numutterances() == 0)
+                LogicError("installdata: cannot page in virgin block");
+            if (isinram())
+                LogicError("installdata: called when data is already in memory");
+            frames = std::move(chunkframes);
+            try
+            {
+                if (!latticesource.empty())
+                {
+                    lattices.resize(utteranceset.size());
+                    foreach_index (i, utteranceset)
+                        latticesource.getlattices(utteranceset[i].key(), lattices[i], numframes(i));
+                }
+                if (verbosity)
+                    fprintf(stderr, "installdata: %d prefetched utterances installed\n", (int) utteranceset.size());
+            }
+            catch (...)
+            {
+                releasedata();
+                throw;
+            }
+        }
+        // page in data for this chunk from frames in a sharedchunkstore; lattices are read here
+        void installshareddata(std::shared_ptr<sharedchunkframes> &&chunkframes, const latticesource &latticesource, int verbosity = 0) const
+        {
+            if (numutterances() == 0)
+                LogicError("installshareddata: cannot page in virgin block");
+            if (isinram())
+                LogicError("installshareddata: called when data is already in memory");
+            sharedframes = std::move(chunkframes);
+            try
+            {
+                if (!latticesource.empty())
+                {
+                    lattices.resize(utteranceset.size());
+                    foreach_index (i, utteranceset)
+                        latticesource.getlattices(utteranceset[i].key(), lattices[i], numframes(i));
+                }
+                if (verbosity)
+                    fprintf(stderr, "installshareddata: %d utterances mapped\n", (int) utteranceset.size());
+            }
+            catch (...)
+            {
+                releasedata();
+                throw;
+            }
+        }
         // page out data for this chunk
         void releasedata() const
         {
@@ -182,6 +255,7 @@ class minibatchutterancesourcemulti : public minibatchsource
                 LogicError("releasedata: called when data is not memory");
             // release frames
             frames.resize(0, 0);
+            sharedframes.reset();
             // release lattice data
             lattices.clear();
         }
@@ -240,6 +314,47 @@ class minibatchutterancesourcemulti : public minibatchsource
     };
     std::vector<std::vector<chunk>> randomizedchunks; // utterance chunks after being brought into random order (we randomize within a rolling window over them)
     size_t chunksinram;                               // (for diagnostics messages)
+
+    // asynchronous read-ahead of the chunks at and beyond the current chunk window (see setprefetch())
+    size_t prefetchchunks;       // how many chunks beyond the window to read ahead; 0 means no prefetching
+    size_t prefetchthreads;      // max number of concurrent chunk reads, each with its own htkfeatreader
+    size_t prefetchmemorybudget; // [bytes] don't prefetch if frames in RAM plus prefetched frames would exceed this; 0 means no limit
+    std::map<const utterancechunkdata *, std::future<std::vector<msra::dbn::matrix>>> prefetchedchunks; // [chunk data of first stream] frames of all streams
+
+    // local cache of the chunks of this subset across sweeps (see setshardedcache())
+    bool shardedcache;                                // randomize chunks within subsets and keep the chunks of this subset
+    size_t shardedcachememorybudget;                  // [bytes] for chunks kept in RAM after they left the chunk window
+    wstring shardedcachedir;                          // chunks beyond the budget are written here (e.g. a local SSD); empty: not kept
+    size_t shardedcachebytes;                         // bytes of the chunks kept in RAM
+    std::set<const utterancechunkdata *> cachedchunks; // [chunk data of first stream] chunks kept in RAM
+    std::set<const utterancechunkdata *> spilledchunks; // [chunk data of first stream] chunks whose frames are in shardedcachedir
+    size_t randomizationsubsets;                      // numsubsets the current randomization was made for, if shardedcache
+    size_t cachesubsetnum;                            // subset of the last getbatch() (for the names of the spill files)
+
+    // chunks shared by the processes of a host (see setsharedchunkstore())
+    std::unique_ptr<sharedchunkstore> chunkstore; // null if chunks are paged into private memory
+    size_t hostsubsets;                           // number of consecutive subsets that page in the same chunks, as they share a host
+
+    // frame mode without gathering the frames in getbatch() (see setdeferframegather())
+public:
+    struct gatherframeref // where a returned frame lives
+    {
+        size_t chunkindex;         // in this chunk (index into randomizedchunks[])
+        size_t utteranceframepos;  // the utterance starts at this frame of the chunk
+        size_t utterancenumframes; // (for clamping the neighbor frames at the utterance boundaries)
+        size_t frameindex;         // frame index within the utterance
+        gatherframeref(size_t chunkindex, size_t utteranceframepos, size_t utterancenumframes, size_t frameindex)
+            : chunkindex(chunkindex), utteranceframepos(utteranceframepos), utterancenumframes(utterancenumframes), frameindex(frameindex)
+        {
+        }
+    };
+
+private:
+    bool deferframegather;
+    std::vector<gatherframeref> lastframerefs; // [j] for the frames of the last getbatch()
+    size_t lastsweep;                           // and its sweep, chunk window, and subset
+    size_t lastwindowbegin, lastwindowend;
+    size_t lastsubsetnum, lastnumsubsets;
     struct utteranceref                               // describes the underlying random utterance associated with an utterance position
     {
         size_t chunkindex;     // lives in this chunk (index into randomizedchunks[])
@@ -389,7 +504,7 @@ public:
     minibatchutterancesourcemulti(const std::vector<std::vector<wstring>> &infiles, const std::vector<map<wstring, std::vector<msra::asr::htkmlfentry>>> &labels,
                                   std::vector<size_t> vdim, std::vector<size_t> udim, std::vector<size_t> leftcontext, std::vector<size_t> rightcontext, size_t randomizationrange,
                                   const latticesource &lattices, const map<wstring, msra::lattices::lattice::htkmlfwordsequence> &allwordtranscripts, const bool framemode)
-        : vdim(vdim), leftcontext(leftcontext), rightcontext(rightcontext), sampperiod(0), featdim(0), randomizationrange(randomizationrange), currentsweep(SIZE_MAX), lattices(lattices), allwordtranscripts(allwordtranscripts), framemode(framemode), chunksinram(0), timegetbatch(0), verbosity(2)
+        : vdim(vdim), leftcontext(leftcontext), rightcontext(rightcontext), sampperiod(0), featdim(0), randomizationrange(randomizationrange), currentsweep(SIZE_MAX), lattices(lattices), allwordtranscripts(allwordtranscripts), framemode(framemode), chunksinram(0), prefetchchunks(0), prefetchthreads(1), prefetchmemorybudget(0), deferframegather(false), lastsweep(SIZE_MAX), lastwindowbegin(0), lastwindowend(0), lastsubsetnum(0), lastnumsubsets(1), shardedcache(false), shardedcachememorybudget(0), shardedcachebytes(0), randomizationsubsets(1), cachesubsetnum(0), hostsubsets(1), timegetbatch(0), verbosity(2)
     // [v-hansu] change framemode (lattices.empty()) into framemode (false) to run utterance mode without lattice
     // you also need to change another line, search : [v-hansu] comment out to run utterance mode without lattice
     {
@@ -714,6 +829,39 @@ private:
             ::swap(v[i], v[irand]);
         }
     }
+    // shuffle such that every element stays at a position congruent to its own modulo numsubsets
+    // With this, subset s (k % numsubsets == s) gets the same chunks in every sweep, only in a different order.
+    template <typename VECTOR>
+    static void randomshufflewithinsubsets(VECTOR &v, size_t numsubsets, size_t randomseed)
+    {
+        for (size_t s = 0; s < numsubsets && s < v.size(); s++)
+        {
+            VECTOR subset;
+            for (size_t k = s; k < v.size(); k += numsubsets)
+                subset.push_back(v[k]);
+            randomshuffle(subset, randomseed * numsubsets + s);
+            for (size_t k = s, i = 0; k < v.size(); k += numsubsets, i++)
+                v[k] = subset[i];
+        }
+    }
+
+    // data-parallel subsets: the subsets are in groups of 'hostsubsets' that share a host; chunk k is paged in by the
+    // subsets of group k % numgroups, and an item (utterance position or frame) of it is returned by one of them
+    size_t numsubsetgroups(size_t numsubsets) const
+    {
+        return (hostsubsets > 1 && numsubsets % hostsubsets == 0) ? numsubsets / hostsubsets : numsubsets;
+    }
+    bool ischunkforsubset(size_t k, size_t subsetnum, size_t numsubsets) const
+    {
+        const size_t numgroups = numsubsetgroups(numsubsets);
+        return (k % numgroups) == subsetnum / (numsubsets / numgroups);
+    }
+    size_t subsetforitem(size_t k, size_t itempos, size_t numsubsets) const
+    {
+        const size_t numgroups = numsubsetgroups(numsubsets);
+        const size_t groupsize = numsubsets / numgroups;
+        return (k % numgroups) * groupsize + itempos % groupsize;
+    }
     static void checkoverflow(size_t fieldval, size_t targetval, const char *fieldname)
     {
         if (fieldval != targetval)
@@ -771,7 +919,10 @@ private:
             assert(randomizedchunkrefs[i].size() == allchunks[i].size());
 
             // note that sincew randomshuffle() uses sweep as seed, this will keep the randomization common across all feature streams
-            randomshuffle(randomizedchunkrefs[i], sweep); // bring into random order (with random seed depending on sweep)
+            if (shardedcache && randomizationsubsets > 1)
+                randomshufflewithinsubsets(randomizedchunkrefs[i], randomizationsubsets, sweep); // (so that the chunks of a subset stay in its cache)
+            else
+                randomshuffle(randomizedchunkrefs[i], sweep); // bring into random order (with random seed depending on sweep)
         }
 
         // place them onto the global timeline -> randomizedchunks[]
@@ -1058,8 +1209,11 @@ private:
     }
 
     // helper to page out a chunk with log message
+    // With the sharded cache, the chunk is kept in RAM while the budget allows, else its frames are written to the cache directory.
     void releaserandomizedchunk(size_t k)
     {
+        if (shardedcache && !chunkstore && randomizedchunks[0][k].getchunkdata().isinram() && cacheorspillrandomizedchunk(k)) // (the store keeps the chunks anyway)
+            return;
         size_t numreleased = 0;
         foreach_index (m, randomizedchunks)
         {
@@ -1084,6 +1238,47 @@ private:
         return;
     }
 
+    // keep a chunk that leaves the chunk window in RAM, or write it to the cache directory; returns true if it stays in RAM
+    bool cacheorspillrandomizedchunk(size_t k)
+    {
+        const utterancechunkdata *key = &randomizedchunks[0][k].getchunkdata();
+        if (cachedchunks.find(key) != cachedchunks.end())
+            return true;
+        const size_t bytes = chunkbytes(k);
+        if (shardedcachebytes + bytes <= shardedcachememorybudget)
+        {
+            cachedchunks.insert(key);
+            shardedcachebytes += bytes;
+            if (verbosity)
+                fprintf(stderr, "releaserandomizedchunk: keeping randomized chunk %d in RAM, %.1f MB cached\n", (int) k, shardedcachebytes / 1e6);
+            return true;
+        }
+        if (!shardedcachedir.empty() && spilledchunks.find(key) == spilledchunks.end())
+        {
+            foreach_index (m, randomizedchunks)
+            {
+                const msra::dbn::matrixbase &frames = randomizedchunks[m][k].getchunkdata().chunkframes();
+                const wstring path = spillfilename(m, k);
+                msra::files::make_intermediate_dirs(path);
+                FILE *f = fopenOrDie(path, L"wb");
+                for (size_t j = 0; j < frames.cols(); j++)
+                    fwriteOrDie(&frames(0, j), sizeof(float), frames.rows(), f);
+                fcloseOrDie(f);
+            }
+            spilledchunks.insert(key);
+            if (verbosity)
+                fprintf(stderr, "releaserandomizedchunk: wrote randomized chunk %d to the local cache\n", (int) k);
+        }
+        return false;
+    }
+
+    // file of the frames of stream m of randomized chunk k in the cache directory, named by the chunk's index in allchunks[]
+    wstring spillfilename(size_t m, size_t k) const
+    {
+        const size_t chunkid = &randomizedchunks[m][k].getchunkdata() - allchunks[m].data();
+        return msra::strfun::wstrprintf(L"%ls/subset%d.stream%d.chunk%d.frames", shardedcachedir.c_str(), (int) cachesubsetnum, (int) m, (int) chunkid);
+    }
+
     // helper to page in a chunk for a given utterance
     // (window range passed in for checking only)
     // Returns true if we actually did read something.
@@ -1105,6 +1300,76 @@ private:
             return false;
         else if (numinram == 0)
         {
+            // map the frames from the store of this host, if another process has read them already, else read and share them
+            // (The first chunk is read privately, to determine the feature kind.)
+            if (chunkstore && featdim[0] != 0)
+            {
+                foreach_index (m, randomizedchunks)
+                {
+                    auto &chunkdata = randomizedchunks[m][chunkindex].getchunkdata();
+                    if (verbosity)
+                        fprintf(stderr, "feature set %d: requirerandomizedchunk: paging in randomized chunk %d from the shared store, %d resident in RAM\n", m, (int) chunkindex, (int) (chunksinram + 1));
+                    const size_t chunkid = &chunkdata - allchunks[m].data();
+                    const string name = msra::strfun::strprintf("stream%d.chunk%d", m, (int) chunkid);
+                    auto sharedframes = chunkstore->get(name, featdim[m], chunkdata.totalframes, [&](msra::dbn::matrix &chunkframes)
+                                                        {
+                                                            msra::util::attempt(5, [&]() // (reading from network)
+                                                                                {
+                                                                                    chunkdata.readframes(featkind[m], featdim[m], sampperiod[m], chunkframes);
+                                                                                });
+                                                        });
+                    chunkdata.installshareddata(std::move(sharedframes), this->lattices, verbosity);
+                }
+                chunksinram++;
+                return true;
+            }
+
+            // read the frames from the local cache if they have been written there
+            if (spilledchunks.find(&randomizedchunks[0][chunkindex].getchunkdata()) != spilledchunks.end())
+            {
+                foreach_index (m, randomizedchunks)
+                {
+                    auto &chunkdata = randomizedchunks[m][chunkindex].getchunkdata();
+                    if (verbosity)
+                        fprintf(stderr, "feature set %d: requirerandomizedchunk: reading randomized chunk %d from the local cache, %d resident in RAM\n", m, (int) chunkindex, (int) (chunksinram + 1));
+                    msra::dbn::matrix chunkframes(featdim[m], chunkdata.totalframes);
+                    FILE *f = fopenOrDie(spillfilename(m, chunkindex), L"rb");
+                    for (size_t j = 0; j < chunkframes.cols(); j++)
+                        freadOrDie(&chunkframes(0, j), sizeof(float), chunkframes.rows(), f);
+                    fcloseOrDie(f);
+                    chunkdata.installdata(std::move(chunkframes), this->lattices, verbosity);
+                }
+                chunksinram++;
+                return true;
+            }
+
+            // use the prefetched frames if we have them; if prefetching failed, read again below
+            auto prefetched = prefetchedchunks.find(&randomizedchunks[0][chunkindex].getchunkdata());
+            if (prefetched != prefetchedchunks.end())
+            {
+                std::vector<msra::dbn::matrix> chunkframes;
+                try
+                {
+                    chunkframes = prefetched->second.get();
+                }
+                catch (const std::exception &e)
+                {
+                    fprintf(stderr, "requirerandomizedchunk: prefetching chunk %d failed (%s), reading it again\n", (int) chunkindex, e.what());
+                }
+                prefetchedchunks.erase(prefetched);
+                if (chunkframes.size() == randomizedchunks.size())
+                {
+                    foreach_index (m, randomizedchunks)
+                    {
+                        if (verbosity)
+                            fprintf(stderr, "feature set %d: requirerandomizedchunk: installing prefetched randomized chunk %d, %d resident in RAM\n", m, (int) chunkindex, (int) (chunksinram + 1));
+                        randomizedchunks[m][chunkindex].getchunkdata().installdata(std::move(chunkframes[m]), this->lattices, verbosity);
+                    }
+                    chunksinram++;
+                    return true;
+                }
+            }
+
             foreach_index (m, randomizedchunks)
             {
                 auto &chunk = randomizedchunks[m][chunkindex];
@@ -1125,6 +1390,88 @@ private:
         }
     }
 
+    // bytes of frames of a randomized chunk, over all streams
+    size_t chunkbytes(size_t k) const
+    {
+        size_t bytes = 0;
+        foreach_index (m, randomizedchunks)
+            bytes += randomizedchunks[m][k].getchunkdata().totalframes * featdim[m] * sizeof(float);
+        return bytes;
+    }
+
+    // start reading the chunks this subset will need next: the ones of [windowbegin, windowend + prefetchchunks) not in RAM, nearest first
+    // Prefetched chunks outside this range (e.g. after a new sweep) are discarded.
+    void prefetchchunksafter(const size_t windowbegin, const size_t windowend, const size_t subsetnum, const size_t numsubsets)
+    {
+        if (prefetchchunks == 0 || chunkstore) // (chunks of the store are read under its lock, once per host)
+            return;
+        foreach_index (m, randomizedchunks)
+            if (featdim[m] == 0) // feature kind not known yet
+                return;
+
+        const size_t prefetchend = min(windowend + prefetchchunks, randomizedchunks[0].size());
+        std::set<const utterancechunkdata *> wanted;
+        size_t bytesinram = 0;
+        for (size_t k = windowbegin; k < prefetchend; k++)
+        {
+            const auto &chunkdata = randomizedchunks[0][k].getchunkdata();
+            if (chunkdata.isinram())
+                bytesinram += chunkbytes(k);
+            else if (ischunkforsubset(k, subsetnum, numsubsets) && spilledchunks.find(&chunkdata) == spilledchunks.end()) // (spilled chunks are read locally)
+                wanted.insert(&chunkdata);
+        }
+
+        // evict what is no longer coming up; count the rest against the budget
+        size_t numreading = 0;
+        for (auto iter = prefetchedchunks.begin(); iter != prefetchedchunks.end();)
+        {
+            if (wanted.find(iter->first) == wanted.end())
+            {
+                iter->second.wait(); // (the reader threads reference the chunk data)
+                iter = prefetchedchunks.erase(iter);
+                continue;
+            }
+            if (iter->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                numreading++;
+            iter++;
+        }
+        for (size_t k = windowbegin; k < prefetchend; k++)
+        {
+            const auto &chunkdata = randomizedchunks[0][k].getchunkdata();
+            if (prefetchedchunks.find(&chunkdata) != prefetchedchunks.end())
+                bytesinram += chunkbytes(k);
+        }
+
+        for (size_t k = windowbegin; k < prefetchend && numreading < prefetchthreads; k++)
+        {
+            const utterancechunkdata *key = &randomizedchunks[0][k].getchunkdata();
+            if (wanted.find(key) == wanted.end() || prefetchedchunks.find(key) != prefetchedchunks.end())
+                continue;
+            if (prefetchmemorybudget > 0 && bytesinram + chunkbytes(k) > prefetchmemorybudget)
+                break;
+            std::vector<const utterancechunkdata *> chunkdatas;
+            foreach_index (m, randomizedchunks)
+                chunkdatas.push_back(&randomizedchunks[m][k].getchunkdata());
+            if (verbosity > 1)
+                fprintf(stderr, "prefetchchunksafter: prefetching randomized chunk %d\n", (int) k);
+            const std::vector<string> kinds = featkind;
+            const std::vector<size_t> dims = featdim;
+            const std::vector<unsigned int> periods = sampperiod;
+            prefetchedchunks[key] = std::async(std::launch::async, [chunkdatas, kinds, dims, periods]()
+                                               {
+                                                   std::vector<msra::dbn::matrix> chunkframes(chunkdatas.size());
+                                                   foreach_index (m, chunkdatas)
+                                                       msra::util::attempt(5, [&]() // (reading from network)
+                                                                           {
+                                                                               chunkdatas[m]->readframes(kinds[m], dims[m], periods[m], chunkframes[m]);
+                                                                           });
+                                                   return chunkframes;
+                                               });
+            bytesinram += chunkbytes(k);
+            numreading++;
+        }
+    }
+
     class matrixasvectorofvectors // wrapper around a matrix that views it as a vector of column vectors
     {
         void operator=(const matrixasvectorofvectors &); // non-assignable
@@ -1164,6 +1511,109 @@ public:
         verbosity = newverbosity;
     }
 
+    // frame mode: let getbatch() return the uids, but leave the frames of feat[] unfilled and return where they live instead (getlastframerefs()).
+    // This is for a caller that keeps the chunks of the chunk window in (device) memory (getchunkframes()) and gathers the frames from there.
+    // The chunks of the last window are in RAM until the next getbatch().
+    void setdeferframegather(bool enable)
+    {
+        if (enable && !framemode)
+            InvalidArgument("setdeferframegather: only supported in frame mode");
+        deferframegather = enable;
+    }
+    const std::vector<gatherframeref> &getlastframerefs() const
+    {
+        return lastframerefs;
+    }
+    // the chunk window [windowbegin, windowend) of the last getbatch(); of these, this subset has the chunks k with ischunkofsubset().
+    // Within a sweep, the windows move forward only.
+    void getlastchunkwindow(size_t &sweep, size_t &windowbegin, size_t &windowend, size_t &subsetnum, size_t &numsubsets) const
+    {
+        sweep = lastsweep;
+        windowbegin = lastwindowbegin;
+        windowend = lastwindowend;
+        subsetnum = lastsubsetnum;
+        numsubsets = lastnumsubsets;
+    }
+    size_t getchunknumframes(size_t k) const
+    {
+        return randomizedchunks[0][k].numframes();
+    }
+    // whether randomized chunk k is paged in for the given subset
+    bool ischunkofsubset(size_t k, size_t subsetnum, size_t numsubsets) const
+    {
+        return ischunkforsubset(k, subsetnum, numsubsets);
+    }
+    // frames [featdim x numframes] of feature stream i of randomized chunk k
+    const msra::dbn::matrixbase &getchunkframes(size_t i, size_t k) const
+    {
+        const auto &chunkdata = randomizedchunks[i][k].getchunkdata();
+        if (!chunkdata.isinram())
+            LogicError("getchunkframes: called when data have not been paged in");
+        return chunkdata.chunkframes();
+    }
+    // number of neighbor frames that feature stream i stacks on either side of a frame
+    void getcontextextent(size_t i, size_t &leftextent, size_t &rightextent) const
+    {
+        if (leftcontext[i] == 0 && rightcontext[i] == 0)
+            leftextent = rightextent = augmentationextent(featdim[i], vdim[i]);
+        else
+        {
+            leftextent = leftcontext[i];
+            rightextent = rightcontext[i];
+        }
+    }
+
+    // read chunks ahead asynchronously, so that moving the chunk window does not stall on file reads
+    // chunksahead - how many chunks beyond the current chunk window to read ahead (0 disables prefetching)
+    // numthreads - max number of chunks read concurrently
+    // memorybudget - max bytes of frames in RAM including prefetched ones (0 for no limit)
+    void setprefetch(size_t chunksahead, size_t numthreads, size_t memorybudget)
+    {
+        prefetchchunks = chunksahead;
+        prefetchthreads = max(numthreads, (size_t) 1);
+        prefetchmemorybudget = memorybudget;
+    }
+
+    // keep the chunks this subset reads in the first sweep for the later ones, instead of reading them again, e.g. from network storage
+    // Chunks are then randomized such that a subset gets the same chunks in every sweep (in the order of a different shuffle).
+    // memorybudget - max bytes of frames of chunks kept in RAM after they have left the chunk window
+    // dir - directory on local storage for the chunks beyond the budget; empty to read those again from their archives
+    // Lattices are not cached.
+    void setshardedcache(size_t memorybudget, const wstring &dir)
+    {
+        shardedcache = memorybudget > 0 || !dir.empty();
+        shardedcachememorybudget = memorybudget;
+        shardedcachedir = dir;
+    }
+    // page chunks into the memory-mapped files of a store in 'dir', shared with the other processes of this host that use the same 'dir',
+    // instead of into private memory; see sharedchunkstore
+    // With hostsubsets > 1, the subsets are taken to be in groups of that many consecutive ones that share a host (as MPI ranks
+    // usually are). All subsets of a group then page in the same chunks, which are in RAM once, and take turns in returning
+    // their utterances or frames. Their chunk window thus holds the data of one subset, not of hostsubsets ones.
+    // Prefetching is not done with a store.
+    void setsharedchunkstore(const wstring &dir, size_t newhostsubsets)
+    {
+        chunkstore.reset(dir.empty() ? nullptr : new sharedchunkstore(dir));
+        hostsubsets = chunkstore ? max(newhostsubsets, (size_t) 1) : 1;
+        currentsweep = SIZE_MAX; // (the randomization may depend on the subset groups)
+    }
+    // the subset that the following getbatch() calls will ask for; with the sharded cache, this must be set before the first sweep
+    // The chunks are randomized for the number of subsets. If that changes, so does the randomization, and the cache starts over.
+    void setshardedcachesubset(size_t subsetnum, size_t numsubsets)
+    {
+        if (!shardedcache)
+            return;
+        if (numsubsetgroups(numsubsets) != randomizationsubsets || subsetnum != cachesubsetnum)
+        {
+            randomizationsubsets = numsubsetgroups(numsubsets); // (the subsets of a group share the chunks)
+            cachesubsetnum = subsetnum;
+            currentsweep = SIZE_MAX; // (re-randomize)
+            cachedchunks.clear();    // (what is still in RAM is released or cached again as it leaves the chunk window)
+            spilledchunks.clear();
+            shardedcachebytes = 0;
+        }
+    }
+
     // get the next minibatch
     // A minibatch is made up of one or more utterances.
     // We will return less than 'framesrequested' unless the first utterance is too long.
@@ -1219,18 +1669,19 @@ public:
             for (size_t k = windowend; k < randomizedchunks[0].size(); k++)
                 releaserandomizedchunk(k);
             for (size_t pos = spos; pos < epos; pos++)
-                if ((randomizedutterancerefs[pos].chunkindex % numsubsets) == subsetnum)
+                if (ischunkforsubset(randomizedutterancerefs[pos].chunkindex, subsetnum, numsubsets))
                     readfromdisk |= requirerandomizedchunk(randomizedutterancerefs[pos].chunkindex, windowbegin, windowend); // (window range passed in for checking only)
 
             // Note that the above loop loops over all chunks incl. those that we already should have.
             // This has an effect, e.g., if 'numsubsets' has changed (we will fill gaps).
+            prefetchchunksafter(windowbegin, windowend, subsetnum, numsubsets);
 
             // determine the true #frames we return, for allocation--it is less than mbframes in the case of MPI/data-parallel sub-set mode
             size_t tspos = 0;
             for (size_t pos = spos; pos < epos; pos++)
             {
                 const auto &uttref = randomizedutterancerefs[pos];
-                if ((uttref.chunkindex % numsubsets) != subsetnum) // chunk not to be returned for this MPI node
+                if (subsetforitem(uttref.chunkindex, pos, numsubsets) != subsetnum) // utterance not to be returned for this MPI node
                     continue;
 
                 tspos += uttref.numframes;
@@ -1277,7 +1728,7 @@ public:
             for (size_t pos = spos; pos < epos; pos++)
             {
                 const auto &uttref = randomizedutterancerefs[pos];
-                if ((uttref.chunkindex % numsubsets) != subsetnum) // chunk not to be returned for this MPI node
+                if (subsetforitem(uttref.chunkindex, pos, numsubsets) != subsetnum) // utterance not to be returned for this MPI node
                     continue;
 
                 size_t n = 0;
@@ -1369,10 +1820,17 @@ public:
             for (size_t k = 0; k < windowbegin; k++)
                 releaserandomizedchunk(k);
             for (size_t k = windowbegin; k < windowend; k++)
-                if ((k % numsubsets) == subsetnum)                                     // in MPI mode, we skip chunks this way
+                if (ischunkforsubset(k, subsetnum, numsubsets))                        // in MPI mode, we skip chunks this way
                     readfromdisk |= requirerandomizedchunk(k, windowbegin, windowend); // (window range passed in for checking only, redundant here)
             for (size_t k = windowend; k < randomizedchunks[0].size(); k++)
                 releaserandomizedchunk(k);
+            prefetchchunksafter(windowbegin, windowend, subsetnum, numsubsets);
+            lastframerefs.clear();
+            lastsweep = sweep;
+            lastwindowbegin = windowbegin;
+            lastwindowend = windowend;
+            lastsubsetnum = subsetnum;
+            lastnumsubsets = numsubsets;
 
             // determine the true #frames we return--it is less than mbframes in the case of MPI/data-parallel sub-set mode
             // First determine it for all nodes, then pick the min over all nodes, as to give all the same #frames for better load balancing.
@@ -1382,7 +1840,7 @@ public:
             {
                 const size_t framepos = (globalts + i) % _totalframes; // (for comments, see main loop below)
                 const frameref &frameref = randomizedframerefs[framepos];
-                subsetsizes[frameref.chunkindex % numsubsets]++;
+                subsetsizes[subsetforitem(frameref.chunkindex, framepos, numsubsets)]++;
             }
             size_t j = subsetsizes[subsetnum];                                           // return what we have  --TODO: we can remove the above full computation again now
             const size_t allocframes = max(j, (mbframes + numsubsets - 1) / numsubsets); // we leave space for the desired #frames, assuming caller will try to pad them later
@@ -1422,13 +1880,28 @@ public:
                 const size_t framepos = (globalts + j) % _totalframes; // using mod because we may actually run beyond the sweep for the last call
                 const frameref &frameref = randomizedframerefs[framepos];
 
-                // in MPI/data-parallel mode, skip frames that are not in chunks loaded for this MPI node
-                if ((frameref.chunkindex % numsubsets) != subsetnum)
+                // in MPI/data-parallel mode, skip frames that are not in chunks loaded for this MPI node, or left to another one of the host
+                if (subsetforitem(frameref.chunkindex, framepos, numsubsets) != subsetnum)
                     continue;
 
                 // random utterance
                 readfromdisk |= requirerandomizedchunk(frameref.chunkindex, windowbegin, windowend); // (this is just a check; should not actually page in anything)
 
+                // the caller gathers the frame and its neighbors from its own copy of the chunk window
+                if (deferframegather)
+                {
+                    const auto &chunkdata = randomizedchunks[0][frameref.chunkindex].getchunkdata();
+                    lastframerefs.push_back(gatherframeref(frameref.chunkindex, chunkdata.firstframes[frameref.utteranceindex], chunkdata.numframes(frameref.utteranceindex), frameref.frameindex));
+                    if (issupervised())
+                    {
+                        auto frameclassids = getclassids(frameref);
+                        foreach_index (k, uids)
+                            uids[k][currmpinodeframecount] = frameclassids[k][frameref.frameindex];
+                    }
+                    currmpinodeframecount++;
+                    continue;
+                }
+
                 foreach_index (i, randomizedchunks)
                 {
                     const auto &chunk = randomizedchunks[i][frameref.chunkindex];
@@ -1444,15 +1917,7 @@ public:
 
                     size_t leftextent, rightextent;
                     // page in the needed range of frames
-                    if (leftcontext[i] == 0 && rightcontext[i] == 0)
-                    {
-                        leftextent = rightextent = augmentationextent(uttframevectors[t].size(), vdim[i]);
-                    }
-                    else
-                    {
-                        leftextent = leftcontext[i];
-                        rightextent = rightcontext[i];
-                    }
+                    getcontextextent(i, leftextent, rightextent);
                     augmentneighbors(uttframevectors, noboundaryflags, t, leftextent, rightextent, feat[i], currmpinodeframecount);
 
                     if (issupervised() && i == 0)
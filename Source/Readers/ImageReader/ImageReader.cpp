@@ -10,6 +10,7 @@
 #include "Config.h"
 #include "ScriptableObjects.h"
 #include "ConcStack.h"
+#include "PackedImageFile.h"
 #include <algorithm>
 #include <fstream>
 #include <sstream> // TODO: this should go away once we update the parameter parsing
@@ -30,6 +31,17 @@ static bool AreEqual(const std::string& s1, const std::string& s2)
 //-------------------
 // Transforms
 
+// transferFormat=uint8 in the feature section: the images go to the device as bytes (a quarter of the floats), and are
+// converted and mean-subtracted there
+template <class ConfigRecordType>
+static bool IsCompactTransfer(const ConfigRecordType& config)
+{
+    std::string transferFormat = config(L"transferFormat", "float");
+    if (!AreEqual(transferFormat, "float") && !AreEqual(transferFormat, "uint8"))
+        RuntimeError("ImageReader: transferFormat must be float or uint8, not %s.", transferFormat.c_str());
+    return AreEqual(transferFormat, "uint8");
+}
+
 class ITransform
 {
 public:
@@ -211,7 +223,7 @@ class ScaleTransform : public ITransform
 {
 public:
     ScaleTransform(int dataType, unsigned int seed)
-        : m_dataType(dataType), m_seed(seed)
+        : m_dataType(dataType), m_elemDataType(dataType), m_seed(seed)
     {
         assert(m_dataType == CV_32F || m_dataType == CV_64F);
 
@@ -244,6 +256,9 @@ public:
 
         if (m_interp.size() == 0)
             m_interp.push_back(cv::INTER_LINEAR);
+
+        // with transferFormat=uint8 the pixels stay bytes, and are resized as such
+        m_dataType = IsCompactTransfer(config) ? CV_8U : m_elemDataType;
     }
     virtual void Init(const ConfigParameters& config) override
     {
@@ -253,7 +268,7 @@ public:
 
     void Apply(cv::Mat& mat)
     {
-        // If matrix has not been converted to the right type, do it now as rescaling requires floating point type.
+        // If matrix has not been converted to the right type, do it now (rescaling is more precise in floating point).
         if (mat.type() != CV_MAKETYPE(m_dataType, m_imgChannels))
             mat.convertTo(mat, m_dataType);
 
@@ -277,6 +292,7 @@ private:
     conc_stack<std::unique_ptr<std::mt19937>> m_rngs;
 
     int m_dataType;
+    int m_elemDataType;
 
     using StrToIntMapT = std::unordered_map<std::string, int>;
     StrToIntMapT m_interpMap;
@@ -319,6 +335,7 @@ public:
             fs.release();
             m_meanImg = m_meanImg.reshape(cchan, crow);
         }
+        m_subtractOnDevice = IsCompactTransfer(config);
     }
     virtual void Init(const ConfigParameters& config) override
     {
@@ -328,6 +345,9 @@ public:
 
     void Apply(cv::Mat& mat)
     {
+        if (m_subtractOnDevice) // (the reader does it while converting the bytes, see GetMeanImage())
+            return;
+
         assert(m_meanImg.size() == cv::Size(0, 0) || (m_meanImg.size() == mat.size() && m_meanImg.channels() == mat.channels()));
 
         // REVIEW alexeyk: check type conversion (float/double).
@@ -335,33 +355,165 @@ public:
             mat = mat - m_meanImg;
     }
 
+    // the mean image if it is not subtracted by Apply(); empty without a mean file
+    const cv::Mat& GetMeanImage() const
+    {
+        static const cv::Mat none;
+        return m_subtractOnDevice ? m_meanImg : none;
+    }
+
 private:
     cv::Mat m_meanImg;
+    bool m_subtractOnDevice = false;
+};
+
+//-------------------
+// DecodedImageCache
+
+// The decoded images (BGR bytes) of the first epoch, kept for the following ones in memory or in a file on a local
+// disk, so that those only read pixels; the random transforms are applied to a copy. Images are added until maxBytes
+// (0: no limit) is reached and are then kept; with the random order of the images there is nothing better to evict.
+class DecodedImageCache
+{
+public:
+    // dir - for the cache file, empty to cache in memory
+    DecodedImageCache(size_t numImages, size_t maxBytes, const std::wstring& dir)
+        : m_entries(numImages), m_maxBytes(maxBytes), m_bytes(0), m_numCached(0), m_fileEnd(0)
+    {
+        if (!dir.empty())
+        {
+#ifdef _WIN32
+            const int pid = (int) GetCurrentProcessId();
+#else
+            const int pid = (int) getpid();
+#endif
+            m_path = msra::strfun::wstrprintf(L"%ls/ImageReaderCache.%d.%p.bin", dir.c_str(), pid, (void*) this);
+            m_file = std::make_unique<File>(m_path, fileOptionsBinary | fileOptionsReadWrite);
+        }
+    }
+
+    ~DecodedImageCache()
+    {
+        if (m_file)
+        {
+            m_file.reset();
+            _wunlink(m_path.c_str());
+        }
+    }
+
+    // copy of the cached image into mat; false if it is not cached
+    bool Get(size_t image, cv::Mat& mat)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const Entry& entry = m_entries[image];
+        if (entry.rows == 0)
+            return false;
+        mat.create(entry.rows, entry.cols, CV_8UC3);
+        const size_t size = mat.total() * mat.elemSize();
+        if (m_file)
+        {
+            m_file->SetPosition(entry.offset);
+            m_file->GetArray(mat.ptr(), size);
+        }
+        else
+        {
+            const unsigned char* data = entry.data.get(); // (immutable once set)
+            lock.unlock();
+            memcpy(mat.ptr(), data, size);
+        }
+        return true;
+    }
+
+    void Add(size_t image, const cv::Mat& mat)
+    {
+        assert(mat.type() == CV_8UC3 && mat.isContinuous());
+        const size_t size = mat.total() * mat.elemSize();
+        std::unique_ptr<unsigned char[]> data;
+        if (!m_file) // (copied before taking the lock)
+        {
+            if (IsFull(size))
+                return;
+            data.reset(new unsigned char[size]);
+            memcpy(data.get(), mat.ptr(), size);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Entry& entry = m_entries[image];
+        if (entry.rows != 0 || (m_maxBytes > 0 && m_bytes + size > m_maxBytes))
+            return;
+        if (m_file)
+        {
+            entry.offset = m_fileEnd;
+            m_file->SetPosition(m_fileEnd);
+            m_file->PutArray(mat.ptr(), size);
+            m_fileEnd += size;
+        }
+        else
+            entry.data = std::move(data);
+        entry.rows = mat.rows;
+        entry.cols = mat.cols;
+        m_bytes += size;
+        m_numCached++;
+    }
+
+    size_t GetNumCached()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_numCached;
+    }
+    size_t GetNumBytes()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bytes;
+    }
+
+private:
+    bool IsFull(size_t size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_maxBytes > 0 && m_bytes + size > m_maxBytes;
+    }
+
+    struct Entry
+    {
+        int rows = 0; // 0: not cached
+        int cols = 0;
+        uint64_t offset = 0;                  // in the cache file
+        std::unique_ptr<unsigned char[]> data; // or in memory
+    };
+
+    std::mutex m_mutex; // protects all below, and the position of m_file
+    std::vector<Entry> m_entries; // [image index]
+    size_t m_maxBytes;
+    size_t m_bytes;
+    size_t m_numCached;
+    std::wstring m_path;
+    std::unique_ptr<File> m_file;
+    uint64_t m_fileEnd;
 };
 
 //-------------------
 // ImageReader
 
+// (ElemType is that of the pixels of src: float or double, or unsigned char with compact transfer)
 template <class ElemType>
 static void CopyFromImage(const cv::Mat& src, std::vector<ElemType>& dst, size_t ivDst, bool transpose);
 
-static std::launch GetLaunchPolicy(bool prefetch)
-{
-    return prefetch ? std::launch::async : std::launch::deferred;
-}
-
 template <class ElemType>
 ImageReader<ElemType>::ImageReader()
-    : m_seed(0), m_rng(m_seed), m_imgListRand(true), m_pMBLayout(make_shared<MBLayout>()), m_mbFmt(DataFormat::NCHW)
+    : m_seed(0), m_rng(m_seed), m_compactTransfer(false), m_randomizationWindow(1), m_cacheShortSide(0), m_prefetch(true), m_prefetchDepth(1), m_ringHead(0), m_ringCount(0), m_stopWorkers(false), m_imgListRand(true), m_pMBLayout(make_shared<MBLayout>()), m_mbFmt(DataFormat::NCHW)
 {
     m_transforms.push_back(std::make_unique<CropTransform>(m_seed));
     m_transforms.push_back(std::make_unique<ScaleTransform>(sizeof(ElemType) == 4 ? CV_32F : CV_64F, m_seed));
-    m_transforms.push_back(std::make_unique<MeanTransform>());
+    auto meanTransform = std::make_unique<MeanTransform>();
+    m_meanTransform = meanTransform.get();
+    m_transforms.push_back(std::move(meanTransform));
 }
 
 template <class ElemType>
 ImageReader<ElemType>::~ImageReader()
 {
+    StopWorkers();
 }
 
 template <class ElemType>
@@ -401,25 +553,72 @@ void ImageReader<ElemType>::InitFromConfig(const ConfigRecordType& config)
     for (auto& t : m_transforms)
         t->Init(featSect.second);
 
+    // compact transfer: the mean is subtracted while the bytes are converted on the device, as a (negated) column in minibatch layout
+    m_compactTransfer = IsCompactTransfer(featSect.second);
+    m_meanShift.clear();
+    m_meanShiftOnDevice.reset();
+    const cv::Mat& meanImg = m_meanTransform->GetMeanImage();
+    if (!meanImg.empty())
+    {
+        if (meanImg.rows != (int) h || meanImg.cols != (int) w || meanImg.channels() != (int) c)
+            RuntimeError("ImageReader: with transferFormat=uint8 the mean image must have the dimensions of the scaled images.");
+        cv::Mat negatedMean;
+        meanImg.convertTo(negatedMean, sizeof(ElemType) == 4 ? CV_32F : CV_64F, -1);
+        m_meanShift.resize(m_featDim);
+        CopyFromImage(negatedMean, m_meanShift, 0, m_mbFmt == DataFormat::NCHW);
+    }
+
     SectionT labSect{gettter("labelDim")};
     m_labName = msra::strfun::utf16(labSect.first);
     m_labDim = labSect.second("labelDim");
 
-    std::string mapPath = config(L"file");
-    std::ifstream mapFile(mapPath);
-    if (!mapFile)
-        RuntimeError("Could not open %s for reading.", mapPath.c_str());
+    if (config.Exists(L"packedFile"))
+    {
+        // written by the "packImages" action
+        std::wstring packedPath = config(L"packedFile");
+        m_packedFile = std::make_unique<PackedImageFile>(packedPath);
+        m_randomizationWindow = config(L"randomizationWindow", (size_t) 4);
+        if (m_randomizationWindow == 0)
+            RuntimeError("ImageReader: randomizationWindow must be at least 1 chunk.");
+        m_imageOrder.resize(m_packedFile->GetNumImages());
+    }
+    else
+    {
+        std::string mapPath = config(L"file");
+        std::ifstream mapFile(mapPath);
+        if (!mapFile)
+            RuntimeError("Could not open %s for reading.", mapPath.c_str());
+
+        std::string line{""};
+        for (size_t cline = 0; std::getline(mapFile, line); cline++)
+        {
+            std::stringstream ss{line};
+            std::string imgPath;
+            std::string clsId;
+            if (!std::getline(ss, imgPath, '\t') || !std::getline(ss, clsId, '\t'))
+                RuntimeError("Invalid map file format, must contain 2 tab-delimited columns: %s, line: %d.", mapPath.c_str(), static_cast<int>(cline));
+            m_files.push_back({imgPath, std::stoi(clsId)});
+        }
+        m_imageOrder.resize(m_files.size());
+    }
+    for (size_t i = 0; i < m_imageOrder.size(); i++)
+        m_imageOrder[i] = i;
 
-    std::string line{""};
-    for (size_t cline = 0; std::getline(mapFile, line); cline++)
+    // keep the decoded images for the following epochs: cache=ram, or cache=disk with cacheDir on a local disk
+    std::string cache = config(L"cache", "none");
+    m_cache.reset();
+    if (AreEqual(cache, "ram") || AreEqual(cache, "disk"))
     {
-        std::stringstream ss{line};
-        std::string imgPath;
-        std::string clsId;
-        if (!std::getline(ss, imgPath, '\t') || !std::getline(ss, clsId, '\t'))
-            RuntimeError("Invalid map file format, must contain 2 tab-delimited columns: %s, line: %d.", mapPath.c_str(), static_cast<int>(cline));
-        m_files.push_back({imgPath, std::stoi(clsId)});
+        std::wstring cacheDir = config(L"cacheDir", L"");
+        if (AreEqual(cache, "disk") && cacheDir.empty())
+            RuntimeError("ImageReader: cache=disk requires cacheDir.");
+        const size_t cacheSizeMB = config(L"cacheSizeMB", (size_t) 0);
+        m_cache = std::make_unique<DecodedImageCache>(GetNumImages(), cacheSizeMB << 20, AreEqual(cache, "disk") ? cacheDir : std::wstring());
+        // pre-scaling to little more than the crop keeps the cache small and the transforms cheap
+        m_cacheShortSide = config(L"cacheShortSide", (size_t) 0);
     }
+    else if (!AreEqual(cache, "none"))
+        RuntimeError("ImageReader: cache must be none, ram or disk, not %s.", cache.c_str());
 
     std::string rand = config(L"randomize", "auto");
     if (AreEqual(rand, "none"))
@@ -428,11 +627,26 @@ void ImageReader<ElemType>::InitFromConfig(const ConfigRecordType& config)
         RuntimeError("Only Auto and None are currently supported.");
 
     m_prefetch = config(L"prefetch", true);
+    // number of minibatches decoded ahead
+    m_prefetchDepth = m_prefetch ? (size_t) config(L"prefetchDepth", (size_t) 2) : 1;
+    if (m_prefetchDepth == 0)
+        RuntimeError("ImageReader: prefetchDepth must be at least 1.");
 
     int cthread = config(L"numCPUThreads", 0);
     if (cthread > 0)
         omp_set_num_threads(cthread);
 
+    size_t cdecodeThread = config(L"numDecodeThreads", (size_t) 0);
+    if (cdecodeThread == 0)
+        cdecodeThread = cthread > 0 ? cthread : std::max(std::thread::hardware_concurrency(), 1u);
+    StopWorkers();
+    m_stopWorkers = false;
+    for (size_t i = 0; i < cdecodeThread; i++)
+        m_workers.push_back(std::thread([this]()
+                                        {
+                                            DecodeLoop();
+                                        }));
+
     m_epochStart = 0;
     m_mbStart = 0;
 }
@@ -452,30 +666,45 @@ void ImageReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t
     assert(subsetNum < numSubsets);
     assert(requestedEpochSamples > 0);
 
+    // the workers must be done with the previous epoch before the images are reordered; anything still buffered is dropped
+    WaitForAllMinibatches();
+    m_ringHead = 0;
+    m_ringCount = 0;
+
     m_subsetNum = subsetNum;
     m_numSubsets = numSubsets;
 
+    if (m_cache && epoch > 0)
+        fprintf(stderr, "ImageReader: %d of %d images cached (%.1f MB).\n", (int) m_cache->GetNumCached(), (int) GetNumImages(), m_cache->GetNumBytes() / 1048576.0);
+
     if (m_imgListRand)
-        std::shuffle(m_files.begin(), m_files.end(), m_rng);
+        RandomizeImageOrder();
 
-    m_epochSize = (requestedEpochSamples == requestDataSize ? m_files.size() : requestedEpochSamples);
+    m_epochSize = (requestedEpochSamples == requestDataSize ? GetNumImages() : requestedEpochSamples);
     m_mbSize = mbSize;
     // REVIEW alexeyk: if user provides epoch size explicitly then we assume epoch size is a multiple of mbsize, is this ok?
     assert(requestedEpochSamples == requestDataSize || (m_epochSize % m_mbSize) == 0);
     m_epoch = epoch;
     m_epochStart = m_epoch * m_epochSize;
-    if (m_epochStart >= m_files.size())
+    if (m_epochStart >= GetNumImages())
     {
         m_epochStart = 0;
         m_mbStart = 0;
     }
 
-    m_featBuf.resize(m_mbSize * m_featDim);
-    m_labBuf.resize(m_mbSize * m_labDim);
-    m_mbPrefetchFut = std::async(GetLaunchPolicy(m_prefetch), [this]()
-                                 {
-                                     return ReadImages();
-                                 });
+    m_ring.resize(m_prefetchDepth);
+    for (auto& buf : m_ring)
+    {
+        if (m_compactTransfer)
+            buf.compactFeat.resize(m_mbSize * m_featDim);
+        else
+            buf.feat.resize(m_mbSize * m_featDim);
+        buf.lab.resize(m_mbSize * m_labDim);
+    }
+
+    if (m_prefetch)
+        while (m_ringCount < m_prefetchDepth && IssueMinibatch())
+            ;
 }
 
 template <class ElemType>
@@ -485,24 +714,50 @@ bool ImageReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType>
     assert(matrices.find(m_featName) != matrices.end());
     assert(m_mbSize > 0);
 
-    size_t mbSize = m_mbPrefetchFut.valid() ? m_mbPrefetchFut.get() : 0;
+    if (!m_prefetch && m_ringCount == 0)
+        IssueMinibatch();
+    if (m_ringCount == 0)
+        return false;
+
+    MinibatchBuffer& buf = m_ring[m_ringHead];
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_taskDone.wait(lock, [&buf]()
+                        {
+                            return buf.pending == 0;
+                        });
+    }
+    m_ringHead = (m_ringHead + 1) % m_ring.size();
+    m_ringCount--;
+    if (buf.error)
+        std::rethrow_exception(buf.error);
 
+    size_t mbSize = buf.size;
     if (mbSize == 0)
         return false;
 
     Matrix<ElemType>& features = *matrices[m_featName];
-    features.SetValue(m_featDim, mbSize, features.GetDeviceId(), m_featBuf.data(), matrixFlagNormal);
+    if (m_compactTransfer)
+    {
+        if (!m_meanShift.empty() && (!m_meanShiftOnDevice || m_meanShiftOnDevice->GetDeviceId() != features.GetDeviceId()))
+        {
+            m_meanShiftOnDevice = std::make_unique<Matrix<ElemType>>(features.GetDeviceId());
+            m_meanShiftOnDevice->SetValue(m_featDim, 1, features.GetDeviceId(), m_meanShift.data(), matrixFlagNormal);
+        }
+        features.SetValueFromCompact(m_featDim, mbSize, features.GetDeviceId(), buf.compactFeat.data(), compactElementUInt8, 1, m_meanShiftOnDevice.get());
+    }
+    else
+        features.SetValue(m_featDim, mbSize, features.GetDeviceId(), buf.feat.data(), matrixFlagNormal);
 
     Matrix<ElemType>& labels = *matrices[m_labName];
-    labels.SetValue(m_labDim, mbSize, labels.GetDeviceId(), m_labBuf.data(), matrixFlagNormal);
+    labels.SetValue(m_labDim, mbSize, labels.GetDeviceId(), buf.lab.data(), matrixFlagNormal);
 
     m_pMBLayout->InitAsFrameMode(mbSize);
 
-    // It is safe to run prefetching with just one buffer as SetValue is synchronous so there will be no race.
-    m_mbPrefetchFut = std::async(GetLaunchPolicy(m_prefetch), [this]()
-                                 {
-                                     return ReadImages();
-                                 });
+    // SetValue is synchronous, so the buffer can be refilled right away. (SetValueFromCompact() is not, but has copied
+    // the pageable host buffer out when it returns.)
+    if (m_prefetch)
+        IssueMinibatch();
 
     return true;
 }
@@ -520,7 +775,7 @@ bool ImageReader<ElemType>::DataEnd(EndDataType endDataType)
         ret = m_mbStart < m_epochStart + m_epochSize;
         break;
     case endDataSet:
-        ret = m_mbStart >= m_files.size();
+        ret = m_mbStart >= GetNumImages();
         break;
     case endDataSentence:
         ret = true;
@@ -536,42 +791,198 @@ void ImageReader<ElemType>::SetRandomSeed(unsigned int seed)
     m_rng.seed(m_seed);
 }
 
+// Images of a map file are shuffled freely. Those of a packed file are shuffled chunk-wise and then within a
+// window of chunks, so that the reads stay close to each other.
 template <class ElemType>
-size_t ImageReader<ElemType>::ReadImages()
+void ImageReader<ElemType>::RandomizeImageOrder()
 {
-    if (m_mbStart >= m_files.size() || m_mbStart >= m_epochStart + m_epochSize)
-        return 0;
+    if (!m_packedFile)
+    {
+        std::shuffle(m_imageOrder.begin(), m_imageOrder.end(), m_rng);
+        return;
+    }
 
-    size_t mbLim = m_mbStart + m_mbSize;
-    if (mbLim > m_files.size())
-        mbLim = m_files.size();
+    const size_t numImages = GetNumImages();
+    const size_t chunkSize = m_packedFile->GetChunkSizeInImages();
+    const size_t numChunks = (numImages + chunkSize - 1) / chunkSize;
+    std::vector<size_t> chunkOrder(numChunks);
+    for (size_t k = 0; k < numChunks; k++)
+        chunkOrder[k] = k;
+    std::shuffle(chunkOrder.begin(), chunkOrder.end(), m_rng);
 
-    std::fill(m_labBuf.begin(), m_labBuf.end(), static_cast<ElemType>(0));
+    m_imageOrder.clear();
+    for (size_t k = 0; k < numChunks; k++)
+    {
+        const size_t first = chunkOrder[k] * chunkSize;
+        const size_t last = std::min(first + chunkSize, numImages);
+        for (size_t i = first; i < last; i++)
+            m_imageOrder.push_back(i);
+    }
+    for (size_t windowStart = 0; windowStart < numChunks; windowStart += m_randomizationWindow)
+    {
+        // (windows are counted in images; only the short last chunk of the file, if any, can make them straddle chunks)
+        auto begin = m_imageOrder.begin() + std::min(windowStart * chunkSize, numImages);
+        auto end = m_imageOrder.begin() + std::min((windowStart + m_randomizationWindow) * chunkSize, numImages);
+        std::shuffle(begin, end, m_rng);
+    }
+}
+
+// hand the images of the next minibatch to the decode workers; returns false at the end of the epoch
+template <class ElemType>
+bool ImageReader<ElemType>::IssueMinibatch()
+{
+    if (m_mbStart >= GetNumImages() || m_mbStart >= m_epochStart + m_epochSize)
+        return false;
+
+    size_t mbLim = m_mbStart + m_mbSize;
+    if (mbLim > GetNumImages())
+        mbLim = GetNumImages();
 
     size_t actualMBSize = mbLim - m_mbStart;
     size_t iStart = actualMBSize * m_subsetNum / m_numSubsets;
     size_t iLim = actualMBSize * (m_subsetNum + 1) / m_numSubsets;
     size_t subsetSize = iLim - iStart;
 
-#pragma omp parallel for ordered schedule(dynamic)
-    for (long long i = 0; i < static_cast<long long>(subsetSize); i++)
+    assert(m_ringCount < m_ring.size());
+    size_t ibuf = (m_ringHead + m_ringCount) % m_ring.size();
+    MinibatchBuffer& buf = m_ring[ibuf];
+    std::fill(buf.lab.begin(), buf.lab.end(), static_cast<ElemType>(0));
+    buf.size = subsetSize;
+    buf.error = nullptr;
     {
-        const auto& p = m_files[m_mbStart + iStart + i];
-        cv::Mat img{cv::imread(p.first, cv::IMREAD_COLOR)};
-        if (!img.data)
-            RuntimeError("Cannot read image file %s", p.first.c_str());
-        for (auto& t : m_transforms)
-            t->Apply(img);
-
-        assert(img.rows * img.cols * img.channels() == m_featDim);
-        // When IMREAD_COLOR is used, OpenCV stores image in BGR format.
-        // Transpose is required if requested mini-batch format is NCHW.
-        CopyFromImage(img, m_featBuf, m_featDim * i, m_mbFmt == DataFormat::NCHW);
-        m_labBuf[m_labDim * i + p.second] = 1;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        buf.pending = subsetSize;
+        for (size_t i = 0; i < subsetSize; i++)
+            m_tasks.push_back(DecodeTask{ibuf, i, m_mbStart + iStart + i});
     }
+    m_taskAvailable.notify_all();
 
+    m_ringCount++;
     m_mbStart += actualMBSize;
-    return subsetSize;
+    return true;
+}
+
+template <class ElemType>
+void ImageReader<ElemType>::WaitForAllMinibatches()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_taskDone.wait(lock, [this]()
+                    {
+                        return m_tasks.empty() && std::all_of(m_ring.begin(), m_ring.end(), [](const MinibatchBuffer& buf)
+                                                              {
+                                                                  return buf.pending == 0;
+                                                              });
+                    });
+}
+
+template <class ElemType>
+void ImageReader<ElemType>::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopWorkers = true;
+        m_tasks.clear();
+    }
+    m_taskAvailable.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+    m_workers.clear();
+}
+
+// worker thread: decode and transform one image at a time
+template <class ElemType>
+void ImageReader<ElemType>::DecodeLoop()
+{
+    // reused across images, to avoid reallocating the file and decoding buffers
+    std::vector<unsigned char> fileBuf;
+    cv::Mat decoded;
+
+    for (;;)
+    {
+        DecodeTask task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_taskAvailable.wait(lock, [this]()
+                                 {
+                                     return m_stopWorkers || !m_tasks.empty();
+                                 });
+            if (m_stopWorkers)
+                return;
+            task = m_tasks.front();
+            m_tasks.pop_front();
+        }
+
+        MinibatchBuffer& buf = m_ring[task.buffer];
+        std::exception_ptr error;
+        try
+        {
+            const size_t image = m_imageOrder[task.file];
+            const int label = m_packedFile ? m_packedFile->GetLabel(image) : m_files[image].second;
+            // the cache holds the images as decoded (and pre-scaled), or gets them now
+            if (!m_cache || !m_cache->Get(image, decoded))
+            {
+                if (m_packedFile)
+                {
+                    // decode in place from the mapped file
+                    const cv::Mat encoded(1, static_cast<int>(m_packedFile->GetImageSize(image)), CV_8U, const_cast<char*>(m_packedFile->GetImageData(image)));
+                    cv::imdecode(encoded, cv::IMREAD_COLOR, &decoded);
+                    if (!decoded.data)
+                        RuntimeError("Cannot decode image %d of the packed image file", static_cast<int>(image));
+                }
+                else
+                {
+                    const auto& p = m_files[image];
+                    std::ifstream file(p.first, std::ios::binary | std::ios::ate);
+                    if (!file)
+                        RuntimeError("Cannot read image file %s", p.first.c_str());
+                    fileBuf.resize(static_cast<size_t>(file.tellg()));
+                    file.seekg(0);
+                    if (!file.read(reinterpret_cast<char*>(fileBuf.data()), fileBuf.size()))
+                        RuntimeError("Cannot read image file %s", p.first.c_str());
+
+                    cv::imdecode(fileBuf, cv::IMREAD_COLOR, &decoded);
+                    if (!decoded.data)
+                        RuntimeError("Cannot decode image file %s", p.first.c_str());
+                }
+                if (m_cache)
+                {
+                    const int shortSide = std::min(decoded.rows, decoded.cols);
+                    if (m_cacheShortSide > 0 && shortSide > (int) m_cacheShortSide)
+                    {
+                        const double scale = (double) m_cacheShortSide / shortSide;
+                        cv::resize(decoded, decoded, cv::Size(), scale, scale, cv::INTER_AREA);
+                    }
+                    m_cache->Add(image, decoded);
+                }
+            }
+            if (label < 0 || static_cast<size_t>(label) >= m_labDim)
+                RuntimeError("Image %d has class id %d, which is beyond labelDim.", static_cast<int>(image), label);
+            cv::Mat img = decoded;
+            for (auto& t : m_transforms)
+                t->Apply(img);
+
+            assert(img.rows * img.cols * img.channels() == m_featDim);
+            // When IMREAD_COLOR is used, OpenCV stores image in BGR format.
+            // Transpose is required if requested mini-batch format is NCHW.
+            if (m_compactTransfer)
+                CopyFromImage(img, buf.compactFeat, m_featDim * task.index, m_mbFmt == DataFormat::NCHW);
+            else
+                CopyFromImage(img, buf.feat, m_featDim * task.index, m_mbFmt == DataFormat::NCHW);
+            buf.lab[m_labDim * task.index + label] = 1;
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (error && !buf.error)
+                buf.error = error;
+            buf.pending--;
+        }
+        m_taskDone.notify_all();
+    }
 }
 
 template class ImageReader<double>;
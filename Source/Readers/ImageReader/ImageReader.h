@@ -9,13 +9,21 @@
 #include "DataReader.h"
 #include <random>
 #include <memory>
-#include <future>
 #include <array>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // REVIEW alexeyk: can't put it into ImageReader itself as ImageReader is a template.
 class ITransform;
+class MeanTransform;
+class PackedImageFile;
+class DecodedImageCache;
 
 template <class ElemType>
 class ImageReader : public IDataReader<ElemType>
@@ -83,6 +91,12 @@ private:
     std::mt19937 m_rng;
 
     std::vector<std::unique_ptr<ITransform>> m_transforms;
+    MeanTransform* m_meanTransform; // (in m_transforms)
+
+    // transferFormat=uint8: the features travel as bytes and are converted on the device, minus the mean image
+    bool m_compactTransfer;
+    std::vector<ElemType> m_meanShift; // [featDim] the negated mean image; empty without one
+    std::unique_ptr<Matrix<ElemType>> m_meanShiftOnDevice;
 
     std::wstring m_featName;
     std::wstring m_labName;
@@ -90,8 +104,16 @@ private:
     size_t m_featDim;
     size_t m_labDim;
 
+    // the images come either from the files of a map file, or from a packed image file (PackedImageFile.h)
     using StrIntPairT = std::pair<std::string, int>;
     std::vector<StrIntPairT> m_files;
+    std::unique_ptr<PackedImageFile> m_packedFile;
+    size_t m_randomizationWindow;     // packed file: number of chunks within which images are shuffled
+    std::vector<size_t> m_imageOrder; // [reading position] image index, randomized every epoch
+
+    // cache=ram|disk: the decoded images are kept for the following epochs, scaled to a shorter side of m_cacheShortSide if > 0
+    std::unique_ptr<DecodedImageCache> m_cache;
+    size_t m_cacheShortSide;
 
     size_t m_epochSize;
     size_t m_mbSize;
@@ -103,10 +125,37 @@ private:
     size_t m_subsetNum;
     size_t m_numSubsets;
 
+    // Images are decoded and transformed by a persistent pool of worker threads into a ring of minibatch buffers.
+    // With prefetching, up to m_prefetchDepth minibatches are in flight while the network runs; otherwise a
+    // minibatch is only issued when it is requested.
+    struct MinibatchBuffer
+    {
+        std::vector<ElemType> feat;
+        std::vector<unsigned char> compactFeat; // (instead of feat with compact transfer)
+        std::vector<ElemType> lab;
+        size_t size;                 // number of samples of this subset
+        size_t pending;              // images still being decoded
+        std::exception_ptr error;    // first decoding error, rethrown by GetMinibatch()
+    };
+    struct DecodeTask
+    {
+        size_t buffer; // index into m_ring
+        size_t index;  // sample within the minibatch
+        size_t file;   // index into m_files
+    };
+
     bool m_prefetch;
-    std::future<size_t> m_mbPrefetchFut;
-    std::vector<ElemType> m_featBuf;
-    std::vector<ElemType> m_labBuf;
+    size_t m_prefetchDepth;
+    std::vector<MinibatchBuffer> m_ring;
+    size_t m_ringHead;  // next buffer to hand out
+    size_t m_ringCount; // buffers issued and not yet handed out
+
+    std::vector<std::thread> m_workers;
+    std::deque<DecodeTask> m_tasks;
+    std::mutex m_mutex; // protects m_tasks, m_stopWorkers, and pending/error of m_ring
+    std::condition_variable m_taskAvailable;
+    std::condition_variable m_taskDone;
+    bool m_stopWorkers;
 
     bool m_imgListRand;
 
@@ -114,6 +163,14 @@ private:
     DataFormat m_mbFmt;
 
 private:
-    size_t ReadImages();
+    size_t GetNumImages() const
+    {
+        return m_imageOrder.size();
+    }
+    void RandomizeImageOrder();
+    bool IssueMinibatch();
+    void WaitForAllMinibatches();
+    void StopWorkers();
+    void DecodeLoop();
 };
 } } }
@@ -316,7 +316,8 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
         m_featureNameToIdMap[featureNames[i]] = iFeat;
         assert(iFeat == m_featureIdToNameMap.size());
         m_featureIdToNameMap.push_back(featureNames[i]);
-        scriptpaths.push_back(new msra::asr::FeatureSection(thisFeature(L"scpFile"), thisFeature(L"rx"), thisFeature(L"featureTransform", L"")));
+        const size_t numReaderThreads = thisFeature(L"numReaderThreads", (size_t) 1);
+        scriptpaths.push_back(new msra::asr::FeatureSection(thisFeature(L"scpFile"), thisFeature(L"rx"), thisFeature(L"featureTransform", L""), numReaderThreads));
         m_featureNameToDimMap[featureNames[i]] = m_featDims[i];
 
         m_featuresBufferMultiIO.push_back(NULL);
@@ -4,6 +4,7 @@
 #include "Matrix.h"
 #include "basetypes.h"
 #include "UtteranceDerivativeComputationInterface.h"
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -22,6 +23,7 @@ private:
     kaldi::TransitionModel m_transModel;
     kaldi::RandomAccessCompactLatticeReader* m_denlatReader;
     kaldi::RandomAccessInt32VectorReader* m_aliReader;
+    mutable std::mutex m_readerMutex; // the Kaldi readers are not thread-safe; the rest of ComputeDerivative() is
 
     // Rescores the lattice with the lastest posteriors from the neural network.
     void LatticeAcousticRescore(const wstring& uttID,
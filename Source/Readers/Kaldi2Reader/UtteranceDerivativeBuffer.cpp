@@ -138,11 +138,7 @@ bool UtteranceDerivativeBuffer<ElemType>::SetLikelihood(
                 m_uttPool[uttID].progress += numFrames;
                 if (m_uttPool[uttID].progress == m_uttPool[uttID].uttLength)
                 {
-                    m_derivativeInterface->ComputeDerivative(
-                        uttID,
-                        m_uttPool[uttID].logLikelihood,
-                        &m_uttPool[uttID].derivative,
-                        &m_uttPool[uttID].objective);
+                    StartDerivative(uttID, m_uttPool[uttID]);
                     m_uttPool[uttID].hasDerivative = true;
                     m_uttPool[uttID].progress = 0;
                     m_uttReady[m_uttPool[uttID].streamID] = true;
@@ -197,6 +193,7 @@ bool UtteranceDerivativeBuffer<ElemType>::GetDerivative(
                              " %S\n",
                              uttID.c_str());
             }
+            m_uttPool[uttID].derivativeDone.get(); // (rethrows what the computation threw)
 
             // Assign the derivatives.
             assert(uttID == uttInfoInMinibatch[i][j].first);
@@ -264,6 +261,34 @@ bool UtteranceDerivativeBuffer<ElemType>::GetObjective(
     return true;
 }
 
+// The computation only touches <uttUnit>'s log-likelihood, derivative and
+// objective, which nobody else accesses until it is done. Elements of
+// <m_uttPool> are not moved by insertions of other utterances.
+template <class ElemType>
+void UtteranceDerivativeBuffer<ElemType>::StartDerivative(
+    const wstring& uttID, UtteranceDerivativeUnit& uttUnit)
+{
+    UtteranceDerivativeComputationInterface<ElemType>* derivativeInterface = m_derivativeInterface;
+    UtteranceDerivativeUnit* unit = &uttUnit;
+    uttUnit.derivativeDone = std::async(std::launch::async, [derivativeInterface, uttID, unit]()
+                                        {
+                                            return derivativeInterface->ComputeDerivative(
+                                                uttID, unit->logLikelihood, &unit->derivative, &unit->objective);
+                                        }).share();
+}
+
+template <class ElemType>
+void UtteranceDerivativeBuffer<ElemType>::WaitForDerivatives()
+{
+    for (auto& utt : m_uttPool)
+    {
+        if (utt.second.derivativeDone.valid())
+        {
+            utt.second.derivativeDone.wait();
+        }
+    }
+}
+
 template <class ElemType>
 bool UtteranceDerivativeBuffer<ElemType>::HasResourceForDerivative(
     const wstring& uttID) const
@@ -307,6 +332,7 @@ bool UtteranceDerivativeBuffer<ElemType>::CompareUttInfo(
 template <class ElemType>
 void UtteranceDerivativeBuffer<ElemType>::ResetEpoch()
 {
+    WaitForDerivatives();
     m_needLikelihood = true;
     m_currentObj = 0;
     m_epochEnd = false;
@@ -4,19 +4,26 @@
 #include "basetypes.h"
 #include "Sequences.h"
 #include "UtteranceDerivativeComputationInterface.h"
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // This class "gules" together the log-likelihood from different minibatches,
 // and then calls <UtteranceDerivativeComputationInterface> class to compute
 // the derivative for given utterance.
+// The derivative of an utterance is computed on a thread of its own as soon as
+// its last log-likelihood has been set, so that the lattice processing of the
+// utterances of all streams runs in parallel, and overlaps with the forward
+// computation of the next minibatches that SetLikelihood() still waits for.
+// GetDerivative() waits for the derivatives it returns.
 template <class ElemType>
 class UtteranceDerivativeBuffer
 {
 private:
     struct UtteranceDerivativeUnit
     {
-        bool hasDerivative;
+        bool hasDerivative; // (requested; ready once <derivativeDone> is)
+        std::shared_future<bool> derivativeDone;
         size_t uttLength;
         size_t progress;
         size_t streamID;
@@ -56,6 +63,12 @@ private:
         const std::vector<std::vector<std::pair<wstring, size_t>>>& uttInfo1,
         const std::vector<std::vector<std::pair<wstring, size_t>>>& uttInfo2);
 
+    // Starts the derivative computation of a complete utterance.
+    void StartDerivative(const wstring& uttID, UtteranceDerivativeUnit& uttUnit);
+
+    // Waits for all derivative computations that are in flight.
+    void WaitForDerivatives();
+
 public:
     // Constructor.
     // Does not take ownership of <derivativeInterface>.
@@ -66,6 +79,7 @@ public:
     // Destructor.
     ~UtteranceDerivativeBuffer()
     {
+        WaitForDerivatives();
     }
 
     bool NeedLikelihoodToComputeDerivative() const
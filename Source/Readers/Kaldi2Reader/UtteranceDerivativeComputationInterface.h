@@ -12,6 +12,7 @@ class UtteranceDerivativeComputationInterface
 public:
     // Computes derivative and objective for given utterance ID and
     // log-likelihood from neural network output.
+    // May be called from several threads at once, for different utterances.
     virtual bool ComputeDerivative(const wstring& /*uttID*/,
                                    const Matrix<ElemType>& /*logLikelihood*/,
                                    Matrix<ElemType>* /*derivative*/,
@@ -26,6 +26,11 @@
 
 namespace msra { namespace asr {
 
+// FeatureSection -- Kaldi table reader for one feature stream, with the optional nnet feature transform
+// With numReaderThreads > 1 it holds one random-access reader per thread, so that the utterances of a chunk
+// can be fetched from their ark offsets concurrently (readraw()). This is only done for 'scp:' rspecifiers;
+// other rspecifiers (archives, pipes) are read sequentially and would be read once per reader.
+// The transform runs on CuMatrix and is not thread-safe, so it is applied by the caller's thread (transform()).
 class FeatureSection
 {
 public:
@@ -34,19 +39,38 @@ public:
     string feature_transform;
 
 private:
-    kaldi::RandomAccessBaseFloatMatrixReader *feature_reader;
+    std::vector<kaldi::RandomAccessBaseFloatMatrixReader *> feature_readers; // [reader index]
     kaldi::nnet1::Nnet nnet_transf;
     kaldi::CuMatrix<kaldi::BaseFloat> feats_transf;
     kaldi::Matrix<kaldi::BaseFloat> buf;
 
+    const kaldi::Matrix<kaldi::BaseFloat> &value(const string &key, size_t readerindex)
+    {
+        kaldi::RandomAccessBaseFloatMatrixReader *feature_reader = feature_readers[readerindex];
+        if (!feature_reader->HasKey(key))
+        {
+            fprintf(stderr, "Missing features for: %s", key.c_str());
+            throw std::runtime_error(msra::strfun::strprintf("Missing features for: %s", key.c_str()));
+        }
+        return feature_reader->Value(key);
+    }
+
 public:
-    FeatureSection(wstring scpFile, wstring rx_file, wstring feature_transform)
+    FeatureSection(wstring scpFile, wstring rx_file, wstring feature_transform, size_t numReaderThreads = 1)
     {
         this->scpFile = scpFile;
         this->rx = trimmed(fileToStr(toStr(rx_file)));
         this->feature_transform = toStr(feature_transform);
 
-        feature_reader = new kaldi::RandomAccessBaseFloatMatrixReader(rx);
+        if (numReaderThreads == 0)
+            numReaderThreads = 1;
+        if (numReaderThreads > 1 && rx.compare(0, 3, "scp") != 0)
+        {
+            fprintf(stderr, "FeatureSection: numReaderThreads=%zu ignored for non-scp rspecifier '%s'\n", numReaderThreads, rx.c_str());
+            numReaderThreads = 1;
+        }
+        for (size_t r = 0; r < numReaderThreads; r++)
+            feature_readers.push_back(new kaldi::RandomAccessBaseFloatMatrixReader(rx));
 
         // std::wcout << "Kaldi2Reader: created feature reader " << feature_reader << " [" << rx.c_str() << "]" << std::endl;
 
@@ -61,18 +85,33 @@ public:
         }
     }
 
-    kaldi::Matrix<kaldi::BaseFloat> &read(wstring wkey)
+    size_t numreaders() const
     {
-        string key = toStr(wkey);
+        return feature_readers.size();
+    }
 
-        if (!feature_reader->HasKey(key))
-        {
-            fprintf(stderr, "Missing features for: %s", key.c_str());
-            throw std::runtime_error(msra::strfun::strprintf("Missing features for: %s", key.c_str()));
-        }
+    bool hastransform() const
+    {
+        return !feature_transform.empty();
+    }
 
-        const kaldi::Matrix<kaldi::BaseFloat> &value = feature_reader->Value(key);
+    // read and transform an utterance, using reader 0
+    kaldi::Matrix<kaldi::BaseFloat> &read(wstring wkey)
+    {
+        return transform(value(toStr(wkey), 0));
+    }
 
+    // read an untransformed utterance with the given reader; concurrent calls must use distinct reader indices
+    void readraw(const wstring &wkey, size_t readerindex, kaldi::Matrix<kaldi::BaseFloat> &raw)
+    {
+        const kaldi::Matrix<kaldi::BaseFloat> &v = value(toStr(wkey), readerindex);
+        raw.Resize(v.NumRows(), v.NumCols());
+        raw.CopyFromMat(v);
+    }
+
+    // apply the feature transform (if any); the result lives in a buffer owned by this object
+    kaldi::Matrix<kaldi::BaseFloat> &transform(const kaldi::Matrix<kaldi::BaseFloat> &value)
+    {
         if (this->feature_transform.empty())
         {
             buf.Resize(value.NumRows(), value.NumCols());
@@ -92,7 +131,8 @@ public:
     {
         // std::wcout << "Kaldi2Reader: deleted feature reader " << feature_reader << std::endl;
 
-        delete feature_reader;
+        for (auto feature_reader : feature_readers)
+            delete feature_reader;
     }
 };
 
@@ -112,13 +152,13 @@ protected:
     This makes it ok to copy one to the other straight-up.
     */
     template <class MATRIX>
-    void copyKaldiToCntk(kaldi::Matrix<kaldi::BaseFloat> &kaldifeat, MATRIX &cntkfeat)
+    void copyKaldiToCntk(const kaldi::Matrix<kaldi::BaseFloat> &kaldifeat, MATRIX &cntkfeat)
     {
         int num_rows = kaldifeat.NumRows();
         int num_cols = kaldifeat.NumCols();
         int src_stride = kaldifeat.Stride();
 
-        kaldi::BaseFloat *src = kaldifeat.Data();
+        const kaldi::BaseFloat *src = kaldifeat.Data();
 
         int same_size = (num_rows == cntkfeat.cols()) && (num_cols == cntkfeat.rows());
         if (!same_size)
@@ -372,6 +412,17 @@ public:
         }
     }
 
+    // copy an utterance obtained from FeatureSection::readraw() into an already allocated matrix, applying the feature transform
+    // Without a transform this does not touch shared state and may run concurrently for distinct target matrices.
+    template <class MATRIX>
+    void copyNoAlloc(const parsedpath &ppath, const kaldi::Matrix<kaldi::BaseFloat> &raw, MATRIX &feat)
+    {
+        const kaldi::Matrix<kaldi::BaseFloat> &kaldifeat = ppath.featuresection->hastransform() ? ppath.featuresection->transform(raw) : raw;
+        if (feat.cols() != ppath.numframes() || feat.rows() != (size_t) kaldifeat.NumCols())
+            throw std::logic_error("read: stripe read called with wrong dimensions");
+        copyKaldiToCntk(kaldifeat, feat);
+    }
+
     // read an entire utterance into a virgen, allocatable matrix
     // Matrix type needs to have operator(i,j) and resize(n,m)
     template <class MATRIX>
@@ -12,6 +12,9 @@
 #include "latticearchive.h" // for reading HTK phoneme lattices (MMI training)
 #include "minibatchsourcehelpers.h"
 #include "minibatchiterator.h"
+#include <thread>
+#include <atomic>
+#include <exception>
 
 namespace msra { namespace dbn {
 
@@ -150,12 +153,17 @@ class minibatchutterancesourcemulti : public minibatchsource
                 frames.resize(featdim, totalframes);
                 if (!latticesource.empty())
                     lattices.resize(utteranceset.size());
+                msra::asr::FeatureSection *featuresection = utteranceset[0].parsedpath.featuresection;
+                const bool parallel = featuresection->numreaders() > 1 && utteranceset.size() > 1;
+                if (parallel) // features by the reader pool; lattices below
+                    readparallel(reader, *featuresection);
                 foreach_index (i, utteranceset)
                 {
                     // fprintf (stderr, ".");
                     // read features for this file
-                    auto uttframes = getutteranceframes(i);                                                           // matrix stripe for this utterance (currently unfilled)
-                    reader.readNoAlloc(utteranceset[i].parsedpath, (const string &) featkind, sampperiod, uttframes); // note: file info here used for checkuing only
+                    auto uttframes = getutteranceframes(i); // matrix stripe for this utterance (currently unfilled)
+                    if (!parallel)
+                        reader.readNoAlloc(utteranceset[i].parsedpath, (const string &) featkind, sampperiod, uttframes); // note: file info here used for checkuing only
                     // page in lattice data
                     if (!latticesource.empty())
                         latticesource.getlattices(utteranceset[i].key(), lattices[i], uttframes.cols());
@@ -172,6 +180,55 @@ class minibatchutterancesourcemulti : public minibatchsource
                 throw;
             }
         }
+        // read all utterances of the chunk with the feature section's reader pool
+        // Thread r fetches utterances from their ark offsets with reader r. Without a feature transform, each thread
+        // also copies into its utterances' (disjoint) column stripes; otherwise the transform is applied here afterwards.
+        void readparallel(msra::asr::htkfeatreader &reader, msra::asr::FeatureSection &featuresection) const
+        {
+            const bool transforminthread = !featuresection.hastransform();
+            std::vector<kaldi::Matrix<kaldi::BaseFloat>> raw(transforminthread ? 0 : utteranceset.size());
+            std::atomic<size_t> next(0);
+            std::vector<std::exception_ptr> errors(min(featuresection.numreaders(), utteranceset.size()));
+            std::vector<std::thread> threads;
+            for (size_t r = 0; r < errors.size(); r++)
+            {
+                threads.emplace_back([&, r]()
+                {
+                    try
+                    {
+                        kaldi::Matrix<kaldi::BaseFloat> buf;
+                        for (size_t i = next++; i < utteranceset.size(); i = next++)
+                        {
+                            const auto &ppath = utteranceset[i].parsedpath;
+                            if (transforminthread)
+                            {
+                                featuresection.readraw(ppath, r, buf);
+                                auto uttframes = getutteranceframes(i);
+                                reader.copyNoAlloc(ppath, buf, uttframes);
+                            }
+                            else
+                                featuresection.readraw(ppath, r, raw[i]);
+                        }
+                    }
+                    catch (...)
+                    {
+                        errors[r] = std::current_exception();
+                        next = utteranceset.size(); // stop the other threads early
+                    }
+                });
+            }
+            for (auto &thread : threads)
+                thread.join();
+            for (const auto &error : errors)
+                if (error)
+                    std::rethrow_exception(error);
+            foreach_index (i, raw)
+            {
+                auto uttframes = getutteranceframes(i);
+                reader.copyNoAlloc(utteranceset[i].parsedpath, raw[i], uttframes);
+                raw[i].Resize(0, 0);
+            }
+        }
         // page out data for this chunk
         void releasedata() const
         {
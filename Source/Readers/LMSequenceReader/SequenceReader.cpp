@@ -58,29 +58,22 @@ size_t SequenceReader<ElemType>::RecordsToRead(size_t mbStartSample, bool tail)
 template <class ElemType>
 typename IDataReader<ElemType>::LabelIdType SequenceReader<ElemType>::GetIdFromLabel(const std::string& labelValue, LabelInfo& labelInfo)
 {
-    auto found = labelInfo.mapLabelToId.find(labelValue);
-    string unk = this->mUnk;
-    // not yet found, add to the map
-    if (found == labelInfo.mapLabelToId.end())
-    {
-        found = labelInfo.mapLabelToId.find(unk);
-        if (found == labelInfo.mapLabelToId.end())
-            RuntimeError("%s not in vocabulary", labelValue.c_str());
-    }
-    return found->second;
+    LabelIdType id;
+    // not found, use the unknown word
+    if (!labelInfo.mapLabelToId.Find(labelValue, id) && !labelInfo.mapLabelToId.Find(this->mUnk, id))
+        RuntimeError("%s not in vocabulary", labelValue.c_str());
+    return id;
 }
 
 template <class ElemType>
 bool SequenceReader<ElemType>::CheckIdFromLabel(const std::string& labelValue, const LabelInfo& labelInfo, unsigned& labelId)
 {
-    auto found = labelInfo.mapLabelToId.find(labelValue);
-
-    // not yet found, add to the map
-    if (found == labelInfo.mapLabelToId.end())
+    LabelIdType id;
+    if (!labelInfo.mapLabelToId.Find(labelValue, id))
     {
         return false;
     }
-    labelId = found->second;
+    labelId = id;
     return true;
 }
 
@@ -495,7 +488,7 @@ void SequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
                 {
                     LabelType label = arrayLabels[i];
                     m_labelInfo[index].mapIdToLabel[i] = label;
-                    m_labelInfo[index].mapLabelToId[label] = i;
+                    m_labelInfo[index].mapLabelToId.Set(label, i);
                 }
                 m_labelInfo[index].idMax = (LabelIdType) arrayLabels.size();
                 m_labelInfo[index].mapName = labelPath;
@@ -512,13 +505,13 @@ void SequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
                                   nwords, mUnk, m_noiseSampler,
                                   false);
                     int iMax = -1, i;
-                    for (auto ptr = word4idx.begin(); ptr != word4idx.end(); ptr++)
+                    for (size_t entry = 0; entry < word4idx.size(); entry++)
                     {
-                        LabelType label = ptr->first;
-                        i = ptr->second;
+                        LabelType label = word4idx.Word(entry);
+                        i = word4idx.Id(entry);
                         iMax = max(i, iMax);
                         m_labelInfo[index].mapIdToLabel[i] = label;
-                        m_labelInfo[index].mapLabelToId[label] = i;
+                        m_labelInfo[index].mapLabelToId.Set(label, i);
                     }
                     m_labelInfo[index].idMax = (LabelIdType)(iMax + 1);
                 }
@@ -608,14 +601,77 @@ void SequenceReader<ElemType>::ReadWord(char* word, FILE* fin)
 
 template <class ElemType>
 void SequenceReader<ElemType>::ReadClassInfo(const wstring& vocfile, int& class_size,
-                                             map<string, int>& word4idx,
-                                             map<int, string>& idx4word,
-                                             map<int, int>& idx4class,
-                                             map<int, size_t>& idx4cnt,
+                                             Vocabulary<char, int>& word4idx,
+                                             std::vector<string>& idx4word,
+                                             std::vector<int>& idx4class,
+                                             std::vector<size_t>& idx4cnt,
                                              int nwords,
                                              string mUnk,
                                              noiseSampler<long>& m_noiseSampler,
                                              bool /*flatten*/)
+{
+    // the word classes are kept in a binary file next to the text file, which is read instead while it is up to date
+    const wstring binaryVocfile = vocfile + L".bin";
+    if (msra::files::fuptodate(binaryVocfile, vocfile))
+    {
+        File fstream(binaryVocfile, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+        fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BWordClasses");
+        word4idx.Read(fstream);
+        size_t numWords;
+        fstream >> numWords;
+        idx4word.resize(numWords);
+        for (auto& word : idx4word)
+            fstream >> word;
+        fstream >> idx4class >> idx4cnt >> class_size;
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EWordClasses");
+    }
+    else
+    {
+        ParseClassInfo(vocfile, class_size, word4idx, idx4word, idx4class, idx4cnt);
+
+        // write the binary word classes for the next time (not fatal, the directory may be read-only)
+        try
+        {
+            const wstring tempFileName = binaryVocfile + L".tmp";
+            {
+                File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+                fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BWordClasses");
+                word4idx.Write(fstream);
+                fstream << idx4word.size();
+                for (const auto& word : idx4word)
+                    fstream << word;
+                fstream << idx4class << idx4cnt << class_size;
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EWordClasses");
+            }
+            renameOrDie(tempFileName, binaryVocfile);
+        }
+        catch (const std::exception& e)
+        {
+            fprintf(stderr, "SequenceReader: binary word classes %ls not written: %s\n", binaryVocfile.c_str(), e.what());
+        }
+    }
+
+    if (idx4class.size() < nwords)
+    {
+        LogicError("SequenceReader::ReadClassInfo the actual number of words %d is smaller than the specified vocabulary size %d. Check if labelDim is too large. ", (int) idx4class.size(), (int) nwords);
+    }
+    std::vector<double> counts(idx4cnt.begin(), idx4cnt.end());
+    m_noiseSampler = noiseSampler<long>(counts);
+
+    // check if unk is the same used in vocabulary file
+    if (!word4idx.Contains(mUnk))
+    {
+        LogicError("SequenceReader::ReadClassInfo unk symbol %s is not in vocabulary file", mUnk.c_str());
+    }
+}
+
+// ParseClassInfo - read a text word class file, lines of word ID, count, word and class ID
+template <class ElemType>
+void SequenceReader<ElemType>::ParseClassInfo(const wstring& vocfile, int& class_size,
+                                              Vocabulary<char, int>& word4idx,
+                                              std::vector<string>& idx4word,
+                                              std::vector<int>& idx4class,
+                                              std::vector<size_t>& idx4cnt)
 {
     string tmp_vocfile(vocfile.begin(), vocfile.end()); // convert from wstring to string
     string strtmp;
@@ -643,8 +699,14 @@ void SequenceReader<ElemType>::ReadClassInfo(const wstring& vocfile, int& class_
         strtmp = tokens[2];
         clsidx = stoi(tokens[3]);
 
+        if (b >= idx4word.size()) // (IDs may come in any order)
+        {
+            idx4cnt.resize(b + 1, 0);
+            idx4word.resize(b + 1);
+            idx4class.resize(b + 1, 0);
+        }
         idx4cnt[b] = cnt;
-        word4idx[strtmp] = b;
+        word4idx.Set(strtmp, b);
         idx4word[b] = strtmp;
 
         idx4class[b] = clsidx;
@@ -652,21 +714,6 @@ void SequenceReader<ElemType>::ReadClassInfo(const wstring& vocfile, int& class_
     }
     fin.close();
     class_size++;
-
-    if (idx4class.size() < nwords)
-    {
-        LogicError("SequenceReader::ReadClassInfo the actual number of words %d is smaller than the specified vocabulary size %d. Check if labelDim is too large. ", (int) idx4class.size(), (int) nwords);
-    }
-    std::vector<double> counts(idx4cnt.size());
-    for (const auto& p : idx4cnt)
-        counts[p.first] = (double) p.second;
-    m_noiseSampler = noiseSampler<long>(counts);
-
-    // check if unk is the same used in vocabulary file
-    if (word4idx.find(mUnk.c_str()) == word4idx.end())
-    {
-        LogicError("SequenceReader::ReadClassInfo unk symbol %s is not in vocabulary file", mUnk.c_str());
-    }
 }
 
 // InitCache - Initialize the caching reader if cache files exist, otherwise the writer
@@ -1089,7 +1136,7 @@ void SequenceReader<ElemType>::GetInputToClass(std::map<std::wstring, Matrix<Ele
     m_id2classLocal->TransferFromDeviceToDevice(curDevId, CPUDEVICE, true, false, false);
     for (size_t j = 0; j < nwords; j++)
     {
-        int clsidx = idx4class[(int) j];
+        int clsidx = idx4class[j];
         (*m_id2classLocal)(j, 0) = (float) clsidx;
     }
     m_id2classLocal->TransferFromDeviceToDevice(CPUDEVICE, curDevId, true, false, false);
@@ -1120,7 +1167,7 @@ void SequenceReader<ElemType>::GetClassInfo()
     int prvcls = -1;
     for (size_t j = 0; j < nwords; j++)
     {
-        clsidx = idx4class[(int) j];
+        clsidx = idx4class[j];
         if (prvcls != clsidx && clsidx > prvcls)
         {
             if (prvcls >= 0)
@@ -1337,7 +1384,7 @@ void SequenceReader<ElemType>::SetLabelMapping(const std::wstring& /*sectionName
     labelInfo.mapLabelToId.clear();
     for (std::pair<unsigned, LabelType> var : labelMapping)
     {
-        labelInfo.mapLabelToId[var.second] = var.first;
+        labelInfo.mapLabelToId.Set(var.second, var.first);
     }
 }
 
@@ -1471,7 +1518,7 @@ void BatchSequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& reade
                 {
                     LabelType label = arrayLabels[i];
                     m_labelInfo[index].mapIdToLabel[i] = label;
-                    m_labelInfo[index].mapLabelToId[label] = i;
+                    m_labelInfo[index].mapLabelToId.Set(label, i);
                 }
                 m_labelInfo[index].idMax = (LabelIdType) arrayLabels.size();
                 m_labelInfo[index].mapName = labelPath;
@@ -1493,13 +1540,13 @@ void BatchSequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& reade
                         LogicError("BatchSequenceReader::Init : vocabulary size %d from setup file and %d from that in word class file %ls is not consistent", (int) nwords, (int) word4idx.size(), wClassFile.c_str());
                     }
                     int iMax = -1, i;
-                    for (auto ptr = word4idx.begin(); ptr != word4idx.end(); ptr++)
+                    for (size_t entry = 0; entry < word4idx.size(); entry++)
                     {
-                        LabelType label = ptr->first;
-                        i = ptr->second;
+                        LabelType label = word4idx.Word(entry);
+                        i = word4idx.Id(entry);
                         iMax = max(i, iMax);
                         m_labelInfo[index].mapIdToLabel[i] = label;
-                        m_labelInfo[index].mapLabelToId[label] = i;
+                        m_labelInfo[index].mapLabelToId.Set(label, i);
                     }
                     m_labelInfo[index].idMax = (LabelIdType)(iMax + 1);
                 }
@@ -1582,9 +1629,13 @@ void BatchSequenceReader<ElemType>::Reset()
     m_parser.mSentenceIndex2SentenceInfo.clear();
 }
 
+// StartDistributedMinibatchLoop - Startup a minibatch loop that reads only every numSubsets-th sentence, beginning with subsetNum
 template <class ElemType>
-void BatchSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples)
+void BatchSequenceReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
 {
+    m_subsetNum = subsetNum;
+    m_numSubsets = numSubsets;
+
     // if we aren't currently caching, see if we can use a cache
     if (!m_cachingReader && !m_cachingWriter)
     {
@@ -1596,7 +1647,7 @@ void BatchSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epo
     // if we are reading from the cache, do so now and return
     if (m_cachingReader)
     {
-        m_cachingReader->StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
+        m_cachingReader->StartDistributedMinibatchLoop(mbSize, epoch, subsetNum, numSubsets, requestedEpochSamples);
         return;
     }
 
@@ -1669,6 +1720,7 @@ void BatchSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epo
     m_idx2clsRead = false;
 
     m_parser.ParseReset();
+    m_numSentencesParsed = 0;
 
     Reset();
 }
@@ -1759,12 +1811,19 @@ bool BatchSequenceReader<ElemType>::EnsureDataAvailable(size_t /*mbStartSample*/
     size_t sLn = FindNextSentences(mNumRead);
     if (sLn == 0)
     {
-        Reset();
+        // parse blocks until one has sentences of this worker (the others are dropped right after parsing)
+        do
+        {
+            Reset();
+            seqPos.clear();
 
-        mNumRead = m_parser.Parse(CACHE_BLOG_SIZE, &m_labelTemp, &m_featureTemp, &seqPos);
-        firstPosInSentence = mLastPosInSentence;
-        if (mNumRead == 0)
-            return false;
+            const size_t numParsed = m_parser.Parse(CACHE_BLOG_SIZE, &m_labelTemp, &m_featureTemp, &seqPos);
+            firstPosInSentence = mLastPosInSentence;
+            if (numParsed == 0)
+                return false;
+            mNumRead = KeepSubsetOf(m_parser.mSentenceIndex2SentenceInfo, m_numSentencesParsed, m_subsetNum, m_numSubsets);
+            m_numSentencesParsed += numParsed;
+        } while (mNumRead == 0);
 
         std::random_shuffle(m_parser.mSentenceIndex2SentenceInfo.begin(), m_parser.mSentenceIndex2SentenceInfo.end());
 
@@ -2151,12 +2210,10 @@ int BatchSequenceReader<ElemType>::GetSentenceEndIdFromOutputLabel()
 
     // now get the labels
     LabelInfo& labelIn = m_labelInfo[labelInfoIn];
-    auto found = word4idx.find(labelIn.endSequence);
-
-    // not yet found, add to the map
-    if (found != word4idx.end())
+    int id;
+    if (word4idx.Find(labelIn.endSequence, id))
     {
-        return (int) found->second;
+        return id;
     }
     else
         return -1;
@@ -11,6 +11,7 @@
 #include "DataWriter.h"
 #include "Config.h"
 #include "SequenceParser.h"
+#include "Vocabulary.h"
 #include "RandomOrdering.h"
 #include <string>
 #include <map>
@@ -123,10 +124,10 @@ public:
     using LabelType = typename IDataReader<ElemType>::LabelType;
     using LabelIdType = typename IDataReader<ElemType>::LabelIdType;
 
-    map<string, int> word4idx;
-    map<int, string> idx4word;
-    map<int, int> idx4class;
-    map<int, size_t> idx4cnt;
+    Vocabulary<char, int> word4idx;
+    std::vector<string> idx4word;  // [id]
+    std::vector<int> idx4class;    // [id]
+    std::vector<size_t> idx4cnt;   // [id]
     int nwords, dims, nsamps, nglen, nmefeats;
     Matrix<ElemType>* m_id2classLocal;  // CPU version
     Matrix<ElemType>* m_classInfoLocal; // CPU version
@@ -205,7 +206,7 @@ protected:
     {
         LabelKind type; // labels are categories, create mapping table
         std::map<LabelIdType, LabelType> mapIdToLabel;
-        std::map<LabelType, LabelIdType> mapLabelToId;
+        Vocabulary<char, LabelIdType> mapLabelToId;
         LabelIdType idMax;         // maximum label ID we have encountered so far
         LabelIdType dim;           // maximum label ID we will ever see (used for array dimensions)
         std::string beginSequence; // starting sequence string (i.e. <s>)
@@ -247,14 +248,19 @@ public:
         InitFromConfig(config);
     }
     static void ReadClassInfo(const wstring& vocfile, int& class_size,
-                              map<string, int>& word4idx,
-                              map<int, string>& idx4word,
-                              map<int, int>& idx4class,
-                              map<int, size_t>& idx4cnt,
+                              Vocabulary<char, int>& word4idx,
+                              std::vector<string>& idx4word,
+                              std::vector<int>& idx4class,
+                              std::vector<size_t>& idx4cnt,
                               int nwords,
                               string mUnk,
                               noiseSampler<long>& m_noiseSampler,
                               bool flatten);
+    static void ParseClassInfo(const wstring& vocfile, int& class_size,
+                               Vocabulary<char, int>& word4idx,
+                               std::vector<string>& idx4word,
+                               std::vector<int>& idx4class,
+                               std::vector<size_t>& idx4cnt);
     static void ReadWord(char* wrod, FILE* fin);
 
     void GetLabelOutput(std::map<std::wstring, Matrix<ElemType>*>& matrices,
@@ -386,6 +392,11 @@ private:
     bool mSentenceEnd;
     bool mSentenceBegin;
 
+    // distributed reading: this worker keeps sentence i of the corpus if i % m_numSubsets == m_subsetNum
+    size_t m_subsetNum;
+    size_t m_numSubsets;
+    size_t m_numSentencesParsed; // since the beginning of the corpus, counting those of other workers
+
     MBLayoutPtr m_pMBLayout;
 
 public:
@@ -399,6 +410,9 @@ public:
         mLastPosInSentence = 0;
         mNumRead = 0;
         mSentenceEnd = false;
+        m_subsetNum = 0;
+        m_numSubsets = 1;
+        m_numSentencesParsed = 0;
     }
 
     template <class ConfigRecordType>
@@ -437,7 +451,15 @@ public:
     void GetLabelOutput(std::map<std::wstring, Matrix<ElemType>*>& matrices,
                         size_t m_mbStartSample, size_t actualmbsize);
 
-    void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize);
+    void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize)
+    {
+        return StartDistributedMinibatchLoop(mbSize, epoch, 0, 1, requestedEpochSamples);
+    }
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return (m_cachingReader == nullptr) || m_cachingReader->SupportsDistributedMBRead();
+    }
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
     bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
     bool EnsureDataAvailable(size_t mbStartSample, size_t& firstPosInSentence);
     size_t GetNumParallelSequences();
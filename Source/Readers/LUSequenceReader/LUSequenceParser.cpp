@@ -45,7 +45,7 @@ template class LUSequenceParser<double, std::string>;
 template class LUSequenceParser<double, std::wstring>;
 
 template <class NumType, class LabelType>
-long BatchLUSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<long> *labels, std::vector<vector<long>> *input, std::vector<SequencePosition> *seqPos, const map<wstring, long> &inputlabel2id, const map<wstring, long> &outputlabel2id, bool canMultiplePassData)
+long BatchLUSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<long> *labels, std::vector<vector<long>> *input, std::vector<SequencePosition> *seqPos, const Vocabulary<wchar_t, long> &inputlabel2id, const Vocabulary<wchar_t, long> &outputlabel2id, bool canMultiplePassData)
 {
     fprintf(stderr, "BatchLUSequenceParser: Parsing input data...\n");
 
@@ -95,27 +95,16 @@ long BatchLUSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, s
 
         bAtEOS = false;
         vector<long> vtmp;
+        long id;
         for (size_t i = 0; i < vstr.size() - 1; i++)
         {
-            if (inputlabel2id.find(vstr[i]) == inputlabel2id.end())
-            {
-                if (inputlabel2id.find(mUnkStr) == inputlabel2id.end())
-                {
-                    LogicError("cannot find item %ls and unk str %ls in input label", vstr[i].c_str(), mUnkStr.c_str());
-                }
-                vtmp.push_back(inputlabel2id.find(mUnkStr)->second);
-            }
-            else
-                vtmp.push_back(inputlabel2id.find(vstr[i])->second);
-        }
-        if (outputlabel2id.find(vstr[vstr.size() - 1]) == outputlabel2id.end())
-        {
-            if (outputlabel2id.find(mUnkStr) == outputlabel2id.end())
-                LogicError("cannot find item %ls and unk str %ls in output label", vstr[vstr.size() - 1].c_str(), mUnkStr.c_str());
-            labels->push_back(outputlabel2id.find(mUnkStr)->second);
+            if (!inputlabel2id.Find(vstr[i], id) && !inputlabel2id.Find(mUnkStr, id))
+                LogicError("cannot find item %ls and unk str %ls in input label", vstr[i].c_str(), mUnkStr.c_str());
+            vtmp.push_back(id);
         }
-        else
-            labels->push_back(outputlabel2id.find(vstr[vstr.size() - 1])->second);
+        if (!outputlabel2id.Find(vstr[vstr.size() - 1], id) && !outputlabel2id.Find(mUnkStr, id))
+            LogicError("cannot find item %ls and unk str %ls in output label", vstr[vstr.size() - 1].c_str(), mUnkStr.c_str());
+        labels->push_back(id);
         input->push_back(vtmp);
         if ((vstr[vstr.size() - 1] == m_endSequenceOut ||
              // below is for backward support
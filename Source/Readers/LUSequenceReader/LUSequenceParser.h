@@ -14,6 +14,7 @@
 #include <stdint.h>
 #include "Platform.h"
 #include "DataReader.h"
+#include "Vocabulary.h"
 
 using namespace std;
 
@@ -225,7 +226,7 @@ public:
     // numbers - pointer to vector to return the numbers
     // seqPos - pointers to the other two arrays showing positions of each sequence
     // returns - number of records actually read, if the end of file is reached the return value will be < requested records
-    long Parse(size_t recordsRequested, std::vector<long>* labels, std::vector<vector<long>>* input, std::vector<SequencePosition>* seqPos, const map<wstring, long>& inputlabel2id, const map<wstring, long>& outputlabel2id, bool mAllowMultPassData = false);
+    long Parse(size_t recordsRequested, std::vector<long>* labels, std::vector<vector<long>>* input, std::vector<SequencePosition>* seqPos, const Vocabulary<wchar_t, long>& inputlabel2id, const Vocabulary<wchar_t, long>& outputlabel2id, bool mAllowMultPassData = false);
 };
 }
 }
@@ -26,9 +26,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 template <class ElemType>
 long LUSequenceReader<ElemType>::GetIdFromLabel(const LabelType& labelValue, LabelInfo& labelInfo)
 {
-    auto found = labelInfo.word4idx.find(labelValue);
-
-    return found->second;
+    return labelInfo.word4idx[labelValue];
 }
 
 template <class ElemType>
@@ -43,13 +41,30 @@ BatchLUSequenceReader<ElemType>::~BatchLUSequenceReader()
 
 template <class ElemType>
 void BatchLUSequenceReader<ElemType>::ReadLabelInfo(const wstring& vocfile,
-                                                    map<wstring, long>& word4idx,
+                                                    Vocabulary<wchar_t, long>& word4idx,
                                                     bool readClass,
-                                                    map<wstring, long>& word4cls,
-                                                    map<long, wstring>& idx4word,
-                                                    map<long, long>& idx4class,
+                                                    std::vector<wstring>& idx4word,
+                                                    std::vector<long>& idx4class,
                                                     int& mNbrCls)
 {
+    // the vocabulary is kept in a binary file next to the text file, which is read instead while it is up to date
+    const wstring binaryVocfile = vocfile + (readClass ? L".class.bin" : L".bin");
+    if (msra::files::fuptodate(binaryVocfile, vocfile))
+    {
+        File fstream(binaryVocfile, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+        fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BLUVocabulary");
+        word4idx.Read(fstream);
+        size_t numWords;
+        fstream >> numWords;
+        idx4word.resize(numWords);
+        for (auto& word : idx4word)
+            fstream >> word;
+        fstream >> idx4class >> mNbrCls;
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ELUVocabulary");
+        this->nwords = (long) numWords;
+        return;
+    }
+
     wifstream vin;
 #ifdef _MSC_VER
     vin.open(vocfile, wifstream::in);
@@ -76,32 +91,51 @@ void BatchLUSequenceReader<ElemType>::ReadLabelInfo(const wstring& vocfile,
         {
             vector<wstring> wordandcls = wsep_string(strtmp, wstr);
             long cls = _wtoi(wordandcls[1].c_str());
-            word4cls[wordandcls[0]] = cls;
-
-            idx4class[b] = cls;
+            idx4class.push_back(cls);
 
-            if (idx4class[b] != prevcls)
+            if (cls != prevcls)
             {
-                if (idx4class[b] < prevcls)
+                if (cls < prevcls)
                     LogicError("LUSequenceReader: the word list needs to be grouped into classes and the classes indices need to be ascending.");
-                prevcls = idx4class[b];
+                prevcls = cls;
             }
 
-            word4idx[wordandcls[0]] = b;
-            idx4word[b++] = wordandcls[0];
+            word4idx.Set(wordandcls[0], b++);
+            idx4word.push_back(wordandcls[0]);
             if (mNbrCls < cls)
                 mNbrCls = cls;
         }
         else
         {
-            word4idx[strtmp] = b;
-            idx4word[b++] = strtmp;
+            word4idx.Set(strtmp, b++);
+            idx4word.push_back(strtmp);
         }
         this->nwords++;
     }
 
     if (readClass)
         mNbrCls++;
+
+    // write the binary vocabulary for the next time (not fatal, the directory may be read-only)
+    try
+    {
+        const wstring tempFileName = binaryVocfile + L".tmp";
+        {
+            File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLUVocabulary");
+            word4idx.Write(fstream);
+            fstream << idx4word.size();
+            for (const auto& word : idx4word)
+                fstream << word;
+            fstream << idx4class << mNbrCls;
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELUVocabulary");
+        }
+        renameOrDie(tempFileName, binaryVocfile);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "LUSequenceReader: binary vocabulary %ls not written: %s\n", binaryVocfile.c_str(), e.what());
+    }
 }
 
 template <class ElemType>
@@ -129,7 +163,7 @@ void BatchLUSequenceReader<ElemType>::GetClassInfo(LabelInfo& lblInfo)
     int prvcls = -1;
     for (size_t j = 0; j < this->nwords; j++)
     {
-        clsidx = lblInfo.idx4class[(long) j];
+        clsidx = lblInfo.idx4class[j];
         if (prvcls != clsidx)
         {
             if (prvcls >= 0)
@@ -166,10 +200,9 @@ int LUSequenceReader<ElemType>::GetSentenceEndIdFromOutputLabel()
 {
     LabelInfo& featIn = m_labelInfo[labelInfoOut];
 
-    auto found = featIn.word4idx.find(featIn.endSequence);
-
-    if (found != featIn.word4idx.end())
-        return (int) found->second;
+    LabelIdType id;
+    if (featIn.word4idx.Find(featIn.endSequence, id))
+        return (int) id;
     else
         return -1; // not found
 }
@@ -268,28 +301,33 @@ void LUSequenceReader<ElemType>::LoadLabelFile(const std::wstring& filePath, std
 template <class ElemType>
 void LUSequenceReader<ElemType>::ChangeMaping(const map<LabelType, LabelType>& maplist,
                                               const LabelType& unkstr,
-                                              map<LabelType, LabelIdType>& word4idx)
+                                              Vocabulary<wchar_t, LabelIdType>& word4idx)
 {
-    auto punk = word4idx.find(unkstr);
-    for (auto ptr = word4idx.begin(); ptr != word4idx.end(); ptr++)
+    LabelIdType unkIdx;
+    const bool hasUnk = word4idx.Find(unkstr, unkIdx);
+    for (size_t entry = 0; entry < word4idx.size(); entry++)
     {
-        LabelType wrd = ptr->first;
+        LabelType wrd = word4idx.Word(entry);
         LabelIdType idx = -1;
         if (maplist.find(wrd) != maplist.end())
         {
             LabelType mpp = maplist.find(wrd)->second;
-            idx = word4idx[mpp];
+            if (!word4idx.Find(mpp, idx)) // (a word mapped to one that is not in the vocabulary gets ID 0)
+            {
+                idx = 0;
+                word4idx.Set(mpp, idx);
+            }
         }
         else
         {
-            if (punk == word4idx.end())
+            if (!hasUnk)
             {
                 RuntimeError("check unk list is missing ");
             }
-            idx = punk->second;
+            idx = unkIdx;
         }
 
-        word4idx[wrd] = idx;
+        word4idx.Set(wrd, idx);
     }
 }
 
@@ -390,7 +428,6 @@ void BatchLUSequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& rea
                 {
                     ReadLabelInfo(wClassFile, m_labelInfo[index].word4idx,
                                   m_labelInfo[index].readerMode == ReaderMode::Class,
-                                  m_labelInfo[index].word4cls,
                                   m_labelInfo[index].idx4word, m_labelInfo[index].idx4class, m_labelInfo[index].mNbrClasses);
 
                     GetClassInfo(m_labelInfo[index]);
@@ -442,6 +479,8 @@ void BatchLUSequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& rea
 
     mEqualLengthOutput = readerConfig(L"equalLength", true);
     mAllowMultPassData = readerConfig(L"dataMultiPass", false);
+    mBucketByLength = readerConfig(L"bucketByLength", false);
+    mBucketWindow = readerConfig(L"bucketWindow", (size_t) 0);
 
     mIgnoreSentenceBeginTag = readerConfig(L"ignoresentencebegintag", false);
 }
@@ -461,9 +500,14 @@ void BatchLUSequenceReader<ElemType>::Reset()
     m_parser.mSentenceIndex2SentenceInfo.clear();
 }
 
+// StartDistributedMinibatchLoop - Startup a minibatch loop that reads only every numSubsets-th sentence, beginning with subsetNum
+// requestedEpochSamples - [in] number of sentences of the epoch, over all workers
 template <class ElemType>
-void BatchLUSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples)
+void BatchLUSequenceReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
 {
+    m_subsetNum = subsetNum;
+    m_numSubsets = numSubsets;
+
     if (m_featuresBuffer == NULL)
     {
         const LabelInfo& labelInfo = m_labelInfo[(m_labelInfo[labelInfoOut].type == labelNextWord) ? labelInfoIn : labelInfoOut];
@@ -491,6 +535,8 @@ void BatchLUSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t e
 
     m_mbSize = mbSize;
     m_epochSize = requestedEpochSamples;
+    if (m_epochSize != requestDataSize)
+        m_epochSize = (m_epochSize + numSubsets - 1 - subsetNum) / numSubsets; // (this worker's share)
 
     // we use epochSize, which might not be set yet, so use a default value for allocations if not yet set
     m_epoch = epoch;
@@ -512,6 +558,7 @@ void BatchLUSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t e
     Reset();
 
     m_parser.ParseReset(); // restart from the corpus beginning
+    m_numSentencesParsed = 0;
 }
 
 template <class ElemType>
@@ -653,15 +700,22 @@ bool BatchLUSequenceReader<ElemType>::EnsureDataAvailable(size_t /*mbStartSample
 
         if (nbrSentenceRead == 0)
         {
-            Reset();
-
-            mNumRead = m_parser.Parse(CACHE_BLOG_SIZE, &m_labelTemp, &m_featureTemp, &seqPos, featIn.word4idx, labelIn.word4idx, mAllowMultPassData);
-            if (mNumRead == 0)
+            // parse blocks until one has sentences of this worker (the others are dropped right after parsing)
+            do
             {
-                fprintf(stderr, "EnsureDataAvailable: No more data.\n");
-                m_pMBLayout->Init(1, 0);
-                return false;
-            }
+                Reset();
+                seqPos.clear();
+
+                const size_t numParsed = m_parser.Parse(CACHE_BLOG_SIZE, &m_labelTemp, &m_featureTemp, &seqPos, featIn.word4idx, labelIn.word4idx, mAllowMultPassData);
+                if (numParsed == 0)
+                {
+                    fprintf(stderr, "EnsureDataAvailable: No more data.\n");
+                    m_pMBLayout->Init(1, 0);
+                    return false;
+                }
+                mNumRead = KeepSubsetOf(m_parser.mSentenceIndex2SentenceInfo, m_numSentencesParsed, m_subsetNum, m_numSubsets);
+                m_numSentencesParsed += numParsed;
+            } while (mNumRead == 0);
             mProcessed.assign(mNumRead, false);
 
 #ifndef DEBUG_READER
@@ -672,6 +726,17 @@ bool BatchLUSequenceReader<ElemType>::EnsureDataAvailable(size_t /*mbStartSample
                 this->m_seed++;
             }
 #endif
+            if (mBucketByLength)
+            {
+                auto& sentences = m_parser.mSentenceIndex2SentenceInfo;
+                std::default_random_engine engine(this->m_seed);
+                BucketSequencesByLength(sentences, 0, sentences.size(), mBucketWindow > 0 ? mBucketWindow : sentences.size(), mRequestedNumParallelSequences,
+                                        [](const stSentenceInfo& sentence)
+                                        {
+                                            return sentence.sLen;
+                                        },
+                                        engine);
+            }
 
             m_readNextSampleLine += mNumRead;
             nbrSentenceRead = FindNextSentences(mRequestedNumParallelSequences);
@@ -824,7 +889,12 @@ bool BatchLUSequenceReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix
 
     bool moreData = EnsureDataAvailable(m_mbStartSample);
     if (moreData == false)
+    {
+        if (mBucketByLength || m_traceLevel > 0)
+            mGapFrames.Report("BatchLUSequenceReader");
         return false;
+    }
+    mGapFrames.Add(*m_pMBLayout);
 
     // actual size is the size of the next seqence
     size_t actualmbsize = 0;
@@ -1269,12 +1339,12 @@ void MultiIOBatchLUSequenceReader<ElemType>::InitFromConfig(const ConfigRecordTy
 }
 
 template <class ElemType>
-void MultiIOBatchLUSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples)
+void MultiIOBatchLUSequenceReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
 {
     // run for each reader
     for (typename map<wstring, BatchLUSequenceReader<ElemType>*>::iterator p = mReader.begin(); p != mReader.end(); p++)
     {
-        (p->second)->StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
+        (p->second)->StartDistributedMinibatchLoop(mbSize, epoch, subsetNum, numSubsets, requestedEpochSamples);
     }
 }
 
@@ -11,6 +11,7 @@
 #include "DataReader.h"
 #include "DataWriter.h"
 #include "LUSequenceParser.h"
+#include "SequenceBucketing.h"
 #include "Config.h" // for intargvector
 #include "ScriptableObjects.h"
 #include <string>
@@ -124,8 +125,8 @@ protected:
     struct LabelInfo
     {
         LabelKind type; // labels are categories, create mapping table
-        map<LabelType, LabelIdType> word4idx;
-        map<LabelIdType, LabelType> idx4word;
+        Vocabulary<wchar_t, LabelIdType> word4idx;
+        std::vector<LabelType> idx4word; // [id]
         LabelIdType idMax;       // maximum label ID we have encountered so far
         long dim;                // maximum label ID we will ever see (used for array dimensions)
         LabelType beginSequence; // starting sequence string (i.e. <s>)
@@ -144,8 +145,7 @@ protected:
         $ 26
         where the first column is the word and the second column is the class id, base 0
         */
-        map<wstring, long> word4cls;
-        map<long, long> idx4class;
+        std::vector<long> idx4class; // [id]
         Matrix<ElemType>* m_id2classLocal;  // CPU version
         Matrix<ElemType>* m_classInfoLocal; // CPU version
         int mNbrClasses;
@@ -176,7 +176,7 @@ public:
     void Init(const ScriptableObjects::IConfigRecord&){};
     void ChangeMaping(const map<LabelType, LabelType>& maplist,
                       const LabelType& unkstr,
-                      map<LabelType, LabelIdType>& word4idx);
+                      Vocabulary<wchar_t, LabelIdType>& word4idx);
 
     void Destroy(){};
 
@@ -269,6 +269,11 @@ private:
     bool mSentenceEnd;
     bool mSentenceBegin;
 
+    // distributed reading: this worker keeps sentence i of the corpus if i % m_numSubsets == m_subsetNum
+    size_t m_subsetNum;
+    size_t m_numSubsets;
+    size_t m_numSentencesParsed; // since the beginning of the corpus, counting those of other workers
+
 public:
     vector<bool> mProcessed;
     BatchLUSequenceParser<ElemType, LabelType> m_parser;
@@ -282,6 +287,9 @@ public:
         mSentenceEnd = false;
         mSentenceBegin = true;
         mIgnoreSentenceBeginTag = false;
+        m_subsetNum = 0;
+        m_numSubsets = 1;
+        m_numSentencesParsed = 0;
     }
 
     ~BatchLUSequenceReader();
@@ -324,7 +332,15 @@ public:
                                    Matrix<ElemType>*>& matrices,
                           LabelInfo& labelInfo, size_t actualmbsize);
 
-    void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize);
+    void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize)
+    {
+        return StartDistributedMinibatchLoop(mbSize, epoch, 0, 1, requestedEpochSamples);
+    }
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return true;
+    }
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
     bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
 
     bool EnsureDataAvailable(size_t mbStartSample);
@@ -336,11 +352,10 @@ public:
 public:
     void GetClassInfo(LabelInfo& lblInfo);
     void ReadLabelInfo(const wstring& vocfile,
-                       map<wstring, long>& word4idx,
+                       Vocabulary<wchar_t, long>& word4idx,
                        bool readClass,
-                       map<wstring, long>& word4cls,
-                       map<long, wstring>& idx4word,
-                       map<long, long>& idx4class,
+                       std::vector<wstring>& idx4word,
+                       std::vector<long>& idx4class,
                        int& mNbrCls);
 
     template <class ConfigRecordType>
@@ -377,6 +392,11 @@ public:
     bool mEqualLengthOutput;
     bool mAllowMultPassData;
 
+    // group sentences of similar length into the same minibatch, within windows of mBucketWindow sentences (0: all sentences read at once)
+    bool mBucketByLength;
+    size_t mBucketWindow;
+    GapFrameCounter mGapFrames;
+
     // return length of sentences size
     vector<size_t> mSentenceLengths; // [seqIndex] lengths of all sentences in a minibatch
     size_t mMaxSentenceLength;       // max over mSentenceLength[]  --TODO: why not compute on the fly?
@@ -419,7 +439,12 @@ public:
 
     bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
 
-    void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples);
+    void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples)
+    {
+        return StartDistributedMinibatchLoop(mbSize, epoch, 0, 1, requestedEpochSamples);
+    }
+    // (all streams drop the same sentences, so they stay parallel)
+    void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples) override;
 
     void CopyMBLayoutTo(MBLayoutPtr pMBLayout);
 
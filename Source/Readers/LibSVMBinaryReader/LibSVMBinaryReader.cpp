@@ -228,7 +228,8 @@ void SparseBinaryMatrix<ElemType>::Fill(Matrix<ElemType>* matrix)
 
 template <class ElemType>
 SparseBinaryInput<ElemType>::SparseBinaryInput(std::wstring fileName)
-    : m_fileName(fileName), m_readOrder(nullptr), m_readOrderLength(0), m_randomize(false), m_tempValues(nullptr), m_tempValuesSize(0), m_offsets(nullptr), m_offsetsStart(0), m_startMB(0), m_endMB(0)
+    : m_fileName(fileName), m_readOrder(nullptr), m_readOrderLength(0), m_randomize(false), m_tempValues(nullptr), m_tempValuesSize(0), m_offsets(nullptr), m_offsetsStart(0), m_startMB(0), m_endMB(0),
+      m_numReaderThreads(1), m_inOrder(true), m_stopReading(false), m_bufferSize(0), m_nextRing(0)
 {
     std::string name = msra::strfun::utf8(m_fileName);
     m_inFile.open(name, ifstream::binary | ifstream::in);
@@ -237,11 +238,18 @@ SparseBinaryInput<ElemType>::SparseBinaryInput(std::wstring fileName)
 template <class ElemType>
 SparseBinaryInput<ElemType>::~SparseBinaryInput()
 {
+    StopReaderThreads();
+    for (void* buffer : m_buffers)
+        free(buffer);
 }
 
 template <class ElemType>
-void SparseBinaryInput<ElemType>::Init(std::map<std::wstring, std::wstring> rename)
+void SparseBinaryInput<ElemType>::Init(std::map<std::wstring, std::wstring> rename, size_t numReaderThreads, bool inOrder)
 {
+    if (numReaderThreads == 0)
+        InvalidArgument("LibSVMBinaryReader: numReaderThreads must be at least 1.");
+    m_numReaderThreads = numReaderThreads;
+    m_inOrder = inOrder;
 
     size_t base_offset = 0;
     m_inFile.seekg(0, ifstream::beg);
@@ -404,6 +412,7 @@ void SparseBinaryInput<ElemType>::Shuffle()
 template <class ElemType>
 void SparseBinaryInput<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t subsetNum, size_t numSubsets)
 {
+    StopReaderThreads(); // (the previous epoch's, which may not have read all of it)
 
     m_nextMB = 0;
 
@@ -445,19 +454,56 @@ void SparseBinaryInput<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, s
         // fprintf(stderr, "m_offsets[%lu] = %lu\n", c, m_offsets[c]);
     }
     // fprintf(stderr, "max mb size: %ld\n", m_maxMBSize);
-    size_t maxMem = 1024 * 1024 * 1024; // 1GB
-    size_t maxPointers = maxMem / m_maxMBSize;
-    for (size_t c = 0; c < maxPointers; c++)
+    AllocateBuffers();
+
+    m_stopReading = false;
+    m_nextRing = 0;
+    for (size_t t = 0; t < m_numReaderThreads; t++)
+        m_readerThreads.push_back(std::thread([this, t]
+                                              {
+                                                  this->ReadMinibatches(t);
+                                              }));
+}
+
+// (re)fill the rings with the reader threads' buffers; they are reallocated only for larger minibatches
+// Together they take up to 1GB, at most 256 per thread.
+template <class ElemType>
+void SparseBinaryInput<ElemType>::AllocateBuffers()
+{
+    const size_t maxMem = 1024 * 1024 * 1024; // 1GB
+    const size_t buffersPerThread = max((size_t) 2, min((size_t) 256, maxMem / max(m_maxMBSize, (size_t) 1) / m_numReaderThreads));
+    if (m_maxMBSize > m_bufferSize || m_buffers.size() != buffersPerThread * m_numReaderThreads)
     {
-        void* dataBuffer = malloc(m_maxMBSize);
-        m_dataToProduce.push(dataBuffer);
+        for (void* buffer : m_buffers)
+            free(buffer);
+        m_buffers.assign(buffersPerThread * m_numReaderThreads, nullptr);
+        for (auto& buffer : m_buffers)
+            buffer = malloc(m_maxMBSize);
+        m_bufferSize = m_maxMBSize;
     }
+    m_freeBuffers.resize(m_numReaderThreads);
+    m_filledBuffers.resize(m_numReaderThreads);
+    for (size_t t = 0; t < m_numReaderThreads; t++)
+    {
+        if (!m_freeBuffers[t])
+        {
+            m_freeBuffers[t].reset(new SPSCRing<void*>(buffersPerThread));
+            m_filledBuffers[t].reset(new SPSCRing<void*>(buffersPerThread));
+        }
+        m_freeBuffers[t]->Reset(buffersPerThread);
+        m_filledBuffers[t]->Reset(buffersPerThread);
+        for (size_t i = 0; i < buffersPerThread; i++)
+            m_freeBuffers[t]->TryPush(m_buffers[t * buffersPerThread + i]);
+    }
+}
 
-    std::thread readData([this]
-                         {
-                             this->ReadMinibatches(m_readOrder, m_readOrderLength);
-                         });
-    readData.detach();
+template <class ElemType>
+void SparseBinaryInput<ElemType>::StopReaderThreads()
+{
+    m_stopReading = true;
+    for (auto& thread : m_readerThreads)
+        thread.join();
+    m_readerThreads.clear();
 }
 template <class ElemType>
 void* SparseBinaryInput<ElemType>::GetTempDataPointer(size_t numBytes)
@@ -493,52 +539,49 @@ shared_ptr<BinaryMatrix<ElemType>> SparseBinaryInput<ElemType>::CreateMatrix(std
     return retVal;
 }
 
+// thread 'thread' of the reader threads: read its share of the window, each minibatch into a buffer of its own
+// Each thread has a stream of its own, so that the reads do not wait for each other.
 template <class ElemType>
-void SparseBinaryInput<ElemType>::ReadMinibatches(size_t* read_order, size_t numToRead)
+void SparseBinaryInput<ElemType>::ReadMinibatches(size_t thread)
 {
-#if DEBUG
-    marker_series series(L"Read Minibatches");
-    // diagnostic::span span(series, L"Reading Data");
-    span* read_span;
-#endif
-    for (size_t c = 0; c < numToRead; c++)
+    ifstream inFile(msra::strfun::utf8(m_fileName), ifstream::binary | ifstream::in);
+    SPSCRing<void*>& freeBuffers = *m_freeBuffers[thread];
+    SPSCRing<void*>& filledBuffers = *m_filledBuffers[thread];
+    for (size_t c = thread; c < m_readOrderLength; c += m_numReaderThreads)
     {
-#if DEBUG
-        read_span = new span(series, 1, L"Getting Buffer %ld\n", c);
-#endif
-        // fprintf(stderr, "start reading data %ld\n", c);
-        size_t readSize = m_offsets[read_order[c] + 1] - m_offsets[read_order[c]];
-//void* data_buffer = GetTempDataPointer(readSize);
-#if DEBUG
-        series.write_flag(_T("Getting buffer."));
-#endif
-        void* data_buffer = m_dataToProduce.pop();
-#if DEBUG
-        delete read_span;
-        series.write_flag(_T("Got buffer."));
-        read_span = new span(series, 2, L"Reading Data %ld\n", c);
-#endif
+        void* data_buffer;
+        while (!freeBuffers.TryPop(data_buffer))
+        {
+            if (m_stopReading)
+                return;
+            std::this_thread::yield();
+        }
+        const size_t mb = m_readOrder[c];
+        const size_t readSize = m_offsets[mb + 1] - m_offsets[mb];
+        inFile.seekg(m_dataStart + m_offsets[mb], ios::beg);
+        inFile.read((char*) data_buffer, readSize);
+        filledBuffers.TryPush(data_buffer); // (cannot be full: it holds at most the thread's own buffers)
+    }
+}
 
-        m_inFile.clear();
-#if DEBUG
-        series.write_flag(_T("seeking."));
-#endif
-        m_inFile.seekg(m_dataStart + m_offsets[c], ios::beg);
-#if DEBUG
-        series.write_flag(_T("reading."));
-#endif
-        m_inFile.read((char*) data_buffer, readSize);
-        m_dataToConsume.push(data_buffer);
-//fprintf(stderr, "done reading data %ld\n", c);
-#if DEBUG
-        series.write_flag(_T("Done read, pushed buffer."));
-        delete read_span;
-#endif
+// the next minibatch read, and the reader thread that read it
+template <class ElemType>
+void* SparseBinaryInput<ElemType>::NextFilledBuffer(size_t& thread)
+{
+    for (;;)
+    {
+        for (size_t i = 0; i < (m_inOrder ? 1 : m_numReaderThreads); i++)
+        {
+            thread = m_inOrder ? m_nextMB % m_numReaderThreads : (m_nextRing + i) % m_numReaderThreads;
+            void* data_buffer;
+            if (m_filledBuffers[thread]->TryPop(data_buffer))
+            {
+                m_nextRing = (thread + 1) % m_numReaderThreads;
+                return data_buffer;
+            }
+        }
+        std::this_thread::yield();
     }
-//m_dataToConsume.push(nullptr);
-#if DEBUG
-    series.write_flag(_T("Done reading."));
-#endif
 }
 
 template <class ElemType>
@@ -633,7 +676,8 @@ size_t SparseBinaryInput<ElemType>::FillMatrices(std::map<std::wstring, shared_p
     // while (curSize + m_microBatchSize <= m_mbSize && (data_buffer = m_dataToConsume.pop()) != nullptr) {
     while (curSize + m_microBatchSize <= m_mbSize && m_nextMB < m_epochSize)
     {
-        data_buffer = m_dataToConsume.pop();
+        size_t thread;
+        data_buffer = NextFilledBuffer(thread);
         // clock_t in_w = clock();
         // start_w = in_w - start_w;
         // fprintf(stderr, "start read mb\tIt took me %d clicks (%f seconds).\n", start_w, ((float)start_w) / CLOCKS_PER_SEC);
@@ -642,7 +686,7 @@ size_t SparseBinaryInput<ElemType>::FillMatrices(std::map<std::wstring, shared_p
         curSize += ReadMinibatch(data_buffer, matrices);
         // fprintf(stderr, "end read mb\n");
         m_nextMB++;
-        m_dataToProduce.push(data_buffer);
+        m_freeBuffers[thread]->TryPush(data_buffer);
     }
     // fprintf(stderr, "end fill matrices\n");
     return curSize;
@@ -687,8 +731,11 @@ void LibSVMBinaryReader<ElemType>::InitFromConfig(const ConfigRecordType& reader
 
     std::wstring file = readerConfig(L"file", L"");
 
+    // reader threads; when randomizing, minibatches are taken in the order in which they are read
+    const size_t numReaderThreads = readerConfig(L"numReaderThreads", (size_t) 1);
+
     m_dataInput = make_shared<SparseBinaryInput<ElemType>>(file);
-    m_dataInput->Init(rename);
+    m_dataInput->Init(rename, numReaderThreads, m_randomize == 0);
 
     m_mbSize = (size_t) readerConfig(L"minibatch", 0);
     if (m_mbSize > 0)
@@ -737,6 +784,9 @@ void LibSVMBinaryReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize,
     reader_series = new marker_series(L"Base Reader");
     cur_read = 0;
 #endif
+    // (a minibatch read ahead in the last epoch must not race with the reader threads being restarted)
+    if (m_pendingAsyncGetMinibatch.valid())
+        m_pendingAsyncGetMinibatch.get();
     m_dataInput->StartDistributedMinibatchLoop(mbSize, subsetNum, numSubsets);
 }
 
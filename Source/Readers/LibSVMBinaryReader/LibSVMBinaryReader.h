@@ -9,6 +9,7 @@
 #include "DataReader.h"
 #include "DataWriter.h"
 #include "RandomOrdering.h"
+#include "PrefetchQueue.h"
 #include <string>
 #include <map>
 #include <vector>
@@ -18,6 +19,7 @@
 #include <condition_variable>
 #include <deque>
 #include <thread>
+#include <atomic>
 #if DEBUG
 #include <cvmarkersobj.h>
 using namespace Concurrency::diagnostic;
@@ -25,36 +27,6 @@ using namespace Concurrency::diagnostic;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-template <typename T>
-class BlockingQueue
-{
-private:
-    std::mutex d_mutex;
-    std::condition_variable d_condition;
-    std::deque<T> d_queue;
-
-public:
-    void push(T const& value)
-    {
-        {
-            std::unique_lock<std::mutex> lock(this->d_mutex);
-            d_queue.push_front(value);
-        }
-        this->d_condition.notify_one();
-    }
-    T pop()
-    {
-        std::unique_lock<std::mutex> lock(this->d_mutex);
-        this->d_condition.wait(lock, [=]
-                               {
-                                   return !this->d_queue.empty();
-                               });
-        T rc(std::move(this->d_queue.back()));
-        this->d_queue.pop_back();
-        return rc;
-    }
-};
-
 template <class ElemType>
 class BinaryMatrix
 {
@@ -149,9 +121,9 @@ class SparseBinaryInput
 public:
     SparseBinaryInput(std::wstring fileName);
     ~SparseBinaryInput();
-    void Init(std::map<std::wstring, std::wstring> rename);
+    void Init(std::map<std::wstring, std::wstring> rename, size_t numReaderThreads, bool inOrder);
     void StartDistributedMinibatchLoop(size_t mbSize, size_t subsetNum, size_t numSubsets);
-    void ReadMinibatches(size_t* read_order, size_t numToRead);
+    void ReadMinibatches(size_t thread);
     size_t ReadMinibatch(void* data_buffer, std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices);
     // void GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
     size_t FillMatrices(std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices);
@@ -173,6 +145,9 @@ private:
     void FillReadOrder(size_t windowSize);
     void* GetTempDataPointer(size_t numVals);
     bool Randomize();
+    void AllocateBuffers();
+    void* NextFilledBuffer(size_t& thread);
+    void StopReaderThreads();
 
     ifstream m_inFile;
     std::wstring m_fileName;
@@ -220,8 +195,19 @@ private:
 #else
     int32_t sysGran;
 #endif
-    BlockingQueue<void*> m_dataToProduce;
-    BlockingQueue<void*> m_dataToConsume;
+
+    // reader threads: thread t reads the minibatches t, t + N, t + 2N, ... of the read order into buffers of its own,
+    // which circulate through two rings between it and FillMatrices(); in order, FillMatrices() takes minibatch k
+    // from thread k % N, otherwise from whichever thread has one ready
+    size_t m_numReaderThreads;
+    bool m_inOrder;
+    std::vector<std::thread> m_readerThreads;
+    std::atomic<bool> m_stopReading;
+    std::vector<void*> m_buffers; // [t * buffersPerThread + i] preallocated, reused over epochs
+    size_t m_bufferSize;
+    std::vector<std::unique_ptr<SPSCRing<void*>>> m_freeBuffers;   // [t] buffers for thread t to fill
+    std::vector<std::unique_ptr<SPSCRing<void*>>> m_filledBuffers; // [t] minibatches read by thread t
+    size_t m_nextRing;                                             // (not in order) the ring to try first
 };
 
 template <class ElemType>
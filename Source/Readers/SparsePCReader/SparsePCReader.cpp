@@ -27,6 +27,8 @@ DWORD LODWORD(size_t size)
 template <class ElemType>
 SparsePCReader<ElemType>::~SparsePCReader()
 {
+    m_prefetcher.Stop(); // (before the mapping goes away)
+
     if (m_filemap != NULL)
     {
         UnmapViewOfFile(m_filemap);
@@ -38,29 +40,6 @@ SparsePCReader<ElemType>::~SparsePCReader()
     }
 
     CloseHandle(m_hndl);
-
-    for (int i = 0; i < m_featureCount; i++)
-    {
-        if (m_values[i] != NULL)
-        {
-            free(m_values[i]);
-        }
-
-        if (m_rowIndices[i] != NULL)
-        {
-            free(m_rowIndices[i]);
-        }
-
-        if (m_colIndices[i] != NULL)
-        {
-            free(m_colIndices[i]);
-        }
-    }
-
-    if (m_labelsBuffer != NULL)
-    {
-        free(m_labelsBuffer);
-    }
 }
 
 template <class ElemType>
@@ -85,7 +64,6 @@ void SparsePCReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
     m_maxReadData = readerConfig(L"maxReadData", (size_t) 0);
     m_doGradientCheck = readerConfig(L"gradientCheck", false);
     m_returnDense = readerConfig(L"returnDense", false);
-    m_sparsenessFactor = readerConfig(L"sparsenessFactor", (size_t) 50); // We don't expect more than one in 50 input positions to have non-zero values
     m_verificationCode = (int32_t) readerConfig(L"verificationCode", (size_t) 0);
 
     std::vector<std::wstring> featureNames;
@@ -109,9 +87,6 @@ void SparsePCReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
 
     m_featureNames = std::vector<std::wstring>(m_featureCount);
     m_dims = std::vector<size_t>(m_featureCount);
-    m_values = std::vector<ElemType*>(m_featureCount);
-    m_rowIndices = std::vector<int32_t*>(m_featureCount);
-    m_colIndices = std::vector<int32_t*>(m_featureCount);
 
     for (int i = 0; i < m_featureCount; i++)
     {
@@ -149,120 +124,129 @@ void SparsePCReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
 // mbSize - [in] size of the minibatch (number of Samples, etc.)
 // epoch - [in] epoch number for this loop --ignored
 // requestedEpochSamples - [in] number of samples to randomize --ignored
+// subsetNum, numSubsets - [in] distributed reading: this worker reads minibatches subsetNum, subsetNum + numSubsets, ... of the file
 template <class ElemType>
-void SparsePCReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t /*epoch*/, size_t /*requestedEpochSamples*/)
+void SparsePCReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t /*epoch*/, size_t subsetNum, size_t numSubsets, size_t /*requestedEpochSamples*/)
 {
-    if (m_values[0] == NULL || m_miniBatchSize != mbSize)
-    {
-        m_miniBatchSize = mbSize;
+    m_miniBatchSize = mbSize;
 
+    // reset the next read sample
+    m_currOffset = 0;
+
+    // two minibatches in flight: one being parsed while the other one is copied into the matrices
+    // The records have no index, so the minibatches of the other workers are stepped over by their headers, without copying them.
+    int64_t nextOffset = 0;
+    size_t numBefore = subsetNum * mbSize;
+    const size_t numOthers = (numSubsets - 1) * mbSize;
+    m_prefetcher.Start(2, [this, nextOffset, numBefore, numOthers](PrefetchedMinibatch& minibatch) mutable
+                       {
+                           SkipSamples(nextOffset, numBefore);
+                           numBefore = 0;
+                           if (!ReadMinibatch(minibatch, nextOffset))
+                               return false;
+                           SkipSamples(nextOffset, numOthers);
+                           minibatch.endOffset = nextOffset; // (so that DataEnd() sees the end after the last minibatch of this worker)
+                           return true;
+                       });
+}
+
+// SkipSamples - step over numSamples samples in the mapping, starting at offset, without parsing their values
+template <class ElemType>
+void SparsePCReader<ElemType>::SkipSamples(int64_t& offset, size_t numSamples) const
+{
+    for (size_t j = 0; j < numSamples && offset < m_filePositionMax; j++)
+    {
         for (int i = 0; i < m_featureCount; i++)
         {
-            if (m_values[i] != NULL)
-            {
-                free(m_values[i]);
-                free(m_colIndices[i]);
-                free(m_rowIndices[i]);
-                free(m_labelsBuffer);
-            }
-
-            m_values[i] = (ElemType*) malloc(sizeof(ElemType) * m_dims[i] * m_miniBatchSize / m_sparsenessFactor);
-            m_rowIndices[i] = (int32_t*) malloc(sizeof(int32_t) * m_dims[i] * m_miniBatchSize / m_sparsenessFactor);
-            m_colIndices[i] = (int32_t*) malloc(sizeof(int32_t) * (m_miniBatchSize + 1));
-            m_labelsBuffer = (ElemType*) malloc(sizeof(ElemType) * m_miniBatchSize);
+            const int32_t nnz = *(int32_t*) ((char*) m_dataBuffer + offset);
+            offset += sizeof(int32_t) + (sizeof(ElemType) + sizeof(int32_t)) * nnz;
         }
+        offset += sizeof(ElemType);
+        if (m_verificationCode != 0)
+            offset += sizeof(int32_t);
     }
-
-    // reset the next read sample
-    m_currOffset = 0;
 }
 
-// GetMinibatch - Get the next minibatch (features and labels)
-// matrices - [in] a map with named matrix types (i.e. 'features', 'labels') mapped to the corresponding matrix,
-//             [out] each matrix resized if necessary containing data.
-// returns - true if there are more minibatches, false if no more minibatchs remain
+// ReadMinibatch - parse the samples of the next minibatch from the mapping, starting at offset
+// returns - false if there are none left
 template <class ElemType>
-bool SparsePCReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices)
+bool SparsePCReader<ElemType>::ReadMinibatch(PrefetchedMinibatch& minibatch, int64_t& offset) const
 {
-    // get out if they didn't call StartMinibatchLoop() first
-    if (m_miniBatchSize == 0)
-        return false;
-
     // Return early (for debugging purposes)
-    if (m_maxReadData > 0 && m_currOffset >= m_maxReadData)
+    if (m_maxReadData > 0 && offset >= m_maxReadData)
         return false;
 
-    if (m_currOffset >= m_filePositionMax)
+    if (offset >= m_filePositionMax)
         return false;
 
-    Matrix<ElemType>* labels = nullptr; // labels to return, or NULL if no labels in matrix set
-    auto labelEntry = matrices.find(m_labelName);
-    if (labelEntry != matrices.end())
-    {
-        labels = labelEntry->second;
-
-        if (labels->GetNumRows() != 1)
-            RuntimeError("SparsePCReader only supports single label value per column but the network expected %d.", (int) labels->GetNumRows());
-    }
-
-    std::vector<int32_t> currIndex = std::vector<int32_t>(m_featureCount);
-    for (int i = 0; i < m_featureCount; i++)
-    {
-        currIndex[i] = 0;
-    }
-
-    size_t j = 0;
+    minibatch.features.resize(m_featureCount);
+    for (auto& features : minibatch.features)
+        features.Clear();
+    minibatch.labels.clear();
 
-    for (j = 0; j < m_miniBatchSize && m_currOffset < m_filePositionMax; j++)
+    for (size_t j = 0; j < m_miniBatchSize && offset < m_filePositionMax; j++)
     {
         for (int i = 0; i < m_featureCount; i++)
         {
-            m_colIndices[i][j] = currIndex[i];
-
-            int32_t nnz = *(int32_t*) ((char*) m_dataBuffer + m_currOffset);
-            m_currOffset += sizeof(int32_t);
-
-            if (nnz > m_dims[i] / m_sparsenessFactor)
-            {
-                RuntimeError("Input data is too dense - not enough memory allocated");
-            }
-
-            memcpy(m_values[i] + currIndex[i], (char*) m_dataBuffer + m_currOffset, sizeof(ElemType) * nnz);
-            m_currOffset += (sizeof(ElemType) * nnz);
-
-            memcpy(m_rowIndices[i] + currIndex[i], (char*) m_dataBuffer + m_currOffset, sizeof(int32_t) * nnz);
-            m_currOffset += (sizeof(int32_t) * nnz);
-
-            currIndex[i] += nnz;
+            const int32_t nnz = *(int32_t*) ((char*) m_dataBuffer + offset);
+            offset += sizeof(int32_t);
+            minibatch.features[i].AppendColumn((char*) m_dataBuffer + offset, nnz);
+            offset += (sizeof(ElemType) + sizeof(int32_t)) * nnz;
         }
 
-        ElemType label = *(ElemType*) ((char*) m_dataBuffer + m_currOffset);
-        m_labelsBuffer[j] = label;
-        m_currOffset += sizeof(ElemType);
+        ElemType label = *(ElemType*) ((char*) m_dataBuffer + offset);
+        minibatch.labels.push_back(label);
+        offset += sizeof(ElemType);
 
         if (m_verificationCode != 0)
         {
-            int32_t verifCode = *(int32_t*) ((char*) m_dataBuffer + m_currOffset);
+            int32_t verifCode = *(int32_t*) ((char*) m_dataBuffer + offset);
 
             if (verifCode != m_verificationCode)
-            {
                 RuntimeError("Verification code did not match (expected %d) - error in reading data", m_verificationCode);
-                return false;
-            }
 
-            m_currOffset += sizeof(int32_t);
+            offset += sizeof(int32_t);
         }
     }
+    minibatch.endOffset = offset;
+    return true;
+}
+
+// GetMinibatch - Get the next minibatch (features and labels)
+// matrices - [in] a map with named matrix types (i.e. 'features', 'labels') mapped to the corresponding matrix,
+//             [out] each matrix resized if necessary containing data.
+// returns - true if there are more minibatches, false if no more minibatchs remain
+template <class ElemType>
+bool SparsePCReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices)
+{
+    // get out if they didn't call StartMinibatchLoop() first
+    if (m_miniBatchSize == 0)
+        return false;
+
+    Matrix<ElemType>* labels = nullptr; // labels to return, or NULL if no labels in matrix set
+    auto labelEntry = matrices.find(m_labelName);
+    if (labelEntry != matrices.end())
+    {
+        labels = labelEntry->second;
+
+        if (labels->GetNumRows() != 1)
+            RuntimeError("SparsePCReader only supports single label value per column but the network expected %d.", (int) labels->GetNumRows());
+    }
+
+    PrefetchedMinibatch* minibatch = m_prefetcher.Next();
+    if (!minibatch)
+        return false;
+    const size_t j = minibatch->labels.size();
 
     for (int i = 0; i < m_featureCount; i++)
     {
-        m_colIndices[i][j] = currIndex[i];
         Matrix<ElemType>& features = *matrices[m_featureNames[i]];
 
         if (features.GetFormat() != MatrixFormat::matrixFormatSparseCSC)
             features.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
 
-        features.SetMatrixFromCSCFormat(m_colIndices[i], m_rowIndices[i], m_values[i], currIndex[i], m_dims[i], j);
+        const auto& buffer = minibatch->features[i];
+        features.SetMatrixFromCOOFormat(buffer.colIndices.data(), buffer.rowIndices.data(), buffer.values.data(), buffer.NumNonZeros(), m_dims[i], j);
     }
 
     if (m_returnDense || m_doGradientCheck)
@@ -277,8 +261,10 @@ bool SparsePCReader<ElemType>::GetMinibatch(std::map<std::wstring, Matrix<ElemTy
     {
         labels->Resize(1, j);
         labels->SetValue((ElemType) 0);
-        labels->SetValue(1, j, labels->GetDeviceId(), m_labelsBuffer, 0);
+        labels->SetValue(1, j, labels->GetDeviceId(), minibatch->labels.data(), 0);
     }
+    m_currOffset = minibatch->endOffset;
+    m_prefetcher.Release(minibatch);
 
     // create the MBLayout
     // Each sample consists of a "sequence" of 'm_microBatchSize' samples.
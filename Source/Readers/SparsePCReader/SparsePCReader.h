@@ -9,6 +9,7 @@
 #include "DataWriter.h"
 #include "Config.h"
 #include "RandomOrdering.h"
+#include "PrefetchQueue.h"
 #include <string>
 #include <map>
 #include <vector>
@@ -30,14 +31,20 @@ private:
     int64_t m_maxReadData; // For early exit during debugging
     bool m_doGradientCheck;
     bool m_returnDense;
-    size_t m_sparsenessFactor;
     int32_t m_verificationCode;
-    std::vector<ElemType*> m_values;
-    std::vector<int32_t*> m_rowIndices;
-    std::vector<int32_t*> m_colIndices;
-    ElemType* m_labelsBuffer;
     MBLayoutPtr m_pMBLayout;
 
+    // the coming minibatches are parsed from the mapping on a thread of their own
+    struct PrefetchedMinibatch
+    {
+        std::vector<SparseCSCBuffer<ElemType>> features; // [i] for m_featureNames[i]
+        std::vector<ElemType> labels;
+        int64_t endOffset; // file position after it
+    };
+    BufferPrefetcher<PrefetchedMinibatch> m_prefetcher;
+    bool ReadMinibatch(PrefetchedMinibatch& minibatch, int64_t& offset) const;
+    void SkipSamples(int64_t& offset, size_t numSamples) const;
+
     HANDLE m_hndl;
     HANDLE m_filemap;
     void* m_dataBuffer;
@@ -63,7 +70,15 @@ public:
     {
         InitFromConfig(config);
     }
-    virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize);
+    virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize)
+    {
+        return StartDistributedMinibatchLoop(mbSize, epoch, 0, 1, requestedEpochSamples);
+    }
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return true;
+    }
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
     virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
 
     size_t GetNumParallelSequences()
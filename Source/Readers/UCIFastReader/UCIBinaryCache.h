@@ -0,0 +1,343 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// UCIBinaryCache.h -- the parsed records of a UCI text file, in a chunked binary file that is read memory-mapped
+//
+#pragma once
+
+#include "Basics.h"
+#include "fileutil.h"
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// UCIBinaryCache -- features [featureDim] and one label value per record, parsed once from a text file
+//
+// The file is named after the text file and a key, a hash of its path, size, modification time and of the parse
+// configuration, so a changed source or configuration gets a cache of its own. It holds a header, the records in
+// chunks of ChunkSizeFor() records (the features of a chunk, then its labels), and the label names of the mapping
+// used for category labels. The writer writes it aside and renames it into place; several processes writing the
+// same cache at once write the same content.
+// Record() maps a sample of the global timeline to a record. With randomization, each sweep over the data visits
+// the chunks in a random order and the records of a chunk in a random order, both determined by the sweep, so
+// reading stays local to a chunk of the mapping and an epoch can be started anywhere.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class UCIBinaryCache
+{
+    struct Header
+    {
+        char magic[8];
+        uint64_t version;
+        uint64_t key;
+        uint64_t elemSize;
+        uint64_t numRecords;
+        uint64_t featureDim;
+        uint64_t hasLabels;
+        uint64_t chunkSize;
+        uint64_t labelNamesOffset;
+        uint64_t labelNamesBytes;
+    };
+    static const uint64_t currentVersion = 1;
+    static const size_t dataOffset = 4096; // the first chunk (page-aligned)
+
+public:
+    // the path of the cache of 'dataPath', in 'cacheDir' or, if empty, next to the data; 'parseConfig' describes all
+    // that goes into the parsed values
+    static std::wstring CachePath(const std::wstring& dataPath, const std::wstring& cacheDir, const std::string& parseConfig, uint64_t& key)
+    {
+        uint64_t modificationTime;
+        if (!GetModificationTime(dataPath, modificationTime))
+            RuntimeError("UCIBinaryCache: cannot determine the modification time of %ls", dataPath.c_str());
+        key = 14695981039346656037ull;
+        key = Hash(key, dataPath.data(), dataPath.size() * sizeof(wchar_t));
+        const uint64_t fileInfo[4] = { (uint64_t) filesize64(dataPath.c_str()), modificationTime, sizeof(ElemType), currentVersion };
+        key = Hash(key, fileInfo, sizeof(fileInfo));
+        key = Hash(key, parseConfig.data(), parseConfig.size());
+
+        const size_t slash = dataPath.find_last_of(L"/\\");
+        const std::wstring fileName = slash == std::wstring::npos ? dataPath : dataPath.substr(slash + 1);
+        const std::wstring dir = !cacheDir.empty() ? cacheDir : slash == std::wstring::npos ? L"." : dataPath.substr(0, slash);
+        return dir + L"/" + fileName + msra::strfun::utf16(msra::strfun::strprintf(".%016llx.ucicache", (unsigned long long) key));
+    }
+
+    // records per chunk, so that a chunk takes about 32 MB
+    static size_t ChunkSizeFor(size_t featureDim)
+    {
+        return std::max((size_t) 1, ((size_t) 32 << 20) / ((featureDim + 1) * sizeof(ElemType)));
+    }
+
+    // -----------------------------------------------------------------------
+    // Writer -- AddRecord() the records in file order, then Finish()
+    // -----------------------------------------------------------------------
+
+    class Writer
+    {
+        std::wstring m_path;
+        std::wstring m_tempPath;
+        FILE* m_file;
+        Header m_header;
+        std::vector<ElemType> m_chunkFeatures;
+        std::vector<ElemType> m_chunkLabels;
+
+        void FlushChunk()
+        {
+            if (m_chunkLabels.empty() && m_chunkFeatures.empty())
+                return;
+            fwriteOrDie(m_chunkFeatures, m_file);
+            if (m_header.hasLabels)
+                fwriteOrDie(m_chunkLabels, m_file);
+            m_chunkFeatures.clear();
+            m_chunkLabels.clear();
+        }
+
+    public:
+        Writer(const std::wstring& path, uint64_t key, size_t featureDim, bool hasLabels)
+            : m_path(path), m_file(nullptr)
+        {
+            memset(&m_header, 0, sizeof(m_header));
+            memcpy(m_header.magic, "UCICACHE", sizeof(m_header.magic));
+            m_header.version = currentVersion;
+            m_header.key = key;
+            m_header.elemSize = sizeof(ElemType);
+            m_header.featureDim = featureDim;
+            m_header.hasLabels = hasLabels;
+            m_header.chunkSize = ChunkSizeFor(featureDim);
+#ifdef _WIN32
+            m_tempPath = m_path + msra::strfun::utf16(msra::strfun::strprintf(".tmp%d", (int) GetCurrentProcessId()));
+#else
+            m_tempPath = m_path + msra::strfun::utf16(msra::strfun::strprintf(".tmp%d", (int) getpid()));
+#endif
+            msra::files::make_intermediate_dirs(m_tempPath);
+            m_file = fopenOrDie(m_tempPath, L"wb");
+            const std::vector<char> headerPage(dataOffset, 0); // (the header is written by Finish())
+            fwriteOrDie(headerPage, m_file);
+            m_chunkFeatures.reserve(m_header.chunkSize * featureDim);
+            m_chunkLabels.reserve(hasLabels ? m_header.chunkSize : 0);
+        }
+
+        ~Writer() // (an unfinished cache is removed)
+        {
+            if (m_file)
+            {
+                fclose(m_file);
+                _wunlink(m_tempPath.c_str());
+            }
+        }
+
+        void AddRecord(const ElemType* features, ElemType label)
+        {
+            m_chunkFeatures.insert(m_chunkFeatures.end(), features, features + m_header.featureDim);
+            if (m_header.hasLabels)
+                m_chunkLabels.push_back(label);
+            if (++m_header.numRecords % m_header.chunkSize == 0)
+                FlushChunk();
+        }
+
+        // write the label names (of category labels by ID) and the header, and put the cache into place
+        void Finish(const std::vector<std::string>& labelNames)
+        {
+            FlushChunk();
+            std::string names;
+            for (const auto& name : labelNames)
+                names += name + "\n";
+            m_header.labelNamesOffset = dataOffset + m_header.numRecords * (m_header.featureDim + (m_header.hasLabels ? 1 : 0)) * sizeof(ElemType);
+            m_header.labelNamesBytes = names.size();
+            if (!names.empty())
+                fwriteOrDie(names.data(), 1, names.size(), m_file);
+            fseekOrDie(m_file, 0);
+            fwriteOrDie(&m_header, sizeof(m_header), 1, m_file);
+            fcloseOrDie(m_file);
+            m_file = nullptr;
+            renameOrDie(m_tempPath, m_path);
+        }
+    };
+
+    // the cache if it exists, else null
+    static std::unique_ptr<UCIBinaryCache> Open(const std::wstring& path, uint64_t key)
+    {
+        if (!fexists(path))
+            return nullptr;
+        return std::unique_ptr<UCIBinaryCache>(new UCIBinaryCache(path, key));
+    }
+
+    ~UCIBinaryCache()
+    {
+        Unmap();
+    }
+
+    size_t NumRecords() const { return m_header.numRecords; }
+    size_t FeatureDim() const { return m_header.featureDim; }
+    bool HasLabels() const { return m_header.hasLabels != 0; }
+    const std::vector<std::string>& LabelNames() const { return m_labelNames; }
+
+    const ElemType* Features(size_t record) const
+    {
+        return ChunkBase(record / m_header.chunkSize) + (record % m_header.chunkSize) * m_header.featureDim;
+    }
+
+    ElemType Label(size_t record) const
+    {
+        const size_t chunk = record / m_header.chunkSize;
+        return ChunkBase(chunk)[ChunkRecords(chunk) * m_header.featureDim + record % m_header.chunkSize];
+    }
+
+    // the record for a sample of the global timeline (not thread-safe)
+    size_t Record(size_t globalSample, bool randomize)
+    {
+        const size_t sweep = globalSample / m_header.numRecords;
+        const size_t sweepSample = globalSample % m_header.numRecords;
+        if (!randomize)
+            return sweepSample;
+
+        if (sweep != m_sweep) // the order of the chunks in this sweep
+        {
+            std::mt19937_64 rng(Hash(14695981039346656037ull, &sweep, sizeof(sweep)));
+            std::iota(m_chunkOrder.begin(), m_chunkOrder.end(), (size_t) 0);
+            std::shuffle(m_chunkOrder.begin(), m_chunkOrder.end(), rng);
+            for (size_t k = 0; k < m_chunkOrder.size(); k++)
+                m_chunkStarts[k + 1] = m_chunkStarts[k] + ChunkRecords(m_chunkOrder[k]);
+            m_sweep = sweep;
+            m_permutedChunk = SIZE_MAX;
+        }
+        const size_t k = std::upper_bound(m_chunkStarts.begin(), m_chunkStarts.end(), sweepSample) - m_chunkStarts.begin() - 1;
+        const size_t chunk = m_chunkOrder[k];
+        if (chunk != m_permutedChunk) // the order of the records of the chunk in this sweep
+        {
+            const uint64_t seed[2] = { sweep, chunk };
+            std::mt19937_64 rng(Hash(14695981039346656037ull, seed, sizeof(seed)));
+            m_recordOrder.resize(ChunkRecords(chunk));
+            std::iota(m_recordOrder.begin(), m_recordOrder.end(), (size_t) 0);
+            std::shuffle(m_recordOrder.begin(), m_recordOrder.end(), rng);
+            m_permutedChunk = chunk;
+        }
+        return chunk * m_header.chunkSize + m_recordOrder[sweepSample - m_chunkStarts[k]];
+    }
+
+private:
+    UCIBinaryCache(const std::wstring& path, uint64_t key)
+        : m_base(nullptr), m_bytes(filesize(path.c_str())), m_sweep(SIZE_MAX), m_permutedChunk(SIZE_MAX)
+    {
+        if (m_bytes < dataOffset)
+            RuntimeError("UCIBinaryCache: %ls is too short to be a cache", path.c_str());
+#ifdef _WIN32
+        m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_file == INVALID_HANDLE_VALUE)
+            RuntimeError("UCIBinaryCache: cannot open %ls", path.c_str());
+        m_mapping = CreateFileMappingW(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping != NULL)
+            m_base = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!m_base)
+        {
+            if (m_mapping != NULL)
+                CloseHandle(m_mapping);
+            CloseHandle(m_file);
+            RuntimeError("UCIBinaryCache: cannot map %ls", path.c_str());
+        }
+#else
+        const int fd = open(msra::strfun::utf8(path).c_str(), O_RDONLY);
+        if (fd < 0)
+            RuntimeError("UCIBinaryCache: cannot open %ls", path.c_str());
+        m_base = mmap(NULL, m_bytes, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd); // (the mapping keeps the file)
+        if (m_base == MAP_FAILED)
+            RuntimeError("UCIBinaryCache: cannot map %ls", path.c_str());
+#endif
+        memcpy(&m_header, m_base, sizeof(m_header));
+        const size_t numChunks = m_header.numRecords == 0 ? 0 : (m_header.numRecords - 1) / std::max((uint64_t) 1, m_header.chunkSize) + 1;
+        const bool valid = memcmp(m_header.magic, "UCICACHE", sizeof(m_header.magic)) == 0 && m_header.version == currentVersion &&
+                           m_header.key == key && m_header.elemSize == sizeof(ElemType) && m_header.numRecords > 0 && m_header.chunkSize > 0 &&
+                           m_header.labelNamesOffset == dataOffset + m_header.numRecords * (m_header.featureDim + (m_header.hasLabels ? 1 : 0)) * sizeof(ElemType) &&
+                           m_header.labelNamesOffset + m_header.labelNamesBytes == m_bytes;
+        if (!valid)
+        {
+            Unmap(); // (the destructor does not run)
+            RuntimeError("UCIBinaryCache: %ls is not a complete cache of this data and configuration", path.c_str());
+        }
+
+        const char* names = (const char*) m_base + m_header.labelNamesOffset;
+        for (size_t begin = 0, end; begin < m_header.labelNamesBytes; begin = end + 1)
+        {
+            end = std::find(names + begin, names + m_header.labelNamesBytes, '\n') - names;
+            m_labelNames.push_back(std::string(names + begin, names + end));
+        }
+        m_chunkOrder.resize(numChunks);
+        m_chunkStarts.assign(numChunks + 1, 0);
+    }
+
+    void Unmap()
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_base);
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+#else
+        munmap(m_base, m_bytes);
+#endif
+    }
+
+    static uint64_t Hash(uint64_t hash, const void* data, size_t numBytes) // FNV-1a
+    {
+        for (size_t i = 0; i < numBytes; i++)
+            hash = (hash ^ ((const unsigned char*) data)[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    static bool GetModificationTime(const std::wstring& path, uint64_t& time)
+    {
+#ifdef _WIN32
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data))
+            return false;
+        time = ((uint64_t) data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+        struct stat buf;
+        if (stat(msra::strfun::utf8(path).c_str(), &buf) != 0)
+            return false;
+        time = (uint64_t) buf.st_mtim.tv_sec * 1000000000 + buf.st_mtim.tv_nsec;
+#endif
+        return true;
+    }
+
+    size_t ChunkRecords(size_t chunk) const
+    {
+        return std::min((size_t) m_header.chunkSize, (size_t) m_header.numRecords - chunk * m_header.chunkSize);
+    }
+
+    const ElemType* ChunkBase(size_t chunk) const
+    {
+        const size_t recordElements = m_header.featureDim + (m_header.hasLabels ? 1 : 0);
+        return (const ElemType*) ((const char*) m_base + dataOffset) + chunk * m_header.chunkSize * recordElements;
+    }
+
+    void* m_base; // mapped view
+    size_t m_bytes;
+#ifdef _WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;
+#endif
+    Header m_header;
+    std::vector<std::string> m_labelNames;
+
+    // randomization of the current sweep
+    size_t m_sweep;
+    std::vector<size_t> m_chunkOrder;  // [k] the k-th chunk of the sweep
+    std::vector<size_t> m_chunkStarts; // [k] its first sample in the sweep
+    size_t m_permutedChunk;            // the chunk m_recordOrder is for
+    std::vector<size_t> m_recordOrder;
+};
+} } }
@@ -139,36 +139,36 @@ bool UCIFastReader<ElemType>::EnsureDataAvailable(size_t mbStartSample, bool end
         // loop through all the newly read records
         for (int numberRead = 0; numberRead < recordsRead; numberRead++)
         {
-            LabelType& label = m_labelData[epochSample + numberRead];
-            // check to see if we have seen this label before
-            auto value = m_mapLabelToId.find(label);
-            LabelIdType labelId;
-            if (value == m_mapLabelToId.end())
-            {
-                if (m_labelFileToWrite.empty())
-                    RuntimeError("label found in data not specified in label mapping file: %s", label.c_str());
-                // new label so add it to the mapping tables
-                m_mapLabelToId[label] = m_labelIdMax;
-                m_mapIdToLabel[m_labelIdMax] = label;
-                labelId = m_labelIdMax++;
-
-                // if our label dimension is lower than the current labelId then increase it
-                if (m_labelDim < m_labelIdMax)
-                    m_labelDim = m_labelIdMax;
-            }
-            else
-            {
-                labelId = value->second;
-            }
-
             // now add the label id to the label data array
-            m_labelIdData.push_back(labelId);
+            m_labelIdData.push_back(LabelIdFor(m_labelData[epochSample + numberRead]));
         }
     }
     // if there more to read (always is, unless we want partial minibatches
     return moreToRead;
 }
 
+// LabelIdFor - the ID of a category label, added to the mapping tables if new (and they are being created)
+template <class ElemType>
+typename UCIFastReader<ElemType>::LabelIdType UCIFastReader<ElemType>::LabelIdFor(const LabelType& label)
+{
+    // check to see if we have seen this label before
+    auto value = m_mapLabelToId.find(label);
+    if (value != m_mapLabelToId.end())
+        return value->second;
+
+    if (m_labelFileToWrite.empty())
+        RuntimeError("label found in data not specified in label mapping file: %s", label.c_str());
+    // new label so add it to the mapping tables
+    m_mapLabelToId[label] = m_labelIdMax;
+    m_mapIdToLabel[m_labelIdMax] = label;
+    LabelIdType labelId = m_labelIdMax++;
+
+    // if our label dimension is lower than the current labelId then increase it
+    if (m_labelDim < m_labelIdMax)
+        m_labelDim = m_labelIdMax;
+    return labelId;
+}
+
 // UpdateDataVariables - Update variables that depend on the dataset being completely read
 template <class ElemType>
 size_t UCIFastReader<ElemType>::UpdateDataVariables(size_t mbStartSample)
@@ -386,6 +386,10 @@ void UCIFastReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfi
     size_t bufSize = max(dimFeatures * 16, (size_t) 256 * 1024);
     m_parser.ParseInit(file.c_str(), startFeatures, dimFeatures, startLabels, dimLabels, bufSize);
 
+    // parse with several threads, e.g. for very wide feature files; each thread takes blocks of many lines
+    size_t numParserThreads = readerConfig(L"numParserThreads", (size_t) 1);
+    m_parser.SetParallelism(numParserThreads, max(bufSize * 4, (size_t) 4 * 1024 * 1024));
+
     // if we have labels, we need a label Mapping file, it will be a file with one label per line
     if (m_labelType != labelNone)
     {
@@ -415,6 +419,14 @@ void UCIFastReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfi
         }
     }
 
+    // parse the text file once into a binary cache that this and later runs read instead, unless a cache is written explicitly
+    if (readerConfig(L"binaryCache", true) && !m_cachingWriter && m_labelType != labelOther)
+    {
+        std::wstring binaryCacheDir = (wstring) readerConfig(L"binaryCacheDir", L"");
+        std::string parseConfig = msra::strfun::strprintf("features=%d:%d labels=%d:%d labelType=%d", (int) startFeatures, (int) dimFeatures, (int) startLabels, (int) dimLabels, (int) m_labelType);
+        InitBinaryCache(file, binaryCacheDir, parseConfig);
+    }
+
     // if we know the size of the randomization now, resize, otherwise wait until we know the epochSize in StartMinibatchLoop()
     if (Randomize() && m_randomizeRange != randomizeAuto)
         m_randomordering.Resize(m_randomizeRange, m_randomizeRange);
@@ -427,6 +439,104 @@ void UCIFastReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfi
     mOneLinePerFile = readerConfig(L"oneLinePerFile", false);
 }
 
+// InitBinaryCache - Open the binary cache of the text file, writing it first if there is none
+// file - the text file, which the parser has been initialized with
+// cacheDir - directory of the cache, empty for next to the text file
+// parseConfig - the parse configuration, part of the cache key
+// Without a usable cache (e.g. a directory that cannot be written), the text file is parsed as usual.
+template <class ElemType>
+void UCIFastReader<ElemType>::InitBinaryCache(const std::wstring& file, const std::wstring& cacheDir, const std::string& parseConfig)
+{
+    try
+    {
+        uint64_t key;
+        const std::wstring path = UCIBinaryCache<ElemType>::CachePath(file, cacheDir, parseConfig, key);
+        m_binaryCache = UCIBinaryCache<ElemType>::Open(path, key);
+
+        // category labels are cached as IDs, which are only valid with the label mapping they were made with
+        if (m_binaryCache && m_labelType == labelCategory && !m_mapIdToLabel.empty())
+        {
+            const auto& labelNames = m_binaryCache->LabelNames();
+            bool sameMapping = labelNames.size() == m_mapIdToLabel.size();
+            for (size_t i = 0; sameMapping && i < labelNames.size(); i++)
+                sameMapping = m_mapIdToLabel[(LabelIdType) i] == labelNames[i];
+            if (!sameMapping)
+            {
+                fprintf(stderr, "UCIFastReader: binary cache %ls was made with a different label mapping, writing it again\n", path.c_str());
+                m_binaryCache.reset();
+            }
+        }
+
+        if (!m_binaryCache)
+        {
+            WriteBinaryCache(path, key);
+            m_binaryCache = UCIBinaryCache<ElemType>::Open(path, key);
+        }
+        else if (m_traceLevel > 0)
+            fprintf(stderr, "UCIFastReader: reading binary cache %ls\n", path.c_str());
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "UCIFastReader: not using a binary cache of %ls: %s\n", file.c_str(), e.what());
+        m_binaryCache.reset();
+        m_parser.SetFilePosition(0);
+        return;
+    }
+
+    // the label mapping to write, if there is no mapping file
+    if (m_labelType == labelCategory && m_mapIdToLabel.empty())
+    {
+        const auto& labelNames = m_binaryCache->LabelNames();
+        for (size_t i = 0; i < labelNames.size(); i++)
+        {
+            m_mapIdToLabel[(LabelIdType) i] = labelNames[i];
+            m_mapLabelToId[labelNames[i]] = (LabelIdType) i;
+        }
+        m_labelIdMax = (LabelIdType) labelNames.size();
+    }
+    m_totalSamples = m_binaryCache->NumRecords();
+}
+
+// WriteBinaryCache - Parse the entire text file into a new binary cache
+template <class ElemType>
+void UCIFastReader<ElemType>::WriteBinaryCache(const std::wstring& path, uint64_t key)
+{
+    if (m_traceLevel > 0)
+        fprintf(stderr, "UCIFastReader: parsing the data into binary cache %ls\n", path.c_str());
+    typename UCIBinaryCache<ElemType>::Writer writer(path, key, m_featureCount, m_labelType != labelNone);
+    const size_t recordsPerParse = 65536;
+    std::vector<ElemType> features;
+    std::vector<LabelType> labels;
+    m_parser.SetFilePosition(0);
+    long numRead;
+    do
+    {
+        features.clear();
+        labels.clear();
+        numRead = m_parser.Parse(recordsPerParse, &features, &labels);
+        if (features.size() != numRead * m_featureCount)
+            LogicError("UCIFastReader: parsed %d feature values for %d records", (int) features.size(), (int) numRead);
+        for (long i = 0; i < numRead; i++)
+        {
+            ElemType label = 0;
+            if (m_labelType == labelCategory)
+                label = (ElemType) LabelIdFor(labels[i]);
+            else if (m_labelType == labelRegression)
+                label = (ElemType) atof(labels[i].c_str());
+            writer.AddRecord(&features[i * m_featureCount], label);
+        }
+    } while (numRead == recordsPerParse);
+    m_parser.SetFilePosition(0);
+
+    std::vector<std::string> labelNames;
+    if (m_labelType == labelCategory)
+    {
+        for (size_t i = 0; i < m_mapIdToLabel.size(); i++)
+            labelNames.push_back(m_mapIdToLabel[(LabelIdType) i]);
+    }
+    writer.Finish(labelNames);
+}
+
 // InitCache - Initialize the caching reader if cache files exist, otherwise the writer
 // readerConfig - reader configuration
 template <class ElemType>
@@ -550,6 +660,13 @@ void UCIFastReader<ElemType>::ReleaseMemory()
 template <class ElemType>
 void UCIFastReader<ElemType>::SetupEpoch()
 {
+    // with the binary cache, any record can be read without positioning the parser
+    if (m_binaryCache)
+    {
+        m_readNextSample = m_epochStartSample = m_mbStartSample = m_epoch * m_epochSize;
+        return;
+    }
+
     // if we are starting fresh (epoch zero and no data read), init everything
     // however if we are using cachingWriter, we need to know record count, so do that first
     if (m_epoch == 0 && m_totalSamples == 0 && m_cachingWriter != NULL)
@@ -699,6 +816,10 @@ void UCIFastReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_
             fprintf(stderr, "epochSize rounded up to %d to fit an integral number of minibatches\n", (int) m_epochSize);
     }
 
+    // with the binary cache, the size of the dataset is known without reading it
+    if (m_binaryCache && !m_endReached)
+        UpdateDataVariables(m_epochStartSample);
+
     // set the randomization range for randomizationAuto
     // or if it's invalid less than the minibatch size, we need to make it at least minibatch size
     if (m_randomizeRange != randomizeNone)
@@ -731,6 +852,26 @@ void UCIFastReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_
     SetupEpoch();
 }
 
+// SkipMinibatches - continue the epoch after its first numMinibatches minibatches
+// Only with the binary cache, which maps a position in the epoch to its record, randomized or not, without reading the
+// ones before; the parser would have to parse up to there anyway. The minibatch sizes are those of GetMinibatchImpl().
+template <class ElemType>
+bool UCIFastReader<ElemType>::SkipMinibatches(size_t numMinibatches)
+{
+    if (m_cachingReader || !m_binaryCache || m_pendingAsyncGetMinibatch.valid() || m_epochSize == requestDataSize || m_totalSamples == 0)
+        return false;
+    for (size_t k = 0; k < numMinibatches && m_mbStartSample / m_epochSize == m_epoch; k++)
+    {
+        size_t actualmbsize = min(min(m_totalSamples, m_mbSize), m_epochSize - m_mbStartSample % m_epochSize);
+        if (m_partialMinibatch) // (ends at the end of the dataset)
+            actualmbsize = min(actualmbsize, m_totalSamples - m_mbStartSample % m_totalSamples);
+        if (actualmbsize == 0)
+            break;
+        m_mbStartSample += actualmbsize;
+    }
+    return true;
+}
+
 // function to store the LabelType in an ElemType
 // required for string labels, which can't be stored in ElemType arrays
 template <class ElemType>
@@ -831,7 +972,8 @@ bool UCIFastReader<ElemType>::GetMinibatchImpl(std::map<std::wstring, Matrix<Ele
         return false;
 
     bool randomize = Randomize();
-    bool moreData = EnsureDataAvailable(m_mbStartSample);
+    // (with the binary cache, partial minibatches end at the end of the dataset, as with the parser)
+    bool moreData = m_binaryCache ? !m_partialMinibatch : EnsureDataAvailable(m_mbStartSample);
 
     // figure which sweep of the randomization we are on
     size_t epochSample = m_mbStartSample % m_epochSize; // where the minibatch starts in this epoch
@@ -891,7 +1033,26 @@ bool UCIFastReader<ElemType>::GetMinibatchImpl(std::map<std::wstring, Matrix<Ele
         memset(m_labelsBuffer.get(), 0, sizeof(ElemType) * 1 * actualmbsize);
     }
 
-    if (actualmbsize > 0)
+    if (actualmbsize > 0 && m_binaryCache)
+    {
+        // copy the records of the sweep's chunk order from the mapped cache
+        for (size_t j = 0; j < actualmbsize; ++j)
+        {
+            size_t record = m_binaryCache->Record(m_mbStartSample + j, randomize);
+            memcpy(&m_featuresBuffer.get()[j * m_featureCount], m_binaryCache->Features(record), sizeof(ElemType) * m_featureCount);
+            if (m_labelType == labelCategory)
+            {
+                LabelIdType labelId = (LabelIdType) m_binaryCache->Label(record);
+                m_labelsBuffer.get()[j * m_labelDim + labelId] = (ElemType) 1;
+                m_labelsIdBuffer.get()[j] = labelId;
+            }
+            else if (m_labelType != labelNone)
+            {
+                m_labelsBuffer.get()[j] = m_binaryCache->Label(record);
+            }
+        }
+    }
+    else if (actualmbsize > 0)
     {
         // loop through and copy data to matrix
         int j = 0; // vector of vectors of feature data
@@ -1075,7 +1236,10 @@ bool UCIFastReader<ElemType>::DataEnd(EndDataType endDataType)
         ret = (m_mbStartSample / m_epochSize != m_epoch);
         break;
     case endDataSet:
-        ret = EnsureDataAvailable(m_mbStartSample, true);
+        if (m_binaryCache)
+            ret = m_mbStartSample == m_epochStartSample || m_mbStartSample % m_totalSamples != 0;
+        else
+            ret = EnsureDataAvailable(m_mbStartSample, true);
         break;
     case endDataSentence: // for fast reader each minibatch is considered a "sentence", so always true
         ret = true;
@@ -11,6 +11,7 @@
 #include "Config.h"
 #include "RandomOrdering.h"
 #include <future>
+#include "UCIBinaryCache.h"
 #include "UCIParser.h"
 #include <string>
 #include <map>
@@ -108,6 +109,11 @@ private:
     void InitCache(const ConfigParameters& config);
     void InitCache(const ScriptableObjects::IConfigRecord& config);
 
+    // automatic binary cache of the parsed text file, which replaces the parser if present
+    std::unique_ptr<UCIBinaryCache<ElemType>> m_binaryCache;
+    void InitBinaryCache(const std::wstring& file, const std::wstring& cacheDir, const std::string& parseConfig);
+    void WriteBinaryCache(const std::wstring& path, uint64_t key);
+
     size_t RandomizeSweep(size_t epochSample);
     bool Randomize()
     {
@@ -119,6 +125,7 @@ private:
     size_t RecordsToRead(size_t mbStartSample, bool tail = false);
     void ReleaseMemory();
     void WriteLabelFile();
+    LabelIdType LabelIdFor(const LabelType& label);
 
     virtual bool EnsureDataAvailable(size_t mbStartSample, bool endOfDataCheck = false);
     virtual bool ReadRecord(size_t readSample);
@@ -156,6 +163,7 @@ public:
     }
 
     virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
+    virtual bool SkipMinibatches(size_t numMinibatches) override;
 
     virtual bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& matrices);
 
@@ -235,6 +235,11 @@ void UCIParser<NumType, LabelType>::Init()
     PrepareStartPosition(0);
     m_fileBuffer = NULL;
     m_pFile = NULL;
+    m_parseEnd = 0;
+    m_blockRecord = 0;
+    m_blockSize = 0;
+    m_nextBlockStart = 0;
+    m_nextWorker = 0;
     m_stateTable = new DWORD[AllStateMax * 256];
     SetupStateTables();
 }
@@ -243,10 +248,21 @@ void UCIParser<NumType, LabelType>::Init()
 template <typename NumType, typename LabelType>
 UCIParser<NumType, LabelType>::~UCIParser()
 {
+    Close();
     delete m_stateTable;
+}
+
+// Close - close the file and stop parallel parsing
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::Close()
+{
+    StopBlocks();
+    m_workers.clear();
     delete m_fileBuffer;
+    m_fileBuffer = NULL;
     if (m_pFile)
         fclose(m_pFile);
+    m_pFile = NULL;
 }
 
 // DoneWithLabel - Called when a string label is found
@@ -360,8 +376,8 @@ void UCIParser<NumType, LabelType>::ParseInit(LPCWSTR fileName, size_t startFeat
     m_bufferStart = startPosition;
 
     // if we have a file already open, cleanup
-    if (m_pFile != NULL)
-        UCIParser<NumType, LabelType>::~UCIParser();
+    Close();
+    m_fileName = fileName;
 
     errno_t err = _wfopen_s(&m_pFile, fileName, L"rb");
     if (err)
@@ -375,6 +391,27 @@ void UCIParser<NumType, LabelType>::ParseInit(LPCWSTR fileName, size_t startFeat
     SetFilePosition(startPosition);
 }
 
+// SetParallelism - parse with multiple threads, call after ParseInit() and before parsing
+// numThreads - number of worker parsers; up to this many blocks are parsed ahead of Parse(). 1 means sequential parsing.
+// blockSize - approximate number of bytes each worker parses at a time
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::SetParallelism(size_t numThreads, size_t blockSize)
+{
+    StopBlocks();
+    m_workers.clear();
+    m_blockSize = std::max(blockSize, (size_t) 1);
+    if (numThreads <= 1)
+        return;
+
+    int64_t position = m_byteCounter;
+    for (size_t i = 0; i < numThreads; i++)
+    {
+        m_workers.push_back(std::unique_ptr<UCIParser>(new UCIParser()));
+        m_workers.back()->ParseInit(m_fileName.c_str(), m_startFeatures, m_dimFeatures, m_startLabels, m_dimLabels, m_bufferSize);
+    }
+    SetFilePosition(position);
+}
+
 // GetFilePosition - Get the current file position in the text file
 // returns current position in the file
 template <typename NumType, typename LabelType>
@@ -393,12 +430,22 @@ int64_t UCIParser<NumType, LabelType>::GetFilePosition()
 template <typename NumType, typename LabelType>
 void UCIParser<NumType, LabelType>::SetFilePosition(int64_t position)
 {
+    // restart the workers from this position
+    if (!m_workers.empty())
+    {
+        StopBlocks();
+        m_nextBlockStart = position;
+        LaunchBlocks();
+        return;
+    }
+
     int rc = _fseeki64(m_pFile, position, SEEK_SET);
     if (rc)
         RuntimeError("UCIParser::SetFilePosition - error seeking in file");
 
     // setup state machine to start at this position
     PrepareStartPosition(position);
+    m_parseEnd = m_fileSize;
 
     // read in the first buffer of data from this position,  first buffer is expected to be read after a reposition
     UpdateBuffer();
@@ -411,6 +458,10 @@ void UCIParser<NumType, LabelType>::SetFilePosition(int64_t position)
 template <typename NumType, typename LabelType>
 bool UCIParser<NumType, LabelType>::HasMoreData()
 {
+    // (with parallel parsing, a trailing block may turn out to have only whitespace)
+    if (!m_workers.empty())
+        return m_blockRecord < m_block.numberEnds.size() || !m_pendingBlocks.empty();
+
     long long byteCounter = m_byteCounter;
     size_t bufferIndex = m_byteCounter - m_bufferStart;
 
@@ -490,6 +541,9 @@ long UCIParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<N
     assert(numbers != NULL || m_dimFeatures == 0 || m_parseMode == ParseLineCount);
     assert(labels != NULL || m_dimLabels == 0 || m_parseMode == ParseLineCount);
 
+    if (!m_workers.empty())
+        return ParseParallel(recordsRequested, numbers, labels);
+
     // transfer to member variables
     m_numbers = numbers;
     m_labels = labels;
@@ -497,7 +551,7 @@ long UCIParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<N
     long TickStart = GetTickCount();
     long recordCount = 0;
     size_t bufferIndex = m_byteCounter - m_bufferStart;
-    while (m_byteCounter < m_fileSize && recordCount < recordsRequested)
+    while (m_byteCounter < m_parseEnd && recordCount < recordsRequested)
     {
         // check to see if we need to update the buffer
         if (bufferIndex >= m_bufferSize)
@@ -655,6 +709,107 @@ long UCIParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<N
     return recordCount;
 }
 
+// ParseBlock - parse the records of [start, end) on a worker, which must both be line starts (or the file end)
+template <typename NumType, typename LabelType>
+typename UCIParser<NumType, LabelType>::ParsedBlock UCIParser<NumType, LabelType>::ParseBlock(int64_t start, int64_t end)
+{
+    ParsedBlock block;
+    SetFilePosition(start);
+    m_parseEnd = end;
+    while (Parse(1, &block.numbers, &block.labels) == 1)
+    {
+        block.numberEnds.push_back(block.numbers.size());
+        block.labelEnds.push_back(block.labels.size());
+    }
+    return block;
+}
+
+// NextLineStart - the first line start at or after position
+template <typename NumType, typename LabelType>
+int64_t UCIParser<NumType, LabelType>::NextLineStart(int64_t position)
+{
+    if (position <= 0 || position >= m_fileSize)
+        return min(std::max(position, (int64_t) 0), m_fileSize);
+    // position is a line start if the character before it is a line end
+    position--;
+    int rc = _fseeki64(m_pFile, position, SEEK_SET);
+    if (rc)
+        RuntimeError("UCIParser::NextLineStart - error seeking in file");
+    char buffer[4096];
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer, 1, sizeof(buffer), m_pFile)) > 0)
+    {
+        const char* lineEnd = (const char*) memchr(buffer, '\n', bytesRead);
+        if (lineEnd != NULL)
+            return position + (lineEnd - buffer) + 1;
+        position += bytesRead;
+    }
+    if (ferror(m_pFile))
+        RuntimeError("UCIParser::NextLineStart - error reading file");
+    return m_fileSize;
+}
+
+// LaunchBlocks - start parsing the next blocks, until every worker is busy
+// Block i goes to worker i % #workers, which is free since block i - #workers has been consumed.
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::LaunchBlocks()
+{
+    while (m_pendingBlocks.size() < m_workers.size() && m_nextBlockStart < m_fileSize)
+    {
+        const int64_t start = m_nextBlockStart;
+        const int64_t end = NextLineStart(start + m_blockSize);
+        UCIParser* worker = m_workers[m_nextWorker++ % m_workers.size()].get();
+        m_pendingBlocks.push_back(std::async(std::launch::async, [worker, start, end]()
+                                             {
+                                                 return worker->ParseBlock(start, end);
+                                             }));
+        m_nextBlockStart = end;
+    }
+}
+
+// StopBlocks - wait for the blocks in flight and discard them
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::StopBlocks()
+{
+    for (auto& pendingBlock : m_pendingBlocks)
+        pendingBlock.wait();
+    m_pendingBlocks.clear();
+    m_block = ParsedBlock();
+    m_blockRecord = 0;
+    m_nextWorker = 0;
+}
+
+// ParseParallel - Parse() from the blocks parsed by the workers
+template <typename NumType, typename LabelType>
+long UCIParser<NumType, LabelType>::ParseParallel(size_t recordsRequested, std::vector<NumType> *numbers, std::vector<LabelType> *labels)
+{
+    long recordCount = 0;
+    while (recordCount < recordsRequested)
+    {
+        // move on to the next block, and keep the workers busy
+        if (m_blockRecord >= m_block.numberEnds.size())
+        {
+            if (m_pendingBlocks.empty())
+                break;
+            m_block = m_pendingBlocks.front().get();
+            m_pendingBlocks.pop_front();
+            m_blockRecord = 0;
+            LaunchBlocks();
+            continue;
+        }
+
+        const size_t begin = m_blockRecord;
+        const size_t end = begin + min(recordsRequested - recordCount, m_block.numberEnds.size() - begin);
+        if (numbers != NULL)
+            numbers->insert(numbers->end(), m_block.numbers.begin() + (begin > 0 ? m_block.numberEnds[begin - 1] : 0), m_block.numbers.begin() + m_block.numberEnds[end - 1]);
+        if (labels != NULL)
+            labels->insert(labels->end(), m_block.labels.begin() + (begin > 0 ? m_block.labelEnds[begin - 1] : 0), m_block.labels.begin() + m_block.labelEnds[end - 1]);
+        recordCount += (long) (end - begin);
+        m_blockRecord = end;
+    }
+    return recordCount;
+}
+
 // StoreLabel - string version gets last space delimited string and stores in labels vector
 template <>
 void UCIParser<float, std::string>::StoreLabel(float /*finalResult*/)
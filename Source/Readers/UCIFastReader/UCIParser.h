@@ -11,6 +11,9 @@
 #include <assert.h>
 #include <stdint.h>
 #include <algorithm>
+#include <deque>
+#include <future>
+#include <memory>
 
 #ifdef min
 #undef min
@@ -109,6 +112,28 @@ private:
     std::vector<LabelType> *m_labels; // pointer to vector to append with labels (may be numeric)
     // FUTURE: do we want a vector to collect string labels in the non string label case? (signifies an error)
 
+    // parsing stops at this file position (the file size, or the end of a block)
+    int64_t m_parseEnd;
+
+    // parallel parsing (see SetParallelism())
+    // The file is cut into blocks at line ends, which worker parsers parse ahead into their own buffers.
+    // Parse() consumes the blocks in file order; this restores the order of the records.
+    struct ParsedBlock
+    {
+        std::vector<NumType> numbers;
+        std::vector<LabelType> labels;
+        std::vector<size_t> numberEnds; // [record] end of its numbers in 'numbers'
+        std::vector<size_t> labelEnds;  // [record] end of its labels in 'labels'
+    };
+    std::wstring m_fileName;
+    std::vector<std::unique_ptr<UCIParser>> m_workers;    // each with its own file handle
+    std::deque<std::future<ParsedBlock>> m_pendingBlocks; // in file order; at most one per worker
+    ParsedBlock m_block;                                  // the block being consumed
+    size_t m_blockRecord;                                 // next record in m_block
+    size_t m_blockSize;                                   // approximate block size in bytes
+    int64_t m_nextBlockStart;                             // file position of the next block to launch
+    size_t m_nextWorker;
+
     // SetState for a particular value
     void SetState(int value, ParseState m_current_state, ParseState next_state);
 
@@ -132,6 +157,16 @@ private:
     // returns - number of records read
     size_t UpdateBuffer();
 
+    // Close - close the file and stop parallel parsing
+    void Close();
+
+    // parallel parsing helpers
+    ParsedBlock ParseBlock(int64_t start, int64_t end);
+    int64_t NextLineStart(int64_t position);
+    void LaunchBlocks();
+    void StopBlocks();
+    long ParseParallel(size_t recordsRequested, std::vector<NumType> *numbers, std::vector<LabelType> *labels);
+
 public:
     // UCIParser constructor
     UCIParser();
@@ -174,6 +209,11 @@ public:
     // startPosition - file position on which we should start
     void ParseInit(LPCWSTR fileName, size_t startFeatures, size_t dimFeatures, size_t startLabels, size_t dimLabels, size_t bufferSize = 1024 * 256, size_t startPosition = 0);
 
+    // SetParallelism - parse with multiple threads, call after ParseInit() and before parsing
+    // numThreads - number of worker parsers; up to this many blocks are parsed ahead of Parse(). 1 means sequential parsing.
+    // blockSize - approximate number of bytes each worker parses at a time
+    void SetParallelism(size_t numThreads, size_t blockSize);
+
     // Parse - Parse the data
     // recordsRequested - number of records requested
     // numbers - pointer to vector to return the numbers (must be allocated)
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Basics.h"
+#include "fileutil.h"
+#include <future>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// AsyncCheckpointWriter -- publishes model and checkpoint files in the background
+//
+// Writing a multi-GB model to network storage can take minutes, during which all ranks would wait.
+// Instead, the files are saved into a staging directory on local storage first, which is fast (mostly the page cache)
+// and gives a consistent snapshot, and are then copied to their targets by a background thread while training continues.
+// Each target is written as target.tmp and then renamed, so that a reader never sees a partial file.
+// -----------------------------------------------------------------------
+
+class AsyncCheckpointWriter
+{
+public:
+    // stagingDir should be on local storage; empty means the temp directory
+    AsyncCheckpointWriter(const std::wstring& stagingDir)
+        : m_stagingDir(stagingDir.empty() ? DefaultStagingDir() : stagingDir)
+    {
+        msra::files::make_intermediate_dirs(StagingPath(L"dummy"));
+    }
+
+    ~AsyncCheckpointWriter()
+    {
+        // (a failure here can no longer be reported)
+        if (m_pending.valid())
+            m_pending.wait();
+    }
+
+    // where to save a file that is to be published as targetPath
+    std::wstring StagingPath(const std::wstring& targetPath) const
+    {
+        const size_t pos = targetPath.find_last_of(L"/\\");
+        const std::wstring name = pos == std::wstring::npos ? targetPath : targetPath.substr(pos + 1);
+        return m_stagingDir + L"/" + name + L"." + std::to_wstring(GetCurrentProcessId()) + L".staged";
+    }
+
+    // copy the staged files of targetPaths to their targets in the background, in this order, then delete obsoleteFiles
+    // Waits for the previous publication first.
+    void PublishAsync(const std::vector<std::wstring>& targetPaths, const std::vector<std::wstring>& obsoleteFiles)
+    {
+        Wait();
+        m_pending = std::async(std::launch::async, [this, targetPaths, obsoleteFiles]
+                               {
+                                   for (const auto& targetPath : targetPaths)
+                                   {
+                                       const std::wstring stagingPath = StagingPath(targetPath);
+                                       const std::wstring tmpPath = targetPath + L".tmp";
+                                       CopyToFile(stagingPath, tmpPath);
+                                       renameOrDie(tmpPath, targetPath);
+                                       _wunlink(stagingPath.c_str());
+                                   }
+                                   for (const auto& file : obsoleteFiles)
+                                       _wunlink(file.c_str());
+                               });
+    }
+
+    // wait until the last publication has completed; rethrows its error
+    void Wait()
+    {
+        if (m_pending.valid())
+            m_pending.get();
+    }
+
+private:
+    static std::wstring DefaultStagingDir()
+    {
+        for (const char* var : {"TMPDIR", "TEMP", "TMP"})
+        {
+            const char* dir = getenv(var);
+            if (dir != nullptr && *dir != 0)
+                return msra::strfun::utf16(dir);
+        }
+        return L"/tmp";
+    }
+
+    static void CopyToFile(const std::wstring& from, const std::wstring& to)
+    {
+        std::vector<char> buffer(16 * 1024 * 1024);
+        FILE* in = fopenOrDie(from, L"rb");
+        FILE* out = fopenOrDie(to, L"wb");
+        size_t n;
+        while ((n = fread(buffer.data(), 1, buffer.size(), in)) > 0)
+            fwriteOrDie(buffer.data(), 1, n, out);
+        if (ferror(in))
+            RuntimeError("AsyncCheckpointWriter: error reading '%ls'.", from.c_str());
+        fclose(in);
+        fflushOrDie(out);
+        fcloseOrDie(out);
+    }
+
+    std::wstring m_stagingDir;
+    std::future<void> m_pending;
+};
+} } }
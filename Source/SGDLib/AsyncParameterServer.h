@@ -0,0 +1,214 @@
+#pragma once
+
+#include "MPIWrapper.h"
+#include "Matrix.h"
+#include <vector>
+#include <climits>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// AsyncParameterServer -- asynchronous data-parallel training with bounded staleness
+//
+// Every learnable parameter is split into one shard per server rank (the first numServers ranks, which also train).
+// The shards live in an MPI window. Every syncFrequencyInMBs minibatches a worker pushes the change of its local model
+// since its last pull into the shards (MPI_Accumulate with MPI_SUM) and pulls the current global model back.
+// This uses passive-target one-sided communication, so neither the servers nor other workers take part in a worker's
+// sync, and every worker proceeds at its own pace.
+// Staleness is bounded by a clock per worker (its number of pushes) kept in a second window on rank 0: a worker does
+// not push while more than maxStaleness pushes ahead of the slowest worker that is still training.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class AsyncParameterServer
+{
+public:
+    AsyncParameterServer(MPIWrapper* mpi, size_t numServers, size_t syncFrequencyInMBs, size_t maxStaleness)
+        : m_mpi(mpi), m_numServers(numServers == 0 ? mpi->NumNodesInUse() : numServers), m_syncFrequencyInMBs(syncFrequencyInMBs), m_maxStaleness(maxStaleness),
+          m_modelWindow(MPI_WIN_NULL), m_clockWindow(MPI_WIN_NULL), m_myClock(0), m_numMBsSinceSync(0)
+    {
+        if (m_numServers > m_mpi->NumNodesInUse())
+            InvalidArgument("AsyncParameterServer: numServers (%d) exceeds the number of MPI ranks (%d).", (int) m_numServers, (int) m_mpi->NumNodesInUse());
+        if (m_syncFrequencyInMBs == 0)
+            InvalidArgument("AsyncParameterServer: syncFrequencyInMBs must be greater than 0.");
+    }
+
+    ~AsyncParameterServer()
+    {
+        if (m_modelWindow != MPI_WIN_NULL)
+        {
+            MPI_Win_unlock_all(m_modelWindow);
+            MPI_Win_free(&m_modelWindow);
+            MPI_Win_unlock_all(m_clockWindow);
+            MPI_Win_free(&m_clockWindow);
+        }
+    }
+
+    // collective; sets up the shards from the server ranks' current models, and makes every worker start from that
+    void Initialize(const std::vector<Matrix<ElemType>*>& parameters)
+    {
+        if (m_modelWindow != MPI_WIN_NULL)
+            return;
+
+        // shard s of parameter p covers elements [n * s / numServers, n * (s+1) / numServers) and is stored on rank s
+        std::vector<size_t> windowSizes(m_numServers, 0);
+        m_shardOffsets.resize(parameters.size());
+        for (size_t p = 0; p < parameters.size(); p++)
+        {
+            for (size_t s = 0; s < m_numServers; s++)
+            {
+                m_shardOffsets[p].push_back(windowSizes[s]);
+                windowSizes[s] += ShardEnd(parameters[p], s) - ShardBegin(parameters[p], s);
+            }
+        }
+
+        const size_t myRank = m_mpi->CurrentNodeRank();
+        const size_t myWindowSize = myRank < m_numServers ? windowSizes[myRank] : 0;
+        ElemType* shards;
+        MPI_Win_allocate(myWindowSize * sizeof(ElemType), sizeof(ElemType), MPI_INFO_NULL, m_mpi->Communicator(), &shards, &m_modelWindow) || MpiFail("MPI_Win_allocate");
+        int* clocks;
+        MPI_Win_allocate(m_mpi->IsMainNode() ? m_mpi->NumNodesInUse() * sizeof(int) : 0, sizeof(int), MPI_INFO_NULL, m_mpi->Communicator(), &clocks, &m_clockWindow) || MpiFail("MPI_Win_allocate");
+        MPI_Win_lock_all(0, m_modelWindow) || MpiFail("MPI_Win_lock_all");
+        MPI_Win_lock_all(0, m_clockWindow) || MpiFail("MPI_Win_lock_all");
+
+        if (myRank < m_numServers)
+        {
+            for (size_t p = 0; p < parameters.size(); p++)
+            {
+                CopyToCPU(*parameters[p]);
+                std::copy(m_localModel.begin() + ShardBegin(parameters[p], myRank), m_localModel.begin() + ShardEnd(parameters[p], myRank), shards + m_shardOffsets[p][myRank]);
+            }
+            MPI_Win_sync(m_modelWindow) || MpiFail("MPI_Win_sync");
+        }
+        if (m_mpi->IsMainNode())
+        {
+            std::fill(clocks, clocks + m_mpi->NumNodesInUse(), 0);
+            MPI_Win_sync(m_clockWindow) || MpiFail("MPI_Win_sync");
+        }
+        m_mpi->WaitAll();
+
+        m_lastPulledModel.resize(parameters.size());
+        Pull(parameters);
+    }
+
+    // call after every local model update; pushes and pulls once every syncFrequencyInMBs calls
+    // Returns true if it synced.
+    bool OnMinibatchUpdated(const std::vector<Matrix<ElemType>*>& parameters)
+    {
+        if (++m_numMBsSinceSync < m_syncFrequencyInMBs)
+            return false;
+        m_numMBsSinceSync = 0;
+
+        WaitForSlowestWorker();
+        Push(parameters);
+        Pull(parameters);
+        return true;
+    }
+
+    // collective; pushes the remaining local changes and leaves every worker with the same final model
+    void Synchronize(const std::vector<Matrix<ElemType>*>& parameters)
+    {
+        Push(parameters);
+        // a finished worker must not hold up the ones that are still training
+        SetClock(INT_MAX);
+        m_mpi->WaitAll();
+        Pull(parameters);
+
+        m_myClock = 0;
+        m_numMBsSinceSync = 0;
+        SetClock(0);
+        m_mpi->WaitAll();
+    }
+
+private:
+    size_t ShardBegin(const Matrix<ElemType>* parameter, size_t server) const
+    {
+        return parameter->GetNumElements() * server / m_numServers;
+    }
+    size_t ShardEnd(const Matrix<ElemType>* parameter, size_t server) const
+    {
+        return parameter->GetNumElements() * (server + 1) / m_numServers;
+    }
+
+    // into m_localModel
+    void CopyToCPU(const Matrix<ElemType>& parameter)
+    {
+        m_localModel.resize(parameter.GetNumElements());
+        parameter.CopySection(parameter.GetNumRows(), parameter.GetNumCols(), m_localModel.data(), parameter.GetNumRows());
+    }
+
+    void Push(const std::vector<Matrix<ElemType>*>& parameters)
+    {
+        for (size_t p = 0; p < parameters.size(); p++)
+        {
+            CopyToCPU(*parameters[p]);
+            auto& lastPulled = m_lastPulledModel[p];
+            for (size_t i = 0; i < m_localModel.size(); i++)
+                m_localModel[i] -= lastPulled[i];
+            for (size_t s = 0; s < m_numServers; s++)
+            {
+                const size_t begin = ShardBegin(parameters[p], s);
+                MPI_Accumulate(m_localModel.data() + begin, (int) (ShardEnd(parameters[p], s) - begin), MPIWrapper::GetDataType(m_localModel.data()),
+                               (int) s, (MPI_Aint) m_shardOffsets[p][s], (int) (ShardEnd(parameters[p], s) - begin), MPIWrapper::GetDataType(m_localModel.data()), MPI_SUM, m_modelWindow) || MpiFail("MPI_Accumulate");
+            }
+            // (the origin buffer is reused for the next parameter)
+            MPI_Win_flush_all(m_modelWindow) || MpiFail("MPI_Win_flush_all");
+        }
+        SetClock(++m_myClock);
+    }
+
+    // MPI_Get_accumulate() with MPI_NO_OP, as a plain MPI_Get() would race with other workers' MPI_Accumulate()
+    void Pull(const std::vector<Matrix<ElemType>*>& parameters)
+    {
+        for (size_t p = 0; p < parameters.size(); p++)
+        {
+            auto& lastPulled = m_lastPulledModel[p];
+            lastPulled.resize(parameters[p]->GetNumElements());
+            for (size_t s = 0; s < m_numServers; s++)
+            {
+                const size_t begin = ShardBegin(parameters[p], s);
+                MPI_Get_accumulate(nullptr, 0, MPIWrapper::GetDataType(lastPulled.data()), lastPulled.data() + begin, (int) (ShardEnd(parameters[p], s) - begin), MPIWrapper::GetDataType(lastPulled.data()),
+                                   (int) s, (MPI_Aint) m_shardOffsets[p][s], (int) (ShardEnd(parameters[p], s) - begin), MPIWrapper::GetDataType(lastPulled.data()), MPI_NO_OP, m_modelWindow) || MpiFail("MPI_Get_accumulate");
+            }
+        }
+        MPI_Win_flush_all(m_modelWindow) || MpiFail("MPI_Win_flush_all");
+        for (size_t p = 0; p < parameters.size(); p++)
+            parameters[p]->SetValue(parameters[p]->GetNumRows(), parameters[p]->GetNumCols(), parameters[p]->GetDeviceId(), m_lastPulledModel[p].data());
+    }
+
+    void SetClock(int clock)
+    {
+        MPI_Accumulate(&clock, 1, MPI_INT, m_mpi->MainNodeRank(), (MPI_Aint) m_mpi->CurrentNodeRank(), 1, MPI_INT, MPI_REPLACE, m_clockWindow) || MpiFail("MPI_Accumulate");
+        MPI_Win_flush(m_mpi->MainNodeRank(), m_clockWindow) || MpiFail("MPI_Win_flush");
+    }
+
+    void WaitForSlowestWorker()
+    {
+        std::vector<int> clocks(m_mpi->NumNodesInUse());
+        for (;;)
+        {
+            MPI_Get_accumulate(nullptr, 0, MPI_INT, clocks.data(), (int) clocks.size(), MPI_INT, m_mpi->MainNodeRank(), 0, (int) clocks.size(), MPI_INT, MPI_NO_OP, m_clockWindow) || MpiFail("MPI_Get_accumulate");
+            MPI_Win_flush(m_mpi->MainNodeRank(), m_clockWindow) || MpiFail("MPI_Win_flush");
+            const int slowest = *std::min_element(clocks.begin(), clocks.end());
+            if (m_myClock <= slowest + (int) m_maxStaleness)
+                return;
+            ::Sleep(1);
+        }
+    }
+
+private:
+    MPIWrapper* m_mpi;
+    size_t m_numServers;
+    size_t m_syncFrequencyInMBs;
+    size_t m_maxStaleness; // in pushes
+
+    MPI_Win m_modelWindow; // the shards stored on this rank
+    MPI_Win m_clockWindow; // [rank] number of pushes of that worker, INT_MAX once finished; on rank 0 only
+    std::vector<std::vector<size_t>> m_shardOffsets; // [parameter][server] offset of the shard in that server's window
+
+    std::vector<std::vector<ElemType>> m_lastPulledModel; // [parameter] the global model as of our last pull
+    std::vector<ElemType> m_localModel;                   // CPU copy of one parameter; its change since the last pull when pushing
+    int m_myClock;
+    size_t m_numMBsSinceSync;
+};
+} } }
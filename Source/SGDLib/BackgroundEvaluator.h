@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "DataReader.h"
+#include "SimpleEvaluator.h"
+#include <future>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// BackgroundEvaluator -- cross-validation of a model snapshot while training continues
+//
+// The snapshot is saved to a file (on local storage) and loaded by a background thread onto its own device, where it
+// is evaluated; meanwhile the caller trains the next epoch. The evaluation should run on a different device than
+// training (or on the CPU): on the same GPU it works, but competes with training for the device.
+// The reader must not be used by anyone else until the evaluation is done.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class BackgroundEvaluator
+{
+public:
+    BackgroundEvaluator(DEVICEID_TYPE deviceId, const std::wstring& snapshotPath)
+        : m_deviceId(deviceId), m_snapshotPath(snapshotPath), m_epoch(-1)
+    {
+        msra::files::make_intermediate_dirs(m_snapshotPath);
+    }
+
+    ~BackgroundEvaluator()
+    {
+        // (a failure here can no longer be reported)
+        if (m_pending.valid())
+            m_pending.wait();
+    }
+
+    // evaluate the current state of 'net' as that of 'epoch' in the background
+    // Waits for the previous evaluation first, whose results must have been picked up with Wait().
+    void StartAsync(const ComputationNetworkPtr& net, int epoch, IDataReader<ElemType>* reader, const std::vector<std::wstring>& evalNodeNames, size_t mbSize)
+    {
+        if (m_pending.valid())
+            LogicError("BackgroundEvaluator: The results of the previous evaluation have not been picked up.");
+        net->Save(m_snapshotPath);
+        m_epoch = epoch;
+        const DEVICEID_TYPE deviceId = m_deviceId;
+        const std::wstring snapshotPath = m_snapshotPath;
+        m_pending = std::async(std::launch::async, [deviceId, snapshotPath, reader, evalNodeNames, mbSize]
+                               {
+                                   auto snapshot = ComputationNetwork::CreateFromFile<ElemType>(deviceId, snapshotPath);
+                                   SimpleEvaluator<ElemType> evaluator(snapshot);
+                                   return evaluator.Evaluate(reader, evalNodeNames, mbSize);
+                               });
+    }
+
+    bool IsPending() const
+    {
+        return m_pending.valid();
+    }
+
+    // wait for the running evaluation and return the epoch it was started for (-1 if none); rethrows its error
+    int Wait(std::vector<double>& results)
+    {
+        if (!m_pending.valid())
+            return -1;
+        results = m_pending.get();
+        return m_epoch;
+    }
+
+private:
+    DEVICEID_TYPE m_deviceId;
+    std::wstring m_snapshotPath;
+    int m_epoch;
+    std::future<std::vector<double>> m_pending;
+};
+} } }
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "IDistGradAggregator.h"
+#include "TimerUtility.h"
+#include <climits>
+#include <string.h>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// BackupWorkerGradAggregator -- synchronous data-parallel SGD that does not wait for the slowest workers
+//
+// With N + b workers, every step sums the gradients of the first N workers to arrive; the b late ones are dropped
+// (cf. synchronous SGD with backup workers). Each worker sends its header and gradients as one message to the main
+// node, which adds up the first N - 1 of those that belong to the current step to its own and sends the result
+// back to all workers, the late ones included, so that all models stay the same. The aggregated header only counts
+// the samples of the gradients that were summed, so the per-sample normalization of the update stays correct.
+// A late message is dropped when the main node receives it during a later step. This absorbs workers that are slow
+// for a while: a worker may fall up to maxLag steps behind, for which the main node keeps the sums to send; beyond
+// that the main node waits for it. (A worker that is always slower still applies every update, and sets the pace.)
+// The main node always contributes, so it should not be the slowest machine. Only dense gradients are supported;
+// they go through CPU memory.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class BackupWorkerGradAggregator : public IDistGradAggregator<ElemType>
+{
+    UsingIDistGradAggregatorMembers;
+
+public:
+    BackupWorkerGradAggregator(MPIWrapper* mpi, size_t numBackupWorkers, int syncStatsTrace)
+        : IDistGradAggregator<ElemType>(mpi), m_numBackupWorkers(numBackupWorkers), m_syncStatsTrace(syncStatsTrace), m_step(0), m_numDropped(0), m_headerSize(0), m_messageSize(0)
+    {
+        if (numBackupWorkers == 0 || numBackupWorkers >= NumProc())
+            InvalidArgument("BackupWorkerGradAggregator: the number of backup workers must be at least 1 and less than the number of workers (%d).", (int) NumProc());
+    }
+
+    ~BackupWorkerGradAggregator()
+    {
+        // the main node has a receive posted for the next message of every worker, which will not come any more
+        for (auto& request : m_recvRequests)
+        {
+            MPI_Cancel(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        for (auto& requests : m_sendRequests)
+        {
+            if (!requests.empty())
+                MPI_Waitall((int) requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+        }
+    }
+
+    bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int /*epochNumber*/) override
+    {
+        if (m_messageSize == 0)
+            Setup(gradients, headerCPU->Size());
+        const bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_step % m_syncStatsTrace) == 0);
+        m_step++;
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        // our message: [step][header][gradients]
+        *(size_t*) m_sendBuffer.data() = m_step;
+        memcpy(HeaderOf(m_sendBuffer.data()), headerCPU, m_headerSize);
+        for (size_t i = 0; i < gradients.size(); i++)
+            gradients[i]->CopySection(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), ValuesOf(m_sendBuffer.data()) + m_offsets[i], gradients[i]->GetNumRows());
+
+        const char* aggregate;
+        if (m_mpi->IsMainNode())
+            aggregate = AggregateOnMainNode();
+        else
+        {
+            MPI_Request sendRequest;
+            MPI_Isend(m_sendBuffer.data(), (int) m_messageSize, MPI_CHAR, m_mpi->MainNodeRank(), gradientsTag, m_mpi->Communicator(), &sendRequest) || MpiFail("MPI_Isend");
+            MPI_Recv(m_aggregateBuffers[0].data(), (int) m_messageSize, MPI_CHAR, m_mpi->MainNodeRank(), aggregateTag, m_mpi->Communicator(), MPI_STATUS_IGNORE) || MpiFail("MPI_Recv");
+            MPI_Wait(&sendRequest, MPI_STATUS_IGNORE) || MpiFail("MPI_Wait");
+            aggregate = m_aggregateBuffers[0].data();
+        }
+
+        headerCPU->Aggregate(HeaderOf(aggregate));
+        for (size_t i = 0; i < gradients.size(); i++)
+            gradients[i]->SetValue(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), gradients[i]->GetDeviceId(), ValuesOf(aggregate) + m_offsets[i]);
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            fprintf(stderr, "Actual gradient aggregation time: %.6g (%d late gradients dropped so far)\n", aggregationTimer.ElapsedSeconds(), (int) m_numDropped);
+        }
+        return headerCPU->numSamples != 0;
+    }
+
+private:
+    enum
+    {
+        maxLag = 4,
+        gradientsTag = 0x6b00, // (above the tags of SimpleDistGradAggregator, which go by the number of gradients)
+        aggregateTag
+    };
+
+    void Setup(const std::vector<Matrix<ElemType>*>& gradients, size_t headerSize)
+    {
+        m_headerSize = headerSize;
+        m_offsets.clear();
+        size_t numElements = 0;
+        for (const auto& gradient : gradients)
+        {
+            if (gradient->GetMatrixType() != DENSE)
+                InvalidArgument("BackupWorkerGradAggregator: only dense gradients are supported.");
+            m_offsets.push_back(numElements);
+            numElements += gradient->GetNumElements();
+        }
+        m_messageSize = sizeof(size_t) + m_headerSize + numElements * sizeof(ElemType);
+        if (m_messageSize > INT_MAX)
+            RuntimeError("BackupWorkerGradAggregator: the gradients are too large for one message (%.0f bytes).", (double) m_messageSize);
+        m_sendBuffer.resize(m_messageSize);
+        m_aggregateBuffers.assign(m_mpi->IsMainNode() ? maxLag + 1 : 1, std::vector<char>(m_messageSize));
+        m_sendRequests.resize(m_aggregateBuffers.size());
+
+        if (m_mpi->IsMainNode())
+        {
+            m_recvBuffers.assign(NumProc() - 1, std::vector<char>(m_messageSize));
+            m_recvRequests.assign(NumProc() - 1, MPI_REQUEST_NULL);
+            for (size_t j = 0; j < m_recvRequests.size(); j++)
+                PostReceive(j);
+        }
+    }
+
+    // rank of the j-th other worker, as seen from the main node
+    int OtherRank(size_t j)
+    {
+        return (int) ((j >= MyRank()) ? (j + 1) : j);
+    }
+
+    void PostReceive(size_t j)
+    {
+        MPI_Irecv(m_recvBuffers[j].data(), (int) m_messageSize, MPI_CHAR, OtherRank(j), gradientsTag, m_mpi->Communicator(), &m_recvRequests[j]) || MpiFail("MPI_Irecv");
+    }
+
+    // sum our gradients and those of the first workers to send theirs for this step, and send the sum to all
+    // The sums of the last maxLag + 1 steps are kept, so that the sends to a late worker have that long to complete.
+    const char* AggregateOnMainNode()
+    {
+        std::vector<char>& aggregate = m_aggregateBuffers[m_step % m_aggregateBuffers.size()];
+        std::vector<MPI_Request>& sendRequests = m_sendRequests[m_step % m_aggregateBuffers.size()];
+        if (!sendRequests.empty())
+            MPI_Waitall((int) sendRequests.size(), sendRequests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+        memcpy(aggregate.data(), m_sendBuffer.data(), m_messageSize);
+
+        const size_t numElements = (m_messageSize - sizeof(size_t) - m_headerSize) / sizeof(ElemType);
+        ElemType* sum = ValuesOf(aggregate.data());
+        for (size_t numContributions = 1; numContributions < NumProc() - m_numBackupWorkers;)
+        {
+            int j = MPI_UNDEFINED;
+            MPI_Waitany((int) m_recvRequests.size(), m_recvRequests.data(), &j, MPI_STATUS_IGNORE) || MpiFail("MPI_Waitany");
+            if (j == MPI_UNDEFINED)
+                LogicError("BackupWorkerGradAggregator: no receives pending.");
+            const char* message = m_recvBuffers[j].data();
+            if (*(const size_t*) message == m_step)
+            {
+                HeaderOf(aggregate.data())->Aggregate(HeaderOf(message), true);
+                const ElemType* values = ValuesOf(message);
+                for (size_t k = 0; k < numElements; k++)
+                    sum[k] += values[k];
+                numContributions++;
+            }
+            else // (of a step we finished without it)
+                m_numDropped++;
+            PostReceive(j);
+        }
+
+        sendRequests.assign(NumProc() - 1, MPI_REQUEST_NULL);
+        for (size_t j = 0; j < sendRequests.size(); j++)
+            MPI_Isend(aggregate.data(), (int) m_messageSize, MPI_CHAR, OtherRank(j), aggregateTag, m_mpi->Communicator(), &sendRequests[j]) || MpiFail("MPI_Isend");
+        return aggregate.data();
+    }
+
+    DistGradHeader* HeaderOf(const char* message) const
+    {
+        return (DistGradHeader*) (message + sizeof(size_t));
+    }
+    ElemType* ValuesOf(const char* message) const
+    {
+        return (ElemType*) (message + sizeof(size_t) + m_headerSize);
+    }
+
+    size_t m_numBackupWorkers;
+    int m_syncStatsTrace;
+    size_t m_step;       // number of AggregateGradients() calls, the same on all workers
+    size_t m_numDropped; // late messages the main node received
+
+    size_t m_headerSize;
+    size_t m_messageSize; // 0 until the first step
+    std::vector<size_t> m_offsets; // [i] element offset of gradient i in a message
+    std::vector<char> m_sendBuffer;
+    std::vector<std::vector<char>> m_aggregateBuffers; // [step % (maxLag + 1)] the main node's sums; on the other workers [0] receives the sum
+
+    // main node
+    std::vector<std::vector<char>> m_recvBuffers; // [j] next message of the j-th other worker
+    std::vector<MPI_Request> m_recvRequests;
+    std::vector<std::vector<MPI_Request>> m_sendRequests; // [.] sends of m_aggregateBuffers[.]
+};
+} } }
@@ -0,0 +1,300 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BeamSearchDecoder.h -- batched beam search over a recurrent network that predicts the next token
+//
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "RecurrentNodes.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// BeamSearchDecoder -- N-best decoding of many sentences at once, one forward step per time step
+//
+// The network reads one token per frame (one-hot, dense or sparse) and its output node gives the unnormalized
+// scores of the next token. All hypotheses of all sentences of a batch are the parallel sequences of one
+// single-frame minibatch, sentence s owning columns [s * beamWidth, (s + 1) * beamWidth). Each step takes the
+// beamWidth best next tokens of every hypothesis on the device (no more than that can make it into the beam);
+// the host then picks the new beam of each sentence from these beamWidth^2 candidates. The recurrent state is not
+// recomputed: the PastValue nodes' last inputs are permuted into the new beam order by a product with a sparse
+// selection matrix, and the next step continues from there.
+// Ending with the end symbol moves a hypothesis into the N-best list; a sentence is done when that has beamWidth
+// entries, and all are after maxLength steps. Scores are log probabilities conditioned on the given prefix.
+// Only the PastValue nodes with a delay of 1 carry state; networks with FutureValue nodes cannot be decoded this way.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class BeamSearchDecoder
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+public:
+    struct Hypothesis
+    {
+        std::vector<size_t> tokens; // after the start symbol, including the prefix, without the end symbol
+        double score;
+        bool finished; // ended with the end symbol (rather than running into maxLength)
+    };
+
+    BeamSearchDecoder(const ComputationNetworkPtr& net, const std::wstring& inputNodeName, const std::wstring& outputNodeName,
+                      size_t beamWidth, size_t maxLength, size_t startSymbol, size_t endSymbol)
+        : m_net(net), m_beamWidth(beamWidth), m_maxLength(maxLength), m_startSymbol(startSymbol), m_endSymbol(endSymbol),
+          m_logProbs(net->GetDeviceId()), m_topIndexes(net->GetDeviceId()), m_topValues(net->GetDeviceId()),
+          m_selection(0, 0, net->GetDeviceId(), SPARSE, matrixFormatSparseCSC), m_reindexed(net->GetDeviceId())
+    {
+        if (beamWidth == 0 || maxLength == 0)
+            InvalidArgument("BeamSearchDecoder: beamWidth and maxLength must be positive.");
+        m_inputNode = dynamic_pointer_cast<ComputationNode<ElemType>>(m_net->GetNodeFromName(inputNodeName));
+        m_outputNode = dynamic_pointer_cast<ComputationNode<ElemType>>(m_net->GetNodeFromName(outputNodeName));
+        if (!m_net->GetNodesWithType(OperationNameOf(FutureValueNode)).empty())
+            InvalidArgument("BeamSearchDecoder: The network must not look into the future (FutureValue nodes).");
+        for (const auto& node : m_net->GetNodesWithType(OperationNameOf(PastValueNode)))
+        {
+            auto pastValueNode = dynamic_pointer_cast<PastValueNode<ElemType>>(node);
+            if (pastValueNode->GetTimeStep() != 1)
+                InvalidArgument("BeamSearchDecoder: PastValue node %ls has a delay of %d; only 1 is supported.", node->NodeName().c_str(), pastValueNode->GetTimeStep());
+            pastValueNode->SetKeepWholeInput(true); // (the state is reordered by beam after each step)
+            m_pastValueNodes.push_back(pastValueNode);
+        }
+
+        m_net->AllocateAllMatrices({}, {OutputNode()}, nullptr);
+        m_vocabSize = m_inputNode->GetSampleMatrixNumRows();
+        if (startSymbol >= m_vocabSize || endSymbol >= m_vocabSize)
+            InvalidArgument("BeamSearchDecoder: The start and end symbols must be less than the input dimension %d.", (int) m_vocabSize);
+    }
+
+    // decode one batch of sentences, each continuing the start symbol and its prefix; returns the N-best lists, best first
+    std::vector<std::vector<Hypothesis>> Decode(const std::vector<std::vector<size_t>>& prefixes)
+    {
+        const size_t numSentences = prefixes.size();
+        const size_t B = m_beamWidth;
+        const size_t N = numSentences * B;
+        std::vector<std::vector<Hypothesis>> nBest(numSentences);
+        if (numSentences == 0)
+            return nBest;
+
+        // at first, only the first hypothesis of each sentence is alive
+        std::vector<Column> columns(N);
+        for (size_t s = 0; s < numSentences; s++)
+        {
+            for (size_t token : prefixes[s])
+                if (token >= m_vocabSize)
+                    InvalidArgument("BeamSearchDecoder: Token %d of sentence %d is outside the input dimension %d.", (int) token, (int) s, (int) m_vocabSize);
+            Column& column = columns[s * B];
+            column.tokens.push_back(m_startSymbol);
+            column.tokens.insert(column.tokens.end(), prefixes[s].begin(), prefixes[s].end());
+            column.alive = true;
+        }
+        std::vector<bool> done(numSentences, false);
+        std::vector<size_t> backPointers(N);
+        std::vector<Candidate> candidates;
+
+        m_net->StartEvaluateMinibatchLoop(OutputNode());
+        for (size_t t = 0; t < m_maxLength; t++)
+        {
+            // feed token t of each hypothesis and get the scores of token t + 1
+            SetInput(columns, t);
+            auto pMBLayout = m_net->GetMBLayoutPtr();
+            pMBLayout->Init(N, 1);
+            for (size_t j = 0; j < N; j++)
+                pMBLayout->AddSequence(NEW_SEQUENCE_ID, j, -(ptrdiff_t) t, 2); // (begun t frames ago, continues beyond this one)
+            NotifyInputsResized();
+            m_net->ForwardProp(OutputNode());
+
+            m_logProbs.SetValue(m_outputNode->Value());
+            m_logProbs.InplaceLogSoftmax(true);
+            const size_t topK = min(B, m_vocabSize);
+            m_logProbs.VectorMax(m_topIndexes, m_topValues, true, (int) topK);
+            std::unique_ptr<ElemType[]> topIndexes(m_topIndexes.CopyToArray()); // [topK x N]
+            std::unique_ptr<ElemType[]> topValues(m_topValues.CopyToArray());
+
+            // the new beam of each sentence
+            std::vector<Column> newColumns(N);
+            bool anyAlive = false;
+            for (size_t s = 0; s < numSentences; s++)
+            {
+                for (size_t i = 0; i < B; i++)
+                    backPointers[s * B + i] = s * B;
+                if (done[s])
+                    continue;
+
+                candidates.clear();
+                for (size_t j = s * B; j < (s + 1) * B; j++)
+                {
+                    const Column& column = columns[j];
+                    if (!column.alive)
+                        continue;
+                    if (t + 1 < column.tokens.size()) // still within the prefix
+                        candidates.push_back(Candidate{column.score, j, column.tokens[t + 1], true});
+                    else
+                        for (size_t k = 0; k < topK; k++)
+                            candidates.push_back(Candidate{column.score + topValues[j * topK + k], j, (size_t)(topIndexes[j * topK + k] + 0.5), false});
+                }
+                std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+                          {
+                              return a.score > b.score;
+                          });
+
+                size_t numLive = 0;
+                for (const auto& candidate : candidates)
+                {
+                    if (numLive == B || nBest[s].size() == B)
+                        break;
+                    const Column& source = columns[candidate.source];
+                    if (candidate.token == m_endSymbol && !candidate.forced)
+                    {
+                        nBest[s].push_back(Hypothesis{std::vector<size_t>(source.tokens.begin() + 1, source.tokens.end()), candidate.score, true});
+                        continue;
+                    }
+                    const size_t j = s * B + numLive++;
+                    Column& column = newColumns[j];
+                    column.tokens = candidate.forced ? source.tokens : AppendedTokens(source.tokens, candidate.token);
+                    column.score = candidate.score;
+                    column.alive = true;
+                    backPointers[j] = candidate.source;
+                }
+                done[s] = numLive == 0 || nBest[s].size() == B;
+                if (done[s])
+                    for (size_t i = 0; i < B; i++)
+                        newColumns[s * B + i].alive = false;
+                else
+                    anyAlive = true;
+            }
+            columns.swap(newColumns);
+            if (!anyAlive)
+                break;
+
+            // carry the recurrent state over into the new beam order
+            SetSelection(backPointers);
+            for (const auto& node : m_pastValueNodes)
+            {
+                const Matrix<ElemType>& lastInput = node->GetDelayedValue();
+                if (lastInput.GetNumCols() != N)
+                    continue; // (not on the path to the output)
+                m_reindexed.AssignProductOf(lastInput, false, m_selection, false);
+                node->SetDelayedValue(m_reindexed, N);
+            }
+        }
+
+        // sentences that ran into maxLength get their live hypotheses, unfinished
+        for (size_t s = 0; s < numSentences; s++)
+        {
+            for (size_t j = s * B; j < (s + 1) * B && nBest[s].size() < B; j++)
+                if (columns[j].alive)
+                    nBest[s].push_back(Hypothesis{std::vector<size_t>(columns[j].tokens.begin() + 1, columns[j].tokens.end()), columns[j].score, false});
+            std::stable_sort(nBest[s].begin(), nBest[s].end(), [](const Hypothesis& a, const Hypothesis& b)
+                             {
+                                 return a.score > b.score;
+                             });
+        }
+        return nBest;
+    }
+
+private:
+    struct Column
+    {
+        std::vector<size_t> tokens; // starting with the start symbol
+        double score = 0;
+        bool alive = false;
+    };
+
+    struct Candidate
+    {
+        double score;
+        size_t source; // column of the hypothesis it extends
+        size_t token;
+        bool forced;   // the next prefix token rather than a choice
+    };
+
+    static std::vector<size_t> AppendedTokens(const std::vector<size_t>& tokens, size_t token)
+    {
+        std::vector<size_t> result;
+        result.reserve(tokens.size() + 1);
+        result.assign(tokens.begin(), tokens.end());
+        result.push_back(token);
+        return result;
+    }
+
+    // one-hot input of token t of every column (the start symbol for dead ones)
+    void SetInput(const std::vector<Column>& columns, size_t t)
+    {
+        const size_t N = columns.size();
+        Matrix<ElemType>& input = m_inputNode->Value();
+        if (input.GetMatrixType() == SPARSE)
+        {
+            m_colStarts.resize(N + 1);
+            m_rowIndices.resize(N);
+            m_ones.assign(N, 1);
+            for (size_t j = 0; j < N; j++)
+            {
+                m_colStarts[j] = (CPUSPARSE_INDEX_TYPE) j;
+                m_rowIndices[j] = (CPUSPARSE_INDEX_TYPE)(columns[j].alive ? columns[j].tokens[t] : m_startSymbol);
+            }
+            m_colStarts[N] = (CPUSPARSE_INDEX_TYPE) N;
+            input.SetMatrixFromCSCFormat(m_colStarts.data(), m_rowIndices.data(), m_ones.data(), N, m_vocabSize, N);
+        }
+        else
+        {
+            m_denseInput.assign(m_vocabSize * N, 0);
+            for (size_t j = 0; j < N; j++)
+                m_denseInput[j * m_vocabSize + (columns[j].alive ? columns[j].tokens[t] : m_startSymbol)] = 1;
+            input.SetValue(m_vocabSize, N, input.GetDeviceId(), m_denseInput.data(), matrixFlagNormal);
+        }
+    }
+
+    // [N x N] with a 1 in row backPointers[j] of column j, so that (state * selection) reorders the state's columns
+    void SetSelection(const std::vector<size_t>& backPointers)
+    {
+        const size_t N = backPointers.size();
+        m_colStarts.resize(N + 1);
+        m_rowIndices.resize(N);
+        m_ones.assign(N, 1);
+        for (size_t j = 0; j < N; j++)
+        {
+            m_colStarts[j] = (CPUSPARSE_INDEX_TYPE) j;
+            m_rowIndices[j] = (CPUSPARSE_INDEX_TYPE) backPointers[j];
+        }
+        m_colStarts[N] = (CPUSPARSE_INDEX_TYPE) N;
+        m_selection.SetMatrixFromCSCFormat(m_colStarts.data(), m_rowIndices.data(), m_ones.data(), N, N, N);
+    }
+
+    ComputationNodeBasePtr OutputNode() const
+    {
+        return m_outputNode;
+    }
+
+    // same as in GetMinibatchIntoNetwork()
+    void NotifyInputsResized()
+    {
+        for (auto& node : m_net->FeatureNodes())
+            node->NotifyFunctionValuesMBSizeModified();
+        m_net->DetermineActualMBSizeFromFeatures();
+        ComputationNetwork::BumpEvalTimeStamp(m_net->FeatureNodes());
+    }
+
+    ComputationNetworkPtr m_net;
+    ComputationNodePtr m_inputNode;
+    ComputationNodePtr m_outputNode;
+    std::vector<shared_ptr<PastValueNode<ElemType>>> m_pastValueNodes;
+    size_t m_beamWidth;
+    size_t m_maxLength;
+    size_t m_startSymbol;
+    size_t m_endSymbol;
+    size_t m_vocabSize;
+
+    Matrix<ElemType> m_logProbs;                  // [vocab x N] log softmax of the output
+    Matrix<ElemType> m_topIndexes, m_topValues;   // [beamWidth x N]
+    Matrix<ElemType> m_selection;                 // [N x N] sparse, see SetSelection()
+    Matrix<ElemType> m_reindexed;                 // a PastValue node's state in the new beam order
+    std::vector<CPUSPARSE_INDEX_TYPE> m_colStarts, m_rowIndices;
+    std::vector<ElemType> m_ones, m_denseInput;
+};
+} } }
@@ -0,0 +1,126 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ComputeGraphReplay.h -- replay of the GPU work of forward and backward prop as a CUDA graph while minibatches look alike
+//
+#pragma once
+
+#include "Basics.h"
+#include "CommonMatrix.h"
+#include "Sequences.h"
+#include <functional>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// ComputeGraphReplay -- runs a training step either directly or by launching the CUDA graph of an earlier one
+//
+// A step is identified by the MBLayout, the loss scale and whether it includes backprop. The second step in a row
+// with the same identity is captured (see ComputeGraphs) and launched; later steps with that identity launch the
+// graph again, as long as no device memory has been allocated or freed since the capture, which would mean that
+// the graph refers to buffers that are no longer those of the network. Any other step runs directly, and the next
+// repetition is captured anew. If a capture fails (something in the step synchronizes with the host, or allocates),
+// the step runs directly and so do all later ones.
+// Only the GPU work is replayed. The step must therefore not depend on host state that changes from minibatch to
+// minibatch other than the identity, e.g. random seeds (dropout) or counters (batch normalization's running averages).
+// -----------------------------------------------------------------------
+
+class ComputeGraphReplay
+{
+public:
+    ComputeGraphReplay(DEVICEID_TYPE deviceId)
+        : m_deviceId(deviceId), m_graph(nullptr), m_graphAllocationCount(0), m_disabled(false), m_numCaptured(0), m_numReplayed(0)
+    {
+    }
+
+    ~ComputeGraphReplay()
+    {
+        ComputeGraphs::Destroy(m_graph);
+    }
+
+    void Run(const MBLayoutPtr& layout, double lossScale, bool withBackprop, const std::function<void()>& step)
+    {
+        const bool isGraphStep = m_graph && m_graphKey.Matches(layout, lossScale, withBackprop);
+        if (isGraphStep && ComputeGraphs::GetAllocationCount() == m_graphAllocationCount)
+        {
+            ComputeGraphs::Launch(m_deviceId, m_graph);
+            m_numReplayed++;
+            return;
+        }
+        const bool isRepeated = m_lastKey.Matches(layout, lossScale, withBackprop);
+        m_lastKey.Set(layout, lossScale, withBackprop);
+        if (m_disabled || !isRepeated)
+        {
+            step();
+            return;
+        }
+
+        ComputeGraphs::Destroy(m_graph);
+        m_graph = nullptr;
+        const size_t allocationCount = ComputeGraphs::GetAllocationCount();
+        ComputeGraphs::BeginCapture(m_deviceId);
+        bool captured = true;
+        try
+        {
+            step();
+        }
+        catch (const std::exception&) // (the capture failed; if the step itself has a problem, the direct run below throws again)
+        {
+            captured = false;
+        }
+        void* graph = ComputeGraphs::EndCapture(m_deviceId);
+        if (!captured || !graph || ComputeGraphs::GetAllocationCount() != allocationCount)
+        {
+            ComputeGraphs::Destroy(graph);
+            fprintf(stderr, "ComputeGraphReplay: WARNING: The training step cannot be captured into a CUDA graph, since it synchronizes with the host or allocates GPU memory. Running it directly from now on.\n");
+            m_disabled = true;
+            step(); // (nothing of the capture has run)
+            return;
+        }
+        m_graph = graph;
+        m_graphKey.Set(layout, lossScale, withBackprop);
+        m_graphAllocationCount = allocationCount;
+        ComputeGraphs::Launch(m_deviceId, m_graph);
+        m_numCaptured++;
+    }
+
+    size_t NumCaptured() const { return m_numCaptured; }
+    size_t NumReplayed() const { return m_numReplayed; }
+
+private:
+    struct StepKey
+    {
+        MBLayoutPtr layout; // (a copy)
+        double lossScale;
+        bool withBackprop;
+
+        StepKey()
+            : lossScale(0), withBackprop(false)
+        {
+        }
+        bool Matches(const MBLayoutPtr& otherLayout, double otherLossScale, bool otherWithBackprop) const
+        {
+            return layout && otherLayout && *layout == *otherLayout && lossScale == otherLossScale && withBackprop == otherWithBackprop;
+        }
+        void Set(const MBLayoutPtr& otherLayout, double otherLossScale, bool otherWithBackprop)
+        {
+            if (!layout)
+                layout = std::make_shared<MBLayout>();
+            layout->CopyFrom(otherLayout);
+            lossScale = otherLossScale;
+            withBackprop = otherWithBackprop;
+        }
+    };
+
+    DEVICEID_TYPE m_deviceId;
+    void* m_graph;
+    StepKey m_graphKey;
+    size_t m_graphAllocationCount;
+    StepKey m_lastKey;
+    bool m_disabled;
+    size_t m_numCaptured;
+    size_t m_numReplayed;
+};
+} } }
@@ -0,0 +1,323 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DataParallelReplicas.h -- data-parallel training on several GPUs, or groups of CPU cores, of one process
+//
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "DataReaderHelpers.h"
+#include "CPUMatrix.h" // for CPUThreadBudget
+#include "PrefetchQueue.h"
+#include <future>
+#include <thread>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// DataParallelReplicas -- one replica of the network per additional GPU, trained in lock-step with the main network
+//
+// The reader fills the main network's inputs as usual. Each minibatch is then split by parallel sequences, like
+// DecimateMinibatch() does for MPI workers; every replica runs forward prop and backprop of its share on a thread of
+// its own, while the main network does its share. The replicas' gradients and criterion values are then added into
+// those of the main network (peer-to-peer where the GPUs support it), which SGD updates as usual; after the update,
+// the parameters are copied back to the replicas. Thus only one reader and one copy of the optimizer state exist.
+// On the CPU, the replicas (the main network included) each get a group of cores instead of a GPU: one network
+// cannot keep many cores busy with small matrices, while several replicas on fewer threads each can. The share of
+// every network then runs on a thread bound to its cores, which also creates the replica, so that its memory is on
+// their NUMA node; the main thread only waits (and afterwards updates the parameters with all cores).
+// Not for sequence training or sub-minibatching, and not combined with MPI-based parallel training.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class DataParallelReplicas
+{
+public:
+    // 'devices' are the additional GPUs, or CPUDEVICE for each additional replica on the CPU; the main network keeps its own
+    // 'coreGroups' are the cores of each network on the CPU, the main network's first (empty for GPUs); the destructor
+    // releases them with CPUThreadBudget::ReleaseCores().
+    DataParallelReplicas(const ComputationNetworkPtr& net, const std::vector<DEVICEID_TYPE>& devices, const std::vector<std::vector<int>>& coreGroups,
+                         const std::wstring& snapshotPath,
+                         const std::vector<ComputationNodeBasePtr>& criterionNodes, const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                         const std::list<ComputationNodeBasePtr>& learnableNodes, size_t recomputeSegmentLength, bool offloadActivations, size_t maxTempMemSizeInSamplesForCNN)
+        : m_mainLayoutCache(make_shared<MBLayout>()), m_coreGroups(coreGroups)
+    {
+        if (!coreGroups.empty() && coreGroups.size() != devices.size() + 1)
+            LogicError("DataParallelReplicas: Expected %d core groups, got %d.", (int) devices.size() + 1, (int) coreGroups.size());
+        for (const auto& cores : coreGroups)
+            m_coreGroupThreads.push_back(std::unique_ptr<CoreGroupThread>(new CoreGroupThread(cores)));
+
+        net->Save(snapshotPath);
+        for (size_t k = 0; k < devices.size(); k++)
+        {
+            if (devices[k] >= 0 && devices[k] == net->GetDeviceId())
+                InvalidArgument("DataParallelReplicas: The training device %d cannot also hold a replica.", (int) devices[k]);
+            auto create = [&]()
+            {
+                return CreateReplica(devices[k], snapshotPath, criterionNodes, evaluationNodes, learnableNodes,
+                                     recomputeSegmentLength, offloadActivations, maxTempMemSizeInSamplesForCNN);
+            };
+            Replica replica;
+            if (m_coreGroupThreads.empty())
+                replica = create();
+            else
+                m_coreGroupThreads[k + 1]->Run([&]() { replica = create(); }).get(); // (first touch from its cores)
+            replica.prevDropoutRate = 0;
+            replica.dropoutSeed = (unsigned long) (1 + 1000 * (k + 1)); // (the main network starts at 1)
+            m_replicas.push_back(std::move(replica));
+        }
+        _wunlink(snapshotPath.c_str());
+    }
+
+    ~DataParallelReplicas()
+    {
+        m_coreGroupThreads.clear(); // (joins them)
+        for (const auto& cores : m_coreGroups)
+            CPUThreadBudget::ReleaseCores(cores);
+    }
+
+    // number of networks sharing each minibatch, including the main network
+    size_t NumReplicas() const
+    {
+        return m_replicas.size() + 1;
+    }
+
+    // bring the replicas in sync with the main network at the beginning of an epoch (also after the main network's model got reloaded)
+    void StartEpoch(const std::list<ComputationNodeBasePtr>& learnableNodes, double dropoutRate)
+    {
+        for (auto& replica : m_replicas)
+        {
+            ComputationNetwork::SetDropoutRate<ElemType>(replica.net, replica.criterionNode, dropoutRate, replica.prevDropoutRate, replica.dropoutSeed);
+            replica.net->StartEvaluateMinibatchLoop(replica.evaluationNodes);
+            replica.net->StartEvaluateMinibatchLoop(replica.criterionNode);
+        }
+        BroadcastParameters(learnableNodes);
+    }
+
+    // forward prop and backprop of the minibatch that the reader put into the main network's inputs, split over all replicas
+    // Afterwards, the main network's parameter gradients and criterion values are those of the whole minibatch, and its
+    // MBLayout is that of the whole minibatch again; its inputs hold its own share only.
+    void ForwardBackward(const ComputationNetworkPtr& net, std::map<std::wstring, Matrix<ElemType>*>& inputMatrices,
+                         const std::vector<ComputationNodeBasePtr>& criterionNodes, const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                         const std::list<ComputationNodeBasePtr>& learnableNodes, double lossScale, bool doBackprop)
+    {
+        auto pMBLayout = net->GetMBLayoutPtr();
+        m_mainLayoutCache->CopyFrom(pMBLayout);
+        // with fewer parallel sequences than replicas, the last replicas sit this one out
+        const size_t numActive = min(NumReplicas(), pMBLayout->GetNumParallelSequences());
+
+        // hand out the replicas' shares first, then decimate the main network's in place
+        for (size_t k = 1; k < numActive; k++)
+        {
+            auto& replica = m_replicas[k - 1];
+            std::map<std::wstring, Matrix<ElemType>*> decimatedMB;
+            MBLayoutPtr pDecimatedLayout;
+            DataReaderHelpers::DecimateMinibatch(inputMatrices, decimatedMB, pMBLayout, pDecimatedLayout, (int) numActive, (int) k);
+            for (auto& input : decimatedMB)
+            {
+                auto iter = replica.inputMatrices.find(input.first);
+                if (iter == replica.inputMatrices.end())
+                    LogicError("DataParallelReplicas: Input %ls not found in replica.", input.first.c_str());
+                CopyAcrossDevices(*input.second, *iter->second);
+                delete input.second;
+            }
+            replica.net->GetMBLayoutPtr()->CopyFrom(pDecimatedLayout);
+            NotifyInputsResized(replica.net);
+        }
+        DataReaderHelpers::DecimateMinibatch(inputMatrices, (int) numActive, 0, pMBLayout);
+        NotifyInputsResized(net);
+
+        std::vector<std::future<void>> pending;
+        for (size_t k = 1; k < numActive; k++)
+        {
+            auto* replica = &m_replicas[k - 1];
+            auto work = [replica, lossScale, doBackprop]
+            {
+                ForwardAndBackprop(replica->net, replica->criterionNode, replica->evaluationNodes, lossScale, doBackprop);
+            };
+            if (m_coreGroupThreads.empty())
+                pending.push_back(std::async(std::launch::async, work));
+            else
+                pending.push_back(m_coreGroupThreads[k]->Run(work));
+        }
+        if (m_coreGroupThreads.empty())
+            ForwardAndBackprop(net, criterionNodes[0], evaluationNodes, lossScale, doBackprop);
+        else
+            pending.push_back(m_coreGroupThreads[0]->Run([&]() { ForwardAndBackprop(net, criterionNodes[0], evaluationNodes, lossScale, doBackprop); }));
+        for (auto& p : pending)
+            p.wait(); // (all of them before one rethrows, since the work refers to this frame)
+        for (auto& p : pending)
+            p.get(); // (rethrows what the replica threw)
+
+        // sum up into the main network
+        for (size_t k = 1; k < numActive; k++)
+        {
+            const auto& replica = m_replicas[k - 1];
+            AddAcrossDevices(Value(replica.criterionNode), Value(criterionNodes[0]));
+            for (size_t i = 0; i < evaluationNodes.size(); i++)
+                AddAcrossDevices(Value(replica.evaluationNodes[i]), Value(evaluationNodes[i]));
+            if (!doBackprop)
+                continue;
+            auto replicaNodeIter = replica.learnableNodes.begin();
+            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, replicaNodeIter++)
+            {
+                if ((*nodeIter)->IsParameterUpdateRequired())
+                    AddAcrossDevices(dynamic_pointer_cast<ComputationNode<ElemType>>(*replicaNodeIter)->Gradient(),
+                                     dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Gradient());
+            }
+        }
+        pMBLayout->CopyFrom(m_mainLayoutCache);
+    }
+
+    // copy the main network's parameters, as updated, to the replicas
+    void BroadcastParameters(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        for (auto& replica : m_replicas)
+        {
+            auto replicaNodeIter = replica.learnableNodes.begin();
+            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, replicaNodeIter++)
+                CopyAcrossDevices(Value(*nodeIter), Value(*replicaNodeIter));
+        }
+    }
+
+private:
+    // -----------------------------------------------------------------------
+    // CoreGroupThread -- a thread that runs work on a group of cores, with as many OpenMP threads
+    // (OpenMP keeps a pool of threads for each thread that starts parallel regions; with a thread per minibatch, as
+    // std::async() gives, that pool would be created and bound to the cores every time.)
+    // -----------------------------------------------------------------------
+
+    class CoreGroupThread
+    {
+    public:
+        CoreGroupThread(const std::vector<int>& cores)
+            : m_thread([this, cores]
+                       {
+                           CPUThreadBudget budget(0, cores); // (for the lifetime of the thread)
+                           for (;;)
+                           {
+                               std::unique_ptr<std::packaged_task<void()>> task(m_tasks.pop());
+                               if (!task)
+                                   return;
+                               (*task)();
+                           }
+                       })
+        {
+        }
+        ~CoreGroupThread()
+        {
+            m_tasks.push(nullptr);
+            m_thread.join();
+        }
+
+        std::future<void> Run(std::function<void()> work)
+        {
+            auto* task = new std::packaged_task<void()>(std::move(work));
+            auto result = task->get_future();
+            m_tasks.push(task);
+            return result;
+        }
+
+    private:
+        BlockingQueue<std::packaged_task<void()>*> m_tasks; // (before m_thread, which uses it)
+        std::thread m_thread;
+    };
+
+    struct Replica
+    {
+        ComputationNetworkPtr net;
+        ComputationNodeBasePtr criterionNode;
+        std::vector<ComputationNodeBasePtr> evaluationNodes;
+        std::list<ComputationNodeBasePtr> learnableNodes; // in the order of the main network's
+        std::map<std::wstring, Matrix<ElemType>*> inputMatrices;
+        double prevDropoutRate;
+        unsigned long dropoutSeed;
+    };
+
+    static Matrix<ElemType>& Value(const ComputationNodeBasePtr& node)
+    {
+        return dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+    }
+
+    static Replica CreateReplica(DEVICEID_TYPE deviceId, const std::wstring& snapshotPath,
+                                 const std::vector<ComputationNodeBasePtr>& criterionNodes, const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                 const std::list<ComputationNodeBasePtr>& learnableNodes, size_t recomputeSegmentLength, bool offloadActivations, size_t maxTempMemSizeInSamplesForCNN)
+    {
+        Replica replica;
+        replica.net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, snapshotPath);
+        replica.criterionNode = replica.net->GetNodeFromName(criterionNodes[0]->NodeName());
+        for (const auto& node : evaluationNodes)
+            replica.evaluationNodes.push_back(replica.net->GetNodeFromName(node->NodeName()));
+        for (const auto& node : learnableNodes)
+            replica.learnableNodes.push_back(replica.net->GetNodeFromName(node->NodeName()));
+        for (const auto& node : replica.net->FeatureNodes())
+            replica.inputMatrices[node->NodeName()] = &dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        for (const auto& node : replica.net->LabelNodes())
+            replica.inputMatrices[node->NodeName()] = &dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        replica.net->SetRecomputeSegmentLength(recomputeSegmentLength);
+        replica.net->SetOffloadActivations(offloadActivations);
+        replica.net->AllocateAllMatrices(replica.evaluationNodes, {}, replica.criterionNode);
+        ComputationNetwork::SetMaxTempMemSizeForCNN(replica.net, replica.criterionNode, maxTempMemSizeInSamplesForCNN);
+        return replica;
+    }
+
+    static void ForwardAndBackprop(const ComputationNetworkPtr& net, const ComputationNodeBasePtr& criterionNode,
+                                   const std::vector<ComputationNodeBasePtr>& evaluationNodes, double lossScale, bool doBackprop)
+    {
+        net->ForwardProp(evaluationNodes);
+        net->ForwardProp(criterionNode);
+        if (doBackprop)
+            net->Backprop(criterionNode, lossScale);
+    }
+
+    // same as in GetMinibatchIntoNetwork()
+    static void NotifyInputsResized(const ComputationNetworkPtr& net)
+    {
+        for (auto& node : net->FeatureNodes())
+            node->NotifyFunctionValuesMBSizeModified();
+        for (auto& node : net->LabelNodes())
+            node->NotifyFunctionValuesMBSizeModified();
+        net->DetermineActualMBSizeFromFeatures();
+        ComputationNetwork::BumpEvalTimeStamp(net->FeatureNodes());
+        ComputationNetwork::BumpEvalTimeStamp(net->LabelNodes());
+    }
+
+    // Matrix::SetValue() would move the target to the source's device; this goes through a moved copy instead
+    static void CopyAcrossDevices(const Matrix<ElemType>& from, Matrix<ElemType>& to)
+    {
+        if (from.GetDeviceId() == to.GetDeviceId())
+        {
+            to.SetValue(from);
+            return;
+        }
+        Matrix<ElemType> moved(from.GetDeviceId());
+        moved.SetValue(from);
+        moved.TransferToDeviceIfNotThere(to.GetDeviceId(), true);
+        to.SetValue(moved);
+    }
+
+    static void AddAcrossDevices(const Matrix<ElemType>& from, Matrix<ElemType>& to)
+    {
+        if (from.GetDeviceId() == to.GetDeviceId())
+        {
+            Matrix<ElemType>::ScaleAndAdd(1, from, to);
+            return;
+        }
+        Matrix<ElemType> moved(from.GetDeviceId());
+        moved.SetValue(from);
+        moved.TransferToDeviceIfNotThere(to.GetDeviceId(), true);
+        Matrix<ElemType>::ScaleAndAdd(1, moved, to);
+    }
+
+    std::vector<Replica> m_replicas;
+    MBLayoutPtr m_mainLayoutCache;
+    std::vector<std::vector<int>> m_coreGroups;                       // on the CPU: [k] the cores of network k, the main network first
+    std::vector<std::unique_ptr<CoreGroupThread>> m_coreGroupThreads; // [k] runs the work of network k
+};
+} } }
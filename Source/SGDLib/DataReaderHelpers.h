@@ -7,14 +7,22 @@
 #include "ComputationNetwork.h"
 #include "MPIWrapper.h"
 #include "SpecialPurposeNodes.h"        // for SequenceWithSoftmaxNode
+#include "CUDAPageLockedMemAllocator.h"
+#include "GPUDataTransferer.h"
+#include "MatrixQuantizerImpl.h"        // for MatrixComputeStreamEvent
+#include "TimerUtility.h"
 #include <string>
 #include <map>
 #include <set>
+#include <future>
+#include <memory>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 /*static*/ struct DataReaderHelpers
 {
+    template <class ElemType>
+    class MinibatchPrefetcher;
 
     // -------------------------------------------------------------------
     // GetMinibatchIntoNetwork() -- get one minibatch from Reader (this->trainSetDataReader) into Network (this->net)
@@ -31,16 +39,21 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                                         bool useDistributedMBReading,
                                         bool useParallelTrain,
                                         std::map<std::wstring, Matrix<ElemType>*>& inputMatrices,
-                                        size_t& actualMBSize)
+                                        size_t& actualMBSize,
+                                        MinibatchPrefetcher<ElemType>* prefetcher = nullptr,
+                                        const std::vector<double>* workerShares = nullptr) // (see WorkerLoadBalancer; equal shares if null)
     {
         auto pMBLayout = net->GetMBLayoutPtr();
+        ScopedMemoryTag memoryTag(MemoryTag::Reader);
         // Reading consists of a sequence of Reader API calls:
         //  - GetMinibatch() --fills the inputMatrices
         //  - SetActualMiniBatchSizeFromFeatures()  --tells Network to resize the nodes' buffers
         //  - CopyMBLayoutTo()   --copies the MBLayout from Reader to Network
         // with the special twist that in presence of parallelization, there is some decimation involved.
 
-        bool wasDataRead = trainSetDataReader.GetMinibatch(inputMatrices); // fill in the minibatch data into the Input nodes' buffers directly
+        // With a prefetcher, GetMinibatch() and CopyMBLayoutTo() have already been called on a background thread, and we only pick up the result.
+        bool wasDataRead = prefetcher ? prefetcher->GetMinibatch(inputMatrices, pMBLayout)
+                                      : trainSetDataReader.GetMinibatch(inputMatrices); // fill in the minibatch data into the Input nodes' buffers directly
         // If this returns false, the matrices may contain garbage or not sized to 0 columns.
         // On the other hand, if it returns a 0-column matrix, that would be a perfectly cromulent minibatch (in case of data parallelism with distributed reading).
 
@@ -52,6 +65,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         // TODO: This should not need to be called in case of wasDataRead == false, since in that case, returned values are invalid.
         if ((criterionNode != nullptr) && (criterionNode->OperationName() == L"SequenceWithSoftmax"))
         {
+            if (prefetcher)
+                LogicError("GetMinibatchIntoNetwork: Minibatch prefetching cannot be used with sequence training.");
             auto node = dynamic_pointer_cast<SequenceWithSoftmaxNode<ElemType>>(criterionNode);
             auto latticeinput = node->getLatticePtr();
             auto uids = node->getuidprt();
@@ -62,11 +77,12 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         }
 
         // get layout meta-data
-        trainSetDataReader.CopyMBLayoutTo(pMBLayout);
+        if (!prefetcher)
+            trainSetDataReader.CopyMBLayoutTo(pMBLayout);
 
         // decimate if needed. Decimation happens in-place.
         if (!useDistributedMBReading && useParallelTrain)
-            DecimateMinibatch(inputMatrices, g_mpi->NumNodesInUse(), g_mpi->CurrentNodeRank(), net->GetMBLayoutPtr());
+            DecimateMinibatch(inputMatrices, g_mpi->NumNodesInUse(), g_mpi->CurrentNodeRank(), net->GetMBLayoutPtr(), workerShares);
 
         // reader will have resized input node's m_value directly. Nodes must be notified to do necessary internal state updates from that.
         // TODO: This is a stopgap. SGD will at some point change from sets of matrices to sets of nodes. Then this will become much simpler.
@@ -91,6 +107,27 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     // -------------------------------------------------------------------
     // DecimateMinibatch - decimate minibatch for parallelization
     // -------------------------------------------------------------------
+    // the parallel sequences [first, second) of 'rank': an equal part, or the fraction shares[rank] (the shares add up to 1)
+    static pair<size_t, size_t> SequenceRangeOf(size_t numParallelSequences, int numWorker, int rank, const std::vector<double>* shares)
+    {
+        if (shares == nullptr)
+        {
+            size_t st = numParallelSequences * (size_t) rank / numWorker;
+            size_t en = numParallelSequences * (size_t)(rank + 1) / numWorker;
+            en = en > numParallelSequences ? numParallelSequences : en; // TODO: why are these two tests necessary?
+            en = (rank == numWorker - 1) ? numParallelSequences : en;
+            return pair<size_t, size_t>(st, en);
+        }
+        if (shares->size() != (size_t) numWorker)
+            LogicError("DecimateMinibatch: %d shares for %d workers.", (int) shares->size(), numWorker);
+        double begin = 0;
+        for (int r = 0; r < rank; r++)
+            begin += (*shares)[r];
+        const size_t st = min((size_t) (numParallelSequences * begin + 0.5), numParallelSequences);
+        const size_t en = (rank == numWorker - 1) ? numParallelSequences : min((size_t) (numParallelSequences * (begin + (*shares)[rank]) + 0.5), numParallelSequences);
+        return pair<size_t, size_t>(st, max(st, en));
+    }
+
     // non-inplace decimation , to be used in subminibatch implementation
     // returns a subset of parallel sequences
     template <class ElemType>
@@ -98,16 +135,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                                                   std::map<std::wstring, Matrix<ElemType>*>& decimatedMB, // output decimated matrices.
                                                   MBLayoutPtr pMBLayout,                                  // input MBLayout
                                                   MBLayoutPtr& pDecimateMBLayout,                         // output decimated MBLayout (note: cannot work in-place)
-                                                  int numWorker, int rank)
+                                                  int numWorker, int rank,
+                                                  const std::vector<double>* shares = nullptr) // fraction of each worker, see SequenceRangeOf()
     {
         size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
         size_t nT = pMBLayout->GetNumTimeSteps();
 
         // decide start column and end column
-        size_t st = numParallelSequences * (size_t) rank / numWorker;
-        size_t en = numParallelSequences * (size_t)(rank + 1) / numWorker;
-        en = en > numParallelSequences ? numParallelSequences : en; // TODO: why are these two tests necessary?
-        en = (rank == numWorker - 1) ? numParallelSequences : en;
+        const pair<size_t, size_t> range = SequenceRangeOf(numParallelSequences, numWorker, rank, shares);
+        const size_t st = range.first, en = range.second;
         size_t numNewParallelSequence = en - st;
 
         // begin decimate matrices
@@ -162,7 +198,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     template <class ElemType>
     static pair<size_t, size_t> DecimateMinibatch(std::map<std::wstring, Matrix<ElemType>*>& mb, // matrix to be decimated
                                                   int numprocs, int rank,                        // rank info
-                                                  MBLayoutPtr pMBLayout)                         // get decimated as well
+                                                  MBLayoutPtr pMBLayout,                         // get decimated as well
+                                                  const std::vector<double>* shares = nullptr)
     {
         if (numprocs == 1)
             return pair<size_t, size_t>(0, pMBLayout->GetNumParallelSequences());
@@ -172,7 +209,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         MBLayoutPtr pDecimatedMB = make_shared<MBLayout>();
         std::map<wstring, Matrix<ElemType>*> decimatedMB;
         // call in-place decimation
-        pair<size_t, size_t> selected = DecimateMinibatch(mb, decimatedMB, pMBLayout, pDecimatedMB, numprocs, rank);
+        pair<size_t, size_t> selected = DecimateMinibatch(mb, decimatedMB, pMBLayout, pDecimatedMB, numprocs, rank, shares);
         // move the data
         for (auto k : mb)
         {
@@ -583,5 +620,179 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             m_NetEvaluationAccumulator->SetValue((ElemType) 0);
         }
     };
+
+    // ===================================================================
+    // MinibatchPrefetcher -- reads the next minibatch on a background thread while the current one is being trained
+    // ===================================================================
+
+    // The reader fills private staging matrices; GetMinibatchIntoNetwork() then only hands them over to the network.
+    // Dense inputs on a GPU are read into CPU matrices, copied into page-locked buffers, and uploaded on a
+    // private assign stream of the prefetcher's GPUDataTransferer, so that the host-to-device copy overlaps with computation as well.
+    // All other inputs (sparse, or a CPU device) are read directly into staging matrices on the input's device.
+    // The usage would be:
+    //        reader.StartMinibatchLoop(...);
+    //        MinibatchPrefetcher<ElemType> prefetcher(reader, inputMatrices); // starts reading the first minibatch
+    //        while (GetMinibatchIntoNetwork(reader, net, ..., &prefetcher))
+    //        {
+    //            // train; do not call the reader here (the prefetcher calls DataEnd(endDataSentence) before reading the next minibatch)
+    //        }
+    // Not usable with sequence training, which needs the lattices of exactly the minibatch just read.
+    template <class ElemType>
+    class MinibatchPrefetcher
+    {
+        struct StagingBuffer
+        {
+            shared_ptr<Matrix<ElemType>> readerMatrix; // filled by the reader
+            shared_ptr<Matrix<ElemType>> deviceMatrix; // upload target if uploaded asynchronously, else nullptr
+            shared_ptr<ElemType> pinnedBuffer;
+            size_t pinnedBufferSize;
+        };
+
+        IDataReader<ElemType>& m_reader;
+        std::map<std::wstring, Matrix<ElemType>*> m_readerMatrices; // what we pass to the reader
+        std::map<std::wstring, StagingBuffer> m_stagingBuffers;
+        MBLayoutPtr m_MBLayout;
+        int m_deviceId;   // device for asynchronous uploads; CPUDEVICE if none
+        bool m_isFirstMB; // no DataEnd() before the very first minibatch
+        double m_lastUploadWaitSeconds;
+
+        std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
+        std::unique_ptr<GPUDataTransferer<ElemType>> m_gpuDataTransferer;
+        std::future<bool> m_pendingMB;
+
+    public:
+        MinibatchPrefetcher(IDataReader<ElemType>& reader, const std::map<std::wstring, Matrix<ElemType>*>& inputMatrices)
+            : m_reader(reader), m_MBLayout(make_shared<MBLayout>()), m_deviceId(CPUDEVICE), m_isFirstMB(true), m_lastUploadWaitSeconds(0)
+        {
+            for (const auto& iter : inputMatrices)
+            {
+                const Matrix<ElemType>& input = *iter.second;
+                StagingBuffer& staging = m_stagingBuffers[iter.first];
+                staging.pinnedBufferSize = 0;
+                bool uploadAsync = input.GetDeviceId() >= 0 && input.GetMatrixType() == DENSE &&
+                                   (m_deviceId == CPUDEVICE || m_deviceId == input.GetDeviceId()); // (one transferer, one device)
+                if (uploadAsync)
+                {
+                    m_deviceId = input.GetDeviceId();
+                    staging.readerMatrix = make_shared<Matrix<ElemType>>(CPUDEVICE);
+                    staging.deviceMatrix = make_shared<Matrix<ElemType>>(m_deviceId);
+                }
+                else
+                {
+                    staging.readerMatrix = make_shared<Matrix<ElemType>>(input.GetDeviceId());
+                    staging.readerMatrix->SwitchToMatrixType(input.GetMatrixType(), input.GetFormat(), false);
+                }
+                m_readerMatrices[iter.first] = staging.readerMatrix.get();
+            }
+            if (m_deviceId != CPUDEVICE)
+            {
+                m_allocator.reset(new CUDAPageLockedMemAllocator(m_deviceId));
+                m_gpuDataTransferer.reset(new GPUDataTransferer<ElemType>(m_deviceId, false /*useConcurrentStreams*/, true /*usePrivateStreams*/));
+            }
+            StartReading();
+        }
+
+        ~MinibatchPrefetcher()
+        {
+            // the background thread uses our buffers; an exception it may have thrown is dropped here
+            if (m_pendingMB.valid())
+                m_pendingMB.wait();
+        }
+
+        // wait for the pending minibatch, hand it into inputMatrices and pMBLayout, and start reading the next one
+        // Returns false if no data was read, just like IDataReader::GetMinibatch(). In that case, nothing is read ahead,
+        // and a subsequent call reads synchronously (as distributed reading keeps calling past the end).
+        bool GetMinibatch(std::map<std::wstring, Matrix<ElemType>*>& inputMatrices, MBLayoutPtr pMBLayout)
+        {
+            if (!m_pendingMB.valid())
+                StartReading();
+            bool wasDataRead = m_pendingMB.get(); // (rethrows what the reader threw)
+            if (!wasDataRead)
+                return false;
+
+            m_lastUploadWaitSeconds = 0;
+            if (m_gpuDataTransferer)
+            {
+                Timer uploadTimer;
+                uploadTimer.Start();
+                m_gpuDataTransferer->WaitForCopyCPUToGPUAsync();
+                uploadTimer.Stop();
+                m_lastUploadWaitSeconds = uploadTimer.ElapsedSeconds();
+            }
+            for (auto& iter : inputMatrices)
+            {
+                auto staging = m_stagingBuffers.find(iter.first);
+                if (staging == m_stagingBuffers.end())
+                    LogicError("MinibatchPrefetcher: Input '%ls' was not known when the prefetcher was created.", iter.first.c_str());
+                int deviceId = iter.second->GetDeviceId();
+                iter.second->SetValue(staging->second.deviceMatrix ? *staging->second.deviceMatrix : *staging->second.readerMatrix);
+                iter.second->TransferToDeviceIfNotThere(deviceId, true); // (in case the reader changed the matrix type on us)
+            }
+            pMBLayout->CopyFrom(m_MBLayout);
+
+            // The copies above are queued on the main compute stream and read the device staging matrices,
+            // which the next upload overwrites. Make the assign stream wait for them.
+            if (m_gpuDataTransferer)
+                m_gpuDataTransferer->SynchronizeAssignStreamWithComputeStream();
+            StartReading();
+            return true;
+        }
+
+        // how long the last GetMinibatch() waited for the upload of the inputs to finish
+        double LastUploadWaitSeconds() const
+        {
+            return m_lastUploadWaitSeconds;
+        }
+
+    private:
+        void StartReading()
+        {
+            bool callDataEnd = !m_isFirstMB;
+            m_isFirstMB = false;
+            m_pendingMB = std::async(std::launch::async, [this, callDataEnd]
+                                     {
+                                         ScopedMemoryTag memoryTag(MemoryTag::Reader);
+                                         if (m_deviceId != CPUDEVICE)
+                                             Matrix<ElemType>::SetDevice(m_deviceId); // we are on a new thread
+                                         if (callDataEnd)
+                                             m_reader.DataEnd(EndDataType::endDataSentence);
+                                         if (!m_reader.GetMinibatch(m_readerMatrices))
+                                             return false;
+                                         m_reader.CopyMBLayoutTo(m_MBLayout);
+                                         for (auto& iter : m_stagingBuffers)
+                                             UploadAsync(iter.second);
+                                         return true;
+                                     });
+        }
+
+        // copy a dense CPU staging matrix into page-locked memory and from there to the GPU, on the assign stream
+        void UploadAsync(StagingBuffer& staging)
+        {
+            if (!staging.deviceMatrix)
+                return;
+            const Matrix<ElemType>& source = *staging.readerMatrix;
+            if (source.GetMatrixType() != DENSE) // reader made it sparse: hand it over as is
+            {
+                staging.deviceMatrix = nullptr;
+                return;
+            }
+            size_t numElements = source.GetNumElements();
+            if (numElements > staging.pinnedBufferSize)
+            {
+                CUDAPageLockedMemAllocator* allocator = m_allocator.get();
+                staging.pinnedBuffer = nullptr; // (free the old one first)
+                staging.pinnedBuffer = std::shared_ptr<ElemType>((ElemType*) allocator->Malloc(numElements * sizeof(ElemType)), [allocator](ElemType* p)
+                                                                 {
+                                                                     allocator->Free(p);
+                                                                 });
+                staging.pinnedBufferSize = numElements;
+            }
+            staging.deviceMatrix->Resize(source.GetNumRows(), source.GetNumCols());
+            if (numElements == 0)
+                return;
+            memcpy(staging.pinnedBuffer.get(), source.BufferPointer(), numElements * sizeof(ElemType));
+            m_gpuDataTransferer->CopyCPUToGPUAsync(staging.pinnedBuffer.get(), numElements, staging.deviceMatrix->BufferPointer());
+        }
+    };
 };
 } } }
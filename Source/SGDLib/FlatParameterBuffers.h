@@ -0,0 +1,219 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// FlatParameterBuffers.h -- the values and gradients of all parameters as views into one contiguous buffer each
+//
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include <list>
+#include <vector>
+#include <map>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// FlatParameterBuffers -- one device buffer for the values of all learnable parameters, and one for their gradients
+//
+// Each parameter's value and gradient become views into the buffers, in the order of the learnable nodes, each
+// starting at a multiple of 'alignment' elements (the gaps are zero and stay zero). Code that treats all gradients
+// alike (aggregation, the overflow check of loss scaling) can then work on one large matrix instead of many small ones.
+// For that, the buffers are also available as [spanRows x N] matrices, so that column-wise gradient quantization
+// still sees columns of moderate length.
+// Parameters on another device than the first one stay separate, as do gradients that are not dense (a Times node
+// with sparse input switches its weight gradient to sparse, which detaches it from the buffer); HasValue() and
+// HasGradient() tell which ones are in.
+// Attach() must be called again whenever the matrices may have been replaced (a model reload); when this object
+// goes away, the parameters get their own copies again.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class FlatParameterBuffers
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+    static const size_t alignment = 32;
+    static const size_t spanRows = 1024;
+
+public:
+    FlatParameterBuffers()
+        : m_deviceId(CPUDEVICE), m_valueSpan(CPUDEVICE), m_gradientSpan(CPUDEVICE)
+    {
+    }
+
+    ~FlatParameterBuffers()
+    {
+        Detach();
+    }
+
+    // move the parameters into the buffers, unless they still are in there
+    void Attach(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        std::vector<ComputationNodePtr> nodes;
+        for (const auto& nodeBase : learnableNodes)
+        {
+            auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodeBase);
+            if (node->Value().GetMatrixType() == DENSE && node->Value().GetNumElements() > 0 &&
+                (nodes.empty() || node->Value().GetDeviceId() == nodes[0]->Value().GetDeviceId()))
+                nodes.push_back(node);
+        }
+        if (IsAttached(nodes))
+            return;
+        Detach();
+        if (nodes.empty())
+            return;
+
+        m_deviceId = nodes[0]->Value().GetDeviceId();
+        size_t total = 0;
+        for (const auto& node : nodes)
+        {
+            m_layout.push_back(Slot{node, total, false});
+            total += (node->Value().GetNumElements() + alignment - 1) / alignment * alignment;
+        }
+        total = (total + spanRows - 1) / spanRows * spanRows;
+
+        m_values = make_shared<Matrix<ElemType>>(1, total, m_deviceId);
+        m_gradients = make_shared<Matrix<ElemType>>(1, total, m_deviceId);
+        m_values->SetValue(0);
+        m_gradients->SetValue(0);
+        for (auto& slot : m_layout)
+        {
+            auto& node = slot.node;
+            const size_t rows = node->Value().GetNumRows(), cols = node->Value().GetNumCols();
+            View(*m_values, slot.offset, rows, cols).SetValue(node->Value());
+            node->Value().AssignColumnSlice(*m_values, slot.offset, rows * cols);
+            node->Value().Reshape(rows, cols);
+
+            // the gradient may be shared with other nodes through the matrix pool, hence it is replaced rather than turned into a view
+            const auto& gradient = node->GradientPtr();
+            slot.hasGradient = gradient && gradient->GetMatrixType() == DENSE && gradient->GetDeviceId() == m_deviceId;
+            if (!slot.hasGradient)
+                continue;
+            if (gradient->GetNumRows() == rows && gradient->GetNumCols() == cols)
+                View(*m_gradients, slot.offset, rows, cols).SetValue(*gradient);
+            auto gradientView = make_shared<Matrix<ElemType>>(m_deviceId);
+            gradientView->AssignColumnSlice(*m_gradients, slot.offset, rows * cols);
+            gradientView->Reshape(rows, cols);
+            node->SetGradientPtr(gradientView);
+        }
+        m_valueSpan.AssignColumnSlice(*m_values, 0, total);
+        m_valueSpan.Reshape(spanRows, total / spanRows);
+        m_gradientSpan.AssignColumnSlice(*m_gradients, 0, total);
+        m_gradientSpan.Reshape(spanRows, total / spanRows);
+        BuildOffsets();
+        fprintf(stderr, "FlatParameterBuffers: %d parameters with %.1f MB of values on device %d.\n",
+                (int) m_layout.size(), total * sizeof(ElemType) / 1e6, (int) m_deviceId);
+    }
+
+    // give the parameters their own matrices again
+    void Detach()
+    {
+        for (const auto& slot : m_layout)
+        {
+            auto& node = slot.node;
+            if (IsInBuffer(node->Value(), *m_values, slot.offset))
+            {
+                Matrix<ElemType> value(node->Value().GetNumRows(), node->Value().GetNumCols(), m_deviceId);
+                value.SetValue(node->Value());
+                node->Value() = std::move(value);
+            }
+            if (slot.hasGradient && IsInBuffer(node->Gradient(), *m_gradients, slot.offset))
+            {
+                auto gradient = make_shared<Matrix<ElemType>>(node->Gradient().GetNumRows(), node->Gradient().GetNumCols(), m_deviceId);
+                gradient->SetValue(node->Gradient());
+                node->SetGradientPtr(gradient);
+            }
+        }
+        m_layout.clear();
+        m_offsets.clear();
+        m_valueSpan = Matrix<ElemType>(CPUDEVICE);
+        m_gradientSpan = Matrix<ElemType>(CPUDEVICE);
+        m_values.reset();
+        m_gradients.reset();
+    }
+
+    bool HasValue(const ComputationNodeBasePtr& node) const
+    {
+        auto iter = m_offsets.find(node.get());
+        return iter != m_offsets.end() &&
+               IsInBuffer(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(), *m_values, m_layout[iter->second].offset);
+    }
+
+    bool HasGradient(const ComputationNodeBasePtr& node) const
+    {
+        auto iter = m_offsets.find(node.get());
+        return iter != m_offsets.end() && m_layout[iter->second].hasGradient &&
+               IsInBuffer(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient(), *m_gradients, m_layout[iter->second].offset);
+    }
+
+    bool IsEmpty() const
+    {
+        return m_layout.empty();
+    }
+
+    // all values resp. gradients as one [spanRows x N] matrix
+    Matrix<ElemType>& ValueSpan()
+    {
+        return m_valueSpan;
+    }
+
+    Matrix<ElemType>& GradientSpan()
+    {
+        return m_gradientSpan;
+    }
+
+private:
+    struct Slot
+    {
+        ComputationNodePtr node;
+        size_t offset; // in elements
+        bool hasGradient;
+    };
+
+    static Matrix<ElemType> View(const Matrix<ElemType>& buffer, size_t offset, size_t rows, size_t cols)
+    {
+        Matrix<ElemType> view = buffer.ColumnSlice(offset, rows * cols);
+        view.Reshape(rows, cols);
+        return view;
+    }
+
+    static bool IsInBuffer(const Matrix<ElemType>& matrix, const Matrix<ElemType>& buffer, size_t offset)
+    {
+        return matrix.GetMatrixType() == DENSE && matrix.GetDeviceId() == buffer.GetDeviceId() &&
+               matrix.BufferPointer() == buffer.BufferPointer() + offset;
+    }
+
+    // same nodes in the same order, and all still in the buffers
+    bool IsAttached(const std::vector<ComputationNodePtr>& nodes)
+    {
+        if (nodes.size() != m_layout.size())
+            return false;
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            const auto& slot = m_layout[i];
+            if (slot.node != nodes[i] || !IsInBuffer(slot.node->Value(), *m_values, slot.offset))
+                return false;
+            // a gradient that became sparse stays out, but one that the matrix pool allocated since can come in
+            const auto& gradient = slot.node->GradientPtr();
+            if (!slot.hasGradient && gradient && gradient->GetMatrixType() == DENSE && gradient->GetDeviceId() == m_deviceId)
+                return false;
+        }
+        BuildOffsets();
+        return true;
+    }
+
+    void BuildOffsets()
+    {
+        m_offsets.clear();
+        for (size_t i = 0; i < m_layout.size(); i++)
+            m_offsets[m_layout[i].node.get()] = i;
+    }
+
+    DEVICEID_TYPE m_deviceId;
+    std::vector<Slot> m_layout;
+    std::map<const ComputationNodeBase*, size_t> m_offsets; // [node] -> index into m_layout
+    shared_ptr<Matrix<ElemType>> m_values, m_gradients;     // [1 x N], owning
+    Matrix<ElemType> m_valueSpan, m_gradientSpan;           // [spanRows x N / spanRows] views of the same
+};
+} } }
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "SimpleDistGradAggregator.h"
+#include "ReducedPrecision.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// HalfPrecisionGradAggregator -- gradient all-reduce in a 16-bit wire format, FP16 or bfloat16
+//
+// Dense gradients are converted while they are packed for MPI, reduced with an MPI operation that adds 16-bit
+// values (in float, rounding each partial sum back), and converted back when unpacked. This halves the traffic
+// of full-precision aggregation and keeps no state between minibatches, unlike quantization with residuals.
+// FP16 has the finer resolution; bfloat16 has the range of float, for gradients that may exceed 65504.
+// Sparse block-column gradients, the header exchange and buffered async aggregation are those of
+// SimpleDistGradAggregator.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class HalfPrecisionGradAggregator : public SimpleDistGradAggregator<ElemType>
+{
+    typedef SimpleDistGradAggregator<ElemType> Base;
+    UsingIDistGradAggregatorMembers;
+
+public:
+    HalfPrecisionGradAggregator(MPIWrapper* mpi, bool useBFloat16, bool useAsyncAggregation, int syncStatsTrace)
+        : Base(mpi, useAsyncAggregation, syncStatsTrace), m_useBFloat16(useBFloat16), m_sumOp(MPI_OP_NULL)
+    {
+        MPI_Op_create(useBFloat16 ? &SumBFloat16 : &SumHalves, 1 /*commutative*/, &m_sumOp) || MpiFail("MPI_Op_create");
+    }
+
+    ~HalfPrecisionGradAggregator()
+    {
+        if (m_sumOp != MPI_OP_NULL)
+            MPI_Op_free(&m_sumOp);
+    }
+
+protected:
+    void StartGradientExchange(const std::vector<Matrix<ElemType>*>& gradients, const std::vector<bool>& /*isExchanged: no exchange during backprop*/) override
+    {
+        m_packed.resize(gradients.size());
+        m_requests.assign(gradients.size(), MPI_REQUEST_NULL);
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            Matrix<ElemType>& gradient = *gradients[i];
+            if (Base::IsSparse(&gradient))
+                continue;
+            const size_t n = gradient.GetNumElements();
+            if (n == 0)
+                continue;
+            m_values.resize(n);
+            gradient.CopySection(gradient.GetNumRows(), gradient.GetNumCols(), m_values.data(), gradient.GetNumRows());
+            std::vector<uint16_t>& packed = m_packed[i];
+            packed.resize(n);
+            if (m_useBFloat16)
+            {
+                for (size_t k = 0; k < n; k++)
+                    packed[k] = FloatToBFloat16((float) m_values[k]);
+            }
+            else
+            {
+                for (size_t k = 0; k < n; k++)
+                    packed[k] = FloatToHalf((float) m_values[k]);
+            }
+            MPI_Iallreduce(MPI_IN_PLACE, packed.data(), (int) n, MPI_UNSIGNED_SHORT, m_sumOp, m_mpi->Communicator(), &m_requests[i]) || MpiFail("MPI_Iallreduce");
+        }
+
+        // (while the dense ones are in flight)
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            if (Base::IsSparse(gradients[i]))
+                Base::ExchangeSparseBlockColGradient(*gradients[i]);
+        }
+    }
+
+    void FinishGradientExchange(const std::vector<Matrix<ElemType>*>& gradients) override
+    {
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            if (m_requests[i] == MPI_REQUEST_NULL)
+                continue;
+            MPI_Wait(&m_requests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+            Matrix<ElemType>& gradient = *gradients[i];
+            const std::vector<uint16_t>& packed = m_packed[i];
+            const size_t n = packed.size();
+            m_values.resize(n);
+            if (m_useBFloat16)
+            {
+                for (size_t k = 0; k < n; k++)
+                    m_values[k] = (ElemType) BFloat16ToFloat(packed[k]);
+            }
+            else
+            {
+                for (size_t k = 0; k < n; k++)
+                    m_values[k] = (ElemType) HalfToFloat(packed[k]);
+            }
+            gradient.SetValue(gradient.GetNumRows(), gradient.GetNumCols(), gradient.GetDeviceId(), m_values.data());
+        }
+    }
+
+private:
+    // MPI_User_function: inout[k] += in[k]
+    static void SumHalves(void* in, void* inout, int* len, MPI_Datatype* /*datatype*/)
+    {
+        const uint16_t* a = (const uint16_t*) in;
+        uint16_t* b = (uint16_t*) inout;
+        for (int k = 0; k < *len; k++)
+            b[k] = FloatToHalf(HalfToFloat(a[k]) + HalfToFloat(b[k]));
+    }
+    static void SumBFloat16(void* in, void* inout, int* len, MPI_Datatype* /*datatype*/)
+    {
+        const uint16_t* a = (const uint16_t*) in;
+        uint16_t* b = (uint16_t*) inout;
+        for (int k = 0; k < *len; k++)
+            b[k] = FloatToBFloat16(BFloat16ToFloat(a[k]) + BFloat16ToFloat(b[k]));
+    }
+
+    bool m_useBFloat16;
+    MPI_Op m_sumOp;
+    std::vector<std::vector<uint16_t>> m_packed; // [i] gradient i in the wire format, reduced in place
+    std::vector<MPI_Request> m_requests;         // [i] its all-reduce
+    std::vector<ElemType> m_values;
+};
+} } }
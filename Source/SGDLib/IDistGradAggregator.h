@@ -21,6 +21,12 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int epochNumber) = 0;
 
+    // Called during backprop as soon as a gradient has its final value for this minibatch.
+    // Aggregators may start exchanging it while backprop continues; AggregateGradients() must still be called.
+    virtual void OnGradientFinal(Matrix<ElemType>* /*gradient*/)
+    {
+    }
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
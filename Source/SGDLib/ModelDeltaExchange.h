@@ -0,0 +1,298 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ModelDeltaExchange.h -- model averaging by exchanging compressed model deltas, optionally overlapped with training
+//
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "MPIWrapper.h"
+#include "MatrixQuantizerImpl.h"
+#include "ReducedPrecision.h"
+#include <climits>
+#include <list>
+#include <memory>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// ModelDeltaExchange -- the model averaging sync of SGD, on the changes of the models since the last one
+//
+// All workers keep the same reference model, the average after the last sync. Start() sends what this worker's
+// model moved away from it, d = model - reference, and Finish() adds the average of the deltas of all workers,
+// weighted by their numbers of samples as the models are in ModelAveragingSync(), to the reference; the model
+// replaces its own delta by that average: model += average - d. Called back to back, the models become the
+// reference, as with averaging the models themselves. Between the two, training can go on while MPI moves the
+// deltas (overlapped model averaging, where a sync applies the exchange started by the one before); what the
+// model learns meanwhile is kept, and goes into the next delta.
+// With numBits < 8 * sizeof(ElemType), the deltas go as FP16 (16) or through the CPU MatrixQuantizer (other widths,
+// as for 1-bit SGD), with the quantization error carried over to the next delta. Through the quantizer, parameters of
+// fewer than MinElementsToQuantize elements go unquantized (see QuantizedMatrix::SelectNumBits()). All workers unpack the same data,
+// so their references stay the same. The first Start() sends the main node's model to all workers, so that they
+// begin with the same reference.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class ModelDeltaExchange
+{
+public:
+    ModelDeltaExchange(MPIWrapper* mpi, size_t numBits, bool zeroThresholdFor1Bit)
+        : m_mpi(mpi), m_numBits(numBits), m_zeroThresholdFor1Bit(zeroThresholdFor1Bit), m_blockSize(0), m_numSamples(0), m_totalSamples(0), m_requests(2, MPI_REQUEST_NULL), m_pending(false)
+    {
+        if (numBits < 1 || numBits > 8 * sizeof(ElemType))
+            InvalidArgument("ModelDeltaExchange: the model delta bits must be in the range [1, %d].", (int) (8 * sizeof(ElemType)));
+    }
+
+    ~ModelDeltaExchange()
+    {
+        if (m_pending)
+            MPI_Waitall((int) m_requests.size(), m_requests.data(), MPI_STATUSES_IGNORE);
+    }
+
+    bool IsPending() const
+    {
+        return m_pending;
+    }
+
+    // send this worker's delta since the reference; 'numSamples' is the number of samples it trained on for it
+    void Start(const std::list<ComputationNodeBasePtr>& learnableNodes, size_t numSamples)
+    {
+        if (m_pending)
+            LogicError("ModelDeltaExchange: Start() while an exchange is pending.");
+        if (m_params.empty())
+            Setup(learnableNodes);
+
+        char* block = m_sendBuffer.data();
+        if (!FullPrecision())
+            *(size_t*) block = numSamples;
+        for (auto& param : m_params)
+        {
+            param.delta.AssignDifferenceOf(Value(param.node), param.reference);
+            param.delta.CopySection(param.delta.GetNumRows(), param.delta.GetNumCols(), param.hostDelta.BufferPointer(), param.delta.GetNumRows());
+            ElemType* values = param.hostDelta.BufferPointer();
+            const size_t n = param.hostDelta.GetNumElements();
+            if (FullPrecision())
+            {
+                ElemType* out = (ElemType*) m_sendBuffer.data() + param.offset / sizeof(ElemType);
+                for (size_t k = 0; k < n; k++)
+                    out[k] = values[k] * (ElemType) numSamples;
+            }
+            else if (param.numBits == 16)
+            {
+                ElemType* residual = param.residual.BufferPointer();
+                uint16_t* out = (uint16_t*) (block + param.offset);
+                for (size_t k = 0; k < n; k++)
+                {
+                    const ElemType value = values[k] + residual[k];
+                    out[k] = FloatToHalf((float) value);
+                    residual[k] = value - (ElemType) HalfToFloat(out[k]);
+                }
+            }
+            else if (param.numBits == 8 * sizeof(ElemType))
+                memcpy(block + param.offset, values, n * sizeof(ElemType));
+            else
+            {
+                m_quantizer->QuantizeAsync(param.hostDelta, param.residual, *param.quantized, param.residual, m_zeroThresholdFor1Bit);
+                m_quantizer->WaitQuantizeAsyncDone();
+                memcpy(block + param.offset, param.quantized->GetArray(), param.quantized->GetSize());
+            }
+        }
+
+        m_numSamples = numSamples;
+        if (FullPrecision())
+        {
+            MPI_Iallreduce(MPI_IN_PLACE, (ElemType*) m_sendBuffer.data(), (int) (m_blockSize / sizeof(ElemType)), MPIWrapper::GetDataType((ElemType*) nullptr), MPI_SUM, m_mpi->Communicator(), &m_requests[0]) || MpiFail("MPI_Iallreduce");
+            MPI_Iallreduce(&m_numSamples, &m_totalSamples, 1, MPIWrapper::GetDataType((size_t*) nullptr), MPI_SUM, m_mpi->Communicator(), &m_requests[1]) || MpiFail("MPI_Iallreduce");
+        }
+        else
+        {
+            MPI_Iallgather(m_sendBuffer.data(), (int) m_blockSize, MPI_CHAR, m_recvBuffer.data(), (int) m_blockSize, MPI_CHAR, m_mpi->Communicator(), &m_requests[0]) || MpiFail("MPI_Iallgather");
+            m_requests[1] = MPI_REQUEST_NULL;
+        }
+        m_pending = true;
+    }
+
+    // wait for the exchange and apply the average delta; returns the number of samples of all workers
+    size_t Finish()
+    {
+        if (!m_pending)
+            return 0;
+        MPI_Waitall((int) m_requests.size(), m_requests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+        m_pending = false;
+
+        const size_t numWorkers = m_mpi->NumNodesInUse();
+        std::vector<ElemType> weights(numWorkers);
+        if (!FullPrecision())
+        {
+            m_totalSamples = 0;
+            for (size_t j = 0; j < numWorkers; j++)
+                m_totalSamples += *(const size_t*) (m_recvBuffer.data() + j * m_blockSize);
+            for (size_t j = 0; j < numWorkers; j++)
+                weights[j] = m_totalSamples > 0 ? (ElemType) *(const size_t*) (m_recvBuffer.data() + j * m_blockSize) / m_totalSamples : (ElemType) 1 / numWorkers;
+        }
+
+        for (auto& param : m_params)
+        {
+            // the average delta, into hostDelta
+            ElemType* average = param.hostDelta.BufferPointer();
+            const size_t n = param.hostDelta.GetNumElements();
+            if (FullPrecision())
+            {
+                const ElemType* sum = (const ElemType*) m_sendBuffer.data() + param.offset / sizeof(ElemType);
+                // (nobody trained: the numbers of samples are 0, and so are the deltas)
+                const ElemType scale = m_totalSamples > 0 ? (ElemType) 1 / m_totalSamples : 0;
+                for (size_t k = 0; k < n; k++)
+                    average[k] = sum[k] * scale;
+            }
+            else
+            {
+                memset(average, 0, n * sizeof(ElemType));
+                for (size_t j = 0; j < numWorkers; j++)
+                {
+                    const char* block = m_recvBuffer.data() + j * m_blockSize;
+                    if (param.numBits == 16)
+                    {
+                        const uint16_t* in = (const uint16_t*) (block + param.offset);
+                        for (size_t k = 0; k < n; k++)
+                            average[k] += weights[j] * (ElemType) HalfToFloat(in[k]);
+                    }
+                    else if (param.numBits == 8 * sizeof(ElemType))
+                    {
+                        const ElemType* in = (const ElemType*) (block + param.offset);
+                        for (size_t k = 0; k < n; k++)
+                            average[k] += weights[j] * in[k];
+                    }
+                    else
+                    {
+                        memcpy(param.quantized->GetArray(), block + param.offset, param.quantized->GetSize());
+                        m_quantizer->UnquantizeAsync(*param.quantized, param.unquantized, false);
+                        m_quantizer->WaitUnquantizeAsyncDone();
+                        const ElemType* in = param.unquantized.BufferPointer();
+                        for (size_t k = 0; k < n; k++)
+                            average[k] += weights[j] * in[k];
+                    }
+                }
+            }
+
+            // model += average - delta; reference += average
+            Matrix<ElemType>& value = Value(param.node);
+            value -= param.delta;
+            param.delta.SetValue(param.delta.GetNumRows(), param.delta.GetNumCols(), param.delta.GetDeviceId(), average);
+            value += param.delta;
+            param.reference += param.delta;
+        }
+        return m_totalSamples;
+    }
+
+    // the models were changed in the same way on all workers (block momentum): they are the new reference
+    void ResetReference()
+    {
+        if (m_pending)
+            LogicError("ModelDeltaExchange: ResetReference() while an exchange is pending.");
+        for (auto& param : m_params)
+            param.reference.SetValue(Value(param.node));
+    }
+
+private:
+    struct Param
+    {
+        ComputationNodeBasePtr node;
+        size_t numBits;             // its width in the exchange
+        size_t offset;              // of its data in a worker's block
+        Matrix<ElemType> reference; // on the device of the model
+        Matrix<ElemType> delta;     // the one sent by Start(), on the device of the model
+        Matrix<ElemType> hostDelta;
+        Matrix<ElemType> residual;  // quantization error carried over
+        Matrix<ElemType> unquantized;
+        std::shared_ptr<QuantizedMatrix<ElemType>> quantized;
+
+        Param(const ComputationNodeBasePtr& node, DEVICEID_TYPE deviceId)
+            : node(node), numBits(0), offset(0), reference(deviceId), delta(deviceId), hostDelta(CPUDEVICE), residual(CPUDEVICE), unquantized(CPUDEVICE)
+        {
+        }
+    };
+
+    bool FullPrecision() const
+    {
+        return m_numBits == 8 * sizeof(ElemType);
+    }
+
+    static Matrix<ElemType>& Value(const ComputationNodeBasePtr& node)
+    {
+        return dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+    }
+
+    void Setup(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        if (!FullPrecision() && m_numBits != 16)
+            m_quantizer.reset(MatrixQuantizerImpl<ElemType>::Create(CPUDEVICE, false));
+
+        m_blockSize = FullPrecision() ? 0 : sizeof(size_t); // [numSamples][data of the parameters]
+        for (const auto& node : learnableNodes)
+        {
+            if (!node->IsParameterUpdateRequired())
+                continue;
+            Matrix<ElemType>& value = Value(node);
+            std::vector<ElemType> host(value.GetNumElements());
+            if (!host.empty())
+                value.CopySection(value.GetNumRows(), value.GetNumCols(), host.data(), value.GetNumRows());
+            m_mpi->Bcast(host.data(), host.size(), m_mpi->MainNodeRank());
+            value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), host.data());
+
+            m_params.emplace_back(node, value.GetDeviceId());
+            Param& param = m_params.back();
+            param.reference.SetValue(value);
+            param.delta.Resize(value.GetNumRows(), value.GetNumCols());
+            param.hostDelta.Resize(value.GetNumRows(), value.GetNumCols());
+            param.offset = m_blockSize;
+            param.numBits = m_numBits;
+            if (m_quantizer)
+                param.numBits = QuantizedMatrix<ElemType>::SelectNumBits(value.GetNumRows(), value.GetNumCols(), m_numBits, MinElementsToQuantize);
+            size_t bytes;
+            if (param.numBits == 8 * sizeof(ElemType))
+                bytes = value.GetNumElements() * sizeof(ElemType);
+            else
+            {
+                param.residual.Resize(value.GetNumRows(), value.GetNumCols());
+                param.residual.SetValue(0);
+                if (param.numBits == 16)
+                    bytes = value.GetNumElements() * sizeof(uint16_t);
+                else
+                {
+                    param.unquantized.Resize(value.GetNumRows(), value.GetNumCols());
+                    param.quantized = std::make_shared<QuantizedMatrix<ElemType>>(value.GetNumRows(), value.GetNumCols(), param.numBits, CPUDEVICE);
+                    bytes = QuantizedMatrix<ElemType>::QuantizedSize(value.GetNumRows(), value.GetNumCols(), param.numBits);
+                }
+            }
+            m_blockSize += (bytes + 7) / 8 * 8; // (aligned for the next parameter's values)
+        }
+        if (m_blockSize > INT_MAX)
+            RuntimeError("ModelDeltaExchange: the model is too large for one message (%.0f bytes).", (double) m_blockSize);
+        m_sendBuffer.assign(m_blockSize, 0);
+        if (!FullPrecision())
+            m_recvBuffer.assign(m_blockSize * m_mpi->NumNodesInUse(), 0);
+    }
+
+    // smaller parameters (e.g. biases) are sent unquantized: their share of the traffic is small, and their quantization error is large
+    static const size_t MinElementsToQuantize = 1024;
+
+    MPIWrapper* m_mpi;
+    size_t m_numBits;
+    bool m_zeroThresholdFor1Bit;
+    std::unique_ptr<MatrixQuantizerImpl<ElemType>> m_quantizer; // for widths other than 16 and full precision
+
+    std::list<Param> m_params;   // the learnable parameters that are updated, in order
+    size_t m_blockSize;          // bytes of a worker's data
+    std::vector<char> m_sendBuffer;
+    std::vector<char> m_recvBuffer; // [worker][m_blockSize], compressed only
+    size_t m_numSamples;
+    size_t m_totalSamples;
+    std::vector<MPI_Request> m_requests;
+    bool m_pending;
+};
+} } }
@@ -0,0 +1,209 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ReferenceOutputCache.h -- the reference network's outputs of KL-regularized adaptation, kept per frame in a side file
+//
+#pragma once
+
+#include "Basics.h"
+#include "File.h"
+#include "fileutil.h"
+#include "ComputationNode.h"
+#include "Sequences.h"
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// ReferenceOutputCache -- the top-k outputs of the reference node per frame, so that the reference network need not run
+// again on the frames it has seen (also in earlier runs on the same adaptation set)
+//
+// Frames are identified by a hash of their input columns (of all feature nodes), which does not depend on the order
+// the reader delivers them in, nor on how it cuts utterances into minibatches. This is only sound if the reference
+// output of a frame depends on the inputs of that frame alone; networks with recurrence must not use the cache.
+// Lookup() gives the cached outputs of all frames of a minibatch as dense targets, each column renormalized to sum
+// to 1 over its k entries, or fails if any frame is missing; the caller then runs the reference network and Insert()s
+// its outputs. Save() writes the cache if anything was added (aside and renamed).
+// -----------------------------------------------------------------------
+
+class ReferenceOutputCache
+{
+public:
+    ReferenceOutputCache(const std::wstring& path, size_t topK)
+        : m_path(path), m_topK(topK), m_outputDim(0), m_dirty(false)
+    {
+        if (m_topK == 0)
+            InvalidArgument("ReferenceOutputCache: topK must be positive.");
+        if (fexists(m_path.c_str()))
+            Load();
+    }
+
+    size_t Size() const { return m_keys.size(); }
+
+    // the key of each column of the minibatch; 0 for gaps
+    template <class ElemType>
+    void ComputeKeys(const std::vector<ComputationNodeBasePtr>& featureNodes, const MBLayoutPtr& pMBLayout, std::vector<uint64_t>& keys)
+    {
+        const size_t numCols = pMBLayout->GetNumCols();
+        keys.assign(numCols, fnvOffsetBasis);
+        std::vector<ElemType> host;
+        for (const auto& node : featureNodes)
+        {
+            const Matrix<ElemType>& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+            if (value.GetMatrixType() != DENSE)
+                InvalidArgument("ReferenceOutputCache: the feature input '%ls' is sparse; the cache needs dense features.", node->NodeName().c_str());
+            if (value.GetNumCols() != numCols)
+                LogicError("ReferenceOutputCache: the feature input '%ls' has %d columns, the minibatch %d.", node->NodeName().c_str(), (int) value.GetNumCols(), (int) numCols);
+            CopyToHost(value, host);
+            const size_t rows = value.GetNumRows();
+            for (size_t j = 0; j < numCols; j++)
+                keys[j] = Hash(keys[j], (const unsigned char*) &host[j * rows], rows * sizeof(ElemType));
+        }
+        ForEachColumn(pMBLayout, [&](size_t j, bool isGap)
+        {
+            keys[j] = isGap ? 0 : (keys[j] == 0 ? 1 : keys[j]);
+        });
+    }
+
+    // the cached targets [outputDim x columns] of the minibatch, on the device of 'targets'; false if a frame is not cached
+    template <class ElemType>
+    bool Lookup(const std::vector<uint64_t>& keys, size_t outputDim, Matrix<ElemType>& targets)
+    {
+        if (m_keys.empty() || outputDim != m_outputDim)
+            return false;
+        std::vector<ElemType> host(outputDim * keys.size(), 0);
+        for (size_t j = 0; j < keys.size(); j++)
+        {
+            if (keys[j] == 0) // (gap)
+                continue;
+            const auto iter = m_index.find(keys[j]);
+            if (iter == m_index.end())
+                return false;
+            const size_t entry = iter->second;
+            const float sum = std::accumulate(m_values.begin() + entry * m_topK, m_values.begin() + (entry + 1) * m_topK, 0.0f);
+            for (size_t k = 0; k < m_topK; k++)
+                host[j * outputDim + m_indices[entry * m_topK + k]] = (ElemType)(sum > 0 ? m_values[entry * m_topK + k] / sum : 0);
+        }
+        targets.SetValue(outputDim, keys.size(), targets.GetDeviceId(), host.data());
+        return true;
+    }
+
+    // add the outputs [outputDim x columns] of the frames that are not cached yet
+    template <class ElemType>
+    void Insert(const std::vector<uint64_t>& keys, const Matrix<ElemType>& outputs)
+    {
+        const size_t outputDim = outputs.GetNumRows();
+        if (m_keys.empty())
+            m_outputDim = outputDim;
+        else if (outputDim != m_outputDim)
+            InvalidArgument("ReferenceOutputCache: %ls holds outputs of dimension %d, but the reference node has %d.", m_path.c_str(), (int) m_outputDim, (int) outputDim);
+        const size_t k = std::min(m_topK, outputDim);
+        std::vector<ElemType> host;
+        CopyToHost(outputs, host);
+        std::vector<unsigned int> order(outputDim);
+        for (size_t j = 0; j < keys.size(); j++)
+        {
+            if (keys[j] == 0 || m_index.find(keys[j]) != m_index.end())
+                continue;
+            const ElemType* column = &host[j * outputDim];
+            std::iota(order.begin(), order.end(), 0);
+            std::partial_sort(order.begin(), order.begin() + k, order.end(), [column](unsigned int a, unsigned int b) { return column[a] > column[b]; });
+            m_index[keys[j]] = m_keys.size();
+            m_keys.push_back(keys[j]);
+            for (size_t i = 0; i < m_topK; i++) // (with fewer outputs than k, the rest is zero)
+            {
+                m_indices.push_back(i < k ? order[i] : 0);
+                m_values.push_back(i < k ? (float) column[order[i]] : 0.0f);
+            }
+        }
+        m_dirty = true;
+    }
+
+    void Save()
+    {
+        if (!m_dirty)
+            return;
+        const std::wstring tempFileName = m_path + L".tmp";
+        {
+            File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BRefOutputCache");
+            fstream << (size_t) 1 /*version*/ << m_topK << m_outputDim << m_keys.size();
+            fstream.PutArray(m_keys.data(), m_keys.size());
+            fstream.PutArray(m_indices.data(), m_indices.size());
+            fstream.PutArray(m_values.data(), m_values.size());
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ERefOutputCache");
+            fstream.Flush();
+        }
+        renameOrDie(tempFileName, m_path);
+        m_dirty = false;
+    }
+
+private:
+    static const uint64_t fnvOffsetBasis = 14695981039346656037ull;
+
+    // FNV-1a
+    static uint64_t Hash(uint64_t hash, const unsigned char* bytes, size_t numBytes)
+    {
+        for (size_t i = 0; i < numBytes; i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    // f(column, isGap) for all columns of the minibatch
+    template <class F>
+    static void ForEachColumn(const MBLayoutPtr& pMBLayout, const F& f)
+    {
+        const size_t numSequences = pMBLayout->GetNumParallelSequences();
+        for (size_t t = 0; t < pMBLayout->GetNumTimeSteps(); t++)
+            for (size_t s = 0; s < numSequences; s++)
+                f(t * numSequences + s, pMBLayout->IsGap(FrameRange(pMBLayout, t).Sequence(s)));
+    }
+
+    template <class ElemType>
+    static void CopyToHost(const Matrix<ElemType>& m, std::vector<ElemType>& buffer)
+    {
+        buffer.resize(m.GetNumElements());
+        if (buffer.empty())
+            return;
+        if (m.GetDeviceId() == CPUDEVICE)
+            memcpy(buffer.data(), m.BufferPointer(), buffer.size() * sizeof(ElemType));
+        else
+            m.CopySection(m.GetNumRows(), m.GetNumCols(), buffer.data(), m.GetNumRows());
+    }
+
+    void Load()
+    {
+        File fstream(m_path, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+        fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BRefOutputCache");
+        size_t version, topK, numEntries;
+        fstream >> version >> topK >> m_outputDim >> numEntries;
+        if (version != 1)
+            RuntimeError("ReferenceOutputCache: %ls has an unsupported version %d.", m_path.c_str(), (int) version);
+        if (topK != m_topK)
+            InvalidArgument("ReferenceOutputCache: %ls was made with topK = %d, not %d.", m_path.c_str(), (int) topK, (int) m_topK);
+        m_keys.resize(numEntries);
+        m_indices.resize(numEntries * m_topK);
+        m_values.resize(numEntries * m_topK);
+        fstream.GetArray(m_keys.data(), m_keys.size());
+        fstream.GetArray(m_indices.data(), m_indices.size());
+        fstream.GetArray(m_values.data(), m_values.size());
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ERefOutputCache");
+        for (size_t i = 0; i < numEntries; i++)
+            m_index[m_keys[i]] = i;
+        fprintf(stderr, "ReferenceOutputCache: read the outputs of %d frames from %ls.\n", (int) numEntries, m_path.c_str());
+    }
+
+    std::wstring m_path;
+    size_t m_topK;
+    size_t m_outputDim;
+    bool m_dirty;
+    std::vector<uint64_t> m_keys;                // [entry]
+    std::vector<unsigned int> m_indices;         // [entry * topK + k] output index of the k-th largest output
+    std::vector<float> m_values;                 // [entry * topK + k] its value
+    std::unordered_map<uint64_t, size_t> m_index; // key -> entry
+};
+} } }
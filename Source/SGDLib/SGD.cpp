@@ -13,7 +13,22 @@
 #include "AllReduceDistGradAggregator.h"
 #endif
 #include "SimpleDistGradAggregator.h"
+#include "SparseGradientAggregator.h"
+#include "BackupWorkerGradAggregator.h"
+#include "HalfPrecisionGradAggregator.h"
+#include "WorkerLoadBalancer.h"
+#include "ModelDeltaExchange.h"
+#include "AsyncParameterServer.h"
+#include "AsyncCheckpointWriter.h"
 #include "ProgressTracing.h"
+#include "NodeProfiler.h"
+#include "BackgroundEvaluator.h"
+#include "DataParallelReplicas.h"
+#include "FlatParameterBuffers.h"
+#include "ComputeGraphReplay.h"
+#include "TrainingTelemetry.h"
+#include "ReferenceOutputCache.h"
+#include "GPUWatcher.h"
 
 #include <map>
 #include <set>
@@ -40,6 +55,18 @@ void SGD<ElemType>::Train(function<ComputationNetworkPtr(DEVICEID_TYPE)> createN
                           IDataReader<ElemType>* trainSetDataReader,
                           IDataReader<ElemType>* validationSetDataReader,
                           const bool makeMode)
+{
+    TrainWithDeferredReaders(createNetworkFn, deviceId, [trainSetDataReader, validationSetDataReader]()
+                             {
+                                 return make_pair(trainSetDataReader, validationSetDataReader);
+                             },
+                             makeMode);
+}
+
+template <class ElemType>
+void SGD<ElemType>::TrainWithDeferredReaders(function<ComputationNetworkPtr(DEVICEID_TYPE)> createNetworkFn, DEVICEID_TYPE deviceId,
+                                             const function<pair<IDataReader<ElemType>*, IDataReader<ElemType>*>()>& getReadersFn,
+                                             const bool makeMode)
 {
     // determine which epoch to start with, including recoveing a checkpoint if any and 'makeMode' enabled
     int startEpoch = DetermineStartEpoch(makeMode);
@@ -50,11 +77,14 @@ void SGD<ElemType>::Train(function<ComputationNetworkPtr(DEVICEID_TYPE)> createN
     }
 
     wstring modelFileName = GetModelNameForEpoch(int(startEpoch) - 1);
+    if (startEpoch >= 0 && m_numMBsToCheckpoint > 0 && HasMidEpochCheckPoint(startEpoch))
+        modelFileName = GetMidEpochModelFileName(startEpoch);
     if (startEpoch >= 0)
         fprintf(stderr, "Starting from checkpoint. Load Network From File %ls.\n", modelFileName.c_str());
 
     // create or load from checkpoint
     shared_ptr<ComputationNetwork> net = startEpoch < 0 ? createNetworkFn(deviceId) : ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
+    m_startupTimes.networkSeconds = SecondsSinceStartup();
 
     // log the device we are computing on
     if (net->GetDeviceId() < 0)
@@ -68,7 +98,10 @@ void SGD<ElemType>::Train(function<ComputationNetworkPtr(DEVICEID_TYPE)> createN
     startEpoch = max(startEpoch, 0);
     m_needAdaptRegularization = false;
 
-    TrainOrAdaptModel(startEpoch, net, net, nullptr, trainSetDataReader, validationSetDataReader);
+    auto readers = getReadersFn();
+    m_startupTimes.readersSeconds = SecondsSinceStartup();
+    fprintf(stderr, "Startup: network ready after %.3fs; readers ready after %.3fs.\n", m_startupTimes.networkSeconds, m_startupTimes.readersSeconds);
+    TrainOrAdaptModel(startEpoch, net, net, nullptr, readers.first, readers.second);
 }
 
 // -----------------------------------------------------------------------
@@ -92,6 +125,8 @@ void SGD<ElemType>::Adapt(wstring origModelFileName, wstring refNodeName,
     if (startEpoch >= 0)
     {
         wstring modelFileName = GetModelNameForEpoch(int(startEpoch) - 1);
+        if (m_numMBsToCheckpoint > 0 && HasMidEpochCheckPoint(startEpoch))
+            modelFileName = GetMidEpochModelFileName(startEpoch);
         fprintf(stderr, "Starting from checkpoint. Load Network From File %ls.\n", modelFileName.c_str());
         net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
     }
@@ -105,6 +140,8 @@ void SGD<ElemType>::Adapt(wstring origModelFileName, wstring refNodeName,
 
     ComputationNetworkPtr refNet;
     m_needAdaptRegularization = m_adaptationRegType != AdaptationRegType::None && m_adaptationRegWeight > 0;
+    if (m_needAdaptRegularization && m_numGradientAccumulationSteps > 1)
+        InvalidArgument("Adaptation regularization cannot be combined with gradientAccumulationSteps.");
     if (m_needAdaptRegularization)
     {
         fprintf(stderr, "Load reference Network From the original model file %ls.\n", origModelFileName.c_str());
@@ -136,6 +173,25 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                       IDataReader<ElemType>* trainSetDataReader,
                                       IDataReader<ElemType>* validationSetDataReader)
 {
+    // model parallelism: spread the network over several GPUs; this changes nodes, so it comes first
+    if (!m_devicePlacement.empty() || !m_shardedTimes.empty() || !m_stageDevices.empty())
+    {
+        if (net->GetDeviceId() < 0)
+            InvalidArgument("devicePlacement: Placing nodes on several devices requires the training device to be a GPU.");
+        if (!m_localDevices.empty() || m_numCPUReplicas > 1)
+            InvalidArgument("devicePlacement: Placing nodes on several devices cannot be combined with localDevices or numCPUReplicas.");
+        // stages first, so that explicit placements can refine them; the training device runs the last stage
+        vector<pair<wstring, DEVICEID_TYPE>> placement;
+        if (!m_stageDevices.empty())
+        {
+            vector<DEVICEID_TYPE> stageDevices(m_stageDevices.begin(), m_stageDevices.end());
+            stageDevices.push_back(net->GetDeviceId());
+            placement = net->PartitionIntoStages(GetTrainCriterionNodes(net)[0], stageDevices);
+        }
+        placement.insert(placement.end(), m_devicePlacement.begin(), m_devicePlacement.end());
+        net->PlaceNodesOnDevices<ElemType>(placement, m_shardedTimes);
+    }
+
     auto& featureNodes = net->FeatureNodes();
     auto& labelNodes = net->LabelNodes();
     auto& criterionNodes = GetTrainCriterionNodes(net);
@@ -171,6 +227,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     additionalNodesToEvaluate.insert(additionalNodesToEvaluate.end(), preComputeNodesList.cbegin(), preComputeNodesList.cend());
 
     // allocate memory for forward and backward computation
+    net->SetRecomputeSegmentLength(m_recomputeSegmentLength);
+    net->SetOffloadActivations(m_offloadActivations);
     net->AllocateAllMatrices(evaluationNodes, additionalNodesToEvaluate, criterionNodes[0]);
 
     // get feature and label nodes into an array of matrices that will be passed to GetMinibatch()
@@ -220,6 +278,16 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
         // allocate memory for forward computation
         refNet->AllocateAllMatrices({refNode}, {}, nullptr);
+
+        if (!m_adaptationRefCache.empty())
+        {
+            if (!refNet->GetNodesWithType(L"PastValue", refNode).empty() || !refNet->GetNodesWithType(L"FutureValue", refNode).empty())
+                InvalidArgument("adaptationRefCache: The reference network is recurrent; its outputs cannot be cached per frame.");
+            wstring cacheFile = m_adaptationRefCache;
+            if (g_mpi && g_mpi->NumNodesInUse() > 1) // (every worker sees frames of its own)
+                cacheFile += L".rank" + std::to_wstring(g_mpi->CurrentNodeRank());
+            m_referenceOutputCache = make_shared<ReferenceOutputCache>(cacheFile, m_adaptationRefCacheTopK);
+        }
     }
 
     // initializing weights and gradient holder
@@ -227,12 +295,40 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     auto& learnableNodes = net->LearnableParameterNodes(criterionNodes[0]);
     std::list<Matrix<ElemType>> smoothedGradients;
 
+    size_t numHostOptimizerStates = 0;
     for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
     {
         ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+        DEVICEID_TYPE stateDeviceId = node->Value().GetDeviceId(); // (with model parallelism, not necessarily the network's device)
+        if (m_hostOptimizerState && stateDeviceId >= 0 && node->Value().GetNumElements() >= m_hostOptimizerStateMinElements)
+        {
+            stateDeviceId = CPUDEVICE;
+            numHostOptimizerStates++;
+        }
+        ScopedMemoryTag memoryTag(MemoryTag::OptimizerState);
         smoothedGradients.push_back(Matrix<ElemType>(node->Value().GetNumRows(),
                                                      node->Value().GetNumCols(),
-                                                     net->GetDeviceId()));
+                                                     stateDeviceId));
+        if (stateDeviceId != node->Value().GetDeviceId())
+            smoothedGradients.back().SetValue(0);
+    }
+    if (numHostOptimizerStates > 0)
+        fprintf(stderr, "The smoothed gradients of %d parameters are kept in host memory, and these parameters are updated there.\n", (int) numHostOptimizerStates);
+
+    // find the largest minibatch that fits into the GPU, from the memory plan of the network and what the model left free
+    // (The remaining fraction is headroom for what the plan does not cover, e.g. convolution workspaces and the reader's buffers.)
+    if (m_autoMaxSamplesInRAM && net->GetDeviceId() >= 0 && m_localDevices.empty() && m_stageDevices.empty() && m_numGradientAccumulationSteps <= 1)
+    {
+        const size_t bytesPerSample = net->GetPlannedBytesPerSample();
+        const size_t freeBytes = GPUWatcher::GetFreeMemoryOnCUDADevice(net->GetDeviceId());
+        const size_t usableBytes = (size_t) (freeBytes * m_autoMaxSamplesInRAMMemoryFraction);
+        if (bytesPerSample > 0 && usableBytes > 0)
+        {
+            const size_t maxSamples = max((size_t) 1, usableBytes / bytesPerSample);
+            m_maxSamplesInRAM = min(m_maxSamplesInRAM, maxSamples);
+            fprintf(stderr, "autoMaxSamplesInRAM: %d MB of GPU memory free, %d bytes planned per sample: maxSamplesInRAM = %d.\n",
+                    (int) (freeBytes >> 20), (int) bytesPerSample, (int) m_maxSamplesInRAM);
+        }
     }
 
     double epochCriterion, avgCriterion, prevCriterion, lrControlCriterion;
@@ -258,12 +354,19 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         prevLearnRates[i] = -1.0;
     }
 
+    if (g_mpi != nullptr)
+        g_mpi->SetAllReduceAlgorithm(m_allReduceAlgorithm);
+    if (m_elasticTraining)
+        g_mpi->EnableFaultTolerance();
     if (m_parallelizationMethod == ParallelizationMethod::DataParallelSGD)
     {
         InitDistGradAgg(evaluationNodes.size(), m_traceLevel);
     }
+    // (Train() and Adapt() loaded the model of the mid-epoch checkpoint then)
+    const bool resumeWithinEpoch = m_numMBsToCheckpoint > 0 && HasMidEpochCheckPoint(startEpoch);
+
     // precompute mean and invStdDev nodes and save initial model
-    if (PreCompute(net, trainSetDataReader, featureNodes, labelNodes, inputMatrices) || startEpoch == 0)
+    if ((PreCompute(net, trainSetDataReader, featureNodes, labelNodes, inputMatrices) || startEpoch == 0) && !resumeWithinEpoch)
     {
         // Synchronize all ranks before writing the model to ensure that
         // everyone is done loading the model
@@ -275,6 +378,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         net->Save(GetModelNameForEpoch(int(startEpoch) - 1));
     }
 
+    if (m_asyncCheckpointing && ((g_mpi == nullptr) || g_mpi->IsMainNode()))
+        m_checkpointWriter = make_shared<AsyncCheckpointWriter>(m_checkpointStagingDir);
+
     bool learnRateInitialized = false;
     if (startEpoch > 0)
     {
@@ -287,6 +393,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         if (learnRateInitialized)
             prevLearnRates[startEpoch % m_numPrevLearnRates] = learnRatePerSample;
     }
+    if (resumeWithinEpoch && LoadMidEpochCheckPoint(startEpoch, smoothedGradients))
+        fprintf(stderr, "Resuming Epoch %d after %d minibatches (%d samples) from %ls.\n",
+                startEpoch + 1, (int) m_midEpochResume.numMBsRun, (int) m_midEpochResume.epochSamples, GetMidEpochModelFileName(startEpoch).c_str());
 
     if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::AdjustAfterEpoch &&
         !learnRateInitialized && m_learningRatesParam.size() <= startEpoch)
@@ -315,6 +424,69 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                                   m_seqGammarCalcAMF, m_seqGammarCalcLMF, m_seqGammarCalcWP, m_seqGammarCalcbMMIFactor, m_seqGammarCalcUsesMBR);
     }
 
+    // per-node profile of the training minibatches, reported at the end of every epoch
+    shared_ptr<NodeProfiler> nodeProfiler;
+    if (m_profileNodes)
+    {
+        const bool writeTrace = (g_mpi == nullptr) || g_mpi->IsMainNode();
+        nodeProfiler = make_shared<NodeProfiler>(net->GetDeviceId(), writeTrace ? m_nodeProfileTrace : L"", m_nodeProfileTraceMinibatches);
+    }
+
+    // cross-validation in the background, on the main node only, overlapped with the next epoch
+    shared_ptr<BackgroundEvaluator<ElemType>> backgroundEvaluator;
+    if (m_asyncCrossValidation && validationSetDataReader != nullptr && validationSetDataReader != trainSetDataReader && ((g_mpi == nullptr) || g_mpi->IsMainNode()))
+    {
+        const DEVICEID_TYPE cvDeviceId = m_asyncCrossValidationDeviceId == DEVICEID_NOTYETDETERMINED ? net->GetDeviceId() : m_asyncCrossValidationDeviceId;
+        const wstring snapshotPath = m_modelPath + L".cvSnapshot";
+        backgroundEvaluator = make_shared<BackgroundEvaluator<ElemType>>(cvDeviceId, m_checkpointWriter ? m_checkpointWriter->StagingPath(snapshotPath) : snapshotPath);
+        fprintf(stderr, "Cross-validation runs in the background on device %d; the learning-rate control uses its result one epoch late.\n", (int) cvDeviceId);
+    }
+
+    // replicas of the network on the other local GPUs, or on groups of CPU cores, which share every minibatch with the main network
+    if (!m_localDevices.empty() || m_numCPUReplicas > 1)
+    {
+        const bool onCPU = m_localDevices.empty();
+        const char* what = onCPU ? "numCPUReplicas: Training with several CPU replicas" : "localDevices: Training on several local GPUs";
+        if (!onCPU && net->GetDeviceId() < 0)
+            InvalidArgument("%s requires the training device to be a GPU.", what);
+        if (onCPU && net->GetDeviceId() >= 0)
+            InvalidArgument("%s requires the training device to be the CPU.", what);
+        if (!onCPU && m_numCPUReplicas > 1)
+            InvalidArgument("localDevices and numCPUReplicas cannot be combined.");
+        // (Across MPI ranks, the replicas combine with model averaging and BMUF only: one rank per machine then aggregates
+        // the gradients of its GPUs exactly every minibatch and averages the models with the other machines every few.)
+        if (m_parallelizationMethod != ParallelizationMethod::None && m_parallelizationMethod != ParallelizationMethod::ModelAveragingSGD &&
+            m_parallelizationMethod != ParallelizationMethod::BlockMomentumSGD)
+            InvalidArgument("%s can only be combined with ModelAveragingSGD or BlockMomentumSGD across MPI ranks.", what);
+        if (m_maxSamplesInRAM < SIZE_MAX || m_numSubminiBatches > 1)
+            InvalidArgument("%s cannot be combined with sub-minibatching.", what);
+        if (isSequenceTrainingCriterion || (m_needAdaptRegularization && m_adaptationRegType == AdaptationRegType::KL && refNode))
+            InvalidArgument("%s is not supported for sequence training or KL-regularized adaptation.", what);
+        std::vector<DEVICEID_TYPE> replicaDevices(m_localDevices.begin(), m_localDevices.end());
+        std::vector<std::vector<int>> coreGroups;
+        if (onCPU)
+        {
+            const size_t coresPerReplica = m_cpuCoresPerReplica > 0 ? m_cpuCoresPerReplica : max((size_t) 1, (size_t) std::thread::hardware_concurrency() / m_numCPUReplicas);
+            for (size_t k = 0; k < m_numCPUReplicas; k++)
+                coreGroups.push_back(CPUThreadBudget::AllocateCores(coresPerReplica));
+            replicaDevices.assign(m_numCPUReplicas - 1, CPUDEVICE);
+        }
+        m_dataParallelReplicas = make_shared<DataParallelReplicas<ElemType>>(net, replicaDevices, coreGroups, m_modelPath + L".replicaSnapshot",
+                                                                              criterionNodes, evaluationNodes, learnableNodes,
+                                                                              m_recomputeSegmentLength, m_offloadActivations, m_maxTempMemSizeInSamplesForCNN);
+        if (onCPU)
+            fprintf(stderr, "Training with %d network replicas in this process, on %d CPU cores each%s.\n",
+                    (int) m_dataParallelReplicas->NumReplicas(), (int) coreGroups[0].size(),
+                    m_parallelizationMethod != ParallelizationMethod::None ? ", and model averaging across the MPI ranks" : "");
+        else
+            fprintf(stderr, "Training with %d network replicas in this process, on the training GPU and %d more%s.\n",
+                    (int) m_dataParallelReplicas->NumReplicas(), (int) replicaDevices.size(),
+                    m_parallelizationMethod != ParallelizationMethod::None ? ", and model averaging across the MPI ranks" : "");
+    }
+
+    if (m_flatParameterBuffers)
+        m_flatParameters = make_shared<FlatParameterBuffers<ElemType>>();
+
     // --- MAIN EPOCH LOOP
     for (int i = startEpoch; i < (int) m_maxEpochs; i++) // TODO: why is this an int, and not a size_t?
     {
@@ -331,8 +503,15 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // set dropout rate for this epoch
         ComputationNetwork::SetDropoutRate<ElemType>(net, criterionNodes[0], m_dropoutRates[i], prevDropoutRate, dropOutSeed);
 
+        // a resumed epoch continues with the learning rate and minibatch size it began with
+        const bool resumingEpoch = m_midEpochResume.numReaderMinibatches > 0 && i == m_midEpochResume.epoch;
+
         // learning rate adjustment
-        if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::None || i < m_learningRatesParam.size())
+        if (resumingEpoch)
+        {
+            learnRatePerSample = m_midEpochResume.learnRatePerSample;
+        }
+        else if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::None || i < m_learningRatesParam.size())
         {
             // BUGBUG: GetNumParallelSequences() returns 1 under certain situations; it seems when restarting from checkpoint
             learnRatePerSample = GetLearningRatePerSample(i /*BUGBUG workaround:*/, trainSetDataReader->GetNumParallelSequences());
@@ -366,6 +545,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     i + 1, learnRatePerSample, m_minLearnRate);
             if (m_autoLearnRateSearchType != LearningRateSearchAlgorithm::None)
             {
+                WaitForCheckpointWriter();
                 net->Save(m_modelPath);
             }
             break;
@@ -378,7 +558,11 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // basis for a set number of epochs.  For epochs after that point, m_mbSize.size(), either
         // we just keep using
         // the last minibatch size, or we use tuning to try and find a better one.
-        if (m_autoAdjustMinibatch && i >= m_mbSize.size())
+        if (resumingEpoch)
+        {
+            chosenMinibatchSize = m_midEpochResume.minibatchSize;
+        }
+        else if (m_autoAdjustMinibatch && i >= m_mbSize.size())
         {
             size_t numFramesToUseInSearch = m_numMiniBatch4LRSearch[i] * m_mbSize[i];
             if (m_epochSize != requestDataSize)
@@ -413,21 +597,60 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         fprintf(stderr, "Starting Epoch %d: learning rate per sample = %f  effective momentum = %f  momentum as time constant = %.1f samples\n",
                 i + 1, learnRatePerSample, MomentumPerMB(momentumPerSample, actualMinibatchSize), momentumAsTimeConstant);
 
-        TrainOneEpoch(net,
-                      refNet,
-                      refNode,
-                      i,
-                      m_epochSize,
-                      trainSetDataReader,
-                      learnRatePerSample,
-                      chosenMinibatchSize,
-                      featureNodes,
-                      labelNodes,
-                      criterionNodes,
-                      evaluationNodes,
-                      inputMatrices,
-                      learnableNodes, smoothedGradients,
-                      epochCriterion, epochEvalErrors, totalSamplesSeen);
+        net->SetNodeProfiler(nodeProfiler);
+        MatrixTransferMonitor::SetMode(m_matrixTransferMonitor);
+        const size_t epochStartSamplesSeen = totalSamplesSeen;
+        if (m_elasticTraining)
+            SnapshotEpochStart(learnableNodes, smoothedGradients);
+        for (;;)
+        {
+            try
+            {
+                TrainOneEpoch(net,
+                              refNet,
+                              refNode,
+                              i,
+                              m_epochSize,
+                              trainSetDataReader,
+                              learnRatePerSample,
+                              chosenMinibatchSize,
+                              featureNodes,
+                              labelNodes,
+                              criterionNodes,
+                              evaluationNodes,
+                              inputMatrices,
+                              learnableNodes, smoothedGradients,
+                              epochCriterion, epochEvalErrors, totalSamplesSeen);
+                break;
+            }
+            catch (const MpiRankLoss& e) // (only with elastic training)
+            {
+                RecoverFromRankLoss(e, i, learnableNodes, smoothedGradients, (int) evaluationNodes.size());
+                totalSamplesSeen = epochStartSamplesSeen;
+            }
+        }
+        net->SetNodeProfiler(nullptr);
+        MatrixTransferMonitor::SetMode(MatrixTransferMonitor::Mode::off);
+        if (m_referenceOutputCache)
+            m_referenceOutputCache->Save();
+
+        if (m_maxSamples > 0 && totalSamplesSeen == epochStartSamplesSeen)
+        {
+            fprintf(stderr, "Epoch[%d] got no data. Training complete after %d samples.\n", i + 1, (int) totalSamplesSeen);
+            WaitForCheckpointWriter();
+            if ((g_mpi == nullptr) || g_mpi->IsMainNode())
+                net->Save(m_modelPath);
+            break;
+        }
+
+        if (IsBenchmarkDone())
+        {
+            ReportBenchmark(net->GetDeviceId());
+            WaitForCheckpointWriter();
+            if ((g_mpi == nullptr) || g_mpi->IsMainNode())
+                net->Save(m_modelPath);
+            break;
+        }
 
         timer.Stop();
         double epochTime = timer.ElapsedSeconds();
@@ -478,12 +701,18 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                         i + 1, (int) m_maxEpochs, evalNodeNames[j].c_str(), epochEvalErrors[j]);
             }
         }
-
-        if ((g_mpi == nullptr) || g_mpi->IsMainNode())
+        if (nodeProfiler)
+            nodeProfiler->PrintReport(msra::strfun::strprintf("of epoch %d", i + 1).c_str());
+        if (m_matrixTransferMonitor != MatrixTransferMonitor::Mode::off)
+            MatrixTransferMonitor::Report(msra::strfun::strprintf("of epoch %d", i + 1).c_str());
+
+        // with distributed reading, all workers take part in cross-validation, each on its own share of the data
+        const bool useDistributedCV = m_enableDistributedMBReading && !m_asyncCrossValidation && g_mpi != nullptr && g_mpi->NumNodesInUse() > 1 &&
+                                      validationSetDataReader != nullptr && validationSetDataReader->SupportsDistributedMBRead();
+        if ((g_mpi == nullptr) || g_mpi->IsMainNode() || useDistributedCV)
         {
             if (validationSetDataReader != trainSetDataReader && validationSetDataReader != nullptr)
             {
-                SimpleEvaluator<ElemType> evalforvalidation(net);
                 vector<wstring> cvSetTrainAndEvalNodes;
                 if (criterionNodes.size() > 0)
                 {
@@ -494,15 +723,23 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     cvSetTrainAndEvalNodes.push_back(evaluationNodes[0]->NodeName());
                 }
 
-                vector<double> vScore = evalforvalidation.Evaluate(validationSetDataReader, cvSetTrainAndEvalNodes, m_mbSize[i]);
-                fprintf(stderr, "Finished Epoch[%2d of %d]: [Validation Set] TrainLossPerSample = %.8g", i + 1, (int) m_maxEpochs, vScore[0]);
-                if (vScore.size() > 1)
+                vector<double> vScore;
+                int cvEpoch = i;
+                if (backgroundEvaluator)
                 {
-                    fprintf(stderr, "; EvalErrPerSample = %.8g", vScore[1]);
+                    // pick up the result for the previous epoch's model, which was evaluated while this epoch trained
+                    cvEpoch = backgroundEvaluator->Wait(vScore);
+                    backgroundEvaluator->StartAsync(net, i, validationSetDataReader, cvSetTrainAndEvalNodes, m_mbSize[i]);
                 }
-                fprintf(stderr, "\n");
+                else
+                {
+                    SimpleEvaluator<ElemType> evalforvalidation(net, 100, 0, useDistributedCV);
+                    vScore = evalforvalidation.Evaluate(validationSetDataReader, cvSetTrainAndEvalNodes, m_mbSize[i]);
+                }
+                if (cvEpoch >= 0)
+                    PrintCrossValidationResult(cvEpoch, vScore);
 
-                if (m_useCVSetControlLRIfCVExists)
+                if (m_useCVSetControlLRIfCVExists && cvEpoch >= 0)
                 {
                     if (m_useEvalCriterionControlLR && vScore.size() > 1)
                     {
@@ -517,7 +754,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         }
 
         // broadcast epochCriterion to make sure each processor will have the same learning rate schedule
-        if ((m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD) && (g_mpi->NumNodesInUse() > 1))
+        if ((m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD || m_parallelizationMethod == ParallelizationMethod::BlockMomentumSGD ||
+             m_parallelizationMethod == ParallelizationMethod::AsyncParameterServerSGD) && (g_mpi->NumNodesInUse() > 1))
         {
             g_mpi->Bcast(&epochCriterion, 1, g_mpi->MainNodeRank());
             g_mpi->Bcast(&lrControlCriterion, 1, g_mpi->MainNodeRank());
@@ -546,6 +784,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                 {
                     auto bestModelPath = GetModelNameForEpoch(i - m_learnRateAdjustInterval);
                     fprintf(stderr, "Loading previous model with best training-criterion value: %ls.\n", bestModelPath.c_str());
+                    WaitForCheckpointWriter();
                     net->RereadPersistableParameters<ElemType>(bestModelPath);
                     LoadCheckPointInfo(i - m_learnRateAdjustInterval,
                                        /*out*/ totalSamplesSeen,
@@ -569,6 +808,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     }
                     else
                     {
+                        WaitForCheckpointWriter();
                         net->Save(GetModelNameForEpoch(i, true));
 
                         fprintf(stderr, "Finished training and saved final model\n\n");
@@ -624,8 +864,13 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // persist model and check-point info
         if ((g_mpi == nullptr) || g_mpi->IsMainNode())
         {
-            net->Save(GetModelNameForEpoch(i));
+            const wstring modelFileName = GetModelNameForEpoch(i);
+            if (m_checkpointWriter)
+                m_checkpointWriter->Wait(); // (staging files are reused)
+            SaveEpochModel(net, learnableNodes, i, m_checkpointWriter ? m_checkpointWriter->StagingPath(modelFileName) : modelFileName);
             SaveCheckPointInfo(i, totalSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize);
+
+            vector<wstring> obsoleteCheckPointFiles;
             if (!m_keepCheckPointFiles)
             {
                 // delete previous checkpoint file to save space
@@ -633,18 +878,32 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                 {
                     if (epochsSinceLastLearnRateAdjust != 1)
                     {
-                        _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                        obsoleteCheckPointFiles.push_back(GetCheckPointFileNameForEpoch(i - 1));
                     }
                     if (epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
                     {
-                        _wunlink(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval).c_str());
+                        obsoleteCheckPointFiles.push_back(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval));
                     }
                 }
                 else
                 {
-                    _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                    obsoleteCheckPointFiles.push_back(GetCheckPointFileNameForEpoch(i - 1));
                 }
             }
+            if (m_numMBsToCheckpoint > 0) // the mid-epoch checkpoint is superseded by the model of the epoch
+            {
+                obsoleteCheckPointFiles.push_back(GetMidEpochModelFileName(i) + L".ckp");
+                obsoleteCheckPointFiles.push_back(GetMidEpochModelFileName(i));
+            }
+
+            // the checkpoint goes last, so that its presence implies the model's
+            if (m_checkpointWriter)
+                m_checkpointWriter->PublishAsync(vector<wstring>{modelFileName, GetCheckPointFileNameForEpoch(i)}, obsoleteCheckPointFiles);
+            else
+            {
+                for (const auto& file : obsoleteCheckPointFiles)
+                    _wunlink(file.c_str());
+            }
         }
 
         if (learnRatePerSample < 1e-12)
@@ -655,6 +914,16 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     }
     // --- END OF MAIN EPOCH LOOP
 
+    if (backgroundEvaluator && backgroundEvaluator->IsPending())
+    {
+        vector<double> vScore;
+        const int cvEpoch = backgroundEvaluator->Wait(vScore);
+        PrintCrossValidationResult(cvEpoch, vScore);
+    }
+    WaitForCheckpointWriter();
+    m_dataParallelReplicas.reset();
+    m_flatParameters.reset(); // (the parameters get their own matrices again)
+
     // Synchronize all ranks before proceeding to ensure that
     // rank 0 has finished writing the model file
     if (g_mpi != nullptr)
@@ -726,11 +995,13 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     localEpochCriterion.SetValue(0);
     localEpochEvalErrors.SetValue(0);
 
-    bool useGradientAggregation = ((m_parallelizationMethod == ParallelizationMethod::DataParallelSGD) &&
-                                   (epochNumber >= m_parallelizationStartEpochNum));
-    bool useModelAveraging = ((m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD) &&
-                              (epochNumber >= m_parallelizationStartEpochNum));
-    bool useParallelTrain = useGradientAggregation || useModelAveraging;
+    const bool parallelEpoch = epochNumber >= m_parallelizationStartEpochNum && !m_trainOnThisRankOnly;
+    bool useGradientAggregation = ((m_parallelizationMethod == ParallelizationMethod::DataParallelSGD) && parallelEpoch);
+    // (block momentum is model averaging with a different update of the averaged model)
+    bool useModelAveraging = ((m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD || m_parallelizationMethod == ParallelizationMethod::BlockMomentumSGD) &&
+                              parallelEpoch);
+    bool useParameterServer = ((m_parallelizationMethod == ParallelizationMethod::AsyncParameterServerSGD) && parallelEpoch);
+    bool useParallelTrain = useGradientAggregation || useModelAveraging || useParameterServer;
 
     // MA-related variables
     size_t nSamplesSinceLastModelSync = 0;
@@ -745,22 +1016,89 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         epochEvalErrors.assign(epochEvalErrors.size(), double(0.0));
     }
 
+    // parameter-server related variables
+    std::vector<Matrix<ElemType>*> learnParamsValues;
+    if (useParameterServer)
+    {
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
+        {
+            ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+            if (node->IsParameterUpdateRequired())
+                learnParamsValues.push_back(&node->Value());
+        }
+        if (m_parameterServer == nullptr)
+            m_parameterServer = new AsyncParameterServer<ElemType>(g_mpi, m_numParameterServers, m_parameterServerSyncFrequencyInMBs, m_maxStaleness);
+        m_parameterServer->Initialize(learnParamsValues);
+    }
+
     Profiler profiler(m_numMBsToCUDAProfile);
 
     // resetting this, so profiling is performed for one epoch only
     m_numMBsToCUDAProfile = 0;
 
+    // with gradient accumulation, the reader delivers micro-batches, and a model update happens every numAccumulationSteps of them
+    const size_t numAccumulationSteps = m_numGradientAccumulationSteps;
+    const size_t readerMBSize = (tunedMBSize + numAccumulationSteps - 1) / numAccumulationSteps;
+    Matrix<ElemType> accumulatedCriterion(1, 1, net->GetDeviceId());
+    Matrix<ElemType> accumulatedEvalErrors(1, epochEvalErrors.size(), net->GetDeviceId());
+
     bool useDistributedMBReading = useParallelTrain &&
                                    m_enableDistributedMBReading &&
                                    trainSetDataReader->SupportsDistributedMBRead();
     if (useDistributedMBReading)
     {
-        trainSetDataReader->StartDistributedMinibatchLoop(tunedMBSize, epochNumber, g_mpi->CurrentNodeRank(),
+        trainSetDataReader->StartDistributedMinibatchLoop(readerMBSize, epochNumber, g_mpi->CurrentNodeRank(),
                                                           g_mpi->NumNodesInUse(), epochSize);
     }
     else
     {
-        trainSetDataReader->StartMinibatchLoop(tunedMBSize, epochNumber, epochSize);
+        trainSetDataReader->StartMinibatchLoop(readerMBSize, epochNumber, epochSize);
+    }
+    // load balancing splits the minibatches that every worker reads in full, by the shares of the workers
+    // (a reader's distributed reading gives equal parts)
+    if (useGradientAggregation && !useDistributedMBReading && m_loadBalancingWindow > 0 && !m_loadBalancer)
+        m_loadBalancer = make_shared<WorkerLoadBalancer>(g_mpi, m_loadBalancingWindow);
+    const std::vector<double>* workerShares = (useGradientAggregation && !useDistributedMBReading && m_loadBalancer) ? &m_loadBalancer->Shares() : nullptr;
+
+    // resuming from a mid-epoch checkpoint: move the reader to where it was, and restore the statistics of the epoch so far
+    // The randomization of an epoch only depends on the epoch number, so the reader's position is the number of minibatches
+    // read from it. Readers that cannot seek read them and drop them.
+    size_t numReaderMinibatches = 0;
+    if (m_midEpochResume.numReaderMinibatches > 0 && m_midEpochResume.epoch == epochNumber && prefixMsg.empty())
+    {
+        numReaderMinibatches = m_midEpochResume.numReaderMinibatches;
+        if (!trainSetDataReader->SkipMinibatches(numReaderMinibatches))
+        {
+            for (size_t k = 0; k < numReaderMinibatches; k++)
+            {
+                if (!trainSetDataReader->GetMinibatch(*inputMatrices))
+                    break;
+                trainSetDataReader->DataEnd(EndDataType::endDataSentence);
+            }
+        }
+        numMBsRun = (int) m_midEpochResume.numMBsRun;
+        totalEpochSamples = m_midEpochResume.epochSamples;
+        totalSamplesSeen += m_midEpochResume.epochSamples;
+        // the criteria of the checkpoint are summed over the workers; all but the main node resume from 0
+        const bool restoreCriteria = useGradientAggregation || !(useModelAveraging || useParameterServer) || g_mpi == nullptr || g_mpi->IsMainNode();
+        if (useGradientAggregation)
+        {
+            epochCriterion = m_midEpochResume.criterion;
+            epochEvalErrors = m_midEpochResume.evalErrors;
+        }
+        else if (restoreCriteria)
+        {
+            localEpochCriterion.SetValue((ElemType) m_midEpochResume.criterion);
+            std::vector<ElemType> evalErrors(m_midEpochResume.evalErrors.begin(), m_midEpochResume.evalErrors.end());
+            if (!evalErrors.empty())
+                localEpochEvalErrors.SetValue(1, evalErrors.size(), net->GetDeviceId(), evalErrors.data());
+        }
+        if (restoreCriteria)
+        {
+            epochCriterionLastMBs = m_midEpochResume.criterion;
+            epochEvalErrorsLastMBs = m_midEpochResume.evalErrors;
+        }
+        m_midEpochResume.numReaderMinibatches = 0; // (once)
     }
 
     net->StartEvaluateMinibatchLoop(evaluationNodes);
@@ -769,6 +1107,13 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     {
         refNet->StartEvaluateMinibatchLoop(refNode);
     }
+    std::vector<uint64_t> refOutputKeys;                   // with m_referenceOutputCache: the frames of the minibatch
+    Matrix<ElemType> cachedRefOutputs(net->GetDeviceId()); // and their reference outputs, if all are cached
+    // (again each epoch, since a reloaded model brings new matrices)
+    if (m_flatParameters)
+        m_flatParameters->Attach(learnableNodes);
+    if (m_dataParallelReplicas)
+        m_dataParallelReplicas->StartEpoch(learnableNodes, m_dropoutRates[epochNumber]);
 
     // prepare for sub-minibatching
     // Sub-minibatching is used if a single minibatch is too large to fit into GPU RAM.
@@ -801,6 +1146,40 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     // TODO: move the two-forward-pass support out of the reader, make a first-class citizen.
     AttemptUtteranceDerivativeFeatures(net, trainSetDataReader, featureNodes, inputMatrices);
 
+    // read minibatches ahead on a background thread
+    // Not for sequence training, which needs the lattices of the minibatch just read.
+    std::unique_ptr<DataReaderHelpers::MinibatchPrefetcher<ElemType>> prefetcher;
+    if (m_prefetchMinibatches && criterionNodes[0]->OperationName() != L"SequenceWithSoftmax")
+        prefetcher.reset(new DataReaderHelpers::MinibatchPrefetcher<ElemType>(*trainSetDataReader, *inputMatrices));
+
+    // replay forward and backward prop as CUDA graphs while the minibatches look alike
+    // Only where a step is nothing but the network's own GPU work, without nodes whose work depends on changing host state.
+    std::unique_ptr<ComputeGraphReplay> graphReplay;
+    if (m_useCUDAGraphs)
+    {
+        if (!ComputeGraphs::IsSupported(net->GetDeviceId()))
+            fprintf(stderr, "TrainOneEpoch: WARNING: cudaGraphs needs a GPU and CUDA 10 or later; ignored.\n");
+        else if (useGradientAggregation || m_dataParallelReplicas || numSubminibatchesNeeded > 1 || numAccumulationSteps > 1 || m_profileNodes ||
+                 (m_needAdaptRegularization && refNode) || !net->GetNodesWithType(L"Dropout").empty() || !net->GetNodesWithType(L"BatchNormalization").empty())
+            fprintf(stderr, "TrainOneEpoch: WARNING: cudaGraphs is not supported with parallel training, sub-minibatches, gradient accumulation, node profiling, KL adaptation, dropout or batch normalization; ignored.\n");
+        else
+            graphReplay.reset(new ComputeGraphReplay(net->GetDeviceId()));
+    }
+
+    // device statistics and the time of each section of the training step with each progress line; with several workers,
+    // each writes a metrics file of its own, and with gradient aggregation (where they run in lockstep) the main node a summary
+    // With replicas or CUDA graphs, forward and backward prop are timed together, as forward.
+    std::unique_ptr<TrainingTelemetry> telemetry;
+    if (m_traceTelemetry)
+    {
+        const size_t rank = g_mpi ? g_mpi->CurrentNodeRank() : 0;
+        wstring metricsFile = m_telemetryFile;
+        if (!metricsFile.empty() && g_mpi && g_mpi->NumNodesInUse() > 1)
+            metricsFile += L".rank" + std::to_wstring(rank);
+        telemetry.reset(new TrainingTelemetry(net->GetDeviceId(), rank, metricsFile, !m_profileNodes /*(NodeProfiler uses the timing events)*/));
+    }
+    const bool timeForwardBackwardApart = telemetry && !graphReplay;
+
     fprintf(stderr, "\nStarting minibatch loop");
     if (useGradientAggregation)
     {
@@ -811,10 +1190,23 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             fprintf(stderr, ", BufferedAsyncGradientAggregation is ENABLED");
         }
     }
+    if (useModelAveraging && m_parallelizationMethod == ParallelizationMethod::BlockMomentumSGD)
+    {
+        fprintf(stderr, ", BlockMomentumSGD training (MyRank = %d, NumNodes = %d, BlockSizePerWorker = %d)",
+                (int) g_mpi->CurrentNodeRank(), (int) g_mpi->NumNodesInUse(), (int) m_nFramesBetweenMASync);
+    }
     if (useDistributedMBReading)
     {
         fprintf(stderr, ", distributed reading is ENABLED");
     }
+    if (prefetcher)
+    {
+        fprintf(stderr, ", minibatch prefetching is ENABLED");
+    }
+    if (m_dataParallelReplicas)
+    {
+        fprintf(stderr, ", split over %d local %s", (int) m_dataParallelReplicas->NumReplicas(), net->GetDeviceId() < 0 ? "CPU replicas" : "GPUs");
+    }
     if (numSubminibatchesNeeded > 1)
     {
         if (m_maxSamplesInRAM < SIZE_MAX)
@@ -822,8 +1214,15 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         else
             fprintf(stderr, ", with %d subminibatch", (int) numSubminibatchesNeeded);
     }
+    if (numAccumulationSteps > 1)
+    {
+        fprintf(stderr, ", accumulating gradients over %d micro-batches", (int) numAccumulationSteps);
+    }
     fprintf(stderr, ".\n");
 
+    // benchmark mode: only the regular epochs count, not the trials of the learning-rate and minibatch-size searches
+    const bool benchmarking = m_benchmarkMinibatches > 0 && prefixMsg.empty();
+
     Timer timer;
     timer.Start();
 
@@ -835,8 +1234,22 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         // get minibatch
         // TODO: is it guaranteed that the GPU is already completed at this point, is it safe to overwrite the buffers?
         size_t actualMBSize = 0;
+        Timer waitTimer, stepTimer;
+        waitTimer.Start();
+        stepTimer.Start();
         bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork(*trainSetDataReader, net, criterionNodes[0],
-                                                                      useDistributedMBReading, useParallelTrain, *inputMatrices, actualMBSize);
+                                                                      useDistributedMBReading, useParallelTrain, *inputMatrices, actualMBSize, prefetcher.get(), workerShares);
+        waitTimer.Stop();
+        if (wasDataRead)
+            numReaderMinibatches++;
+        if (benchmarking && m_benchmark.numMinibatches >= m_benchmarkWarmupMinibatches)
+            m_benchmark.readerSeconds += waitTimer.ElapsedSeconds();
+        if (telemetry)
+        {
+            const double uploadSeconds = prefetcher ? prefetcher->LastUploadWaitSeconds() : 0;
+            telemetry->AddHostTime(TrainingSection::read, waitTimer.ElapsedSeconds() - uploadSeconds);
+            telemetry->AddHostTime(TrainingSection::upload, uploadSeconds);
+        }
         if (!wasDataRead && (!useDistributedMBReading || noMoreSamplesToProcess)) // in case of distributed reading, we do a few more loops until all ranks have completed
             break;                                                                // end of epoch
 
@@ -866,24 +1279,48 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             // TODO: currently we only support one node for regularization
             if (m_needAdaptRegularization && m_adaptationRegType == AdaptationRegType::KL && refNode)
             {
-                size_t actualMBSize2 = refNet->DetermineActualMBSizeFromFeatures();
-                refNet->GetMBLayoutPtr()->CopyFrom(net->GetMBLayoutPtr()); // TODO: This is UNTESTED (before this was missing, seemingly inconsistently)
+                Matrix<ElemType>& labels = dynamic_pointer_cast<ComputationNode<ElemType>>(labelNodes[0])->Value();
+                bool isCached = false;
+                if (m_referenceOutputCache)
+                {
+                    m_referenceOutputCache->ComputeKeys<ElemType>(featureNodes, net->GetMBLayoutPtr(), refOutputKeys);
+                    isCached = m_referenceOutputCache->Lookup(refOutputKeys, labels.GetNumRows(), cachedRefOutputs);
+                }
+                if (!isCached)
+                {
+                    size_t actualMBSize2 = refNet->DetermineActualMBSizeFromFeatures();
+                    refNet->GetMBLayoutPtr()->CopyFrom(net->GetMBLayoutPtr()); // TODO: This is UNTESTED (before this was missing, seemingly inconsistently)
 
-                if (actualMBSize2 != actualMBSize)
-                    LogicError("TrainOneEpoch: refNet has different MB size than main net??");
+                    if (actualMBSize2 != actualMBSize)
+                        LogicError("TrainOneEpoch: refNet has different MB size than main net??");
 
-                refNet->ForwardProp(refNode);
+                    refNet->ForwardProp(refNode);
+                    if (m_referenceOutputCache)
+                        m_referenceOutputCache->Insert(refOutputKeys, dynamic_pointer_cast<ComputationNode<ElemType>>(refNode)->Value());
+                }
                 Matrix<ElemType>::ScaleAndAdd((ElemType) m_adaptationRegWeight,
-                                              dynamic_pointer_cast<ComputationNode<ElemType>>(refNode)->Value(),
+                                              isCached ? cachedRefOutputs : dynamic_pointer_cast<ComputationNode<ElemType>>(refNode)->Value(),
                                               (ElemType)(1.0 - m_adaptationRegWeight),
-                                              dynamic_pointer_cast<ComputationNode<ElemType>>(labelNodes[0])->Value());
+                                              labels);
             }
 
             // do forward and back propagation
 
+            // with replicas on other GPUs, they share the minibatch instead, and the loop below is skipped
+            if (m_dataParallelReplicas)
+            {
+                if (telemetry)
+                    telemetry->BeginDeviceSection(TrainingSection::forward);
+                m_dataParallelReplicas->ForwardBackward(net, *inputMatrices, criterionNodes, evaluationNodes, learnableNodes,
+                                                        m_currentLossScale, learnRatePerSample > 0.01 * m_minLearnRate);
+                if (telemetry)
+                    telemetry->EndDeviceSection(TrainingSection::forward);
+            }
+
             // We optionally break the minibatch into sub-minibatches.
             // This, when enabled, is used when a full minibatch does not fit into GPU RAM.
-            size_t actualNumSubminibatches = numSubminibatchesNeeded <= 1 ? 1 : smbDispatcher.GetMinibatchIntoCache(*trainSetDataReader, *net, *inputMatrices, numSubminibatchesNeeded);
+            size_t actualNumSubminibatches = m_dataParallelReplicas ? 0
+                                           : numSubminibatchesNeeded <= 1 ? 1 : smbDispatcher.GetMinibatchIntoCache(*trainSetDataReader, *net, *inputMatrices, numSubminibatchesNeeded);
             for (size_t ismb = 0; ismb < actualNumSubminibatches; ismb++)
             {
                 if (actualNumSubminibatches > 1)
@@ -893,26 +1330,62 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                     ComputationNetwork::BumpEvalTimeStamp(labelNodes);
                 }
 
-                // ===========================================================
-                // forward prop for evaluate eval nodes
-                // ===========================================================
+                // with a single sub-minibatch, parameter gradients are final when backprop reaches them and can be exchanged right away
+                if (useGradientAggregation && actualNumSubminibatches <= 1 && numAccumulationSteps <= 1)
+                {
+                    net->SetGradientFinalCallback([this](const ComputationNodeBasePtr& node)
+                                                  {
+                                                      m_distGradAgg->OnGradientFinal(&dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient());
+                                                  });
+                }
+
+                const bool doBackprop = learnRatePerSample > 0.01 * m_minLearnRate; // only compute gradient when learning rate is large enough
+                auto forwardBackward = [&]()
+                {
+                    // ===========================================================
+                    // forward prop for evaluate eval nodes
+                    // ===========================================================
+
+                    if (timeForwardBackwardApart)
+                        telemetry->BeginDeviceSection(TrainingSection::forward);
 
-                // compute eval node first since when gradient is computed the forward function values
-                // may be changed and need to be recomputed when gradient and function value share the same matrix
-                net->ForwardProp(evaluationNodes); // the bulk of this evaluation is reused in ComputeGradient() below
+                    // compute eval node first since when gradient is computed the forward function values
+                    // may be changed and need to be recomputed when gradient and function value share the same matrix
+                    net->ForwardProp(evaluationNodes); // the bulk of this evaluation is reused in ComputeGradient() below
 
-                // ===========================================================
-                // forward prop for training criterion
-                // ===========================================================
+                    // ===========================================================
+                    // forward prop for training criterion
+                    // ===========================================================
 
-                net->ForwardProp(criterionNodes[0]);
+                    net->ForwardProp(criterionNodes[0]);
 
-                // ===========================================================
-                // backprop
-                // ===========================================================
+                    if (timeForwardBackwardApart)
+                        telemetry->EndDeviceSection(TrainingSection::forward);
 
-                if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                    // ===========================================================
+                    // backprop
+                    // ===========================================================
+
+                    if (doBackprop)
+                    {
+                        if (timeForwardBackwardApart)
+                            telemetry->BeginDeviceSection(TrainingSection::backward);
+                        net->Backprop(criterionNodes[0], m_currentLossScale);
+                        if (timeForwardBackwardApart)
+                            telemetry->EndDeviceSection(TrainingSection::backward);
+                    }
+                };
+                if (graphReplay)
+                {
+                    if (telemetry) // (no timing events inside a capture)
+                        telemetry->BeginDeviceSection(TrainingSection::forward);
+                    graphReplay->Run(net->GetMBLayoutPtr(), m_currentLossScale, doBackprop, forwardBackward);
+                    if (telemetry)
+                        telemetry->EndDeviceSection(TrainingSection::forward);
+                }
+                else
+                    forwardBackward();
+                net->SetGradientFinalCallback(nullptr);
 
                 // house-keeping for sub-minibatching
                 if (actualNumSubminibatches > 1)
@@ -925,6 +1398,62 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         // for progress and statistics, we should only count frames that are not gaps
         size_t numSamplesWithLabel = wasDataRead ? net->GetNumSamplesWithLabel(actualMBSize) : 0;
 
+        // gradient accumulation: read the remaining micro-batches of this minibatch straight into the network,
+        // and backpropagate each on top of the parameter gradients so far
+        // The criterion nodes hold the values of the latest micro-batch, accumulatedCriterion/accumulatedEvalErrors the sums of the earlier ones.
+        if (numAccumulationSteps > 1 && actualMBSize > 0)
+        {
+            accumulatedCriterion.SetValue(0);
+            accumulatedEvalErrors.SetValue(0);
+            for (size_t step = 1; step < numAccumulationSteps; step++)
+            {
+                size_t microMBSize = 0;
+                waitTimer.Restart();
+                const bool wasMicroMBRead = DataReaderHelpers::GetMinibatchIntoNetwork(*trainSetDataReader, net, criterionNodes[0],
+                                                                                       useDistributedMBReading, useParallelTrain, *inputMatrices, microMBSize, prefetcher.get(), workerShares);
+                waitTimer.Stop();
+                if (telemetry)
+                {
+                    const double uploadSeconds = prefetcher ? prefetcher->LastUploadWaitSeconds() : 0;
+                    telemetry->AddHostTime(TrainingSection::read, waitTimer.ElapsedSeconds() - uploadSeconds);
+                    telemetry->AddHostTime(TrainingSection::upload, uploadSeconds);
+                }
+                if (!wasMicroMBRead)
+                    break; // (end of data; the main loop finds it on its next read)
+                numReaderMinibatches++;
+                ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+                ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+                if (microMBSize == 0)
+                    continue;
+
+                Matrix<ElemType>::AddElementToElement(dynamic_pointer_cast<ComputationNode<ElemType>>(criterionNodes[0])->Value(), 0, 0, accumulatedCriterion, 0, 0);
+                for (size_t i = 0; i < evaluationNodes.size(); i++)
+                    Matrix<ElemType>::AddElementToElement(dynamic_pointer_cast<ComputationNode<ElemType>>(evaluationNodes[i])->Value(), 0, 0, accumulatedEvalErrors, 0, i);
+                actualMBSize += microMBSize;
+                numSamplesWithLabel += net->GetNumSamplesWithLabel(microMBSize);
+                nSamplesSinceLastModelSync += microMBSize;
+
+                if (telemetry)
+                    telemetry->BeginDeviceSection(TrainingSection::forward);
+                net->ForwardProp(evaluationNodes);
+                net->ForwardProp(criterionNodes[0]);
+                if (telemetry)
+                    telemetry->EndDeviceSection(TrainingSection::forward);
+                if (learnRatePerSample > 0.01 * m_minLearnRate)
+                {
+                    if (telemetry)
+                        telemetry->BeginDeviceSection(TrainingSection::backward);
+                    net->Backprop(criterionNodes[0], m_currentLossScale, true /*accumulateParameterGradients*/);
+                    if (telemetry)
+                        telemetry->EndDeviceSection(TrainingSection::backward);
+                }
+            }
+            // the criterion nodes now hold the sums over all micro-batches
+            Matrix<ElemType>::AddElementToElement(accumulatedCriterion, 0, 0, dynamic_pointer_cast<ComputationNode<ElemType>>(criterionNodes[0])->Value(), 0, 0);
+            for (size_t i = 0; i < evaluationNodes.size(); i++)
+                Matrix<ElemType>::AddElementToElement(accumulatedEvalErrors, 0, i, dynamic_pointer_cast<ComputationNode<ElemType>>(evaluationNodes[i])->Value(), 0, 0);
+        }
+
         // Sum of actualMBSize across all nodes when using parallel training
         size_t aggregateNumSamples = actualMBSize;
         size_t aggregateNumSamplesWithLabel = numSamplesWithLabel;
@@ -951,10 +1480,15 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             if (learnParamsGradients.size() == 0)
             {
                 learnParamsGradients.reserve(learnableNodes.size());
+                // with flat parameter buffers, the gradients in there are exchanged as one matrix
+                // (not with buffered async aggregation, which swaps the gradient matrices with its buffers)
+                const bool useGradientSpan = m_flatParameters && !m_flatParameters->IsEmpty() && !m_bufferedAsyncGradientAggregation;
+                if (useGradientSpan)
+                    learnParamsGradients.push_back(&m_flatParameters->GradientSpan());
                 for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
                 {
                     ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
-                    if (node->IsParameterUpdateRequired())
+                    if (node->IsParameterUpdateRequired() && !(useGradientSpan && m_flatParameters->HasGradient(node)))
                     {
                         Matrix<ElemType>* currParamsGradient = &(node->Gradient());
 
@@ -979,7 +1513,22 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             for (size_t i = 0; i < evaluationNodes.size(); i++)
                 m_gradHeader->evalErrors[i] = actualMBSize > 0 ? evaluationNodes[i]->Get00Element() : 0.0;
 
-            bool samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader, epochNumber);
+            // (reading the criterion above waited for the device, so the step time is complete here)
+            if (workerShares)
+            {
+                stepTimer.Stop();
+                m_loadBalancer->AddMinibatch(m_gradHeader->numSamples, stepTimer.ElapsedSeconds());
+            }
+
+            waitTimer.Restart();
+            bool samplesProcessed;
+            {
+                ScopedMemoryTag memoryTag(MemoryTag::Aggregator);
+                samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader, epochNumber);
+            }
+            waitTimer.Stop();
+            if (telemetry)
+                telemetry->AddHostTime(TrainingSection::aggregation, waitTimer.ElapsedSeconds());
             noMoreSamplesToProcess = !samplesProcessed;
 
             aggregateNumSamples = m_gradHeader->numSamples;
@@ -990,10 +1539,16 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         }
 
         // update model parameters
-        if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01))
+        // With loss scaling, a minibatch whose gradients overflowed is skipped.
+        if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01) && UnscaleGradients(learnableNodes))
         {
+            ScopedMemoryTag memoryTag(MemoryTag::OptimizerState);
+            if (telemetry)
+                telemetry->BeginDeviceSection(TrainingSection::update);
+            const double momentumPerSample = GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtr()->GetNumParallelSequences());
             auto smoothedGradientIter = smoothedGradients.begin();
-            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+            const bool isFused = UpdateWeightsFused(learnableNodes, smoothedGradients, learnRatePerSample, momentumPerSample, aggregateNumSamples);
+            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end() && !isFused; nodeIter++, smoothedGradientIter++)
             {
                 ComputationNodeBasePtr node = *nodeIter;
                 if (node->IsParameterUpdateRequired())
@@ -1004,7 +1559,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                         LogicError("%ls %ls operation has NaNs in smoothedGradient.", node->NodeName().c_str(), node->OperationName().c_str());
 #endif
                     UpdateWeights(node, smoothedGradient, learnRatePerSample,
-                                  GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtr()->GetNumParallelSequences()), aggregateNumSamples,
+                                  momentumPerSample, aggregateNumSamples,
                                   m_L2RegWeight, m_L1RegWeight,
                                   m_needAveMultiplier, m_useNesterovMomentum);
 #ifdef _DEBUG
@@ -1013,6 +1568,20 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 #endif
                 }
             }
+            if (m_dataParallelReplicas)
+                m_dataParallelReplicas->BroadcastParameters(learnableNodes);
+            if (telemetry)
+                telemetry->EndDeviceSection(TrainingSection::update);
+        }
+
+        // asynchronous exchange with the parameter server
+        // Workers that run out of data do not wait for the others here but in Synchronize() at the end of the epoch.
+        if (useParameterServer)
+        {
+            if (wasDataRead)
+                m_parameterServer->OnMinibatchUpdated(learnParamsValues);
+            else
+                noMoreSamplesToProcess = true;
         }
 
         // aggregation by model averaging
@@ -1042,6 +1611,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                     nSynced++;
 
                     nSecondsOnMASync += secondsSpentOnSync;
+                    if (telemetry)
+                        telemetry->AddHostTime(TrainingSection::aggregation, secondsSpentOnSync);
                     nSecondsSinceLastMAPerfReport += secondsSinceLastSyncFinished;
 
                     if (m_syncStatsTrace > 0)
@@ -1061,9 +1632,25 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
         timer.Stop();
         numMBsRun++;
+        if (telemetry)
+            telemetry->EndMinibatch();
 
         totalTimeInMBs += timer.ElapsedSeconds();
         numSamplesLastMBs += useModelAveraging ? int(actualMBSize) : int(aggregateNumSamplesWithLabel);
+        if (m_startupTimes.firstMinibatchSeconds < 0)
+        {
+            m_startupTimes.firstMinibatchSeconds = SecondsSinceStartup();
+            if (g_mpi == nullptr || g_mpi->IsMainNode())
+                fprintf(stderr, "Startup: TimeToFirstMinibatch = %.3fs\n", m_startupTimes.firstMinibatchSeconds);
+        }
+        if (benchmarking)
+        {
+            if (m_benchmark.numMinibatches++ >= m_benchmarkWarmupMinibatches)
+            {
+                m_benchmark.numSamples += useModelAveraging ? actualMBSize : aggregateNumSamplesWithLabel;
+                m_benchmark.seconds += timer.ElapsedSeconds();
+            }
+        }
 
         if (numMBsRun % m_numMBsToShowResult == 0)
         {
@@ -1126,6 +1713,10 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
             string formatString = "TotalTime = " + GeneratePaddedFloatOrExpFormat(0, 4, totalTimeInMBs) + "s; SamplesPerSecond = %.1f\n";
             SGDTrace(stderr, formatString.c_str(), totalTimeInMBs, numSamplesLastMBs / totalTimeInMBs);
+            if (telemetry)
+                telemetry->Report(epochNumber + 1, m_numMBsToShowResult, totalTimeInMBs, useGradientAggregation /*(workers in lockstep)*/);
+            if (m_traceMemoryUsage)
+                DeviceMemoryAccounting::PrintReport(net->GetDeviceId());
 
             // progress tracing for compute cluster management
             if (wasProgressPrinted)
@@ -1158,19 +1749,60 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         totalEpochSamples += aggregateNumSamplesWithLabel;
         totalSamplesSeen += aggregateNumSamplesWithLabel;
 
+        // mid-epoch checkpoint (not in the trial epochs of the learning-rate and minibatch-size searches, which have a prefixMsg)
+        // With model averaging only right after a sync, when the models are the same and all samples are counted.
+        if (m_numMBsToCheckpoint > 0 && prefixMsg.empty() && numMBsRun % m_numMBsToCheckpoint == 0 && !useParameterServer && !m_trainOnThisRankOnly &&
+            !(useModelAveraging && nSamplesSinceLastModelSync > 0) && !noMoreSamplesToProcess)
+        {
+            MidEpochState state;
+            state.epoch = epochNumber;
+            state.numReaderMinibatches = numReaderMinibatches;
+            state.numMBsRun = numMBsRun;
+            state.epochSamples = totalEpochSamples;
+            state.totalSamplesSeen = totalSamplesSeen;
+            state.learnRatePerSample = learnRatePerSample;
+            state.minibatchSize = tunedMBSize;
+            if (useGradientAggregation)
+            {
+                state.criterion = epochCriterion;
+                state.evalErrors = epochEvalErrors;
+            }
+            else
+            {
+                state.criterion = localEpochCriterion.Get00Element();
+                state.evalErrors.resize(epochEvalErrors.size());
+                for (size_t i = 0; i < state.evalErrors.size(); i++)
+                    state.evalErrors[i] = localEpochEvalErrors(0, i);
+                if (useModelAveraging && g_mpi->NumNodesInUse() > 1)
+                {
+                    g_mpi->AllReduce(&state.criterion, 1);
+                    g_mpi->AllReduce(state.evalErrors);
+                }
+            }
+            if (g_mpi == nullptr || g_mpi->IsMainNode())
+                SaveMidEpochCheckPoint(net, state, smoothedGradients);
+        }
+
         // call DataEnd function
         // This signals something from SGD to the reader.
         // DataEnd does reader specific process if sentence ending is reached
-        trainSetDataReader->DataEnd(EndDataType::endDataSentence);
+        // When prefetching, the reader is busy with the next minibatch; the prefetcher calls DataEnd() before reading it.
+        if (!prefetcher)
+            trainSetDataReader->DataEnd(EndDataType::endDataSentence);
 
         // Attempts to compute the error signal for the whole utterance, which will
         // be fed to the neural network as features. Currently it is a workaround
         // for the two-forward-pass sequence and ctc training, which allows
         // processing more utterances at the same time. Only used in Kaldi2Reader.
         // TODO: move the two-forward-pass support out of the reader.
-        AttemptUtteranceDerivativeFeatures(net, trainSetDataReader, featureNodes, inputMatrices);
+        // BUGBUG: This is not done when prefetching, since it would have to read from the reader concurrently.
+        if (!prefetcher)
+            AttemptUtteranceDerivativeFeatures(net, trainSetDataReader, featureNodes, inputMatrices);
 
         profiler.NextSample();
+
+        if (benchmarking && IsBenchmarkDone())
+            break; // (the epoch loop reports it and stops)
     }
 
     // --- END MAIN MINIBATCH LOOP
@@ -1187,6 +1819,18 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         nSamplesSinceLastModelSync = 0;
     }
 
+    if (useParameterServer)
+    {
+        m_parameterServer->Synchronize(learnParamsValues);
+        // so far we have only counted our own samples
+        size_t localEpochSamples = totalEpochSamples;
+        g_mpi->AllReduce(&totalEpochSamples, 1);
+        totalSamplesSeen += totalEpochSamples - localEpochSamples;
+    }
+
+    if (graphReplay && graphReplay->NumCaptured() > 0)
+        fprintf(stderr, "TrainOneEpoch: %d minibatches replayed from %d captured CUDA graphs.\n", (int) graphReplay->NumReplayed(), (int) graphReplay->NumCaptured());
+
     // compute final criterion values
     if (useGradientAggregation)
     {
@@ -1210,8 +1854,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         }
     }
 
-    // in case of model averaging, do one more final aggregation of criteria
-    if (useModelAveraging && (g_mpi->NumNodesInUse() > 1))
+    // in case of model averaging or a parameter server, do one more final aggregation of criteria
+    if ((useModelAveraging || useParameterServer) && (g_mpi->NumNodesInUse() > 1))
     {
         // merge epochCriterion and epochEvalErrors over nodes
         g_mpi->AllReduce(&epochCriterion, 1);
@@ -1283,15 +1927,31 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
         fprintf(stderr, "\tNodeName: %ls\n", (node->NodeName()).c_str());
     }
 
+    // restore the values of an earlier run with the same reader config and nodes
+    const wstring cacheKey = PreComputeCacheKey(nodes);
+    if (!m_preComputeCache.empty() && LoadPreComputeCache(nodes, cacheKey))
+    {
+        fprintf(stderr, "\nPrecomputing --> Restored from %ls.\n\n", m_preComputeCache.c_str());
+        return true;
+    }
+
+    // with several workers, each reads its share of the data, and the nodes' statistics are merged at the end
+    bool mergeAcrossWorkers = m_distributedPreCompute && g_mpi != nullptr && g_mpi->NumNodesInUse() > 1 && trainSetDataReader->SupportsDistributedMBRead();
+    for (auto nodeIter = nodes.begin(); nodeIter != nodes.end(); nodeIter++)
+        mergeAcrossWorkers &= static_pointer_cast<PreComputedNodeBase<ElemType>>(*nodeIter)->SupportsMergingStatistics();
+
     // compute
-    // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , requestDataSize);
-    // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , m_epochSize); // only based on one epoch
     // [1/12/2015 erw] to support large dataset, we usually partition whole dataset into several epoch's,
     // so we need to use all the data to do precomputing
-    if (m_useAllDataForPreComputedNode) // using all the data
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0);
-    else // using only one epoch
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, m_epochSize);
+    const size_t requestedSamples = m_useAllDataForPreComputedNode ? requestDataSize // using all the data
+                                                                   : m_epochSize;    // using only one epoch
+    if (mergeAcrossWorkers)
+    {
+        fprintf(stderr, "Precomputing on %d workers; this is worker %d.\n", (int) g_mpi->NumNodesInUse(), (int) g_mpi->CurrentNodeRank());
+        trainSetDataReader->StartDistributedMinibatchLoop(m_mbSize[0], 0, g_mpi->CurrentNodeRank(), g_mpi->NumNodesInUse(), requestedSamples);
+    }
+    else
+        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, requestedSamples);
     net->StartEvaluateMinibatchLoop(nodes);
 
     // initialize
@@ -1303,9 +1963,12 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
 
     const size_t numIterationsBeforePrintingProgress = 100;
     size_t numItersSinceLastPrintOfProgress = 0;
-    size_t actualMBSizeDummy;
-    while (DataReaderHelpers::GetMinibatchIntoNetwork(*trainSetDataReader, net, nullptr, false, false, *inputMatrices, actualMBSizeDummy))
+    size_t actualMBSize;
+    while (DataReaderHelpers::GetMinibatchIntoNetwork(*trainSetDataReader, net, nullptr, mergeAcrossWorkers, false, *inputMatrices, actualMBSize))
     {
+        if (actualMBSize == 0) // (a distributed reader may return empty minibatches to some workers)
+            continue;
+
         // TODO: move these into GetMinibatchIntoNetwork()  --but those are passed around; necessary? Can't we get them from 'net'?
         ComputationNetwork::BumpEvalTimeStamp(featureNodes);
         ComputationNetwork::BumpEvalTimeStamp(labelNodes);
@@ -1324,6 +1987,28 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
         }
     }
 
+    // merge the workers' statistics, of all nodes in one all-reduce
+    if (mergeAcrossWorkers)
+    {
+        vector<vector<double>> stats(nodes.size());
+        vector<double> buffer;
+        size_t k = 0;
+        for (auto nodeIter = nodes.begin(); nodeIter != nodes.end(); nodeIter++, k++)
+        {
+            static_pointer_cast<PreComputedNodeBase<ElemType>>(*nodeIter)->GetMergeableStatistics(stats[k]);
+            buffer.insert(buffer.end(), stats[k].begin(), stats[k].end());
+        }
+        g_mpi->AllReduce(buffer);
+        size_t offset = 0;
+        k = 0;
+        for (auto nodeIter = nodes.begin(); nodeIter != nodes.end(); nodeIter++, k++)
+        {
+            copy(buffer.begin() + offset, buffer.begin() + offset + stats[k].size(), stats[k].begin());
+            offset += stats[k].size();
+            static_pointer_cast<PreComputedNodeBase<ElemType>>(*nodeIter)->SetMergedStatistics(stats[k]);
+        }
+    }
+
     // finalize
     for (auto nodeIter = nodes.begin(); nodeIter != nodes.end(); nodeIter++)
     {
@@ -1332,9 +2017,78 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     }
     fprintf(stderr, "\nPrecomputing --> Completed.\n\n");
 
+    if (!m_preComputeCache.empty() && ((g_mpi == nullptr) || g_mpi->IsMainNode()))
+        SavePreComputeCache(nodes, cacheKey);
+
     return true;
 }
 
+// the precompute cache is valid for the same reader config, amount of data, precision, and precompute nodes
+template <class ElemType>
+wstring SGD<ElemType>::PreComputeCacheKey(const std::list<ComputationNodeBasePtr>& nodes) const
+{
+    wstring key = m_readerConfigKey;
+    key += msra::strfun::wstrprintf(L"|samples=%ls|precision=%d", m_useAllDataForPreComputedNode ? L"all" : std::to_wstring(m_epochSize).c_str(), (int) sizeof(ElemType));
+    for (const auto& node : nodes)
+        key += L"|" + node->NodeName() + L":" + node->OperationName() + L":" + msra::strfun::utf16(string(node->GetSampleLayout()));
+    return key;
+}
+
+template <class ElemType>
+bool SGD<ElemType>::LoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const wstring& key)
+{
+    if (!fexists(m_preComputeCache))
+        return false;
+    File fstream(m_preComputeCache, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BPreComputeCache");
+    wstring cachedKey;
+    fstream >> cachedKey;
+    if (cachedKey != key)
+    {
+        fprintf(stderr, "Precomputing: Ignoring %ls, which was written for a different reader config or network.\n", m_preComputeCache.c_str());
+        return false;
+    }
+
+    size_t numNodes;
+    fstream >> numNodes;
+    if (numNodes != nodes.size())
+        RuntimeError("LoadPreComputeCache: %ls is inconsistent with its key.", m_preComputeCache.c_str());
+    for (const auto& nodeBase : nodes) // (same order as when saved, since the key lists the nodes)
+    {
+        auto node = static_pointer_cast<PreComputedNodeBase<ElemType>>(nodeBase);
+        wstring name;
+        Matrix<ElemType> value(nodeBase->GetDeviceId());
+        fstream >> name >> value;
+        if (name != node->NodeName() || value.GetNumElements() != nodeBase->GetSampleMatrixNumRows())
+            RuntimeError("LoadPreComputeCache: %ls is inconsistent with its key.", m_preComputeCache.c_str());
+        node->RestoreComputedValue(value);
+    }
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EPreComputeCache");
+    return true;
+}
+
+// written to a temporary file first, so that an interrupted run does not leave a truncated cache
+template <class ElemType>
+void SGD<ElemType>::SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const wstring& key) const
+{
+    const wstring tmpPath = m_preComputeCache + L".tmp";
+    msra::files::make_intermediate_dirs(m_preComputeCache);
+    {
+        File fstream(tmpPath, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BPreComputeCache");
+        fstream << key;
+        fstream << nodes.size();
+        for (const auto& nodeBase : nodes)
+        {
+            auto node = static_pointer_cast<PreComputedNodeBase<ElemType>>(nodeBase);
+            fstream << node->NodeName() << node->Value();
+        }
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EPreComputeCache");
+    }
+    renameOrDie(tmpPath, m_preComputeCache);
+    fprintf(stderr, "Precomputing: Saved the precomputed values to %ls.\n", m_preComputeCache.c_str());
+}
+
 // return a reasonable initial learning rate based on the initial mbsize
 template <class ElemType>
 double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
@@ -1378,6 +2132,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
     }
 
     int baseModelEpoch = epochNumber - 1;
+    WaitForCheckpointWriter();
     net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
 
     double learnRate = learnRatePerSample;
@@ -1389,6 +2144,14 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
                        /*out*/ prevCriterion,
                        /*out*/ dummyMinibatchSize);
 
+    if (m_parallelLearnRateSearch && m_autoLearnRateSearchType == LearningRateSearchAlgorithm::SearchBeforeEpoch &&
+        g_mpi != nullptr && g_mpi->NumNodesInUse() > 1)
+    {
+        return SearchForBestLearnRateAcrossRanks(net, refNet, refNode, epochNumber, numFramesToUseInSearch, learnRatePerSample, minLearnRate,
+                                                 prevCriterion, trainSetDataReader, featureNodes, labelNodes, criterionNodes, evaluationNodes,
+                                                 inputMatrices, learnableNodes, smoothedGradients);
+    }
+
     // if model is not changed this is what we will get
     TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
                                     numFramesToUseInSearch, trainSetDataReader, 0, m_mbSize[epochNumber],
@@ -1496,6 +2259,142 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
     return bestLearnRatePerSample;
 }
 
+// SearchForBestLearnRateAcrossRanks() -- the search of SearchForBestLearnRate(), with the trials spread over the MPI ranks
+// Each round, every rank trains on the same subset of the data at a candidate rate of its own, without aggregation, and
+// an all-reduce of the criteria brings the results to all ranks, which then decide alike. The first round also gives the
+// base criterion (rate 0, on the main node). The candidates are those of the serial search (the rate shrinking by 0.618
+// until the criterion falls below the base), numRanks at a time, so the result is the same; the grid search of the first
+// numBestSearchEpoch epochs instead tries numRanks rates between its bounds at once and takes the best.
+template <class ElemType>
+double SGD<ElemType>::SearchForBestLearnRateAcrossRanks(ComputationNetworkPtr net,
+                                                        ComputationNetworkPtr refNet,
+                                                        const ComputationNodeBasePtr& refNode, const int epochNumber,
+                                                        const size_t numFramesToUseInSearch,
+                                                        double learnRatePerSample,
+                                                        const double minLearnRate,
+                                                        double prevCriterion,
+                                                        IDataReader<ElemType>* trainSetDataReader,
+                                                        const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                                        const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                                        const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                                        const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                                        std::map<std::wstring, Matrix<ElemType>*>* inputMatrices,
+                                                        const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                                        std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    const size_t numRanks = g_mpi->NumNodesInUse();
+    const size_t rank = g_mpi->CurrentNodeRank();
+
+    // the criteria of one round of candidates; a rank without a candidate (rate < 0) just waits for the others
+    auto trainRound = [&](const vector<double>& learnRates, const char* prefixMsg)
+    {
+        vector<double> criteria(numRanks, 0.0);
+        if (rank < numRanks && learnRates[rank] >= 0)
+        {
+            vector<double> epochEvalErrors(evaluationNodes.size(), std::numeric_limits<double>::infinity());
+            size_t totalSamplesSeen = 0;
+            m_trainOnThisRankOnly = true;
+            try
+            {
+                TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
+                                                numFramesToUseInSearch, trainSetDataReader,
+                                                learnRates[rank], m_mbSize[epochNumber],
+                                                featureNodes, labelNodes,
+                                                criterionNodes, evaluationNodes,
+                                                inputMatrices, learnableNodes,
+                                                smoothedGradients, /*out*/ criteria[rank],
+                                                /*out*/ epochEvalErrors, /*out*/ totalSamplesSeen,
+                                                prefixMsg);
+            }
+            catch (...)
+            {
+                m_trainOnThisRankOnly = false;
+                throw;
+            }
+            m_trainOnThisRankOnly = false;
+        }
+        g_mpi->AllReduce(criteria);
+        for (size_t r = 0; r < numRanks; r++)
+            if (learnRates[r] >= 0)
+                fprintf(stderr, "%s rank %d: learnRatePerSample = %.10g; TrainLossPerSample = %.8g\n", prefixMsg, (int) r, learnRates[r], criteria[r]);
+        return criteria;
+    };
+
+    // round 0: the base on the main node, the first candidates on the others
+    vector<double> learnRates(numRanks);
+    for (size_t r = 0; r < numRanks; r++)
+    {
+        if (r == g_mpi->MainNodeRank())
+            learnRates[r] = 0;
+        else
+        {
+            learnRatePerSample *= 0.618;
+            learnRates[r] = learnRatePerSample;
+        }
+    }
+    vector<double> criteria = trainRound(learnRates, "ParallelAdaptiveLearnRateSearch:");
+
+    double baseCriterion = criteria[g_mpi->MainNodeRank()];
+    if (prevCriterion == std::numeric_limits<double>::infinity())
+        prevCriterion = baseCriterion;
+    double ratio = 0.3;
+    if (m_epochSize != requestDataSize)
+        ratio = pow(((double) numFramesToUseInSearch) / m_epochSize, 1.0f / 2);
+    baseCriterion = max(ratio * prevCriterion + (1 - ratio) * baseCriterion, baseCriterion);
+
+    // the first candidate (largest rate) at which the serial search would stop
+    double bestLearnRatePerSample = -1;
+    double bestCriterion = std::numeric_limits<double>::infinity();
+    for (;;)
+    {
+        for (size_t r = 0; r < numRanks && bestLearnRatePerSample < 0; r++)
+        {
+            if (r == g_mpi->MainNodeRank() && learnRates[r] == 0)
+                continue;
+            if (!std::isnan(criteria[r]) && (criteria[r] <= baseCriterion || learnRates[r] <= minLearnRate))
+            {
+                bestLearnRatePerSample = learnRates[r];
+                bestCriterion = criteria[r];
+            }
+        }
+        if (bestLearnRatePerSample >= 0)
+            break;
+        for (size_t r = 0; r < numRanks; r++)
+        {
+            learnRatePerSample *= 0.618;
+            learnRates[r] = learnRatePerSample;
+        }
+        criteria = trainRound(learnRates, "ParallelAdaptiveLearnRateSearch:");
+    }
+
+    // grid search for the first m_numBestSearchEpoch epochs: numRanks rates spaced geometrically from the left bound up to
+    // (not including) the rate found above
+    if (epochNumber < m_numBestSearchEpoch)
+    {
+        const double leftLearnRatePerSample = 0.01 / m_mbSize[epochNumber];
+        const double rightLearnRatePerSample = bestLearnRatePerSample;
+        if (rightLearnRatePerSample > leftLearnRatePerSample)
+        {
+            for (size_t r = 0; r < numRanks; r++)
+                learnRates[r] = leftLearnRatePerSample * pow(rightLearnRatePerSample / leftLearnRatePerSample, (double) r / numRanks);
+            criteria = trainRound(learnRates, "ParallelDetailAdaptiveLearnRateSearch:");
+            for (size_t r = 0; r < numRanks; r++)
+            {
+                if (!std::isnan(criteria[r]) && criteria[r] < bestCriterion)
+                {
+                    bestLearnRatePerSample = learnRates[r];
+                    bestCriterion = criteria[r];
+                }
+            }
+        }
+    }
+
+    fprintf(stderr, "Best Learn Rate Per Sample for Epoch[%d] = %.10g  baseCriterion=%.10g (searched on %d ranks)\n",
+            epochNumber + 1, bestLearnRatePerSample, baseCriterion, (int) numRanks);
+
+    return bestLearnRatePerSample;
+}
+
 // AdaptiveMinibatchSizing() -- choose the largest feasible minibatch size
 // This is necessary for data-parallel operation. The aim is to minimize model updates, and hence bandwidth
 // This implements
@@ -1747,6 +2646,7 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
     }
 
     int baseModelEpoch = epochNumber - 1;
+    WaitForCheckpointWriter();
     net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
 
     double dummyLearnRate;
@@ -1812,6 +2712,24 @@ static string GeneratePaddedFloatOrExpFormat(int padSize, int precision, double
     return format;
 }
 
+// benchmark mode (benchmarkMinibatches > 0) ends training with one line, which 'TestDriver.py benchmark' compares
+// against its baselines (see Tests/EndToEndTests):
+//   Benchmark: minibatches = 100; SamplesPerSecond = ...; ReaderWaitPerMinibatch = ...s; PeakDeviceMemory = ... MB; TimeToFirstMinibatch = ...s
+// The throughput is that of all workers with gradient aggregation, and of this one otherwise. The peak device memory
+// is that of DeviceMemoryAccounting since the start of the process, 0 on the CPU.
+template <class ElemType>
+void SGD<ElemType>::ReportBenchmark(DEVICEID_TYPE deviceId)
+{
+    if (g_mpi != nullptr && !g_mpi->IsMainNode())
+        return;
+    size_t currentBytes, peakBytes;
+    DeviceMemoryAccounting::GetTotalUsage(deviceId, currentBytes, peakBytes);
+    const size_t numMeasured = m_benchmark.numMinibatches - m_benchmarkWarmupMinibatches;
+    fprintf(stderr, "Benchmark: minibatches = %d; SamplesPerSecond = %.1f; ReaderWaitPerMinibatch = %.6fs; PeakDeviceMemory = %.1f MB; TimeToFirstMinibatch = %.3fs\n",
+            (int) numMeasured, m_benchmark.seconds > 0 ? m_benchmark.numSamples / m_benchmark.seconds : 0.0, m_benchmark.readerSeconds / numMeasured,
+            peakBytes / (double) (1 << 20), m_startupTimes.firstMinibatchSeconds);
+}
+
 template <class ElemType>
 int SGD<ElemType>::SGDTrace(FILE* __restrict __stream, const char* __restrict __format, ...)
 {
@@ -1831,6 +2749,26 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int traceLevel)
 {
     if (m_parallelizationMethod == ParallelizationMethod::DataParallelSGD)
     {
+        if (m_distGradAgg == nullptr && m_numBackupWorkers > 0)
+        {
+            if (m_numGradientBits != (8 * sizeof(ElemType)) || m_sparseGradientDensity > 0 || m_bufferedAsyncGradientAggregation || m_gradientWireFormat != GradientWireFormat::Full)
+                InvalidArgument("Backup workers cannot be combined with gradient quantization, sparse gradients, buffered async aggregation or a 16-bit gradient wire format.");
+            m_distGradAgg = new BackupWorkerGradAggregator<ElemType>(g_mpi, m_numBackupWorkers, m_syncStatsTrace);
+        }
+        if (m_distGradAgg == nullptr && m_sparseGradientDensity > 0)
+        {
+            if (m_numGradientBits != (8 * sizeof(ElemType)) || m_gradientWireFormat != GradientWireFormat::Full)
+                InvalidArgument("Sparse gradient aggregation cannot be combined with gradient quantization or a 16-bit gradient wire format.");
+            m_distGradAgg = new SparseGradientAggregator<ElemType>(g_mpi, m_sparseGradientDensity, m_bufferedAsyncGradientAggregation, m_syncStatsTrace);
+        }
+        if (m_distGradAgg == nullptr && m_gradientWireFormat != GradientWireFormat::Full)
+        {
+            if (m_numGradientBits != (8 * sizeof(ElemType)))
+                InvalidArgument("gradientWireFormat cannot be combined with gradient quantization.");
+            if (m_gradientBucketSizeInBytes > 0 || m_useGPUDirectGradientExchange)
+                fprintf(stderr, "InitDistGradAgg: gradientWireFormat exchanges the gradients after backprop, through CPU memory; gradientBucketSizeInMB and useGPUDirect are ignored.\n");
+            m_distGradAgg = new HalfPrecisionGradAggregator<ElemType>(g_mpi, m_gradientWireFormat == GradientWireFormat::BFloat16, m_bufferedAsyncGradientAggregation, m_syncStatsTrace);
+        }
         if (m_distGradAgg == nullptr)
         {
 #ifdef QUANTIZED_GRADIENT_AGGREGATION
@@ -1841,7 +2779,7 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int traceLevel)
                 RuntimeError("Gradient quantization is unsupported in CNTK binaries built without quantized gradient aggregation support!");
             }
 
-            m_distGradAgg = new SimpleDistGradAggregator<ElemType>(g_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace);
+            m_distGradAgg = new SimpleDistGradAggregator<ElemType>(g_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace, m_gradientBucketSizeInBytes, m_useGPUDirectGradientExchange);
 #endif // !QUANTIZED_GRADIENT_AGGREGATION
         }
 
@@ -1852,6 +2790,58 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int traceLevel)
     }
 }
 
+// keep the state to which the survivors of a rank loss return
+// This copies the parameters and the smoothed gradients once per epoch; a recovery thus repeats up to one epoch.
+template <class ElemType>
+void SGD<ElemType>::SnapshotEpochStart(const std::list<ComputationNodeBasePtr>& learnableNodes, const std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    if (m_epochStartValues.empty())
+    {
+        for (auto& node : learnableNodes)
+        {
+            const Matrix<ElemType>& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+            m_epochStartValues.push_back(Matrix<ElemType>(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId()));
+        }
+        for (auto& smoothedGradient : smoothedGradients)
+            m_epochStartSmoothedGradients.push_back(Matrix<ElemType>(smoothedGradient.GetNumRows(), smoothedGradient.GetNumCols(), smoothedGradient.GetDeviceId()));
+    }
+    auto snapshotIter = m_epochStartValues.begin();
+    for (auto& node : learnableNodes)
+        (snapshotIter++)->SetValue(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value());
+    snapshotIter = m_epochStartSmoothedGradients.begin();
+    for (auto& smoothedGradient : smoothedGradients)
+        (snapshotIter++)->SetValue(smoothedGradient);
+    m_epochStartLossScale = m_currentLossScale;
+}
+
+// continue the epoch among the ranks that are left: re-form the communicator, return to the model at the start of the
+// epoch, and recreate the gradient aggregator, whose buffers and requests belong to the old communicator.
+// TrainOneEpoch() then re-shards the reader over the survivors through StartDistributedMinibatchLoop().
+template <class ElemType>
+void SGD<ElemType>::RecoverFromRankLoss(const MpiRankLoss& e, int epochNumber, const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                        std::list<Matrix<ElemType>>& smoothedGradients, int numEvalNodes)
+{
+    fprintf(stderr, "Epoch[%d]: lost a rank (%s); restarting the epoch on the remaining ones.\n", epochNumber + 1, e.what());
+    g_mpi->ShrinkAfterRankLoss();
+
+    auto snapshotIter = m_epochStartValues.begin();
+    for (auto& node : learnableNodes)
+    {
+        ComputationNodePtr learnableNode = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+        learnableNode->Value().SetValue(*snapshotIter++);
+        learnableNode->BumpEvalTimeStamp();
+    }
+    snapshotIter = m_epochStartSmoothedGradients.begin();
+    for (auto& smoothedGradient : smoothedGradients)
+        smoothedGradient.SetValue(*snapshotIter++);
+    m_currentLossScale = m_epochStartLossScale;
+    m_numMBsSinceLossScaleChange = 0;
+
+    // Note: The old aggregator is not deleted, since its destructor may wait for exchanges on the revoked communicator.
+    m_distGradAgg = nullptr;
+    InitDistGradAgg(numEvalNodes, m_traceLevel);
+}
+
 template <class ElemType>
 bool SGD<ElemType>::ModelAveragingProcessing(size_t nSamplesSinceLastSync, const std::list<ComputationNodeBasePtr>& learnableNodes, size_t& nProcessedFrames,
                                              float& SecondsSinceLastSyncFinished, float& SecondsSpentOnSync)
@@ -1863,6 +2853,7 @@ bool SGD<ElemType>::ModelAveragingProcessing(size_t nSamplesSinceLastSync, const
 
     // TODO: the way we handle timer is not very good
     // ////////////////////////////////////////////////////////////////////////
+    ScopedMemoryTag memoryTag(MemoryTag::Aggregator);
     static bool first = true;
     static Timer MAtimer;
     if (first)
@@ -1884,7 +2875,7 @@ bool SGD<ElemType>::ModelAveragingProcessing(size_t nSamplesSinceLastSync, const
         double elapsedsec = MAtimer.ElapsedSeconds();
         SecondsSinceLastSyncFinished = first ? 0 : (float) elapsedsec;
         MAtimer.Start();
-        nProcessedFrames = ModelAveragingSync((int) nSamplesSinceLastSync, learnableNodes);
+        nProcessedFrames = ModelAveragingSync((int) nSamplesSinceLastSync, learnableNodes, m_overlapModelAveraging);
         MAtimer.Stop();
         SecondsSpentOnSync = (float) MAtimer.ElapsedSeconds();
 
@@ -1898,14 +2889,41 @@ bool SGD<ElemType>::ModelAveragingProcessing(size_t nSamplesSinceLastSync, const
     return true;
 }
 
+// With 'overlap', the exchange of this sync runs on during the next block, and what is applied is that of the sync
+// before; the returned number of samples is then that of the sync before, too.
 template <class ElemType>
-size_t SGD<ElemType>::ModelAveragingSync(int nSamplesSinceLastSync, const std::list<ComputationNodeBasePtr>& learnableNodes)
+size_t SGD<ElemType>::ModelAveragingSync(int nSamplesSinceLastSync, const std::list<ComputationNodeBasePtr>& learnableNodes, bool overlap)
 {
     if (g_mpi->NumNodesInUse() <= 1)
     {
         return nSamplesSinceLastSync;
     }
 
+    // exchange of model deltas, compressed or overlapped
+    if (m_modelDeltaBits != 8 * sizeof(ElemType) || m_overlapModelAveraging)
+    {
+        if (!m_modelDeltaExchange)
+            m_modelDeltaExchange = make_shared<ModelDeltaExchange<ElemType>>(g_mpi, m_modelDeltaBits, m_zeroThresholdFor1Bit);
+        size_t nTotalSamples = m_modelDeltaExchange->Finish();
+        m_modelDeltaExchange->Start(learnableNodes, (size_t) nSamplesSinceLastSync);
+        if (!overlap)
+        {
+            nTotalSamples += m_modelDeltaExchange->Finish();
+            if (m_parallelizationMethod == ParallelizationMethod::BlockMomentumSGD)
+            {
+                for (const auto& pNode : learnableNodes)
+                {
+                    if (pNode->IsParameterUpdateRequired())
+                        BlockMomentumUpdate(pNode, dynamic_pointer_cast<ComputationNode<ElemType>>(pNode)->Value());
+                }
+                m_modelDeltaExchange->ResetReference();
+            }
+        }
+        if (m_dataParallelReplicas)
+            m_dataParallelReplicas->BroadcastParameters(learnableNodes);
+        return nTotalSamples;
+    }
+
     // ========================================
     // Sec. 1 calculate factor
     // ========================================
@@ -1950,11 +2968,46 @@ size_t SGD<ElemType>::ModelAveragingSync(int nSamplesSinceLastSync, const std::l
         mat.SetValue(mat.GetNumRows(), mat.GetNumCols(), mat.GetDeviceId(), px);
         // 4. clean up
         delete[] px;
+        // 5. filter the model update
+        if (m_parallelizationMethod == ParallelizationMethod::BlockMomentumSGD)
+            BlockMomentumUpdate(pNode, mat);
     }
+    // the local replicas continue from the averaged model as well
+    if (m_dataParallelReplicas)
+        m_dataParallelReplicas->BroadcastParameters(learnableNodes);
 
     return nTotalSamples;
 }
 
+// blockwise model-update filtering (Chen and Huo, ICASSP 2016)
+// With W the global model after the previous sync and G = averagedModel - W the aggregated update of this block:
+//     delta = blockMomentum * delta + blockLearningRate * G
+//     W     = W + delta
+// and workers continue from W, or from W + blockMomentum * delta with Nesterov block momentum.
+template <class ElemType>
+void SGD<ElemType>::BlockMomentumUpdate(const ComputationNodeBasePtr& node, Matrix<ElemType>& averagedModel)
+{
+    // The first sync has no previous global model to filter against; its plain average becomes the global model.
+    auto& model = m_blockLevelModel[node->NodeName()];
+    auto& delta = m_blockLevelDelta[node->NodeName()];
+    if (!model)
+    {
+        model = make_shared<Matrix<ElemType>>(averagedModel.GetDeviceId());
+        model->SetValue(averagedModel);
+        delta = make_shared<Matrix<ElemType>>(averagedModel.GetNumRows(), averagedModel.GetNumCols(), averagedModel.GetDeviceId());
+        delta->SetValue(0);
+        return;
+    }
+
+    const double blockMomentum = m_blockMomentumPerSync >= 0 ? m_blockMomentumPerSync : 1.0 - 1.0 / g_mpi->NumNodesInUse();
+    averagedModel -= *model;
+    Matrix<ElemType>::ScaleAndAdd((ElemType) m_blockLearningRate, averagedModel, (ElemType) blockMomentum, *delta);
+    *model += *delta;
+    averagedModel.SetValue(*model);
+    if (m_useNesterovBlockMomentum)
+        Matrix<ElemType>::ScaleAndAdd((ElemType) blockMomentum, *delta, averagedModel);
+}
+
 // public:
 // UpdateWeightsS - static version of UpdateWeights()
 // not static since it wants to access protected methods on the SGD object
@@ -2011,12 +3064,9 @@ template <class ElemType>
         smoothedGradient.NormalGrad(gradientValues, functionValues,
                                     (ElemType) learnRatePerSample, (ElemType) momentum, useNesterovMomentum);
     }
-    else if (adpType == GradientsUpdateType::AdaGrad ||
-             (adpType == GradientsUpdateType::RmsProp && gradientValues.GetMatrixType() == MatrixType::SPARSE) ||
-             (adpType == GradientsUpdateType::FSAdaGrad && gradientValues.GetMatrixType() == MatrixType::SPARSE))
+    else if (adpType == GradientsUpdateType::AdaGrad)
     {
-        // rmsprop for sparse is not implemented yet, delegate it with adagrad
-
+        // (for sparse gradients, this and the following updates only touch the columns present in the gradient)
         double aveMultiplier = smoothedGradient.Adagrad(gradientValues, needAveMultiplier);
         Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample / aveMultiplier), gradientValues, functionValues);
     }
@@ -2031,6 +3081,16 @@ template <class ElemType>
                                                         (ElemType) sgd->m_rpi.dec, (ElemType) sgd->m_rpi.min, needAveMultiplier);
         Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample / aveMultiplier), gradientValues, functionValues);
     }
+    // (the trust ratio makes these invariant to the scale of the gradient, so they take the learning rate per minibatch)
+    else if (adpType == GradientsUpdateType::Lars)
+    {
+        smoothedGradient.LarsUpdate(gradientValues, functionValues, (ElemType)(learnRatePerSample * actualMBSize), (ElemType) momentum, (ElemType) sgd->m_lwi.trustCoefficient);
+    }
+    else if (adpType == GradientsUpdateType::Lamb)
+    {
+        smoothedGradient.LambUpdate(gradientValues, functionValues, (ElemType)(learnRatePerSample * actualMBSize), (ElemType) sgd->m_lwi.beta1,
+                                    (ElemType) sgd->m_lwi.beta2, (ElemType) sgd->m_lwi.epsilon, (ElemType) sgd->m_lwi.weightDecay);
+    }
 
     if (noiseStd > 0)
     {
@@ -2068,6 +3128,13 @@ void SGD<ElemType>::UpdateWeights(const ComputationNodeBasePtr& node,
     if (!node->IsParameterUpdateRequired())
         LogicError("UpdateWeights() called for a learnable ComputationNode which has m_parameterUpdateRequired == false!");
 
+    if (smoothedGradient.GetDeviceId() != node->GetDeviceId())
+    {
+        UpdateWeightsOnHost(node, smoothedGradient, learnRatePerSample, momentumPerSample, actualMBSize, L2RegWeight, L1RegWeight, needAveMultiplier);
+        node->BumpEvalTimeStamp();
+        return;
+    }
+
     UpdateWeightsS(this, dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(), dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient(),
                    smoothedGradient, learnRatePerSample, momentumPerSample,
                    actualMBSize, L2RegWeight, L1RegWeight,
@@ -2075,6 +3142,164 @@ void SGD<ElemType>::UpdateWeights(const ComputationNodeBasePtr& node,
     node->BumpEvalTimeStamp();
 }
 
+// The update runs on the CPU with the smoothed gradient where it is, and only what it touches crosses the bus. A
+// block-sparse gradient (e.g. of an embedding with sparse input) brings the parameter columns it has over: they are
+// gathered on the GPU, updated on the host as a compact matrix with the gathered columns of the smoothed gradient,
+// and the change is added back. This is the update of UpdateWeightsS() for sparse gradients, which touches only the
+// columns present in the gradient, too. Dense gradients move the whole parameter. Momentum SGD and AdaGrad only,
+// whose smoothed gradient has the shape of the parameter.
+template <class ElemType>
+void SGD<ElemType>::UpdateWeightsOnHost(const ComputationNodeBasePtr& node,
+                                        Matrix<ElemType>& smoothedGradient,
+                                        const double learnRatePerSample,
+                                        const double momentumPerSample,
+                                        const size_t actualMBSize,
+                                        const double L2RegWeight, const double L1RegWeight,
+                                        const bool needAveMultiplier) const
+{
+    Matrix<ElemType>& functionValues = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+    Matrix<ElemType>& gradientValues = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient();
+    const DEVICEID_TYPE deviceId = functionValues.GetDeviceId();
+    const size_t numRows = functionValues.GetNumRows();
+
+    if (gradientValues.GetMatrixType() != SPARSE)
+    {
+        const size_t numCols = functionValues.GetNumCols();
+        Matrix<ElemType> hostValues(numRows, numCols, CPUDEVICE);
+        Matrix<ElemType> hostGradient(numRows, numCols, CPUDEVICE);
+        functionValues.CopySection(numRows, numCols, hostValues.BufferPointer(), numRows);
+        gradientValues.CopySection(numRows, numCols, hostGradient.BufferPointer(), numRows);
+        UpdateWeightsS(this, hostValues, hostGradient, smoothedGradient, learnRatePerSample, momentumPerSample,
+                       actualMBSize, L2RegWeight, L1RegWeight, needAveMultiplier, m_useNesterovMomentum);
+        functionValues.SetValue(numRows, numCols, deviceId, hostValues.BufferPointer());
+        return;
+    }
+    if (gradientValues.GetFormat() != matrixFormatSparseBlockCol)
+        LogicError("UpdateWeightsOnHost: The gradient of %ls %ls operation has a sparse format that is not supported.", node->NodeName().c_str(), node->OperationName().c_str());
+
+    std::vector<size_t> columnIds;
+    std::vector<ElemType> gradientColumns;
+    gradientValues.GetSparseBlockColData(columnIds, gradientColumns);
+    const size_t numTouched = columnIds.size();
+    if (numTouched == 0)
+        return;
+
+    // gather the touched columns of the parameter on the GPU, and of the smoothed gradient on the host
+    std::vector<ElemType> columnIndices(columnIds.begin(), columnIds.end()); // (as AssignRowStackedColumnsOf() takes them)
+    Matrix<ElemType> sourceColumns(1, numTouched, columnIndices.data(), matrixFlagNormal, deviceId);
+    Matrix<ElemType> touchedValues(deviceId);
+    touchedValues.AssignRowStackedColumnsOf(functionValues, sourceColumns);
+    Matrix<ElemType> hostValues(numRows, numTouched, CPUDEVICE);
+    touchedValues.CopySection(numRows, numTouched, hostValues.BufferPointer(), numRows);
+    Matrix<ElemType> previousValues(hostValues, CPUDEVICE);
+    Matrix<ElemType> hostSmoothedGradient(numRows, numTouched, CPUDEVICE);
+    for (size_t j = 0; j < numTouched; j++)
+        memcpy(hostSmoothedGradient.BufferPointer() + j * numRows, smoothedGradient.BufferPointer() + columnIds[j] * numRows, numRows * sizeof(ElemType));
+
+    // the compact gradient has all of its columns present
+    std::vector<size_t> compactIds(numTouched);
+    for (size_t j = 0; j < numTouched; j++)
+        compactIds[j] = j;
+    Matrix<ElemType> hostGradient(numRows, numTouched, CPUDEVICE, SPARSE, matrixFormatSparseBlockCol);
+    hostGradient.SetSparseBlockColData(numRows, numTouched, compactIds, gradientColumns);
+
+    UpdateWeightsS(this, hostValues, hostGradient, hostSmoothedGradient, learnRatePerSample, momentumPerSample,
+                   actualMBSize, L2RegWeight, L1RegWeight, needAveMultiplier, m_useNesterovMomentum);
+
+    // scatter back: the smoothed gradient on the host, and the change of the parameter, added on the GPU
+    for (size_t j = 0; j < numTouched; j++)
+        memcpy(smoothedGradient.BufferPointer() + columnIds[j] * numRows, hostSmoothedGradient.BufferPointer() + j * numRows, numRows * sizeof(ElemType));
+    hostValues -= previousValues;
+    Matrix<ElemType> change(numRows, numTouched, hostValues.BufferPointer(), matrixFlagNormal, deviceId);
+    functionValues.AddFromRowStackedColumnsOf(change, sourceColumns);
+}
+
+// plain momentum SGD of all parameters in one go, see Matrix::MultiTensorNormalGrad(): same result as UpdateWeights() per node,
+// but in one or two kernel launches instead of several per parameter, which matters for models with many small parameters
+// Only for dense gradients on one device, and without gradient noise; returns false otherwise.
+template <class ElemType>
+bool SGD<ElemType>::UpdateWeightsFused(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradients,
+                                       const double learnRatePerSample, const double momentumPerSample, const size_t actualMBSize) const
+{
+    if (!m_fuseWeightUpdates || GradUpdateType() != GradientsUpdateType::None || GradientUpdateNoiseStd() > 0)
+        return false;
+
+    std::vector<Matrix<ElemType>*> values, gradients, smoothed;
+    std::vector<ComputationNodeBasePtr> nodes;
+    auto smoothedGradientIter = smoothedGradients.begin();
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+    {
+        if (!(*nodeIter)->IsParameterUpdateRequired())
+            continue;
+        auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+        if (node->Gradient().GetMatrixType() != DENSE || smoothedGradientIter->GetMatrixType() != DENSE ||
+            smoothedGradientIter->GetNumElements() != node->Value().GetNumElements() || smoothedGradientIter->GetDeviceId() != node->Value().GetDeviceId() ||
+            (!values.empty() && node->Value().GetDeviceId() != values[0]->GetDeviceId()))
+            return false;
+        values.push_back(&node->Value());
+        gradients.push_back(&node->Gradient());
+        smoothed.push_back(&*smoothedGradientIter);
+        nodes.push_back(node);
+    }
+    if (nodes.empty())
+        return false;
+
+    const double momentum = MomentumPerMB(momentumPerSample, actualMBSize);
+    Matrix<ElemType>::MultiTensorNormalGrad(values, gradients, smoothed, (ElemType) learnRatePerSample, (ElemType) momentum, m_useNesterovMomentum,
+                                            (ElemType)(m_clippingThresholdPerSample * actualMBSize), m_gradientClippingWithTruncation,
+                                            (ElemType)(m_L2RegWeight * actualMBSize), (ElemType)(learnRatePerSample * m_L1RegWeight * actualMBSize));
+    for (const auto& node : nodes)
+        node->BumpEvalTimeStamp();
+    return true;
+}
+
+// undo the loss scaling on all parameter gradients and adjust a dynamic loss scale
+// Returns false if a gradient overflowed, in which case the update must be skipped.
+// Since this runs on the aggregated gradients, all workers of a parallel job make the same decision.
+template <class ElemType>
+bool SGD<ElemType>::UnscaleGradients(const std::list<ComputationNodeBasePtr>& learnableNodes)
+{
+    if (m_currentLossScale == 1 && m_lossScaleGrowthInterval == 0)
+        return true;
+
+    // (with flat parameter buffers, one reduction covers the gradients in there)
+    const bool useGradientSpan = m_flatParameters && !m_flatParameters->IsEmpty();
+    bool overflow = useGradientSpan && !std::isfinite(m_flatParameters->GradientSpan().SumOfAbsElements());
+    for (const auto& node : learnableNodes)
+    {
+        if (overflow)
+            break;
+        if (node->IsParameterUpdateRequired() && !(useGradientSpan && m_flatParameters->HasGradient(node)) &&
+            !std::isfinite(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient().SumOfAbsElements()))
+            overflow = true;
+    }
+
+    if (overflow)
+    {
+        fprintf(stderr, "UnscaleGradients: gradient overflow at loss scale %.9g, skipping this minibatch.\n", m_currentLossScale);
+        if (m_lossScaleGrowthInterval > 0)
+            m_currentLossScale = max(m_currentLossScale / 2, 1.0);
+        m_numMBsSinceLossScaleChange = 0;
+        return false;
+    }
+
+    if (m_currentLossScale != 1)
+    {
+        if (useGradientSpan)
+            m_flatParameters->GradientSpan() *= (ElemType)(1.0 / m_currentLossScale);
+        for (const auto& node : learnableNodes)
+            if (node->IsParameterUpdateRequired() && !(useGradientSpan && m_flatParameters->HasGradient(node)))
+                dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient() *= (ElemType)(1.0 / m_currentLossScale);
+    }
+
+    if (m_lossScaleGrowthInterval > 0 && ++m_numMBsSinceLossScaleChange >= m_lossScaleGrowthInterval)
+    {
+        m_currentLossScale *= 2;
+        m_numMBsSinceLossScaleChange = 0;
+    }
+    return true;
+}
+
 template <class ElemType>
 void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const
 {
@@ -2083,6 +3308,13 @@ void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actual
         double maxGradientPerMB = m_clippingThresholdPerSample * actualMBSize;
         if (m_gradientClippingWithTruncation)
             gradient.InplaceTruncate((ElemType)(maxGradientPerMB));
+        else if (gradient.GetMatrixType() == DENSE)
+        {
+            // norm2 normalized, decided on the device
+            if (!m_gradientNorm)
+                m_gradientNorm = make_shared<Matrix<ElemType>>(gradient.GetDeviceId());
+            gradient.ClipFrobeniusNorm((ElemType) maxGradientPerMB, *m_gradientNorm);
+        }
         else
         {
             // norm2 normalized
@@ -2096,6 +3328,41 @@ void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actual
     }
 }
 
+// save the model of an epoch in full, or with m_incrementalCheckpoints as the differences to the last full one
+// The differences are against the values that were saved, so they do not accumulate errors from one epoch to the next.
+template <class ElemType>
+void SGD<ElemType>::SaveEpochModel(ComputationNetworkPtr net, const std::list<ComputationNodeBasePtr>& learnableNodes, const int epoch, const wstring& fileName)
+{
+    const bool saveInFull = m_incrementalCheckpoints == 0 || m_checkpointBaseEpoch < 0 || epoch == (int) m_maxEpochs - 1 ||
+                            epoch - m_checkpointBaseEpoch >= (int) m_incrementalCheckpoints;
+    if (!saveInFull)
+    {
+        FileOptions fileFormat = fileOptionsBinary;
+        if (m_incrementalCheckpointPrecision == L"fp16")
+            fileFormat = (FileOptions)(fileOptionsBinary | fileOptionsCompactFP16);
+        else if (m_incrementalCheckpointPrecision == L"int8")
+            fileFormat = (FileOptions)(fileOptionsBinary | fileOptionsCompactInt8);
+        net->SaveIncremental<ElemType>(fileName, GetModelNameForEpoch(m_checkpointBaseEpoch), m_checkpointBaseValues, fileFormat);
+        fprintf(stderr, "SGD: Saved epoch %d as an incremental checkpoint against epoch %d.\n", epoch + 1, m_checkpointBaseEpoch + 1);
+        return;
+    }
+
+    net->Save(fileName);
+    if (m_incrementalCheckpoints == 0)
+        return;
+    m_checkpointBaseEpoch = epoch;
+    m_checkpointBaseValues.clear();
+    for (const auto& node : learnableNodes)
+    {
+        const Matrix<ElemType>& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        if (value.GetMatrixType() != MatrixType::DENSE)
+            continue;
+        auto& baseValues = m_checkpointBaseValues[node->NodeName()];
+        baseValues.resize(value.GetNumElements());
+        value.CopySection(value.GetNumRows(), value.GetNumCols(), baseValues.data(), value.GetNumRows());
+    }
+}
+
 template <class ElemType>
 void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen,
                                        const double learnRatePerSample,
@@ -2108,6 +3375,8 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
     if ((g_mpi == nullptr) || g_mpi->IsMainNode())
     {
         wstring checkPointFileName = GetCheckPointFileNameForEpoch(int(epoch));
+        if (m_checkpointWriter) // (published by the caller)
+            checkPointFileName = m_checkpointWriter->StagingPath(checkPointFileName);
         // Saving into temporary file and then renaming it to the checkPointFileName
         // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
         wstring tempFileName = checkPointFileName + L".tmp";
@@ -2191,12 +3460,128 @@ bool SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
     return true;
 }
 
+// wait until the epoch model and checkpoint being published in the background are in place
+// With async checkpointing, this is collective, as the other ranks may read them next.
+template <class ElemType>
+void SGD<ElemType>::PrintCrossValidationResult(int epoch, const vector<double>& vScore) const
+{
+    fprintf(stderr, "Finished Epoch[%2d of %d]: [Validation Set] TrainLossPerSample = %.8g", epoch + 1, (int) m_maxEpochs, vScore[0]);
+    if (vScore.size() > 1)
+    {
+        fprintf(stderr, "; EvalErrPerSample = %.8g", vScore[1]);
+    }
+    fprintf(stderr, "\n");
+}
+
+template <class ElemType>
+void SGD<ElemType>::WaitForCheckpointWriter()
+{
+    if (!m_asyncCheckpointing)
+        return;
+    if (m_checkpointWriter)
+        m_checkpointWriter->Wait();
+    if (g_mpi != nullptr)
+        g_mpi->WaitAll();
+}
+
 template <class ElemType>
 wstring SGD<ElemType>::GetCheckPointFileNameForEpoch(const int epoch)
 {
     return GetModelNameForEpoch(epoch) + L".ckp";
 }
 
+template <class ElemType>
+wstring SGD<ElemType>::GetMidEpochModelFileName(const int epoch)
+{
+    return GetModelNameForEpoch(epoch) + L".partial";
+}
+
+// a mid-epoch checkpoint of the epoch counts if it is newer than the model of the epoch before
+// (The checkpoint is written after its model, and removed before the model is replaced, so that it implies the model.)
+template <class ElemType>
+bool SGD<ElemType>::HasMidEpochCheckPoint(const int epoch)
+{
+    const wstring modelFileName = GetMidEpochModelFileName(epoch);
+    return fexists((modelFileName + L".ckp").c_str()) && msra::files::fuptodate(modelFileName, GetModelNameForEpoch(epoch - 1), true);
+}
+
+template <class ElemType>
+void SGD<ElemType>::SaveMidEpochCheckPoint(ComputationNetworkPtr net, const MidEpochState& state, const std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    const wstring modelFileName = GetMidEpochModelFileName(state.epoch);
+    const wstring checkPointFileName = modelFileName + L".ckp";
+    _wunlink(checkPointFileName.c_str());
+    net->Save(modelFileName);
+
+    const wstring tempFileName = checkPointFileName + L".tmp";
+    {
+        File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMidEpochCKP");
+
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BPosition");
+        fstream << state.epoch << state.numReaderMinibatches << state.numMBsRun << state.epochSamples << state.totalSamplesSeen;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EPosition");
+
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
+        fstream << state.learnRatePerSample << state.minibatchSize;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
+
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCriteria");
+        fstream << state.criterion << state.evalErrors.size();
+        for (double evalError : state.evalErrors)
+            fstream << evalError;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECriteria");
+
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+        for (const auto& smoothedGradient : smoothedGradients)
+            fstream << smoothedGradient;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMidEpochCKP");
+        fstream.Flush();
+    }
+    renameOrDie(tempFileName, checkPointFileName);
+}
+
+// fills m_midEpochResume
+template <class ElemType>
+bool SGD<ElemType>::LoadMidEpochCheckPoint(const int epoch, std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    const wstring checkPointFileName = GetMidEpochModelFileName(epoch) + L".ckp";
+    if (!fexists(checkPointFileName.c_str()))
+        return false;
+
+    MidEpochState& state = m_midEpochResume;
+    File fstream(checkPointFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BMidEpochCKP");
+
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BPosition");
+    fstream >> state.epoch >> state.numReaderMinibatches >> state.numMBsRun >> state.epochSamples >> state.totalSamplesSeen;
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EPosition");
+    if (state.epoch != epoch)
+        RuntimeError("LoadMidEpochCheckPoint: %ls is a checkpoint of epoch %d, not of epoch %d.", checkPointFileName.c_str(), state.epoch + 1, epoch + 1);
+
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
+    fstream >> state.learnRatePerSample >> state.minibatchSize;
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
+
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BCriteria");
+    size_t numEvalErrors;
+    fstream >> state.criterion >> numEvalErrors;
+    state.evalErrors.resize(numEvalErrors);
+    for (auto& evalError : state.evalErrors)
+        fstream >> evalError;
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECriteria");
+
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+    for (auto& smoothedGradient : smoothedGradients)
+        fstream >> smoothedGradient;
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EMidEpochCKP");
+    return true;
+}
+
 template <class ElemType>
 wstring SGD<ElemType>::GetModelNameForEpoch(const int epoch, bool bLastModel)
 {
@@ -2369,8 +3754,12 @@ static GradientsUpdateType ParseGradUpdateType(const wstring& s)
         return GradientsUpdateType::RmsProp;
     else if (!_wcsicmp(s.c_str(), L"fsAdagrad"))
         return GradientsUpdateType::FSAdaGrad;
+    else if (!_wcsicmp(s.c_str(), L"lars"))
+        return GradientsUpdateType::Lars;
+    else if (!_wcsicmp(s.c_str(), L"lamb"))
+        return GradientsUpdateType::Lamb;
     else
-        InvalidArgument("ParseGradUpdateType: Invalid Gradient Updating Type. Valid values are (none | adagrad | rmsProp | fsAdagrad )");
+        InvalidArgument("ParseGradUpdateType: Invalid Gradient Updating Type. Valid values are (none | adagrad | rmsProp | fsAdagrad | lars | lamb )");
 }
 
 static ParallelizationMethod ParseParallelizationMethod(const wstring& s)
@@ -2381,8 +3770,55 @@ static ParallelizationMethod ParseParallelizationMethod(const wstring& s)
         return ParallelizationMethod::DataParallelSGD;
     else if (!_wcsicmp(s.c_str(), L"ModelAveragingSGD"))
         return ParallelizationMethod::ModelAveragingSGD;
+    else if (!_wcsicmp(s.c_str(), L"BlockMomentumSGD"))
+        return ParallelizationMethod::BlockMomentumSGD;
+    else if (!_wcsicmp(s.c_str(), L"AsyncParameterServerSGD"))
+        return ParallelizationMethod::AsyncParameterServerSGD;
     else
-        InvalidArgument("ParseParallelizationMethod: Invalid Parallelization Method. Valid values are (none | dataParallelSGD | modelAveragingSGD)");
+        InvalidArgument("ParseParallelizationMethod: Invalid Parallelization Method. Valid values are (none | dataParallelSGD | modelAveragingSGD | blockMomentumSGD | asyncParameterServerSGD)");
+}
+
+static GradientWireFormat ParseGradientWireFormat(const wstring& s)
+{
+    if (!_wcsicmp(s.c_str(), L"") || !_wcsicmp(s.c_str(), L"full"))
+        return GradientWireFormat::Full;
+    else if (!_wcsicmp(s.c_str(), L"fp16"))
+        return GradientWireFormat::FP16;
+    else if (!_wcsicmp(s.c_str(), L"bf16") || !_wcsicmp(s.c_str(), L"bfloat16"))
+        return GradientWireFormat::BFloat16;
+    else
+        InvalidArgument("ParseGradientWireFormat: Invalid gradient wire format '%ls'. Valid values are (full | fp16 | bf16)", s.c_str());
+}
+
+// "pattern=device;pattern=device", e.g. "L1.*=0;L2.*=1"
+static vector<pair<wstring, DEVICEID_TYPE>> ParseDevicePlacement(const wstring& s)
+{
+    vector<pair<wstring, DEVICEID_TYPE>> placement;
+    for (const auto& item : msra::strfun::split(s, L";"))
+    {
+        const auto parts = msra::strfun::split(item, L"=");
+        if (parts.size() != 2)
+            InvalidArgument("ParseDevicePlacement: '%ls' is not of the form 'nodeNamePattern=deviceId'.", item.c_str());
+        placement.push_back(make_pair(parts[0], (DEVICEID_TYPE) msra::strfun::toint(parts[1])));
+    }
+    return placement;
+}
+
+// "node=device:device:...;...", e.g. "OutputTimes=0:1:2:3"
+static vector<pair<wstring, vector<DEVICEID_TYPE>>> ParseShardedTimes(const wstring& s)
+{
+    vector<pair<wstring, vector<DEVICEID_TYPE>>> shardedTimes;
+    for (const auto& item : msra::strfun::split(s, L";"))
+    {
+        const auto parts = msra::strfun::split(item, L"=");
+        if (parts.size() != 2)
+            InvalidArgument("ParseShardedTimes: '%ls' is not of the form 'nodeName=deviceId:deviceId:...'.", item.c_str());
+        vector<DEVICEID_TYPE> devices;
+        for (const auto& device : msra::strfun::split(parts[1], L":"))
+            devices.push_back((DEVICEID_TYPE) msra::strfun::toint(device));
+        shardedTimes.push_back(make_pair(parts[0], devices));
+    }
+    return shardedTimes;
 }
 
 static LearningRateSearchAlgorithm ParseLearningRateSearchType(const wstring& s)
@@ -2431,6 +3867,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
 
     m_numPrevLearnRates = configAALR(L"numPrevLearnRates", (size_t) 5);
     m_numBestSearchEpoch = configAALR(L"numBestSearchEpoch", (size_t) 1);
+    m_parallelLearnRateSearch = configAALR(L"parallelLearnRateSearch", false);
     m_loadBestModel = configAALR(L"loadBestModel", true);
     m_useCVSetControlLRIfCVExists = configAALR(L"UseCVSetControlLRIfCVExists", true);
     m_useEvalCriterionControlLR = configAALR(L"UseEvalCriterionControlLR", false);
@@ -2441,7 +3878,10 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_mbSize = configSGD(L"minibatchSize", ConfigRecordType::Array(intargvector(vector<int>{256})));
     m_truncated = configSGD(L"truncated", false);
     m_maxSamplesInRAM = configSGD(L"maxSamplesInRAM", (size_t) SIZE_MAX);
+    m_autoMaxSamplesInRAM = configSGD(L"autoMaxSamplesInRAM", false);
+    m_autoMaxSamplesInRAMMemoryFraction = configSGD(L"autoMaxSamplesInRAMMemoryFraction", 0.8);
     m_numSubminiBatches = configSGD(L"numSubminibatches", (size_t) 1);
+    m_numGradientAccumulationSteps = configSGD(L"gradientAccumulationSteps", (size_t) 1);
 
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
     m_epochSize = configSGD(L"epochSize", (size_t) 0);
@@ -2451,7 +3891,20 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_maxComputedEpochSize = m_epochSize;
 
     // the total number of epochs to run.
-    m_maxEpochs = configSGD(L"maxEpochs");
+    // Alternatively, training runs for maxSamples samples, in epochs of epochSize samples, which is then the interval
+    // of checkpoints, cross-validation and the learning-rate schedule; e.g. for a stream of data that has no sweeps
+    // (ChunkedBinaryReader with streamFiles). It ends early if an epoch gets no data at all.
+    m_maxSamples = configSGD(L"maxSamples", (size_t) 0);
+    if (m_maxSamples > 0)
+    {
+        if (m_epochSize == requestDataSize)
+            InvalidArgument("maxSamples requires an epochSize.");
+        m_maxEpochs = (m_maxSamples + m_epochSize - 1) / m_epochSize;
+        if (configSGD.Exists(L"maxEpochs"))
+            m_maxEpochs = min(m_maxEpochs, (size_t) configSGD(L"maxEpochs"));
+    }
+    else
+        m_maxEpochs = configSGD(L"maxEpochs");
 
     // Note: Momentum is best specified as a MB-size agnostic fashion.
     // Because momentum per sample is a number very close to 1, it is more handy to use a logarithmic specification.
@@ -2465,6 +3918,25 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
 
     m_maxTempMemSizeInSamplesForCNN = configSGD(L"maxTempMemSizeInSamplesForCNN", (size_t) 0);
 
+    // gradient checkpointing: number of top-level nodes per recompute segment (0 = store all outputs)
+    m_recomputeSegmentLength = configSGD(L"recomputeSegmentLength", (size_t) 0);
+
+    // activation offload: copy outputs to host memory between their forward prop and their backprop
+    m_offloadActivations = configSGD(L"offloadActivations", false);
+
+    // per-node timing and memory profile, optionally with a Chrome trace of the first minibatches
+    m_profileNodes = configSGD(L"profileNodes", false);
+    wstring matrixTransferMonitor = configSGD(L"matrixTransferMonitor", L"off");
+    m_matrixTransferMonitor = MatrixTransferMonitor::ParseMode(matrixTransferMonitor);
+    wstring nodeProfileTrace = configSGD(L"nodeProfileTrace", L"");
+    m_nodeProfileTrace = nodeProfileTrace;
+    m_nodeProfileTraceMinibatches = configSGD(L"nodeProfileTraceMinibatches", (size_t) 10);
+    m_prefetchMinibatches = configSGD(L"prefetchMinibatches", false);
+    m_lossScale = configSGD(L"lossScale", 1.0);
+    m_lossScaleGrowthInterval = configSGD(L"lossScaleGrowthInterval", (size_t) 0);
+    if (m_lossScale <= 0)
+        InvalidArgument("lossScale must be positive.");
+
     m_traceLevel = configSGD(L"traceLevel", (int) 0);
     m_numMBsToShowResult = configSGD(L"numMBsToShowResult", (size_t) 10);
     m_numMBsToCUDAProfile = configSGD(L"numMBsToCUDAProfile", (size_t) 0);
@@ -2488,6 +3960,16 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     double gaussianNoiseInjecStd = configSGD(L"gaussianNoiseInjectStd", 0.0);
     m_gradType.mType = gradUpdateType;
     m_gradType.mGaussianNoiseInjectStd = (float) gaussianNoiseInjecStd;
+    m_fuseWeightUpdates = configSGD(L"fuseWeightUpdates", true);
+    m_hostOptimizerState = configSGD(L"hostOptimizerState", false);
+    m_hostOptimizerStateMinElements = configSGD(L"hostOptimizerStateMinElements", (size_t) 1048576);
+    m_useCUDAGraphs = configSGD(L"cudaGraphs", false);
+    m_traceTelemetry = configSGD(L"telemetry", false);
+    m_traceMemoryUsage = configSGD(L"traceMemoryUsage", false);
+    m_benchmarkMinibatches = configSGD(L"benchmarkMinibatches", (size_t) 0);
+    m_benchmarkWarmupMinibatches = configSGD(L"benchmarkWarmupMinibatches", (size_t) 10);
+    wstring telemetryFile = configSGD(L"telemetryFile", L"");
+    m_telemetryFile = telemetryFile;
 
     // extract RMSProp parameters from config, if they exist. Default to reasonable values.
     m_rpi.dec = configSGD(L"rms_wgt_dec", 0.75);
@@ -2496,6 +3978,13 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_rpi.max = configSGD(L"rms_wgt_max", 10.0);
     m_rpi.gamma = configSGD(L"rms_gamma", 0.99);
 
+    // LARS and LAMB parameters
+    m_lwi.trustCoefficient = configSGD(L"lars_trustCoefficient", 0.001);
+    m_lwi.beta1 = configSGD(L"lamb_beta1", 0.9);
+    m_lwi.beta2 = configSGD(L"lamb_beta2", 0.999);
+    m_lwi.epsilon = configSGD(L"lamb_epsilon", 1e-6);
+    m_lwi.weightDecay = configSGD(L"lamb_weightDecay", 0.0);
+
     m_needAveMultiplier = configSGD(L"normWithAveMultiplier", true);
     m_L2RegWeight = configSGD(L"L2RegWeight", 0.0);
     m_L1RegWeight = configSGD(L"L1RegWeight", 0.0);
@@ -2509,8 +3998,14 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
         m_gradType.mType = gradUpdateType;
     }
 
+    if (m_hostOptimizerState && gradUpdateType != GradientsUpdateType::None && gradUpdateType != GradientsUpdateType::AdaGrad)
+        InvalidArgument("hostOptimizerState: Only supported with gradUpdateType=None or AdaGrad.");
+
     m_adaptationRegType = ParseAdaptationRegType(configSGD(L"adaptationRegType", L"None"));
     m_adaptationRegWeight = configSGD(L"adaptationRegWeight", 0.0);
+    wstring adaptationRefCache = configSGD(L"adaptationRefCache", L"");
+    m_adaptationRefCache = adaptationRefCache;
+    m_adaptationRefCacheTopK = configSGD(L"adaptationRefCacheTopK", (size_t) 20);
 
     // gradient check setup
     m_doGradientCheck = configSGD(L"gradientcheck", false);
@@ -2522,6 +4017,27 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     }
 
     m_useAllDataForPreComputedNode = configSGD(L"UseAllDataForPreComputedNode", true);
+    m_distributedPreCompute = configSGD(L"distributedPreCompute", true);
+    m_asyncCrossValidation = configSGD(L"asyncCrossValidation", false);
+    m_asyncCrossValidationDeviceId = configSGD(L"asyncCrossValidationDeviceId", (int) DEVICEID_NOTYETDETERMINED); // default: the training device
+    m_localDevices = configSGD(L"localDevices", ConfigRecordType::Array(intargvector()));
+    m_numCPUReplicas = configSGD(L"numCPUReplicas", (size_t) 1);
+    m_cpuCoresPerReplica = configSGD(L"cpuCoresPerReplica", (size_t) 0);
+    if (m_numCPUReplicas == 0)
+        InvalidArgument("numCPUReplicas must be at least 1.");
+    m_flatParameterBuffers = configSGD(L"flatParameterBuffers", false);
+    wstring devicePlacement = configSGD(L"devicePlacement", L"");
+    m_devicePlacement = ParseDevicePlacement(devicePlacement);
+    wstring shardTimes = configSGD(L"shardTimes", L"");
+    m_shardedTimes = ParseShardedTimes(shardTimes);
+    m_stageDevices = configSGD(L"stageDevices", ConfigRecordType::Array(intargvector()));
+    wstring preComputeCache = configSGD(L"preComputeCache", L"");
+    m_preComputeCache = preComputeCache;
+
+    if (m_numGradientAccumulationSteps == 0)
+        InvalidArgument("gradientAccumulationSteps must be at least 1.");
+    if (m_numGradientAccumulationSteps > 1 && (m_numSubminiBatches > 1 || m_maxSamplesInRAM < SIZE_MAX || !m_localDevices.empty() || m_numCPUReplicas > 1))
+        InvalidArgument("gradientAccumulationSteps cannot be combined with numSubminibatches, maxSamplesInRAM, localDevices, or numCPUReplicas.");
 
     // consistency checks
     for (size_t i = 0; i < m_mbSize.size(); i++)
@@ -2624,9 +4140,25 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numGradientBits = 32;
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_gradientBucketSizeInBytes = 0;
+    m_allReduceAlgorithm = AllReduceAlgorithm::MPI;
+    m_useGPUDirectGradientExchange = false;
+    m_sparseGradientDensity = 0;
+    m_numBackupWorkers = 0;
+    m_loadBalancingWindow = 0;
+    m_gradientWireFormat = GradientWireFormat::Full;
     m_enableDistributedMBReading = false;
     m_parallelizationStartEpochNum = 0;
+    m_elasticTraining = false;
     m_nFramesBetweenMASync = 40000; // default 40k frames
+    m_modelDeltaBits = 8 * sizeofElemType;
+    m_overlapModelAveraging = false;
+    m_blockMomentumPerSync = -1;
+    m_blockLearningRate = 1.0;
+    m_useNesterovBlockMomentum = true;
+    m_numParameterServers = 0;
+    m_parameterServerSyncFrequencyInMBs = 1;
+    m_maxStaleness = 4;
 
     if ((g_mpi != nullptr) && configSGD.Exists(L"ParallelTrain"))
     {
@@ -2635,6 +4167,10 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
         m_parallelizationStartEpochNum = configParallelTrain(L"parallelizationStartEpoch", (int) 1) - 1; // Epoch numbers internally are 0 based
         m_enableDistributedMBReading = configParallelTrain(L"distributedMBReading", false);
         m_syncStatsTrace = configParallelTrain(L"syncPerfStats", (int) 0);
+        m_allReduceAlgorithm = ParseAllReduceAlgorithm(configParallelTrain(L"allReduceAlgorithm", L"mpi"));
+        m_elasticTraining = configParallelTrain(L"elasticTraining", false);
+        if (m_elasticTraining && m_parallelizationMethod != ParallelizationMethod::DataParallelSGD)
+            InvalidArgument("elasticTraining is only supported with parallelizationMethod=dataParallelSGD.");
 
         if (configParallelTrain.Exists(L"DataParallelSGD"))
         {
@@ -2643,6 +4179,14 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_numGradientBits = configDataParallelSGD(L"gradientBits", defaultGradientBits);
             m_zeroThresholdFor1Bit = configDataParallelSGD(L"useZeroThresholdFor1BitQuantization", true);
             m_bufferedAsyncGradientAggregation = configDataParallelSGD(L"useBufferedAsyncGradientAggregation", false);
+            m_gradientBucketSizeInBytes = (size_t) (configDataParallelSGD(L"gradientBucketSizeInMB", 0.0) * 1024 * 1024);
+            m_useGPUDirectGradientExchange = configDataParallelSGD(L"useGPUDirect", false);
+            m_sparseGradientDensity = configDataParallelSGD(L"sparseGradientDensity", 0.0);
+            if (m_sparseGradientDensity < 0 || m_sparseGradientDensity > 1)
+                InvalidArgument("sparseGradientDensity must be in the range [0, 1] (0 to disable).");
+            m_numBackupWorkers = configDataParallelSGD(L"numBackupWorkers", (size_t) 0);
+            m_loadBalancingWindow = configDataParallelSGD(L"loadBalancingWindow", (size_t) 0);
+            m_gradientWireFormat = ParseGradientWireFormat(configDataParallelSGD(L"gradientWireFormat", L"full"));
             if ((m_numGradientBits < 1) || (m_numGradientBits > (8 * sizeofElemType)))
             {
                 InvalidArgument("gradientBits must be in the range [1, 32] when using precision=float and in range [1, 64] when using precision=double!");
@@ -2653,6 +4197,32 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
         {
             const ConfigRecordType& configMASGD(configParallelTrain(L"ModelAveragingSGD", ConfigRecordType::Record()));
             m_nFramesBetweenMASync = configMASGD(L"syncFrequencyInFrames", (size_t) 40000);
+            m_modelDeltaBits = configMASGD(L"modelDeltaBits", (size_t) (8 * sizeofElemType));
+            m_overlapModelAveraging = configMASGD(L"overlapSync", false);
+        }
+
+        if (configParallelTrain.Exists(L"BlockMomentumSGD"))
+        {
+            const ConfigRecordType& configBMSGD(configParallelTrain(L"BlockMomentumSGD", ConfigRecordType::Record()));
+            m_nFramesBetweenMASync = configBMSGD(L"blockSizePerWorker", (size_t) 120000);
+            m_blockMomentumPerSync = configBMSGD(L"blockMomentumPerSync", -1.0);
+            m_blockLearningRate = configBMSGD(L"blockLearningRate", 1.0);
+            m_useNesterovBlockMomentum = configBMSGD(L"useNesterovMomentum", true);
+            m_modelDeltaBits = configBMSGD(L"modelDeltaBits", (size_t) (8 * sizeofElemType));
+            if (m_blockMomentumPerSync >= 1.0)
+                InvalidArgument("blockMomentumPerSync must be less than 1.");
+            if (m_nFramesBetweenMASync == 0)
+                InvalidArgument("blockSizePerWorker must be greater than 0.");
+            if (configBMSGD.Exists(L"overlapSync"))
+                InvalidArgument("overlapSync is not supported for BlockMomentumSGD: the block momentum filters the average of the current block.");
+        }
+
+        if (configParallelTrain.Exists(L"AsyncParameterServerSGD"))
+        {
+            const ConfigRecordType& configPS(configParallelTrain(L"AsyncParameterServerSGD", ConfigRecordType::Record()));
+            m_numParameterServers = configPS(L"numServers", (size_t) 0);
+            m_parameterServerSyncFrequencyInMBs = configPS(L"syncFrequencyInMBs", (size_t) 1);
+            m_maxStaleness = configPS(L"maxStaleness", (size_t) 4);
         }
     }
 }
@@ -17,6 +17,7 @@
 #include <chrono>
 #include <random>
 #include "Profiler.h"
+#include "TimerUtility.h"
 
 using namespace std; // ugh! TODO: get rid of this from .h files!!!
 
@@ -40,18 +41,31 @@ enum class GradientsUpdateType : int
     None,
     AdaGrad,
     RmsProp,
-    FSAdaGrad
+    FSAdaGrad,
+    Lars, // layer-wise adaptive rate scaling, for large minibatches
+    Lamb  // layer-wise adaptive moments (Adam with a per-parameter trust ratio)
 };
 
-// TODO: While currently combining these methods is not supported,
+// TODO: While currently combining these methods is mostly not supported,
 // these are not mutually exclusive and we can/should support combinations of these
-// in the future
+// in the future. (ModelAveragingSGD and BlockMomentumSGD combine with the in-process GPU replicas
+// of localDevices: exact gradient aggregation within a machine, model averaging across machines.)
+// how data-parallel SGD sends gradients: in full precision, or converted to 16 bits for the all-reduce
+enum class GradientWireFormat : int
+{
+    Full,
+    FP16,
+    BFloat16
+};
+
 enum class ParallelizationMethod : int
 {
     None = 0,
     DataParallelSGD = 1,
     ModelAveragingSGD = (1 << 1),
-    ModelParallelSGD = (1 << 2), // Currently unsupported
+    ModelParallelSGD = (1 << 2), // Currently unsupported; model parallelism within a process is configured by devicePlacement and shardTimes instead
+    BlockMomentumSGD = (1 << 3), // model averaging with blockwise model-update filtering (BMUF)
+    AsyncParameterServerSGD = (1 << 4), // asynchronous, with bounded staleness
 };
 
 // configuration parameters associated with RMSProp learning algorithm
@@ -73,6 +87,25 @@ struct RMSPropInfo
     }
 };
 
+// configuration parameters of the layer-wise adaptive updates (LARS, LAMB)
+struct LayerwiseAdaptiveInfo
+{
+    double trustCoefficient; // LARS
+    double beta1;            // LAMB
+    double beta2;
+    double epsilon;
+    double weightDecay; // LAMB, decoupled from the gradient (unlike L2RegWeight)
+
+    LayerwiseAdaptiveInfo()
+    {
+        trustCoefficient = 0.001;
+        beta1 = 0.9;
+        beta2 = 0.999;
+        epsilon = 1e-6;
+        weightDecay = 0.0;
+    }
+};
+
 struct GradientUpdateInfo
 {
     GradientsUpdateType mType;
@@ -159,6 +192,13 @@ protected:
     // default is 1, which means no subminibatch is used
     // if m_maxTempMemSizeInSamples = SIZE_MAX (which means users do not specify the option) and m_numSubminiBatches > 1
     // we divide one minibatch to m_numSubminiBatches subMinibatches
+    bool m_autoMaxSamplesInRAM;
+    double m_autoMaxSamplesInRAMMemoryFraction;
+    // probe instead of configure m_maxSamplesInRAM: the largest minibatch whose planned node memory (see MatrixPool) fits into
+    // this fraction of the memory left on the GPU after allocation of the model
+    size_t m_numGradientAccumulationSteps;
+    // leaner alternative to sub-minibatches: the reader delivers each minibatch as this many micro-batches,
+    // whose gradients are accumulated in place in the parameters' gradients; aggregation and model update happen once per minibatch
 
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
     size_t m_epochSize;
@@ -166,18 +206,23 @@ protected:
 
     // the total number of epochs to run.
     size_t m_maxEpochs;
+    // alternatively, the total number of samples to train on, in epochs of m_epochSize; 0 if not given
+    size_t m_maxSamples;
 
     bool m_gradientClippingWithTruncation;
     double m_clippingThresholdPerSample;
 
     intargvector m_numMiniBatch4LRSearch;
     size_t m_numBestSearchEpoch;
+    bool m_parallelLearnRateSearch; // each MPI rank trains on its own candidate learning rates in the search before an epoch
 
     LearningRateSearchAlgorithm m_autoLearnRateSearchType;
 
     AdaptationRegType m_adaptationRegType;
     double m_adaptationRegWeight;
     bool m_needAdaptRegularization;
+    wstring m_adaptationRefCache;      // if not empty, the KL reference outputs are kept per frame in this file (see ReferenceOutputCache.h)
+    size_t m_adaptationRefCacheTopK;   // outputs kept per frame
 
     bool m_loadBestModel;
     double m_reduceLearnRateIfImproveLessThan;
@@ -200,6 +245,27 @@ protected:
     floatargvector m_dropoutRates;
     size_t m_maxTempMemSizeInSamplesForCNN;
 
+    // gradient checkpointing: recompute node outputs in segments of this many nodes during backprop (0 = off)
+    size_t m_recomputeSegmentLength;
+
+    // activation offload: keep outputs that only backprop reads in host memory in between (see ComputationNetwork::SetOffloadActivations())
+    bool m_offloadActivations;
+
+    // per-node profiling (see NodeProfiler.h): report per epoch, and trace of the first minibatches if a file is given
+    bool m_profileNodes;
+    // counting (or, in strict mode, forbidding) implicit CPU/GPU transfers of matrices in nodes (see MatrixTransferMonitor), reported per epoch
+    MatrixTransferMonitor::Mode m_matrixTransferMonitor;
+    std::wstring m_nodeProfileTrace;
+    size_t m_nodeProfileTraceMinibatches;
+
+    // read and upload the next minibatch on a background thread while the current one is trained
+    bool m_prefetchMinibatches;
+
+    // loss scaling: the criterion gradient is seeded with m_lossScale instead of 1, and the parameter gradients are unscaled before the update
+    // With m_lossScaleGrowthInterval > 0 the scale is dynamic: halved on overflow, doubled after that many minibatches without one.
+    double m_lossScale;
+    size_t m_lossScaleGrowthInterval;
+
     int m_traceLevel;
 
     size_t m_numPrevLearnRates;
@@ -207,7 +273,17 @@ protected:
     double m_minLearnRate;
 
     GradientUpdateInfo m_gradType;
+    bool m_fuseWeightUpdates; // see SGD::UpdateWeightsFused()
+    bool m_hostOptimizerState;               // keep the smoothed gradients of large GPU parameters in host memory (see SGD::UpdateWeightsOnHost())
+    size_t m_hostOptimizerStateMinElements;  // ...those with at least this many elements
+    bool m_useCUDAGraphs;     // replay forward and backward prop of repeating minibatch shapes as CUDA graphs (see ComputeGraphReplay.h)
+    bool m_traceTelemetry;    // device and wait-time statistics per progress interval (see TrainingTelemetry.h)
+    bool m_traceMemoryUsage;  // device memory per subsystem, current and peak, per progress interval (see DeviceMemoryAccounting)
+    size_t m_benchmarkMinibatches;       // > 0: benchmark mode, stop training after measuring this many minibatches (see SGD::ReportBenchmark())
+    size_t m_benchmarkWarmupMinibatches; // ...that follow this many unmeasured ones
+    wstring m_telemetryFile;  // if not empty, where they are also written for scraping
     RMSPropInfo m_rpi;
+    LayerwiseAdaptiveInfo m_lwi;
 
     int m_numMBsToShowResult;
     int m_numMBsToCUDAProfile;
@@ -218,11 +294,36 @@ protected:
     bool m_doUnitTest;
 
     bool m_useAllDataForPreComputedNode;
+    // shard the precompute pass over the MPI workers and merge the statistics with one all-reduce
+    bool m_distributedPreCompute;
+    // file that keeps the precomputed values across restarts, for as long as the reader config and the nodes stay the same
+    wstring m_preComputeCache;
+
+    // evaluate the CV set on a snapshot in the background while the next epoch trains; the LR control gets the result one epoch late
+    bool m_asyncCrossValidation;
+    DEVICEID_TYPE m_asyncCrossValidationDeviceId;
+
+    // data-parallel training within this process: additional GPUs that each hold a replica of the network (see DataParallelReplicas.h)
+    intargvector m_localDevices;
+    // the same with a CPU training device: this many replicas (the main network included), each on a group of cpuCoresPerReplica cores
+    size_t m_numCPUReplicas;
+    size_t m_cpuCoresPerReplica; // 0: the cores of the machine divided among the replicas
+
+    // all parameter values and gradients in one buffer each, so that gradient aggregation works on one matrix (see FlatParameterBuffers.h)
+    bool m_flatParameterBuffers;
+
+    // model parallelism: nodes moved to other GPUs by name pattern, and Times nodes whose weights are split over GPUs (see ComputationNetwork::PlaceNodesOnDevices())
+    vector<pair<wstring, DEVICEID_TYPE>> m_devicePlacement;
+    vector<pair<wstring, vector<DEVICEID_TYPE>>> m_shardedTimes;
+    // model parallelism: GPUs for the first stages of the network, the training device runs the last
+    // The stages run one after another on each (sub-)minibatch; this spreads a model that does not fit on one GPU, it does not pipeline.
+    intargvector m_stageDevices;
 
     // Parallel training
     ParallelizationMethod m_parallelizationMethod;
     bool m_enableDistributedMBReading;
     int m_parallelizationStartEpochNum;
+    bool m_elasticTraining; // if ranks are lost, the survivors go back to the start of the epoch and train it among themselves
 
     // decide if/how often we measure and show sync performance stats (seconds spend on sync, seconds since last sync etc.) ?
     // 0: No sync perfomance stats
@@ -234,9 +335,30 @@ protected:
     int m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
     bool m_zeroThresholdFor1Bit;
+    size_t m_gradientBucketSizeInBytes; // > 0: start exchanging gradients in buckets of this size during backprop
+    AllReduceAlgorithm m_allReduceAlgorithm;
+    bool m_useGPUDirectGradientExchange; // pass GPU gradients to CUDA-aware MPI without staging them in CPU memory
+    double m_sparseGradientDensity;      // > 0: send only this fraction of largest gradient entries, with error feedback
+    size_t m_numBackupWorkers;           // > 0: every step sums the gradients of the first workers but this many, dropping the late ones
+    size_t m_loadBalancingWindow;        // > 0: split minibatches by the throughput of the workers over this many minibatches
+    GradientWireFormat m_gradientWireFormat;
 
     // Parallel training related with MA
     size_t m_nFramesBetweenMASync;
+    size_t m_modelDeltaBits;       // < 8 * sizeof(ElemType): syncs exchange model deltas as FP16 (16) or quantized to this many bits
+    bool m_overlapModelAveraging;  // a sync only starts the exchange, and the next one applies it
+
+    // blockwise model-update filtering: the averaged model delta of each block (m_nFramesBetweenMASync samples per worker)
+    // is smoothed with block momentum and scaled by the block learning rate before it is applied to the global model
+    double m_blockMomentumPerSync; // < 0: default to 1 - 1/numWorkers
+    double m_blockLearningRate;
+    bool m_useNesterovBlockMomentum;
+
+    // asynchronous parameter-server training: models are synced every m_parameterServerSyncFrequencyInMBs minibatches,
+    // and no worker gets more than m_maxStaleness syncs ahead of the slowest one
+    size_t m_numParameterServers; // 0: all ranks
+    size_t m_parameterServerSyncFrequencyInMBs;
+    size_t m_maxStaleness;
 
     bool m_needAveMultiplier;
     double m_L2RegWeight;
@@ -256,6 +378,18 @@ protected:
 template <class ElemType>
 class IDistGradAggregator;
 
+template <class ElemType>
+class AsyncParameterServer;
+template <class ElemType>
+class DataParallelReplicas;
+template <class ElemType>
+class FlatParameterBuffers;
+template <class ElemType>
+class ModelDeltaExchange;
+class AsyncCheckpointWriter;
+class ReferenceOutputCache;
+class WorkerLoadBalancer;
+
 // -----------------------------------------------------------------------
 // class SGD
 // -----------------------------------------------------------------------
@@ -277,15 +411,32 @@ public:
           // TODO: The next few do not belong into SGD any more than the network or reader we operate on. Either move network and reader in here, or move these out.
           m_modelPath((const wstring&) configSGD(L"modelPath")),
           m_keepCheckPointFiles(configSGD(L"keepCheckPointFiles", false)),
+          m_numMBsToCheckpoint(configSGD(L"numMBsToCheckpoint", (size_t) 0)),
+          m_asyncCheckpointing(configSGD(L"asyncCheckpointing", false)),
+          m_checkpointStagingDir((const wstring&) configSGD(L"checkpointStagingDir", L"")),
+          m_incrementalCheckpoints(configSGD(L"incrementalCheckpoints", (size_t) 0)),
+          m_incrementalCheckpointPrecision((const wstring&) configSGD(L"incrementalCheckpointPrecision", L"fp16")),
+          m_checkpointBaseEpoch(-1),
+          m_trainOnThisRankOnly(false),
           // m_validateAfterModelReloading(configSGD(L"validateAfterModelReloading", true)),
           m_trainCriterionNodeName((const wstring&) configSGD(L"trainCriterionNodeName", L"")),
           m_evalCriterionNodeName((const wstring&) configSGD(L"evalCriterionNodeName", L"")),
           m_prevChosenMinibatchSize(0),
           m_lastFinishedEpochTrainLoss(0.0),
+          m_currentLossScale(m_lossScale),
+          m_numMBsSinceLossScaleChange(0),
           m_distGradAgg(nullptr),
+          m_parameterServer(nullptr),
           m_gradHeader(nullptr)
     {
+        m_startupTimer.Start();
         msra::files::make_intermediate_dirs(m_modelPath);
+        m_midEpochResume.epoch = -1;
+        m_midEpochResume.numReaderMinibatches = 0;
+        if (m_numMBsToCheckpoint > 0 && m_overlapModelAveraging)
+            InvalidArgument("numMBsToCheckpoint cannot be combined with overlapSync: the models of the workers are never the same mid-epoch.");
+        if (m_incrementalCheckpointPrecision != L"fp16" && m_incrementalCheckpointPrecision != L"int8" && m_incrementalCheckpointPrecision != L"full")
+            InvalidArgument("incrementalCheckpointPrecision must be fp16, int8 or full.");
     }
     // note: This must be in the header, as we cannot properly specialize this constructor in the CPP to make sure all versions are generated.
 
@@ -299,11 +450,22 @@ public:
                IDataReader<ElemType>* trainSetDataReader,
                IDataReader<ElemType>* validationSetDataReader,
                const bool makeMode = true);
+    // Train() with readers that are still being created, e.g. on another thread: the network is created or loaded
+    // meanwhile, and getReadersFn() then returns the training and validation (or nullptr) readers, waiting for them
+    void TrainWithDeferredReaders(function<ComputationNetworkPtr(DEVICEID_TYPE)> createNetworkFn, DEVICEID_TYPE deviceId,
+                                  const function<pair<IDataReader<ElemType>*, IDataReader<ElemType>*>()>& getReadersFn,
+                                  const bool makeMode = true);
     void Adapt(wstring origModelFileName, wstring refNodeName,
                IDataReader<ElemType>* trainSetDataReader,
                IDataReader<ElemType>* validationSetDataReader,
                const DEVICEID_TYPE deviceID, const bool makeMode = true);
 
+    // text that identifies the training reader's configuration, part of the key of the precompute cache
+    void SetReaderConfigKey(const wstring& key)
+    {
+        m_readerConfigKey = key;
+    }
+
 protected:
 
     std::vector<ComputationNodeBasePtr>& GetTrainCriterionNodes(ComputationNetworkPtr net);
@@ -323,6 +485,9 @@ protected:
                     std::vector<ComputationNodeBasePtr>& featureNodes,
                     std::vector<ComputationNodeBasePtr>& labelNodes,
                     std::map<std::wstring, Matrix<ElemType>*>* inputMatrices);
+    wstring PreComputeCacheKey(const std::list<ComputationNodeBasePtr>& nodes) const;
+    bool LoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const wstring& key);
+    void SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const wstring& key) const;
 
     // return a reasonable initial learning rate based on the initial mbsize
     double SearchForBestLearnRate(ComputationNetworkPtr net,
@@ -339,6 +504,21 @@ protected:
                                   std::list<Matrix<ElemType>>& smoothedGradients,
                                   const bool learnRateInitialized,
                                   const double largestPrevLearnRatePerSample);
+    double SearchForBestLearnRateAcrossRanks(ComputationNetworkPtr net,
+                                             ComputationNetworkPtr refNet,
+                                             const ComputationNodeBasePtr& refNode, const int epochNumber,
+                                             const size_t numFramesToUseInSearch,
+                                             double learnRatePerSample,
+                                             const double minLearnRate,
+                                             double prevCriterion,
+                                             IDataReader<ElemType>* trainSetDataReader,
+                                             const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                             const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                             const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                             const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                             std::map<std::wstring, Matrix<ElemType>*>* inputMatrices,
+                                             const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                             std::list<Matrix<ElemType>>& smoothedGradients);
 
     void TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
                                          ComputationNetworkPtr refNet,
@@ -425,10 +605,17 @@ protected:
 
     void InitDistGradAgg(int numEvalNodes, int traceLevel);
 
+    // elastic training: the parameters and optimizer state at the start of the epoch, kept on their devices
+    void SnapshotEpochStart(const std::list<ComputationNodeBasePtr>& learnableNodes, const std::list<Matrix<ElemType>>& smoothedGradients);
+    void RecoverFromRankLoss(const MpiRankLoss& e, int epochNumber, const std::list<ComputationNodeBasePtr>& learnableNodes,
+                             std::list<Matrix<ElemType>>& smoothedGradients, int numEvalNodes);
+
     bool ModelAveragingProcessing(size_t nSamplesSinceLastSync, const std::list<ComputationNodeBasePtr>& learnableNodes, size_t& nProcessedFrames,
                                   float& SecondsSinceLastSyncFinished, float& SecondsSpentOnSync);
 
-    size_t ModelAveragingSync(int nSamplesSinceLastSync, const std::list<ComputationNodeBasePtr>& learnableNodes);
+    size_t ModelAveragingSync(int nSamplesSinceLastSync, const std::list<ComputationNodeBasePtr>& learnableNodes, bool overlap = false);
+
+    void BlockMomentumUpdate(const ComputationNodeBasePtr& node, Matrix<ElemType>& averagedModel);
 
 public:
     // UpdateWeightsS - static version of UpdateWeights()
@@ -453,9 +640,24 @@ protected:
                        const double L2RegWeight, const double L1RegWeight,
                        const bool needAveMultiplier,
                        const bool useNesterovMomentum) const;
+    // UpdateWeights() of a GPU parameter whose smoothed gradient is in host memory
+    void UpdateWeightsOnHost(const ComputationNodeBasePtr& node,
+                             Matrix<ElemType>& smoothedGradient,
+                             const double learnRatePerSample,
+                             const double momentumPerSample,
+                             const size_t actualMBSize,
+                             const double L2RegWeight, const double L1RegWeight,
+                             const bool needAveMultiplier) const;
+    // all parameters in one multi-tensor update, for plain momentum SGD; returns false if UpdateWeights() must be used instead
+    bool UpdateWeightsFused(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradients,
+                            const double learnRatePerSample, const double momentumPerSample, const size_t actualMBSize) const;
 
     void ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const;
 
+    bool UnscaleGradients(const std::list<ComputationNodeBasePtr>& learnableNodes);
+
+    void SaveEpochModel(ComputationNetworkPtr net, const std::list<ComputationNodeBasePtr>& learnableNodes, const int epoch, const wstring& fileName);
+
     void SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen,
                             const double learnRatePerSample,
                             const std::list<Matrix<ElemType>>& smoothedGradients,
@@ -469,9 +671,30 @@ protected:
                             /*out*/ double& prevCriterion,
                             /*out*/ size_t& minibatchSize);
 
+    void WaitForCheckpointWriter();
+    void PrintCrossValidationResult(int epoch, const vector<double>& vScore) const;
+
     wstring GetCheckPointFileNameForEpoch(const int epoch);
     wstring GetModelNameForEpoch(const int epoch, bool bLastModel = false);
 
+    // mid-epoch checkpoints (see m_numMBsToCheckpoint): a model and a checkpoint of the epoch in progress
+    struct MidEpochState
+    {
+        int epoch;
+        size_t numReaderMinibatches; // the cursor of the reader: minibatches read in the epoch; 0 if not resuming
+        size_t numMBsRun;
+        size_t epochSamples;
+        size_t totalSamplesSeen;
+        double learnRatePerSample;
+        size_t minibatchSize;
+        double criterion; // sums over the epoch so far, of all workers
+        std::vector<double> evalErrors;
+    };
+    wstring GetMidEpochModelFileName(const int epoch);
+    bool HasMidEpochCheckPoint(const int epoch);
+    void SaveMidEpochCheckPoint(ComputationNetworkPtr net, const MidEpochState& state, const std::list<Matrix<ElemType>>& smoothedGradients);
+    bool LoadMidEpochCheckPoint(const int epoch, std::list<Matrix<ElemType>>& smoothedGradients);
+
     // return -1 if nothing exists
     int DetermineStartEpoch(const bool makeMode);
 
@@ -495,16 +718,80 @@ public:
 protected:
     wstring m_modelPath;
     bool m_keepCheckPointFiles;
+    size_t m_numMBsToCheckpoint; // > 0: also checkpoint every this many minibatches, and resume within the epoch from there
+    MidEpochState m_midEpochResume;
+    // epoch models and checkpoints are saved into m_checkpointStagingDir and published in the background
+    bool m_asyncCheckpointing;
+    wstring m_checkpointStagingDir;
+    // > 0: a full epoch model only every this many epochs (and the last one); those in between store the differences
+    // of the parameters to the one before, in m_incrementalCheckpointPrecision (fp16, int8 or full)
+    size_t m_incrementalCheckpoints;
+    wstring m_incrementalCheckpointPrecision;
+    int m_checkpointBaseEpoch;                                 // of the last full epoch model, or -1
+    std::map<wstring, std::vector<ElemType>> m_checkpointBaseValues; // [nodeName] its parameter values
+    std::shared_ptr<AsyncCheckpointWriter> m_checkpointWriter; // on the main node only
+    std::shared_ptr<ReferenceOutputCache> m_referenceOutputCache;
+    bool m_trainOnThisRankOnly; // during a trial of the parallel learning-rate search: no aggregation, no distributed reading
+
+    // benchmark mode: the minibatches measured so far, over epochs if an epoch is shorter than the benchmark
+    struct BenchmarkState
+    {
+        size_t numMinibatches = 0; // run so far, warm-up included
+        size_t numSamples = 0;     // of the measured ones
+        double seconds = 0;
+        double readerSeconds = 0; // waiting for the reader during the measured ones
+    };
+    BenchmarkState m_benchmark;
+
+    // startup, timed from the construction of this object; reported once, at the first minibatch
+    struct StartupTimes
+    {
+        double networkSeconds = -1;        // the network is created or loaded
+        double readersSeconds = -1;        // the readers are created (TrainWithDeferredReaders() only)
+        double firstMinibatchSeconds = -1; // the first minibatch is done
+    };
+    StartupTimes m_startupTimes;
+    Timer m_startupTimer;
+    double SecondsSinceStartup()
+    {
+        m_startupTimer.Stop(); // (does not reset the start)
+        return m_startupTimer.ElapsedSeconds();
+    }
+    bool IsBenchmarkDone() const
+    {
+        return m_benchmarkMinibatches > 0 && m_benchmark.numMinibatches >= m_benchmarkWarmupMinibatches + m_benchmarkMinibatches;
+    }
+    void ReportBenchmark(DEVICEID_TYPE deviceId);
     // bool m_validateAfterModelReloading; // TODO: remove this. Why would one not validate a model?
 
     wstring m_trainCriterionNodeName;
     wstring m_evalCriterionNodeName;
+    wstring m_readerConfigKey;
 
     size_t m_prevChosenMinibatchSize;
     double m_lastFinishedEpochTrainLoss;
 
+    // current loss scale and number of minibatches since it last changed (dynamic loss scaling)
+    double m_currentLossScale;
+    size_t m_numMBsSinceLossScaleChange;
+
     IDistGradAggregator<ElemType>* m_distGradAgg;
     struct DistGradHeader* m_gradHeader;
+    std::list<Matrix<ElemType>> m_epochStartValues;          // elastic training: [learnable node] its value at the start of the epoch
+    std::list<Matrix<ElemType>> m_epochStartSmoothedGradients; // and its smoothed gradient
+    double m_epochStartLossScale;
+    AsyncParameterServer<ElemType>* m_parameterServer;
+    std::shared_ptr<DataParallelReplicas<ElemType>> m_dataParallelReplicas;
+    std::shared_ptr<FlatParameterBuffers<ElemType>> m_flatParameters;
+    std::shared_ptr<WorkerLoadBalancer> m_loadBalancer; // minibatch shares of the workers, see m_loadBalancingWindow
+    std::shared_ptr<ModelDeltaExchange<ElemType>> m_modelDeltaExchange; // see m_modelDeltaBits and m_overlapModelAveraging
+
+    // BMUF state per learnable parameter: the global model after the last sync, and the filtered model delta
+    std::map<std::wstring, std::shared_ptr<Matrix<ElemType>>> m_blockLevelModel;
+    std::map<std::wstring, std::shared_ptr<Matrix<ElemType>>> m_blockLevelDelta;
+
+    // [1 x 1] device scratch of ClipGradient(), so that clipping a dense gradient does not read its norm back
+    mutable std::shared_ptr<Matrix<ElemType>> m_gradientNorm;
 
 private:
     int SGDTrace(FILE* __restrict __stream, const char* __restrict __format, ...);
@@ -5,6 +5,8 @@
 #include <future>
 #include "GPUDataTransferer.h"
 #include "TimerUtility.h"
+#include <map>
+#include <set>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -14,9 +16,18 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(MPIWrapper* mpi, bool useAsyncAggregation, int syncStatsTrace)
-        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0)
+    // bucketSizeInBytes > 0 overlaps the exchange with backprop: final gradients are collected into buckets of about that size,
+    // and each bucket's all-reduce starts as soon as it is full (not with async aggregation, which already overlaps a whole minibatch)
+    // useGPUDirect passes GPU gradients to MPI in place instead of staging them in page-locked CPU buffers, if MPI is CUDA-aware.
+    SimpleDistGradAggregator(MPIWrapper* mpi, bool useAsyncAggregation, int syncStatsTrace, size_t bucketSizeInBytes = 0, bool useGPUDirect = false)
+        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0),
+          m_bucketSizeInBytes(useAsyncAggregation ? 0 : bucketSizeInBytes), m_currentBucketBytes(0), m_useGPUDirect(useGPUDirect)
     {
+        if (m_useGPUDirect && !mpi->IsCudaAware())
+        {
+            fprintf(stderr, "SimpleDistGradAggregator: MPI is not CUDA-aware; staging GPU gradients through CPU memory.\n");
+            m_useGPUDirect = false;
+        }
     }
 
     ~SimpleDistGradAggregator()
@@ -121,7 +132,94 @@ public:
         }
     }
 
+    void OnGradientFinal(Matrix<ElemType>* gradient) override
+    {
+        if (m_bucketSizeInBytes == 0)
+            return;
+        auto iter = m_gradientIndex.find(gradient); // (empty until the first AggregateGradients() call has set up the buffers)
+        if (iter == m_gradientIndex.end())
+            return;
+        m_currentBucket.push_back(iter->second);
+        m_currentBucketBytes += gradient->GetNumElements() * sizeof(ElemType);
+        if (m_currentBucketBytes >= m_bucketSizeInBytes)
+            StartBucketExchange();
+    }
+
 private:
+    // whether GPU gradients go through page-locked CPU buffers
+    bool UseStaging(int deviceId) const
+    {
+        return deviceId >= 0 && !m_useGPUDirect;
+    }
+
+    // start the all-reduce of one buffer
+    // With the ring or hierarchical algorithm, MPIWrapper reduces synchronously, and the request is left empty.
+    // Those add up chunks on the CPU, so device buffers always go to MPI_Iallreduce.
+    void StartAllReduce(ElemType* buffer, size_t numElements, bool isOnDevice, MPI_Request* request)
+    {
+        if (m_mpi->GetAllReduceAlgorithm() == AllReduceAlgorithm::MPI || isOnDevice)
+        {
+            // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
+            MPI_Iallreduce(MPI_IN_PLACE, buffer, numElements, MPIWrapper::GetDataType(buffer), MPI_SUM, m_mpi->Communicator(), request) || MpiFail("MPI_Iallreduce");
+        }
+        else
+        {
+            m_mpi->AllReduce(buffer, numElements);
+            *request = MPI_REQUEST_NULL;
+        }
+    }
+
+    // start the all-reduce of the current bucket: copy its gradients to the CPU on this thread, after making the fetch stream
+    // wait for the backprop kernels that computed them, then wait and reduce on a worker thread
+    // With GPU-direct, an event recorded here takes the place of the copies.
+    // Buckets are chained, so that only one thread at a time makes MPI calls (we run with MPI_THREAD_SERIALIZED).
+    void StartBucketExchange()
+    {
+        const std::vector<size_t> bucket = m_currentBucket;
+        m_currentBucket.clear();
+        m_currentBucketBytes = 0;
+        if (bucket.empty())
+            return;
+
+        const int deviceId = m_gradients[bucket.front()]->GetDeviceId();
+        const bool useStaging = UseStaging(deviceId);
+        if (useStaging)
+        {
+            // the fetch stream may be non-blocking: order the copies after the backprop kernels queued so far
+            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+            mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
+            for (size_t i : bucket)
+                m_gpuDataTransferers[i]->CopyGPUToCPUAsync(m_gradients[i]->BufferPointer(), m_gradients[i]->GetNumElements(), m_intermediateCPUBuffers[i].get());
+        }
+        std::shared_ptr<MatrixComputeStreamEvent> computedEvent;
+        if (deviceId >= 0 && !useStaging)
+            computedEvent.reset(MatrixComputeStreamEvent::Create(deviceId));
+        for (size_t i : bucket)
+            m_isExchanged[i] = true;
+
+        std::shared_future<void> previousBucket = m_lastBucketExchange;
+        m_lastBucketExchange = std::async(std::launch::async, [this, bucket, deviceId, useStaging, computedEvent, previousBucket]
+                                          {
+                                              if (previousBucket.valid())
+                                                  previousBucket.wait();
+                                              if (computedEvent)
+                                                  computedEvent->SynchronizeEvent();
+                                              std::vector<MPI_Request> allReduceRequests(bucket.size());
+                                              for (size_t k = 0; k < bucket.size(); k++)
+                                              {
+                                                  const size_t i = bucket[k];
+                                                  ElemType* reductionBuffer = m_gradients[i]->BufferPointer();
+                                                  if (useStaging)
+                                                  {
+                                                      m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
+                                                      reductionBuffer = m_intermediateCPUBuffers[i].get();
+                                                  }
+                                                  StartAllReduce(reductionBuffer, m_gradients[i]->GetNumElements(), deviceId >= 0 && !useStaging, &allReduceRequests[k]);
+                                              }
+                                              MPI_Waitall(allReduceRequests.size(), allReduceRequests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+                                          }).share();
+    }
+
     std::shared_ptr<ElemType> AllocateIntermediateBuffer(int deviceID, size_t numElements)
     {
         assert(deviceID >= 0);
@@ -142,26 +240,38 @@ private:
         if (m_currentEpochNumber == -1)
         {
             int deviceId = gradients[0]->GetDeviceId();
-            if (deviceId != CPUDEVICE)
+            if (UseStaging(deviceId))
             {
                 m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
             }
 
             for (size_t i = 0; i < gradients.size(); i++)
             {
-                // Make sure none of the gradient matrixes are sparse - we currently do not support aggregation of sparse gradient matrices
-                if (gradients[i]->GetMatrixType() != DENSE)
-                    RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
+                // sparse gradients are only supported in the block-column format that embeddings produce, see ExchangeSparseBlockColGradient()
+                const bool isSparse = IsSparse(gradients[i]);
+                if (gradients[i]->GetMatrixType() != DENSE && !isSparse)
+                    RuntimeError("Gradient aggregation for sparse gradient matrices is only supported in SparseBlockCol format!");
+                if (isSparse && m_useAsyncAggregation)
+                    RuntimeError("Buffered async gradient aggregation is unsupported for sparse gradient matrices!");
 
-                if (deviceId != CPUDEVICE)
+                if (m_bucketSizeInBytes > 0 && !isSparse)
+                    m_gradientIndex[gradients[i]] = i;
+
+                if (UseStaging(deviceId) && isSparse) // (placeholders, to keep the indices aligned with the gradients)
+                {
+                    m_gpuDataTransferers.push_back(nullptr);
+                    m_intermediateCPUBuffers.push_back(nullptr);
+                }
+                else if (UseStaging(deviceId))
                 {
-                    m_gpuDataTransferers.push_back(std::unique_ptr<GPUDataTransferer<ElemType>>(new GPUDataTransferer<ElemType>(deviceId, m_useAsyncAggregation)));
-                    m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(deviceId, gradients[i]->GetNumElements()));
+                    // (with model parallelism, the gradients may be spread over several GPUs)
+                    m_gpuDataTransferers.push_back(std::unique_ptr<GPUDataTransferer<ElemType>>(new GPUDataTransferer<ElemType>(gradients[i]->GetDeviceId(), m_useAsyncAggregation)));
+                    m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(gradients[i]->GetDeviceId(), gradients[i]->GetNumElements()));
                 }
 
                 if (m_useAsyncAggregation)
                 {
-                    m_bufferedGradients[gradients[i]].reset(new Matrix<ElemType>(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), deviceId));
+                    m_bufferedGradients[gradients[i]].reset(new Matrix<ElemType>(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), gradients[i]->GetDeviceId()));
                 }
             }
 
@@ -171,6 +281,12 @@ private:
                 m_bufferedGradHeader->Clear();
             }
 
+            if (m_bucketSizeInBytes > 0)
+            {
+                m_gradients = gradients;
+                m_isExchanged.assign(gradients.size(), false);
+            }
+
             if (m_mpi->IsMainNode())
             {
                 for (size_t i = 0; i < NumProc() - 1; ++i)
@@ -218,6 +334,19 @@ private:
 
         size_t numGradMatrices = gradients.size();
 
+        // gradients whose exchange was started during backprop: finish their buckets before we make any MPI calls here
+        if (m_bucketSizeInBytes > 0)
+        {
+            StartBucketExchange();
+            if (m_lastBucketExchange.valid())
+                m_lastBucketExchange.get();
+            m_lastBucketExchange = std::shared_future<void>();
+        }
+        std::vector<bool> isExchanged(numGradMatrices, false);
+        if (m_isExchanged.size() == numGradMatrices)
+            isExchanged.swap(m_isExchanged);
+        m_isExchanged.assign(isExchanged.size(), false);
+
         if (headerCPU->numSamples == 0)
         {
             assert(headerCPU->criterion == 0);
@@ -229,25 +358,19 @@ private:
             // If the current node did not process any samples, the gradients should be zero'd
             for (size_t i = 0; i < numGradMatrices; ++i)
             {
-                gradients[i]->SetValue(0);
+                if (IsSparse(gradients[i]))
+                    gradients[i]->Reset();
+                else
+                    gradients[i]->SetValue(0);
             }
 
-            if (m_useAsyncAggregation)
+            if (m_useAsyncAggregation && UseStaging(deviceId))
             {
                 std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
                 mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
             }
         }
 
-        // Initiate transfer of the gradient matrices to the CPU if needed
-        if (deviceId >= 0)
-        {
-            for (size_t i = 0; i < numGradMatrices; ++i)
-            {
-                m_gpuDataTransferers[i]->CopyGPUToCPUAsync(gradients[i]->BufferPointer(), gradients[i]->GetNumElements(), m_intermediateCPUBuffers[i].get());
-            }
-        }
-
         // Initiate receive of the header on the main node
         std::vector<MPI_Request> recvHeaderRequests(NumProc() - 1);
         if (m_mpi->IsMainNode())
@@ -267,20 +390,7 @@ private:
             MPI_Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), numGradMatrices, m_mpi->Communicator(), &sendHeaderRequest) || MpiFail("MPI_Isend");
         }
 
-        // Perform MPI async allreduce on the gradient data
-        std::vector<MPI_Request> allReduceRequests(numGradMatrices);
-        for (size_t i = 0; i < numGradMatrices; ++i)
-        {
-            ElemType* reductionBuffer = gradients[i]->BufferPointer();
-            if (deviceId >= 0)
-            {
-                m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
-                reductionBuffer = m_intermediateCPUBuffers[i].get();
-            }
-
-            // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
-            MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, gradients[i]->GetNumElements(), MPIWrapper::GetDataType(reductionBuffer), MPI_SUM, m_mpi->Communicator(), &allReduceRequests[i]) || MpiFail("MPI_Iallreduce");
-        }
+        StartGradientExchange(gradients, isExchanged);
 
         // On the main node wait for the headers to arrive and aggregate
         if (m_mpi->IsMainNode())
@@ -322,15 +432,7 @@ private:
             }
         }
 
-        // Wait for the allreduce operations to finish and initiate transfer back to the GPU if needed
-        for (size_t i = 0; i < numGradMatrices; ++i)
-        {
-            MPI_Wait(&allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
-            if (deviceId >= 0)
-            {
-                m_gpuDataTransferers[i]->CopyCPUToGPUAsync(m_intermediateCPUBuffers[i].get(), gradients[i]->GetNumElements(), gradients[i]->BufferPointer());
-            }
-        }
+        FinishGradientExchange(gradients);
 
         // Wait to receive aggregate header
         if (!m_mpi->IsMainNode())
@@ -338,15 +440,6 @@ private:
             MPI_Wait(&recvAggHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
         }
 
-        // Wait for all the transfers to finish
-        if (deviceId >= 0)
-        {
-            for (size_t i = 0; i < numGradMatrices; ++i)
-            {
-                m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
-            }
-        }
-
         // Wait for completion of the async send requests
         if (!m_mpi->IsMainNode())
         {
@@ -365,7 +458,143 @@ private:
         }
     }
 
+protected:
+    // exchange of the gradient data, overlapped with the exchange of the header in AggregateGradientsImpl()
+    // Gradients with isExchanged[i] were already reduced during backprop. Derived classes may exchange them differently.
+    virtual void StartGradientExchange(const std::vector<Matrix<ElemType>*>& gradients, const std::vector<bool>& isExchanged)
+    {
+        size_t numGradMatrices = gradients.size();
+        int deviceId = gradients[0]->GetDeviceId();
+
+        // MPI reads device memory outside of our streams, so the gradients must be complete before we hand them over
+        const bool useStaging = UseStaging(deviceId);
+        if (deviceId >= 0 && !useStaging)
+        {
+            std::set<int> devices;
+            for (const auto& gradient : gradients)
+                devices.insert(gradient->GetDeviceId());
+            for (int device : devices)
+            {
+                std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(device));
+                mainStreamSyncEvent->SynchronizeEvent();
+            }
+        }
+
+        // Initiate transfer of the gradient matrices to the CPU if needed
+        if (useStaging)
+        {
+            for (size_t i = 0; i < numGradMatrices; ++i)
+            {
+                if (!isExchanged[i] && !IsSparse(gradients[i]))
+                    m_gpuDataTransferers[i]->CopyGPUToCPUAsync(gradients[i]->BufferPointer(), gradients[i]->GetNumElements(), m_intermediateCPUBuffers[i].get());
+            }
+        }
+
+        // Perform MPI async allreduce on the gradient data
+        m_allReduceRequests.assign(numGradMatrices, MPI_REQUEST_NULL);
+        for (size_t i = 0; i < numGradMatrices; ++i)
+        {
+            if (isExchanged[i] || IsSparse(gradients[i]))
+                continue;
+            ElemType* reductionBuffer = gradients[i]->BufferPointer();
+            if (useStaging)
+            {
+                m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
+                reductionBuffer = m_intermediateCPUBuffers[i].get();
+            }
+
+            StartAllReduce(reductionBuffer, gradients[i]->GetNumElements(), deviceId >= 0 && !useStaging, &m_allReduceRequests[i]);
+        }
+
+        // (while the dense ones are in flight)
+        for (size_t i = 0; i < numGradMatrices; ++i)
+        {
+            if (IsSparse(gradients[i]))
+                ExchangeSparseBlockColGradient(*gradients[i]);
+        }
+    }
+
+    virtual void FinishGradientExchange(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        size_t numGradMatrices = gradients.size();
+        const bool useStaging = UseStaging(gradients[0]->GetDeviceId());
+
+        // Wait for the allreduce operations to finish and initiate transfer back to the GPU if needed
+        for (size_t i = 0; i < numGradMatrices; ++i)
+        {
+            MPI_Wait(&m_allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+            if (useStaging && !IsSparse(gradients[i]))
+            {
+                m_gpuDataTransferers[i]->CopyCPUToGPUAsync(m_intermediateCPUBuffers[i].get(), gradients[i]->GetNumElements(), gradients[i]->BufferPointer());
+            }
+        }
+
+        // Wait for all the transfers to finish
+        if (useStaging)
+        {
+            for (size_t i = 0; i < numGradMatrices; ++i)
+            {
+                if (!IsSparse(gradients[i]))
+                    m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
+            }
+        }
+    }
+
+    static bool IsSparse(const Matrix<ElemType>* gradient)
+    {
+        return gradient->GetMatrixType() == SPARSE && gradient->GetFormat() == matrixFormatSparseBlockCol;
+    }
+
+    // sum a sparse block-column gradient (e.g. of an embedding, with one block per word seen in the minibatch) over all ranks
+    // Only the blocks are sent; the result has one block per word seen by any rank.
+    void ExchangeSparseBlockColGradient(Matrix<ElemType>& gradient)
+    {
+        const size_t numRows = gradient.GetNumRows();
+        gradient.GetSparseBlockColData(m_sparseColumnIds, m_sparseValues);
+
+        std::vector<int> numBlocks(NumProc());
+        int myNumBlocks = (int) m_sparseColumnIds.size();
+        MPI_Allgather(&myNumBlocks, 1, MPI_INT, numBlocks.data(), 1, MPI_INT, m_mpi->Communicator()) || MpiFail("MPI_Allgather");
+        std::vector<int> blockOffsets(NumProc()), valueCounts(NumProc()), valueOffsets(NumProc());
+        int totalBlocks = 0;
+        for (size_t r = 0; r < NumProc(); r++)
+        {
+            blockOffsets[r] = totalBlocks;
+            valueCounts[r] = numBlocks[r] * (int) numRows;
+            valueOffsets[r] = totalBlocks * (int) numRows;
+            totalBlocks += numBlocks[r];
+        }
+
+        std::vector<size_t> allColumnIds(totalBlocks);
+        std::vector<ElemType> allValues(totalBlocks * numRows);
+        MPI_Allgatherv(m_sparseColumnIds.data(), myNumBlocks, MPIWrapper::GetDataType(m_sparseColumnIds.data()),
+                       allColumnIds.data(), numBlocks.data(), blockOffsets.data(), MPIWrapper::GetDataType(allColumnIds.data()), m_mpi->Communicator()) || MpiFail("MPI_Allgatherv");
+        MPI_Allgatherv(m_sparseValues.data(), myNumBlocks * (int) numRows, MPIWrapper::GetDataType(m_sparseValues.data()),
+                       allValues.data(), valueCounts.data(), valueOffsets.data(), MPIWrapper::GetDataType(allValues.data()), m_mpi->Communicator()) || MpiFail("MPI_Allgatherv");
+
+        // merge blocks of the same column, in column order so that all ranks end up with the same layout
+        std::map<size_t, size_t> blockOfColumn;
+        for (size_t columnId : allColumnIds)
+            blockOfColumn.insert(std::make_pair(columnId, 0));
+        m_sparseColumnIds.clear();
+        for (auto& entry : blockOfColumn)
+        {
+            entry.second = m_sparseColumnIds.size();
+            m_sparseColumnIds.push_back(entry.first);
+        }
+        m_sparseValues.assign(m_sparseColumnIds.size() * numRows, 0);
+        for (size_t j = 0; j < allColumnIds.size(); j++)
+        {
+            ElemType* block = m_sparseValues.data() + blockOfColumn[allColumnIds[j]] * numRows;
+            for (size_t k = 0; k < numRows; k++)
+                block[k] += allValues[j * numRows + k];
+        }
+        gradient.SetSparseBlockColData(numRows, gradient.GetNumCols(), m_sparseColumnIds, m_sparseValues);
+    }
+
 private:
+    std::vector<MPI_Request> m_allReduceRequests; // [i] pending all-reduce of gradient i, see StartGradientExchange()
+
     std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
     std::vector<std::shared_ptr<ElemType>> m_intermediateCPUBuffers;
 
@@ -389,5 +618,21 @@ private:
     size_t m_iterationCount;
 
     int m_currentEpochNumber;
+
+    // overlapping the exchange with backprop (see OnGradientFinal())
+    size_t m_bucketSizeInBytes;                                    // 0 if off
+    std::vector<Matrix<ElemType>*> m_gradients;                    // the gradients as passed to the first AggregateGradients() call
+    std::unordered_map<Matrix<ElemType>*, size_t> m_gradientIndex; // [gradient] -> index into m_gradients
+    std::vector<size_t> m_currentBucket;                           // final gradients not yet being exchanged
+    size_t m_currentBucketBytes;
+    std::vector<bool> m_isExchanged;                               // [i] exchange of m_gradients[i] was started during this minibatch's backprop
+    std::shared_future<void> m_lastBucketExchange;                 // completes when all started buckets are reduced
+
+    // GPU gradients are passed to CUDA-aware MPI directly
+    bool m_useGPUDirect;
+
+    // scratch buffers for ExchangeSparseBlockColGradient()
+    std::vector<size_t> m_sparseColumnIds;
+    std::vector<ElemType> m_sparseValues;
 };
 } } }
@@ -24,8 +24,10 @@ template <class ElemType>
 class SimpleEvaluator
 {
 public:
-    SimpleEvaluator(ComputationNetworkPtr net, const size_t numMBsToShowResult = 100, const int traceLevel = 0)
-        : m_net(net), m_numMBsToShowResult(numMBsToShowResult), m_traceLevel(traceLevel)
+    // With enableDistributedMBReading, and if the reader supports it, every MPI worker evaluates its own share of the data,
+    // and the results are combined at the end; Evaluate() must then be called by all workers.
+    SimpleEvaluator(ComputationNetworkPtr net, const size_t numMBsToShowResult = 100, const int traceLevel = 0, const bool enableDistributedMBReading = false)
+        : m_net(net), m_numMBsToShowResult(numMBsToShowResult), m_traceLevel(traceLevel), m_enableDistributedMBReading(enableDistributedMBReading)
     {
     }
 
@@ -92,11 +94,18 @@ public:
         for (int i = 0; i < evalResults.size(); i++)
             evalResultsLastMBs.push_back((ElemType) 0);
 
-        dataReader->StartMinibatchLoop(mbSize, 0, testSize);
+        const bool useDistributedMBReading = m_enableDistributedMBReading && g_mpi != nullptr && g_mpi->NumNodesInUse() > 1 && dataReader->SupportsDistributedMBRead();
+        if (useDistributedMBReading)
+            dataReader->StartDistributedMinibatchLoop(mbSize, 0, g_mpi->CurrentNodeRank(), g_mpi->NumNodesInUse(), testSize);
+        else
+            dataReader->StartMinibatchLoop(mbSize, 0, testSize);
         m_net->StartEvaluateMinibatchLoop(evalNodes);
 
-        while (DataReaderHelpers::GetMinibatchIntoNetwork(*dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize))
+        while (DataReaderHelpers::GetMinibatchIntoNetwork(*dataReader, m_net, nullptr, useDistributedMBReading, false, inputMatrices, actualMBSize))
         {
+            if (actualMBSize == 0) // (a distributed reader may return empty minibatches to some workers)
+                continue;
+
             ComputationNetwork::BumpEvalTimeStamp(featureNodes);
             ComputationNetwork::BumpEvalTimeStamp(labelNodes);
 
@@ -141,6 +150,18 @@ public:
             DisplayEvalStatistics(lastMBsRun + 1, numMBsRun, numSamplesLastMBs, evalNodes, evalResults, evalResultsLastMBs);
         }
 
+        // combine the workers' sums and sample counts
+        if (useDistributedMBReading)
+        {
+            vector<double> sums(evalResults);
+            sums.push_back((double) totalEpochSamples);
+            sums.push_back((double) numMBsRun);
+            g_mpi->AllReduce(sums);
+            copy(sums.begin(), sums.begin() + evalResults.size(), evalResults.begin());
+            totalEpochSamples = (size_t) sums[evalResults.size()];
+            numMBsRun = (size_t) sums[evalResults.size() + 1];
+        }
+
         // final statistics
         for (int i = 0; i < evalResultsLastMBs.size(); i++)
         {
@@ -187,6 +208,7 @@ protected:
                 if (evalNodes[i]->OperationName() == OperationNameOf(CrossEntropyWithSoftmaxNode) ||
                     evalNodes[i]->OperationName() == OperationNameOf(CrossEntropyNode) ||
                     evalNodes[i]->OperationName() == OperationNameOf(ClassBasedCrossEntropyWithSoftmaxNode) ||
+                    evalNodes[i]->OperationName() == OperationNameOf(HierarchicalSoftmaxNode) ||
                     evalNodes[i]->OperationName() == OperationNameOf(NoiseContrastiveEstimationNode))
                     fprintf(stderr, "Perplexity = %.8g    ", std::exp(eresult));
             }
@@ -199,6 +221,7 @@ protected:
     ComputationNetworkPtr m_net;
     size_t m_numMBsToShowResult;
     int m_traceLevel;
+    bool m_enableDistributedMBReading;
     void operator=(const SimpleEvaluator&); // (not assignable)
 };
 } } }
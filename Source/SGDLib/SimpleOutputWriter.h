@@ -14,20 +14,70 @@
 #include <string>
 #include <stdexcept>
 #include <fstream>
+#include <functional>
+#include <future>
 
 using namespace std;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// -----------------------------------------------------------------------
+// BackgroundWrites -- writes the output of one minibatch on a thread of its own while the next one is evaluated
+// Only one write is in flight at a time, so two sets of output buffers suffice. Wait() rethrows what the write threw.
+// -----------------------------------------------------------------------
+
+class BackgroundWrites
+{
+public:
+    BackgroundWrites(bool async)
+        : m_async(async)
+    {
+    }
+
+    ~BackgroundWrites()
+    {
+        if (m_pending.valid()) // (only on the error path, when nobody is interested in the result anymore)
+            m_pending.wait();
+    }
+
+    void Submit(std::function<void()>&& write)
+    {
+        Wait();
+        if (m_async)
+            m_pending = std::async(std::launch::async, std::move(write));
+        else
+            write();
+    }
+
+    void Wait()
+    {
+        if (m_pending.valid())
+            m_pending.get();
+    }
+
+private:
+    bool m_async;
+    std::future<void> m_pending;
+};
+
 template <class ElemType>
 class SimpleOutputWriter
 {
     typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
 
 public:
-    SimpleOutputWriter(ComputationNetworkPtr net, int verbosity = 0)
-        : m_net(net), m_verbosity(verbosity)
+    // with 'asyncWrite', formatting and writing the output overlaps with the evaluation of the next minibatch
+    SimpleOutputWriter(ComputationNetworkPtr net, int verbosity = 0, bool asyncWrite = false)
+        : m_net(net), m_verbosity(verbosity), m_asyncWrite(asyncWrite)
+    {
+    }
+
+    // keep the node values of the previous WriteOutput() where they are still valid: the inputs for which this returns
+    // true keep their evaluation time stamp, so that the nodes that only depend on such inputs and on parameters are not
+    // computed again. The node values must persist between minibatches, i.e. not be shared (shareNodeValueMatrices).
+    void SetUnchangedInputTest(const std::function<bool(const ComputationNodeBasePtr&)>& isInputUnchanged)
     {
+        m_isInputUnchanged = isInputUnchanged;
     }
 
     void WriteOutput(IDataReader<ElemType>& dataReader, size_t mbSize, IDataWriter<ElemType>& dataWriter, const std::vector<std::wstring>& outputNodeNames, size_t numOutputSamples = requestDataSize, bool doUnitTest = false)
@@ -68,39 +118,59 @@ public:
         dataReader.StartMinibatchLoop(mbSize, 0, numOutputSamples);
         dataReader.SetNumParallelSequences(1);
 
-        m_net->StartEvaluateMinibatchLoop(outputNodes);
+        if (!m_isInputUnchanged) // (resets all time stamps, which invalidates all node values)
+            m_net->StartEvaluateMinibatchLoop(outputNodes);
 
         size_t totalEpochSamples = 0;
+        size_t numMBsRun = 0;
         std::map<std::wstring, void*, nocase_compare> outputMatrices;
 
+        // while one set of CPU copies is being written, the next minibatch's output goes into the other
+        BackgroundWrites writes(m_asyncWrite);
+        std::map<std::wstring, shared_ptr<Matrix<ElemType>>> outputBuffers[2];
+
         size_t actualMBSize;
         while (DataReaderHelpers::GetMinibatchIntoNetwork(dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize))
         {
-            ComputationNetwork::BumpEvalTimeStamp(featureNodes);
-            ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+            BumpChangedInputs(featureNodes);
+            BumpChangedInputs(labelNodes);
 
+            // (the nodes that several outputs share are computed for the first one only, as they are up to date from then on)
             for (int i = 0; i < outputNodes.size(); i++)
             {
                 m_net->ForwardProp(outputNodes[i]);
                 outputMatrices[outputNodes[i]->NodeName()] = (void*) (&dynamic_pointer_cast<ComputationNode<ElemType>>(outputNodes[i])->Value());
             }
 
+            std::map<std::wstring, void*, nocase_compare> matricesToSave = outputMatrices;
             if (doUnitTest)
             {
-                std::map<std::wstring, void*, nocase_compare> inputMatricesUnitTest;
+                matricesToSave.clear();
                 for (auto iter = inputMatrices.begin(); iter != inputMatrices.end(); iter++)
-                    inputMatricesUnitTest[iter->first] = (void*) (iter->second);
-                dataWriter.SaveData(0, inputMatricesUnitTest, actualMBSize, actualMBSize, 0);
+                    matricesToSave[iter->first] = (void*) (iter->second);
+            }
+
+            if (m_asyncWrite && CopyToBuffers(matricesToSave, outputBuffers[numMBsRun % 2]))
+            {
+                writes.Submit([&dataWriter, matricesToSave, actualMBSize]
+                              {
+                                  dataWriter.SaveData(0, matricesToSave, actualMBSize, actualMBSize, 0);
+                              });
+            }
+            else // (sparse matrices are written in place)
+            {
+                writes.Wait();
+                dataWriter.SaveData(0, matricesToSave, actualMBSize, actualMBSize, 0);
             }
-            else
-                dataWriter.SaveData(0, outputMatrices, actualMBSize, actualMBSize, 0);
 
             totalEpochSamples += actualMBSize;
+            numMBsRun++;
 
             // call DataEnd function in dataReader to do
             // reader specific process if sentence ending is reached
             dataReader.DataEnd(endDataSentence);
         }
+        writes.Wait();
 
         if (m_verbosity > 0)
             fprintf(stderr, "Total Samples Evaluated = %lu\n", totalEpochSamples);
@@ -108,7 +178,11 @@ public:
         // clean up
     }
 
-    void WriteOutput(IDataReader<ElemType>& dataReader, size_t mbSize, std::wstring outputPath, const std::vector<std::wstring>& outputNodeNames, size_t numOutputSamples = requestDataSize)
+    // write the outputs to one file per node, 'outputPath.nodeName'
+    // As text, each sample is a line of values. The binary format is a header of two int32 values, the size of an element
+    // in bytes and the number of rows, followed by the samples' values as they are in memory, without any separators.
+    void WriteOutput(IDataReader<ElemType>& dataReader, size_t mbSize, std::wstring outputPath, const std::vector<std::wstring>& outputNodeNames, size_t numOutputSamples = requestDataSize,
+                     bool binaryOutput = false)
     {
         msra::files::make_intermediate_dirs(outputPath);
 
@@ -128,12 +202,13 @@ public:
                 outputNodes.push_back(m_net->GetNodeFromName(outputNodeNames[i]));
         }
 
+        const auto mode = binaryOutput ? ios::out | ios::binary : ios::out;
         std::vector<ofstream*> outputStreams;
         for (int i = 0; i < outputNodes.size(); i++)
 #ifdef _MSC_VER
-            outputStreams.push_back(new ofstream((outputPath + L"." + outputNodes[i]->NodeName()).c_str()));
+            outputStreams.push_back(new ofstream((outputPath + L"." + outputNodes[i]->NodeName()).c_str(), mode));
 #else
-            outputStreams.push_back(new ofstream(wtocharpath(outputPath + L"." + outputNodes[i]->NodeName()).c_str()));
+            outputStreams.push_back(new ofstream(wtocharpath(outputPath + L"." + outputNodes[i]->NodeName()).c_str(), mode));
 #endif
 
         // allocate memory for forward computation
@@ -152,36 +227,39 @@ public:
 
         size_t totalEpochSamples = 0;
         size_t numMBsRun = 0;
-        size_t tempArraySize = 0;
-        ElemType* tempArray = nullptr;
+        // one set of CPU copies per buffer, [buffer][node]
+        std::vector<size_t> tempArraySizes[2] = {std::vector<size_t>(outputNodes.size(), 0), std::vector<size_t>(outputNodes.size(), 0)};
+        std::vector<ElemType*> tempArrays[2] = {std::vector<ElemType*>(outputNodes.size(), nullptr), std::vector<ElemType*>(outputNodes.size(), nullptr)};
+        BackgroundWrites writes(m_asyncWrite); // (declared last, so that on errors it waits before the buffers go away)
 
         size_t actualMBSize;
         while (DataReaderHelpers::GetMinibatchIntoNetwork(dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize))
         {
             ComputationNetwork::BumpEvalTimeStamp(featureNodes);
 
+            const size_t buffer = numMBsRun % 2;
+            std::vector<pair<size_t, size_t>> dims;
             for (int i = 0; i < outputNodes.size(); i++)
             {
                 m_net->ForwardProp(outputNodes[i]);
 
                 Matrix<ElemType>& outputValues = dynamic_pointer_cast<ComputationNode<ElemType>>(outputNodes[i])->Value();
-                ofstream& outputStream = *outputStreams[i];
-                outputValues.CopyToArray(tempArray, tempArraySize);
-                ElemType* pCurValue = tempArray;
-                foreach_column (j, outputValues)
-                {
-                    foreach_row (k, outputValues)
-                    {
-                        outputStream << *pCurValue++ << " ";
-                    }
-                    outputStream << endl;
-                }
+                outputValues.CopyToArray(tempArrays[buffer][i], tempArraySizes[buffer][i]);
+                dims.push_back(make_pair(outputValues.GetNumRows(), outputValues.GetNumCols()));
             }
 
+            const std::vector<ElemType*> values = tempArrays[buffer];
+            writes.Submit([&outputStreams, values, dims, binaryOutput]
+                          {
+                              for (size_t i = 0; i < values.size(); i++)
+                                  WriteValues(*outputStreams[i], values[i], dims[i].first, dims[i].second, binaryOutput);
+                          });
+
             totalEpochSamples += actualMBSize;
 
             fprintf(stderr, "Minibatch[%lu]: ActualMBSize = %lu\n", ++numMBsRun, actualMBSize);
         }
+        writes.Wait();
 
         fprintf(stderr, "Total Samples Evaluated = %lu\n", totalEpochSamples);
 
@@ -192,12 +270,70 @@ public:
             delete outputStreams[i];
         }
 
-        delete[] tempArray;
+        for (const auto& arrays : tempArrays)
+            for (auto* tempArray : arrays)
+                delete[] tempArray;
     }
 
 private:
+    // point 'matrices' to CPU copies in 'buffers' instead; false if some are sparse, which then stay as they are
+    static bool CopyToBuffers(std::map<std::wstring, void*, nocase_compare>& matrices, std::map<std::wstring, shared_ptr<Matrix<ElemType>>>& buffers)
+    {
+        for (const auto& entry : matrices)
+        {
+            if (((Matrix<ElemType>*) entry.second)->GetMatrixType() != DENSE)
+                return false;
+        }
+        for (auto& entry : matrices)
+        {
+            const auto& from = *(Matrix<ElemType>*) entry.second;
+            auto& to = buffers[entry.first];
+            if (!to)
+                to = make_shared<Matrix<ElemType>>(CPUDEVICE);
+            to->Resize(from.GetNumRows(), from.GetNumCols());
+            from.CopySection(from.GetNumRows(), from.GetNumCols(), to->BufferPointer(), from.GetNumRows());
+            entry.second = (void*) to.get();
+        }
+        return true;
+    }
+
+    static void WriteValues(ofstream& outputStream, const ElemType* values, size_t rows, size_t cols, bool binaryOutput)
+    {
+        if (binaryOutput)
+        {
+            if (outputStream.tellp() == 0)
+            {
+                const int header[2] = {(int) sizeof(ElemType), (int) rows};
+                outputStream.write((const char*) header, sizeof(header));
+            }
+            outputStream.write((const char*) values, rows * cols * sizeof(ElemType));
+        }
+        else
+        {
+            for (size_t j = 0; j < cols; j++)
+            {
+                for (size_t k = 0; k < rows; k++)
+                    outputStream << *values++ << " ";
+                outputStream << "\n";
+            }
+        }
+        if (!outputStream)
+            RuntimeError("WriteOutput: Failed to write the output.");
+    }
+
+    void BumpChangedInputs(const std::vector<ComputationNodeBasePtr>& inputNodes)
+    {
+        for (const auto& node : inputNodes)
+        {
+            if (!m_isInputUnchanged || !m_isInputUnchanged(node))
+                node->BumpEvalTimeStamp();
+        }
+    }
+
     ComputationNetworkPtr m_net;
     int m_verbosity;
+    bool m_asyncWrite;
+    std::function<bool(const ComputationNodeBasePtr&)> m_isInputUnchanged; // see SetUnchangedInputTest()
     void operator=(const SimpleOutputWriter&); // (not assignable)
 };
 } } }
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "SimpleDistGradAggregator.h"
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// SparseGradientAggregator -- top-k sparsified gradient aggregation with error feedback
+//
+// Each rank sends only the 'density' fraction of largest-magnitude entries of every gradient, as (index, value) pairs.
+// What is not sent is kept in a per-gradient residual and added to the next minibatch's gradient, the same way
+// the 1-bit path carries its quantization error forward, so no gradient mass is lost, only delayed.
+// Header exchange and buffered async aggregation are those of SimpleDistGradAggregator.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class SparseGradientAggregator : public SimpleDistGradAggregator<ElemType>
+{
+    typedef SimpleDistGradAggregator<ElemType> Base;
+    UsingIDistGradAggregatorMembers;
+
+public:
+    SparseGradientAggregator(MPIWrapper* mpi, double density, bool useAsyncAggregation, int syncStatsTrace)
+        : Base(mpi, useAsyncAggregation, syncStatsTrace), m_density(density)
+    {
+        if (density <= 0 || density > 1)
+            InvalidArgument("SparseGradientAggregator: density must be in (0, 1].");
+    }
+
+protected:
+    void StartGradientExchange(const std::vector<Matrix<ElemType>*>& gradients, const std::vector<bool>& /*isExchanged: no exchange during backprop*/) override
+    {
+        m_residuals.resize(gradients.size());
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            Matrix<ElemType>& gradient = *gradients[i];
+            // (already row-sparse; only its blocks are sent)
+            if (Base::IsSparse(&gradient))
+            {
+                Base::ExchangeSparseBlockColGradient(gradient);
+                continue;
+            }
+            const size_t n = gradient.GetNumElements();
+            if (n == 0)
+                continue;
+
+            // add what we did not send before
+            std::vector<ElemType>& residual = m_residuals[i];
+            if (residual.size() != n)
+                residual.assign(n, 0);
+            m_values.resize(n);
+            gradient.CopySection(gradient.GetNumRows(), gradient.GetNumCols(), m_values.data(), gradient.GetNumRows());
+            for (size_t j = 0; j < n; j++)
+                residual[j] += m_values[j];
+
+            // select the k largest magnitudes; they are sent, the rest stays in the residual
+            const size_t k = std::min(n, std::max((size_t) 1, (size_t) std::ceil(m_density * n)));
+            m_order.resize(n);
+            std::iota(m_order.begin(), m_order.end(), 0);
+            std::nth_element(m_order.begin(), m_order.begin() + (k - 1), m_order.end(), [&residual](int a, int b)
+                             {
+                                 return std::abs(residual[a]) > std::abs(residual[b]);
+                             });
+            m_sendIndices.assign(m_order.begin(), m_order.begin() + k);
+            m_sendValues.resize(k);
+            for (size_t j = 0; j < k; j++)
+            {
+                m_sendValues[j] = residual[m_sendIndices[j]];
+                residual[m_sendIndices[j]] = 0;
+            }
+
+            // every rank sends the same number of entries
+            m_recvIndices.resize(k * NumProc());
+            m_recvValues.resize(k * NumProc());
+            MPI_Allgather(m_sendIndices.data(), (int) k, MPI_INT, m_recvIndices.data(), (int) k, MPI_INT, m_mpi->Communicator()) || MpiFail("MPI_Allgather");
+            MPI_Allgather(m_sendValues.data(), (int) k, MPIWrapper::GetDataType(m_sendValues.data()), m_recvValues.data(), (int) k, MPIWrapper::GetDataType(m_recvValues.data()), m_mpi->Communicator()) || MpiFail("MPI_Allgather");
+
+            std::fill(m_values.begin(), m_values.end(), (ElemType) 0);
+            for (size_t j = 0; j < m_recvIndices.size(); j++)
+                m_values[m_recvIndices[j]] += m_recvValues[j];
+            gradient.SetValue(gradient.GetNumRows(), gradient.GetNumCols(), gradient.GetDeviceId(), m_values.data());
+        }
+    }
+
+    void FinishGradientExchange(const std::vector<Matrix<ElemType>*>& /*gradients*/) override
+    {
+    }
+
+private:
+    double m_density; // fraction of entries sent per gradient
+
+    std::vector<std::vector<ElemType>> m_residuals; // [i] error feedback for gradient i, kept on the CPU where entries are selected
+
+    // scratch buffers
+    std::vector<ElemType> m_values;
+    std::vector<int> m_order;
+    std::vector<int> m_sendIndices;
+    std::vector<ElemType> m_sendValues;
+    std::vector<int> m_recvIndices;
+    std::vector<ElemType> m_recvValues;
+};
+} } }
@@ -0,0 +1,216 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TrainingTelemetry.h -- per-interval device and timing statistics of a training worker, for the log and for scraping
+//
+#pragma once
+
+#include "Basics.h"
+#include "fileutil.h"
+#include "GPUWatcher.h"
+#include "MPIWrapper.h"
+#include "TimerUtility.h"
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// the parts of a training step that TrainingTelemetry times
+enum class TrainingSection : size_t
+{
+    read,        // waiting for the reader (without a prefetcher, this includes the upload of the inputs)
+    upload,      // waiting for the prefetcher's asynchronous host-to-device copy
+    forward,
+    backward,
+    aggregation, // gradient aggregation or model averaging, including the wait for the other workers (and for the GPU to finish backprop)
+    update,
+};
+static const size_t numTrainingSections = 6;
+
+// -----------------------------------------------------------------------
+// TrainingTelemetry -- where the time of the minibatches of one progress interval went, and what the GPU was doing
+//
+// Waits are timed on the host by SGD (AddHostTime()). Computation is timed between BeginDeviceSection() and
+// EndDeviceSection(): on a GPU with CUDA events (see ComputeTimingEvents), so that it is the time the GPU spent,
+// not the time it took to queue the work. The events of a minibatch are read at the end of the next one
+// (EndMinibatch()), which keeps the host at most one minibatch ahead of the GPU. On the CPU, and when the
+// NodeProfiler owns the timing events, computation is timed on the host.
+// Report() samples the device and writes one line per worker:
+//   Telemetry: rank = 3; device = 0; minibatches = 10; read = ...s; upload = ...s; forward = ...s; ...
+// With summarizeAcrossRanks, which all workers must call together, the main node also writes the minimum, average,
+// and maximum of each section over the workers and the slowest one, to spot a straggler without going through
+// all logs. If a metrics file is given, Report() also replaces it with the same values in the Prometheus text
+// format (labeled by rank), e.g. for the textfile collector of a node exporter.
+// -----------------------------------------------------------------------
+
+class TrainingTelemetry
+{
+public:
+    TrainingTelemetry(DEVICEID_TYPE deviceId, size_t rank, const std::wstring& metricsFile, bool useTimingEvents)
+        : m_deviceId(deviceId), m_rank(rank), m_metricsFile(metricsFile), m_useTimingEvents(useTimingEvents && deviceId >= 0), m_slot(0), m_openEvent(SIZE_MAX)
+    {
+        ResetInterval();
+    }
+
+    void AddHostTime(TrainingSection section, double seconds)
+    {
+        m_seconds[(size_t) section] += seconds;
+    }
+
+    void BeginDeviceSection(TrainingSection section)
+    {
+        if (!m_useTimingEvents)
+        {
+            m_hostTimer.Restart();
+            return;
+        }
+        auto& pending = m_pending[m_slot];
+        if (2 * pending.size() + 2 > maxEventsPerMinibatch) // (not timed beyond this; only with many sub-minibatches)
+            return;
+        m_openEvent = Event(m_slot, 2 * pending.size());
+        ComputeTimingEvents::Record(m_deviceId, m_openEvent);
+        pending.push_back(section);
+    }
+
+    void EndDeviceSection(TrainingSection section)
+    {
+        if (!m_useTimingEvents)
+        {
+            m_hostTimer.Stop();
+            AddHostTime(section, m_hostTimer.ElapsedSeconds());
+            return;
+        }
+        if (m_openEvent == SIZE_MAX)
+            return;
+        ComputeTimingEvents::Record(m_deviceId, m_openEvent + 1);
+        m_openEvent = SIZE_MAX;
+    }
+
+    // switch to the other set of events, after reading the times of the minibatch that last used it
+    void EndMinibatch()
+    {
+        m_slot = 1 - m_slot;
+        Collect(m_slot);
+    }
+
+    // at the end of a progress interval of numMBs minibatches that took intervalSeconds
+    void Report(size_t epoch, size_t numMBs, double intervalSeconds, bool summarizeAcrossRanks)
+    {
+        Collect(1 - m_slot); // (the last minibatch)
+        const GPUTelemetrySample gpu = m_deviceId >= 0 ? GPUWatcher::GetTelemetryOfCUDADevice(m_deviceId) : GPUTelemetrySample();
+        double sectionsSeconds = 0;
+        for (size_t s = 0; s < numTrainingSections; s++)
+            sectionsSeconds += m_seconds[s];
+        const double otherSeconds = max(intervalSeconds - sectionsSeconds, 0.0); // host work between the sections, and stalls
+
+        fprintf(stderr, "Telemetry: rank = %d; device = %d; minibatches = %d; ", (int) m_rank, (int) m_deviceId, (int) numMBs);
+        for (size_t s = 0; s < numTrainingSections; s++)
+            fprintf(stderr, "%s = %.4fs; ", SectionName(s), m_seconds[s]);
+        fprintf(stderr, "other = %.4fs; SMUtil = %d%%; memoryUsed = %.1f MB of %.1f MB; memoryCached = %.1f MB; PCIeTx = %.1f MB/s; PCIeRx = %.1f MB/s\n",
+                otherSeconds, gpu.smUtilization, gpu.memoryUsedMB, gpu.memoryTotalMB, gpu.memoryCachedMB, gpu.pcieTxMBPerSec, gpu.pcieRxMBPerSec);
+
+        if (summarizeAcrossRanks && g_mpi && g_mpi->NumNodesInUse() > 1)
+            ReportAcrossRanks();
+
+        if (!m_metricsFile.empty())
+        {
+            // written aside and renamed, so that a scraper never sees a partial file
+            const std::wstring tmpFile = m_metricsFile + L".tmp";
+            {
+                FILE* f = fopenOrDie(tmpFile, L"w");
+                WriteMetric(f, "cntk_epoch", nullptr, (double) epoch);
+                WriteMetric(f, "cntk_minibatches", nullptr, (double) numMBs);
+                for (size_t s = 0; s < numTrainingSections; s++)
+                    WriteMetric(f, "cntk_section_seconds", SectionName(s), m_seconds[s]);
+                WriteMetric(f, "cntk_section_seconds", "other", otherSeconds);
+                WriteMetric(f, "cntk_gpu_sm_utilization_percent", nullptr, gpu.smUtilization);
+                WriteMetric(f, "cntk_gpu_memory_used_megabytes", nullptr, gpu.memoryUsedMB);
+                WriteMetric(f, "cntk_gpu_memory_cached_megabytes", nullptr, gpu.memoryCachedMB);
+                WriteMetric(f, "cntk_gpu_pcie_tx_megabytes_per_second", nullptr, gpu.pcieTxMBPerSec);
+                WriteMetric(f, "cntk_gpu_pcie_rx_megabytes_per_second", nullptr, gpu.pcieRxMBPerSec);
+                fcloseOrDie(f);
+            }
+            renameOrDie(tmpFile, m_metricsFile);
+        }
+        ResetInterval();
+    }
+
+private:
+    static const size_t maxEventsPerMinibatch = 64;
+
+    static size_t Event(size_t slot, size_t k)
+    {
+        return slot * maxEventsPerMinibatch + k;
+    }
+
+    static const char* SectionName(size_t s)
+    {
+        static const char* names[numTrainingSections] = {"read", "upload", "forward", "backward", "aggregation", "update"};
+        return names[s];
+    }
+
+    void Collect(size_t slot)
+    {
+        auto& pending = m_pending[slot];
+        for (size_t k = 0; k < pending.size(); k++)
+            m_seconds[(size_t) pending[k]] += ComputeTimingEvents::ElapsedMilliseconds(m_deviceId, Event(slot, 2 * k), Event(slot, 2 * k + 1)) / 1000.0;
+        pending.clear();
+    }
+
+    // every worker fills its row of a table that the all-reduce sums up
+    void ReportAcrossRanks()
+    {
+        const size_t numRanks = g_mpi->NumNodesInUse();
+        std::vector<double> table(numRanks * numTrainingSections, 0.0);
+        for (size_t s = 0; s < numTrainingSections; s++)
+            table[m_rank * numTrainingSections + s] = m_seconds[s];
+        g_mpi->AllReduce(table);
+        if (!g_mpi->IsMainNode())
+            return;
+        fprintf(stderr, "Telemetry over %d ranks (min/avg/max, slowest rank):", (int) numRanks);
+        for (size_t s = 0; s < numTrainingSections; s++)
+        {
+            double minSeconds = table[s], maxSeconds = table[s], sumSeconds = 0;
+            size_t slowest = 0;
+            for (size_t r = 0; r < numRanks; r++)
+            {
+                const double seconds = table[r * numTrainingSections + s];
+                sumSeconds += seconds;
+                minSeconds = min(minSeconds, seconds);
+                if (seconds > maxSeconds)
+                {
+                    maxSeconds = seconds;
+                    slowest = r;
+                }
+            }
+            fprintf(stderr, " %s = %.4f/%.4f/%.4fs, %d;", SectionName(s), minSeconds, sumSeconds / numRanks, maxSeconds, (int) slowest);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    void ResetInterval()
+    {
+        for (size_t s = 0; s < numTrainingSections; s++)
+            m_seconds[s] = 0;
+    }
+
+    void WriteMetric(FILE* f, const char* name, const char* section, double value) const
+    {
+        if (section)
+            fprintf(f, "%s{rank=\"%d\",device=\"%d\",section=\"%s\"} %g\n", name, (int) m_rank, (int) m_deviceId, section, value);
+        else
+            fprintf(f, "%s{rank=\"%d\",device=\"%d\"} %g\n", name, (int) m_rank, (int) m_deviceId, value);
+    }
+
+    DEVICEID_TYPE m_deviceId;
+    size_t m_rank;
+    std::wstring m_metricsFile;
+    bool m_useTimingEvents;
+    double m_seconds[numTrainingSections];
+    std::vector<TrainingSection> m_pending[2]; // [slot] the sections timed by events in the minibatch that uses the slot
+    size_t m_slot;                             // the slot of the current minibatch
+    size_t m_openEvent;                        // begin event of the section in progress; SIZE_MAX if none
+    Timer m_hostTimer;
+};
+} } }
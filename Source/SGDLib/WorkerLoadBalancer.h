@@ -0,0 +1,95 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// WorkerLoadBalancer.h -- minibatch shares of the data-parallel workers in proportion to their throughput
+//
+#pragma once
+
+#include "Basics.h"
+#include "MPIWrapper.h"
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// WorkerLoadBalancer -- how much of each minibatch every worker takes, so that fast GPUs do not wait for slow ones
+//
+// Each worker reports every minibatch with the number of samples it processed and the time it took (reading and
+// computing, not the wait for the other workers). Every 'windowSize' minibatches, the workers exchange their
+// throughput over the last 'windowSize' minibatches, and Shares() becomes proportional to it (at least a quarter
+// of an equal share, so that a worker keeps being measured). All workers must report the same minibatches, as in
+// synchronous data-parallel SGD; they then compute the same shares. The aggregated gradient needs no reweighting:
+// the numbers of samples of the workers add up in the DistGradHeader.
+// -----------------------------------------------------------------------
+
+class WorkerLoadBalancer
+{
+public:
+    WorkerLoadBalancer(MPIWrapper* mpi, size_t windowSize)
+        : m_mpi(mpi), m_windowSize(windowSize), m_numMinibatches(0), m_shares(mpi->NumNodesInUse(), 1.0 / mpi->NumNodesInUse())
+    {
+        if (windowSize == 0)
+            InvalidArgument("WorkerLoadBalancer: the window must be at least one minibatch.");
+    }
+
+    // [rank] fraction of the parallel sequences of every minibatch; they add up to 1
+    const std::vector<double>& Shares() const
+    {
+        return m_shares;
+    }
+
+    void AddMinibatch(size_t numSamples, double seconds)
+    {
+        m_window.push_back(std::make_pair(numSamples, seconds));
+        if (m_window.size() > m_windowSize)
+            m_window.pop_front();
+        if (++m_numMinibatches % m_windowSize == 0)
+            Rebalance();
+    }
+
+private:
+    void Rebalance()
+    {
+        double numSamples = 0, seconds = 0;
+        for (const auto& minibatch : m_window)
+        {
+            numSamples += minibatch.first;
+            seconds += minibatch.second;
+        }
+        double throughput = seconds > 0 ? numSamples / seconds : 0;
+        std::vector<double> throughputs(m_shares.size());
+        MPI_Allgather(&throughput, 1, MPI_DOUBLE, throughputs.data(), 1, MPI_DOUBLE, m_mpi->Communicator()) || MpiFail("MPI_Allgather");
+
+        double sum = 0;
+        for (double t : throughputs)
+            sum += t;
+        if (sum <= 0 || std::find(throughputs.begin(), throughputs.end(), 0.0) != throughputs.end()) // (a worker without samples: keep what we have)
+            return;
+        const double minShare = 0.25 / m_shares.size();
+        double sumOfShares = 0;
+        for (size_t r = 0; r < m_shares.size(); r++)
+        {
+            m_shares[r] = std::max(throughputs[r] / sum, minShare);
+            sumOfShares += m_shares[r];
+        }
+        for (auto& share : m_shares)
+            share /= sumOfShares;
+        if (m_mpi->IsMainNode())
+        {
+            fprintf(stderr, "WorkerLoadBalancer: minibatch shares");
+            for (double share : m_shares)
+                fprintf(stderr, " %.3f", share);
+            fprintf(stderr, "\n");
+        }
+    }
+
+    MPIWrapper* m_mpi;
+    size_t m_windowSize;
+    size_t m_numMinibatches;
+    std::deque<std::pair<size_t, double>> m_window; // (samples, seconds) of the last m_windowSize minibatches
+    std::vector<double> m_shares;
+};
+} } }
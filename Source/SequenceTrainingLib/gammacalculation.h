@@ -65,6 +65,14 @@ public:
 
             if (parallellattice.enabled())                             // send hmm set to GPU if GPU computation enabled
                 parallellattice.entercomputation(m_hset, mbrclassdef); // cache senone2classmap if mpemode
+            if (m_deviceid != CPUDEVICE)
+            {
+                m_packedloglls.reset(new Microsoft::MSR::CNTK::Matrix<ElemType>(m_deviceid));
+                m_packedlabels.reset(new Microsoft::MSR::CNTK::Matrix<ElemType>(m_deviceid));
+                m_packedgammas.reset(new Microsoft::MSR::CNTK::Matrix<ElemType>(m_deviceid));
+                m_uttlabels.reset(new Microsoft::MSR::CNTK::Matrix<ElemType>(m_deviceid));
+                m_uttgammas.reset(new Microsoft::MSR::CNTK::Matrix<ElemType>(m_deviceid));
+            }
             initialmark = true;
         }
     }
@@ -95,6 +103,11 @@ public:
                        std::vector<size_t>& extrauttmap,
                        bool doreferencealign)
     {
+        // on the GPU, all lattices of the minibatch go through a single batched forward-backward if possible
+        if (m_deviceid != CPUDEVICE && !doreferencealign &&
+            calgammaformbbatched(functionValues, lattices, loglikelihood, labels, gammafromlattice, samplesInRecurrentStep, pMBLayout, extrauttmap, uids))
+            return;
+
         // check total frame number to be added ?
         // int deviceid = loglikelihood.GetDeviceId();
         size_t boundaryframenum;
@@ -116,6 +129,14 @@ public:
         if (doreferencealign)
             labels.SetValue((ElemType)(0.0f));
 
+        // On the GPU, the lattice code reads the logLLs from GPU memory and writes the gammas into gammafromlattice (or, for
+        // parallel sequences, into a buffer they are strided from) in place, and the numerator is taken from the labels there.
+        // The logLLs only go to the CPU if it aligns to the reference, or for sparse labels of parallel sequences, which
+        // cannot be gathered on the GPU; the frames of the stripes of 'pred' are not filled otherwise.
+        const bool ondevice = m_deviceid != CPUDEVICE;
+        const bool hostloglls = !ondevice || doreferencealign ||
+                                (samplesInRecurrentStep > 1 && labels.GetMatrixType() != Microsoft::MSR::CNTK::MatrixType::DENSE);
+
         size_t T = numcols / samplesInRecurrentStep; // number of time steps in minibatch
         if (samplesInRecurrentStep > 1)
         {
@@ -136,12 +157,10 @@ public:
             if (samplesInRecurrentStep == 1) // no sequence parallelism
             {
                 tempmatrix = loglikelihood.ColumnSlice(ts, numframes);
-                // if (m_deviceid == CPUDEVICE)
-                {
+                if (hostloglls)
                     CopyFromCNTKMatrixToSSEMatrix(tempmatrix, numframes, predstripe);
-                }
 
-                if (m_deviceid != CPUDEVICE)
+                if (ondevice)
                     parallellattice.setloglls(tempmatrix);
             }
             else // multiple parallel sequences
@@ -172,15 +191,11 @@ public:
                 Microsoft::MSR::CNTK::Matrix<ElemType> loglikelihoodForCurrentParallelUtterance = loglikelihood.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
                 tempmatrix.CopyColumnsStrided(loglikelihoodForCurrentParallelUtterance, numframes, samplesInRecurrentStep, 1);
 
-                // if (doreferencealign || m_deviceid == CPUDEVICE)
-                {
+                if (hostloglls)
                     CopyFromCNTKMatrixToSSEMatrix(tempmatrix, numframes, predstripe);
-                }
 
-                if (m_deviceid != CPUDEVICE)
-                {
-                    parallellattice.setloglls(tempmatrix);
-                }
+                if (ondevice)
+                    parallellattice.setloglls(tempmatrix.ColumnSlice(0, numframes));
             }
 
             array_ref<size_t> uidsstripe(&uids[ts], numframes);
@@ -194,13 +209,38 @@ public:
             array_ref<size_t> boundariesstripe(&boundaries[ts], boundaryframenum);
 
             double numavlogp = 0;
-            foreach_column (t, dengammasstripe) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
+            if (hostloglls)
+            {
+                foreach_column (t, dengammasstripe) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
+                {
+                    const size_t s = uidsstripe[t];
+                    numavlogp += predstripe(s, t) / amf;
+                }
+            }
+            else if (samplesInRecurrentStep == 1)
+                numavlogp = Microsoft::MSR::CNTK::Matrix<ElemType>::InnerProductOfMatrices(labels.ColumnSlice(ts, numframes), tempmatrix) / amf;
+            else
             {
-                const size_t s = uidsstripe[t];
-                numavlogp += predstripe(s, t) / amf;
+                m_uttlabels->Resize(labels.GetNumRows(), numframes);
+                m_uttlabels->CopyColumnsStrided(labels.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1), numframes, samplesInRecurrentStep, 1);
+                numavlogp = Microsoft::MSR::CNTK::Matrix<ElemType>::InnerProductOfMatrices(*m_uttlabels, tempmatrix.ColumnSlice(0, numframes)) / amf;
             }
             numavlogp /= numframes;
 
+            // the gammas of the utterance: where they go on the GPU
+            Microsoft::MSR::CNTK::Matrix<ElemType> uttgammas(m_deviceid);
+            if (ondevice)
+            {
+                if (samplesInRecurrentStep == 1)
+                    uttgammas = gammafromlattice.ColumnSlice(ts, numframes);
+                else
+                {
+                    m_uttgammas->Resize(numrows, numframes);
+                    uttgammas = m_uttgammas->ColumnSlice(0, numframes);
+                }
+                parallellattice.setgammas(uttgammas);
+            }
+
             // auto_timer dengammatimer;
             double denavlogp = lattices[i]->second.forwardbackward(parallellattice,
                                                                    (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
@@ -208,24 +248,21 @@ public:
                                                                    lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
             objectValue += (ElemType)((numavlogp - denavlogp) * numframes);
 
-            if (samplesInRecurrentStep == 1)
-            {
-                tempmatrix = gammafromlattice.ColumnSlice(ts, numframes);
-            }
-
             // copy gamma to tempmatrix
             if (m_deviceid == CPUDEVICE)
             {
+                if (samplesInRecurrentStep == 1)
+                    tempmatrix = gammafromlattice.ColumnSlice(ts, numframes);
                 CopyFromSSEMatrixToCNTKMatrix(dengammas, numrows, numframes, tempmatrix, gammafromlattice.GetDeviceId());
             }
             else
-                parallellattice.getgamma(tempmatrix);
+                parallellattice.getgamma(uttgammas); // (nothing to do if they were written in place)
 
             // set gamma for multi channel
             if (samplesInRecurrentStep > 1)
             {
                 Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
-                gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(tempmatrix, numframes, 1, samplesInRecurrentStep);
+                gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(ondevice ? uttgammas : tempmatrix, numframes, 1, samplesInRecurrentStep);
             }
 
             if (doreferencealign)
@@ -248,6 +285,82 @@ public:
     }
 
 private:
+    // calgammaformbbatched() -- calgammaformb() for all lattices of the minibatch at once, see lattice::parallelforwardbackwardbatch()
+    // The utterances are packed into consecutive columns (parallel sequences are strided by samplesInRecurrentStep), so that
+    // the logLLs are uploaded to the lattice code once and the gammas come back in one matrix; nothing goes through the CPU.
+    // The numerator is taken from the labels, which must be dense for this. Returns false if the lattices cannot be batched.
+    bool calgammaformbbatched(Microsoft::MSR::CNTK::Matrix<ElemType>& functionValues,
+                              std::vector<shared_ptr<const msra::dbn::latticepair>>& lattices,
+                              const Microsoft::MSR::CNTK::Matrix<ElemType>& loglikelihood,
+                              const Microsoft::MSR::CNTK::Matrix<ElemType>& labels,
+                              Microsoft::MSR::CNTK::Matrix<ElemType>& gammafromlattice,
+                              size_t samplesInRecurrentStep, std::shared_ptr<Microsoft::MSR::CNTK::MBLayout> pMBLayout,
+                              const std::vector<size_t>& extrauttmap, const std::vector<size_t>& uids)
+    {
+        if (labels.GetMatrixType() != Microsoft::MSR::CNTK::MatrixType::DENSE || lattices.empty())
+            return false;
+
+        // first column of each utterance in the minibatch
+        const size_t S = samplesInRecurrentStep;
+        const size_t T = loglikelihood.GetNumCols() / S;
+        std::vector<size_t> uttcols(lattices.size());
+        std::vector<size_t> validframes(S, 0); // [s] cursor pointing to next utterance begin within a single parallel sequence [s]
+        std::vector<const msra::lattices::lattice*> denlattices(lattices.size());
+        size_t totalframes = 0;
+        for (size_t i = 0; i < lattices.size(); i++)
+        {
+            const size_t numframes = lattices[i]->getnumframes();
+            if (S == 1)
+                uttcols[i] = totalframes;
+            else
+            {
+                const size_t mapi = extrauttmap[i];
+                if (validframes[mapi] + numframes > T || !pMBLayout->IsEnd(mapi, validframes[mapi] + numframes - 1))
+                    LogicError("gammacalculation: IsEnd() not working, utterance %d does not end after %d frames", (int) i, (int) numframes);
+                uttcols[i] = mapi + validframes[mapi] * S;
+                validframes[mapi] += numframes;
+            }
+            denlattices[i] = &lattices[i]->second;
+            totalframes += numframes;
+        }
+        if (uids.size() < totalframes)
+            return false;
+
+        // pack
+        m_packedloglls->Resize(loglikelihood.GetNumRows(), totalframes);
+        m_packedlabels->Resize(labels.GetNumRows(), totalframes);
+        size_t ts = 0;
+        for (size_t i = 0; i < lattices.size(); i++)
+        {
+            const size_t numframes = lattices[i]->getnumframes();
+            const size_t span = (numframes - 1) * S + 1;
+            m_packedloglls->ColumnSlice(ts, numframes).CopyColumnsStrided(loglikelihood.ColumnSlice(uttcols[i], span), numframes, S, 1);
+            m_packedlabels->ColumnSlice(ts, numframes).CopyColumnsStrided(labels.ColumnSlice(uttcols[i], span), numframes, S, 1);
+            ts += numframes;
+        }
+
+        std::vector<double> denavlogps;
+        const std::vector<size_t> packeduids(uids.begin(), uids.begin() + totalframes);
+        if (!msra::lattices::lattice::parallelforwardbackwardbatch(parallellattice, denlattices, m_hset, *m_packedloglls, packeduids,
+                                                                   lmf, wp, amf, boostmmifactor, seqsMBRmode, *m_packedgammas, denavlogps))
+            return false;
+
+        // objective: sum over utterances of (numerator - denominator) log likelihood
+        double objectValue = Microsoft::MSR::CNTK::Matrix<ElemType>::InnerProductOfMatrices(*m_packedlabels, *m_packedloglls) / amf;
+        ts = 0;
+        for (size_t i = 0; i < lattices.size(); i++)
+        {
+            const size_t numframes = lattices[i]->getnumframes();
+            const size_t span = (numframes - 1) * S + 1;
+            gammafromlattice.ColumnSlice(uttcols[i], span).CopyColumnsStrided(m_packedgammas->ColumnSlice(ts, numframes), numframes, 1, S);
+            objectValue -= denavlogps[i] * numframes;
+            fprintf(stderr, "dengamma value %f\n", denavlogps[i]);
+            ts += numframes;
+        }
+        functionValues.SetValue((ElemType) objectValue);
+        return true;
+    }
+
     // Helper methods for copying between ssematrix objects and CNTK matrices
     void CopyFromCNTKMatrixToSSEMatrix(const Microsoft::MSR::CNTK::Matrix<ElemType>& src, size_t numCols, msra::math::ssematrixbase& dest)
     {
@@ -378,5 +491,12 @@ private:
     std::unique_ptr<Microsoft::MSR::CNTK::CUDAPageLockedMemAllocator> m_cudaAllocator;
     std::shared_ptr<ElemType> m_intermediateCUDACopyBuffer;
     size_t m_intermediateCUDACopyBufferSize;
+    // for calgammaformbbatched(): the utterances of the minibatch in consecutive columns
+    std::unique_ptr<Microsoft::MSR::CNTK::Matrix<ElemType>> m_packedloglls;
+    std::unique_ptr<Microsoft::MSR::CNTK::Matrix<ElemType>> m_packedlabels;
+    std::unique_ptr<Microsoft::MSR::CNTK::Matrix<ElemType>> m_packedgammas;
+    // for the GPU path of calgammaformb(): an utterance of a parallel sequence in consecutive columns
+    std::unique_ptr<Microsoft::MSR::CNTK::Matrix<ElemType>> m_uttlabels;
+    std::unique_ptr<Microsoft::MSR::CNTK::Matrix<ElemType>> m_uttgammas;
 };
 } }
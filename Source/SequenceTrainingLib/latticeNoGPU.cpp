@@ -54,6 +54,32 @@ void latticefunctionsops::stateposteriors(const vectorref<unsigned short>& align
 {
 }
 
+void latticefunctionsops::forwardbackwardlatticebatch(const size_t* batchsizeforward, const size_t* batchsizebackward,
+                                                      const size_t numlaunchforward, const size_t numlaunchbackward,
+                                                      const vectorref<unsigned int>& edgeorder, const vectorref<unsigned int>& edgelattices,
+                                                      const vectorref<unsigned int>& latticenodes,
+                                                      const size_t spalignunitid, const size_t silalignunitid,
+                                                      const vectorref<float>& edgeacscores, const vectorref<msra::lattices::edgeinfowithscores>& edges,
+                                                      const vectorref<msra::lattices::nodeinfo>& nodes,
+                                                      const vectorref<msra::lattices::aligninfo>& aligns, const vectorref<unsigned short>& aligments,
+                                                      const vectorref<unsigned int>& aligmentoffsets,
+                                                      vectorref<double>& logpps, vectorref<double>& logalphas, vectorref<double>& logbetas,
+                                                      const float lmf, const float wp, const float amf, const float boostingfactor, const bool returnEframescorrect,
+                                                      const vectorref<unsigned short>& uids, const vectorref<unsigned short>& senone2classmap,
+                                                      vectorref<double>& logaccalphas, vectorref<double>& logaccbetas,
+                                                      vectorref<double>& logframescorrectedge, vectorref<double>& logEframescorrect,
+                                                      vectorref<double>& latticetotals) const
+{
+}
+
+void latticefunctionsops::sMBRerrorsignalbatch(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
+                                               const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
+                                               const vectorref<double>& logpps, const float amf, const vectorref<double>& logEframescorrect,
+                                               const vectorref<unsigned int>& edgelattices, const vectorref<double>& latticetotals,
+                                               matrixref<float>& errorsignal, matrixref<float>& errorsignalneg) const
+{
+}
+
 latticefunctions* newlatticefunctions(size_t deviceid)
 {
     return nullptr;
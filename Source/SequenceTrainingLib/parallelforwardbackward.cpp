@@ -105,7 +105,8 @@ void forwardlatticej(const size_t batchsize, const size_t startindex, const std:
     if (j < batchsize) // note: will cause issues if we ever use __synctreads() in forwardlatticej
     {
         msra::lattices::latticefunctionskernels::forwardlatticej(j + startindex, edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns, alignments, alignmentoffsets,
-                                                                 logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas);
+                                                                 logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas,
+                                                                 0, nodes.size() - 1);
     }
 }
 
@@ -126,7 +127,7 @@ void backwardlatticej(const size_t batchsize, const size_t startindex, const std
         msra::lattices::latticefunctionskernels::backwardlatticej(j + startindex, edgeacscores, spalignunitid, silalignunitid,
                                                                   edges, nodes, aligns, totalfwscore, logpps, logalphas,
                                                                   logbetas, lmf, wp, amf, boostingfactor, returnEframescorrect, logframescorrectedge,
-                                                                  logaccalphas, Eframescorrectbuf, logaccbetas);
+                                                                  logaccalphas, Eframescorrectbuf, logaccbetas, 0, nodes.size() - 1);
     }
 }
 
@@ -359,6 +360,45 @@ static void emulatemmierrorsignal(const std::vector<unsigned short>& alignstatei
                 });
 }
 
+// determinelaunchbatches() -- split the edges of a lattice into batches without data dependencies, one kernel launch each
+// Forward, a batch is a run of edges that all start before the first end node of the run (the lattice is sorted by end node);
+// backward, a run (in reverse order) of edges that all end after the last start node of the run.
+template <class edgestype>
+static void determinelaunchbatches(const edgestype& edges, std::vector<size_t>& batchsizeforward, std::vector<size_t>& batchsizebackward)
+{
+    size_t endindexforward = edges[0].E;
+    size_t countbatchforward = 0;
+
+    size_t endindexbackward = edges.back().S;
+    size_t countbatchbackward = 0;
+    foreach_index (j, edges) // compute the batch size info for kernel launches
+    {
+        if (edges[j].S < endindexforward)
+            countbatchforward++; // note: we don't check forward because the order of end node is assured.
+        else
+        {
+            batchsizeforward.push_back(countbatchforward);
+            countbatchforward = 1;
+            endindexforward = edges[j].E;
+        }
+        const size_t backj = edges.size() - 1 - j;
+        if (edges[backj].E > endindexbackward)
+        {
+            countbatchbackward++;
+            if (endindexbackward < edges[backj].S)
+                endindexbackward = edges[backj].S;
+        }
+        else
+        {
+            batchsizebackward.push_back(countbatchbackward);
+            countbatchbackward = 1;
+            endindexbackward = edges[backj].S;
+        }
+    }
+    batchsizeforward.push_back(countbatchforward);
+    batchsizebackward.push_back(countbatchbackward);
+}
+
 // -----------------------------------------------------------------------
 // parallelstate (-impl) --holds variables for CUDA access
 // -----------------------------------------------------------------------
@@ -396,8 +436,14 @@ struct parallelstateimpl
           errorsignalneggpu(new Microsoft::MSR::CNTK::Matrix<float>((int) deviceid)),
           errorsignalgpustorage(new Microsoft::MSR::CNTK::Matrix<float>((int) deviceid)),
           errorsignalneggpustorage(new Microsoft::MSR::CNTK::Matrix<float>((int) deviceid)),
+          errorsignalingammas(false),
           backptrstoragegpu(msra::cuda::newushortvector(deviceid)),
-          backptroffsetsgpu(msra::cuda::newsizetvector(deviceid))
+          backptroffsetsgpu(msra::cuda::newsizetvector(deviceid)),
+          // minibatch arena
+          edgeordergpu(msra::cuda::newuintvector(deviceid)),
+          edgelatticesgpu(msra::cuda::newuintvector(deviceid)),
+          latticenodesgpu(msra::cuda::newuintvector(deviceid)),
+          latticetotalsgpu(msra::cuda::newdoublevector(deviceid))
     {
     }
 
@@ -541,6 +587,15 @@ struct parallelstateimpl
     std::unique_ptr<Microsoft::MSR::CNTK::Matrix<float>> errorsignalneggpustorage;
     std::unique_ptr<Microsoft::MSR::CNTK::Matrix<float>> errorsignalgpu;
     std::unique_ptr<Microsoft::MSR::CNTK::Matrix<float>> errorsignalneggpu;
+    std::unique_ptr<Microsoft::MSR::CNTK::Matrix<float>> gammasgpu; // (a view) where the next cacheerrorsignal() puts errorsignalgpu, see setgammas()
+    bool errorsignalingammas;                                        // errorsignalgpu is a view of gammasgpu
+
+    // all lattices of a minibatch packed into one arena, for parallelforwardbackwardbatch()
+    // The arena itself lives in edgesgpu, nodesgpu, etc., like a single lattice.
+    std::unique_ptr<msra::cuda::uintvector> edgeordergpu;    // arena edge indices in launch order, forward launches first
+    std::unique_ptr<msra::cuda::uintvector> edgelatticesgpu; // [j] lattice of arena edge j
+    std::unique_ptr<msra::cuda::uintvector> latticenodesgpu; // [l] first arena node of lattice l; one extra element for the end
+    std::unique_ptr<doublevector> latticetotalsgpu;          // [3 * #lattices] total fw scores, total bw scores, logEframescorrecttotals
 
     // cache current lattice
     // This is a weird mix of const/non-const and private lattice data... :(
@@ -571,15 +626,52 @@ struct parallelstateimpl
         /*cudalogLLs->allocate (logLLs.rows(), logLLs.cols());
             cudalogLLs->assign(0, logLLs.rows(), 0, logLLs.cols(), &logLLs(0,0), logLLs.getcolstride(), true);  // doing this last with 'true' so we can measure time better; maybe remove later*/
     }
+    // cache the arena of a minibatch (see parallelforwardbackwardbatch())
+    template <class edgestype, class nodestype, class aligntype>
+    void setminibatchdata(const edgestype& edges, const nodestype& nodes, const aligntype& align,
+                          const std::vector<unsigned int>& alignoffsets, const size_t alignbuffersize,
+                          const std::vector<size_t>& backptroffsets, const size_t backptrstoragesize,
+                          const std::vector<unsigned int>& edgeorder, const std::vector<unsigned int>& edgelattices,
+                          const std::vector<unsigned int>& latticenodes)
+    {
+        edgesgpu->assign(edges, false);
+        nodesgpu->assign(nodes, false);
+        aligngpu->assign(align, false);
+        alignoffsetsgpu->assign(alignoffsets, false);
+        backptrstoragegpu->allocate(backptrstoragesize);
+        backptroffsetsgpu->assign(backptroffsets, false);
+        alignresult->allocate(alignbuffersize);
+        edgeacscoresgpu->allocate(edges.size());
+
+        edgeordergpu->assign(edgeorder, false);
+        edgelatticesgpu->assign(edgelattices, false);
+        latticenodesgpu->assign(latticenodes, true);
+        latticetotalsgpu->allocate(3 * (latticenodes.size() - 1));
+    }
     // template<class ElemType>
+    // a view, not a copy; 'loglls' must be kept until forwardbackward() has returned
     void setloglls(const Microsoft::MSR::CNTK::Matrix<float>& loglls)
     {
-        *cudalogLLs = loglls;
+        *cudalogLLs = loglls.ColumnSlice(0, loglls.GetNumCols());
+    }
+    void setgammas(Microsoft::MSR::CNTK::Matrix<float>& gammas)
+    {
+        gammasgpu.reset(new Microsoft::MSR::CNTK::Matrix<float>(gammas.ColumnSlice(0, gammas.GetNumCols())));
     }
     void getgamma(Microsoft::MSR::CNTK::Matrix<float>& loglls)
     {
+        gammasgpu.reset();
+        if (errorsignalingammas) // (already there)
+        {
+            errorsignalingammas = false;
+            return;
+        }
         loglls = *errorsignalgpu;
     }
+    bool iserrorsignalingammas() const
+    {
+        return errorsignalingammas;
+    }
     template <class edgealignments>
     void copyalignments(edgealignments& edgeAlignments)
     {
@@ -620,20 +712,29 @@ struct parallelstateimpl
     // check if gpumatrixstorage supports size of cpumatrix, if not allocate. set gpumatrix to part of gpumatrixstorage
     void cacheerrorsignal(const msra::math::ssematrixbase& errorsignal, const bool cacheerrsignalneg)
     {
-        if (errorsignalgpustorage->GetNumRows() != 0 && errorsignalgpustorage->GetNumRows() != errorsignal.rows())
-            throw ::logic_error("gpumatrixstorage->rows() shall be fixed once allocated");
-        if (errorsignalgpustorage->GetNumCols() < errorsignal.cols())
-            errorsignalgpustorage->Resize(errorsignal.rows(), errorsignal.cols());
-        *errorsignalgpu = errorsignalgpustorage->ColumnSlice(0, errorsignal.cols());
-
-        if (cacheerrsignalneg)
+        errorsignalingammas = gammasgpu && gammasgpu->GetNumRows() == errorsignal.rows() && gammasgpu->GetNumCols() == errorsignal.cols();
+        if (errorsignalingammas)
+            *errorsignalgpu = gammasgpu->ColumnSlice(0, errorsignal.cols());
+        else
         {
-            if (errorsignalneggpustorage->GetNumRows() != 0 && errorsignalneggpustorage->GetNumRows() != errorsignal.rows())
+            if (errorsignalgpustorage->GetNumRows() != 0 && errorsignalgpustorage->GetNumRows() != errorsignal.rows())
                 throw ::logic_error("gpumatrixstorage->rows() shall be fixed once allocated");
-            if (errorsignalneggpustorage->GetNumCols() < errorsignal.cols())
-                errorsignalneggpustorage->Resize(errorsignal.rows(), errorsignal.cols());
-            *errorsignalneggpu = errorsignalneggpustorage->ColumnSlice(0, errorsignal.cols());
+            if (errorsignalgpustorage->GetNumCols() < errorsignal.cols())
+                errorsignalgpustorage->Resize(errorsignal.rows(), errorsignal.cols());
+            *errorsignalgpu = errorsignalgpustorage->ColumnSlice(0, errorsignal.cols());
         }
+        gammasgpu.reset(); // (for one lattice only)
+
+        if (cacheerrsignalneg)
+            cacheerrorsignalneg(errorsignal.rows(), errorsignal.cols());
+    }
+    void cacheerrorsignalneg(const size_t rows, const size_t cols)
+    {
+        if (errorsignalneggpustorage->GetNumRows() != 0 && errorsignalneggpustorage->GetNumRows() != rows)
+            throw ::logic_error("gpumatrixstorage->rows() shall be fixed once allocated");
+        if (errorsignalneggpustorage->GetNumCols() < cols)
+            errorsignalneggpustorage->Resize(rows, cols);
+        *errorsignalneggpu = errorsignalneggpustorage->ColumnSlice(0, cols);
     }
 
     void getedgeacscores(std::vector<float>& edgeacscores)
@@ -720,6 +821,17 @@ void lattice::parallelstate::setloglls(const Microsoft::MSR::CNTK::Matrix<double
     throw ::logic_error("Double precision not supported for sequence training");
 }
 
+void lattice::parallelstate::setgammas(Microsoft::MSR::CNTK::Matrix<float>& gammas)
+{
+    pimpl->setgammas(gammas);
+}
+
+// TODO: Overload to enable compilation for DoublePrecision though its currently unsupported
+void lattice::parallelstate::setgammas(Microsoft::MSR::CNTK::Matrix<double>& /*gammas*/)
+{
+    throw ::logic_error("Double precision not supported for sequence training");
+}
+
 void lattice::parallelstate::getgamma(Microsoft::MSR::CNTK::Matrix<float>& loglls)
 {
     pimpl->getgamma(loglls);
@@ -784,38 +896,7 @@ double lattice::parallelforwardbackwardlattice(parallelstate& parallelstate, con
 {                                     // ^^ TODO: remove this
     vector<size_t> batchsizeforward;  // record the batch size that exclude the data dependency for forward
     vector<size_t> batchsizebackward; // record the batch size that exclude the data dependency for backward
-
-    size_t endindexforward = edges[0].E;
-    size_t countbatchforward = 0;
-
-    size_t endindexbackward = edges.back().S;
-    size_t countbatchbackward = 0;
-    foreach_index (j, edges) // compute the batch size info for kernel launches
-    {
-        if (edges[j].S < endindexforward)
-            countbatchforward++; // note: we don't check forward because the order of end node is assured.
-        else
-        {
-            batchsizeforward.push_back(countbatchforward);
-            countbatchforward = 1;
-            endindexforward = edges[j].E;
-        }
-        const size_t backj = edges.size() - 1 - j;
-        if (edges[backj].E > endindexbackward)
-        {
-            countbatchbackward++;
-            if (endindexbackward < edges[backj].S)
-                endindexbackward = edges[backj].S;
-        }
-        else
-        {
-            batchsizebackward.push_back(countbatchbackward);
-            countbatchbackward = 1;
-            endindexbackward = edges[backj].S;
-        }
-    }
-    batchsizeforward.push_back(countbatchforward);
-    batchsizebackward.push_back(countbatchbackward);
+    determinelaunchbatches(edges, batchsizeforward, batchsizebackward);
 
     std::vector<unsigned short> uidsuint(uids.size()); // actually we shall not do this, but as it will not take much time, let us just leave it here now.
     foreach_index (i, uidsuint)
@@ -910,7 +991,7 @@ void lattice::parallelsMBRerrorsignal(parallelstate& parallelstate, const edgeal
                                           logEframescorrecttotal,
                                           *parallelstate->errorsignalgpu.get(), *parallelstate->errorsignalneggpu.get());
 
-        if (errorsignal.rows() > 0 && errorsignal.cols() > 0)
+        if (errorsignal.rows() > 0 && errorsignal.cols() > 0 && !parallelstate->iserrorsignalingammas()) // (else the caller takes it from the GPU, see setgammas())
         {
             parallelstate->errorsignalgpu->CopySection(errorsignal.rows(), errorsignal.cols(), &errorsignal(0, 0), errorsignal.getcolstride());
         }
@@ -943,5 +1024,222 @@ void lattice::parallelmmierrorsignal(parallelstate& parallelstate, const edgeali
         emulatemmierrorsignal(thisedgealignments.getalignmentsbuffer(), thisedgealignments.getalignoffsets(), edges, nodes, logpps, errorsignal);
     }
 }
+
+// ------------------------------------------------------------------------
+// batched version of forwardbackward() for all lattices of a minibatch
+// ------------------------------------------------------------------------
+
+// appendlaunchorder() -- append the arena edges of all lattices in launch order; launch k takes the k-th batch of every lattice
+// Backward batches are counted from the end of each lattice.
+static void appendlaunchorder(const std::vector<std::vector<size_t>>& latticebatchsizes, const std::vector<size_t>& edgebegins, const bool backward,
+                              std::vector<unsigned int>& edgeorder, std::vector<size_t>& batchsizes)
+{
+    const size_t numlattices = latticebatchsizes.size();
+    std::vector<size_t> cursors(numlattices); // [l] next edge of lattice l (backward: one past it)
+    for (size_t l = 0; l < numlattices; l++)
+        cursors[l] = backward ? edgebegins[l + 1] : edgebegins[l];
+    for (size_t k = 0;; k++)
+    {
+        size_t batchsize = 0;
+        for (size_t l = 0; l < numlattices; l++)
+        {
+            if (k >= latticebatchsizes[l].size())
+                continue;
+            const size_t n = latticebatchsizes[l][k];
+            if (backward)
+                cursors[l] -= n;
+            for (size_t j = cursors[l]; j < cursors[l] + n; j++)
+                edgeorder.push_back((unsigned int) j);
+            if (!backward)
+                cursors[l] += n;
+            batchsize += n;
+        }
+        if (batchsize == 0)
+            break;
+        batchsizes.push_back(batchsize);
+    }
+}
+
+// parallelforwardbackwardbatch() -- lattice-level forward-backward and error signal for all lattices of a minibatch at once
+// The lattices are packed into one arena of nodes, edges, and alignments, with node times relative to the packed logLLs
+// (the utterances concatenated). The arena is uploaded once, and edge alignment, forward, backward, and the error signal take
+// one launch per stage for the whole minibatch instead of one per lattice. Results are fetched once at the end.
+//  - logLLs: [senone, frame] of all utterances concatenated; uids alike
+//  - errorsignal: receives the denominator gammas (MMI) or the error signal (sMBR) in the same layout
+//  - results: [l] per-frame average as returned by forwardbackward(), or LOGZERO if lattice l has no path
+// Returns false if the lattices cannot be batched (emulation, or the arena exceeds the bit fields of the lattice storage);
+// the caller then processes them one by one with forwardbackward().
+/*static*/ bool lattice::parallelforwardbackwardbatch(parallelstate& parallelstate, const std::vector<const lattice*>& lattices,
+                                                      const msra::asr::simplesenonehmm& hset, const Microsoft::MSR::CNTK::Matrix<float>& logLLs,
+                                                      const std::vector<size_t>& uids, const float lmf, const float wp, const float amf,
+                                                      const float boostingfactor, const bool sMBRmode,
+                                                      Microsoft::MSR::CNTK::Matrix<float>& errorsignal, std::vector<double>& results)
+{
+    if (!parallelstate.enabled() || parallelstate->emulation || lattices.empty())
+        return false;
+    parallelstate->validatehset(hset); // ensure the models have been correctly cached on the GPU already
+
+    // the arena must fit into the bit fields of nodeinfo and edgeinfo
+    size_t numnodes = 0, numedges = 0, numaligns = 0, numframes = 0;
+    for (const lattice* L : lattices)
+    {
+        numnodes += L->nodes.size();
+        numedges += L->edges.size();
+        numaligns += L->align.size();
+        numframes += L->info.numframes;
+    }
+    if (numnodes > ((size_t) 1 << 19) || numaligns > ((size_t) 1 << 24) || numframes > USHRT_MAX)
+        return false;
+    if (logLLs.GetNumCols() != numframes || uids.size() != numframes)
+        LogicError("parallelforwardbackwardbatch: #frames mismatch between lattices (%d) and LLs (%d) or uids (%d)", (int) numframes, (int) logLLs.GetNumCols(), (int) uids.size());
+
+    // pack the lattices
+    const size_t numlattices = lattices.size();
+    std::vector<nodeinfo> arenanodes;
+    std::vector<edgeinfowithscores> arenaedges;
+    std::vector<aligninfo> arenaalign;
+    arenanodes.reserve(numnodes);
+    arenaedges.reserve(numedges);
+    arenaalign.reserve(numaligns);
+    std::vector<unsigned int> alignoffsets(numedges + 1);
+    std::vector<size_t> backptroffsets(numedges + 1);
+    std::vector<unsigned int> edgelattices(numedges);
+    std::vector<unsigned int> latticenodes(numlattices + 1);
+    std::vector<size_t> edgebegins(numlattices + 1);
+    std::vector<size_t> framebegins(numlattices);
+    std::vector<std::vector<size_t>> latticebatchsizesforward(numlattices), latticebatchsizesbackward(numlattices);
+    size_t alignbuffersize = 0, backptrstoragesize = 0, framebegin = 0;
+    for (size_t l = 0; l < numlattices; l++)
+    {
+        const lattice& L = *lattices[l];
+        framebegins[l] = framebegin;
+        const size_t nodebegin = arenanodes.size();
+        const size_t edgebegin = arenaedges.size();
+        const size_t alignbegin = arenaalign.size();
+        latticenodes[l] = (unsigned int) nodebegin;
+        edgebegins[l] = edgebegin;
+
+        foreach_index (i, L.nodes)
+            arenanodes.push_back(nodeinfo(framebegin + L.nodes[i].t));
+        foreach_index (j, L.edges)
+        {
+            const edgeinfowithscores& e = L.edges[j];
+            edgeinfowithscores arenae(nodebegin + e.S, nodebegin + e.E, e.a, e.l, alignbegin + e.firstalign);
+            arenae.unused = e.unused; // (marks added /sil/ edges)
+            arenae.implysp = e.implysp;
+            arenaedges.push_back(arenae);
+            edgelattices[edgebegin + j] = (unsigned int) l;
+        }
+        arenaalign.insert(arenaalign.end(), L.align.begin(), L.align.end());
+
+        const edgealignments thisedgealignments(L);
+        const backpointers thisbackpointers(L, hset);
+        foreach_index (j, L.edges)
+        {
+            alignoffsets[edgebegin + j] = (unsigned int) (alignbuffersize + thisedgealignments.getalignoffsets()[j]);
+            backptroffsets[edgebegin + j] = backptrstoragesize + thisbackpointers.getbackptroffsets()[j];
+        }
+        alignbuffersize += thisedgealignments.getalignbuffersize();
+        backptrstoragesize += thisbackpointers.getbackptrstoragesize();
+
+        determinelaunchbatches(L.edges, latticebatchsizesforward[l], latticebatchsizesbackward[l]);
+        framebegin += L.info.numframes;
+    }
+    latticenodes[numlattices] = (unsigned int) numnodes;
+    edgebegins[numlattices] = numedges;
+    alignoffsets[numedges] = (unsigned int) alignbuffersize;
+    backptroffsets[numedges] = backptrstoragesize;
+
+    std::vector<unsigned int> edgeorder;
+    edgeorder.reserve(2 * numedges);
+    std::vector<size_t> batchsizeforward, batchsizebackward;
+    appendlaunchorder(latticebatchsizesforward, edgebegins, false, edgeorder, batchsizeforward);
+    appendlaunchorder(latticebatchsizesbackward, edgebegins, true, edgeorder, batchsizebackward);
+
+    std::vector<unsigned short> uidsushort(uids.size());
+    foreach_index (i, uidsushort)
+        uidsushort[i] = (unsigned short) uids[i];
+
+    // move the arena to the GPU
+    parallelstate->setminibatchdata(arenaedges, arenanodes, arenaalign, alignoffsets, alignbuffersize, backptroffsets, backptrstoragesize,
+                                    edgeorder, edgelattices, latticenodes);
+    const bool returnEframescorrect = sMBRmode;
+    const bool allocateframescorrect = (returnEframescorrect || boostingfactor != 0.0f);
+    parallelstate->allocfwbwvectors(arenaedges, arenanodes, uidsushort, allocateframescorrect, allocateframescorrect /*copyuids*/, returnEframescorrect);
+
+    if (lattices[0]->verbosity >= 2)
+        fprintf(stderr, "parallelforwardbackwardbatch: %d lattices, %d launches for forward, %d launches for backward\n",
+                (int) numlattices, (int) batchsizeforward.size(), (int) batchsizebackward.size());
+
+    std::unique_ptr<latticefunctions> latticefunctions(msra::cuda::newlatticefunctions(parallelstate.getdevice()));
+    latticefunctions->edgealignment(*parallelstate->hmmsgpu.get(), *parallelstate->lr3transPgpu.get(),
+                                    parallelstate->spalignunitid, parallelstate->silalignunitid,
+                                    logLLs, *parallelstate->nodesgpu.get(),
+                                    *parallelstate->edgesgpu.get(), *parallelstate->aligngpu.get(),
+                                    *parallelstate->alignoffsetsgpu.get(),
+                                    *parallelstate->backptrstoragegpu.get(), *parallelstate->backptroffsetsgpu.get(),
+                                    *parallelstate->alignresult.get(), *parallelstate->edgeacscoresgpu.get());
+    latticefunctions->forwardbackwardlatticebatch(&batchsizeforward[0], &batchsizebackward[0], batchsizeforward.size(), batchsizebackward.size(),
+                                                  *parallelstate->edgeordergpu.get(), *parallelstate->edgelatticesgpu.get(), *parallelstate->latticenodesgpu.get(),
+                                                  parallelstate->spalignunitid, parallelstate->silalignunitid,
+                                                  *parallelstate->edgeacscoresgpu.get(), *parallelstate->edgesgpu.get(),
+                                                  *parallelstate->nodesgpu.get(), *parallelstate->aligngpu.get(),
+                                                  *parallelstate->alignresult.get(), *parallelstate->alignoffsetsgpu.get(),
+                                                  *parallelstate->logppsgpu.get(), *parallelstate->logalphasgpu.get(),
+                                                  *parallelstate->logbetasgpu.get(), lmf, wp, amf, boostingfactor,
+                                                  returnEframescorrect, *parallelstate->uidsgpu.get(), *parallelstate->senone2classmapgpu.get(),
+                                                  *parallelstate->logaccalphasgpu.get(), *parallelstate->logaccbetasgpu.get(),
+                                                  *parallelstate->logframescorrectedgegpu.get(), *parallelstate->logEframescorrectgpu.get(),
+                                                  *parallelstate->latticetotalsgpu.get());
+
+    errorsignal.Resize(logLLs.GetNumRows(), numframes);
+    if (!sMBRmode)
+        latticefunctions->mmierrorsignal(*parallelstate->alignresult.get(), *parallelstate->alignoffsetsgpu.get(), *parallelstate->edgesgpu.get(),
+                                         *parallelstate->nodesgpu.get(), *parallelstate->logppsgpu.get(), errorsignal);
+    else
+    {
+        parallelstate->cacheerrorsignalneg(errorsignal.GetNumRows(), errorsignal.GetNumCols());
+        latticefunctions->sMBRerrorsignalbatch(*parallelstate->alignresult.get(), *parallelstate->alignoffsetsgpu.get(), *parallelstate->edgesgpu.get(),
+                                               *parallelstate->nodesgpu.get(), *parallelstate->logppsgpu.get(), amf, *parallelstate->logEframescorrectgpu.get(),
+                                               *parallelstate->edgelatticesgpu.get(), *parallelstate->latticetotalsgpu.get(),
+                                               errorsignal, *parallelstate->errorsignalneggpu.get());
+    }
+
+    // the only transfer back: 3 numbers per lattice
+    std::vector<double> latticetotals(3 * numlattices);
+    parallelstate->latticetotalsgpu->fetch(latticetotals, true);
+    results.resize(numlattices);
+    for (size_t l = 0; l < numlattices; l++)
+    {
+        const lattice& L = *lattices[l];
+        const double totalfwscore = latticetotals[l];
+        const double totalbwscore = latticetotals[numlattices + l];
+        if (totalfwscore < LOGZERO / 2)
+        {
+            fprintf(stderr, "parallelforwardbackwardbatch: WARNING: no path found in lattice (%d nodes/%d edges)\n", (int) L.nodes.size(), (int) L.edges.size());
+            errorsignal.ColumnSlice(framebegins[l], L.info.numframes).SetValue(0.0f); // do not use this lattice's part
+            results[l] = LOGZERO;
+            continue;
+        }
+        const double difffwbwscore = totalfwscore - totalbwscore;
+        if ((difffwbwscore > 0 ? difffwbwscore : -difffwbwscore) / L.nodes.size() > 1e-4)
+            fprintf(stderr, "parallelforwardbackwardbatch: WARNING: lattice fw and bw scores %.10f vs. %.10f (%d nodes/%d edges)\n", (float) totalfwscore, (float) totalbwscore, (int) L.nodes.size(), (int) L.edges.size());
+        if (!sMBRmode)
+            results[l] = totalfwscore / L.info.numframes; // av. posterior
+        else
+            results[l] = exp(latticetotals[2 * numlattices + l]) / L.info.numframes; // av. expected frame-correct count
+    }
+    return true;
+}
+
+// TODO: Overload to enable compilation for DoublePrecision though its currently unsupported
+/*static*/ bool lattice::parallelforwardbackwardbatch(parallelstate& /*parallelstate*/, const std::vector<const lattice*>& /*lattices*/,
+                                                      const msra::asr::simplesenonehmm& /*hset*/, const Microsoft::MSR::CNTK::Matrix<double>& /*logLLs*/,
+                                                      const std::vector<size_t>& /*uids*/, const float /*lmf*/, const float /*wp*/, const float /*amf*/,
+                                                      const float /*boostingfactor*/, const bool /*sMBRmode*/,
+                                                      Microsoft::MSR::CNTK::Matrix<double>& /*errorsignal*/, std::vector<double>& /*results*/)
+{
+    throw ::logic_error("Double precision not supported for sequence training");
+}
 };
 };
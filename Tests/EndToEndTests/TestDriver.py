@@ -94,8 +94,18 @@
 # In practice, TestDriver performs 1 pass through the output of run-test performing a real-time 
 # matching against all test-cases/pattern simulteneously
 #
+# ----- Benchmark mode ------
+# ./TestDriver.py benchmark [tests] runs the run-test scripts with SGD in benchmark mode: after a warm-up
+# (--warmup minibatches), training stops once --minibatches minibatches have been measured, and CNTK writes
+#   Benchmark: minibatches = 100; SamplesPerSecond = ...; ReaderWaitPerMinibatch = ...s; PeakDeviceMemory = ... MB; TimeToFirstMinibatch = ...s
+# for each training run of the test. The values are recorded in benchmark.yml in the run directory of the test and
+# compared against benchmark.<flavor>.<device model>.yml in the test directory, where <device model> is the name of
+# GPU 0 (from nvidia-smi) or of the CPU, in lowercase with '_' for anything but letters and digits. A test fails if
+# its throughput is lower, or its reader wait, peak memory or time to the first minibatch higher, than the baseline
+# by more than --tolerance percent. --update-baseline writes the baseline file of the device instead.
+#
 
-import sys, os, argparse, traceback, yaml, subprocess, random, re, time, sets
+import sys, os, argparse, traceback, yaml, subprocess, random, re, time, sets, platform
 
 thisDir = os.path.dirname(os.path.realpath(__file__))
 windows = os.getenv("OS")=="Windows_NT"
@@ -225,6 +235,53 @@ class Test:
     if not os.path.isdir(runDir):
       os.makedirs(runDir)
 
+    def processLine(line):
+      for testCaseRunResult in result.testCaseRunResults:
+        testCaseRunResult.testCase.processLine(line, testCaseRunResult, args.verbose)
+
+    cmdLine = ["bash", "-c", self.testDir + "/run-test 2>&1"]
+    exitCode, logFile, allLines = self.runScript(flavor, device, args, runDir, processLine)
+    success = True
+
+    # saving log file path, so it can be reported later
+    result.logFile = logFile
+
+    # checking exit code
+    if exitCode != 0:
+      if args.dry_run:
+        print "[SKIPPED]"
+        return result
+      else:
+        return TestRunResult.fatalError("Exit code must be 0", "==> got exit code {0} when running: {1}".format(exitCode, " ".join(cmdLine)), logFile = logFile)
+
+    # finalizing verification - need to check whether we have any unmatched lines
+    for testCaseRunResult in result.testCaseRunResults:
+      testCaseRunResult.testCase.finalize(testCaseRunResult)
+      if not testCaseRunResult.succeeded:
+        result.succeeded = False
+
+    if (self.testCases)>0 and args.update_baseline and result.succeeded:
+      # When running in --update-baseline mode 
+      # verifying that new output is succesfully matching every pattern in the testcases.yml
+      # If this is not the case then baseline update will be rejected
+      for testCase in self.testCases:
+        testCaseRunResult = testCase.processBaseline(allLines)
+        if not testCaseRunResult.succeeded:
+           result.succeeded = False
+        result.testCaseRunResults.append(testCaseRunResult)
+
+      if result.succeeded:
+       if args.verbose:
+         print "Updating baseline file", baselineFile
+       with open(baselineFile, "w") as f:
+         f.write("\n".join(allLines))
+
+    return result
+
+  # Runs the run-test script of this test in runDir
+  #   processLine - called for each line of output (except in dry-run mode), or None
+  # returns (exit code, path of the log file, all lines of output)
+  def runScript(self, flavor, device, args, runDir, processLine = None):
     # preparing environment for the test script
     os.environ["TEST_FLAVOR"] = flavor
     os.environ["TEST_DEVICE"] = device
@@ -269,45 +326,60 @@ class Test:
         print >>output, line
         allLines.append(line)
         output.flush()
-        for testCaseRunResult in result.testCaseRunResults:
-          testCaseRunResult.testCase.processLine(line, testCaseRunResult, args.verbose)
-
-    exitCode = process.wait()
-    success = True
+        if processLine:
+          processLine(line)
 
-    # saving log file path, so it can be reported later
-    result.logFile = logFile
-
-    # checking exit code
-    if exitCode != 0:
-      if args.dry_run:
-        print "[SKIPPED]"
-        return result
-      else:
-        return TestRunResult.fatalError("Exit code must be 0", "==> got exit code {0} when running: {1}".format(exitCode, " ".join(cmdLine)), logFile = logFile)
+    return process.wait(), logFile, allLines
 
-    # finalizing verification - need to check whether we have any unmatched lines
-    for testCaseRunResult in result.testCaseRunResults:
-      testCaseRunResult.testCase.finalize(testCaseRunResult)
-      if not testCaseRunResult.succeeded:
-        result.succeeded = False
+  # Runs this test in benchmark mode
+  # returns an instance of TestRunResult, with the measurements of each training run in result.benchmarks
+  def benchmark(self, flavor, device, args):
+    startTime = time.time()
+    result = self.benchmarkImpl(flavor, device, args)
+    result.duration = time.time() - startTime
+    return result
 
-    if (self.testCases)>0 and args.update_baseline and result.succeeded:
-      # When running in --update-baseline mode 
-      # verifying that new output is succesfully matching every pattern in the testcases.yml
-      # If this is not the case then baseline update will be rejected
-      for testCase in self.testCases:
-        testCaseRunResult = testCase.processBaseline(allLines)
-        if not testCaseRunResult.succeeded:
-           result.succeeded = False
-        result.testCaseRunResults.append(testCaseRunResult)
+  def benchmarkImpl(self, flavor, device, args):
+    result = TestRunResult()
+    result.succeeded = True
 
-      if result.succeeded:
-       if args.verbose:
-         print "Updating baseline file", baselineFile
-       with open(baselineFile, "w") as f:
-         f.write("\n".join(allLines))
+    runDir = os.path.join(args.run_dir, "{0}_{1}@{2}_{3}".format(self.suite, self.name, flavor, device))
+    if not os.path.isdir(runDir):
+      os.makedirs(runDir)
 
+    os.environ["TEST_BENCHMARK_ARGS"] = "benchmarkMinibatches={0} benchmarkWarmupMinibatches={1}".format(args.minibatches, args.warmup)
+    exitCode, logFile, allLines = self.runScript(flavor, device, args, runDir)
+    del os.environ["TEST_BENCHMARK_ARGS"]
+    result.logFile = logFile
+    if exitCode != 0:
+      return TestRunResult.fatalError("Exit code must be 0", "==> got exit code {0}".format(exitCode), logFile = logFile)
+
+    result.benchmarks = [BenchmarkMetrics.parse(line) for line in allLines if BenchmarkMetrics.lineRegex.search(line)]
+    if len(result.benchmarks) == 0:
+      return TestRunResult.fatalError("Benchmark output", "No 'Benchmark:' line in the output; is the test data shorter than the benchmark?", logFile = logFile)
+    with open(os.path.join(runDir, "benchmark.yml"), "w") as f:
+      yaml.safe_dump({"runs": [m.values for m in result.benchmarks]}, f, default_flow_style=False)
+
+    baselineFile = os.path.join(self.testDir, "benchmark.{0}.{1}.yml".format(flavor, args.deviceModel))
+    if args.update_baseline:
+      with open(baselineFile, "w") as f:
+        f.write("# {0} benchmark of {1} ({2}, {3} minibatches after {4} of warm-up)\n".format(args.deviceModel, self.fullName, flavor, args.minibatches, args.warmup))
+        yaml.safe_dump({"runs": [m.values for m in result.benchmarks]}, f, default_flow_style=False)
+      if args.verbose:
+        print "Updated benchmark baseline", baselineFile
+      return result
+
+    if not os.path.isfile(baselineFile):
+      return TestRunResult.fatalError("Benchmark baseline", "Can't find baseline file " + baselineFile, logFile = logFile)
+    with open(baselineFile, "r") as f:
+      baselineRuns = yaml.safe_load(f.read())["runs"]
+    if len(baselineRuns) != len(result.benchmarks):
+      return TestRunResult.fatalError("Benchmark baseline", "{0} training runs in the baseline, {1} in the output".format(len(baselineRuns), len(result.benchmarks)), logFile = logFile)
+    for i in range(0, len(baselineRuns)):
+      diagnostics = result.benchmarks[i].compare(baselineRuns[i], args.tolerance / 100.0)
+      result.testCaseRunResults.append(TestCaseRunResult("Benchmark run {0}".format(i), len(diagnostics) == 0, "\n".join(diagnostics)))
+      if len(diagnostics) > 0:
+        result.succeeded = False
     return result
 
   # Finds a location of a baseline file by probing different names in the following order:
@@ -499,6 +571,65 @@ class TestPattern:
         return False;
     return True
 
+# The measurements of one 'Benchmark:' line of CNTK output (see SGD::ReportBenchmark())
+class BenchmarkMetrics:
+  lineRegex = re.compile(r"Benchmark: minibatches = ")
+  valueRegex = re.compile(r"(\w+) = (-?[0-9.e+]+)")
+  # metric => (higher is better, absolute slack on top of the relative tolerance)
+  metrics = {
+    "SamplesPerSecond"       : (True, 0.0),
+    "ReaderWaitPerMinibatch" : (False, 0.001),
+    "PeakDeviceMemory"       : (False, 1.0),
+    "TimeToFirstMinibatch"   : (False, 0.5)
+  }
+
+  def __init__(self, values):
+    self.values = values
+
+  @staticmethod
+  def parse(line):
+    values = {}
+    for name, value in BenchmarkMetrics.valueRegex.findall(line):
+      if name in BenchmarkMetrics.metrics:
+        values[name] = float(value)
+    return BenchmarkMetrics(values)
+
+  # returns a list of the regressions against the baseline values, empty if there are none
+  def compare(self, baseline, tolerance):
+    diagnostics = []
+    for name in sorted(BenchmarkMetrics.metrics.keys()):
+      higherIsBetter, slack = BenchmarkMetrics.metrics[name]
+      if not name in baseline or not name in self.values:
+        continue
+      expected, actual = float(baseline[name]), self.values[name]
+      if higherIsBetter:
+        regressed = actual < expected * (1 - tolerance) - slack
+      else:
+        regressed = actual > expected * (1 + tolerance) + slack
+      if regressed:
+        diagnostics.append("{0}: {1:g} (baseline {2:g})".format(name, actual, expected))
+    return diagnostics
+
+# Name of the device the benchmark runs on, for the name of its baseline file: GPU 0 or the CPU
+def benchmarkDeviceModel(device):
+  name = None
+  if device == "gpu":
+    try:
+      name = subprocess.check_output(["nvidia-smi", "-i", "0", "--query-gpu=name", "--format=csv,noheader"]).strip()
+    except Exception:
+      pass
+  elif os.path.isfile("/proc/cpuinfo"):
+    with open("/proc/cpuinfo", "r") as f:
+      for line in f:
+        if line.startswith("model name"):
+          name = line.split(":", 1)[1].strip()
+          break
+  if not name:
+    name = platform.processor() if device == "cpu" else None
+  if not name:
+    return "unknown"
+  return re.sub(r"[^a-z0-9]+", "_", name.lower()).strip("_")
+
 class TestRunResult:
   def __init__(self):
     self.succeeded = False;
@@ -623,6 +754,66 @@ def runCommand(args):
   if succeededCount != totalCount:
     sys.exit(10)
 
+# Runs given test(s) or all tests in benchmark mode
+def benchmarkCommand(args):
+  if len(args.test) > 0:
+     testsToRun = []
+     for name in args.test:
+       if name.lower() in Test.allTestsIndexedByFullName:
+         testsToRun.append(Test.allTestsIndexedByFullName[name.lower()])
+       else:
+         print >>sys.stderr, "ERROR: test not found", name
+         return 1
+  else:
+     testsToRun = Test.allTestsIndexedByFullName.values()
+
+  os.environ["TEST_ROOT_DIR"] = os.path.dirname(os.path.realpath(sys.argv[0]))
+
+  print "CNTK Test Driver is started in benchmark mode"
+  print "Running tests:  ", " ".join([y.fullName for y in testsToRun])
+  print "Build location: ", args.build_location
+  print "Run location:   ", args.run_dir
+  print "Minibatches:    ", args.minibatches, "after", args.warmup, "of warm-up"
+  if (args.update_baseline):
+    print "*** Running in automatic baseline update mode ***"
+  print ""
+  succeededCount, totalCount = 0, 0
+  for test in testsToRun:
+    for flavor in args.flavors:
+      for device in args.devices:
+        for build_sku in args.buildSKUs:
+          if args.tag and args.tag != '' and not test.matchesTag(args.tag, flavor, device, 'windows' if windows else 'linux', build_sku):
+            continue
+          totalCount = totalCount + 1
+          args.deviceModel = benchmarkDeviceModel(device)
+          sys.stdout.write("Benchmarking {0} ({1} {2}, {3}) - ".format(test.fullName, flavor, device, args.deviceModel));
+          if args.verbose:
+            sys.stdout.write("\n");
+          sys.stdout.flush()
+          result = test.benchmark(flavor, device, args)
+          if result.succeeded:
+            succeededCount = succeededCount + 1
+            print "[OK] {0:.2f} sec".format(result.duration)
+          else:
+            print "[FAILED] {0:.2f} sec".format(result.duration)
+          for i, metrics in enumerate(getattr(result, "benchmarks", [])):
+            print "  run {0}: ".format(i) + "; ".join(["{0} = {1:g}".format(name, metrics.values[name]) for name in sorted(metrics.values.keys())])
+          for testCaseRunResult in result.testCaseRunResults:
+            if not testCaseRunResult.succeeded:
+              print(" [FAILED] " + testCaseRunResult.testCaseName);
+              if testCaseRunResult.diagnostics:
+                for line in testCaseRunResult.diagnostics.split('\n'):
+                  print "    " + line;
+          if not result.succeeded and result.logFile:
+            print "  See log file for details:", result.logFile
+
+  if args.update_baseline:
+    print "{0}/{1} benchmark baselines updated, {2} failed".format(succeededCount, totalCount, totalCount - succeededCount)
+  else:
+    print "{0}/{1} benchmarks passed, {2} failed".format(succeededCount, totalCount, totalCount - succeededCount)
+  if succeededCount != totalCount:
+    sys.exit(10)
+
 # ======================= Entry point =======================
 parser = argparse.ArgumentParser(description="TestDriver - CNTK Test Driver")
 subparsers = parser.add_subparsers(help="command to execute. Run TestDriver.py <command> --help for command-specific help")
@@ -649,6 +840,22 @@ runSubparser.add_argument("-n", "--dry-run", action='store_true', help="do not r
 
 runSubparser.set_defaults(func=runCommand)
 
+benchmarkSubparser = subparsers.add_parser("benchmark", help="run test(s) in benchmark mode and compare their throughput with baselines")
+benchmarkSubparser.add_argument("test", nargs="*", help="optional test name(s) to benchmark, specified as Suite/TestName; if not specified then all tests")
+benchmarkSubparser.add_argument("-b", "--build-location", default=defaultBuildLocation, help="location of the CNTK build to run")
+benchmarkSubparser.add_argument("-t", "--tag", help="benchmarks tests which match the spacified tag")
+benchmarkSubparser.add_argument("-d", "--device", default="gpu", help="cpu|gpu - run on a specified device, default: gpu")
+benchmarkSubparser.add_argument("-f", "--flavor", default="release", help="release|debug - run a specified flavor, default: release")
+benchmarkSubparser.add_argument("-s", "--build-sku", default=defaultBuildSKU, help="cpu|gpu|1bitsgd - run tests only for a specified build SKU")
+benchmarkSubparser.add_argument("-r", "--run-dir", default=defaultRunDir, help="directory where to store test output, default: a random dir within /tmp")
+benchmarkSubparser.add_argument("--minibatches", type=int, default=100, help="number of minibatches to measure, default: 100")
+benchmarkSubparser.add_argument("--warmup", type=int, default=10, help="number of minibatches to run before measuring, default: 10")
+benchmarkSubparser.add_argument("--tolerance", type=float, default=10.0, help="regression tolerance in percent of the baseline, default: 10")
+benchmarkSubparser.add_argument("--update-baseline", action='store_true', help="update the benchmark baseline files of the device instead of comparing against them")
+benchmarkSubparser.add_argument("-v", "--verbose", action='store_true', help="verbose output - dump all output of test script")
+
+benchmarkSubparser.set_defaults(func=benchmarkCommand, dry_run=False)
+
 listSubparser = subparsers.add_parser("list", help="list available tests")
 listSubparser.add_argument("-t", "--tag", help="limits a resulting list to tests matching the spacified tag")
 listSubparser.add_argument("-d", "--device", help="cpu|gpu - tests for a specified device")
@@ -687,7 +894,7 @@ if (args.build_sku):
   if not args.build_sku in args.buildSKUs:
     print >>sys.stderr, "--build-sku must be one of", args.buildSKUs
     sys.exit(1)
-  if args.func == runCommand:
+  if args.func == runCommand or args.func == benchmarkCommand:
     if (args.build_location == defaultBuildLocation):
       args.build_location = os.path.realpath(os.path.join(thisDir, "../..", "x64" if windows else "build/"+args.build_sku))
   args.buildSKUs = [args.build_sku]
@@ -7,12 +7,22 @@
 #include "Config.h"
 using namespace Microsoft::MSR::CNTK;
 
+// EvalLoadTest.cpp
+template <typename ElemType>
+void DoLoadTest(const ConfigParameters& config);
+
 // process the command
 template <typename ElemType>
 void DoCommand(const ConfigParameters& configRoot)
 {
     ConfigArray command = configRoot("command", "train");
     ConfigParameters config = configRoot(command[0]);
+    std::string action = config("action", "eval");
+    if (action == "loadTest")
+    {
+        DoLoadTest<ElemType>(config);
+        return;
+    }
     ConfigParameters readerConfig(config("reader"));
     readerConfig.Insert("traceLevel", config("traceLevel", "0"));
 
@@ -0,0 +1,304 @@
+// EvalLoadTest.cpp -- latency distribution of a model served through IEvaluateModel, under a configurable load
+//
+// The 'loadTest' action of EvalTest. A number of client threads send requests to one evaluator, either as fast as
+// their previous request returns (qps=0, closed loop), or at a fixed total rate (open loop). In the open loop, each
+// request's latency counts from the time it was due, so that a server that falls behind shows it in the tail
+// rather than by sending fewer requests. Requests are synthetic (random inputs of samplesPerRequest samples) or
+// recorded (one request per line of a text file: the values of all samples, for the input nodes in name order).
+//
+// Configuration:
+//   modelPath, outputNodeName   the model and the node to evaluate; the other keys go to the evaluator as well,
+//                               e.g. deviceId, numCPUThreads, maxBatchLatencyMs, maxBatchRequests, quantizeWeights
+//   evaluation=batched          evaluate (Evaluate(), one request at a time), batched (EvaluateBatched()) or
+//                               stream (EvaluateStream(), one stream per client thread)
+//   threads=1                   client threads, i.e. the maximum number of requests in flight
+//   qps=0                       total requests per second; 0 = every thread sends its next request when the last returns
+//   durationSeconds=10, warmupSeconds=2
+//   samplesPerRequest=1, recordedInputs=  (a file of recorded requests, instead of synthetic ones)
+//
+// The report has the latency percentiles p50/p95/p99/p99.9 and the maximum, the achieved throughput, and the
+// utilization of the CPUs (process time over all cores) and, for a GPU device, of the GPU (sampled with nvidia-smi).
+
+#include "stdafx.h"
+#include "Eval.h"
+#include "Config.h"
+#include <atomic>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#define _popen popen
+#define _pclose pclose
+#endif
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace {
+
+typedef std::chrono::steady_clock LoadTestClock;
+
+// seconds of CPU time this process has used, in all its threads
+double ProcessCPUSeconds()
+{
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+        return 0;
+    auto toSeconds = [](const FILETIME& t) { return (((unsigned long long) t.dwHighDateTime << 32) | t.dwLowDateTime) * 1e-7; };
+    return toSeconds(kernelTime) + toSeconds(userTime);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+// utilization.gpu of nvidia-smi for the given device, in percent; negative if it cannot be read
+double SampleGPUUtilization(int deviceId)
+{
+    char command[200];
+    sprintf(command, "nvidia-smi --query-gpu=utilization.gpu --format=csv,noheader,nounits -i %d", deviceId);
+    FILE* f = _popen(command, "r");
+    if (f == nullptr)
+        return -1;
+    double utilization = -1;
+    if (fscanf(f, "%lf", &utilization) != 1)
+        utilization = -1;
+    _pclose(f);
+    return utilization;
+}
+
+// the p-quantile of sorted latencies (nearest rank)
+double Percentile(const std::vector<double>& sortedLatencies, double p)
+{
+    if (sortedLatencies.empty())
+        return 0;
+    size_t rank = (size_t) ceil(p * sortedLatencies.size());
+    return sortedLatencies[std::min(std::max(rank, (size_t) 1), sortedLatencies.size()) - 1];
+}
+
+template <typename ElemType>
+struct LoadTestRequest
+{
+    std::map<std::wstring, std::vector<ElemType>> inputs;
+};
+
+// the requests of the recorded-inputs file; each line holds a whole number of samples of all input nodes
+template <typename ElemType>
+std::vector<LoadTestRequest<ElemType>> ReadRecordedRequests(const std::string& path, const std::map<std::wstring, size_t>& inputDims)
+{
+    size_t sampleSize = 0;
+    for (const auto& input : inputDims)
+        sampleSize += input.second;
+    std::ifstream f(path);
+    if (!f)
+        RuntimeError("loadTest: cannot open recordedInputs file %s", path.c_str());
+    std::vector<LoadTestRequest<ElemType>> requests;
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(f, line); lineNumber++)
+    {
+        std::istringstream values(line);
+        std::vector<ElemType> sample;
+        double value;
+        while (values >> value)
+            sample.push_back((ElemType) value);
+        if (sample.empty())
+            continue;
+        if (sample.size() % sampleSize != 0)
+            RuntimeError("loadTest: line %d of %s has %d values, not a multiple of the %d values of a sample", (int) lineNumber, path.c_str(), (int) sample.size(), (int) sampleSize);
+        const size_t numSamples = sample.size() / sampleSize;
+        LoadTestRequest<ElemType> request;
+        size_t offset = 0;
+        for (const auto& input : inputDims)
+        {
+            std::vector<ElemType>& inputValues = request.inputs[input.first];
+            for (size_t t = 0; t < numSamples; t++)
+                inputValues.insert(inputValues.end(), sample.begin() + t * sampleSize + offset, sample.begin() + t * sampleSize + offset + input.second);
+            offset += input.second;
+        }
+        requests.push_back(std::move(request));
+    }
+    if (requests.empty())
+        RuntimeError("loadTest: no requests in %s", path.c_str());
+    return requests;
+}
+}
+
+template <typename ElemType>
+void DoLoadTest(const ConfigParameters& config)
+{
+    const std::wstring modelPath = config("modelPath");
+    const std::wstring outputNodeName = config("outputNodeName");
+    const std::string evaluation = config("evaluation", "batched");
+    if (evaluation != "evaluate" && evaluation != "batched" && evaluation != "stream")
+        InvalidArgument("loadTest: evaluation must be evaluate, batched or stream.");
+    const size_t numThreads = config("threads", "1");
+    const double qps = config("qps", "0");
+    const double durationSeconds = config("durationSeconds", "10");
+    const double warmupSeconds = config("warmupSeconds", "2");
+    const size_t samplesPerRequest = config("samplesPerRequest", "1");
+    const std::string recordedInputs = config("recordedInputs", "");
+    const std::string deviceIdString = config("deviceId", "auto");
+    if (numThreads == 0 || samplesPerRequest == 0 || durationSeconds <= 0)
+        InvalidArgument("loadTest: threads, samplesPerRequest and durationSeconds must be greater than 0.");
+
+    ConfigParameters evalConfig(config);
+    std::string evalConfigString = (ConfigValue) evalConfig;
+    Eval<ElemType> eval(evalConfigString);
+    eval.LoadModel(modelPath);
+    eval.StartEvaluateMinibatchLoop(outputNodeName);
+    std::map<std::wstring, size_t> inputDims, outputDims;
+    eval.GetNodeDimensions(inputDims, nodeInput);
+    eval.GetNodeDimensions(outputDims, nodeOutput);
+
+    std::vector<LoadTestRequest<ElemType>> requests;
+    if (!recordedInputs.empty())
+        requests = ReadRecordedRequests<ElemType>(recordedInputs, inputDims);
+    else
+    {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> uniform(0, 1);
+        requests.resize(16); // (a few different ones, so that no cache sees the same request every time)
+        for (auto& request : requests)
+            for (const auto& input : inputDims)
+            {
+                std::vector<ElemType>& values = request.inputs[input.first];
+                values.resize(input.second * samplesPerRequest);
+                for (auto& value : values)
+                    value = (ElemType) uniform(rng);
+            }
+    }
+    fprintf(stderr, "loadTest: %ls, %s evaluation, %d threads, %s, %d %s requests\n",
+            modelPath.c_str(), evaluation.c_str(), (int) numThreads, qps > 0 ? msra::strfun::strprintf("%.1f requests/s", qps).c_str() : "closed loop",
+            (int) requests.size(), recordedInputs.empty() ? "synthetic" : "recorded");
+
+    const auto start = LoadTestClock::now();
+    const auto measureStart = start + std::chrono::duration_cast<LoadTestClock::duration>(std::chrono::duration<double>(warmupSeconds));
+    const auto end = measureStart + std::chrono::duration_cast<LoadTestClock::duration>(std::chrono::duration<double>(durationSeconds));
+    std::vector<std::vector<double>> latencies(numThreads); // [thread] seconds of each measured request
+    std::vector<size_t> numSamples(numThreads, 0);
+    std::vector<std::exception_ptr> errors(numThreads);
+    double measureCPUSeconds = 0;
+
+    // GPU utilization, sampled while the load runs
+    std::atomic<bool> done(false);
+    std::vector<double> gpuSamples;
+    std::thread gpuSampler;
+    const bool onGPU = deviceIdString != "cpu" && deviceIdString != "-1" && deviceIdString != "auto" && isdigit(deviceIdString[0]);
+    if (onGPU)
+        gpuSampler = std::thread([&]()
+        {
+            while (!done)
+            {
+                if (LoadTestClock::now() >= measureStart)
+                {
+                    double utilization = SampleGPUUtilization(atoi(deviceIdString.c_str()));
+                    if (utilization < 0)
+                        return;
+                    gpuSamples.push_back(utilization);
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+        });
+
+    std::vector<std::thread> clients;
+    for (size_t k = 0; k < numThreads; k++)
+        clients.push_back(std::thread([&, k]()
+        {
+            try
+            {
+                std::map<std::wstring, std::vector<ElemType>> outputValues;
+                std::map<std::wstring, std::vector<ElemType>*> outputs;
+                for (const auto& output : outputDims)
+                    outputs[output.first] = &outputValues[output.first];
+                const size_t streamId = evaluation == "stream" ? eval.OpenStream() : 0;
+                // open loop: thread k sends every numThreads/qps seconds, offset so that the threads take turns
+                const double interval = qps > 0 ? numThreads / qps : 0;
+                auto due = start + std::chrono::duration_cast<LoadTestClock::duration>(std::chrono::duration<double>(interval * k / numThreads));
+                for (size_t i = k;; i += numThreads)
+                {
+                    if (qps > 0)
+                    {
+                        std::this_thread::sleep_until(due);
+                    }
+                    else
+                        due = LoadTestClock::now();
+                    if (due >= end)
+                        break;
+
+                    LoadTestRequest<ElemType>& request = requests[i % requests.size()];
+                    std::map<std::wstring, std::vector<ElemType>*> inputs;
+                    for (auto& input : request.inputs)
+                        inputs[input.first] = &input.second;
+                    if (evaluation == "evaluate")
+                        eval.Evaluate(inputs, outputs);
+                    else if (evaluation == "batched")
+                        eval.EvaluateBatched(inputs, outputs);
+                    else
+                        eval.EvaluateStream(streamId, inputs, outputs);
+                    const auto finished = LoadTestClock::now();
+
+                    if (due >= measureStart)
+                    {
+                        latencies[k].push_back(std::chrono::duration<double>(finished - due).count());
+                        numSamples[k] += inputs.begin()->second->size() / inputDims.begin()->second;
+                    }
+                    if (qps > 0)
+                        due += std::chrono::duration_cast<LoadTestClock::duration>(std::chrono::duration<double>(interval));
+                }
+                if (evaluation == "stream")
+                    eval.CloseStream(streamId);
+            }
+            catch (...)
+            {
+                errors[k] = std::current_exception();
+            }
+        }));
+
+    std::this_thread::sleep_until(measureStart);
+    const double cpuSecondsAtStart = ProcessCPUSeconds();
+    for (auto& client : clients)
+        client.join();
+    const auto measureEnd = std::min(LoadTestClock::now(), std::max(end, measureStart));
+    measureCPUSeconds = ProcessCPUSeconds() - cpuSecondsAtStart;
+    done = true;
+    if (gpuSampler.joinable())
+        gpuSampler.join();
+    for (const auto& error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    std::vector<double> allLatencies;
+    size_t totalSamples = 0;
+    for (size_t k = 0; k < numThreads; k++)
+    {
+        allLatencies.insert(allLatencies.end(), latencies[k].begin(), latencies[k].end());
+        totalSamples += numSamples[k];
+    }
+    std::sort(allLatencies.begin(), allLatencies.end());
+    const double seconds = std::chrono::duration<double>(measureEnd - measureStart).count();
+    const unsigned int numCores = std::max(std::thread::hardware_concurrency(), 1u);
+    double gpuUtilization = -1;
+    if (!gpuSamples.empty())
+    {
+        gpuUtilization = 0;
+        for (double sample : gpuSamples)
+            gpuUtilization += sample / gpuSamples.size();
+    }
+
+    fprintf(stderr, "loadTest: requests = %d; latency p50 = %.3f ms; p95 = %.3f ms; p99 = %.3f ms; p99.9 = %.3f ms; max = %.3f ms\n",
+            (int) allLatencies.size(), 1000 * Percentile(allLatencies, 0.5), 1000 * Percentile(allLatencies, 0.95), 1000 * Percentile(allLatencies, 0.99),
+            1000 * Percentile(allLatencies, 0.999), allLatencies.empty() ? 0.0 : 1000 * allLatencies.back());
+    fprintf(stderr, "loadTest: RequestsPerSecond = %.1f; SamplesPerSecond = %.1f; CPU utilization = %.1f%% of %d cores; GPU utilization = %s\n",
+            allLatencies.size() / seconds, totalSamples / seconds, 100 * measureCPUSeconds / (seconds * numCores), (int) numCores,
+            gpuUtilization >= 0 ? msra::strfun::strprintf("%.1f%%", gpuUtilization).c_str() : "n/a");
+}
+
+template void DoLoadTest<float>(const ConfigParameters& config);
+template void DoLoadTest<double>(const ConfigParameters& config);
@@ -0,0 +1,581 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MathBenchmarks.cpp -- micro-benchmarks of the Math library, with JSON results and comparison against a baseline
+//
+// Every benchmark runs one operation repeatedly on operands of a shape typical of our models, for float and double,
+// on the CPU and the GPU. Its name "op/precision/device/shape" is the key for comparing against a baseline.
+// The reported time per operation is the best of several timed batches, which is more stable than the average.
+// GPU operations are asynchronous; a batch waits for the device by copying one element of the result to the host.
+//
+#include "stdafx.h"
+#include "MathBenchmarks.h"
+#include "Matrix.h"
+#include "TensorView.h"
+#include "ConvolutionEngine.h"
+#include "CuDnnConvolutionEngine.h"
+#include "MatrixQuantizerImpl.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+struct BenchmarkOptions
+{
+    wstring jsonPath;
+    wstring baselinePath;
+    string filter;
+    double tolerance;
+    double minSeconds;
+    bool useCPU;
+    bool useGPU;
+    DEVICEID_TYPE gpuDeviceId;
+
+    BenchmarkOptions()
+        : tolerance(0.1), minSeconds(0.25), useCPU(true), useGPU(true), gpuDeviceId(0)
+    {
+    }
+};
+
+struct BenchmarkResult
+{
+    string name;
+    size_t iterations; // total number of timed runs
+    double seconds;    // per operation
+    double flops;      // per operation; 0 where not meaningful
+    double bytes;      // per operation, the operands read and written once (lower bound of the memory traffic)
+};
+
+static FILE* OpenFile(const wstring& path, const wchar_t* mode)
+{
+#ifdef _WIN32
+    FILE* f = _wfopen(path.c_str(), mode);
+#else
+    FILE* f = fopen(string(path.begin(), path.end()).c_str(), string(mode, mode + wcslen(mode)).c_str());
+#endif
+    if (!f)
+        RuntimeError("MathBenchmarks: cannot open '%ls'.", path.c_str());
+    return f;
+}
+
+// -----------------------------------------------------------------------
+// BenchmarkRunner -- times operations and collects the results
+// -----------------------------------------------------------------------
+
+class BenchmarkRunner
+{
+public:
+    BenchmarkRunner(const BenchmarkOptions& options)
+        : m_options(options)
+    {
+    }
+
+    // 'op' runs the operation once; 'sync' waits until the device has finished all operations run so far
+    void Run(const string& name, double flops, double bytes, const function<void()>& op, const function<void()>& sync)
+    {
+        if (!m_options.filter.empty() && name.find(m_options.filter) == string::npos)
+            return;
+        try
+        {
+            // warm-up: allocations, library handles, algorithm selection
+            op();
+            sync();
+
+            // double the batch size until a batch takes a fraction of the minimum time, then take the best of the batches
+            const size_t numBatches = 5;
+            size_t batchSize = 1;
+            double seconds = TimeBatch(op, sync, batchSize);
+            while (seconds * numBatches < m_options.minSeconds && batchSize < (1 << 20))
+            {
+                batchSize *= 2;
+                seconds = TimeBatch(op, sync, batchSize);
+            }
+            double best = seconds / batchSize;
+            for (size_t b = 1; b < numBatches; b++)
+                best = min(best, TimeBatch(op, sync, batchSize) / batchSize);
+
+            BenchmarkResult result = {name, batchSize * numBatches, best, flops, bytes};
+            m_results.push_back(result);
+            fprintf(stderr, "%-60s %12.3f us", name.c_str(), best * 1e6);
+            if (flops > 0)
+                fprintf(stderr, " %9.2f GFLOP/s", flops / best * 1e-9);
+            if (bytes > 0)
+                fprintf(stderr, " %9.2f GB/s", bytes / best * 1e-9);
+            fprintf(stderr, "\n");
+        }
+        catch (const exception& e)
+        {
+            fprintf(stderr, "%-60s skipped: %s\n", name.c_str(), e.what());
+        }
+    }
+
+    // write all results, one benchmark per line (ReadBaseline() relies on that)
+    void WriteJson(const wstring& path) const
+    {
+        FILE* f = OpenFile(path, L"w");
+        fprintf(f, "{\n  \"benchmarks\": [\n");
+        for (size_t i = 0; i < m_results.size(); i++)
+        {
+            const auto& r = m_results[i];
+            fprintf(f, "    {\"name\": \"%s\", \"iterations\": %d, \"seconds\": %.9g, \"gflops\": %.6g, \"gbps\": %.6g}%s\n",
+                    r.name.c_str(), (int) r.iterations, r.seconds, r.flops / r.seconds * 1e-9, r.bytes / r.seconds * 1e-9,
+                    i + 1 < m_results.size() ? "," : "");
+        }
+        fprintf(f, "  ]\n}\n");
+        fclose(f);
+        fprintf(stderr, "MathBenchmarks: %d results written to '%ls'.\n", (int) m_results.size(), path.c_str());
+    }
+
+    // compare against the results of an earlier run; returns the number of regressions
+    size_t CompareToBaseline(const wstring& path, double tolerance) const
+    {
+        const auto baseline = ReadBaseline(path);
+        size_t numRegressions = 0, numCompared = 0;
+        for (const auto& r : m_results)
+        {
+            auto iter = baseline.find(r.name);
+            if (iter == baseline.end())
+                continue;
+            numCompared++;
+            const double ratio = r.seconds / iter->second;
+            if (ratio > 1 + tolerance)
+            {
+                fprintf(stderr, "REGRESSION: %-60s %.3f us vs. %.3f us in baseline (%+.1f%%)\n",
+                        r.name.c_str(), r.seconds * 1e6, iter->second * 1e6, (ratio - 1) * 100);
+                numRegressions++;
+            }
+            else if (ratio < 1 - tolerance)
+                fprintf(stderr, "improvement: %-60s %.3f us vs. %.3f us in baseline (%+.1f%%)\n",
+                        r.name.c_str(), r.seconds * 1e6, iter->second * 1e6, (ratio - 1) * 100);
+        }
+        fprintf(stderr, "MathBenchmarks: %d of %d benchmarks compared to '%ls' regressed by more than %.0f%%.\n",
+                (int) numRegressions, (int) numCompared, path.c_str(), tolerance * 100);
+        return numRegressions;
+    }
+
+private:
+    static double TimeBatch(const function<void()>& op, const function<void()>& sync, size_t batchSize)
+    {
+        const auto start = chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < batchSize; i++)
+            op();
+        sync();
+        return chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // [name] -> seconds, from a file written by WriteJson()
+    static map<string, double> ReadBaseline(const wstring& path)
+    {
+        map<string, double> baseline;
+        FILE* f = OpenFile(path, L"r");
+        char line[4096];
+        while (fgets(line, sizeof(line), f))
+        {
+            const char* name = strstr(line, "\"name\": \"");
+            const char* seconds = strstr(line, "\"seconds\": ");
+            if (!name || !seconds)
+                continue;
+            name += strlen("\"name\": \"");
+            const char* nameEnd = strchr(name, '"');
+            if (!nameEnd)
+                continue;
+            baseline[string(name, nameEnd)] = atof(seconds + strlen("\"seconds\": "));
+        }
+        fclose(f);
+        if (baseline.empty())
+            RuntimeError("MathBenchmarks: no results found in baseline '%ls'.", path.c_str());
+        return baseline;
+    }
+
+    const BenchmarkOptions& m_options;
+    vector<BenchmarkResult> m_results;
+};
+
+// -----------------------------------------------------------------------
+// the benchmarks
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+static string BenchmarkName(const char* op, DEVICEID_TYPE deviceId, const string& shape)
+{
+    const string device = deviceId == CPUDEVICE ? string("cpu") : "gpu" + to_string(deviceId);
+    return string(op) + "/" + (sizeof(ElemType) == sizeof(float) ? "float" : "double") + "/" + device + "/" + shape;
+}
+
+static string ShapeString(const vector<size_t>& dims)
+{
+    string s;
+    for (size_t d : dims)
+        s += (s.empty() ? "" : "x") + to_string(d);
+    return s;
+}
+
+template <class ElemType>
+static function<void()> SyncOn(const Matrix<ElemType>& m)
+{
+    return [&m]
+    {
+        m.Get00Element();
+    };
+}
+
+template <class ElemType>
+static void BenchmarkGemm(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    struct GemmShape
+    {
+        size_t m, k, n;
+        bool transposeA;
+    };
+    const GemmShape shapes[] = {
+        {2048, 512, 256, false},  // hidden layer, minibatch of 256 frames
+        {2048, 2048, 256, false}, // hidden layer
+        {2048, 2048, 256, true},  // back-propagation through a hidden layer
+        {9304, 2048, 256, false}, // senone output layer
+        {1024, 1024, 32, false},  // recurrent step with 32 parallel sequences
+    };
+    for (const auto& s : shapes)
+    {
+        Matrix<ElemType> a(s.transposeA ? s.k : s.m, s.transposeA ? s.m : s.k, deviceId);
+        Matrix<ElemType> b(s.k, s.n, deviceId);
+        Matrix<ElemType> c(s.m, s.n, deviceId);
+        a.SetUniformRandomValue(-1, 1, 1);
+        b.SetUniformRandomValue(-1, 1, 2);
+        c.SetValue(0);
+        const string shape = ShapeString({s.m, s.k, s.n}) + (s.transposeA ? "/transA" : "");
+        runner.Run(BenchmarkName<ElemType>("gemm", deviceId, shape), 2.0 * s.m * s.k * s.n, (double) sizeof(ElemType) * (s.m * s.k + s.k * s.n + 2 * s.m * s.n),
+                   [&]
+                   {
+                       Matrix<ElemType>::MultiplyAndWeightedAdd(1, a, s.transposeA, b, false, 0, c);
+                   },
+                   SyncOn(c));
+    }
+}
+
+template <class ElemType>
+static void BenchmarkTensorOps(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    const size_t rows = 2048, cols = 1024;
+    const double n = (double) rows * cols, elemSize = sizeof(ElemType);
+    Matrix<ElemType> a(rows, cols, deviceId), b(rows, cols, deviceId), c(rows, cols, deviceId), bias(rows, 1, deviceId), colSum(rows, 1, deviceId);
+    a.SetUniformRandomValue(-1, 1, 1);
+    b.SetUniformRandomValue(-1, 1, 2);
+    bias.SetUniformRandomValue(-1, 1, 3);
+    TensorView<ElemType> ta(a, TensorShape(rows, cols)), tb(b, TensorShape(rows, cols)), tc(c, TensorShape(rows, cols));
+    TensorView<ElemType> tbias(bias, TensorShape(rows, 1)), tcolSum(colSum, TensorShape(rows, 1));
+    const string shape = ShapeString({rows, cols});
+
+    runner.Run(BenchmarkName<ElemType>("tensor-sum", deviceId, shape), n, 3 * n * elemSize, [&]
+               {
+                   tc.AssignSumOf(ta, tb);
+               },
+               SyncOn(c));
+    runner.Run(BenchmarkName<ElemType>("tensor-product", deviceId, shape), n, 3 * n * elemSize, [&]
+               {
+                   tc.AssignElementwiseProductOf(ta, tb);
+               },
+               SyncOn(c));
+    runner.Run(BenchmarkName<ElemType>("tensor-sigmoid", deviceId, shape), 0, 2 * n * elemSize, [&]
+               {
+                   tc.AssignSigmoidOf(ta);
+               },
+               SyncOn(c));
+    runner.Run(BenchmarkName<ElemType>("tensor-bias", deviceId, shape), n, (2 * n + rows) * elemSize, [&]
+               {
+                   tc.AssignSumOf(ta, tbias); // broadcasting along the columns
+               },
+               SyncOn(c));
+    runner.Run(BenchmarkName<ElemType>("tensor-rowsum", deviceId, shape), n, (n + rows) * elemSize, [&]
+               {
+                   tcolSum.AssignCopyOf(ta); // reduction along the columns
+               },
+               SyncOn(colSum));
+}
+
+template <class ElemType>
+static void BenchmarkSoftmax(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    const vector<size_t> shapes[] = {
+        {9304, 256}, // senone posteriors
+        {32000, 64}, // word posteriors of a language model
+    };
+    for (const auto& s : shapes)
+    {
+        const size_t rows = s[0], cols = s[1];
+        const double n = (double) rows * cols, elemSize = sizeof(ElemType);
+        Matrix<ElemType> in(rows, cols, deviceId), out(rows, cols, deviceId);
+        in.SetUniformRandomValue(-5, 5, 1);
+        runner.Run(BenchmarkName<ElemType>("logsoftmax", deviceId, ShapeString(s)), 0, 2 * n * elemSize, [&]
+                   {
+                       out.AssignLogSoftmaxOf(in, true);
+                   },
+                   SyncOn(out));
+        runner.Run(BenchmarkName<ElemType>("softmax", deviceId, ShapeString(s)), 0, 4 * n * elemSize, [&]
+                   {
+                       out.AssignLogSoftmaxOf(in, true).InplaceExp();
+                   },
+                   SyncOn(out));
+    }
+}
+
+// dense weights times a sparse CSC input, as in the first layer of a text model
+template <class ElemType>
+static void BenchmarkSparse(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    const vector<size_t> shapes[] = {
+        {512, 50000, 256, 1},  // one-hot word input (embedding)
+        {512, 50000, 256, 20}, // bag of words
+    };
+    for (const auto& s : shapes)
+    {
+        const size_t m = s[0], vocabSize = s[1], n = s[2], nzPerCol = s[3];
+        vector<CPUSPARSE_INDEX_TYPE> colStarts(n + 1), rowIndices;
+        vector<ElemType> values(n * nzPerCol, 1);
+        srand(1);
+        for (size_t j = 0; j < n; j++)
+        {
+            colStarts[j] = (CPUSPARSE_INDEX_TYPE) rowIndices.size();
+            vector<CPUSPARSE_INDEX_TYPE> rowsOfCol;
+            while (rowsOfCol.size() < nzPerCol)
+            {
+                const auto row = (CPUSPARSE_INDEX_TYPE)(((size_t) rand() * RAND_MAX + rand()) % vocabSize);
+                if (find(rowsOfCol.begin(), rowsOfCol.end(), row) == rowsOfCol.end())
+                    rowsOfCol.push_back(row);
+            }
+            sort(rowsOfCol.begin(), rowsOfCol.end());
+            rowIndices.insert(rowIndices.end(), rowsOfCol.begin(), rowsOfCol.end());
+        }
+        colStarts[n] = (CPUSPARSE_INDEX_TYPE) rowIndices.size();
+
+        Matrix<ElemType> w(m, vocabSize, deviceId), out(m, n, deviceId);
+        Matrix<ElemType> x(vocabSize, n, deviceId, MatrixType::SPARSE, matrixFormatSparseCSC);
+        w.SetUniformRandomValue(-1, 1, 1);
+        x.SetMatrixFromCSCFormat(colStarts.data(), rowIndices.data(), values.data(), values.size(), vocabSize, n);
+        const double nz = (double) values.size();
+        runner.Run(BenchmarkName<ElemType>("dense-x-sparse", deviceId, ShapeString({m, vocabSize, n}) + "/nz" + to_string(nzPerCol)),
+                   2 * m * nz, sizeof(ElemType) * (m * nz + 2.0 * m * n) + nz * (sizeof(ElemType) + sizeof(CPUSPARSE_INDEX_TYPE)),
+                   [&]
+                   {
+                       Matrix<ElemType>::MultiplyAndWeightedAdd(1, w, false, x, false, 0, out);
+                   },
+                   SyncOn(out));
+    }
+}
+
+template <class ElemType>
+static void BenchmarkConvolution(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    typedef ConvolutionEngineFactory<ElemType> ConvFact;
+    struct ConvShape
+    {
+        size_t w, h, c, k, kW, kH, stride, n;
+    };
+    const ConvShape shapes[] = {
+        {224, 224, 3, 64, 7, 7, 2, 16},  // first layer of an image classifier
+        {56, 56, 64, 64, 3, 3, 1, 32},   // 3x3 layers
+        {28, 28, 128, 128, 3, 3, 1, 32},
+    };
+    // cuDNN wants CHW; the legacy engines run HWC
+    const ImageLayoutKind layout = deviceId >= 0 && CuDnnConvolutionEngineFactory<ElemType>::IsSupported(deviceId) ? ImageLayoutKind::CHW : ImageLayoutKind::HWC;
+    auto fact = ConvFact::Create(deviceId, ConvFact::EngineType::Auto, layout);
+    auto eng = fact->CreateConvEngine(deviceId, 0);
+    for (const auto& s : shapes)
+    {
+        const size_t outW = (s.w - 1) / s.stride + 1, outH = (s.h - 1) / s.stride + 1; // with padding
+        auto inT = fact->CreateTensor(s.w, s.h, s.c, s.n);
+        auto filtT = fact->CreateFilter(s.kW, s.kH, s.c, s.k);
+        auto outT = fact->CreateTensor(outW, outH, s.k, s.n);
+        auto convT = fact->CreateConvDescriptor(*inT, *filtT, s.stride, s.stride, true);
+
+        Matrix<ElemType> in(s.w * s.h * s.c, s.n, deviceId), inGrad(s.w * s.h * s.c, s.n, deviceId);
+        Matrix<ElemType> filt(s.k, s.kW * s.kH * s.c, deviceId), filtGrad(s.k, s.kW * s.kH * s.c, deviceId);
+        Matrix<ElemType> out(outW * outH * s.k, s.n, deviceId), outGrad(outW * outH * s.k, s.n, deviceId);
+        Matrix<ElemType> workspace(deviceId);
+        in.SetUniformRandomValue(-1, 1, 1);
+        filt.SetUniformRandomValue(-1, 1, 2);
+        outGrad.SetUniformRandomValue(-1, 1, 3);
+
+        const string shape = ShapeString({s.w, s.h, s.c, s.n}) + "/k" + ShapeString({s.kW, s.kH, s.k}) + "/s" + to_string(s.stride);
+        const double flops = 2.0 * outW * outH * s.k * s.kW * s.kH * s.c * s.n;
+        const double bytes = (double) sizeof(ElemType) * (in.GetNumElements() + filt.GetNumElements() + out.GetNumElements());
+        runner.Run(BenchmarkName<ElemType>("conv-forward", deviceId, shape), flops, bytes, [&]
+                   {
+                       eng->Forward(*inT, in, *filtT, filt, *convT, *outT, out, workspace);
+                   },
+                   SyncOn(out));
+        runner.Run(BenchmarkName<ElemType>("conv-backward-data", deviceId, shape), flops, bytes, [&]
+                   {
+                       inGrad.SetValue(0);
+                       eng->BackwardData(*outT, outGrad, *filtT, filt, *convT, *inT, inGrad, workspace);
+                   },
+                   SyncOn(inGrad));
+        runner.Run(BenchmarkName<ElemType>("conv-backward-filter", deviceId, shape), flops, bytes, [&]
+                   {
+                       filtGrad.SetValue(0);
+                       eng->BackwardFilter(*outT, outGrad, *inT, in, *convT, *filtT, filtGrad, false, workspace);
+                   },
+                   SyncOn(filtGrad));
+    }
+}
+
+// 1-bit SGD gradient quantization of a hidden layer's gradient, into a host buffer (page-locked for the GPU)
+template <class ElemType>
+static void BenchmarkQuantizer(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    const size_t rows = 2048, cols = 2048, numBits = 1;
+    unique_ptr<MemAllocator> allocator(deviceId == CPUDEVICE ? nullptr : new CUDAPageLockedMemAllocator(deviceId));
+    unique_ptr<MatrixQuantizerImpl<ElemType>> quantizer(MatrixQuantizerImpl<ElemType>::Create(deviceId, false /*useAsync*/));
+    Matrix<ElemType> in(rows, cols, deviceId), residual(rows, cols, deviceId), out(rows, cols, deviceId);
+    in.SetUniformRandomValue(-1, 1, 1);
+    residual.SetValue(0);
+    QuantizedMatrix<ElemType> quantized(rows, cols, numBits, CPUDEVICE, allocator.get());
+
+    const string shape = ShapeString({rows, cols}) + "/" + to_string(numBits) + "bit";
+    const double n = (double) rows * cols;
+    runner.Run(BenchmarkName<ElemType>("quantize", deviceId, shape), 0, 3 * n * sizeof(ElemType) + n * numBits / 8, [&]
+               {
+                   quantizer->QuantizeAsync(in, residual, quantized, residual, false);
+               },
+               [&]
+               {
+                   quantizer->WaitQuantizeAsyncDone();
+               });
+    runner.Run(BenchmarkName<ElemType>("unquantize", deviceId, shape), 0, n * sizeof(ElemType) + n * numBits / 8, [&]
+               {
+                   quantizer->UnquantizeAsync(quantized, out, false);
+               },
+               [&]
+               {
+                   quantizer->WaitUnquantizeAsyncDone();
+               });
+}
+
+// copies between host memory (pageable, as most of our buffers) and the GPU
+template <class ElemType>
+static void BenchmarkTransfers(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    const vector<size_t> shapes[] = {
+        {2048, 256},  // a minibatch of features
+        {4096, 4096}, // a large model parameter
+    };
+    for (const auto& s : shapes)
+    {
+        const size_t rows = s[0], cols = s[1];
+        vector<ElemType> host(rows * cols, 1);
+        ElemType* hostCopy = new ElemType[rows * cols];
+        size_t hostCopySize = rows * cols;
+        Matrix<ElemType> m(rows, cols, deviceId);
+        const double bytes = (double) sizeof(ElemType) * rows * cols;
+        runner.Run(BenchmarkName<ElemType>("host-to-device", deviceId, ShapeString(s)), 0, bytes, [&]
+                   {
+                       m.SetValue(rows, cols, deviceId, host.data());
+                   },
+                   SyncOn(m));
+        runner.Run(BenchmarkName<ElemType>("device-to-host", deviceId, ShapeString(s)), 0, bytes, [&]
+                   {
+                       m.CopyToArray(hostCopy, hostCopySize);
+                   },
+                   SyncOn(m));
+        delete[] hostCopy;
+    }
+}
+
+// a group fails as a whole if its setup fails, e.g. without cuDNN or a quantizer for the device
+static void RunGroup(const char* group, DEVICEID_TYPE deviceId, const function<void()>& benchmarks)
+{
+    try
+    {
+        benchmarks();
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "%s benchmarks on device %d skipped: %s\n", group, (int) deviceId, e.what());
+    }
+}
+
+template <class ElemType>
+static void RunBenchmarksOn(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    RunGroup("gemm", deviceId, [&] { BenchmarkGemm<ElemType>(runner, deviceId); });
+    RunGroup("tensor", deviceId, [&] { BenchmarkTensorOps<ElemType>(runner, deviceId); });
+    RunGroup("softmax", deviceId, [&] { BenchmarkSoftmax<ElemType>(runner, deviceId); });
+    RunGroup("sparse", deviceId, [&] { BenchmarkSparse<ElemType>(runner, deviceId); });
+    RunGroup("convolution", deviceId, [&] { BenchmarkConvolution<ElemType>(runner, deviceId); });
+    RunGroup("quantizer", deviceId, [&] { BenchmarkQuantizer<ElemType>(runner, deviceId); });
+    if (deviceId != CPUDEVICE)
+        RunGroup("transfer", deviceId, [&] { BenchmarkTransfers<ElemType>(runner, deviceId); });
+}
+
+static BenchmarkOptions ParseOptions(int argc, wchar_t* argv[])
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        const wstring arg = argv[i];
+        if (i + 1 >= argc)
+            InvalidArgument("MathBenchmarks: option '%ls' needs a value.", arg.c_str());
+        const wstring value = argv[++i];
+        if (arg == L"-json")
+            options.jsonPath = value;
+        else if (arg == L"-baseline")
+            options.baselinePath = value;
+        else if (arg == L"-tolerance")
+            options.tolerance = wcstod(value.c_str(), nullptr);
+        else if (arg == L"-minTime")
+            options.minSeconds = wcstod(value.c_str(), nullptr);
+        else if (arg == L"-filter")
+            options.filter = string(value.begin(), value.end());
+        else if (arg == L"-device")
+        {
+            options.useCPU = value == L"cpu" || value == L"all";
+            options.useGPU = value != L"cpu";
+            if (value != L"cpu" && value != L"gpu" && value != L"all")
+                options.gpuDeviceId = (DEVICEID_TYPE) wcstol(value.c_str(), nullptr, 10);
+        }
+        else
+            InvalidArgument("MathBenchmarks: unknown option '%ls'.", arg.c_str());
+    }
+    return options;
+}
+
+int RunMathBenchmarks(int argc, wchar_t* argv[])
+{
+    const BenchmarkOptions options = ParseOptions(argc, argv);
+    BenchmarkRunner runner(options);
+    vector<DEVICEID_TYPE> devices;
+    if (options.useCPU)
+        devices.push_back(CPUDEVICE);
+    if (options.useGPU)
+    {
+        try
+        {
+            Matrix<float> probe(1, 1, options.gpuDeviceId);
+            devices.push_back(options.gpuDeviceId);
+        }
+        catch (const exception& e)
+        {
+            fprintf(stderr, "MathBenchmarks: no GPU %d, running on the CPU only (%s).\n", (int) options.gpuDeviceId, e.what());
+        }
+    }
+    for (DEVICEID_TYPE deviceId : devices)
+    {
+        RunBenchmarksOn<float>(runner, deviceId);
+        RunBenchmarksOn<double>(runner, deviceId);
+    }
+
+    if (!options.jsonPath.empty())
+        runner.WriteJson(options.jsonPath);
+    if (!options.baselinePath.empty() && runner.CompareToBaseline(options.baselinePath, options.tolerance) > 0)
+        return 1;
+    return 0;
+}
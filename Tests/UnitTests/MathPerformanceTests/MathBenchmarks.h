@@ -0,0 +1,17 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MathBenchmarks.h -- micro-benchmarks of the Math library, with JSON results and comparison against a baseline
+//
+#pragma once
+
+// runs the benchmarks selected by the command line; returns the process exit code (non-zero if a regression was found)
+// Options:
+//   -json <path>        write the results as JSON to 'path'
+//   -baseline <path>    compare against the JSON results of an earlier run, and report every benchmark that got slower
+//   -tolerance <x>      relative slow-down that counts as a regression (default 0.1)
+//   -device <cpu|gpu|all|N>  where to run (default all: the CPU and GPU 0, if present); N selects a GPU
+//   -filter <substring> only run benchmarks whose name contains 'substring', e.g. "gemm/float/gpu"
+//   -minTime <seconds>  minimum time to measure each benchmark (default 0.25)
+int RunMathBenchmarks(int argc, wchar_t* argv[]);
@@ -13,6 +13,7 @@
 #include "Matrix.h"
 #include "CPUMatrix.h"
 #include "Sequences.h"
+#include "MathBenchmarks.h"
 using namespace Microsoft::MSR::CNTK;
 using namespace std;
 
@@ -435,8 +436,13 @@ void MandSTest(int count, int devId)
     delete[] data3;
 }
 
-int wmain()
+// Without arguments, this runs the ad-hoc tests below. Otherwise it runs the benchmark suite, see MathBenchmarks.h, e.g.
+//   MathPerformanceTests -json today.json -baseline yesterday.json
+int wmain(int argc, wchar_t* argv[])
 {
+    if (argc > 1)
+        return RunMathBenchmarks(argc, argv);
+
     ColumnSliceMultAndAddTest<float>(2048, 2048, 256, 0);
 
     TestRnnForwardPropSRP<float>();
@@ -4,6 +4,8 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/Int8WeightMatrix.h"
+#include <omp.h>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -874,6 +876,191 @@ BOOST_FIXTURE_TEST_CASE(CPUColumnElementOperations, RandomSeedFixture)
     BOOST_CHECK(m0.IsEqualTo(m2, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixRowStackedColumns, RandomSeedFixture)
+{
+    // splice each of 4 columns with its left and right neighbor, clamped at the ends
+    DMatrix a = DMatrix::RandomUniform(3, 4, -1, 1, IncrementCounter());
+    const double sourceColumnValues[] = {0, 0, 1, 0, 1, 2, 1, 2, 3, 2, 3, 3};
+    DMatrix sourceColumns(3, 4);
+    sourceColumns.SetValue(3, 4, (double*) sourceColumnValues, matrixFlagNormal);
+
+    DMatrix spliced;
+    spliced.AssignRowStackedColumnsOf(a, sourceColumns);
+    BOOST_CHECK_EQUAL(spliced.GetNumRows(), 9);
+    BOOST_CHECK_EQUAL(spliced.GetNumCols(), 4);
+    for (size_t j = 0; j < 4; j++)
+        for (size_t k = 0; k < 3; k++)
+            for (size_t i = 0; i < 3; i++)
+                BOOST_CHECK_EQUAL(spliced(k * 3 + i, j), a(i, (size_t) sourceColumns(k, j)));
+
+    // the backward pass adds every block back to its source column; here, each column is used three times
+    DMatrix gradient(3, 4);
+    gradient.SetValue(0);
+    DMatrix ones(9, 4);
+    ones.SetValue(1);
+    gradient.AddFromRowStackedColumnsOf(ones, sourceColumns);
+    for (size_t j = 0; j < 4; j++)
+        for (size_t i = 0; i < 3; i++)
+            BOOST_CHECK_EQUAL(gradient(i, j), 3);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixBatchedCRF, RandomSeedFixture)
+{
+    // 2 labels, 2 parallel sequences: sequence 0 has labels (0, 1) at time steps 0..1, sequence 1 has label 1 at time step 0 and a gap after it
+    const size_t L = 2, S = 2;
+    DMatrix pos = DMatrix::RandomUniform(L, 4, -1, 1, IncrementCounter());
+    DMatrix pair = DMatrix::RandomUniform(L, L, -1, 1, IncrementCounter());
+    const double labelValues[] = {1, 0, 0, 1, 0, 1, 0, 0};
+    DMatrix labels(L, 4);
+    labels.SetValue(L, 4, (double*) labelValues, matrixFlagNormal);
+    const double sequenceValues[] = {0, 0, 2, 1, 0, 1};
+    DMatrix sequences(3, 2);
+    sequences.SetValue(3, 2, (double*) sequenceValues, matrixFlagNormal);
+
+    DMatrix alpha, beta, scores;
+    DMatrix::CRFForwardBackward(labels, pos, pair, alpha, beta, scores, sequences, S);
+
+    // sequence 0 by enumerating its 4 label paths; its start symbol is its first label 0
+    double z = 0;
+    for (size_t y0 = 0; y0 < L; y0++)
+        for (size_t y1 = 0; y1 < L; y1++)
+            z += exp(pair(y0, 0) + pos(y0, 0) + pair(y1, y0) + pos(y1, 2));
+    BOOST_CHECK_CLOSE(scores(0, 0), log(z) - (pair(0, 0) + pos(0, 0) + pair(1, 0) + pos(1, 2)), 1e-8);
+
+    // posteriors sum to 1 in every frame and are 0 in the gap
+    for (size_t j = 0; j < 3; j++)
+        BOOST_CHECK_CLOSE(exp(beta(0, j)) + exp(beta(1, j)), 1, 1e-8);
+    BOOST_CHECK_SMALL(exp(beta(0, 3)) + exp(beta(1, 3)), 1e-8);
+
+    // expected and actual transition counts are both 3 in total
+    DMatrix gradient(L, L);
+    gradient.SetValue(0);
+    DMatrix::CRFTransitionGradient(labels, pos, pair, alpha, beta, gradient, sequences, S);
+    BOOST_CHECK_SMALL(gradient.SumOfElements(), 1e-8);
+
+    // Viterbi ends in the last label of each sequence and leaves the gap empty
+    DMatrix backtrace, path;
+    DMatrix::ViterbiDecode(labels, pos, pair, alpha, backtrace, path, sequences, S);
+    BOOST_CHECK_EQUAL(path(0, 0), 1);
+    BOOST_CHECK_EQUAL(path(1, 2), 1);
+    BOOST_CHECK_EQUAL(path(1, 1), 1);
+    BOOST_CHECK_EQUAL(path(0, 3) + path(1, 3), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixClassConditionalSoftmax, RandomSeedFixture)
+{
+    // 5 words in the classes {0, 1} and {2, 3, 4}; the frames are sorted by class:
+    // column 1 with target word 1, column 0 with target word 2, and column 2 with target word 4
+    const size_t hd = 3, V = 5;
+    DMatrix hidden = DMatrix::RandomUniform(hd, 3, -1, 1, IncrementCounter());
+    DMatrix weights = DMatrix::RandomUniform(hd, V, -1, 1, IncrementCounter());
+    const double frameValues[] = {1, 0, 0, 2, 1, 0, 2, 2, 3, 0, 2, 5, 2, 3, 2};
+    DMatrix frames(5, 3);
+    frames.SetValue(5, 3, (double*) frameValues, matrixFlagNormal);
+    const double classValues[] = {0, 1, 1, 3};
+    DMatrix classes(2, 2);
+    classes.SetValue(2, 2, (double*) classValues, matrixFlagNormal);
+
+    DMatrix logSoftmax, targetLogProbs;
+    DMatrix::ClassConditionalLogSoftmax(hidden, weights, frames, 8, logSoftmax, targetLogProbs);
+    BOOST_CHECK_EQUAL(logSoftmax.GetNumCols(), 8);
+    for (size_t j = 0; j < 3; j++)
+    {
+        const size_t col = (size_t) frames(0, j), offset = (size_t) frames(1, j), first = (size_t) frames(2, j), n = (size_t) frames(3, j);
+        DMatrix logits(1, n);
+        DMatrix::MultiplyAndWeightedAdd(1, hidden.ColumnSlice(col, 1), true, weights.ColumnSlice(first, n), false, 0, logits);
+        logits.InplaceLogSoftmax(false);
+        for (size_t k = 0; k < n; k++)
+            BOOST_CHECK_CLOSE(logSoftmax(0, offset + k), logits(0, k), 1e-8);
+        BOOST_CHECK_CLOSE(targetLogProbs(0, j), logits(0, (size_t) frames(4, j)), 1e-8);
+    }
+
+    // the gradient w.r.t. the logits of a frame sums to 0
+    DMatrix gradient(1, 1);
+    gradient.SetValue(2);
+    DMatrix grd;
+    DMatrix::ClassConditionalSoftmaxGradient(logSoftmax, gradient, frames, grd);
+    BOOST_CHECK_SMALL(grd(0, 0) + grd(0, 1), 1e-8);
+    BOOST_CHECK_SMALL(grd(0, 2) + grd(0, 3) + grd(0, 4), 1e-8);
+    BOOST_CHECK_CLOSE(grd(0, 1), 2 * (exp(logSoftmax(0, 1)) - 1), 1e-8);
+
+    // hidden and weight gradients against the products of each frame
+    DMatrix hiddenGradient(hd, 3), expectedHiddenGradient(hd, 3);
+    DMatrix weightGradient(hd, V), expectedWeightGradient(hd, V);
+    hiddenGradient.SetValue(1);
+    expectedHiddenGradient.SetValue(1);
+    weightGradient.SetValue(0);
+    expectedWeightGradient.SetValue(0);
+    DMatrix::AddClassConditionalHiddenGradient(weights, grd, frames, hiddenGradient);
+    DMatrix::AddClassConditionalWeightGradient(hidden, grd, frames, classes, weightGradient);
+    for (size_t j = 0; j < 3; j++)
+    {
+        const size_t col = (size_t) frames(0, j), offset = (size_t) frames(1, j), first = (size_t) frames(2, j), n = (size_t) frames(3, j);
+        for (size_t k = 0; k < n; k++)
+            for (size_t i = 0; i < hd; i++)
+            {
+                expectedHiddenGradient(i, col) += weights(i, first + k) * grd(0, offset + k);
+                expectedWeightGradient(i, first + k) += hidden(i, col) * grd(0, offset + k);
+            }
+    }
+    BOOST_CHECK(hiddenGradient.IsEqualTo(expectedHiddenGradient, 1e-10));
+    BOOST_CHECK(weightGradient.IsEqualTo(expectedWeightGradient, 1e-10));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixDenominatorForwardBackward, RandomSeedFixture)
+{
+    // graph with the arcs 0 -> 0 (pdf 0), 0 -> 1 (pdf 1), 1 -> 1 (pdf 1), start state 0, both states final;
+    // two parallel sequences of 3 and 2 frames
+    const size_t S = 2, T = 3;
+    const double w0 = log(0.3), w1 = log(0.7);
+    const double arcValues[] = {0, 0, 0, w0, 0, 1, 1, w1, 1, 1, 1, 0,  // by destination
+                                0, 0, 0, w0, 0, 1, 1, w1, 1, 1, 1, 0}; // by source
+    DMatrix arcs(4, 6);
+    arcs.SetValue(4, 6, (double*) arcValues, matrixFlagNormal);
+    const double stateValues[] = {0, 0, 0, 0, 1, 2, LZERO, 0, 3, 3, LZERO, 0};
+    DMatrix states(4, 3);
+    states.SetValue(4, 3, (double*) stateValues, matrixFlagNormal);
+    const double sequenceValues[] = {0, 0, 3, 1, 0, 2};
+    DMatrix sequences(3, 2);
+    sequences.SetValue(3, 2, (double*) sequenceValues, matrixFlagNormal);
+    DMatrix logLikelihoods = DMatrix::RandomUniform(2, S * T, -2, 0, IncrementCounter());
+
+    DMatrix alpha, beta, posteriors, logDenominators;
+    DMatrix::DenominatorForwardBackward(logLikelihoods, arcs, states, alpha, beta, posteriors, logDenominators, sequences, S);
+
+    // against the enumeration of all state sequences
+    for (size_t s = 0; s < S; s++)
+    {
+        const size_t len = s == 0 ? 3 : 2;
+        double Z = 0;
+        double expected[2][T] = {};
+        for (size_t path = 0; path < ((size_t) 1 << len); path++)
+        {
+            double score = 1;
+            size_t prev = 0;
+            bool valid = true;
+            for (size_t t = 0; t < len; t++)
+            {
+                const size_t next = (path >> t) & 1;
+                if (prev == 1 && next == 0)
+                    valid = false;
+                score *= (next == 0 ? 0.3 : prev == 0 ? 0.7 : 1.0) * exp(logLikelihoods(next, t * S + s));
+                prev = next;
+            }
+            if (!valid)
+                continue;
+            Z += score;
+            for (size_t t = 0; t < len; t++)
+                expected[(path >> t) & 1][t] += score;
+        }
+        BOOST_CHECK_CLOSE(logDenominators(0, s), log(Z), 1e-8);
+        for (size_t t = 0; t < len; t++)
+            for (size_t pdf = 0; pdf < 2; pdf++)
+                BOOST_CHECK_CLOSE(posteriors(pdf, t * S + s), expected[pdf][t] / Z, 1e-8);
+    }
+    BOOST_CHECK_EQUAL(posteriors(0, 2 * S + 1) + posteriors(1, 2 * S + 1), 0); // gap
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixSeedingFloat, RandomSeedFixture)
 {
     const float low = 0;
@@ -898,6 +1085,335 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixSeedingDouble, RandomSeedFixture)
     BOOST_CHECK(m1.IsEqualTo(m2));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixInt8WeightMultiply, RandomSeedFixture)
+{
+    // 37 columns to exercise the padding of the rows
+    const size_t rows = 24, cols = 37, numSamples = 5;
+    auto w = SMatrix::RandomUniform(rows, cols, -1.0f, 1.0f, IncrementCounter());
+    auto x = SMatrix::RandomUniform(cols, numSamples, -2.0f, 2.0f, IncrementCounter());
+    SMatrix expected(rows, numSamples);
+    SMatrix::MultiplyAndWeightedAdd(1, w, false, x, false, 0, expected);
+
+    Int8WeightMatrix<float> quantized(w.GetArray(), rows, cols);
+    SMatrix actual(rows, numSamples);
+    quantized.Multiply(x.GetArray(), numSamples, actual.GetArray());
+    // each product is off by at most half a quantization step of either factor
+    BOOST_CHECK(actual.IsEqualTo(expected, cols * (2.0f / 127 + 1.0f / 127)));
+
+    // a calibrated input range clips
+    quantized.SetInputMaxAbs(1);
+    SMatrix ones(cols, 1);
+    ones.SetValue(3);
+    SMatrix clipped(rows, 1);
+    quantized.Multiply(ones.GetArray(), 1, clipped.GetArray());
+    ones.SetValue(1);
+    SMatrix expectedClipped(rows, 1);
+    SMatrix::MultiplyAndWeightedAdd(1, w, false, ones, false, 0, expectedClipped);
+    BOOST_CHECK(clipped.IsEqualTo(expectedClipped, cols * 1.0f / 127));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixLayerwiseAdaptiveUpdates, RandomSeedFixture)
+{
+    const size_t rows = 7, cols = 5;
+    const double learnRate = 0.1, trustCoefficient = 0.01;
+    auto w = DMatrix::RandomUniform(rows, cols, -1.0, 1.0, IncrementCounter());
+    auto g = DMatrix::RandomUniform(rows, cols, -100.0, 100.0, IncrementCounter());
+
+    // LARS without momentum moves W by learnRate * trustCoefficient * ||W||, whatever the scale of the gradient
+    DMatrix lars(w);
+    DMatrix larsState;
+    larsState.LarsUpdate(g, lars, learnRate, 0, trustCoefficient);
+    DMatrix delta(w);
+    delta -= lars;
+    BOOST_CHECK_CLOSE(delta.FrobeniusNorm(), learnRate * trustCoefficient * w.FrobeniusNorm(), 1e-6);
+
+    // the first LAMB step has bias-corrected moments g and g^2, hence the direction sign(g) and a change of learnRate * ||W||
+    DMatrix lamb(w);
+    DMatrix lambState;
+    lambState.LambUpdate(g, lamb, learnRate, 0.9, 0.999, 1e-12, 0);
+    DMatrix lambDelta(w);
+    lambDelta -= lamb;
+    BOOST_CHECK_CLOSE(lambDelta.FrobeniusNorm(), learnRate * w.FrobeniusNorm(), 1e-6);
+    for (size_t j = 0; j < cols; j++)
+        for (size_t i = 0; i < rows; i++)
+            BOOST_CHECK(lambDelta(i, j) * g(i, j) > 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixDropout, RandomSeedFixture)
+{
+    const size_t rows = 16, cols = 64;
+    const float dropoutRate = 0.25f;
+    SMatrix ones(rows, cols);
+    ones.SetValue(1);
+
+    // the mask is pre-scaled and drops about the requested share of elements
+    SMatrix mask;
+    mask.AddDropoutOf(ones, 0, dropoutRate, 17, 0);
+    size_t numDropped = 0;
+    for (size_t j = 0; j < cols; j++)
+        for (size_t i = 0; i < rows; i++)
+        {
+            BOOST_CHECK(mask(i, j) == 0 || fabs(mask(i, j) - 1 / (1 - dropoutRate)) < 1e-6);
+            numDropped += mask(i, j) == 0;
+        }
+    BOOST_CHECK(numDropped > rows * cols / 8 && numDropped < rows * cols * 3 / 8);
+
+    // a column slice at its element offset gets the same part of the mask, and adding applies it once more
+    SMatrix slice = ones.ColumnSlice(10, 5);
+    SMatrix sliceMask(slice);
+    sliceMask.AddDropoutOf(slice, 1, dropoutRate, 17, 10 * rows);
+    for (size_t j = 0; j < 5; j++)
+        for (size_t i = 0; i < rows; i++)
+            BOOST_CHECK_CLOSE(sliceMask(i, j), 1 + mask(i, j + 10), 1e-4);
+
+    // a different seed gives a different mask
+    SMatrix otherMask;
+    otherMask.AddDropoutOf(ones, 0, dropoutRate, 18, 0);
+    BOOST_CHECK(!otherMask.IsEqualTo(mask));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSoftmaxCrossEntropy, RandomSeedFixture)
+{
+    const size_t rows = 9, cols = 6;
+    auto prediction = DMatrix::RandomUniform(rows, cols, -5.0, 5.0, IncrementCounter());
+    DMatrix labels(rows, cols);
+    labels.SetValue(0);
+    for (size_t j = 0; j < cols - 1; j++) // (the last column is a gap)
+        labels(j % rows, j) = 1;
+
+    DMatrix logSoftmax;
+    logSoftmax.AssignLogSoftmaxOf(prediction, true);
+    DMatrix stats;
+    DMatrix::SoftmaxCrossEntropy(labels, prediction, stats);
+    for (size_t j = 0; j < cols - 1; j++)
+        BOOST_CHECK_CLOSE(stats(j, 2), -logSoftmax(j % rows, j), 1e-8);
+    BOOST_CHECK_EQUAL(stats(cols - 1, 2), 0);
+
+    // the gradient is softmax - labels, scaled by alpha
+    DMatrix alpha(1, 1);
+    alpha(0, 0) = 2;
+    DMatrix gradient(rows, cols);
+    gradient.SetValue(1);
+    DMatrix::SoftmaxCrossEntropyBackprop(alpha, labels, prediction, stats, gradient);
+    for (size_t j = 0; j < cols; j++)
+        for (size_t i = 0; i < rows; i++)
+            BOOST_CHECK_CLOSE(gradient(i, j), 1 + 2 * (exp(logSoftmax(i, j)) - labels(i, j)), 1e-8);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSoftmaxCrossEntropyOfIndices, RandomSeedFixture)
+{
+    // the same as one-hot labels, with the class indices as a row (-1 for the gap)
+    const size_t rows = 9, cols = 6;
+    auto prediction = DMatrix::RandomUniform(rows, cols, -5.0, 5.0, IncrementCounter());
+    DMatrix oneHot(rows, cols), indices(1, cols);
+    oneHot.SetValue(0);
+    indices.SetValue(-1);
+    for (size_t j = 0; j < cols - 1; j++)
+    {
+        oneHot(j % rows, j) = 1;
+        indices(0, j) = (double) (j % rows);
+    }
+
+    DMatrix stats, statsOfIndices;
+    DMatrix::SoftmaxCrossEntropy(oneHot, prediction, stats);
+    DMatrix::SoftmaxCrossEntropy(indices, prediction, statsOfIndices);
+    BOOST_CHECK(statsOfIndices.IsEqualTo(stats, 1e-12));
+
+    DMatrix alpha(1, 1);
+    alpha(0, 0) = 2;
+    DMatrix gradient(rows, cols), gradientOfIndices(rows, cols);
+    gradient.SetValue(1);
+    gradientOfIndices.SetValue(1);
+    DMatrix::SoftmaxCrossEntropyBackprop(alpha, oneHot, prediction, stats, gradient);
+    DMatrix::SoftmaxCrossEntropyBackprop(alpha, indices, prediction, stats, gradientOfIndices);
+    BOOST_CHECK(gradientOfIndices.IsEqualTo(gradient, 1e-12));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixHierarchicalSoftmax, RandomSeedFixture)
+{
+    // a tree of 3 classes: the root (weights column 0) branches to class 0 (+) and node 1 (-), which branches to classes 1 (+) and 2 (-)
+    const size_t hiddenDim = 5, numClasses = 3, depth = 2;
+    DMatrix paths(2 * depth, numClasses);
+    const double pathValues[] = {0, -1, +1, 0, /**/ 0, 1, -1, +1, /**/ 0, 1, -1, -1};
+    std::copy(pathValues, pathValues + 12, paths.BufferPointer());
+    auto weights = DMatrix::RandomUniform(hiddenDim, numClasses - 1, -1.0, 1.0, IncrementCounter());
+
+    // every class for the same hidden column, and a gap (-1)
+    const size_t cols = 4;
+    auto column = DMatrix::RandomUniform(hiddenDim, 1, -2.0, 2.0, IncrementCounter());
+    DMatrix hidden(hiddenDim, cols);
+    for (size_t j = 0; j < cols; j++)
+        for (size_t i = 0; i < hiddenDim; i++)
+            hidden(i, j) = column(i, 0);
+    DMatrix labels(1, cols);
+    labels(0, 0) = 0;
+    labels(0, 1) = 1;
+    labels(0, 2) = 2;
+    labels(0, 3) = -1;
+
+    DMatrix frameLosses, pathGradients;
+    DMatrix::HierarchicalSoftmax(labels, hidden, weights, paths, frameLosses, pathGradients);
+    const auto sigmoid = [](double z) { return 1 / (1 + exp(-z)); };
+    double score0 = 0, score1 = 0;
+    for (size_t i = 0; i < hiddenDim; i++)
+    {
+        score0 += weights(i, 0) * hidden(i, 0);
+        score1 += weights(i, 1) * hidden(i, 0);
+    }
+    BOOST_CHECK_CLOSE(frameLosses(0, 0), -log(sigmoid(score0)), 1e-9);
+    BOOST_CHECK_CLOSE(frameLosses(0, 1), -log(sigmoid(-score0) * sigmoid(score1)), 1e-9);
+    BOOST_CHECK_CLOSE(frameLosses(0, 2), -log(sigmoid(-score0) * sigmoid(-score1)), 1e-9);
+    BOOST_CHECK_EQUAL(frameLosses(0, 3), 0);
+    BOOST_CHECK_CLOSE(exp(-frameLosses(0, 0)) + exp(-frameLosses(0, 1)) + exp(-frameLosses(0, 2)), 1, 1e-9);
+
+    // the gradients against central differences of the summed loss
+    DMatrix alpha(1, 1);
+    alpha(0, 0) = 1;
+    DMatrix hiddenGradient(hiddenDim, cols), weightsGradient(hiddenDim, numClasses - 1);
+    hiddenGradient.SetValue(0);
+    weightsGradient.SetValue(0);
+    DMatrix::HierarchicalSoftmaxBackpropHidden(alpha, labels, weights, paths, pathGradients, hiddenGradient);
+    DMatrix::HierarchicalSoftmaxBackpropWeights(alpha, labels, hidden, paths, pathGradients, weightsGradient);
+    const double epsilon = 1e-5;
+    const auto loss = [&]()
+    {
+        DMatrix losses, unused;
+        DMatrix::HierarchicalSoftmax(labels, hidden, weights, paths, losses, unused);
+        return losses.SumOfElements();
+    };
+    for (size_t i = 0; i < hiddenDim; i++)
+    {
+        for (size_t j = 0; j < cols; j++)
+        {
+            const double value = hidden(i, j);
+            hidden(i, j) = value + epsilon;
+            const double lossPlus = loss();
+            hidden(i, j) = value - epsilon;
+            const double lossMinus = loss();
+            hidden(i, j) = value;
+            BOOST_CHECK_SMALL(hiddenGradient(i, j) - (lossPlus - lossMinus) / (2 * epsilon), 1e-7);
+        }
+        for (size_t n = 0; n < numClasses - 1; n++)
+        {
+            const double value = weights(i, n);
+            weights(i, n) = value + epsilon;
+            const double lossPlus = loss();
+            weights(i, n) = value - epsilon;
+            const double lossMinus = loss();
+            weights(i, n) = value;
+            BOOST_CHECK_SMALL(weightsGradient(i, n) - (lossPlus - lossMinus) / (2 * epsilon), 1e-7);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorOpReduction, RandomSeedFixture)
+{
+    const size_t rows = 256, cols = 256; // large enough for the multi-threaded reduction to a scalar
+    auto a = DMatrix::RandomUniform(rows, cols, -3.0, 3.0, IncrementCounter());
+
+    // column-wise max: reduce over the rows
+    DMatrix columnMax(1, cols);
+    columnMax.TensorOp(0, a, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opMax, std::array<size_t, 2>{0, 0},
+                       SmallVector<size_t>{cols}, std::array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{(ptrdiff_t) rows}, SmallVector<ptrdiff_t>{1}},
+                       SmallVector<size_t>{rows}, std::array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{0}});
+    double overallMax = a(0, 0), sumOfAbs = 0;
+    for (size_t j = 0; j < cols; j++)
+    {
+        double expected = a(0, j);
+        for (size_t i = 0; i < rows; i++)
+        {
+            expected = max(expected, a(i, j));
+            sumOfAbs += fabs(a(i, j));
+        }
+        BOOST_CHECK_EQUAL(columnMax(0, j), expected);
+        overallMax = max(overallMax, expected);
+    }
+
+    // everything to a scalar, with the op fused in; alpha = 1/n makes it a mean
+    DMatrix scalar(1, 1);
+    const SmallVector<size_t> noDims;
+    const std::array<SmallVector<ptrdiff_t>, 2> noStrides;
+    scalar.TensorOp(0, a, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opMax, std::array<size_t, 2>{0, 0}, noDims, noStrides,
+                    SmallVector<size_t>{rows * cols}, std::array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{0}});
+    BOOST_CHECK_EQUAL(scalar(0, 0), overallMax);
+    scalar.TensorOp(0, a, 1.0 / (rows * cols), ElementWiseOperator::opAbs, ElementWiseOperator::opSum, std::array<size_t, 2>{0, 0}, noDims, noStrides,
+                    SmallVector<size_t>{rows * cols}, std::array<SmallVector<ptrdiff_t>, 2>{SmallVector<ptrdiff_t>{1}, SmallVector<ptrdiff_t>{0}});
+    BOOST_CHECK_CLOSE(scalar(0, 0), sumOfAbs / (rows * cols), 1e-8);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixVectorizedFunctions, RandomSeedFixture)
+{
+    const size_t rows = 67, cols = 13; // not a multiple of the vector length
+    auto a = SMatrix::RandomUniform(rows, cols, -20.0f, 20.0f, IncrementCounter());
+    auto b = SMatrix::RandomUniform(rows, cols, 1e-3f, 50.0f, IncrementCounter());
+    SMatrix c(rows, cols);
+
+    // the vectorized kernels, if the CPU has them, are approximations to within a few ulp
+    c.AssignExpOf(a);
+    foreach_coord (i, j, c)
+        BOOST_CHECK_CLOSE(c(i, j), exp(a(i, j)), 1e-4);
+    c.AssignTanhOf(a);
+    foreach_coord (i, j, c)
+        BOOST_CHECK_CLOSE(c(i, j), tanh(a(i, j)), 1e-4);
+    c.AssignSigmoidOf(a);
+    foreach_coord (i, j, c)
+        BOOST_CHECK_CLOSE(c(i, j), 1 / (1 + exp(-a(i, j))), 1e-4);
+    c.AssignLogOf(b);
+    foreach_coord (i, j, c)
+        BOOST_CHECK_CLOSE(c(i, j), log(b(i, j)), 1e-4);
+
+    // in-place, and with beta = 1
+    SMatrix d(rows, cols);
+    d.SetValue(a);
+    d.AddElementProductOf(a, b);
+    foreach_coord (i, j, d)
+        BOOST_CHECK_CLOSE(d(i, j), a(i, j) + a(i, j) * b(i, j), 1e-4);
+    d.AssignElementProductOf(d, b);
+    foreach_coord (i, j, d)
+        BOOST_CHECK_CLOSE(d(i, j), (a(i, j) + a(i, j) * b(i, j)) * b(i, j), 1e-4);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixRandomFillsIndependentOfThreads, RandomSeedFixture)
+{
+    const size_t rows = 256, cols = 128;
+    const unsigned long seed = IncrementCounter();
+    const int numThreads = omp_get_max_threads();
+
+    SMatrix u1(rows, cols), u2(rows, cols), g1(rows, cols), g2(rows, cols);
+    omp_set_num_threads(1);
+    u1.SetUniformRandomValue(-1, 1, seed);
+    g1.SetGaussianRandomValue(0, 1, seed);
+    omp_set_num_threads(max(numThreads, 4));
+    u2.SetUniformRandomValue(-1, 1, seed);
+    g2.SetGaussianRandomValue(0, 1, seed);
+    omp_set_num_threads(numThreads);
+    BOOST_CHECK(u1.IsEqualTo(u2, 0));
+    BOOST_CHECK(g1.IsEqualTo(g2, 0));
+
+    // moments, and a mask that is the one dropout uses
+    double sum = 0, sumOfSquares = 0;
+    foreach_coord (i, j, g1)
+    {
+        sum += g1(i, j);
+        sumOfSquares += g1(i, j) * g1(i, j);
+    }
+    const double n = (double) (rows * cols);
+    BOOST_CHECK_SMALL(sum / n, 0.03);
+    BOOST_CHECK_CLOSE(sumOfSquares / n, 1.0, 3);
+
+    SMatrix mask(rows, cols), ones(rows, cols), dropped(rows, cols);
+    mask.SetUniformRandomMask(0.25f, 2, seed);
+    ones.SetValue(1);
+    dropped.AddDropoutOf(ones, 0, 0.5f, seed, 0);
+    size_t numMasked = 0;
+    foreach_coord (i, j, mask)
+        numMasked += mask(i, j) == 0;
+    BOOST_CHECK_CLOSE(numMasked / n, 0.25, 5);
+
+    mask.SetUniformRandomMask(0.5f, 2, seed);
+    BOOST_CHECK(mask.IsEqualTo(dropped, 0));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
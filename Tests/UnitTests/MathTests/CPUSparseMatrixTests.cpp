@@ -59,6 +59,112 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixCopyColumnSliceToDense, RandomSeedFixture
     BOOST_CHECK(dm1.IsEqualTo(dm2, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndWeightedAdd, RandomSeedFixture)
+{
+    const size_t m = 30;
+    const size_t k = 40;
+    const size_t n = 20;
+    const double alpha = 0.5;
+    const double beta = 2;
+
+    // a sparse k x (n + 5) matrix with about 20% nonzeros, and its dense copy; the products use an n-column slice
+    DenseMatrix dense(k, n + 5);
+    dense.SetUniformRandomValue(-1, 1, IncrementCounter());
+    SparseMatrix sparse(MatrixFormat::matrixFormatSparseCSC, k, n + 5, 0);
+    foreach_coord (row, col, dense)
+    {
+        if (dense(row, col) < -0.6)
+            sparse.SetValue(row, col, dense(row, col));
+        else
+            dense(row, col) = 0;
+    }
+    const SparseMatrix sparseSlice = sparse.ColumnSlice(2, n);
+    const DenseMatrix denseSlice = dense.ColumnSlice(2, n);
+
+    DenseMatrix lhs(m, k), lhsT(k, m), lhsB(m, n), rhsT(n, m);
+    lhs.SetUniformRandomValue(-1, 1, IncrementCounter());
+    lhsT.SetUniformRandomValue(-1, 1, IncrementCounter());
+    lhsB.SetUniformRandomValue(-1, 1, IncrementCounter());
+    rhsT.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    // dense * sparse, dense^T * sparse, dense * sparse^T
+    DenseMatrix c0(m, n), c1(m, n);
+    c0.SetUniformRandomValue(-1, 1, IncrementCounter());
+    c1.SetValue(c0);
+    CPUMatrix<double>::MultiplyAndWeightedAdd(alpha, lhs, false, denseSlice, false, beta, c0);
+    SparseMatrix::MultiplyAndWeightedAdd(alpha, lhs, false, sparseSlice, false, beta, c1);
+    BOOST_CHECK(c0.IsEqualTo(c1, c_epsilonFloatE4));
+
+    CPUMatrix<double>::MultiplyAndWeightedAdd(alpha, lhsT, true, denseSlice, false, beta, c0);
+    SparseMatrix::MultiplyAndWeightedAdd(alpha, lhsT, true, sparseSlice, false, beta, c1);
+    BOOST_CHECK(c0.IsEqualTo(c1, c_epsilonFloatE4));
+
+    DenseMatrix d0(m, k), d1(m, k);
+    CPUMatrix<double>::MultiplyAndWeightedAdd(alpha, lhsB, false, denseSlice, true, 0, d0);
+    SparseMatrix::MultiplyAndWeightedAdd(alpha, lhsB, false, sparseSlice, true, 0, d1);
+    BOOST_CHECK(d0.IsEqualTo(d1, c_epsilonFloatE4));
+
+    // sparse * dense, sparse^T * dense^T
+    DenseMatrix e0(k, m), e1(k, m);
+    CPUMatrix<double>::MultiplyAndWeightedAdd(alpha, denseSlice, false, rhsT, false, 0, e0);
+    SparseMatrix::MultiplyAndWeightedAdd(alpha, sparseSlice, false, rhsT, false, 0, e1);
+    BOOST_CHECK(e0.IsEqualTo(e1, c_epsilonFloatE4));
+
+    DenseMatrix f0(n, m), f1(n, m);
+    CPUMatrix<double>::MultiplyAndWeightedAdd(alpha, denseSlice, true, lhs, true, 0, f0);
+    SparseMatrix::MultiplyAndWeightedAdd(alpha, sparseSlice, true, lhs, true, 0, f1);
+    BOOST_CHECK(f0.IsEqualTo(f1, c_epsilonFloatE4));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixBlockSparseRow, RandomSeedFixture)
+{
+    // dimensions that are not multiples of the block dimensions, to cover the padded edge blocks
+    const size_t m = 30;
+    const size_t k = 22;
+    const size_t n = 7;
+    for (size_t blockDim : {4, 5, 8})
+    {
+        // a dense matrix pruned to blocks: every third block is kept
+        DenseMatrix dense(m, k);
+        dense.SetUniformRandomValue(-1, 1, IncrementCounter());
+        foreach_coord (row, col, dense)
+        {
+            if (((row / blockDim) + 2 * (col / blockDim)) % 3 != 0)
+                dense(row, col) = 0;
+        }
+        SparseMatrix bsr(MatrixFormat::matrixFormatSparseBSR);
+        bsr.SetBSRFromDense(dense.GetArray(), m, k, blockDim);
+        BOOST_CHECK_EQUAL(bsr.GetBSRBlockDim(), blockDim);
+        BOOST_CHECK(bsr.GetNumBSRBlocks() < ((m + blockDim - 1) / blockDim) * ((k + blockDim - 1) / blockDim));
+        BOOST_CHECK(dense.IsEqualTo(bsr.CopyColumnSliceToDense(0, k), c_epsilonFloatE4));
+
+        DenseMatrix rhs(k, n), rhsT(n, k), rhsForTranspose(m, n);
+        rhs.SetUniformRandomValue(-1, 1, IncrementCounter());
+        rhsT.SetUniformRandomValue(-1, 1, IncrementCounter());
+        rhsForTranspose.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+        DenseMatrix c0(m, n), c1(m, n);
+        c0.SetUniformRandomValue(-1, 1, IncrementCounter());
+        c1.SetValue(c0);
+        CPUMatrix<double>::MultiplyAndWeightedAdd(0.5, dense, false, rhs, false, 2, c0);
+        SparseMatrix::MultiplyAndWeightedAdd(0.5, bsr, false, rhs, false, 2, c1);
+        BOOST_CHECK(c0.IsEqualTo(c1, c_epsilonFloatE4));
+
+        CPUMatrix<double>::MultiplyAndWeightedAdd(1, dense, false, rhsT, true, 0, c0);
+        SparseMatrix::MultiplyAndWeightedAdd(1, bsr, false, rhsT, true, 0, c1);
+        BOOST_CHECK(c0.IsEqualTo(c1, c_epsilonFloatE4));
+
+        DenseMatrix d0(k, n), d1(k, n);
+        CPUMatrix<double>::MultiplyAndWeightedAdd(1, dense, true, rhsForTranspose, false, 0, d0);
+        SparseMatrix::MultiplyAndWeightedAdd(1, bsr, true, rhsForTranspose, false, 0, d1);
+        BOOST_CHECK(d0.IsEqualTo(d1, c_epsilonFloatE4));
+
+        // deep copy
+        SparseMatrix copy(bsr);
+        BOOST_CHECK(dense.IsEqualTo(copy.CopyColumnSliceToDense(0, k), c_epsilonFloatE4));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -535,6 +535,280 @@ BOOST_AUTO_TEST_CASE(AvgPoolBackward)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ConvolutionForwardWinogradMatchesLegacy)
+{
+    int n = 3;
+    int cmapIn = 5;
+    int kW = 3;
+    int kH = 3;
+    int cmapOut = 4;
+    int deviceId = -1;
+
+    // odd and even image sizes, to cover partial output tiles
+    for (int inW : {7, 8})
+    {
+        int inH = inW - 2;
+        for (bool pad : {false, true})
+        {
+            int outW = GetNumOut(inW, kW, 1, pad);
+            int outH = GetNumOut(inH, kH, 1, pad);
+
+            auto legacyFact = ConvFact::Create(deviceId, ConvFact::EngineType::Legacy, ImageLayoutKind::HWC);
+            auto winogradFact = ConvFact::Create(deviceId, ConvFact::EngineType::Winograd, ImageLayoutKind::HWC);
+            auto legacyEng = legacyFact->CreateConvEngine(deviceId, 0);
+            // (2 samples per sub-batch, to cover sub-batching)
+            auto winogradEng = winogradFact->CreateConvEngine(deviceId, 2);
+            auto inT = legacyFact->CreateTensor(inW, inH, cmapIn, n);
+            auto filtT = legacyFact->CreateFilter(kW, kH, cmapIn, cmapOut);
+            auto outT = legacyFact->CreateTensor(outW, outH, cmapOut, n);
+            auto convT = legacyFact->CreateConvDescriptor(*inT, *filtT, 1, 1, pad);
+
+            SingleMatrix in = SingleMatrix::RandomUniform(inW * inH * cmapIn, n, -1.0f, 1.0f, 1, deviceId);
+            SingleMatrix filt = SingleMatrix::RandomUniform(cmapOut, kW * kH * cmapIn, -1.0f, 1.0f, 2, deviceId);
+
+            SingleMatrix expected(outW * outH * cmapOut, n, deviceId);
+            SingleMatrix out(outW * outH * cmapOut, n, deviceId);
+            SingleMatrix temp(deviceId);
+            legacyEng->Forward(*inT, in, *filtT, filt, *convT, *outT, expected, temp);
+            winogradEng->Forward(*inT, in, *filtT, filt, *convT, *outT, out, temp);
+
+            BOOST_CHECK_MESSAGE(out.IsEqualTo(expected, 1e-4f), "Winograd convolution output differs from im2col.");
+        }
+    }
+}
+
+// HWC: c fastest, then h, then w; CHW: w fastest, then h, then c. HWC filters are stored (c, w, h) with h fastest.
+static vec HWCToCHW(const vec& hwc, int w, int h, int c, int n, bool isFilter)
+{
+    vec chw(hwc.size());
+    for (int s = 0; s < n; s++)
+        for (int ch = 0; ch < c; ch++)
+            for (int row = 0; row < h; row++)
+                for (int col = 0; col < w; col++)
+                {
+                    int from = isFilter ? s + n * (ch * w * h + row + col * h) : s * w * h * c + ch + c * (row + h * col);
+                    int to = isFilter ? s + n * (col + w * (row + h * ch)) : s * w * h * c + col + w * (row + h * ch);
+                    chw[to] = hwc[from];
+                }
+    return chw;
+}
+
+BOOST_AUTO_TEST_CASE(ConvolutionForwardCHWMatchesHWC)
+{
+    int n = 2;
+    int cmapIn = 3;
+    int inW = 7;
+    int inH = 6;
+    int kW = 3;
+    int kH = 3;
+    int cmapOut = 4;
+    int deviceId = -1;
+
+    // stride 1 takes the Winograd path of the Auto engine, stride 2 im2col
+    for (int stride : {1, 2})
+    {
+        for (bool pad : {false, true})
+        {
+            int outW = GetNumOut(inW, kW, stride, pad);
+            int outH = GetNumOut(inH, kH, stride, pad);
+
+            vec inBuf(inW * inH * cmapIn * n);
+            vec filtBuf(kW * kH * cmapIn * cmapOut);
+            int seed = 0;
+            std::generate(inBuf.begin(), inBuf.end(), [&seed] { return (float) (seed++ * 7 % 11) - 5; });
+            std::generate(filtBuf.begin(), filtBuf.end(), [&seed] { return (float) (seed++ * 5 % 7) - 3; });
+
+            auto hwcFact = ConvFact::Create(deviceId, ConvFact::EngineType::Legacy, ImageLayoutKind::HWC);
+            auto hwcEng = hwcFact->CreateConvEngine(deviceId, 0);
+            auto inT = hwcFact->CreateTensor(inW, inH, cmapIn, n);
+            auto filtT = hwcFact->CreateFilter(kW, kH, cmapIn, cmapOut);
+            auto outT = hwcFact->CreateTensor(outW, outH, cmapOut, n);
+            auto convT = hwcFact->CreateConvDescriptor(*inT, *filtT, stride, stride, pad);
+
+            SingleMatrix in(inW * inH * cmapIn, n, inBuf.data(), matrixFlagNormal, deviceId);
+            SingleMatrix filt(cmapOut, kW * kH * cmapIn, filtBuf.data(), matrixFlagNormal, deviceId);
+            SingleMatrix out(outW * outH * cmapOut, n, deviceId);
+            SingleMatrix temp(deviceId);
+            hwcEng->Forward(*inT, in, *filtT, filt, *convT, *outT, out, temp);
+            vec outBuf(out.GetNumElements());
+            out.CopySection(out.GetNumRows(), out.GetNumCols(), outBuf.data(), out.GetNumRows());
+            SingleMatrix expected(outW * outH * cmapOut, n, HWCToCHW(outBuf, outW, outH, cmapOut, n, false).data(), matrixFlagNormal, deviceId);
+
+            SingleMatrix inCHW(inW * inH * cmapIn, n, HWCToCHW(inBuf, inW, inH, cmapIn, n, false).data(), matrixFlagNormal, deviceId);
+            SingleMatrix filtCHW(cmapOut, kW * kH * cmapIn, HWCToCHW(filtBuf, kW, kH, cmapIn, cmapOut, true).data(), matrixFlagNormal, deviceId);
+            for (auto engType : {ConvFact::EngineType::Legacy, ConvFact::EngineType::Auto})
+            {
+                auto chwFact = ConvFact::Create(deviceId, engType, ImageLayoutKind::CHW);
+                auto chwEng = chwFact->CreateConvEngine(deviceId, 0);
+                SingleMatrix outCHW(outW * outH * cmapOut, n, deviceId);
+                chwEng->Forward(*inT, inCHW, *filtT, filtCHW, *convT, *outT, outCHW, temp);
+                BOOST_CHECK_MESSAGE(outCHW.IsEqualTo(expected, 1e-3f), "CHW convolution output differs from HWC.");
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ConvolutionForwardBiasActivationCPU)
+{
+    int n = 3;
+    int cmapIn = 3;
+    int inW = 7;
+    int inH = 6;
+    int kW = 3;
+    int kH = 3;
+    int cmapOut = 4;
+    int deviceId = -1;
+
+    // stride 1 takes the Winograd path of the Auto engine, stride 2 im2col; 2 samples per sub-batch
+    for (auto layout : {ImageLayoutKind::HWC, ImageLayoutKind::CHW})
+    {
+        for (auto engType : {ConvFact::EngineType::Legacy, ConvFact::EngineType::Auto})
+        {
+            for (int stride : {1, 2})
+            {
+                for (bool relu : {false, true})
+                {
+                    int outW = GetNumOut(inW, kW, stride, true);
+                    int outH = GetNumOut(inH, kH, stride, true);
+
+                    auto fact = ConvFact::Create(deviceId, engType, layout);
+                    auto eng = fact->CreateConvEngine(deviceId, 2);
+                    auto inT = fact->CreateTensor(inW, inH, cmapIn, n);
+                    auto filtT = fact->CreateFilter(kW, kH, cmapIn, cmapOut);
+                    auto outT = fact->CreateTensor(outW, outH, cmapOut, n);
+                    auto biasT = fact->CreateTensor(1, 1, cmapOut, 1);
+                    auto convT = fact->CreateConvDescriptor(*inT, *filtT, stride, stride, true);
+
+                    SingleMatrix in = SingleMatrix::RandomUniform(inW * inH * cmapIn, n, -1.0f, 1.0f, 1, deviceId);
+                    SingleMatrix filt = SingleMatrix::RandomUniform(cmapOut, kW * kH * cmapIn, -1.0f, 1.0f, 2, deviceId);
+                    SingleMatrix bias = SingleMatrix::RandomUniform(cmapOut, 1, -1.0f, 1.0f, 3, deviceId);
+
+                    SingleMatrix conv(outW * outH * cmapOut, n, deviceId);
+                    SingleMatrix expected(outW * outH * cmapOut, n, deviceId);
+                    SingleMatrix out(outW * outH * cmapOut, n, deviceId);
+                    SingleMatrix temp(deviceId);
+                    eng->Forward(*inT, in, *filtT, filt, *convT, *outT, conv, temp);
+                    eng->AddBias(*outT, conv, *biasT, bias, expected);
+                    if (relu)
+                        expected.InplaceTruncateBottom(0);
+                    eng->ForwardBiasActivation(*inT, in, *filtT, filt, *convT, *biasT, bias, relu, *outT, out, temp);
+
+                    BOOST_CHECK_MESSAGE(out.IsEqualTo(expected, 1e-4f), "Convolution with bias and activation differs from its separate steps.");
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MaxPoolWithIndicesMatchesMaxPoolCPU)
+{
+    int n = 3;
+    int cmap = 4;
+    int inW = 9;
+    int inH = 7;
+    int kW = 3;
+    int kH = 3;
+    int sW = 2;
+    int sH = 2;
+    int outW = GetNumOut(inW, kW, sW, false);
+    int outH = GetNumOut(inH, kH, sH, false);
+    int deviceId = -1;
+
+    for (auto layout : {ImageLayoutKind::HWC, ImageLayoutKind::CHW})
+    {
+        auto fact = ConvFact::Create(deviceId, ConvFact::EngineType::Legacy, layout);
+        auto eng = fact->CreatePoolEngine(deviceId);
+        auto inT = fact->CreateTensor(inW, inH, cmap, n);
+        auto outT = fact->CreateTensor(outW, outH, cmap, n);
+        auto poolT = fact->CreatePoolDescriptor(PoolingDescriptor::PoolKind::Max, kW, kH, sW, sH, 0, 0);
+        BOOST_REQUIRE(eng->SupportsMaxIndices());
+
+        // (random values have no ties within a window, where the two backward passes would differ)
+        SingleMatrix in = SingleMatrix::RandomUniform(inW * inH * cmap, n, -1.0f, 1.0f, 1, deviceId);
+        SingleMatrix srcGrad = SingleMatrix::RandomUniform(outW * outH * cmap, n, -1.0f, 1.0f, 2, deviceId);
+
+        SingleMatrix expected(outW * outH * cmap, n, deviceId);
+        eng->Forward(*inT, in, *poolT, *outT, expected);
+        SingleMatrix out(outW * outH * cmap, n, deviceId);
+        std::vector<unsigned char> indices(out.GetNumElements() * PoolingEngine<float>::MaxIndexBytes(*poolT));
+        eng->ForwardMaxWithIndices(*inT, in, *poolT, *outT, out, indices.data());
+        BOOST_CHECK_MESSAGE(out.IsEqualTo(expected), "Max pooling with indices differs from max pooling.");
+
+        SingleMatrix expectedGrad(inW * inH * cmap, n, deviceId);
+        expectedGrad.SetValue(1);
+        eng->Backward(*outT, expected, srcGrad, *poolT, *inT, in, expectedGrad);
+        SingleMatrix grad(inW * inH * cmap, n, deviceId);
+        grad.SetValue(1);
+        eng->BackwardMaxFromIndices(*outT, srcGrad, *poolT, *inT, indices.data(), grad);
+        BOOST_CHECK_MESSAGE(grad.IsEqualTo(expectedGrad, 1e-5f), "Max pooling gradient from indices differs from the max pooling gradient.");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BatchNormalizationSpatialCPU)
+{
+    int n = 4;
+    int cmap = 2;
+    int inW = 3;
+    int inH = 2;
+    int deviceId = -1;
+    int pixels = inW * inH;
+
+    auto fact = ConvFact::Create(deviceId, ConvFact::EngineType::Auto, ImageLayoutKind::CHW);
+    auto eng = fact->CreateConvEngine(deviceId, 0);
+    auto inT = fact->CreateTensor(inW, inH, cmap, n);
+    auto scaleBiasT = fact->CreateTensor(1, 1, cmap, 1);
+
+    vec buf(pixels * cmap * n);
+    int seed = 0;
+    std::generate(buf.begin(), buf.end(), [&seed] { return (float) (seed++ * 7 % 13); });
+    SingleMatrix in(pixels * cmap, n, buf.data(), matrixFlagNormal, deviceId);
+    float s[] = {2.0f, 0.5f};
+    float b[] = {1.0f, -1.0f};
+    SingleMatrix scale(cmap, 1, s, matrixFlagNormal, deviceId);
+    SingleMatrix bias(cmap, 1, b, matrixFlagNormal, deviceId);
+    SingleMatrix runMean = SingleMatrix::Zeros(cmap, 1, deviceId);
+    SingleMatrix runInvStdDev = SingleMatrix::Zeros(cmap, 1, deviceId);
+    SingleMatrix out(pixels * cmap, n, deviceId);
+    SingleMatrix saveMean(deviceId);
+    SingleMatrix saveInvStdDev(deviceId);
+
+    eng->NormalizeBatch(*inT, in, *scaleBiasT, scale, bias, true, 0.5, runMean, runInvStdDev, out, saveMean, saveInvStdDev);
+
+    // per channel (a contiguous block of pixels in CHW), the output has mean bias and standard deviation scale
+    for (int c = 0; c < cmap; c++)
+    {
+        double sum = 0, sumSq = 0, inSum = 0;
+        for (int sample = 0; sample < n; sample++)
+            for (int p = 0; p < pixels; p++)
+            {
+                double y = out(c * pixels + p, sample);
+                sum += y;
+                sumSq += y * y;
+                inSum += in(c * pixels + p, sample);
+            }
+        double mean = sum / (n * pixels);
+        BOOST_CHECK_CLOSE(mean, b[c], 1e-3);
+        BOOST_CHECK_CLOSE(sqrt(sumSq / (n * pixels) - mean * mean), s[c], 1e-1);
+        BOOST_CHECK_CLOSE(saveMean(c, 0), inSum / (n * pixels), 1e-3);
+        BOOST_CHECK_CLOSE(runMean(c, 0), 0.5 * saveMean(c, 0), 1e-3);
+        BOOST_CHECK_CLOSE(runInvStdDev(c, 0), 0.5 * saveInvStdDev(c, 0), 1e-3);
+    }
+
+    // the bias gradient is the sum of the output gradient, and the input gradient of a constant output gradient is 0
+    SingleMatrix srcGrad(pixels * cmap, n, vec(pixels * cmap * n, 1.0f).data(), matrixFlagNormal, deviceId);
+    SingleMatrix grad = SingleMatrix::Zeros(pixels * cmap, n, deviceId);
+    SingleMatrix scaleGrad(deviceId);
+    SingleMatrix biasGrad(deviceId);
+    eng->BackwardNormalizeBatch(*inT, in, srcGrad, grad, *scaleBiasT, scale, true, saveMean, saveInvStdDev, scaleGrad, biasGrad);
+    for (int c = 0; c < cmap; c++)
+    {
+        BOOST_CHECK_CLOSE(biasGrad(c, 0), (float) (n * pixels), 1e-3);
+        BOOST_CHECK_SMALL(scaleGrad(c, 0), 1e-3f);
+    }
+    SingleMatrix zeros = SingleMatrix::Zeros(pixels * cmap, n, deviceId);
+    BOOST_CHECK(grad.IsEqualTo(zeros, 1e-4f));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
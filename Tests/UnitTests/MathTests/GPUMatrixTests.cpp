@@ -6,6 +6,7 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/GPUMatrix.h"
+#include "../../../Source/Math/CPUMatrix.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -501,40 +502,67 @@ BOOST_FIXTURE_TEST_CASE(GPUMatrixColumnElementOperations, RandomSeedFixture)
     BOOST_CHECK(m0.IsEqualTo(m2, c_epsilonFloatE4));
 }
 
-BOOST_FIXTURE_TEST_CASE(GPUMatrixCurandSeedingFloat, RandomSeedFixture)
+BOOST_FIXTURE_TEST_CASE(GPUMatrixRandomSeedingFloat, RandomSeedFixture)
 {
     const float low = 0;
     const float high = 1;
-    const unsigned long seedUsed = 1;
-    const unsigned long seedIgnored = 4711;
+    const unsigned long seed = 1;
 
-    // The current GPUMatrix implementation uses a static RNG.
-
-    GPUMatrix<float>::ResetCurandObject(seedUsed, __FUNCTION__);
-    auto m1 = GPUMatrix<float>::RandomUniform(16, 16, c_deviceIdZero, low, high, seedIgnored);
+    // the seed alone determines the values, which are the same as on the CPU
+    auto m1 = GPUMatrix<float>::RandomUniform(16, 16, c_deviceIdZero, low, high, seed);
+    auto m2 = GPUMatrix<float>::RandomUniform(16, 16, c_deviceIdZero, low, high, seed);
+    BOOST_CHECK(m1.IsEqualTo(m2));
 
-    GPUMatrix<float>::ResetCurandObject(seedUsed, __FUNCTION__);
-    auto m2 = GPUMatrix<float>::RandomUniform(16, 16, c_deviceIdZero, low, high, seedIgnored);
+    auto m3 = GPUMatrix<float>::RandomUniform(16, 16, c_deviceIdZero, low, high, seed + 1);
+    BOOST_CHECK(!m1.IsEqualTo(m3));
 
-    BOOST_CHECK(m1.IsEqualTo(m2));
+    auto c = CPUMatrix<float>::RandomUniform(16, 16, low, high, seed);
+    unique_ptr<float[]> result(m1.CopyToArray());
+    BOOST_CHECK_EQUAL_COLLECTIONS(result.get(), result.get() + 256, c.GetArray(), c.GetArray() + 256);
 }
 
-BOOST_FIXTURE_TEST_CASE(GPUMatrixCurandSeedingDouble, RandomSeedFixture)
+BOOST_FIXTURE_TEST_CASE(GPUMatrixRandomSeedingDouble, RandomSeedFixture)
 {
-    const double low = 0;
-    const double high = 1;
-    const unsigned long seedUsed = 1;
-    const unsigned long seedIgnored = 4711;
-
-    // The current GPUMatrix implementation uses a static RNG.
+    const double mean = 0;
+    const double sigma = 1;
+    const unsigned long seed = 1;
 
-    GPUMatrix<double>::ResetCurandObject(seedUsed, __FUNCTION__);
-    auto m1 = GPUMatrix<double>::RandomUniform(16, 16, c_deviceIdZero, low, high, seedIgnored);
+    auto m1 = GPUMatrix<double>::RandomGaussian(16, 16, c_deviceIdZero, mean, sigma, seed);
+    auto m2 = GPUMatrix<double>::RandomGaussian(16, 16, c_deviceIdZero, mean, sigma, seed);
+    BOOST_CHECK(m1.IsEqualTo(m2));
 
-    GPUMatrix<double>::ResetCurandObject(seedUsed, __FUNCTION__);
-    auto m2 = GPUMatrix<double>::RandomUniform(16, 16, c_deviceIdZero, low, high, seedIgnored);
+    // Gaussians go through log() and cos(), which may round differently on the GPU
+    auto c = CPUMatrix<double>::RandomGaussian(16, 16, mean, sigma, seed);
+    unique_ptr<double[]> result(m1.CopyToArray());
+    for (size_t i = 0; i < 256; i++)
+        BOOST_CHECK_CLOSE(result[i], c.GetArray()[i], 1e-10);
+}
 
-    BOOST_CHECK(m1.IsEqualTo(m2));
+BOOST_FIXTURE_TEST_CASE(GPUMatrixColumnwiseLogSoftmaxTuned, RandomSeedFixture)
+{
+    // every launch configuration the tuner may pick computes the same function; short and tall columns
+    const size_t shapes[][2] = {{3, 1000}, {40, 77}, {1500, 5}};
+    for (const auto& shape : shapes)
+    {
+        auto a = GPUMatrix<float>::RandomUniform(shape[0], shape[1], c_deviceIdZero, -5, 5, IncrementCounter());
+        GPUMatrix<float> untuned(c_deviceIdZero);
+        untuned.AssignLogSoftmaxOf(a, true);
+
+        GPUKernelTuning::SetEnabled(true);
+        GPUMatrix<float> tuned(c_deviceIdZero);
+        tuned.AssignLogSoftmaxOf(a, true); // (tunes)
+        BOOST_CHECK(tuned.IsEqualTo(untuned, c_epsilonFloatE5));
+        tuned.AssignLogSoftmaxOf(a, true); // (cached choice)
+        BOOST_CHECK(tuned.IsEqualTo(untuned, c_epsilonFloatE5));
+        GPUKernelTuning::SetEnabled(false);
+
+        unique_ptr<float[]> values(a.CopyToArray());
+        CPUMatrix<float> c(shape[0], shape[1], values.get(), matrixFlagNormal);
+        c.InplaceLogSoftmax(true);
+        unique_ptr<float[]> result(tuned.CopyToArray());
+        for (size_t i = 0; i < shape[0] * shape[1]; i++)
+            BOOST_CHECK_SMALL(result[i] - c.GetArray()[i], 1e-4f);
+    }
 }
 
 #if 0 // Temporarily disabling
@@ -197,6 +197,94 @@ BOOST_FIXTURE_TEST_CASE(GPUDenseTimesSparse, RandomSeedFixture)
     BOOST_CHECK(twiceTransposeC.IsEqualTo(matrixC, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(GPUDenseTimesOneHotSparse, RandomSeedFixture)
+{
+    // one-hot columns (word ids, with a repeated id) and a column with three non-zeros, as for letter-n-gram inputs
+    const int vocabSize = 50, numCols = 6, hiddenDim = 37;
+    const int colStarts[numCols + 1] = {0, 1, 2, 3, 6, 7, 8};
+    const int rowIndices[8] = {3, 17, 3, 0, 21, 49, 42, 17};
+    const float values[8] = {1, 1, 1, 0.5f, -2, 1, 1, 1};
+
+    GPUSparseMatrix<float> sparseX(matrixFormatSparseCSC, c_deviceIdZero);
+    sparseX.SetMatrixFromCSCFormat(colStarts, rowIndices, values, 8, vocabSize, numCols);
+    BOOST_CHECK(sparseX.HasFewNonZerosPerColumn());
+    const GPUMatrix<float> denseX = sparseX.CopyToDenseMatrix();
+
+    // forward: W * X, and with beta
+    const GPUMatrix<float> w = GPUMatrix<float>::RandomUniform(hiddenDim, vocabSize, c_deviceIdZero, -1, 1, IncrementCounter());
+    GPUMatrix<float> expected(hiddenDim, numCols, c_deviceIdZero);
+    GPUMatrix<float> result(hiddenDim, numCols, c_deviceIdZero);
+    GPUMatrix<float>::MultiplyAndWeightedAdd(1, w, false, denseX, false, 0, expected);
+    GPUSparseMatrix<float>::MultiplyAndWeightedAdd(1, w, false, sparseX, false, 0, result);
+    BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE5));
+
+    GPUMatrix<float>::MultiplyAndWeightedAdd(0.5f, w, false, denseX, false, 2, expected);
+    GPUSparseMatrix<float>::MultiplyAndWeightedAdd(0.5f, w, false, sparseX, false, 2, result);
+    BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE5));
+
+    // gradient: dW += dY * X^T, where the repeated id accumulates
+    const GPUMatrix<float> dY = GPUMatrix<float>::RandomUniform(hiddenDim, numCols, c_deviceIdZero, -1, 1, IncrementCounter());
+    GPUMatrix<float> expectedGrad = GPUMatrix<float>::RandomUniform(hiddenDim, vocabSize, c_deviceIdZero, -1, 1, IncrementCounter());
+    GPUMatrix<float> grad(expectedGrad);
+    GPUMatrix<float>::MultiplyAndWeightedAdd(1, dY, false, denseX, true, 1, expectedGrad);
+    GPUSparseMatrix<float>::MultiplyAndWeightedAdd(1, dY, false, sparseX, true, 1, grad);
+    BOOST_CHECK(grad.IsEqualTo(expectedGrad, c_epsilonFloatE5));
+
+    GPUMatrix<float>::MultiplyAndWeightedAdd(-1, dY, false, denseX, true, 0, expectedGrad);
+    GPUSparseMatrix<float>::MultiplyAndWeightedAdd(-1, dY, false, sparseX, true, 0, grad);
+    BOOST_CHECK(grad.IsEqualTo(expectedGrad, c_epsilonFloatE5));
+}
+
+BOOST_FIXTURE_TEST_CASE(GPUSparseFromCOOFormat, RandomSeedFixture)
+{
+    // the triplets of the CSC matrix above, plus an empty column in the middle and at the end
+    const int vocabSize = 50, numCols = 8;
+    const int colStarts[numCols + 1] = {0, 1, 2, 3, 3, 6, 7, 8, 8};
+    const int colIndices[8] = {0, 1, 2, 4, 4, 4, 5, 6};
+    const int rowIndices[8] = {3, 17, 3, 0, 21, 49, 42, 17};
+    const float values[8] = {1, 1, 1, 0.5f, -2, 1, 1, 1};
+
+    GPUSparseMatrix<float> fromCSC(matrixFormatSparseCSC, c_deviceIdZero);
+    fromCSC.SetMatrixFromCSCFormat(colStarts, rowIndices, values, 8, vocabSize, numCols);
+    GPUSparseMatrix<float> fromCOO(matrixFormatSparseCSC, c_deviceIdZero);
+    fromCOO.SetMatrixFromCOOFormat(colIndices, rowIndices, values, 8, vocabSize, numCols);
+    BOOST_CHECK_EQUAL(fromCOO.GetNumNZElements(), 8);
+    BOOST_CHECK(fromCOO.CopyToDenseMatrix().IsEqualTo(fromCSC.CopyToDenseMatrix(), c_epsilonFloatE5));
+
+    // again, smaller, into the same matrix (reusing the staging buffers): the fifth column alone
+    const int zeros[3] = {0, 0, 0};
+    fromCOO.SetMatrixFromCOOFormat(zeros, rowIndices + 3, values + 3, 3, vocabSize, 1);
+    BOOST_CHECK(fromCOO.IsValid());
+    BOOST_CHECK(fromCOO.CopyToDenseMatrix().IsEqualTo(fromCSC.CopyToDenseMatrix().ColumnSlice(4, 1), c_epsilonFloatE5));
+}
+
+BOOST_FIXTURE_TEST_CASE(GPUSparseBlockColGradientOfReaderInput, RandomSeedFixture)
+{
+    // a large vocabulary, so that the gradient numbers the rows with values (IdentifyRowsWithValues()); the two consumers
+    // of the input share that numbering, and a new minibatch in the same matrix must not
+    const int vocabSize = 1000, numCols = 4, hiddenDim = 5;
+    const int colStarts[numCols + 1] = {0, 1, 3, 4, 5};
+    const int rowIndices[2][5] = {{7, 999, 7, 300, 12}, {1, 2, 3, 4, 998}};
+    const float values[5] = {1, 0.5f, -1, 2, 1};
+
+    GPUSparseMatrix<float> input(matrixFormatSparseCSC, c_deviceIdZero);
+    const GPUMatrix<float> dY = GPUMatrix<float>::RandomUniform(hiddenDim, numCols, c_deviceIdZero, -1, 1, IncrementCounter());
+    for (int minibatch = 0; minibatch < 2; minibatch++)
+    {
+        input.SetMatrixFromCSCFormat(colStarts, rowIndices[minibatch], values, 5, vocabSize, numCols);
+        GPUMatrix<float> expected(hiddenDim, vocabSize, c_deviceIdZero);
+        GPUMatrix<float>::MultiplyAndWeightedAdd(1, dY, false, input.CopyToDenseMatrix(), true, 0, expected);
+        for (int consumer = 0; consumer < 2; consumer++)
+        {
+            GPUSparseMatrix<float> blockGrad(matrixFormatSparseBlockCol, c_deviceIdZero);
+            GPUSparseMatrix<float>::MultiplyAndAdd(1, dY, false, input.ColumnSlice(0, numCols), true, blockGrad);
+            GPUMatrix<float> grad = GPUMatrix<float>::Zeros(hiddenDim, vocabSize, c_deviceIdZero);
+            GPUSparseMatrix<float>::ScaleAndAdd(1, blockGrad, grad);
+            BOOST_CHECK(grad.IsEqualTo(expected, c_epsilonFloatE5));
+        }
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(GPUSparseTimesSparse, RandomSeedFixture)
 {
     GPUSparseMatrix<float> matrixA;
@@ -0,0 +1,89 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Common/Include/Sequences.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Count the heap allocations made by this thread while counting is on. This replaces the global operator new of the
+// test executable; on Windows, allocations made inside Math.dll go through its own CRT and are not seen.
+static std::atomic<size_t> s_numHeapAllocations(0);
+static thread_local bool t_countHeapAllocations = false;
+
+void* operator new(size_t size)
+{
+    if (t_countHeapAllocations)
+        s_numHeapAllocations++;
+    void* p = malloc(size > 0 ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(MBLayoutSuite)
+
+// one minibatch worth of layout work, as done by a reader and a recurrent loop: sequences of varying length with gaps
+// (no checks in here, which would allocate; the number of gap frames is returned instead)
+static size_t SimulateMinibatch(const MBLayoutPtr& pMBLayout, size_t numTimeSteps)
+{
+    const size_t numParallelSequences = 4;
+    pMBLayout->Init(numParallelSequences, numTimeSteps);
+    for (size_t s = 0; s < numParallelSequences; s++)
+    {
+        const size_t length = numTimeSteps - s;
+        pMBLayout->AddSequence(NEW_SEQUENCE_ID, s, 0, length);
+        pMBLayout->AddGap(s, length, numTimeSteps);
+    }
+    pMBLayout->GetColumnsValidityMask(CPUDEVICE);
+
+    SmallVector<size_t> shape;
+    shape.push_back(13);
+    shape.push_back(numParallelSequences);
+    shape.push_back(numTimeSteps);
+    size_t numGaps = 0;
+    for (size_t t = 0; t < numTimeSteps; t++)
+    {
+        const FrameRange fr(pMBLayout, t);
+        const auto slice = TensorSliceWithMBLayoutFor(shape, fr, pMBLayout);
+        if (slice.first[2] != t || slice.second[2] != t + 1)
+            return SIZE_MAX;
+        for (size_t s = 0; s < numParallelSequences; s++)
+            numGaps += pMBLayout->IsGap(fr.Sequence(s)) ? 1 : 0;
+    }
+    return numGaps;
+}
+
+BOOST_AUTO_TEST_CASE(MBLayoutSteadyStateIsAllocationFree)
+{
+    auto pMBLayout = make_shared<MBLayout>();
+    const size_t maxTimeSteps = 20;
+    SimulateMinibatch(pMBLayout, maxTimeSteps); // (allocates the buffers of the largest minibatch)
+
+    s_numHeapAllocations = 0;
+    t_countHeapAllocations = true;
+    size_t numGaps = 0;
+    for (size_t numTimeSteps = maxTimeSteps; numTimeSteps >= 10 && numGaps != SIZE_MAX; numTimeSteps--)
+    {
+        const size_t numGapsOfMinibatch = SimulateMinibatch(pMBLayout, numTimeSteps);
+        numGaps = numGapsOfMinibatch == SIZE_MAX ? SIZE_MAX : numGaps + numGapsOfMinibatch;
+    }
+    t_countHeapAllocations = false;
+
+    BOOST_CHECK_EQUAL(numGaps, 11 * (0 + 1 + 2 + 3));
+    BOOST_CHECK_EQUAL(s_numHeapAllocations.load(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -307,6 +307,38 @@ BOOST_FIXTURE_TEST_CASE(MatrixInnerProductOfMatrices, RandomSeedFixture)
     BOOST_CHECK_EQUAL(217, ip);
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixBatchMultiplyAndWeightedAdd, RandomSeedFixture)
+{
+    // small products (plain loop) and large ones (BLAS), each with a batched a and a shared b, and a shared transposed a and a batched transposed b
+    for (size_t dim : {5, 150})
+    {
+        const size_t batchSize = 4;
+        const size_t m = dim, k = dim + 3, n = dim + 1;
+        SingleMatrix a = SingleMatrix::RandomUniform(m, k * batchSize, -1, 1, IncrementCounter());
+        SingleMatrix b = SingleMatrix::RandomUniform(k, n, -1, 1, IncrementCounter());
+        SingleMatrix c = SingleMatrix::RandomUniform(m, n * batchSize, -1, 1, IncrementCounter());
+        SingleMatrix expected(c); // (deep copy)
+        SingleMatrix::BatchMultiplyAndWeightedAdd(2, a, false, b, false, 0.5f, c, batchSize);
+        for (size_t i = 0; i < batchSize; i++)
+        {
+            SingleMatrix expectedSlice = expected.ColumnSlice(i * n, n);
+            SingleMatrix::MultiplyAndWeightedAdd(2, a.ColumnSlice(i * k, k), false, b, false, 0.5f, expectedSlice);
+        }
+        BOOST_CHECK(c.IsEqualTo(expected, 1e-4f * dim));
+
+        SingleMatrix at = SingleMatrix::RandomUniform(k, m, -1, 1, IncrementCounter());
+        SingleMatrix bt = SingleMatrix::RandomUniform(n, k * batchSize, -1, 1, IncrementCounter());
+        SingleMatrix ct(m, n * batchSize, c.GetDeviceId());
+        SingleMatrix::BatchMultiplyAndWeightedAdd(1, at, true, bt, true, 0, ct, batchSize);
+        for (size_t i = 0; i < batchSize; i++)
+        {
+            SingleMatrix expectedSlice = expected.ColumnSlice(i * n, n);
+            SingleMatrix::Multiply(at, true, bt.ColumnSlice(i * k, k), true, expectedSlice);
+        }
+        BOOST_CHECK(ct.IsEqualTo(expected, 1e-4f * dim));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -37,6 +37,77 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteRead, RandomSeedFixture)
     BOOST_CHECK(matrixCpuCopy.IsEqualTo(matrixCpuRead, c_epsilonFloatE5));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteReadMapped, RandomSeedFixture)
+{
+    CPUMatrix<float> matrixCpu = CPUMatrix<float>::RandomUniform(43, 10, -26.3f, 30.2f, IncrementCounter());
+
+    std::wstring fileNameCpu(L"MCPUAligned.bin");
+    {
+        File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsWrite | fileOptionsAlignedBlocks);
+        fileCpu << matrixCpu << matrixCpu;
+    }
+
+    CPUMatrix<float> matrixCpuRead1, matrixCpuRead2;
+    std::shared_ptr<const char> mapping;
+    {
+        File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsRead | fileOptionsMapped);
+        fileCpu >> matrixCpuRead1 >> matrixCpuRead2;
+        mapping = fileCpu.GetMapping();
+    }
+
+    BOOST_CHECK(mapping != nullptr);
+    BOOST_CHECK(!matrixCpuRead2.OwnBuffer());
+    BOOST_CHECK_EQUAL(0, (matrixCpuRead2.BufferPointer() - (float*) mapping.get()) * sizeof(float) % File::alignedBlockAlignment);
+    BOOST_CHECK(matrixCpu.IsEqualTo(matrixCpuRead1, c_epsilonFloatE5));
+    BOOST_CHECK(matrixCpu.IsEqualTo(matrixCpuRead2, c_epsilonFloatE5));
+
+    // without mapping, aligned blocks are read into the matrix
+    File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsRead);
+    CPUMatrix<float> matrixCpuRead3;
+    fileCpu >> matrixCpuRead3;
+    BOOST_CHECK(matrixCpuRead3.OwnBuffer());
+    BOOST_CHECK(matrixCpu.IsEqualTo(matrixCpuRead3, c_epsilonFloatE5));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteReadBinary, RandomSeedFixture)
+{
+    CPUMatrix<float> matrixCpu = CPUMatrix<float>::RandomUniform(43, 10, -26.3f, 30.2f, IncrementCounter());
+
+    std::wstring fileNameCpu(L"MCPU.bin");
+    {
+        File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsWrite);
+        fileCpu << matrixCpu;
+    }
+
+    CPUMatrix<float> matrixCpuRead;
+    {
+        File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsRead);
+        fileCpu >> matrixCpuRead;
+    }
+    BOOST_CHECK(matrixCpu.IsEqualTo(matrixCpuRead, c_epsilonFloatE5));
+
+    // the elements, written as one block, read the same one by one
+    File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsRead);
+    fileCpu.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+    size_t elsize, numRows, numCols;
+    std::wstring matrixName;
+    int format;
+    fileCpu >> elsize >> matrixName >> format >> numRows >> numCols;
+    BOOST_CHECK_EQUAL(sizeof(float), elsize);
+    BOOST_CHECK_EQUAL(43, numRows);
+    BOOST_CHECK_EQUAL(10, numCols);
+    for (size_t j = 0; j < numCols; j++)
+    {
+        for (size_t i = 0; i < numRows; i++)
+        {
+            float value;
+            fileCpu >> value;
+            BOOST_CHECK_EQUAL(matrixCpu(i, j), value);
+        }
+    }
+    fileCpu.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixFileWriteRead, RandomSeedFixture)
 {
     // Test Matrix in Dense mode
@@ -73,6 +144,32 @@ BOOST_FIXTURE_TEST_CASE(MatrixFileWriteRead, RandomSeedFixture)
     BOOST_CHECK(matrixSparseRead.IsEqualTo(matrixSparseCopy, c_epsilonFloatE5));
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixFileWriteReadCompact, RandomSeedFixture)
+{
+    Matrix<float> matrix = Matrix<float>::RandomUniform(100, 20, -1.0f, 1.0f, IncrementCounter());
+    Matrix<float> matrixSmall = Matrix<float>::RandomUniform(10, 1, -1.0f, 1.0f, IncrementCounter());
+
+    // FP16: relative error 2^-11; 8 bits: half of (max - min) / 255 of the column
+    const FileOptions compactOptions[] = {fileOptionsCompactFP16, fileOptionsCompactInt8};
+    const float tolerances[] = {0.001f, 0.0045f};
+    for (size_t k = 0; k < 2; k++)
+    {
+        std::wstring fileName(L"MCompact.bin");
+        {
+            File file(fileName, fileOptionsBinary | fileOptionsWrite | compactOptions[k]);
+            file << matrix << matrixSmall;
+        }
+        Matrix<float> matrixRead, matrixSmallRead;
+        File file(fileName, fileOptionsBinary | fileOptionsRead);
+        file >> matrixRead >> matrixSmallRead;
+        BOOST_CHECK_EQUAL(100, matrixRead.GetNumRows());
+        BOOST_CHECK_EQUAL(20, matrixRead.GetNumCols());
+        BOOST_CHECK(matrixRead.IsEqualTo(matrix, tolerances[k]));
+        BOOST_CHECK(!matrixRead.IsEqualTo(matrix, c_epsilonFloatE5 / 100));
+        BOOST_CHECK(matrixSmallRead.IsEqualTo(matrixSmall, c_epsilonFloatE5 / 100)); // (small matrices are stored in full)
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(GPUMatrixSuite)
@@ -477,6 +477,31 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrix1BitQuantizeDouble, RandomSeedFixture)
         TestQuantization<'float or double'>('CPU or GPU', 737, 373, -0.5f, +0.5f, 2915, 5);
         */
 
+BOOST_AUTO_TEST_CASE(QuantizedMatrixSelectNumBits)
+{
+    // small matrices are passed through at the full word width
+    BOOST_CHECK_EQUAL(QuantizedMatrix<float>::SelectNumBits(10, 10, 1, 1024), (size_t) 32);
+    BOOST_CHECK_EQUAL(QuantizedMatrix<double>::SelectNumBits(1023, 1, 2, 1024), (size_t) 64);
+    BOOST_CHECK_EQUAL(QuantizedMatrix<float>::SelectNumBits(32, 32, 1, 1024), (size_t) 1);
+    BOOST_CHECK_EQUAL(QuantizedMatrix<float>::SelectNumBits(512, 256, 4, 1024), (size_t) 4);
+    BOOST_CHECK_EQUAL(QuantizedMatrix<float>::SelectNumBits(512, 256, 8, 0), (size_t) 8);
+
+    // the bit width must divide the word
+    BOOST_CHECK_THROW(QuantizedMatrix<float>::SelectNumBits(512, 256, 3, 1024), std::invalid_argument);
+    BOOST_CHECK_THROW(QuantizedMatrix<float>::SelectNumBits(512, 256, 0, 1024), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(QuantizedMatrixQuantizedSize)
+{
+    for (size_t nbits : {1, 2, 4, 8, 16, 32})
+    {
+        QuantizedMatrix<float> quantized(89, 23, nbits, CPUDEVICE);
+        BOOST_CHECK_EQUAL(QuantizedMatrix<float>::QuantizedSize(89, 23, nbits), quantized.GetSize());
+    }
+    // one column of 1-bit values: lower and upper bound, and 100 bits rounded up to four 32-bit words
+    BOOST_CHECK_EQUAL(QuantizedMatrix<float>::QuantizedSize(100, 1, 1), 2 * sizeof(float) + 4 * sizeof(uint32_t));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -6,6 +6,7 @@
 #include "../../../Source/Math/Matrix.h"
 #include "../../../Source/Math/CPUMatrix.h"
 #include "../../../Source/Math/Helpers.h"
+#include "../../../Source/Math/TensorView.h"
 
 #define IDX2C(i, j, ld) (((j) * (ld)) + (i)) // 0 based indexing
 
@@ -1079,6 +1080,108 @@ BOOST_FIXTURE_TEST_CASE(MatrixVectorMax, RandomSeedFixture)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixVectorMaxTopKLarge, RandomSeedFixture)
+{
+    // a vocabulary-sized column with ties, against a stable descending sort
+    const int rows = 5000, cols = 7;
+    std::vector<float> src(rows * cols);
+    for (size_t i = 0; i < src.size(); i++)
+        src[i] = (float) ((i * 7919) % 1009); // (each value several times per column)
+
+    for (int topK : {5, 20, 40})
+    {
+        std::vector<float> expectedIdx(topK * cols), expectedVal(topK * cols);
+        for (int j = 0; j < cols; j++)
+        {
+            std::vector<int> order(rows);
+            for (int i = 0; i < rows; i++)
+                order[i] = i;
+            const float* column = &src[j * rows];
+            std::stable_sort(order.begin(), order.end(), [column](int a, int b) { return column[a] > column[b]; });
+            for (int k = 0; k < topK; k++)
+            {
+                expectedIdx[j * topK + k] = (float) order[k];
+                expectedVal[j * topK + k] = column[order[k]];
+            }
+        }
+
+        for (auto deviceId : {CPUDEVICE, AUTOPLACEMATRIX})
+        {
+            Matrix<float> expIdx(topK, cols, expectedIdx.data(), matrixFlagNormal, deviceId);
+            Matrix<float> expVal(topK, cols, expectedVal.data(), matrixFlagNormal, deviceId);
+
+            Matrix<float> actual(rows, cols, src.data(), matrixFlagNormal, deviceId);
+            Matrix<float> actualIdx(deviceId);
+            Matrix<float> actualVal(deviceId);
+
+            actual.VectorMax(actualIdx, actualVal, true, topK);
+            BOOST_CHECK(actualIdx.IsEqualTo(expIdx));
+            BOOST_CHECK(actualVal.IsEqualTo(expVal));
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixCosDistanceWithShiftNeg, RandomSeedFixture)
+{
+    const int dim = 10, cols = 6;
+    const size_t shift = 2, neg = 4; // (row 4 wraps around)
+
+    // the cosine distance of inputs given as host arrays, and the gradient of sum(cos .* w) w.r.t. a and b
+    auto cosDistance = [&](const double* a, const double* b, DEVICEID_TYPE deviceId, Matrix<double>& cos, Matrix<double>& invNormA, Matrix<double>& invNormB)
+    {
+        Matrix<double> ma(dim, cols, const_cast<double*>(a), matrixFlagNormal, deviceId);
+        Matrix<double> mb(dim, cols, const_cast<double*>(b), matrixFlagNormal, deviceId);
+        invNormA.AssignVectorNorm2Of(ma, true);
+        invNormA.AssignElementInverseOf(invNormA);
+        invNormB.AssignVectorNorm2Of(mb, true);
+        invNormB.AssignElementInverseOf(invNormB);
+        cos.AssignCosDistanceWithShiftNeg(ma, mb, invNormA, invNormB, shift, neg);
+    };
+
+    for (auto deviceId : {CPUDEVICE, AUTOPLACEMATRIX})
+    {
+        Matrix<double> a(dim, cols, deviceId), b(dim, cols, deviceId), w(neg + 1, cols, deviceId);
+        a.SetUniformRandomValue(-1, 1, IncrementCounter());
+        b.SetUniformRandomValue(-1, 1, IncrementCounter());
+        w.SetUniformRandomValue(-1, 1, IncrementCounter());
+        std::unique_ptr<double[]> hostA(a.CopyToArray()), hostB(b.CopyToArray()), hostW(w.CopyToArray());
+
+        Matrix<double> cos(deviceId), invNormA(deviceId), invNormB(deviceId);
+        cosDistance(hostA.get(), hostB.get(), deviceId, cos, invNormA, invNormB);
+
+        // forward: same as the element-wise product of the shifted norms and inner products
+        Matrix<double> norms(deviceId), products(deviceId), expected(deviceId);
+        norms.AssignElementProductOfWithShiftNeg(invNormA, invNormB, shift, neg);
+        products.AssignInnerProductOfWithShiftNeg(a, b, true, shift, neg);
+        expected.AssignElementProductOf(norms, products);
+        BOOST_CHECK(cos.IsEqualTo(expected, 1e-10));
+
+        // backward: against finite differences
+        for (bool wrtB : {false, true})
+        {
+            Matrix<double> gradient(dim, cols, deviceId);
+            gradient.SetValue(0);
+            Matrix<double>::AddCosDistanceWithShiftNegGradient(w, cos, a, b, invNormA, invNormB, shift, neg, wrtB, gradient);
+            std::unique_ptr<double[]> hostGradient(gradient.CopyToArray());
+            std::unique_ptr<double[]> hostCos(cos.CopyToArray());
+
+            const double epsilon = 1e-6;
+            for (int k = 0; k < dim * cols; k++)
+            {
+                std::vector<double> a1(hostA.get(), hostA.get() + dim * cols), b1(hostB.get(), hostB.get() + dim * cols);
+                (wrtB ? b1 : a1)[k] += epsilon;
+                Matrix<double> cos1(deviceId), invNormA1(deviceId), invNormB1(deviceId);
+                cosDistance(a1.data(), b1.data(), deviceId, cos1, invNormA1, invNormB1);
+                std::unique_ptr<double[]> hostCos1(cos1.CopyToArray());
+                double delta = 0;
+                for (size_t i = 0; i < (neg + 1) * cols; i++)
+                    delta += (hostCos1[i] - hostCos[i]) * hostW[i];
+                BOOST_CHECK_SMALL(delta / epsilon - hostGradient[k], 1e-4);
+            }
+        }
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixAssignNumOfDiff, RandomSeedFixture)
 {
     float labels[] = {1.0f, 2.0f, 3.0f};
@@ -1101,6 +1204,177 @@ BOOST_FIXTURE_TEST_CASE(MatrixAssignNumOfDiff, RandomSeedFixture)
         BOOST_CHECK_EQUAL(expectedDiff, actual.Get00Element());
     }
 }
+
+BOOST_FIXTURE_TEST_CASE(MatrixRandomizedSVD, RandomSeedFixture)
+{
+    // a 60 x 40 matrix of rank 5 is reproduced by its 5 leading singular values
+    const size_t m = 60, n = 40, rank = 5;
+    for (auto deviceId : {CPUDEVICE, AUTOPLACEMATRIX})
+    {
+        Matrix<float> P = Matrix<float>::RandomGaussian(m, rank, 0, 1, IncrementCounter(), deviceId);
+        Matrix<float> Q = Matrix<float>::RandomGaussian(rank, n, 0, 1, IncrementCounter(), deviceId);
+        Matrix<float> A(deviceId);
+        Matrix<float>::Multiply(P, false, Q, false, A);
+
+        Matrix<float> S(CPUDEVICE), U(deviceId), VT(deviceId);
+        Matrix<float>::RandomizedSVD(A, rank, 4, 1, IncrementCounter(), S, U, VT);
+        BOOST_CHECK_EQUAL(S.GetNumRows(), rank);
+        BOOST_CHECK_EQUAL(U.GetNumRows(), m);
+        BOOST_CHECK_EQUAL(U.GetNumCols(), rank);
+        BOOST_CHECK_EQUAL(VT.GetNumRows(), rank);
+        BOOST_CHECK_EQUAL(VT.GetNumCols(), n);
+        for (size_t i = 1; i < rank; i++)
+            BOOST_CHECK(S(i - 1, 0) >= S(i, 0));
+
+        S.TransferToDeviceIfNotThere(U.GetDeviceId(), true);
+        U.RowElementMultiplyWith(S.Transpose());
+        Matrix<float> reconstructed(deviceId);
+        Matrix<float>::Multiply(U, false, VT, false, reconstructed);
+        reconstructed -= A;
+        BOOST_CHECK_LT(reconstructed.FrobeniusNorm(), 1e-3 * A.FrobeniusNorm());
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixTransferMonitorStrict, RandomSeedFixture)
+{
+    // operands on different devices are moved implicitly, which strict mode forbids inside a node, but not elsewhere
+    Matrix<float> a = Matrix<float>::Ones(4, 3, CPUDEVICE);
+    Matrix<float> b = Matrix<float>::Ones(4, 3, c_deviceIdZero);
+    const std::wstring owner = L"node";
+    MatrixTransferMonitor::SetMode(MatrixTransferMonitor::Mode::strict);
+    {
+        MatrixTransferMonitor::Scope scope(owner, "forward");
+        BOOST_CHECK_THROW(a += b, std::runtime_error);
+    }
+    Matrix<float> c = Matrix<float>::Ones(4, 3, CPUDEVICE);
+    c += b;
+    MatrixTransferMonitor::Report("of MatrixTransferMonitorStrict");
+    MatrixTransferMonitor::SetMode(MatrixTransferMonitor::Mode::off);
+    BOOST_CHECK_EQUAL(c(0, 0), 2.0f);
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixSetValueFromCompact, RandomSeedFixture)
+{
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        // bytes, scaled and shifted per row
+        const unsigned char pixels[6] = {0, 1, 2, 128, 254, 255};
+        Matrix<float> shift(3, 1, deviceId);
+        shift.SetValue(3, 1, deviceId, std::vector<float>{-1.0f, 0.0f, 1.0f}.data());
+        Matrix<float> m(deviceId);
+        m.SetValueFromCompact(3, 2, deviceId, pixels, compactElementUInt8, 0.5f, &shift);
+        BOOST_CHECK_EQUAL(m(0, 0), -1.0f);
+        BOOST_CHECK_EQUAL(m(2, 0), 2.0f);
+        BOOST_CHECK_EQUAL(m(0, 1), 63.0f);
+        BOOST_CHECK_EQUAL(m(2, 1), 128.5f);
+
+        // half precision: exact for these, including a denormal, and nearest-even rounding otherwise
+        const float values[6] = {0.0f, -2.5f, 65504.0f, 5.9604645e-8f, 1.0f / 3, 1e-3f};
+        std::vector<unsigned short> halves;
+        for (float v : values)
+            halves.push_back(FloatToFloat16(v));
+        BOOST_CHECK_EQUAL(FloatToFloat16(1e6f), 0x7c00);
+        m.SetValueFromCompact(6, 1, deviceId, halves.data(), compactElementFloat16);
+        for (size_t i = 0; i < 4; i++)
+            BOOST_CHECK_EQUAL(m(i, 0), values[i]);
+        BOOST_CHECK_CLOSE(m(4, 0), values[4], 0.05);
+        BOOST_CHECK_CLOSE(m(5, 0), values[5], 0.05);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixClipFrobeniusNorm, RandomSeedFixture)
+{
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        // the norm is 5: scaled down to 2.5, and left as it is for a bound of 10
+        Matrix<float> m(2, 2, deviceId);
+        m.SetValue(2, 2, deviceId, std::vector<float>{3.0f, 0.0f, 0.0f, 4.0f}.data());
+        Matrix<float> norm(deviceId);
+        m.ClipFrobeniusNorm(2.5f, norm);
+        BOOST_CHECK_CLOSE(norm(0, 0), 5.0f, 1e-4);
+        BOOST_CHECK_CLOSE(m(0, 0), 1.5f, 1e-4);
+        BOOST_CHECK_CLOSE(m(1, 1), 2.0f, 1e-4);
+        m.ClipFrobeniusNorm(10.0f, norm);
+        BOOST_CHECK_CLOSE(norm(0, 0), 2.5f, 1e-4);
+        BOOST_CHECK_CLOSE(m(1, 1), 2.0f, 1e-4);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixSoftmaxCrossEntropyOfSparseLabels, RandomSeedFixture)
+{
+    // sparse one-hot labels (the last column empty) give their class indices, and the cross entropy of dense one-hot labels
+    const int rows = 7, cols = 4;
+    const CPUSPARSE_INDEX_TYPE colStarts[cols + 1] = {0, 1, 2, 3, 3};
+    const CPUSPARSE_INDEX_TYPE rowIndices[3] = {6, 0, 6};
+    const float values[3] = {1, 1, 1};
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        Matrix<float> sparseLabels(rows, cols, deviceId, MatrixType::SPARSE, matrixFormatSparseCSC);
+        sparseLabels.SetMatrixFromCSCFormat(colStarts, rowIndices, values, 3, rows, cols);
+        Matrix<float> indices(deviceId);
+        indices.AssignOneHotIndicesOf(sparseLabels);
+        BOOST_CHECK_EQUAL(indices.GetNumRows(), 1);
+        BOOST_CHECK_EQUAL(indices(0, 0), 6.0f);
+        BOOST_CHECK_EQUAL(indices(0, 1), 0.0f);
+        BOOST_CHECK_EQUAL(indices(0, 3), -1.0f);
+
+        std::vector<float> oneHot(rows * cols, 0);
+        for (int j = 0; j < cols; j++)
+            for (int p = colStarts[j]; p < colStarts[j + 1]; p++)
+                oneHot[j * rows + rowIndices[p]] = values[p];
+        Matrix<float> denseLabels(deviceId);
+        denseLabels.SetValue(rows, cols, deviceId, oneHot.data());
+        const auto prediction = Matrix<float>::RandomUniform(rows, cols, deviceId, -3, 3, IncrementCounter());
+        Matrix<float> stats(deviceId), statsOfIndices(deviceId);
+        Matrix<float>::SoftmaxCrossEntropy(denseLabels, prediction, stats);
+        Matrix<float>::SoftmaxCrossEntropy(indices, prediction, statsOfIndices);
+        BOOST_CHECK(statsOfIndices.IsEqualTo(stats, 1e-5f));
+    }
+}
+BOOST_FIXTURE_TEST_CASE(TensorViewContraction, RandomSeedFixture)
+{
+    // a batch of products c[:,:,t] = a[:,:,t] * b[:,:,t] as a GEMM, into a transposed output, and with a's batch axis
+    // in the middle (the reduction fallback)
+    const size_t I = 3, K = 4, J = 5, T = 2;
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        const auto a = Matrix<float>::RandomUniform(I * K, T, deviceId, -1, 1, IncrementCounter());
+        const auto b = Matrix<float>::RandomUniform(K * J, T, deviceId, -1, 1, IncrementCounter());
+        Matrix<float> expected(I * J, T, CPUDEVICE), expectedTransposed(J * I, T, CPUDEVICE);
+        Matrix<float> middleBatchA(I * T, K, CPUDEVICE);
+        for (size_t t = 0; t < T; t++)
+        {
+            for (size_t i = 0; i < I; i++)
+            {
+                for (size_t j = 0; j < J; j++)
+                {
+                    float sum = 0;
+                    for (size_t k = 0; k < K; k++)
+                        sum += a(i + I * k, t) * b(k + K * j, t);
+                    expected(i + I * j, t) = sum;
+                    expectedTransposed(j + J * i, t) = sum;
+                }
+                for (size_t k = 0; k < K; k++)
+                    middleBatchA(i + I * t, k) = a(i + I * k, t);
+            }
+        }
+        middleBatchA.TransferToDeviceIfNotThere(deviceId, true);
+
+        Matrix<float> c(I * J, T, deviceId), cTransposed(J * I, T, deviceId), cFallback(I * J, T, deviceId);
+        TensorView<float>(c, TensorShape(I, J, T)).AssignContractionOf(TensorView<float>(a, TensorShape(I, K, T)), TensorView<float>(b, TensorShape(K, J, T)), "ikt,kjt->ijt");
+        TensorView<float>(cTransposed, TensorShape(J, I, T)).AssignContractionOf(TensorView<float>(a, TensorShape(I, K, T)), TensorView<float>(b, TensorShape(K, J, T)), "ikt,kjt->jit");
+        TensorView<float>(cFallback, TensorShape(I, J, T)).AssignContractionOf(TensorView<float>(middleBatchA, TensorShape(I, T, K)), TensorView<float>(b, TensorShape(K, J, T)), "itk,kjt->ijt");
+        for (size_t t = 0; t < T; t++)
+        {
+            for (size_t r = 0; r < I * J; r++)
+            {
+                BOOST_CHECK_CLOSE(c(r, t), expected(r, t), 1e-3);
+                BOOST_CHECK_CLOSE(cTransposed(r, t), expectedTransposed(r, t), 1e-3);
+                BOOST_CHECK_CLOSE(cFallback(r, t), expected(r, t), 1e-3);
+            }
+        }
+    }
+}
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }